@@ -0,0 +1,291 @@
+/**
+ * @file columns.c
+ * @brief Columnar export of list instances
+ *
+ * Copyright (c) 2015 - 2018 CESNET, z.s.p.o.
+ *
+ * This source code is licensed under BSD 3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://opensource.org/licenses/BSD-3-Clause
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "libyang.h"
+#include "tree_data.h"
+#include "tree_internal.h"
+#include "tree_schema.h"
+
+/**
+ * @brief Get the width of the values of a column, 0 for a column without fixed-width values.
+ */
+static size_t
+columns_width(LY_DATA_TYPE type)
+{
+    switch (type) {
+    case LY_TYPE_INT8:
+    case LY_TYPE_UINT8:
+        return 1;
+    case LY_TYPE_INT16:
+    case LY_TYPE_UINT16:
+        return 2;
+    case LY_TYPE_INT32:
+    case LY_TYPE_UINT32:
+        return 4;
+    case LY_TYPE_INT64:
+    case LY_TYPE_UINT64:
+    case LY_TYPE_DEC64:
+        return 8;
+    default:
+        return 0;
+    }
+}
+
+/**
+ * @brief Find the leaf of a column among the children of a list.
+ *
+ * @param[in] list List schema node.
+ * @param[in] name Leaf name, optionally prefixed with its module name.
+ * @return Leaf, NULL if not found.
+ */
+static const struct lys_node *
+columns_find_leaf(const struct lys_node *list, const char *name)
+{
+    const struct lys_node *snode = NULL;
+    const char *mod_name = NULL, *ptr;
+    size_t mod_len = 0;
+
+    ptr = strchr(name, ':');
+    if (ptr) {
+        mod_name = name;
+        mod_len = ptr - name;
+        name = ptr + 1;
+    }
+
+    while ((snode = lys_getnext(snode, list, NULL, 0))) {
+        if ((snode->nodetype == LYS_LEAF) && !strcmp(snode->name, name)
+                && (!mod_name || (!strncmp(lys_node_module(snode)->name, mod_name, mod_len)
+                && !lys_node_module(snode)->name[mod_len]))) {
+            return snode;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Prepare a column of the export.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int
+columns_init(struct lyd_column *col, const struct lys_node *leaf, uint32_t rows)
+{
+    const struct lys_type *type = &((struct lys_node_leaf *)leaf)->type;
+    size_t width;
+
+    col->schema = (struct lys_node_leaf *)leaf;
+    switch (type->base) {
+    case LY_TYPE_INT8:
+    case LY_TYPE_UINT8:
+    case LY_TYPE_INT16:
+    case LY_TYPE_UINT16:
+    case LY_TYPE_INT32:
+    case LY_TYPE_UINT32:
+    case LY_TYPE_INT64:
+    case LY_TYPE_UINT64:
+    case LY_TYPE_BOOL:
+    case LY_TYPE_EMPTY:
+        col->type = type->base;
+        break;
+    case LY_TYPE_DEC64:
+        col->type = LY_TYPE_DEC64;
+        col->fraction_digits = type->info.dec64.dig;
+        break;
+    default:
+        /* everything else as its canonical string */
+        col->type = LY_TYPE_STRING;
+        break;
+    }
+
+    col->validity = calloc((rows + 7) / 8 ? (rows + 7) / 8 : 1, 1);
+    LY_CHECK_ERR_RETURN(!col->validity, LOGMEM(leaf->module->ctx), -1);
+
+    width = columns_width(col->type);
+    if (width) {
+        col->values = calloc(rows ? rows : 1, width);
+    } else if (col->type == LY_TYPE_BOOL) {
+        col->values = calloc((rows + 7) / 8 ? (rows + 7) / 8 : 1, 1);
+    } else if (col->type == LY_TYPE_STRING) {
+        col->offsets = calloc(rows + 1, sizeof *col->offsets);
+    }
+    LY_CHECK_ERR_RETURN((width || (col->type == LY_TYPE_BOOL)) ? !col->values
+                        : ((col->type == LY_TYPE_STRING) && !col->offsets), LOGMEM(leaf->module->ctx), -1);
+
+    return 0;
+}
+
+/**
+ * @brief Store the value of a leaf into the row of a column.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int
+columns_store(struct lyd_column *col, uint32_t row, const struct lyd_node_leaf_list *leaf, size_t *data_size)
+{
+    size_t len, width;
+    char *data;
+
+    if (col->type == LY_TYPE_STRING) {
+        len = strlen(leaf->value_str);
+        if ((size_t)col->offsets[row] + len > INT32_MAX) {
+            LOGERR(leaf->schema->module->ctx, LY_EINVAL, "Values of the column \"%s\" too long.", col->schema->name);
+            return -1;
+        }
+        if ((size_t)col->offsets[row] + len > *data_size) {
+            *data_size = (*data_size ? *data_size : 256);
+            while (*data_size < (size_t)col->offsets[row] + len) {
+                *data_size *= 2;
+            }
+            data = realloc(col->data, *data_size);
+            LY_CHECK_ERR_RETURN(!data, LOGMEM(leaf->schema->module->ctx), -1);
+            col->data = data;
+        }
+        memcpy(col->data + col->offsets[row], leaf->value_str, len);
+        col->offsets[row + 1] = col->offsets[row] + len;
+    } else if ((leaf->value_type != col->type) || (leaf->value_flags & LY_VALUE_USER)) {
+        /* value not in the native representation */
+        return 0;
+    } else if (col->type == LY_TYPE_BOOL) {
+        if (leaf->value.bln) {
+            ((uint8_t *)col->values)[row / 8] |= 1 << (row % 8);
+        }
+    } else if ((width = columns_width(col->type))) {
+        /* all the integers are stored at the beginning of the union */
+        switch (width) {
+        case 1:
+            ((uint8_t *)col->values)[row] = leaf->value.uint8;
+            break;
+        case 2:
+            ((uint16_t *)col->values)[row] = leaf->value.uint16;
+            break;
+        case 4:
+            ((uint32_t *)col->values)[row] = leaf->value.uint32;
+            break;
+        default:
+            ((uint64_t *)col->values)[row] = leaf->value.uint64;
+            break;
+        }
+    }
+
+    col->validity[row / 8] |= 1 << (row % 8);
+    return 0;
+}
+
+API int
+lyd_export_columns(const struct lyd_node *data, const struct lys_node *list, const char **columns, uint32_t count,
+                   struct lyd_columns **result)
+{
+    struct lyd_columns *cols = NULL;
+    struct lyd_column *col;
+    struct ly_set *set = NULL;
+    const struct lys_node *leaf;
+    struct lyd_node *iter;
+    size_t *data_sizes = NULL;
+    uint32_t i, row;
+
+    if (!list || (list->nodetype != LYS_LIST) || (count && !columns) || !result) {
+        LOGARG;
+        return -1;
+    }
+    *result = NULL;
+
+    if (data) {
+        set = lyd_find_instance(data, list);
+        if (!set) {
+            return -1;
+        }
+    }
+
+    cols = calloc(1, sizeof *cols);
+    LY_CHECK_ERR_GOTO(!cols, LOGMEM(list->module->ctx), error);
+    cols->rows = set ? set->number : 0;
+    cols->count = count;
+    cols->columns = calloc(count ? count : 1, sizeof *cols->columns);
+    data_sizes = calloc(count ? count : 1, sizeof *data_sizes);
+    LY_CHECK_ERR_GOTO(!cols->columns || !data_sizes, LOGMEM(list->module->ctx), error);
+
+    for (i = 0; i < count; ++i) {
+        leaf = columns[i] ? columns_find_leaf(list, columns[i]) : NULL;
+        if (!leaf) {
+            LOGERR(list->module->ctx, LY_EINVAL, "Leaf \"%s\" not found in the list \"%s\".",
+                   columns[i] ? columns[i] : "", list->name);
+            goto error;
+        }
+        if (columns_init(&cols->columns[i], leaf, cols->rows)) {
+            goto error;
+        }
+    }
+
+    /* one pass over the instances and their children */
+    for (row = 0; row < cols->rows; ++row) {
+        LY_TREE_FOR(set->set.d[row]->child, iter) {
+            if (iter->schema->nodetype != LYS_LEAF) {
+                continue;
+            }
+            for (i = 0; i < count; ++i) {
+                col = &cols->columns[i];
+                if ((struct lys_node *)col->schema == iter->schema) {
+                    if (columns_store(col, row, (struct lyd_node_leaf_list *)iter, &data_sizes[i])) {
+                        goto error;
+                    }
+                }
+            }
+        }
+
+        for (i = 0; i < count; ++i) {
+            col = &cols->columns[i];
+            if (!(col->validity[row / 8] & (1 << (row % 8)))) {
+                ++col->null_count;
+                if (col->offsets) {
+                    col->offsets[row + 1] = col->offsets[row];
+                }
+            }
+        }
+    }
+
+    ly_set_free(set);
+    free(data_sizes);
+    *result = cols;
+    return 0;
+
+error:
+    ly_set_free(set);
+    free(data_sizes);
+    lyd_free_columns(cols);
+    return -1;
+}
+
+API void
+lyd_free_columns(struct lyd_columns *columns)
+{
+    uint32_t i;
+
+    if (!columns) {
+        return;
+    }
+
+    for (i = 0; columns->columns && (i < columns->count); ++i) {
+        free(columns->columns[i].validity);
+        free(columns->columns[i].values);
+        free(columns->columns[i].offsets);
+        free(columns->columns[i].data);
+    }
+    free(columns->columns);
+    free(columns);
+}
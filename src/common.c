@@ -23,12 +23,19 @@
 #include <stdlib.h>
 #include <sys/syscall.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
+#if defined(__SSE2__)
+# include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+# include <arm_neon.h>
+#endif
 
 #include "common.h"
 #include "parser.h"
 #include "xpath.h"
 #include "context.h"
+#include "xml_internal.h"
 
 THREAD_LOCAL enum int_log_opts log_opt;
 THREAD_LOCAL int8_t ly_errno_glob;
@@ -39,6 +46,133 @@ ly_errno_glob_address(void)
     return (LY_ERR *)&ly_errno_glob;
 }
 
+/* evaluation budget of the thread, see ly_eval_budget() */
+static THREAD_LOCAL struct {
+    uint64_t steps;             /* maximum steps, 0 for no limit */
+    uint64_t used;              /* steps already performed */
+    struct timespec deadline;   /* zero for no limit */
+    const volatile int *cancel;
+    ly_eval_yield_clb yield_clb;
+    void *yield_data;
+    uint8_t active;
+    uint8_t exhausted;
+} eval_budget;
+
+/* how often the deadline is checked, in steps */
+#define LY_EVAL_TIME_STEPS 64
+
+API void
+ly_eval_budget(uint64_t steps, uint32_t msec, const volatile int *cancel, ly_eval_yield_clb yield_clb,
+               void *yield_data)
+{
+    memset(&eval_budget, 0, sizeof eval_budget);
+    eval_budget.steps = steps;
+    if (msec) {
+        clock_gettime(CLOCK_MONOTONIC, &eval_budget.deadline);
+        eval_budget.deadline.tv_sec += msec / 1000;
+        eval_budget.deadline.tv_nsec += (msec % 1000) * 1000000L;
+        if (eval_budget.deadline.tv_nsec >= 1000000000L) {
+            ++eval_budget.deadline.tv_sec;
+            eval_budget.deadline.tv_nsec -= 1000000000L;
+        }
+    }
+    eval_budget.cancel = cancel;
+    eval_budget.yield_clb = yield_clb;
+    eval_budget.yield_data = yield_data;
+    eval_budget.active = (steps || msec || cancel || yield_clb) ? 1 : 0;
+}
+
+int
+ly_eval_step(const struct ly_ctx *ctx)
+{
+    struct timespec now;
+
+    if (!eval_budget.active) {
+        return 0;
+    }
+
+    if (!eval_budget.exhausted) {
+        ++eval_budget.used;
+        if (eval_budget.steps && (eval_budget.used > eval_budget.steps)) {
+            eval_budget.exhausted = 1;
+        } else if (eval_budget.cancel && *eval_budget.cancel) {
+            eval_budget.exhausted = 1;
+        } else if ((eval_budget.deadline.tv_sec || eval_budget.deadline.tv_nsec)
+                && !(eval_budget.used % LY_EVAL_TIME_STEPS)) {
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            if ((now.tv_sec > eval_budget.deadline.tv_sec)
+                    || ((now.tv_sec == eval_budget.deadline.tv_sec) && (now.tv_nsec >= eval_budget.deadline.tv_nsec))) {
+                eval_budget.exhausted = 1;
+            }
+        }
+        if (!eval_budget.exhausted && eval_budget.yield_clb && !(eval_budget.used % LY_EVAL_YIELD_STEPS)
+                && eval_budget.yield_clb(eval_budget.yield_data)) {
+            eval_budget.exhausted = 1;
+        }
+        if (!eval_budget.exhausted) {
+            return 0;
+        }
+    }
+
+    LOGERR(ctx, LY_EINCOMPLETE, "Evaluation interrupted after %" PRIu64 " steps, its budget is exhausted.",
+           eval_budget.used);
+    return 1;
+}
+
+/* parse budget of the thread, see ly_parse_budget() */
+static THREAD_LOCAL struct {
+    uint64_t nodes;             /* maximum data nodes of a single parse, 0 for no limit */
+    size_t bytes;               /* maximum bytes of a single parse, 0 for no limit */
+    uint64_t used_nodes;
+    size_t used_bytes;
+    uint32_t parsing;           /* depth of the parse calls in progress */
+} parse_budget;
+
+API void
+ly_parse_budget(uint64_t nodes, size_t bytes)
+{
+    parse_budget.nodes = nodes;
+    parse_budget.bytes = bytes;
+}
+
+void
+ly_parse_budget_start(void)
+{
+    if (!parse_budget.parsing++) {
+        parse_budget.used_nodes = 0;
+        parse_budget.used_bytes = 0;
+    }
+}
+
+void
+ly_parse_budget_stop(void)
+{
+    assert(parse_budget.parsing);
+    --parse_budget.parsing;
+}
+
+int
+ly_parse_charge(const struct ly_ctx *ctx, uint32_t nodes, size_t bytes)
+{
+    if (!parse_budget.parsing || (!parse_budget.nodes && !parse_budget.bytes)) {
+        return 0;
+    }
+
+    parse_budget.used_nodes += nodes;
+    parse_budget.used_bytes += bytes;
+    if (parse_budget.nodes && (parse_budget.used_nodes > parse_budget.nodes)) {
+        LOGERR(ctx, LY_EMEM, "Data parsing interrupted, its budget of %" PRIu64 " nodes is exhausted.",
+               parse_budget.nodes);
+        return 1;
+    }
+    if (parse_budget.bytes && (parse_budget.used_bytes > parse_budget.bytes)) {
+        LOGERR(ctx, LY_EMEM, "Data parsing interrupted, its budget of %zu bytes is exhausted.", parse_budget.bytes);
+        return 1;
+    }
+
+    return 0;
+}
+
 API LY_VECODE
 ly_vecode(const struct ly_ctx *ctx)
 {
@@ -91,6 +225,35 @@ ly_errapptag(const struct ly_ctx *ctx)
     return NULL;
 }
 
+/* error list of the context last used by the thread, avoids the thread-specific key lookup */
+static THREAD_LOCAL struct {
+    const struct ly_ctx *ctx;
+    uint32_t id;                /* ID of the context, the address may be reused by a new context */
+    struct ly_err_item *first;
+} errlist_cache;
+
+struct ly_err_item *
+ly_err_list_get(const struct ly_ctx *ctx)
+{
+    if ((errlist_cache.ctx != ctx) || (errlist_cache.id != ctx->errlist_id)) {
+        errlist_cache.ctx = ctx;
+        errlist_cache.id = ctx->errlist_id;
+        errlist_cache.first = pthread_getspecific(ctx->errlist_key);
+    }
+
+    return errlist_cache.first;
+}
+
+void
+ly_err_list_set(const struct ly_ctx *ctx, struct ly_err_item *first)
+{
+    pthread_setspecific(ctx->errlist_key, first);
+
+    errlist_cache.ctx = ctx;
+    errlist_cache.id = ctx->errlist_id;
+    errlist_cache.first = first;
+}
+
 API struct ly_err_item *
 ly_err_first(const struct ly_ctx *ctx)
 {
@@ -98,7 +261,7 @@ ly_err_first(const struct ly_ctx *ctx)
         return NULL;
     }
 
-    return pthread_getspecific(ctx->errlist_key);
+    return ly_err_list_get(ctx);
 }
 
 void
@@ -126,9 +289,9 @@ ly_err_clean(struct ly_ctx *ctx, struct ly_err_item *eitem)
         eitem = NULL;
     }
     if (eitem) {
-        /* disconnect the error */
-        for (i = first; i && (i->next != eitem); i = i->next);
-        assert(i);
+        /* disconnect the error, the previous error is directly linked */
+        i = eitem->prev;
+        assert(i && (i->next == eitem));
         i->next = NULL;
         first->prev = i;
         /* free this err and newer */
@@ -138,7 +301,7 @@ ly_err_clean(struct ly_ctx *ctx, struct ly_err_item *eitem)
     } else {
         /* free all err */
         ly_err_free(first);
-        pthread_setspecific(ctx->errlist_key, NULL);
+        ly_err_list_set(ctx, NULL);
         /* also clean errno */
         ly_errno = LY_SUCCESS;
     }
@@ -457,11 +620,10 @@ static int
 transform_xml2json_subexp(struct ly_ctx *ctx, const char *expr, char **out, size_t *out_used, size_t *out_size,
                           struct lyxml_elem *xml, int inst_id, int use_ctx_data_clb)
 {
-    const char *end, *cur_expr, *literal;
-    char *prefix;
+    const char *end, *cur_expr, *literal, *prev_prefix = NULL;
     uint16_t i;
     enum int_log_opts prev_ilo;
-    size_t pref_len;
+    size_t pref_len, prev_pref_len = 0;
     const struct lys_module *mod, *prev_mod = NULL;
     const struct lyxml_ns *ns;
     struct lyxp_expr *exp;
@@ -483,13 +645,12 @@ transform_xml2json_subexp(struct ly_ctx *ctx, const char *expr, char **out, size
         if ((exp->tokens[i] == LYXP_TOKEN_NAMETEST) && (end = strnchr(cur_expr, ':', exp->tok_len[i]))) {
             /* get the module */
             pref_len = end - cur_expr;
-            prefix = strndup(cur_expr, pref_len);
-            if (!prefix) {
-                LOGMEM(ctx);
-                goto error;
+            if (prev_mod && (pref_len == prev_pref_len) && !strncmp(cur_expr, prev_prefix, pref_len)) {
+                /* the same prefix as the previous one, mostly in instance-identifiers */
+                mod = prev_mod;
+                goto copy;
             }
-            ns = lyxml_get_ns(xml, prefix);
-            free(prefix);
+            ns = lyxml_get_ns_len(xml, cur_expr, pref_len);
             if (!ns) {
                 LOGVAL(ctx, LYE_XML_INVAL, LY_VLOG_XML, xml, "namespace prefix");
                 LOGVAL(ctx, LYE_SPEC, LY_VLOG_PREV, NULL, "XML namespace with prefix \"%.*s\" not defined.", pref_len, cur_expr);
@@ -509,6 +670,7 @@ transform_xml2json_subexp(struct ly_ctx *ctx, const char *expr, char **out, size
                 goto error;
             }
 
+copy:
             if (!inst_id || (mod != prev_mod)) {
                 /* adjust out size (it can even decrease in some strange cases) */
                 *out_size += strlen(mod->name) - pref_len;
@@ -529,6 +691,8 @@ transform_xml2json_subexp(struct ly_ctx *ctx, const char *expr, char **out, size
 
             /* remember previous model name */
             prev_mod = mod;
+            prev_prefix = cur_expr;
+            prev_pref_len = pref_len;
 
             /* copy the rest */
             strncpy(&(*out)[*out_used], end, exp->tok_len[i] - pref_len);
@@ -1309,6 +1473,11 @@ ly_new_node_validity(const struct lys_node *schema)
     return validity;
 }
 
+#ifdef LY_ENABLED_ALLOC_TRACE
+/* only the calls are expanded in place */
+#undef ly_realloc
+#endif
+
 void *
 ly_realloc(void *ptr, size_t size)
 {
@@ -1367,6 +1536,118 @@ dec64cmp(int64_t num1, uint8_t dig1, int64_t num2, uint8_t dig2)
     return (num1 > num2 ? 1 : -1);
 }
 
+size_t
+ly_utf8_span(const char *str, size_t len, size_t *count)
+{
+    const unsigned char *s = (const unsigned char *)str;
+    size_t i = 0, chars = 0;
+    uint32_t c, min;
+    unsigned int n, j;
+#if defined(__SSE2__)
+    __m128i chunk, bad;
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    uint8x16_t chunk, bad;
+#endif
+
+    while (i < len) {
+        /* whole blocks of allowed ASCII characters */
+#if defined(__SSE2__)
+        /* as signed bytes, the characters that are not allowed or not ASCII are lower than 0x20, except whitespaces */
+        for (; i + 16 <= len; i += 16, chars += 16) {
+            chunk = _mm_loadu_si128((const __m128i *)&s[i]);
+            bad = _mm_andnot_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(0x9)),
+                                                _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(0xa)),
+                                                             _mm_cmpeq_epi8(chunk, _mm_set1_epi8(0xd)))),
+                                   _mm_cmplt_epi8(chunk, _mm_set1_epi8(0x20)));
+            if (_mm_movemask_epi8(bad)) {
+                break;
+            }
+        }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+        for (; i + 16 <= len; i += 16, chars += 16) {
+            chunk = vld1q_u8(&s[i]);
+            bad = vbicq_u8(vorrq_u8(vcltq_u8(chunk, vdupq_n_u8(0x20)), vcgtq_u8(chunk, vdupq_n_u8(0x7f))),
+                           vorrq_u8(vceqq_u8(chunk, vdupq_n_u8(0x9)),
+                                    vorrq_u8(vceqq_u8(chunk, vdupq_n_u8(0xa)), vceqq_u8(chunk, vdupq_n_u8(0xd)))));
+            if (vmaxvq_u8(bad)) {
+                break;
+            }
+        }
+#endif
+        if (i == len) {
+            break;
+        }
+
+        /* single character */
+        c = s[i];
+        if (c < 0x80) {
+            if ((c < 0x20) && (c != 0x9) && (c != 0xa) && (c != 0xd)) {
+                break;
+            }
+            n = 1;
+            min = 0;
+        } else if ((c & 0xe0) == 0xc0) {
+            n = 2;
+            c &= 0x1f;
+            min = 0x80;
+        } else if ((c & 0xf0) == 0xe0) {
+            n = 3;
+            c &= 0x0f;
+            min = 0x800;
+        } else if ((c & 0xf8) == 0xf0) {
+            n = 4;
+            c &= 0x07;
+            min = 0x10000;
+        } else {
+            break;
+        }
+        if (n > len - i) {
+            break;
+        }
+        for (j = 1; j < n; ++j) {
+            if ((s[i + j] & 0xc0) != 0x80) {
+                break;
+            }
+            c = (c << 6) | (s[i + j] & 0x3f);
+        }
+        if ((j < n) || (c < min) || (c > 0x10ffff)) {
+            break;
+        }
+        if ((n > 2) && (((c & 0xf800) == 0xd800) || ((c >= 0xfdd0) && (c <= 0xfdef)) || ((c & 0xffe) == 0xffe))) {
+            /* surrogates and noncharacters, the same as copyutf8() excludes */
+            break;
+        }
+
+        i += n;
+        ++chars;
+    }
+
+    if (count) {
+        *count = chars;
+    }
+    return i;
+}
+
+size_t
+ly_utf8_count(const char *str, size_t len)
+{
+    size_t i = 0, count = 0, chars;
+
+    while (1) {
+        i += ly_utf8_span(&str[i], len - i, &chars);
+        count += chars;
+        if (i == len) {
+            break;
+        }
+
+        /* a control character or an invalid byte, count it as a character */
+        ++i;
+        ++count;
+    }
+
+    return count;
+}
+
 LYB_HASH
 lyb_hash(struct lys_node *sibling, uint8_t collision_id)
 {
@@ -1383,8 +1664,9 @@ lyb_hash(struct lys_node *sibling, uint8_t collision_id)
 
     mod = lys_node_module(sibling);
 
-    full_hash = dict_hash_multi(0, mod->name, strlen(mod->name));
-    full_hash = dict_hash_multi(full_hash, sibling->name, strlen(sibling->name));
+    /* the hash is a part of the LYB format */
+    full_hash = dict_hash_multi_oaat(0, mod->name, strlen(mod->name));
+    full_hash = dict_hash_multi_oaat(full_hash, sibling->name, strlen(sibling->name));
     if (collision_id) {
         if (collision_id > strlen(mod->name)) {
             /* fine, we will not hash more bytes, just use more bits from the hash than previously */
@@ -1393,9 +1675,9 @@ lyb_hash(struct lys_node *sibling, uint8_t collision_id)
             /* use one more byte from the module name than before */
             ext_len = collision_id;
         }
-        full_hash = dict_hash_multi(full_hash, mod->name, ext_len);
+        full_hash = dict_hash_multi_oaat(full_hash, mod->name, ext_len);
     }
-    full_hash = dict_hash_multi(full_hash, NULL, 0);
+    full_hash = dict_hash_multi_oaat(full_hash, NULL, 0);
 
     /* use the shortened hash */
     hash = full_hash & (LYB_HASH_MASK >> collision_id);
@@ -1426,3 +1708,240 @@ lyb_has_schema_model(struct lys_node *sibling, const struct lys_module **models,
 
     return 0;
 }
+
+#ifdef LY_ENABLED_ALLOC_TRACE
+
+/* maximum number of the allocation call sites, a power of 2 */
+#define LY_ALLOC_SITES 8192
+
+enum ly_alloc_func {
+    LY_ALLOC_MALLOC,
+    LY_ALLOC_CALLOC,
+    LY_ALLOC_REALLOC,
+    LY_ALLOC_STRDUP,
+    LY_ALLOC_STRNDUP,
+    LY_ALLOC_ASPRINTF,
+    LY_ALLOC_FREE
+};
+
+static const char *ly_alloc_func_names[] = {"malloc", "calloc", "realloc", "strdup", "strndup", "asprintf", "free"};
+
+static struct {
+    atomic_int state;            /* 0 - unused, 1 - being filled, 2 - used */
+    const char *file;
+    int line;
+    enum ly_alloc_func func;
+    atomic_uint_least64_t calls;
+    atomic_uint_least64_t bytes;
+} ly_alloc_sites[LY_ALLOC_SITES];
+
+static void
+ly_alloc_count(enum ly_alloc_func func, size_t bytes, const char *file, int line)
+{
+    uint32_t i, hash;
+    int state;
+
+    hash = (uint32_t)((uintptr_t)file >> 3) * 31 + line * 8 + func;
+    for (i = 0; i < LY_ALLOC_SITES; ++i) {
+        hash &= LY_ALLOC_SITES - 1;
+        state = atomic_load_explicit(&ly_alloc_sites[hash].state, memory_order_acquire);
+        if (!state && atomic_compare_exchange_strong(&ly_alloc_sites[hash].state, &state, 1)) {
+            ly_alloc_sites[hash].file = file;
+            ly_alloc_sites[hash].line = line;
+            ly_alloc_sites[hash].func = func;
+            atomic_store_explicit(&ly_alloc_sites[hash].state, 2, memory_order_release);
+            state = 2;
+        }
+        while (state == 1) {
+            state = atomic_load_explicit(&ly_alloc_sites[hash].state, memory_order_acquire);
+        }
+
+        if ((ly_alloc_sites[hash].line == line) && (ly_alloc_sites[hash].func == func)
+                && ((ly_alloc_sites[hash].file == file) || !strcmp(ly_alloc_sites[hash].file, file))) {
+            atomic_fetch_add_explicit(&ly_alloc_sites[hash].calls, 1, memory_order_relaxed);
+            atomic_fetch_add_explicit(&ly_alloc_sites[hash].bytes, bytes, memory_order_relaxed);
+            return;
+        }
+        ++hash;
+    }
+
+    /* all the sites are used, not counted */
+}
+
+void *
+ly_trace_malloc(size_t size, const char *file, int line)
+{
+    ly_alloc_count(LY_ALLOC_MALLOC, size, file, line);
+    return (malloc)(size);
+}
+
+void *
+ly_trace_calloc(size_t nmemb, size_t size, const char *file, int line)
+{
+    ly_alloc_count(LY_ALLOC_CALLOC, nmemb * size, file, line);
+    return (calloc)(nmemb, size);
+}
+
+void *
+ly_trace_realloc(void *ptr, size_t size, const char *file, int line)
+{
+    ly_alloc_count(LY_ALLOC_REALLOC, size, file, line);
+    return (realloc)(ptr, size);
+}
+
+char *
+ly_trace_strdup(const char *s, const char *file, int line)
+{
+    ly_alloc_count(LY_ALLOC_STRDUP, strlen(s) + 1, file, line);
+    return (strdup)(s);
+}
+
+char *
+ly_trace_strndup(const char *s, size_t n, const char *file, int line)
+{
+    ly_alloc_count(LY_ALLOC_STRNDUP, strnlen(s, n) + 1, file, line);
+    return (strndup)(s, n);
+}
+
+int
+ly_trace_vasprintf(char **strp, const char *fmt, va_list ap, const char *file, int line)
+{
+    int ret;
+
+    ret = (vasprintf)(strp, fmt, ap);
+    ly_alloc_count(LY_ALLOC_ASPRINTF, ret < 0 ? 0 : ret + 1, file, line);
+    return ret;
+}
+
+int
+ly_trace_asprintf(const char *file, int line, char **strp, const char *fmt, ...)
+{
+    va_list ap;
+    int ret;
+
+    va_start(ap, fmt);
+    ret = ly_trace_vasprintf(strp, fmt, ap, file, line);
+    va_end(ap);
+    return ret;
+}
+
+void
+ly_trace_free(void *ptr, const char *file, int line)
+{
+    if (ptr) {
+        ly_alloc_count(LY_ALLOC_FREE, 0, file, line);
+    }
+    (free)(ptr);
+}
+
+static int
+ly_alloc_site_cmp(const void *a, const void *b)
+{
+    const struct ly_alloc_site *s1 = a, *s2 = b;
+
+    return (s1->calls < s2->calls) - (s1->calls > s2->calls);
+}
+
+API int
+ly_alloc_trace_get(struct ly_alloc_site **sites, uint32_t *count)
+{
+    uint32_t i;
+    void *mem;
+
+    if (!sites || !count) {
+        LOGARG;
+        return EXIT_FAILURE;
+    }
+
+    *sites = NULL;
+    *count = 0;
+    for (i = 0; i < LY_ALLOC_SITES; ++i) {
+        if ((atomic_load_explicit(&ly_alloc_sites[i].state, memory_order_acquire) != 2)
+                || !atomic_load_explicit(&ly_alloc_sites[i].calls, memory_order_relaxed)) {
+            continue;
+        }
+
+        /* not traced itself */
+        if (!(*count % 64)) {
+            mem = (realloc)(*sites, (*count + 64) * sizeof **sites);
+            if (!mem) {
+                (free)(*sites);
+                *sites = NULL;
+                *count = 0;
+                LOGMEM(NULL);
+                return EXIT_FAILURE;
+            }
+            *sites = mem;
+        }
+        (*sites)[*count].file = ly_alloc_sites[i].file;
+        (*sites)[*count].line = ly_alloc_sites[i].line;
+        (*sites)[*count].func = ly_alloc_func_names[ly_alloc_sites[i].func];
+        (*sites)[*count].calls = atomic_load_explicit(&ly_alloc_sites[i].calls, memory_order_relaxed);
+        (*sites)[*count].bytes = atomic_load_explicit(&ly_alloc_sites[i].bytes, memory_order_relaxed);
+        ++(*count);
+    }
+
+    if (*count) {
+        qsort(*sites, *count, sizeof **sites, ly_alloc_site_cmp);
+    }
+    return EXIT_SUCCESS;
+}
+
+API void
+ly_alloc_trace_clean(void)
+{
+    uint32_t i;
+
+    for (i = 0; i < LY_ALLOC_SITES; ++i) {
+        atomic_store_explicit(&ly_alloc_sites[i].calls, 0, memory_order_relaxed);
+        atomic_store_explicit(&ly_alloc_sites[i].bytes, 0, memory_order_relaxed);
+    }
+}
+
+/* append the sites to the file from LIBYANG_ALLOC_TRACE when the process exits */
+static void __attribute__((destructor))
+ly_alloc_trace_report(void)
+{
+    struct ly_alloc_site *sites;
+    uint32_t i, count;
+    const char *path;
+    FILE *out;
+
+    path = getenv("LIBYANG_ALLOC_TRACE");
+    if (!path || !path[0] || ly_alloc_trace_get(&sites, &count)) {
+        return;
+    }
+
+    out = fopen(path, "a");
+    if (out) {
+        fprintf(out, "# %s (%d)\n", program_invocation_short_name, (int)getpid());
+        for (i = 0; i < count; ++i) {
+            fprintf(out, "%s:%" PRIu32 " %s %" PRIu64 " %" PRIu64 "\n", sites[i].file, sites[i].line, sites[i].func,
+                    sites[i].calls, sites[i].bytes);
+        }
+        fclose(out);
+    }
+    (free)(sites);
+}
+
+#else
+
+API int
+ly_alloc_trace_get(struct ly_alloc_site **sites, uint32_t *count)
+{
+    if (sites) {
+        *sites = NULL;
+    }
+    if (count) {
+        *count = 0;
+    }
+    return EXIT_FAILURE;
+}
+
+API void
+ly_alloc_trace_clean(void)
+{
+    return;
+}
+
+#endif
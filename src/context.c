@@ -13,6 +13,7 @@
  */
 
 #define _GNU_SOURCE
+#include <ctype.h>
 #include <pthread.h>
 #include <stddef.h>
 #include <stdlib.h>
@@ -23,6 +24,7 @@
 #include <limits.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <time.h>
 
 #include "common.h"
 #include "context.h"
@@ -78,8 +80,19 @@ ly_ctx_internal_modules_count(struct ly_ctx *ctx)
     return ctx->internal_module_count;
 }
 
-API struct ly_ctx *
-ly_ctx_new(const char *search_dir, int options)
+/* source of the context IDs, see ly_err_list_get() */
+static atomic_uint_least32_t ly_ctx_errlist_ids;
+
+/**
+ * @brief Create a new context, see ly_ctx_new().
+ *
+ * @param[in] search_dir Search directories.
+ * @param[in] options Context options.
+ * @param[in] dict Dictionary to share with another context, NULL to create a new one.
+ * @return New context, NULL on error.
+ */
+static struct ly_ctx *
+ly_ctx_new_dict(const char *search_dir, int options, struct dict_table *dict)
 {
     struct ly_ctx *ctx = NULL;
     struct lys_module *module;
@@ -87,23 +100,52 @@ ly_ctx_new(const char *search_dir, int options)
     char *search_dir_list;
     char *sep, *dir;
     int rc = EXIT_SUCCESS;
-    int i;
+    int i, trusted;
 
     ctx = calloc(1, sizeof *ctx);
     LY_CHECK_ERR_RETURN(!ctx, LOGMEM(NULL), NULL);
 
     /* dictionary */
-    lydict_init(&ctx->dict);
+    ctx->dict = dict ? lydict_ref(dict) : lydict_new();
+    LY_CHECK_ERR_RETURN(!ctx->dict, free(ctx), NULL);
 
     /* plugins */
     ly_load_plugins();
 
     /* initialize thread-specific key */
     while ((i = pthread_key_create(&ctx->errlist_key, ly_err_free)) == EAGAIN);
+    ctx->errlist_id = atomic_fetch_add(&ly_ctx_errlist_ids, 1) + 1;
+
+    pthread_mutex_init(&ctx->val_prof_lock, NULL);
+    pthread_mutex_init(&ctx->plugin_stats_lock, NULL);
+    pthread_mutex_init(&ctx->bits_lock, NULL);
+    pthread_mutex_init(&ctx->binary_lock, NULL);
+    pthread_rwlock_init(&ctx->node_id_lock, NULL);
+    pthread_mutex_init(&ctx->reclaim_lock, NULL);
+    pthread_cond_init(&ctx->reclaim_cond, NULL);
+    atomic_init(&ctx->data_gen, 1);
+
+#ifdef LY_ENABLED_CACHE
+    ctx->data_ht_threshold = LY_CACHE_HT_MIN_CHILDREN;
+    ctx->feature_gen = 1;
+    pthread_mutex_init(&ctx->regex_lock, NULL);
+    pthread_rwlock_init(&ctx->child_hash_lock, NULL);
+    pthread_rwlock_init(&ctx->mand_hash_lock, NULL);
+    pthread_rwlock_init(&ctx->op_deps_hash_lock, NULL);
+    pthread_rwlock_init(&ctx->value_hash_lock, NULL);
+    pthread_rwlock_init(&ctx->ident_hash_lock, NULL);
+    pthread_rwlock_init(&ctx->annot_hash_lock, NULL);
+    pthread_rwlock_init(&ctx->lyb_hash_lock, NULL);
+    pthread_rwlock_init(&ctx->schema_print_lock, NULL);
+    pthread_rwlock_init(&ctx->path_hash_lock, NULL);
+    pthread_rwlock_init(&ctx->ctx_map_lock, NULL);
+    pthread_rwlock_init(&ctx->info_lock, NULL);
+    pthread_rwlock_init(&ctx->data_side_lock, NULL);
+#endif
 
     /* models list */
     ctx->models.list = calloc(16, sizeof *ctx->models.list);
-    LY_CHECK_ERR_RETURN(!ctx->models.list, LOGMEM(NULL); free(ctx), NULL);
+    LY_CHECK_ERR_RETURN(!ctx->models.list, LOGMEM(NULL); lydict_free(ctx->dict); free(ctx), NULL);
     ctx->models.flags = options;
     ctx->models.used = 0;
     ctx->models.size = 16;
@@ -132,6 +174,9 @@ ly_ctx_new(const char *search_dir, int options)
     } else {
         ctx->internal_module_count = LY_INTERNAL_MODULE_COUNT;
     }
+    /* the internal modules are known to be correct, skip their validation and compile their patterns lazily */
+    trusted = options & LY_CTX_TRUSTED;
+    ctx->models.flags |= LY_CTX_TRUSTED;
     for (i = 0; i < ctx->internal_module_count; i++) {
         module = (struct lys_module *)lys_parse_mem(ctx, internal_modules[i].data, internal_modules[i].format);
         if (!module) {
@@ -139,6 +184,9 @@ ly_ctx_new(const char *search_dir, int options)
         }
         module->implemented = internal_modules[i].implemented;
     }
+    if (!trusted) {
+        ctx->models.flags &= ~LY_CTX_TRUSTED;
+    }
 
     /* cleanup */
     free(cwd);
@@ -151,6 +199,175 @@ error:
     return NULL;
 }
 
+API struct ly_ctx *
+ly_ctx_new(const char *search_dir, int options)
+{
+    return ly_ctx_new_dict(search_dir, options, NULL);
+}
+
+static struct ly_ctx_prefetch *
+ly_ctx_prefetch_find(struct ly_ctx *ctx, const char *filepath)
+{
+    uint32_t i;
+
+    for (i = 0; i < ctx->models.prefetch_count; ++i) {
+        if (ctx->models.prefetch[i].filepath && !strcmp(ctx->models.prefetch[i].filepath, filepath)) {
+            return &ctx->models.prefetch[i];
+        }
+    }
+
+    return NULL;
+}
+
+static void
+ly_ctx_prefetch_release(struct ly_ctx *ctx, struct ly_ctx_prefetch *pre)
+{
+    lyxml_free(ctx, pre->xml);
+    pre->xml = NULL;
+    if (pre->data) {
+        lyp_munmap(pre->data, pre->length);
+        pre->data = NULL;
+    }
+}
+
+static void
+ly_ctx_prefetch_free(struct ly_ctx *ctx)
+{
+    uint32_t i;
+
+    for (i = 0; i < ctx->models.prefetch_count; ++i) {
+        ly_ctx_prefetch_release(ctx, &ctx->models.prefetch[i]);
+        free(ctx->models.prefetch[i].filepath);
+    }
+    free(ctx->models.prefetch);
+    ctx->models.prefetch = NULL;
+    ctx->models.prefetch_count = 0;
+}
+
+struct ly_ctx_prefetch_thread {
+    struct ly_ctx *ctx;
+    uint32_t first;          /* the thread reads every step-th module starting with first */
+    uint32_t step;
+};
+
+static void *
+ly_ctx_prefetch_thread(void *arg)
+{
+    struct ly_ctx_prefetch_thread *pt = (struct ly_ctx_prefetch_thread *)arg;
+    struct ly_ctx_prefetch *pre;
+    enum int_log_opts prev_log_opt = log_opt;
+    uint32_t i;
+    int fd;
+
+    /* any errors are detected and logged again when the module is being loaded */
+    log_opt = ILO_IGNORE;
+
+    for (i = pt->first; i < pt->ctx->models.prefetch_count; i += pt->step) {
+        pre = &pt->ctx->models.prefetch[i];
+        if (!pre->filepath) {
+            continue;
+        }
+
+        fd = open(pre->filepath, O_RDONLY);
+        if (fd < 0) {
+            continue;
+        }
+        if (lyp_mmap(pt->ctx, fd, (pre->format == LYS_IN_YANG) ? 1 : 0, &pre->length, (void **)&pre->data)) {
+            pre->data = NULL;
+        }
+        close(fd);
+
+        if (pre->data && (pre->format == LYS_IN_YIN)) {
+            /* the XML is parsed without the context modules, only the (thread-safe) dictionary is used */
+            pre->xml = lyxml_parse_mem(pt->ctx, pre->data, LYXML_PARSE_NOMIXEDCONTENT);
+        }
+    }
+
+    log_opt = prev_log_opt;
+    return NULL;
+}
+
+/**
+ * @brief Find the files of the modules listed in yang-library data and read (and parse YIN modules)
+ * in several threads, see #LY_CTX_PARALLEL_LOAD. The modules are then parsed from the prefetched
+ * data by ly_ctx_load_localfile().
+ *
+ * @param[in] ctx Context to prefetch for.
+ * @param[in] set Module nodes of yang-library data.
+ */
+static void
+ly_ctx_prefetch_modules(struct ly_ctx *ctx, struct ly_set *set)
+{
+    struct ly_ctx_prefetch *pre;
+    struct ly_ctx_prefetch_thread *pt = NULL;
+    struct lyd_node *node;
+    pthread_t *tids = NULL;
+    int8_t *started = NULL;
+    uint32_t i, count;
+    long cpus;
+
+    if (!set->number || (ctx->models.flags & LY_CTX_DISABLE_SEARCHDIRS)) {
+        return;
+    }
+
+    ctx->models.prefetch = calloc(set->number, sizeof *ctx->models.prefetch);
+    LY_CHECK_ERR_RETURN(!ctx->models.prefetch, LOGMEM(ctx), );
+    ctx->models.prefetch_count = set->number;
+
+    /* find the files, the search directories are indexed so this is fast */
+    for (i = 0; i < set->number; ++i) {
+        pre = &ctx->models.prefetch[i];
+        LY_TREE_FOR(set->set.d[i]->child, node) {
+            if (!strcmp(node->schema->name, "name")) {
+                pre->name = ((struct lyd_node_leaf_list *)node)->value_str;
+            } else if (!strcmp(node->schema->name, "revision")) {
+                pre->revision = ((struct lyd_node_leaf_list *)node)->value_str;
+            }
+        }
+        if (!pre->name) {
+            continue;
+        }
+#ifdef LY_ENABLED_CACHE
+        lys_search_localfile_index(&ctx->models.search_index, ly_ctx_get_searchdirs(ctx),
+                                   !(ctx->models.flags & LY_CTX_DISABLE_SEARCHDIR_CWD), pre->name, pre->revision,
+                                   &pre->filepath, &pre->format);
+#else
+        lys_search_localfile(ly_ctx_get_searchdirs(ctx), !(ctx->models.flags & LY_CTX_DISABLE_SEARCHDIR_CWD), pre->name,
+                             pre->revision, &pre->filepath, &pre->format);
+#endif
+    }
+
+    cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    count = (cpus < 1) ? 1 : (((uint32_t)cpus < set->number) ? (uint32_t)cpus : set->number);
+    pt = calloc(count, sizeof *pt);
+    tids = malloc(count * sizeof *tids);
+    started = calloc(count, sizeof *started);
+    LY_CHECK_ERR_GOTO(!pt || !tids || !started, LOGMEM(ctx), cleanup);
+
+    /* the calling thread reads its own part */
+    for (i = 0; i < count; ++i) {
+        pt[i].ctx = ctx;
+        pt[i].first = i;
+        pt[i].step = count;
+        if (i) {
+            started[i] = pthread_create(&tids[i], NULL, ly_ctx_prefetch_thread, &pt[i]) ? 0 : 1;
+        }
+    }
+    for (i = 0; i < count; ++i) {
+        if (started[i]) {
+            pthread_join(tids[i], NULL);
+        } else {
+            /* our part or a thread could not be created */
+            ly_ctx_prefetch_thread(&pt[i]);
+        }
+    }
+
+cleanup:
+    free(pt);
+    free(tids);
+    free(started);
+}
+
 static int
 ly_ctx_new_yl_legacy(struct ly_ctx *ctx, struct lyd_node *yltree)
 {
@@ -158,13 +375,16 @@ ly_ctx_new_yl_legacy(struct ly_ctx *ctx, struct lyd_node *yltree)
     struct lyd_node *module, *node;
     struct ly_set *set;
     const char *name, *revision;
-    struct ly_set features = {0, 0, {NULL}};
+    struct ly_set features = {0};
     const struct lys_module *mod;
 
     set = lyd_find_path(yltree, "/ietf-yang-library:yang-library/modules-state/module");
     if (!set) {
         return 1;
     }
+    if (ctx->models.flags & LY_CTX_PARALLEL_LOAD) {
+        ly_ctx_prefetch_modules(ctx, set);
+    }
 
     /* process the data tree */
     for (i = 0; i < set->number; ++i) {
@@ -215,7 +435,7 @@ ly_ctx_new_yl_common(const char *search_dir, const char *input, LYD_FORMAT forma
     unsigned int i, u;
     struct lyd_node *module, *node;
     const char *name, *revision;
-    struct ly_set features = {0, 0, {NULL}};
+    struct ly_set features = {0};
     const struct lys_module *mod;
     struct lyd_node *yltree = NULL;
     struct ly_ctx *ctx = NULL;
@@ -244,6 +464,10 @@ ly_ctx_new_yl_common(const char *search_dir, const char *input, LYD_FORMAT forma
             goto error;
         }
     } else {
+        if (options & LY_CTX_PARALLEL_LOAD) {
+            ly_ctx_prefetch_modules(ctx, set);
+        }
+
         /* process the data tree */
         for (i = 0; i < set->number; ++i) {
             module = set->set.d[i];
@@ -263,129 +487,1526 @@ ly_ctx_new_yl_common(const char *search_dir, const char *input, LYD_FORMAT forma
                 }
             }
 
-            /* use the gathered data to load the module */
-            mod = ly_ctx_load_module(ctx, name, revision);
-            if (!mod) {
-                LOGERR(NULL, LY_EINVAL, "Unable to load module specified by yang library data.");
-                goto error;
-            }
+            /* use the gathered data to load the module */
+            mod = ly_ctx_load_module(ctx, name, revision);
+            if (!mod) {
+                LOGERR(NULL, LY_EINVAL, "Unable to load module specified by yang library data.");
+                goto error;
+            }
+
+            /* set features */
+            for (u = 0; u < features.number; u++) {
+                lys_features_enable(mod, ((struct lyd_node_leaf_list*)features.set.d[u])->value_str);
+            }
+        }
+    }
+
+    if (0) {
+        /* skip context destroy in case of success */
+error:
+        if (ctx) {
+            ly_ctx_prefetch_free(ctx);
+        }
+        ly_ctx_destroy(ctx, NULL);
+        ctx = NULL;
+    }
+
+    /* cleanup */
+    if (ctx) {
+        ly_ctx_prefetch_free(ctx);
+    }
+    if (yltree) {
+        /* yang library data tree */
+        lyd_free_withsiblings(yltree);
+    }
+    if (set) {
+        ly_set_free(set);
+    }
+
+    return ctx;
+}
+
+API struct ly_ctx *
+ly_ctx_new_ylpath(const char *search_dir, const char *path, LYD_FORMAT format, int options)
+{
+    return ly_ctx_new_yl_common(search_dir, path, format, options, lyd_parse_path);
+}
+
+API struct ly_ctx *
+ly_ctx_new_ylmem(const char *search_dir, const char *data, LYD_FORMAT format, int options)
+{
+    return ly_ctx_new_yl_common(search_dir, data, format, options, lyd_parse_mem);
+}
+
+/*
+ * Context image, see ly_ctx_print_image(). All the numbers are in the native byte order, the strings
+ * are stored with their length and 2 terminating NULL bytes so that YANG sources can be parsed directly
+ * from the mapped image.
+ *
+ * header: LY_CTX_IMAGE_MAGIC, LY_CTX_IMAGE_BOM, LY_CTX_IMAGE_VERSION, libyang version, module count (uint32_t)
+ * module: flags (uint8_t), source, feature count (uint32_t), feature states (uint8_t each),
+ *         submodule count (uint32_t), submodule sources
+ * source: name, revision (string), format (uint8_t), data (string, empty for internal modules)
+ */
+#define LY_CTX_IMAGE_MAGIC 0x4d49594cU /* "LYIM" */
+#define LY_CTX_IMAGE_BOM 0x01020304U
+#define LY_CTX_IMAGE_VERSION 1
+#define LY_CTX_IMAGE_LYVERSION ((LY_VERSION_MAJOR << 16) | (LY_VERSION_MINOR << 8) | LY_VERSION_MICRO)
+
+#define LY_CTX_IMAGE_IMPLEMENTED 0x01
+#define LY_CTX_IMAGE_DISABLED 0x02
+#define LY_CTX_IMAGE_LATEST 0x04
+
+/* image output, either a file or a memory buffer */
+struct ly_ctx_image_out {
+    int fd;                     /* file descriptor, -1 for the memory buffer */
+    char *buf;
+    size_t len;
+    size_t size;
+};
+
+static int
+ly_ctx_image_write(struct ly_ctx_image_out *out, const void *buf, size_t len)
+{
+    ssize_t r;
+    size_t size;
+    char *mem;
+    int fd = out->fd;
+
+    if (fd == -1) {
+        if (out->len + len > out->size) {
+            for (size = out->size ? out->size : 4096; size < out->len + len; size *= 2);
+            mem = realloc(out->buf, size);
+            if (!mem) {
+                errno = ENOMEM;
+                return 1;
+            }
+            out->buf = mem;
+            out->size = size;
+        }
+        memcpy(out->buf + out->len, buf, len);
+        out->len += len;
+        return 0;
+    }
+
+    while (len) {
+        r = write(fd, buf, len);
+        if (r < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return 1;
+        }
+        buf = (const char *)buf + r;
+        len -= r;
+    }
+    return 0;
+}
+
+static int
+ly_ctx_image_write_u32(struct ly_ctx_image_out *out, uint32_t val)
+{
+    return ly_ctx_image_write(out, &val, sizeof val);
+}
+
+static int
+ly_ctx_image_write_u8(struct ly_ctx_image_out *out, uint8_t val)
+{
+    return ly_ctx_image_write(out, &val, sizeof val);
+}
+
+static int
+ly_ctx_image_write_str(struct ly_ctx_image_out *out, const char *str, size_t len)
+{
+    return ly_ctx_image_write_u32(out, len) || ly_ctx_image_write(out, str, len) || ly_ctx_image_write(out, "\0", 2);
+}
+
+/**
+ * @brief Get the source of a (sub)module to store in an image.
+ *
+ * @param[in] mod (Sub)module.
+ * @param[out] data Source of the (sub)module.
+ * @param[out] len Length of \p data.
+ * @param[out] format Format of \p data.
+ * @return EXIT_SUCCESS or EXIT_FAILURE.
+ */
+static int
+ly_ctx_image_source(const struct lys_module *mod, char **data, size_t *len, LYS_INFORMAT *format)
+{
+    struct ly_ctx *ctx = mod->ctx;
+    struct stat st;
+    size_t flen;
+    ssize_t r;
+    int fd;
+
+    if (!mod->filepath) {
+        /* the printed schema is an equivalent source unless there are any deviations applied */
+        if (mod->deviated || mod->deviation_size) {
+            LOGERR(ctx, LY_EINVAL, "Unable to store the deviated (sub)module \"%s\" without its source file.", mod->name);
+            return EXIT_FAILURE;
+        }
+        if (lys_print_mem(data, mod, LYS_OUT_YANG, NULL, 0, 0)) {
+            return EXIT_FAILURE;
+        }
+        *len = strlen(*data);
+        *format = LYS_IN_YANG;
+        return EXIT_SUCCESS;
+    }
+
+    flen = strlen(mod->filepath);
+    *format = ((flen > 4) && !strcmp(&mod->filepath[flen - 4], ".yin")) ? LYS_IN_YIN : LYS_IN_YANG;
+
+    fd = open(mod->filepath, O_RDONLY);
+    if (fd < 0) {
+        LOGERR(ctx, LY_ESYS, "Opening file \"%s\" failed (%s).", mod->filepath, strerror(errno));
+        return EXIT_FAILURE;
+    }
+    if (fstat(fd, &st) == -1) {
+        LOGERR(ctx, LY_ESYS, "Failed to stat the file \"%s\" (%s).", mod->filepath, strerror(errno));
+        close(fd);
+        return EXIT_FAILURE;
+    }
+    *data = malloc(st.st_size + 1);
+    LY_CHECK_ERR_RETURN(!*data, LOGMEM(ctx); close(fd), EXIT_FAILURE);
+    for (*len = 0; *len < (size_t)st.st_size; *len += r) {
+        r = read(fd, *data + *len, st.st_size - *len);
+        if (r <= 0) {
+            if ((r < 0) && (errno == EINTR)) {
+                r = 0;
+                continue;
+            }
+            LOGERR(ctx, LY_ESYS, "Reading file \"%s\" failed (%s).", mod->filepath, r ? strerror(errno) : "unexpected EOF");
+            free(*data);
+            close(fd);
+            return EXIT_FAILURE;
+        }
+    }
+    (*data)[*len] = '\0';
+    close(fd);
+
+    return EXIT_SUCCESS;
+}
+
+static void
+ly_ctx_image_write_error(struct ly_ctx *ctx, const struct ly_ctx_image_out *out, const char *path)
+{
+    if (out->fd == -1) {
+        LOGMEM(ctx);
+    } else {
+        LOGERR(ctx, LY_ESYS, "Writing into file \"%s\" failed (%s).", path, strerror(errno));
+    }
+}
+
+/**
+ * @brief Store a (sub)module name, revision and source into an image.
+ *
+ * @param[in] out Image output.
+ * @param[in] mod (Sub)module to store.
+ * @param[in] source Whether to store the source, only an empty one is stored otherwise.
+ * @param[in] path Image file path for logging.
+ * @return EXIT_SUCCESS or EXIT_FAILURE.
+ */
+static int
+ly_ctx_image_print_source(struct ly_ctx_image_out *out, const struct lys_module *mod, int source, const char *path)
+{
+    char *data = NULL;
+    size_t len = 0;
+    LYS_INFORMAT format = LYS_IN_UNKNOWN;
+    int r;
+
+    if (source && ly_ctx_image_source(mod, &data, &len, &format)) {
+        return EXIT_FAILURE;
+    }
+
+    r = ly_ctx_image_write_str(out, mod->name, strlen(mod->name))
+            || ly_ctx_image_write_str(out, mod->rev_size ? mod->rev[0].date : "", mod->rev_size ? strlen(mod->rev[0].date) : 0)
+            || ly_ctx_image_write_u8(out, format)
+            || ly_ctx_image_write_str(out, data ? data : "", len);
+    free(data);
+    if (r) {
+        ly_ctx_image_write_error(mod->ctx, out, path);
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Store all the modules of a context with their state into an image.
+ *
+ * @param[in] ctx Context to store.
+ * @param[in] out Image output.
+ * @param[in] path Image file path for logging.
+ * @return EXIT_SUCCESS or EXIT_FAILURE.
+ */
+static int
+ly_ctx_image_print(struct ly_ctx *ctx, struct ly_ctx_image_out *out, const char *path)
+{
+    const struct lys_module *mod;
+    uint8_t flags;
+    uint32_t count;
+    int i, j;
+
+    if (ly_ctx_image_write_u32(out, LY_CTX_IMAGE_MAGIC) || ly_ctx_image_write_u32(out, LY_CTX_IMAGE_BOM)
+            || ly_ctx_image_write_u32(out, LY_CTX_IMAGE_VERSION) || ly_ctx_image_write_u32(out, LY_CTX_IMAGE_LYVERSION)
+            || ly_ctx_image_write_u32(out, ctx->models.used)) {
+        goto write_error;
+    }
+
+    /* modules in the order they were added, the imports always precede the modules importing them */
+    for (i = 0; i < ctx->models.used; ++i) {
+        mod = ctx->models.list[i];
+
+        flags = 0;
+        if (mod->implemented) {
+            flags |= LY_CTX_IMAGE_IMPLEMENTED;
+        }
+        if (mod->disabled) {
+            flags |= LY_CTX_IMAGE_DISABLED;
+        }
+        if (mod->latest_revision) {
+            flags |= LY_CTX_IMAGE_LATEST;
+        }
+        if (ly_ctx_image_write_u8(out, flags)) {
+            goto write_error;
+        }
+        /* the internal modules are always present, only their state is stored */
+        if (ly_ctx_image_print_source(out, mod, (i >= ctx->internal_module_count), path)) {
+            return EXIT_FAILURE;
+        }
+
+        /* feature states in the order of lys_features_list() */
+        count = mod->features_size;
+        for (j = 0; j < mod->inc_size; ++j) {
+            count += mod->inc[j].submodule->features_size;
+        }
+        if (ly_ctx_image_write_u32(out, count)) {
+            goto write_error;
+        }
+        for (j = 0; j < mod->features_size; ++j) {
+            if (ly_ctx_image_write_u8(out, (mod->features[j].flags & LYS_FENABLED) ? 1 : 0)) {
+                goto write_error;
+            }
+        }
+        for (j = 0; j < mod->inc_size; ++j) {
+            for (count = 0; count < mod->inc[j].submodule->features_size; ++count) {
+                if (ly_ctx_image_write_u8(out, (mod->inc[j].submodule->features[count].flags & LYS_FENABLED) ? 1 : 0)) {
+                    goto write_error;
+                }
+            }
+        }
+
+        /* the submodules are stored separately */
+        if (ly_ctx_image_write_u32(out, mod->inc_size)) {
+            goto write_error;
+        }
+        for (j = 0; j < mod->inc_size; ++j) {
+            if (ly_ctx_image_print_source(out, (struct lys_module *)mod->inc[j].submodule, 1, path)) {
+                return EXIT_FAILURE;
+            }
+        }
+    }
+
+    return EXIT_SUCCESS;
+
+write_error:
+    ly_ctx_image_write_error(ctx, out, path);
+    return EXIT_FAILURE;
+}
+
+API int
+ly_ctx_print_image(struct ly_ctx *ctx, const char *path)
+{
+    struct ly_ctx_image_out out;
+    int ret;
+
+    if (!ctx || !path) {
+        LOGARG;
+        return EXIT_FAILURE;
+    }
+
+    memset(&out, 0, sizeof out);
+    out.fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 00644);
+    if (out.fd < 0) {
+        LOGERR(ctx, LY_ESYS, "Creating file \"%s\" failed (%s).", path, strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    ret = ly_ctx_image_print(ctx, &out, path);
+    close(out.fd);
+    if (ret) {
+        unlink(path);
+    }
+    return ret;
+}
+
+struct ly_ctx_image_src {
+    const char *name;
+    const char *revision;       /* NULL if none */
+    LYS_INFORMAT format;
+    const char *data;
+};
+
+struct ly_ctx_image_mod {
+    uint8_t flags;
+    struct ly_ctx_image_src src;
+    uint32_t feature_count;
+    const uint8_t *features;
+    uint32_t inc_count;
+    struct ly_ctx_image_src *inc;
+};
+
+struct ly_ctx_image {
+    const char *cur;            /* parser position */
+    const char *end;
+    uint32_t count;
+    struct ly_ctx_image_mod *mods;
+};
+
+static int
+ly_ctx_image_read(struct ly_ctx_image *image, void *buf, size_t len)
+{
+    if ((size_t)(image->end - image->cur) < len) {
+        return 1;
+    }
+    memcpy(buf, image->cur, len);
+    image->cur += len;
+    return 0;
+}
+
+static int
+ly_ctx_image_read_str(struct ly_ctx_image *image, const char **str)
+{
+    uint32_t len;
+
+    if (ly_ctx_image_read(image, &len, sizeof len) || ((size_t)(image->end - image->cur) < (size_t)len + 2)
+            || image->cur[len] || image->cur[len + 1]) {
+        return 1;
+    }
+    *str = image->cur;
+    image->cur += len + 2;
+    return 0;
+}
+
+static int
+ly_ctx_image_read_src(struct ly_ctx_image *image, struct ly_ctx_image_src *src)
+{
+    uint8_t format;
+
+    if (ly_ctx_image_read_str(image, &src->name) || ly_ctx_image_read_str(image, &src->revision)
+            || ly_ctx_image_read(image, &format, sizeof format) || ly_ctx_image_read_str(image, &src->data)) {
+        return 1;
+    }
+    if (!src->revision[0]) {
+        src->revision = NULL;
+    }
+    src->format = format;
+    return 0;
+}
+
+/**
+ * @brief Parse the mapped image into the module records, the strings point into the mapped memory.
+ *
+ * @param[in] ctx Context for logging.
+ * @param[in] image Image to fill, with the data range set.
+ * @param[in] path Image file path for logging.
+ * @return EXIT_SUCCESS or EXIT_FAILURE.
+ */
+static int
+ly_ctx_image_parse(struct ly_ctx *ctx, struct ly_ctx_image *image, const char *path)
+{
+    uint32_t header[5], i, j;
+    struct ly_ctx_image_mod *mod;
+
+    if (ly_ctx_image_read(image, header, sizeof header) || (header[0] != LY_CTX_IMAGE_MAGIC)) {
+        LOGERR(ctx, LY_EINVAL, "File \"%s\" is not a context image.", path);
+        return EXIT_FAILURE;
+    }
+    if ((header[1] != LY_CTX_IMAGE_BOM) || (header[2] != LY_CTX_IMAGE_VERSION) || (header[3] != LY_CTX_IMAGE_LYVERSION)) {
+        LOGERR(ctx, LY_EINVAL, "Context image \"%s\" was created by an incompatible libyang version.", path);
+        return EXIT_FAILURE;
+    }
+    if (header[4] > (size_t)(image->end - image->cur)) {
+        goto invalid;
+    }
+
+    image->mods = calloc(header[4], sizeof *image->mods);
+    LY_CHECK_ERR_RETURN(header[4] && !image->mods, LOGMEM(ctx), EXIT_FAILURE);
+    for (i = 0; i < header[4]; ++i) {
+        mod = &image->mods[i];
+        ++image->count;
+
+        if (ly_ctx_image_read(image, &mod->flags, sizeof mod->flags) || ly_ctx_image_read_src(image, &mod->src)
+                || ly_ctx_image_read(image, &mod->feature_count, sizeof mod->feature_count)
+                || ((size_t)(image->end - image->cur) < mod->feature_count)) {
+            goto invalid;
+        }
+        mod->features = (const uint8_t *)image->cur;
+        image->cur += mod->feature_count;
+
+        if (ly_ctx_image_read(image, &mod->inc_count, sizeof mod->inc_count)
+                || (mod->inc_count > (size_t)(image->end - image->cur))) {
+            goto invalid;
+        }
+        if (mod->inc_count) {
+            mod->inc = calloc(mod->inc_count, sizeof *mod->inc);
+            LY_CHECK_ERR_RETURN(!mod->inc, LOGMEM(ctx), EXIT_FAILURE);
+        }
+        for (j = 0; j < mod->inc_count; ++j) {
+            if (ly_ctx_image_read_src(image, &mod->inc[j])) {
+                goto invalid;
+            }
+        }
+    }
+
+    return EXIT_SUCCESS;
+
+invalid:
+    LOGERR(ctx, LY_EINVAL, "Context image \"%s\" is corrupted.", path);
+    return EXIT_FAILURE;
+}
+
+static int
+ly_ctx_image_src_match(const struct ly_ctx_image_src *src, const char *name, const char *revision)
+{
+    return !strcmp(src->name, name) && (!revision || (src->revision && !strcmp(src->revision, revision)));
+}
+
+/* import callback serving the (sub)modules stored in the image */
+static const char *
+ly_ctx_image_imp_clb(const char *mod_name, const char *mod_rev, const char *submod_name, const char *sub_rev,
+                     void *user_data, LYS_INFORMAT *format, void (**free_module_data)(void *model_data, void *user_data))
+{
+    struct ly_ctx_image *image = (struct ly_ctx_image *)user_data;
+    struct ly_ctx_image_mod *mod, *match = NULL;
+    uint32_t i, j;
+
+    *free_module_data = NULL;
+    for (i = 0; i < image->count; ++i) {
+        mod = &image->mods[i];
+        if (!ly_ctx_image_src_match(&mod->src, mod_name, submod_name ? NULL : mod_rev)) {
+            continue;
+        }
+
+        if (!submod_name) {
+            if (mod->src.format == LYS_IN_UNKNOWN) {
+                continue;
+            }
+            /* without a revision, prefer the module found as the latest revision originally */
+            if (!match || (mod->flags & LY_CTX_IMAGE_LATEST)) {
+                match = mod;
+            }
+            continue;
+        }
+        for (j = 0; j < mod->inc_count; ++j) {
+            if (ly_ctx_image_src_match(&mod->inc[j], submod_name, sub_rev)) {
+                *format = mod->inc[j].format;
+                return mod->inc[j].data;
+            }
+        }
+    }
+
+    if (match) {
+        *format = match->src.format;
+        return match->src.data;
+    }
+    return NULL;
+}
+
+/* restore the feature states of a module, see ly_ctx_print_image() */
+static int
+ly_ctx_image_features(struct lys_module *mod, const struct ly_ctx_image_mod *rec)
+{
+    struct lys_feature *f;
+    uint32_t i = 0;
+    uint8_t fsize;
+    int j, k;
+
+    lys_features_changed(mod->ctx);
+    for (j = -1; j < mod->inc_size; ++j) {
+        if (j == -1) {
+            fsize = mod->features_size;
+            f = mod->features;
+        } else {
+            fsize = mod->inc[j].submodule->features_size;
+            f = mod->inc[j].submodule->features;
+        }
+        for (k = 0; k < fsize; ++k, ++i) {
+            if (i == rec->feature_count) {
+                return EXIT_FAILURE;
+            }
+            if (rec->features[i]) {
+                f[k].flags |= LYS_FENABLED;
+            } else {
+                f[k].flags &= ~LYS_FENABLED;
+            }
+        }
+    }
+
+    return (i == rec->feature_count) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/**
+ * @brief Load all the modules stored in an image into a context and restore their state.
+ *
+ * @param[in] ctx Context to load into.
+ * @param[in] data Image data.
+ * @param[in] len Length of \p data.
+ * @param[in] path Image file path for logging.
+ * @return EXIT_SUCCESS or EXIT_FAILURE.
+ */
+static int
+ly_ctx_image_load(struct ly_ctx *ctx, const char *data, size_t len, const char *path)
+{
+    struct ly_ctx_image image;
+    struct ly_ctx_image_mod *rec;
+    struct lys_module *mod;
+    ly_module_imp_clb imp_clb;
+    void *imp_clb_data;
+    uint32_t i;
+    int ret = EXIT_FAILURE;
+
+    memset(&image, 0, sizeof image);
+    image.cur = data;
+    image.end = data + (data ? len : 0);
+    if (ly_ctx_image_parse(ctx, &image, path)) {
+        goto cleanup;
+    }
+
+    /* the imported modules and the submodules are taken from the image as well */
+    imp_clb = ctx->imp_clb;
+    imp_clb_data = ctx->imp_clb_data;
+    ctx->imp_clb = ly_ctx_image_imp_clb;
+    ctx->imp_clb_data = &image;
+
+    for (i = 0; i < image.count; ++i) {
+        rec = &image.mods[i];
+        mod = (struct lys_module *)ly_ctx_get_module(ctx, rec->src.name, rec->src.revision, 0);
+        if (!mod) {
+            if (rec->src.format == LYS_IN_UNKNOWN) {
+                LOGERR(ctx, LY_EINVAL, "Context image \"%s\" was created with a different internal module \"%s\".",
+                       path, rec->src.name);
+                break;
+            }
+            /* the data are terminated by 2 NULL bytes so they can be parsed in place */
+            mod = (struct lys_module *)lys_parse_mem_(ctx, rec->src.data, rec->src.format, rec->src.revision, 1,
+                                                      rec->flags & LY_CTX_IMAGE_IMPLEMENTED);
+            if (!mod) {
+                break;
+            }
+        } else if ((rec->flags & LY_CTX_IMAGE_IMPLEMENTED) && !mod->implemented && lys_set_implemented(mod)) {
+            break;
+        }
+        /* the imports without a revision must be resolved to the same modules */
+        if (rec->flags & LY_CTX_IMAGE_LATEST) {
+            mod->latest_revision = 1;
+        }
+    }
+    ctx->imp_clb = imp_clb;
+    ctx->imp_clb_data = imp_clb_data;
+    if (i < image.count) {
+        LOGERR(ctx, LY_EINVAL, "Unable to load module \"%s\" from context image \"%s\".", image.mods[i].src.name, path);
+        goto cleanup;
+    }
+
+    /* all the modules are loaded, restore their state */
+    for (i = 0; i < image.count; ++i) {
+        rec = &image.mods[i];
+        mod = (struct lys_module *)ly_ctx_get_module(ctx, rec->src.name, rec->src.revision, 0);
+        if (!mod || ly_ctx_image_features(mod, rec)) {
+            LOGERR(ctx, LY_EINVAL, "Module \"%s\" does not match context image \"%s\".", rec->src.name, path);
+            goto cleanup;
+        }
+    }
+    for (i = image.count; i > 0; --i) {
+        /* the importing modules first, disabling a module disables also its unused imports */
+        rec = &image.mods[i - 1];
+        if (rec->flags & LY_CTX_IMAGE_DISABLED) {
+            mod = (struct lys_module *)ly_ctx_get_module(ctx, rec->src.name, rec->src.revision, 0);
+            if (mod) {
+                lys_set_disabled(mod);
+            }
+        }
+    }
+    ret = EXIT_SUCCESS;
+
+cleanup:
+    for (i = 0; i < image.count; ++i) {
+        free(image.mods[i].inc);
+    }
+    free(image.mods);
+    return ret;
+}
+
+API struct ly_ctx *
+ly_ctx_new_image(const char *search_dir, const char *path, int options)
+{
+    struct ly_ctx *ctx;
+    void *addr = NULL;
+    size_t length = 0;
+    struct stat st;
+    int fd;
+
+    if (!path) {
+        LOGARG;
+        return NULL;
+    }
+
+    ctx = ly_ctx_new(search_dir, options);
+    if (!ctx) {
+        return NULL;
+    }
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        LOGERR(ctx, LY_ESYS, "Opening file \"%s\" failed (%s).", path, strerror(errno));
+        goto error;
+    }
+    if (fstat(fd, &st) == -1) {
+        LOGERR(ctx, LY_ESYS, "Failed to stat the file \"%s\" (%s).", path, strerror(errno));
+        close(fd);
+        goto error;
+    }
+    if (lyp_mmap(ctx, fd, 0, &length, &addr)) {
+        close(fd);
+        goto error;
+    }
+    close(fd);
+    if (ly_ctx_image_load(ctx, addr, st.st_size, path)) {
+        goto error;
+    }
+
+    if (0) {
+error:
+        ly_ctx_destroy(ctx, NULL);
+        ctx = NULL;
+    }
+    if (addr) {
+        lyp_munmap(addr, length);
+    }
+    return ctx;
+}
+
+API struct ly_ctx *
+ly_ctx_clone(struct ly_ctx *ctx)
+{
+    struct ly_ctx *clone;
+    struct ly_ctx_image_out out;
+    const char * const *dirs;
+    int i;
+
+    if (!ctx) {
+        LOGARG;
+        return NULL;
+    }
+
+    /* the internal modules are loaded with the same options, the dictionary is shared */
+    clone = ly_ctx_new_dict(NULL, ctx->models.flags, ctx->dict);
+    if (!clone) {
+        return NULL;
+    }
+    dirs = ly_ctx_get_searchdirs(ctx);
+    for (i = 0; dirs && dirs[i]; ++i) {
+        if (ly_ctx_set_searchdir(clone, dirs[i])) {
+            goto error;
+        }
+    }
+    clone->imp_clb = ctx->imp_clb;
+    clone->imp_clb_data = ctx->imp_clb_data;
+    clone->data_clb = ctx->data_clb;
+    clone->data_clb_data = ctx->data_clb_data;
+#ifdef LY_ENABLED_LYD_PRIV
+    clone->priv_dup_clb = ctx->priv_dup_clb;
+#endif
+    clone->val_threads = ctx->val_threads;
+    clone->print_threads = ctx->print_threads;
+    clone->free_threads = ctx->free_threads;
+    clone->xpath_threads = ctx->xpath_threads;
+    clone->private_vals = ctx->private_vals;
+    clone->data_ht_threshold = ctx->data_ht_threshold;
+    clone->data_alloc = ctx->data_alloc;
+    clone->data_free = ctx->data_free;
+    clone->data_alloc_data = ctx->data_alloc_data;
+
+    /* the modules are rebuilt from their sources, the strings are already in the dictionary */
+    memset(&out, 0, sizeof out);
+    out.fd = -1;
+    if (ly_ctx_image_print(ctx, &out, NULL) || ly_ctx_image_load(clone, out.buf, out.len, "<clone>")) {
+        free(out.buf);
+        goto error;
+    }
+    free(out.buf);
+
+    return clone;
+
+error:
+    ly_ctx_destroy(clone, NULL);
+    return NULL;
+}
+
+static void
+ly_ctx_set_option(struct ly_ctx *ctx, int options)
+{
+    if (!ctx) {
+        return;
+    }
+
+    ctx->models.flags |= options;
+}
+
+static void
+ly_ctx_unset_option(struct ly_ctx *ctx, int options)
+{
+    if (!ctx) {
+        return;
+    }
+
+    ctx->models.flags &= ~options;
+}
+
+API void
+ly_ctx_set_disable_searchdirs(struct ly_ctx *ctx)
+{
+    ly_ctx_set_option(ctx, LY_CTX_DISABLE_SEARCHDIRS);
+}
+
+API void
+ly_ctx_unset_disable_searchdirs(struct ly_ctx *ctx)
+{
+    ly_ctx_unset_option(ctx, LY_CTX_DISABLE_SEARCHDIRS);
+}
+
+API void
+ly_ctx_set_disable_searchdir_cwd(struct ly_ctx *ctx)
+{
+    ly_ctx_set_option(ctx, LY_CTX_DISABLE_SEARCHDIR_CWD);
+}
+
+API void
+ly_ctx_unset_disable_searchdir_cwd(struct ly_ctx *ctx)
+{
+    ly_ctx_unset_option(ctx, LY_CTX_DISABLE_SEARCHDIR_CWD);
+}
+
+API void
+ly_ctx_set_prefer_searchdirs(struct ly_ctx *ctx)
+{
+    ly_ctx_set_option(ctx, LY_CTX_PREFER_SEARCHDIRS);
+}
+
+API void
+ly_ctx_unset_prefer_searchdirs(struct ly_ctx *ctx)
+{
+    ly_ctx_unset_option(ctx, LY_CTX_PREFER_SEARCHDIRS);
+}
+
+API void
+ly_ctx_set_allimplemented(struct ly_ctx *ctx)
+{
+    ly_ctx_set_option(ctx, LY_CTX_ALLIMPLEMENTED);
+}
+
+API void
+ly_ctx_unset_allimplemented(struct ly_ctx *ctx)
+{
+    ly_ctx_unset_option(ctx, LY_CTX_ALLIMPLEMENTED);
+}
+
+API void
+ly_ctx_set_trusted(struct ly_ctx *ctx)
+{
+    ly_ctx_set_option(ctx, LY_CTX_TRUSTED);
+}
+
+API void
+ly_ctx_unset_trusted(struct ly_ctx *ctx)
+{
+    ly_ctx_unset_option(ctx, LY_CTX_TRUSTED);
+}
+
+API void
+ly_ctx_set_validation_threads(struct ly_ctx *ctx, uint16_t threads)
+{
+    if (!ctx) {
+        return;
+    }
+
+    ctx->val_threads = threads;
+}
+
+API uint16_t
+ly_ctx_get_validation_threads(const struct ly_ctx *ctx)
+{
+    if (!ctx) {
+        LOGARG;
+        return 0;
+    }
+
+    return ctx->val_threads;
+}
+
+API void
+ly_ctx_set_data_hash_threshold(struct ly_ctx *ctx, uint16_t children)
+{
+    if (!ctx) {
+        return;
+    }
+
+    ctx->data_ht_threshold = children;
+}
+
+API uint16_t
+ly_ctx_get_data_hash_threshold(const struct ly_ctx *ctx)
+{
+    if (!ctx) {
+        LOGARG;
+        return 0;
+    }
+
+    return ctx->data_ht_threshold;
+}
+
+API int
+ly_ctx_set_data_allocator(struct ly_ctx *ctx, ly_data_alloc_clb alloc_clb, ly_data_free_clb free_clb, void *user_data)
+{
+    if (!ctx || (!alloc_clb != !free_clb)) {
+        LOGARG;
+        return EXIT_FAILURE;
+    }
+
+    ctx->data_alloc = alloc_clb;
+    ctx->data_free = free_clb;
+    ctx->data_alloc_data = user_data;
+    return EXIT_SUCCESS;
+}
+
+API void
+ly_ctx_set_free_threads(struct ly_ctx *ctx, uint16_t threads)
+{
+    if (!ctx) {
+        return;
+    }
+
+    ctx->free_threads = threads;
+}
+
+API uint16_t
+ly_ctx_get_free_threads(const struct ly_ctx *ctx)
+{
+    if (!ctx) {
+        LOGARG;
+        return 0;
+    }
+
+    return ctx->free_threads;
+}
+
+API void
+ly_ctx_set_xpath_threads(struct ly_ctx *ctx, uint16_t threads)
+{
+    if (!ctx) {
+        return;
+    }
+
+    ctx->xpath_threads = threads;
+}
+
+API uint16_t
+ly_ctx_get_xpath_threads(const struct ly_ctx *ctx)
+{
+    if (!ctx) {
+        LOGARG;
+        return 0;
+    }
+
+    return ctx->xpath_threads;
+}
+
+API void
+ly_ctx_set_private_values(struct ly_ctx *ctx, int types)
+{
+    if (!ctx) {
+        return;
+    }
+
+    ctx->private_vals = types & (LY_PRIVVAL_NUMBERS | LY_PRIVVAL_USER);
+}
+
+API int
+ly_ctx_get_private_values(const struct ly_ctx *ctx)
+{
+    if (!ctx) {
+        LOGARG;
+        return 0;
+    }
+
+    return ctx->private_vals;
+}
+
+API void
+ly_ctx_set_print_threads(struct ly_ctx *ctx, uint16_t threads)
+{
+    if (!ctx) {
+        return;
+    }
+
+    ctx->print_threads = threads;
+}
+
+API uint16_t
+ly_ctx_get_print_threads(const struct ly_ctx *ctx)
+{
+    if (!ctx) {
+        LOGARG;
+        return 0;
+    }
+
+    return ctx->print_threads;
+}
+
+static int
+ly_val_prof_val_equal(void *val1_p, void *val2_p, int UNUSED(mod), void *UNUSED(cb_data))
+{
+    struct ly_val_prof *val1 = val1_p, *val2 = val2_p;
+
+    /* the expressions are in the dictionary */
+    return (val1->type == val2->type) && (val1->node == val2->node) && (val1->expr == val2->expr);
+}
+
+static uint32_t
+ly_val_prof_hash(const struct ly_val_prof *prof)
+{
+    uint32_t hash;
+
+    hash = dict_hash_multi(0, (const char *)&prof->type, sizeof prof->type);
+    hash = dict_hash_multi(hash, (const char *)&prof->node, sizeof prof->node);
+    hash = dict_hash_multi(hash, (const char *)&prof->expr, sizeof prof->expr);
+    return dict_hash_multi(hash, NULL, 0);
+}
+
+void
+ly_val_prof_start(const struct ly_ctx *ctx, struct timespec *start)
+{
+    if (ctx->val_prof) {
+        clock_gettime(CLOCK_MONOTONIC, start);
+    } else {
+        start->tv_sec = 0;
+        start->tv_nsec = 0;
+    }
+}
+
+void
+ly_val_prof_add(struct ly_ctx *ctx, const struct timespec *start, LY_VAL_PROF_TYPE type,
+                const struct lys_node *node, const char *expr, uint32_t nodes)
+{
+    struct timespec end;
+    struct ly_val_prof rec, *found;
+    uint32_t hash;
+
+    if (!start->tv_sec && !start->tv_nsec) {
+        /* not timed */
+        return;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    memset(&rec, 0, sizeof rec);
+    rec.type = type;
+    rec.node = node;
+    rec.expr = expr;
+    hash = ly_val_prof_hash(&rec);
+
+    pthread_mutex_lock(&ctx->val_prof_lock);
+
+    if (!ctx->val_prof_ht) {
+        ctx->val_prof_ht = lyht_new(32, sizeof rec, ly_val_prof_val_equal, NULL, 1);
+        LY_CHECK_ERR_GOTO(!ctx->val_prof_ht, LOGMEM(ctx), cleanup);
+    }
+
+    if (lyht_find(ctx->val_prof_ht, &rec, hash, (void **)&found)) {
+        /* first evaluation, keep the expression even if the schema node changes */
+        rec.expr = expr ? lydict_insert(ctx, expr, 0) : NULL;
+        if (lyht_insert(ctx->val_prof_ht, &rec, hash, (void **)&found)) {
+            LOGMEM(ctx);
+            lydict_remove(ctx, rec.expr);
+            goto cleanup;
+        }
+    }
+
+    ++found->count;
+    found->time += (uint64_t)(end.tv_sec - start->tv_sec) * 1000000000 + end.tv_nsec - start->tv_nsec;
+    found->nodes += nodes;
+    if (nodes > found->max_nodes) {
+        found->max_nodes = nodes;
+    }
+
+cleanup:
+    pthread_mutex_unlock(&ctx->val_prof_lock);
+}
+
+API void
+ly_ctx_set_val_profiling(struct ly_ctx *ctx, int enable)
+{
+    if (!ctx) {
+        return;
+    }
+
+    ctx->val_prof = enable ? 1 : 0;
+}
+
+API int
+ly_ctx_get_val_profiling(const struct ly_ctx *ctx)
+{
+    if (!ctx) {
+        LOGARG;
+        return 0;
+    }
+
+    return ctx->val_prof;
+}
+
+static int
+ly_val_prof_cmp(const void *ptr1, const void *ptr2)
+{
+    const struct ly_val_prof *prof1 = ptr1, *prof2 = ptr2;
+
+    if (prof1->time != prof2->time) {
+        return (prof1->time < prof2->time) ? 1 : -1;
+    }
+    return (prof1->count < prof2->count) ? 1 : (prof1->count > prof2->count) ? -1 : 0;
+}
+
+API struct ly_val_prof *
+ly_ctx_get_val_profile(struct ly_ctx *ctx, uint32_t *count)
+{
+    struct ht_rec *ht_rec;
+    struct ly_val_prof *profs = NULL;
+    uint32_t i;
+
+    if (!ctx || !count) {
+        LOGARG;
+        return NULL;
+    }
+
+    *count = 0;
+    pthread_mutex_lock(&ctx->val_prof_lock);
+
+    if (!ctx->val_prof_ht || !ctx->val_prof_ht->used) {
+        goto cleanup;
+    }
+
+    profs = malloc(ctx->val_prof_ht->used * sizeof *profs);
+    LY_CHECK_ERR_GOTO(!profs, LOGMEM(ctx), cleanup);
+
+    for (i = 0; i < ctx->val_prof_ht->size; ++i) {
+        if (ctx->val_prof_ht->ctrl[i] & LYHT_CTRL_FULL) {
+            ht_rec = lyht_get_rec(ctx->val_prof_ht->recs, ctx->val_prof_ht->rec_size, i);
+            memcpy(&profs[*count], ht_rec->val, sizeof *profs);
+            ++(*count);
+        }
+    }
+    qsort(profs, *count, sizeof *profs, ly_val_prof_cmp);
+
+cleanup:
+    pthread_mutex_unlock(&ctx->val_prof_lock);
+    return profs;
+}
+
+API void
+ly_ctx_clean_val_profile(struct ly_ctx *ctx)
+{
+    struct ht_rec *ht_rec;
+    struct ly_val_prof *prof;
+    uint32_t i;
+
+    if (!ctx) {
+        return;
+    }
 
-            /* set features */
-            for (u = 0; u < features.number; u++) {
-                lys_features_enable(mod, ((struct lyd_node_leaf_list*)features.set.d[u])->value_str);
+    pthread_mutex_lock(&ctx->val_prof_lock);
+
+    if (ctx->val_prof_ht) {
+        for (i = 0; i < ctx->val_prof_ht->size; ++i) {
+            if (ctx->val_prof_ht->ctrl[i] & LYHT_CTRL_FULL) {
+                ht_rec = lyht_get_rec(ctx->val_prof_ht->recs, ctx->val_prof_ht->rec_size, i);
+                prof = (struct ly_val_prof *)ht_rec->val;
+                lydict_remove(ctx, prof->expr);
             }
         }
+        lyht_free(ctx->val_prof_ht);
+        ctx->val_prof_ht = NULL;
     }
 
-    if (0) {
-        /* skip context destroy in case of success */
-error:
-        ly_ctx_destroy(ctx, NULL);
-        ctx = NULL;
-    }
+    pthread_mutex_unlock(&ctx->val_prof_lock);
+}
 
-    /* cleanup */
-    if (yltree) {
-        /* yang library data tree */
-        lyd_free_withsiblings(yltree);
-    }
-    if (set) {
-        ly_set_free(set);
+static void
+ly_plugin_stats_clear(struct ly_ctx *ctx)
+{
+    struct ht_rec *ht_rec;
+    struct ly_plugin_stats *stats;
+    uint32_t i;
+
+    pthread_mutex_lock(&ctx->plugin_stats_lock);
+
+    if (ctx->plugin_stats_ht) {
+        for (i = 0; i < ctx->plugin_stats_ht->size; ++i) {
+            if (ctx->plugin_stats_ht->ctrl[i] & LYHT_CTRL_FULL) {
+                ht_rec = lyht_get_rec(ctx->plugin_stats_ht->recs, ctx->plugin_stats_ht->rec_size, i);
+                stats = (struct ly_plugin_stats *)ht_rec->val;
+                lydict_remove(ctx, stats->module);
+                lydict_remove(ctx, stats->name);
+            }
+        }
+        lyht_free(ctx->plugin_stats_ht);
+        ctx->plugin_stats_ht = NULL;
     }
 
-    return ctx;
+    pthread_mutex_unlock(&ctx->plugin_stats_lock);
 }
 
-API struct ly_ctx *
-ly_ctx_new_ylpath(const char *search_dir, const char *path, LYD_FORMAT format, int options)
+API void
+ly_ctx_set_stats(struct ly_ctx *ctx, int enable)
 {
-    return ly_ctx_new_yl_common(search_dir, path, format, options, lyd_parse_path);
+    if (!ctx) {
+        return;
+    }
+
+    ctx->stats_on = enable ? 1 : 0;
 }
 
-API struct ly_ctx *
-ly_ctx_new_ylmem(const char *search_dir, const char *data, LYD_FORMAT format, int options)
+API int
+ly_ctx_get_stats(struct ly_ctx *ctx, struct ly_ctx_stats *stats)
 {
-    return ly_ctx_new_yl_common(search_dir, data, format, options, lyd_parse_mem);
+    if (!ctx || !stats) {
+        LOGARG;
+        return EXIT_FAILURE;
+    }
+
+    stats->parse_calls = atomic_load_explicit(&ctx->stats.parse_calls, memory_order_relaxed);
+    stats->parse_bytes = atomic_load_explicit(&ctx->stats.parse_bytes, memory_order_relaxed);
+    stats->nodes_created = atomic_load_explicit(&ctx->stats.nodes_created, memory_order_relaxed);
+    stats->nodes_freed = atomic_load_explicit(&ctx->stats.nodes_freed, memory_order_relaxed);
+    stats->dict_strings = lydict_count(ctx->dict);
+    stats->dict_inserts = atomic_load_explicit(&ctx->stats.dict_inserts, memory_order_relaxed);
+    stats->dict_hits = atomic_load_explicit(&ctx->stats.dict_hits, memory_order_relaxed);
+    stats->dict_lock_waits = atomic_load_explicit(&ctx->stats.dict_lock_waits, memory_order_relaxed);
+    stats->ht_probes = atomic_load_explicit(&ctx->stats.ht_probes, memory_order_relaxed);
+    stats->ht_resizes = atomic_load_explicit(&ctx->stats.ht_resizes, memory_order_relaxed);
+    stats->xpath_evals = atomic_load_explicit(&ctx->stats.xpath_evals, memory_order_relaxed);
+    stats->xpath_nodes = atomic_load_explicit(&ctx->stats.xpath_nodes, memory_order_relaxed);
+    stats->must_evals = atomic_load_explicit(&ctx->stats.must_evals, memory_order_relaxed);
+    stats->when_evals = atomic_load_explicit(&ctx->stats.when_evals, memory_order_relaxed);
+    stats->leafref_evals = atomic_load_explicit(&ctx->stats.leafref_evals, memory_order_relaxed);
+    stats->val_time = atomic_load_explicit(&ctx->stats.val_time, memory_order_relaxed);
+    stats->schema_loads = atomic_load_explicit(&ctx->stats.schema_loads, memory_order_relaxed);
+    stats->schema_parse_time = atomic_load_explicit(&ctx->stats.schema_parse_time, memory_order_relaxed);
+    stats->schema_unres_time = atomic_load_explicit(&ctx->stats.schema_unres_time, memory_order_relaxed);
+    stats->schema_augdev_time = atomic_load_explicit(&ctx->stats.schema_augdev_time, memory_order_relaxed);
+    stats->schema_patterns = atomic_load_explicit(&ctx->stats.schema_patterns, memory_order_relaxed);
+    stats->schema_pattern_time = atomic_load_explicit(&ctx->stats.schema_pattern_time, memory_order_relaxed);
+
+    return EXIT_SUCCESS;
 }
 
-static void
-ly_ctx_set_option(struct ly_ctx *ctx, int options)
+API void
+ly_ctx_clean_binary(struct ly_ctx *ctx)
 {
     if (!ctx) {
+        LOGARG;
         return;
     }
 
-    ctx->models.flags |= options;
+    lyd_binary_clear(ctx);
 }
 
-static void
-ly_ctx_unset_option(struct ly_ctx *ctx, int options)
+API void
+ly_ctx_clean_stats(struct ly_ctx *ctx)
 {
+    atomic_uint_least64_t *counter;
+
     if (!ctx) {
         return;
     }
 
-    ctx->models.flags &= ~options;
+    for (counter = (atomic_uint_least64_t *)&ctx->stats; counter < (atomic_uint_least64_t *)(&ctx->stats + 1); ++counter) {
+        atomic_store_explicit(counter, 0, memory_order_relaxed);
+    }
+    ly_plugin_stats_clear(ctx);
 }
 
-API void
-ly_ctx_set_disable_searchdirs(struct ly_ctx *ctx)
+static int
+ly_plugin_stats_val_equal(void *val1_p, void *val2_p, int UNUSED(mod), void *UNUSED(cb_data))
 {
-    ly_ctx_set_option(ctx, LY_CTX_DISABLE_SEARCHDIRS);
+    struct ly_plugin_stats *val1 = val1_p, *val2 = val2_p;
+
+    /* the names are in the dictionary */
+    return (val1->clb == val2->clb) && (val1->module == val2->module) && (val1->name == val2->name);
 }
 
-API void
-ly_ctx_unset_disable_searchdirs(struct ly_ctx *ctx)
+void
+ly_plugin_stats_start(const struct ly_ctx *ctx, struct timespec *start)
 {
-    ly_ctx_unset_option(ctx, LY_CTX_DISABLE_SEARCHDIRS);
+    if (ctx->stats_on) {
+        clock_gettime(CLOCK_MONOTONIC, start);
+    } else {
+        start->tv_sec = 0;
+        start->tv_nsec = 0;
+    }
 }
 
-API void
-ly_ctx_set_disable_searchdir_cwd(struct ly_ctx *ctx)
+void
+ly_plugin_stats_add(struct ly_ctx *ctx, const struct timespec *start, LY_PLUGIN_CLB clb, const char *module,
+                    const char *name)
 {
-    ly_ctx_set_option(ctx, LY_CTX_DISABLE_SEARCHDIR_CWD);
+    struct timespec end;
+    struct ly_plugin_stats rec, *found;
+    uint32_t hash;
+
+    if (!start->tv_sec && !start->tv_nsec) {
+        /* not timed */
+        return;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    memset(&rec, 0, sizeof rec);
+    rec.clb = clb;
+    rec.module = module;
+    rec.name = name;
+    hash = dict_hash_multi(0, (const char *)&rec.clb, sizeof rec.clb);
+    hash = dict_hash_multi(hash, (const char *)&rec.module, sizeof rec.module);
+    hash = dict_hash_multi(hash, (const char *)&rec.name, sizeof rec.name);
+    hash = dict_hash_multi(hash, NULL, 0);
+
+    pthread_mutex_lock(&ctx->plugin_stats_lock);
+
+    if (!ctx->plugin_stats_ht) {
+        ctx->plugin_stats_ht = lyht_new(16, sizeof rec, ly_plugin_stats_val_equal, NULL, 1);
+        LY_CHECK_ERR_GOTO(!ctx->plugin_stats_ht, LOGMEM(ctx), cleanup);
+    }
+
+    if (lyht_find(ctx->plugin_stats_ht, &rec, hash, (void **)&found)) {
+        /* first call, keep the names even if the module is removed */
+        rec.module = lydict_insert(ctx, module, 0);
+        rec.name = lydict_insert(ctx, name, 0);
+        if (lyht_insert(ctx->plugin_stats_ht, &rec, hash, (void **)&found)) {
+            LOGMEM(ctx);
+            lydict_remove(ctx, rec.module);
+            lydict_remove(ctx, rec.name);
+            goto cleanup;
+        }
+    }
+
+    ++found->count;
+    found->time += (uint64_t)(end.tv_sec - start->tv_sec) * 1000000000 + end.tv_nsec - start->tv_nsec;
+
+cleanup:
+    pthread_mutex_unlock(&ctx->plugin_stats_lock);
 }
 
-API void
-ly_ctx_unset_disable_searchdir_cwd(struct ly_ctx *ctx)
+static int
+ly_plugin_stats_cmp(const void *ptr1, const void *ptr2)
 {
-    ly_ctx_unset_option(ctx, LY_CTX_DISABLE_SEARCHDIR_CWD);
+    const struct ly_plugin_stats *stats1 = ptr1, *stats2 = ptr2;
+
+    if (stats1->time != stats2->time) {
+        return (stats1->time < stats2->time) ? 1 : -1;
+    }
+    return (stats1->count < stats2->count) ? 1 : (stats1->count > stats2->count) ? -1 : 0;
 }
 
-API void
-ly_ctx_set_prefer_searchdirs(struct ly_ctx *ctx)
+API struct ly_plugin_stats *
+ly_ctx_get_plugin_stats(struct ly_ctx *ctx, uint32_t *count)
 {
-    ly_ctx_set_option(ctx, LY_CTX_PREFER_SEARCHDIRS);
+    struct ht_rec *ht_rec;
+    struct ly_plugin_stats *stats = NULL;
+    uint32_t i;
+
+    if (!ctx || !count) {
+        LOGARG;
+        return NULL;
+    }
+
+    *count = 0;
+    pthread_mutex_lock(&ctx->plugin_stats_lock);
+
+    if (!ctx->plugin_stats_ht || !ctx->plugin_stats_ht->used) {
+        goto cleanup;
+    }
+
+    stats = malloc(ctx->plugin_stats_ht->used * sizeof *stats);
+    LY_CHECK_ERR_GOTO(!stats, LOGMEM(ctx), cleanup);
+
+    for (i = 0; i < ctx->plugin_stats_ht->size; ++i) {
+        if (ctx->plugin_stats_ht->ctrl[i] & LYHT_CTRL_FULL) {
+            ht_rec = lyht_get_rec(ctx->plugin_stats_ht->recs, ctx->plugin_stats_ht->rec_size, i);
+            memcpy(&stats[*count], ht_rec->val, sizeof *stats);
+            ++(*count);
+        }
+    }
+    qsort(stats, *count, sizeof *stats, ly_plugin_stats_cmp);
+
+cleanup:
+    pthread_mutex_unlock(&ctx->plugin_stats_lock);
+    return stats;
 }
 
-API void
-ly_ctx_unset_prefer_searchdirs(struct ly_ctx *ctx)
+/* schema loading phase being timed in this thread */
+static THREAD_LOCAL struct {
+    struct ly_ctx *ctx;
+    int phase;
+    struct timespec start;
+} stats_phase;
+
+static void
+ly_stats_phase_charge(const struct timespec *now)
 {
-    ly_ctx_unset_option(ctx, LY_CTX_PREFER_SEARCHDIRS);
+    uint64_t ns;
+
+    if (!stats_phase.ctx || (stats_phase.phase <= LY_STATS_PHASE_NONE)) {
+        return;
+    }
+
+    ns = (now->tv_sec - stats_phase.start.tv_sec) * 1000000000ULL + now->tv_nsec - stats_phase.start.tv_nsec;
+    switch (stats_phase.phase) {
+    case LY_STATS_PHASE_PARSE:
+        LY_STATS_ADD(stats_phase.ctx, schema_parse_time, ns);
+        break;
+    case LY_STATS_PHASE_UNRES:
+        LY_STATS_ADD(stats_phase.ctx, schema_unres_time, ns);
+        break;
+    case LY_STATS_PHASE_AUGDEV:
+        LY_STATS_ADD(stats_phase.ctx, schema_augdev_time, ns);
+        break;
+    case LY_STATS_PHASE_PATTERN:
+        LY_STATS_ADD(stats_phase.ctx, schema_pattern_time, ns);
+        break;
+    }
 }
 
-API void
-ly_ctx_set_allimplemented(struct ly_ctx *ctx)
+void
+ly_stats_phase_enter(struct ly_ctx *ctx, enum ly_stats_phase phase, struct ly_stats_phase_prev *prev)
 {
-    ly_ctx_set_option(ctx, LY_CTX_ALLIMPLEMENTED);
+    struct timespec now;
+
+    if (!ctx || !ctx->stats_on) {
+        prev->phase = -1;
+        return;
+    }
+
+    /* interrupt the current phase */
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    ly_stats_phase_charge(&now);
+    prev->ctx = stats_phase.ctx;
+    prev->phase = stats_phase.phase;
+
+    stats_phase.ctx = ctx;
+    stats_phase.phase = phase;
+    stats_phase.start = now;
 }
 
-API void
-ly_ctx_unset_allimplemented(struct ly_ctx *ctx)
+void
+ly_stats_phase_leave(const struct ly_stats_phase_prev *prev)
 {
-    ly_ctx_unset_option(ctx, LY_CTX_ALLIMPLEMENTED);
+    struct timespec now;
+
+    if (prev->phase == -1) {
+        return;
+    }
+
+    /* continue with the interrupted phase */
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    ly_stats_phase_charge(&now);
+    stats_phase.ctx = prev->ctx;
+    stats_phase.phase = prev->phase;
+    stats_phase.start = now;
 }
 
-API void
-ly_ctx_set_trusted(struct ly_ctx *ctx)
+#ifdef LY_ENABLED_CACHE
+
+static size_t
+ly_ctx_cache_mem_size(struct hash_table *ht, pthread_rwlock_t *lock)
 {
-    ly_ctx_set_option(ctx, LY_CTX_TRUSTED);
+    size_t size;
+
+    pthread_rwlock_rdlock(lock);
+    size = lyht_mem_size(ht);
+    pthread_rwlock_unlock(lock);
+
+    return size;
 }
 
-API void
-ly_ctx_unset_trusted(struct ly_ctx *ctx)
+#endif
+
+API int
+ly_ctx_get_mem_usage(struct ly_ctx *ctx, struct ly_ctx_mem_usage *usage)
 {
-    ly_ctx_unset_option(ctx, LY_CTX_TRUSTED);
+    int i;
+
+    if (!ctx || !usage) {
+        LOGARG;
+        return EXIT_FAILURE;
+    }
+
+    memset(usage, 0, sizeof *usage);
+
+    usage->modules = sizeof *ctx + ctx->models.size * sizeof *ctx->models.list;
+    for (i = 0; i < ctx->models.used; ++i) {
+        lys_mem_usage(ctx->models.list[i], usage);
+    }
+
+    usage->patterns += lyp_regex_cache_mem_size(ctx);
+    usage->dict = lydict_mem_size(ctx->dict);
+
+    pthread_mutex_lock(&ctx->val_prof_lock);
+    usage->caches = lyht_mem_size(ctx->val_prof_ht);
+    pthread_mutex_unlock(&ctx->val_prof_lock);
+    pthread_mutex_lock(&ctx->plugin_stats_lock);
+    usage->caches += lyht_mem_size(ctx->plugin_stats_ht);
+    pthread_mutex_unlock(&ctx->plugin_stats_lock);
+    usage->caches += lyd_bits_ht_mem_size(ctx);
+    usage->caches += lyd_binary_mem_size(ctx);
+    pthread_rwlock_rdlock(&ctx->node_id_lock);
+    usage->caches += lyht_mem_size(ctx->node_id_ht);
+    pthread_rwlock_unlock(&ctx->node_id_lock);
+#ifdef LY_ENABLED_CACHE
+    usage->caches += lyht_mem_size(ctx->models.name_ht) + lyht_mem_size(ctx->models.ns_ht);
+    usage->caches += ly_ctx_cache_mem_size(ctx->child_hash, &ctx->child_hash_lock);
+    usage->caches += ly_ctx_cache_mem_size(ctx->mand_hash, &ctx->mand_hash_lock);
+    usage->caches += ly_ctx_cache_mem_size(ctx->op_deps_hash, &ctx->op_deps_hash_lock);
+    usage->caches += ly_ctx_cache_mem_size(ctx->value_hash, &ctx->value_hash_lock);
+    usage->caches += ly_ctx_cache_mem_size(ctx->ident_hash, &ctx->ident_hash_lock);
+    usage->caches += ly_ctx_cache_mem_size(ctx->annot_hash, &ctx->annot_hash_lock);
+    usage->caches += ly_ctx_cache_mem_size(ctx->lyb_hash, &ctx->lyb_hash_lock);
+    usage->caches += ly_ctx_cache_mem_size(ctx->schema_print, &ctx->schema_print_lock);
+    usage->caches += ly_ctx_cache_mem_size(ctx->path_hash, &ctx->path_hash_lock);
+    usage->caches += ly_ctx_cache_mem_size(ctx->ctx_map, &ctx->ctx_map_lock);
+    usage->caches += ly_ctx_cache_mem_size(ctx->data_side, &ctx->data_side_lock);
+
+    pthread_rwlock_rdlock(&ctx->info_lock);
+    usage->caches += ctx->info ? lyd_mem_usage(ctx->info, LYD_MEM_WITHSIBLINGS) : 0;
+    pthread_rwlock_unlock(&ctx->info_lock);
+#endif
+
+    usage->total = usage->modules + usage->types + usage->patterns + usage->dict + usage->caches;
+    return EXIT_SUCCESS;
+}
+
+API int
+ly_ctx_precompile(struct ly_ctx *ctx)
+{
+    int i;
+
+    if (!ctx) {
+        LOGARG;
+        return EXIT_FAILURE;
+    }
+
+    for (i = 0; i < ctx->models.used; ++i) {
+        if (lys_precompile(ctx->models.list[i])) {
+            return EXIT_FAILURE;
+        }
+    }
+    return EXIT_SUCCESS;
 }
 
 API int
@@ -435,6 +2056,10 @@ ly_ctx_set_searchdir(struct ly_ctx *ctx, const char *search_dir)
         ctx->models.search_paths[index] = new_dir;
         new_dir = NULL;
         ctx->models.search_paths[index + 1] = NULL;
+#ifdef LY_ENABLED_CACHE
+        lys_search_index_free(ctx->models.search_index);
+        ctx->models.search_index = NULL;
+#endif
 
 success:
         rc = EXIT_SUCCESS;
@@ -466,6 +2091,10 @@ ly_ctx_unset_searchdirs(struct ly_ctx *ctx, int index)
     if (!ctx->models.search_paths) {
         return;
     }
+#ifdef LY_ENABLED_CACHE
+    lys_search_index_free(ctx->models.search_index);
+    ctx->models.search_index = NULL;
+#endif
 
     for (i = 0; ctx->models.search_paths[i]; i++) {
         if (index < 0 || index == i) {
@@ -491,13 +2120,27 @@ ly_ctx_destroy(struct ly_ctx *ctx, void (*private_destructor)(const struct lys_n
         return;
     }
 
+    /* data trees still being freed in the background, they need the schema */
+    lyd_reclaim_stop(ctx);
+    pthread_mutex_destroy(&ctx->reclaim_lock);
+    pthread_cond_destroy(&ctx->reclaim_cond);
+
+    /* cached yang-library data, they need the schema */
+    ly_ctx_info_clear(ctx);
+
     /* models list */
     for (; ctx->models.used > 0; ctx->models.used--) {
         /* remove the applied deviations and augments */
         lys_sub_module_remove_devs_augs(ctx->models.list[ctx->models.used - 1]);
         /* remove the module */
+        ly_ctx_module_hash_remove(ctx, ctx->models.list[ctx->models.used - 1]);
         lys_free(ctx->models.list[ctx->models.used - 1], private_destructor, 1, 0);
     }
+#ifdef LY_ENABLED_CACHE
+    lyht_free(ctx->models.name_ht);
+    lyht_free(ctx->models.ns_ht);
+    lys_search_index_free(ctx->models.search_index);
+#endif
     if (ctx->models.search_paths) {
         for(i = 0; ctx->models.search_paths[i]; i++) {
             free(ctx->models.search_paths[i]);
@@ -510,8 +2153,48 @@ ly_ctx_destroy(struct ly_ctx *ctx, void (*private_destructor)(const struct lys_n
     ly_err_clean(ctx, 0);
     pthread_key_delete(ctx->errlist_key);
 
+    /* compiled regular expressions, they use the dictionary */
+    lyp_regex_cache_free(ctx);
+    lys_child_hash_clear(ctx);
+    lys_mand_hash_clear(ctx);
+    lys_op_deps_hash_clear(ctx);
+    lys_value_hash_clear(ctx);
+    lys_ident_hash_clear(ctx);
+    lys_annot_hash_clear(ctx);
+    lyb_sib_ht_clear(ctx);
+    lys_print_cache_clear(ctx);
+    lys_path_hash_clear(ctx);
+    lys_ctx_map_clear(ctx);
+    ly_ctx_clean_val_profile(ctx);
+    pthread_mutex_destroy(&ctx->val_prof_lock);
+    ly_plugin_stats_clear(ctx);
+    pthread_mutex_destroy(&ctx->plugin_stats_lock);
+    lyd_bits_clear(ctx);
+    pthread_mutex_destroy(&ctx->bits_lock);
+    lyd_binary_clear(ctx);
+    pthread_mutex_destroy(&ctx->binary_lock);
+    lys_node_id_clear(ctx);
+    pthread_rwlock_destroy(&ctx->node_id_lock);
+#ifdef LY_ENABLED_CACHE
+    pthread_mutex_destroy(&ctx->regex_lock);
+    pthread_rwlock_destroy(&ctx->child_hash_lock);
+    pthread_rwlock_destroy(&ctx->mand_hash_lock);
+    pthread_rwlock_destroy(&ctx->op_deps_hash_lock);
+    pthread_rwlock_destroy(&ctx->value_hash_lock);
+    pthread_rwlock_destroy(&ctx->ident_hash_lock);
+    pthread_rwlock_destroy(&ctx->annot_hash_lock);
+    pthread_rwlock_destroy(&ctx->lyb_hash_lock);
+    pthread_rwlock_destroy(&ctx->schema_print_lock);
+    pthread_rwlock_destroy(&ctx->path_hash_lock);
+    pthread_rwlock_destroy(&ctx->ctx_map_lock);
+    pthread_rwlock_destroy(&ctx->info_lock);
+    /* records of data trees not freed before the context */
+    lyd_side_clear(ctx);
+    pthread_rwlock_destroy(&ctx->data_side_lock);
+#endif
+
     /* dictionary */
-    lydict_clean(&ctx->dict);
+    lydict_free(ctx->dict);
 
     /* plugins - will be removed only if this is the last context */
     ly_clean_plugins();
@@ -598,6 +2281,162 @@ ly_ctx_get_submodule(const struct ly_ctx *ctx, const char *module, const char *r
     return ret;
 }
 
+#ifdef LY_ENABLED_CACHE
+
+/* module in a hash table of the context modules list */
+struct ly_ctx_mod_rec {
+    const char *key;
+    size_t key_len;
+    struct lys_module *mod;
+};
+
+static int
+ly_ctx_mod_rec_equal(void *val1_p, void *val2_p, int mod, void *UNUSED(cb_data))
+{
+    struct ly_ctx_mod_rec *rec1 = (struct ly_ctx_mod_rec *)val1_p, *rec2 = (struct ly_ctx_mod_rec *)val2_p;
+
+    if (mod) {
+        /* the exact module */
+        return (rec1->mod == rec2->mod);
+    }
+
+    return (rec1->key_len == rec2->key_len) && !strncmp(rec1->key, rec2->key, rec1->key_len);
+}
+
+static uint32_t
+ly_ctx_mod_rec_hash(const char *key, size_t key_len)
+{
+    uint32_t hash;
+
+    hash = dict_hash_multi(0, key, key_len);
+    return dict_hash_multi(hash, NULL, 0);
+}
+
+static int
+ly_ctx_mod_ht_insert(struct hash_table **ht, const char *key, struct lys_module *mod)
+{
+    struct ly_ctx_mod_rec rec;
+
+    if (!*ht) {
+        *ht = lyht_new(64, sizeof rec, ly_ctx_mod_rec_equal, NULL, 1);
+        if (!*ht) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    rec.key = key;
+    rec.key_len = strlen(key);
+    rec.mod = mod;
+    if (lyht_insert(*ht, &rec, ly_ctx_mod_rec_hash(rec.key, rec.key_len), NULL) == -1) {
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+static void
+ly_ctx_mod_ht_remove(struct hash_table *ht, const char *key, struct lys_module *mod)
+{
+    struct ly_ctx_mod_rec rec;
+
+    if (!ht) {
+        return;
+    }
+
+    rec.key = key;
+    rec.key_len = strlen(key);
+    rec.mod = mod;
+    lyht_remove(ht, &rec, ly_ctx_mod_rec_hash(rec.key, rec.key_len));
+}
+
+#endif
+
+int
+ly_ctx_module_hash_add(struct ly_ctx *ctx, struct lys_module *mod)
+{
+#ifdef LY_ENABLED_CACHE
+    if (ly_ctx_mod_ht_insert(&ctx->models.name_ht, mod->name, mod)
+            || ly_ctx_mod_ht_insert(&ctx->models.ns_ht, mod->ns, mod)) {
+        LOGMEM(ctx);
+        ly_ctx_module_hash_remove(ctx, mod);
+        return EXIT_FAILURE;
+    }
+#else
+    (void)ctx;
+    (void)mod;
+#endif
+
+    return EXIT_SUCCESS;
+}
+
+void
+ly_ctx_module_hash_remove(struct ly_ctx *ctx, struct lys_module *mod)
+{
+#ifdef LY_ENABLED_CACHE
+    ly_ctx_mod_ht_remove(ctx->models.name_ht, mod->name, mod);
+    ly_ctx_mod_ht_remove(ctx->models.ns_ht, mod->ns, mod);
+#else
+    (void)ctx;
+    (void)mod;
+#endif
+}
+
+/**
+ * @brief Learn whether a module matching the key is the one to be returned by ly_ctx_get_module_by().
+ *
+ * @param[in] mod Module with a matching key.
+ * @param[in] revision Required revision, NULL for the newest or the implemented one.
+ * @param[in] with_disabled Whether disabled modules can be returned.
+ * @param[in] implemented Whether only the implemented module is returned.
+ * @param[in,out] result Module to be returned.
+ * @return 1 if \p result is final, 0 otherwise.
+ */
+static int
+ly_ctx_get_module_match(struct lys_module *mod, const char *revision, int with_disabled, int implemented,
+                        struct lys_module **result)
+{
+    if (!with_disabled && mod->disabled) {
+        /* skip the disabled modules */
+        return 0;
+    }
+
+    if (!revision) {
+        /* compare revisons and remember the newest one */
+        if (*result) {
+            if (!mod->rev_size) {
+                /* the current have no revision, keep the previous with some revision */
+                return 0;
+            }
+            if ((*result)->rev_size && strcmp(mod->rev[0].date, (*result)->rev[0].date) < 0) {
+                /* the previous found matching module has a newer revision */
+                return 0;
+            }
+        }
+        if (implemented) {
+            if (mod->implemented) {
+                /* we have the implemented revision */
+                *result = mod;
+                return 1;
+            } else {
+                /* do not remember the result, we are supposed to return the implemented revision
+                 * not the newest one */
+                return 0;
+            }
+        }
+
+        /* remember the current match and search for newer version */
+        *result = mod;
+    } else {
+        if (mod->rev_size && !strcmp(revision, mod->rev[0].date)) {
+            /* matching revision */
+            *result = mod;
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
 static const struct lys_module *
 ly_ctx_get_module_by(const struct ly_ctx *ctx, const char *key, size_t key_len, int offset, const char *revision,
                      int with_disabled, int implemented)
@@ -605,15 +2444,45 @@ ly_ctx_get_module_by(const struct ly_ctx *ctx, const char *key, size_t key_len,
     int i;
     char *val;
     struct lys_module *result = NULL;
+#ifdef LY_ENABLED_CACHE
+    struct hash_table *ht = NULL;
+    struct ly_ctx_mod_rec rec, *match;
+    uint32_t hash;
+#endif
 
     if (!ctx || !key) {
         LOGARG;
         return NULL;
     }
 
+#ifdef LY_ENABLED_CACHE
+    if (offset == offsetof(struct lys_module, name)) {
+        ht = ctx->models.name_ht;
+    } else if (offset == offsetof(struct lys_module, ns)) {
+        ht = ctx->models.ns_ht;
+    }
+    if (ht) {
+        rec.key = key;
+        rec.key_len = key_len ? key_len : strlen(key);
+        hash = ly_ctx_mod_rec_hash(rec.key, rec.key_len);
+
+        /* all the modules with the key (its revisions), the order does not matter */
+        if (lyht_find(ht, &rec, hash, (void **)&match)) {
+            return NULL;
+        }
+        do {
+            if (ly_ctx_mod_rec_equal(&rec, match, 0, NULL)
+                    && ly_ctx_get_module_match(match->mod, revision, with_disabled, implemented, &result)) {
+                break;
+            }
+        } while (!lyht_find_next(ht, match, hash, (void **)&match));
+
+        return result;
+    }
+#endif
+
     for (i = 0; i < ctx->models.used; i++) {
-        if (!with_disabled && ctx->models.list[i]->disabled) {
-            /* skip the disabled modules */
+        if (!ctx->models.list[i]) {
             continue;
         }
         /* use offset to get address of the pointer to string (char**), remember that offset is in
@@ -621,47 +2490,16 @@ ly_ctx_get_module_by(const struct ly_ctx *ctx, const char *key, size_t key_len,
          * string not the pointer to string
          */
         val = *(char **)(((char *)ctx->models.list[i]) + offset);
-        if (!ctx->models.list[i] || (!key_len && strcmp(key, val)) || (key_len && (strncmp(key, val, key_len) || val[key_len]))) {
+        if ((!key_len && strcmp(key, val)) || (key_len && (strncmp(key, val, key_len) || val[key_len]))) {
             continue;
         }
 
-        if (!revision) {
-            /* compare revisons and remember the newest one */
-            if (result) {
-                if (!ctx->models.list[i]->rev_size) {
-                    /* the current have no revision, keep the previous with some revision */
-                    continue;
-                }
-                if (result->rev_size && strcmp(ctx->models.list[i]->rev[0].date, result->rev[0].date) < 0) {
-                    /* the previous found matching module has a newer revision */
-                    continue;
-                }
-            }
-            if (implemented) {
-                if (ctx->models.list[i]->implemented) {
-                    /* we have the implemented revision */
-                    result = ctx->models.list[i];
-                    break;
-                } else {
-                    /* do not remember the result, we are supposed to return the implemented revision
-                     * not the newest one */
-                    continue;
-                }
-            }
-
-            /* remember the current match and search for newer version */
-            result = ctx->models.list[i];
-        } else {
-            if (ctx->models.list[i]->rev_size && !strcmp(revision, ctx->models.list[i]->rev[0].date)) {
-                /* matching revision */
-                result = ctx->models.list[i];
-                break;
-            }
+        if (ly_ctx_get_module_match(ctx->models.list[i], revision, with_disabled, implemented, &result)) {
+            break;
         }
     }
 
     return result;
-
 }
 
 API const struct lys_module *
@@ -796,9 +2634,15 @@ ly_ctx_load_localfile(struct ly_ctx *ctx, struct lys_module *module, const char
     char *filepath = NULL, *dot, *rev, *filename;
     LYS_INFORMAT format;
     struct lys_module *result = NULL;
+    struct ly_ctx_prefetch *pre;
 
+#ifdef LY_ENABLED_CACHE
+    if (lys_search_localfile_index(&ctx->models.search_index, ly_ctx_get_searchdirs(ctx),
+                                   !(ctx->models.flags & LY_CTX_DISABLE_SEARCHDIR_CWD), name, revision, &filepath, &format)) {
+#else
     if (lys_search_localfile(ly_ctx_get_searchdirs(ctx), !(ctx->models.flags & LY_CTX_DISABLE_SEARCHDIR_CWD), name, revision,
                              &filepath, &format)) {
+#endif
         goto cleanup;
     } else if (!filepath) {
         if (!module && !revision) {
@@ -841,20 +2685,30 @@ ly_ctx_load_localfile(struct ly_ctx *ctx, struct lys_module *module, const char
     /* add the format back */
     dot[1] = 'y';
 
-    /* open the file */
-    fd = open(filepath, O_RDONLY);
-    if (fd < 0) {
-        LOGERR(ctx, LY_ESYS, "Unable to open data model file \"%s\" (%s).",
-               filepath, strerror(errno));
-        goto cleanup;
-    }
-
-    if (module) {
-        result = (struct lys_module *)lys_sub_parse_fd(module, fd, format, unres);
+    if (!module && (pre = ly_ctx_prefetch_find(ctx, filepath)) && pre->data) {
+        /* the file was already read */
+        if (pre->xml) {
+            result = (struct lys_module *)lys_parse_yin_(ctx, pre->xml, revision, implement);
+        } else {
+            result = (struct lys_module *)lys_parse_mem_(ctx, pre->data, format, revision, 1, implement);
+        }
+        ly_ctx_prefetch_release(ctx, pre);
     } else {
-        result = (struct lys_module *)lys_parse_fd_(ctx, fd, format, revision, implement);
+        /* open the file */
+        fd = open(filepath, O_RDONLY);
+        if (fd < 0) {
+            LOGERR(ctx, LY_ESYS, "Unable to open data model file \"%s\" (%s).",
+                   filepath, strerror(errno));
+            goto cleanup;
+        }
+
+        if (module) {
+            result = (struct lys_module *)lys_sub_parse_fd(module, fd, format, unres);
+        } else {
+            result = (struct lys_module *)lys_parse_fd_(ctx, fd, format, revision, implement);
+        }
+        close(fd);
     }
-    close(fd);
 
     if (!result) {
         goto cleanup;
@@ -935,9 +2789,51 @@ ly_ctx_load_sub_module_clb(struct ly_ctx *ctx, struct lys_module *module, const
     return mod;
 }
 
-const struct lys_module *
-ly_ctx_load_sub_module(struct ly_ctx *ctx, struct lys_module *module, const char *name, const char *revision,
-                       int implement, struct unres_schema *unres)
+/**
+ * @brief Parse a (sub)module from the sources fetched by ly_ctx_fetch_modules().
+ *
+ * @return Parsed (sub)module, NULL if not fetched or on error.
+ */
+static struct lys_module *
+ly_ctx_load_sub_module_fetched(struct ly_ctx *ctx, struct lys_module *module, const char *name, const char *revision,
+                               int implement, struct unres_schema *unres)
+{
+    struct ly_fetch *req, *found = NULL;
+    const char *mod_name, *submod_name, *req_rev;
+    uint32_t i;
+
+    mod_name = module ? lys_main_module(module)->name : name;
+    submod_name = module ? name : NULL;
+
+    for (i = 0; i < ctx->models.fetch->count; ++i) {
+        req = ctx->models.fetch->reqs[i];
+        if (!req->data || strcmp(req->mod_name, mod_name) || (!req->submod_name != !submod_name)
+                || (submod_name && strcmp(req->submod_name, submod_name))) {
+            continue;
+        }
+
+        /* prefer the source of the same requested revision, any source is fine if no revision is required */
+        req_rev = submod_name ? req->submod_rev : req->mod_rev;
+        if (ly_strequal(req_rev, revision, 0)) {
+            found = req;
+            break;
+        } else if ((!req_rev || !revision) && !found) {
+            found = req;
+        }
+    }
+    if (!found) {
+        return NULL;
+    }
+
+    if (module) {
+        return (struct lys_module *)lys_sub_parse_mem(module, found->data, found->format, unres);
+    }
+    return (struct lys_module *)lys_parse_mem_(ctx, found->data, found->format, NULL, 0, implement);
+}
+
+static const struct lys_module *
+ly_ctx_load_sub_module_(struct ly_ctx *ctx, struct lys_module *module, const char *name, const char *revision,
+                        int implement, struct unres_schema *unres)
 {
     struct lys_module *mod = NULL;
     int i;
@@ -985,6 +2881,14 @@ ly_ctx_load_sub_module(struct ly_ctx *ctx, struct lys_module *module, const char
         }
     }
 
+    if (ctx->models.fetch) {
+        /* fetched in advance by ly_ctx_fetch_modules() */
+        mod = ly_ctx_load_sub_module_fetched(ctx, module, name, revision, implement, unres);
+        if (mod) {
+            goto loaded;
+        }
+    }
+
     /* module is not yet in context, use the user callback or try to find the schema on our own */
     if (ctx->imp_clb && !(ctx->models.flags & LY_CTX_PREFER_SEARCHDIRS)) {
 search_clb:
@@ -1005,6 +2909,7 @@ search_file:
         }
     }
 
+loaded:
 #ifdef LY_ENABLED_LATEST_REVISIONS
     if (!revision && mod) {
         /* module is the latest revision found */
@@ -1015,6 +2920,19 @@ search_file:
     return mod;
 }
 
+const struct lys_module *
+ly_ctx_load_sub_module(struct ly_ctx *ctx, struct lys_module *module, const char *name, const char *revision,
+                       int implement, struct unres_schema *unres)
+{
+    const struct lys_module *mod;
+
+    LY_TRACE(module_load_start, ctx, name, revision, module ? 1 : 0, implement);
+    mod = ly_ctx_load_sub_module_(ctx, module, name, revision, implement, unres);
+    LY_TRACE(module_load_done, ctx, name, revision, mod);
+
+    return mod;
+}
+
 API const struct lys_module *
 ly_ctx_load_module(struct ly_ctx *ctx, const char *name, const char *revision)
 {
@@ -1026,6 +2944,346 @@ ly_ctx_load_module(struct ly_ctx *ctx, const char *name, const char *revision)
     return ly_ctx_load_sub_module(ctx, NULL, name, revision && revision[0] ? revision : NULL, 1, NULL);
 }
 
+/**
+ * @brief Request a (sub)module source from the fetch callback unless it is already requested. Logs directly.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int
+ly_fetch_add(struct ly_fetch_set *fs, const char *mod_name, size_t mod_name_len, const char *mod_rev, size_t mod_rev_len,
+             const char *submod_name, size_t submod_name_len, const char *submod_rev, size_t submod_rev_len)
+{
+    struct ly_fetch *req, **reqs;
+    uint32_t i;
+
+    for (i = 0; i < fs->count; ++i) {
+        req = fs->reqs[i];
+        if (!strncmp(req->mod_name, mod_name, mod_name_len) && !req->mod_name[mod_name_len]
+                && (!req->submod_name == !submod_name)
+                && (!submod_name || (!strncmp(req->submod_name, submod_name, submod_name_len) && !req->submod_name[submod_name_len]))) {
+            /* a source of another revision is not requested again */
+            return 0;
+        }
+    }
+
+    req = calloc(1, sizeof *req);
+    reqs = realloc(fs->reqs, (fs->count + 1) * sizeof *fs->reqs);
+    LY_CHECK_ERR_GOTO(!req || !reqs, LOGMEM(NULL), error);
+    fs->reqs = reqs;
+
+    req->set = fs;
+    req->mod_name = strndup(mod_name, mod_name_len);
+    req->mod_rev = mod_rev ? strndup(mod_rev, mod_rev_len) : NULL;
+    req->submod_name = submod_name ? strndup(submod_name, submod_name_len) : NULL;
+    req->submod_rev = submod_rev ? strndup(submod_rev, submod_rev_len) : NULL;
+    LY_CHECK_ERR_GOTO(!req->mod_name || (mod_rev && !req->mod_rev) || (submod_name && !req->submod_name)
+                      || (submod_rev && !req->submod_rev), LOGMEM(NULL), error);
+
+    fs->reqs[fs->count++] = req;
+    return 0;
+
+error:
+    if (req) {
+        free(req->mod_name);
+        free(req->mod_rev);
+        free(req->submod_name);
+        free(req->submod_rev);
+        free(req);
+    }
+    return -1;
+}
+
+/**
+ * @brief Get the next token of a YANG source, the quoted strings are returned without the quotes.
+ *
+ * @param[in,out] data Current position in the source, moved after the token.
+ * @param[out] len Length of the returned token.
+ * @return Token, NULL at the end of the source.
+ */
+static const char *
+ly_fetch_yang_token(const char **data, size_t *len)
+{
+    const char *ptr = *data, *tok;
+    char quot;
+
+    while (1) {
+        while (isspace(*ptr)) {
+            ++ptr;
+        }
+        if ((ptr[0] == '/') && (ptr[1] == '/')) {
+            ptr = strchrnul(ptr, '\n');
+        } else if ((ptr[0] == '/') && (ptr[1] == '*')) {
+            tok = strstr(ptr + 2, "*/");
+            ptr = tok ? tok + 2 : ptr + strlen(ptr);
+        } else {
+            break;
+        }
+    }
+
+    if (!*ptr) {
+        *data = ptr;
+        return NULL;
+    }
+
+    if ((*ptr == '"') || (*ptr == '\'')) {
+        quot = *ptr;
+        tok = ++ptr;
+        while (*ptr && (*ptr != quot)) {
+            if ((quot == '"') && (*ptr == '\\') && ptr[1]) {
+                ++ptr;
+            }
+            ++ptr;
+        }
+        *len = ptr - tok;
+        *data = *ptr ? ptr + 1 : ptr;
+        return tok;
+    }
+
+    tok = ptr;
+    if ((*ptr == '{') || (*ptr == '}') || (*ptr == ';')) {
+        ++ptr;
+    } else {
+        while (*ptr && !isspace(*ptr) && !strchr("{};\"'", *ptr)) {
+            ++ptr;
+        }
+    }
+    *len = ptr - tok;
+    *data = ptr;
+    return tok;
+}
+
+/**
+ * @brief Request the imports and includes of a fetched YANG source, it is not parsed, only the statements are
+ * recognized. Logs directly.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int
+ly_fetch_scan_yang(struct ly_fetch_set *fs, struct ly_fetch *req)
+{
+    const char *data = req->data, *tok, *arg, *rev;
+    size_t len, kw_len, arg_len, rev_len = 0;
+    int depth = 0, stmt_start = 1, inner, r;
+
+    while ((tok = ly_fetch_yang_token(&data, &len))) {
+        if (*tok == '{') {
+            ++depth;
+            stmt_start = 1;
+            continue;
+        } else if ((*tok == '}') || (*tok == ';')) {
+            depth -= (*tok == '}') ? 1 : 0;
+            stmt_start = 1;
+            continue;
+        } else if (!stmt_start || (depth != 1) || (((len != 6) || strncmp(tok, "import", 6))
+                && ((len != 7) || strncmp(tok, "include", 7)))) {
+            stmt_start = 0;
+            continue;
+        }
+
+        /* import or include of the (sub)module */
+        kw_len = len;
+        arg = ly_fetch_yang_token(&data, &arg_len);
+        if (!arg) {
+            break;
+        }
+        rev = NULL;
+        tok = ly_fetch_yang_token(&data, &len);
+        if (tok && (*tok == '{')) {
+            for (inner = 1, stmt_start = 1; inner && (tok = ly_fetch_yang_token(&data, &len)); ) {
+                if ((*tok == '{') || (*tok == '}') || (*tok == ';')) {
+                    inner += (*tok == '{') ? 1 : ((*tok == '}') ? -1 : 0);
+                    stmt_start = 1;
+                } else if (stmt_start && (inner == 1) && (len == 13) && !strncmp(tok, "revision-date", 13)) {
+                    rev = ly_fetch_yang_token(&data, &rev_len);
+                    stmt_start = 0;
+                } else {
+                    stmt_start = 0;
+                }
+            }
+        }
+        stmt_start = 1;
+
+        if (kw_len == 6) {
+            r = ly_fetch_add(fs, arg, arg_len, rev, rev_len, NULL, 0, NULL, 0);
+        } else {
+            r = ly_fetch_add(fs, req->mod_name, strlen(req->mod_name), req->mod_rev, req->mod_rev ? strlen(req->mod_rev) : 0,
+                             arg, arg_len, rev, rev_len);
+        }
+        if (r) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Request the imports and includes of a fetched YIN source. Logs directly.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int
+ly_fetch_scan_yin(struct ly_ctx *ctx, struct ly_fetch_set *fs, struct ly_fetch *req)
+{
+    struct lyxml_elem *xml, *elem, *child;
+    const char *arg, *rev;
+    int r = 0;
+
+    xml = lyxml_parse_mem(ctx, req->data, LYXML_PARSE_NOMIXEDCONTENT);
+    if (!xml) {
+        /* the error is reported once the source is parsed */
+        return 0;
+    }
+
+    LY_TREE_FOR(xml->child, elem) {
+        if (strcmp(elem->name, "import") && strcmp(elem->name, "include")) {
+            continue;
+        }
+        arg = lyxml_get_attr(elem, "module", NULL);
+        if (!arg) {
+            continue;
+        }
+        rev = NULL;
+        LY_TREE_FOR(elem->child, child) {
+            if (!strcmp(child->name, "revision-date")) {
+                rev = lyxml_get_attr(child, "date", NULL);
+            }
+        }
+
+        if (!strcmp(elem->name, "import")) {
+            r = ly_fetch_add(fs, arg, strlen(arg), rev, rev ? strlen(rev) : 0, NULL, 0, NULL, 0);
+        } else {
+            r = ly_fetch_add(fs, req->mod_name, strlen(req->mod_name), req->mod_rev, req->mod_rev ? strlen(req->mod_rev) : 0,
+                             arg, strlen(arg), rev, rev ? strlen(rev) : 0);
+        }
+        if (r) {
+            break;
+        }
+    }
+
+    lyxml_free_withsiblings(ctx, xml);
+    return r ? -1 : 0;
+}
+
+API void
+ly_fetch_done(struct ly_fetch *request, const char *data, LYS_INFORMAT format,
+              void (*free_module_data)(void *model_data, void *user_data))
+{
+    struct ly_fetch_set *fs;
+
+    if (!request) {
+        LOGARG;
+        return;
+    }
+    fs = request->set;
+
+    pthread_mutex_lock(&fs->lock);
+    if (!request->done) {
+        request->data = data;
+        request->format = format;
+        request->free_module_data = free_module_data;
+        request->done = 1;
+        --fs->pending;
+        pthread_cond_signal(&fs->cond);
+    }
+    pthread_mutex_unlock(&fs->lock);
+}
+
+API int
+ly_ctx_fetch_modules(struct ly_ctx *ctx, const char **names, const char **revisions, unsigned int count,
+                     ly_module_fetch_clb clb, void *user_data)
+{
+    struct ly_fetch_set fs;
+    struct ly_fetch *req;
+    const char *rev;
+    uint32_t i;
+    int ret = EXIT_SUCCESS, progress;
+
+    if (!ctx || (count && !names) || !clb || ctx->models.fetch) {
+        LOGARG;
+        return EXIT_FAILURE;
+    }
+
+    memset(&fs, 0, sizeof fs);
+    fs.clb = clb;
+    fs.user_data = user_data;
+    pthread_mutex_init(&fs.lock, NULL);
+    pthread_cond_init(&fs.cond, NULL);
+
+    for (i = 0; i < count; ++i) {
+        rev = revisions ? revisions[i] : NULL;
+        if (!names[i] || ly_ctx_get_module(ctx, names[i], rev, 0)) {
+            continue;
+        }
+        if (ly_fetch_add(&fs, names[i], strlen(names[i]), rev, rev ? strlen(rev) : 0, NULL, 0, NULL, 0)) {
+            ret = EXIT_FAILURE;
+            break;
+        }
+    }
+
+    /* request all the sources, and the imports and includes of every source as soon as it arrives,
+     * the requests are always finished before returning since the callback could still use them */
+    pthread_mutex_lock(&fs.lock);
+    while (1) {
+        progress = 0;
+        for (i = 0; i < fs.count; ++i) {
+            req = fs.reqs[i];
+            if (!req->issued && !ret) {
+                req->issued = 1;
+                ++fs.pending;
+                progress = 1;
+                pthread_mutex_unlock(&fs.lock);
+                clb(req, req->mod_name, req->mod_rev, req->submod_name, req->submod_rev, user_data);
+                pthread_mutex_lock(&fs.lock);
+            } else if (req->done && !req->scanned) {
+                req->scanned = 1;
+                progress = 1;
+                if (!req->data || ret) {
+                    continue;
+                }
+                pthread_mutex_unlock(&fs.lock);
+                if (((req->format == LYS_IN_YIN) ? ly_fetch_scan_yin(ctx, &fs, req) : ly_fetch_scan_yang(&fs, req))) {
+                    ret = EXIT_FAILURE;
+                }
+                pthread_mutex_lock(&fs.lock);
+            }
+        }
+        if (!progress) {
+            if (!fs.pending) {
+                break;
+            }
+            pthread_cond_wait(&fs.cond, &fs.lock);
+        }
+    }
+    pthread_mutex_unlock(&fs.lock);
+
+    /* parse and resolve the modules from the fetched sources */
+    ctx->models.fetch = &fs;
+    for (i = 0; !ret && (i < count); ++i) {
+        if (names[i] && !ly_ctx_load_module(ctx, names[i], revisions ? revisions[i] : NULL)) {
+            ret = EXIT_FAILURE;
+        }
+    }
+    ctx->models.fetch = NULL;
+
+    for (i = 0; i < fs.count; ++i) {
+        req = fs.reqs[i];
+        if (req->data && req->free_module_data) {
+            req->free_module_data((char *)req->data, user_data);
+        }
+        free(req->mod_name);
+        free(req->mod_rev);
+        free(req->submod_name);
+        free(req->submod_rev);
+        free(req);
+    }
+    free(fs.reqs);
+    pthread_mutex_destroy(&fs.lock);
+    pthread_cond_destroy(&fs.cond);
+
+    return ret;
+}
+
 /*
  * mods - set of removed modules, if NULL all modules are supposed to be removed so any backlink is invalid
  */
@@ -1488,6 +3746,9 @@ ly_ctx_remove_module(const struct lys_module *module,
             return EXIT_FAILURE;
         }
     }
+    /* data trees still being freed in the background, they need the schema */
+    lyd_free_deferred_wait(ctx);
+
     /* ... and hide the module from the further processing of the context modules list */
     for (i = ctx->internal_module_count; i < ctx->models.used; i++) {
         if (mod == ctx->models.list[i]) {
@@ -1573,10 +3834,16 @@ imported:
     }
     ctx->models.used = o + 1;
     ctx->models.module_set_id++;
+    for (u = 0; u < mods->number; u++) {
+        ly_ctx_module_hash_remove(ctx, (struct lys_module *)mods->set.g[u]);
+    }
 
     /* maintain backlinks (start with internal ietf-yang-library which have leafs as possible targets of leafrefs */
     ctx_modules_undo_backlinks(ctx, mods);
 
+    /* the profile refers the schema nodes */
+    ly_ctx_clean_val_profile(ctx);
+
     /* free the modules */
     for (u = 0; u < mods->number; u++) {
         /* remove the applied deviations and augments */
@@ -1596,11 +3863,18 @@ ly_ctx_clean(struct ly_ctx *ctx, void (*private_destructor)(const struct lys_nod
         return;
     }
 
+    /* data trees still being freed in the background, they need the schema */
+    lyd_free_deferred_wait(ctx);
+
+    /* the profile refers the schema nodes */
+    ly_ctx_clean_val_profile(ctx);
+
     /* models list */
     for (; ctx->models.used > ctx->internal_module_count; ctx->models.used--) {
         /* remove the applied deviations and augments */
         lys_sub_module_remove_devs_augs(ctx->models.list[ctx->models.used - 1]);
         /* remove the module */
+        ly_ctx_module_hash_remove(ctx, ctx->models.list[ctx->models.used - 1]);
         lys_free(ctx->models.list[ctx->models.used - 1], private_destructor, 1, 0);
         /* clean it for safer future use */
         ctx->models.list[ctx->models.used - 1] = NULL;
@@ -1773,8 +4047,8 @@ ly_ctx_get_module_set_id(const struct ly_ctx *ctx)
     return ctx->models.module_set_id;
 }
 
-API struct lyd_node *
-ly_ctx_info(struct ly_ctx *ctx)
+static struct lyd_node *
+ly_ctx_info_create(struct ly_ctx *ctx)
 {
     int i, bis = 0;
     char id[8];
@@ -1782,11 +4056,6 @@ ly_ctx_info(struct ly_ctx *ctx)
     const struct lys_module *mod;
     struct lyd_node *root, *root_bis = NULL, *cont = NULL, *set_bis = NULL;
 
-    if (!ctx) {
-        LOGARG;
-        return NULL;
-    }
-
     mod = ly_ctx_get_module(ctx, "ietf-yang-library", NULL, 1);
     if (!mod || !mod->data) {
         LOGERR(ctx, LY_EINVAL, "ietf-yang-library is not implemented.");
@@ -1958,6 +4227,57 @@ error:
     return NULL;
 }
 
+void
+ly_ctx_info_clear(struct ly_ctx *ctx)
+{
+#ifdef LY_ENABLED_CACHE
+    pthread_rwlock_wrlock(&ctx->info_lock);
+    lyd_free_withsiblings(ctx->info);
+    ctx->info = NULL;
+    pthread_rwlock_unlock(&ctx->info_lock);
+#else
+    (void)ctx;
+#endif
+}
+
+API struct lyd_node *
+ly_ctx_info(struct ly_ctx *ctx)
+{
+#ifdef LY_ENABLED_CACHE
+    struct lyd_node *ret = NULL;
+#endif
+
+    if (!ctx) {
+        LOGARG;
+        return NULL;
+    }
+
+#ifdef LY_ENABLED_CACHE
+    /* the data are created only once for each module set, a copy is returned */
+    pthread_rwlock_rdlock(&ctx->info_lock);
+    if (ctx->info && (ctx->info_set_id == ctx->models.module_set_id)) {
+        ret = lyd_dup_withsiblings(ctx->info, LYD_DUP_OPT_RECURSIVE);
+        pthread_rwlock_unlock(&ctx->info_lock);
+        return ret;
+    }
+    pthread_rwlock_unlock(&ctx->info_lock);
+
+    pthread_rwlock_wrlock(&ctx->info_lock);
+    if (!ctx->info || (ctx->info_set_id != ctx->models.module_set_id)) {
+        lyd_free_withsiblings(ctx->info);
+        ctx->info = ly_ctx_info_create(ctx);
+        ctx->info_set_id = ctx->models.module_set_id;
+    }
+    if (ctx->info) {
+        ret = lyd_dup_withsiblings(ctx->info, LYD_DUP_OPT_RECURSIVE);
+    }
+    pthread_rwlock_unlock(&ctx->info_lock);
+    return ret;
+#else
+    return ly_ctx_info_create(ctx);
+#endif
+}
+
 API const struct lys_node *
 ly_ctx_get_node(struct ly_ctx *ctx, const struct lys_node *start, const char *nodeid, int output)
 {
@@ -1978,6 +4298,17 @@ ly_ctx_get_node(struct ly_ctx *ctx, const struct lys_node *start, const char *no
     return node;
 }
 
+API const struct lys_node *
+ly_ctx_get_node_by_id(struct ly_ctx *ctx, uint64_t id)
+{
+    if (!ctx || !id) {
+        LOGARG;
+        return NULL;
+    }
+
+    return lys_node_id_find(ctx, id);
+}
+
 API struct ly_set *
 ly_ctx_find_path(struct ly_ctx *ctx, const char *path)
 {
@@ -1988,7 +4319,14 @@ ly_ctx_find_path(struct ly_ctx *ctx, const char *path)
         return NULL;
     }
 
+    if (!lys_path_hash_find(ctx, path, LYS_PATH_SCHEMA, NULL, &resultset)) {
+        return resultset;
+    }
+
     /* start in internal module without data to make sure that all the nodes are prefixed */
     resolve_schema_nodeid(path, NULL, ctx->models.list[0], &resultset, 1, 1);
+    if (resultset) {
+        lys_path_hash_add(ctx, path, LYS_PATH_SCHEMA, NULL, resultset);
+    }
     return resultset;
 }
@@ -16,12 +16,137 @@
 #define LY_CONTEXT_H_
 
 #include <pthread.h>
+#include <time.h>
 
 #include "libyang.h"
 #include "common.h"
 #include "hash_table.h"
 #include "tree_schema.h"
 
+/* statistics counters of a context, see ly_ctx_set_stats() */
+struct ly_stats {
+    atomic_uint_least64_t parse_calls;
+    atomic_uint_least64_t parse_bytes;
+    atomic_uint_least64_t nodes_created;
+    atomic_uint_least64_t nodes_freed;
+    atomic_uint_least64_t dict_inserts;
+    atomic_uint_least64_t dict_hits;
+    atomic_uint_least64_t dict_lock_waits;
+    atomic_uint_least64_t ht_probes;
+    atomic_uint_least64_t ht_resizes;
+    atomic_uint_least64_t xpath_evals;
+    atomic_uint_least64_t xpath_nodes;
+    atomic_uint_least64_t must_evals;
+    atomic_uint_least64_t when_evals;
+    atomic_uint_least64_t leafref_evals;
+    atomic_uint_least64_t val_time;
+    atomic_uint_least64_t schema_loads;
+    atomic_uint_least64_t schema_parse_time;
+    atomic_uint_least64_t schema_unres_time;
+    atomic_uint_least64_t schema_augdev_time;
+    atomic_uint_least64_t schema_patterns;
+    atomic_uint_least64_t schema_pattern_time;
+};
+
+/**
+ * @brief Add to a statistics counter of a context if the collection is enabled, see ly_ctx_set_stats().
+ */
+#define LY_STATS_ADD(ctx, counter, n)                                                                   \
+    do {                                                                                                \
+        if ((ctx) && (ctx)->stats_on) {                                                                 \
+            atomic_fetch_add_explicit(&((struct ly_ctx *)(ctx))->stats.counter, (n), memory_order_relaxed); \
+        }                                                                                               \
+    } while (0)
+
+/* schema loading phases timed by the statistics, nested phases are not accounted in the outer ones */
+enum ly_stats_phase {
+    LY_STATS_PHASE_NONE = 0,
+    LY_STATS_PHASE_PARSE,        /* schema_parse_time */
+    LY_STATS_PHASE_UNRES,        /* schema_unres_time */
+    LY_STATS_PHASE_AUGDEV,       /* schema_augdev_time */
+    LY_STATS_PHASE_PATTERN       /* schema_pattern_time */
+};
+
+/* phase interrupted by a nested one, see ly_stats_phase_enter() */
+struct ly_stats_phase_prev {
+    struct ly_ctx *ctx;
+    int phase;                   /* enum ly_stats_phase, -1 if the statistics were disabled */
+};
+
+/**
+ * @brief Start timing a schema loading phase of the thread, if the statistics are enabled.
+ *
+ * @param[in] ctx Context whose counters to update.
+ * @param[in] phase Entered phase.
+ * @param[out] prev Interrupted phase to be passed to ly_stats_phase_leave().
+ */
+void ly_stats_phase_enter(struct ly_ctx *ctx, enum ly_stats_phase phase, struct ly_stats_phase_prev *prev);
+
+/**
+ * @brief Stop timing the current schema loading phase of the thread and continue with the interrupted one.
+ *
+ * @param[in] prev Interrupted phase from ly_stats_phase_enter().
+ */
+void ly_stats_phase_leave(const struct ly_stats_phase_prev *prev);
+
+/**
+ * @brief Start timing a plugin callback call if the statistics are enabled.
+ *
+ * @param[in] ctx Context of the plugin user.
+ * @param[out] start Start time, zeroed if the statistics are disabled.
+ */
+void ly_plugin_stats_start(const struct ly_ctx *ctx, struct timespec *start);
+
+/**
+ * @brief Account a finished plugin callback call, see ly_ctx_get_plugin_stats().
+ * Does nothing if the timing was not started by ly_plugin_stats_start().
+ *
+ * @param[in] ctx Context of the plugin user.
+ * @param[in] start Start time from ly_plugin_stats_start().
+ * @param[in] clb Called callback.
+ * @param[in] module Name of the module with the extension or typedef, in the dictionary.
+ * @param[in] name Name of the extension or typedef, in the dictionary.
+ */
+void ly_plugin_stats_add(struct ly_ctx *ctx, const struct timespec *start, LY_PLUGIN_CLB clb, const char *module,
+                         const char *name);
+
+/* file of a module read in advance, see ly_ctx_prefetch_modules() */
+struct ly_ctx_prefetch {
+    const char *name;        /* module name and revision requested in yang-library data */
+    const char *revision;
+    char *filepath;          /* found module file, NULL if not found */
+    LYS_INFORMAT format;
+    char *data;              /* mapped file content */
+    size_t length;
+    struct lyxml_elem *xml;  /* parsed XML of a YIN module */
+};
+
+/* module source requested from the fetch callback, see ly_ctx_fetch_modules() */
+struct ly_fetch {
+    struct ly_fetch_set *set;
+    char *mod_name;          /* requested (sub)module */
+    char *mod_rev;
+    char *submod_name;
+    char *submod_rev;
+    uint8_t issued;          /* passed to the callback */
+    uint8_t done;            /* ly_fetch_done() called, set under the lock */
+    uint8_t scanned;         /* its imports and includes requested */
+    const char *data;        /* fetched source, NULL if not available */
+    LYS_INFORMAT format;
+    void (*free_module_data)(void *model_data, void *user_data);
+};
+
+/* sources being fetched by ly_ctx_fetch_modules() */
+struct ly_fetch_set {
+    ly_module_fetch_clb clb;
+    void *user_data;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;     /* signaled on every finished request */
+    struct ly_fetch **reqs;
+    uint32_t count;
+    uint32_t pending;        /* issued requests not finished yet, changed under the lock */
+};
+
 struct ly_modules_list {
     char **search_paths;
     int size;
@@ -35,10 +160,18 @@ struct ly_modules_list {
     uint8_t parsed_submodules_count;
     uint16_t module_set_id;
     int flags; /* see @ref contextoptions. */
+    struct ly_ctx_prefetch *prefetch; /* modules being loaded from yang-library data */
+    uint32_t prefetch_count;
+    struct ly_fetch_set *fetch;       /* sources of the modules being loaded by ly_ctx_fetch_modules() */
+#ifdef LY_ENABLED_CACHE
+    struct hash_table *name_ht; /* modules in the list by their name, see ly_ctx_module_hash_add() */
+    struct hash_table *ns_ht;   /* modules in the list by their namespace */
+    struct lys_search_index *search_index; /* files in the search directories, see lys_search_localfile_index() */
+#endif
 };
 
 struct ly_ctx {
-    struct dict_table dict;
+    struct dict_table *dict;        /* possibly shared with clones, see ly_ctx_clone() */
     struct ly_modules_list models;
     ly_module_imp_clb imp_clb;
     void *imp_clb_data;
@@ -48,7 +181,126 @@ struct ly_ctx {
     void *(*priv_dup_clb)(const void *priv);
 #endif
     pthread_key_t errlist_key;
+    uint32_t errlist_id;            /* unique ID of the context, see ly_err_list_get() */
     uint8_t internal_module_count;
+    uint16_t val_threads;
+    uint16_t data_ht_threshold;     /* see ly_ctx_set_data_hash_threshold() */
+    uint16_t print_threads;
+    ly_data_alloc_clb data_alloc;   /* see ly_ctx_set_data_allocator() */
+    ly_data_free_clb data_free;
+    void *data_alloc_data;
+    uint16_t free_threads;          /* see ly_ctx_set_free_threads() */
+    uint8_t private_vals;           /* see ly_ctx_set_private_values() */
+    uint16_t xpath_threads;         /* see ly_ctx_set_xpath_threads() */
+    pthread_mutex_t reclaim_lock;   /* data trees freed in the background, see lyd_free_deferred() */
+    pthread_cond_t reclaim_cond;
+    pthread_t reclaim_tid;
+    struct lyd_reclaim *reclaim_queue;
+    uint8_t reclaim_started;
+    uint8_t reclaim_stop;
+    uint8_t reclaim_busy;
+    atomic_uint_least64_t data_gen; /* data trees modification generation, see lyd_gen_bump() */
+    uint8_t val_prof;               /* see ly_ctx_set_val_profiling() */
+    struct hash_table *val_prof_ht; /* struct ly_val_prof records of the profiled constraints */
+    pthread_mutex_t val_prof_lock;
+    uint8_t stats_on;               /* see ly_ctx_set_stats() */
+    struct ly_stats stats;
+    struct hash_table *plugin_stats_ht; /* struct ly_plugin_stats records of the called plugin callbacks */
+    pthread_mutex_t plugin_stats_lock;
+    struct hash_table *bits_ht;     /* bits values shared by the data nodes, see lyd_bits_share() */
+    pthread_mutex_t bits_lock;
+    struct hash_table *binary_ht;   /* decoded binary values, see lyd_binary_value() */
+    pthread_mutex_t binary_lock;
+    struct hash_table *node_id_ht;  /* schema nodes by their stable IDs, see lys_node_id() */
+    uint16_t node_id_set_id;        /* module set ID the IDs were computed for */
+    uint32_t node_id_gen;           /* schema generation the IDs were computed for */
+    pthread_rwlock_t node_id_lock;
+    uint32_t schema_gen;            /* schema trees modification generation, see lys_children_changed() */
+#ifdef LY_ENABLED_CACHE
+    struct hash_table *regex_cache; /* compiled regular expressions, see lyp_regex_get() */
+    pthread_mutex_t regex_lock;
+    struct hash_table *child_hash;  /* schema children of the parents already searched, see lys_find_child_hash() */
+    uint16_t child_hash_set_id;     /* module set ID the children were hashed for */
+    uint32_t child_hash_gen;        /* schema generation the children were hashed for */
+    uint32_t feature_gen;           /* feature states generation, see lys_features_changed() */
+    pthread_rwlock_t child_hash_lock;
+    struct hash_table *mand_hash;   /* schema subtrees with mandatory nodes, see lys_mand_subtree() */
+    uint16_t mand_hash_set_id;      /* module set ID the subtrees were checked for */
+    pthread_rwlock_t mand_hash_lock;
+    struct hash_table *op_deps_hash; /* operations depending on external data, see lys_op_ext_deps() */
+    uint16_t op_deps_hash_set_id;   /* module set ID the operations were checked for */
+    pthread_rwlock_t op_deps_hash_lock;
+    struct hash_table *value_hash;  /* enums, bits and derived identities already searched, see lys_find_value_hash() */
+    uint16_t value_hash_set_id;     /* module set ID the definitions were hashed for */
+    pthread_rwlock_t value_hash_lock;
+    struct hash_table *ident_hash;  /* identities and their derivations, see lys_ident_derived_hash() */
+    uint16_t ident_hash_set_id;     /* module set ID the identities were hashed for */
+    pthread_rwlock_t ident_hash_lock;
+    struct hash_table *annot_hash;  /* annotation definitions of the modules already searched, see lys_find_annotation() */
+    uint16_t annot_hash_set_id;     /* module set ID the definitions were hashed for */
+    pthread_rwlock_t annot_hash_lock;
+    struct hash_table *lyb_hash;    /* LYB hashes of the schema siblings already printed, see lyb_sib_ht_get() */
+    uint16_t lyb_hash_set_id;       /* module set ID the siblings were hashed for */
+    pthread_rwlock_t lyb_hash_lock;
+    struct hash_table *schema_print; /* modules printed in YANG and YIN, see lys_print_cached() */
+    uint16_t schema_print_set_id;   /* module set ID the modules were printed for */
+    pthread_rwlock_t schema_print_lock;
+    struct hash_table *path_hash;   /* absolute schema paths already resolved, see lys_path_hash_find() */
+    uint16_t path_hash_set_id;      /* module set ID the paths were resolved for */
+    uint32_t path_hash_gen;         /* schema generation the paths were resolved for */
+    uint32_t path_hash_feature_gen; /* feature states generation the paths were resolved for */
+    pthread_rwlock_t path_hash_lock;
+    struct hash_table *ctx_map;     /* schema nodes of other contexts mapped into this one, see lys_get_schema_inctx() */
+    uint16_t ctx_map_set_id;        /* module set ID the nodes were mapped for */
+    uint32_t ctx_map_gen;           /* schema generation the nodes were mapped for */
+    pthread_rwlock_t ctx_map_lock;
+    struct lyd_node *info;          /* yang-library data of the context, see ly_ctx_info() */
+    uint16_t info_set_id;           /* module set ID the data were created for */
+    pthread_rwlock_t info_lock;
+    struct hash_table *data_side;   /* subtree filters and unique indexes of the data nodes, see lyd_side_get() */
+    pthread_rwlock_t data_side_lock;
+#endif
 };
 
+/**
+ * @brief Add a module into the hash tables of the context modules list,
+ * must be called whenever a module is added into the list.
+ *
+ * @param[in] ctx Context with the module.
+ * @param[in] mod Module to add.
+ * @return EXIT_SUCCESS on success, EXIT_FAILURE on error.
+ */
+int ly_ctx_module_hash_add(struct ly_ctx *ctx, struct lys_module *mod);
+
+/**
+ * @brief Remove a module from the hash tables of the context modules list,
+ * must be called whenever a module is removed from the list before it is freed.
+ *
+ * @param[in] ctx Context with the module.
+ * @param[in] mod Module to remove.
+ */
+void ly_ctx_module_hash_remove(struct ly_ctx *ctx, struct lys_module *mod);
+
+/**
+ * @brief Start timing an evaluation of a validated constraint if validation profiling is enabled.
+ *
+ * @param[in] ctx Context of the constraint.
+ * @param[out] start Start time, zeroed if profiling is disabled.
+ */
+void ly_val_prof_start(const struct ly_ctx *ctx, struct timespec *start);
+
+/**
+ * @brief Account a finished evaluation of a validated constraint, see ly_ctx_set_val_profiling().
+ * Does nothing if the timing was not started by ly_val_prof_start().
+ *
+ * @param[in] ctx Context of the constraint.
+ * @param[in] start Start time from ly_val_prof_start().
+ * @param[in] type Kind of the constraint.
+ * @param[in] node Schema node with the constraint.
+ * @param[in] expr Constraint expression in the dictionary, NULL if none.
+ * @param[in] nodes Number of data nodes in the result.
+ */
+void ly_val_prof_add(struct ly_ctx *ctx, const struct timespec *start, LY_VAL_PROF_TYPE type,
+                     const struct lys_node *node, const char *expr, uint32_t nodes);
+
 #endif /* LY_CONTEXT_H_ */
@@ -0,0 +1,590 @@
+/**
+ * @file filter.c
+ * @brief NETCONF subtree filters (RFC 6241 section 6) compiled for evaluating data trees
+ *
+ * Copyright (c) 2015 - 2018 CESNET, z.s.p.o.
+ *
+ * This source code is licensed under BSD 3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://opensource.org/licenses/BSD-3-Clause
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "context.h"
+#include "hash_table.h"
+#include "libyang.h"
+#include "parser.h"
+#include "tree_data.h"
+#include "tree_internal.h"
+#include "tree_schema.h"
+#include "xml_internal.h"
+
+/* data nodes a filter can descend into */
+#define FILTER_INNER (LYS_CONTAINER | LYS_LIST | LYS_RPC | LYS_ACTION | LYS_NOTIF)
+
+/* data node marks */
+#define FILTER_PARTIAL 1             /* some descendants are selected */
+#define FILTER_WHOLE 2               /* the whole subtree is selected */
+
+/**
+ * @brief Node of a compiled filter, a selection node has no value and no children, a content match node
+ * has a value and a containment node has children.
+ */
+struct filter_node {
+    const struct lys_node *schema;   /* bound schema node, NULL for a content match node that can never match */
+    const char *value;               /* canonical value of a content match node */
+    struct filter_node *child;       /* children, the content match nodes first */
+    uint32_t child_count;
+    uint32_t cm_count;               /* content match children */
+    const char **keys;               /* values of all the keys of a list given by content match children */
+    uint8_t none;                    /* containment node with no known children, selects nothing */
+#ifdef LY_ENABLED_CACHE
+    uint64_t bloom;                  /* subtree filter bits of the descendants every matching data node has */
+#endif
+};
+
+struct lyd_filter {
+    struct ly_ctx *ctx;
+    struct filter_node top;          /* parent of the top-level nodes */
+};
+
+/* evaluating a filter on a data tree */
+struct filter_apply {
+    struct hash_table *marks;        /* struct filter_mark of the selected data nodes */
+    struct ly_set *set;
+};
+
+struct filter_mark {
+    const struct lyd_node *node;
+    int mark;
+};
+
+static void
+filter_node_clean(struct ly_ctx *ctx, struct filter_node *fnode)
+{
+    uint32_t u;
+
+    for (u = 0; u < fnode->child_count; ++u) {
+        filter_node_clean(ctx, &fnode->child[u]);
+    }
+    free(fnode->child);
+    free(fnode->keys);
+    lydict_remove(ctx, fnode->value);
+}
+
+/* whether the element content is a value, not just formatting */
+static int
+filter_has_value(const struct lyxml_elem *xml)
+{
+    const char *c;
+
+    if (xml->child || !xml->content) {
+        return 0;
+    }
+    for (c = xml->content; *c && ((*c == ' ') || (*c == '\t') || (*c == '\n') || (*c == '\r')); ++c);
+    return *c ? 1 : 0;
+}
+
+/* the value in the canonical form, the same as stored in the data trees, NULL if it is not a valid value */
+static const char *
+filter_value(struct ly_ctx *ctx, const struct lys_node *snode, const struct lyxml_elem *xml)
+{
+    struct lyd_node_leaf_list leaf;
+    struct lys_type *type;
+    enum int_log_opts prev_ilo;
+
+    memset(&leaf, 0, sizeof leaf);
+    leaf.schema = (struct lys_node *)snode;
+    leaf.value_str = lydict_insert(ctx, xml->content, 0);
+
+    /* an invalid value never matches */
+    ly_ilo_change(NULL, ILO_IGNORE, &prev_ilo, NULL);
+    type = lyp_parse_value(&((struct lys_node_leaf *)snode)->type, &leaf.value_str, (struct lyxml_elem *)xml, &leaf,
+                           NULL, NULL, 1, 0, 0);
+    ly_ilo_restore(NULL, prev_ilo, NULL, 0);
+    if (!type) {
+        lydict_remove(ctx, leaf.value_str);
+        return NULL;
+    }
+
+    lyd_free_value(leaf.value, leaf.value_type, leaf.value_flags, &((struct lys_node_leaf *)snode)->type, NULL, NULL,
+                   NULL);
+    return leaf.value_str;
+}
+
+static int filter_compile_children(struct ly_ctx *ctx, const struct lyxml_elem *xml, const struct lys_node *sparent,
+                                   struct filter_node *fparent);
+
+static int
+filter_compile_node(struct ly_ctx *ctx, const struct lyxml_elem *xml, const struct lys_node *snode,
+                    struct filter_node *fnode)
+{
+    const struct lys_node_list *slist;
+    uint32_t u;
+    uint8_t k;
+
+    memset(fnode, 0, sizeof *fnode);
+    fnode->schema = snode;
+
+    if (filter_has_value(xml)) {
+        if (!snode) {
+            /* content match of an unknown node */
+            return 0;
+        } else if (!(snode->nodetype & (LYS_LEAF | LYS_LEAFLIST))) {
+            /* content match of other nodes is not defined, so it is a selection node */
+            return 0;
+        }
+        fnode->value = filter_value(ctx, snode, xml);
+        if (!fnode->value) {
+            fnode->schema = NULL;
+        }
+    } else if (xml->child && (snode->nodetype & FILTER_INNER)) {
+        /* containment node */
+        if (filter_compile_children(ctx, xml->child, snode, fnode)) {
+            return -1;
+        }
+        if (!fnode->child_count) {
+            fnode->none = 1;
+            return 0;
+        }
+
+        /* a list instance given by all its keys is found directly */
+        slist = (const struct lys_node_list *)snode;
+        if ((snode->nodetype == LYS_LIST) && slist->keys_size) {
+            fnode->keys = calloc(slist->keys_size, sizeof *fnode->keys);
+            LY_CHECK_ERR_RETURN(!fnode->keys, LOGMEM(ctx), -1);
+            for (k = 0; k < slist->keys_size; ++k) {
+                for (u = 0; u < fnode->cm_count; ++u) {
+                    if (fnode->child[u].schema == (struct lys_node *)slist->keys[k]) {
+                        fnode->keys[k] = fnode->child[u].value;
+                        break;
+                    }
+                }
+                if (u == fnode->cm_count) {
+                    free(fnode->keys);
+                    fnode->keys = NULL;
+                    break;
+                }
+            }
+        }
+
+#ifdef LY_ENABLED_CACHE
+        /* all the content match nodes must be there, otherwise the only child */
+        for (u = 0; u < fnode->cm_count; ++u) {
+            if (fnode->child[u].schema) {
+                fnode->bloom |= lyd_bloom_bits(fnode->child[u].schema->name, strlen(fnode->child[u].schema->name));
+            }
+        }
+        if (!fnode->cm_count && (fnode->child_count == 1)) {
+            fnode->bloom = lyd_bloom_bits(fnode->child[0].schema->name, strlen(fnode->child[0].schema->name))
+                    | fnode->child[0].bloom;
+        }
+#endif
+    }
+
+    return 0;
+}
+
+static int
+filter_add_child(struct ly_ctx *ctx, struct filter_node *fparent, const struct lyxml_elem *xml,
+                 const struct lys_node *snode)
+{
+    struct filter_node fnode, *child;
+
+    if (filter_compile_node(ctx, xml, snode, &fnode)) {
+        filter_node_clean(ctx, &fnode);
+        return -1;
+    }
+
+    child = realloc(fparent->child, (fparent->child_count + 1) * sizeof *fparent->child);
+    LY_CHECK_ERR_RETURN(!child, filter_node_clean(ctx, &fnode); LOGMEM(ctx), -1);
+    fparent->child = child;
+
+    if (fnode.value || !fnode.schema) {
+        /* content match nodes go first */
+        memmove(&child[fparent->cm_count + 1], &child[fparent->cm_count],
+                (fparent->child_count - fparent->cm_count) * sizeof *child);
+        child[fparent->cm_count] = fnode;
+        ++fparent->cm_count;
+    } else {
+        child[fparent->child_count] = fnode;
+    }
+    ++fparent->child_count;
+
+    return 0;
+}
+
+/* bind the children to the schema nodes, an element with no namespace matches the nodes of all the modules */
+static int
+filter_compile_children(struct ly_ctx *ctx, const struct lyxml_elem *xml, const struct lys_node *sparent,
+                        struct filter_node *fparent)
+{
+    const struct lyxml_elem *child;
+    const struct lys_module *mod;
+    const struct lys_node *snode;
+    uint32_t idx;
+    int found;
+
+    LY_TREE_FOR(xml, child) {
+        if (!child->name) {
+            /* text of a mixed content */
+            continue;
+        }
+
+        found = 0;
+        idx = 0;
+        do {
+            if (sparent) {
+                mod = NULL;
+            } else if (child->ns) {
+                mod = ly_ctx_get_module_by_ns(ctx, child->ns->value, NULL, 1);
+                if (!mod) {
+                    break;
+                }
+            } else {
+                mod = ly_ctx_get_module_iter(ctx, &idx);
+                if (!mod) {
+                    break;
+                }
+                if (!mod->implemented) {
+                    continue;
+                }
+            }
+
+            snode = NULL;
+            while ((snode = lys_getnext(snode, sparent, mod, 0))) {
+                if (strcmp(snode->name, child->name)
+                        || (child->ns && strcmp(lys_node_module(snode)->ns, child->ns->value))) {
+                    continue;
+                }
+                if (filter_add_child(ctx, fparent, child, snode)) {
+                    return -1;
+                }
+                found = 1;
+            }
+        } while (!sparent && !child->ns);
+
+        /* an unknown node that is not a content match does not select anything */
+        if (!found && filter_has_value(child) && filter_add_child(ctx, fparent, child, NULL)) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+API struct lyd_filter *
+lyd_filter_compile(struct ly_ctx *ctx, const char *filter)
+{
+    struct lyd_filter *f;
+    struct lyxml_elem *xml = NULL;
+    const char *c;
+
+    if (!ctx || !filter) {
+        LOGARG;
+        return NULL;
+    }
+
+    f = calloc(1, sizeof *f);
+    LY_CHECK_ERR_RETURN(!f, LOGMEM(ctx), NULL);
+    f->ctx = ctx;
+
+    /* an empty filter selects nothing */
+    for (c = filter; *c && ((*c == ' ') || (*c == '\t') || (*c == '\n') || (*c == '\r')); ++c);
+    if (*c) {
+        xml = lyxml_parse_mem(ctx, c, LYXML_PARSE_MULTIROOT);
+        if (!xml || filter_compile_children(ctx, xml, NULL, &f->top)) {
+            goto error;
+        }
+    }
+
+    lyxml_free_withsiblings(ctx, xml);
+    return f;
+
+error:
+    lyxml_free_withsiblings(ctx, xml);
+    lyd_filter_free(f);
+    return NULL;
+}
+
+API void
+lyd_filter_free(struct lyd_filter *filter)
+{
+    if (!filter) {
+        return;
+    }
+
+    filter_node_clean(filter->ctx, &filter->top);
+    free(filter);
+}
+
+static int
+filter_mark_equal(void *val1_p, void *val2_p, int UNUSED(mod), void *UNUSED(cb_data))
+{
+    return ((struct filter_mark *)val1_p)->node == ((struct filter_mark *)val2_p)->node;
+}
+
+static uint32_t
+filter_mark_hash(const struct lyd_node *node)
+{
+    uint32_t hash;
+
+    hash = dict_hash_multi(0, (const char *)&node, sizeof node);
+    return dict_hash_multi(hash, NULL, 0);
+}
+
+/* the whole subtree mark is kept over a partial one */
+static int
+filter_mark(struct filter_apply *a, const struct lyd_node *node, int mark)
+{
+    struct filter_mark rec, *found;
+
+    rec.node = node;
+    rec.mark = mark;
+    switch (lyht_insert(a->marks, &rec, filter_mark_hash(node), (void **)&found)) {
+    case 0:
+        return 0;
+    case 1:
+        if (mark > found->mark) {
+            found->mark = mark;
+        }
+        return 0;
+    default:
+        return -1;
+    }
+}
+
+static int
+filter_mark_get(struct filter_apply *a, const struct lyd_node *node)
+{
+    struct filter_mark rec, *found;
+
+    rec.node = node;
+    if (lyht_find(a->marks, &rec, filter_mark_hash(node), (void **)&found)) {
+        return 0;
+    }
+    return found->mark;
+}
+
+/* content match nodes are looked up in the hash table of the siblings */
+static const struct lyd_node *
+filter_find_value(const struct lyd_node *first, const struct filter_node *fnode)
+{
+    const struct lyd_node *match;
+
+    if (fnode->schema->nodetype == LYS_LEAFLIST) {
+        return lyd_find_sibling_val(first, fnode->schema, (const char **)&fnode->value);
+    }
+
+    match = lyd_find_sibling_val(first, fnode->schema, NULL);
+    if (match && !ly_strequal(((struct lyd_node_leaf_list *)match)->value_str, fnode->value, 0)) {
+        match = NULL;
+    }
+    return match;
+}
+
+static int filter_match_node(struct filter_apply *a, const struct filter_node *fnode, const struct lyd_node *node);
+
+/**
+ * @brief Evaluate the children of a filter node on data siblings, the selected data nodes are marked.
+ *
+ * @param[in] a Evaluation.
+ * @param[in] fparent Filter node with the children to evaluate.
+ * @param[in] first First data sibling, NULL if there are none.
+ * @param[in] top Whether the siblings are the top-level data nodes.
+ * @return 0 if the siblings do not match, 1 if some nodes were selected, 2 if all the siblings are selected,
+ * -1 on error.
+ */
+static int
+filter_match_r(struct filter_apply *a, const struct filter_node *fparent, const struct lyd_node *first, int top)
+{
+    const struct filter_node *fnode;
+    const struct lyd_node *iter;
+    uint32_t u;
+    int r, ret = 0;
+
+    /* all the content match nodes must match */
+    for (u = 0; u < fparent->cm_count; ++u) {
+        if (!first || !fparent->child[u].schema || !filter_find_value(first, &fparent->child[u])) {
+            return 0;
+        }
+    }
+    if (fparent->cm_count && (fparent->cm_count == fparent->child_count) && !top) {
+        return 2;
+    }
+
+    /* the content match nodes are selected with the other nodes */
+    for (u = 0; u < fparent->cm_count; ++u) {
+        if (filter_mark(a, filter_find_value(first, &fparent->child[u]), FILTER_WHOLE)) {
+            return -1;
+        }
+        ret = 1;
+    }
+
+    for (u = fparent->cm_count; first && (u < fparent->child_count); ++u) {
+        fnode = &fparent->child[u];
+        if (fnode->keys) {
+            iter = lyd_find_sibling_val(first, fnode->schema, fnode->keys);
+            r = iter ? filter_match_node(a, fnode, iter) : 0;
+            if (r == -1) {
+                return -1;
+            }
+            ret |= r;
+            continue;
+        }
+
+        LY_TREE_FOR(first, iter) {
+            if (iter->schema != fnode->schema) {
+                continue;
+            }
+            r = filter_match_node(a, fnode, iter);
+            if (r == -1) {
+                return -1;
+            }
+            ret |= r;
+        }
+    }
+
+    return ret;
+}
+
+static int
+filter_match_node(struct filter_apply *a, const struct filter_node *fnode, const struct lyd_node *node)
+{
+    int r;
+
+    if (fnode->none) {
+        return 0;
+    } else if (!fnode->child_count) {
+        /* selection node */
+        return filter_mark(a, node, FILTER_WHOLE) ? -1 : 1;
+    }
+
+    /* containment node */
+#ifdef LY_ENABLED_CACHE
+    if (fnode->bloom && !lyd_bloom_contains((struct lyd_node *)node, fnode->bloom)) {
+        /* the subtree does not have the required descendants */
+        return 0;
+    }
+#endif
+    r = filter_match_r(a, fnode, node->child, 0);
+    if (r > 0) {
+        return filter_mark(a, node, (r == 2) ? FILTER_WHOLE : FILTER_PARTIAL) ? -1 : 1;
+    }
+    return r;
+}
+
+/* duplicate or collect the marked data nodes */
+static int
+filter_output_r(struct filter_apply *a, const struct lyd_node *first, struct lyd_node *rparent, struct lyd_node **rfirst)
+{
+    const struct lyd_node *iter, *key;
+    struct lyd_node *dup, *key_dup;
+    int mark;
+
+    LY_TREE_FOR(first, iter) {
+        mark = filter_mark_get(a, iter);
+        if (!mark || (rparent && (iter->schema->nodetype == LYS_LEAF)
+                && lys_is_key((const struct lys_node_leaf *)iter->schema, NULL))) {
+            /* not selected, or a list key already duplicated with its list */
+            continue;
+        }
+
+        if (a->set) {
+            if ((mark == FILTER_WHOLE) ? (ly_set_add(a->set, (void *)iter, LY_SET_OPT_USEASLIST) == -1)
+                    : filter_output_r(a, iter->child, NULL, NULL)) {
+                return -1;
+            }
+            continue;
+        }
+
+        dup = lyd_dup(iter, (mark == FILTER_WHOLE) ? LYD_DUP_OPT_RECURSIVE : 0);
+        if (!dup) {
+            return -1;
+        }
+        if (!rparent && !*rfirst) {
+            *rfirst = dup;
+        } else if (rparent ? lyd_insert(rparent, dup) : lyd_insert_sibling(rfirst, dup)) {
+            lyd_free(dup);
+            return -1;
+        }
+        if (mark == FILTER_WHOLE) {
+            continue;
+        }
+
+        /* list instances are always returned with their keys */
+        if (iter->schema->nodetype == LYS_LIST) {
+            LY_TREE_FOR(iter->child, key) {
+                if ((key->schema->nodetype != LYS_LEAF) || !lys_is_key((const struct lys_node_leaf *)key->schema, NULL)) {
+                    continue;
+                }
+                key_dup = lyd_dup(key, 0);
+                if (!key_dup || lyd_insert(dup, key_dup)) {
+                    lyd_free(key_dup);
+                    return -1;
+                }
+            }
+        }
+        if (filter_output_r(a, iter->child, dup, NULL)) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+API int
+lyd_filter_apply(const struct lyd_filter *filter, const struct lyd_node *root, struct lyd_node **result,
+                 struct ly_set **set)
+{
+    struct filter_apply a;
+    struct lyd_node *first = NULL;
+    int ret = -1;
+
+    if (!filter || ((result != NULL) == (set != NULL)) || (root && (lyd_node_module(root)->ctx != filter->ctx))) {
+        LOGARG;
+        return -1;
+    }
+    if (result) {
+        *result = NULL;
+    } else {
+        *set = NULL;
+    }
+
+    memset(&a, 0, sizeof a);
+    a.marks = lyht_new(64, sizeof(struct filter_mark), filter_mark_equal, NULL, 1);
+    LY_CHECK_ERR_RETURN(!a.marks, LOGMEM(filter->ctx), -1);
+    if (set) {
+        a.set = ly_set_new();
+        LY_CHECK_ERR_GOTO(!a.set, LOGMEM(filter->ctx), cleanup);
+    }
+
+    if (root) {
+        /* the top-level siblings of the whole data tree */
+        for (; root->parent; root = root->parent);
+        for (; root->prev->next; root = root->prev);
+    }
+
+    if ((filter_match_r(&a, &filter->top, root, 1) == -1) || filter_output_r(&a, root, NULL, &first)) {
+        lyd_free_withsiblings(first);
+        goto cleanup;
+    }
+
+    if (result) {
+        *result = first;
+    } else {
+        *set = a.set;
+        a.set = NULL;
+    }
+    ret = 0;
+
+cleanup:
+    lyht_free(a.marks);
+    ly_set_free(a.set);
+    return ret;
+}
@@ -17,112 +17,211 @@
 #include <stdlib.h>
 #include <pthread.h>
 #include <assert.h>
+#if defined(__SSE2__)
+# include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+# include <arm_neon.h>
+#endif
 
 #include "common.h"
 #include "context.h"
 #include "hash_table.h"
 
 static int
-lydict_val_eq(void *val1_p, void *val2_p, int UNUSED(mod), void *cb_data)
+lydict_val_eq(void *val1_p, void *val2_p, int UNUSED(mod), void *UNUSED(cb_data))
 {
-    if (!val1_p || !val2_p) {
-        LOGARG;
-        return 0;
-    }
+    const struct dict_rec *rec1 = val1_p, *rec2 = val2_p;
 
-    const char *str1 = ((struct dict_rec *)val1_p)->value;
-    const char *str2 = ((struct dict_rec *)val2_p)->value;
-
-    if (!str1 || !str2 || !cb_data) {
+    if (!rec1 || !rec2 || !rec1->value || !rec2->value) {
         LOGARG;
         return 0;
     }
 
-    if (strncmp(str1, str2, *(size_t *)cb_data) == 0) {
-        return 1;
-    }
-
-    return 0;
+    /* the value of rec1 may not be terminated */
+    return (rec1->len == rec2->len) && !memcmp(rec1->value, rec2->value, rec1->len);
 }
 
 void
 lydict_init(struct dict_table *dict)
 {
+    unsigned int i;
+
     if (!dict) {
         LOGARG;
         return;
     }
 
-    dict->hash_tab = lyht_new(1024, sizeof(struct dict_rec), lydict_val_eq, NULL, 1);
-    LY_CHECK_ERR_RETURN(!dict->hash_tab, LOGINT(NULL), );
-    pthread_mutex_init(&dict->lock, NULL);
+    for (i = 0; i < LYDICT_SHARDS; i++) {
+        dict->shards[i].hash_tab = lyht_new(1024 / LYDICT_SHARDS, sizeof(struct dict_rec), lydict_val_eq, NULL,
+                                            1 | LYHT_RESIZE_INCREMENTAL);
+        LY_CHECK_ERR_RETURN(!dict->shards[i].hash_tab, LOGINT(NULL), );
+        pthread_rwlock_init(&dict->shards[i].lock, NULL);
+        dict->shards[i].str_size = 0;
+    }
 }
 
 void
 lydict_clean(struct dict_table *dict)
 {
-    unsigned int i;
+    unsigned int i, j;
     struct dict_rec *dict_rec  = NULL;
     struct ht_rec *rec = NULL;
+    struct hash_table *ht;
 
     if (!dict) {
         LOGARG;
         return;
     }
 
-    for (i = 0; i < dict->hash_tab->size; i++) {
-        /* get ith record */
-        rec = (struct ht_rec *)&dict->hash_tab->recs[i * dict->hash_tab->rec_size];
-        if (rec->hits == 1) {
-            /*
-             * this should not happen, all records inserted into
-             * dictionary are supposed to be removed using lydict_remove()
-             * before calling lydict_clean()
-             */
-            dict_rec  = (struct dict_rec *)rec->val;
-            LOGWRN(NULL, "String \"%s\" not freed from the dictionary, refcount %d", dict_rec->value, dict_rec->refcount);
-            /* if record wasn't removed before free string allocated for that record */
+    for (j = 0; j < LYDICT_SHARDS; j++) {
+        ht = dict->shards[j].hash_tab;
+        lyht_resize_finish(ht);
+        for (i = 0; i < ht->size; i++) {
+            /* get ith record */
+            if (ht->ctrl[i] & LYHT_CTRL_FULL) {
+                /*
+                 * this should not happen, all records inserted into
+                 * dictionary are supposed to be removed using lydict_remove()
+                 * before calling lydict_clean()
+                 */
+                rec = lyht_get_rec(ht->recs, ht->rec_size, i);
+                dict_rec  = (struct dict_rec *)rec->val;
+                LOGWRN(NULL, "String \"%s\" not freed from the dictionary, refcount %u", dict_rec->value,
+                       (uint32_t)atomic_load(&dict_rec->refcount));
+                /* if record wasn't removed before free string allocated for that record */
 #ifdef NDEBUG
-            free(dict_rec->value);
+                free(dict_rec->value);
 #endif
+            }
         }
+
+        /* free table and destroy lock */
+        lyht_free(ht);
+        pthread_rwlock_destroy(&dict->shards[j].lock);
     }
+}
+
+struct dict_table *
+lydict_new(void)
+{
+    struct dict_table *dict;
+
+    dict = malloc(sizeof *dict);
+    LY_CHECK_ERR_RETURN(!dict, LOGMEM(NULL), NULL);
+    lydict_init(dict);
+    atomic_init(&dict->refs, 1);
 
-    /* free table and destroy mutex */
-    lyht_free(dict->hash_tab);
-    pthread_mutex_destroy(&dict->lock);
+    return dict;
+}
+
+struct dict_table *
+lydict_ref(struct dict_table *dict)
+{
+    atomic_fetch_add_explicit(&dict->refs, 1, memory_order_relaxed);
+    return dict;
+}
+
+void
+lydict_free(struct dict_table *dict)
+{
+    if (!dict) {
+        return;
+    }
+
+    /* the last context releasing the dictionary has removed all its references, nothing else can access it */
+    if (atomic_fetch_sub_explicit(&dict->refs, 1, memory_order_acq_rel) == 1) {
+        lydict_clean(dict);
+        free(dict);
+    }
+}
+
+size_t
+lydict_mem_size(struct dict_table *dict)
+{
+    size_t size = 0;
+    unsigned int i;
+
+    for (i = 0; i < LYDICT_SHARDS; i++) {
+        pthread_rwlock_rdlock(&dict->shards[i].lock);
+        size += lyht_mem_size(dict->shards[i].hash_tab) + dict->shards[i].str_size;
+        pthread_rwlock_unlock(&dict->shards[i].lock);
+    }
+
+    return size;
+}
+
+uint32_t
+lydict_count(struct dict_table *dict)
+{
+    uint32_t count = 0;
+    unsigned int i;
+
+    for (i = 0; i < LYDICT_SHARDS; i++) {
+        pthread_rwlock_rdlock(&dict->shards[i].lock);
+        count += dict->shards[i].hash_tab->used;
+        pthread_rwlock_unlock(&dict->shards[i].lock);
+    }
+
+    return count;
 }
 
 /*
- * Bob Jenkin's one-at-a-time hash
- * http://www.burtleburtle.net/bob/hash/doobs.html
- *
- * Spooky hash is faster, but it works only for little endian architectures.
+ * The hash processes the keys 8 bytes at a time, every part is folded into the 32-bit hash with its length,
+ * so the hash depends on how the key is split into parts. Its values are only kept in memory, they differ
+ * between architectures of different endianness.
  */
-static uint32_t
-dict_hash(const char *key, size_t len)
+#define DICT_HASH_PRIME1 0x9E3779B185EBCA87ULL
+#define DICT_HASH_PRIME2 0xC2B2AE3D27D4EB4FULL
+
+static inline uint64_t
+dict_hash_round(uint64_t acc, uint64_t word)
+{
+    acc ^= word * DICT_HASH_PRIME2;
+    acc = (acc << 31) | (acc >> 33);
+    return acc * DICT_HASH_PRIME1;
+}
+
+uint32_t
+dict_hash_multi(uint32_t hash, const char *key_part, size_t len)
 {
-    uint32_t hash, i;
+    uint64_t acc, word;
+
+    if (!key_part) {
+        /* finish with a final avalanche so that all the bits of the hash are usable */
+        hash ^= hash >> 16;
+        hash *= 0x85EBCA6BU;
+        hash ^= hash >> 13;
+        hash *= 0xC2B2AE35U;
+        hash ^= hash >> 16;
+        return hash;
+    }
 
-    for (hash = i = 0; i < len; ++i) {
-        hash += key[i];
-        hash += (hash << 10);
-        hash ^= (hash >> 6);
+    acc = hash ^ (len * DICT_HASH_PRIME1);
+    for (; len >= sizeof word; len -= sizeof word, key_part += sizeof word) {
+        memcpy(&word, key_part, sizeof word);
+        acc = dict_hash_round(acc, word);
     }
-    hash += (hash << 3);
-    hash ^= (hash >> 11);
-    hash += (hash << 15);
-    return hash;
+    if (len) {
+        word = 0;
+        memcpy(&word, key_part, len);
+        acc = dict_hash_round(acc, word);
+    }
+
+    return (uint32_t)(acc ^ (acc >> 32));
+}
+
+static uint32_t
+dict_hash(const char *key, size_t len)
+{
+    return dict_hash_multi(dict_hash_multi(0, key, len), NULL, 0);
 }
 
 /*
- * Usage:
- * - init hash to 0
- * - repeatedly call dict_hash_multi(), provide hash from the last call
- * - call dict_hash_multi() with key_part = NULL to finish the hash
+ * Bob Jenkin's one-at-a-time hash
+ * http://www.burtleburtle.net/bob/hash/doobs.html
  */
 uint32_t
-dict_hash_multi(uint32_t hash, const char *key_part, size_t len)
+dict_hash_multi_oaat(uint32_t hash, const char *key_part, size_t len)
 {
     uint32_t i;
 
@@ -141,76 +240,223 @@ dict_hash_multi(uint32_t hash, const char *key_part, size_t len)
     return hash;
 }
 
+/* the lowest bits of the hash select the record in the hash table, so use the highest ones */
+#define DICT_SHARD(ctx, hash) (&(ctx)->dict->shards[(hash) >> (32 - LYDICT_SHARD_BITS)])
+
+/*
+ * Reference counts of the stored values are changed atomically with only the shard read lock held,
+ * the write lock is taken only to add a new value or to remove one with no references left. The shard
+ * lock orders all the accesses to the values themselves, so the reference counts need no ordering.
+ */
+
+/**
+ * @brief Decrease the reference count of a stored value unless it would drop to zero.
+ *
+ * @param[in] rec Stored dictionary record.
+ * @return 0 if decreased, 1 if it is the last reference.
+ */
+static int
+dict_unref_shared(struct dict_rec *rec)
+{
+    uint32_t refcount = atomic_load_explicit(&rec->refcount, memory_order_relaxed);
+
+    while (refcount > 1) {
+        if (atomic_compare_exchange_weak_explicit(&rec->refcount, &refcount, refcount - 1, memory_order_relaxed,
+                                                  memory_order_relaxed)) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/* the shard write lock must be held */
+static void
+dict_remove_locked(struct ly_ctx *ctx, struct dict_shard *shard, struct dict_rec *rec, uint32_t hash)
+{
+    struct dict_rec *match = NULL;
+    char *val_p;
+
+    LY_CHECK_ERR_RETURN(lyht_find(shard->hash_tab, rec, hash, (void **)&match), LOGINT(ctx), );
+
+    if (atomic_fetch_sub_explicit(&match->refcount, 1, memory_order_relaxed) == 1) {
+        /*
+         * remove record
+         * save pointer to stored string before lyht_remove to
+         * free it after it is removed from hash table
+         */
+        val_p = match->value;
+        if (lyht_remove(shard->hash_tab, rec, hash)) {
+            LOGINT(ctx);
+        }
+        free(val_p);
+        shard->str_size -= rec->len + 1;
+    }
+}
+
+/**
+ * @brief Lock a dictionary shard, waiting for another thread is counted in the statistics of the context.
+ *
+ * @param[in] ctx Context for the statistics.
+ * @param[in] shard Dictionary shard to lock.
+ * @param[in] write Whether to get the write lock or the read lock.
+ */
+static void
+dict_lock(struct ly_ctx *ctx, struct dict_shard *shard, int write)
+{
+    if (ctx->stats_on) {
+        if (!(write ? pthread_rwlock_trywrlock(&shard->lock) : pthread_rwlock_tryrdlock(&shard->lock))) {
+            return;
+        }
+        LY_STATS_ADD(ctx, dict_lock_waits, 1);
+    }
+
+    if (write) {
+        pthread_rwlock_wrlock(&shard->lock);
+    } else {
+        pthread_rwlock_rdlock(&shard->lock);
+    }
+}
+
+/* maximum number of removals collected by a batch before they are applied */
+#define DICT_BATCH_MAX 1024
+
+/* removals collected by the current thread, see lydict_batch_start() */
+static THREAD_LOCAL struct {
+    struct ly_ctx *ctx;
+    uint32_t depth;
+    uint32_t count;
+    struct dict_batch_rec {
+        const char *value;
+        size_t len;
+        uint32_t hash;
+    } *recs;
+} dict_batch;
+
+void
+lydict_batch_start(struct ly_ctx *ctx)
+{
+    if (!dict_batch.depth++) {
+        dict_batch.ctx = ctx;
+        dict_batch.count = 0;
+        /* without the array the values are removed right away */
+        dict_batch.recs = malloc(DICT_BATCH_MAX * sizeof *dict_batch.recs);
+    }
+}
+
+static void
+dict_batch_flush(void)
+{
+    struct ly_ctx *ctx = dict_batch.ctx;
+    struct dict_shard *shard;
+    struct dict_rec rec;
+    uint32_t i, j;
+
+    /* each shard is locked once for all its removals */
+    for (i = 0; dict_batch.count && (i < LYDICT_SHARDS); ++i) {
+        shard = &ctx->dict->shards[i];
+        dict_lock(ctx, shard, 1);
+        for (j = 0; j < dict_batch.count; ) {
+            if (DICT_SHARD(ctx, dict_batch.recs[j].hash) != shard) {
+                ++j;
+                continue;
+            }
+
+            rec.value = (char *)dict_batch.recs[j].value;
+            rec.len = dict_batch.recs[j].len;
+            dict_remove_locked(ctx, shard, &rec, dict_batch.recs[j].hash);
+
+            /* the order of the remaining removals does not matter */
+            dict_batch.recs[j] = dict_batch.recs[--dict_batch.count];
+        }
+        pthread_rwlock_unlock(&shard->lock);
+    }
+}
+
+void
+lydict_batch_stop(void)
+{
+    assert(dict_batch.depth);
+
+    if (!--dict_batch.depth) {
+        dict_batch_flush();
+        free(dict_batch.recs);
+        dict_batch.recs = NULL;
+        dict_batch.ctx = NULL;
+    }
+}
+
 API void
 lydict_remove(struct ly_ctx *ctx, const char *value)
 {
-    size_t len;
     int ret;
     uint32_t hash;
     struct dict_rec rec, *match = NULL;
-    char *val_p;
+    struct dict_shard *shard;
 
     if (!value || !ctx) {
         return;
     }
 
-    len = strlen(value);
-    hash = dict_hash(value, len);
-
     /* create record for lyht_find call */
     rec.value = (char *)value;
-    rec.refcount = 0;
+    rec.len = strlen(value);
+    hash = dict_hash(value, rec.len);
 
-    pthread_mutex_lock(&ctx->dict.lock);
-    /* set len as data for compare callback */
-    lyht_set_cb_data(ctx->dict.hash_tab, (void *)&len);
-    /* check if value is already inserted */
-    ret = lyht_find(ctx->dict.hash_tab, &rec, hash, (void **)&match);
+    if (dict_batch.recs && (dict_batch.ctx->dict == ctx->dict)) {
+        /* the removal is only collected, the value remains valid until the batch is applied */
+        if (dict_batch.count == DICT_BATCH_MAX) {
+            dict_batch_flush();
+        }
+        dict_batch.recs[dict_batch.count].value = value;
+        dict_batch.recs[dict_batch.count].len = rec.len;
+        dict_batch.recs[dict_batch.count].hash = hash;
+        ++dict_batch.count;
+        return;
+    }
 
-    if (ret == 0) {
-        LY_CHECK_ERR_GOTO(!match, LOGINT(ctx), finish);
+    shard = DICT_SHARD(ctx, hash);
 
-        /* if value is already in dictionary, decrement reference counter */
-        match->refcount--;
-        if (match->refcount == 0) {
-            /*
-             * remove record
-             * save pointer to stored string before lyht_remove to
-             * free it after it is removed from hash table
-             */
-            val_p = match->value;
-            ret = lyht_remove(ctx->dict.hash_tab, &rec, hash);
-            free(val_p);
-            LY_CHECK_ERR_GOTO(ret, LOGINT(ctx), finish);
-        }
+    /* other references remain, the table itself is not changed */
+    dict_lock(ctx, shard, 0);
+    ret = lyht_find(shard->hash_tab, &rec, hash, (void **)&match);
+    if (!ret && !dict_unref_shared(match)) {
+        pthread_rwlock_unlock(&shard->lock);
+        return;
+    }
+    pthread_rwlock_unlock(&shard->lock);
+    if (ret) {
+        return;
     }
 
-finish:
-    pthread_mutex_unlock(&ctx->dict.lock);
+    /* last reference, unless another was added in the meantime */
+    dict_lock(ctx, shard, 1);
+    dict_remove_locked(ctx, shard, &rec, hash);
+    pthread_rwlock_unlock(&shard->lock);
 }
 
+/* the shard write lock must be held */
 static char *
-dict_insert(struct ly_ctx *ctx, char *value, size_t len, int zerocopy)
+dict_insert(struct ly_ctx *ctx, struct dict_shard *shard, char *value, size_t len, uint32_t hash, int zerocopy)
 {
     struct dict_rec *match = NULL, rec;
     int ret = 0;
-    uint32_t hash;
 
-    hash = dict_hash(value, len);
-    /* set len as data for compare callback */
-    lyht_set_cb_data(ctx->dict.hash_tab, (void *)&len);
     /* create record for lyht_insert */
     rec.value = value;
-    rec.refcount = 1;
+    rec.len = len;
+    atomic_init(&rec.refcount, 1);
 
-    LOGDBG(LY_LDGDICT, "inserting \"%s\"", rec.value);
-    ret = lyht_insert(ctx->dict.hash_tab, (void *)&rec, hash, (void **)&match);
+    LOGDBG(LY_LDGDICT, "inserting \"%.*s\"", (int)len, rec.value);
+    ret = lyht_insert(shard->hash_tab, (void *)&rec, hash, (void **)&match);
     if (ret == 1) {
-        match->refcount++;
+        atomic_fetch_add_explicit(&match->refcount, 1, memory_order_relaxed);
+        LY_STATS_ADD(ctx, dict_hits, 1);
         if (zerocopy) {
             free(value);
         }
     } else if (ret == 0) {
+        shard->str_size += len + 1;
         if (!zerocopy) {
             /*
              * allocate string for new record
@@ -230,10 +476,43 @@ dict_insert(struct ly_ctx *ctx, char *value, size_t len, int zerocopy)
     return match->value;
 }
 
+/**
+ * @brief Add a reference to an already stored value, the table is only read.
+ *
+ * @param[in] ctx Context for the statistics.
+ * @param[in] shard Dictionary shard of the value.
+ * @param[in] value Value to find, does not have to be terminated.
+ * @param[in] len Length of \p value.
+ * @param[in] hash Hash of \p value.
+ * @return Stored value, NULL if not stored.
+ */
+static char *
+dict_ref_shared(struct ly_ctx *ctx, struct dict_shard *shard, const char *value, size_t len, uint32_t hash)
+{
+    struct dict_rec *match = NULL, rec;
+    char *result = NULL;
+
+    rec.value = (char *)value;
+    rec.len = len;
+
+    dict_lock(ctx, shard, 0);
+    if (!lyht_find(shard->hash_tab, &rec, hash, (void **)&match)) {
+        /* the last reference can be removed only with the write lock, so the value cannot disappear */
+        atomic_fetch_add_explicit(&match->refcount, 1, memory_order_relaxed);
+        LY_STATS_ADD(ctx, dict_hits, 1);
+        result = match->value;
+    }
+    pthread_rwlock_unlock(&shard->lock);
+
+    return result;
+}
+
 API const char *
 lydict_insert(struct ly_ctx *ctx, const char *value, size_t len)
 {
     const char *result;
+    struct dict_shard *shard;
+    uint32_t hash;
 
     if (!value) {
         return NULL;
@@ -243,9 +522,15 @@ lydict_insert(struct ly_ctx *ctx, const char *value, size_t len)
         len = strlen(value);
     }
 
-    pthread_mutex_lock(&ctx->dict.lock);
-    result = dict_insert(ctx, (char *)value, len, 0);
-    pthread_mutex_unlock(&ctx->dict.lock);
+    hash = dict_hash(value, len);
+    shard = DICT_SHARD(ctx, hash);
+    LY_STATS_ADD(ctx, dict_inserts, 1);
+    result = dict_ref_shared(ctx, shard, value, len, hash);
+    if (!result) {
+        dict_lock(ctx, shard, 1);
+        result = dict_insert(ctx, shard, (char *)value, len, hash, 0);
+        pthread_rwlock_unlock(&shard->lock);
+    }
 
     return result;
 }
@@ -254,24 +539,291 @@ API const char *
 lydict_insert_zc(struct ly_ctx *ctx, char *value)
 {
     const char *result;
+    struct dict_shard *shard;
+    uint32_t hash;
+    size_t len;
 
     if (!value) {
         return NULL;
     }
 
-    pthread_mutex_lock(&ctx->dict.lock);
-    result = dict_insert(ctx, value, strlen(value), 1);
-    pthread_mutex_unlock(&ctx->dict.lock);
+    len = strlen(value);
+    hash = dict_hash(value, len);
+    shard = DICT_SHARD(ctx, hash);
+    LY_STATS_ADD(ctx, dict_inserts, 1);
+    result = dict_ref_shared(ctx, shard, value, len, hash);
+    if (result) {
+        free(value);
+    } else {
+        dict_lock(ctx, shard, 1);
+        result = dict_insert(ctx, shard, value, len, hash, 1);
+        pthread_rwlock_unlock(&shard->lock);
+    }
 
     return result;
 }
 
+const char *
+lydict_insert_priv(struct ly_ctx *ctx, const char *value, size_t len, int priv)
+{
+    char *str;
+
+    if (!priv) {
+        return lydict_insert(ctx, value, len);
+    } else if (!value) {
+        return NULL;
+    }
+
+    if (!len) {
+        len = strlen(value);
+    }
+    str = malloc(len + 1);
+    LY_CHECK_ERR_RETURN(!str, LOGMEM(ctx), NULL);
+    memcpy(str, value, len);
+    str[len] = '\0';
+
+    return str;
+}
+
+const char *
+lydict_insert_zc_priv(struct ly_ctx *ctx, char *value, int priv)
+{
+    if (!priv) {
+        return lydict_insert_zc(ctx, value);
+    }
+    return value;
+}
+
+void
+lydict_remove_priv(struct ly_ctx *ctx, const char *value, int priv)
+{
+    if (!priv) {
+        lydict_remove(ctx, value);
+    } else {
+        free((char *)value);
+    }
+}
+
+size_t
+lydict_val_mem_size(struct ly_ctx *ctx, const char *value)
+{
+    struct dict_rec rec, *match;
+    struct dict_shard *shard;
+    uint32_t hash;
+    size_t size = 0;
+
+    if (!value) {
+        return 0;
+    }
+
+    rec.value = (char *)value;
+    rec.len = strlen(value);
+    hash = dict_hash(value, rec.len);
+    shard = DICT_SHARD(ctx, hash);
+
+    dict_lock(ctx, shard, 0);
+    if (!lyht_find(shard->hash_tab, &rec, hash, (void **)&match)) {
+        size = (rec.len + 1 + shard->hash_tab->rec_size + 1) / atomic_load_explicit(&match->refcount, memory_order_relaxed);
+    }
+    pthread_rwlock_unlock(&shard->lock);
+
+    return size;
+}
+
 struct ht_rec *
 lyht_get_rec(unsigned char *recs, uint16_t rec_size, uint32_t idx)
 {
     return (struct ht_rec *)&recs[idx * rec_size];
 }
 
+/*
+ * Group control byte matching, every function returns a mask with a bit set for every matching record of the group
+ */
+
+static inline uint32_t
+lyht_group_match(const uint8_t *ctrl, uint8_t byte)
+{
+#if defined(__SSE2__)
+    __m128i group = _mm_loadu_si128((const __m128i *)ctrl);
+
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char)byte)));
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    static const uint8_t bits[16] = {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+    uint8x16_t match;
+
+    match = vandq_u8(vceqq_u8(vld1q_u8(ctrl), vdupq_n_u8(byte)), vld1q_u8(bits));
+    return vaddv_u8(vget_low_u8(match)) | ((uint32_t)vaddv_u8(vget_high_u8(match)) << 8);
+#else
+    uint32_t i, mask = 0;
+
+    for (i = 0; i < LYHT_GROUP_SIZE; ++i) {
+        if (ctrl[i] == byte) {
+            mask |= 1U << i;
+        }
+    }
+    return mask;
+#endif
+}
+
+/* empty and deleted records */
+static inline uint32_t
+lyht_group_match_free(const uint8_t *ctrl)
+{
+#if defined(__SSE2__)
+    /* filled records are exactly those with the highest bit set */
+    return ~(uint32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)ctrl)) & 0xFFFF;
+#else
+    return lyht_group_match(ctrl, LYHT_CTRL_EMPTY) | lyht_group_match(ctrl, LYHT_CTRL_DELETED);
+#endif
+}
+
+/* index of the lowest set bit of a non-zero mask */
+static inline uint32_t
+lyht_mask_first(uint32_t mask)
+{
+#ifdef __GNUC__
+    return __builtin_ctz(mask);
+#else
+    uint32_t i;
+
+    for (i = 0; !(mask & 1); ++i, mask >>= 1);
+    return i;
+#endif
+}
+
+/*
+ * The hash is spread (multiplicative hashing) so that even trivial hashes (small integers, pointers)
+ * are distributed evenly. Its highest bits select the first probed group, some lower bits are
+ * stored in the control byte.
+ */
+#define LYHT_HASH_MIX(hash) ((uint32_t)((hash) * 0x9E3779B1U))
+
+static inline uint32_t
+lyht_first_group(const struct hash_table *ht, uint32_t hash)
+{
+    uint32_t group_count = ht->size / LYHT_GROUP_SIZE;
+
+    return (LYHT_HASH_MIX(hash) >> 8) & (group_count - 1);
+}
+
+static inline uint8_t
+lyht_hash_ctrl(uint32_t hash)
+{
+    return LYHT_CTRL_FULL | (LYHT_HASH_MIX(hash) >> 25);
+}
+
+/*
+ * Groups are probed in the triangular sequence (+1, +2, +3, ...), which visits all the groups of a table
+ * whose group count is a power of 2. The loop ends after all of them were probed.
+ */
+#define LYHT_PROBE_FOR(ht, hash, group, i) \
+    for ((i) = 0, (group) = lyht_first_group(ht, hash); \
+         (i) < (ht)->size / LYHT_GROUP_SIZE; \
+         ++(i), (group) = ((group) + (i)) & ((ht)->size / LYHT_GROUP_SIZE - 1))
+
+/**
+ * @brief Find the first free record for a value that is known not to be in the table.
+ *
+ * @param[in] ht Hash table.
+ * @param[in] hash Hash of the value.
+ * @return Index of the free record, ht->size if there are none.
+ */
+static uint32_t
+lyht_find_free(const struct hash_table *ht, uint32_t hash)
+{
+    uint32_t group, i, mask;
+
+    LYHT_PROBE_FOR(ht, hash, group, i) {
+        mask = lyht_group_match_free(&ht->ctrl[group * LYHT_GROUP_SIZE]);
+        if (mask) {
+            return group * LYHT_GROUP_SIZE + lyht_mask_first(mask);
+        }
+    }
+
+    return ht->size;
+}
+
+/**
+ * @brief Allocate records of a hash table, all empty.
+ *
+ * @param[in] ht Hash table with the new size set.
+ * @return 0 on success, -1 on error.
+ */
+static int
+lyht_alloc_recs(struct hash_table *ht)
+{
+    /* control bytes are stored right after the records, empty is 0 */
+    ht->recs = calloc(ht->size, ht->rec_size + 1);
+    LY_CHECK_ERR_RETURN(!ht->recs, LOGMEM(NULL), -1);
+    ht->ctrl = ht->recs + ht->size * ht->rec_size;
+
+    return 0;
+}
+
+/**
+ * @brief Get a view of the previous records of an incremental resize as a hash table.
+ *
+ * @param[in] ht Hash table being resized.
+ * @param[out] old Hash table sharing the previous records of \p ht.
+ */
+static void
+lyht_old_view(const struct hash_table *ht, struct hash_table *old)
+{
+    *old = *ht;
+    old->recs = ht->old_recs;
+    old->ctrl = ht->old_ctrl;
+    old->size = ht->old_size;
+    old->old_recs = NULL;
+}
+
+/**
+ * @brief Move the records of the next groups of the previous records into the current ones.
+ *
+ * @param[in] ht Hash table being resized.
+ * @param[in] groups Number of groups to migrate.
+ */
+static void
+lyht_migrate(struct hash_table *ht, uint32_t groups)
+{
+    struct ht_rec *rec;
+    uint32_t i, end, idx;
+
+    for (; ht->old_recs && groups; --groups) {
+        for (i = ht->migrated * LYHT_GROUP_SIZE, end = i + LYHT_GROUP_SIZE; i < end; ++i) {
+            if (!(ht->old_ctrl[i] & LYHT_CTRL_FULL)) {
+                continue;
+            }
+
+            rec = lyht_get_rec(ht->old_recs, ht->rec_size, i);
+            idx = lyht_find_free(ht, rec->hash);
+            assert(idx < ht->size);
+            if (ht->ctrl[idx] == LYHT_CTRL_DELETED) {
+                --ht->deleted;
+            }
+            memcpy(lyht_get_rec(ht->recs, ht->rec_size, idx), rec, ht->rec_size);
+            ht->ctrl[idx] = ht->old_ctrl[i];
+
+            /* keep probing through this group of the previous records working */
+            ht->old_ctrl[i] = LYHT_CTRL_DELETED;
+        }
+
+        if (++ht->migrated == ht->old_size / LYHT_GROUP_SIZE) {
+            /* all migrated */
+            free(ht->old_recs);
+            ht->old_recs = NULL;
+            ht->old_ctrl = NULL;
+            ht->old_size = 0;
+            ht->migrated = 0;
+        }
+    }
+}
+
+void
+lyht_resize_finish(struct hash_table *ht)
+{
+    lyht_migrate(ht, UINT32_MAX);
+}
+
 struct hash_table *
 lyht_new(uint32_t size, uint16_t val_size, values_equal_cb val_equal, void *cb_data, int resize)
 {
@@ -280,7 +832,7 @@ lyht_new(uint32_t size, uint16_t val_size, values_equal_cb val_equal, void *cb_d
     /* check that 2^x == size (power of 2) */
     assert(size && !(size & (size - 1)));
     assert(val_equal && val_size);
-    assert(resize == 0 || resize == 1);
+    assert(!(resize & ~(1 | LYHT_RESIZE_INCREMENTAL)));
 
     if (size < LYHT_MIN_SIZE) {
         size = LYHT_MIN_SIZE;
@@ -291,14 +843,24 @@ lyht_new(uint32_t size, uint16_t val_size, values_equal_cb val_equal, void *cb_d
 
     ht->used = 0;
     ht->size = size;
+    ht->deleted = 0;
     ht->val_equal = val_equal;
     ht->cb_data = cb_data;
-    ht->resize = (uint16_t)resize;
-
-    ht->rec_size = (sizeof(struct ht_rec) - 1) + val_size;
+    ht->resize = (uint16_t)(resize & 1);
+    ht->incremental = (resize & LYHT_RESIZE_INCREMENTAL) ? 1 : 0;
+    ht->old_recs = NULL;
+    ht->old_ctrl = NULL;
+    ht->old_size = 0;
+    ht->migrated = 0;
+    ht->stats_ctx = NULL;
+
+    ht->val_size = val_size;
+    ht->rec_size = (LYHT_REC_HDR_SIZE + val_size + 7) & ~7;
     /* allocate the records correctly */
-    ht->recs = calloc(size, ht->rec_size);
-    LY_CHECK_ERR_RETURN(!ht->recs, free(ht); LOGMEM(NULL), NULL);
+    if (lyht_alloc_recs(ht)) {
+        free(ht);
+        return NULL;
+    }
 
     return ht;
 }
@@ -323,22 +885,47 @@ lyht_set_cb_data(struct hash_table *ht, void *new_cb_data)
     return prev;
 }
 
+void
+lyht_set_stats(struct hash_table *ht, struct ly_ctx *ctx)
+{
+    ht->stats_ctx = ctx;
+}
+
 struct hash_table *
 lyht_dup(const struct hash_table *orig)
 {
     struct hash_table *ht;
+    struct ht_rec *rec;
+    uint32_t i, idx;
 
     if (!orig) {
         return NULL;
     }
 
-    ht = lyht_new(orig->size, orig->rec_size - (sizeof(struct ht_rec) - 1), orig->val_equal, orig->cb_data, orig->resize ? 1 : 0);
+    ht = lyht_new(orig->size, orig->val_size, orig->val_equal, orig->cb_data,
+                  (orig->resize ? 1 : 0) | (orig->incremental ? LYHT_RESIZE_INCREMENTAL : 0));
     if (!ht) {
         return NULL;
     }
 
-    memcpy(ht->recs, orig->recs, orig->used * orig->rec_size);
+    memcpy(ht->recs, orig->recs, orig->size * (orig->rec_size + 1));
     ht->used = orig->used;
+    ht->deleted = orig->deleted;
+    ht->stats_ctx = orig->stats_ctx;
+
+    /* the duplicate gets all the records not yet migrated at once */
+    for (i = 0; orig->old_recs && (i < orig->old_size); ++i) {
+        if (orig->old_ctrl[i] & LYHT_CTRL_FULL) {
+            rec = lyht_get_rec(orig->old_recs, orig->rec_size, i);
+            idx = lyht_find_free(ht, rec->hash);
+            assert(idx < ht->size);
+            if (ht->ctrl[idx] == LYHT_CTRL_DELETED) {
+                --ht->deleted;
+            }
+            memcpy(lyht_get_rec(ht->recs, ht->rec_size, idx), rec, ht->rec_size);
+            ht->ctrl[idx] = orig->old_ctrl[i];
+        }
+    }
     return ht;
 }
 
@@ -346,43 +933,80 @@ void
 lyht_free(struct hash_table *ht)
 {
     if (ht) {
+        free(ht->old_recs);
         free(ht->recs);
         free(ht);
     }
 }
 
+size_t
+lyht_mem_size(const struct hash_table *ht)
+{
+    size_t size;
+
+    if (!ht) {
+        return 0;
+    }
+
+    /* every record has its control byte */
+    size = sizeof *ht + (size_t)ht->size * (ht->rec_size + 1);
+    if (ht->old_recs) {
+        size += (size_t)ht->old_size * (ht->rec_size + 1);
+    }
+    return size;
+}
+
+/**
+ * @brief Resize a hash table.
+ *
+ * @param[in] ht Hash table to resize.
+ * @param[in] new_size New size of the table, power of 2.
+ * @param[in] incremental Whether the records can be migrated incrementally, if the table allows it.
+ * @return 0 on success, -1 on error.
+ */
 static int
-lyht_resize(struct hash_table *ht, int enlarge)
+lyht_resize_to(struct hash_table *ht, uint32_t new_size, int incremental)
 {
     struct ht_rec *rec;
     unsigned char *old_recs;
-    uint32_t i, old_size;
-    int ret;
+    uint8_t *old_ctrl;
+    uint32_t i, idx, old_size;
+
+    /* never more than two arrays */
+    lyht_resize_finish(ht);
+    LY_STATS_ADD(ht->stats_ctx, ht_resizes, 1);
 
     old_recs = ht->recs;
+    old_ctrl = ht->ctrl;
     old_size = ht->size;
 
-    if (enlarge) {
-        /* double the size */
-        ht->size <<= 1;
-    } else {
-        /* half the size */
-        ht->size >>= 1;
-    }
+    ht->size = new_size;
 
-    ht->recs = calloc(ht->size, ht->rec_size);
-    LY_CHECK_ERR_RETURN(!ht->recs, LOGMEM(NULL); ht->recs = old_recs; ht->size = old_size, -1);
+    if (lyht_alloc_recs(ht)) {
+        ht->recs = old_recs;
+        ht->ctrl = old_ctrl;
+        ht->size = old_size;
+        return -1;
+    }
 
-    /* reset used, it will increase again */
-    ht->used = 0;
+    ht->deleted = 0;
+    if (incremental && ht->incremental) {
+        /* the records will be migrated later */
+        ht->old_recs = old_recs;
+        ht->old_ctrl = old_ctrl;
+        ht->old_size = old_size;
+        ht->migrated = 0;
+        return 0;
+    }
 
-    /* add all the old records into the new records array */
+    /* add all the old records into the new records array, they are all different */
     for (i = 0; i < old_size; ++i) {
-        rec = lyht_get_rec(old_recs, ht->rec_size, i);
-        if (rec->hits > 0) {
-            ret = lyht_insert(ht, rec->val, rec->hash, NULL);
-            assert(!ret);
-            (void)ret;
+        if (old_ctrl[i] & LYHT_CTRL_FULL) {
+            rec = lyht_get_rec(old_recs, ht->rec_size, i);
+            idx = lyht_find_free(ht, rec->hash);
+            assert(idx < ht->size);
+            memcpy(lyht_get_rec(ht->recs, ht->rec_size, idx), rec, ht->rec_size);
+            ht->ctrl[idx] = old_ctrl[i];
         }
     }
 
@@ -391,192 +1015,255 @@ lyht_resize(struct hash_table *ht, int enlarge)
     return 0;
 }
 
-/* return: 0 - hash found, returned its record,
- *         1 - hash not found, returned the record where it would be inserted */
+/**
+ * @brief Resize a hash table to double or half of its size.
+ *
+ * @param[in] ht Hash table to resize.
+ * @param[in] enlarge Whether to enlarge or shrink the table.
+ * @return 0 on success, -1 on error.
+ */
 static int
-lyht_find_first(struct hash_table *ht, uint32_t hash, struct ht_rec **rec_p)
+lyht_resize(struct hash_table *ht, int enlarge)
 {
-    struct ht_rec *rec;
-    uint32_t i, idx;
+    return lyht_resize_to(ht, enlarge ? ht->size << 1 : ht->size >> 1, enlarge);
+}
+
+int
+lyht_reserve(struct hash_table *ht, uint32_t count)
+{
+    uint32_t size;
 
-    if (rec_p) {
-        *rec_p = NULL;
+    if (!ht->resize) {
+        return 0;
     }
 
-    idx = i = hash & (ht->size - 1);
-    rec = lyht_get_rec(ht->recs, ht->rec_size, idx);
+    for (size = ht->size; ((uint64_t)ht->used + count) * 100 >= (uint64_t)size * LYHT_ENLARGE_PERCENTAGE; size <<= 1);
+    if (size == ht->size) {
+        return 0;
+    }
 
-    /* skip through overflow and deleted records */
-    while ((rec->hits != 0) && ((rec->hits == -1) || ((rec->hash & (ht->size - 1)) != idx))) {
-        if ((rec->hits == -1) && rec_p && !(*rec_p)) {
-            /* remember this record for return */
-            *rec_p = rec;
-        }
-        i = (i + 1) % ht->size;
-        if (i == idx) {
-            /* we went through all the records (very unlikely, but possible when many records are invalid),
-             * just return not found */
-            assert(!rec_p || *rec_p);
-            return 1;
+    /* all the records are moved right away, they are about to be followed by many more */
+    return lyht_resize_to(ht, size, 0);
+}
+
+/**
+ * @brief Rehash the table without changing its size to get rid of all the deleted records.
+ *
+ * @param[in] ht Hash table to rehash.
+ * @return 0 on success, -1 on error.
+ */
+static int
+lyht_rehash(struct hash_table *ht)
+{
+    struct ht_rec *rec, *tmp;
+    uint32_t i, idx;
+
+    tmp = malloc(ht->rec_size);
+    LY_CHECK_ERR_RETURN(!tmp, LOGMEM(NULL), -1);
+
+    /* deleted records become empty and filled records deleted, which now means "not yet placed" */
+    for (i = 0; i < ht->size; ++i) {
+        ht->ctrl[i] = (ht->ctrl[i] & LYHT_CTRL_FULL) ? LYHT_CTRL_DELETED : LYHT_CTRL_EMPTY;
+    }
+
+    for (i = 0; i < ht->size; ++i) {
+        if (ht->ctrl[i] != LYHT_CTRL_DELETED) {
+            continue;
         }
+
         rec = lyht_get_rec(ht->recs, ht->rec_size, i);
-    }
-    if (rec->hits == 0) {
-        /* we could not find the value */
-        if (rec_p && !*rec_p) {
-            *rec_p = rec;
+        idx = lyht_find_free(ht, rec->hash);
+        assert(idx < ht->size);
+
+        if (idx / LYHT_GROUP_SIZE == i / LYHT_GROUP_SIZE) {
+            /* the record can stay where it is, all the groups probed before its own are full */
+            ht->ctrl[i] = lyht_hash_ctrl(rec->hash);
+            continue;
         }
-        return 1;
-    }
 
-    /* we have found a record with equal (shortened) hash */
-    if (rec_p) {
-        *rec_p = rec;
+        if (ht->ctrl[idx] == LYHT_CTRL_EMPTY) {
+            /* move the record */
+            memcpy(lyht_get_rec(ht->recs, ht->rec_size, idx), rec, ht->rec_size);
+            ht->ctrl[idx] = lyht_hash_ctrl(rec->hash);
+            ht->ctrl[i] = LYHT_CTRL_EMPTY;
+        } else {
+            /* swap with another not yet placed record and process this index again */
+            assert(ht->ctrl[idx] == LYHT_CTRL_DELETED);
+            memcpy(tmp, lyht_get_rec(ht->recs, ht->rec_size, idx), ht->rec_size);
+            memcpy(lyht_get_rec(ht->recs, ht->rec_size, idx), rec, ht->rec_size);
+            memcpy(rec, tmp, ht->rec_size);
+            ht->ctrl[idx] = lyht_hash_ctrl(lyht_get_rec(ht->recs, ht->rec_size, idx)->hash);
+            --i;
+        }
     }
+    ht->deleted = 0;
+    free(tmp);
     return 0;
 }
 
 /**
- * @brief Search for the next collision.
+ * @brief Find a record with a value.
  *
  * @param[in] ht Hash table to search in.
- * @param[in,out] last Last returned collision record.
- * @param[in] first First collision record (hits > 1).
- * @return 0 when hash collision found, \p last points to this next collision,
- *         1 when hash collision not found, \p last points to the record where it would be inserted.
+ * @param[in] val_p Pointer to the value to find.
+ * @param[in] hash Hash of the value.
+ * @param[in] mod Whether the search is a part of a modifying operation, passed to the callback.
+ * @param[out] free_idx Index of the first free record where the value could be inserted, ht->size if none, optional.
+ * @return Index of the matching record, ht->size if not found.
  */
-static int
-lyht_find_collision(struct hash_table *ht, struct ht_rec **last, struct ht_rec *first)
+static uint32_t
+lyht_find_rec(struct hash_table *ht, void *val_p, uint32_t hash, int mod, uint32_t *free_idx)
 {
-    struct ht_rec *empty = NULL;
-    uint32_t i, idx;
+    struct ht_rec *rec;
+    const uint8_t *ctrl;
+    uint32_t group, i, idx, mask;
+    uint8_t hash_ctrl = lyht_hash_ctrl(hash);
 
-    assert(last && *last);
+    if (free_idx) {
+        *free_idx = ht->size;
+    }
 
-    idx = (*last)->hash & (ht->size - 1);
-    i = (((unsigned char *)*last) - ht->recs) / ht->rec_size;
+    LYHT_PROBE_FOR(ht, hash, group, i) {
+        ctrl = &ht->ctrl[group * LYHT_GROUP_SIZE];
 
-    do {
-        i = (i + 1) % ht->size;
-        *last = lyht_get_rec(ht->recs, ht->rec_size, i);
-        if (*last == first) {
-            /* we went through all the records (very unlikely, but possible when many records are invalid),
-             * just return an invalid record */
-            assert(empty);
-            *last = empty;
-            return 1;
+        for (mask = lyht_group_match(ctrl, hash_ctrl); mask; mask &= mask - 1) {
+            idx = group * LYHT_GROUP_SIZE + lyht_mask_first(mask);
+            rec = lyht_get_rec(ht->recs, ht->rec_size, idx);
+            if ((rec->hash == hash) && ht->val_equal(val_p, &rec->val, mod, ht->cb_data)) {
+                LY_STATS_ADD(ht->stats_ctx, ht_probes, i + 1);
+                return idx;
+            }
         }
 
-        if (((*last)->hits == -1) && !empty) {
-            empty = *last;
+        if (free_idx && (*free_idx == ht->size)) {
+            mask = lyht_group_match_free(ctrl);
+            if (mask) {
+                *free_idx = group * LYHT_GROUP_SIZE + lyht_mask_first(mask);
+            }
         }
-    } while (((*last)->hits != 0) && (((*last)->hits == -1) || (((*last)->hash & (ht->size - 1)) != idx)));
 
-    if ((*last)->hits > 0) {
-        /* we found a collision */
-        assert((*last)->hits == 1);
-        return 0;
+        if (lyht_group_match(ctrl, LYHT_CTRL_EMPTY)) {
+            /* the value would have been stored in this group */
+            ++i;
+            break;
+        }
     }
+    LY_STATS_ADD(ht->stats_ctx, ht_probes, i);
 
-    /* no next collision found, return the record where it would be inserted */
-    if (empty) {
-        *last = empty;
-    } /* else (*last)->hits == 0, it is already correct */
-    return 1;
+    return ht->size;
 }
 
 int
 lyht_find(struct hash_table *ht, void *val_p, uint32_t hash, void **match_p)
 {
-    struct ht_rec *rec, *crec;
-    uint32_t i, c;
-    int r;
+    struct hash_table old;
+    uint32_t idx;
 
-    if (lyht_find_first(ht, hash, &rec)) {
-        /* not found */
-        return 1;
-    }
-    if ((rec->hash == hash) && ht->val_equal(val_p, &rec->val, 0, ht->cb_data)) {
-        /* even the value matches */
+    idx = lyht_find_rec(ht, val_p, hash, 0, NULL);
+    if (idx < ht->size) {
         if (match_p) {
-            *match_p = rec->val;
+            *match_p = lyht_get_rec(ht->recs, ht->rec_size, idx)->val;
         }
         return 0;
     }
 
-    /* some collisions, we need to go through them, too */
-    crec = rec;
-    c = rec->hits;
-    for (i = 1; i < c; ++i) {
-        r = lyht_find_collision(ht, &rec, crec);
-        assert(!r);
-        (void)r;
-
-        /* compare values */
-        if ((rec->hash == hash) && ht->val_equal(val_p, &rec->val, 0, ht->cb_data)) {
+    if (ht->old_recs) {
+        /* the value may not have been migrated yet */
+        lyht_old_view(ht, &old);
+        idx = lyht_find_rec(&old, val_p, hash, 0, NULL);
+        if (idx < old.size) {
             if (match_p) {
-                *match_p = rec->val;
+                *match_p = lyht_get_rec(old.recs, old.rec_size, idx)->val;
             }
             return 0;
         }
     }
 
-    /* not found even in collisions */
+    /* not found */
     return 1;
 }
 
 int
-lyht_find_next(struct hash_table *ht, void *val_p, uint32_t hash, void **match_p)
+lyht_find_cb(const struct hash_table *ht, void *val_p, uint32_t hash, values_equal_cb val_equal, void *cb_data,
+             void **match_p)
 {
-    struct ht_rec *rec, *crec;
-    uint32_t i, c;
-    int r, found = 0;
-
-    if (lyht_find_first(ht, hash, &rec)) {
-        /* not found, cannot happen */
-        assert(0);
-    }
+    struct hash_table view;
 
-    if ((rec->hash == hash) && ht->val_equal(val_p, &rec->val, 1, ht->cb_data)) {
-        /* previously returned value */
-        found = 1;
-    }
-
-    if (rec->hits == 1) {
-        /* there are no more similar values */
-        assert(rec->hash == hash);
-        assert(found);
-        return 1;
-    }
+    /* the table itself is not modified so that it can be searched by several threads */
+    view = *ht;
+    view.val_equal = val_equal;
+    view.cb_data = cb_data;
+    return lyht_find(&view, val_p, hash, match_p);
+}
 
-    /* go through collisions and find next one after the previous one */
-    crec = rec;
-    c = rec->hits;
-    for (i = 1; i < c; ++i) {
-        r = lyht_find_collision(ht, &rec, crec);
-        assert(!r);
-        (void)r;
+/**
+ * @brief Find the next record with the same hash as a previously found value.
+ *
+ * @param[in] ht Hash table to search in.
+ * @param[in] val_p Pointer to the previously found value.
+ * @param[in] hash Hash of the value.
+ * @param[in,out] found Whether the previously found value was already passed.
+ * @param[out] match_p Pointer to the next matching value.
+ * @return 0 if found, 1 if not.
+ */
+static int
+lyht_find_next_rec(struct hash_table *ht, void *val_p, uint32_t hash, int *found, void **match_p)
+{
+    struct ht_rec *rec;
+    const uint8_t *ctrl;
+    uint32_t group, i, idx, mask;
+    uint8_t hash_ctrl = lyht_hash_ctrl(hash);
+
+    /* go through the records with the same hash in the probing order and return the one after the previous one */
+    LYHT_PROBE_FOR(ht, hash, group, i) {
+        ctrl = &ht->ctrl[group * LYHT_GROUP_SIZE];
+
+        for (mask = lyht_group_match(ctrl, hash_ctrl); mask; mask &= mask - 1) {
+            idx = group * LYHT_GROUP_SIZE + lyht_mask_first(mask);
+            rec = lyht_get_rec(ht->recs, ht->rec_size, idx);
+            if (rec->hash != hash) {
+                /* a normal collision, we are not interested in those */
+                continue;
+            }
 
-        if (rec->hash != hash) {
-            /* a normal collision, we are not interested in those */
-            continue;
-        }
+            if (*found) {
+                /* next value with equal hash, found our value */
+                if (match_p) {
+                    *match_p = rec->val;
+                }
+                return 0;
+            }
 
-        if (found) {
-            /* next value with equal hash, found our value */
-            if (match_p) {
-                *match_p = rec->val;
+            if (ht->val_equal(val_p, &rec->val, 1, ht->cb_data)) {
+                /* this one was returned previously, continue looking */
+                *found = 1;
             }
-            return 0;
         }
 
-        if (!ht->val_equal(val_p, &rec->val, 1, ht->cb_data)) {
-            /* already returned value, skip */
-            continue;
+        if (lyht_group_match(ctrl, LYHT_CTRL_EMPTY)) {
+            break;
         }
+    }
+
+    return 1;
+}
+
+int
+lyht_find_next(struct hash_table *ht, void *val_p, uint32_t hash, void **match_p)
+{
+    struct hash_table old;
+    int found = 0;
 
-        /* this one was returned previously, continue looking */
-        found = 1;
+    if (!lyht_find_next_rec(ht, val_p, hash, &found, match_p)) {
+        return 0;
+    }
+
+    if (ht->old_recs) {
+        /* continue with the values not yet migrated, they are found after all the migrated ones */
+        lyht_old_view(ht, &old);
+        if (!lyht_find_next_rec(&old, val_p, hash, &found, match_p)) {
+            return 0;
+        }
     }
 
     /* the last equal value was already returned */
@@ -588,82 +1275,81 @@ int
 lyht_insert_with_resize_cb(struct hash_table *ht, void *val_p, uint32_t hash,
                            values_equal_cb resize_val_equal, void **match_p)
 {
-    struct ht_rec *rec, *crec = NULL;
-    int32_t i;
+    struct hash_table old;
+    struct ht_rec *rec;
+    uint32_t idx, free_idx;
     int r, ret;
-    values_equal_cb old_val_equal;
+    values_equal_cb old_val_equal = NULL;
 
-    if (!lyht_find_first(ht, hash, &rec)) {
-        /* we found matching shortened hash */
-        if ((rec->hash == hash) && ht->val_equal(val_p, &rec->val, 1, ht->cb_data)) {
-            /* even the value matches */
+    /* move a part of the previous records, if being resized */
+    lyht_migrate(ht, LYHT_MIGRATE_GROUPS);
+
+    idx = lyht_find_rec(ht, val_p, hash, 1, &free_idx);
+    if (idx < ht->size) {
+        /* the value is already stored */
+        if (match_p) {
+            *match_p = (void *)&lyht_get_rec(ht->recs, ht->rec_size, idx)->val;
+        }
+        return 1;
+    }
+    if (ht->old_recs) {
+        lyht_old_view(ht, &old);
+        idx = lyht_find_rec(&old, val_p, hash, 1, NULL);
+        if (idx < old.size) {
+            /* the value is already stored, not yet migrated */
             if (match_p) {
-                *match_p = (void *)&rec->val;
+                *match_p = (void *)&lyht_get_rec(old.recs, old.rec_size, idx)->val;
             }
             return 1;
         }
-
-        /* some collisions, we need to go through them, too */
-        crec = rec;
-        for (i = 1; i < crec->hits; ++i) {
-            r = lyht_find_collision(ht, &rec, crec);
-            assert(!r);
-
-            /* compare values */
-            if ((rec->hash == hash) && ht->val_equal(val_p, &rec->val, 1, ht->cb_data)) {
-                if (match_p) {
-                    *match_p = (void *)&rec->val;
-                }
-                return 1;
-            }
-        }
-
-        /* value not found, get the record where it will be inserted */
-        r = lyht_find_collision(ht, &rec, crec);
-        assert(r);
+    }
+    if (free_idx == ht->size) {
+        /* full table that cannot be enlarged */
+        LOGINT(NULL);
+        return -1;
     }
 
-    /* insert it into the returned record */
-    assert(rec->hits < 1);
+    /* insert it into the free record */
+    if (ht->ctrl[free_idx] == LYHT_CTRL_DELETED) {
+        --ht->deleted;
+    }
+    rec = lyht_get_rec(ht->recs, ht->rec_size, free_idx);
     rec->hash = hash;
-    rec->hits = 1;
-    memcpy(&rec->val, val_p, ht->rec_size - (sizeof(struct ht_rec) - 1));
+    memcpy(&rec->val, val_p, ht->val_size);
+    ht->ctrl[free_idx] = lyht_hash_ctrl(hash);
     if (match_p) {
         *match_p = (void *)&rec->val;
     }
 
-    if (crec) {
-        /* there was a collision, increase hits */
-        if (crec->hits == INT32_MAX) {
-            LOGINT(NULL);
-        }
-        ++crec->hits;
-    }
-
     /* check size & enlarge if needed */
     ret = 0;
     ++ht->used;
-    if (ht->resize) {
-        r = (ht->used * 100) / ht->size;
-        if ((ht->resize == 1) && (r >= LYHT_FIRST_SHRINK_PERCENTAGE)) {
-            /* enable shrinking */
-            ht->resize = 2;
+    r = (ht->used * 100) / ht->size;
+    if ((ht->resize == 1) && (r >= LYHT_FIRST_SHRINK_PERCENTAGE)) {
+        /* enable shrinking */
+        ht->resize = 2;
+    }
+    if ((ht->resize == 2) && (r >= LYHT_ENLARGE_PERCENTAGE)) {
+        /* enlarge (finishes any previous resize) */
+        ret = lyht_resize(ht, 1);
+    } else if (((ht->deleted * 100) / ht->size >= LYHT_DELETED_PERCENTAGE)
+            && (((ht->used + ht->deleted) * 100) / ht->size >= LYHT_ENLARGE_PERCENTAGE)) {
+        /* too many deleted records, get rid of them */
+        ret = lyht_rehash(ht);
+    } else {
+        return 0;
+    }
+
+    /* if hash_table was rehashed, we need to find new matching value */
+    if (!ret && match_p) {
+        if (resize_val_equal) {
+            old_val_equal = lyht_set_cb(ht, resize_val_equal);
         }
-        if ((ht->resize == 2) && (r >= LYHT_ENLARGE_PERCENTAGE)) {
-            if (resize_val_equal) {
-                old_val_equal = lyht_set_cb(ht, resize_val_equal);
-            }
 
-            /* enlarge */
-            ret = lyht_resize(ht, 1);
-            /* if hash_table was resized, we need to find new matching value */
-            if (ret == 0 && match_p) {
-                lyht_find(ht, val_p, hash, match_p);
-            }
+        lyht_find(ht, val_p, hash, match_p);
 
-            if (resize_val_equal) {
-                lyht_set_cb(ht, old_val_equal);
-            }
+        if (resize_val_equal) {
+            lyht_set_cb(ht, old_val_equal);
         }
     }
     return ret;
@@ -676,62 +1362,68 @@ lyht_insert(struct hash_table *ht, void *val_p, uint32_t hash, void **match_p)
 }
 
 int
-lyht_remove(struct hash_table *ht, void *val_p, uint32_t hash)
+lyht_remove_with_resize_cb(struct hash_table *ht, void *val_p, uint32_t hash, values_equal_cb resize_val_equal)
 {
-    struct ht_rec *rec, *crec;
-    int32_t i;
-    int first_matched = 0, r, ret;
-
-    if (lyht_find_first(ht, hash, &rec)) {
-        /* hash not found */
-        return 1;
-    }
-    if ((rec->hash == hash) && ht->val_equal(val_p, &rec->val, 1, ht->cb_data)) {
-        /* even the value matches */
-        first_matched = 1;
-    }
-
-    /* we always need to go through collisions */
-    crec = rec;
-    for (i = 1; i < crec->hits; ++i) {
-        r = lyht_find_collision(ht, &rec, crec);
-        assert(!r);
+    struct hash_table old;
+    uint32_t idx;
+    int r, ret;
+    values_equal_cb old_val_equal;
 
-        /* compare values */
-        if (!first_matched && (rec->hash == hash) && ht->val_equal(val_p, &rec->val, 1, ht->cb_data)) {
-            break;
+    /* move a part of the previous records, if being resized */
+    lyht_migrate(ht, LYHT_MIGRATE_GROUPS);
+
+    idx = lyht_find_rec(ht, val_p, hash, 1, NULL);
+    if (idx < ht->size) {
+        if (lyht_group_match(&ht->ctrl[(idx / LYHT_GROUP_SIZE) * LYHT_GROUP_SIZE], LYHT_CTRL_EMPTY)) {
+            /* no probing went past this group, so the record can be emptied */
+            ht->ctrl[idx] = LYHT_CTRL_EMPTY;
+        } else {
+            ht->ctrl[idx] = LYHT_CTRL_DELETED;
+            ++ht->deleted;
+        }
+    } else if (ht->old_recs) {
+        /* the value may not have been migrated yet, deleted previous records are not counted */
+        lyht_old_view(ht, &old);
+        idx = lyht_find_rec(&old, val_p, hash, 1, NULL);
+        if (idx == old.size) {
+            /* value not found */
+            return 1;
         }
-    }
 
-    if (i < crec->hits) {
-        /* one of collisions matched, reduce collision count, remove the record */
-        assert(!first_matched);
-        --crec->hits;
-        rec->hits = -1;
-    } else if (first_matched) {
-        /* the first record matches */
-        if (crec != rec) {
-            /* ... so put the last collision in its place */
-            rec->hits = crec->hits - 1;
-            memcpy(crec, rec, ht->rec_size);
+        if (lyht_group_match(&old.ctrl[(idx / LYHT_GROUP_SIZE) * LYHT_GROUP_SIZE], LYHT_CTRL_EMPTY)) {
+            old.ctrl[idx] = LYHT_CTRL_EMPTY;
+        } else {
+            old.ctrl[idx] = LYHT_CTRL_DELETED;
         }
-        rec->hits = -1;
     } else {
-        /* value not found even in collisions */
-        assert(!first_matched);
+        /* value not found */
         return 1;
     }
 
-    /* check size & shrink if needed */
+    /* check size & shrink if needed, never while still being enlarged */
     ret = 0;
     --ht->used;
-    if (ht->resize == 2) {
+    if ((ht->resize == 2) && !ht->old_recs) {
         r = (ht->used * 100) / ht->size;
         if ((r < LYHT_SHRINK_PERCENTAGE) && (ht->size > LYHT_MIN_SIZE)) {
+            if (resize_val_equal) {
+                old_val_equal = lyht_set_cb(ht, resize_val_equal);
+            }
+
             /* shrink */
             ret = lyht_resize(ht, 0);
+
+            if (resize_val_equal) {
+                lyht_set_cb(ht, old_val_equal);
+            }
         }
     }
 
     return ret;
 }
+
+int
+lyht_remove(struct hash_table *ht, void *val_p, uint32_t hash)
+{
+    return lyht_remove_with_resize_cb(ht, val_p, hash, NULL);
+}
@@ -18,6 +18,7 @@
 
 #include <stdint.h>
 #include <pthread.h>
+#include <stdatomic.h>
 
 #include "common.h"
 #include "dict.h"
@@ -29,9 +30,20 @@
  * - init hash to 0
  * - repeatedly call dict_hash_multi(), provide hash from the last call
  * - call dict_hash_multi() with key_part = NULL to finish the hash
+ *
+ * Equal keys get equal hashes only if they are split into the same parts. The hashes
+ * must not be stored, use dict_hash_multi_oaat() for those.
  */
 uint32_t dict_hash_multi(uint32_t hash, const char *key_part, size_t len);
 
+/**
+ * @brief Compute hash from (several) string(s), stable across versions and architectures.
+ *
+ * Used the same way as dict_hash_multi(), but slower. Only for hashes that are stored, such as
+ * the schema node hashes in LYB data, which must never change.
+ */
+uint32_t dict_hash_multi_oaat(uint32_t hash, const char *key_part, size_t len);
+
 /**
  * @brief Callback for checking hash table values equivalence.
  *
@@ -52,50 +64,112 @@ typedef int (*values_equal_cb)(void *val1_p, void *val2_p, int mod, void *cb_dat
 /** when the table is less than this much percent full, it is shrunk (half the size) */
 #define LYHT_SHRINK_PERCENTAGE 25
 
-/** never shrink beyond this size */
-#define LYHT_MIN_SIZE 8
+/** when the table is at least #LYHT_ENLARGE_PERCENTAGE full including deleted records and at least this much
+ * percent of its records are deleted, it is rehashed without changing its size */
+#define LYHT_DELETED_PERCENTAGE 12
+
+/** lyht_new() resize flag, enlarge the table gradually so that no single operation has to move all the records */
+#define LYHT_RESIZE_INCREMENTAL 0x02
+
+/** number of groups of the previous records migrated by every modifying operation during an incremental resize */
+#define LYHT_MIGRATE_GROUPS 2
+
+/** number of records probed at once, their control bytes are compared in parallel */
+#define LYHT_GROUP_SIZE 16
+
+/** never shrink beyond this size, must be a multiple of #LYHT_GROUP_SIZE */
+#define LYHT_MIN_SIZE 16
+
+/** control byte of a record that was never filled */
+#define LYHT_CTRL_EMPTY 0x00
+
+/** control byte of a removed record (tombstone) */
+#define LYHT_CTRL_DELETED 0x01
+
+/** control byte flag of a filled record, the remaining 7 bits are taken from the value hash */
+#define LYHT_CTRL_FULL 0x80
 
 /**
  * @brief Generic hash table record.
  */
 struct ht_rec {
     uint32_t hash;        /* hash of the value */
-    int32_t hits;         /* collision/overflow value count - 1 (a filled entry has 1 hit,
-                           * special value -1 means a deleted record) */
+    uint32_t padding;     /* keeps the value 8-byte aligned, the record size is a multiple of 8 as well */
     unsigned char val[1]; /* arbitrary-size value */
 } _PACKED;
 
+/** size of the record header before the value */
+#define LYHT_REC_HDR_SIZE (sizeof(struct ht_rec) - 1)
+
 /**
  * @brief (Very) generic hash table.
  *
- * Hash table with open addressing collision resolution and
- * linear probing of interval 1 (next free record is used).
- * Removal is lazy (removed records are only marked), but
- * if possible, they are fully emptied.
+ * Hash table with open addressing collision resolution. The records are split into groups
+ * of #LYHT_GROUP_SIZE and every record has a control byte (kept in a separate array) saying
+ * whether it is empty, deleted, or filled and in that case also holding 7 bits of its hash.
+ * The probing goes through whole groups, whose control bytes are compared in parallel (SSE2/NEON
+ * if available), so the full records are accessed only for likely matches.
+ * Removed records are only marked deleted if some probing may have skipped them while they were
+ * filled, otherwise they are fully emptied. Deleted records are reused by inserts and if there
+ * are too many of them, the table is rehashed in-place.
+ *
+ * With #LYHT_RESIZE_INCREMENTAL, enlarging only allocates the new records and the previous ones are
+ * migrated a few groups at a time by the following inserts and removals. Until then, both arrays are
+ * searched. Finds never modify the table so they can still be performed concurrently.
  */
 struct hash_table {
     uint32_t used;        /* number of values stored in the hash table (filled records) */
     uint32_t size;        /* always holds 2^x == size (is power of 2), actually number of records allocated */
+    uint32_t deleted;     /* number of deleted records */
     values_equal_cb val_equal; /* callback for testing value equivalence */
     void *cb_data;        /* user data callback arbitrary value */
     uint16_t resize;      /* 0 - resizing is disabled, *
                            * 1 - enlarging is enabled, *
                            * 2 - both shrinking and enlarging is enabled */
-    uint16_t rec_size;    /* real size (in bytes) of one record for accessing recs array */
+    uint16_t rec_size;    /* real size (in bytes) of one record for accessing recs array, aligned to 8 bytes */
+    uint16_t val_size;    /* size of the stored values */
     unsigned char *recs;  /* pointer to the hash table itself (array of struct ht_rec) */
+    uint8_t *ctrl;        /* control bytes of the records (LYHT_CTRL_*), allocated together with recs */
+    uint8_t incremental;  /* whether the table is enlarged incrementally */
+    unsigned char *old_recs; /* previous records being migrated during an incremental resize, NULL if none */
+    uint8_t *old_ctrl;    /* control bytes of the previous records, migrated records are marked deleted */
+    uint32_t old_size;    /* number of the previous records */
+    uint32_t migrated;    /* number of already migrated groups of the previous records */
+    struct ly_ctx *stats_ctx; /* context whose statistics counters account probes and resizes, see lyht_set_stats() */
 };
 
 struct dict_rec {
     char *value;
-    uint32_t refcount;
+    size_t len;                     /* length of value (without the terminating zero) */
+    atomic_uint_least32_t refcount; /* may be changed with only the shard read lock held */
 };
 
 /**
- * dictionary to store repeating strings
+ * number of hash bits selecting the dictionary shard (the highest bits of the hash are used)
  */
-struct dict_table {
+#define LYDICT_SHARD_BITS 4
+
+/**
+ * number of dictionary shards
+ */
+#define LYDICT_SHARDS (1 << LYDICT_SHARD_BITS)
+
+/**
+ * one part of the dictionary with its own lock
+ */
+struct dict_shard {
     struct hash_table *hash_tab;
-    pthread_mutex_t lock;
+    pthread_rwlock_t lock;        /* read lock for referencing stored values, write lock for changing the table */
+    size_t str_size;              /* bytes allocated for the stored strings, changed with the write lock held */
+};
+
+/**
+ * dictionary to store repeating strings, split into shards by the string hash so that
+ * threads working with different strings do not compete for a single lock
+ */
+struct dict_table {
+    struct dict_shard shards[LYDICT_SHARDS];
+    atomic_uint_least32_t refs;   /* number of contexts sharing the dictionary, see ly_ctx_clone() */
 };
 
 /**
@@ -112,6 +186,101 @@ void lydict_init(struct dict_table *dict);
  */
 void lydict_clean(struct dict_table *dict);
 
+/**
+ * @brief Start collecting the dictionary removals of the current thread, lydict_remove() then only records
+ * the values and they are removed together by lydict_batch_stop(), each dictionary shard is locked once.
+ *
+ * Batches can be nested, only the outermost one applies the removals. Removals from other dictionaries
+ * are performed immediately.
+ *
+ * @param[in] ctx Context whose dictionary removals are collected.
+ */
+void lydict_batch_start(struct ly_ctx *ctx);
+
+/**
+ * @brief Stop collecting the dictionary removals and apply them, see lydict_batch_start().
+ */
+void lydict_batch_stop(void);
+
+/**
+ * @brief Store a data value string, either in the dictionary or, with \p priv, as a private copy owned
+ * by the data node only (#LY_VALUE_PRIVATE), see ly_ctx_set_private_values().
+ *
+ * @param[in] ctx Context with the dictionary.
+ * @param[in] value String to store.
+ * @param[in] len Length of \p value, 0 to use strlen().
+ * @param[in] priv Whether to make a private copy instead of a dictionary reference.
+ * @return Stored string, NULL on error.
+ */
+const char *lydict_insert_priv(struct ly_ctx *ctx, const char *value, size_t len, int priv);
+
+/**
+ * @brief Store a dynamically allocated data value string, see lydict_insert_priv() and lydict_insert_zc().
+ *
+ * @param[in] ctx Context with the dictionary.
+ * @param[in] value String to store, it is adopted.
+ * @param[in] priv Whether to keep \p value as a private string instead of a dictionary reference.
+ * @return Stored string, NULL on error.
+ */
+const char *lydict_insert_zc_priv(struct ly_ctx *ctx, char *value, int priv);
+
+/**
+ * @brief Release a data value string stored by lydict_insert_priv() or lydict_insert_zc_priv().
+ *
+ * @param[in] ctx Context with the dictionary.
+ * @param[in] value String to release.
+ * @param[in] priv Whether \p value is a private string.
+ */
+void lydict_remove_priv(struct ly_ctx *ctx, const char *value, int priv);
+
+/**
+ * @brief Create a new dictionary referenced once.
+ *
+ * @return New dictionary, NULL on memory allocation error.
+ */
+struct dict_table *lydict_new(void);
+
+/**
+ * @brief Add a reference to a dictionary shared by another context.
+ *
+ * @param[in] dict Dictionary to share.
+ * @return \p dict.
+ */
+struct dict_table *lydict_ref(struct dict_table *dict);
+
+/**
+ * @brief Remove a reference to a dictionary, cleanup and free it when there are no references left.
+ *
+ * @param[in] dict Dictionary to release.
+ */
+void lydict_free(struct dict_table *dict);
+
+/**
+ * @brief Get the memory occupied by the dictionary, both its tables and the stored strings.
+ *
+ * @param[in] dict Dictionary table to examine.
+ * @return Size in bytes.
+ */
+size_t lydict_mem_size(struct dict_table *dict);
+
+/**
+ * @brief Get the number of strings stored in the dictionary.
+ *
+ * @param[in] dict Dictionary table to examine.
+ * @return Number of stored strings.
+ */
+uint32_t lydict_count(struct dict_table *dict);
+
+/**
+ * @brief Get the share of a dictionary string in the dictionary memory, the size of the string and its record
+ * divided by the number of its references.
+ *
+ * @param[in] ctx Context with the dictionary.
+ * @param[in] value String stored in the dictionary.
+ * @return Size in bytes, 0 if \p value is NULL or not in the dictionary.
+ */
+size_t lydict_val_mem_size(struct ly_ctx *ctx, const char *value);
+
 /**
  * @brief Get a specific record from a hash table.
  *
@@ -129,11 +298,21 @@ struct ht_rec *lyht_get_rec(unsigned char *recs, uint16_t rec_size, uint32_t idx
  * @param[in] val_size Size in bytes of value (the stored hashed item).
  * @param[in] val_equal Callback for checking value equivalence.
  * @param[in] cb_data User data always passed to \p val_equal.
- * @param[in] resize Whether to resize the table on too few/too many records taken.
+ * @param[in] resize Whether to resize the table on too few/too many records taken, can be combined
+ * with #LYHT_RESIZE_INCREMENTAL.
  * @return Empty hash table, NULL on error.
  */
 struct hash_table *lyht_new(uint32_t size, uint16_t val_size, values_equal_cb val_equal, void *cb_data, int resize);
 
+/**
+ * @brief Make room for inserting more values into a hash table without any resize.
+ *
+ * @param[in] ht Hash table to enlarge, if needed and its resizing is enabled.
+ * @param[in] count Number of values to be inserted.
+ * @return 0 on success, -1 on error.
+ */
+int lyht_reserve(struct hash_table *ht, uint32_t count);
+
 /**
  * @brief Set hash table value equal callback.
  *
@@ -152,6 +331,14 @@ values_equal_cb lyht_set_cb(struct hash_table *ht, values_equal_cb new_val_equal
  */
 void *lyht_set_cb_data(struct hash_table *ht, void *new_cb_data);
 
+/**
+ * @brief Account the probes and resizes of a hash table in the statistics of a context, see ly_ctx_set_stats().
+ *
+ * @param[in] ht Hash table to modify.
+ * @param[in] ctx Context whose statistics to use, NULL to stop accounting.
+ */
+void lyht_set_stats(struct hash_table *ht, struct ly_ctx *ctx);
+
 /**
  * @brief Make a duplicate of an existing hash table.
  *
@@ -160,6 +347,13 @@ void *lyht_set_cb_data(struct hash_table *ht, void *new_cb_data);
  */
 struct hash_table *lyht_dup(const struct hash_table *orig);
 
+/**
+ * @brief Finish an incremental resize in progress so that all the records are stored in ht->recs.
+ *
+ * @param[in] ht Hash table to modify.
+ */
+void lyht_resize_finish(struct hash_table *ht);
+
 /**
  * @brief Free a hash table.
  *
@@ -167,6 +361,14 @@ struct hash_table *lyht_dup(const struct hash_table *orig);
  */
 void lyht_free(struct hash_table *ht);
 
+/**
+ * @brief Get the memory occupied by a hash table including its records.
+ *
+ * @param[in] ht Hash table to examine, can be NULL.
+ * @return Size in bytes.
+ */
+size_t lyht_mem_size(const struct hash_table *ht);
+
 /**
  * @brief Find a value in a hash table.
  *
@@ -178,6 +380,23 @@ void lyht_free(struct hash_table *ht);
  */
 int lyht_find(struct hash_table *ht, void *val_p, uint32_t hash, void **match_p);
 
+/**
+ * @brief Find a value in a hash table using a specific value equal callback.
+ *
+ * Unlike changing the callback of the table by lyht_set_cb(), the table is only read,
+ * so it can be searched this way concurrently.
+ *
+ * @param[in] ht Hash table to search in.
+ * @param[in] val_p Pointer to the value to find.
+ * @param[in] hash Hash of the stored value.
+ * @param[in] val_equal Callback for checking value equivalence used instead of the one of \p ht.
+ * @param[in] cb_data User data passed to \p val_equal.
+ * @param[out] match_p Pointer to the matching value, optional.
+ * @return 0 on success, 1 on not found.
+ */
+int lyht_find_cb(const struct hash_table *ht, void *val_p, uint32_t hash, values_equal_cb val_equal, void *cb_data,
+                 void **match_p);
+
 /**
  * @brief Find another equal value in the hash table.
  *
@@ -228,4 +447,18 @@ int lyht_insert_with_resize_cb(struct hash_table *ht, void *val_p, uint32_t hash
  */
 int lyht_remove(struct hash_table *ht, void *val_p, uint32_t hash);
 
+/**
+ * @brief Remove a value from a hash table. Same functionality as lyht_remove()
+ * but allows to specify a temporary val equal callback to be used in case the hash table
+ * will be resized after successful removal.
+ *
+ * @param[in] ht Hash table to remove from.
+ * @param[in] value_p Pointer to value to be removed. Be careful, if the values stored in the hash table
+ * are pointers, \p value_p must be a pointer to a pointer.
+ * @param[in] hash Hash of the stored value.
+ * @param[in] resize_val_equal Val equal callback to use for resizing.
+ * @return 0 on success, 1 if value was not found, -1 on error.
+ */
+int lyht_remove_with_resize_cb(struct hash_table *ht, void *val_p, uint32_t hash, values_equal_cb resize_val_equal);
+
 #endif /* LY_HASH_TABLE_H_ */
@@ -84,7 +84,7 @@ log_store(const struct ly_ctx *ctx, LY_LOG_LEVEL level, LY_ERR no, LY_VECODE vec
 
     assert(ctx && (level < LY_LLVRB));
 
-    eitem = pthread_getspecific(ctx->errlist_key);
+    eitem = ly_err_list_get(ctx);
     if (!eitem) {
         /* if we are only to fill in path, there must have been an error stored */
         assert(msg);
@@ -95,7 +95,7 @@ log_store(const struct ly_ctx *ctx, LY_LOG_LEVEL level, LY_ERR no, LY_VECODE vec
         eitem->prev = eitem;
         eitem->next = NULL;
 
-        pthread_setspecific(ctx->errlist_key, eitem);
+        ly_err_list_set(ctx, eitem);
     } else if (!msg) {
         /* only filling the path */
         assert(path);
@@ -148,6 +148,33 @@ mem_fail:
     return -1;
 }
 
+/**
+ * @brief Learn whether a message of the level would be stored or printed with the current options.
+ *
+ * @param[in] ctx Context of the message.
+ * @param[in] level Message level before applying the internal logging options.
+ * @return 1 if the message is used, 0 if it would be thrown away.
+ */
+static int
+log_is_used(const struct ly_ctx *ctx, LY_LOG_LEVEL level)
+{
+    if ((log_opt == ILO_ERR2WRN) && (level == LY_LLERR)) {
+        level = LY_LLWRN;
+    }
+
+    if ((log_opt == ILO_IGNORE) || (level > ly_log_level)) {
+        return 0;
+    }
+
+    if ((level < LY_LLVRB) && ctx && ((ly_log_opts & LY_LOSTORE) || (log_opt == ILO_STORE))) {
+        /* stored */
+        return 1;
+    }
+
+    /* printed */
+    return ((ly_log_opts & LY_LOLOG) && (log_opt != ILO_STORE)) ? 1 : 0;
+}
+
 /* !! spends path !! */
 static void
 log_vprintf(const struct ly_ctx *ctx, LY_LOG_LEVEL level, LY_ERR no, LY_VECODE vecode, char *path,
@@ -177,6 +204,12 @@ log_vprintf(const struct ly_ctx *ctx, LY_LOG_LEVEL level, LY_ERR no, LY_VECODE v
         vecode = ly_vecode(ctx);
     }
 
+    if (!log_is_used(ctx, level)) {
+        /* neither stored nor printed, do not even format it */
+        free(path);
+        return;
+    }
+
     /* store the error/warning (if we need to store errors internally, it does not matter what are the user log options) */
     if ((level < LY_LLVRB) && ctx && ((ly_log_opts & LY_LOSTORE) || (log_opt == ILO_STORE))) {
         if (!format) {
@@ -783,11 +816,16 @@ ly_vlog(const struct ly_ctx *ctx, LY_ECODE ecode, enum LY_VLOG_ELEM elem_type, c
     char* path = NULL;
     const struct ly_err_item *first;
 
-    if ((ecode == LYE_PATH) && !path_flag) {
+    if (log_opt == ILO_IGNORE) {
+        /* nothing to do, the message and its path are never used */
+        return;
+    }
+
+    if ((ecode == LYE_PATH) && (!path_flag || !log_is_used(ctx, LY_LLERR))) {
         return;
     }
 
-    if (path_flag && (elem_type != LY_VLOG_NONE)) {
+    if (path_flag && (elem_type != LY_VLOG_NONE) && log_is_used(ctx, LY_LLERR)) {
         if (elem_type == LY_VLOG_PREV) {
             /* use previous path */
             first = ly_err_first(ctx);
@@ -814,7 +852,10 @@ ly_vlog(const struct ly_ctx *ctx, LY_ECODE ecode, enum LY_VLOG_ELEM elem_type, c
         break;
     case LYE_PATH:
         assert(path);
-        log_vprintf(ctx, LY_LLERR, LY_EVALID, LYVE_SUCCESS, path, NULL, ap);
+        /* keep the error code of the previous error, it need not be a validation error */
+        first = ly_err_first(ctx);
+        log_vprintf(ctx, LY_LLERR, (first && first->prev->no) ? first->prev->no : LY_EVALID, LYVE_SUCCESS, path,
+                    NULL, ap);
         break;
     default:
         log_vprintf(ctx, LY_LLERR, LY_EVALID, ecode2vecode[ecode], path, ly_errs[ecode], ap);
@@ -832,7 +873,11 @@ ly_vlog_str(const struct ly_ctx *ctx, enum LY_VLOG_ELEM elem_type, const char *s
 
     assert((elem_type == LY_VLOG_NONE) || (elem_type == LY_VLOG_PREV));
 
-    if (elem_type == LY_VLOG_PREV) {
+    if (log_opt == ILO_IGNORE) {
+        return;
+    }
+
+    if ((elem_type == LY_VLOG_PREV) && log_is_used(ctx, LY_LLERR)) {
         /* use previous path */
         first = ly_err_first(ctx);
         if (first && first->prev->path) {
@@ -879,7 +924,7 @@ static void
 err_print(struct ly_ctx *ctx, struct ly_err_item *last_eitem)
 {
     if (!last_eitem) {
-        last_eitem = pthread_getspecific(ctx->errlist_key);
+        last_eitem = ly_err_list_get(ctx);
     } else {
         /* this last was already stored before, do not write it again */
         last_eitem = last_eitem->next;
@@ -931,7 +976,7 @@ err_clean(struct ly_ctx *ctx, struct ly_err_item *prev_eitem, int keep)
         ly_err_free_next(ctx, prev_eitem);
     } else if ((ly_log_opts & LY_LOSTORE_LAST) == LY_LOSTORE_LAST) {
         /* keep only the most recent error */
-        first = pthread_getspecific(ctx->errlist_key);
+        first = ly_err_list_get(ctx);
         if (!first) {
             /* no errors whatsoever */
             return;
@@ -939,7 +984,7 @@ err_clean(struct ly_ctx *ctx, struct ly_err_item *prev_eitem, int keep)
         prev_eitem = first->prev;
 
         /* put the context errlist in order */
-        pthread_setspecific(ctx->errlist_key, prev_eitem);
+        ly_err_list_set(ctx, prev_eitem);
         assert(!prev_eitem->prev->next || (prev_eitem->prev->next == prev_eitem));
         prev_eitem->prev->next = NULL;
         prev_eitem->prev = prev_eitem;
@@ -1004,3 +1049,39 @@ ly_err_last_set_apptag(const struct ly_ctx *ctx, const char *apptag)
         }
     }
 }
+
+/**
+ * @brief Take all the error items stored for the calling thread, the thread has no errors afterwards.
+ */
+struct ly_err_item *
+ly_err_detach(const struct ly_ctx *ctx)
+{
+    struct ly_err_item *eitem;
+
+    eitem = ly_err_list_get(ctx);
+    ly_err_list_set(ctx, NULL);
+    return eitem;
+}
+
+/**
+ * @brief Append error items (taken from another thread by ly_err_detach()) to the errors of the calling thread.
+ */
+void
+ly_err_append(const struct ly_ctx *ctx, struct ly_err_item *eitem)
+{
+    struct ly_err_item *first, *last;
+
+    if (!eitem) {
+        return;
+    }
+
+    first = ly_err_list_get(ctx);
+    if (!first) {
+        ly_err_list_set(ctx, eitem);
+    } else {
+        last = eitem->prev;
+        first->prev->next = eitem;
+        eitem->prev = first->prev;
+        first->prev = last;
+    }
+}
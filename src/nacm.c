@@ -0,0 +1,352 @@
+/**
+ * @file nacm.c
+ * @brief NACM (RFC 8341) rules compiled for checking data trees
+ *
+ * Copyright (c) 2015 - 2018 CESNET, z.s.p.o.
+ *
+ * This source code is licensed under BSD 3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://opensource.org/licenses/BSD-3-Clause
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "context.h"
+#include "hash_table.h"
+#include "libyang.h"
+#include "tree_data.h"
+#include "tree_schema.h"
+
+/* no rule */
+#define NACM_NONE UINT32_MAX
+
+/* write access operations, denied by default-deny-write */
+#define NACM_WRITE (LYD_NACM_CREATE | LYD_NACM_UPDATE | LYD_NACM_DELETE)
+
+/* first rule of a module, schema node or data node */
+struct nacm_rec {
+    const void *key;
+    uint32_t idx;
+};
+
+/* path rule with predicates, evaluated for every data tree */
+struct nacm_inst {
+    char *path;
+    uint32_t idx;
+};
+
+struct lyd_nacm {
+    struct ly_ctx *ctx;
+    uint8_t access;              /* compiled access operation */
+    uint8_t dflt_deny;           /* denied if no rule matches */
+    uint32_t any_idx;            /* first module rule of any module */
+    struct hash_table *mod_ht;   /* first module rule of a module */
+    struct hash_table *snode_ht; /* first path rule of a schema node */
+    struct nacm_inst *inst;      /* path rules with predicates */
+    uint32_t inst_count;
+    uint8_t *deny;               /* deny of every rule */
+};
+
+/* applying rules to a data tree */
+struct nacm_apply {
+    const struct lyd_nacm *nacm;
+    struct hash_table *inst_ht;  /* first path rule with predicates of a data node */
+    struct ly_set *denied;
+    int prune;
+};
+
+static int
+nacm_rec_equal(void *val1_p, void *val2_p, int UNUSED(mod), void *UNUSED(cb_data))
+{
+    return ((struct nacm_rec *)val1_p)->key == ((struct nacm_rec *)val2_p)->key;
+}
+
+static uint32_t
+nacm_hash(const void *key)
+{
+    uint32_t hash;
+
+    hash = dict_hash_multi(0, (const char *)&key, sizeof key);
+    return dict_hash_multi(hash, NULL, 0);
+}
+
+/* the rules are added in their order, so the first one of a key is kept */
+static int
+nacm_rec_add(struct hash_table **ht, const void *key, uint32_t idx)
+{
+    struct nacm_rec rec;
+
+    if (!*ht) {
+        *ht = lyht_new(8, sizeof rec, nacm_rec_equal, NULL, 1);
+        if (!*ht) {
+            return -1;
+        }
+    }
+
+    rec.key = key;
+    rec.idx = idx;
+    return (lyht_insert(*ht, &rec, nacm_hash(key), NULL) == -1) ? -1 : 0;
+}
+
+static uint32_t
+nacm_rec_find(struct hash_table *ht, const void *key)
+{
+    struct nacm_rec rec, *found;
+
+    if (!ht) {
+        return NACM_NONE;
+    }
+
+    rec.key = key;
+    if (lyht_find(ht, &rec, nacm_hash(key), (void **)&found)) {
+        return NACM_NONE;
+    }
+    return found->idx;
+}
+
+API struct lyd_nacm *
+lyd_nacm_compile(struct ly_ctx *ctx, const struct lyd_nacm_rule *rules, uint32_t count, uint8_t access, int dflt_deny)
+{
+    struct lyd_nacm *nacm;
+    const struct lys_module *mod;
+    const struct lys_node *snode;
+    struct nacm_inst *inst;
+    uint32_t u;
+
+    if (!ctx || (count && !rules) || !access || (access & ~LYD_NACM_ALL)) {
+        LOGARG;
+        return NULL;
+    }
+
+    nacm = calloc(1, sizeof *nacm);
+    LY_CHECK_ERR_RETURN(!nacm, LOGMEM(ctx), NULL);
+    nacm->ctx = ctx;
+    nacm->access = access;
+    nacm->dflt_deny = dflt_deny ? 1 : 0;
+    nacm->any_idx = NACM_NONE;
+    nacm->deny = calloc(count ? count : 1, sizeof *nacm->deny);
+    LY_CHECK_ERR_GOTO(!nacm->deny, LOGMEM(ctx), error);
+
+    for (u = 0; u < count; ++u) {
+        if (!(rules[u].access & access)) {
+            continue;
+        }
+        nacm->deny[u] = rules[u].deny ? 1 : 0;
+
+        mod = NULL;
+        if (rules[u].module && strcmp(rules[u].module, "*")) {
+            mod = ly_ctx_get_module(ctx, rules[u].module, NULL, 1);
+            if (!mod) {
+                /* there can be no data of the module */
+                continue;
+            }
+        }
+
+        if (!rules[u].path || !strcmp(rules[u].path, "/")) {
+            /* module rule */
+            if (mod) {
+                LY_CHECK_ERR_GOTO(nacm_rec_add(&nacm->mod_ht, mod, u), LOGMEM(ctx), error);
+            } else if (nacm->any_idx == NACM_NONE) {
+                nacm->any_idx = u;
+            }
+            continue;
+        }
+
+        /* path rule */
+        snode = ly_ctx_get_node(ctx, NULL, rules[u].path, 0);
+        if (!snode) {
+            LOGERR(ctx, LY_EINVAL, "Invalid NACM rule path \"%s\".", rules[u].path);
+            goto error;
+        }
+        if (mod && (lys_node_module(snode) != mod)) {
+            /* the rule never matches */
+            continue;
+        }
+
+        if (strchr(rules[u].path, '[')) {
+            /* only some instances of the node */
+            inst = realloc(nacm->inst, (nacm->inst_count + 1) * sizeof *nacm->inst);
+            LY_CHECK_ERR_GOTO(!inst, LOGMEM(ctx), error);
+            nacm->inst = inst;
+            inst[nacm->inst_count].path = strdup(rules[u].path);
+            LY_CHECK_ERR_GOTO(!inst[nacm->inst_count].path, LOGMEM(ctx), error);
+            inst[nacm->inst_count].idx = u;
+            ++nacm->inst_count;
+        } else {
+            LY_CHECK_ERR_GOTO(nacm_rec_add(&nacm->snode_ht, snode, u), LOGMEM(ctx), error);
+        }
+    }
+
+    return nacm;
+
+error:
+    lyd_nacm_free(nacm);
+    return NULL;
+}
+
+API void
+lyd_nacm_free(struct lyd_nacm *nacm)
+{
+    uint32_t u;
+
+    if (!nacm) {
+        return;
+    }
+
+    lyht_free(nacm->mod_ht);
+    lyht_free(nacm->snode_ht);
+    for (u = 0; u < nacm->inst_count; ++u) {
+        free(nacm->inst[u].path);
+    }
+    free(nacm->inst);
+    free(nacm->deny);
+    free(nacm);
+}
+
+/**
+ * @brief Decide the access to a data node.
+ *
+ * @param[in] a Applying the rules.
+ * @param[in] node Data node to decide.
+ * @param[in,out] path_idx First path rule of the ancestors, the first path rule of the node is stored.
+ * @return Whether the access is denied.
+ */
+static int
+nacm_denied(const struct nacm_apply *a, const struct lyd_node *node, uint32_t *path_idx)
+{
+    const struct lyd_nacm *nacm = a->nacm;
+    uint32_t idx, r;
+
+    /* path rules apply to the whole subtrees */
+    idx = *path_idx;
+    r = nacm_rec_find(nacm->snode_ht, node->schema);
+    idx = (r < idx) ? r : idx;
+    r = nacm_rec_find(a->inst_ht, node);
+    idx = (r < idx) ? r : idx;
+    *path_idx = idx;
+
+    /* module rules */
+    r = nacm_rec_find(nacm->mod_ht, lyd_node_module(node));
+    idx = (r < idx) ? r : idx;
+    idx = (nacm->any_idx < idx) ? nacm->any_idx : idx;
+
+    if (idx != NACM_NONE) {
+        return nacm->deny[idx];
+    }
+
+    /* precomputed default-deny extension instances */
+    if (node->schema->flags & LYS_NACM_DENYA) {
+        return 1;
+    } else if ((node->schema->flags & LYS_NACM_DENYW) && (nacm->access & NACM_WRITE)) {
+        return 1;
+    }
+    return nacm->dflt_deny;
+}
+
+/* a list instance cannot be returned without its keys */
+static int
+nacm_keys_denied(const struct nacm_apply *a, const struct lyd_node *list, uint32_t path_idx)
+{
+    const struct lys_node_list *slist = (const struct lys_node_list *)list->schema;
+    const struct lyd_node *key;
+    uint32_t idx;
+    uint8_t i;
+
+    for (i = 0, key = list->child; key && (i < slist->keys_size); ++i, key = key->next) {
+        idx = path_idx;
+        if ((key->schema == (struct lys_node *)slist->keys[i]) && nacm_denied(a, key, &idx)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int
+nacm_apply_r(struct nacm_apply *a, struct lyd_node **first, uint32_t path_idx)
+{
+    struct lyd_node *node, *next;
+    uint32_t idx;
+    int top;
+
+    LY_TREE_FOR_SAFE(*first, next, node) {
+        idx = path_idx;
+        if (!nacm_denied(a, node, &idx) && !((node->schema->nodetype == LYS_LIST) && nacm_keys_denied(a, node, idx))) {
+            if ((node->schema->nodetype & (LYS_CONTAINER | LYS_LIST | LYS_RPC | LYS_ACTION | LYS_NOTIF))
+                    && node->child && nacm_apply_r(a, &node->child, idx)) {
+                return -1;
+            }
+            continue;
+        }
+
+        /* denied subtree */
+        if (a->prune) {
+            top = (node == *first) && !node->parent;
+            lyd_free(node);
+            if (top) {
+                *first = next;
+            }
+        } else if (ly_set_add(a->denied, node, LY_SET_OPT_USEASLIST) == -1) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+API int
+lyd_nacm_apply(const struct lyd_nacm *nacm, struct lyd_node **root, int options, struct ly_set **denied)
+{
+    struct nacm_apply a;
+    struct ly_set *set;
+    uint32_t u, v;
+    int ret = -1;
+
+    if (!nacm || !root || ((options & LYD_NACM_PRUNE) ? (denied != NULL) : !denied)) {
+        LOGARG;
+        return -1;
+    }
+
+    memset(&a, 0, sizeof a);
+    a.nacm = nacm;
+    a.prune = options & LYD_NACM_PRUNE;
+    if (!a.prune) {
+        a.denied = ly_set_new();
+        LY_CHECK_ERR_RETURN(!a.denied, LOGMEM(nacm->ctx), -1);
+    }
+
+    /* the instances of the path rules with predicates */
+    for (u = 0; *root && (u < nacm->inst_count); ++u) {
+        set = lyd_find_path(*root, nacm->inst[u].path);
+        if (!set) {
+            goto cleanup;
+        }
+        for (v = 0; v < set->number; ++v) {
+            if (nacm_rec_add(&a.inst_ht, set->set.d[v], nacm->inst[u].idx)) {
+                LOGMEM(nacm->ctx);
+                ly_set_free(set);
+                goto cleanup;
+            }
+        }
+        ly_set_free(set);
+    }
+
+    if (nacm_apply_r(&a, root, NACM_NONE)) {
+        LOGMEM(nacm->ctx);
+        goto cleanup;
+    }
+
+    if (denied) {
+        *denied = a.denied;
+        a.denied = NULL;
+    }
+    ret = 0;
+
+cleanup:
+    lyht_free(a.inst_ht);
+    ly_set_free(a.denied);
+    return ret;
+}
@@ -27,6 +27,11 @@
 #include <unistd.h>
 #include <pcre.h>
 #include <time.h>
+#if defined(__SSE2__)
+# include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+# include <arm_neon.h>
+#endif
 
 #include "common.h"
 #include "context.h"
@@ -239,6 +244,18 @@ lyp_data_check_options(struct ly_ctx *ctx, int options, const char *func)
         }
     }
 
+    if ((options & LYD_OPT_PROJECTION) && (x != LYD_OPT_GET) && (x != LYD_OPT_GETCONFIG)) {
+        LOGERR(ctx, LY_EINVAL, "%s: Invalid options 0x%x (LYD_OPT_PROJECTION can be used only with LYD_OPT_GET or LYD_OPT_GETCONFIG)",
+               func, options);
+        return 1;
+    }
+
+    if ((options & LYD_OPT_VAL_DIFF_REF) && !(options & LYD_OPT_VAL_DIFF)) {
+        LOGERR(ctx, LY_EINVAL, "%s: Invalid options 0x%x (LYD_OPT_VAL_DIFF_REF can be used only with LYD_OPT_VAL_DIFF)",
+               func, options);
+        return 1;
+    }
+
     /* "is power of 2" algorithm, with 0 exception */
     if (x && !(x && !(x & (x - 1)))) {
         LOGERR(ctx, LY_EINVAL, "%s: Invalid options 0x%x (multiple data type flags set).", func, options);
@@ -248,6 +265,40 @@ lyp_data_check_options(struct ly_ctx *ctx, int options, const char *func)
     return 0;
 }
 
+int
+lyp_data_projected(const struct ly_set *projection, const struct lys_node *schema)
+{
+    const struct lys_node *iter;
+    unsigned int i;
+
+    if (!projection) {
+        return 1;
+    }
+
+    /* the node or any of its ancestors is selected */
+    for (iter = schema; iter; iter = lys_parent(iter)) {
+        if (ly_set_contains(projection, (void *)iter) > -1) {
+            return 1;
+        }
+    }
+
+    /* the node is an ancestor of a selected node */
+    for (i = 0; i < projection->number; ++i) {
+        for (iter = lys_parent(projection->set.s[i]); iter; iter = lys_parent(iter)) {
+            if (iter == schema) {
+                return 1;
+            }
+        }
+    }
+
+    /* the keys are needed to create the instances of the lists on the way to the selected nodes */
+    if ((schema->nodetype == LYS_LEAF) && lys_is_key((struct lys_node_leaf *)schema, NULL)) {
+        return 1;
+    }
+
+    return 0;
+}
+
 int
 lyp_mmap(struct ly_ctx *ctx, int fd, size_t addsize, size_t *length, void **addr)
 {
@@ -504,93 +555,79 @@ error:
  * kind == 0 - unsigned (unum used), 1 - signed (snum used), 2 - floating point (fnum used)
  */
 static int
-validate_length_range(uint8_t kind, uint64_t unum, int64_t snum, int64_t fnum, uint8_t fnum_dig, struct lys_type *type,
+validate_length_range(uint8_t kind, uint64_t unum, int64_t snum, int64_t fnum, struct lys_type *type,
                       const char *val_str, struct lyd_node *node)
 {
     struct lys_restr *restr = NULL;
-    struct len_ran_intv *intv = NULL, *tmp_intv;
-    struct lys_type *cur_type;
+    struct len_ran_cmp *intv;
     struct ly_ctx *ctx = type->parent->module->ctx;
-    int match;
+    uint64_t value;
+    uint32_t i;
+#ifdef LY_ENABLED_CACHE
+    struct lys_type_eff *eff;
+#endif
 
-    if (resolve_len_ran_interval(ctx, NULL, type, &intv)) {
+#ifdef LY_ENABLED_CACHE
+    eff = lys_type_eff(ctx, type);
+    if (!eff) {
+        return EXIT_FAILURE;
+    }
+    intv = eff->intv;
+#else
+    if (resolve_len_ran_compiled(ctx, type, &intv)) {
         /* already done during schema parsing */
         LOGINT(ctx);
         return EXIT_FAILURE;
     }
+#endif
     if (!intv) {
         return EXIT_SUCCESS;
     }
 
-    /* I know that all intervals belonging to a single restriction share one type pointer */
-    tmp_intv = intv;
-    cur_type = intv->type;
-    do {
-        match = 0;
-        for (; tmp_intv && (tmp_intv->type == cur_type); tmp_intv = tmp_intv->next) {
-            if (match) {
-                /* just iterate through the rest of this restriction intervals */
-                continue;
-            }
-
-            if (((kind == 0) && (unum < tmp_intv->value.uval.min))
-                    || ((kind == 1) && (snum < tmp_intv->value.sval.min))
-                    || ((kind == 2) && (dec64cmp(fnum, fnum_dig, tmp_intv->value.fval.min, cur_type->info.dec64.dig) < 0))) {
-                break;
-            }
-
-            if (((kind == 0) && (unum >= tmp_intv->value.uval.min) && (unum <= tmp_intv->value.uval.max))
-                    || ((kind == 1) && (snum >= tmp_intv->value.sval.min) && (snum <= tmp_intv->value.sval.max))
-                    || ((kind == 2) && (dec64cmp(fnum, fnum_dig, tmp_intv->value.fval.min, cur_type->info.dec64.dig) > -1)
-                    && (dec64cmp(fnum, fnum_dig, tmp_intv->value.fval.max, cur_type->info.dec64.dig) < 1))) {
-                match = 1;
-            }
-        }
+    if (kind == 0) {
+        value = unum;
+    } else if (kind == 1) {
+        value = LEN_RAN_SIGNED(snum);
+    } else {
+        /* fraction-digits value is always the same (it cannot be changed in derived types) */
+        value = LEN_RAN_SIGNED(fnum);
+    }
 
-        if (!match) {
+    /* every restriction must be satisfied */
+    for (i = 0; i < intv->group_count; ++i) {
+        if (!resolve_len_ran_match(&intv->group[i], value)) {
+            restr = intv->group[i].restr;
             break;
-        } else if (tmp_intv) {
-            cur_type = tmp_intv->type;
         }
-    } while (tmp_intv);
-
-    while (intv) {
-        tmp_intv = intv->next;
-        free(intv);
-        intv = tmp_intv;
     }
 
-    if (!match) {
-        switch (cur_type->base) {
-        case LY_TYPE_BINARY:
-            restr = cur_type->info.binary.length;
-            break;
-        case LY_TYPE_DEC64:
-            restr = cur_type->info.dec64.range;
-            break;
-        case LY_TYPE_INT8:
-        case LY_TYPE_INT16:
-        case LY_TYPE_INT32:
-        case LY_TYPE_INT64:
-        case LY_TYPE_UINT8:
-        case LY_TYPE_UINT16:
-        case LY_TYPE_UINT32:
-        case LY_TYPE_UINT64:
-            restr = cur_type->info.num.range;
-            break;
-        case LY_TYPE_STRING:
-            restr = cur_type->info.str.length;
-            break;
-        default:
-            LOGINT(ctx);
-            return EXIT_FAILURE;
+#ifndef LY_ENABLED_CACHE
+    free(intv);
+#endif
+
+    if (restr) {
+        LOGVAL(ctx, LYE_NOCONSTR, LY_VLOG_LYD, node, (val_str ? val_str : ""), restr->expr);
+        if (restr->emsg) {
+            ly_vlog_str(ctx, LY_VLOG_PREV, restr->emsg);
+        }
+        if (restr->eapptag) {
+            ly_err_last_set_apptag(ctx, restr->eapptag);
         }
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
 
-        LOGVAL(ctx, LYE_NOCONSTR, LY_VLOG_LYD, node, (val_str ? val_str : ""), restr ? restr->expr : "");
-        if (restr && restr->emsg) {
+/* logs directly */
+static int
+validate_pattern_restr(struct ly_ctx *ctx, const char *val_str, int rc, struct lys_restr *restr, struct lyd_node *node)
+{
+    if ((rc && restr->expr[0] == 0x06) || (!rc && restr->expr[0] == 0x15)) {
+        LOGVAL(ctx, LYE_NOCONSTR, LY_VLOG_LYD, node, val_str, &restr->expr[1]);
+        if (restr->emsg) {
             ly_vlog_str(ctx, LY_VLOG_PREV, restr->emsg);
         }
-        if (restr && restr->eapptag) {
+        if (restr->eapptag) {
             ly_err_last_set_apptag(ctx, restr->eapptag);
         }
         return EXIT_FAILURE;
@@ -604,7 +641,9 @@ validate_pattern(struct ly_ctx *ctx, const char *val_str, struct lys_type *type,
 {
     int rc;
     unsigned int i;
-#ifndef LY_ENABLED_CACHE
+#ifdef LY_ENABLED_CACHE
+    struct lys_type_eff *eff;
+#else
     pcre *precomp;
 #endif
 
@@ -614,48 +653,35 @@ validate_pattern(struct ly_ctx *ctx, const char *val_str, struct lys_type *type,
         val_str = "";
     }
 
-    if (type->der && validate_pattern(ctx, val_str, &type->der->type, node)) {
+#ifdef LY_ENABLED_CACHE
+    /* the patterns of the whole typedef chain */
+    eff = lys_type_eff(ctx, type);
+    if (!eff) {
         return EXIT_FAILURE;
     }
 
-#ifdef LY_ENABLED_CACHE
-    /* there is no cache, build it */
-    if (!type->info.str.patterns_pcre && type->info.str.pat_count) {
-        type->info.str.patterns_pcre = malloc(2 * type->info.str.pat_count * sizeof *type->info.str.patterns_pcre);
-        LY_CHECK_ERR_RETURN(!type->info.str.patterns_pcre, LOGMEM(ctx), -1);
-
-        for (i = 0; i < type->info.str.pat_count; ++i) {
-            if (lyp_precompile_pattern(ctx, &type->info.str.patterns[i].expr[1],
-                                       (pcre**)&type->info.str.patterns_pcre[i * 2],
-                                       (pcre_extra**)&type->info.str.patterns_pcre[i * 2 + 1])) {
-                return EXIT_FAILURE;
-            }
+    for (i = 0; i < eff->pat_count; ++i) {
+        rc = lyp_regex_exec((pcre *)eff->pat[i].regex, (pcre_extra *)eff->pat[i].study, val_str);
+        if (validate_pattern_restr(ctx, val_str, rc, eff->pat[i].restr, node)) {
+            return EXIT_FAILURE;
         }
     }
-#endif
+#else
+    if (type->der && validate_pattern(ctx, val_str, &type->der->type, node)) {
+        return EXIT_FAILURE;
+    }
 
     for (i = 0; i < type->info.str.pat_count; ++i) {
-#ifdef LY_ENABLED_CACHE
-        rc = pcre_exec((pcre *)type->info.str.patterns_pcre[2 * i], (pcre_extra *)type->info.str.patterns_pcre[2 * i + 1],
-                       val_str, strlen(val_str), 0, 0, NULL, 0);
-#else
         if (lyp_check_pattern(ctx, &type->info.str.patterns[i].expr[1], &precomp)) {
             return EXIT_FAILURE;
         }
         rc = pcre_exec(precomp, NULL, val_str, strlen(val_str), 0, 0, NULL, 0);
         free(precomp);
-#endif
-        if ((rc && type->info.str.patterns[i].expr[0] == 0x06) || (!rc && type->info.str.patterns[i].expr[0] == 0x15)) {
-            LOGVAL(ctx, LYE_NOCONSTR, LY_VLOG_LYD, node, val_str, &type->info.str.patterns[i].expr[1]);
-            if (type->info.str.patterns[i].emsg) {
-                ly_vlog_str(ctx, LY_VLOG_PREV, type->info.str.patterns[i].emsg);
-            }
-            if (type->info.str.patterns[i].eapptag) {
-                ly_err_last_set_apptag(ctx, type->info.str.patterns[i].eapptag);
-            }
+        if (validate_pattern_restr(ctx, val_str, rc, &type->info.str.patterns[i], node)) {
             return EXIT_FAILURE;
         }
     }
+#endif
 
     return EXIT_SUCCESS;
 }
@@ -830,8 +856,8 @@ error:
  * @param[out] pcre_precomp Precompiled PCRE pattern. Can be NULL.
  * @return EXIT_SUCCESS on success, EXIT_FAILURE otherwise.
  */
-int
-lyp_check_pattern(struct ly_ctx *ctx, const char *pattern, pcre **pcre_precomp)
+static int
+lyp_check_pattern_(struct ly_ctx *ctx, const char *pattern, pcre **pcre_precomp)
 {
     int idx, idx2, start, end, err_offset, count;
     char *perl_regex, *ptr;
@@ -944,6 +970,20 @@ lyp_check_pattern(struct ly_ctx *ctx, const char *pattern, pcre **pcre_precomp)
     return EXIT_SUCCESS;
 }
 
+int
+lyp_check_pattern(struct ly_ctx *ctx, const char *pattern, pcre **pcre_precomp)
+{
+    struct ly_stats_phase_prev phase;
+    int rc;
+
+    LY_STATS_ADD(ctx, schema_patterns, 1);
+    ly_stats_phase_enter(ctx, LY_STATS_PHASE_PATTERN, &phase);
+    rc = lyp_check_pattern_(ctx, pattern, pcre_precomp);
+    ly_stats_phase_leave(&phase);
+
+    return rc;
+}
+
 int
 lyp_precompile_pattern(struct ly_ctx *ctx, const char *pattern, pcre** pcre_cmp, pcre_extra **pcre_std)
 {
@@ -954,7 +994,11 @@ lyp_precompile_pattern(struct ly_ctx *ctx, const char *pattern, pcre** pcre_cmp,
     }
 
     if (pcre_std && pcre_cmp) {
+#ifdef PCRE_STUDY_JIT_COMPILE
+        (*pcre_std) = pcre_study(*pcre_cmp, PCRE_STUDY_JIT_COMPILE, &err_msg);
+#else
         (*pcre_std) = pcre_study(*pcre_cmp, 0, &err_msg);
+#endif
         if (err_msg) {
             LOGWRN(ctx, "Studying pattern \"%s\" failed (%s).", pattern, err_msg);
         }
@@ -963,6 +1007,264 @@ lyp_precompile_pattern(struct ly_ctx *ctx, const char *pattern, pcre** pcre_cmp,
     return EXIT_SUCCESS;
 }
 
+/* frees a pattern compiled by lyp_precompile_pattern() */
+void
+lyp_regex_free(pcre *pcre_cmp, pcre_extra *pcre_std)
+{
+    pcre_free_study(pcre_std);
+    pcre_free(pcre_cmp);
+}
+
+size_t
+lyp_regex_mem_size(const pcre *pcre_cmp, const pcre_extra *pcre_std)
+{
+    size_t size = 0, std_size = 0;
+
+    if (pcre_cmp) {
+        pcre_fullinfo(pcre_cmp, NULL, PCRE_INFO_SIZE, &size);
+    }
+    if (pcre_std) {
+        /* JIT compiled code is not included */
+        pcre_fullinfo(pcre_cmp, pcre_std, PCRE_INFO_STUDYSIZE, &std_size);
+        size += sizeof *pcre_std + std_size;
+    }
+
+    return size;
+}
+
+/* matches a whole string, returns the pcre_exec() result */
+int
+lyp_regex_exec(const pcre *pcre_cmp, const pcre_extra *pcre_std, const char *str)
+{
+    int rc;
+
+    rc = pcre_exec(pcre_cmp, pcre_std, str, strlen(str), 0, 0, NULL, 0);
+#ifdef PCRE_ERROR_JIT_STACKLIMIT
+    if ((rc == PCRE_ERROR_JIT_STACKLIMIT) && pcre_std) {
+        /* the JIT stack is too small for this string, use the interpreter */
+        rc = pcre_exec(pcre_cmp, NULL, str, strlen(str), 0, 0, NULL, 0);
+    }
+#endif
+
+    return rc;
+}
+
+#ifdef LY_ENABLED_CACHE
+
+static int
+lyp_regex_val_equal(void *val1_p, void *val2_p, int UNUSED(mod), void *UNUSED(cb_data))
+{
+    return !strcmp(((struct lyp_regex *)val1_p)->pattern, ((struct lyp_regex *)val2_p)->pattern);
+}
+
+#endif
+
+/**
+ * @brief Get a compiled regular expression shared in the context, compile it on the first use.
+ * Logs directly.
+ *
+ * @param[in] ctx Context with the cache.
+ * @param[in] pattern Pattern to get.
+ * @param[out] pcre_cmp Compiled pattern.
+ * @param[out] pcre_std Studied pattern, can be NULL even on success.
+ * @param[out] cached Set if the pattern is owned by the context, otherwise the caller must free it
+ * with lyp_regex_free().
+ * @return EXIT_SUCCESS on success, EXIT_FAILURE otherwise.
+ */
+int
+lyp_regex_get(struct ly_ctx *ctx, const char *pattern, pcre **pcre_cmp, pcre_extra **pcre_std, int *cached)
+{
+#ifdef LY_ENABLED_CACHE
+    struct lyp_regex rec, *match;
+    uint32_t hash;
+    int r;
+
+    rec.pattern = pattern;
+    hash = dict_hash_multi(0, pattern, strlen(pattern));
+    hash = dict_hash_multi(hash, NULL, 0);
+
+    pthread_mutex_lock(&ctx->regex_lock);
+    if (ctx->regex_cache && !lyht_find(ctx->regex_cache, &rec, hash, (void **)&match)) {
+        *pcre_cmp = match->cmp;
+        *pcre_std = match->std;
+        pthread_mutex_unlock(&ctx->regex_lock);
+        *cached = 1;
+        return EXIT_SUCCESS;
+    }
+    pthread_mutex_unlock(&ctx->regex_lock);
+#endif
+
+    *pcre_std = NULL;
+    if (lyp_precompile_pattern(ctx, pattern, pcre_cmp, pcre_std)) {
+        return EXIT_FAILURE;
+    }
+    *cached = 0;
+
+#ifdef LY_ENABLED_CACHE
+    pthread_mutex_lock(&ctx->regex_lock);
+    if (!ctx->regex_cache) {
+        ctx->regex_cache = lyht_new(64, sizeof(struct lyp_regex), lyp_regex_val_equal, NULL, 1);
+        LY_CHECK_ERR_GOTO(!ctx->regex_cache, LOGMEM(ctx), unlock);
+    }
+    if (ctx->regex_cache->used >= LYP_REGEX_CACHE_MAX) {
+        /* do not let the cache grow without limits, the patterns may come from data */
+        goto unlock;
+    }
+
+    rec.pattern = lydict_insert(ctx, pattern, 0);
+    rec.cmp = *pcre_cmp;
+    rec.std = *pcre_std;
+    r = lyht_insert(ctx->regex_cache, &rec, hash, (void **)&match);
+    if (r == 1) {
+        /* compiled by another thread meanwhile, use that one */
+        lydict_remove(ctx, rec.pattern);
+        lyp_regex_free(*pcre_cmp, *pcre_std);
+        *pcre_cmp = match->cmp;
+        *pcre_std = match->std;
+        *cached = 1;
+    } else if (!r) {
+        *cached = 1;
+    } else {
+        lydict_remove(ctx, rec.pattern);
+    }
+
+unlock:
+    pthread_mutex_unlock(&ctx->regex_lock);
+#endif
+
+    return EXIT_SUCCESS;
+}
+
+size_t
+lyp_regex_cache_mem_size(struct ly_ctx *ctx)
+{
+    size_t size = 0;
+#ifdef LY_ENABLED_CACHE
+    struct ht_rec *ht_rec;
+    struct lyp_regex *rec;
+    uint32_t i;
+
+    pthread_mutex_lock(&ctx->regex_lock);
+    if (ctx->regex_cache) {
+        size = lyht_mem_size(ctx->regex_cache);
+        for (i = 0; i < ctx->regex_cache->size; ++i) {
+            if (ctx->regex_cache->ctrl[i] & LYHT_CTRL_FULL) {
+                ht_rec = lyht_get_rec(ctx->regex_cache->recs, ctx->regex_cache->rec_size, i);
+                rec = (struct lyp_regex *)ht_rec->val;
+                size += lyp_regex_mem_size(rec->cmp, rec->std);
+            }
+        }
+    }
+    pthread_mutex_unlock(&ctx->regex_lock);
+#else
+    (void)ctx;
+#endif
+
+    return size;
+}
+
+void
+lyp_regex_cache_free(struct ly_ctx *ctx)
+{
+#ifdef LY_ENABLED_CACHE
+    struct ht_rec *ht_rec;
+    struct lyp_regex *rec;
+    uint32_t i;
+
+    if (!ctx->regex_cache) {
+        return;
+    }
+
+    for (i = 0; i < ctx->regex_cache->size; ++i) {
+        if (ctx->regex_cache->ctrl[i] & LYHT_CTRL_FULL) {
+            ht_rec = lyht_get_rec(ctx->regex_cache->recs, ctx->regex_cache->rec_size, i);
+            rec = (struct lyp_regex *)ht_rec->val;
+            lydict_remove(ctx, rec->pattern);
+            lyp_regex_free(rec->cmp, rec->std);
+        }
+    }
+    lyht_free(ctx->regex_cache);
+    ctx->regex_cache = NULL;
+#else
+    (void)ctx;
+#endif
+}
+
+/* number of the leading characters from the Base64 alphabet (without padding and line breaks), checked in blocks */
+size_t
+lyp_base64_span(const char *data, size_t len)
+{
+    size_t i = 0;
+
+#if defined(__SSE2__)
+    __m128i chunk, ok;
+
+    /* as signed bytes, non-ASCII characters are below all the ranges */
+    for (; i + 16 <= len; i += 16) {
+        chunk = _mm_loadu_si128((const __m128i *)&data[i]);
+        ok = _mm_and_si128(_mm_cmpgt_epi8(chunk, _mm_set1_epi8('A' - 1)), _mm_cmplt_epi8(chunk, _mm_set1_epi8('Z' + 1)));
+        ok = _mm_or_si128(ok, _mm_and_si128(_mm_cmpgt_epi8(chunk, _mm_set1_epi8('a' - 1)),
+                                            _mm_cmplt_epi8(chunk, _mm_set1_epi8('z' + 1))));
+        ok = _mm_or_si128(ok, _mm_and_si128(_mm_cmpgt_epi8(chunk, _mm_set1_epi8('/' - 1)),
+                                            _mm_cmplt_epi8(chunk, _mm_set1_epi8('9' + 1))));
+        ok = _mm_or_si128(ok, _mm_cmpeq_epi8(chunk, _mm_set1_epi8('+')));
+        if (_mm_movemask_epi8(ok) != 0xFFFF) {
+            break;
+        }
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    uint8x16_t chunk, ok;
+
+    for (; i + 16 <= len; i += 16) {
+        chunk = vld1q_u8((const uint8_t *)&data[i]);
+        ok = vandq_u8(vcgeq_u8(chunk, vdupq_n_u8('A')), vcleq_u8(chunk, vdupq_n_u8('Z')));
+        ok = vorrq_u8(ok, vandq_u8(vcgeq_u8(chunk, vdupq_n_u8('a')), vcleq_u8(chunk, vdupq_n_u8('z'))));
+        ok = vorrq_u8(ok, vandq_u8(vcgeq_u8(chunk, vdupq_n_u8('/')), vcleq_u8(chunk, vdupq_n_u8('9'))));
+        ok = vorrq_u8(ok, vceqq_u8(chunk, vdupq_n_u8('+')));
+        if (vminvq_u8(ok) != 0xFF) {
+            break;
+        }
+    }
+#else
+    (void)data;
+    (void)len;
+#endif
+
+    return i;
+}
+
+/* print canonical decimal64 value with dig fraction digits, buf must have at least LYP_NUM_BUFLEN bytes */
+static void
+print_dec64(char *buf, int64_t num, uint8_t dig)
+{
+    char digits[20];
+    uint64_t val;
+    int i, len, trail;
+
+    /* digits in the reverse order, at least one before the floating point */
+    val = (num < 0) ? -(uint64_t)num : (uint64_t)num;
+    len = 0;
+    do {
+        digits[len++] = '0' + val % 10;
+        val /= 10;
+    } while (val || (len < dig + 1));
+
+    /* skip trailing zeros, but keep at least one fraction digit */
+    for (trail = 0; (trail < dig - 1) && (digits[trail] == '0'); ++trail);
+
+    if (num < 0) {
+        *buf++ = '-';
+    }
+    for (i = len - 1; i >= dig; --i) {
+        *buf++ = digits[i];
+    }
+    *buf++ = '.';
+    for (i = dig - 1; i >= trail; --i) {
+        *buf++ = digits[i];
+    }
+    *buf = '\0';
+}
+
 /**
  * @brief Change the value into its canonical form. In libyang, additionally to the RFC,
  * all identities have their module as a prefix in their canonical form.
@@ -979,10 +1281,11 @@ lyp_precompile_pattern(struct ly_ctx *ctx, const char *pattern, pcre** pcre_cmp,
  * @param[in] data2 If \p type is #LY_TYPE_BITS: (int *) type bit field length,
  *                                #LY_TYPE_DEC64: (uint8_t *) number of fraction digits (position of the floating point),
  *                                otherwise ignored.
+ * @param[in] priv Whether \p value is a private string (#LY_VALUE_PRIVATE) instead of a dictionary string.
  * @return 1 if a conversion took place, 0 if the value was kept the same.
  */
 static int
-make_canonical(struct ly_ctx *ctx, int type, const char **value, void *data1, void *data2)
+make_canonical(struct ly_ctx *ctx, int type, const char **value, void *data1, void *data2, int priv)
 {
     const uint16_t buf_len = 511;
     char buf[buf_len + 1];
@@ -992,7 +1295,6 @@ make_canonical(struct ly_ctx *ctx, int type, const char **value, void *data1, vo
     int i, j, count;
     int64_t num;
     uint64_t unum;
-    uint8_t c;
 
     switch (type) {
     case LY_TYPE_BITS:
@@ -1089,33 +1391,7 @@ make_canonical(struct ly_ctx *ctx, int type, const char **value, void *data1, vo
         break;
 
     case LY_TYPE_DEC64:
-        num = *((int64_t *)data1);
-        c = *((uint8_t *)data2);
-        if (num) {
-            count = sprintf(buf, "%"PRId64" ", num);
-            if ( (num > 0 && (count - 1) <= c)
-                 || (count - 2) <= c ) {
-                /* we have 0. value, print the value with the leading zeros
-                 * (one for 0. and also keep the correct with of num according
-                 * to fraction-digits value)
-                 * for (num<0) - extra character for '-' sign */
-                count = sprintf(buf, "%0*"PRId64" ", (num > 0) ? (c + 1) : (c + 2), num);
-            }
-            for (i = c, j = 1; i > 0 ; i--) {
-                if (j && i > 1 && buf[count - 2] == '0') {
-                    /* we have trailing zero to skip */
-                    buf[count - 1] = '\0';
-                } else {
-                    j = 0;
-                    buf[count - 1] = buf[count - 2];
-                }
-                count--;
-            }
-            buf[count - 1] = '.';
-        } else {
-            /* zero */
-            sprintf(buf, "0.0");
-        }
+        print_dec64(buf, *((int64_t *)data1), *((uint8_t *)data2));
         break;
 
     case LY_TYPE_INT8:
@@ -1140,14 +1416,78 @@ make_canonical(struct ly_ctx *ctx, int type, const char **value, void *data1, vo
     }
 
     if (strcmp(buf, *value)) {
-        lydict_remove(ctx, *value);
-        *value = lydict_insert(ctx, buf, 0);
+        lydict_remove_priv(ctx, *value, priv);
+        *value = lydict_insert_priv(ctx, buf, 0, priv);
         return 1;
     }
 
     return 0;
 }
 
+int
+lyp_num_value(struct lys_type *type, const lyd_val *value, char *buf, struct lyd_node *node)
+{
+    int64_t num = 0;
+    uint64_t unum = 0;
+    uint8_t kind;
+
+    switch (type->base) {
+    case LY_TYPE_BOOL:
+        strcpy(buf, value->bln ? "true" : "false");
+        return 0;
+    case LY_TYPE_DEC64:
+        num = value->dec64;
+        print_dec64(buf, num, type->info.dec64.dig);
+        kind = 2;
+        break;
+    case LY_TYPE_INT8:
+        num = value->int8;
+        kind = 1;
+        break;
+    case LY_TYPE_INT16:
+        num = value->int16;
+        kind = 1;
+        break;
+    case LY_TYPE_INT32:
+        num = value->int32;
+        kind = 1;
+        break;
+    case LY_TYPE_INT64:
+        num = value->int64;
+        kind = 1;
+        break;
+    case LY_TYPE_UINT8:
+        unum = value->uint8;
+        kind = 0;
+        break;
+    case LY_TYPE_UINT16:
+        unum = value->uint16;
+        kind = 0;
+        break;
+    case LY_TYPE_UINT32:
+        unum = value->uint32;
+        kind = 0;
+        break;
+    case LY_TYPE_UINT64:
+        unum = value->uint64;
+        kind = 0;
+        break;
+    default:
+        return -1;
+    }
+
+    if (kind == 1) {
+        sprintf(buf, "%"PRId64, num);
+    } else if (kind == 0) {
+        sprintf(buf, "%"PRIu64, unum);
+    }
+
+    if (node && validate_length_range(kind, unum, num, num, type, buf, node)) {
+        return 1;
+    }
+    return 0;
+}
+
 static const char *
 ident_val_add_module_prefix(const char *value, const struct lyxml_elem *xml, struct ly_ctx *ctx)
 {
@@ -1189,6 +1529,60 @@ ident_val_add_module_prefix(const char *value, const struct lyxml_elem *xml, str
     return lydict_insert_zc(ctx, str);
 }
 
+int
+lyp_union_value_class(const char *value)
+{
+    int vclass = 0;
+
+    if (!value || !value[0]) {
+        return LYP_UNI_EMPTY;
+    }
+
+    for (; *value && ((vclass & LYP_UNI_ALL) != LYP_UNI_ALL); ++value) {
+        if (isdigit(*value) || (*value == '+') || isspace(*value)) {
+            continue;
+        }
+        if (*value != '-') {
+            vclass |= LYP_UNI_NONINT;
+            if (*value != '.') {
+                vclass |= LYP_UNI_NONDEC;
+            }
+        }
+        if (!isalpha(*value) && (*value != '/') && (*value != '=')) {
+            vclass |= LYP_UNI_NONB64;
+        }
+    }
+
+    return vclass;
+}
+
+int
+lyp_union_type_skip(const struct lys_type *type, const char *value, int vclass)
+{
+    switch (type->base) {
+    case LY_TYPE_INT8:
+    case LY_TYPE_INT16:
+    case LY_TYPE_INT32:
+    case LY_TYPE_INT64:
+    case LY_TYPE_UINT8:
+    case LY_TYPE_UINT16:
+    case LY_TYPE_UINT32:
+    case LY_TYPE_UINT64:
+        return vclass & (LYP_UNI_EMPTY | LYP_UNI_NONINT);
+    case LY_TYPE_DEC64:
+        return vclass & (LYP_UNI_EMPTY | LYP_UNI_NONDEC);
+    case LY_TYPE_BINARY:
+        return vclass & LYP_UNI_NONB64;
+    case LY_TYPE_BOOL:
+        return (vclass & LYP_UNI_EMPTY) || (strcmp(value, "true") && strcmp(value, "false"));
+    case LY_TYPE_EMPTY:
+        return !(vclass & LYP_UNI_EMPTY);
+    default:
+        /* no cheap way to decide */
+        return 0;
+    }
+}
+
 /*
  * xml  - optional for converting instance-identifier and identityref into JSON format
  * leaf - mandatory to know the context (necessary e.g. for prefixes in idenitytref values)
@@ -1196,7 +1590,8 @@ ident_val_add_module_prefix(const char *value, const struct lyxml_elem *xml, str
  * local_mod - optional if the local module dos not match the module of leaf/attr
  * store - flag for union resolution - we do not want to store the result, we are just learning the type
  * dflt - whether the value is a default value from the schema
- * trusted - whether the value is trusted to be valid (but may not be canonical, so it is canonized)
+ * trusted - whether the value is trusted to be valid (but may not be canonical, so it is canonized),
+ *           LYP_TRUSTED_CANON if it is also trusted to be canonical
  */
 struct lys_type *
 lyp_parse_value(struct lys_type *type, const char **value_, struct lyxml_elem *xml,
@@ -1206,18 +1601,22 @@ lyp_parse_value(struct lys_type *type, const char **value_, struct lyxml_elem *x
     struct lys_type *ret = NULL, *t;
     struct lys_tpdf *tpdf;
     enum int_log_opts prev_ilo;
-    int c, len, found = 0;
+    int c, len, found = 0, user_type = 1, priv;
     unsigned int i, j;
     int64_t num;
     uint64_t unum, uind, u = 0;
     const char *ptr, *value = *value_, *itemname;
-    struct lys_type_bit **bits = NULL;
+    struct lys_type_bit **bits = NULL, *bit;
+    struct lys_type_enum *enm;
     struct lys_ident *ident;
-    lyd_val *val, old_val;
+    lyd_val *val, old_val, user_val;
     LY_DATA_TYPE *val_type, old_val_type;
     uint8_t *val_flags, old_val_flags;
     struct lyd_node *contextnode;
     struct ly_ctx *ctx = type->parent->module->ctx;
+#ifdef LY_ENABLED_CACHE
+    struct lys_type_eff *eff;
+#endif
 
     assert(leaf || attr);
 
@@ -1231,6 +1630,7 @@ lyp_parse_value(struct lys_type *type, const char **value_, struct lyxml_elem *x
         val_flags = &leaf->value_flags;
         contextnode = (struct lyd_node *)leaf;
         itemname = leaf->schema->name;
+        priv = leaf->value_flags & LY_VALUE_PRIVATE;
     } else {
         assert(!leaf);
         if (!local_mod) {
@@ -1241,6 +1641,7 @@ lyp_parse_value(struct lys_type *type, const char **value_, struct lyxml_elem *x
         val_flags = &attr->value_flags;
         contextnode = attr->parent;
         itemname = attr->name;
+        priv = 0;
     }
 
     /* fully clear the value */
@@ -1249,12 +1650,26 @@ lyp_parse_value(struct lys_type *type, const char **value_, struct lyxml_elem *x
         *val_flags &= ~LY_VALUE_UNRES;
     }
 
+#ifdef LY_ENABLED_CACHE
+    eff = LYS_TYPE_EFF(type);
+    if ((store == 1) && value && !dflt && eff && eff->parse && !eff->parse(eff->info, value, val)) {
+        /* the specialized parser accepts only valid values in the canonical form */
+        *val_type = type->base;
+        type = eff->info;
+        goto stored;
+    }
+#endif
+
     switch (type->base) {
     case LY_TYPE_BINARY:
         /* get number of octets for length validation */
         unum = 0;
         ptr = NULL;
-        if (value) {
+        if (value && (trusted == LYP_TRUSTED_CANON)) {
+            /* no whitespaces to skip, the length is not needed */
+            ptr = value;
+            u = strlen(ptr);
+        } else if (value) {
             /* silently skip leading/trailing whitespaces */
             for (uind = 0; isspace(value[uind]); ++uind);
             ptr = &value[uind];
@@ -1263,7 +1678,8 @@ lyp_parse_value(struct lys_type *type, const char **value_, struct lyxml_elem *x
                 --u;
             }
             unum = u;
-            for (uind = 0; uind < u; ++uind) {
+            /* the plain Base64 characters in bulk, only the rest one by one */
+            for (uind = lyp_base64_span(ptr, u); uind < u; ++uind) {
                 if (ptr[uind] == '\n') {
                     unum--;
                 } else if ((ptr[uind] < '/' && ptr[uind] != '+') ||
@@ -1301,7 +1717,7 @@ lyp_parse_value(struct lys_type *type, const char **value_, struct lyxml_elem *x
 
         /* length of the encoded string */
         len = ((unum / 4) * 3) - found;
-        if (!trusted && validate_length_range(0, len, 0, 0, 0, type, value, contextnode)) {
+        if (!trusted && validate_length_range(0, len, 0, 0, type, value, contextnode)) {
             goto error;
         }
 
@@ -1323,19 +1739,26 @@ lyp_parse_value(struct lys_type *type, const char **value_, struct lyxml_elem *x
         /* locate bits structure with the bits definitions
          * since YANG 1.1 allows restricted bits, it is the first
          * bits type with some explicit bit specification */
+#ifdef LY_ENABLED_CACHE
+        eff = lys_type_eff(ctx, type);
+        LY_CHECK_GOTO(!eff, error);
+        type = eff->info;
+#else
         for (; !type->info.bits.count; type = &type->der->type);
+#endif
 
         if (value || store) {
             /* allocate the array of pointers to bits definition */
-            bits = calloc(type->info.bits.count, sizeof *bits);
-            LY_CHECK_ERR_GOTO(!bits, LOGMEM(ctx), error);
+            bits = lyd_bits_new(ctx, type->info.bits.count);
+            LY_CHECK_GOTO(!bits, error);
         }
 
         if (!value) {
             /* no bits set */
             if (store) {
                 /* store empty array */
-                val->bit = bits;
+                val->bit = lyd_bits_share(bits);
+                LY_CHECK_GOTO(!val->bit, error);
                 *val_type = LY_TYPE_BITS;
             }
             break;
@@ -1360,65 +1783,69 @@ lyp_parse_value(struct lys_type *type, const char **value_, struct lyxml_elem *x
             c = c - len;
 
             /* find bit definition, identifiers appear ordered by their posititon */
-            for (found = i = 0; i < type->info.bits.count; i++) {
-                if (!strncmp(type->info.bits.bit[i].name, &value[c], len) && !type->info.bits.bit[i].name[len]) {
-                    /* we have match, check if the value is enabled ... */
-                    for (j = 0; !trusted && (j < type->info.bits.bit[i].iffeature_size); j++) {
-                        if (!resolve_iffeature(&type->info.bits.bit[i].iffeature[j])) {
-                            if (leaf) {
-                                LOGVAL(ctx, LYE_INVAL, LY_VLOG_LYD, contextnode, value, itemname);
-                            } else {
-                                LOGVAL(ctx, LYE_INMETA, LY_VLOG_LYD, contextnode, "<none>", itemname, value);
-                            }
-                            LOGVAL(ctx, LYE_SPEC, LY_VLOG_PREV, NULL,
-                                   "Bit \"%s\" is disabled by its %d. if-feature condition.",
-                                   type->info.bits.bit[i].name, j + 1);
-                            free(bits);
-                            goto error;
-                        }
-                    }
-                    /* check that the value was not already set */
-                    if (bits[i]) {
-                        if (leaf) {
-                            LOGVAL(ctx, LYE_INVAL, LY_VLOG_LYD, contextnode, value, itemname);
-                        } else {
-                            LOGVAL(ctx, LYE_INMETA, LY_VLOG_LYD, contextnode, "<none>", itemname, value);
-                        }
-                        LOGVAL(ctx, LYE_SPEC, LY_VLOG_PREV, NULL, "Bit \"%s\" used multiple times.",
-                               type->info.bits.bit[i].name);
-                        free(bits);
-                        goto error;
+            if (!lys_find_bit_hash(ctx, type, &value[c], len, &bit)) {
+                i = bit ? bit - type->info.bits.bit : type->info.bits.count;
+            } else {
+                for (i = 0; i < type->info.bits.count; i++) {
+                    if (!strncmp(type->info.bits.bit[i].name, &value[c], len) && !type->info.bits.bit[i].name[len]) {
+                        break;
                     }
-                    /* ... and then store the pointer */
-                    bits[i] = &type->info.bits.bit[i];
-
-                    /* stop searching */
-                    found = 1;
-                    break;
                 }
             }
-
-            if (!found) {
+            if (i == type->info.bits.count) {
                 /* referenced bit value does not exist */
                 if (leaf) {
                     LOGVAL(ctx, LYE_INVAL, LY_VLOG_LYD, contextnode, value, itemname);
                 } else {
                     LOGVAL(ctx, LYE_INMETA, LY_VLOG_LYD, contextnode, "<none>", itemname, value);
                 }
-                free(bits);
+                lyd_bits_free(bits);
                 goto error;
             }
+
+            /* we have match, check if the value is enabled ... */
+            for (j = 0; !trusted && (j < type->info.bits.bit[i].iffeature_size); j++) {
+                if (!resolve_iffeature(&type->info.bits.bit[i].iffeature[j])) {
+                    if (leaf) {
+                        LOGVAL(ctx, LYE_INVAL, LY_VLOG_LYD, contextnode, value, itemname);
+                    } else {
+                        LOGVAL(ctx, LYE_INMETA, LY_VLOG_LYD, contextnode, "<none>", itemname, value);
+                    }
+                    LOGVAL(ctx, LYE_SPEC, LY_VLOG_PREV, NULL,
+                           "Bit \"%s\" is disabled by its %d. if-feature condition.",
+                           type->info.bits.bit[i].name, j + 1);
+                    lyd_bits_free(bits);
+                    goto error;
+                }
+            }
+            /* check that the value was not already set */
+            if (bits[i]) {
+                if (leaf) {
+                    LOGVAL(ctx, LYE_INVAL, LY_VLOG_LYD, contextnode, value, itemname);
+                } else {
+                    LOGVAL(ctx, LYE_INMETA, LY_VLOG_LYD, contextnode, "<none>", itemname, value);
+                }
+                LOGVAL(ctx, LYE_SPEC, LY_VLOG_PREV, NULL, "Bit \"%s\" used multiple times.",
+                       type->info.bits.bit[i].name);
+                lyd_bits_free(bits);
+                goto error;
+            }
+            /* ... and then store the pointer */
+            bits[i] = &type->info.bits.bit[i];
             c = c + len;
         }
 
-        make_canonical(ctx, LY_TYPE_BITS, value_, bits, &type->info.bits.count);
+        if (trusted != LYP_TRUSTED_CANON) {
+            make_canonical(ctx, LY_TYPE_BITS, value_, bits, &type->info.bits.count, 0);
+        }
 
         if (store) {
-            /* store the result */
-            val->bit = bits;
+            /* store the result, shared with all the same values */
+            val->bit = lyd_bits_share(bits);
+            LY_CHECK_GOTO(!val->bit, error);
             *val_type = LY_TYPE_BITS;
         } else {
-            free(bits);
+            lyd_bits_free(bits);
         }
         break;
 
@@ -1465,11 +1892,13 @@ lyp_parse_value(struct lys_type *type, const char **value_, struct lyxml_elem *x
             goto error;
         }
 
-        if (!trusted && validate_length_range(2, 0, 0, num, type->info.dec64.dig, type, value, contextnode)) {
+        if (!trusted && validate_length_range(2, 0, 0, num, type, value, contextnode)) {
             goto error;
         }
 
-        make_canonical(ctx, LY_TYPE_DEC64, value_, &num, &type->info.dec64.dig);
+        if (trusted != LYP_TRUSTED_CANON) {
+            make_canonical(ctx, LY_TYPE_DEC64, value_, &num, &type->info.dec64.dig, priv);
+        }
 
         if (store) {
             /* store the result */
@@ -1497,35 +1926,26 @@ lyp_parse_value(struct lys_type *type, const char **value_, struct lyxml_elem *x
         /* locate enums structure with the enumeration definitions,
          * since YANG 1.1 allows restricted enums, it is the first
          * enum type with some explicit enum specification */
+#ifdef LY_ENABLED_CACHE
+        eff = lys_type_eff(ctx, type);
+        LY_CHECK_GOTO(!eff, error);
+        type = eff->info;
+#else
         for (; !type->info.enums.count; type = &type->der->type);
+#endif
 
         /* find matching enumeration value */
-        for (i = found = 0; i < type->info.enums.count; i++) {
-            if (value && !strcmp(value, type->info.enums.enm[i].name)) {
-                /* we have match, check if the value is enabled ... */
-                for (j = 0; !trusted && (j < type->info.enums.enm[i].iffeature_size); j++) {
-                    if (!resolve_iffeature(&type->info.enums.enm[i].iffeature[j])) {
-                        if (leaf) {
-                            LOGVAL(ctx, LYE_INVAL, LY_VLOG_LYD, contextnode, value, itemname);
-                        } else {
-                            LOGVAL(ctx, LYE_INMETA, LY_VLOG_LYD, contextnode, "<none>", itemname, value);
-                        }
-                        LOGVAL(ctx, LYE_SPEC, LY_VLOG_PREV, NULL, "Enum \"%s\" is disabled by its %d. if-feature condition.",
-                               value, j + 1);
-                        goto error;
-                    }
-                }
-                /* ... and store pointer to the definition */
-                if (store) {
-                    val->enm = &type->info.enums.enm[i];
-                    *val_type = LY_TYPE_ENUM;
+        i = type->info.enums.count;
+        if (value) {
+            if (!lys_find_enum_hash(ctx, type, value, &enm)) {
+                if (enm) {
+                    i = enm - type->info.enums.enm;
                 }
-                found = 1;
-                break;
+            } else {
+                for (i = 0; (i < type->info.enums.count) && strcmp(value, type->info.enums.enm[i].name); i++);
             }
         }
-
-        if (!found) {
+        if (i == type->info.enums.count) {
             if (leaf) {
                 LOGVAL(ctx, LYE_INVAL, LY_VLOG_LYD, contextnode, value ? value : "", itemname);
             } else {
@@ -1533,6 +1953,25 @@ lyp_parse_value(struct lys_type *type, const char **value_, struct lyxml_elem *x
             }
             goto error;
         }
+
+        /* we have match, check if the value is enabled ... */
+        for (j = 0; !trusted && (j < type->info.enums.enm[i].iffeature_size); j++) {
+            if (!resolve_iffeature(&type->info.enums.enm[i].iffeature[j])) {
+                if (leaf) {
+                    LOGVAL(ctx, LYE_INVAL, LY_VLOG_LYD, contextnode, value, itemname);
+                } else {
+                    LOGVAL(ctx, LYE_INMETA, LY_VLOG_LYD, contextnode, "<none>", itemname, value);
+                }
+                LOGVAL(ctx, LYE_SPEC, LY_VLOG_PREV, NULL, "Enum \"%s\" is disabled by its %d. if-feature condition.",
+                       value, j + 1);
+                goto error;
+            }
+        }
+        /* ... and store pointer to the definition */
+        if (store) {
+            val->enm = &type->info.enums.enm[i];
+            *val_type = LY_TYPE_ENUM;
+        }
         break;
 
     case LY_TYPE_IDENT:
@@ -1597,7 +2036,7 @@ lyp_parse_value(struct lys_type *type, const char **value_, struct lyxml_elem *x
             type->parent->flags |= LYS_DFLTJSON;
         }
 
-        make_canonical(ctx, LY_TYPE_IDENT, &value, (void*)lys_main_module(local_mod)->name, NULL);
+        make_canonical(ctx, LY_TYPE_IDENT, &value, (void*)lys_main_module(local_mod)->name, NULL, 0);
 
         /* replace the old value with the new one (even if they may be the same) */
         lydict_remove(ctx, *value_);
@@ -1649,8 +2088,8 @@ lyp_parse_value(struct lys_type *type, const char **value_, struct lyxml_elem *x
             }
             /* turn logging back on */
             ly_ilo_restore(NULL, prev_ilo, NULL, 0);
-        } else {
-            if (make_canonical(ctx, LY_TYPE_INST, &value, NULL, NULL)) {
+        } else if (trusted != LYP_TRUSTED_CANON) {
+            if (make_canonical(ctx, LY_TYPE_INST, &value, NULL, NULL, 0)) {
                 /* if a change occured, value was removed from the dicionary so fix the pointers */
                 *value_ = value;
             }
@@ -1687,7 +2126,7 @@ lyp_parse_value(struct lys_type *type, const char **value_, struct lyxml_elem *x
 
         /* it is called not only to get the final type, but mainly to update value to canonical or JSON form
          * if needed */
-        t = lyp_parse_value(&type->info.lref.target->type, value_, xml, leaf, attr, NULL, store, dflt, trusted);
+        t = lyp_parse_value(&type->info.lref.target->type, value_, xml, leaf, attr, NULL, store ? 2 : 0, dflt, trusted);
         value = *value_; /* refresh possibly changed value */
         if (!t) {
             if (leaf) {
@@ -1704,10 +2143,11 @@ lyp_parse_value(struct lys_type *type, const char **value_, struct lyxml_elem *x
         }
 
         type = t;
+        user_type = 0;
         break;
 
     case LY_TYPE_STRING:
-        if (!trusted && validate_length_range(0, (value ? strlen(value) : 0), 0, 0, 0, type, value, contextnode)) {
+        if (!trusted && validate_length_range(0, (value ? ly_utf8_count(value, strlen(value)) : 0), 0, 0, type, value, contextnode)) {
             goto error;
         }
 
@@ -1732,7 +2172,13 @@ lyp_parse_value(struct lys_type *type, const char **value_, struct lyxml_elem *x
                 goto error;
             }
 
-            if (!ly_strequal(value, *value_, 1)) {
+            if (priv) {
+                /* replace the private value by a private copy */
+                lydict_remove_priv(ctx, *value_, 1);
+                *value_ = lydict_insert_priv(ctx, value, 0, 1);
+                lydict_remove(ctx, value);
+                value = *value_;
+            } else if (!ly_strequal(value, *value_, 1)) {
                 /* update the changed value */
                 lydict_remove(ctx, *value_);
                 *value_ = value;
@@ -1748,11 +2194,13 @@ lyp_parse_value(struct lys_type *type, const char **value_, struct lyxml_elem *x
 
     case LY_TYPE_INT8:
         if (parse_int(value, __INT64_C(-128), __INT64_C(127), dflt ? 0 : 10, &num, contextnode)
-                || (!trusted && validate_length_range(1, 0, num, 0, 0, type, value, contextnode))) {
+                || (!trusted && validate_length_range(1, 0, num, 0, type, value, contextnode))) {
             goto error;
         }
 
-        make_canonical(ctx, LY_TYPE_INT8, value_, &num, NULL);
+        if (trusted != LYP_TRUSTED_CANON) {
+            make_canonical(ctx, LY_TYPE_INT8, value_, &num, NULL, priv);
+        }
 
         if (store) {
             /* store the result */
@@ -1763,11 +2211,13 @@ lyp_parse_value(struct lys_type *type, const char **value_, struct lyxml_elem *x
 
     case LY_TYPE_INT16:
         if (parse_int(value, __INT64_C(-32768), __INT64_C(32767), dflt ? 0 : 10, &num, contextnode)
-                || (!trusted && validate_length_range(1, 0, num, 0, 0, type, value, contextnode))) {
+                || (!trusted && validate_length_range(1, 0, num, 0, type, value, contextnode))) {
             goto error;
         }
 
-        make_canonical(ctx, LY_TYPE_INT16, value_, &num, NULL);
+        if (trusted != LYP_TRUSTED_CANON) {
+            make_canonical(ctx, LY_TYPE_INT16, value_, &num, NULL, priv);
+        }
 
         if (store) {
             /* store the result */
@@ -1778,11 +2228,13 @@ lyp_parse_value(struct lys_type *type, const char **value_, struct lyxml_elem *x
 
     case LY_TYPE_INT32:
         if (parse_int(value, __INT64_C(-2147483648), __INT64_C(2147483647), dflt ? 0 : 10, &num, contextnode)
-                || (!trusted && validate_length_range(1, 0, num, 0, 0, type, value, contextnode))) {
+                || (!trusted && validate_length_range(1, 0, num, 0, type, value, contextnode))) {
             goto error;
         }
 
-        make_canonical(ctx, LY_TYPE_INT32, value_, &num, NULL);
+        if (trusted != LYP_TRUSTED_CANON) {
+            make_canonical(ctx, LY_TYPE_INT32, value_, &num, NULL, priv);
+        }
 
         if (store) {
             /* store the result */
@@ -1794,11 +2246,13 @@ lyp_parse_value(struct lys_type *type, const char **value_, struct lyxml_elem *x
     case LY_TYPE_INT64:
         if (parse_int(value, __INT64_C(-9223372036854775807) - __INT64_C(1), __INT64_C(9223372036854775807),
                       dflt ? 0 : 10, &num, contextnode)
-                || (!trusted && validate_length_range(1, 0, num, 0, 0, type, value, contextnode))) {
+                || (!trusted && validate_length_range(1, 0, num, 0, type, value, contextnode))) {
             goto error;
         }
 
-        make_canonical(ctx, LY_TYPE_INT64, value_, &num, NULL);
+        if (trusted != LYP_TRUSTED_CANON) {
+            make_canonical(ctx, LY_TYPE_INT64, value_, &num, NULL, priv);
+        }
 
         if (store) {
             /* store the result */
@@ -1809,11 +2263,13 @@ lyp_parse_value(struct lys_type *type, const char **value_, struct lyxml_elem *x
 
     case LY_TYPE_UINT8:
         if (parse_uint(value, __UINT64_C(255), dflt ? 0 : 10, &unum, contextnode)
-                || (!trusted && validate_length_range(0, unum, 0, 0, 0, type, value, contextnode))) {
+                || (!trusted && validate_length_range(0, unum, 0, 0, type, value, contextnode))) {
             goto error;
         }
 
-        make_canonical(ctx, LY_TYPE_UINT8, value_, &unum, NULL);
+        if (trusted != LYP_TRUSTED_CANON) {
+            make_canonical(ctx, LY_TYPE_UINT8, value_, &unum, NULL, priv);
+        }
 
         if (store) {
             /* store the result */
@@ -1824,11 +2280,13 @@ lyp_parse_value(struct lys_type *type, const char **value_, struct lyxml_elem *x
 
     case LY_TYPE_UINT16:
         if (parse_uint(value, __UINT64_C(65535), dflt ? 0 : 10, &unum, contextnode)
-                || (!trusted && validate_length_range(0, unum, 0, 0, 0, type, value, contextnode))) {
+                || (!trusted && validate_length_range(0, unum, 0, 0, type, value, contextnode))) {
             goto error;
         }
 
-        make_canonical(ctx, LY_TYPE_UINT16, value_, &unum, NULL);
+        if (trusted != LYP_TRUSTED_CANON) {
+            make_canonical(ctx, LY_TYPE_UINT16, value_, &unum, NULL, priv);
+        }
 
         if (store) {
             /* store the result */
@@ -1839,11 +2297,13 @@ lyp_parse_value(struct lys_type *type, const char **value_, struct lyxml_elem *x
 
     case LY_TYPE_UINT32:
         if (parse_uint(value, __UINT64_C(4294967295), dflt ? 0 : 10, &unum, contextnode)
-                || (!trusted && validate_length_range(0, unum, 0, 0, 0, type, value, contextnode))) {
+                || (!trusted && validate_length_range(0, unum, 0, 0, type, value, contextnode))) {
             goto error;
         }
 
-        make_canonical(ctx, LY_TYPE_UINT32, value_, &unum, NULL);
+        if (trusted != LYP_TRUSTED_CANON) {
+            make_canonical(ctx, LY_TYPE_UINT32, value_, &unum, NULL, priv);
+        }
 
         if (store) {
             /* store the result */
@@ -1854,11 +2314,13 @@ lyp_parse_value(struct lys_type *type, const char **value_, struct lyxml_elem *x
 
     case LY_TYPE_UINT64:
         if (parse_uint(value, __UINT64_C(18446744073709551615), dflt ? 0 : 10, &unum, contextnode)
-                || (!trusted && validate_length_range(0, unum, 0, 0, 0, type, value, contextnode))) {
+                || (!trusted && validate_length_range(0, unum, 0, 0, type, value, contextnode))) {
             goto error;
         }
 
-        make_canonical(ctx, LY_TYPE_UINT64, value_, &unum, NULL);
+        if (trusted != LYP_TRUSTED_CANON) {
+            make_canonical(ctx, LY_TYPE_UINT64, value_, &unum, NULL, priv);
+        }
 
         if (store) {
             /* store the result */
@@ -1892,16 +2354,24 @@ lyp_parse_value(struct lys_type *type, const char **value_, struct lyxml_elem *x
 
         t = NULL;
         found = 0;
+        /* schema default values of integer types may be hexadecimal or octal, do not filter those */
+        c = dflt ? 0 : lyp_union_value_class(value);
 
         /* turn logging off, we are going to try to validate the value with all the types in order */
         ly_ilo_change(NULL, ILO_IGNORE, &prev_ilo, NULL);
 
         while ((t = lyp_get_next_union_type(type, t, &found))) {
             found = 0;
-            ret = lyp_parse_value(t, value_, xml, leaf, attr, NULL, store, dflt, 0);
+            if (!dflt && lyp_union_type_skip(t, value, c)) {
+                /* the value cannot be of this type */
+                continue;
+            }
+            ret = lyp_parse_value(t, value_, xml, leaf, attr, NULL, store ? 2 : 0, dflt,
+                                  (trusted == LYP_TRUSTED_CANON) ? trusted : 0);
             if (ret) {
                 /* we have the result */
                 type = ret;
+                user_type = 0;
                 break;
             }
 
@@ -1934,13 +2404,33 @@ lyp_parse_value(struct lys_type *type, const char **value_, struct lyxml_elem *x
         goto error;
     }
 
+#ifdef LY_ENABLED_CACHE
+stored:
+#endif
     /* search user types in case this value is supposed to be stored in a custom way */
-    if (store && type->der && type->der->module) {
-        c = lytype_store(type->der->module, type->der->name, *value_, val);
+    if (store && user_type && type->der && type->der->module) {
+        user_val = *val;
+        c = lytype_store(type->der, *value_, &user_val);
         if (c == -1) {
             goto error;
         } else if (!c) {
-            *val_flags |= LY_VALUE_USER;
+            /* adopt the canonical form printed by the plugin */
+            if ((trusted != LYP_TRUSTED_CANON) && lytype_canonize(type->der, &user_val, value_, priv)) {
+                lytype_free(type->der, user_val);
+                goto error;
+            }
+
+            if (store == 1) {
+                *val = user_val;
+                *val_flags |= LY_VALUE_USER;
+            } else {
+                /* union members and leafref targets keep only the canonical string, the union or leafref
+                 * type would not know how to free the user value */
+                lytype_free(type->der, user_val);
+                if ((*val_type == LY_TYPE_STRING) || (*val_type == LY_TYPE_BINARY)) {
+                    val->string = *value_;
+                }
+            }
         }
     }
 
@@ -2000,10 +2490,9 @@ lyp_fill_attr(struct ly_ctx *ctx, struct lyd_node *parent, const char *module_ns
               const char *attr_name, const char *attr_value, struct lyxml_elem *xml, int options, struct lyd_attr **ret)
 {
     const struct lys_module *mod = NULL;
-    const struct lys_submodule *submod = NULL;
+    struct lys_ext_instance_complex *annot;
     struct lys_type **type;
     struct lyd_attr *dattr;
-    int pos, i, j, k;
 
     /* first, get module where the annotation should be defined */
     if (module_ns) {
@@ -2019,36 +2508,8 @@ lyp_fill_attr(struct ly_ctx *ctx, struct lyd_node *parent, const char *module_ns
     }
 
     /* then, find the appropriate annotation definition */
-    pos = -1;
-    for (i = 0, j = 0; i < mod->ext_size; i = i + j + 1) {
-        j = lys_ext_instance_presence(&ctx->models.list[0]->extensions[0], &mod->ext[i], mod->ext_size - i);
-        if (j == -1) {
-            break;
-        }
-        if (ly_strequal(mod->ext[i + j]->arg_value, attr_name, 0)) {
-            pos = i + j;
-            break;
-        }
-    }
-
-    /* try submodules */
-    if (pos == -1) {
-        for (k = 0; k < mod->inc_size; ++k) {
-            submod = mod->inc[k].submodule;
-            for (i = 0, j = 0; i < submod->ext_size; i = i + j + 1) {
-                j = lys_ext_instance_presence(&ctx->models.list[0]->extensions[0], &submod->ext[i], submod->ext_size - i);
-                if (j == -1) {
-                    break;
-                }
-                if (ly_strequal(submod->ext[i + j]->arg_value, attr_name, 0)) {
-                    pos = i + j;
-                    break;
-                }
-            }
-        }
-    }
-
-    if (pos == -1) {
+    annot = lys_find_annotation(mod, attr_name);
+    if (!annot) {
         return 1;
     }
 
@@ -2058,15 +2519,14 @@ lyp_fill_attr(struct ly_ctx *ctx, struct lyd_node *parent, const char *module_ns
 
     dattr->parent = parent;
     dattr->next = NULL;
-    dattr->annotation = submod ? (struct lys_ext_instance_complex *)submod->ext[pos] :
-                                 (struct lys_ext_instance_complex *)mod->ext[pos];
+    dattr->annotation = annot;
     dattr->name = lydict_insert(ctx, attr_name, 0);
     dattr->value_str = lydict_insert(ctx, attr_value, 0);
 
     /* the value is here converted to a JSON format if needed in case of LY_TYPE_IDENT and LY_TYPE_INST or to a
      * canonical form of the value */
     type = lys_ext_complex_get_substmt(LY_STMT_TYPE, dattr->annotation, NULL);
-    if (!type || !lyp_parse_value(*type, &dattr->value_str, xml, NULL, dattr, NULL, 1, 0, options & LYD_OPT_TRUSTED)) {
+    if (!type || !lyp_parse_value(*type, &dattr->value_str, xml, NULL, dattr, NULL, 1, 0, LYP_TRUSTED(options))) {
         lydict_remove(ctx, dattr->name);
         lydict_remove(ctx, dattr->value_str);
         free(dattr);
@@ -3445,18 +3905,12 @@ lyp_deviation_apply_ext(struct lys_module *module)
     struct ly_set *extset;
 
     for (i = 0; i < module->deviation_size; i++) {
-        target = NULL;
-        extset = NULL;
-        j = resolve_schema_nodeid(module->deviation[i].target_name, NULL, module, &extset, 0, 0);
-        if (j == -1) {
-            return EXIT_FAILURE;
-        } else if (!extset) {
-            /* LY_DEVIATE_NO */
-            ly_set_free(extset);
+        /* resolved when the deviation was applied */
+        target = module->deviation[i].target;
+        if (!target || !module->deviation[i].deviate_size || (module->deviation[i].deviate[0].mod == LY_DEVIATE_NO)) {
+            /* LY_DEVIATE_NO, the target is not in the tree anymore */
             continue;
         }
-        target = extset->set.s[0];
-        ly_set_free(extset);
 
         for (j = 0; j < module->deviation[i].deviate_size; j++) {
             dev = &module->deviation[i].deviate[j];
@@ -3628,6 +4082,11 @@ lyp_ctx_add_module(struct lys_module *module)
     }
 #endif
 
+    /* schema order of the data nodes, the module is complete now */
+    lys_node_pos_module(module);
+    /* state data presence in the subtrees, deviations included */
+    lys_node_state_module(module);
+
     /* add to the context's list of modules */
     if (module->ctx->models.used == module->ctx->models.size) {
         newlist = realloc(module->ctx->models.list, (2 * module->ctx->models.size) * sizeof *newlist);
@@ -3638,6 +4097,9 @@ lyp_ctx_add_module(struct lys_module *module)
         module->ctx->models.size *= 2;
         module->ctx->models.list = newlist;
     }
+    if (ly_ctx_module_hash_add(module->ctx, module)) {
+        return -1;
+    }
     module->ctx->models.list[module->ctx->models.used++] = module;
     module->ctx->models.module_set_id++;
 
@@ -33,15 +33,63 @@
  * @{
  */
 struct lys_module *yin_read_module(struct ly_ctx *ctx, const char *data, const char *revision, int implement);
+struct lys_module *yin_read_module_(struct ly_ctx *ctx, struct lyxml_elem *yin, const char *revision, int implement);
 struct lys_submodule *yin_read_submodule(struct lys_module *module, const char *data,struct unres_schema *unres);
 
 /**@} yin */
 
+/**
+ * @brief Incremental data parser, see lyd_parser_new(). Input is buffered only until the top-level
+ * subtree it belongs to is complete, then the subtree is parsed and connected to the data parsed so far.
+ */
+struct lyd_parser {
+    struct ly_ctx *ctx;
+    LYD_FORMAT format;
+    int options;
+    int failed;                 /* an error occurred, no more input is accepted */
+
+    /* buffered input, always terminated by a zero byte */
+    char *buf;
+    size_t used;
+    size_t size;
+    size_t start;               /* start of the top-level subtree being read, the input before it is not needed */
+    size_t scanned;             /* input already scanned for the end of the subtree */
+
+    /* format-specific scanner state */
+    int state;
+    int depth;
+    int count;                  /* number of top-level subtrees read */
+
+    /* data parsed so far */
+    struct lyd_node *result;
+    struct lyd_node *last;
+    struct unres_data *unres;
+    void *attrs;                /* JSON attributes, stored into the data only when all of them are parsed */
+};
+
 /**
  * @defgroup xmldata XML data format support
  * @{
  */
-struct lyd_node *xml_read_data(struct ly_ctx *ctx, const char *data, int options);
+struct lyd_node *xml_read_data(struct ly_ctx *ctx, const char *data, int options, const struct lyd_node *rpc_act,
+                               const struct lyd_node *data_tree, const char *yang_data_name,
+                               const struct ly_set *projection);
+
+/**
+ * @brief Parse all the complete top-level elements buffered in an incremental parser.
+ *
+ * @param[in] parser Incremental parser.
+ * @return EXIT_SUCCESS on success, EXIT_FAILURE on error.
+ */
+int xml_parser_push(struct lyd_parser *parser);
+
+/**
+ * @brief Check the rest of the input of an incremental parser and validate the parsed data.
+ *
+ * @param[in] parser Incremental parser, its parsed data are taken over.
+ * @return Validated data tree, NULL if empty or on error.
+ */
+struct lyd_node *xml_parser_finish(struct lyd_parser *parser);
 
 /**@} xmldata */
 
@@ -50,7 +98,31 @@ struct lyd_node *xml_read_data(struct ly_ctx *ctx, const char *data, int options
  * @{
  */
 struct lyd_node *lyd_parse_json(struct ly_ctx *ctx, const char *data, int options, const struct lyd_node *rpc_act,
-                                const struct lyd_node *data_tree, const char *yang_data_name);
+                                const struct lyd_node *data_tree, const char *yang_data_name,
+                                const struct ly_set *projection);
+
+/**
+ * @brief Parse all the complete top-level members buffered in an incremental parser.
+ *
+ * @param[in] parser Incremental parser.
+ * @return EXIT_SUCCESS on success, EXIT_FAILURE on error.
+ */
+int json_parser_push(struct lyd_parser *parser);
+
+/**
+ * @brief Check the rest of the input of an incremental parser and validate the parsed data.
+ *
+ * @param[in] parser Incremental parser, its parsed data are taken over.
+ * @return Validated data tree, NULL if empty or on error.
+ */
+struct lyd_node *json_parser_finish(struct lyd_parser *parser);
+
+/**
+ * @brief Free the JSON attributes of an incremental parser that were not stored into the data.
+ *
+ * @param[in] parser Incremental parser.
+ */
+void json_parser_clean(struct lyd_parser *parser);
 
 /**@} jsondata */
 
@@ -61,6 +133,56 @@ struct lyd_node *lyd_parse_json(struct ly_ctx *ctx, const char *data, int option
 struct lyd_node *lyd_parse_lyb(struct ly_ctx *ctx, const char *data, int options, const struct lyd_node *data_tree,
                                const char *yang_data_name, int *parsed);
 
+/**
+ * @brief Parse only the top-level subtrees matching a path using the LYB index, see lyd_parse_lyb_subtrees().
+ */
+struct lyd_node *lyd_parse_lyb_index(struct ly_ctx *ctx, const char *data, size_t length, int options, const char *path);
+
+/**
+ * @brief Whether a path of the LYB index matches a path of top-level nodes, see lyd_parse_lyb_subtrees().
+ *
+ * @param[in] ipath Index path, not terminated.
+ * @param[in] len Length of \p ipath.
+ * @param[in] path Path to match.
+ * @return non-zero if matches, 0 otherwise.
+ */
+int lyb_index_match(const char *ipath, size_t len, const char *path);
+
+/**
+ * @brief Read the models and the index of lazily parsed LYB data, see lyd_lazy_new().
+ *
+ * @param[in] lazy Lazy data with the LYB data set.
+ * @param[in] length Length of the data, 0 if unknown.
+ * @return 0 on success, -1 on error.
+ */
+int lyd_parse_lyb_lazy(struct lyd_lazy *lazy, size_t length);
+
+/**
+ * @brief Parse a top-level subtree of lazily parsed LYB data.
+ *
+ * @param[in] lazy Lazy data.
+ * @param[in] idx Index of the subtree.
+ * @return Parsed subtree, NULL on error.
+ */
+struct lyd_node *lyd_parse_lyb_lazy_subtree(struct lyd_lazy *lazy, uint32_t idx);
+
+/**
+ * @brief Apply a LYB patch to a data tree, see lyd_apply_lyb_patch().
+ */
+int lyd_parse_lyb_patch(struct ly_ctx *ctx, struct lyd_node **root, const char *data);
+
+/**
+ * @brief Parse the header of a LYB stream, see lyd_lyb_stream_parse_header().
+ *
+ * @return Number of parsed bytes, -1 on error.
+ */
+int lyd_parse_lyb_stream_header(struct lyd_lyb_stream *stream, const char *data);
+
+/**
+ * @brief Parse a frame of a LYB stream, see lyd_lyb_stream_parse().
+ */
+struct lyd_node *lyd_parse_lyb_stream_frame(struct lyd_lyb_stream *stream, const char *data, int options, int *parsed);
+
 /**@} lybdata */
 
 /**
@@ -95,21 +217,89 @@ int lyp_yin_parse_subnode_ext(struct lys_module *mod, void *elem, LYEXT_PAR elem
 
 struct lys_type *lyp_get_next_union_type(struct lys_type *type, struct lys_type *prev_type, int *found);
 
+/* lexical classes of a value, see lyp_union_value_class() */
+#define LYP_UNI_EMPTY   0x01 /**< NULL or empty value */
+#define LYP_UNI_NONINT  0x02 /**< contains a character invalid in an integer */
+#define LYP_UNI_NONDEC  0x04 /**< contains a character invalid in a decimal64 */
+#define LYP_UNI_NONB64  0x08 /**< contains a character invalid in a binary */
+#define LYP_UNI_ALL     0x0E
+
+/**
+ * @brief Get the lexical class of a value to quickly skip union member types it cannot be valid for.
+ *
+ * @param[in] value Value to classify.
+ * @return Bitmask of LYP_UNI_* flags.
+ */
+int lyp_union_value_class(const char *value);
+
+/**
+ * @brief Learn whether a value certainly cannot be parsed as a (union member) type.
+ * Not to be used for schema default values (they allow integers in other bases).
+ *
+ * @param[in] type Member type.
+ * @param[in] value Value.
+ * @param[in] vclass Class of \p value from lyp_union_value_class().
+ * @return non-zero if the type can be skipped, 0 if the value must be parsed to decide.
+ */
+int lyp_union_type_skip(const struct lys_type *type, const char *value, int vclass);
+
 /* return: 0 - ret set, ok; 1 - ret not set, no log, unknown meta; -1 - ret not set, log, fatal error */
 int lyp_fill_attr(struct ly_ctx *ctx, struct lyd_node *parent, const char *module_ns, const char *module_name,
                   const char *attr_name, const char *attr_value, struct lyxml_elem *xml, int options, struct lyd_attr **ret);
 
 int lyp_check_edit_attr(struct ly_ctx *ctx, struct lyd_attr *attr, struct lyd_node *parent, int *editbits);
 
+/* trusted: 0 - validate the value; non-zero - do not check restrictions; LYP_TRUSTED_CANON - also do not canonize
+ * the value, it is expected to be in the canonical form (used with LYD_OPT_CANONICAL) */
+#define LYP_TRUSTED_CANON 2
+#define LYP_TRUSTED(options) (!((options) & LYD_OPT_TRUSTED) ? 0 : ((options) & LYD_OPT_CANONICAL) ? LYP_TRUSTED_CANON : 1)
+
+/* store: 0 - only validate; 1 - store the value; 2 - store the value, but only canonize it if it is of a user type
+ * (used for union members and leafref targets) */
 struct lys_type *lyp_parse_value(struct lys_type *type, const char **value_, struct lyxml_elem *xml,
                                  struct lyd_node_leaf_list *leaf, struct lyd_attr *attr, struct lys_module *local_mod,
                                  int store, int dflt, int trusted);
 
+/* maximum length of a canonical numeric value printed by lyp_num_value(), including the terminating zero */
+#define LYP_NUM_BUFLEN 24
+
+/* print the canonical form of a binary boolean or numeric value of the type base into buf (LYP_NUM_BUFLEN),
+ * if node is set, also check the type restrictions (logs directly);
+ * return: 0 - ok; 1 - restriction not satisfied; -1 - not a boolean or numeric type, nothing printed */
+int lyp_num_value(struct lys_type *type, const lyd_val *value, char *buf, struct lyd_node *node);
+
 int lyp_check_length_range(struct ly_ctx *ctx, const char *expr, struct lys_type *type);
 
 int lyp_check_pattern(struct ly_ctx *ctx, const char *pattern, pcre **pcre_precomp);
 int lyp_precompile_pattern(struct ly_ctx *ctx, const char *pattern, pcre** pcre_cmp, pcre_extra **pcre_std);
 
+/* maximum number of compiled regular expressions cached in a context */
+#define LYP_REGEX_CACHE_MAX 1024
+
+/* compiled regular expression cached in a context */
+struct lyp_regex {
+    const char *pattern;    /* pattern in the dictionary */
+    pcre *cmp;
+    pcre_extra *std;
+};
+
+int lyp_regex_get(struct ly_ctx *ctx, const char *pattern, pcre **pcre_cmp, pcre_extra **pcre_std, int *cached);
+void lyp_regex_free(pcre *pcre_cmp, pcre_extra *pcre_std);
+void lyp_regex_cache_free(struct ly_ctx *ctx);
+size_t lyp_regex_mem_size(const pcre *pcre_cmp, const pcre_extra *pcre_std);
+size_t lyp_regex_cache_mem_size(struct ly_ctx *ctx);
+int lyp_regex_exec(const pcre *pcre_cmp, const pcre_extra *pcre_std, const char *str);
+
+/**
+ * @brief Get the number of the leading characters of Base64 data from the Base64 alphabet,
+ * without padding and line breaks.
+ *
+ * @param[in] data Base64 data.
+ * @param[in] len Length of \p data.
+ * @return Number of the characters.
+ */
+size_t lyp_base64_span(const char *data, size_t len);
+
 int fill_yin_type(struct lys_module *module, struct lys_node *parent, struct lyxml_elem *yin, struct lys_type *type,
                   int tpdftype, struct unres_schema *unres);
 
@@ -140,6 +330,16 @@ int lyp_is_rpc_action(struct lys_node *node);
  */
 int lyp_data_check_options(struct ly_ctx *ctx, int options, const char *func);
 
+/**
+ * @brief Check whether a data node is to be parsed with #LYD_OPT_PROJECTION. These are the instances of the
+ * selected schema nodes with all their descendants, their ancestors, and the keys of the lists among them.
+ *
+ * @param[in] projection Set of the selected schema nodes, NULL if all the data are parsed.
+ * @param[in] schema Schema node of the data node.
+ * @return non-zero if the node is to be parsed, 0 if it is to be skipped.
+ */
+int lyp_data_projected(const struct ly_set *projection, const struct lys_node *schema);
+
 int lyp_check_identifier(struct ly_ctx *ctx, const char *id, enum LY_IDENT type, struct lys_module *module, struct lys_node *parent);
 int lyp_check_date(struct ly_ctx *ctx, const char *date);
 int lyp_check_mandatory_augment(struct lys_node_augment *node, const struct lys_node *target);
@@ -256,21 +456,71 @@ struct lyext_plugin *ext_get_plugin(const char *name, const char *module, const
 /**
  * @brief Try to store a value as a user type defined by a plugin.
  *
- * @param[in] mod Module of the type.
- * @param[in] type_name Type (typedef) name.
+ * @param[in] tpdf Typedef of the type.
  * @param[in] value_str Value to store as a string.
  * @param[in,out] value Filled value to be overwritten by the user store callback.
  * @return 0 on successful storing, 1 if the type is not a user type, -1 on error.
  */
-int lytype_store(const struct lys_module *mod, const char *type_name, const char *value_str, lyd_val *value);
+int lytype_store(struct lys_tpdf *tpdf, const char *value_str, lyd_val *value);
+
+/**
+ * @brief Learn whether the values of a type are stored by a user type plugin.
+ *
+ * @param[in] tpdf Typedef of the type.
+ * @return 1 if there is a plugin for \p tpdf, 0 otherwise.
+ */
+int lytype_is_user(struct lys_tpdf *tpdf);
+
+/**
+ * @brief Replace a string value of a stored user type value with its canonical form, if the plugin can print it.
+ *
+ * @param[in] tpdf Typedef of the type.
+ * @param[in] value Value stored by lytype_store().
+ * @param[in,out] value_str String value in the dictionary, may be replaced.
+ * @param[in] priv Whether \p value_str is a private string (#LY_VALUE_PRIVATE) instead of a dictionary string.
+ * @return 0 on success, -1 on error.
+ */
+int lytype_canonize(struct lys_tpdf *tpdf, const lyd_val *value, const char **value_str, int priv);
+
+/**
+ * @brief Compare user type values by the plugin callback.
+ *
+ * @param[in] tpdf1 Typedef of the first value type.
+ * @param[in] value1 First value stored by lytype_store().
+ * @param[in] tpdf2 Typedef of the second value type, may be from another context.
+ * @param[in] value2 Second value stored by lytype_store().
+ * @return 1 if the values are equal, 0 if not, -1 if the plugin cannot compare them and the strings must be compared.
+ */
+int lytype_compare(struct lys_tpdf *tpdf1, const lyd_val *value1, struct lys_tpdf *tpdf2, const lyd_val *value2);
+
+/**
+ * @brief Order user type values by the plugin callback.
+ *
+ * @param[in] tpdf1 Typedef of the first value type.
+ * @param[in] value1 First value stored by lytype_store().
+ * @param[in] tpdf2 Typedef of the second value type.
+ * @param[in] value2 Second value stored by lytype_store().
+ * @param[out] order Negative value, 0, or positive value if \p value1 is less than, equal to, or greater than \p value2.
+ * @return 0 on success, 1 if the plugin cannot order the values.
+ */
+int lytype_order(struct lys_tpdf *tpdf1, const lyd_val *value1, struct lys_tpdf *tpdf2, const lyd_val *value2, int *order);
+
+/**
+ * @brief Hash a user type value by the plugin callback.
+ *
+ * @param[in] tpdf Typedef of the type.
+ * @param[in] value Value stored by lytype_store(), NULL to only learn whether the values are hashed by the plugin.
+ * @param[out] hash Hash of the value.
+ * @return 0 on success, 1 if the plugin does not hash the values and the strings must be hashed.
+ */
+int lytype_hash(struct lys_tpdf *tpdf, const lyd_val *value, uint32_t *hash);
 
 /**
  * @brief Free a user type stored value.
  *
- * @param[in] mod Module of the type.
- * @param[in] type_name Type (typedef) name.
+ * @param[in] tpdf Typedef of the type.
  * @param[in] value Value union to free.
  */
-void lytype_free(const struct lys_module *mod, const char *type_name, lyd_val value);
+void lytype_free(struct lys_tpdf *tpdf, lyd_val value);
 
 #endif /* LY_PARSER_H_ */
@@ -19,6 +19,11 @@
 #include <errno.h>
 #include <stdlib.h>
 #include <string.h>
+#if defined(__SSE2__)
+# include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+# include <arm_neon.h>
+#endif
 
 #include "libyang.h"
 #include "common.h"
@@ -197,6 +202,70 @@ error:
     return NULL;
 }
 
+/* whether all the characters are ASCII and none of them is a control character */
+static int
+lyjson_text_plain(const char *data, size_t len)
+{
+    size_t i = 0;
+
+#if defined(__SSE2__)
+    /* as signed bytes, exactly the allowed characters are greater than 0x1f */
+    for (; i + 16 <= len; i += 16) {
+        if (_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_loadu_si128((const __m128i *)&data[i]), _mm_set1_epi8(0x1f))) != 0xFFFF) {
+            return 0;
+        }
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    uint8x16_t chunk;
+
+    for (; i + 16 <= len; i += 16) {
+        chunk = vld1q_u8((const uint8_t *)&data[i]);
+        if ((vminvq_u8(chunk) < 0x20) || (vmaxvq_u8(chunk) > 0x7f)) {
+            return 0;
+        }
+    }
+#endif
+    for (; i < len; ++i) {
+        if (((unsigned char)data[i] < 0x20) || ((unsigned char)data[i] > 0x7f)) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/**
+ * @brief Parse JSON string into a dictionary string. Strings without escape sequences and non-ASCII
+ * characters, which is the common case, are found in bulk and inserted into the dictionary directly
+ * from the input, all the others are decoded by lyjson_parse_text().
+ *
+ * @param[in] ctx libyang context.
+ * @param[in] data Input data following the opening quotation mark.
+ * @param[out] len Number of the characters of the string read.
+ * @param[in] priv Whether to return a private string (#LY_VALUE_PRIVATE) instead of a dictionary string.
+ * @return Dictionary string, NULL on error.
+ */
+static const char *
+lyjson_parse_text_dict(struct ly_ctx *ctx, const char *data, unsigned int *len, int priv)
+{
+    size_t span;
+    char *str;
+
+    /* the end of the string or the first escape sequence */
+    span = strcspn(data, "\"\\");
+    if ((data[span] == '"') && (span <= UINT_MAX) && lyjson_text_plain(data, span)) {
+        *len = span;
+        /* zero length would mean the whole rest of the data */
+        return lydict_insert_priv(ctx, span ? data : "", span, priv);
+    }
+
+    str = lyjson_parse_text(ctx, data, len);
+    if (!str) {
+        return NULL;
+    }
+    return lydict_insert_zc_priv(ctx, str, priv);
+}
+
 static unsigned int
 lyjson_parse_number(struct ly_ctx *ctx, const char *data)
 {
@@ -370,22 +439,22 @@ json_get_anydata(struct lyd_node_anydata *any, const char *data)
 {
     struct ly_ctx *ctx = any->schema->module->ctx;
     unsigned int len = 0, c = 0;
-    char *str;
+    const char *str;
 
     if (data[len] == '"') {
         len = 1;
-        str = lyjson_parse_text(ctx, &data[len], &c);
+        str = lyjson_parse_text_dict(ctx, &data[len], &c, 0);
         if (!str) {
             return 0;
         }
         if (data[len + c] != '"') {
-            free(str);
+            lydict_remove(ctx, str);
             LOGVAL(ctx, LYE_XML_INVAL, LY_VLOG_LYD, any,
                    "JSON data (missing quotation-mark at the end of string)");
             return 0;
         }
 
-        any->value.str = lydict_insert_zc(ctx, str);
+        any->value.str = str;
         any->value_type = LYD_ANYDATA_CONSTSTRING;
         return len + c + 1;
     } else if (data[len] != '{') {
@@ -419,6 +488,50 @@ json_get_anydata(struct lyd_node_anydata *any, const char *data)
     return len;
 }
 
+/* get the length of any JSON value without its parsing */
+static unsigned int
+json_skip_value(struct ly_ctx *ctx, const char *data)
+{
+    unsigned int len = 0, depth = 0;
+
+    /* count opening and closing brackets outside of strings to get the end of the value */
+    while (data[len] && (depth || ((data[len] != ',') && (data[len] != '}') && (data[len] != ']')))) {
+        switch (data[len]) {
+        case '"':
+            for (++len; data[len] && (data[len] != '"'); ++len) {
+                if ((data[len] == '\\') && data[len + 1]) {
+                    ++len;
+                }
+            }
+            if (!data[len]) {
+                LOGVAL(ctx, LYE_EOF, LY_VLOG_NONE, NULL);
+                return 0;
+            }
+            break;
+        case '{':
+        case '[':
+            ++depth;
+            break;
+        case '}':
+        case ']':
+            --depth;
+            break;
+        default:
+            break;
+        }
+        ++len;
+    }
+    if (!data[len]) {
+        LOGVAL(ctx, LYE_EOF, LY_VLOG_NONE, NULL);
+        return 0;
+    } else if (!len) {
+        LOGVAL(ctx, LYE_XML_INVAL, LY_VLOG_NONE, NULL, "JSON data (missing value)");
+        return 0;
+    }
+
+    return len;
+}
+
 static unsigned int
 json_get_value(struct lyd_node_leaf_list *leaf, struct lyd_node **first_sibling, const char *data, int options,
                struct unres_data *unres)
@@ -428,11 +541,13 @@ json_get_value(struct lyd_node_leaf_list *leaf, struct lyd_node **first_sibling,
     struct ly_ctx *ctx;
     unsigned int len = 0, r;
     char *str;
+    int priv;
 
     assert(leaf && data);
     ctx = leaf->schema->module->ctx;
 
     stype = &((struct lys_node_leaf *)leaf->schema)->type;
+    priv = lyd_value_private(leaf->schema);
 
     if (leaf->schema->nodetype == LYS_LEAFLIST) {
         /* expecting begin-array */
@@ -447,16 +562,18 @@ repeat:
 
     /* will be changed in case of union */
     leaf->value_type = stype->base;
+    if (priv) {
+        leaf->value_flags |= LY_VALUE_PRIVATE;
+    }
 
     if (data[len] == '"') {
         /* string representations */
         ++len;
-        str = lyjson_parse_text(ctx, &data[len], &r);
-        if (!str) {
+        leaf->value_str = lyjson_parse_text_dict(ctx, &data[len], &r, priv);
+        if (!leaf->value_str) {
             LOGPATH(ctx, LY_VLOG_LYD, leaf);
             return 0;
         }
-        leaf->value_str = lydict_insert_zc(ctx, str);
         if (data[len + r] != '"') {
             LOGVAL(ctx, LYE_XML_INVAL, LY_VLOG_LYD, leaf,
                    "JSON data (missing quotation-mark at the end of string)");
@@ -476,9 +593,9 @@ repeat:
             if (!str) {
                 return 0;
             }
-            leaf->value_str = lydict_insert_zc(ctx, str);
+            leaf->value_str = lydict_insert_zc_priv(ctx, str, priv);
         } else {
-            leaf->value_str = lydict_insert(ctx, &data[len], r);
+            leaf->value_str = lydict_insert_priv(ctx, &data[len], r, priv);
         }
         len += r;
     } else if (data[len] == 'f' || data[len] == 't') {
@@ -488,11 +605,11 @@ repeat:
             LOGPATH(ctx, LY_VLOG_LYD, leaf);
             return 0;
         }
-        leaf->value_str = lydict_insert(ctx, &data[len], r);
+        leaf->value_str = lydict_insert_priv(ctx, &data[len], r, priv);
         len += r;
     } else if (!strncmp(&data[len], "[null]", 6)) {
         /* empty */
-        leaf->value_str = lydict_insert(ctx, "", 0);
+        leaf->value_str = lydict_insert_priv(ctx, "", 0, priv);
         len += 6;
     } else {
         /* error */
@@ -503,7 +620,7 @@ repeat:
     /* the value is here converted to a JSON format if needed in case of LY_TYPE_IDENT and LY_TYPE_INST or to a
      * canonical form of the value */
     if (!lyp_parse_value(&((struct lys_node_leaf *)leaf->schema)->type, &leaf->value_str, NULL, leaf, NULL, NULL,
-                         1, 0, options & LYD_OPT_TRUSTED)) {
+                         1, 0, LYP_TRUSTED(options))) {
         return 0;
     }
 
@@ -525,7 +642,8 @@ repeat:
             }
 
             /* another instance of the leaf-list */
-            new = calloc(1, sizeof(struct lyd_node_leaf_list));
+            LY_CHECK_RETURN(ly_parse_charge(ctx, 1, sizeof *new), 0);
+            new = (struct lyd_node_leaf_list *)lyd_node_alloc(ctx, sizeof *new);
             LY_CHECK_ERR_RETURN(!new, LOGMEM(ctx), 0);
 
             new->parent = leaf->parent;
@@ -693,46 +811,99 @@ struct attr_cont {
     unsigned int index;    /** non-zero only in case of leaf-list */
 };
 
+/* sibling matching an attribute container */
+struct attr_match {
+    const struct lys_node *schema;
+    unsigned int index;    /* leaf-list position, 0 for other nodes and for the leaf-list counter */
+    unsigned int count;    /* leaf-list instances counted so far, only in the counter */
+    struct lyd_node *node;
+};
+
 static int
-store_attrs(struct ly_ctx *ctx, struct attr_cont *attrs, struct lyd_node *first, int options)
+attr_match_equal(void *val1_p, void *val2_p, int UNUSED(mod), void *UNUSED(cb_data))
+{
+    struct attr_match *m1 = val1_p, *m2 = val2_p;
+
+    return (m1->schema == m2->schema) && (m1->index == m2->index);
+}
+
+static uint32_t
+attr_match_hash(const struct lys_node *schema, unsigned int index)
+{
+    uint32_t hash;
+
+    hash = dict_hash_multi(0, (const char *)&schema, sizeof schema);
+    hash = dict_hash_multi(hash, (const char *)&index, sizeof index);
+    return dict_hash_multi(hash, NULL, 0);
+}
+
+/**
+ * @brief Index the siblings by their schema node and leaf-list position in one pass.
+ *
+ * @return Hash table of struct attr_match, NULL on error.
+ */
+static struct hash_table *
+attr_match_index(struct ly_ctx *ctx, struct lyd_node *first)
 {
+    struct hash_table *ht;
     struct lyd_node *diter;
-    struct attr_cont *iter;
-    struct lyd_attr *aiter;
-    unsigned int flag_leaflist = 0;
+    struct attr_match rec, *found;
 
-    while (attrs) {
-        iter = attrs;
-        attrs = attrs->next;
+    ht = lyht_new(8, sizeof rec, attr_match_equal, NULL, 1);
+    LY_CHECK_ERR_RETURN(!ht, LOGMEM(ctx), NULL);
 
-        if (iter->index) {
-            flag_leaflist = 1;
+    LY_TREE_FOR(first, diter) {
+        rec.schema = diter->schema;
+        rec.index = 0;
+        rec.count = 0;
+        rec.node = diter;
+        if (lyht_insert(ht, &rec, attr_match_hash(rec.schema, 0), (void **)&found) == -1) {
+            goto error;
+        }
+        if (diter->schema->nodetype != LYS_LEAFLIST) {
+            /* the first instance matches */
+            continue;
         }
 
-        LY_TREE_FOR(first, diter) {
-            if (iter->schema != diter->schema) {
-                continue;
-            }
+        rec.index = ++found->count;
+        if (lyht_insert(ht, &rec, attr_match_hash(rec.schema, rec.index), NULL) == -1) {
+            goto error;
+        }
+    }
 
-            if (flag_leaflist && flag_leaflist != iter->index) {
-                flag_leaflist++;
-                continue;
-            }
+    return ht;
 
-            /* we have match */
-            if (diter->attr) {
-                LOGVAL(ctx, LYE_XML_INVAL, LY_VLOG_LYD, diter,
-                       "attribute (multiple attribute definitions belong to a single element)");
-                free(iter);
-                goto error;
-            }
+error:
+    lyht_free(ht);
+    return NULL;
+}
 
-            diter->attr = iter->attr;
-            for (aiter = iter->attr; aiter; aiter = aiter->next) {
-                aiter->parent = diter;
-            }
+static int
+store_attrs(struct ly_ctx *ctx, struct attr_cont *attrs, struct lyd_node *first, int options)
+{
+    struct lyd_node *diter;
+    struct attr_cont *iter;
+    struct lyd_attr *aiter;
+    struct hash_table *ht = NULL;
+    struct attr_match rec, *found;
 
-            break;
+    if (attrs) {
+        /* every container is matched to its sibling directly */
+        ht = attr_match_index(ctx, first);
+        if (!ht) {
+            goto error;
+        }
+    }
+
+    while (attrs) {
+        iter = attrs;
+        attrs = attrs->next;
+
+        rec.schema = iter->schema;
+        rec.index = iter->index;
+        diter = NULL;
+        if (!lyht_find(ht, &rec, attr_match_hash(rec.schema, rec.index), (void **)&found)) {
+            diter = found->node;
         }
 
         if (!diter) {
@@ -741,6 +912,20 @@ store_attrs(struct ly_ctx *ctx, struct attr_cont *attrs, struct lyd_node *first,
             free(iter);
             goto error;
         }
+
+        /* we have match */
+        if (diter->attr) {
+            LOGVAL(ctx, LYE_XML_INVAL, LY_VLOG_LYD, diter,
+                   "attribute (multiple attribute definitions belong to a single element)");
+            lyd_free_attr(ctx, NULL, iter->attr, 1);
+            free(iter);
+            goto error;
+        }
+
+        diter->attr = iter->attr;
+        for (aiter = iter->attr; aiter; aiter = aiter->next) {
+            aiter->parent = diter;
+        }
         free(iter);
 
         /* check edit-config attribute correctness */
@@ -749,10 +934,11 @@ store_attrs(struct ly_ctx *ctx, struct attr_cont *attrs, struct lyd_node *first,
         }
     }
 
+    lyht_free(ht);
     return 0;
 
 error:
-
+    lyht_free(ht);
     while (attrs) {
         iter = attrs;
         attrs = attrs->next;
@@ -767,15 +953,17 @@ error:
 static unsigned int
 json_parse_data(struct ly_ctx *ctx, const char *data, const struct lys_node *schema_parent, struct lyd_node **parent,
                 struct lyd_node *first_sibling, struct lyd_node *prev, struct attr_cont **attrs, int options,
-                struct unres_data *unres, struct lyd_node **act_notif, const char *yang_data_name)
+                struct unres_data *unres, struct lyd_node **act_notif, const char *yang_data_name,
+                const struct ly_set *projection)
 {
     unsigned int len = 0;
     unsigned int r;
     unsigned int flag_leaflist = 0;
     int i;
     uint8_t pos;
+    size_t size;
     char *name, *prefix = NULL, *str = NULL;
-    const struct lys_module *module = NULL;
+    const struct lys_module *module = NULL, *node_mod;
     struct lys_node *schema = NULL;
     const struct lys_node *sparent = NULL;
     struct lyd_node *result = NULL, *new, *list, *diter = NULL;
@@ -878,6 +1066,11 @@ json_parse_data(struct ly_ctx *ctx, const char *data, const struct lys_node *sch
                         }
                     }
                 }
+            } else if (!lys_find_child_hash(ctx, NULL, module, 0, name, strlen(name), module->ns,
+                                            (const struct lys_node **)&schema)) {
+                if (schema && lys_is_disabled(schema, 0)) {
+                    schema = NULL;
+                }
             } else {
                 /* get the proper schema node */
                 while ((schema = (struct lys_node *) lys_getnext(schema, NULL, module, 0))) {
@@ -913,7 +1106,21 @@ json_parse_data(struct ly_ctx *ctx, const char *data, const struct lys_node *sch
             schema = NULL;
         }
 
-        if (schema_parent) {
+        /* module of the node */
+        if (prefix) {
+            node_mod = ly_ctx_get_module(ctx, prefix, NULL, 1);
+        } else if (schema_parent) {
+            node_mod = lys_node_module(schema_parent);
+        } else {
+            node_mod = lyd_node_module(*parent);
+        }
+
+        if (node_mod && !lys_find_child_hash(ctx, (schema_parent ? schema_parent : (*parent)->schema), NULL, 0, name,
+                                             strlen(name), node_mod->ns, (const struct lys_node **)&schema)) {
+            if (schema && lys_is_disabled(schema, 0)) {
+                schema = NULL;
+            }
+        } else if (schema_parent) {
             while ((schema = (struct lys_node *)lys_getnext(schema, schema_parent, NULL, 0))) {
                 if (!strcmp(schema->name, name)
                         && ((prefix && !strcmp(lys_node_module(schema)->name, prefix))
@@ -938,6 +1145,19 @@ json_parse_data(struct ly_ctx *ctx, const char *data, const struct lys_node *sch
         goto error;
     }
 
+    if (!lyp_data_projected(projection, schema)) {
+        /* not selected, skip the value (or its attributes) */
+        r = json_skip_value(ctx, &data[len]);
+        if (!r) {
+            goto error;
+        }
+        len += r;
+        len += skip_ws(&data[len]);
+
+        free(str);
+        return len;
+    }
+
     if (str[0] == '@') {
         /* attribute for some sibling node */
         if (data[len] == '[') {
@@ -988,20 +1208,22 @@ attr_repeat:
     case LYS_NOTIF:
     case LYS_RPC:
     case LYS_ACTION:
-        result = calloc(1, sizeof *result);
+        size = sizeof *result;
         break;
     case LYS_LEAF:
     case LYS_LEAFLIST:
-        result = calloc(1, sizeof(struct lyd_node_leaf_list));
+        size = sizeof(struct lyd_node_leaf_list);
         break;
     case LYS_ANYXML:
     case LYS_ANYDATA:
-        result = calloc(1, sizeof(struct lyd_node_anydata));
+        size = sizeof(struct lyd_node_anydata);
         break;
     default:
         LOGINT(ctx);
         goto error;
     }
+    LY_CHECK_GOTO(ly_parse_charge(ctx, 1, size), error);
+    result = lyd_node_alloc(ctx, size);
     LY_CHECK_ERR_GOTO(!result, LOGMEM(ctx), error);
 
     result->prev = result;
@@ -1126,7 +1348,8 @@ attr_repeat:
                 len++;
                 len += skip_ws(&data[len]);
 
-                r = json_parse_data(ctx, &data[len], NULL, &result, result->child, diter, &attrs_aux, options, unres, act_notif, yang_data_name);
+                r = json_parse_data(ctx, &data[len], NULL, &result, result->child, diter, &attrs_aux, options, unres, act_notif,
+                                    yang_data_name, projection);
                 if (!r) {
                     goto error;
                 }
@@ -1178,7 +1401,8 @@ attr_repeat:
                 len++;
                 len += skip_ws(&data[len]);
 
-                r = json_parse_data(ctx, &data[len], NULL, &list, list->child, diter, &attrs_aux, options, unres, act_notif, yang_data_name);
+                r = json_parse_data(ctx, &data[len], NULL, &list, list->child, diter, &attrs_aux, options, unres, act_notif,
+                                    yang_data_name, projection);
                 if (!r) {
                     goto error;
                 }
@@ -1220,7 +1444,8 @@ attr_repeat:
                 }
 
                 /* another instance of the list */
-                new = calloc(1, sizeof *new);
+                LY_CHECK_GOTO(ly_parse_charge(ctx, 1, sizeof *new), error);
+                new = lyd_node_alloc(ctx, sizeof *new);
                 LY_CHECK_ERR_GOTO(!new, LOGMEM(ctx), error);
                 new->parent = list->parent;
                 new->prev = list;
@@ -1293,9 +1518,50 @@ error:
     return 0;
 }
 
+/* logs directly */
+static int
+json_parse_finish(struct ly_ctx *ctx, struct lyd_node **result, int options, const struct lyd_node *data_tree,
+                  struct lyd_node *act_notif, struct unres_data *unres)
+{
+    struct lyd_node *iter;
+
+    /* add missing ietf-yang-library if requested */
+    if (options & LYD_OPT_DATA_ADD_YANGLIB) {
+        if (lyd_merge(*result, ly_ctx_info(ctx), LYD_OPT_DESTRUCT | LYD_OPT_EXPLICIT)) {
+            LOGERR(ctx, LY_EINT, "Adding ietf-yang-library data failed.");
+            return EXIT_FAILURE;
+        }
+    }
+
+    /* check for uniquness of top-level lists/leaflists because
+     * only the inner instances were tested in lyv_data_content() */
+    LY_TREE_FOR(*result, iter) {
+        if (!(iter->schema->nodetype & (LYS_LIST | LYS_LEAFLIST)) || !(iter->validity & LYD_VAL_DUP)) {
+            continue;
+        }
+
+        if (lyv_data_dup(iter, *result)) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    /* add/validate default values, unres */
+    if (lyd_defaults_add_unres(result, options, ctx, NULL, 0, data_tree, act_notif, unres, 1)) {
+        return EXIT_FAILURE;
+    }
+
+    /* check for missing top level mandatory nodes */
+    if (!(options & (LYD_OPT_TRUSTED | LYD_OPT_NOTIF_FILTER))
+            && lyd_check_mandatory_tree((act_notif ? act_notif : *result), ctx, NULL, 0, options)) {
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
 struct lyd_node *
 lyd_parse_json(struct ly_ctx *ctx, const char *data, int options, const struct lyd_node *rpc_act,
-               const struct lyd_node *data_tree, const char *yang_data_name)
+               const struct lyd_node *data_tree, const char *yang_data_name, const struct ly_set *projection)
 {
     struct lyd_node *result = NULL, *next, *iter, *reply_parent = NULL, *reply_top = NULL, *act_notif = NULL;
     struct unres_data *unres = NULL;
@@ -1383,7 +1649,8 @@ lyd_parse_json(struct ly_ctx *ctx, const char *data, int options, const struct l
             }
         }
 
-        r = json_parse_data(ctx, &data[len], NULL, &next, result, iter, &attrs, options, unres, &act_notif, yang_data_name);
+        r = json_parse_data(ctx, &data[len], NULL, &next, result, iter, &attrs, options, unres, &act_notif, yang_data_name,
+                            projection);
         if (!r) {
             goto error;
         }
@@ -1436,7 +1703,7 @@ lyd_parse_json(struct ly_ctx *ctx, const char *data, int options, const struct l
         result = reply_top;
     }
 
-    if (!result) {
+    if (!result && !projection) {
         LOGERR(ctx, LY_EVALID, "Model for the data to be linked with not found.");
         goto error;
     }
@@ -1456,34 +1723,7 @@ lyd_parse_json(struct ly_ctx *ctx, const char *data, int options, const struct l
         goto error;
     }
 
-    /* add missing ietf-yang-library if requested */
-    if (options & LYD_OPT_DATA_ADD_YANGLIB) {
-        if (lyd_merge(result, ly_ctx_info(ctx), LYD_OPT_DESTRUCT | LYD_OPT_EXPLICIT)) {
-            LOGERR(ctx, LY_EINT, "Adding ietf-yang-library data failed.");
-            goto error;
-        }
-    }
-
-    /* check for uniquness of top-level lists/leaflists because
-     * only the inner instances were tested in lyv_data_content() */
-    LY_TREE_FOR(result, iter) {
-        if (!(iter->schema->nodetype & (LYS_LIST | LYS_LEAFLIST)) || !(iter->validity & LYD_VAL_DUP)) {
-            continue;
-        }
-
-        if (lyv_data_dup(iter, result)) {
-            goto error;
-        }
-    }
-
-    /* add/validate default values, unres */
-    if (lyd_defaults_add_unres(&result, options, ctx, NULL, 0, data_tree, act_notif, unres, 1)) {
-        goto error;
-    }
-
-    /* check for missing top level mandatory nodes */
-    if (!(options & (LYD_OPT_TRUSTED | LYD_OPT_NOTIF_FILTER))
-            && lyd_check_mandatory_tree((act_notif ? act_notif : result), ctx, NULL, 0, options)) {
+    if (json_parse_finish(ctx, &result, options, data_tree, act_notif, unres)) {
         goto error;
     }
 
@@ -1504,3 +1744,186 @@ error:
 
     return NULL;
 }
+
+/* incremental parser states */
+#define JSON_PARSER_START 0     /* before the top-level begin-object */
+#define JSON_PARSER_MEMBER 1    /* in a top-level member */
+#define JSON_PARSER_STRING 2    /* in a string in a top-level member */
+#define JSON_PARSER_ESCAPE 3    /* after a backslash in a string in a top-level member */
+#define JSON_PARSER_END 4       /* after the top-level end-object */
+
+/**
+ * @brief Parse the top-level member buffered in an incremental parser. Logs directly.
+ *
+ * @param[in] parser Incremental parser.
+ * @param[in] end Position of the delimiter (',' or '}') terminating the member.
+ * @return EXIT_SUCCESS on success, EXIT_FAILURE on error.
+ */
+static int
+json_parser_parse(struct lyd_parser *parser, size_t end)
+{
+    struct ly_ctx *ctx = parser->ctx;
+    struct lyd_node *next = NULL, *iter, *act_notif = NULL;
+    struct attr_cont *attrs = parser->attrs;
+    const char *data = &parser->buf[parser->start];
+    unsigned int len, r;
+    char c;
+
+    len = skip_ws(data);
+    if (!parser->count && (&data[len] == &parser->buf[end]) && (data[len] == '}')) {
+        /* empty object */
+        parser->state = JSON_PARSER_END;
+        return EXIT_SUCCESS;
+    }
+
+    c = parser->buf[end + 1];
+    parser->buf[end + 1] = '\0';
+    r = json_parse_data(ctx, &data[len], NULL, &next, parser->result, parser->last, &attrs, parser->options,
+                        parser->unres, &act_notif, NULL, NULL);
+    parser->buf[end + 1] = c;
+    parser->attrs = attrs;
+    if (!r) {
+        return EXIT_FAILURE;
+    }
+    len += r;
+    ++parser->count;
+
+    if (!parser->result) {
+        for (iter = next; iter && iter->prev->next; iter = iter->prev);
+        parser->result = iter;
+        if (iter && (parser->options & LYD_OPT_DATA_ADD_YANGLIB)
+                && iter->schema->module == ctx->models.list[ctx->internal_module_count - 1]) {
+            /* ietf-yang-library data present, so ignore the option to add them */
+            parser->options &= ~LYD_OPT_DATA_ADD_YANGLIB;
+        }
+        parser->last = next;
+    } else {
+        parser->last = parser->result->prev;
+    }
+
+    if (&data[len] != &parser->buf[end]) {
+        LOGVAL(ctx, LYE_XML_INVAL, LY_VLOG_NONE, NULL, "JSON data (missing top-level end-object)");
+        return EXIT_FAILURE;
+    }
+    parser->start = end + 1;
+    if (parser->buf[end] == '}') {
+        parser->state = JSON_PARSER_END;
+    }
+    return EXIT_SUCCESS;
+}
+
+int
+json_parser_push(struct lyd_parser *parser)
+{
+    size_t pos;
+    char c;
+
+    for (pos = parser->scanned; (pos < parser->used) && (parser->state != JSON_PARSER_END); ++pos) {
+        c = parser->buf[pos];
+        switch (parser->state) {
+        case JSON_PARSER_START:
+            if (lyjson_isspace(c)) {
+                break;
+            } else if (c != '{') {
+                LOGVAL(parser->ctx, LYE_XML_INVAL, LY_VLOG_NONE, NULL, "JSON data (missing top level begin-object)");
+                return EXIT_FAILURE;
+            }
+            parser->state = JSON_PARSER_MEMBER;
+            parser->start = pos + 1;
+            break;
+        case JSON_PARSER_MEMBER:
+            if (c == '"') {
+                parser->state = JSON_PARSER_STRING;
+            } else if ((c == '{') || (c == '[')) {
+                ++parser->depth;
+            } else if (parser->depth && ((c == '}') || (c == ']'))) {
+                --parser->depth;
+            } else if (!parser->depth && ((c == ',') || (c == '}'))) {
+                /* the member is complete, parse it */
+                if (json_parser_parse(parser, pos)) {
+                    return EXIT_FAILURE;
+                }
+            }
+            break;
+        case JSON_PARSER_STRING:
+            if (c == '\\') {
+                parser->state = JSON_PARSER_ESCAPE;
+            } else if (c == '"') {
+                parser->state = JSON_PARSER_MEMBER;
+            }
+            break;
+        case JSON_PARSER_ESCAPE:
+            parser->state = JSON_PARSER_STRING;
+            break;
+        }
+    }
+
+    if (parser->state == JSON_PARSER_START) {
+        /* only white spaces so far */
+        parser->start = pos;
+    } else if (parser->state == JSON_PARSER_END) {
+        /* anything following the top-level object is ignored */
+        pos = parser->start = parser->used;
+    }
+    parser->scanned = pos;
+    return EXIT_SUCCESS;
+}
+
+struct lyd_node *
+json_parser_finish(struct lyd_parser *parser)
+{
+    struct ly_ctx *ctx = parser->ctx;
+    struct lyd_node *result = NULL;
+    struct attr_cont *attrs;
+
+    if (parser->state == JSON_PARSER_START) {
+        LOGVAL(ctx, LYE_XML_INVAL, LY_VLOG_NONE, NULL, "JSON data (missing top level begin-object)");
+        return NULL;
+    } else if (parser->state != JSON_PARSER_END) {
+        LOGVAL(ctx, LYE_XML_INVAL, LY_VLOG_NONE, NULL, "JSON data (missing top-level end-object)");
+        return NULL;
+    }
+
+    if (!parser->count) {
+        /* empty object */
+        if (parser->options & LYD_OPT_DATA_ADD_YANGLIB) {
+            result = ly_ctx_info(ctx);
+        }
+        lyd_validate(&result, parser->options, ctx);
+        return result;
+    }
+
+    /* store attributes */
+    attrs = parser->attrs;
+    parser->attrs = NULL;
+    if (store_attrs(ctx, attrs, parser->result, parser->options)) {
+        return NULL;
+    }
+
+    result = parser->result;
+    parser->result = NULL;
+    if (!result) {
+        LOGERR(ctx, LY_EVALID, "Model for the data to be linked with not found.");
+        return NULL;
+    }
+
+    if (json_parse_finish(ctx, &result, parser->options, NULL, NULL, parser->unres)) {
+        lyd_free_withsiblings(result);
+        return NULL;
+    }
+    return result;
+}
+
+void
+json_parser_clean(struct lyd_parser *parser)
+{
+    struct attr_cont *attrs;
+
+    while (parser->attrs) {
+        attrs = parser->attrs;
+        parser->attrs = attrs->next;
+
+        lyd_free_attr(parser->ctx, NULL, attrs->attr, 1);
+        free(attrs);
+    }
+}
@@ -211,6 +211,217 @@ error:
     return -1;
 }
 
+/**
+ * @brief Read a string (until the end of the current subtree) and store it in the dictionary. If the string
+ * is not split by any chunk meta information, it is inserted directly from the input without an intermediate copy.
+ *
+ * @param[in] ctx libyang context.
+ * @param[in] data Input data.
+ * @param[out] str Dictionary string.
+ * @param[in] lybs LYB parser state.
+ * @return Number of read bytes, -1 on error.
+ */
+static int
+lyb_read_string_dict(struct ly_ctx *ctx, const char *data, const char **str, struct lyb_state *lybs)
+{
+    int i, ret;
+    size_t len;
+    char *dup;
+
+    len = lybs->written[lybs->used - 1];
+    if (!lybs->position[lybs->used - 1]) {
+        for (i = 0; i < lybs->used - 1; ++i) {
+            if (lybs->written[i] < len) {
+                /* an outer chunk ends inside the string */
+                break;
+            }
+        }
+        if (i == lybs->used - 1) {
+            /* the whole string is contiguous in the input, just move the state */
+            ret = lyb_read(data, NULL, len, lybs);
+            if (ret > -1) {
+                *str = len ? lydict_insert(ctx, data, len) : lydict_insert(ctx, "", 0);
+                LY_CHECK_ERR_RETURN(!*str, LOGMEM(ctx), -1);
+            }
+            return ret;
+        }
+    }
+
+    ret = lyb_read_string(data, &dup, 0, lybs);
+    if (ret > -1) {
+        *str = lydict_insert_zc(ctx, dup);
+    }
+    return ret;
+}
+
+static int
+lyb_read_varnum(struct ly_ctx *ctx, uint32_t *num, const char *data, struct lyb_state *lybs)
+{
+    int r, ret = 0, shift = 0;
+    uint8_t byte;
+
+    *num = 0;
+    do {
+        if (shift > 28) {
+            LOGVAL(ctx, LYE_SPEC, LY_VLOG_NONE, NULL, "Invalid LYB string table index.");
+            return -1;
+        }
+        ret += (r = lyb_read(data + ret, &byte, sizeof byte, lybs));
+        if (r < 0) {
+            return -1;
+        }
+        *num |= (uint32_t)(byte & 0x7f) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+
+    return ret;
+}
+
+/**
+ * @brief Read a string value, either directly or from the string table if used (#LYB_HEADER_STRTABLE).
+ *
+ * @param[in] ctx libyang context.
+ * @param[in] data Input data.
+ * @param[out] str Dictionary string.
+ * @param[in] lybs LYB parser state.
+ * @return Number of read bytes, -1 on error.
+ */
+static int
+lyb_read_value_string(struct ly_ctx *ctx, const char *data, const char **str, struct lyb_state *lybs)
+{
+    int r, ret = 0;
+    uint32_t idx;
+    const char **mem;
+
+    if (!lybs->str_table) {
+        return lyb_read_string_dict(ctx, data, str, lybs);
+    }
+
+    ret += (r = lyb_read_varnum(ctx, &idx, data, lybs));
+    LYB_HAVE_READ_RETURN(r, data, -1);
+
+    if (idx) {
+        /* string read before */
+        if (idx > lybs->str_count) {
+            LOGVAL(ctx, LYE_SPEC, LY_VLOG_NONE, NULL, "Invalid LYB string table index.");
+            return -1;
+        }
+        *str = lydict_insert(ctx, lybs->strs[idx - 1], 0);
+        return ret;
+    }
+
+    /* new string */
+    ret += (r = lyb_read_string_dict(ctx, data, str, lybs));
+    LYB_HAVE_READ_RETURN(r, data, -1);
+
+    if (!(lybs->str_count % LYB_STATE_STEP)) {
+        mem = realloc(lybs->strs, (lybs->str_count + LYB_STATE_STEP) * sizeof *lybs->strs);
+        LY_CHECK_ERR_RETURN(!mem, LOGMEM(ctx), -1);
+        lybs->strs = mem;
+    }
+    lybs->strs[lybs->str_count++] = lydict_insert(ctx, *str, 0);
+
+    return ret;
+}
+
+/**
+ * @brief Read a string value as lyb_read_value_string(), but possibly into a private string (#LY_VALUE_PRIVATE).
+ *
+ * @param[in] ctx libyang context.
+ * @param[in] data Input data.
+ * @param[out] str Dictionary or private string.
+ * @param[in] priv Whether to read a private string.
+ * @param[in] lybs LYB parser state.
+ * @return Number of read bytes, -1 on error.
+ */
+static int
+lyb_read_value_string_priv(struct ly_ctx *ctx, const char *data, const char **str, int priv, struct lyb_state *lybs)
+{
+    int ret;
+    char *dup;
+
+    if (!priv) {
+        return lyb_read_value_string(ctx, data, str, lybs);
+    } else if (!lybs->str_table) {
+        ret = lyb_read_string(data, &dup, 0, lybs);
+        if (ret > -1) {
+            *str = dup;
+        }
+        return ret;
+    }
+
+    /* the string table keeps dictionary strings */
+    ret = lyb_read_value_string(ctx, data, str, lybs);
+    if (ret > -1) {
+        dup = (char *)*str;
+        *str = lydict_insert_priv(ctx, dup, 0, 1);
+        lydict_remove(ctx, dup);
+        LY_CHECK_RETURN(!*str, -1);
+    }
+    return ret;
+}
+
+/**
+ * @brief Read an identity stored by its module name and index (#LYB_HEADER_IDENTIDX).
+ *
+ * @param[in] ctx libyang context.
+ * @param[in] data Input data.
+ * @param[out] ident Read identity.
+ * @param[in] lybs LYB parser state.
+ * @return Number of read bytes, -1 on error.
+ */
+static int
+lyb_read_ident(struct ly_ctx *ctx, const char *data, struct lys_ident **ident, struct lyb_state *lybs)
+{
+    int r, ret = 0;
+    const char *mod_name = NULL;
+    const struct lys_module *mod;
+    uint32_t idx;
+    uint8_t i;
+
+    ret += (r = lyb_read_varnum(ctx, &idx, data, lybs));
+    LYB_HAVE_READ_GOTO(r, data, error);
+    ret += (r = lyb_read_value_string(ctx, data, &mod_name, lybs));
+    LYB_HAVE_READ_GOTO(r, data, error);
+
+    /* identities of a single module are usually stored next to each other, remember the last module */
+    if (lybs->ident_mod && (lybs->ident_mod->name == mod_name)) {
+        mod = lybs->ident_mod;
+    } else {
+        mod = ly_ctx_get_module(ctx, mod_name, NULL, 1);
+        if (!mod) {
+            mod = ly_ctx_get_module(ctx, mod_name, NULL, 0);
+        }
+        if (!mod) {
+            LOGVAL(ctx, LYE_SPEC, LY_VLOG_NONE, NULL, "Module \"%s\" of an identity not found in the context.", mod_name);
+            goto error;
+        }
+        lybs->ident_mod = mod;
+    }
+
+    /* find the identity, submodules follow the main module */
+    if (idx < mod->ident_size) {
+        *ident = &mod->ident[idx];
+    } else {
+        idx -= mod->ident_size;
+        for (i = 0; (i < mod->inc_size) && (idx >= mod->inc[i].submodule->ident_size); ++i) {
+            idx -= mod->inc[i].submodule->ident_size;
+        }
+        if (i == mod->inc_size) {
+            LOGVAL(ctx, LYE_SPEC, LY_VLOG_NONE, NULL, "Invalid LYB identity index of module \"%s\".", mod_name);
+            goto error;
+        }
+        *ident = &mod->inc[i].submodule->ident[idx];
+    }
+
+    lydict_remove(ctx, mod_name);
+    return ret;
+
+error:
+    lydict_remove(ctx, mod_name);
+    return -1;
+}
+
 static void
 lyb_read_stop_subtree(struct lyb_state *lybs)
 {
@@ -293,6 +504,27 @@ error:
     return -1;
 }
 
+static int
+lyb_parse_stream_model(struct ly_ctx *ctx, const char *data, const struct lys_module **mod, struct lyb_state *lybs)
+{
+    int r;
+    uint64_t idx = 0;
+
+    r = lyb_read_number(&idx, 2, data, lybs);
+    if (r < 0) {
+        return -1;
+    }
+    idx = le64toh(idx);
+
+    if ((idx >= (unsigned)lybs->mod_count) || !lybs->models[idx]) {
+        LOGERR(ctx, LY_EINVAL, "Invalid context for LYB stream parsing, missing module of the index %u.", (unsigned)idx);
+        return -1;
+    }
+    *mod = lybs->models[idx];
+
+    return r;
+}
+
 static struct lyd_node *
 lyb_new_node(const struct lys_node *schema)
 {
@@ -304,11 +536,13 @@ lyb_new_node(const struct lys_node *schema)
     case LYS_NOTIF:
     case LYS_RPC:
     case LYS_ACTION:
-        node = calloc(sizeof(struct lyd_node), 1);
+        LY_CHECK_RETURN(ly_parse_charge(schema->module->ctx, 1, sizeof(struct lyd_node)), NULL);
+        node = lyd_node_alloc(schema->module->ctx, sizeof(struct lyd_node));
         break;
     case LYS_LEAF:
     case LYS_LEAFLIST:
-        node = calloc(sizeof(struct lyd_node_leaf_list), 1);
+        LY_CHECK_RETURN(ly_parse_charge(schema->module->ctx, 1, sizeof(struct lyd_node_leaf_list)), NULL);
+        node = lyd_node_alloc(schema->module->ctx, sizeof(struct lyd_node_leaf_list));
 
         if (((struct lys_node_leaf *)schema)->type.base == LY_TYPE_LEAFREF) {
             node->validity |= LYD_VAL_LEAFREF;
@@ -316,7 +550,8 @@ lyb_new_node(const struct lys_node *schema)
         break;
     case LYS_ANYDATA:
     case LYS_ANYXML:
-        node = calloc(sizeof(struct lyd_node_anydata), 1);
+        LY_CHECK_RETURN(ly_parse_charge(schema->module->ctx, 1, sizeof(struct lyd_node_anydata)), NULL);
+        node = lyd_node_alloc(schema->module->ctx, sizeof(struct lyd_node_anydata));
         break;
     default:
         return NULL;
@@ -338,7 +573,6 @@ static int
 lyb_parse_anydata(struct lyd_node *node, const char *data, struct lyb_state *lybs)
 {
     int r, ret = 0;
-    char *str = NULL;
     struct lyd_node_anydata *any = (struct lyd_node_anydata *)node;
 
     /* read value type */
@@ -354,11 +588,9 @@ lyb_parse_anydata(struct lyd_node *node, const char *data, struct lyb_state *lyb
         ret += (r = lyb_read_string(data, &any->value.mem, 0, lybs));
         LYB_HAVE_READ_RETURN(r, data, -1);
     } else {
-        ret += (r = lyb_read_string(data, &str, 0, lybs));
-        LYB_HAVE_READ_RETURN(r, data, -1);
-
         /* add to dictionary */
-        any->value.str = lydict_insert_zc(node->schema->module->ctx, str);
+        ret += (r = lyb_read_string_dict(node->schema->module->ctx, data, &any->value.str, lybs));
+        LYB_HAVE_READ_RETURN(r, data, -1);
     }
 
     return ret;
@@ -371,16 +603,14 @@ lyb_parse_val_1(struct ly_ctx *ctx, struct lys_type *type, LY_DATA_TYPE value_ty
 {
     int r, ret;
     size_t i;
-    char *str = NULL;
     uint8_t byte;
     uint64_t num;
+    struct lys_ident *ident;
+    char *str;
 
     if (value_flags & LY_VALUE_USER) {
         /* just read value_str */
-        ret = lyb_read_string(data, &str, 0, lybs);
-        if (ret > -1) {
-            *value_str = lydict_insert_zc(ctx, str);
-        }
+        ret = lyb_read_value_string_priv(ctx, data, value_str, value_flags & LY_VALUE_PRIVATE, lybs);
         return ret;
     }
 
@@ -399,27 +629,43 @@ lyb_parse_val_1(struct ly_ctx *ctx, struct lys_type *type, LY_DATA_TYPE value_ty
     }
 
     switch (value_type) {
-    case LY_TYPE_INST:
     case LY_TYPE_IDENT:
+        if (!lybs->ident_idx) {
+            /* we do not actually fill value now, but value_str */
+            ret = lyb_read_value_string(ctx, data, value_str, lybs);
+            break;
+        }
+
+        ret = lyb_read_ident(ctx, data, &ident, lybs);
+        if (ret < 0) {
+            return -1;
+        }
+
+        /* canonical value, always with the module name */
+        str = malloc(strlen(lys_main_module(ident->module)->name) + 1 + strlen(ident->name) + 1);
+        LY_CHECK_ERR_RETURN(!str, LOGMEM(ctx), -1);
+        sprintf(str, "%s:%s", lys_main_module(ident->module)->name, ident->name);
+        *value_str = lydict_insert_zc(ctx, str);
+
+        if (lybs->trusted && (type->base == LY_TYPE_IDENT)) {
+            /* no need to resolve it again */
+            value->ident = ident;
+        }
+        break;
+    case LY_TYPE_INST:
     case LY_TYPE_UNION:
         /* we do not actually fill value now, but value_str */
-        ret = lyb_read_string(data, &str, 0, lybs);
-        if (ret > -1) {
-            *value_str = lydict_insert_zc(ctx, str);
-        }
+        ret = lyb_read_value_string(ctx, data, value_str, lybs);
         break;
     case LY_TYPE_BINARY:
     case LY_TYPE_STRING:
     case LY_TYPE_UNKNOWN:
         /* read string */
-        ret = lyb_read_string(data, &str, 0, lybs);
-        if (ret > -1) {
-            value->string = lydict_insert_zc(ctx, str);
-        }
+        ret = lyb_read_value_string_priv(ctx, data, &value->string, value_flags & LY_VALUE_PRIVATE, lybs);
         break;
     case LY_TYPE_BITS:
-        value->bit = calloc(type->info.bits.count, sizeof *value->bit);
-        LY_CHECK_ERR_RETURN(!value->bit, LOGMEM(ctx), -1);
+        value->bit = lyd_bits_new(ctx, type->info.bits.count);
+        LY_CHECK_RETURN(!value->bit, -1);
 
         /* read values */
         ret = 0;
@@ -437,6 +683,9 @@ lyb_parse_val_1(struct ly_ctx *ctx, struct lys_type *type, LY_DATA_TYPE value_ty
                 value->bit[i] = &type->info.bits.bit[i];
             }
         }
+
+        value->bit = lyd_bits_share(value->bit);
+        LY_CHECK_RETURN(!value->bit, -1);
         break;
     case LY_TYPE_BOOL:
         /* read byte */
@@ -520,7 +769,7 @@ lyb_parse_val_2(struct lys_type *type, struct lyd_node_leaf_list *leaf, struct l
     if (*value_flags & LY_VALUE_USER) {
         /* unfortunately, we need to also fill the value properly, so just parse it again */
         *value_flags &= ~LY_VALUE_USER;
-        if (!lyp_parse_value(type, value_str, NULL, leaf, attr, NULL, 1, (leaf ? leaf->dflt : 0), 1)) {
+        if (!lyp_parse_value(type, value_str, NULL, leaf, attr, NULL, 1, (leaf ? leaf->dflt : 0), LYP_TRUSTED_CANON)) {
             return -1;
         }
 
@@ -555,6 +804,11 @@ lyb_parse_val_2(struct lys_type *type, struct lyd_node_leaf_list *leaf, struct l
 
     switch (value_type) {
     case LY_TYPE_IDENT:
+        if (value->ident) {
+            /* trusted identity read by its index */
+            break;
+        }
+
         /* fill the identity pointer now */
         value->ident = resolve_identref(type, *value_str, (struct lyd_node *)leaf, mod, (leaf ? leaf->dflt : 0));
         if (!value->ident) {
@@ -611,35 +865,35 @@ lyb_parse_val_2(struct lys_type *type, struct lyd_node_leaf_list *leaf, struct l
         break;
     case LY_TYPE_INT8:
         sprintf(num_str, "%d", value->int8);
-        *value_str = lydict_insert(ctx, num_str, 0);
+        *value_str = lydict_insert_priv(ctx, num_str, 0, *value_flags & LY_VALUE_PRIVATE);
         break;
     case LY_TYPE_UINT8:
         sprintf(num_str, "%u", value->uint8);
-        *value_str = lydict_insert(ctx, num_str, 0);
+        *value_str = lydict_insert_priv(ctx, num_str, 0, *value_flags & LY_VALUE_PRIVATE);
         break;
     case LY_TYPE_INT16:
         sprintf(num_str, "%d", value->int16);
-        *value_str = lydict_insert(ctx, num_str, 0);
+        *value_str = lydict_insert_priv(ctx, num_str, 0, *value_flags & LY_VALUE_PRIVATE);
         break;
     case LY_TYPE_UINT16:
         sprintf(num_str, "%u", value->uint16);
-        *value_str = lydict_insert(ctx, num_str, 0);
+        *value_str = lydict_insert_priv(ctx, num_str, 0, *value_flags & LY_VALUE_PRIVATE);
         break;
     case LY_TYPE_INT32:
         sprintf(num_str, "%d", value->int32);
-        *value_str = lydict_insert(ctx, num_str, 0);
+        *value_str = lydict_insert_priv(ctx, num_str, 0, *value_flags & LY_VALUE_PRIVATE);
         break;
     case LY_TYPE_UINT32:
         sprintf(num_str, "%u", value->uint32);
-        *value_str = lydict_insert(ctx, num_str, 0);
+        *value_str = lydict_insert_priv(ctx, num_str, 0, *value_flags & LY_VALUE_PRIVATE);
         break;
     case LY_TYPE_INT64:
         sprintf(num_str, "%"PRId64, value->int64);
-        *value_str = lydict_insert(ctx, num_str, 0);
+        *value_str = lydict_insert_priv(ctx, num_str, 0, *value_flags & LY_VALUE_PRIVATE);
         break;
     case LY_TYPE_UINT64:
         sprintf(num_str, "%"PRIu64, value->uint64);
-        *value_str = lydict_insert(ctx, num_str, 0);
+        *value_str = lydict_insert_priv(ctx, num_str, 0, *value_flags & LY_VALUE_PRIVATE);
         break;
     case LY_TYPE_DEC64:
         frac = value->dec64 % rtype->info.dec64.div;
@@ -651,7 +905,7 @@ lyb_parse_val_2(struct lys_type *type, struct lyd_node_leaf_list *leaf, struct l
         }
 
         sprintf(num_str, "%"PRId64".%.*"PRId64, value->dec64 / (int64_t)rtype->info.dec64.div, dig, frac);
-        *value_str = lydict_insert(ctx, num_str, 0);
+        *value_str = lydict_insert_priv(ctx, num_str, 0, *value_flags & LY_VALUE_PRIVATE);
         break;
     default:
         return -1;
@@ -724,6 +978,8 @@ lyb_parse_value(struct lys_type *type, struct lyd_node_leaf_list *leaf, struct l
     if (start_byte & 0x80) {
         assert(leaf);
         leaf->dflt = 1;
+    } else if (leaf && (*value_type == type->base) && lyd_value_private(leaf->schema)) {
+        *value_flags |= LY_VALUE_PRIVATE;
     }
     if (start_byte & 0x40) {
         *value_flags |= LY_VALUE_USER;
@@ -754,49 +1010,15 @@ static int
 lyb_parse_attr_name(const struct lys_module *mod, const char *data, struct lys_ext_instance_complex **ext, int options,
                     struct lyb_state *lybs)
 {
-    int r, ret = 0, pos, i, j, k;
-    const struct lys_submodule *submod = NULL;
+    int r, ret = 0;
     char *attr_name = NULL;
 
     /* attr name */
     ret += (r = lyb_read_string(data, &attr_name, 1, lybs));
     LYB_HAVE_READ_RETURN(r, data, -1);
 
-    /* search module */
-    pos = -1;
-    for (i = 0, j = 0; i < mod->ext_size; i = i + j + 1) {
-        j = lys_ext_instance_presence(&mod->ctx->models.list[0]->extensions[0], &mod->ext[i], mod->ext_size - i);
-        if (j == -1) {
-            break;
-        }
-        if (ly_strequal(mod->ext[i + j]->arg_value, attr_name, 0)) {
-            pos = i + j;
-            break;
-        }
-    }
-
-    /* try submodules */
-    if (pos == -1) {
-        for (k = 0; k < mod->inc_size; ++k) {
-            submod = mod->inc[k].submodule;
-            for (i = 0, j = 0; i < submod->ext_size; i = i + j + 1) {
-                j = lys_ext_instance_presence(&mod->ctx->models.list[0]->extensions[0], &submod->ext[i], submod->ext_size - i);
-                if (j == -1) {
-                    break;
-                }
-                if (ly_strequal(submod->ext[i + j]->arg_value, attr_name, 0)) {
-                    pos = i + j;
-                    break;
-                }
-            }
-        }
-    }
-
-    if (pos == -1) {
-        *ext = NULL;
-    } else {
-        *ext = submod ? (struct lys_ext_instance_complex *)submod->ext[pos] : (struct lys_ext_instance_complex *)mod->ext[pos];
-    }
+    /* search module and its submodules */
+    *ext = lys_find_annotation(mod, attr_name);
 
     if (!*ext && (options & LYD_OPT_STRICT)) {
         LOGVAL(mod->ctx, LYE_SPEC, LY_VLOG_NONE, NULL, "Failed to find annotation \"%s\" in \"%s\".", attr_name, mod->name);
@@ -906,6 +1128,35 @@ lyb_is_schema_hash_match(struct lys_node *sibling, LYB_HASH *hash, uint8_t hash_
     return 1;
 }
 
+/* schema node found by its hashes, see lyb_state.snode_ht */
+struct lyb_snode_rec {
+    const struct lys_node *sparent;
+    const struct lys_module *mod;
+    uint64_t hash;              /* all the read hashes */
+    int options;
+    struct lys_node *snode;
+};
+
+static int
+lyb_snode_equal(void *val1_p, void *val2_p, int UNUSED(mod), void *UNUSED(cb_data))
+{
+    struct lyb_snode_rec *rec1 = val1_p, *rec2 = val2_p;
+
+    return (rec1->sparent == rec2->sparent) && (rec1->mod == rec2->mod) && (rec1->hash == rec2->hash)
+            && (rec1->options == rec2->options);
+}
+
+static uint32_t
+lyb_snode_hash(const struct lyb_snode_rec *rec)
+{
+    uint32_t hash;
+
+    hash = dict_hash_multi(0, (const char *)&rec->sparent, sizeof rec->sparent);
+    hash = dict_hash_multi(hash, (const char *)&rec->mod, sizeof rec->mod);
+    hash = dict_hash_multi(hash, (const char *)&rec->hash, sizeof rec->hash);
+    return dict_hash_multi(hash, NULL, 0);
+}
+
 static int
 lyb_parse_schema_hash(const struct lys_node *sparent, const struct lys_module *mod, const char *data, const char *yang_data_name,
                       int options, struct lys_node **snode, struct lyb_state *lybs)
@@ -915,6 +1166,8 @@ lyb_parse_schema_hash(const struct lys_node *sparent, const struct lys_module *m
     struct lys_node *sibling;
     LYB_HASH hash[LYB_HASH_BITS - 1];
     struct ly_ctx *ctx;
+    struct lyb_snode_rec rec, *match;
+    uint32_t rec_hash = 0;
 
     assert((sparent || mod) && (!sparent || !mod));
     ctx = (sparent ? sparent->module->ctx : mod->ctx);
@@ -944,6 +1197,20 @@ lyb_parse_schema_hash(const struct lys_node *sparent, const struct lys_module *m
         assert(!(hash[j - 1] & (LYB_HASH_MASK << (LYB_HASH_BITS - (j - 1)))));
     }
 
+    if (lybs->snode_ht) {
+        /* the same schema node was likely found in a previous frame of the stream */
+        memset(&rec, 0, sizeof rec);
+        rec.sparent = sparent;
+        rec.mod = mod;
+        memcpy(&rec.hash, hash, i + 1);
+        rec.options = options & (LYD_OPT_RPC | LYD_OPT_RPCREPLY);
+        rec_hash = lyb_snode_hash(&rec);
+        if (!lyht_find(lybs->snode_ht, &rec, rec_hash, (void **)&match)) {
+            sibling = match->snode;
+            goto finish;
+        }
+    }
+
     /* handle yang data templates */
     if ((options & LYD_OPT_DATA_TEMPLATE) && yang_data_name && mod) {
         sparent = lyp_get_yang_data_template(mod, yang_data_name, strlen(yang_data_name));
@@ -983,6 +1250,11 @@ lyb_parse_schema_hash(const struct lys_node *sparent, const struct lys_module *m
         }
     }
 
+    if (lybs->snode_ht) {
+        rec.snode = sibling;
+        lyht_insert(lybs->snode_ht, &rec, rec_hash, NULL);
+    }
+
 finish:
     *snode = sibling;
     if (!sibling && (options & LYD_OPT_STRICT)) {
@@ -1012,7 +1284,13 @@ lyb_parse_subtree(struct ly_ctx *ctx, const char *data, struct lyd_node *parent,
     ret += (r = lyb_read_start_subtree(data, lybs));
     LYB_HAVE_READ_GOTO(r, data, error);
 
-    if (!parent) {
+    if (!parent && lybs->stream) {
+        /* top-level, read the index of the module in the stream header */
+        ret += (r = lyb_parse_stream_model(ctx, data, &mod, lybs));
+        LYB_HAVE_READ_GOTO(r, data, error);
+
+        r = lyb_parse_schema_hash(NULL, mod, data, yang_data_name, options, &snode, lybs);
+    } else if (!parent) {
         /* top-level, read module name */
         ret += (r = lyb_parse_model(ctx, data, &mod, lybs));
         LYB_HAVE_READ_GOTO(r, data, error);
@@ -1199,17 +1477,154 @@ lyb_parse_header(const char *data, struct lyb_state *lybs)
     int ret = 0;
     uint8_t byte = 0;
 
-    /* TODO version, any flags? */
+    /* TODO version */
     ret += lyb_read(data, (uint8_t *)&byte, sizeof byte, lybs);
+    lybs->str_table = (byte & LYB_HEADER_STRTABLE) ? 1 : 0;
+    lybs->index = (byte & LYB_HEADER_INDEX) ? 1 : 0;
+    lybs->ident_idx = (byte & LYB_HEADER_IDENTIDX) ? 1 : 0;
+    lybs->patch = (byte & LYB_HEADER_PATCH) ? 1 : 0;
+    lybs->stream = (byte & LYB_HEADER_STREAM) ? 1 : 0;
 
     return ret;
 }
 
-struct lyd_node *
-lyd_parse_lyb(struct ly_ctx *ctx, const char *data, int options, const struct lyd_node *data_tree,
-              const char *yang_data_name, int *parsed)
+static void
+lyb_strs_clear(struct ly_ctx *ctx, struct lyb_state *lybs)
+{
+    while (lybs->str_count) {
+        lydict_remove(ctx, lybs->strs[--lybs->str_count]);
+    }
+}
+
+/* whether an index path matches the requested path, see lyd_parse_lyb_subtrees() */
+int
+lyb_index_match(const char *ipath, size_t len, const char *path)
+{
+    size_t plen;
+
+    plen = strlen(path);
+    if (plen && (path[plen - 1] == '*')) {
+        /* all the top-level nodes of a module */
+        --plen;
+        return (len >= plen) && !strncmp(ipath, path, plen);
+    }
+
+    if ((len < plen) || strncmp(ipath, path, plen)) {
+        return 0;
+    }
+    /* the node itself or all the instances of a list or leaf-list */
+    return (len == plen) || (ipath[plen] == '[');
+}
+
+/**
+ * @brief Parse the subtrees of the top-level nodes matching a path found in the LYB index.
+ *
+ * @param[in] ctx libyang context.
+ * @param[in] start Whole LYB data.
+ * @param[in] length Length of \p start, 0 if unknown.
+ * @param[in] path Path to match.
+ * @param[in] options Parser options.
+ * @param[in] unres Unresolved data.
+ * @param[in,out] first First parsed top-level node.
+ * @param[in] lybs LYB parser state with the models already read.
+ * @return 0 on success, -1 on error.
+ */
+static int
+lyb_parse_index(struct ly_ctx *ctx, const char *start, size_t length, const char *path, int options,
+                struct unres_data *unres, struct lyd_node **first, struct lyb_state *lybs)
+{
+    const char *index;
+    uint64_t offset;
+    uint32_t count, i;
+    uint16_t len;
+    int r;
+
+    if (!lybs->index) {
+        LOGERR(ctx, LY_EINVAL, "LYB data do not include an index.");
+        return -1;
+    }
+    if (!length) {
+        r = lyd_lyb_data_length(start);
+        if (r < 0) {
+            LOGERR(ctx, LY_EINVAL, "Invalid LYB data.");
+            return -1;
+        }
+        length = r;
+    }
+
+    /* index offset is stored at the very end */
+    memcpy(&offset, start + length - sizeof offset, sizeof offset);
+    index = start + le64toh(offset);
+    memcpy(&count, index, sizeof count);
+    count = le32toh(count);
+    index += sizeof count;
+
+    for (i = 0; i < count; ++i) {
+        memcpy(&offset, index, sizeof offset);
+        offset = le64toh(offset);
+        index += sizeof offset;
+        memcpy(&len, index, sizeof len);
+        len = le16toh(len);
+        index += sizeof len;
+
+        if (lyb_index_match(index, len, path)) {
+            /* every indexed subtree can be parsed on its own */
+            lyb_strs_clear(ctx, lybs);
+            if (lyb_parse_subtree(ctx, start + offset, NULL, first, NULL, options, unres, lybs) < 0) {
+                return -1;
+            }
+        }
+        index += len;
+    }
+
+    return 0;
+}
+
+static int
+lyb_parse_state_init(struct ly_ctx *ctx, struct lyb_state *lybs, int options)
+{
+    memset(lybs, 0, sizeof *lybs);
+    lybs->trusted = (options & LYD_OPT_TRUSTED) ? 1 : 0;
+    lybs->written = malloc(LYB_STATE_STEP * sizeof *lybs->written);
+    lybs->position = malloc(LYB_STATE_STEP * sizeof *lybs->position);
+    lybs->inner_chunks = malloc(LYB_STATE_STEP * sizeof *lybs->inner_chunks);
+    LY_CHECK_ERR_RETURN(!lybs->written || !lybs->position || !lybs->inner_chunks, LOGMEM(ctx), -1);
+    lybs->size = LYB_STATE_STEP;
+
+    return 0;
+}
+
+static void
+lyb_parse_state_clean(struct ly_ctx *ctx, struct lyb_state *lybs)
+{
+    free(lybs->written);
+    free(lybs->position);
+    free(lybs->inner_chunks);
+    free(lybs->models);
+    lyb_strs_clear(ctx, lybs);
+    free(lybs->strs);
+}
+
+/**
+ * @brief Parse LYB data.
+ *
+ * @param[in] ctx libyang context.
+ * @param[in] data LYB data.
+ * @param[in] length Length of \p data, 0 if unknown, used only with \p path.
+ * @param[in] options Parser options.
+ * @param[in] data_tree Data tree for the RPC/action/notification.
+ * @param[in] yang_data_name Yang data template name.
+ * @param[in] path Path of the top-level nodes to parse using the index, NULL to parse all the data.
+ * @param[in] stream Stream with the header of the data, which are only a frame, NULL for standalone data.
+ * @param[out] parsed Number of parsed bytes, optional.
+ * @return Parsed data tree, NULL on error or if empty.
+ */
+static struct lyd_node *
+lyb_parse_data(struct ly_ctx *ctx, const char *data, size_t length, int options, const struct lyd_node *data_tree,
+               const char *yang_data_name, const char *path, struct lyd_lyb_stream *stream, int *parsed)
 {
     int r = 0, ret = 0;
+    const char *start = data;
     struct lyd_node *node = NULL, *next, *act_notif = NULL;
     struct unres_data *unres = NULL;
     struct lyb_state lybs;
@@ -1219,18 +1634,26 @@ lyd_parse_lyb(struct ly_ctx *ctx, const char *data, int options, const struct ly
         return NULL;
     }
 
-    lybs.written = malloc(LYB_STATE_STEP * sizeof *lybs.written);
-    lybs.position = malloc(LYB_STATE_STEP * sizeof *lybs.position);
-    lybs.inner_chunks = malloc(LYB_STATE_STEP * sizeof *lybs.inner_chunks);
-    LY_CHECK_ERR_GOTO(!lybs.written || !lybs.position || !lybs.inner_chunks, LOGMEM(ctx), finish);
-    lybs.used = 0;
-    lybs.size = LYB_STATE_STEP;
-    lybs.models = NULL;
-    lybs.mod_count = 0;
+    if (lyb_parse_state_init(ctx, &lybs, options)) {
+        goto finish;
+    }
 
     unres = calloc(1, sizeof *unres);
     LY_CHECK_ERR_GOTO(!unres, LOGMEM(ctx), finish);
 
+    if (stream) {
+        /* the header with the models was read before, skip the frame length */
+        lybs.stream = 1;
+        lybs.str_table = stream->str_table;
+        lybs.ident_idx = 1;
+        lybs.models = stream->models;
+        lybs.mod_count = stream->mod_count;
+        lybs.snode_ht = stream->snode_ht;
+        data += 4;
+        ret += 4;
+        goto subtrees;
+    }
+
     /* read magic number */
     ret += (r = lyb_parse_magic_number(data, &lybs));
     LYB_HAVE_READ_GOTO(r, data, finish);
@@ -1238,25 +1661,47 @@ lyd_parse_lyb(struct ly_ctx *ctx, const char *data, int options, const struct ly
     /* read header */
     ret += (r = lyb_parse_header(data, &lybs));
     LYB_HAVE_READ_GOTO(r, data, finish);
+    if (lybs.patch) {
+        LOGERR(ctx, LY_EINVAL, "LYB data are a patch, it can only be applied to a data tree.");
+        goto finish;
+    } else if (lybs.stream) {
+        LOGERR(ctx, LY_EINVAL, "LYB data are a stream header, the frames are parsed with lyd_lyb_stream_parse().");
+        goto finish;
+    }
 
     /* read used models */
     ret += (r = lyb_parse_data_models(ctx, data, &lybs));
     LYB_HAVE_READ_GOTO(r, data, finish);
 
-    /* read subtree(s) */
-    while (data[0]) {
-        ret += (r = lyb_parse_subtree(ctx, data, NULL, &node, yang_data_name, options, unres, &lybs));
-        if (r < 0) {
+subtrees:
+    if (path) {
+        /* read only the indexed subtree(s) */
+        if (lyb_parse_index(ctx, start, length, path, options, unres, &node, &lybs)) {
             lyd_free_withsiblings(node);
             node = NULL;
             goto finish;
         }
-        data += r;
-    }
+        r = ret;
+    } else {
+        /* read subtree(s) */
+        while (data[0]) {
+            if (lybs.index) {
+                /* the string table is not shared by indexed subtrees */
+                lyb_strs_clear(ctx, &lybs);
+            }
+            ret += (r = lyb_parse_subtree(ctx, data, NULL, &node, yang_data_name, options, unres, &lybs));
+            if (r < 0) {
+                lyd_free_withsiblings(node);
+                node = NULL;
+                goto finish;
+            }
+            data += r;
+        }
 
-    /* read the last zero, parsing finished */
-    ++ret;
-    r = ret;
+        /* read the last zero, parsing finished */
+        ++ret;
+        r = ret;
+    }
 
     if (options & LYD_OPT_DATA_ADD_YANGLIB) {
         if (lyd_merge(node, ly_ctx_info(ctx), LYD_OPT_DESTRUCT | LYD_OPT_EXPLICIT)) {
@@ -1285,10 +1730,11 @@ lyd_parse_lyb(struct ly_ctx *ctx, const char *data, int options, const struct ly
     }
 
 finish:
-    free(lybs.written);
-    free(lybs.position);
-    free(lybs.inner_chunks);
-    free(lybs.models);
+    if (stream) {
+        /* owned by the stream */
+        lybs.models = NULL;
+    }
+    lyb_parse_state_clean(ctx, &lybs);
     if (unres) {
         free(unres->node);
         free(unres->type);
@@ -1300,3 +1746,447 @@ finish:
     }
     return node;
 }
+
+struct lyd_node *
+lyd_parse_lyb(struct ly_ctx *ctx, const char *data, int options, const struct lyd_node *data_tree,
+              const char *yang_data_name, int *parsed)
+{
+    return lyb_parse_data(ctx, data, 0, options, data_tree, yang_data_name, NULL, NULL, parsed);
+}
+
+struct lyd_node *
+lyd_parse_lyb_index(struct ly_ctx *ctx, const char *data, size_t length, int options, const char *path)
+{
+    return lyb_parse_data(ctx, data, length, options, NULL, NULL, path, NULL, NULL);
+}
+
+int
+lyd_parse_lyb_lazy(struct lyd_lazy *lazy, size_t length)
+{
+    struct ly_ctx *ctx = lazy->ctx;
+    const char *data = lazy->data, *index;
+    uint64_t offset;
+    uint32_t count, i;
+    uint16_t len;
+    int r, ret = -1;
+    struct lyb_state lybs;
+
+    if (lyb_parse_state_init(ctx, &lybs, LYD_OPT_TRUSTED)) {
+        goto finish;
+    }
+
+    r = lyb_parse_magic_number(data, &lybs);
+    LYB_HAVE_READ_GOTO(r, data, finish);
+    r = lyb_parse_header(data, &lybs);
+    LYB_HAVE_READ_GOTO(r, data, finish);
+    if (lybs.patch || lybs.stream || !lybs.index) {
+        LOGERR(ctx, LY_EINVAL, "LYB data do not include an index.");
+        goto finish;
+    }
+    r = lyb_parse_data_models(ctx, data, &lybs);
+    LYB_HAVE_READ_GOTO(r, data, finish);
+
+    if (!length) {
+        r = lyd_lyb_data_length(lazy->data);
+        if (r < 0) {
+            LOGERR(ctx, LY_EINVAL, "Invalid LYB data.");
+            goto finish;
+        }
+        length = r;
+    }
+
+    /* only the index is read, the subtrees stay in the data */
+    memcpy(&offset, lazy->data + length - sizeof offset, sizeof offset);
+    index = lazy->data + le64toh(offset);
+    memcpy(&count, index, sizeof count);
+    count = le32toh(count);
+    index += sizeof count;
+
+    lazy->subtrees = calloc(count ? count : 1, sizeof *lazy->subtrees);
+    LY_CHECK_ERR_GOTO(!lazy->subtrees, LOGMEM(ctx), finish);
+    for (i = 0; i < count; ++i) {
+        memcpy(&offset, index, sizeof offset);
+        offset = le64toh(offset);
+        index += sizeof offset;
+        memcpy(&len, index, sizeof len);
+        len = le16toh(len);
+        index += sizeof len;
+        if ((offset >= length) || (index + len > lazy->data + length)) {
+            LOGERR(ctx, LY_EINVAL, "Invalid LYB index.");
+            goto finish;
+        }
+
+        lazy->subtrees[i].offset = offset;
+        lazy->subtrees[i].path = index;
+        lazy->subtrees[i].path_len = len;
+        index += len;
+    }
+    lazy->count = count;
+
+    lazy->snode_ht = lyht_new(64, sizeof(struct lyb_snode_rec), lyb_snode_equal, NULL, 1);
+    LY_CHECK_ERR_GOTO(!lazy->snode_ht, LOGMEM(ctx), finish);
+
+    /* the models are now owned by the lazy data */
+    lazy->str_table = lybs.str_table;
+    lazy->ident_idx = lybs.ident_idx;
+    lazy->models = lybs.models;
+    lazy->mod_count = lybs.mod_count;
+    lybs.models = NULL;
+    ret = 0;
+
+finish:
+    lyb_parse_state_clean(ctx, &lybs);
+    return ret;
+}
+
+struct lyd_node *
+lyd_parse_lyb_lazy_subtree(struct lyd_lazy *lazy, uint32_t idx)
+{
+    struct ly_ctx *ctx = lazy->ctx;
+    struct lyd_node *node = NULL;
+    struct unres_data *unres = NULL;
+    struct lyb_state lybs;
+
+    if (lyb_parse_state_init(ctx, &lybs, lazy->options)) {
+        goto finish;
+    }
+    lybs.str_table = lazy->str_table;
+    lybs.index = 1;
+    lybs.ident_idx = lazy->ident_idx;
+    lybs.models = lazy->models;
+    lybs.mod_count = lazy->mod_count;
+    lybs.snode_ht = lazy->snode_ht;
+
+    unres = calloc(1, sizeof *unres);
+    LY_CHECK_ERR_GOTO(!unres, LOGMEM(ctx), finish);
+
+    if (lyb_parse_subtree(ctx, lazy->data + lazy->subtrees[idx].offset, NULL, &node, NULL, lazy->options, unres,
+                          &lybs) < 0) {
+        lyd_free_withsiblings(node);
+        node = NULL;
+        goto finish;
+    }
+
+    /* references only within the subtree, so it can be freed on its own, the others are kept unresolved */
+    if (unres->count && resolve_unres_data(ctx, unres, &node, lazy->options)) {
+        lyd_free_withsiblings(node);
+        node = NULL;
+    }
+
+finish:
+    /* owned by the lazy data */
+    lybs.models = NULL;
+    lyb_parse_state_clean(ctx, &lybs);
+    if (unres) {
+        free(unres->node);
+        free(unres->type);
+        free(unres);
+    }
+    return node;
+}
+
+struct lyd_node *
+lyd_parse_lyb_stream_frame(struct lyd_lyb_stream *stream, const char *data, int options, int *parsed)
+{
+    if (!stream->snode_ht) {
+        stream->snode_ht = lyht_new(64, sizeof(struct lyb_snode_rec), lyb_snode_equal, NULL, 1);
+        LY_CHECK_ERR_RETURN(!stream->snode_ht, LOGMEM(stream->ctx), NULL);
+    }
+
+    return lyb_parse_data(stream->ctx, data, 0, options, NULL, NULL, NULL, stream, parsed);
+}
+
+int
+lyd_parse_lyb_stream_header(struct lyd_lyb_stream *stream, const char *data)
+{
+    int r, ret = -1;
+    const char *start = data;
+    struct lyb_state lybs;
+
+    if (lyb_parse_state_init(stream->ctx, &lybs, 0)) {
+        goto finish;
+    }
+
+    r = lyb_parse_magic_number(data, &lybs);
+    LYB_HAVE_READ_GOTO(r, data, finish);
+    r = lyb_parse_header(data, &lybs);
+    LYB_HAVE_READ_GOTO(r, data, finish);
+    if (!lybs.stream) {
+        LOGERR(stream->ctx, LY_EINVAL, "LYB data are not a stream header.");
+        goto finish;
+    }
+
+    /* skip the models length */
+    data += 4;
+    r = lyb_parse_data_models(stream->ctx, data, &lybs);
+    LYB_HAVE_READ_GOTO(r, data, finish);
+
+    /* the models are now owned by the stream */
+    stream->str_table = lybs.str_table;
+    stream->models = lybs.models;
+    stream->mod_count = lybs.mod_count;
+    lybs.models = NULL;
+    ret = data - start;
+
+finish:
+    lyb_parse_state_clean(stream->ctx, &lybs);
+    return ret;
+}
+
+/* find the data instance of a node parsed from a LYB patch among its siblings */
+static struct lyd_node *
+lyb_patch_find(struct ly_ctx *ctx, const struct lyd_node *first, const struct lyd_node *pnode)
+{
+    const struct lys_node_list *slist;
+    const struct lyd_node *key;
+    const char **values;
+    struct lyd_node *match;
+    uint8_t i;
+
+    if (!first) {
+        return NULL;
+    }
+
+    if (pnode->schema->nodetype == LYS_LEAFLIST) {
+        return lyd_find_sibling_val(first, pnode->schema, &((struct lyd_node_leaf_list *)pnode)->value_str);
+    } else if (pnode->schema->nodetype != LYS_LIST) {
+        return lyd_find_sibling_val(first, pnode->schema, NULL);
+    }
+
+    /* the keys are the first children */
+    slist = (const struct lys_node_list *)pnode->schema;
+    values = malloc(slist->keys_size * sizeof *values);
+    LY_CHECK_ERR_RETURN(!values, LOGMEM(ctx), NULL);
+    for (i = 0, key = pnode->child; i < slist->keys_size; ++i, key = key->next) {
+        if (!key || (key->schema != (struct lys_node *)slist->keys[i])) {
+            LOGERR(ctx, LY_EINVAL, "Invalid LYB patch, missing \"%s\" list keys.", slist->name);
+            free(values);
+            return NULL;
+        }
+        values[i] = ((struct lyd_node_leaf_list *)key)->value_str;
+    }
+
+    match = lyd_find_sibling_val(first, pnode->schema, values);
+    free(values);
+    return match;
+}
+
+/**
+ * @brief Find the node of a LYB patch operation in the data tree.
+ *
+ * @param[in] ctx libyang context.
+ * @param[in] first First top-level data node.
+ * @param[in] chain Parsed top-level subtree of the operation.
+ * @param[in] depth Depth of the node.
+ * @param[out] parent Data parent of the node, NULL for a top-level node.
+ * @param[out] pnode Parsed node.
+ * @param[out] match Data instance of the node, NULL if there is none.
+ * @return 0 on success, -1 if some ancestor of the node is not in the tree.
+ */
+static int
+lyb_patch_walk(struct ly_ctx *ctx, struct lyd_node *first, struct lyd_node *chain, uint32_t depth,
+               struct lyd_node **parent, struct lyd_node **pnode, struct lyd_node **match)
+{
+    *parent = NULL;
+    for (; depth > 1; --depth) {
+        *parent = lyb_patch_find(ctx, first, chain);
+        if (!*parent || !chain->child) {
+            LOGERR(ctx, LY_EINVAL, "LYB patch does not match the data tree, \"%s\" instance not found.", chain->schema->name);
+            return -1;
+        }
+
+        /* the next node of the chain is the last child */
+        first = (*parent)->child;
+        chain = chain->child->prev;
+    }
+
+    *pnode = chain;
+    *match = lyb_patch_find(ctx, first, chain);
+    return 0;
+}
+
+/* read the depth and the subtree of a LYB patch node */
+static int
+lyb_parse_patch_node(struct ly_ctx *ctx, const char *data, uint32_t *depth, struct lyd_node **chain,
+                     struct unres_data *unres, struct lyb_state *lybs)
+{
+    int r, ret = 0;
+
+    ret += (r = lyb_read_varnum(ctx, depth, data, lybs));
+    LYB_HAVE_READ_RETURN(r, data, -1);
+    ret += (r = lyb_parse_subtree(ctx, data, NULL, chain, NULL, LYD_OPT_STRICT, unres, lybs));
+    LYB_HAVE_READ_RETURN(r, data, -1);
+    if (!*chain || !*depth) {
+        LOGERR(ctx, LY_EINVAL, "Invalid LYB patch.");
+        return -1;
+    }
+
+    return ret;
+}
+
+int
+lyd_parse_lyb_patch(struct ly_ctx *ctx, struct lyd_node **root, const char *data)
+{
+    int r, ret = -1;
+    uint8_t op, byte;
+    uint32_t depth, adepth;
+    struct lyd_node *chain = NULL, *achain = NULL, *parent, *pnode, *match, *anchor, *iter;
+    struct unres_data *unres = NULL;
+    struct lyb_state lybs;
+
+    if (lyb_parse_state_init(ctx, &lybs, LYD_OPT_TRUSTED)) {
+        goto finish;
+    }
+
+    unres = calloc(1, sizeof *unres);
+    LY_CHECK_ERR_GOTO(!unres, LOGMEM(ctx), finish);
+
+    r = lyb_parse_magic_number(data, &lybs);
+    LYB_HAVE_READ_GOTO(r, data, finish);
+    r = lyb_parse_header(data, &lybs);
+    LYB_HAVE_READ_GOTO(r, data, finish);
+    if (!lybs.patch) {
+        LOGERR(ctx, LY_EINVAL, "LYB data are not a patch.");
+        goto finish;
+    }
+    r = lyb_parse_data_models(ctx, data, &lybs);
+    LYB_HAVE_READ_GOTO(r, data, finish);
+
+    if (*root) {
+        for (; (*root)->parent; *root = (*root)->parent);
+        for (; (*root)->prev->next; *root = (*root)->prev);
+    }
+
+    while (data[0]) {
+        op = data[0];
+        ++data;
+        r = lyb_parse_patch_node(ctx, data, &depth, &chain, unres, &lybs);
+        LYB_HAVE_READ_GOTO(r, data, finish);
+        if ((op == LYD_DIFF_MOVEDAFTER1) || (op == LYD_DIFF_MOVEDAFTER2)) {
+            /* the preceding instance, if any */
+            byte = data[0];
+            ++data;
+            if (byte) {
+                r = lyb_parse_patch_node(ctx, data, &adepth, &achain, unres, &lybs);
+                LYB_HAVE_READ_GOTO(r, data, finish);
+            }
+        }
+
+        if (lyb_patch_walk(ctx, *root, chain, depth, &parent, &pnode, &match)) {
+            goto finish;
+        }
+        if (!match && (op != LYD_DIFF_CREATED)) {
+            LOGERR(ctx, LY_EINVAL, "LYB patch does not match the data tree, \"%s\" instance not found.", pnode->schema->name);
+            goto finish;
+        }
+
+        switch (op) {
+        case LYD_DIFF_DELETED:
+            if (match == *root) {
+                *root = match->next;
+            }
+            lyd_free(match);
+            break;
+        case LYD_DIFF_CHANGED:
+            if (match->schema->nodetype == LYS_LEAF) {
+                if (lyd_change_leaf((struct lyd_node_leaf_list *)match, ((struct lyd_node_leaf_list *)pnode)->value_str) < 0) {
+                    goto finish;
+                }
+                break;
+            }
+
+            /* anydata value, replace the whole node */
+            if (match == *root) {
+                *root = match->next;
+            }
+            lyd_free(match);
+            match = NULL;
+            /* fallthrough */
+        case LYD_DIFF_CREATED:
+            if (match && !match->dflt) {
+                LOGERR(ctx, LY_EINVAL, "LYB patch does not match the data tree, \"%s\" instance already exists.",
+                       pnode->schema->name);
+                goto finish;
+            } else if (match) {
+                /* explicit node instead of the default one */
+                if (match == *root) {
+                    *root = match->next;
+                }
+                lyd_free(match);
+            }
+
+            if (pnode == chain) {
+                chain = NULL;
+            } else {
+                lyd_unlink(pnode);
+            }
+            if (parent) {
+                r = lyd_insert(parent, pnode);
+            } else if (*root) {
+                r = lyd_insert_sibling(root, pnode);
+            } else {
+                *root = pnode;
+                r = 0;
+            }
+            if (r) {
+                lyd_free(pnode);
+                goto finish;
+            }
+            break;
+        case LYD_DIFF_MOVEDAFTER1:
+        case LYD_DIFF_MOVEDAFTER2:
+            if (achain) {
+                if ((adepth != depth) || lyb_patch_walk(ctx, *root, achain, adepth, &iter, &pnode, &anchor)) {
+                    goto finish;
+                }
+                if (!anchor) {
+                    LOGERR(ctx, LY_EINVAL, "LYB patch does not match the data tree, \"%s\" instance not found.",
+                           pnode->schema->name);
+                    goto finish;
+                }
+                if ((anchor != match) && lyd_insert_after(anchor, match)) {
+                    goto finish;
+                }
+                break;
+            }
+
+            /* the first instance */
+            LY_TREE_FOR(parent ? parent->child : *root, iter) {
+                if (iter->schema == match->schema) {
+                    break;
+                }
+            }
+            if ((iter != match) && lyd_insert_before(iter, match)) {
+                goto finish;
+            }
+            break;
+        default:
+            LOGERR(ctx, LY_EINVAL, "Invalid LYB patch operation %u.", op);
+            goto finish;
+        }
+
+        /* the first top-level node could have changed */
+        if (*root) {
+            for (; (*root)->prev->next; *root = (*root)->prev);
+        }
+
+        lyd_free_withsiblings(chain);
+        chain = NULL;
+        lyd_free_withsiblings(achain);
+        achain = NULL;
+        unres->count = 0;
+    }
+
+    ret = 0;
+
+finish:
+    lyd_free_withsiblings(chain);
+    lyd_free_withsiblings(achain);
+    lyb_parse_state_clean(ctx, &lybs);
+    if (unres) {
+        free(unres->node);
+        free(unres->type);
+        free(unres);
+    }
+    return ret;
+}
@@ -73,6 +73,27 @@ xml_data_search_schemanode(struct lyxml_elem *xml, struct lys_node *start, int o
     return NULL;
 }
 
+/* does not log */
+static struct lys_node *
+xml_data_find_schemanode(struct ly_ctx *ctx, struct lyxml_elem *xml, struct lys_node *sparent,
+                         const struct lys_module *mod, int options)
+{
+    const struct lys_node *snode;
+    LYS_NODE inout = 0;
+
+    if (options & LYD_OPT_RPC) {
+        inout = LYS_INPUT;
+    } else if (options & LYD_OPT_RPCREPLY) {
+        inout = LYS_OUTPUT;
+    }
+
+    if (!lys_find_child_hash(ctx, sparent, mod, inout, xml->name, strlen(xml->name), xml->ns->value, &snode)) {
+        return (struct lys_node *)snode;
+    }
+
+    return xml_data_search_schemanode(xml, (sparent ? sparent->child : mod->data), options);
+}
+
 /* logs directly */
 static int
 xml_get_value(struct lyd_node *node, struct lyxml_elem *xml, int editbits, int trusted)
@@ -81,7 +102,10 @@ xml_get_value(struct lyd_node *node, struct lyxml_elem *xml, int editbits, int t
 
     assert(node && (node->schema->nodetype & (LYS_LEAFLIST | LYS_LEAF)) && xml);
 
-    leaf->value_str = lydict_insert(node->schema->module->ctx, xml->content, 0);
+    if (lyd_value_private(node->schema)) {
+        leaf->value_flags |= LY_VALUE_PRIVATE;
+    }
+    leaf->value_str = lydict_insert_priv(node->schema->module->ctx, xml->content, 0, leaf->value_flags & LY_VALUE_PRIVATE);
 
     if ((editbits & 0x20) && (node->schema->nodetype & LYS_LEAF) && (!leaf->value_str || !leaf->value_str[0])) {
         /* we have edit-config leaf/leaf-list with delete operation and no (empty) value,
@@ -99,11 +123,139 @@ xml_get_value(struct lyd_node *node, struct lyxml_elem *xml, int editbits, int t
     return EXIT_SUCCESS;
 }
 
+/**
+ * @brief Element being read directly from the input data, without building the whole XML tree first.
+ */
+struct xml_input {
+    const char *stag;           /**< start tag of the element in the input */
+    const char *data;           /**< position in the input after the already read part of the element */
+    int done;                   /**< whether the element end tag was already read */
+};
+
+/* logs directly */
+static int
+xml_input_finish(struct ly_ctx *ctx, struct lyxml_elem *xml, struct xml_input *in)
+{
+    unsigned int len;
+
+    if (in->done) {
+        return EXIT_SUCCESS;
+    }
+
+    /* read the rest of the element including all its descendants */
+    if (lyxml_parse_elem_finish(ctx, in->data, &len, xml, in->stag, 0)) {
+        return -1;
+    }
+    in->data += len;
+    in->done = 1;
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Read the start tag of the next child element of \p parent. Logs directly.
+ *
+ * @param[in] ctx Context to use.
+ * @param[in] parent Parent XML element, NULL for top-level elements.
+ * @param[in] pin Input of \p parent.
+ * @param[out] in Input of the read child.
+ * @param[out] child Read child element with only its start tag parsed.
+ * @return 0 if a child was read, 1 if there are no more children, -1 on error.
+ */
+static int
+xml_input_next(struct ly_ctx *ctx, struct lyxml_elem *parent, struct xml_input *pin, struct xml_input *in,
+               struct lyxml_elem **child)
+{
+    unsigned int len;
+    int r;
+
+    if (pin->done) {
+        return 1;
+    }
+
+    if (parent) {
+        r = lyxml_parse_elem_next(ctx, pin->data, &len, parent, pin->stag, 0);
+    } else {
+        r = lyxml_parse_misc(ctx, pin->data, &len);
+    }
+    pin->data += len;
+    if (r) {
+        if (r == 1) {
+            pin->done = 1;
+        }
+        return r;
+    }
+
+    in->stag = pin->data;
+    *child = lyxml_parse_elem_start(ctx, in->stag, &len, parent);
+    if (!*child) {
+        return -1;
+    }
+    in->data = in->stag + len;
+    /* EmptyElemTag has the content already set */
+    in->done = (*child)->content ? 1 : 0;
+
+    return 0;
+}
+
+/* logs directly, returns 1 if the element is to be ignored */
+static int
+xml_check_mixed(struct ly_ctx *ctx, struct lyxml_elem *xml, int options)
+{
+    if (xml->flags & LYXML_ELEM_MIXED) {
+        if (options & LYD_OPT_STRICT) {
+            LOGVAL(ctx, LYE_XML_INVAL, LY_VLOG_XML, xml, "XML element with mixed content");
+            return -1;
+        } else {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/* whether the element has any text content other than white spaces */
+static int
+xml_has_text(struct lyxml_elem *xml)
+{
+    int i;
+
+    for (i = 0; xml->content && xml->content[i]; ++i) {
+        if (!is_xmlws(xml->content[i])) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/* logs directly */
+static int
+xml_check_nocontent(struct ly_ctx *ctx, struct lyxml_elem *xml)
+{
+    int i;
+    char *msg;
+
+    for (i = 0; xml->content && xml->content[i]; ++i) {
+        if (!is_xmlws(xml->content[i])) {
+            msg = malloc(22 + strlen(xml->content) + 1);
+            LY_CHECK_ERR_RETURN(!msg, LOGMEM(ctx), -1);
+            sprintf(msg, "node with text data \"%s\"", xml->content);
+            LOGVAL(ctx, LYE_XML_INVAL, LY_VLOG_XML, xml, msg);
+            free(msg);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
 /* logs directly */
 static int
-xml_parse_data(struct ly_ctx *ctx, struct lyxml_elem *xml, struct lyd_node *parent, struct lyd_node *first_sibling,
-               struct lyd_node *prev, int options, struct unres_data *unres, struct lyd_node **result,
-               struct lyd_node **act_notif, const char *yang_data_name)
+xml_parse_data(struct ly_ctx *ctx, struct lyxml_elem *xml, struct xml_input *in, struct lyd_node *parent,
+               struct lyd_node *first_sibling, struct lyd_node *prev, int options, struct unres_data *unres,
+               struct lyd_node **result, struct lyd_node **act_notif, const char *yang_data_name,
+               const struct ly_set *projection)
 {
     const struct lys_module *mod = NULL;
     struct lyd_node *diter, *dlast;
@@ -113,23 +265,23 @@ xml_parse_data(struct ly_ctx *ctx, struct lyxml_elem *xml, struct lyd_node *pare
     struct lyd_attr *dattr, *dattr_iter;
     struct lyxml_attr *attr;
     struct lyxml_elem *child, *next;
-    int i, j, havechildren, r, editbits = 0, filterflag = 0, found;
+    struct xml_input chin;
+    int i, j, havechildren, r, editbits = 0, filterflag = 0, found, child_read;
     uint8_t pos;
     int ret = 0;
     const char *str = NULL;
-    char *msg;
+    char *raw = NULL;
+    unsigned int len;
+    size_t size;
 
     assert(xml);
     assert(result);
     *result = NULL;
 
-    if (xml->flags & LYXML_ELEM_MIXED) {
-        if (options & LYD_OPT_STRICT) {
-            LOGVAL(ctx, LYE_XML_INVAL, LY_VLOG_XML, xml, "XML element with mixed content");
-            return -1;
-        } else {
-            return 0;
-        }
+    /* when reading the input directly, the content is not known yet */
+    r = xml_check_mixed(ctx, xml, options);
+    if (r) {
+        return (r == 1) ? 0 : -1;
     }
 
     if (!xml->ns || !xml->ns->value) {
@@ -163,7 +315,7 @@ xml_parse_data(struct ly_ctx *ctx, struct lyxml_elem *xml, struct lyd_node *pare
                     }
                 }
             } else {
-                schema = xml_data_search_schemanode(xml, mod->data, options);
+                schema = xml_data_find_schemanode(ctx, xml, NULL, mod, options);
                 if (!schema) {
                     /* it still can be the specific case of this module containing an augment of another module
                     * top-level choice or top-level choice's case, bleh */
@@ -195,7 +347,7 @@ xml_parse_data(struct ly_ctx *ctx, struct lyxml_elem *xml, struct lyd_node *pare
         }
     } else {
         /* parsing some internal node, we start with parent's schema pointer */
-        schema = xml_data_search_schemanode(xml, parent->schema->child, options);
+        schema = xml_data_find_schemanode(ctx, xml, parent->schema, NULL, options);
 
         if (ctx->data_clb) {
             if (schema && !lys_node_module(schema)->implemented) {
@@ -204,7 +356,7 @@ xml_parse_data(struct ly_ctx *ctx, struct lyxml_elem *xml, struct lyd_node *pare
             } else if (!schema) {
                 if (ctx->data_clb(ctx, NULL, xml->ns->value, 0, ctx->data_clb_data)) {
                     /* context was updated, so try to find the schema node again */
-                    schema = xml_data_search_schemanode(xml, parent->schema->child, options);
+                    schema = xml_data_find_schemanode(ctx, xml, parent->schema, NULL, options);
                 }
             }
         }
@@ -220,6 +372,37 @@ xml_parse_data(struct ly_ctx *ctx, struct lyxml_elem *xml, struct lyd_node *pare
         }
     }
 
+    if (!lyp_data_projected(projection, schema)) {
+        /* not selected, skip the whole element */
+        if (in && !in->done) {
+            if (lyxml_parse_elem_skip(ctx, in->data, &len, xml, in->stag)) {
+                return -1;
+            }
+            in->data += len;
+            in->done = 1;
+        }
+        return 0;
+    }
+
+    if (in && (schema->nodetype & LYS_ANYDATA) && (options & LYD_OPT_ANYDATA_RAW) && !in->done) {
+        /* keep the content serialized, it is parsed only if requested */
+        raw = lyxml_parse_elem_raw(ctx, in->data, &len, xml, in->stag);
+        if (!raw) {
+            return -1;
+        }
+        in->data += len;
+        in->done = 1;
+    } else if (in && !(schema->nodetype & (LYS_CONTAINER | LYS_LIST | LYS_NOTIF | LYS_RPC | LYS_ACTION))) {
+        /* the element content is needed, read the whole element first */
+        if (xml_input_finish(ctx, xml, in)) {
+            return -1;
+        }
+        r = xml_check_mixed(ctx, xml, options);
+        if (r) {
+            return (r == 1) ? 0 : -1;
+        }
+    }
+
     /* create the element structure */
     switch (schema->nodetype) {
     case LYS_CONTAINER:
@@ -227,34 +410,29 @@ xml_parse_data(struct ly_ctx *ctx, struct lyxml_elem *xml, struct lyd_node *pare
     case LYS_NOTIF:
     case LYS_RPC:
     case LYS_ACTION:
-        for (i = 0; xml->content && xml->content[i]; ++i) {
-            if (!is_xmlws(xml->content[i])) {
-                msg = malloc(22 + strlen(xml->content) + 1);
-                LY_CHECK_ERR_RETURN(!msg, LOGMEM(ctx), -1);
-                sprintf(msg, "node with text data \"%s\"", xml->content);
-                LOGVAL(ctx, LYE_XML_INVAL, LY_VLOG_XML, xml, msg);
-                free(msg);
-                return -1;
-            }
+        if (xml_check_nocontent(ctx, xml)) {
+            return -1;
         }
-        *result = calloc(1, sizeof **result);
+        size = sizeof **result;
         havechildren = 1;
         break;
     case LYS_LEAF:
     case LYS_LEAFLIST:
-        *result = calloc(1, sizeof(struct lyd_node_leaf_list));
+        size = sizeof(struct lyd_node_leaf_list);
         havechildren = 0;
         break;
     case LYS_ANYXML:
     case LYS_ANYDATA:
-        *result = calloc(1, sizeof(struct lyd_node_anydata));
+        size = sizeof(struct lyd_node_anydata);
         havechildren = 0;
         break;
     default:
         LOGINT(ctx);
         return -1;
     }
-    LY_CHECK_ERR_RETURN(!(*result), LOGMEM(ctx), -1);
+    LY_CHECK_ERR_RETURN(ly_parse_charge(ctx, 1, size), free(raw), -1);
+    *result = lyd_node_alloc(ctx, size);
+    LY_CHECK_ERR_RETURN(!(*result), LOGMEM(ctx); free(raw), -1);
 
     (*result)->prev = *result;
     (*result)->schema = schema;
@@ -272,7 +450,7 @@ xml_parse_data(struct ly_ctx *ctx, struct lyxml_elem *xml, struct lyd_node *pare
                 LOGVAL(ctx, LYE_INORDER, LY_VLOG_LYD, *result, schema->name, diter->schema->name);
                 LOGVAL(ctx, LYE_SPEC, LY_VLOG_PREV, NULL, "Invalid position of the key \"%s\" in a list \"%s\".",
                        schema->name, parent->schema->name);
-                free(*result);
+                lyd_node_dealloc(*result);
                 *result = NULL;
                 return -1;
             } else {
@@ -453,12 +631,16 @@ attr_error:
     /* type specific processing */
     if (schema->nodetype & (LYS_LEAF | LYS_LEAFLIST)) {
         /* type detection and assigning the value */
-        if (xml_get_value(*result, xml, editbits, options & LYD_OPT_TRUSTED)) {
+        if (xml_get_value(*result, xml, editbits, LYP_TRUSTED(options))) {
             goto unlink_node_error;
         }
     } else if (schema->nodetype & LYS_ANYDATA) {
         /* store children values */
-        if (xml->child) {
+        if (raw) {
+            ((struct lyd_node_anydata *)*result)->value_type = LYD_ANYDATA_SXML;
+            ((struct lyd_node_anydata *)*result)->value.str = lydict_insert_zc(ctx, raw);
+            raw = NULL;
+        } else if (xml->child) {
             child = xml->child;
             /* manually unlink all siblings and correct namespaces */
             xml->child = NULL;
@@ -504,10 +686,57 @@ attr_error:
     }
 
     /* process children */
-    if (havechildren && xml->child) {
+    if (havechildren && in) {
+        /* read the children one by one, each subtree is freed once parsed */
+        diter = dlast = NULL;
+        child_read = 0;
+        while (1) {
+            r = xml_input_next(ctx, xml, in, &chin, &child);
+            if (r == -1) {
+                goto error;
+            } else if (xml_has_text(xml) && (!r || child_read)) {
+                /* text mixed with the child elements, the whole element is ignored as before */
+                if (!r) {
+                    /* read the next child again with the rest of the element */
+                    lyxml_free(ctx, child);
+                }
+                if (options & LYD_OPT_STRICT) {
+                    LOGVAL(ctx, LYE_XML_INVAL, LY_VLOG_XML, xml, "XML element with mixed content");
+                    goto error;
+                }
+                if (xml_input_finish(ctx, xml, in)) {
+                    goto error;
+                }
+                goto ignore;
+            } else if (xml_check_nocontent(ctx, xml)) {
+                goto error;
+            } else if (r == 1) {
+                break;
+            }
+            child_read = 1;
+
+            r = xml_parse_data(ctx, child, &chin, *result, (*result)->child, dlast, options, unres, &diter, act_notif,
+                               yang_data_name, projection);
+            if (!r) {
+                /* skip the rest of an ignored element */
+                r = xml_input_finish(ctx, child, &chin);
+            }
+            in->data = chin.data;
+            lyxml_free(ctx, child);
+            if (r) {
+                goto error;
+            }
+            if (diter && !diter->next) {
+                /* the child was parsed/created and it was placed as the last child. The child can be inserted
+                 * out of order (not as the last one) in case it is a list's key present out of the correct order */
+                dlast = diter;
+            }
+        }
+    } else if (havechildren && xml->child) {
         diter = dlast = NULL;
         LY_TREE_FOR_SAFE(xml->child, next, child) {
-            r = xml_parse_data(ctx, child, *result, (*result)->child, dlast, options, unres, &diter, act_notif, yang_data_name);
+            r = xml_parse_data(ctx, child, NULL, *result, (*result)->child, dlast, options, unres, &diter, act_notif,
+                               yang_data_name, projection);
             if (r) {
                 goto error;
             } else if (options & LYD_OPT_DESTRUCT) {
@@ -541,6 +770,22 @@ attr_error:
 
     return ret;
 
+ignore:
+    /* remove the whole subtree including its unresolved items */
+    for (i = unres->count - 1; i >= 0; i--) {
+        for (diter = unres->node[i]; diter && (diter != *result); diter = diter->parent);
+        if (diter) {
+            unres_data_del(unres, i);
+        }
+    }
+    for (diter = *act_notif; diter && (diter != *result); diter = diter->parent);
+    if (diter) {
+        *act_notif = NULL;
+    }
+    lyd_free(*result);
+    *result = NULL;
+    return 0;
+
 unlink_node_error:
     lyd_unlink_internal(*result, 2);
 error:
@@ -551,32 +796,99 @@ error:
             unres_data_del(unres, i);
         }
     }
+    free(raw);
     lyd_free(*result);
     *result = NULL;
     return -1;
 }
 
-API struct lyd_node *
-lyd_parse_xml(struct ly_ctx *ctx, struct lyxml_elem **root, int options, ...)
+/**
+ * @brief Finish parsing XML data once all the top-level elements were parsed. Logs directly.
+ *
+ * @param[in] ctx Context to use.
+ * @param[in,out] result Parsed data tree, may be changed.
+ * @param[in] options Parser options.
+ * @param[in] data_tree Data tree for RPC/action/notification external dependencies.
+ * @param[in] act_notif Parsed action/notification, if any.
+ * @param[in] unres Unresolved data items.
+ * @return EXIT_SUCCESS on success, EXIT_FAILURE on error.
+ */
+static int
+xml_parse_finish(struct ly_ctx *ctx, struct lyd_node **result, int options, const struct lyd_node *data_tree,
+                 struct lyd_node *act_notif, struct unres_data *unres)
 {
-    va_list ap;
-    int r;
-    struct unres_data *unres = NULL;
-    const struct lyd_node *rpc_act = NULL, *data_tree = NULL;
-    struct lyd_node *result = NULL, *iter, *last, *reply_parent = NULL, *reply_top = NULL, *act_notif = NULL;
-    struct lyxml_elem *xmlstart, *xmlelem, *xmlaux, *xmlfree = NULL;
-    const char *yang_data_name = NULL;
+    struct lyd_node *iter;
 
-    if (!ctx || !root) {
-        LOGARG;
-        return NULL;
+    /* add missing ietf-yang-library if requested */
+    if (options & LYD_OPT_DATA_ADD_YANGLIB) {
+        if (!*result) {
+            *result = ly_ctx_info(ctx);
+        } else if (lyd_merge(*result, ly_ctx_info(ctx), LYD_OPT_DESTRUCT | LYD_OPT_EXPLICIT)) {
+            LOGERR(ctx, LY_EINT, "Adding ietf-yang-library data failed.");
+            return EXIT_FAILURE;
+        }
     }
 
-    if (lyp_data_check_options(ctx, options, __func__)) {
-        return NULL;
+    /* check for uniqueness of top-level lists/leaflists because
+     * only the inner instances were tested in lyv_data_content() */
+    LY_TREE_FOR(*result, iter) {
+        if (!(iter->schema->nodetype & (LYS_LIST | LYS_LEAFLIST)) || !(iter->validity & LYD_VAL_DUP)) {
+            continue;
+        }
+
+        if (lyv_data_dup(iter, *result)) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    /* add default values, resolve unres and check for mandatory nodes in final tree */
+    if (lyd_defaults_add_unres(result, options, ctx, NULL, 0, data_tree, act_notif, unres, 1)) {
+        return EXIT_FAILURE;
+    }
+    if (!(options & (LYD_OPT_TRUSTED | LYD_OPT_NOTIF_FILTER))
+            && lyd_check_mandatory_tree((act_notif ? act_notif : *result), ctx, NULL, 0, options)) {
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Parse XML data either from an already parsed XML tree or directly from the input data.
+ * Logs directly.
+ *
+ * @param[in] ctx Context to use.
+ * @param[in,out] root XML tree to parse the data from, NULL if \p data are used.
+ * @param[in] data Input data to read the XML elements from, used if \p root is NULL.
+ * @param[in] options Parser options.
+ * @param[in] rpc_act RPC/action request for #LYD_OPT_RPCREPLY.
+ * @param[in] data_tree Data tree for RPC/action/notification external dependencies.
+ * @param[in] yang_data_name Name of the yang-data template for #LYD_OPT_DATA_TEMPLATE.
+ * @param[in] projection Schema nodes selected by #LYD_OPT_PROJECTION, NULL to parse all the data.
+ * @return Parsed data tree, NULL on error or empty tree.
+ */
+static struct lyd_node *
+xml_parse(struct ly_ctx *ctx, struct lyxml_elem **root, const char *data, int options, const struct lyd_node *rpc_act,
+          const struct lyd_node *data_tree, const char *yang_data_name, const struct ly_set *projection)
+{
+    int r, empty;
+    unsigned int len;
+    struct unres_data *unres = NULL;
+    struct lyd_node *result = NULL, *iter, *last, *reply_parent = NULL, *reply_top = NULL, *act_notif = NULL;
+    struct lyxml_elem *xmlstart, *xmlelem, *xmlaux, *xmlparent = NULL, *xmlfree = NULL;
+    struct xml_input top, wrap, in, *pin;
+
+    if (root) {
+        empty = !(*root);
+    } else {
+        r = lyxml_parse_misc(ctx, data, &len);
+        if (r == -1) {
+            return NULL;
+        }
+        empty = r;
     }
 
-    if (!(*root) && !(options & LYD_OPT_RPCREPLY)) {
+    if (empty && !(options & LYD_OPT_RPCREPLY)) {
         /* empty tree */
         if (options & (LYD_OPT_RPC | LYD_OPT_NOTIF)) {
             /* error, top level node identify RPC and Notification */
@@ -593,13 +905,7 @@ lyd_parse_xml(struct ly_ctx *ctx, struct lyxml_elem **root, int options, ...)
     unres = calloc(1, sizeof *unres);
     LY_CHECK_ERR_RETURN(!unres, LOGMEM(ctx), NULL);
 
-    va_start(ap, options);
     if (options & LYD_OPT_RPCREPLY) {
-        rpc_act = va_arg(ap, const struct lyd_node *);
-        if (!rpc_act || rpc_act->parent || !(rpc_act->schema->nodetype & (LYS_RPC | LYS_LIST | LYS_CONTAINER))) {
-            LOGERR(ctx, LY_EINVAL, "%s: invalid variable parameter (const struct lyd_node *rpc_act).", __func__);
-            goto error;
-        }
         if (rpc_act->schema->nodetype == LYS_RPC) {
             /* RPC request */
             reply_top = reply_parent = _lyd_new(NULL, rpc_act->schema, 0);
@@ -620,87 +926,108 @@ lyd_parse_xml(struct ly_ctx *ctx, struct lyxml_elem **root, int options, ...)
             lyd_free_withsiblings(reply_parent->child);
         }
     }
-    if (options & (LYD_OPT_RPC | LYD_OPT_NOTIF | LYD_OPT_RPCREPLY)) {
-        data_tree = va_arg(ap, const struct lyd_node *);
-        if (data_tree) {
-            if (options & LYD_OPT_NOEXTDEPS) {
-                LOGERR(ctx, LY_EINVAL, "%s: invalid parameter (variable arg const struct lyd_node *data_tree and LYD_OPT_NOEXTDEPS set).",
-                       __func__);
-                goto error;
+
+    iter = last = NULL;
+    if (!root) {
+        /* read the top-level elements directly from the input, one by one */
+        memset(&top, 0, sizeof top);
+        top.data = data;
+        pin = &top;
+        while (!(r = xml_input_next(ctx, xmlparent, pin, &in, &xmlelem))) {
+            if (!xmlparent && !xmlfree && !result && (options & LYD_OPT_RPC) && !strcmp(xmlelem->name, "action")
+                    && xmlelem->ns && !strcmp(xmlelem->ns->value, "urn:ietf:params:xml:ns:yang:1")) {
+                /* it's an action, not a simple RPC, read its children */
+                xmlfree = xmlparent = xmlelem;
+                wrap = in;
+                pin = &wrap;
+                continue;
             }
 
-            LY_TREE_FOR((struct lyd_node *)data_tree, iter) {
-                if (iter->parent) {
-                    /* a sibling is not top-level */
-                    LOGERR(ctx, LY_EINVAL, "%s: invalid variable parameter (const struct lyd_node *data_tree).", __func__);
-                    goto error;
+            r = xml_parse_data(ctx, xmlelem, &in, reply_parent, result, last, options, unres, &iter, &act_notif,
+                               yang_data_name, projection);
+            if (!r) {
+                /* skip the rest of an ignored element */
+                r = xml_input_finish(ctx, xmlelem, &in);
+            }
+            pin->data = in.data;
+            lyxml_free(ctx, xmlelem);
+            if (r) {
+                break;
+            }
+            if (iter) {
+                last = iter;
+                if ((options & LYD_OPT_DATA_ADD_YANGLIB) && iter->schema->module == ctx->models.list[ctx->internal_module_count - 1]) {
+                    /* ietf-yang-library data present, so ignore the option to add them */
+                    options &= ~LYD_OPT_DATA_ADD_YANGLIB;
                 }
             }
-
-            /* move it to the beginning */
-            for (; data_tree->prev->next; data_tree = data_tree->prev);
-
-            /* LYD_OPT_NOSIBLINGS cannot be set in this case */
-            if (options & LYD_OPT_NOSIBLINGS) {
-                LOGERR(ctx, LY_EINVAL, "%s: invalid parameter (variable arg const struct lyd_node *data_tree with LYD_OPT_NOSIBLINGS).", __func__);
-                goto error;
+            if (!result) {
+                result = iter;
             }
-        }
-    }
-    if (options & LYD_OPT_DATA_TEMPLATE) {
-        yang_data_name = va_arg(ap, const char *);
-    }
 
-    if ((*root) && !(options & LYD_OPT_NOSIBLINGS)) {
-        /* locate the first root to process */
-        if ((*root)->parent) {
-            xmlstart = (*root)->parent->child;
-        } else {
-            xmlstart = *root;
-            while(xmlstart->prev->next) {
-                xmlstart = xmlstart->prev;
+            if (options & LYD_OPT_NOSIBLINGS) {
+                /* stop after the first processed root */
+                break;
             }
         }
-    } else {
-        xmlstart = *root;
-    }
-
-    if ((options & LYD_OPT_RPC)
-            && !strcmp(xmlstart->name, "action") && !strcmp(xmlstart->ns->value, "urn:ietf:params:xml:ns:yang:1")) {
-        /* it's an action, not a simple RPC */
-        xmlstart = xmlstart->child;
-        if (options & LYD_OPT_DESTRUCT) {
-            /* free it later */
-            xmlfree = xmlstart->parent;
-        }
-    }
-
-    iter = last = NULL;
-    LY_TREE_FOR_SAFE(xmlstart, xmlaux, xmlelem) {
-        r = xml_parse_data(ctx, xmlelem, reply_parent, result, last, options, unres, &iter, &act_notif, yang_data_name);
-        if (r) {
+        if (r == -1) {
             if (reply_top) {
                 result = reply_top;
             }
             goto error;
-        } else if (options & LYD_OPT_DESTRUCT) {
-            lyxml_free(ctx, xmlelem);
-            *root = xmlaux;
         }
-        if (iter) {
-            last = iter;
-            if ((options & LYD_OPT_DATA_ADD_YANGLIB) && iter->schema->module == ctx->models.list[ctx->internal_module_count - 1]) {
-                /* ietf-yang-library data present, so ignore the option to add them */
-                options &= ~LYD_OPT_DATA_ADD_YANGLIB;
+    } else {
+        if ((*root) && !(options & LYD_OPT_NOSIBLINGS)) {
+            /* locate the first root to process */
+            if ((*root)->parent) {
+                xmlstart = (*root)->parent->child;
+            } else {
+                xmlstart = *root;
+                while(xmlstart->prev->next) {
+                    xmlstart = xmlstart->prev;
+                }
             }
+        } else {
+            xmlstart = *root;
         }
-        if (!result) {
-            result = iter;
+
+        if ((options & LYD_OPT_RPC)
+                && !strcmp(xmlstart->name, "action") && !strcmp(xmlstart->ns->value, "urn:ietf:params:xml:ns:yang:1")) {
+            /* it's an action, not a simple RPC */
+            xmlstart = xmlstart->child;
+            if (options & LYD_OPT_DESTRUCT) {
+                /* free it later */
+                xmlfree = xmlstart->parent;
+            }
         }
 
-        if (options & LYD_OPT_NOSIBLINGS) {
-            /* stop after the first processed root */
-            break;
+        LY_TREE_FOR_SAFE(xmlstart, xmlaux, xmlelem) {
+            r = xml_parse_data(ctx, xmlelem, NULL, reply_parent, result, last, options, unres, &iter, &act_notif,
+                               yang_data_name, projection);
+            if (r) {
+                if (reply_top) {
+                    result = reply_top;
+                }
+                goto error;
+            } else if (options & LYD_OPT_DESTRUCT) {
+                lyxml_free(ctx, xmlelem);
+                *root = xmlaux;
+            }
+            if (iter) {
+                last = iter;
+                if ((options & LYD_OPT_DATA_ADD_YANGLIB) && iter->schema->module == ctx->models.list[ctx->internal_module_count - 1]) {
+                    /* ietf-yang-library data present, so ignore the option to add them */
+                    options &= ~LYD_OPT_DATA_ADD_YANGLIB;
+                }
+            }
+            if (!result) {
+                result = iter;
+            }
+
+            if (options & LYD_OPT_NOSIBLINGS) {
+                /* stop after the first processed root */
+                break;
+            }
         }
     }
 
@@ -716,34 +1043,7 @@ lyd_parse_xml(struct ly_ctx *ctx, struct lyxml_elem **root, int options, ...)
         goto error;
     }
 
-    /* add missing ietf-yang-library if requested */
-    if (options & LYD_OPT_DATA_ADD_YANGLIB) {
-        if (!result) {
-            result = ly_ctx_info(ctx);
-        } else if (lyd_merge(result, ly_ctx_info(ctx), LYD_OPT_DESTRUCT | LYD_OPT_EXPLICIT)) {
-            LOGERR(ctx, LY_EINT, "Adding ietf-yang-library data failed.");
-            goto error;
-        }
-    }
-
-    /* check for uniqueness of top-level lists/leaflists because
-     * only the inner instances were tested in lyv_data_content() */
-    LY_TREE_FOR(result, iter) {
-        if (!(iter->schema->nodetype & (LYS_LIST | LYS_LEAFLIST)) || !(iter->validity & LYD_VAL_DUP)) {
-            continue;
-        }
-
-        if (lyv_data_dup(iter, result)) {
-            goto error;
-        }
-    }
-
-    /* add default values, resolve unres and check for mandatory nodes in final tree */
-    if (lyd_defaults_add_unres(&result, options, ctx, NULL, 0, data_tree, act_notif, unres, 1)) {
-        goto error;
-    }
-    if (!(options & (LYD_OPT_TRUSTED | LYD_OPT_NOTIF_FILTER))
-            && lyd_check_mandatory_tree((act_notif ? act_notif : result), ctx, NULL, 0, options)) {
+    if (xml_parse_finish(ctx, &result, options, data_tree, act_notif, unres)) {
         goto error;
     }
 
@@ -753,7 +1053,6 @@ lyd_parse_xml(struct ly_ctx *ctx, struct lyxml_elem **root, int options, ...)
     free(unres->node);
     free(unres->type);
     free(unres);
-    va_end(ap);
     return result;
 
 error:
@@ -764,6 +1063,259 @@ error:
     free(unres->node);
     free(unres->type);
     free(unres);
+    return NULL;
+}
+
+struct lyd_node *
+xml_read_data(struct ly_ctx *ctx, const char *data, int options, const struct lyd_node *rpc_act,
+              const struct lyd_node *data_tree, const char *yang_data_name, const struct ly_set *projection)
+{
+    return xml_parse(ctx, NULL, data, options, rpc_act, data_tree, yang_data_name, projection);
+}
+
+/**
+ * @brief Parse all the top-level elements in the buffered input of an incremental parser up to \p end. Logs directly.
+ *
+ * @param[in] parser Incremental parser.
+ * @param[in] end End of the input to parse, the input is terminated there for the time of parsing.
+ * @return EXIT_SUCCESS on success, EXIT_FAILURE on error.
+ */
+static int
+xml_parser_parse(struct lyd_parser *parser, size_t end)
+{
+    struct ly_ctx *ctx = parser->ctx;
+    struct lyd_node *iter = NULL, *act_notif = NULL;
+    struct lyxml_elem *xmlelem;
+    struct xml_input top, in;
+    char c;
+    int r;
+
+    c = parser->buf[end];
+    parser->buf[end] = '\0';
+
+    memset(&top, 0, sizeof top);
+    top.data = &parser->buf[parser->start];
+    while (!(r = xml_input_next(ctx, NULL, &top, &in, &xmlelem))) {
+        r = xml_parse_data(ctx, xmlelem, &in, NULL, parser->result, parser->last, parser->options, parser->unres,
+                           &iter, &act_notif, NULL, NULL);
+        if (!r) {
+            /* skip the rest of an ignored element */
+            r = xml_input_finish(ctx, xmlelem, &in);
+        }
+        top.data = in.data;
+        lyxml_free(ctx, xmlelem);
+        if (r) {
+            r = -1;
+            break;
+        }
+        ++parser->count;
+        if (iter) {
+            parser->last = iter;
+            if ((parser->options & LYD_OPT_DATA_ADD_YANGLIB)
+                    && iter->schema->module == ctx->models.list[ctx->internal_module_count - 1]) {
+                /* ietf-yang-library data present, so ignore the option to add them */
+                parser->options &= ~LYD_OPT_DATA_ADD_YANGLIB;
+            }
+        }
+        if (!parser->result) {
+            parser->result = iter;
+        }
+    }
+
+    parser->buf[end] = c;
+    if (r == -1) {
+        return EXIT_FAILURE;
+    }
+    parser->start = end;
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Find the end of the next markup in the buffered input of an incremental parser.
+ *
+ * @param[in] parser Incremental parser.
+ * @param[in] pos Position of '<' starting the markup.
+ * @param[out] empty Set if the markup is an empty element tag.
+ * @return Position after the markup, 0 if it is not complete yet.
+ */
+static size_t
+xml_parser_markup_end(struct lyd_parser *parser, size_t pos, int *empty)
+{
+    const char *data = &parser->buf[pos], *ptr;
+    size_t len = parser->used - pos;
+    char quot = 0;
+
+    *empty = 0;
+    if (len < 2) {
+        return 0;
+    }
+
+    if (data[1] == '?') {
+        ptr = strstr(data + 2, "?>");
+        return ptr ? (size_t)(ptr - parser->buf) + 2 : 0;
+    } else if (data[1] == '!') {
+        if (!strncmp(data, "<!--", len < 4 ? len : 4)) {
+            if (len < 4) {
+                return 0;
+            }
+            ptr = strstr(data + 4, "-->");
+            return ptr ? (size_t)(ptr - parser->buf) + 3 : 0;
+        } else if (!strncmp(data, "<![CDATA[", len < 9 ? len : 9)) {
+            if (len < 9) {
+                return 0;
+            }
+            ptr = strstr(data + 9, "]]>");
+            return ptr ? (size_t)(ptr - parser->buf) + 3 : 0;
+        }
+    }
+
+    /* tag, the attribute values may include '>' */
+    for (ptr = data + 1; *ptr; ++ptr) {
+        if (quot) {
+            if (*ptr == quot) {
+                quot = 0;
+            }
+        } else if ((*ptr == '"') || (*ptr == '\'')) {
+            quot = *ptr;
+        } else if (*ptr == '>') {
+            *empty = (ptr[-1] == '/');
+            return (size_t)(ptr - parser->buf) + 1;
+        }
+    }
+    return 0;
+}
+
+int
+xml_parser_push(struct lyd_parser *parser)
+{
+    const char *ptr;
+    size_t pos, end;
+    int empty;
+
+    pos = parser->scanned;
+    while ((ptr = memchr(&parser->buf[pos], '<', parser->used - pos))) {
+        pos = ptr - parser->buf;
+        end = xml_parser_markup_end(parser, pos, &empty);
+        if (!end) {
+            /* wait for the rest of the markup */
+            break;
+        }
+
+        if (ptr[1] == '/') {
+            --parser->depth;
+        } else if ((ptr[1] != '?') && (ptr[1] != '!') && !empty) {
+            ++parser->depth;
+        }
+        pos = end;
+
+        if ((parser->depth < 1) && (ptr[1] != '?') && (ptr[1] != '!')) {
+            /* a top-level element is complete (or the input is invalid), parse it */
+            parser->depth = 0;
+            if (xml_parser_parse(parser, end)) {
+                return EXIT_FAILURE;
+            }
+        }
+    }
+    if (!ptr) {
+        pos = parser->used;
+    }
+
+    parser->scanned = pos;
+    return EXIT_SUCCESS;
+}
+
+struct lyd_node *
+xml_parser_finish(struct lyd_parser *parser)
+{
+    struct lyd_node *result;
+
+    /* parse the rest of the input, which is either an incomplete element causing an error or ignored content */
+    if (xml_parser_parse(parser, parser->used)) {
+        return NULL;
+    }
+
+    result = parser->result;
+    parser->result = NULL;
+    if (!parser->count) {
+        /* empty tree, just check for missing mandatory nodes */
+        lyd_validate(&result, parser->options, parser->ctx);
+        return result;
+    }
+
+    if (xml_parse_finish(parser->ctx, &result, parser->options, NULL, NULL, parser->unres)) {
+        lyd_free_withsiblings(result);
+        return NULL;
+    }
+    return result;
+}
+
+API struct lyd_node *
+lyd_parse_xml(struct ly_ctx *ctx, struct lyxml_elem **root, int options, ...)
+{
+    va_list ap;
+    struct lyd_node *iter, *result;
+    const struct lyd_node *rpc_act = NULL, *data_tree = NULL;
+    const char *yang_data_name = NULL;
+    const struct ly_set *projection = NULL;
+
+    if (!ctx || !root) {
+        LOGARG;
+        return NULL;
+    }
+
+    if (lyp_data_check_options(ctx, options, __func__)) {
+        return NULL;
+    }
+
+    va_start(ap, options);
+    if (options & LYD_OPT_RPCREPLY) {
+        rpc_act = va_arg(ap, const struct lyd_node *);
+        if (!rpc_act || rpc_act->parent || !(rpc_act->schema->nodetype & (LYS_RPC | LYS_LIST | LYS_CONTAINER))) {
+            LOGERR(ctx, LY_EINVAL, "%s: invalid variable parameter (const struct lyd_node *rpc_act).", __func__);
+            goto error;
+        }
+    }
+    if (options & (LYD_OPT_RPC | LYD_OPT_NOTIF | LYD_OPT_RPCREPLY)) {
+        data_tree = va_arg(ap, const struct lyd_node *);
+        if (data_tree) {
+            if (options & LYD_OPT_NOEXTDEPS) {
+                LOGERR(ctx, LY_EINVAL, "%s: invalid parameter (variable arg const struct lyd_node *data_tree and LYD_OPT_NOEXTDEPS set).",
+                       __func__);
+                goto error;
+            }
+
+            LY_TREE_FOR((struct lyd_node *)data_tree, iter) {
+                if (iter->parent) {
+                    /* a sibling is not top-level */
+                    LOGERR(ctx, LY_EINVAL, "%s: invalid variable parameter (const struct lyd_node *data_tree).", __func__);
+                    goto error;
+                }
+            }
+
+            /* move it to the beginning */
+            for (; data_tree->prev->next; data_tree = data_tree->prev);
+
+            /* LYD_OPT_NOSIBLINGS cannot be set in this case */
+            if (options & LYD_OPT_NOSIBLINGS) {
+                LOGERR(ctx, LY_EINVAL, "%s: invalid parameter (variable arg const struct lyd_node *data_tree with LYD_OPT_NOSIBLINGS).", __func__);
+                goto error;
+            }
+        }
+    }
+    if (options & LYD_OPT_DATA_TEMPLATE) {
+        yang_data_name = va_arg(ap, const char *);
+    }
+    if (options & LYD_OPT_PROJECTION) {
+        projection = va_arg(ap, const struct ly_set *);
+    }
+    va_end(ap);
+
+    ly_parse_budget_start();
+    result = xml_parse(ctx, root, NULL, options, rpc_act, data_tree, yang_data_name, projection);
+    ly_parse_budget_stop();
+    return result;
+
+error:
     va_end(ap);
     return NULL;
 }
@@ -171,6 +171,12 @@ yang_read_description(struct lys_module *module, void *node, char *value, char *
     int ret;
     char *dsc = "description";
 
+    if (module->ctx->models.flags & LY_CTX_NO_DESCRIPTIONS) {
+        /* not stored */
+        free(value);
+        return EXIT_SUCCESS;
+    }
+
     switch (type) {
     case MODULE_KEYWORD:
         ret = yang_check_string(module, &module->dsc, dsc, "module", value, NULL);
@@ -200,6 +206,12 @@ yang_read_reference(struct lys_module *module, void *node, char *value, char *wh
     int ret;
     char *ref = "reference";
 
+    if (module->ctx->models.flags & LY_CTX_NO_DESCRIPTIONS) {
+        /* not stored */
+        free(value);
+        return EXIT_SUCCESS;
+    }
+
     switch (type) {
     case MODULE_KEYWORD:
         ret = yang_check_string(module, &module->ref, ref, "module", value, NULL);
@@ -4491,7 +4503,7 @@ error:
 }
 
 static int
-yang_check_deviation(struct lys_module *module, struct unres_schema *unres, struct lys_deviation *dev)
+yang_check_deviation_(struct lys_module *module, struct unres_schema *unres, struct lys_deviation *dev)
 {
     int rc;
     uint i;
@@ -4522,6 +4534,7 @@ yang_check_deviation(struct lys_module *module, struct unres_schema *unres, stru
         i = 0;
         goto free_type_error;
     }
+    dev->target = dev_target;
 
     if (!dflt_check) {
         LOGMEM(module->ctx);
@@ -4571,6 +4584,7 @@ yang_check_deviation(struct lys_module *module, struct unres_schema *unres, stru
             }
         }
         dev->orig_node = dev_target;
+        dev->target_parent = parent;
     } else {
         /* store a shallow copy of the original node */
         memset(&tmp_unres, 0, sizeof tmp_unres);
@@ -4658,6 +4672,19 @@ error:
     return EXIT_FAILURE;
 }
 
+static int
+yang_check_deviation(struct lys_module *module, struct unres_schema *unres, struct lys_deviation *dev)
+{
+    struct ly_stats_phase_prev phase;
+    int rc;
+
+    ly_stats_phase_enter(module->ctx, LY_STATS_PHASE_AUGDEV, &phase);
+    rc = yang_check_deviation_(module, unres, dev);
+    ly_stats_phase_leave(&phase);
+
+    return rc;
+}
+
 static int
 yang_check_sub_module(struct lys_module *module, struct unres_schema *unres, struct lys_node *node)
 {
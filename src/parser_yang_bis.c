@@ -3102,12 +3102,13 @@ yyreduce:
                       }
                       s = tmp;
                     } else {
-                      s = calloc(1, yyget_leng(scanner) - 1);
+                      s = malloc(yyget_leng(scanner) - 1);
                       if (!s) {
                         LOGMEM(trg->ctx);
                         YYABORT;
                       }
                       memcpy(s, yyget_text(scanner) + 1, yyget_leng(scanner) - 2);
+                      s[yyget_leng(scanner) - 2] = '\0';
                     }
                     (yyval.p_str) = &s;
                   }
@@ -3639,11 +3640,12 @@ yyreduce:
 
   case 74:
 
-    { s = strdup(yyget_text(scanner));
+    { s = malloc(yyget_leng(scanner) + 1);
                               if (!s) {
                                 LOGMEM(trg->ctx);
                                 YYABORT;
                               }
+                              memcpy(s, yyget_text(scanner), yyget_leng(scanner) + 1);
                               if (lyp_check_date(trg->ctx, s)) {
                                   free(s);
                                   YYABORT;
@@ -7879,11 +7881,12 @@ yyreduce:
 
   case 561:
 
-    { s = strdup(yyget_text(scanner));
+    { s = malloc(yyget_leng(scanner) + 1);
                                if (!s) {
                                  LOGMEM(trg->ctx);
                                  YYABORT;
                                }
+                               memcpy(s, yyget_text(scanner), yyget_leng(scanner) + 1);
                              }
 
     break;
@@ -7904,13 +7907,15 @@ yyreduce:
   case 565:
 
     { if (s) {
-                                                s = ly_realloc(s,strlen(s) + yyget_leng(scanner) + 2);
+                                                int length_s = strlen(s);
+
+                                                s = ly_realloc(s, length_s + yyget_leng(scanner) + 2);
                                                 if (!s) {
                                                   LOGMEM(trg->ctx);
                                                   YYABORT;
                                                 }
-                                                strcat(s,"/");
-                                                strcat(s, yyget_text(scanner));
+                                                s[length_s] = '/';
+                                                memcpy(s + length_s + 1, yyget_text(scanner), yyget_leng(scanner) + 1);
                                               } else {
                                                 s = malloc(yyget_leng(scanner) + 2);
                                                 if (!s) {
@@ -7927,18 +7932,21 @@ yyreduce:
   case 569:
 
     { if (s) {
-                                              s = ly_realloc(s,strlen(s) + yyget_leng(scanner) + 1);
+                                              int length_s = strlen(s);
+
+                                              s = ly_realloc(s, length_s + yyget_leng(scanner) + 1);
                                               if (!s) {
                                                 LOGMEM(trg->ctx);
                                                 YYABORT;
                                               }
-                                              strcat(s, yyget_text(scanner));
+                                              memcpy(s + length_s, yyget_text(scanner), yyget_leng(scanner) + 1);
                                             } else {
-                                              s = strdup(yyget_text(scanner));
+                                              s = malloc(yyget_leng(scanner) + 1);
                                               if (!s) {
                                                 LOGMEM(trg->ctx);
                                                 YYABORT;
                                               }
+                                              memcpy(s, yyget_text(scanner), yyget_leng(scanner) + 1);
                                             }
                                           }
 
@@ -8219,33 +8227,36 @@ yyreduce:
 
   case 656:
 
-    { s = strdup(yyget_text(scanner));
+    { s = malloc(yyget_leng(scanner) + 1);
                   if (!s) {
                     LOGMEM(trg->ctx);
                     YYABORT;
                   }
+                  memcpy(s, yyget_text(scanner), yyget_leng(scanner) + 1);
                 }
 
     break;
 
   case 749:
 
-    { s = strdup(yyget_text(scanner));
+    { s = malloc(yyget_leng(scanner) + 1);
                           if (!s) {
                             LOGMEM(trg->ctx);
                             YYABORT;
                           }
+                          memcpy(s, yyget_text(scanner), yyget_leng(scanner) + 1);
                         }
 
     break;
 
   case 750:
 
-    { s = strdup(yyget_text(scanner));
+    { s = malloc(yyget_leng(scanner) + 1);
                                     if (!s) {
                                       LOGMEM(trg->ctx);
                                       YYABORT;
                                     }
+                                    memcpy(s, yyget_text(scanner), yyget_leng(scanner) + 1);
                                   }
 
     break;
@@ -133,6 +133,24 @@ read_yin_subnode(struct ly_ctx *ctx, struct lyxml_elem *node, const char *name)
     }
 }
 
+/* logs directly, the text is not stored with #LY_CTX_NO_DESCRIPTIONS */
+static int
+read_yin_dscref(struct ly_ctx *ctx, struct lyxml_elem *node, const char **text)
+{
+    if (ctx->models.flags & LY_CTX_NO_DESCRIPTIONS) {
+        /* still check the statement */
+        if (!node->child || !node->child->name || strcmp(node->child->name, "text")) {
+            LOGERR(ctx, LY_EVALID, "Expected \"text\" element in \"%s\" element.", node->name);
+            LOGVAL(ctx, LYE_INARG, LY_VLOG_NONE, NULL, "text", node->name);
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+
+    *text = read_yin_subnode(ctx, node, "text");
+    return *text ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
 int
 lyp_yin_parse_subnode_ext(struct lys_module *mod, void *elem, LYEXT_PAR elem_type,
                      struct lyxml_elem *yin, LYEXT_SUBSTMT type, uint8_t i, struct unres_schema *unres)
@@ -464,8 +482,7 @@ read_restr_substmt(struct lys_module *module, struct lys_restr *restr, struct ly
             if (lyp_yin_parse_subnode_ext(module, restr, LYEXT_PAR_RESTR, child, LYEXT_SUBSTMT_DESCRIPTION, 0, unres)) {
                 return EXIT_FAILURE;
             }
-            restr->dsc = read_yin_subnode(ctx, child, "text");
-            if (!restr->dsc) {
+            if (read_yin_dscref(ctx, child, &restr->dsc)) {
                 return EXIT_FAILURE;
             }
         } else if (!strcmp(child->name, "reference")) {
@@ -476,8 +493,7 @@ read_restr_substmt(struct lys_module *module, struct lys_restr *restr, struct ly
             if (lyp_yin_parse_subnode_ext(module, restr, LYEXT_PAR_RESTR, child, LYEXT_SUBSTMT_REFERENCE, 0, unres)) {
                 return EXIT_FAILURE;
             }
-            restr->ref = read_yin_subnode(ctx, child, "text");
-            if (!restr->ref) {
+            if (read_yin_dscref(ctx, child, &restr->ref)) {
                 return EXIT_FAILURE;
             }
         } else if (!strcmp(child->name, "error-app-tag")) {
@@ -1421,8 +1437,8 @@ fill_yin_type(struct lys_module *module, struct lys_node *parent, struct lyxml_e
             type->info.str.patterns = calloc(i, sizeof *type->info.str.patterns);
             LY_CHECK_ERR_GOTO(!type->info.str.patterns, LOGMEM(ctx), error);
 #ifdef LY_ENABLED_CACHE
-            if (!in_grp) {
-                /* do not compile patterns in groupings */
+            if (!in_grp && !(ctx->models.flags & LY_CTX_TRUSTED)) {
+                /* do not compile patterns in groupings, trusted patterns are compiled on their first use */
                 type->info.str.patterns_pcre = calloc(2 * i, sizeof *type->info.str.patterns_pcre);
                 LY_CHECK_ERR_GOTO(!type->info.str.patterns_pcre, LOGMEM(ctx), error);
             }
@@ -1437,7 +1453,7 @@ fill_yin_type(struct lys_module *module, struct lys_node *parent, struct lyxml_e
                     }
                 }
 #ifdef LY_ENABLED_CACHE
-                else {
+                else if (type->info.str.patterns_pcre) {
                     /* outside grouping, check syntax and precompile pattern for later use by libpcre */
                     if (lyp_precompile_pattern(ctx, value,
                             (pcre **)&type->info.str.patterns_pcre[type->info.str.pat_count * 2],
@@ -1956,8 +1972,7 @@ fill_yin_revision(struct lys_module *module, struct lyxml_elem *yin, struct lys_
                                           child, LYEXT_SUBSTMT_DESCRIPTION, 0, unres)) {
                 goto error;
             }
-            rev->dsc = read_yin_subnode(ctx, child, "text");
-            if (!rev->dsc) {
+            if (read_yin_dscref(ctx, child, &rev->dsc)) {
                 goto error;
             }
         } else if (!strcmp(child->name, "reference")) {
@@ -1969,8 +1984,7 @@ fill_yin_revision(struct lys_module *module, struct lyxml_elem *yin, struct lys_
                                           child, LYEXT_SUBSTMT_REFERENCE, 0, unres)) {
                 goto error;
             }
-            rev->ref = read_yin_subnode(ctx, child, "text");
-            if (!rev->ref) {
+            if (read_yin_dscref(ctx, child, &rev->ref)) {
                 goto error;
             }
         } else {
@@ -2162,8 +2176,8 @@ error:
 
 /* logs directly */
 static int
-fill_yin_deviation(struct lys_module *module, struct lyxml_elem *yin, struct lys_deviation *dev,
-                   struct unres_schema *unres)
+fill_yin_deviation_(struct lys_module *module, struct lyxml_elem *yin, struct lys_deviation *dev,
+                    struct unres_schema *unres)
 {
     const char *value, **stritem;
     struct lyxml_elem *next, *next2, *child, *develem;
@@ -2209,6 +2223,7 @@ fill_yin_deviation(struct lys_module *module, struct lyxml_elem *yin, struct lys
         LOGVAL(ctx, LYE_SPEC, LY_VLOG_NONE, NULL, "Deviating own module is not allowed.");
         goto error;
     }
+    dev->target = dev_target;
 
     LY_TREE_FOR_SAFE(yin->child, next, child) {
         if (!child->ns ) {
@@ -2228,8 +2243,7 @@ fill_yin_deviation(struct lys_module *module, struct lyxml_elem *yin, struct lys
             if (lyp_yin_parse_subnode_ext(module, dev, LYEXT_PAR_DEVIATION, child, LYEXT_SUBSTMT_DESCRIPTION, 0, unres)) {
                 goto error;
             }
-            dev->dsc = read_yin_subnode(ctx, child, "text");
-            if (!dev->dsc) {
+            if (read_yin_dscref(ctx, child, &dev->dsc)) {
                 goto error;
             }
         } else if (!strcmp(child->name, "reference")) {
@@ -2240,8 +2254,7 @@ fill_yin_deviation(struct lys_module *module, struct lyxml_elem *yin, struct lys
             if (lyp_yin_parse_subnode_ext(module, dev, LYEXT_PAR_DEVIATION, child, LYEXT_SUBSTMT_REFERENCE, 0, unres)) {
                 goto error;
             }
-            dev->ref = read_yin_subnode(ctx, child, "text");
-            if (!dev->ref) {
+            if (read_yin_dscref(ctx, child, &dev->ref)) {
                 goto error;
             }
         } else if (!strcmp(child->name, "deviate")) {
@@ -2352,6 +2365,7 @@ fill_yin_deviation(struct lys_module *module, struct lyxml_elem *yin, struct lys
                 }
             }
             dev->orig_node = dev_target;
+            dev->target_parent = parent;
 
         } else if (!strcmp(value, "add")) {
             dev->deviate[dev->deviate_size].mod = LY_DEVIATE_ADD;
@@ -3146,6 +3160,20 @@ error:
     return EXIT_FAILURE;
 }
 
+static int
+fill_yin_deviation(struct lys_module *module, struct lyxml_elem *yin, struct lys_deviation *dev,
+                   struct unres_schema *unres)
+{
+    struct ly_stats_phase_prev phase;
+    int rc;
+
+    ly_stats_phase_enter(module->ctx, LY_STATS_PHASE_AUGDEV, &phase);
+    rc = fill_yin_deviation_(module, yin, dev, unres);
+    ly_stats_phase_leave(&phase);
+
+    return rc;
+}
+
 /* logs directly */
 static int
 fill_yin_augment(struct lys_module *module, struct lys_node *parent, struct lyxml_elem *yin, struct lys_node_augment *aug,
@@ -3336,8 +3364,7 @@ fill_yin_refine(struct lys_node *uses, struct lyxml_elem *yin, struct lys_refine
                 goto error;
             }
 
-            rfn->dsc = read_yin_subnode(ctx, sub, "text");
-            if (!rfn->dsc) {
+            if (read_yin_dscref(ctx, sub, &rfn->dsc)) {
                 goto error;
             }
         } else if (!strcmp(sub->name, "reference")) {
@@ -3350,8 +3377,7 @@ fill_yin_refine(struct lys_node *uses, struct lyxml_elem *yin, struct lys_refine
                 goto error;
             }
 
-            rfn->ref = read_yin_subnode(ctx, sub, "text");
-            if (!rfn->ref) {
+            if (read_yin_dscref(ctx, sub, &rfn->ref)) {
                 goto error;
             }
         } else if (!strcmp(sub->name, "config")) {
@@ -3717,8 +3743,7 @@ fill_yin_import(struct lys_module *module, struct lyxml_elem *yin, struct lys_im
             if (lyp_yin_parse_subnode_ext(module, imp, LYEXT_PAR_IMPORT, child, LYEXT_SUBSTMT_DESCRIPTION, 0, unres)) {
                 goto error;
             }
-            imp->dsc = read_yin_subnode(ctx, child, "text");
-            if (!imp->dsc) {
+            if (read_yin_dscref(ctx, child, &imp->dsc)) {
                 goto error;
             }
         } else if ((module->version >= 2) && !strcmp(child->name, "reference")) {
@@ -3729,8 +3754,7 @@ fill_yin_import(struct lys_module *module, struct lyxml_elem *yin, struct lys_im
             if (lyp_yin_parse_subnode_ext(module, imp, LYEXT_PAR_IMPORT, child, LYEXT_SUBSTMT_REFERENCE, 0, unres)) {
                 goto error;
             }
-            imp->ref = read_yin_subnode(ctx, child, "text");
-            if (!imp->ref) {
+            if (read_yin_dscref(ctx, child, &imp->ref)) {
                 goto error;
             }
         } else {
@@ -3825,8 +3849,7 @@ fill_yin_include(struct lys_module *module, struct lys_submodule *submodule, str
             if (lyp_yin_parse_subnode_ext(module, inc, LYEXT_PAR_INCLUDE, child, LYEXT_SUBSTMT_DESCRIPTION, 0, unres)) {
                 goto error;
             }
-            inc->dsc = read_yin_subnode(ctx, child, "text");
-            if (!inc->dsc) {
+            if (read_yin_dscref(ctx, child, &inc->dsc)) {
                 goto error;
             }
         } else if ((module->version >= 2) && !strcmp(child->name, "reference")) {
@@ -3837,8 +3860,7 @@ fill_yin_include(struct lys_module *module, struct lys_submodule *submodule, str
             if (lyp_yin_parse_subnode_ext(module, inc, LYEXT_PAR_INCLUDE, child, LYEXT_SUBSTMT_REFERENCE, 0, unres)) {
                 goto error;
             }
-            inc->ref = read_yin_subnode(ctx, child, "text");
-            if (!inc->ref) {
+            if (read_yin_dscref(ctx, child, &inc->ref)) {
                 goto error;
             }
         } else {
@@ -3924,8 +3946,7 @@ read_yin_common(struct lys_module *module, struct lys_node *parent, void *stmt,
                 goto error;
             }
 
-            node->dsc = read_yin_subnode(ctx, sub, "text");
-            if (!node->dsc) {
+            if (read_yin_dscref(ctx, sub, &node->dsc)) {
                 goto error;
             }
         } else if (!strcmp(sub->name, "reference")) {
@@ -3938,8 +3959,7 @@ read_yin_common(struct lys_module *module, struct lys_node *parent, void *stmt,
                 goto error;
             }
 
-            node->ref = read_yin_subnode(ctx, sub, "text");
-            if (!node->ref) {
+            if (read_yin_dscref(ctx, sub, &node->ref)) {
                 goto error;
             }
         } else if (!strcmp(sub->name, "status")) {
@@ -4078,8 +4098,7 @@ read_yin_when(struct lys_module *module, struct lyxml_elem *yin, struct unres_sc
                 goto error;
             }
 
-            retval->dsc = read_yin_subnode(ctx, child, "text");
-            if (!retval->dsc) {
+            if (read_yin_dscref(ctx, child, &retval->dsc)) {
                 goto error;
             }
         } else if (!strcmp(child->name, "reference")) {
@@ -4092,8 +4111,7 @@ read_yin_when(struct lys_module *module, struct lyxml_elem *yin, struct unres_sc
                 goto error;
             }
 
-            retval->ref = read_yin_subnode(ctx, child, "text");
-            if (!retval->ref) {
+            if (read_yin_dscref(ctx, child, &retval->ref)) {
                 goto error;
             }
         } else {
@@ -6557,13 +6575,172 @@ error:
     return NULL;
 }
 
+/**
+ * @brief Body statement of a (sub)module with only its start tag read, its content is read just before
+ * the statement is processed so the XML subtrees of all the body statements are never in memory at once.
+ */
+struct yin_lazy_elem {
+    struct lyxml_elem *elem;         /**< element with only the start tag parsed */
+    const char *stag;                /**< start tag of the element in the input */
+    const char *data;                /**< input following the start tag */
+};
+
+static int
+yin_lazy_equal(void *val1_p, void *val2_p, int UNUSED(mod), void *UNUSED(cb_data))
+{
+    return ((struct yin_lazy_elem *)val1_p)->elem == ((struct yin_lazy_elem *)val2_p)->elem;
+}
+
+static uint32_t
+yin_lazy_hash(const struct lyxml_elem *elem)
+{
+    return dict_hash_multi(dict_hash_multi(0, (const char *)&elem, sizeof elem), NULL, 0);
+}
+
+/* the statements moved aside by read_sub_module() and processed after all the other statements */
+static int
+yin_is_lazy_stmt(const struct lyxml_elem *elem)
+{
+    static const char *stmts[] = {"container", "leaf-list", "leaf", "list", "choice", "uses", "anyxml", "anydata",
+                                  "rpc", "notification", "grouping", "augment"};
+    unsigned int i;
+
+    if (!elem->ns || strcmp(elem->ns->value, LY_NSYIN)) {
+        return 0;
+    }
+    for (i = 0; i < sizeof stmts / sizeof *stmts; ++i) {
+        if (!strcmp(elem->name, stmts[i])) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Parse a YIN document reading only the start tags of the body statements of the (sub)module,
+ * their content is skipped and stored in \p lazy to be read by yin_read_lazy(). Logs directly.
+ *
+ * @param[in] ctx Context to use.
+ * @param[in] data YIN document, must not be changed until all the lazy elements are read.
+ * @param[out] lazy Created table of the lazy elements.
+ * @return (Sub)module element, NULL on error or empty document.
+ */
+static struct lyxml_elem *
+yin_parse_lazy(struct ly_ctx *ctx, const char *data, struct hash_table **lazy)
+{
+    struct lyxml_elem *yin, *child;
+    struct yin_lazy_elem item;
+    const char *c = data, *stag;
+    unsigned int len;
+    int r;
+
+    *lazy = NULL;
+    if (lyxml_parse_misc(ctx, c, &len)) {
+        /* empty document or an error */
+        return NULL;
+    }
+    stag = c + len;
+    yin = lyxml_parse_elem_start(ctx, stag, &len, NULL);
+    if (!yin) {
+        return NULL;
+    }
+    c = stag + len;
+
+    *lazy = lyht_new(8, sizeof item, yin_lazy_equal, NULL, 1);
+    LY_CHECK_ERR_GOTO(!*lazy, LOGMEM(ctx), error);
+
+    /* EmptyElemTag has the content already set */
+    if (!yin->content) {
+        while (!(r = lyxml_parse_elem_next(ctx, c, &len, yin, stag, LYXML_PARSE_NOMIXEDCONTENT))) {
+            c += len;
+            item.stag = c;
+            child = lyxml_parse_elem_start(ctx, item.stag, &len, yin);
+            if (!child) {
+                goto error;
+            }
+            c += len;
+
+            if (!child->content && yin_is_lazy_stmt(child)) {
+                item.elem = child;
+                item.data = c;
+                r = lyxml_parse_elem_skip(ctx, c, &len, child, item.stag);
+                if (!r && lyht_insert(*lazy, &item, yin_lazy_hash(child), NULL)) {
+                    LOGINT(ctx);
+                    goto error;
+                }
+            } else if (!child->content) {
+                r = lyxml_parse_elem_finish(ctx, c, &len, child, item.stag, LYXML_PARSE_NOMIXEDCONTENT);
+            } else {
+                r = 0;
+                len = 0;
+            }
+            if (r) {
+                goto error;
+            }
+            c += len;
+        }
+        if (r == -1) {
+            goto error;
+        }
+        /* the end tag */
+        c += len;
+    }
+
+    /* the same as lyxml_parse_mem(), the rest of the document is not checked */
+    for (; is_xmlws(*c); ++c);
+    if (*c) {
+        LOGWRN(ctx, "There are some not parsed data:\n%s", c);
+    }
+
+    return yin;
+
+error:
+    lyht_free(*lazy);
+    *lazy = NULL;
+    lyxml_free(ctx, yin);
+    return NULL;
+}
+
+/**
+ * @brief Read the content of a body statement skipped by yin_parse_lazy(), if it was. Logs directly.
+ *
+ * @param[in] ctx Context to use.
+ * @param[in] lazy Table of the lazy elements, NULL if the whole document was parsed.
+ * @param[in] yin (Sub)module element, \p elem is no longer its child.
+ * @param[in] elem Body statement element to read.
+ * @return EXIT_SUCCESS or EXIT_FAILURE.
+ */
+static int
+yin_read_lazy(struct ly_ctx *ctx, struct hash_table *lazy, struct lyxml_elem *yin, struct lyxml_elem *elem)
+{
+    struct yin_lazy_elem item, *found;
+    struct lyxml_elem *parent;
+    unsigned int len;
+    int r;
+
+    item.elem = elem;
+    if (!lazy || lyht_find(lazy, &item, yin_lazy_hash(elem), (void **)&found)) {
+        return EXIT_SUCCESS;
+    }
+    item = *found;
+    lyht_remove(lazy, &item, yin_lazy_hash(elem));
+
+    /* the namespaces declared in the (sub)module element must be in scope */
+    parent = elem->parent;
+    elem->parent = yin;
+    r = lyxml_parse_elem_finish(ctx, item.data, &len, elem, item.stag, LYXML_PARSE_NOMIXEDCONTENT);
+    elem->parent = parent;
+
+    return r ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
 /* logs directly
  *
  * common code for yin_read_module() and yin_read_submodule()
  */
 static int
 read_sub_module(struct lys_module *module, struct lys_submodule *submodule, struct lyxml_elem *yin,
-                struct unres_schema *unres)
+                struct hash_table *lazy, struct unres_schema *unres)
 {
     struct ly_ctx *ctx = module->ctx;
     struct lyxml_elem *next, *child, root, grps, augs, revs, exts;
@@ -6828,11 +7005,11 @@ read_sub_module(struct lys_module *module, struct lys_submodule *submodule, stru
             if (lyp_yin_parse_subnode_ext(trg, trg, LYEXT_PAR_MODULE, child, LYEXT_SUBSTMT_DESCRIPTION, 0, unres)) {
                 goto error;
             }
-            trg->dsc = read_yin_subnode(ctx, child, "text");
-            lyxml_free(ctx, child);
-            if (!trg->dsc) {
+            if (read_yin_dscref(ctx, child, &trg->dsc)) {
+                lyxml_free(ctx, child);
                 goto error;
             }
+            lyxml_free(ctx, child);
 
             substmt_prev = "description";
         } else if (!strcmp(child->name, "reference")) {
@@ -6851,11 +7028,11 @@ read_sub_module(struct lys_module *module, struct lys_submodule *submodule, stru
             if (lyp_yin_parse_subnode_ext(trg, trg, LYEXT_PAR_MODULE, child, LYEXT_SUBSTMT_REFERENCE, 0, unres)) {
                 goto error;
             }
-            trg->ref = read_yin_subnode(ctx, child, "text");
-            lyxml_free(ctx, child);
-            if (!trg->ref) {
+            if (read_yin_dscref(ctx, child, &trg->ref)) {
+                lyxml_free(ctx, child);
                 goto error;
             }
+            lyxml_free(ctx, child);
 
             substmt_prev = "reference";
         } else if (!strcmp(child->name, "organization")) {
@@ -7152,6 +7329,9 @@ read_sub_module(struct lys_module *module, struct lys_submodule *submodule, stru
      * main module data tree.
      */
     LY_TREE_FOR_SAFE(grps.child, next, child) {
+        if (yin_read_lazy(ctx, lazy, yin, child)) {
+            goto error;
+        }
         node = read_yin_grouping(trg, NULL, child, 0, unres);
         if (!node) {
             goto error;
@@ -7162,6 +7342,9 @@ read_sub_module(struct lys_module *module, struct lys_submodule *submodule, stru
 
     /* parse data nodes, ... */
     LY_TREE_FOR_SAFE(root.child, next, child) {
+        if (yin_read_lazy(ctx, lazy, yin, child)) {
+            goto error;
+        }
 
         if (!strcmp(child->name, "container")) {
             node = read_yin_container(trg, NULL, child, 0, unres);
@@ -7193,6 +7376,9 @@ read_sub_module(struct lys_module *module, struct lys_submodule *submodule, stru
 
     /* ... and finally augments (last, so we can augment our data, for instance) */
     LY_TREE_FOR_SAFE(augs.child, next, child) {
+        if (yin_read_lazy(ctx, lazy, yin, child)) {
+            goto error;
+        }
         r = fill_yin_augment(trg, NULL, child, &trg->augment[trg->augment_size], 0, unres);
         trg->augment_size++;
 
@@ -7230,10 +7416,11 @@ yin_read_submodule(struct lys_module *module, const char *data, struct unres_sch
 {
     struct ly_ctx *ctx = module->ctx;
     struct lyxml_elem *yin;
+    struct hash_table *lazy;
     struct lys_submodule *submodule = NULL;
     const char *value;
 
-    yin = lyxml_parse_mem(ctx, data, LYXML_PARSE_NOMIXEDCONTENT);
+    yin = yin_parse_lazy(ctx, data, &lazy);
     if (!yin) {
         return NULL;
     }
@@ -7265,13 +7452,14 @@ yin_read_submodule(struct lys_module *module, const char *data, struct unres_sch
 
     LOGVRB("Reading submodule \"%s\".", submodule->name);
     /* module cannot be changed in this case and 1 cannot be returned */
-    if (read_sub_module(module, submodule, yin, unres)) {
+    if (read_sub_module(module, submodule, yin, lazy, unres)) {
         goto error;
     }
 
     lyp_sort_revisions((struct lys_module *)submodule);
 
     /* cleanup */
+    lyht_free(lazy);
     lyxml_free(ctx, yin);
     lyp_check_circmod_pop(ctx);
 
@@ -7280,6 +7468,7 @@ yin_read_submodule(struct lys_module *module, const char *data, struct unres_sch
 
 error:
     /* cleanup */
+    lyht_free(lazy);
     lyxml_free(ctx, yin);
     if (!submodule) {
         LOGERR(ctx, ly_errno, "Submodule parsing failed.");
@@ -7297,8 +7486,9 @@ error:
 }
 
 /* logs directly */
-struct lys_module *
-yin_read_module_(struct ly_ctx *ctx, struct lyxml_elem *yin, const char *revision, int implement)
+static struct lys_module *
+yin_read_module_lazy(struct ly_ctx *ctx, struct lyxml_elem *yin, struct hash_table *lazy, const char *revision,
+                     int implement)
 {
     struct lys_module *module = NULL;
     struct unres_schema *unres;
@@ -7337,7 +7527,7 @@ yin_read_module_(struct ly_ctx *ctx, struct lyxml_elem *yin, const char *revisio
     }
 
     LOGVRB("Reading module \"%s\".", module->name);
-    ret = read_sub_module(module, NULL, yin, unres);
+    ret = read_sub_module(module, NULL, yin, lazy, unres);
     if (ret == -1) {
         goto error;
     }
@@ -7419,21 +7609,31 @@ error:
     return NULL;
 }
 
+/* logs directly */
+struct lys_module *
+yin_read_module_(struct ly_ctx *ctx, struct lyxml_elem *yin, const char *revision, int implement)
+{
+    return yin_read_module_lazy(ctx, yin, NULL, revision, implement);
+}
+
 /* logs directly */
 struct lys_module *
 yin_read_module(struct ly_ctx *ctx, const char *data, const char *revision, int implement)
 {
     struct lyxml_elem *yin;
+    struct hash_table *lazy;
     struct lys_module *result;
 
-    yin = lyxml_parse_mem(ctx, data, LYXML_PARSE_NOMIXEDCONTENT);
+    /* the body statements are read one by one while processed */
+    yin = yin_parse_lazy(ctx, data, &lazy);
     if (!yin) {
         LOGERR(ctx, ly_errno, "Module parsing failed.");
         return NULL;
     }
 
-    result = yin_read_module_(ctx, yin, revision, implement);
+    result = yin_read_module_lazy(ctx, yin, lazy, revision, implement);
 
+    lyht_free(lazy);
     lyxml_free(ctx, yin);
 
     return result;
@@ -25,6 +25,7 @@
 #include <sys/types.h>
 
 #include "common.h"
+#include "context.h"
 #include "extensions.h"
 #include "user_types.h"
 #include "plugin_config.h"
@@ -38,7 +39,14 @@ static uint16_t ext_plugins_count = 0; /* size of the ext_plugins array */
 static struct lytype_plugin_list *type_plugins = NULL;
 static uint16_t type_plugins_count = 0;
 
-static struct ly_set dlhandlers = {0, 0, {NULL}};
+/* (module, name) indexes of the plugin lists, rebuilt whenever the lists change */
+static struct hash_table *ext_plugins_ht = NULL;
+static struct hash_table *type_plugins_ht = NULL;
+
+/* generation of the type plugin list, the plugins cached in the typedefs are valid only for the current one */
+static uint16_t type_plugins_gen = 0;
+
+static struct ly_set dlhandlers = {0};
 static pthread_mutex_t plugins_lock = PTHREAD_MUTEX_INITIALIZER;
 
 static char **loaded_plugins = NULL; /* both ext and type plugin names */
@@ -49,6 +57,99 @@ static uint16_t loaded_plugins_count = 0;
  */
 static uint32_t plugin_refs;
 
+static uint32_t
+ly_plugin_hash(const char *module, const char *name)
+{
+    uint32_t hash;
+
+    hash = dict_hash_multi(0, module, strlen(module));
+    hash = dict_hash_multi(hash, name, strlen(name));
+    return dict_hash_multi(hash, NULL, 0);
+}
+
+static int
+lyext_plugin_val_equal(void *val1_p, void *val2_p, int mod, void *UNUSED(cb_data))
+{
+    struct lyext_plugin_list *key = *(struct lyext_plugin_list **)val1_p;
+    struct lyext_plugin_list *p = *(struct lyext_plugin_list **)val2_p;
+
+    if (mod) {
+        return key == p;
+    }
+
+    /* a plugin with no revision implements the extension of any revision */
+    return !strcmp(key->name, p->name) && !strcmp(key->module, p->module)
+            && (!p->revision || (key->revision && !strcmp(key->revision, p->revision)));
+}
+
+static int
+lytype_plugin_val_equal(void *val1_p, void *val2_p, int mod, void *UNUSED(cb_data))
+{
+    struct lytype_plugin_list *key = *(struct lytype_plugin_list **)val1_p;
+    struct lytype_plugin_list *p = *(struct lytype_plugin_list **)val2_p;
+
+    if (mod) {
+        return key == p;
+    }
+
+    return !strcmp(key->name, p->name) && !strcmp(key->module, p->module)
+            && ((!key->revision && !p->revision) || (key->revision && p->revision && !strcmp(key->revision, p->revision)));
+}
+
+/**
+ * @brief Rebuild the indexes of the plugin lists, must be called with the plugins lock held
+ * whenever the lists change, the indexes point into them. If it fails, the lists are searched linearly.
+ *
+ * The lookups do not take the lock, the new indexes are built first and only then they replace the previous
+ * ones, so the lists must not change while other threads use a context (see ly_register_exts()).
+ */
+static void
+ly_plugins_index(void)
+{
+    struct hash_table *ext_ht = NULL, *type_ht = NULL, *old_ext_ht, *old_type_ht;
+    struct lyext_plugin_list *ep;
+    struct lytype_plugin_list *tp;
+    uint16_t u;
+
+    if (ext_plugins_count) {
+        ext_ht = lyht_new(8, sizeof ep, lyext_plugin_val_equal, NULL, 1);
+        LY_CHECK_GOTO(!ext_ht || lyht_reserve(ext_ht, ext_plugins_count), error);
+        for (u = 0; u < ext_plugins_count; ++u) {
+            ep = &ext_plugins[u];
+            LY_CHECK_GOTO(lyht_insert(ext_ht, &ep, ly_plugin_hash(ep->module, ep->name), NULL) == -1, error);
+        }
+    }
+
+    if (type_plugins_count) {
+        type_ht = lyht_new(8, sizeof tp, lytype_plugin_val_equal, NULL, 1);
+        LY_CHECK_GOTO(!type_ht || lyht_reserve(type_ht, type_plugins_count), error);
+        for (u = 0; u < type_plugins_count; ++u) {
+            tp = &type_plugins[u];
+            LY_CHECK_GOTO(lyht_insert(type_ht, &tp, ly_plugin_hash(tp->module, tp->name), NULL) == -1, error);
+        }
+    }
+    goto publish;
+
+error:
+    LOGMEM(NULL);
+    lyht_free(ext_ht);
+    ext_ht = NULL;
+    lyht_free(type_ht);
+    type_ht = NULL;
+
+publish:
+    old_ext_ht = ext_plugins_ht;
+    old_type_ht = type_plugins_ht;
+    ext_plugins_ht = ext_ht;
+    type_plugins_ht = type_ht;
+    if (!++type_plugins_gen) {
+        /* 0 is the generation of the new typedefs */
+        ++type_plugins_gen;
+    }
+    lyht_free(old_ext_ht);
+    lyht_free(old_type_ht);
+}
+
 API const char * const *
 ly_get_loaded_plugins(void)
 {
@@ -65,6 +166,12 @@ ly_clean_plugins(void)
     /* lock the extension plugins list */
     pthread_mutex_lock(&plugins_lock);
 
+    if (plugin_refs && --plugin_refs) {
+        /* there is a context that may refer to the plugins (or their indexes), so we cannot remove them */
+        pthread_mutex_unlock(&plugins_lock);
+        return EXIT_FAILURE;
+    }
+
     if(ext_plugins) {
         free(ext_plugins);
         ext_plugins = NULL;
@@ -76,6 +183,7 @@ ly_clean_plugins(void)
         type_plugins = NULL;
         type_plugins_count = 0;
     }
+    ly_plugins_index();
 
     for (u = 0; u < loaded_plugins_count; ++u) {
         free(loaded_plugins[u]);
@@ -111,6 +219,7 @@ ly_clean_plugins(void)
     free(type_plugins);
     type_plugins = NULL;
     type_plugins_count = 0;
+    ly_plugins_index();
 
     for (u = 0; u < loaded_plugins_count; ++u) {
         free(loaded_plugins[u]);
@@ -126,7 +235,7 @@ ly_clean_plugins(void)
     free(dlhandlers.set.g);
     dlhandlers.set.g = NULL;
     dlhandlers.size = 0;
-    dlhandlers.number = 0;
+    ly_set_clean(&dlhandlers);
 
 cleanup:
     /* unlock the global structures */
@@ -187,6 +296,7 @@ ly_register_types(struct lytype_plugin_list *plugin, const char *log_name)
         memcpy(&type_plugins[type_plugins_count], &plugin[u - 1], sizeof *plugin);
         type_plugins_count++;
     }
+    ly_plugins_index();
 
     return 0;
 }
@@ -267,6 +377,7 @@ ly_register_exts(struct lyext_plugin_list *plugin, const char *log_name)
         memcpy(&ext_plugins[ext_plugins_count], &plugin[u - 1], sizeof *plugin);
         ext_plugins_count++;
     }
+    ly_plugins_index();
 
     return 0;
 }
@@ -371,12 +482,16 @@ ly_load_plugins(void)
     /* lock the extension plugins list */
     pthread_mutex_lock(&plugins_lock);
 
-    ext_plugins = static_load_lyext_plugins(&ext_plugins_count);
-    type_plugins = static_load_lytype_plugins(&type_plugins_count);
+    /* the plugins are loaded only by the first context, the lists and their indexes are then read without the lock */
+    if (!plugin_refs++) {
+        ext_plugins = static_load_lyext_plugins(&ext_plugins_count);
+        type_plugins = static_load_lytype_plugins(&type_plugins_count);
+        ly_plugins_index();
 
-    int u;
-    for (u = 0; u < static_loaded_plugins_count; u++) {
-        ly_add_loaded_plugin(strdup(static_loaded_plugins[u]));
+        int u;
+        for (u = 0; u < static_loaded_plugins_count; u++) {
+            ly_add_loaded_plugin(strdup(static_loaded_plugins[u]));
+        }
     }
 
     /* unlock the global structures */
@@ -427,15 +542,27 @@ ly_load_plugins(void)
 struct lyext_plugin *
 ext_get_plugin(const char *name, const char *module, const char *revision)
 {
+    struct lyext_plugin_list key, *p, **found;
     uint16_t u;
 
     assert(name);
     assert(module);
 
+    if (ext_plugins_ht) {
+        key.module = module;
+        key.revision = revision;
+        key.name = name;
+        p = &key;
+        if (!lyht_find(ext_plugins_ht, &p, ly_plugin_hash(module, name), (void **)&found)) {
+            return (*found)->plugin;
+        }
+        return NULL;
+    }
+
     for (u = 0; u < ext_plugins_count; u++) {
         if (!strcmp(name, ext_plugins[u].name) &&
                 !strcmp(module, ext_plugins[u].module) &&
-                (!ext_plugins[u].revision || !strcmp(revision, ext_plugins[u].revision))) {
+                (!ext_plugins[u].revision || (revision && !strcmp(revision, ext_plugins[u].revision)))) {
             /* we have the match */
             return ext_plugins[u].plugin;
         }
@@ -560,8 +687,20 @@ lys_snode2stmt(LYS_NODE nodetype)
 static struct lytype_plugin_list *
 lytype_find(const char *module, const char *revision, const char *type_name)
 {
+    struct lytype_plugin_list key, *p, **found;
     uint16_t u;
 
+    if (type_plugins_ht) {
+        key.module = module;
+        key.revision = revision;
+        key.name = type_name;
+        p = &key;
+        if (!lyht_find(type_plugins_ht, &p, ly_plugin_hash(module, type_name), (void **)&found)) {
+            return *found;
+        }
+        return NULL;
+    }
+
     for (u = 0; u < type_plugins_count; ++u) {
         if (ly_strequal(module, type_plugins[u].module, 0) && ((!revision && !type_plugins[u].revision)
                 || (revision && ly_strequal(revision, type_plugins[u].revision, 0)))
@@ -573,24 +712,52 @@ lytype_find(const char *module, const char *revision, const char *type_name)
     return NULL;
 }
 
+/* the plugin is searched for only once for every typedef, unless the plugin list changes */
+static struct lytype_plugin_list *
+lytype_find_tpdf(struct lys_tpdf *tpdf)
+{
+    struct lytype_plugin_list *p;
+
+    assert(tpdf && tpdf->module);
+
+#ifdef LY_ENABLED_CACHE
+    if (tpdf->plugin_gen == type_plugins_gen) {
+        return tpdf->plugin_idx ? &type_plugins[tpdf->plugin_idx - 1] : NULL;
+    }
+#endif
+
+    p = lytype_find(tpdf->module->name, tpdf->module->rev_size ? tpdf->module->rev[0].date : NULL, tpdf->name);
+
+#ifdef LY_ENABLED_CACHE
+    tpdf->plugin_idx = p ? (p - type_plugins) + 1 : 0;
+    tpdf->plugin_gen = type_plugins_gen;
+#endif
+    return p;
+}
+
 int
-lytype_store(const struct lys_module *mod, const char *type_name, const char *value_str, lyd_val *value)
+lytype_store(struct lys_tpdf *tpdf, const char *value_str, lyd_val *value)
 {
     struct lytype_plugin_list *p;
+    struct timespec start;
     char *err_msg = NULL;
+    int r;
 
-    assert(mod && type_name && value_str && value);
+    assert(tpdf && tpdf->module && value_str && value);
 
-    p = lytype_find(mod->name, mod->rev_size ? mod->rev[0].date : NULL, type_name);
+    p = lytype_find_tpdf(tpdf);
     if (p) {
-        if (p->store_clb(type_name, value_str, value, &err_msg)) {
+        ly_plugin_stats_start(tpdf->module->ctx, &start);
+        r = p->store_clb(tpdf->name, value_str, value, &err_msg);
+        ly_plugin_stats_add(tpdf->module->ctx, &start, LY_PLUGIN_STORE, tpdf->module->name, tpdf->name);
+        if (r) {
             if (!err_msg) {
-                if (asprintf(&err_msg, "Failed to store value \"%s\" of user type \"%s\".", value_str, type_name) == -1) {
-                    LOGMEM(mod->ctx);
+                if (asprintf(&err_msg, "Failed to store value \"%s\" of user type \"%s\".", value_str, tpdf->name) == -1) {
+                    LOGMEM(tpdf->module->ctx);
                     return -1;
                 }
             }
-            LOGERR(mod->ctx, LY_EPLUGIN, err_msg);
+            LOGERR(tpdf->module->ctx, LY_EPLUGIN, err_msg);
             free(err_msg);
             return -1;
         }
@@ -602,18 +769,133 @@ lytype_store(const struct lys_module *mod, const char *type_name, const char *va
     return 1;
 }
 
+int
+lytype_is_user(struct lys_tpdf *tpdf)
+{
+    return lytype_find_tpdf(tpdf) ? 1 : 0;
+}
+
+int
+lytype_canonize(struct lys_tpdf *tpdf, const lyd_val *value, const char **value_str, int priv)
+{
+    struct lytype_plugin_list *p;
+    struct ly_ctx *ctx = tpdf->module->ctx;
+    struct timespec start;
+    char buf[64], *str;
+    int len, r;
+
+    p = lytype_find_tpdf(tpdf);
+    if (!p || !p->print_clb) {
+        return 0;
+    }
+
+    ly_plugin_stats_start(ctx, &start);
+    len = p->print_clb(tpdf->name, value, buf, sizeof buf);
+    ly_plugin_stats_add(ctx, &start, LY_PLUGIN_PRINT, tpdf->module->name, tpdf->name);
+    if (len < 0) {
+        LOGERR(ctx, LY_EPLUGIN, "Failed to print value \"%s\" of user type \"%s\".", *value_str, tpdf->name);
+        return -1;
+    }
+
+    if ((size_t)len < sizeof buf) {
+        str = buf;
+    } else {
+        str = malloc(len + 1);
+        LY_CHECK_ERR_RETURN(!str, LOGMEM(ctx), -1);
+        ly_plugin_stats_start(ctx, &start);
+        r = p->print_clb(tpdf->name, value, str, len + 1);
+        ly_plugin_stats_add(ctx, &start, LY_PLUGIN_PRINT, tpdf->module->name, tpdf->name);
+        if (r != len) {
+            LOGERR(ctx, LY_EPLUGIN, "Failed to print value \"%s\" of user type \"%s\".", *value_str, tpdf->name);
+            free(str);
+            return -1;
+        }
+    }
+
+    if (strcmp(str, *value_str)) {
+        lydict_remove_priv(ctx, *value_str, priv);
+        if (str == buf) {
+            *value_str = lydict_insert_priv(ctx, str, len, priv);
+        } else {
+            *value_str = lydict_insert_zc_priv(ctx, str, priv);
+            str = NULL;
+        }
+    }
+    if (str != buf) {
+        free(str);
+    }
+    return 0;
+}
+
+int
+lytype_compare(struct lys_tpdf *tpdf1, const lyd_val *value1, struct lys_tpdf *tpdf2, const lyd_val *value2)
+{
+    struct lytype_plugin_list *p;
+    struct timespec start;
+    int r;
+
+    p = lytype_find_tpdf(tpdf1);
+    if (!p || !p->compare_clb || (lytype_find_tpdf(tpdf2) != p)) {
+        return -1;
+    }
+
+    ly_plugin_stats_start(tpdf1->module->ctx, &start);
+    r = p->compare_clb(tpdf1->name, value1, value2);
+    ly_plugin_stats_add(tpdf1->module->ctx, &start, LY_PLUGIN_COMPARE, tpdf1->module->name, tpdf1->name);
+    return r ? 0 : 1;
+}
+
+int
+lytype_order(struct lys_tpdf *tpdf1, const lyd_val *value1, struct lys_tpdf *tpdf2, const lyd_val *value2, int *order)
+{
+    struct lytype_plugin_list *p;
+    struct timespec start;
+
+    p = lytype_find_tpdf(tpdf1);
+    if (!p || !p->order_clb || (lytype_find_tpdf(tpdf2) != p)) {
+        return 1;
+    }
+
+    ly_plugin_stats_start(tpdf1->module->ctx, &start);
+    *order = p->order_clb(tpdf1->name, value1, value2);
+    ly_plugin_stats_add(tpdf1->module->ctx, &start, LY_PLUGIN_ORDER, tpdf1->module->name, tpdf1->name);
+    return 0;
+}
+
+int
+lytype_hash(struct lys_tpdf *tpdf, const lyd_val *value, uint32_t *hash)
+{
+    struct lytype_plugin_list *p;
+    struct timespec start;
+
+    p = lytype_find_tpdf(tpdf);
+    if (!p || !p->hash_clb) {
+        return 1;
+    }
+
+    if (value) {
+        ly_plugin_stats_start(tpdf->module->ctx, &start);
+        *hash = p->hash_clb(tpdf->name, value);
+        ly_plugin_stats_add(tpdf->module->ctx, &start, LY_PLUGIN_HASH, tpdf->module->name, tpdf->name);
+    }
+    return 0;
+}
+
 void
-lytype_free(const struct lys_module *mod, const char *type_name, lyd_val value)
+lytype_free(struct lys_tpdf *tpdf, lyd_val value)
 {
     struct lytype_plugin_list *p;
+    struct timespec start;
 
-    p = lytype_find(mod->name, mod->rev_size ? mod->rev[0].date : NULL, type_name);
+    p = lytype_find_tpdf(tpdf);
     if (!p) {
-        LOGINT(mod->ctx);
+        LOGINT(tpdf->module->ctx);
         return;
     }
 
     if (p->free_clb) {
+        ly_plugin_stats_start(tpdf->module->ctx, &start);
         p->free_clb(value.ptr);
+        ly_plugin_stats_add(tpdf->module->ctx, &start, LY_PLUGIN_FREE, tpdf->module->name, tpdf->name);
     }
 }
@@ -12,7 +12,7 @@
  *     https://opensource.org/licenses/BSD-3-Clause
  */
 
-#define _GNU_SOURCE /* vasprintf(), vdprintf() */
+#define _GNU_SOURCE
 #define _POSIX_C_SOURCE 200809L
 
 #include <sys/types.h>
@@ -22,11 +22,15 @@
 #include <errno.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <pthread.h>
 
 #include "common.h"
+#include "context.h"
 #include "tree_schema.h"
 #include "tree_data.h"
 #include "printer.h"
+#include "hash_table.h"
+#include "tree_internal.h"
 
 struct ext_substmt_info_s ext_substmt_info[] = {
   {NULL, NULL, 0},                              /**< LYEXT_SUBSTMT_SELF */
@@ -77,57 +81,319 @@ nscmp(const struct lyd_node *node1, const struct lyd_node *node2)
     }
 }
 
+/**
+ * @brief Make sure a growable buffer can hold \p needed bytes, its size grows geometrically.
+ *
+ * @param[in,out] buf Buffer.
+ * @param[in,out] size Allocated size of \p buf.
+ * @param[in] needed Required size.
+ * @return 0 on success, -1 on memory allocation failure.
+ */
+static int
+ly_print_buf_reserve(char **buf, size_t *size, size_t needed)
+{
+    size_t new_size;
+    char *aux;
+
+    if (needed <= *size) {
+        return 0;
+    }
+
+    for (new_size = (*size ? *size : LYOUT_BUF_MIN); new_size < needed; new_size *= 2);
+    aux = ly_realloc(*buf, new_size);
+    if (!aux) {
+        *buf = NULL;
+        *size = 0;
+        LOGMEM(NULL);
+        return -1;
+    }
+    *buf = aux;
+    *size = new_size;
+
+    return 0;
+}
+
+/**
+ * @brief Format a string directly at the end of a growable buffer, it is always terminated.
+ *
+ * @param[in,out] buf Buffer.
+ * @param[in,out] len Used length of \p buf.
+ * @param[in,out] size Allocated size of \p buf.
+ * @param[in] format Format string.
+ * @param[in] ap Format arguments.
+ * @return Number of printed bytes, -1 on error.
+ */
+static int
+ly_print_buf_vprintf(char **buf, size_t *len, size_t *size, const char *format, va_list ap)
+{
+    va_list ap2;
+    int count;
+
+    if (ly_print_buf_reserve(buf, size, *len + 1)) {
+        *len = 0;
+        return -1;
+    }
+
+    va_copy(ap2, ap);
+    count = vsnprintf(*buf + *len, *size - *len, format, ap2);
+    va_end(ap2);
+    if (count < 0) {
+        return -1;
+    }
+
+    if (*len + count + 1 > *size) {
+        /* did not fit, print it again */
+        if (ly_print_buf_reserve(buf, size, *len + count + 1)) {
+            *len = 0;
+            return -1;
+        }
+        vsnprintf(*buf + *len, *size - *len, format, ap);
+    }
+    *len += count;
+
+    return count;
+}
+
+/**
+ * @brief Write the queued data of a nonblocking output as long as the file descriptor accepts them.
+ *
+ * @param[in] nb Queued output.
+ * @return 0 if all written, 1 if the file descriptor would block, -1 on error.
+ */
+static int
+ly_print_pending_flush(struct lyd_print_pending *nb)
+{
+    ssize_t r;
+
+    while (nb->off < nb->len) {
+        r = write(nb->fd, nb->buf + nb->off, nb->len - nb->off);
+        if (r < 0) {
+            if (errno == EINTR) {
+                continue;
+            } else if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+                nb->retry = nb->len - nb->off + LYOUT_NB_RETRY;
+                return 1;
+            }
+            nb->err = errno;
+            return -1;
+        }
+        nb->off += r;
+    }
+    nb->off = 0;
+    nb->len = 0;
+    nb->retry = 0;
+
+    return 0;
+}
+
+/**
+ * @brief Write data into the file descriptor of a LYOUT_FD output. In the nonblocking mode, the data
+ * that cannot be written now are queued instead of waiting for the file descriptor.
+ *
+ * @param[in] out Output structure.
+ * @param[in] buf Data to write.
+ * @param[in] count Length of \p buf.
+ * @return 0 on success, -1 on error.
+ */
+static int
+ly_print_fd_write(struct lyout *out, const char *buf, size_t count)
+{
+    struct lyd_print_pending *nb = out->nb;
+    ssize_t r;
+
+    if (nb) {
+        if (nb->err) {
+            return -1;
+        }
+        if ((nb->len > nb->off) && ((nb->len - nb->off < nb->retry) || ly_print_pending_flush(nb))) {
+            /* still blocked, the data must follow the queued ones */
+            goto queue;
+        }
+    }
+
+    while (count) {
+        r = write(out->method.fd, buf, count);
+        if (r < 0) {
+            if (errno == EINTR) {
+                continue;
+            } else if (nb && ((errno == EAGAIN) || (errno == EWOULDBLOCK))) {
+                nb->retry = LYOUT_NB_RETRY;
+                goto queue;
+            }
+            if (nb) {
+                nb->err = errno;
+            }
+            return -1;
+        }
+        buf += r;
+        count -= r;
+    }
+    return 0;
+
+queue:
+    if (nb->err) {
+        return -1;
+    }
+    if (nb->off && (nb->off >= nb->size / 2)) {
+        /* drop the written data */
+        memmove(nb->buf, nb->buf + nb->off, nb->len - nb->off);
+        nb->len -= nb->off;
+        nb->off = 0;
+    }
+    if (ly_print_buf_reserve(&nb->buf, &nb->size, nb->len + count)) {
+        nb->err = ENOMEM;
+        return -1;
+    }
+    memcpy(nb->buf + nb->len, buf, count);
+    nb->len += count;
+    return 0;
+}
+
+/**
+ * @brief Write the buffered data of LYOUT_FD and LYOUT_CALLBACK outputs.
+ *
+ * @param[in] out Output structure.
+ * @return 0 on success, -1 on error.
+ */
+static int
+ly_print_wbuf_flush(struct lyout *out)
+{
+    ssize_t r = 0;
+    size_t written = 0;
+
+    if (out->type == LYOUT_FD) {
+        r = ly_print_fd_write(out, out->wbuf, out->wbuf_len);
+        out->wbuf_len = 0;
+        return r;
+    }
+
+    while (written < out->wbuf_len) {
+        r = out->method.clb.f(out->method.clb.arg, out->wbuf + written, out->wbuf_len - written);
+        if (r <= 0) {
+            break;
+        }
+        written += r;
+    }
+    out->wbuf_len = 0;
+
+    return (r < 0) ? -1 : 0;
+}
+
+/**
+ * @brief Write the pending segments of a LYOUT_IOVEC output.
+ *
+ * @param[in] out Output structure.
+ * @return 0 on success, -1 on error.
+ */
+static int
+ly_print_iov_flush(struct lyout *out)
+{
+    struct iovec iov[LYOUT_IOV_BATCH];
+    ssize_t r = 0;
+    int i;
+
+    for (i = 0; i < out->seg_count; ++i) {
+        iov[i].iov_base = (void *)(out->segs[i].ref ? out->segs[i].ref : out->wbuf + out->segs[i].off);
+        iov[i].iov_len = out->segs[i].len;
+    }
+
+    i = 0;
+    while (i < out->seg_count) {
+        r = out->method.iov.f(out->method.iov.arg, &iov[i], out->seg_count - i);
+        if (r <= 0) {
+            break;
+        }
+
+        /* skip the written segments, the callback may write only some of them (see writev(2)) */
+        for (; (i < out->seg_count) && ((size_t)r >= iov[i].iov_len); ++i) {
+            r -= iov[i].iov_len;
+        }
+        if (i < out->seg_count) {
+            iov[i].iov_base = (char *)iov[i].iov_base + r;
+            iov[i].iov_len -= r;
+        }
+    }
+    out->seg_count = 0;
+    out->wbuf_len = 0;
+
+    return (r < 0) ? -1 : 0;
+}
+
+/**
+ * @brief Add a segment to a LYOUT_IOVEC output, write the pending segments if there are enough of them.
+ *
+ * @param[in] out Output structure.
+ * @param[in] ref Referenced data, NULL if the data were copied into the write buffer.
+ * @param[in] off Offset of the copied data in the write buffer.
+ * @param[in] len Length of the data.
+ * @return 0 on success, -1 on error.
+ */
+static int
+ly_print_iov_add(struct lyout *out, const char *ref, size_t off, size_t len)
+{
+    struct lyout_seg *seg;
+
+    if (!len) {
+        return 0;
+    }
+
+    seg = out->seg_count ? &out->segs[out->seg_count - 1] : NULL;
+    if (!ref && seg && !seg->ref && (seg->off + seg->len == off)) {
+        /* continuous copied data */
+        seg->len += len;
+    } else {
+        seg = &out->segs[out->seg_count++];
+        seg->ref = ref;
+        seg->off = off;
+        seg->len = len;
+    }
+
+    if ((out->seg_count == LYOUT_IOV_BATCH) || (out->wbuf_len >= LYOUT_BUF_FLUSH)) {
+        return ly_print_iov_flush(out);
+    }
+    return 0;
+}
+
 int
 ly_print(struct lyout *out, const char *format, ...)
 {
     int count = 0;
-    char *msg = NULL, *aux;
+    size_t off;
     va_list ap;
-#ifndef HAVE_VDPRINTF
-    FILE *stream;
-#endif
 
     va_start(ap, format);
 
+    if (out->hole_count) {
+        /* we are buffering data after a hole */
+        count = ly_print_buf_vprintf(&out->buffered, &out->buf_len, &out->buf_size, format, ap);
+        va_end(ap);
+        return count;
+    }
+
     switch (out->type) {
-    case LYOUT_FD:
-#ifdef HAVE_VDPRINTF
-        count = vdprintf(out->method.fd, format, ap);
-#else
-        stream = fdopen(dup(out->method.fd), "a+");
-        if (stream) {
-            count = vfprintf(stream, format, ap);
-            fclose(stream);
-        }
-#endif
-        break;
     case LYOUT_STREAM:
         count = vfprintf(out->method.f, format, ap);
         break;
     case LYOUT_MEMORY:
-        count = vasprintf(&msg, format, ap);
-        if (out->method.mem.len + count + 1 > out->method.mem.size) {
-            aux = ly_realloc(out->method.mem.buf, out->method.mem.len + count + 1);
-            if (!aux) {
-                out->method.mem.buf = NULL;
-                out->method.mem.len = 0;
-                out->method.mem.size = 0;
-                LOGMEM(NULL);
-                va_end(ap);
-                return -1;
-            }
-            out->method.mem.buf = aux;
-            out->method.mem.size = out->method.mem.len + count + 1;
-        }
-        memcpy(&out->method.mem.buf[out->method.mem.len], msg, count);
-        out->method.mem.len += count;
-        out->method.mem.buf[out->method.mem.len] = '\0';
-        free(msg);
+        count = ly_print_buf_vprintf(&out->method.mem.buf, &out->method.mem.len, &out->method.mem.size, format, ap);
         break;
+    case LYOUT_FD:
     case LYOUT_CALLBACK:
-        count = vasprintf(&msg, format, ap);
-        count = out->method.clb.f(out->method.clb.arg, msg, count);
-        free(msg);
+        count = ly_print_buf_vprintf(&out->wbuf, &out->wbuf_len, &out->wbuf_size, format, ap);
+        if (!count && (out->type == LYOUT_CALLBACK)) {
+            /* empty output is still passed to the callback */
+            ly_print_wbuf_flush(out);
+            out->method.clb.f(out->method.clb.arg, "", 0);
+        } else if (out->wbuf_len >= LYOUT_BUF_FLUSH) {
+            ly_print_wbuf_flush(out);
+        }
+        break;
+    case LYOUT_IOVEC:
+        off = out->wbuf_len;
+        count = ly_print_buf_vprintf(&out->wbuf, &out->wbuf_len, &out->wbuf_size, format, ap);
+        if (count > 0) {
+            ly_print_iov_add(out, NULL, off, count);
+        }
         break;
     }
 
@@ -143,27 +409,44 @@ ly_print_flush(struct lyout *out)
         fflush(out->method.f);
         break;
     case LYOUT_FD:
-    case LYOUT_MEMORY:
     case LYOUT_CALLBACK:
+        ly_print_wbuf_flush(out);
+        break;
+    case LYOUT_IOVEC:
+        ly_print_iov_flush(out);
+        break;
+    case LYOUT_MEMORY:
         /* nothing to do */
         break;
     }
 }
 
+void
+ly_print_clean(struct lyout *out)
+{
+    ly_print_flush(out);
+
+    free(out->buffered);
+    out->buffered = NULL;
+    out->buf_len = 0;
+    out->buf_size = 0;
+
+    free(out->wbuf);
+    out->wbuf = NULL;
+    out->wbuf_size = 0;
+
+    lyht_free(out->wd_ht);
+    out->wd_ht = NULL;
+}
+
 int
 ly_write(struct lyout *out, const char *buf, size_t count)
 {
     if (out->hole_count) {
         /* we are buffering data after a hole */
-        if (out->buf_len + count > out->buf_size) {
-            out->buffered = ly_realloc(out->buffered, out->buf_len + count);
-            if (!out->buffered) {
-                out->buf_len = 0;
-                out->buf_size = 0;
-                LOGMEM(NULL);
-                return -1;
-            }
-            out->buf_size = out->buf_len + count;
+        if (ly_print_buf_reserve(&out->buffered, &out->buf_size, out->buf_len + count)) {
+            out->buf_len = 0;
+            return -1;
         }
 
         memcpy(&out->buffered[out->buf_len], buf, count);
@@ -173,45 +456,89 @@ ly_write(struct lyout *out, const char *buf, size_t count)
 
     switch (out->type) {
     case LYOUT_MEMORY:
-        if (out->method.mem.len + count + 1 > out->method.mem.size) {
-            out->method.mem.buf = ly_realloc(out->method.mem.buf, out->method.mem.len + count + 1);
-            if (!out->method.mem.buf) {
-                out->method.mem.len = 0;
-                out->method.mem.size = 0;
-                LOGMEM(NULL);
-                return -1;
-            }
-            out->method.mem.size = out->method.mem.len + count + 1;
+        if (ly_print_buf_reserve(&out->method.mem.buf, &out->method.mem.size, out->method.mem.len + count + 1)) {
+            out->method.mem.len = 0;
+            return -1;
         }
         memcpy(&out->method.mem.buf[out->method.mem.len], buf, count);
         out->method.mem.len += count;
         out->method.mem.buf[out->method.mem.len] = '\0';
         return count;
-    case LYOUT_FD:
-        return write(out->method.fd, buf, count);
     case LYOUT_STREAM:
         return fwrite(buf, sizeof *buf, count, out->method.f);
+    case LYOUT_FD:
     case LYOUT_CALLBACK:
-        return out->method.clb.f(out->method.clb.arg, buf, count);
+        if (out->wbuf_len + count > LYOUT_BUF_FLUSH) {
+            if (ly_print_wbuf_flush(out)) {
+                return -1;
+            }
+            if (count >= LYOUT_BUF_FLUSH) {
+                /* large chunk, no point in copying it */
+                if (out->type == LYOUT_FD) {
+                    return ly_print_fd_write(out, buf, count) ? -1 : (int)count;
+                }
+                return out->method.clb.f(out->method.clb.arg, buf, count);
+            }
+        }
+        if (ly_print_buf_reserve(&out->wbuf, &out->wbuf_size, out->wbuf_len + count)) {
+            out->wbuf_len = 0;
+            return -1;
+        }
+        memcpy(&out->wbuf[out->wbuf_len], buf, count);
+        out->wbuf_len += count;
+        return count;
+    case LYOUT_IOVEC:
+        if (ly_print_buf_reserve(&out->wbuf, &out->wbuf_size, out->wbuf_len + count)) {
+            out->wbuf_len = 0;
+            out->seg_count = 0;
+            return -1;
+        }
+        memcpy(&out->wbuf[out->wbuf_len], buf, count);
+        out->wbuf_len += count;
+        if (ly_print_iov_add(out, NULL, out->wbuf_len - count, count)) {
+            return -1;
+        }
+        return count;
     }
 
     return 0;
 }
 
+int
+ly_write_ref(struct lyout *out, const char *buf, size_t count)
+{
+    if ((out->type != LYOUT_IOVEC) || out->hole_count || (count < LYOUT_IOV_REF_MIN)) {
+        return ly_write(out, buf, count);
+    }
+
+    if (ly_print_iov_add(out, buf, 0, count)) {
+        return -1;
+    }
+    return count;
+}
+
+int
+ly_print_indent(struct lyout *out, int count)
+{
+    static const char spaces[] = "                                ";
+    int len, ret = 0;
+
+    for (; count > 0; count -= len) {
+        len = (count < (int)(sizeof spaces - 1)) ? count : (int)(sizeof spaces - 1);
+        ret += ly_write(out, spaces, len);
+    }
+
+    return ret;
+}
+
 int
 ly_write_skip(struct lyout *out, size_t count, size_t *position)
 {
     switch (out->type) {
     case LYOUT_MEMORY:
-        if (out->method.mem.len + count > out->method.mem.size) {
-            out->method.mem.buf = ly_realloc(out->method.mem.buf, out->method.mem.len + count);
-            if (!out->method.mem.buf) {
-                out->method.mem.len = 0;
-                out->method.mem.size = 0;
-                LOGMEM(NULL);
-                return -1;
-            }
-            out->method.mem.size = out->method.mem.len + count;
+        if (ly_print_buf_reserve(&out->method.mem.buf, &out->method.mem.size, out->method.mem.len + count + 1)) {
+            out->method.mem.len = 0;
+            return -1;
         }
 
         /* save the current position */
@@ -223,16 +550,11 @@ ly_write_skip(struct lyout *out, size_t count, size_t *position)
     case LYOUT_FD:
     case LYOUT_STREAM:
     case LYOUT_CALLBACK:
+    case LYOUT_IOVEC:
         /* buffer the hole */
-        if (out->buf_len + count > out->buf_size) {
-            out->buffered = ly_realloc(out->buffered, out->buf_len + count);
-            if (!out->buffered) {
-                out->buf_len = 0;
-                out->buf_size = 0;
-                LOGMEM(NULL);
-                return -1;
-            }
-            out->buf_size = out->buf_len + count;
+        if (ly_print_buf_reserve(&out->buffered, &out->buf_size, out->buf_len + count)) {
+            out->buf_len = 0;
+            return -1;
         }
 
         /* save the current position */
@@ -259,6 +581,7 @@ ly_write_skipped(struct lyout *out, size_t position, const char *buf, size_t cou
     case LYOUT_FD:
     case LYOUT_STREAM:
     case LYOUT_CALLBACK:
+    case LYOUT_IOVEC:
         if (out->buf_len < position + count) {
             LOGINT(NULL);
             return -1;
@@ -349,6 +672,132 @@ ly_print_iffeature(struct lyout *out, const struct lys_module *module, struct ly
     return 0;
 }
 
+#ifdef LY_ENABLED_CACHE
+
+struct lys_print_rec {
+    const struct lys_module *module;
+    LYS_OUTFORMAT format;
+    char *str;
+    size_t len;
+};
+
+static int
+lys_print_rec_equal(void *val1_p, void *val2_p, int UNUSED(mod), void *UNUSED(cb_data))
+{
+    struct lys_print_rec *rec1 = (struct lys_print_rec *)val1_p, *rec2 = (struct lys_print_rec *)val2_p;
+
+    return (rec1->module == rec2->module) && (rec1->format == rec2->format);
+}
+
+static void
+lys_print_cache_free(struct hash_table *ht)
+{
+    struct ht_rec *ht_rec;
+    uint32_t i;
+
+    for (i = 0; i < ht->size; ++i) {
+        if (ht->ctrl[i] & LYHT_CTRL_FULL) {
+            ht_rec = lyht_get_rec(ht->recs, ht->rec_size, i);
+            free(((struct lys_print_rec *)ht_rec->val)->str);
+        }
+    }
+    lyht_free(ht);
+}
+
+/**
+ * @brief Print a module in YANG or YIN format, the output is created only once for each module set.
+ *
+ * @param[in] out Output to write into.
+ * @param[in] module Module to print.
+ * @param[in] format Output format, #LYS_OUT_YANG or #LYS_OUT_YIN.
+ * @return EXIT_SUCCESS on success, EXIT_FAILURE on error.
+ */
+static int
+lys_print_cached(struct lyout *out, const struct lys_module *module, LYS_OUTFORMAT format)
+{
+    struct ly_ctx *ctx = module->ctx;
+    struct lys_print_rec rec, *match;
+    struct lyout mem_out;
+    uint32_t hash;
+    int ret;
+
+    rec.module = module;
+    rec.format = format;
+    rec.str = NULL;
+    rec.len = 0;
+    hash = dict_hash_multi(0, (const char *)&rec.module, sizeof rec.module);
+    hash = dict_hash_multi(hash, (const char *)&rec.format, sizeof rec.format);
+    hash = dict_hash_multi(hash, NULL, 0);
+
+    /* the printed text stays valid as long as we hold the lock */
+    pthread_rwlock_rdlock(&ctx->schema_print_lock);
+    if (ctx->schema_print && (ctx->schema_print_set_id == ctx->models.module_set_id)
+            && !lyht_find(ctx->schema_print, &rec, hash, (void **)&match)) {
+        ret = (ly_write(out, match->str, match->len) < 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+        pthread_rwlock_unlock(&ctx->schema_print_lock);
+        return ret;
+    }
+    pthread_rwlock_unlock(&ctx->schema_print_lock);
+
+    memset(&mem_out, 0, sizeof mem_out);
+    mem_out.type = LYOUT_MEMORY;
+
+    lys_disable_deviations((struct lys_module *)module);
+    if (format == LYS_OUT_YIN) {
+        ret = yin_print_model(&mem_out, module);
+    } else {
+        ret = yang_print_model(&mem_out, module);
+    }
+    lys_enable_deviations((struct lys_module *)module);
+    if (ret) {
+        free(mem_out.method.mem.buf);
+        return ret;
+    }
+    rec.str = mem_out.method.mem.buf;
+    rec.len = mem_out.method.mem.len;
+
+    if (ly_write(out, rec.str, rec.len) < 0) {
+        free(rec.str);
+        return EXIT_FAILURE;
+    }
+
+    /* store it, failing to do so is not an error */
+    pthread_rwlock_wrlock(&ctx->schema_print_lock);
+    if (ctx->schema_print && (ctx->schema_print_set_id != ctx->models.module_set_id)) {
+        /* the modules could have been removed meanwhile */
+        lys_print_cache_free(ctx->schema_print);
+        ctx->schema_print = NULL;
+    }
+    if (!ctx->schema_print) {
+        ctx->schema_print = lyht_new(8, sizeof rec, lys_print_rec_equal, NULL, 1);
+        ctx->schema_print_set_id = ctx->models.module_set_id;
+    }
+    if (!ctx->schema_print || lyht_insert(ctx->schema_print, &rec, hash, NULL)) {
+        /* no memory or printed by another thread meanwhile */
+        free(rec.str);
+    }
+    pthread_rwlock_unlock(&ctx->schema_print_lock);
+
+    return EXIT_SUCCESS;
+}
+
+#endif
+
+void
+lys_print_cache_clear(struct ly_ctx *ctx)
+{
+#ifdef LY_ENABLED_CACHE
+    pthread_rwlock_wrlock(&ctx->schema_print_lock);
+    if (ctx->schema_print) {
+        lys_print_cache_free(ctx->schema_print);
+        ctx->schema_print = NULL;
+    }
+    pthread_rwlock_unlock(&ctx->schema_print_lock);
+#else
+    (void)ctx;
+#endif
+}
+
 static int
 lys_print_(struct lyout *out, const struct lys_module *module, LYS_OUTFORMAT format, const char *target_node,
            int line_length, int options)
@@ -357,14 +806,22 @@ lys_print_(struct lyout *out, const struct lys_module *module, LYS_OUTFORMAT for
 
     switch (format) {
     case LYS_OUT_YIN:
+#ifdef LY_ENABLED_CACHE
+        ret = lys_print_cached(out, module, format);
+#else
         lys_disable_deviations((struct lys_module *)module);
         ret = yin_print_model(out, module);
         lys_enable_deviations((struct lys_module *)module);
+#endif
         break;
     case LYS_OUT_YANG:
+#ifdef LY_ENABLED_CACHE
+        ret = lys_print_cached(out, module, format);
+#else
         lys_disable_deviations((struct lys_module *)module);
         ret = yang_print_model(out, module);
         lys_enable_deviations((struct lys_module *)module);
+#endif
         break;
     case LYS_OUT_TREE:
         ret = tree_print_model(out, module, target_node, line_length, options);
@@ -431,6 +888,7 @@ lys_print_fd(int fd, const struct lys_module *module, LYS_OUTFORMAT format, cons
              int line_length, int options)
 {
     struct lyout out;
+    int r;
 
     if (fd < 0 || !module) {
         LOGARG;
@@ -442,7 +900,10 @@ lys_print_fd(int fd, const struct lys_module *module, LYS_OUTFORMAT format, cons
     out.type = LYOUT_FD;
     out.method.fd = fd;
 
-    return lys_print_(&out, module, format, target_node, line_length, options);
+    r = lys_print_(&out, module, format, target_node, line_length, options);
+
+    ly_print_clean(&out);
+    return r;
 }
 
 API int
@@ -472,6 +933,7 @@ lys_print_clb(ssize_t (*writeclb)(void *arg, const void *buf, size_t count), voi
               LYS_OUTFORMAT format, const char *target_node, int line_length, int options)
 {
     struct lyout out;
+    int r;
 
     if (!writeclb || !module) {
         LOGARG;
@@ -484,7 +946,10 @@ lys_print_clb(ssize_t (*writeclb)(void *arg, const void *buf, size_t count), voi
     out.method.clb.f = writeclb;
     out.method.clb.arg = arg;
 
-    return lys_print_(&out, module, format, target_node, line_length, options);
+    r = lys_print_(&out, module, format, target_node, line_length, options);
+
+    ly_print_clean(&out);
+    return r;
 }
 
 int
@@ -703,20 +1168,197 @@ lys_print_target(struct lyout *out, const struct lys_module *module, const char
     return EXIT_SUCCESS;
 }
 
-static int
-lyd_print_(struct lyout *out, const struct lyd_node *root, LYD_FORMAT format, int options)
+struct ly_print_thread {
+    const struct lyd_node **roots;   /* subtrees to be printed by the thread */
+    unsigned int count;
+    int level;
+    int options;
+    int (*print_clb)(struct lyout *out, int level, const struct lyd_node *node, int options);
+    const char *sep;
+    enum int_log_opts log_opt;       /* internal logging options of the calling thread */
+    struct lyout out;                /* memory output of the thread */
+    struct ly_err_item *err;         /* errors logged by the thread */
+    int ret;
+};
+
+static void *
+ly_print_thread(void *arg)
 {
-    switch (format) {
+    struct ly_print_thread *pt = (struct ly_print_thread *)arg;
+    unsigned int i;
+
+    log_opt = pt->log_opt;
+    pt->ret = EXIT_SUCCESS;
+    for (i = 0; i < pt->count; ++i) {
+        if (i) {
+            ly_write(&pt->out, pt->sep, strlen(pt->sep));
+        }
+        if (pt->print_clb(&pt->out, pt->level, pt->roots[i], pt->options)) {
+            pt->ret = EXIT_FAILURE;
+            break;
+        }
+    }
+
+    /* the errors are passed to the calling thread */
+    pt->err = ly_err_detach(pt->roots[0]->schema->module->ctx);
+    return NULL;
+}
+
+int
+ly_print_threads(struct lyout *out, const struct lyd_node *first, int level, int options,
+                 int (*member_clb)(const struct lyd_node *first, const struct lyd_node *node, int options),
+                 int (*print_clb)(struct lyout *out, int level, const struct lyd_node *node, int options),
+                 const char *sep)
+{
+    struct ly_ctx *ctx = first->schema->module->ctx;
+    const struct lyd_node *node, **roots = NULL;
+    struct ly_print_thread *pt = NULL;
+    pthread_t *tids = NULL;
+    int8_t *started = NULL;
+    unsigned int i, count = 0, thread_count = 0, start;
+    int ret = -1;
+
+    if (ctx->print_threads < 2) {
+        return 1;
+    }
+
+    LY_TREE_FOR(first, node) {
+        if (member_clb(first, node, options)) {
+            ++count;
+        }
+    }
+    if (count < 2) {
+        return 1;
+    }
+
+    thread_count = (count < ctx->print_threads) ? count : ctx->print_threads;
+    roots = malloc(count * sizeof *roots);
+    pt = calloc(thread_count, sizeof *pt);
+    tids = malloc(thread_count * sizeof *tids);
+    started = calloc(thread_count, sizeof *started);
+    LY_CHECK_ERR_GOTO(!roots || !pt || !tids || !started, LOGMEM(ctx), cleanup);
+
+    i = 0;
+    LY_TREE_FOR(first, node) {
+        if (member_clb(first, node, options)) {
+            roots[i++] = node;
+        }
+    }
+
+    /* split the subtrees into contiguous parts, printed in order afterwards */
+    for (i = 0, start = 0; i < thread_count; ++i) {
+        pt[i].roots = &roots[start];
+        pt[i].count = (count - start) / (thread_count - i);
+        pt[i].level = level;
+        pt[i].options = options;
+        pt[i].print_clb = print_clb;
+        pt[i].sep = sep;
+        pt[i].log_opt = log_opt;
+        pt[i].out.type = LYOUT_MEMORY;
+        start += pt[i].count;
+    }
+
+    /* the calling thread prints the first part itself */
+    for (i = 1; i < thread_count; ++i) {
+        started[i] = pthread_create(&tids[i], NULL, ly_print_thread, &pt[i]) ? 0 : 1;
+    }
+    for (i = 0; i < thread_count; ++i) {
+        if (started[i]) {
+            pthread_join(tids[i], NULL);
+        } else {
+            /* the first part or a thread could not be created */
+            ly_print_thread(&pt[i]);
+        }
+    }
+
+    ret = 0;
+    for (i = 0; i < thread_count; ++i) {
+        ly_err_append(ctx, pt[i].err);
+        pt[i].err = NULL;
+        if (pt[i].ret) {
+            ret = -1;
+        }
+
+        if (!ret) {
+            if (i) {
+                ly_write(out, sep, strlen(sep));
+            }
+            ly_write(out, pt[i].out.method.mem.buf, pt[i].out.method.mem.len);
+        }
+    }
+
+cleanup:
+    if (pt) {
+        for (i = 0; i < thread_count; ++i) {
+            ly_print_clean(&pt[i].out);
+            free(pt[i].out.method.mem.buf);
+        }
+    }
+    free(roots);
+    free(pt);
+    free(tids);
+    free(started);
+    return ret;
+}
+
+static int
+lyd_print_format(struct lyout *out, const struct lyd_node *root, LYD_FORMAT format, int options)
+{
+    int ret;
+
+    LY_TRACE(print_start, root, root ? root->schema->name : NULL, format, options);
+    switch (format) {
     case LYD_XML:
-        return xml_print_data(out, root, options);
+        ret = xml_print_data(out, root, options);
+        break;
     case LYD_JSON:
-        return json_print_data(out, root, options);
+        ret = json_print_data(out, root, options);
+        break;
     case LYD_LYB:
-        return lyb_print_data(out, root, options);
+        ret = lyb_print_data(out, root, options);
+        break;
     default:
         LOGERR(root->schema->module->ctx, LY_EINVAL, "Unknown output format.");
+        ret = EXIT_FAILURE;
+        break;
+    }
+    LY_TRACE(print_done, root, format, ret);
+
+    return ret;
+}
+
+static int
+lyd_print_(struct lyout *out, const struct lyd_node *root, LYD_FORMAT format, int options)
+{
+    struct lyd_node *elem, *next, *start;
+    struct ly_set *created;
+    int ret;
+
+    if (!root || !(root->schema->module->ctx->models.flags & LY_CTX_VIRTUAL_DFLT)
+            || !(options & (LYP_WD_ALL | LYP_WD_ALL_TAG | LYP_WD_IMPL_TAG))) {
+        return lyd_print_format(out, root, format, options);
+    }
+
+    /* virtual default nodes are requested to be printed, create them only for the time of printing */
+    created = ly_set_new();
+    if (!created) {
+        LOGMEM(root->schema->module->ctx);
         return EXIT_FAILURE;
     }
+    for (start = (struct lyd_node *)root; start; start = (options & LYP_WITHSIBLINGS) ? start->next : NULL) {
+        LY_TREE_DFS_BEGIN(start, next, elem) {
+            if (!(elem->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST | LYS_ANYDATA))) {
+                lyd_wd_materialize(elem, created);
+            }
+            LY_TREE_DFS_END(start, next, elem);
+        }
+    }
+
+    ret = lyd_print_format(out, root, format, options);
+
+    lyd_wd_virtualize(created);
+    ly_set_free(created);
+    return ret;
 }
 
 API int
@@ -737,7 +1379,7 @@ lyd_print_file(FILE *f, const struct lyd_node *root, LYD_FORMAT format, int opti
 
     r = lyd_print_(&out, root, format, options);
 
-    free(out.buffered);
+    ly_print_clean(&out);
     return r;
 }
 
@@ -782,10 +1424,83 @@ lyd_print_fd(int fd, const struct lyd_node *root, LYD_FORMAT format, int options
 
     r = lyd_print_(&out, root, format, options);
 
-    free(out.buffered);
+    ly_print_clean(&out);
+    return r;
+}
+
+API int
+lyd_print_fd_nb(int fd, const struct lyd_node *root, LYD_FORMAT format, int options, struct lyd_print_pending **pending)
+{
+    int r;
+    struct lyout out;
+    struct lyd_print_pending *nb;
+
+    if ((fd < 0) || !pending) {
+        LOGARG;
+        return EXIT_FAILURE;
+    }
+    *pending = NULL;
+
+    nb = calloc(1, sizeof *nb);
+    LY_CHECK_ERR_RETURN(!nb, LOGMEM(root ? root->schema->module->ctx : NULL), EXIT_FAILURE);
+    nb->fd = fd;
+
+    memset(&out, 0, sizeof out);
+
+    out.type = LYOUT_FD;
+    out.method.fd = fd;
+    out.nb = nb;
+
+    r = lyd_print_(&out, root, format, options);
+
+    ly_print_clean(&out);
+    if (nb->err) {
+        LOGERR(root ? root->schema->module->ctx : NULL, LY_ESYS, "Writing the printed data failed (%s).", strerror(nb->err));
+        r = EXIT_FAILURE;
+    }
+
+    if (r || (nb->off == nb->len)) {
+        lyd_print_pending_free(nb);
+    } else {
+        *pending = nb;
+    }
+    return r;
+}
+
+API int
+lyd_print_pending_write(struct lyd_print_pending *pending)
+{
+    int r;
+
+    if (!pending) {
+        LOGARG;
+        return -1;
+    }
+
+    r = ly_print_pending_flush(pending);
+    if (r == -1) {
+        LOGERR(NULL, LY_ESYS, "Writing the printed data failed (%s).", strerror(pending->err));
+    }
     return r;
 }
 
+API size_t
+lyd_print_pending_len(const struct lyd_print_pending *pending)
+{
+    return pending ? pending->len - pending->off : 0;
+}
+
+API void
+lyd_print_pending_free(struct lyd_print_pending *pending)
+{
+    if (!pending) {
+        return;
+    }
+
+    free(pending->buf);
+    free(pending);
+}
+
 API int
 lyd_print_mem(char **strp, const struct lyd_node *root, LYD_FORMAT format, int options)
 {
@@ -804,7 +1519,7 @@ lyd_print_mem(char **strp, const struct lyd_node *root, LYD_FORMAT format, int o
     r = lyd_print_(&out, root, format, options);
 
     *strp = out.method.mem.buf;
-    free(out.buffered);
+    ly_print_clean(&out);
     return r;
 }
 
@@ -828,121 +1543,420 @@ lyd_print_clb(ssize_t (*writeclb)(void *arg, const void *buf, size_t count), voi
 
     r = lyd_print_(&out, root, format, options);
 
-    free(out.buffered);
+    ly_print_clean(&out);
+    return r;
+}
+
+API int
+lyd_print_iov(ssize_t (*writeclb)(void *arg, const struct iovec *iov, int iovcnt), void *arg,
+              const struct lyd_node *root, LYD_FORMAT format, int options)
+{
+    int r;
+    struct lyout out;
+
+    if (!writeclb) {
+        LOGARG;
+        return EXIT_FAILURE;
+    }
+
+    memset(&out, 0, sizeof out);
+
+    out.type = LYOUT_IOVEC;
+    out.method.iov.f = writeclb;
+    out.method.iov.arg = arg;
+
+    r = lyd_print_(&out, root, format, options);
+
+    ly_print_clean(&out);
+    return r;
+}
+
+API int
+lyd_print_lyb_patch(char **strp, const struct lyd_difflist *diff, int options)
+{
+    struct lyout out;
+    int r;
+
+    if (!strp || !diff || (options & ~(LYP_STRTABLE | LYP_IDENTIDX))) {
+        LOGARG;
+        return EXIT_FAILURE;
+    }
+
+    memset(&out, 0, sizeof out);
+
+    out.type = LYOUT_MEMORY;
+
+    r = lyb_print_patch(&out, diff, options);
+
+    *strp = out.method.mem.buf;
+    ly_print_clean(&out);
+    return r;
+}
+
+API int
+lyd_lyb_stream_print_header(char **strp, struct lyd_lyb_stream *stream)
+{
+    struct lyout out;
+    const struct lys_module *mod;
+    uint32_t idx = 0;
+    int r;
+
+    if (!strp || !stream) {
+        LOGARG;
+        return EXIT_FAILURE;
+    }
+    if (stream->header) {
+        LOGERR(stream->ctx, LY_EINVAL, "%s: the LYB stream header was already processed.", __func__);
+        return EXIT_FAILURE;
+    }
+
+    /* all the modules the data can be from */
+    stream->mod_count = 0;
+    while ((mod = ly_ctx_get_module_iter(stream->ctx, &idx))) {
+        if (!mod->implemented) {
+            continue;
+        }
+        stream->models = ly_realloc(stream->models, (stream->mod_count + 1) * sizeof *stream->models);
+        LY_CHECK_ERR_RETURN(!stream->models, LOGMEM(stream->ctx); stream->mod_count = 0, EXIT_FAILURE);
+        stream->models[stream->mod_count++] = mod;
+    }
+    stream->str_table = (stream->options & LYP_STRTABLE) ? 1 : 0;
+
+    memset(&out, 0, sizeof out);
+    out.type = LYOUT_MEMORY;
+
+    r = lyb_print_stream_header(&out, stream);
+    if (!r && lyb_stream_set_models(stream)) {
+        r = EXIT_FAILURE;
+    }
+
+    *strp = out.method.mem.buf;
+    ly_print_clean(&out);
+    return r;
+}
+
+API int
+lyd_lyb_stream_print(char **strp, struct lyd_lyb_stream *stream, const struct lyd_node *root, int options)
+{
+    struct lyout out;
+    int r;
+
+    if (!strp || !stream || (options & ~LYP_WITHSIBLINGS) || (root && (lyd_node_module(root)->ctx != stream->ctx))) {
+        LOGARG;
+        return EXIT_FAILURE;
+    }
+    if (!stream->header) {
+        LOGERR(stream->ctx, LY_EINVAL, "%s: the LYB stream header was not printed.", __func__);
+        return EXIT_FAILURE;
+    }
+    lyb_stream_check(stream);
+
+    memset(&out, 0, sizeof out);
+    out.type = LYOUT_MEMORY;
+
+    r = lyb_print_stream_frame(&out, stream, root, options);
+
+    *strp = out.method.mem.buf;
+    ly_print_clean(&out);
+    return r;
+}
+
+API int
+lyd_print_page(char **strp, const struct lyd_node *first, uint32_t count, LYD_FORMAT format, int options,
+               const struct lyd_node **next)
+{
+    struct lyout out;
+    const struct lyd_node **parents = NULL, *iter;
+    struct ly_ctx *ctx;
+    int depth = 0, i, r;
+    uint32_t n;
+
+    if (!strp || !first || !count || !(first->schema->nodetype & (LYS_LIST | LYS_LEAFLIST))) {
+        LOGARG;
+        return EXIT_FAILURE;
+    }
+    ctx = first->schema->module->ctx;
+
+    /* ancestors from the top-level one */
+    for (iter = first->parent; iter; iter = iter->parent) {
+        ++depth;
+    }
+    if (depth) {
+        parents = malloc(depth * sizeof *parents);
+        LY_CHECK_ERR_RETURN(!parents, LOGMEM(ctx), EXIT_FAILURE);
+        for (i = depth, iter = first->parent; iter; iter = iter->parent) {
+            parents[--i] = iter;
+        }
+    }
+
+    memset(&out, 0, sizeof out);
+
+    out.type = LYOUT_MEMORY;
+
+    switch (format) {
+    case LYD_XML:
+        r = xml_print_page(&out, parents, depth, first, count, options);
+        break;
+    case LYD_JSON:
+        r = json_print_page(&out, parents, depth, first, count, options);
+        break;
+    default:
+        LOGERR(ctx, LY_EINVAL, "Unsupported output format for printing a page.");
+        r = EXIT_FAILURE;
+        break;
+    }
+
+    if (next) {
+        for (iter = first, n = 0; iter && (n < count); ++n) {
+            for (iter = iter->next; iter && (iter->schema != first->schema); iter = iter->next);
+        }
+        *next = iter;
+    }
+
+    *strp = out.method.mem.buf;
+    ly_print_clean(&out);
+    free(parents);
     return r;
 }
 
 int
-lyd_wd_toprint(const struct lyd_node *node, int options)
+ly_print_gen_next(struct lyout *out, struct ly_print_gen *gen)
 {
-    const struct lyd_node *subroot, *next, *elem;
-    int flag = 0;
+    int r;
 
-    if (options & LYP_WD_TRIM) {
-        /* do not print default nodes */
+    if (gen->instance) {
+        lyd_free(gen->instance);
+        gen->instance = NULL;
+
+        /* the with-defaults properties of the freed nodes must not be found for new nodes at the same address */
+        lyht_free(out->wd_ht);
+        out->wd_ht = NULL;
+    }
+
+    gen->instance = _lyd_new(NULL, gen->list, 0);
+    LY_CHECK_ERR_RETURN(!gen->instance, LOGMEM(gen->list->module->ctx), -1);
+
+    r = gen->clb(gen->instance, gen->user_data);
+    if (r) {
+        lyd_free(gen->instance);
+        gen->instance = NULL;
+        return (r == 1) ? 1 : -1;
+    }
+    return 0;
+}
+
+API int
+lyd_print_gen(ssize_t (*writeclb)(void *arg, const void *buf, size_t count), void *arg, const struct lyd_node *parent,
+              const struct lys_node *list, LYD_FORMAT format, int options, lyd_print_gen_clb clb, void *user_data)
+{
+    struct lyout out;
+    struct ly_print_gen gen;
+    const struct lyd_node **parents = NULL, *iter;
+    const struct lys_node *sparent;
+    struct ly_ctx *ctx;
+    int depth = 0, i, r;
+
+    if (!writeclb || !list || (list->nodetype != LYS_LIST) || !clb) {
+        LOGARG;
+        return EXIT_FAILURE;
+    }
+    ctx = list->module->ctx;
+
+    /* the instances are children of parent */
+    for (sparent = lys_parent(list); sparent && (sparent->nodetype & (LYS_USES | LYS_CHOICE | LYS_CASE | LYS_INPUT | LYS_OUTPUT));
+            sparent = lys_parent(sparent));
+    if (sparent != (parent ? parent->schema : NULL)) {
+        LOGERR(ctx, LY_EINVAL, "List \"%s\" instances are not children of %s%s%s.", list->name,
+               parent ? "\"" : "the top level", parent ? parent->schema->name : "", parent ? "\"" : "");
+        return EXIT_FAILURE;
+    }
+
+    /* ancestors from the top-level one */
+    for (iter = parent; iter; iter = iter->parent) {
+        ++depth;
+    }
+    if (depth) {
+        parents = malloc(depth * sizeof *parents);
+        LY_CHECK_ERR_RETURN(!parents, LOGMEM(ctx), EXIT_FAILURE);
+        for (i = depth, iter = parent; iter; iter = iter->parent) {
+            parents[--i] = iter;
+        }
+    }
+
+    memset(&out, 0, sizeof out);
+    memset(&gen, 0, sizeof gen);
+
+    out.type = LYOUT_CALLBACK;
+    out.method.clb.f = writeclb;
+    out.method.clb.arg = arg;
+    gen.list = list;
+    gen.clb = clb;
+    gen.user_data = user_data;
+
+    switch (format) {
+    case LYD_XML:
+        r = xml_print_gen(&out, parents, depth, &gen, options);
+        break;
+    case LYD_JSON:
+        r = json_print_gen(&out, parents, depth, &gen, options);
+        break;
+    default:
+        LOGERR(ctx, LY_EINVAL, "Unsupported output format for printing generated instances.");
+        r = EXIT_FAILURE;
+        break;
+    }
+
+    lyd_free(gen.instance);
+    ly_print_clean(&out);
+    free(parents);
+    return r;
+}
+
+/* subtree properties of lyd_wd_subtree() */
+#define LYD_WD_NONDFLT 0x01     /* not trimmed in the trim mode */
+#define LYD_WD_STATE 0x02       /* state data */
+#define LYD_WD_NONCONT 0x04     /* other nodes than containers */
+
+/* subtree properties of a node already learned */
+struct lyd_wd_rec {
+    const struct lyd_node *node;
+    uint8_t known;
+    uint8_t props;
+};
+
+static int
+lyd_wd_val_equal(void *val1_p, void *val2_p, int UNUSED(mod), void *UNUSED(cb_data))
+{
+    return ((struct lyd_wd_rec *)val1_p)->node == ((struct lyd_wd_rec *)val2_p)->node;
+}
+
+static uint32_t
+lyd_wd_hash(const struct lyd_node *node)
+{
+    uint32_t hash;
+
+    hash = dict_hash_multi(0, (const char *)&node, sizeof node);
+    return dict_hash_multi(hash, NULL, 0);
+}
+
+/**
+ * @brief Learn a with-defaults property of a subtree. Properties decided by the children of a node are
+ * remembered in the output so that every subtree is searched only once when printing the whole tree.
+ *
+ * @param[in] out Output to remember the properties in, NULL to remember nothing.
+ * @param[in] node Root of the subtree.
+ * @param[in] prop Property to learn, LYD_WD_NONDFLT, LYD_WD_STATE, or LYD_WD_NONCONT.
+ * @return 1 if the subtree has the property, 0 if not.
+ */
+static int
+lyd_wd_subtree(struct lyout *out, const struct lyd_node *node, uint8_t prop)
+{
+    const struct lyd_node *child;
+    struct lyd_wd_rec rec, *found;
+    uint32_t hash = 0;
+    int r = 0;
+
+    switch (prop) {
+    case LYD_WD_NONDFLT:
         if (node->dflt) {
-            /* implicit default node */
             return 0;
-        } else if (node->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST)) {
-            if (lyd_wd_default((struct lyd_node_leaf_list *)node)) {
-                /* explicit default node */
-                return 0;
+        }
+        switch (node->schema->nodetype) {
+        case LYS_LEAF:
+        case LYS_LEAFLIST:
+            return lyd_wd_default((struct lyd_node_leaf_list *)node) ? 0 : 1;
+        case LYS_ANYDATA:
+        case LYS_ANYXML:
+        case LYS_NOTIF:
+        case LYS_ACTION:
+        case LYS_LIST:
+            return 1;
+        case LYS_CONTAINER:
+            if (((struct lys_node_container *)node->schema)->presence) {
+                return 1;
             }
-        } else if ((node->schema->nodetype & (LYS_CONTAINER)) && !((struct lys_node_container *)node->schema)->presence) {
-            /* get know if non-presence container contains non-default node */
-            for (subroot = node->child; subroot && !flag; subroot = subroot->next) {
-                LY_TREE_DFS_BEGIN(subroot, next, elem) {
-                    if (elem->dflt) {
-                        /* skip subtree */
-                        goto trim_dfs_nextsibling;
-                    }
-                    switch (elem->schema->nodetype) {
-                    case LYS_LEAF:
-                    case LYS_LEAFLIST:
-                        if (!lyd_wd_default((struct lyd_node_leaf_list *)elem)) {
-                            /* non-default node */
-                            flag = 1;
-                        }
-                        break;
-                    case LYS_ANYDATA:
-                    case LYS_ANYXML:
-                    case LYS_NOTIF:
-                    case LYS_ACTION:
-                    case LYS_LIST:
-                        /* non-default nodes */
-                        flag = 1;
-                        break;
-                    case LYS_CONTAINER:
-                        if (((struct lys_node_container *)elem->schema)->presence) {
-                            /* non-default node */
-                            flag = 1;
-                        }
-                        break;
-                    default:
-                        break;
-                    }
-                    if (flag) {
-                        break;
-                    }
-
-                    /* modified LY_TREE_DFS_END */
-                    /* select element for the next run - children first */
-                    /* child exception for leafs, leaflists and anyxml without children */
-                    if (elem->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST | LYS_ANYDATA)) {
-                        next = NULL;
-                    } else {
-                        next = elem->child;
-                    }
-                    if (!next) {
-trim_dfs_nextsibling:
-                        /* no children */
-                        if (elem == subroot) {
-                            /* we are done, (START) has no children */
-                            break;
-                        }
-                        /* try siblings */
-                        next = elem->next;
-                    }
-                    while (!next) {
-                        /* parent is already processed, go to its sibling */
-                        elem = elem->parent;
-                        /* no siblings, go back through parents */
-                        if (elem->parent == subroot->parent) {
-                            /* we are done, no next element to process */
-                            break;
-                        }
-                        next = elem->next;
-                    }
-                }
+            /* non-presence container, decided by its children */
+            break;
+        default:
+            return 0;
+        }
+        break;
+    case LYD_WD_STATE:
+        if (node->schema->flags & LYS_CONFIG_R) {
+            return 1;
+        } else if ((node->schema->nodetype & (LYS_CONTAINER | LYS_LIST)) && !(node->schema->flags & LYS_INCL_STATUS)) {
+            /* the schema does not allow any state data here */
+            return 0;
+        }
+        break;
+    case LYD_WD_NONCONT:
+        if (node->schema->nodetype != LYS_CONTAINER) {
+            return 1;
+        }
+        break;
+    }
+    if ((node->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST | LYS_ANYDATA)) || !node->child) {
+        return 0;
+    }
+
+    rec.node = node;
+    if (out) {
+        hash = lyd_wd_hash(node);
+        if (out->wd_ht && !lyht_find(out->wd_ht, &rec, hash, (void **)&found) && (found->known & prop)) {
+            return (found->props & prop) ? 1 : 0;
+        }
+    }
+
+    LY_TREE_FOR(node->child, child) {
+        if (lyd_wd_subtree(out, child, prop)) {
+            r = 1;
+            break;
+        }
+    }
+
+    if (out) {
+        /* the children could have been added meanwhile, search again */
+        if (out->wd_ht && !lyht_find(out->wd_ht, &rec, hash, (void **)&found)) {
+            found->known |= prop;
+            found->props |= r ? prop : 0;
+        } else {
+            if (!out->wd_ht) {
+                out->wd_ht = lyht_new(16, sizeof rec, lyd_wd_val_equal, NULL, 1);
             }
-            if (!flag) {
-                /* only default nodes in subtree, do not print the container */
-                return 0;
+            rec.known = prop;
+            rec.props = r ? prop : 0;
+            if (out->wd_ht) {
+                /* it is only an optimization, nothing is remembered on error */
+                lyht_insert(out->wd_ht, &rec, hash, NULL);
             }
         }
+    }
+    return r;
+}
+
+int
+lyd_wd_toprint(struct lyout *out, const struct lyd_node *node, int options)
+{
+    if ((options & LYP_CONFIG) && (node->schema->flags & LYS_CONFIG_R)) {
+        /* the whole state subtree is skipped */
+        return 0;
+    }
+
+    if (options & LYP_WD_TRIM) {
+        /* do not print default nodes, non-presence containers only with some non-default node */
+        if (!lyd_wd_subtree(out, node, LYD_WD_NONDFLT)
+                && (node->dflt || (node->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST | LYS_CONTAINER)))) {
+            return 0;
+        }
     } else if (node->dflt && !(options & LYP_WD_MASK) && !(node->schema->flags & LYS_CONFIG_R)) {
         /* LYP_WD_EXPLICIT
          * - print only if it contains status data in its subtree */
-        LY_TREE_DFS_BEGIN(node, next, elem) {
-            if (elem->schema->flags & LYS_CONFIG_R) {
-                flag = 1;
-                break;
-            }
-            LY_TREE_DFS_END(node, next, elem)
-        }
-        if (!flag) {
+        if ((options & LYP_CONFIG) || !lyd_wd_subtree(out, node, LYD_WD_STATE)) {
             return 0;
         }
     } else if (node->dflt && node->schema->nodetype == LYS_CONTAINER && !(options & LYP_KEEPEMPTYCONT)) {
         /* avoid empty default containers */
-        LY_TREE_DFS_BEGIN(node, next, elem) {
-            if (elem->schema->nodetype != LYS_CONTAINER) {
-                flag = 1;
-                break;
-            }
-            LY_TREE_DFS_END(node, next, elem)
-        }
-        if (!flag) {
+        if (!lyd_wd_subtree(out, node, LYD_WD_NONCONT)) {
             return 0;
         }
     }
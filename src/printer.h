@@ -15,6 +15,8 @@
 #ifndef LY_PRINTER_H_
 #define LY_PRINTER_H_
 
+#include <sys/uio.h>
+
 #include "libyang.h"
 #include "tree_schema.h"
 #include "tree_internal.h"
@@ -23,9 +25,31 @@ typedef enum LYOUT_TYPE {
     LYOUT_FD,          /**< file descriptor */
     LYOUT_STREAM,      /**< FILE stream */
     LYOUT_MEMORY,      /**< memory */
-    LYOUT_CALLBACK     /**< print via provided callback */
+    LYOUT_CALLBACK,    /**< print via provided callback */
+    LYOUT_IOVEC        /**< print segments via provided callback */
 } LYOUT_TYPE;
 
+#define LYOUT_IOV_BATCH 64     /**< number of segments passed to the LYOUT_IOVEC callback at once */
+#define LYOUT_IOV_REF_MIN 64   /**< minimal length of data referenced by a LYOUT_IOVEC segment instead of copying */
+
+/* segment of LYOUT_IOVEC output, either referencing the printed data or a part of the write buffer */
+struct lyout_seg {
+    const char *ref;   /* referenced data, NULL if copied into the write buffer */
+    size_t off;        /* offset of the copied data in the write buffer */
+    size_t len;
+};
+
+/* output of lyd_print_fd_nb() not written yet because the file descriptor would block */
+struct lyd_print_pending {
+    int fd;
+    char *buf;
+    size_t off;        /* length of the already written data */
+    size_t len;
+    size_t size;
+    size_t retry;      /* queued length when writing into the file descriptor is tried again */
+    int err;           /* errno of a failed write */
+};
+
 struct lyout {
     LYOUT_TYPE type;
     union {
@@ -40,6 +64,10 @@ struct lyout {
             ssize_t (*f)(void *arg, const void *buf, size_t count);
             void *arg;
         } clb;
+        struct {
+            ssize_t (*f)(void *arg, const struct iovec *iov, int iovcnt);
+            void *arg;
+        } iov;
     } method;
 
     /* buffer for holes */
@@ -49,8 +77,27 @@ struct lyout {
 
     /* hole counter */
     size_t hole_count;
+
+    /* write buffer for LYOUT_FD, LYOUT_CALLBACK and LYOUT_IOVEC, written out when it reaches LYOUT_BUF_FLUSH */
+    char *wbuf;
+    size_t wbuf_len;
+    size_t wbuf_size;
+
+    /* pending segments of LYOUT_IOVEC, written out when there are LYOUT_IOV_BATCH of them */
+    struct lyout_seg segs[LYOUT_IOV_BATCH];
+    int seg_count;
+
+    /* LYOUT_FD in the nonblocking mode, the data that cannot be written are queued here */
+    struct lyd_print_pending *nb;
+
+    /* with-defaults properties of the printed subtrees, see lyd_wd_toprint() */
+    struct hash_table *wd_ht;
 };
 
+#define LYOUT_BUF_MIN 256      /**< initial size of the output buffers */
+#define LYOUT_BUF_FLUSH 4096   /**< buffered length of LYOUT_FD and LYOUT_CALLBACK outputs to be written at once */
+#define LYOUT_NB_RETRY 65536   /**< length queued by a blocked nonblocking LYOUT_FD output before writing it is tried again */
+
 struct ext_substmt_info_s {
     const char *name;
     const char *arg;
@@ -67,7 +114,48 @@ extern struct ext_substmt_info_s ext_substmt_info[];
  */
 int ly_print(struct lyout *out, const char *format, ...);
 void ly_print_flush(struct lyout *out);
+
+/* flush the output and free all its buffers except the LYOUT_MEMORY result */
+void ly_print_clean(struct lyout *out);
 int ly_write(struct lyout *out, const char *buf, size_t count);
+/* write data that stay valid until the printing finishes, LYOUT_IOVEC references them instead of copying */
+int ly_write_ref(struct lyout *out, const char *buf, size_t count);
+/* print count spaces */
+int ly_print_indent(struct lyout *out, int count);
+
+/**
+ * @brief Print top-level siblings in several threads, see ly_ctx_set_print_threads().
+ *
+ * @param[in] out Output to write all the printed data to.
+ * @param[in] first First top-level node to print.
+ * @param[in] level Printer level of the top-level nodes.
+ * @param[in] options Printer options.
+ * @param[in] member_clb Callback deciding whether a sibling starts a separately printed part.
+ * @param[in] print_clb Callback printing a single part.
+ * @param[in] sep Separator printed between the parts.
+ * @return 0 on success, 1 if there are not enough parts or threads (nothing was printed), -1 on error.
+ */
+int ly_print_threads(struct lyout *out, const struct lyd_node *first, int level, int options,
+                     int (*member_clb)(const struct lyd_node *first, const struct lyd_node *node, int options),
+                     int (*print_clb)(struct lyout *out, int level, const struct lyd_node *node, int options),
+                     const char *sep);
+/* list instances produced one by one by the callback of lyd_print_gen() */
+struct ly_print_gen {
+    const struct lys_node *list;
+    lyd_print_gen_clb clb;
+    void *user_data;
+    struct lyd_node *instance;     /* the last produced instance, freed when producing the next one */
+};
+
+/**
+ * @brief Free the last produced list instance and produce the next one.
+ *
+ * @param[in] out Output the instances are printed to.
+ * @param[in] gen Instance producer.
+ * @return 0 on success, 1 if there are no more instances, -1 on error.
+ */
+int ly_print_gen_next(struct lyout *out, struct ly_print_gen *gen);
+
 int ly_write_skip(struct lyout *out, size_t count, size_t *position);
 int ly_write_skipped(struct lyout *out, size_t position, const char *buf, size_t count);
 
@@ -83,8 +171,20 @@ int jsons_print_model(struct lyout *out, const struct lys_module *module, const
 int json_print_data(struct lyout *out, const struct lyd_node *root, int options);
 int xml_print_data(struct lyout *out, const struct lyd_node *root, int options);
 int xml_print_node(struct lyout *out, int level, const struct lyd_node *node, int toplevel, int options);
+int json_print_page(struct lyout *out, const struct lyd_node **parents, int depth, const struct lyd_node *first,
+                    uint32_t count, int options);
+int xml_print_page(struct lyout *out, const struct lyd_node **parents, int depth, const struct lyd_node *first,
+                   uint32_t count, int options);
+int json_print_gen(struct lyout *out, const struct lyd_node **parents, int depth, struct ly_print_gen *gen, int options);
+int xml_print_gen(struct lyout *out, const struct lyd_node **parents, int depth, struct ly_print_gen *gen, int options);
 int lyb_print_data(struct lyout *out, const struct lyd_node *root, int options);
 
+int lyb_print_patch(struct lyout *out, const struct lyd_difflist *diff, int options);
+
+int lyb_print_stream_header(struct lyout *out, struct lyd_lyb_stream *stream);
+
+int lyb_print_stream_frame(struct lyout *out, struct lyd_lyb_stream *stream, const struct lyd_node *root, int options);
+
 int lys_print_target(struct lyout *out, const struct lys_module *module, const char *target_schema_path,
                      void (*clb_print_typedef)(struct lyout*, const struct lys_tpdf*, int*),
                      void (*clb_print_identity)(struct lyout*, const struct lys_ident*, int*),
@@ -105,10 +205,11 @@ int lys_print_target(struct lyout *out, const struct lys_module *module, const c
                      void (*clb_print_output)(struct lyout*, const struct lys_node*, int*));
 
 /**
- * get know if the node is supposed to be printed according to the specified with-default mode
+ * get know if the node is supposed to be printed according to the specified with-default mode and #LYP_CONFIG,
+ * the searched subtrees are remembered in \p out (if set) so the whole tree is searched only once
  * return 1 - print, 0 - do not print
  */
-int lyd_wd_toprint(const struct lyd_node *node, int options);
+int lyd_wd_toprint(struct lyout *out, const struct lyd_node *node, int options);
 
 /* 0 - same, 1 - different */
 int nscmp(const struct lyd_node *node1, const struct lyd_node *node2);
@@ -30,40 +30,85 @@
 static int json_print_nodes(struct lyout *out, int level, const struct lyd_node *root, int withsiblings, int toplevel,
                             int options);
 
-int
-json_print_string(struct lyout *out, const char *text)
+static int
+json_print_text(struct lyout *out, const char *text, int ref)
 {
-    unsigned int i, n;
+    unsigned int i, n, len;
 
     if (!text) {
         return 0;
     }
 
     ly_write(out, "\"", 1);
-    for (i = n = 0; text[i]; i++) {
-        const unsigned char ascii = text[i];
-        if (ascii < 0x20) {
-            /* control character */
-            n += ly_print(out, "\\u%.4X", ascii);
-        } else {
-            switch (ascii) {
-            case '"':
-                n += ly_print(out, "\\\"");
-                break;
-            case '\\':
-                n += ly_print(out, "\\\\");
-                break;
-            default:
-                ly_write(out, &text[i], 1);
-                n++;
+    for (i = n = 0; text[i]; ) {
+        /* print the longest run of characters without escaping at once */
+        for (len = 0; ((unsigned char)text[i + len] >= 0x20) && (text[i + len] != '"') && (text[i + len] != '\\');
+                ++len);
+        if (len) {
+            if (ref) {
+                ly_write_ref(out, &text[i], len);
+            } else {
+                ly_write(out, &text[i], len);
             }
+            n += len;
+            i += len;
+            continue;
         }
+
+        switch (text[i]) {
+        case '"':
+            ly_write(out, "\\\"", 2);
+            n += 2;
+            break;
+        case '\\':
+            ly_write(out, "\\\\", 2);
+            n += 2;
+            break;
+        default:
+            /* control character */
+            n += ly_print(out, "\\u%.4X", (unsigned char)text[i]);
+            break;
+        }
+        ++i;
     }
     ly_write(out, "\"", 1);
 
     return n + 2;
 }
 
+int
+json_print_string(struct lyout *out, const char *text)
+{
+    return json_print_text(out, text, 0);
+}
+
+/* print a string stored in the data tree, it can be referenced by the output */
+static int
+json_print_value(struct lyout *out, const char *text)
+{
+    return json_print_text(out, text, 1);
+}
+
+/* print the member name of a data node, returns the module name if it was printed */
+static const char *
+json_print_member(struct lyout *out, int level, const struct lyd_node *node, int toplevel)
+{
+    const char *mod_name = NULL;
+
+    ly_print_indent(out, LEVEL);
+    ly_write(out, "\"", 1);
+    if (toplevel || !node->parent || nscmp(node, node->parent)) {
+        /* print "namespace" */
+        mod_name = lys_node_module(node->schema)->name;
+        ly_write(out, mod_name, strlen(mod_name));
+        ly_write(out, ":", 1);
+    }
+    ly_write(out, node->schema->name, strlen(node->schema->name));
+    ly_write(out, "\":", 2);
+
+    return mod_name;
+}
+
 static int
 json_print_attrs(struct lyout *out, int level, const struct lyd_node *node, const struct lys_module *wdmod)
 {
@@ -95,7 +140,7 @@ json_print_attrs(struct lyout *out, int level, const struct lyd_node *node, cons
         case LY_TYPE_INT64:
         case LY_TYPE_UINT64:
         case LY_TYPE_DEC64:
-            json_print_string(out, attr->value_str);
+            json_print_value(out, attr->value_str);
             break;
 
         case LY_TYPE_INT8:
@@ -117,7 +162,7 @@ json_print_attrs(struct lyout *out, int level, const struct lyd_node *node, cons
                 /* do not print the prefix, it is the default prefix for this node */
                 json_print_string(out, ++p);
             } else {
-                json_print_string(out, attr->value_str);
+                json_print_value(out, attr->value_str);
             }
             break;
 
@@ -155,12 +200,9 @@ json_print_leaf(struct lyout *out, int level, const struct lyd_node *node, int o
     }
 
     if (!onlyvalue) {
-        if (toplevel || !node->parent || nscmp(node, node->parent)) {
-            /* print "namespace" */
-            schema = lys_node_module(node->schema)->name;
-            ly_print(out, "%*s\"%s:%s\":%s", LEVEL, INDENT, schema, node->schema->name, (level ? " " : ""));
-        } else {
-            ly_print(out, "%*s\"%s\":%s", LEVEL, INDENT, node->schema->name, (level ? " " : ""));
+        schema = json_print_member(out, level, node, toplevel);
+        if (level) {
+            ly_write(out, " ", 1);
         }
     }
 
@@ -176,7 +218,7 @@ contentprint:
     case LY_TYPE_UINT64:
     case LY_TYPE_UNION:
     case LY_TYPE_DEC64:
-        json_print_string(out, leaf->value_str);
+        json_print_value(out, leaf->value_str);
         break;
 
     case LY_TYPE_INT8:
@@ -198,7 +240,7 @@ contentprint:
             /* do not print the prefix, it is the default prefix for this node */
             json_print_string(out, ++p);
         } else {
-            json_print_string(out, leaf->value_str);
+            json_print_value(out, leaf->value_str);
         }
         break;
 
@@ -252,15 +294,8 @@ contentprint:
 static int
 json_print_container(struct lyout *out, int level, const struct lyd_node *node, int toplevel, int options)
 {
-    const char *schema;
-
-    if (toplevel || !node->parent || nscmp(node, node->parent)) {
-        /* print "namespace" */
-        schema = lys_node_module(node->schema)->name;
-        ly_print(out, "%*s\"%s:%s\":%s{%s", LEVEL, INDENT, schema, node->schema->name, (level ? " " : ""), (level ? "\n" : ""));
-    } else {
-        ly_print(out, "%*s\"%s\":%s{%s", LEVEL, INDENT, node->schema->name, (level ? " " : ""), (level ? "\n" : ""));
-    }
+    json_print_member(out, level, node, toplevel);
+    ly_print(out, "%s{%s", (level ? " " : ""), (level ? "\n" : ""));
     if (level) {
         level++;
     }
@@ -285,25 +320,57 @@ json_print_container(struct lyout *out, int level, const struct lyd_node *node,
     return EXIT_SUCCESS;
 }
 
+/* limit - maximum number of instances to print, 0 for all */
+/**
+ * @brief Print a list instance as a member of the list array.
+ */
+static int
+json_print_list_instance(struct lyout *out, int level, const struct lyd_node *list, int options)
+{
+    if (level) {
+        ++level;
+    }
+    ly_print(out, "%*s{%s", LEVEL, INDENT, (level ? "\n" : ""));
+    if (level) {
+        ++level;
+    }
+    if (list->attr) {
+        ly_print(out, "%*s\"@\":%s{%s", LEVEL, INDENT, (level ? " " : ""), (level ? "\n" : ""));
+        if (json_print_attrs(out, (level ? level + 1 : level), list, NULL)) {
+            return EXIT_FAILURE;
+        }
+        if (list->child) {
+            ly_print(out, "%*s},%s", LEVEL, INDENT, (level ? "\n" : ""));
+        } else {
+            ly_print(out, "%*s}", LEVEL, INDENT);
+        }
+    }
+    if (json_print_nodes(out, level, list->child, 1, 0, options)) {
+        return EXIT_FAILURE;
+    }
+    if (level) {
+        --level;
+    }
+    ly_print(out, "%*s}", LEVEL, INDENT);
+
+    return EXIT_SUCCESS;
+}
+
 static int
-json_print_leaf_list(struct lyout *out, int level, const struct lyd_node *node, int is_list, int toplevel, int options)
+json_print_leaf_list(struct lyout *out, int level, const struct lyd_node *node, int is_list, int toplevel, int options,
+                     uint32_t limit)
 {
     const char *schema = NULL;
     const struct lyd_node *list = node;
     int flag_empty = 0, flag_attrs = 0;
+    uint32_t i;
 
     if (is_list && !list->child) {
         /* empty, e.g. in case of filter */
         flag_empty = 1;
     }
 
-    if (toplevel || !node->parent || nscmp(node, node->parent)) {
-        /* print "namespace" */
-        schema = lys_node_module(node->schema)->name;
-        ly_print(out, "%*s\"%s:%s\":", LEVEL, INDENT, schema, node->schema->name);
-    } else {
-        ly_print(out, "%*s\"%s\":", LEVEL, INDENT, node->schema->name);
-    }
+    schema = json_print_member(out, level, node, toplevel);
 
     if (flag_empty) {
         ly_print(out, "%snull", (level ? " " : ""));
@@ -315,37 +382,12 @@ json_print_leaf_list(struct lyout *out, int level, const struct lyd_node *node,
         ++level;
     }
 
-    while (list) {
+    for (i = 1; list; ++i) {
         if (is_list) {
             /* list print */
-            if (level) {
-                ++level;
-            }
-            ly_print(out, "%*s{%s", LEVEL, INDENT, (level ? "\n" : ""));
-            if (level) {
-                ++level;
-            }
-            if (list->attr) {
-                ly_print(out, "%*s\"@\":%s{%s", LEVEL, INDENT, (level ? " " : ""), (level ? "\n" : ""));
-                if (json_print_attrs(out, (level ? level + 1 : level), list, NULL)) {
-                    return EXIT_FAILURE;
-                }
-                if (list->child) {
-                    ly_print(out, "%*s},%s", LEVEL, INDENT, (level ? "\n" : ""));
-                } else {
-                    ly_print(out, "%*s}", LEVEL, INDENT);
-                }
-            }
-            if (json_print_nodes(out, level, list->child, 1, 0, options)) {
+            if (json_print_list_instance(out, level, list, options)) {
                 return EXIT_FAILURE;
             }
-            if (level) {
-                --level;
-            }
-            ly_print(out, "%*s}", LEVEL, INDENT);
-            if (level) {
-                --level;
-            }
         } else {
             /* leaf-list print */
             ly_print(out, "%*s", LEVEL, INDENT);
@@ -360,6 +402,9 @@ json_print_leaf_list(struct lyout *out, int level, const struct lyd_node *node,
             /* if initially called without LYP_WITHSIBLINGS do not print other list entries */
             break;
         }
+        if (limit && (i == limit)) {
+            break;
+        }
         for (list = list->next; list && list->schema != node->schema; list = list->next);
         if (list) {
             ly_print(out, ",%s", (level ? "\n" : ""));
@@ -384,7 +429,7 @@ json_print_leaf_list(struct lyout *out, int level, const struct lyd_node *node,
         if (level) {
             level++;
         }
-        for (list = node; list; ) {
+        for (list = node, i = 1; list; ++i) {
             if (list->attr) {
                 ly_print(out, "%*s{%s", LEVEL, INDENT, (level ? " " : ""));
                 if (json_print_attrs(out, 0, list, NULL)) {
@@ -395,7 +440,9 @@ json_print_leaf_list(struct lyout *out, int level, const struct lyd_node *node,
                 ly_print(out, "%*snull", LEVEL, INDENT);
             }
 
-
+            if (limit && (i == limit)) {
+                break;
+            }
             for (list = list->next; list && list->schema != node->schema; list = list->next);
             if (list) {
                 ly_print(out, ",%s", (level ? "\n" : ""));
@@ -418,13 +465,7 @@ json_print_anydataxml(struct lyout *out, int level, const struct lyd_node *node,
     char *buf;
     const char *schema = NULL;
 
-    if (toplevel || !node->parent || nscmp(node, node->parent)) {
-        /* print "namespace" */
-        schema = lys_node_module(node->schema)->name;
-        ly_print(out, "%*s\"%s:%s\":", LEVEL, INDENT, schema, node->schema->name);
-    } else {
-        ly_print(out, "%*s\"%s\":", LEVEL, INDENT, node->schema->name);
-    }
+    schema = json_print_member(out, level, node, toplevel);
     if (level) {
         level++;
     }
@@ -465,7 +506,7 @@ json_print_anydataxml(struct lyout *out, int level, const struct lyd_node *node,
             ly_print(out, " ");
         }
         if (any->value.str) {
-            json_print_string(out, any->value.str);
+            json_print_value(out, any->value.str);
         } else {
             ly_print(out, "\"\"");
         }
@@ -505,89 +546,261 @@ json_print_anydataxml(struct lyout *out, int level, const struct lyd_node *node,
     return EXIT_SUCCESS;
 }
 
+/* is the node printed as a separate member (lists and leaf-lists are printed with their first instance) */
+static int
+json_print_is_member(const struct lyd_node *root, const struct lyd_node *node)
+{
+    const struct lyd_node *iter;
+
+    if ((node->schema->nodetype & (LYS_LIST | LYS_LEAFLIST)) && (node != root)) {
+        /* is it already printed? (root node is not) */
+        for (iter = node->prev; iter->next; iter = iter->prev) {
+            if (iter->schema == node->schema) {
+                /* the list has alread some previous instance and therefore it is already printed */
+                return 0;
+            }
+        }
+    }
+
+    return 1;
+}
+
+static int
+json_print_member_node(struct lyout *out, int level, const struct lyd_node *node, int toplevel, int options)
+{
+    switch (node->schema->nodetype) {
+    case LYS_RPC:
+    case LYS_ACTION:
+    case LYS_NOTIF:
+    case LYS_CONTAINER:
+        return json_print_container(out, level, node, toplevel, options);
+    case LYS_LEAF:
+        return json_print_leaf(out, level, node, 0, toplevel, options);
+    case LYS_LEAFLIST:
+    case LYS_LIST:
+        /* print the list/leaflist */
+        return json_print_leaf_list(out, level, node, node->schema->nodetype == LYS_LIST ? 1 : 0, toplevel, options,
+                                    0);
+    case LYS_ANYXML:
+    case LYS_ANYDATA:
+        return json_print_anydataxml(out, level, node, toplevel, options);
+    default:
+        LOGINT(node->schema->module->ctx);
+        return EXIT_FAILURE;
+    }
+}
+
 static int
 json_print_nodes(struct lyout *out, int level, const struct lyd_node *root, int withsiblings, int toplevel, int options)
 {
-    int ret = EXIT_SUCCESS,comma_flag = 0;
-    const struct lyd_node *node, *iter;
+    int ret = EXIT_SUCCESS, comma_flag = 0;
+    const struct lyd_node *node;
 
     LY_TREE_FOR(root, node) {
-        if (!lyd_wd_toprint(node, options)) {
+        if (!lyd_wd_toprint(out, node, options)) {
             /* wd says do not print */
             continue;
         }
 
-        switch (node->schema->nodetype) {
-        case LYS_RPC:
-        case LYS_ACTION:
-        case LYS_NOTIF:
-        case LYS_CONTAINER:
+        if (json_print_is_member(root, node)) {
             if (comma_flag) {
                 /* print the previous comma */
                 ly_print(out, ",%s", (level ? "\n" : ""));
             }
-            ret = json_print_container(out, level, node, toplevel, options);
+            ret = json_print_member_node(out, level, node, toplevel, options);
+        }
+
+        if (!withsiblings) {
             break;
-        case LYS_LEAF:
-            if (comma_flag) {
-                /* print the previous comma */
-                ly_print(out, ",%s", (level ? "\n" : ""));
+        }
+        comma_flag = 1;
+    }
+    if (root && level) {
+        ly_print(out, "\n");
+    }
+
+    return ret;
+}
+
+static int
+json_print_thread_member(const struct lyd_node *first, const struct lyd_node *node, int options)
+{
+    return lyd_wd_toprint(NULL, node, options) && json_print_is_member(first, node);
+}
+
+static int
+json_print_thread_node(struct lyout *out, int level, const struct lyd_node *node, int options)
+{
+    return json_print_member_node(out, level, node, 1, options);
+}
+
+/**
+ * @brief Print the start of a page and its ancestors, list instances with their keys.
+ *
+ * @param[in,out] level Level of the page.
+ * @param[out] members Whether the innermost ancestor has some members (keys) printed.
+ * @return 0 on success, -1 on error.
+ */
+static int
+json_print_page_open(struct lyout *out, const struct lyd_node **parents, int depth, int options, int *level,
+                     int *members)
+{
+    const struct lyd_node *key;
+    struct lys_node_list *slist;
+    int i, k;
+
+    ly_print(out, "{%s", (*level ? "\n" : ""));
+
+    *members = 0;
+    for (i = 0; i < depth; ++i) {
+        json_print_member(out, *level, parents[i], !i);
+        if (parents[i]->schema->nodetype == LYS_LIST) {
+            ly_print(out, "%s[%s", (*level ? " " : ""), (*level ? "\n" : ""));
+            if (*level) {
+                ++(*level);
             }
-            ret = json_print_leaf(out, level, node, 0, toplevel, options);
-            break;
-        case LYS_LEAFLIST:
-        case LYS_LIST:
-            /* is it already printed? (root node is not) */
-            for (iter = node->prev; iter->next && node != root; iter = iter->prev) {
-                if (iter == node) {
-                    continue;
+            ly_print(out, "%*s{%s", (*level) * 2, INDENT, (*level ? "\n" : ""));
+            if (*level) {
+                ++(*level);
+            }
+
+            slist = (struct lys_node_list *)parents[i]->schema;
+            for (k = 0, key = parents[i]->child;
+                    key && (k < slist->keys_size) && (key->schema == (struct lys_node *)slist->keys[k]);
+                    ++k, key = key->next) {
+                if (k) {
+                    ly_print(out, ",%s", (*level ? "\n" : ""));
                 }
-                if (iter->schema == node->schema) {
-                    /* the list has alread some previous instance and therefore it is already printed */
-                    break;
+                if (json_print_leaf(out, *level, key, 0, 0, options)) {
+                    return -1;
                 }
             }
-            if (!iter->next || node == root) {
-                if (comma_flag) {
-                    /* print the previous comma */
-                    ly_print(out, ",%s", (level ? "\n" : ""));
-                }
-
-                /* print the list/leaflist */
-                ret = json_print_leaf_list(out, level, node, node->schema->nodetype == LYS_LIST ? 1 : 0, toplevel, options);
+            *members = k;
+        } else {
+            ly_print(out, "%s{%s", (*level ? " " : ""), (*level ? "\n" : ""));
+            if (*level) {
+                ++(*level);
             }
-            break;
-        case LYS_ANYXML:
-        case LYS_ANYDATA:
-            if (comma_flag) {
-                /* print the previous comma */
-                ly_print(out, ",%s", (level ? "\n" : ""));
+            *members = 0;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Print the end of a page and its ancestors.
+ */
+static void
+json_print_page_close(struct lyout *out, const struct lyd_node **parents, int depth, int level, int members)
+{
+    int i;
+
+    if (members && level) {
+        ly_print(out, "\n");
+    }
+
+    for (i = depth - 1; i > -1; --i) {
+        if (level) {
+            --level;
+        }
+        ly_print(out, "%*s}%s", LEVEL, INDENT, (level ? "\n" : ""));
+        if (parents[i]->schema->nodetype == LYS_LIST) {
+            if (level) {
+                --level;
             }
-            ret = json_print_anydataxml(out, level, node, toplevel, options);
-            break;
-        default:
-            LOGINT(node->schema->module->ctx);
-            ret = EXIT_FAILURE;
-            break;
+            ly_print(out, "%*s]%s", LEVEL, INDENT, (level ? "\n" : ""));
         }
+    }
 
-        if (!withsiblings) {
-            break;
+    /* end */
+    ly_print(out, "}%s", (level ? "\n" : ""));
+
+    ly_print_flush(out);
+}
+
+int
+json_print_page(struct lyout *out, const struct lyd_node **parents, int depth, const struct lyd_node *first,
+                uint32_t count, int options)
+{
+    int level = 0, members;
+
+    if (options & LYP_FORMAT) {
+        ++level;
+    }
+
+    /* start and the ancestors */
+    if (json_print_page_open(out, parents, depth, options, &level, &members)) {
+        return EXIT_FAILURE;
+    }
+    if (members) {
+        ly_print(out, ",%s", (level ? "\n" : ""));
+    }
+
+    /* the page itself */
+    if (json_print_leaf_list(out, level, first, first->schema->nodetype == LYS_LIST ? 1 : 0, !depth,
+                             options | LYP_WITHSIBLINGS, count)) {
+        return EXIT_FAILURE;
+    }
+
+    json_print_page_close(out, parents, depth, level, 1);
+    return EXIT_SUCCESS;
+}
+
+int
+json_print_gen(struct lyout *out, const struct lyd_node **parents, int depth, struct ly_print_gen *gen, int options)
+{
+    const struct lys_module *mod;
+    int level = 0, members, r, first;
+
+    if (options & LYP_FORMAT) {
+        ++level;
+    }
+
+    if (json_print_page_open(out, parents, depth, options, &level, &members)) {
+        return EXIT_FAILURE;
+    }
+
+    r = ly_print_gen_next(out, gen);
+    if (!r) {
+        if (members) {
+            ly_print(out, ",%s", (level ? "\n" : ""));
         }
-        comma_flag = 1;
+        members = 1;
+
+        /* the instances have no parent, decide about the namespace here */
+        mod = lys_node_module(gen->list);
+        if (!depth || (lyd_node_module(parents[depth - 1]) != mod)) {
+            ly_print(out, "%*s\"%s:%s\":", LEVEL, INDENT, mod->name, gen->list->name);
+        } else {
+            ly_print(out, "%*s\"%s\":", LEVEL, INDENT, gen->list->name);
+        }
+        ly_print(out, "%s[%s", (level ? " " : ""), (level ? "\n" : ""));
+
+        /* every instance printed and freed before the next one is produced */
+        for (first = 1; !r; r = ly_print_gen_next(out, gen), first = 0) {
+            if (!first) {
+                ly_print(out, ",%s", (level ? "\n" : ""));
+            }
+            if (json_print_list_instance(out, level, gen->instance, options)) {
+                return EXIT_FAILURE;
+            }
+        }
+        ly_print(out, "%s%*s]", (level ? "\n" : ""), LEVEL, INDENT);
     }
-    if (root && level) {
-        ly_print(out, "\n");
+    if (r == -1) {
+        return EXIT_FAILURE;
     }
 
-    return ret;
+    json_print_page_close(out, parents, depth, level, members);
+    return EXIT_SUCCESS;
 }
 
 int
 json_print_data(struct lyout *out, const struct lyd_node *root, int options)
 {
     const struct lyd_node *node, *next;
-    int level = 0, action_input = 0;
+    int level = 0, action_input = 0, r;
 
     if (options & LYP_FORMAT) {
         ++level;
@@ -627,7 +840,17 @@ json_print_data(struct lyout *out, const struct lyd_node *root, int options)
     }
 
     /* content */
-    if (json_print_nodes(out, level, root, options & LYP_WITHSIBLINGS, 1, options)) {
+    r = 1;
+    if (root && (options & LYP_WITHSIBLINGS) && !(options & LYP_NETCONF)) {
+        r = ly_print_threads(out, root, level, options, json_print_thread_member, json_print_thread_node,
+                             level ? ",\n" : ",");
+        if (r == -1) {
+            return EXIT_FAILURE;
+        } else if (!r && level) {
+            ly_print(out, "\n");
+        }
+    }
+    if (r && json_print_nodes(out, level, root, options & LYP_WITHSIBLINGS, 1, options)) {
         return EXIT_FAILURE;
     }
 
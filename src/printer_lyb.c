@@ -46,6 +46,7 @@
 #endif
 
 #include "common.h"
+#include "context.h"
 #include "printer.h"
 #include "tree_schema.h"
 #include "tree_data.h"
@@ -319,6 +320,120 @@ lyb_hash_siblings(struct lys_node *sibling, const struct lys_module **models, in
     return ht;
 }
 
+#ifdef LY_ENABLED_CACHE
+
+/* hash table of schema siblings cached in the context */
+struct lyb_sib_ht_rec {
+    struct lys_node *first_sibling;
+    int options;                        /* LYD_OPT_RPC or LYD_OPT_RPCREPLY the siblings were hashed for */
+    struct hash_table *ht;
+};
+
+static int
+lyb_sib_ht_equal(void *val1_p, void *val2_p, int UNUSED(mod), void *UNUSED(cb_data))
+{
+    struct lyb_sib_ht_rec *rec1 = (struct lyb_sib_ht_rec *)val1_p, *rec2 = (struct lyb_sib_ht_rec *)val2_p;
+
+    return (rec1->first_sibling == rec2->first_sibling) && (rec1->options == rec2->options);
+}
+
+static void
+lyb_sib_ht_free(struct hash_table *ht)
+{
+    struct ht_rec *ht_rec;
+    uint32_t i;
+
+    for (i = 0; i < ht->size; ++i) {
+        if (ht->ctrl[i] & LYHT_CTRL_FULL) {
+            ht_rec = lyht_get_rec(ht->recs, ht->rec_size, i);
+            lyht_free(((struct lyb_sib_ht_rec *)ht_rec->val)->ht);
+        }
+    }
+    lyht_free(ht);
+}
+
+/**
+ * @brief Get the hash table of schema siblings, created only once for each module set.
+ *
+ * @param[in] ctx Context to cache the hash table in.
+ * @param[in] first_sibling First schema sibling.
+ * @param[in] options Printer options.
+ * @return Sibling hash table owned by the context, NULL on error.
+ */
+static struct hash_table *
+lyb_sib_ht_get(struct ly_ctx *ctx, struct lys_node *first_sibling, int options)
+{
+    struct lyb_sib_ht_rec rec, *match;
+    struct hash_table *ht = NULL;
+    uint32_t hash;
+
+    rec.first_sibling = first_sibling;
+    rec.options = options & (LYD_OPT_RPC | LYD_OPT_RPCREPLY);
+    rec.ht = NULL;
+    hash = dict_hash_multi(0, (const char *)&rec.first_sibling, sizeof rec.first_sibling);
+    hash = dict_hash_multi(hash, (const char *)&rec.options, sizeof rec.options);
+    hash = dict_hash_multi(hash, NULL, 0);
+
+    pthread_rwlock_rdlock(&ctx->lyb_hash_lock);
+    if (ctx->lyb_hash && (ctx->lyb_hash_set_id == ctx->models.module_set_id)
+            && !lyht_find(ctx->lyb_hash, &rec, hash, (void **)&match)) {
+        ht = match->ht;
+    }
+    pthread_rwlock_unlock(&ctx->lyb_hash_lock);
+    if (ht) {
+        return ht;
+    }
+
+    pthread_rwlock_wrlock(&ctx->lyb_hash_lock);
+    if (ctx->lyb_hash && (ctx->lyb_hash_set_id != ctx->models.module_set_id)) {
+        /* the schema could have changed, the siblings may not even exist anymore */
+        lyb_sib_ht_free(ctx->lyb_hash);
+        ctx->lyb_hash = NULL;
+    }
+    if (!ctx->lyb_hash) {
+        ctx->lyb_hash = lyht_new(8, sizeof rec, lyb_sib_ht_equal, NULL, 1);
+        LY_CHECK_ERR_GOTO(!ctx->lyb_hash, LOGMEM(ctx), unlock);
+        ctx->lyb_hash_set_id = ctx->models.module_set_id;
+    }
+
+    if (!lyht_find(ctx->lyb_hash, &rec, hash, (void **)&match)) {
+        /* created by another thread meanwhile */
+        ht = match->ht;
+        goto unlock;
+    }
+
+    rec.ht = lyb_hash_siblings(first_sibling, NULL, 0, options);
+    if (!rec.ht) {
+        goto unlock;
+    }
+    if (lyht_insert(ctx->lyb_hash, &rec, hash, NULL) == -1) {
+        lyht_free(rec.ht);
+        goto unlock;
+    }
+    ht = rec.ht;
+
+unlock:
+    pthread_rwlock_unlock(&ctx->lyb_hash_lock);
+    return ht;
+}
+
+#endif
+
+void
+lyb_sib_ht_clear(struct ly_ctx *ctx)
+{
+#ifdef LY_ENABLED_CACHE
+    pthread_rwlock_wrlock(&ctx->lyb_hash_lock);
+    if (ctx->lyb_hash) {
+        lyb_sib_ht_free(ctx->lyb_hash);
+        ctx->lyb_hash = NULL;
+    }
+    pthread_rwlock_unlock(&ctx->lyb_hash_lock);
+#else
+    (void)ctx;
+#endif
+}
+
 static LYB_HASH
 lyb_hash_find(struct hash_table *ht, struct lys_node *node)
 {
@@ -542,6 +657,122 @@ lyb_write_string(const char *str, size_t str_len, int with_length, struct lyout
     return ret;
 }
 
+static int
+lyb_write_varnum(uint32_t num, struct lyout *out, struct lyb_state *lybs)
+{
+    int r, ret = 0;
+    uint8_t byte;
+
+    /* 7 bits in every byte, the highest bit set if another byte follows */
+    do {
+        byte = num & 0x7f;
+        num >>= 7;
+        if (num) {
+            byte |= 0x80;
+        }
+        ret += (r = lyb_write(out, &byte, sizeof byte, lybs));
+        if (r < 0) {
+            return -1;
+        }
+    } while (num);
+
+    return ret;
+}
+
+/* string table record, the strings are in the dictionary so they are compared by their pointers */
+struct lyb_str_rec {
+    const char *str;
+    uint32_t idx;
+};
+
+static int
+lyb_str_rec_equal(void *val1_p, void *val2_p, int UNUSED(mod), void *UNUSED(cb_data))
+{
+    return ((struct lyb_str_rec *)val1_p)->str == ((struct lyb_str_rec *)val2_p)->str;
+}
+
+/* write a string value until the end of the chunk, using the string table if enabled */
+static int
+lyb_write_value_string(const char *str, struct lyout *out, struct lyb_state *lybs)
+{
+    int r, ret = 0;
+    struct lyb_str_rec rec, *match;
+    uint32_t hash;
+
+    if (!lybs->str_table) {
+        return lyb_write_string(str, 0, 0, out, lybs);
+    }
+
+    rec.str = str;
+    rec.idx = lybs->str_count;
+    hash = dict_hash_multi(0, (const char *)&rec.str, sizeof rec.str);
+    hash = dict_hash_multi(hash, NULL, 0);
+
+    if (!lybs->str_ht) {
+        lybs->str_ht = lyht_new(64, sizeof rec, lyb_str_rec_equal, NULL, 1);
+        LY_CHECK_ERR_RETURN(!lybs->str_ht, LOGMEM(NULL), -1);
+    }
+    switch (lyht_insert(lybs->str_ht, &rec, hash, (void **)&match)) {
+    case 0:
+        /* new string */
+        ++lybs->str_count;
+        ret += (r = lyb_write_varnum(0, out, lybs));
+        if (r < 0) {
+            return -1;
+        }
+        ret += (r = lyb_write_string(str, 0, 0, out, lybs));
+        if (r < 0) {
+            return -1;
+        }
+        break;
+    case 1:
+        /* already written */
+        ret += (r = lyb_write_varnum(match->idx + 1, out, lybs));
+        if (r < 0) {
+            return -1;
+        }
+        break;
+    default:
+        return -1;
+    }
+
+    return ret;
+}
+
+static int
+lyb_write_ident(const struct lys_ident *ident, struct lyout *out, struct lyb_state *lybs)
+{
+    int r, ret = 0;
+    const struct lys_module *mod;
+    uint32_t idx;
+    uint8_t i;
+
+    /* identities of submodules are indexed after the main module ones, in the order of the includes */
+    mod = lys_main_module(ident->module);
+    if (ident->module == mod) {
+        idx = ident - mod->ident;
+    } else {
+        idx = mod->ident_size;
+        for (i = 0; (i < mod->inc_size) && ((struct lys_module *)mod->inc[i].submodule != ident->module); ++i) {
+            idx += mod->inc[i].submodule->ident_size;
+        }
+        assert(i < mod->inc_size);
+        idx += ident - mod->inc[i].submodule->ident;
+    }
+
+    ret += (r = lyb_write_varnum(idx, out, lybs));
+    if (r < 0) {
+        return -1;
+    }
+    /* module name is a dictionary string so it can be in the string table, it must be last (no length) */
+    ret += (r = lyb_write_value_string(mod->name, out, lybs));
+    if (r < 0) {
+        return -1;
+    }
+
+    return ret;
+}
+
 static int
 lyb_print_model(struct lyout *out, const struct lys_module *mod, struct lyb_state *lybs)
 {
@@ -581,6 +812,21 @@ lyb_print_model(struct lyout *out, const struct lys_module *mod, struct lyb_stat
     return ret;
 }
 
+static int
+lyb_print_stream_model(struct lyout *out, const struct lys_module *mod, struct lyb_state *lybs)
+{
+    int i;
+
+    for (i = 0; i < lybs->mod_count; ++i) {
+        if (lybs->models[i] == mod) {
+            return lyb_write_number(i, 2, out, lybs);
+        }
+    }
+
+    LOGERR(mod->ctx, LY_EINVAL, "Module \"%s\" is not in the LYB stream header.", mod->name);
+    return -1;
+}
+
 static int
 is_added_model(const struct lys_module **models, size_t mod_count, const struct lys_module *mod)
 {
@@ -606,63 +852,59 @@ add_model(const struct lys_module ***models, size_t *mod_count, const struct lys
     (*models)[*mod_count - 1] = mod;
 }
 
-static int
-lyb_print_data_models(struct lyout *out, const struct lyd_node *root, struct lyb_state *lybs)
+/* add all models augmenting or deviating the used models */
+static void
+lyb_add_dependent_models(struct ly_ctx *ctx, const struct lys_module ***models, size_t *mod_count)
 {
-    int ret = 0;
-    const struct lys_module **models = NULL, *mod;
+    const struct lys_module *mod;
     const struct lys_submodule *submod;
-    const struct lyd_node *node;
-    size_t mod_count = 0;
-    uint32_t idx = 0, i, j;
-
-    /* first, collect all data node modules */
-    LY_TREE_FOR(root, node) {
-        mod = lyd_node_module(node);
-        add_model(&models, &mod_count, mod);
-    }
+    uint32_t idx, i, j;
 
-    if (root) {
-        /* then add all models augmenting or deviating the used models */
-        idx = ly_ctx_internal_modules_count(root->schema->module->ctx);
-        while ((mod = ly_ctx_get_module_iter(root->schema->module->ctx, &idx))) {
-            if (!mod->implemented) {
+    idx = ly_ctx_internal_modules_count(ctx);
+    while ((mod = ly_ctx_get_module_iter(ctx, &idx))) {
+        if (!mod->implemented) {
 next_mod:
-                continue;
-            }
+            continue;
+        }
 
-            for (i = 0; i < mod->deviation_size; ++i) {
-                if (mod->deviation[i].orig_node && is_added_model(models, mod_count, lys_node_module(mod->deviation[i].orig_node))) {
-                    add_model(&models, &mod_count, mod);
-                    goto next_mod;
-                }
+        for (i = 0; i < mod->deviation_size; ++i) {
+            if (mod->deviation[i].orig_node && is_added_model(*models, *mod_count, lys_node_module(mod->deviation[i].orig_node))) {
+                add_model(models, mod_count, mod);
+                goto next_mod;
             }
-            for (i = 0; i < mod->augment_size; ++i) {
-                if (is_added_model(models, mod_count, lys_node_module(mod->augment[i].target))) {
-                    add_model(&models, &mod_count, mod);
-                    goto next_mod;
-                }
+        }
+        for (i = 0; i < mod->augment_size; ++i) {
+            if (is_added_model(*models, *mod_count, lys_node_module(mod->augment[i].target))) {
+                add_model(models, mod_count, mod);
+                goto next_mod;
             }
+        }
 
-            /* submodules */
-            for (j = 0; j < mod->inc_size; ++j) {
-                submod = mod->inc[j].submodule;
+        /* submodules */
+        for (j = 0; j < mod->inc_size; ++j) {
+            submod = mod->inc[j].submodule;
 
-                for (i = 0; i < submod->deviation_size; ++i) {
-                    if (submod->deviation[i].orig_node && is_added_model(models, mod_count, lys_node_module(submod->deviation[i].orig_node))) {
-                        add_model(&models, &mod_count, mod);
-                        goto next_mod;
-                    }
+            for (i = 0; i < submod->deviation_size; ++i) {
+                if (submod->deviation[i].orig_node && is_added_model(*models, *mod_count, lys_node_module(submod->deviation[i].orig_node))) {
+                    add_model(models, mod_count, mod);
+                    goto next_mod;
                 }
-                for (i = 0; i < submod->augment_size; ++i) {
-                    if (is_added_model(models, mod_count, lys_node_module(submod->augment[i].target))) {
-                        add_model(&models, &mod_count, mod);
-                        goto next_mod;
-                    }
+            }
+            for (i = 0; i < submod->augment_size; ++i) {
+                if (is_added_model(*models, *mod_count, lys_node_module(submod->augment[i].target))) {
+                    add_model(models, mod_count, mod);
+                    goto next_mod;
                 }
             }
         }
     }
+}
+
+static int
+lyb_print_models(struct lyout *out, const struct lys_module **models, size_t mod_count, struct lyb_state *lybs)
+{
+    int ret = 0;
+    size_t i;
 
     /* now write module count on 2 bytes */
     ret += lyb_write_number(mod_count, 2, out, lybs);
@@ -672,6 +914,30 @@ next_mod:
         ret += lyb_print_model(out, models[i], lybs);
     }
 
+    return ret;
+}
+
+static int
+lyb_print_data_models(struct lyout *out, const struct lyd_node *root, struct lyb_state *lybs)
+{
+    int ret;
+    const struct lys_module **models = NULL, *mod;
+    const struct lyd_node *node;
+    size_t mod_count = 0;
+
+    /* first, collect all data node modules */
+    LY_TREE_FOR(root, node) {
+        mod = lyd_node_module(node);
+        add_model(&models, &mod_count, mod);
+    }
+
+    if (root) {
+        /* then add all models augmenting or deviating the used models */
+        lyb_add_dependent_models(root->schema->module->ctx, &models, &mod_count);
+    }
+
+    ret = lyb_print_models(out, models, mod_count, lybs);
+
     free(models);
     return ret;
 }
@@ -690,12 +956,27 @@ lyb_print_magic_number(struct lyout *out)
 }
 
 static int
-lyb_print_header(struct lyout *out)
+lyb_print_header(struct lyout *out, int options, int patch)
 {
     int ret = 0;
     uint8_t byte = 0;
 
-    /* TODO version, some other flags? */
+    /* TODO version */
+    if (patch == 1) {
+        byte |= LYB_HEADER_PATCH;
+    } else if (patch == 2) {
+        byte |= LYB_HEADER_STREAM;
+    }
+    if (options & LYP_STRTABLE) {
+        byte |= LYB_HEADER_STRTABLE;
+    }
+    if (options & LYP_INDEX) {
+        byte |= LYB_HEADER_INDEX;
+    }
+    if ((options & LYP_IDENTIDX) || (patch == 2)) {
+        /* stream frames always store identities by their index */
+        byte |= LYB_HEADER_IDENTIDX;
+    }
     ret += ly_write(out, (char *)&byte, sizeof byte);
 
     return ret;
@@ -806,10 +1087,19 @@ lyb_print_value(const struct lys_type *type, const char *value_str, lyd_val valu
     case LY_TYPE_INST:
     case LY_TYPE_STRING:
     case LY_TYPE_UNION:
-    case LY_TYPE_IDENT:
     case LY_TYPE_UNKNOWN:
         /* store string */
-        ret += lyb_write_string(value_str, 0, 0, out, lybs);
+        ret += lyb_write_value_string(value_str, out, lybs);
+        break;
+    case LY_TYPE_IDENT:
+        if (!lybs->ident_idx) {
+            /* store string */
+            ret += lyb_write_value_string(value_str, out, lybs);
+            break;
+        }
+
+        /* store the identity module name and index */
+        ret += lyb_write_ident(value.ident, out, lybs);
         break;
     case LY_TYPE_BITS:
         /* find the correct structure */
@@ -951,7 +1241,9 @@ lyb_print_schema_hash(struct lyout *out, struct lys_node *schema, struct hash_ta
                       int options)
 {
     int r, ret = 0;
+#ifndef LY_ENABLED_CACHE
     void *mem;
+#endif
     uint32_t i;
     LYB_HASH hash;
     struct lys_node *first_sibling, *parent, *iter;
@@ -982,6 +1274,13 @@ check_inout:
             }
         }
 
+#ifdef LY_ENABLED_CACHE
+        /* the siblings do not change with the data, the hash table is shared by all the prints */
+        *sibling_ht = lyb_sib_ht_get(schema->module->ctx, first_sibling, options);
+        if (!*sibling_ht) {
+            return -1;
+        }
+#else
         for (r = 0; r < lybs->sib_ht_count; ++r) {
             if (lybs->sib_ht[r].first_sibling == first_sibling) {
                 /* we have already created a hash table for these siblings */
@@ -1006,6 +1305,7 @@ check_inout:
             lybs->sib_ht[lybs->sib_ht_count - 1].first_sibling = first_sibling;
             lybs->sib_ht[lybs->sib_ht_count - 1].ht = *sibling_ht;
         }
+#endif
     }
 
     /* get our hash */
@@ -1044,12 +1344,48 @@ check_inout:
     return ret;
 }
 
+static int
+lyb_print_content(struct lyout *out, const struct lyd_node *node, struct lyb_state *lybs)
+{
+    int r, ret = 0;
+    struct lyd_node_leaf_list *leaf;
+
+    switch (node->schema->nodetype) {
+    case LYS_CONTAINER:
+    case LYS_LIST:
+    case LYS_NOTIF:
+    case LYS_RPC:
+    case LYS_ACTION:
+        /* nothing to write */
+        break;
+    case LYS_LEAF:
+    case LYS_LEAFLIST:
+        leaf = (struct lyd_node_leaf_list *)node;
+        ret += (r = lyb_print_value(&((struct lys_node_leaf *)leaf->schema)->type, leaf->value_str, leaf->value,
+                                    leaf->value_type, leaf->value_flags, leaf->dflt, out, lybs));
+        if (r < 0) {
+            return -1;
+        }
+        break;
+    case LYS_ANYXML:
+    case LYS_ANYDATA:
+        ret += (r = lyb_print_anydata((struct lyd_node_anydata *)node, out, lybs));
+        if (r < 0) {
+            return -1;
+        }
+        break;
+    default:
+        return -1;
+    }
+
+    return ret;
+}
+
 static int
 lyb_print_subtree(struct lyout *out, const struct lyd_node *node, struct hash_table **sibling_ht, struct lyb_state *lybs,
                   int options, int top_level)
 {
     int r, ret = 0;
-    struct lyd_node_leaf_list *leaf;
     struct lys_node *sparent;
     struct hash_table *child_ht = NULL;
 
@@ -1078,7 +1414,13 @@ lyb_print_subtree(struct lyout *out, const struct lyd_node *node, struct hash_ta
     /*
      * write the node information
      */
-    if (top_level) {
+    if (top_level && lybs->stream) {
+        /* index of the model in the stream header */
+        ret += (r = lyb_print_stream_model(out, lyd_node_module(node), lybs));
+        if (r < 0) {
+            return -1;
+        }
+    } else if (top_level) {
         /* write model info first */
         ret += (r = lyb_print_model(out, lyd_node_module(node), lybs));
         if (r < 0) {
@@ -1097,31 +1439,8 @@ lyb_print_subtree(struct lyout *out, const struct lyd_node *node, struct hash_ta
     }
 
     /* write node content */
-    switch (node->schema->nodetype) {
-    case LYS_CONTAINER:
-    case LYS_LIST:
-    case LYS_NOTIF:
-    case LYS_RPC:
-    case LYS_ACTION:
-        /* nothing to write */
-        break;
-    case LYS_LEAF:
-    case LYS_LEAFLIST:
-        leaf = (struct lyd_node_leaf_list *)node;
-        ret += (r = lyb_print_value(&((struct lys_node_leaf *)leaf->schema)->type, leaf->value_str, leaf->value,
-                                    leaf->value_type, leaf->value_flags, leaf->dflt, out, lybs));
-        if (r < 0) {
-            return -1;
-        }
-        break;
-    case LYS_ANYXML:
-    case LYS_ANYDATA:
-        ret += (r = lyb_print_anydata((struct lyd_node_anydata *)node, out, lybs));
-        if (r < 0) {
-            return -1;
-        }
-        break;
-    default:
+    ret += (r = lyb_print_content(out, node, lybs));
+    if (r < 0) {
         return -1;
     }
 
@@ -1148,6 +1467,79 @@ lyb_print_subtree(struct lyout *out, const struct lyd_node *node, struct hash_ta
     return ret;
 }
 
+/* top-level subtree in the LYB index */
+struct lyb_index_rec {
+    uint64_t offset;
+    char *path;
+};
+
+static int
+lyb_index_add(struct lyb_index_rec **index, uint32_t *count, const struct lyd_node *node, uint64_t offset)
+{
+    struct lyb_index_rec *mem;
+
+    if (!(*count % LYB_STATE_STEP)) {
+        mem = realloc(*index, (*count + LYB_STATE_STEP) * sizeof **index);
+        LY_CHECK_ERR_RETURN(!mem, LOGMEM(node->schema->module->ctx), -1);
+        *index = mem;
+    }
+
+    (*index)[*count].offset = offset;
+    (*index)[*count].path = lyd_path(node);
+    if (!(*index)[*count].path) {
+        return -1;
+    }
+    ++(*count);
+
+    return 0;
+}
+
+static int
+lyb_print_index(struct lyout *out, const struct lyb_index_rec *index, uint32_t count, uint64_t offset,
+                struct lyb_state *lybs)
+{
+    int r, ret = 0;
+    uint32_t i;
+
+    ret += (r = lyb_write_number(count, 4, out, lybs));
+    if (r < 0) {
+        return -1;
+    }
+    for (i = 0; i < count; ++i) {
+        ret += (r = lyb_write_number(index[i].offset, 8, out, lybs));
+        if (r < 0) {
+            return -1;
+        }
+        ret += (r = lyb_write_string(index[i].path, 0, 1, out, lybs));
+        if (r < 0) {
+            return -1;
+        }
+    }
+
+    /* the index offset last so that the index can be found from the end of the data */
+    ret += (r = lyb_write_number(offset, 8, out, lybs));
+    if (r < 0) {
+        return -1;
+    }
+
+    return ret;
+}
+
+static void
+lyb_state_clean(struct lyb_state *lybs)
+{
+    int i;
+
+    free(lybs->written);
+    free(lybs->position);
+    free(lybs->inner_chunks);
+    for (i = 0; i < lybs->sib_ht_count; ++i) {
+        lyht_free(lybs->sib_ht[i].ht);
+    }
+    free(lybs->sib_ht);
+    lyht_free(lybs->str_ht);
+}
+
 int
 lyb_print_data(struct lyout *out, const struct lyd_node *root, int options)
 {
@@ -1157,6 +1549,8 @@ lyb_print_data(struct lyout *out, const struct lyd_node *root, int options)
     const struct lys_module *prev_mod = NULL;
     struct lys_node *parent;
     struct lyb_state lybs;
+    struct lyb_index_rec *index = NULL;
+    uint32_t index_count = 0, i;
 
     if (root) {
         for (parent = lys_parent(root->schema); parent && (parent->nodetype == LYS_USES); parent = lys_parent(parent));
@@ -1176,7 +1570,9 @@ lyb_print_data(struct lyout *out, const struct lyd_node *root, int options)
     }
 
     /* LYB header */
-    ret += (r = lyb_print_header(out));
+    lybs.str_table = (options & LYP_STRTABLE) ? 1 : 0;
+    lybs.ident_idx = (options & LYP_IDENTIDX) ? 1 : 0;
+    ret += (r = lyb_print_header(out, options, 0));
     if (r < 0) {
         rc = EXIT_FAILURE;
         goto finish;
@@ -1196,6 +1592,18 @@ lyb_print_data(struct lyout *out, const struct lyd_node *root, int options)
             prev_mod = lyd_node_module(root);
         }
 
+        if (options & LYP_INDEX) {
+            if (lyb_index_add(&index, &index_count, root, ret)) {
+                rc = EXIT_FAILURE;
+                goto finish;
+            }
+
+            /* every indexed subtree must be parseable on its own */
+            lyht_free(lybs.str_ht);
+            lybs.str_ht = NULL;
+            lybs.str_count = 0;
+        }
+
         ret += (r = lyb_print_subtree(out, root, &top_sibling_ht, &lybs, options, 1));
         if (r < 0) {
             rc = EXIT_FAILURE;
@@ -1211,16 +1619,380 @@ lyb_print_data(struct lyout *out, const struct lyd_node *root, int options)
     ret += (r = lyb_write(out, &zero, sizeof zero, &lybs));
     if (r < 0) {
         rc = EXIT_FAILURE;
+        goto finish;
+    }
+
+    if (options & LYP_INDEX) {
+        ret += (r = lyb_print_index(out, index, index_count, ret, &lybs));
+        if (r < 0) {
+            rc = EXIT_FAILURE;
+        }
     }
 
 finish:
-    free(lybs.written);
-    free(lybs.position);
-    free(lybs.inner_chunks);
-    for (r = 0; r < lybs.sib_ht_count; ++r) {
-        lyht_free(lybs.sib_ht[r].ht);
+    for (i = 0; i < index_count; ++i) {
+        free(index[i].path);
+    }
+    free(index);
+    lyb_state_clean(&lybs);
+
+    return rc;
+}
+
+/**
+ * @brief Print a node of a LYB patch identified by its ancestors, see #LYB_HEADER_PATCH.
+ *
+ * @param[in] out Output.
+ * @param[in] chain The top-level ancestor of the node, the ancestors, and the node itself.
+ * @param[in] depth Number of nodes in \p chain.
+ * @param[in] whole Whether to print the whole subtree of the node or only its identity (list keys).
+ * @param[in] sibling_ht Sibling hash table of the first chain node.
+ * @param[in] lybs LYB printer state.
+ * @param[in] top_level Whether the first chain node is a top-level node.
+ * @return Number of printed bytes, -1 on error.
+ */
+static int
+lyb_print_patch_chain(struct lyout *out, const struct lyd_node **chain, uint32_t depth, int whole,
+                      struct hash_table **sibling_ht, struct lyb_state *lybs, int top_level)
+{
+    int r, ret = 0;
+    const struct lyd_node *node = chain[0], *key;
+    const struct lys_node_list *slist;
+    struct hash_table *child_ht = NULL;
+    uint8_t i;
+
+    if ((depth == 1) && whole) {
+        return lyb_print_subtree(out, node, sibling_ht, lybs, 0, top_level);
     }
-    free(lybs.sib_ht);
 
+    ret += (r = lyb_write_start_subtree(out, lybs));
+    if (r < 0) {
+        return -1;
+    }
+    if (top_level) {
+        ret += (r = lyb_print_model(out, lyd_node_module(node), lybs));
+        if (r < 0) {
+            return -1;
+        }
+    }
+    ret += (r = lyb_print_schema_hash(out, node->schema, sibling_ht, lybs, 0));
+    if (r < 0) {
+        return -1;
+    }
+
+    /* no attributes */
+    ret += (r = lyb_print_attributes(out, NULL, lybs));
+    if (r < 0) {
+        return -1;
+    }
+    ret += (r = lyb_print_content(out, node, lybs));
+    if (r < 0) {
+        return -1;
+    }
+
+    if (node->schema->nodetype == LYS_LIST) {
+        slist = (const struct lys_node_list *)node->schema;
+        if (!slist->keys_size) {
+            LOGERR(node->schema->module->ctx, LY_EINVAL, "Instances of the keyless list \"%s\" cannot be identified.",
+                   node->schema->name);
+            return -1;
+        }
+
+        /* the keys are always the first children */
+        for (i = 0, key = node->child; i < slist->keys_size; ++i, key = key->next) {
+            if (!key || (key->schema != (struct lys_node *)slist->keys[i])) {
+                LOGINT(node->schema->module->ctx);
+                return -1;
+            }
+            ret += (r = lyb_print_subtree(out, key, &child_ht, lybs, 0, 0));
+            if (r < 0) {
+                return -1;
+            }
+        }
+    }
+
+    if (depth > 1) {
+        /* the next node of the chain is the last child */
+        ret += (r = lyb_print_patch_chain(out, chain + 1, depth - 1, whole, &child_ht, lybs, 0));
+        if (r < 0) {
+            return -1;
+        }
+    }
+
+    ret += (r = lyb_write_stop_subtree(out, lybs));
+    if (r < 0) {
+        return -1;
+    }
+
+    return ret;
+}
+
+/* print the depth of a node and the node with all its ancestors */
+static int
+lyb_print_patch_node(struct lyout *out, const struct lyd_node *node, int whole, struct lyb_state *lybs)
+{
+    int r, ret = -1;
+    const struct lyd_node **chain = NULL, *iter;
+    struct hash_table *top_sibling_ht = NULL;
+    struct lys_node *parent;
+    uint32_t depth, u;
+
+    for (depth = 0, iter = node; iter; ++depth, iter = iter->parent);
+    chain = malloc(depth * sizeof *chain);
+    LY_CHECK_ERR_RETURN(!chain, LOGMEM(node->schema->module->ctx), -1);
+    for (u = depth, iter = node; iter; iter = iter->parent) {
+        chain[--u] = iter;
+    }
+
+    for (parent = lys_parent(chain[0]->schema); parent && (parent->nodetype == LYS_USES); parent = lys_parent(parent));
+    if (parent && (parent->nodetype != LYS_EXT)) {
+        LOGERR(node->schema->module->ctx, LY_EINVAL, "LYB printer supports only printing top-level nodes.");
+        goto cleanup;
+    }
+
+    ret = lyb_write_varnum(depth, out, lybs);
+    if (ret < 0) {
+        goto cleanup;
+    }
+    r = lyb_print_patch_chain(out, chain, depth, whole, &top_sibling_ht, lybs, 1);
+    ret = (r < 0) ? -1 : ret + r;
+
+cleanup:
+    free(chain);
+    return ret;
+}
+
+static int
+lyb_print_patch_models(struct lyout *out, const struct lyd_difflist *diff, struct lyb_state *lybs)
+{
+    int ret;
+    const struct lys_module **models = NULL;
+    const struct lyd_node *node;
+    struct ly_ctx *ctx = NULL;
+    size_t mod_count = 0;
+    uint32_t i;
+
+    for (i = 0; diff->type[i] != LYD_DIFF_END; ++i) {
+        node = diff->first[i] ? diff->first[i] : diff->second[i];
+        if (!node) {
+            continue;
+        }
+        for (; node->parent; node = node->parent);
+        add_model(&models, &mod_count, lyd_node_module(node));
+        ctx = node->schema->module->ctx;
+    }
+    if (ctx) {
+        lyb_add_dependent_models(ctx, &models, &mod_count);
+    }
+
+    ret = lyb_print_models(out, models, mod_count, lybs);
+
+    free(models);
+    return ret;
+}
+
+int
+lyb_print_patch(struct lyout *out, const struct lyd_difflist *diff, int options)
+{
+    int r, ret = 0, rc = EXIT_SUCCESS;
+    uint8_t byte;
+    const struct lyd_node *node, *anchor;
+    struct lyb_state lybs;
+    uint32_t i;
+
+    memset(&lybs, 0, sizeof lybs);
+
+    ret += (r = lyb_print_magic_number(out));
+    if (r < 0) {
+        rc = EXIT_FAILURE;
+        goto finish;
+    }
+    lybs.str_table = (options & LYP_STRTABLE) ? 1 : 0;
+    lybs.ident_idx = (options & LYP_IDENTIDX) ? 1 : 0;
+    ret += (r = lyb_print_header(out, options, 1));
+    if (r < 0) {
+        rc = EXIT_FAILURE;
+        goto finish;
+    }
+    ret += (r = lyb_print_patch_models(out, diff, &lybs));
+    if (r < 0) {
+        rc = EXIT_FAILURE;
+        goto finish;
+    }
+
+    for (i = 0; diff->type[i] != LYD_DIFF_END; ++i) {
+        anchor = NULL;
+        switch (diff->type[i]) {
+        case LYD_DIFF_DELETED:
+            node = diff->first[i];
+            break;
+        case LYD_DIFF_CHANGED:
+        case LYD_DIFF_CREATED:
+            node = diff->second[i];
+            break;
+        case LYD_DIFF_MOVEDAFTER1:
+            node = diff->first[i];
+            anchor = diff->second[i];
+            break;
+        case LYD_DIFF_MOVEDAFTER2:
+            node = diff->second[i];
+            anchor = diff->first[i];
+            break;
+        default:
+            LOGINT(NULL);
+            rc = EXIT_FAILURE;
+            goto finish;
+        }
+
+        /* operation, the node and, when moving, the preceding instance */
+        byte = diff->type[i];
+        ret += (r = lyb_write(out, &byte, sizeof byte, &lybs));
+        if (r < 0) {
+            rc = EXIT_FAILURE;
+            goto finish;
+        }
+        ret += (r = lyb_print_patch_node(out, node, (byte == LYD_DIFF_CHANGED) || (byte == LYD_DIFF_CREATED), &lybs));
+        if (r < 0) {
+            rc = EXIT_FAILURE;
+            goto finish;
+        }
+        if ((byte == LYD_DIFF_MOVEDAFTER1) || (byte == LYD_DIFF_MOVEDAFTER2)) {
+            byte = anchor ? 1 : 0;
+            ret += (r = lyb_write(out, &byte, sizeof byte, &lybs));
+            if (r < 0) {
+                rc = EXIT_FAILURE;
+                goto finish;
+            }
+            if (anchor) {
+                ret += (r = lyb_print_patch_node(out, anchor, 0, &lybs));
+                if (r < 0) {
+                    rc = EXIT_FAILURE;
+                    goto finish;
+                }
+            }
+        }
+    }
+
+    /* ending zero byte */
+    byte = 0;
+    ret += (r = lyb_write(out, &byte, sizeof byte, &lybs));
+    if (r < 0) {
+        rc = EXIT_FAILURE;
+    }
+
+finish:
+    lyb_state_clean(&lybs);
+
+    return rc;
+}
+
+/* write a 4B little-endian length into a skipped space */
+static int
+lyb_write_skipped_length(struct lyout *out, size_t position, uint32_t len)
+{
+    uint8_t buf[4];
+
+    buf[0] = len & 0xFF;
+    buf[1] = (len >> 8) & 0xFF;
+    buf[2] = (len >> 16) & 0xFF;
+    buf[3] = (len >> 24) & 0xFF;
+    return ly_write_skipped(out, position, (char *)buf, sizeof buf);
+}
+
+int
+lyb_print_stream_header(struct lyout *out, struct lyd_lyb_stream *stream)
+{
+    int r, ret = 0;
+    size_t position;
+    struct lyb_state lybs;
+
+    memset(&lybs, 0, sizeof lybs);
+
+    r = lyb_print_magic_number(out);
+    if (r < 0) {
+        goto error;
+    }
+    r = lyb_print_header(out, stream->options, 2);
+    if (r < 0) {
+        goto error;
+    }
+
+    /* length of the models */
+    r = ly_write_skip(out, 4, &position);
+    if (r < 0) {
+        goto error;
+    }
+    ret = lyb_print_models(out, stream->models, stream->mod_count, &lybs);
+    if ((ret < 0) || (lyb_write_skipped_length(out, position, ret) < 0)) {
+        goto error;
+    }
+
+    lyb_state_clean(&lybs);
+    return EXIT_SUCCESS;
+
+error:
+    lyb_state_clean(&lybs);
+    return EXIT_FAILURE;
+}
+
+int
+lyb_print_stream_frame(struct lyout *out, struct lyd_lyb_stream *stream, const struct lyd_node *root, int options)
+{
+    int r, ret = 0, rc = EXIT_FAILURE;
+    uint8_t zero = 0;
+    size_t position;
+    struct hash_table *top_sibling_ht = NULL;
+    const struct lys_module *prev_mod = NULL;
+    struct lys_node *parent;
+    struct lyb_state lybs;
+
+    if (root) {
+        for (parent = lys_parent(root->schema); parent && (parent->nodetype == LYS_USES); parent = lys_parent(parent));
+        if (parent && (parent->nodetype != LYS_EXT)) {
+            LOGERR(stream->ctx, LY_EINVAL, "LYB printer supports only printing top-level nodes.");
+            return EXIT_FAILURE;
+        }
+    }
+
+    memset(&lybs, 0, sizeof lybs);
+    lybs.str_table = stream->str_table;
+    lybs.ident_idx = 1;
+    lybs.stream = 1;
+    lybs.models = stream->models;
+    lybs.mod_count = stream->mod_count;
+
+    /* length of the frame */
+    r = ly_write_skip(out, 4, &position);
+    if (r < 0) {
+        goto finish;
+    }
+
+    LY_TREE_FOR(root, root) {
+        /* do not reuse sibling hash tables from different modules */
+        if (lyd_node_module(root) != prev_mod) {
+            top_sibling_ht = NULL;
+            prev_mod = lyd_node_module(root);
+        }
+
+        ret += (r = lyb_print_subtree(out, root, &top_sibling_ht, &lybs, options, 1));
+        if (r < 0) {
+            goto finish;
+        }
+
+        if (!(options & LYP_WITHSIBLINGS)) {
+            break;
+        }
+    }
+
+    /* ending zero byte */
+    ret += (r = lyb_write(out, &zero, sizeof zero, &lybs));
+    if ((r < 0) || (lyb_write_skipped_length(out, position, ret) < 0)) {
+        goto finish;
+    }
+    rc = EXIT_SUCCESS;
+
+finish:
+    lybs.models = NULL;
+    lyb_state_clean(&lybs);
     return rc;
 }
@@ -59,6 +59,14 @@ modlist_add(struct mlist **mlist, const struct lys_module *mod)
     return EXIT_SUCCESS;
 }
 
+/* NETCONF's filter attributes are not annotations and have no namespace */
+static int
+xml_is_filter(const struct lyd_node *node)
+{
+    return !strcmp(node->schema->name, "filter")
+            && (!strcmp(node->schema->module->name, "ietf-netconf") || !strcmp(node->schema->module->name, "notifications"));
+}
+
 static void
 xml_print_ns(struct lyout *out, const struct lyd_node *node, int options)
 {
@@ -66,22 +74,13 @@ xml_print_ns(struct lyout *out, const struct lyd_node *node, int options)
     struct lyd_attr *attr;
     const struct lys_module *wdmod = NULL;
     struct mlist *mlist = NULL, *miter;
-    int r;
 
     assert(out);
     assert(node);
 
     /* add node attribute modules */
-    for (attr = node->attr; attr; attr = attr->next) {
-        if (!strcmp(node->schema->name, "filter") &&
-                (!strcmp(node->schema->module->name, "ietf-netconf") ||
-                 !strcmp(node->schema->module->name, "notifications"))) {
-            /* exception for NETCONF's filter attributes */
-            continue;
-        } else {
-            r = modlist_add(&mlist, lys_main_module(attr->annotation->module));
-        }
-        if (r) {
+    for (attr = (node->attr && !xml_is_filter(node)) ? node->attr : NULL; attr; attr = attr->next) {
+        if (modlist_add(&mlist, lys_main_module(attr->annotation->module))) {
             goto print;
         }
     }
@@ -113,16 +112,8 @@ xml_print_ns(struct lyout *out, const struct lyd_node *node, int options)
 
         LY_TREE_FOR(node->child, node2) {
             LY_TREE_DFS_BEGIN(node2, next, cur) {
-                for (attr = cur->attr; attr; attr = attr->next) {
-                    if (!strcmp(cur->schema->name, "filter") &&
-                            (!strcmp(cur->schema->module->name, "ietf-netconf") ||
-                             !strcmp(cur->schema->module->name, "notifications"))) {
-                        /* exception for NETCONF's filter attributes */
-                        continue;
-                    } else {
-                        r = modlist_add(&mlist, lys_main_module(attr->annotation->module));
-                    }
-                    if (r) {
+                for (attr = (cur->attr && !xml_is_filter(cur)) ? cur->attr : NULL; attr; attr = attr->next) {
+                    if (modlist_add(&mlist, lys_main_module(attr->annotation->module))) {
                         goto print;
                     }
                 }
@@ -170,8 +161,7 @@ xml_print_attrs(struct lyout *out, const struct lyd_node *node, int options)
         }
     }
     /* technically, check for the extension get-filter-element-attributes from ietf-netconf */
-    if (!strcmp(node->schema->name, "filter")
-            && (!strcmp(node->schema->module->name, "ietf-netconf") || !strcmp(node->schema->module->name, "notifications"))) {
+    if (node->attr && xml_is_filter(node)) {
         rpc_filter = 1;
     }
 
@@ -274,13 +264,40 @@ printinst:
     return EXIT_SUCCESS;
 }
 
+/* print the start of the opening tag with the namespace, if it differs from the parent one */
+static void
+xml_print_open(struct lyout *out, int level, const struct lyd_node *node, int toplevel)
+{
+    const char *ns;
+
+    ly_print_indent(out, LEVEL);
+    ly_write(out, "<", 1);
+    ly_write(out, node->schema->name, strlen(node->schema->name));
+    if (toplevel || !node->parent || nscmp(node, node->parent)) {
+        /* print "namespace" */
+        ns = lyd_node_module(node)->ns;
+        ly_write(out, " xmlns=\"", 8);
+        ly_write(out, ns, strlen(ns));
+        ly_write(out, "\"", 1);
+    }
+}
+
+static void
+xml_print_close(struct lyout *out, int indent, const struct lyd_node *node, int newline)
+{
+    ly_print_indent(out, indent);
+    ly_write(out, "</", 2);
+    ly_write(out, node->schema->name, strlen(node->schema->name));
+    ly_write(out, newline ? ">\n" : ">", newline ? 2 : 1);
+}
+
 static int
 xml_print_leaf(struct lyout *out, int level, const struct lyd_node *node, int toplevel, int options)
 {
     const struct lyd_node_leaf_list *leaf = (struct lyd_node_leaf_list *)node, *iter;
     const struct lys_type *type;
     struct lys_tpdf *tpdf;
-    const char *ns, *mod_name;
+    const char *mod_name;
     const char **prefs, **nss;
     const char *xml_expr;
     uint32_t ns_count, i;
@@ -289,13 +306,7 @@ xml_print_leaf(struct lyout *out, int level, const struct lyd_node *node, int to
     size_t len;
     enum int_log_opts prev_ilo;
 
-    if (toplevel || !node->parent || nscmp(node, node->parent)) {
-        /* print "namespace" */
-        ns = lyd_node_module(node)->ns;
-        ly_print(out, "%*s<%s xmlns=\"%s\"", LEVEL, INDENT, node->schema->name, ns);
-    } else {
-        ly_print(out, "%*s<%s", LEVEL, INDENT, node->schema->name);
-    }
+    xml_print_open(out, level, node, toplevel);
 
     if (toplevel) {
         xml_print_ns(out, node, options);
@@ -342,8 +353,8 @@ printvalue:
             ly_print(out, "/>");
         } else {
             ly_print(out, ">");
-            lyxml_dump_text(out, leaf->value_str, LYXML_DATA_ELEM);
-            ly_print(out, "</%s>", node->schema->name);
+            lyxml_dump_value(out, leaf->value_str, LYXML_DATA_ELEM);
+            xml_print_close(out, 0, node, 0);
         }
         break;
 
@@ -359,7 +370,7 @@ printvalue:
         if (!strncmp(leaf->value_str, mod_name, len) && !mod_name[len]) {
             ly_print(out, ">");
             lyxml_dump_text(out, ++p, LYXML_DATA_ELEM);
-            ly_print(out, "</%s>", node->schema->name);
+            xml_print_close(out, 0, node, 0);
         } else {
             /* avoid code duplication - use instance-identifier printer which gets necessary namespaces to print */
             datatype = LY_TYPE_INST;
@@ -384,7 +395,7 @@ printvalue:
         if (xml_expr[0]) {
             ly_print(out, ">");
             lyxml_dump_text(out, xml_expr, LYXML_DATA_ELEM);
-            ly_print(out, "</%s>", node->schema->name);
+            xml_print_close(out, 0, node, 0);
         } else {
             ly_print(out, "/>");
         }
@@ -431,15 +442,8 @@ static int
 xml_print_container(struct lyout *out, int level, const struct lyd_node *node, int toplevel, int options)
 {
     struct lyd_node *child;
-    const char *ns;
 
-    if (toplevel || !node->parent || nscmp(node, node->parent)) {
-        /* print "namespace" */
-        ns = lyd_node_module(node)->ns;
-        ly_print(out, "%*s<%s xmlns=\"%s\"", LEVEL, INDENT, node->schema->name, ns);
-    } else {
-        ly_print(out, "%*s<%s", LEVEL, INDENT, node->schema->name);
-    }
+    xml_print_open(out, level, node, toplevel);
 
     if (toplevel) {
         xml_print_ns(out, node, options);
@@ -461,7 +465,7 @@ xml_print_container(struct lyout *out, int level, const struct lyd_node *node, i
         }
     }
 
-    ly_print(out, "%*s</%s>%s", LEVEL, INDENT, node->schema->name, level ? "\n" : "");
+    xml_print_close(out, LEVEL, node, level);
 
     return EXIT_SUCCESS;
 }
@@ -470,17 +474,10 @@ static int
 xml_print_list(struct lyout *out, int level, const struct lyd_node *node, int is_list, int toplevel, int options)
 {
     struct lyd_node *child;
-    const char *ns;
 
     if (is_list) {
         /* list print */
-        if (toplevel || !node->parent || nscmp(node, node->parent)) {
-            /* print "namespace" */
-            ns = lyd_node_module(node)->ns;
-            ly_print(out, "%*s<%s xmlns=\"%s\"", LEVEL, INDENT, node->schema->name, ns);
-        } else {
-            ly_print(out, "%*s<%s", LEVEL, INDENT, node->schema->name);
-        }
+        xml_print_open(out, level, node, toplevel);
 
         if (toplevel) {
             xml_print_ns(out, node, options);
@@ -501,7 +498,7 @@ xml_print_list(struct lyout *out, int level, const struct lyd_node *node, int is
             }
         }
 
-        ly_print(out, "%*s</%s>%s", LEVEL, INDENT, node->schema->name, level ? "\n" : "");
+        xml_print_close(out, LEVEL, node, level);
     } else {
         /* leaf-list print */
         xml_print_leaf(out, level, node, toplevel, options);
@@ -516,15 +513,8 @@ xml_print_anydata(struct lyout *out, int level, const struct lyd_node *node, int
     char *buf;
     struct lyd_node_anydata *any = (struct lyd_node_anydata *)node;
     struct lyd_node *iter;
-    const char *ns;
 
-    if (toplevel || !node->parent || nscmp(node, node->parent)) {
-        /* print "namespace" */
-        ns = lyd_node_module(node)->ns;
-        ly_print(out, "%*s<%s xmlns=\"%s\"", LEVEL, INDENT, node->schema->name, ns);
-    } else {
-        ly_print(out, "%*s<%s", LEVEL, INDENT, node->schema->name);
-    }
+    xml_print_open(out, level, node, toplevel);
 
     if (toplevel) {
         xml_print_ns(out, node, options);
@@ -547,7 +537,7 @@ xml_print_anydata(struct lyout *out, int level, const struct lyd_node *node, int
         /* ... and print anydata content */
         switch (any->value_type) {
         case LYD_ANYDATA_CONSTSTRING:
-            lyxml_dump_text(out, any->value.str, LYXML_DATA_ELEM);
+            lyxml_dump_value(out, any->value.str, LYXML_DATA_ELEM);
             break;
         case LYD_ANYDATA_DATATREE:
             if (any->value.tree) {
@@ -586,7 +576,7 @@ xml_print_anydata(struct lyout *out, int level, const struct lyd_node *node, int
         }
 
         /* closing tag */
-        ly_print(out, "</%s>%s", node->schema->name, level ? "\n" : "");
+        xml_print_close(out, 0, node, level);
     }
 
     return EXIT_SUCCESS;
@@ -597,7 +587,7 @@ xml_print_node(struct lyout *out, int level, const struct lyd_node *node, int to
 {
     int ret = EXIT_SUCCESS;
 
-    if (!lyd_wd_toprint(node, options)) {
+    if (!lyd_wd_toprint(out, node, options)) {
         /* wd says do not print */
         return EXIT_SUCCESS;
     }
@@ -631,12 +621,128 @@ xml_print_node(struct lyout *out, int level, const struct lyd_node *node, int to
     return ret;
 }
 
+static int
+xml_print_thread_member(const struct lyd_node *UNUSED(first), const struct lyd_node *node, int options)
+{
+    return lyd_wd_toprint(NULL, node, options);
+}
+
+static int
+xml_print_thread_node(struct lyout *out, int level, const struct lyd_node *node, int options)
+{
+    return xml_print_node(out, level, node, 1, options);
+}
+
+/**
+ * @brief Print the opening tags of the ancestors of a page, list instances with their keys.
+ *
+ * @return Level of the page, -1 on error.
+ */
+static int
+xml_print_page_open(struct lyout *out, const struct lyd_node **parents, int depth, int options)
+{
+    const struct lyd_node *iter;
+    struct lys_node_list *slist;
+    int level, i, k;
+
+    level = (options & LYP_FORMAT ? 1 : 0);
+
+    for (i = 0; i < depth; ++i) {
+        xml_print_open(out, level, parents[i], !i);
+        ly_print(out, ">%s", level ? "\n" : "");
+        if (level) {
+            ++level;
+        }
+
+        if (parents[i]->schema->nodetype == LYS_LIST) {
+            slist = (struct lys_node_list *)parents[i]->schema;
+            for (k = 0, iter = parents[i]->child;
+                    iter && (k < slist->keys_size) && (iter->schema == (struct lys_node *)slist->keys[k]);
+                    ++k, iter = iter->next) {
+                if (xml_print_node(out, level, iter, 0, options)) {
+                    return -1;
+                }
+            }
+        }
+    }
+
+    return level;
+}
+
+/**
+ * @brief Print the closing tags of the ancestors of a page.
+ */
+static void
+xml_print_page_close(struct lyout *out, const struct lyd_node **parents, int depth, int level)
+{
+    int i;
+
+    for (i = depth - 1; i > -1; --i) {
+        if (level) {
+            --level;
+        }
+        xml_print_close(out, LEVEL, parents[i], level);
+    }
+
+    ly_print_flush(out);
+}
+
+int
+xml_print_page(struct lyout *out, const struct lyd_node **parents, int depth, const struct lyd_node *first,
+               uint32_t count, int options)
+{
+    const struct lyd_node *iter;
+    int level;
+    uint32_t n;
+
+    /* ancestors */
+    level = xml_print_page_open(out, parents, depth, options);
+    if (level == -1) {
+        return EXIT_FAILURE;
+    }
+
+    /* the page itself, every instance carries its namespaces */
+    for (iter = first, n = 0; iter && (n < count); ++n) {
+        if (xml_print_node(out, level, iter, 1, options)) {
+            return EXIT_FAILURE;
+        }
+        for (iter = iter->next; iter && (iter->schema != first->schema); iter = iter->next);
+    }
+
+    xml_print_page_close(out, parents, depth, level);
+    return EXIT_SUCCESS;
+}
+
+int
+xml_print_gen(struct lyout *out, const struct lyd_node **parents, int depth, struct ly_print_gen *gen, int options)
+{
+    int level, r;
+
+    level = xml_print_page_open(out, parents, depth, options);
+    if (level == -1) {
+        return EXIT_FAILURE;
+    }
+
+    /* every instance printed and freed before the next one is produced */
+    while (!(r = ly_print_gen_next(out, gen))) {
+        if (xml_print_node(out, level, gen->instance, 1, options)) {
+            return EXIT_FAILURE;
+        }
+    }
+    if (r == -1) {
+        return EXIT_FAILURE;
+    }
+
+    xml_print_page_close(out, parents, depth, level);
+    return EXIT_SUCCESS;
+}
+
 int
 xml_print_data(struct lyout *out, const struct lyd_node *root, int options)
 {
     const struct lyd_node *node, *next;
     struct lys_node *parent = NULL;
-    int level, action_input = 0;
+    int level, action_input = 0, r;
 
     if (!root) {
         if (out->type == LYOUT_MEMORY || out->type == LYOUT_CALLBACK) {
@@ -682,12 +788,21 @@ xml_print_data(struct lyout *out, const struct lyd_node *root, int options)
     }
 
     /* content */
-    LY_TREE_FOR(root, node) {
-        if (xml_print_node(out, level, node, 1, options)) {
+    r = 1;
+    if ((options & LYP_WITHSIBLINGS) && !(options & LYP_NETCONF)) {
+        r = ly_print_threads(out, root, level, options, xml_print_thread_member, xml_print_thread_node, "");
+        if (r == -1) {
             return EXIT_FAILURE;
         }
-        if (!(options & LYP_WITHSIBLINGS)) {
-            break;
+    }
+    if (r) {
+        LY_TREE_FOR(root, node) {
+            if (xml_print_node(out, level, node, 1, options)) {
+                return EXIT_FAILURE;
+            }
+            if (!(options & LYP_WITHSIBLINGS)) {
+                break;
+            }
         }
     }
 
@@ -1231,16 +1231,12 @@ resolve_hash_table_find_equal(void *val1_p, void *val2_p, int mod, void *UNUSED(
 static struct lyd_node *
 resolve_json_data_node_hash(struct lyd_node *parent, struct parsed_pred pp)
 {
-    values_equal_cb prev_cb;
     struct lyd_node **ret = NULL;
     uint32_t hash;
     int i;
 
     assert(parent && parent->hash);
 
-    /* set our value equivalence callback that does not require data nodes */
-    prev_cb = lyht_set_cb(parent->ht, resolve_hash_table_find_equal);
-
     /* get the hash of the searched node */
     hash = dict_hash_multi(0, lys_node_module(pp.schema)->name, strlen(lys_node_module(pp.schema)->name));
     hash = dict_hash_multi(hash, pp.schema->name, strlen(pp.schema->name));
@@ -1256,13 +1252,10 @@ resolve_json_data_node_hash(struct lyd_node *parent, struct parsed_pred pp)
     }
     hash = dict_hash_multi(hash, NULL, 0);
 
-    /* try to find the node */
-    i = lyht_find(parent->ht, &pp, hash, (void **)&ret);
+    /* try to find the node, with our value equivalence callback that does not require data nodes */
+    i = lyht_find_cb(parent->ht, &pp, hash, resolve_hash_table_find_equal, NULL, (void **)&ret);
     assert(i || *ret);
 
-    /* restore the original callback */
-    lyht_set_cb(parent->ht, prev_cb);
-
     return (i ? NULL : *ret);
 }
 
@@ -1407,11 +1400,30 @@ int
 resolve_iffeature(struct lys_iffeature *expr)
 {
     int index_e = 0, index_f = 0;
+#ifdef LY_ENABLED_CACHE
+    uint32_t gen, cache;
+    int value;
+#endif
 
-    if (expr->expr) {
-        return resolve_iffeature_recursive(expr, &index_e, &index_f);
+    if (!expr->expr) {
+        return 0;
     }
-    return 0;
+
+#ifdef LY_ENABLED_CACHE
+    /* the result depends only on the feature states, reuse it until some of them change,
+     * the generation and the result are stored in a single word for concurrent readers */
+    gen = expr->features[0]->module->ctx->feature_gen << 1;
+    cache = atomic_load_explicit((_Atomic uint32_t *)&expr->value_cache, memory_order_relaxed);
+    if ((cache & ~1U) == gen) {
+        return cache & 1;
+    }
+
+    value = resolve_iffeature_recursive(expr, &index_e, &index_f);
+    atomic_store_explicit((_Atomic uint32_t *)&expr->value_cache, gen | (value ? 1 : 0), memory_order_relaxed);
+    return value;
+#else
+    return resolve_iffeature_recursive(expr, &index_e, &index_f);
+#endif
 }
 
 struct iff_stack {
@@ -1618,6 +1630,9 @@ resolve_iffeature_compile(struct lys_iffeature *iffeat_expr, const char *value,
     /* allocate the memory */
     iffeat_expr->expr = calloc((j = (expr_size / 4) + ((expr_size % 4) ? 1 : 0)), sizeof *iffeat_expr->expr);
     iffeat_expr->features = calloc(f_size, sizeof *iffeat_expr->features);
+#ifdef LY_ENABLED_CACHE
+    iffeat_expr->value_cache = 0;
+#endif
     stack.stack = malloc(expr_size * sizeof *stack.stack);
     LY_CHECK_ERR_GOTO(!stack.stack || !iffeat_expr->expr || !iffeat_expr->features, LOGMEM(ctx), error);
     stack.size = expr_size;
@@ -1817,6 +1832,55 @@ schema_nodeid_siblingcheck(const struct lys_node *sibling, const struct lys_modu
     return 0;
 }
 
+/**
+ * @brief Find the schema child matching a node identifier in the hashed children of a parent.
+ * It is only a hint for schema_nodeid_getnext(), which checks all the children if the hint is not accepted.
+ *
+ * @return Found child, NULL if there is none or the hash table cannot be used.
+ */
+static const struct lys_node *
+schema_nodeid_hint(const struct lys_node *parent, const struct lys_module *module, const struct lys_module *cur_module,
+                   const char *mod_name, int mod_name_len, const char *name, int nam_len)
+{
+    const struct lys_module *prefix_mod;
+    const struct lys_node *node;
+
+    if ((name[0] == '*') || (name[0] == '.')) {
+        return NULL;
+    }
+
+    if (mod_name) {
+        prefix_mod = lyp_get_module(cur_module, NULL, 0, mod_name, mod_name_len, 0);
+        if (!prefix_mod) {
+            return NULL;
+        }
+    } else {
+        prefix_mod = cur_module;
+    }
+
+    if (lys_find_schema_child_hash(cur_module->ctx, parent, module, name, nam_len, lys_main_module(prefix_mod)->ns,
+                                   &node)) {
+        return NULL;
+    }
+    return node;
+}
+
+/* lys_getnext() returning the hint first, all the children are returned if it was not accepted (the next call) */
+static const struct lys_node *
+schema_nodeid_getnext(const struct lys_node *last, const struct lys_node **hint, const struct lys_node *parent,
+                      const struct lys_module *module, int options)
+{
+    if (*hint) {
+        if (!last) {
+            return *hint;
+        }
+        *hint = NULL;
+        last = NULL;
+    }
+
+    return lys_getnext(last, parent, module, options);
+}
+
 /* keys do not have to be ordered and do not have to be all of them */
 static int
 resolve_extended_schema_nodeid_predicate(const char *nodeid, const struct lys_node *node,
@@ -1885,7 +1949,7 @@ resolve_schema_nodeid(const char *nodeid, const struct lys_node *start_parent, c
                       struct ly_set **ret, int extended, int no_node_error)
 {
     const char *name, *mod_name, *id, *backup_mod_name = NULL, *yang_data_name = NULL;
-    const struct lys_node *sibling, *next, *elem;
+    const struct lys_node *sibling, *next, *elem, *hint;
     struct lys_node_augment *last_aug;
     int r, nam_len, mod_name_len = 0, is_relative = -1, all_desc, has_predicate, nodeid_end = 0;
     int yang_data_name_len, backup_mod_name_len = 0;
@@ -1995,8 +2059,14 @@ get_next_augment:
             }
         }
 
-        while ((sibling = lys_getnext(sibling, (last_aug ? (struct lys_node *)last_aug : start_parent), start_mod,
-                LYS_GETNEXT_WITHCHOICE | LYS_GETNEXT_WITHCASE | LYS_GETNEXT_WITHINOUT | LYS_GETNEXT_PARENTUSES | LYS_GETNEXT_NOSTATECHECK))) {
+        /* the children of the parent itself are hashed */
+        hint = NULL;
+        if (!last_aug) {
+            hint = schema_nodeid_hint(start_parent, start_mod, cur_module, mod_name, mod_name_len, name, nam_len);
+        }
+        while ((sibling = schema_nodeid_getnext(sibling, &hint, (last_aug ? (struct lys_node *)last_aug : start_parent),
+                start_mod, LYS_GETNEXT_WITHCHOICE | LYS_GETNEXT_WITHCASE | LYS_GETNEXT_WITHINOUT | LYS_GETNEXT_PARENTUSES
+                | LYS_GETNEXT_NOSTATECHECK))) {
             r = schema_nodeid_siblingcheck(sibling, cur_module, mod_name, mod_name_len, name, nam_len);
 
             /* resolve predicate */
@@ -2237,7 +2307,7 @@ resolve_absolute_schema_nodeid(const char *nodeid, const struct lys_module *modu
                                const struct lys_node **ret)
 {
     const char *name, *mod_name, *id;
-    const struct lys_node *sibling, *start_parent;
+    const struct lys_node *sibling, *start_parent, *hint;
     int r, nam_len, mod_name_len, is_relative = -1;
     const struct lys_module *abs_start_mod;
 
@@ -2263,7 +2333,12 @@ resolve_absolute_schema_nodeid(const char *nodeid, const struct lys_module *modu
 
     while (1) {
         sibling = NULL;
-        while ((sibling = lys_getnext(sibling, start_parent, abs_start_mod, LYS_GETNEXT_WITHCHOICE
+        /* groupings are not hashed */
+        hint = NULL;
+        if (!(ret_nodetype & LYS_GROUPING)) {
+            hint = schema_nodeid_hint(start_parent, abs_start_mod, module, mod_name, mod_name_len, name, nam_len);
+        }
+        while ((sibling = schema_nodeid_getnext(sibling, &hint, start_parent, abs_start_mod, LYS_GETNEXT_WITHCHOICE
                 | LYS_GETNEXT_WITHCASE | LYS_GETNEXT_WITHINOUT | LYS_GETNEXT_WITHGROUPING | LYS_GETNEXT_NOSTATECHECK))) {
             r = schema_nodeid_siblingcheck(sibling, module, mod_name, mod_name_len, name, nam_len);
             if (r == 0) {
@@ -2340,12 +2415,12 @@ resolve_json_schema_list_predicate(const char *predicate, const struct lys_node_
 }
 
 /* cannot return LYS_GROUPING, LYS_AUGMENT, LYS_USES, logs directly */
-const struct lys_node *
-resolve_json_nodeid(const char *nodeid, struct ly_ctx *ctx, const struct lys_node *start, int output)
+static const struct lys_node *
+resolve_json_nodeid_(const char *nodeid, struct ly_ctx *ctx, const struct lys_node *start, int output)
 {
     char *str;
     const char *name, *mod_name, *id, *backup_mod_name = NULL, *yang_data_name = NULL;
-    const struct lys_node *sibling, *start_parent, *parent;
+    const struct lys_node *sibling, *start_parent, *parent, *hint;
     int r, nam_len, mod_name_len, is_relative = -1, has_predicate;
     int yang_data_name_len, backup_mod_name_len;
     /* resolved import module from the start module, it must match the next node-name-match sibling */
@@ -2433,7 +2508,17 @@ resolve_json_nodeid(const char *nodeid, struct ly_ctx *ctx, const struct lys_nod
 
     while (1) {
         sibling = NULL;
-        while ((sibling = lys_getnext(sibling, start_parent, module, 0))) {
+        hint = NULL;
+        if (start_parent || (!module->disabled && module->implemented)) {
+            /* the data children of the parent are hashed, disabled nodes too */
+            prefix_mod = mod_name ? ly_ctx_nget_module(ctx, mod_name, mod_name_len, NULL, 1) : prev_mod;
+            if (prefix_mod && !lys_find_child_hash(ctx, start_parent, module, (output ? LYS_OUTPUT : LYS_INPUT), name,
+                                                   nam_len, lys_main_module(prefix_mod)->ns, &hint)
+                    && hint && lys_is_disabled(hint, 2)) {
+                hint = NULL;
+            }
+        }
+        while ((sibling = schema_nodeid_getnext(sibling, &hint, start_parent, module, 0))) {
             /* name match */
             if (sibling->name && !strncmp(name, sibling->name, nam_len) && !sibling->name[nam_len]) {
                 /* output check */
@@ -2521,6 +2606,27 @@ resolve_json_nodeid(const char *nodeid, struct ly_ctx *ctx, const struct lys_nod
     return NULL;
 }
 
+const struct lys_node *
+resolve_json_nodeid(const char *nodeid, struct ly_ctx *ctx, const struct lys_node *start, int output)
+{
+    const struct lys_node *node;
+    int kind = output ? LYS_PATH_JSON_OUTPUT : LYS_PATH_JSON;
+
+    if (start) {
+        return resolve_json_nodeid_(nodeid, ctx, start, output);
+    }
+
+    /* the same absolute paths are usually resolved over and over again */
+    if (!lys_path_hash_find(ctx, nodeid, kind, &node, NULL)) {
+        return node;
+    }
+    node = resolve_json_nodeid_(nodeid, ctx, NULL, output);
+    if (node) {
+        lys_path_hash_add(ctx, nodeid, kind, node, NULL);
+    }
+    return node;
+}
+
 static int
 resolve_partial_json_data_list_predicate(struct parsed_pred pp, struct lyd_node *node, int position)
 {
@@ -2746,9 +2852,10 @@ resolve_partial_json_data_nodeid(const char *nodeid, const char *llist_value, st
         }
 
 #ifdef LY_ENABLED_CACHE
-        /* we will not be matching keyless lists or state leaf-lists this way */
+        /* we will not be matching keyless lists, state leaf-lists, or values hashed by user type plugins this way */
         if (start->parent && start->parent->ht && ((pp.schema->nodetype != LYS_LIST) || ((struct lys_node_list *)pp.schema)->keys_size)
-                && ((pp.schema->nodetype != LYS_LEAFLIST) || (pp.schema->flags & LYS_CONFIG_W))) {
+                && ((pp.schema->nodetype != LYS_LEAFLIST) || (pp.schema->flags & LYS_CONFIG_W))
+                && !lyd_hash_user_type(pp.schema)) {
             sibling = resolve_json_data_node_hash(start->parent, pp);
         } else
 #endif
@@ -3292,6 +3399,179 @@ error:
     return -1;
 }
 
+/**
+ * @brief Get the length or range restriction of a type or of its nearest superior type. Does not log.
+ *
+ * @param[in] type Type to examine.
+ * @return Found restriction, NULL if there is none.
+ */
+static struct lys_restr *
+len_ran_restr(struct lys_type *type)
+{
+    struct lys_restr *restr;
+
+    for (; type; type = (type->der ? &type->der->type : NULL)) {
+        switch (type->base) {
+        case LY_TYPE_BINARY:
+            restr = type->info.binary.length;
+            break;
+        case LY_TYPE_DEC64:
+            restr = type->info.dec64.range;
+            break;
+        case LY_TYPE_INT8:
+        case LY_TYPE_INT16:
+        case LY_TYPE_INT32:
+        case LY_TYPE_INT64:
+        case LY_TYPE_UINT8:
+        case LY_TYPE_UINT16:
+        case LY_TYPE_UINT32:
+        case LY_TYPE_UINT64:
+            restr = type->info.num.range;
+            break;
+        case LY_TYPE_STRING:
+            restr = type->info.str.length;
+            break;
+        default:
+            return NULL;
+        }
+
+        if (restr) {
+            return restr;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Compile the intervals of a type into flat arrays. Logs directly.
+ *
+ * @param[in] ctx Context for errors.
+ * @param[in] type Type with the restrictions.
+ * @param[out] ret Compiled intervals, NULL if there are no restrictions.
+ * @return EXIT_SUCCESS on success, -1 on error.
+ */
+static int
+len_ran_compile(struct ly_ctx *ctx, struct lys_type *type, struct len_ran_cmp **ret)
+{
+    struct len_ran_intv *intv = NULL, *tmp_intv;
+    struct len_ran_cmp *cmp;
+    struct len_ran_group *group = NULL;
+    struct len_ran_bound *bound;
+    struct lys_type *prev_type = NULL;
+    uint32_t group_count = 0, count = 0;
+
+    *ret = NULL;
+    if (resolve_len_ran_interval(ctx, NULL, type, &intv)) {
+        return -1;
+    }
+    if (!intv) {
+        return EXIT_SUCCESS;
+    }
+
+    /* all the intervals belonging to a single restriction share one type pointer */
+    for (tmp_intv = intv; tmp_intv; tmp_intv = tmp_intv->next) {
+        if (!tmp_intv->next || (tmp_intv->next->type != tmp_intv->type)) {
+            ++group_count;
+        }
+        ++count;
+    }
+
+    cmp = malloc(sizeof *cmp + group_count * sizeof *cmp->group + count * sizeof *bound);
+    LY_CHECK_ERR_GOTO(!cmp, LOGMEM(ctx), cleanup);
+    cmp->group_count = 0;
+    bound = (struct len_ran_bound *)&cmp->group[group_count];
+
+    for (tmp_intv = intv; tmp_intv; tmp_intv = tmp_intv->next) {
+        if (!group || (tmp_intv->type != prev_type)) {
+            group = &cmp->group[cmp->group_count++];
+            group->restr = len_ran_restr(tmp_intv->type);
+            group->count = 0;
+            group->intv = bound;
+        }
+
+        if (tmp_intv->kind == 0) {
+            bound->min = tmp_intv->value.uval.min;
+            bound->max = tmp_intv->value.uval.max;
+        } else if (tmp_intv->kind == 1) {
+            bound->min = LEN_RAN_SIGNED(tmp_intv->value.sval.min);
+            bound->max = LEN_RAN_SIGNED(tmp_intv->value.sval.max);
+        } else {
+            /* fraction-digits value is always the same (it cannot be changed in derived types) */
+            bound->min = LEN_RAN_SIGNED(tmp_intv->value.fval.min);
+            bound->max = LEN_RAN_SIGNED(tmp_intv->value.fval.max);
+        }
+        ++group->count;
+        ++bound;
+        prev_type = tmp_intv->type;
+    }
+    assert(cmp->group_count == group_count);
+    *ret = cmp;
+
+cleanup:
+    while (intv) {
+        tmp_intv = intv->next;
+        free(intv);
+        intv = tmp_intv;
+    }
+    return *ret ? EXIT_SUCCESS : -1;
+}
+
+/**
+ * @brief Get the compiled intervals of all the length/range restrictions of a type. With the cache enabled,
+ * they are compiled only once and owned by the restriction, otherwise the caller must free them.
+ * Logs directly.
+ *
+ * @param[in] ctx Context for errors.
+ * @param[in] type Type with the restrictions.
+ * @param[out] ret Compiled intervals, NULL if the type has no restrictions.
+ * @return EXIT_SUCCESS on success, -1 on error.
+ */
+int
+resolve_len_ran_compiled(struct ly_ctx *ctx, struct lys_type *type, struct len_ran_cmp **ret)
+{
+    struct lys_restr *restr;
+
+    restr = len_ran_restr(type);
+    if (!restr) {
+        *ret = NULL;
+        return EXIT_SUCCESS;
+    }
+
+#ifdef LY_ENABLED_CACHE
+    if (!restr->intv && len_ran_compile(ctx, type, (struct len_ran_cmp **)&restr->intv)) {
+        return -1;
+    }
+    *ret = restr->intv;
+    return EXIT_SUCCESS;
+#else
+    return len_ran_compile(ctx, type, ret);
+#endif
+}
+
+/**
+ * @brief Check whether a value belongs to any interval of a restriction. Does not log.
+ *
+ * @param[in] group Compiled restriction.
+ * @param[in] value Value to check, signed values converted with #LEN_RAN_SIGNED.
+ * @return 1 if the value matches, 0 otherwise.
+ */
+int
+resolve_len_ran_match(const struct len_ran_group *group, uint64_t value)
+{
+    const struct len_ran_bound *base = group->intv;
+    uint32_t count = group->count, half;
+
+    /* find the last interval with min not greater than the value */
+    while (count > 1) {
+        half = count / 2;
+        base = (base[half].min <= value) ? &base[half] : base;
+        count -= half;
+    }
+
+    return (base->min <= value) && (value <= base->max);
+}
+
 /**
  * @brief Resolve a typedef, return only resolved typedefs if derived. If leafref, it must be
  * resolved for this function to return it. Does not log.
@@ -4138,7 +4418,7 @@ cleanup:
 static int
 resolve_schema_leafref(struct lys_type *type, struct lys_node *parent, struct unres_schema *unres)
 {
-    const struct lys_node *node, *op_node = NULL, *tmp_parent;
+    const struct lys_node *node, *op_node = NULL, *tmp_parent, *hint;
     struct lys_node_augment *last_aug;
     const struct lys_module *tmp_mod, *cur_module;
     const char *id, *prefix, *name;
@@ -4220,7 +4500,12 @@ resolve_schema_leafref(struct lys_type *type, struct lys_node *parent, struct un
 
             tmp_parent = (last_aug ? (struct lys_node *)last_aug : node);
             node = NULL;
-            while ((node = lys_getnext(node, tmp_parent, tmp_mod, LYS_GETNEXT_NOSTATECHECK))) {
+            hint = NULL;
+            if (!last_aug && lys_find_child_hash(ctx, tmp_parent, tmp_mod, 0, name, nam_len, lys_main_module(tmp_mod)->ns,
+                                                 &hint)) {
+                hint = NULL;
+            }
+            while ((node = schema_nodeid_getnext(node, &hint, tmp_parent, tmp_mod, LYS_GETNEXT_NOSTATECHECK))) {
                 if (lys_node_module(node) != lys_main_module(tmp_mod)) {
                     continue;
                 }
@@ -4666,7 +4951,7 @@ inherit_config_flag(struct lys_node *node, int flags, int clear)
  * @return EXIT_SUCCESS on success, EXIT_FAILURE on forward reference, -1 on error.
  */
 static int
-resolve_augment(struct lys_node_augment *aug, struct lys_node *uses, struct unres_schema *unres)
+resolve_augment_(struct lys_node_augment *aug, struct lys_node *uses, struct unres_schema *unres)
 {
     int rc;
     struct lys_node *sub;
@@ -4770,6 +5055,19 @@ resolve_augment(struct lys_node_augment *aug, struct lys_node *uses, struct unre
     return EXIT_SUCCESS;
 }
 
+static int
+resolve_augment(struct lys_node_augment *aug, struct lys_node *uses, struct unres_schema *unres)
+{
+    struct ly_stats_phase_prev phase;
+    int rc;
+
+    ly_stats_phase_enter(aug->module->ctx, LY_STATS_PHASE_AUGDEV, &phase);
+    rc = resolve_augment_(aug, uses, unres);
+    ly_stats_phase_leave(&phase);
+
+    return rc;
+}
+
 static int
 resolve_extension(struct unres_ext *info, struct lys_ext_instance **ext, struct unres_schema *unres)
 {
@@ -4782,7 +5080,9 @@ resolve_extension(struct unres_ext *info, struct lys_ext_instance **ext, struct
     const struct lys_module *mod;
     struct lys_ext_instance *tmp_ext;
     struct ly_ctx *ctx = NULL;
+    struct timespec start;
     LYEXT_TYPE etype;
+    int r;
 
     switch (info->parent_type) {
     case LYEXT_PAR_NODE:
@@ -4838,7 +5138,10 @@ resolve_extension(struct unres_ext *info, struct lys_ext_instance **ext, struct
 
         if (e->plugin && e->plugin->check_position) {
             /* common part - we have plugin with position checking function, use it first */
-            if ((*e->plugin->check_position)(info->parent, info->parent_type, info->substmt)) {
+            ly_plugin_stats_start(ctx, &start);
+            r = (*e->plugin->check_position)(info->parent, info->parent_type, info->substmt);
+            ly_plugin_stats_add(ctx, &start, LY_PLUGIN_CHECK_POSITION, e->module->name, e->name);
+            if (r) {
                 /* extension is not allowed here */
                 LOGVAL(ctx, LYE_INSTMT, vlog_type, vlog_node, e->name);
                 return -1;
@@ -4997,7 +5300,10 @@ resolve_extension(struct unres_ext *info, struct lys_ext_instance **ext, struct
 
         if (e->plugin && e->plugin->check_position) {
             /* common part - we have plugin with position checking function, use it first */
-            if ((*e->plugin->check_position)(info->parent, info->parent_type, info->substmt)) {
+            ly_plugin_stats_start(ctx, &start);
+            r = (*e->plugin->check_position)(info->parent, info->parent_type, info->substmt);
+            ly_plugin_stats_add(ctx, &start, LY_PLUGIN_CHECK_POSITION, e->module->name, e->name);
+            if (r) {
                 /* extension is not allowed here */
                 LOGVAL(ctx, LYE_INSTMT, vlog_type, vlog_node, e->name);
                 goto error;
@@ -5318,6 +5624,7 @@ resolve_uses(struct lys_node_uses *uses, struct unres_schema *unres)
             must = realloc(*old_must, size * sizeof *rfn->must);
             LY_CHECK_ERR_GOTO(!must, LOGMEM(ctx), fail);
             for (k = 0, j = *old_size; k < rfn->must_size; k++, j++) {
+                memset(&must[j], 0, sizeof *must);
                 must[j].ext_size = rfn->must[k].ext_size;
                 lys_ext_dup(ctx, rfn->module, rfn->must[k].ext, rfn->must[k].ext_size, &rfn->must[k], LYEXT_PAR_RESTR,
                             &must[j].ext, 0, unres);
@@ -5362,6 +5669,9 @@ resolve_uses(struct lys_node_uses *uses, struct unres_schema *unres)
                     iff[j].features = malloc(usize2 * sizeof *iff[k].features);
                     LY_CHECK_ERR_GOTO(!iff[j].expr, LOGMEM(ctx), fail);
                     memcpy(iff[j].features, rfn->iffeature[k].features, usize2 * sizeof *iff[j].features);
+#ifdef LY_ENABLED_CACHE
+                    iff[j].value_cache = 0;
+#endif
 
                     /* duplicate extensions */
                     iff[j].ext_size = rfn->iffeature[k].ext_size;
@@ -5731,10 +6041,12 @@ resolve_base_ident(const struct lys_module *module, struct lys_ident *ident, con
 static int
 search_base_identity(struct lys_ident *der, struct lys_ident *base)
 {
-    int i;
+    int i, derived;
 
     if (der == base) {
         return 1;
+    } else if (!lys_ident_derived_hash(der->module->ctx, der, base, &derived)) {
+        return derived;
     } else {
         for(i = 0; i < der->base_size; i++) {
             if (search_base_identity(der->base[i], base) == 1) {
@@ -5900,6 +6212,14 @@ resolve_identref(struct lys_type *type, const char *ident_name, struct lyd_node
 
             if (cur->der) {
                 /* there are some derived identities */
+                if (!lys_find_ident_hash(ctx, cur, name, nam_len, imod, &der)) {
+                    if (der) {
+                        /* we have match */
+                        cur = der;
+                        goto match;
+                    }
+                    continue;
+                }
                 for (j = 0; j < cur->der->number; j++) {
                     der = (struct lys_ident *)cur->der->set.g[j]; /* shortcut */
                     if (!strcmp(der->name, name) && lys_main_module(der->module) == imod) {
@@ -6066,8 +6386,13 @@ resolve_list_keys(struct lys_node_list *list, const char *keys_str)
             len = strlen(keys_str);
         }
 
-        rc = lys_getnext_data(lys_node_module((struct lys_node *)list), (struct lys_node *)list, keys_str, len, LYS_LEAF,
-                              (const struct lys_node **)&list->keys[i]);
+        if (list->keys[i] && !strncmp(list->keys[i]->name, keys_str, len) && !list->keys[i]->name[len]) {
+            /* key rebound when instantiating a grouping */
+            rc = 0;
+        } else {
+            rc = lys_getnext_data(lys_node_module((struct lys_node *)list), (struct lys_node *)list, keys_str, len,
+                                  LYS_LEAF, (const struct lys_node **)&list->keys[i]);
+        }
         if (rc) {
             LOGVAL(ctx, LYE_INRESOLV, LY_VLOG_LYS, list, "list key", keys_str);
             return EXIT_FAILURE;
@@ -6108,6 +6433,46 @@ resolve_list_keys(struct lys_node_list *list, const char *keys_str)
     return EXIT_SUCCESS;
 }
 
+/**
+ * @brief Evaluate a must condition, reusing its parsed expression if possible.
+ * Logs directly.
+ *
+ * @param[in] must Must restriction to evaluate.
+ * @param[in] node Current (context) data node.
+ * @param[out] set Result set.
+ *
+ * @return EXIT_SUCCESS on success, EXIT_FAILURE on unresolved when dependency, -1 on error.
+ */
+static int
+resolve_must_eval(struct lys_restr *must, struct lyd_node *node, struct lyxp_set *set)
+{
+    struct ly_ctx *ctx = node->schema->module->ctx;
+    struct timespec prof_start;
+    int rc;
+#ifdef LY_ENABLED_CACHE
+    struct lyxp_expr *exp;
+#endif
+
+    ly_val_prof_start(ctx, &prof_start);
+    LY_STATS_ADD(ctx, must_evals, 1);
+
+#ifdef LY_ENABLED_CACHE
+    /* build the cache if there is none */
+    exp = lyxp_compile_expr_cached(ctx, must->expr, &must->expr_xpath);
+    if (!exp) {
+        return -1;
+    }
+
+    rc = lyxp_eval_expr(exp, node, LYXP_NODE_ELEM, lyd_node_module(node), set, LYXP_MUST);
+#else
+    rc = lyxp_eval(must->expr, node, LYXP_NODE_ELEM, lyd_node_module(node), set, LYXP_MUST);
+#endif
+
+    ly_val_prof_add(ctx, &prof_start, LY_VAL_PROF_MUST, node->schema, must->expr,
+                    (!rc && (set->type == LYXP_SET_NODE_SET)) ? set->used : 0);
+    return rc;
+}
+
 /**
  * @brief Resolve (check) all must conditions of \p node.
  * Logs directly.
@@ -6180,7 +6545,7 @@ resolve_must(struct lyd_node *node, int inout_parent, int ignore_fail)
     }
 
     for (i = 0; i < must_size; ++i) {
-        if (lyxp_eval(must[i].expr, node, LYXP_NODE_ELEM, lyd_node_module(node), &set, LYXP_MUST)) {
+        if (resolve_must_eval(&must[i], node, &set)) {
             return -1;
         }
 
@@ -6205,6 +6570,62 @@ resolve_must(struct lyd_node *node, int inout_parent, int ignore_fail)
     return EXIT_SUCCESS;
 }
 
+/**
+ * @brief Evaluate a when condition, reusing its parsed expression if possible.
+ * Logs directly.
+ *
+ * @param[in] when When condition to evaluate.
+ * @param[in] snode Schema node with the condition.
+ * @param[in] ctx_node Context data node.
+ * @param[in] ctx_node_type Context data node type.
+ * @param[in] local_mod Module of the schema node with the condition.
+ * @param[out] set Result set.
+ *
+ * @return EXIT_SUCCESS on success, EXIT_FAILURE on unresolved when dependency, -1 on error.
+ */
+static int
+resolve_when_eval(struct lys_when *when, const struct lys_node *snode, struct lyd_node *ctx_node,
+                  enum lyxp_node_type ctx_node_type, const struct lys_module *local_mod, struct lyxp_set *set,
+                  const struct lys_node *hide_snode, const struct lyd_node *hide_parent)
+{
+    struct timespec prof_start;
+    int rc;
+    struct lyxp_expr *exp;
+
+    ly_val_prof_start(local_mod->ctx, &prof_start);
+    LY_STATS_ADD(local_mod->ctx, when_evals, 1);
+
+#ifdef LY_ENABLED_CACHE
+    /* build the cache if there is none */
+    exp = lyxp_compile_expr_cached(local_mod->ctx, when->cond, &when->cond_xpath);
+    if (!exp) {
+        return -1;
+    }
+
+    if (hide_snode) {
+        rc = lyxp_eval_expr_hide(exp, ctx_node, ctx_node_type, local_mod, set, LYXP_WHEN, hide_snode,
+                                 hide_parent);
+    } else {
+        rc = lyxp_eval_expr(exp, ctx_node, ctx_node_type, local_mod, set, LYXP_WHEN);
+    }
+#else
+    if (!hide_snode) {
+        rc = lyxp_eval(when->cond, ctx_node, ctx_node_type, local_mod, set, LYXP_WHEN);
+    } else {
+        exp = lyxp_compile_expr(local_mod->ctx, when->cond);
+        if (!exp) {
+            return -1;
+        }
+        rc = lyxp_eval_expr_hide(exp, ctx_node, ctx_node_type, local_mod, set, LYXP_WHEN, hide_snode, hide_parent);
+        lyxp_expr_free(exp);
+    }
+#endif
+
+    ly_val_prof_add(local_mod->ctx, &prof_start, LY_VAL_PROF_WHEN, snode, when->cond,
+                    (!rc && (set->type == LYXP_SET_NODE_SET)) ? set->used : 0);
+    return rc;
+}
+
 /**
  * @brief Resolve (find) when condition schema context node. Does not log.
  *
@@ -6299,163 +6720,25 @@ resolve_when_ctx_node(struct lyd_node *node, struct lys_node *schema, struct lyd
     return EXIT_SUCCESS;
 }
 
-/**
- * @brief Temporarily unlink nodes as per YANG 1.1 RFC section 7.21.5 for when XPath evaluation.
- * The context node is adjusted if needed.
- *
- * @param[in] snode Schema node, whose children instances need to be unlinked.
- * @param[in,out] node Data siblings where to look for the children of \p snode. If it is unlinked,
- * it is moved to point to another sibling still in the original tree.
- * @param[in,out] ctx_node When context node, adjusted if needed.
- * @param[in] ctx_node_type Context node type, just for information to detect invalid situations.
- * @param[out] unlinked_nodes Unlinked siblings. Can be safely appended to \p node afterwards.
- * Ordering may change, but there will be no semantic change.
- *
- * @return EXIT_SUCCESS on success, -1 on error.
- */
-static int
-resolve_when_unlink_nodes(struct lys_node *snode, struct lyd_node **node, struct lyd_node **ctx_node,
-                          enum lyxp_node_type ctx_node_type, struct lyd_node **unlinked_nodes)
+int
+resolve_applies_must(const struct lyd_node *node)
 {
-    struct lyd_node *next, *elem;
-    const struct lys_node *slast;
-    struct ly_ctx *ctx = snode->module->ctx;
+    int ret = 0;
+    uint8_t must_size;
+    struct lys_node *schema, *iter;
 
-    switch (snode->nodetype) {
-    case LYS_AUGMENT:
-    case LYS_USES:
-    case LYS_CHOICE:
-    case LYS_CASE:
-        slast = NULL;
-        while ((slast = lys_getnext(slast, snode, NULL, LYS_GETNEXT_PARENTUSES))) {
-            if (slast->nodetype & (LYS_ACTION | LYS_NOTIF)) {
-                continue;
-            }
+    assert(node);
 
-            if (resolve_when_unlink_nodes((struct lys_node *)slast, node, ctx_node, ctx_node_type, unlinked_nodes)) {
-                return -1;
-            }
-        }
-        break;
+    schema = node->schema;
+
+    /* their own must */
+    switch (schema->nodetype) {
     case LYS_CONTAINER:
-    case LYS_LIST:
+        must_size = ((struct lys_node_container *)schema)->must_size;
+        break;
     case LYS_LEAF:
-    case LYS_LEAFLIST:
-    case LYS_ANYXML:
-    case LYS_ANYDATA:
-        LY_TREE_FOR_SAFE(lyd_first_sibling(*node), next, elem) {
-            if (elem->schema == snode) {
-
-                if (elem == *ctx_node) {
-                    /* We are going to unlink our context node! This normally cannot happen,
-                     * but we use normal top-level data nodes for faking a document root node,
-                     * so if this is the context node, we just use the next top-level node.
-                     * Additionally, it can even happen that there are no top-level data nodes left,
-                     * all were unlinked, so in this case we pass NULL as the context node/data tree,
-                     * lyxp_eval() can handle this special situation.
-                     */
-                    if (ctx_node_type == LYXP_NODE_ELEM) {
-                        LOGINT(ctx);
-                        return -1;
-                    }
-
-                    if (elem->prev == elem) {
-                        /* unlinking last top-level element, use an empty data tree */
-                        *ctx_node = NULL;
-                    } else {
-                        /* in this case just use the previous/last top-level data node */
-                        *ctx_node = elem->prev;
-                    }
-                } else if (elem == *node) {
-                    /* We are going to unlink the currently processed node. This does not matter that
-                     * much, but we would lose access to the original data tree, so just move our
-                     * pointer somewhere still inside it.
-                     */
-                    if ((*node)->prev != *node) {
-                        *node = (*node)->prev;
-                    } else {
-                        /* the processed node with sibings were all unlinked, oh well */
-                        *node = NULL;
-                    }
-                }
-
-                /* temporarily unlink the node */
-                lyd_unlink_internal(elem, 0);
-                if (*unlinked_nodes) {
-                    if (lyd_insert_after((*unlinked_nodes)->prev, elem)) {
-                        LOGINT(ctx);
-                        return -1;
-                    }
-                } else {
-                    *unlinked_nodes = elem;
-                }
-
-                if (snode->nodetype & (LYS_CONTAINER | LYS_LEAF | LYS_ANYDATA)) {
-                    /* there can be only one instance */
-                    break;
-                }
-            }
-        }
-        break;
-    default:
-        LOGINT(ctx);
-        return -1;
-    }
-
-    return EXIT_SUCCESS;
-}
-
-/**
- * @brief Relink the unlinked nodes back.
- *
- * @param[in] node Data node to link the nodes back to. It can actually be the adjusted context node,
- * we simply need a sibling from the original data tree.
- * @param[in] unlinked_nodes Unlinked nodes to relink to \p node.
- * @param[in] ctx_node_type Context node type to distinguish between \p node being the parent
- * or the sibling of \p unlinked_nodes.
- *
- * @return EXIT_SUCCESS on success, -1 on error.
- */
-static int
-resolve_when_relink_nodes(struct lyd_node *node, struct lyd_node *unlinked_nodes, enum lyxp_node_type ctx_node_type)
-{
-    struct lyd_node *elem;
-
-    LY_TREE_FOR_SAFE(unlinked_nodes, unlinked_nodes, elem) {
-        lyd_unlink_internal(elem, 0);
-        if (ctx_node_type == LYXP_NODE_ELEM) {
-            if (lyd_insert_common(node, NULL, elem, 0)) {
-                return -1;
-            }
-        } else {
-            if (lyd_insert_nextto(node, elem, 0, 0)) {
-                return -1;
-            }
-        }
-    }
-
-    return EXIT_SUCCESS;
-}
-
-int
-resolve_applies_must(const struct lyd_node *node)
-{
-    int ret = 0;
-    uint8_t must_size;
-    struct lys_node *schema, *iter;
-
-    assert(node);
-
-    schema = node->schema;
-
-    /* their own must */
-    switch (schema->nodetype) {
-    case LYS_CONTAINER:
-        must_size = ((struct lys_node_container *)schema)->must_size;
-        break;
-    case LYS_LEAF:
-        must_size = ((struct lys_node_leaf *)schema)->must_size;
-        break;
+        must_size = ((struct lys_node_leaf *)schema)->must_size;
+        break;
     case LYS_LEAFLIST:
         must_size = ((struct lys_node_leaflist *)schema)->must_size;
         break;
@@ -6576,7 +6859,7 @@ check_augment:
 int
 resolve_when(struct lyd_node *node, int ignore_fail, struct lys_when **failed_when)
 {
-    struct lyd_node *ctx_node = NULL, *unlinked_nodes, *tmp_node;
+    struct lyd_node *ctx_node = NULL;
     struct lys_node *sparent;
     struct lyxp_set set;
     enum lyxp_node_type ctx_node_type;
@@ -6589,8 +6872,8 @@ resolve_when(struct lyd_node *node, int ignore_fail, struct lys_when **failed_wh
     if (!(node->schema->nodetype & (LYS_NOTIF | LYS_RPC | LYS_ACTION)) && snode_get_when(node->schema)) {
         /* make the node dummy for the evaluation */
         node->validity |= LYD_VAL_INUSE;
-        rc = lyxp_eval(snode_get_when(node->schema)->cond, node, LYXP_NODE_ELEM, lyd_node_module(node),
-                       &set, LYXP_WHEN);
+        rc = resolve_when_eval(snode_get_when(node->schema), node->schema, node, LYXP_NODE_ELEM, lyd_node_module(node),
+                               &set, NULL, NULL);
         node->validity &= ~LYD_VAL_INUSE;
         if (rc) {
             if (rc == 1) {
@@ -6633,24 +6916,9 @@ resolve_when(struct lyd_node *node, int ignore_fail, struct lys_when **failed_wh
                 }
             }
 
-            unlinked_nodes = NULL;
-            /* we do not want our node pointer to change */
-            tmp_node = node;
-            rc = resolve_when_unlink_nodes(sparent, &tmp_node, &ctx_node, ctx_node_type, &unlinked_nodes);
-            if (rc) {
-                goto cleanup;
-            }
-
-            rc = lyxp_eval(snode_get_when(sparent)->cond, ctx_node, ctx_node_type, lys_node_module(sparent),
-                           &set, LYXP_WHEN);
-
-            if (unlinked_nodes && ctx_node) {
-                if (resolve_when_relink_nodes(ctx_node, unlinked_nodes, ctx_node_type)) {
-                    rc = -1;
-                    goto cleanup;
-                }
-            }
-
+            /* the instances of the nodes under sparent are not accessible (RFC 7950 section 7.21.5) */
+            rc = resolve_when_eval(snode_get_when(sparent), sparent, ctx_node, ctx_node_type, lys_node_module(sparent),
+                                   &set, sparent, node->parent);
             if (rc) {
                 if (rc == 1) {
                     LOGVAL(ctx, LYE_INWHEN, LY_VLOG_LYD, node, snode_get_when(sparent)->cond);
@@ -6687,26 +6955,8 @@ check_augment:
                 }
             }
 
-            unlinked_nodes = NULL;
-            tmp_node = node;
-            rc = resolve_when_unlink_nodes(sparent->parent, &tmp_node, &ctx_node, ctx_node_type, &unlinked_nodes);
-            if (rc) {
-                goto cleanup;
-            }
-
-            rc = lyxp_eval(snode_get_when(sparent->parent)->cond, ctx_node, ctx_node_type,
-                           lys_node_module(sparent->parent), &set, LYXP_WHEN);
-
-            /* reconnect nodes, if ctx_node is NULL then all the nodes were unlinked, but linked together,
-             * so the tree did not actually change and there is nothing for us to do
-             */
-            if (unlinked_nodes && ctx_node) {
-                if (resolve_when_relink_nodes(ctx_node, unlinked_nodes, ctx_node_type)) {
-                    rc = -1;
-                    goto cleanup;
-                }
-            }
-
+            rc = resolve_when_eval(snode_get_when(sparent->parent), sparent->parent, ctx_node, ctx_node_type,
+                                   lys_node_module(sparent->parent), &set, sparent->parent, node->parent);
             if (rc) {
                 if (rc == 1) {
                     LOGVAL(ctx, LYE_INWHEN, LY_VLOG_LYD, node, snode_get_when(sparent->parent)->cond);
@@ -6773,6 +7023,26 @@ check_type_union_leafref(struct lys_type *type)
     return type->der->has_union_leafref;
 }
 
+/**
+ * @brief Precompute the NACM default-deny flags of a schema node with an instance of the extension.
+ *
+ * @param[in] ext Extension instance, explicit or inherited.
+ * @param[in] node Schema node with the instance.
+ */
+static void
+resolve_ext_nacm(const struct lys_ext_instance *ext, struct lys_node *node)
+{
+    if (strcmp(ext->def->module->name, "ietf-netconf-acm")) {
+        return;
+    }
+
+    if (!strcmp(ext->def->name, "default-deny-write")) {
+        node->flags |= LYS_NACM_DENYW;
+    } else if (!strcmp(ext->def->name, "default-deny-all")) {
+        node->flags |= LYS_NACM_DENYA;
+    }
+}
+
 /**
  * @brief Resolve a single unres schema item. Logs indirectly.
  *
@@ -6809,6 +7079,7 @@ resolve_unres_schema_item(struct lys_module *mod, void *item, enum UNRES_ITEM ty
     struct unres_ext *ext_data;
     struct lys_ext_instance *ext, **extlist;
     struct lyext_plugin *eplugin;
+    struct timespec start;
 
     switch (type) {
     case UNRES_IDENT:
@@ -7009,7 +7280,12 @@ featurecheckdone:
         break;
     case UNRES_XPATH:
         node = (struct lys_node *)item;
-        rc = check_xpath(node, 1);
+        if (!lys_node_module(node)->implemented) {
+            /* there are no data of only imported modules, the expressions are checked once they are implemented */
+            rc = EXIT_SUCCESS;
+        } else {
+            rc = check_xpath(node, 1);
+        }
         break;
     case UNRES_MOD_IMPLEMENT:
         rc = lys_make_implemented_r(mod, unres);
@@ -7058,6 +7334,7 @@ featurecheckdone:
         /* inherit */
         if ((eplugin->flags & LYEXT_OPT_INHERIT) && (ext->parent_type == LYEXT_PAR_NODE)) {
             root = (struct lys_node *)ext->parent;
+            resolve_ext_nacm(ext, root);
             if (!(root->nodetype & (LYS_LEAF | LYS_LEAFLIST | LYS_ANYDATA))) {
                 LY_TREE_DFS_BEGIN(root->child, next, node) {
                     /* first, check if the node already contain instance of the same extension,
@@ -7072,7 +7349,10 @@ featurecheckdone:
 
                     if (eplugin->check_inherit) {
                         /* we have a callback to check the inheritance, use it */
-                        switch ((rc = (*eplugin->check_inherit)(ext, node))) {
+                        ly_plugin_stats_start(ctx, &start);
+                        rc = (*eplugin->check_inherit)(ext, node);
+                        ly_plugin_stats_add(ctx, &start, LY_PLUGIN_CHECK_INHERIT, ext->def->module->name, ext->def->name);
+                        switch (rc) {
                         case 0:
                             /* yes - continue with the inheriting code */
                             break;
@@ -7098,6 +7378,7 @@ featurecheckdone:
 
                     node->ext = extlist;
                     node->ext_size++;
+                    resolve_ext_nacm(ext, node);
 
 inherit_dfs_child:
                     /* modification of - select element for the next run - children first */
@@ -7129,7 +7410,10 @@ inherit_dfs_sibling:
 
         /* final check */
         if (eplugin->check_result) {
-            if ((*eplugin->check_result)(ext)) {
+            ly_plugin_stats_start(ctx, &start);
+            rc = (*eplugin->check_result)(ext);
+            ly_plugin_stats_add(ctx, &start, LY_PLUGIN_CHECK_RESULT, ext->def->module->name, ext->def->name);
+            if (rc) {
                 LOGERR(ctx, LY_EPLUGIN, "Resolving extension failed.");
                 return -1;
             }
@@ -7236,15 +7520,282 @@ print_unres_schema_item_fail(void *item, enum UNRES_ITEM type, void *str_node)
     }
 }
 
+/* record of unres_schema index */
+struct unres_schema_rec {
+    enum UNRES_ITEM type;
+    const void *item;       /* for UNRES_LIST_UNIQ the list */
+    const char *expr;       /* for UNRES_LIST_UNIQ the unique expression */
+    uint32_t idx;           /* the last item with this key */
+    uint8_t multi;          /* there are more items with this key */
+};
+
+static int
+unres_schema_rec_equal(void *val1_p, void *val2_p, int UNUSED(mod), void *UNUSED(cb_data))
+{
+    struct unres_schema_rec *rec1 = (struct unres_schema_rec *)val1_p, *rec2 = (struct unres_schema_rec *)val2_p;
+
+    return (rec1->type == rec2->type) && (rec1->item == rec2->item) && ly_strequal(rec1->expr, rec2->expr, 0);
+}
+
+/* fill the key of an index record, returns its hash */
+static uint32_t
+unres_schema_rec_key(struct unres_schema_rec *rec, const void *item, enum UNRES_ITEM type)
+{
+    uint32_t hash;
+
+    rec->type = type;
+    if (type == UNRES_LIST_UNIQ) {
+        rec->item = ((struct unres_list_uniq *)item)->list;
+        rec->expr = ((struct unres_list_uniq *)item)->expr;
+    } else {
+        rec->item = item;
+        rec->expr = NULL;
+    }
+
+    hash = dict_hash_multi(0, (const char *)&rec->type, sizeof rec->type);
+    hash = dict_hash_multi(hash, (const char *)&rec->item, sizeof rec->item);
+    if (rec->expr) {
+        hash = dict_hash_multi(hash, rec->expr, strlen(rec->expr));
+    }
+    return dict_hash_multi(hash, NULL, 0);
+}
+
+/**
+ * @brief Find the index record of an unres schema item.
+ *
+ * @param[in] unres Unres schema structure.
+ * @param[in] item Item, for UNRES_LIST_UNIQ an unres_list_uniq structure.
+ * @param[in] type Type of the item.
+ * @return Found record, NULL if there is no such item.
+ */
+static struct unres_schema_rec *
+unres_schema_rec_find(struct unres_schema *unres, const void *item, enum UNRES_ITEM type)
+{
+    struct unres_schema_rec rec, *match;
+
+    if (!unres->ht) {
+        return NULL;
+    }
+    if (lyht_find(unres->ht, &rec, unres_schema_rec_key(&rec, item, type), (void **)&match)) {
+        return NULL;
+    }
+    return match;
+}
+
+/* add the last unres item into the index */
+static int
+unres_schema_rec_add(struct unres_schema *unres)
+{
+    struct unres_schema_rec rec, *match;
+    uint32_t hash;
+
+    if (!unres->ht) {
+        unres->ht = lyht_new(64, sizeof rec, unres_schema_rec_equal, NULL, 1);
+        LY_CHECK_ERR_RETURN(!unres->ht, LOGMEM(NULL), -1);
+    }
+
+    hash = unres_schema_rec_key(&rec, unres->item[unres->count - 1], unres->type[unres->count - 1]);
+    rec.idx = unres->count - 1;
+    rec.multi = 0;
+    if (!lyht_find(unres->ht, &rec, hash, (void **)&match)) {
+        match->idx = rec.idx;
+        match->multi = 1;
+    } else if (lyht_insert(unres->ht, &rec, hash, NULL)) {
+        return -1;
+    }
+
+    return 0;
+}
+
+/* items waiting for a typedef of the name, see resolve_unres_schema_types() */
+struct unres_schema_wait {
+    const char *name;
+    uint32_t len;
+    uint32_t first;         /* the last waiting item, the others are linked in unres_schema_work next */
+};
+
+/* state of an item in unres_schema_work */
+#define UNRES_WORK_NONE  0  /* resolved or not tried yet in this round */
+#define UNRES_WORK_RETRY 1  /* try again in the next round */
+#define UNRES_WORK_WAIT  2  /* waiting for a typedef to be resolved in this round */
+
+/* worklist of resolve_unres_schema_types() */
+struct unres_schema_work {
+    uint32_t *pending;      /* items to try in this round, in the order of unres */
+    uint32_t pending_count;
+    uint32_t *ready;        /* items whose typedef was resolved in this round */
+    uint32_t ready_count;
+    uint32_t *next;         /* next item waiting for the same typedef */
+    uint8_t *state;         /* UNRES_WORK_* of each item */
+    uint32_t size;          /* size of all the arrays */
+    struct hash_table *waits; /* unres_schema_wait records */
+};
+
+static int
+unres_schema_wait_equal(void *val1_p, void *val2_p, int UNUSED(mod), void *UNUSED(cb_data))
+{
+    struct unres_schema_wait *wait1 = (struct unres_schema_wait *)val1_p, *wait2 = (struct unres_schema_wait *)val2_p;
+
+    return (wait1->len == wait2->len) && !strncmp(wait1->name, wait2->name, wait1->len);
+}
+
+/* fill the key of a wait record from a (prefixed) typedef name, returns its hash */
+static uint32_t
+unres_schema_wait_key(struct unres_schema_wait *wait, const char *name)
+{
+    const char *ptr;
+    uint32_t hash;
+
+    /* the prefix is ignored, waking up an item needlessly only costs another try */
+    if ((ptr = strchr(name, ':'))) {
+        name = ptr + 1;
+    }
+    wait->name = name;
+    wait->len = strlen(name);
+
+    hash = dict_hash_multi(0, name, wait->len);
+    return dict_hash_multi(hash, NULL, 0);
+}
+
+static int
+unres_schema_work_resize(struct unres_schema_work *work, uint32_t size, struct ly_ctx *ctx)
+{
+    void *mem;
+
+    if (size <= work->size) {
+        return 0;
+    }
+
+    mem = realloc(work->pending, size * sizeof *work->pending);
+    LY_CHECK_ERR_RETURN(!mem, LOGMEM(ctx), -1);
+    work->pending = mem;
+    mem = realloc(work->ready, size * sizeof *work->ready);
+    LY_CHECK_ERR_RETURN(!mem, LOGMEM(ctx), -1);
+    work->ready = mem;
+    mem = realloc(work->next, size * sizeof *work->next);
+    LY_CHECK_ERR_RETURN(!mem, LOGMEM(ctx), -1);
+    work->next = mem;
+    mem = realloc(work->state, size * sizeof *work->state);
+    LY_CHECK_ERR_RETURN(!mem, LOGMEM(ctx), -1);
+    work->state = mem;
+
+    memset(&work->state[work->size], UNRES_WORK_NONE, (size - work->size) * sizeof *work->state);
+    work->size = size;
+    return 0;
+}
+
+static void
+unres_schema_work_free(struct unres_schema_work *work)
+{
+    free(work->pending);
+    free(work->ready);
+    free(work->next);
+    free(work->state);
+    lyht_free(work->waits);
+}
+
+/* remember an unresolved (forward-referencing) derived type to be tried again once its typedef is resolved */
+static int
+unres_schema_work_wait(struct unres_schema_work *work, struct unres_schema *unres, uint32_t i)
+{
+    struct lyxml_elem *yin;
+    struct unres_schema_wait wait, *match;
+    const char *name;
+    uint32_t hash;
+
+    /* HACK type->der is temporarily unparsed type statement */
+    yin = (struct lyxml_elem *)((struct lys_type *)unres->item[i])->der;
+    if (!yin) {
+        name = NULL;
+    } else if (yin->flags & LY_YANG_STRUCTURE_FLAG) {
+        name = ((struct yang_type *)yin)->name;
+    } else {
+        name = lyxml_get_attr(yin, "name", NULL);
+    }
+    if (!name) {
+        work->state[i] = UNRES_WORK_RETRY;
+        return 0;
+    }
+
+    if (!work->waits) {
+        work->waits = lyht_new(64, sizeof wait, unres_schema_wait_equal, NULL, 1);
+        LY_CHECK_ERR_RETURN(!work->waits, LOGMEM(NULL), -1);
+    }
+
+    hash = unres_schema_wait_key(&wait, name);
+    if (!lyht_find(work->waits, &wait, hash, (void **)&match)) {
+        work->next[i] = match->first;
+        match->first = i;
+    } else {
+        work->next[i] = i;
+        wait.first = i;
+        if (lyht_insert(work->waits, &wait, hash, NULL)) {
+            return -1;
+        }
+    }
+    work->state[i] = UNRES_WORK_WAIT;
+    return 0;
+}
+
+/* a typedef was resolved, make the items waiting for it ready */
+static void
+unres_schema_work_wake(struct unres_schema_work *work, const char *name)
+{
+    struct unres_schema_wait wait, *match;
+    uint32_t hash, i, prev;
+
+    if (!work->waits) {
+        return;
+    }
+
+    hash = unres_schema_wait_key(&wait, name);
+    if (lyht_find(work->waits, &wait, hash, (void **)&match)) {
+        return;
+    }
+
+    /* the chain ends with an item linked to itself, keep the order of unres */
+    i = match->first;
+    do {
+        prev = i;
+        work->state[i] = UNRES_WORK_NONE;
+        work->ready[work->ready_count++] = i;
+        i = work->next[i];
+    } while (i != prev);
+    lyht_remove(work->waits, &wait, hash);
+}
+
+/* collect the items to try in the next round */
+static void
+unres_schema_work_round(struct unres_schema_work *work)
+{
+    uint32_t i;
+
+    work->pending_count = 0;
+    for (i = 0; i < work->size; ++i) {
+        if (work->state[i] != UNRES_WORK_NONE) {
+            work->pending[work->pending_count++] = i;
+            work->state[i] = UNRES_WORK_NONE;
+        }
+    }
+
+    /* items still waiting are tried again in the next round anyway */
+    lyht_free(work->waits);
+    work->waits = NULL;
+}
+
 static int
 resolve_unres_schema_types(struct unres_schema *unres, enum UNRES_ITEM types, struct ly_ctx *ctx, int forward_ref,
                            int print_all_errors, uint32_t *resolved)
 {
-    uint32_t i, unres_count, res_count;
+    uint32_t i, k, unres_count, res_count, scanned = 0;
     int ret = 0, rc;
     struct ly_err_item *prev_eitem;
     enum int_log_opts prev_ilo;
     LY_ERR prev_ly_errno;
+    struct unres_schema_work work;
+    const char *tpdf_name;
+
+    memset(&work, 0, sizeof work);
 
     /* if there can be no forward references, every failure is final, so we can print it directly */
     if (forward_ref) {
@@ -7256,7 +7807,21 @@ resolve_unres_schema_types(struct unres_schema *unres, enum UNRES_ITEM types, st
         unres_count = 0;
         res_count = 0;
 
-        for (i = 0; i < unres->count; ++i) {
+        /* only the items that failed in the previous round are tried again (in the order of unres),
+         * followed by the items added since then, the items waiting for a typedef are tried right
+         * after it is resolved */
+        for (k = 0; work.ready_count || (k < work.pending_count) || (scanned < unres->count); ) {
+            if (unres_schema_work_resize(&work, unres->count, ctx)) {
+                goto error;
+            }
+            if (work.ready_count) {
+                i = work.ready[--work.ready_count];
+            } else if (k < work.pending_count) {
+                i = work.pending[k++];
+            } else {
+                i = scanned++;
+            }
+
             /* UNRES_TYPE_LEAFREF must be resolved (for storing leafref target pointers);
              * if-features are resolved here to make sure that we will have all if-features for
              * later check of feature circular dependency */
@@ -7272,6 +7837,10 @@ resolve_unres_schema_types(struct unres_schema *unres, enum UNRES_ITEM types, st
                     if (unres->type[i] == UNRES_LIST_UNIQ) {
                         /* free the allocated structure */
                         free(unres->item[i]);
+                    } else if ((unres->type[i] == UNRES_TYPE_DER_TPDF) && !rc) {
+                        /* the typedef can be used now */
+                        tpdf_name = ((struct lys_type *)unres->item[i])->parent->name;
+                        unres_schema_work_wake(&work, tpdf_name);
                     }
 
                     unres->type[i] = UNRES_RESOLVED;
@@ -7280,19 +7849,26 @@ resolve_unres_schema_types(struct unres_schema *unres, enum UNRES_ITEM types, st
                 } else if ((rc == EXIT_FAILURE) && forward_ref) {
                     /* forward reference, erase errors */
                     ly_err_free_next(ctx, prev_eitem);
+                    if (unres->type[i] & (UNRES_TYPE_DER | UNRES_TYPE_DER_TPDF | UNRES_TYPE_DER_EXT)) {
+                        if (unres_schema_work_wait(&work, unres, i)) {
+                            goto error;
+                        }
+                    } else {
+                        work.state[i] = UNRES_WORK_RETRY;
+                    }
                 } else if (print_all_errors) {
                     /* just so that we quit the loop */
                     ++res_count;
                     ret = -1;
+                    work.state[i] = UNRES_WORK_RETRY;
                 } else {
-                    if (forward_ref) {
-                        ly_ilo_restore(ctx, prev_ilo, prev_eitem, 1);
-                    }
-                    return -1;
+                    goto error;
                 }
             }
         }
+        unres_schema_work_round(&work);
     } while (res_count && (res_count < unres_count));
+    unres_schema_work_free(&work);
 
     if (res_count < unres_count) {
         assert(forward_ref);
@@ -7314,6 +7890,13 @@ resolve_unres_schema_types(struct unres_schema *unres, enum UNRES_ITEM types, st
     }
 
     return ret;
+
+error:
+    if (forward_ref) {
+        ly_ilo_restore(ctx, prev_ilo, prev_eitem, 1);
+    }
+    unres_schema_work_free(&work);
+    return -1;
 }
 
 /**
@@ -7324,8 +7907,8 @@ resolve_unres_schema_types(struct unres_schema *unres, enum UNRES_ITEM types, st
  *
  * @return EXIT_SUCCESS on success, -1 on error.
  */
-int
-resolve_unres_schema(struct lys_module *mod, struct unres_schema *unres)
+static int
+resolve_unres_schema_(struct lys_module *mod, struct unres_schema *unres)
 {
     uint32_t resolved = 0;
 
@@ -7355,9 +7938,24 @@ resolve_unres_schema(struct lys_module *mod, struct unres_schema *unres)
 
     LOGVRB("All \"%s\" schema nodes and constraints resolved.", mod->name);
     unres->count = 0;
+    lyht_free(unres->ht);
+    unres->ht = NULL;
     return EXIT_SUCCESS;
 }
 
+int
+resolve_unres_schema(struct lys_module *mod, struct unres_schema *unres)
+{
+    struct ly_stats_phase_prev phase;
+    int rc;
+
+    ly_stats_phase_enter(mod->ctx, LY_STATS_PHASE_UNRES, &phase);
+    rc = resolve_unres_schema_(mod, unres);
+    ly_stats_phase_leave(&phase);
+
+    return rc;
+}
+
 /**
  * @brief Try to resolve an unres schema item with a string argument. Logs indirectly.
  *
@@ -7407,18 +8005,27 @@ unres_schema_add_node(struct lys_module *mod, struct unres_schema *unres, void *
     LY_ERR prev_ly_errno;
     struct lyxml_elem *yin;
     struct ly_ctx *ctx = mod->ctx;
+    struct unres_schema_rec *rec;
 
     assert(unres && (item || (type == UNRES_MOD_IMPLEMENT)) && ((type != UNRES_LEAFREF) && (type != UNRES_INSTID)
            && (type != UNRES_WHEN) && (type != UNRES_MUST)));
 
     /* check for duplicities in unres */
-    for (u = 0; u < unres->count; u++) {
-        if (unres->type[u] == type && unres->item[u] == item &&
-                unres->str_snode[u] == snode && unres->module[u] == mod) {
-            /* duplication can happen when the node contains multiple statements of the same type to check,
-             * this can happen for example when refinement is being applied, so we just postpone the processing
-             * and do not duplicate the information */
-            return EXIT_FAILURE;
+    rec = (type == UNRES_LIST_UNIQ) ? NULL : unres_schema_rec_find(unres, item, type);
+    if (rec) {
+        /* start with the last item of this type and item, the previous ones only if there are more */
+        u = rec->idx + 1;
+        while (u--) {
+            if (unres->type[u] == type && unres->item[u] == item &&
+                    unres->str_snode[u] == snode && unres->module[u] == mod) {
+                /* duplication can happen when the node contains multiple statements of the same type to check,
+                 * this can happen for example when refinement is being applied, so we just postpone the processing
+                 * and do not duplicate the information */
+                return EXIT_FAILURE;
+            }
+            if (!rec->multi) {
+                break;
+            }
         }
     }
 
@@ -7478,6 +8085,9 @@ unres_schema_add_node(struct lys_module *mod, struct unres_schema *unres, void *
     unres->module = ly_realloc(unres->module, unres->count*sizeof *unres->module);
     LY_CHECK_ERR_RETURN(!unres->module, LOGMEM(ctx), -1);
     unres->module[unres->count-1] = mod;
+    if (unres_schema_rec_add(unres)) {
+        return -1;
+    }
 
     return rc;
 }
@@ -7549,6 +8159,7 @@ unres_schema_find(struct unres_schema *unres, int start_on_backwards, void *item
 {
     int i;
     struct unres_list_uniq *aux_uniq1, *aux_uniq2;
+    struct unres_schema_rec *rec;
 
     if (!unres->count) {
         return -1;
@@ -7557,7 +8168,14 @@ unres_schema_find(struct unres_schema *unres, int start_on_backwards, void *item
     if (start_on_backwards >= 0) {
         i = start_on_backwards;
     } else {
-        i = unres->count - 1;
+        rec = unres_schema_rec_find(unres, item, type);
+        if (!rec) {
+            return -1;
+        } else if (!rec->multi) {
+            /* the only item with this key, it may have been resolved already */
+            return (unres->type[rec->idx] == type) ? (int)rec->idx : -1;
+        }
+        i = rec->idx;
     }
     for (; i > -1; i--) {
         if (unres->type[i] != type) {
@@ -7657,6 +8275,7 @@ unres_schema_free(struct lys_module *module, struct unres_schema **unres, int al
         free((*unres)->type);
         free((*unres)->str_snode);
         free((*unres)->module);
+        lyht_free((*unres)->ht);
         free((*unres));
         (*unres) = NULL;
     }
@@ -7722,10 +8341,187 @@ check_instid_ext_dep(const struct lys_node *sleaf, const char *json_instid)
 }
 
 /**
- * @brief Resolve instance-identifier in JSON data format. Logs directly.
+ * @brief Get the canonical value of a predicate value. Does not log.
  *
- * @param[in] data Data node where the path is used
- * @param[in] path Instance-identifier node value.
+ * @param[in] node Schema leaf or leaf-list of the value.
+ * @param[in] noncan_val Non-canonical value.
+ * @param[in] noncan_val_len Length of \p noncan_val.
+ * @return Canonical value in the dictionary, NULL if the value is invalid.
+ */
+static const char *
+valcanon(struct lys_node *node, const char *noncan_val, int noncan_val_len)
+{
+    struct lyd_node_leaf_list leaf;
+    struct lys_node_leaf *sleaf = (struct lys_node_leaf *)node;
+    enum int_log_opts prev_ilo;
+    struct lys_type *type;
+
+    /* dummy leaf */
+    memset(&leaf, 0, sizeof leaf);
+    leaf.value_str = lydict_insert(node->module->ctx, noncan_val, noncan_val_len);
+
+    while (sleaf->type.base == LY_TYPE_LEAFREF) {
+        if (!sleaf->type.info.lref.target) {
+            lydict_remove(node->module->ctx, leaf.value_str);
+            return NULL;
+        }
+        sleaf = sleaf->type.info.lref.target;
+    }
+    leaf.value_type = sleaf->type.base;
+    leaf.schema = node;
+
+    ly_ilo_change(NULL, ILO_IGNORE, &prev_ilo, NULL);
+    type = lyp_parse_value(&sleaf->type, &leaf.value_str, NULL, &leaf, NULL, NULL, 0, 0, 0);
+    ly_ilo_restore(NULL, prev_ilo, NULL, 0);
+    if (!type) {
+        lydict_remove(node->module->ctx, leaf.value_str);
+        return NULL;
+    }
+
+    return leaf.value_str;
+}
+
+/**
+ * @brief Resolve the instances selected by all the keys, the value, or the position in instance-identifier
+ * predicates directly, through the children hash tables, instead of checking every instance. Does not log.
+ *
+ * @param[in] mod Module of the node.
+ * @param[in] name Name of the node.
+ * @param[in] nam_len Length of \p name.
+ * @param[in] pred Predicates of the node.
+ * @param[in] root First top-level sibling.
+ * @param[in,out] parents Parents of the node, replaced by the matching instances.
+ * @return Number of characters of the predicates, 0 if they must be resolved by resolve_instid_predicate().
+ */
+static int
+resolve_instid_direct(const struct lys_module *mod, const char *name, int nam_len, const char *pred,
+                      struct lyd_node *root, struct unres_data *parents)
+{
+    const struct lys_node *snode = NULL, *sparent;
+    struct lys_node_list *slist = NULL;
+    struct lyd_node *first, *iter;
+    struct ly_ctx *ctx = mod->ctx;
+    const char *model, *pname, *value, **values = NULL;
+    int mod_len, pnam_len, val_len, has_predicate, parsed = 0, pos = 0, i, count;
+    uint32_t u;
+
+    /* all the parents are instances of the same schema node */
+    if (parents->count) {
+        sparent = parents->node[0]->schema;
+        for (u = 1; u < parents->count; ++u) {
+            if (parents->node[u]->schema != sparent) {
+                return 0;
+            }
+        }
+        if (sparent->nodetype & (LYS_LEAF | LYS_LEAFLIST | LYS_ANYDATA)) {
+            return 0;
+        }
+    } else {
+        sparent = NULL;
+    }
+    while ((snode = lys_getnext(snode, sparent, sparent ? NULL : mod, 0))) {
+        if ((snode->nodetype & (LYS_LIST | LYS_LEAFLIST)) && (lys_node_module(snode) == mod)
+                && !strncmp(snode->name, name, nam_len) && !snode->name[nam_len]) {
+            break;
+        }
+    }
+    if (!snode) {
+        return 0;
+    }
+    if (snode->nodetype == LYS_LIST) {
+        slist = (struct lys_node_list *)snode;
+    }
+
+    values = calloc(slist && slist->keys_size ? slist->keys_size : 1, sizeof *values);
+    LY_CHECK_ERR_RETURN(!values, LOGMEM(ctx), 0);
+
+    count = 0;
+    do {
+        if ((i = parse_predicate(pred + parsed, &model, &mod_len, &pname, &pnam_len, &value, &val_len, &has_predicate)) < 1) {
+            goto fallback;
+        }
+        parsed += i;
+
+        if (pname[0] == '.') {
+            if (slist || has_predicate || !(values[0] = valcanon((struct lys_node *)snode, value, val_len))) {
+                goto fallback;
+            }
+        } else if (isdigit(pname[0])) {
+            if (!slist || slist->keys_size || has_predicate || ((pos = atoi(pname)) < 1)) {
+                goto fallback;
+            }
+        } else {
+            if (!slist) {
+                goto fallback;
+            }
+            for (i = 0; i < slist->keys_size; ++i) {
+                if (!strncmp(slist->keys[i]->name, pname, pnam_len) && !slist->keys[i]->name[pnam_len]) {
+                    break;
+                }
+            }
+            if ((i == slist->keys_size) || values[i]
+                    || (model ? strncmp(slist->keys[i]->module->name, model, mod_len) || slist->keys[i]->module->name[mod_len]
+                        : (slist->keys[i]->module != mod))) {
+                /* the errors are reported by resolve_instid_predicate() */
+                goto fallback;
+            }
+            if (!(values[i] = valcanon((struct lys_node *)slist->keys[i], value, val_len))) {
+                goto fallback;
+            }
+        }
+        ++count;
+    } while (has_predicate);
+
+    if (slist && slist->keys_size && (count != slist->keys_size)) {
+        goto fallback;
+    }
+
+    if (!parents->count) {
+        parents->node = malloc(sizeof *parents->node);
+        LY_CHECK_ERR_GOTO(!parents->node, LOGMEM(ctx), fallback);
+        parents->node[0] = NULL;
+        parents->count = 1;
+    }
+    for (u = 0; u < parents->count; ) {
+        first = parents->node[u] ? parents->node[u]->child : root;
+        if (pos) {
+            /* the position-th instance */
+            i = 0;
+            LY_TREE_FOR(first, iter) {
+                if ((iter->schema == snode) && (++i == pos)) {
+                    break;
+                }
+            }
+        } else {
+            iter = lyd_find_values(parents->node[u], first, snode, values);
+        }
+
+        if (iter) {
+            parents->node[u++] = iter;
+        } else {
+            unres_data_del(parents, u);
+        }
+    }
+
+    for (i = 0; i < (slist && slist->keys_size ? slist->keys_size : 1); ++i) {
+        lydict_remove(ctx, values[i]);
+    }
+    free(values);
+    return parsed;
+
+fallback:
+    for (i = 0; i < (slist && slist->keys_size ? slist->keys_size : 1); ++i) {
+        lydict_remove(ctx, values[i]);
+    }
+    free(values);
+    return 0;
+}
+
+/**
+ * @brief Resolve instance-identifier in JSON data format. Logs directly.
+ *
+ * @param[in] data Data node where the path is used
+ * @param[in] path Instance-identifier node value.
  * @param[in,out] ret Resolved instance or NULL.
  *
  * @return 0 on success (even if unresolved and \p ret is NULL), -1 on error.
@@ -7789,12 +8585,16 @@ resolve_instid(struct lyd_node *data, const char *path, int req_inst, struct lyd
             mod = prev_mod;
         }
 
-        if (resolve_data(mod, name, name_len, root, &node_match)) {
+        if (has_predicate && (parsed = resolve_instid_direct(mod, name, name_len, &path[i], root, &node_match))) {
+            i += parsed;
+            if (!node_match.count) {
+                /* no instance exists */
+                break;
+            }
+        } else if (resolve_data(mod, name, name_len, root, &node_match)) {
             /* no instance exists */
             break;
-        }
-
-        if (has_predicate) {
+        } else if (has_predicate) {
             /* we have predicate, so the current results must be list or leaf-list */
             parsed = j = 0;
             /* index of the current node (for lists with position predicates) */
@@ -7857,14 +8657,151 @@ error:
     return -1;
 }
 
+struct lref_index_rec {
+    const char *path;           /* leafref path */
+    const struct lyd_node *root; /* first top-level node of the data tree */
+    const char *value;          /* target value, NULL for the record marking indexed path */
+    struct lyd_node *target;    /* first target with the value */
+};
+
+static int
+lref_index_val_equal(void *val1_p, void *val2_p, int UNUSED(mod), void *UNUSED(cb_data))
+{
+    struct lref_index_rec *rec1 = (struct lref_index_rec *)val1_p, *rec2 = (struct lref_index_rec *)val2_p;
+
+    return (rec1->path == rec2->path) && (rec1->root == rec2->root) && ly_strequal(rec1->value, rec2->value, 0);
+}
+
+static uint32_t
+lref_index_hash(const struct lref_index_rec *rec)
+{
+    uint32_t hash;
+
+    hash = dict_hash_multi(0, (const char *)&rec->path, sizeof rec->path);
+    hash = dict_hash_multi(hash, (const char *)&rec->root, sizeof rec->root);
+    if (rec->value) {
+        /* the values are hashed by their content, the private ones are not in the dictionary */
+        hash = dict_hash_multi(hash, rec->value, strlen(rec->value));
+    }
+    return dict_hash_multi(hash, NULL, 0);
+}
+
+/**
+ * @brief Learn whether a leafref path selects the same target nodes regardless of the context node, so that
+ * the targets can be indexed by their values.
+ *
+ * @param[in] path Leafref path.
+ * @return non-zero if the path is absolute and without predicates, 0 otherwise.
+ */
+static int
+lref_index_path_usable(const char *path)
+{
+    return (path[0] == '/') && !strchr(path, '[');
+}
+
+/**
+ * @brief Find a leafref target in the index, build the index for the leafref path first, if needed.
+ *
+ * @param[in] lref_index Leafref target index.
+ * @param[in] leaf Leafref node.
+ * @param[in] path Leafref path.
+ * @param[out] ret Found target, NULL if there is none.
+ * @return EXIT_SUCCESS or -1 on error.
+ */
 static int
-resolve_leafref(struct lyd_node_leaf_list *leaf, const char *path, int req_inst, struct lyd_node **ret)
+lref_index_find(struct hash_table *lref_index, struct lyd_node_leaf_list *leaf, const char *path, struct lyd_node **ret)
 {
+    struct lref_index_rec rec, *found;
     struct lyxp_set xp_set;
+    const struct lyd_node *root;
     uint32_t i;
+    int r = 0;
+
+    /* find data root, the path is evaluated from it */
+    for (root = (struct lyd_node *)leaf; root->parent; root = root->parent);
+    while (root->prev->next) {
+        root = root->prev;
+    }
+
+    rec.path = path;
+    rec.root = root;
+    rec.value = NULL;
+    rec.target = NULL;
+    if (lyht_find(lref_index, &rec, lref_index_hash(&rec), NULL)) {
+        /* evaluate the path only once and remember all the targets */
+        memset(&xp_set, 0, sizeof xp_set);
+        if (lyxp_eval(path, (struct lyd_node *)leaf, LYXP_NODE_ELEM, lyd_node_module((struct lyd_node *)leaf), &xp_set, 0) != EXIT_SUCCESS) {
+            return -1;
+        }
+
+        if (xp_set.type == LYXP_SET_NODE_SET) {
+            for (i = 0; i < xp_set.used; ++i) {
+                if ((xp_set.val.nodes[i].type != LYXP_NODE_ELEM) || !(xp_set.val.nodes[i].node->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST))) {
+                    continue;
+                }
+
+                rec.value = ((struct lyd_node_leaf_list *)xp_set.val.nodes[i].node)->value_str;
+                rec.target = xp_set.val.nodes[i].node;
+                /* the first target with a value is kept (returns 1) */
+                r = lyht_insert(lref_index, &rec, lref_index_hash(&rec), NULL);
+                if (r == -1) {
+                    break;
+                }
+            }
+        }
+        lyxp_set_cast(&xp_set, LYXP_SET_EMPTY, (struct lyd_node *)leaf, NULL, 0);
+
+        /* mark the path as indexed */
+        rec.value = NULL;
+        rec.target = NULL;
+        if ((r == -1) || (lyht_insert(lref_index, &rec, lref_index_hash(&rec), NULL) == -1)) {
+            LOGMEM(leaf->schema->module->ctx);
+            return -1;
+        }
+    }
+
+    /* values are in canonical form, so they are compared as strings */
+    rec.value = leaf->value_str;
+    if (!lyht_find(lref_index, &rec, lref_index_hash(&rec), (void **)&found)) {
+        *ret = found->target;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+static struct hash_table *
+lref_index_new(void)
+{
+    struct hash_table *lref_index;
+
+    lref_index = lyht_new(64, sizeof(struct lref_index_rec), lref_index_val_equal, NULL, 1);
+    LY_CHECK_ERR_RETURN(!lref_index, LOGMEM(NULL), NULL);
+
+    return lref_index;
+}
+
+static int
+resolve_leafref(struct lyd_node_leaf_list *leaf, const char *path, int req_inst, struct hash_table *lref_index,
+                struct lyd_node **ret)
+{
+    struct ly_ctx *ctx = leaf->schema->module->ctx;
+    struct lyxp_set xp_set;
+    struct timespec prof_start;
+    uint32_t i, nodes = 0;
 
     memset(&xp_set, 0, sizeof xp_set);
     *ret = NULL;
+    ly_val_prof_start(ctx, &prof_start);
+    LY_STATS_ADD(ctx, leafref_evals, 1);
+
+    if (lref_index && lref_index_path_usable(path)) {
+        /* the targets are the same for all the leafrefs with this path, look the value up */
+        if (lref_index_find(lref_index, leaf, path, ret)) {
+            return -1;
+        }
+        nodes = *ret ? 1 : 0;
+        goto finish;
+    }
 
     /* syntax was already checked, so just evaluate the path using standard XPath */
     if (lyxp_eval(path, (struct lyd_node *)leaf, LYXP_NODE_ELEM, lyd_node_module((struct lyd_node *)leaf), &xp_set, 0) != EXIT_SUCCESS) {
@@ -7872,14 +8809,15 @@ resolve_leafref(struct lyd_node_leaf_list *leaf, const char *path, int req_inst,
     }
 
     if (xp_set.type == LYXP_SET_NODE_SET) {
+        nodes = xp_set.used;
         for (i = 0; i < xp_set.used; ++i) {
             if ((xp_set.val.nodes[i].type != LYXP_NODE_ELEM) || !(xp_set.val.nodes[i].node->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST))) {
                 continue;
             }
 
             /* not that the value is already in canonical form since the parsers does the conversion,
-             * so we can simply compare just the values */
-            if (ly_strequal(leaf->value_str, ((struct lyd_node_leaf_list *)xp_set.val.nodes[i].node)->value_str, 1)) {
+             * so we can simply compare just the values (the target value may be private) */
+            if (ly_strequal(leaf->value_str, ((struct lyd_node_leaf_list *)xp_set.val.nodes[i].node)->value_str, 0)) {
                 /* we have the match */
                 *ret = xp_set.val.nodes[i].node;
                 break;
@@ -7889,10 +8827,12 @@ resolve_leafref(struct lyd_node_leaf_list *leaf, const char *path, int req_inst,
 
     lyxp_set_cast(&xp_set, LYXP_SET_EMPTY, (struct lyd_node *)leaf, NULL, 0);
 
+finish:
+    ly_val_prof_add(ctx, &prof_start, LY_VAL_PROF_LEAFREF, leaf->schema, path, nodes);
     if (!*ret) {
         /* reference not found */
         if (req_inst > -1) {
-            LOGVAL(leaf->schema->module->ctx, LYE_NOLEAFREF, LY_VLOG_LYD, leaf, path, leaf->value_str);
+            LOGVAL(ctx, LYE_NOLEAFREF, LY_VLOG_LYD, leaf, path, leaf->value_str);
             return EXIT_FAILURE;
         } else {
             LOGVRB("There is no leafref \"%s\" with the value \"%s\", but it is not required.", path, leaf->value_str);
@@ -7911,7 +8851,7 @@ resolve_union(struct lyd_node_leaf_list *leaf, struct lys_type *type, int store,
     struct lys_type *t;
     struct lyd_node *ret;
     enum int_log_opts prev_ilo;
-    int found, success = 0, ext_dep, req_inst;
+    int found, success = 0, ext_dep, req_inst, vclass;
     const char *json_val = NULL;
 
     assert(type->base == LY_TYPE_UNION);
@@ -7932,6 +8872,7 @@ resolve_union(struct lyd_node_leaf_list *leaf, struct lys_type *type, int store,
 
     t = NULL;
     found = 0;
+    vclass = lyp_union_value_class(leaf->value_str);
     while ((t = lyp_get_next_union_type(type, t, &found))) {
         found = 0;
 
@@ -7943,7 +8884,7 @@ resolve_union(struct lyd_node_leaf_list *leaf, struct lys_type *type, int store,
                 req_inst = t->info.lref.req;
             }
 
-            if (!resolve_leafref(leaf, t->info.lref.path, req_inst, &ret)) {
+            if (!resolve_leafref(leaf, t->info.lref.path, req_inst, NULL, &ret)) {
                 if (store) {
                     if (ret && !(leaf->schema->flags & LYS_LEAFREF_DEP)) {
                         /* valid resolved */
@@ -7952,7 +8893,7 @@ resolve_union(struct lyd_node_leaf_list *leaf, struct lys_type *type, int store,
                     } else {
                         /* valid unresolved */
                         ly_ilo_restore(NULL, prev_ilo, NULL, 0);
-                        if (!lyp_parse_value(t, &leaf->value_str, NULL, leaf, NULL, NULL, 1, 0, 0)) {
+                        if (!lyp_parse_value(t, &leaf->value_str, NULL, leaf, NULL, NULL, 2, 0, 0)) {
                             return -1;
                         }
                         ly_ilo_change(NULL, ILO_IGNORE, &prev_ilo, NULL);
@@ -8000,7 +8941,11 @@ resolve_union(struct lyd_node_leaf_list *leaf, struct lys_type *type, int store,
             }
             break;
         default:
-            if (lyp_parse_value(t, &leaf->value_str, NULL, leaf, NULL, NULL, store, 0, 0)) {
+            if (lyp_union_type_skip(t, leaf->value_str, vclass)) {
+                /* the value cannot be of this type */
+                continue;
+            }
+            if (lyp_parse_value(t, &leaf->value_str, NULL, leaf, NULL, NULL, store ? 2 : 0, 0, 0)) {
                 success = 1;
             }
             break;
@@ -8051,11 +8996,14 @@ resolve_union(struct lyd_node_leaf_list *leaf, struct lys_type *type, int store,
  * @param[in] node Data node to resolve.
  * @param[in] type Type of the unresolved item.
  * @param[in] ignore_fail 0 - no, 1 - yes, 2 - yes, but only for external dependencies.
+ * @param[out] failed_when Evaluated when condition, optional.
+ * @param[in] lref_index Leafref target index valid while the data tree does not change, optional.
  *
  * @return EXIT_SUCCESS on success, EXIT_FAILURE on forward reference, -1 on error.
  */
 int
-resolve_unres_data_item(struct lyd_node *node, enum UNRES_ITEM type, int ignore_fail, struct lys_when **failed_when)
+resolve_unres_data_item(struct lyd_node *node, enum UNRES_ITEM type, int ignore_fail, struct lys_when **failed_when,
+                        struct hash_table *lref_index)
 {
     int rc, req_inst, ext_dep;
     struct lyd_node_leaf_list *leaf;
@@ -8065,6 +9013,10 @@ resolve_unres_data_item(struct lyd_node *node, enum UNRES_ITEM type, int ignore_
     leaf = (struct lyd_node_leaf_list *)node;
     sleaf = (struct lys_node_leaf *)leaf->schema;
 
+    if (ly_eval_step(sleaf->module->ctx)) {
+        return -1;
+    }
+
     switch (type) {
     case UNRES_LEAFREF:
         assert(sleaf->type.base == LY_TYPE_LEAFREF);
@@ -8074,16 +9026,17 @@ resolve_unres_data_item(struct lyd_node *node, enum UNRES_ITEM type, int ignore_
         } else {
             req_inst = sleaf->type.info.lref.req;
         }
-        rc = resolve_leafref(leaf, sleaf->type.info.lref.path, req_inst, &ret);
+        rc = resolve_leafref(leaf, sleaf->type.info.lref.path, req_inst, lref_index, &ret);
         if (!rc) {
             if (ret && !(leaf->schema->flags & LYS_LEAFREF_DEP)) {
                 /* valid resolved */
                 if (leaf->value_type == LY_TYPE_BITS) {
-                    free(leaf->value.bit);
+                    lyd_bits_free(leaf->value.bit);
                 }
                 leaf->value.leafref = ret;
                 leaf->value_type = LY_TYPE_LEAFREF;
                 leaf->value_flags &= ~LY_VALUE_UNRES;
+                lyd_gen_stamp(leaf);
             } else {
                 /* valid unresolved */
                 if (!(leaf->value_flags & LY_VALUE_UNRES)) {
@@ -8117,6 +9070,7 @@ resolve_unres_data_item(struct lyd_node *node, enum UNRES_ITEM type, int ignore_
                 leaf->value.instance = ret;
                 leaf->value_type = LY_TYPE_INST;
                 leaf->value_flags &= ~LY_VALUE_UNRES;
+                lyd_gen_stamp(leaf);
             } else {
                 /* valid unresolved */
                 leaf->value.instance = NULL;
@@ -8190,6 +9144,191 @@ unres_data_add(struct unres_data *unres, struct lyd_node *node, enum UNRES_ITEM
     return 0;
 }
 
+static int
+changed_snodes_val_equal(void *val1_p, void *val2_p, int UNUSED(mod), void *UNUSED(cb_data))
+{
+    return (*(struct lys_node **)val1_p == *(struct lys_node **)val2_p);
+}
+
+static uint32_t
+changed_snodes_hash(const struct lys_node *snode)
+{
+    uint32_t hash;
+
+    hash = dict_hash_multi(0, (const char *)&snode, sizeof snode);
+    return dict_hash_multi(hash, NULL, 0);
+}
+
+struct hash_table *
+changed_snodes_new(void)
+{
+    struct hash_table *changed;
+
+    changed = lyht_new(64, sizeof(struct lys_node *), changed_snodes_val_equal, NULL, 1);
+    LY_CHECK_ERR_RETURN(!changed, LOGMEM(NULL), NULL);
+
+    return changed;
+}
+
+int
+changed_snodes_add(struct hash_table *changed, const struct lys_node *snode)
+{
+    struct lys_node *child;
+    int r;
+
+    r = lyht_insert(changed, &snode, changed_snodes_hash(snode), NULL);
+    if (r == 1) {
+        /* already added with all the descendants */
+        return 0;
+    } else if (r) {
+        return -1;
+    }
+
+    if (snode->nodetype & (LYS_LEAF | LYS_LEAFLIST | LYS_ANYDATA)) {
+        /* no children (leaves use child member for backlinks) */
+        return 0;
+    }
+
+    LY_TREE_FOR(snode->child, child) {
+        if (child->nodetype == LYS_GROUPING) {
+            continue;
+        }
+        if (changed_snodes_add(changed, child)) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+#ifdef LY_ENABLED_CACHE
+
+static int
+changed_snodes_find(struct hash_table *changed, const struct lys_node *snode)
+{
+    return !lyht_find(changed, &snode, changed_snodes_hash(snode), NULL);
+}
+
+/**
+ * @brief Learn whether an expression may reference any changed schema node.
+ *
+ * @param[in] deps Schema nodes referenced by the expression, NULL if unknown.
+ * @param[in] changed Changed schema nodes.
+ * @return non-zero if the expression needs to be evaluated, 0 if its result cannot have changed.
+ */
+static int
+changed_snodes_deps(const struct ly_set *deps, struct hash_table *changed)
+{
+    unsigned int i;
+
+    if (!deps) {
+        return 1;
+    }
+
+    for (i = 0; i < deps->number; ++i) {
+        if (changed_snodes_find(changed, deps->set.s[i])) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static int
+changed_snodes_affect(const struct lyd_node *node, enum UNRES_ITEM type, struct hash_table *changed)
+{
+    const struct lys_node *sparent;
+    struct lys_restr *must;
+    struct lys_when *when;
+    uint8_t i, must_size;
+
+    if (changed_snodes_find(changed, node->schema)) {
+        /* the node itself or any of its ancestors changed */
+        return 1;
+    }
+
+    if (type == UNRES_MUST) {
+        switch (node->schema->nodetype) {
+        case LYS_CONTAINER:
+            must_size = ((struct lys_node_container *)node->schema)->must_size;
+            must = ((struct lys_node_container *)node->schema)->must;
+            break;
+        case LYS_LEAF:
+            must_size = ((struct lys_node_leaf *)node->schema)->must_size;
+            must = ((struct lys_node_leaf *)node->schema)->must;
+            break;
+        case LYS_LEAFLIST:
+            must_size = ((struct lys_node_leaflist *)node->schema)->must_size;
+            must = ((struct lys_node_leaflist *)node->schema)->must;
+            break;
+        case LYS_LIST:
+            must_size = ((struct lys_node_list *)node->schema)->must_size;
+            must = ((struct lys_node_list *)node->schema)->must;
+            break;
+        case LYS_ANYXML:
+        case LYS_ANYDATA:
+            must_size = ((struct lys_node_anydata *)node->schema)->must_size;
+            must = ((struct lys_node_anydata *)node->schema)->must;
+            break;
+        default:
+            return 1;
+        }
+
+        for (i = 0; i < must_size; ++i) {
+            if (changed_snodes_deps(must[i].deps, changed)) {
+                return 1;
+            }
+        }
+        return 0;
+    }
+
+    assert(type == UNRES_WHEN);
+
+    /* all the when conditions resolve_when() evaluates */
+    sparent = node->schema;
+    do {
+        when = snode_get_when(sparent);
+        if (when && changed_snodes_deps(when->deps, changed)) {
+            return 1;
+        }
+        if (sparent->parent && (sparent->parent->nodetype == LYS_AUGMENT)) {
+            when = snode_get_when(sparent->parent);
+            if (when && changed_snodes_deps(when->deps, changed)) {
+                return 1;
+            }
+        }
+        sparent = lys_parent(sparent);
+    } while (sparent && (sparent->nodetype & (LYS_USES | LYS_CHOICE | LYS_CASE)));
+
+    return 0;
+}
+
+#endif
+
+void
+unres_data_filter_changed(struct unres_data *unres, struct hash_table *changed)
+{
+#ifdef LY_ENABLED_CACHE
+    uint32_t i, j;
+
+    for (i = j = 0; i < unres->count; ++i) {
+        if (((unres->type[i] == UNRES_MUST) || (unres->type[i] == UNRES_WHEN))
+                && !changed_snodes_affect(unres->node[i], unres->type[i], changed)) {
+            /* the result cannot have changed since the last validation */
+            continue;
+        }
+
+        unres->node[j] = unres->node[i];
+        unres->type[j] = unres->type[i];
+        ++j;
+    }
+    unres->count = j;
+#else
+    (void)unres;
+    (void)changed;
+#endif
+}
+
 static void
 resolve_unres_data_autodel_diff(struct unres_data *unres, uint32_t unres_i)
 {
@@ -8261,10 +9400,18 @@ resolve_unres_data_autodel_diff(struct unres_data *unres, uint32_t unres_i)
  *
  * @return EXIT_SUCCESS on success, -1 on error.
  */
-int
-resolve_unres_data(struct ly_ctx *ctx, struct unres_data *unres, struct lyd_node **root, int options)
+/* whether the node is in a subtree unlinked because of a false when condition */
+static int
+resolve_unres_data_autodeleted(struct lyd_node *node)
 {
-    uint32_t i, j, first, resolved, del_items, stmt_count;
+    for (; node->parent; node = node->parent);
+    return (node->when_status & LYD_WHEN_FALSE) ? 1 : 0;
+}
+
+static int
+resolve_unres_data_(struct ly_ctx *ctx, struct unres_data *unres, struct lyd_node **root, int options)
+{
+    uint32_t i, j, k, count, del_items, *worklist = NULL;
     uint8_t prev_when_status;
     int rc, progress, ignore_fail;
     enum int_log_opts prev_ilo;
@@ -8272,6 +9419,8 @@ resolve_unres_data(struct ly_ctx *ctx, struct unres_data *unres, struct lyd_node
     LY_ERR prev_ly_errno = ly_errno;
     struct lyd_node *parent;
     struct lys_when *when;
+    struct hash_table *lref_index = NULL;
+    struct lyxp_memo *memo = NULL, *prev_memo = NULL;
 
     assert(root);
     assert(unres);
@@ -8294,47 +9443,59 @@ resolve_unres_data(struct ly_ctx *ctx, struct unres_data *unres, struct lyd_node
         ly_ilo_change(ctx, ILO_STORE, &prev_ilo, &prev_eitem);
     }
 
+    /* items of the currently resolved type, only the unresolved ones are kept for the next pass */
+    worklist = malloc(unres->count * sizeof *worklist);
+    LY_CHECK_ERR_GOTO(!worklist, LOGMEM(ctx), error);
+
+    /* the same paths of the when and must conditions are evaluated for many nodes */
+    memo = lyxp_memo_new();
+    if (!memo) {
+        goto error;
+    }
+    prev_memo = lyxp_memo_set(memo);
+
     /*
      * when-stmt first
      */
-    first = 1;
-    stmt_count = 0;
-    resolved = 0;
+    for (i = count = 0; i < unres->count; i++) {
+        if (unres->type[i] == UNRES_WHEN) {
+            worklist[count++] = i;
+        }
+    }
     del_items = 0;
     do {
         if (!ignore_fail) {
             ly_err_free_next(ctx, prev_eitem);
         }
         progress = 0;
-        for (i = 0; i < unres->count; i++) {
+        for (k = j = 0; k < count; k++) {
+            i = worklist[k];
             if (unres->type[i] != UNRES_WHEN) {
+                /* resolved meanwhile */
                 continue;
             }
-            if (first) {
-                /* count when-stmt nodes in unres list */
-                stmt_count++;
+
+            if (resolve_unres_data_autodeleted(unres->node[i])) {
+                /* the node is in an already unlinked subtree, do not resolve this node,
+                 * it will be removed anyway, so just mark it as resolved
+                 */
+                unres->node[i]->when_status |= LYD_WHEN_FALSE;
+                unres->type[i] = UNRES_RESOLVED;
+                continue;
             }
 
             /* resolve when condition only when all parent when conditions are already resolved */
             for (parent = unres->node[i]->parent;
                  parent && LYD_WHEN_DONE(parent->when_status);
-                 parent = parent->parent) {
-                if (!parent->parent && (parent->when_status & LYD_WHEN_FALSE)) {
-                    /* the parent node was already unlinked, do not resolve this node,
-                     * it will be removed anyway, so just mark it as resolved
-                     */
-                    unres->node[i]->when_status |= LYD_WHEN_FALSE;
-                    unres->type[i] = UNRES_RESOLVED;
-                    resolved++;
-                    break;
-                }
-            }
+                 parent = parent->parent);
             if (parent) {
+                /* try again in the next pass */
+                worklist[j++] = i;
                 continue;
             }
 
             prev_when_status = unres->node[i]->when_status;
-            rc = resolve_unres_data_item(unres->node[i], unres->type[i], ignore_fail, &when);
+            rc = resolve_unres_data_item(unres->node[i], unres->type[i], ignore_fail, &when, NULL);
             if (!rc) {
                 /* finish with error/delete the node only if when was changed from true to false, an external
                  * dependency was not required, or it was not provided (the flag would not be passed down otherwise,
@@ -8372,45 +9533,46 @@ resolve_unres_data(struct ly_ctx *ctx, struct unres_data *unres, struct lyd_node
                     }
 
                     lyd_unlink(unres->node[i]);
+                    lyxp_memo_flush(memo);
                     unres->type[i] = UNRES_DELETE;
                     del_items++;
 
-                    /* update the rest of unres items */
-                    for (j = 0; j < unres->count; j++) {
-                        if (unres->type[j] == UNRES_RESOLVED || unres->type[j] == UNRES_DELETE) {
-                            continue;
-                        }
-
-                        /* test if the node is in subtree to be deleted */
-                        for (parent = unres->node[j]; parent; parent = parent->parent) {
-                            if (parent == unres->node[i]) {
-                                /* yes, it is */
-                                unres->type[j] = UNRES_RESOLVED;
-                                resolved++;
-                                break;
-                            }
-                        }
-                    }
+                    /* mark the unlinked subtree, the rest of the unres items in it are recognized once processed */
+                    unres->node[i]->when_status |= LYD_WHEN_FALSE;
                 } else {
                     unres->type[i] = UNRES_RESOLVED;
                 }
                 if (!ignore_fail) {
                     ly_err_free_next(ctx, prev_eitem);
                 }
-                resolved++;
                 progress = 1;
             } else if (rc == -1) {
                 goto error;
-            } /* else forward reference */
+            } else {
+                /* forward reference */
+                worklist[j++] = i;
+            }
         }
-        first = 0;
-    } while (progress && resolved < stmt_count);
+        count = j;
+    } while (progress && count);
 
     /* do we have some unresolved when-stmt? */
-    if (stmt_count > resolved) {
+    if (count) {
         goto error;
     }
 
+    /* the subtrees are freed and the leafrefs resolved, deref() results change */
+    lyxp_memo_set(prev_memo);
+    lyxp_memo_flush(memo);
+
+    for (i = 0; del_items && (i < unres->count); i++) {
+        /* the unres items in the subtrees to be deleted are resolved */
+        if ((unres->type[i] != UNRES_RESOLVED) && (unres->type[i] != UNRES_DELETE)
+                && resolve_unres_data_autodeleted(unres->node[i])) {
+            unres->type[i] = UNRES_RESOLVED;
+        }
+    }
+
     for (i = 0; del_items && i < unres->count; i++) {
         /* we had some when-stmt resulted to false, so now we have to sanitize the unres list */
         if (unres->type[i] != UNRES_DELETE) {
@@ -8443,37 +9605,46 @@ resolve_unres_data(struct ly_ctx *ctx, struct unres_data *unres, struct lyd_node
         ly_ilo_restore(ctx, prev_ilo, prev_eitem, 0);
         ly_errno = prev_ly_errno;
     }
-    first = 1;
-    stmt_count = 0;
-    resolved = 0;
+    for (i = count = 0; i < unres->count; i++) {
+        if (unres->type[i] == UNRES_LEAFREF) {
+            worklist[count++] = i;
+        }
+    }
+    if (count) {
+        /* the tree does not change anymore, the leafref targets can be indexed */
+        lref_index = lref_index_new();
+        if (!lref_index) {
+            goto error;
+        }
+    }
     do {
         progress = 0;
-        for (i = 0; i < unres->count; i++) {
-            if (unres->type[i] != UNRES_LEAFREF) {
-                continue;
-            }
-            if (first) {
-                /* count leafref nodes in unres list */
-                stmt_count++;
-            }
-
-            rc = resolve_unres_data_item(unres->node[i], unres->type[i], ignore_fail, NULL);
+        for (k = j = 0; k < count; k++) {
+            i = worklist[k];
+            rc = resolve_unres_data_item(unres->node[i], unres->type[i], ignore_fail, NULL, lref_index);
             if (!rc) {
                 unres->type[i] = UNRES_RESOLVED;
                 if (!ignore_fail) {
                     ly_err_free_next(ctx, prev_eitem);
                 }
-                resolved++;
                 progress = 1;
             } else if (rc == -1) {
                 goto error;
-            } /* else forward reference */
+            } else {
+                /* forward reference */
+                worklist[j++] = i;
+            }
         }
-        first = 0;
-    } while (progress && resolved < stmt_count);
+        count = j;
+    } while (progress && count);
+
+    lyht_free(lref_index);
+    lref_index = NULL;
+    free(worklist);
+    worklist = NULL;
 
     /* do we have some unresolved leafrefs? */
-    if (stmt_count > resolved) {
+    if (count) {
         goto error;
     }
 
@@ -8486,26 +9657,37 @@ resolve_unres_data(struct ly_ctx *ctx, struct unres_data *unres, struct lyd_node
     /*
      * rest
      */
+    lyxp_memo_set(memo);
     for (i = 0; i < unres->count; ++i) {
         if (unres->type[i] == UNRES_RESOLVED) {
             continue;
         }
         assert(!(options & LYD_OPT_TRUSTED) || ((unres->type[i] != UNRES_MUST) && (unres->type[i] != UNRES_MUST_INOUT)));
 
-        rc = resolve_unres_data_item(unres->node[i], unres->type[i], ignore_fail, NULL);
+        rc = resolve_unres_data_item(unres->node[i], unres->type[i], ignore_fail, NULL, NULL);
         if (rc) {
             /* since when was already resolved, a forward reference is an error */
+            lyxp_memo_set(prev_memo);
+            lyxp_memo_free(memo);
             return -1;
         }
 
         unres->type[i] = UNRES_RESOLVED;
     }
+    lyxp_memo_set(prev_memo);
+    lyxp_memo_free(memo);
 
     LOGVRB("All data nodes and constraints resolved.");
     unres->count = 0;
     return EXIT_SUCCESS;
 
 error:
+    if (memo) {
+        lyxp_memo_set(prev_memo);
+        lyxp_memo_free(memo);
+    }
+    lyht_free(lref_index);
+    free(worklist);
     if (!ignore_fail) {
         /* print all the new errors */
         ly_ilo_restore(ctx, prev_ilo, prev_eitem, 1);
@@ -8513,3 +9695,24 @@ error:
     }
     return -1;
 }
+
+int
+resolve_unres_data(struct ly_ctx *ctx, struct unres_data *unres, struct lyd_node **root, int options)
+{
+    struct timespec start, end;
+    int rc;
+
+    LY_TRACE(unres_data_start, ctx, unres->count, options);
+    if (!ctx->stats_on || !unres->count) {
+        rc = resolve_unres_data_(ctx, unres, root, options);
+    } else {
+        /* account the time spent in the validation */
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        rc = resolve_unres_data_(ctx, unres, root, options);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        LY_STATS_ADD(ctx, val_time, (end.tv_sec - start.tv_sec) * 1000000000ULL + end.tv_nsec - start.tv_nsec);
+    }
+    LY_TRACE(unres_data_done, ctx, unres->count, rc);
+
+    return rc;
+}
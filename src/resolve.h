@@ -95,6 +95,7 @@ struct unres_data {
     uint32_t count;
 
     int store_diff;
+    int diff_ref;                   /* deleted nodes are stored with their parent node, not its path */
     struct lyd_difflist *diff;
     unsigned int diff_size;
     unsigned int diff_idx;
@@ -109,6 +110,7 @@ struct unres_schema {
     void **str_snode;       /* array of pointers, each is determined by the type (a string, a lys_node *, or NULL) */
     struct lys_module **module; /* array of pointers to the item's module */
     uint32_t count;         /* count of unres items */
+    struct hash_table *ht;  /* index of the items by their type and item, see unres_schema_find() */
 };
 
 struct len_ran_intv {
@@ -135,6 +137,26 @@ struct len_ran_intv {
     struct len_ran_intv *next;
 };
 
+/* all the values are compared as unsigned, signed values (including decimal64) have their sign bit flipped */
+#define LEN_RAN_SIGNED(snum) ((uint64_t)(snum) ^ __UINT64_C(0x8000000000000000))
+
+struct len_ran_bound {
+    uint64_t min;
+    uint64_t max;
+};
+
+struct len_ran_group {
+    struct lys_restr *restr;      /* the restriction, to be able to get to error-message and/or error-app-tag */
+    uint32_t count;               /* number of the intervals */
+    struct len_ran_bound *intv;   /* ascending intervals of the restriction */
+};
+
+/* intervals of all the length/range restrictions of a type, each restriction must be satisfied */
+struct len_ran_cmp {
+    uint32_t group_count;
+    struct len_ran_group group[]; /* followed by all the intervals */
+};
+
 /**
  * @brief Convert a string with a decimal64 value into our representation.
  * Syntax is expected to be correct. Does not log.
@@ -188,6 +210,10 @@ struct lyd_node *resolve_partial_json_data_nodeid(const char *nodeid, const char
 
 int resolve_len_ran_interval(struct ly_ctx *ctx, const char *str_restr, struct lys_type *type, struct len_ran_intv **ret);
 
+int resolve_len_ran_compiled(struct ly_ctx *ctx, struct lys_type *type, struct len_ran_cmp **ret);
+
+int resolve_len_ran_match(const struct len_ran_group *group, uint64_t value);
+
 int resolve_superior_type(const char *name, const char *prefix, const struct lys_module *module,
                           const struct lys_node *parent, struct lys_tpdf **ret);
 
@@ -236,12 +262,38 @@ void unres_schema_free(struct lys_module *module, struct unres_schema **unres, i
 int resolve_union(struct lyd_node_leaf_list *leaf, struct lys_type *type, int store, int ignore_fail,
                   struct lys_type **resolved_type);
 
-int resolve_unres_data_item(struct lyd_node *dnode, enum UNRES_ITEM type, int ignore_fail, struct lys_when **failed_when);
+int resolve_unres_data_item(struct lyd_node *dnode, enum UNRES_ITEM type, int ignore_fail, struct lys_when **failed_when,
+                            struct hash_table *lref_index);
 
 int unres_data_addonly(struct unres_data *unres, struct lyd_node *node, enum UNRES_ITEM type);
 int unres_data_add(struct unres_data *unres, struct lyd_node *node, enum UNRES_ITEM type);
 void unres_data_del(struct unres_data *unres, uint32_t i);
 
+/**
+ * @brief Create an empty set of changed schema nodes for #LYD_OPT_VAL_CHANGED validation.
+ *
+ * @return Empty set (hash table), NULL on error.
+ */
+struct hash_table *changed_snodes_new(void);
+
+/**
+ * @brief Add a schema node of a changed data node and all its schema descendants into the changed set.
+ *
+ * @param[in] changed Set of changed schema nodes.
+ * @param[in] snode Schema node to add.
+ * @return 0 on success, -1 on error.
+ */
+int changed_snodes_add(struct hash_table *changed, const struct lys_node *snode);
+
+/**
+ * @brief Remove when and must items of nodes that did not change and whose conditions do not
+ * reference any changed schema node.
+ *
+ * @param[in] unres Unresolved data items to filter.
+ * @param[in] changed Set of changed schema nodes.
+ */
+void unres_data_filter_changed(struct unres_data *unres, struct hash_table *changed);
+
 int resolve_unres_data(struct ly_ctx *ctx, struct unres_data *unres, struct lyd_node **root, int options);
 int schema_nodeid_siblingcheck(const struct lys_node *sibling, const struct lys_module *cur_module,
                            const char *mod_name, int mod_name_len, const char *name, int nam_len);
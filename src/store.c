@@ -0,0 +1,432 @@
+/**
+ * @file store.c
+ * @brief Data tree persisted as a LYB snapshot and an append-only log of LYB patches
+ *
+ * Copyright (c) 2015 - 2018 CESNET, z.s.p.o.
+ *
+ * This source code is licensed under BSD 3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://opensource.org/licenses/BSD-3-Clause
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "context.h"
+#include "hash_table.h"
+#include "libyang.h"
+#include "parser.h"
+#include "tree_data.h"
+
+/*
+ * The snapshot file is a LYB data tree followed by the generation (8B) of the snapshot. The log file starts with
+ * the generation (8B) of the snapshot it follows, a log of another generation is left from an unfinished compaction
+ * and is discarded. Then there are the records, each the length (4B) and the hash (4B) of a LYB patch and the patch.
+ * A record not written whole is cut off. All the numbers are little-endian.
+ */
+
+/* size of the log header and of the snapshot trailer */
+#define STORE_GEN_SIZE 8
+
+/* size of the record header */
+#define STORE_REC_SIZE 8
+
+struct lyd_store {
+    struct ly_ctx *ctx;
+    char *path;                 /* snapshot file */
+    char *log_path;             /* log file, the snapshot file with ".log" */
+    int log_fd;
+    int options;                /* parser options of the data */
+    uint64_t gen;               /* generation of the snapshot */
+    size_t snapshot_size;
+    size_t log_size;
+    size_t compact;             /* log size to compact at, 0 for the snapshot size */
+};
+
+static void
+store_put_num(uint8_t *buf, uint64_t num, int bytes)
+{
+    int i;
+
+    for (i = 0; i < bytes; ++i) {
+        buf[i] = (num >> (8 * i)) & 0xFF;
+    }
+}
+
+static uint64_t
+store_get_num(const char *buf, int bytes)
+{
+    uint64_t num = 0;
+    int i;
+
+    for (i = bytes - 1; i > -1; --i) {
+        num = (num << 8) | (uint8_t)buf[i];
+    }
+    return num;
+}
+
+static uint32_t
+store_hash(const char *data, size_t len)
+{
+    return dict_hash_multi_oaat(dict_hash_multi_oaat(0, data, len), NULL, 0);
+}
+
+static int
+store_write(struct ly_ctx *ctx, int fd, const char *buf, size_t count)
+{
+    ssize_t r;
+
+    while (count) {
+        r = write(fd, buf, count);
+        if (r < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            LOGERR(ctx, LY_ESYS, "Writing the data store failed (%s).", strerror(errno));
+            return -1;
+        }
+        buf += r;
+        count -= r;
+    }
+
+    return 0;
+}
+
+/* make a rename or a file creation in the directory of a file durable */
+static int
+store_sync_dir(struct ly_ctx *ctx, const char *path)
+{
+    char *dup;
+    int fd, ret = 0;
+
+    dup = strdup(path);
+    LY_CHECK_ERR_RETURN(!dup, LOGMEM(ctx), -1);
+    fd = open(dirname(dup), O_RDONLY);
+    if ((fd == -1) || fsync(fd)) {
+        LOGERR(ctx, LY_ESYS, "Syncing the data store directory failed (%s).", strerror(errno));
+        ret = -1;
+    }
+    if (fd != -1) {
+        close(fd);
+    }
+    free(dup);
+    return ret;
+}
+
+/* start an empty log following the current snapshot */
+static int
+store_log_reset(struct lyd_store *store)
+{
+    uint8_t buf[STORE_GEN_SIZE];
+
+    if (ftruncate(store->log_fd, 0)) {
+        LOGERR(store->ctx, LY_ESYS, "Truncating the data store log failed (%s).", strerror(errno));
+        return -1;
+    }
+    store_put_num(buf, store->gen, STORE_GEN_SIZE);
+    if (store_write(store->ctx, store->log_fd, (char *)buf, sizeof buf) || fdatasync(store->log_fd)) {
+        return -1;
+    }
+    store->log_size = STORE_GEN_SIZE;
+
+    return 0;
+}
+
+/* read the snapshot, NULL in root for an empty one */
+static int
+store_read_snapshot(struct lyd_store *store, struct lyd_node **root)
+{
+    char *data = NULL;
+    size_t length = 0;
+    int fd, len, ret = -1;
+    struct stat st;
+
+    *root = NULL;
+    store->gen = 0;
+    store->snapshot_size = 0;
+
+    fd = open(store->path, O_RDONLY);
+    if (fd == -1) {
+        if (errno == ENOENT) {
+            /* no snapshot yet */
+            return 0;
+        }
+        LOGERR(store->ctx, LY_ESYS, "Opening the data store snapshot \"%s\" failed (%s).", store->path, strerror(errno));
+        return -1;
+    }
+    if (fstat(fd, &st) || lyp_mmap(store->ctx, fd, 0, &length, (void **)&data)) {
+        goto cleanup;
+    }
+    if (!st.st_size) {
+        ret = 0;
+        goto cleanup;
+    }
+
+    len = lyd_lyb_data_length(data);
+    if ((len < 0) || ((size_t)len + STORE_GEN_SIZE != (size_t)st.st_size)) {
+        LOGERR(store->ctx, LY_EINVAL, "Invalid data store snapshot \"%s\".", store->path);
+        goto cleanup;
+    }
+    store->gen = store_get_num(data + len, STORE_GEN_SIZE);
+    store->snapshot_size = st.st_size;
+
+    *root = lyd_parse_mem(store->ctx, data, LYD_LYB, store->options);
+    if (!*root && ly_errno) {
+        goto cleanup;
+    }
+    ret = 0;
+
+cleanup:
+    if (data) {
+        lyp_munmap(data, length);
+    }
+    close(fd);
+    return ret;
+}
+
+/* apply the log records to the data tree, cut off an incomplete last record */
+static int
+store_replay_log(struct lyd_store *store, struct lyd_node **root)
+{
+    char *data = NULL;
+    size_t length = 0, offset, len;
+    struct stat st;
+    int ret = -1, applied = 0;
+
+    if (fstat(store->log_fd, &st) || lyp_mmap(store->ctx, store->log_fd, 0, &length, (void **)&data)) {
+        return -1;
+    }
+    if (((size_t)st.st_size < STORE_GEN_SIZE) || (store_get_num(data, STORE_GEN_SIZE) != store->gen)) {
+        /* empty or following a previous snapshot */
+        ret = store_log_reset(store);
+        goto cleanup;
+    }
+
+    for (offset = STORE_GEN_SIZE; offset + STORE_REC_SIZE <= (size_t)st.st_size; offset += STORE_REC_SIZE + len) {
+        len = store_get_num(data + offset, 4);
+        if ((offset + STORE_REC_SIZE + len > (size_t)st.st_size)
+                || (store_hash(data + offset + STORE_REC_SIZE, len) != store_get_num(data + offset + 4, 4))) {
+            /* not written whole */
+            break;
+        }
+        if (lyd_apply_lyb_patch(store->ctx, root, data + offset + STORE_REC_SIZE)) {
+            LOGERR(store->ctx, LY_EINVAL, "Data store log \"%s\" does not match its snapshot.", store->log_path);
+            goto cleanup;
+        }
+        applied = 1;
+    }
+    if ((offset != (size_t)st.st_size) && (ftruncate(store->log_fd, offset) || fdatasync(store->log_fd))) {
+        LOGERR(store->ctx, LY_ESYS, "Truncating the data store log failed (%s).", strerror(errno));
+        goto cleanup;
+    }
+    store->log_size = offset;
+
+    if (applied && !(store->options & LYD_OPT_TRUSTED)
+            && lyd_validate(root, store->options, store->ctx)) {
+        goto cleanup;
+    }
+    ret = 0;
+
+cleanup:
+    if (data) {
+        lyp_munmap(data, length);
+    }
+    return ret;
+}
+
+API struct lyd_store *
+lyd_store_open(struct ly_ctx *ctx, const char *path, int options, size_t compact, struct lyd_node **root)
+{
+    struct lyd_store *store;
+
+    if (!ctx || !path || !root || (options & LYD_OPT_TYPEMASK & ~(LYD_OPT_DATA | LYD_OPT_CONFIG))) {
+        LOGARG;
+        return NULL;
+    }
+    *root = NULL;
+
+    store = calloc(1, sizeof *store);
+    LY_CHECK_ERR_RETURN(!store, LOGMEM(ctx), NULL);
+    store->ctx = ctx;
+    store->options = options;
+    store->compact = compact;
+    store->log_fd = -1;
+    store->path = strdup(path);
+    if (!store->path || (asprintf(&store->log_path, "%s.log", path) == -1)) {
+        store->log_path = NULL;
+        LOGMEM(ctx);
+        goto error;
+    }
+
+    if (store_read_snapshot(store, root)) {
+        goto error;
+    }
+
+    store->log_fd = open(store->log_path, O_RDWR | O_CREAT | O_APPEND, 0600);
+    if (store->log_fd == -1) {
+        LOGERR(ctx, LY_ESYS, "Opening the data store log \"%s\" failed (%s).", store->log_path, strerror(errno));
+        goto error;
+    }
+    if (store_replay_log(store, root)) {
+        goto error;
+    }
+
+    return store;
+
+error:
+    lyd_free_withsiblings(*root);
+    *root = NULL;
+    lyd_store_close(store);
+    return NULL;
+}
+
+API void
+lyd_store_close(struct lyd_store *store)
+{
+    if (!store) {
+        return;
+    }
+
+    if (store->log_fd != -1) {
+        close(store->log_fd);
+    }
+    free(store->path);
+    free(store->log_path);
+    free(store);
+}
+
+API int
+lyd_store_compact(struct lyd_store *store, const struct lyd_node *root)
+{
+    char *data = NULL, *tmp_path = NULL;
+    uint8_t buf[STORE_GEN_SIZE];
+    int fd = -1, len, ret = -1;
+
+    if (!store || (root && (lyd_node_module(root)->ctx != store->ctx))) {
+        LOGARG;
+        return -1;
+    }
+    if (root) {
+        for (; root->parent; root = root->parent);
+        for (; root->prev->next; root = root->prev);
+    }
+
+    if (lyd_print_mem(&data, root, LYD_LYB, LYP_WITHSIBLINGS | LYP_IDENTIDX)) {
+        goto cleanup;
+    }
+    len = lyd_lyb_data_length(data);
+    if (len < 0) {
+        LOGINT(store->ctx);
+        goto cleanup;
+    }
+    store_put_num(buf, store->gen + 1, STORE_GEN_SIZE);
+
+    /* the new snapshot replaces the previous one whole */
+    if (asprintf(&tmp_path, "%s.tmp", store->path) == -1) {
+        tmp_path = NULL;
+        LOGMEM(store->ctx);
+        goto cleanup;
+    }
+    fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd == -1) {
+        LOGERR(store->ctx, LY_ESYS, "Creating the data store snapshot \"%s\" failed (%s).", tmp_path, strerror(errno));
+        goto cleanup;
+    }
+    if (store_write(store->ctx, fd, data, len) || store_write(store->ctx, fd, (char *)buf, sizeof buf)) {
+        goto cleanup;
+    }
+    if (fsync(fd) || rename(tmp_path, store->path)) {
+        LOGERR(store->ctx, LY_ESYS, "Replacing the data store snapshot \"%s\" failed (%s).", store->path, strerror(errno));
+        goto cleanup;
+    }
+    if (store_sync_dir(store->ctx, store->path)) {
+        goto cleanup;
+    }
+    ++store->gen;
+    store->snapshot_size = len + STORE_GEN_SIZE;
+
+    /* the log of the previous generation is discarded even if this is interrupted */
+    if (!store_log_reset(store)) {
+        ret = store_sync_dir(store->ctx, store->log_path);
+    }
+
+cleanup:
+    if (fd != -1) {
+        close(fd);
+        if (ret) {
+            unlink(tmp_path);
+        }
+    }
+    free(tmp_path);
+    free(data);
+    return ret;
+}
+
+API int
+lyd_store_commit(struct lyd_store *store, const struct lyd_difflist *diff, const struct lyd_node *root)
+{
+    char *patch = NULL;
+    uint8_t buf[STORE_REC_SIZE];
+    int len, ret = -1;
+
+    if (!store || !diff) {
+        LOGARG;
+        return -1;
+    }
+    if (diff->type[0] == LYD_DIFF_END) {
+        /* nothing changed */
+        return 0;
+    }
+
+    if (lyd_print_lyb_patch(&patch, diff, LYP_STRTABLE | LYP_IDENTIDX)) {
+        goto cleanup;
+    }
+    len = lyd_lyb_data_length(patch);
+    if (len < 0) {
+        LOGINT(store->ctx);
+        goto cleanup;
+    }
+
+    /* the record is durable once synced, an interrupted one is cut off when replaying the log */
+    store_put_num(buf, len, 4);
+    store_put_num(buf + 4, store_hash(patch, len), 4);
+    if (store_write(store->ctx, store->log_fd, (char *)buf, sizeof buf)
+            || store_write(store->ctx, store->log_fd, patch, len)) {
+        goto truncate;
+    }
+    if (fdatasync(store->log_fd)) {
+        LOGERR(store->ctx, LY_ESYS, "Syncing the data store log failed (%s).", strerror(errno));
+        goto truncate;
+    }
+    store->log_size += STORE_REC_SIZE + len;
+    ret = 0;
+
+    if (store->log_size > (store->compact ? store->compact : store->snapshot_size)) {
+        /* replaying the log would take longer than reading the whole tree, the changes are persisted anyway */
+        if (lyd_store_compact(store, root)) {
+            ret = 1;
+        }
+    }
+    goto cleanup;
+
+truncate:
+    /* the record is not committed, a repeated commit must not follow a partial or unsynced one */
+    if (ftruncate(store->log_fd, store->log_size)) {
+        LOGERR(store->ctx, LY_ESYS, "Truncating the data store log failed (%s).", strerror(errno));
+    }
+
+cleanup:
+    free(patch);
+    return ret;
+}
@@ -26,6 +26,8 @@
 #include <unistd.h>
 #include <string.h>
 #include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
 
 #include "libyang.h"
 #include "common.h"
@@ -39,35 +41,72 @@
 #include "xpath.h"
 
 static struct lys_node *lyd_get_schema_inctx(const struct lyd_node *node, struct ly_ctx *ctx);
+static void lyd_journal_created(struct lyd_node *node);
+static void lyd_journal_deleted(struct lyd_node *node);
+static void lyd_journal_changed(struct lyd_node *node, int was_dflt);
+
+/* temporary modifications of the thread that are reverted (dummy nodes), they do not change the generation */
+static THREAD_LOCAL int lyd_gen_frozen;
+
+/* journal of a data tree changes, see lyd_journal_start() */
+struct lyd_journal {
+    struct ly_ctx *ctx;
+    struct ly_set *tops;        /* top-level nodes of the journaled tree */
+    struct lyd_difflist *diff;  /* recorded changes */
+    unsigned int size;          /* allocated size of the diff arrays */
+    unsigned int index;         /* number of the changes */
+    int busy;                   /* the journal is recording a change itself */
+};
+
+/* the journal of the thread */
+static THREAD_LOCAL struct lyd_journal *lyd_journal_active;
+
+/* the last computed list instance position, valid only while the generation of its context does not change */
+static THREAD_LOCAL struct {
+    const struct lyd_node *node;
+    const struct lys_node *schema;
+    const struct ly_ctx *ctx;
+    uint64_t gen;
+    unsigned int pos;
+} lyd_list_pos_cache;
 
 static int
 lyd_anydata_equal(struct lyd_node *first, struct lyd_node *second)
 {
-    char *str1 = NULL, *str2 = NULL;
+    char *buf1 = NULL, *buf2 = NULL;
+    const char *str1, *str2;
     struct lyd_node_anydata *anydata;
+    int ret;
 
     assert(first->schema->nodetype & LYS_ANYDATA);
     assert(first->schema->nodetype == second->schema->nodetype);
 
+    /* the printed values are not stored in the nodes, comparing must not modify the data trees */
     anydata = (struct lyd_node_anydata *)first;
     if (!anydata->value.str) {
-        lyxml_print_mem(&str1, anydata->value.xml, LYXML_PRINT_SIBLINGS);
-        anydata->value.str = lydict_insert_zc(anydata->schema->module->ctx, str1);
+        lyxml_print_mem(&buf1, anydata->value.xml, LYXML_PRINT_SIBLINGS);
+        str1 = buf1;
+    } else {
+        str1 = anydata->value.str;
     }
-    str1 = (char *)anydata->value.str;
 
     anydata = (struct lyd_node_anydata *)second;
     if (!anydata->value.str) {
-        lyxml_print_mem(&str2, anydata->value.xml, LYXML_PRINT_SIBLINGS);
-        anydata->value.str = lydict_insert_zc(anydata->schema->module->ctx, str2);
+        lyxml_print_mem(&buf2, anydata->value.xml, LYXML_PRINT_SIBLINGS);
+        str2 = buf2;
+    } else {
+        str2 = anydata->value.str;
     }
-    str2 = (char *)anydata->value.str;
 
-    if (first->schema->module->ctx != second->schema->module->ctx) {
-        return ly_strequal(str1, str2, 0);
+    if (buf1 || buf2 || (first->schema->module->ctx != second->schema->module->ctx)) {
+        ret = ly_strequal(str1, str2, 0);
     } else {
-        return ly_strequal(str1, str2, 1);
+        ret = ly_strequal(str1, str2, 1);
     }
+
+    free(buf1);
+    free(buf2);
+    return ret;
 }
 
 /* used in tests */
@@ -108,17 +147,144 @@ lyd_list_has_keys(struct lyd_node *list)
     return 1;
 }
 
-static int
+/* typedef of a type whose values are stored by a user type plugin, unions and leafrefs are not resolved for it */
+static struct lys_tpdf *
+lyd_user_type_tpdf(const struct lys_node *snode)
+{
+    struct lys_type *type = &((struct lys_node_leaf *)snode)->type;
+
+    if ((type->base == LY_TYPE_UNION) || (type->base == LY_TYPE_LEAFREF) || !type->der || !type->der->module) {
+        return NULL;
+    }
+    return type->der;
+}
+
+int
+lyd_hash_user_type(const struct lys_node *snode)
+{
+    struct lys_tpdf *tpdf;
+    int i;
+
+    if (snode->nodetype == LYS_LEAFLIST) {
+        tpdf = lyd_user_type_tpdf(snode);
+        return (tpdf && !lytype_hash(tpdf, NULL, NULL));
+    } else if (snode->nodetype == LYS_LIST) {
+        for (i = 0; i < ((struct lys_node_list *)snode)->keys_size; ++i) {
+            tpdf = lyd_user_type_tpdf((struct lys_node *)((struct lys_node_list *)snode)->keys[i]);
+            if (tpdf && !lytype_hash(tpdf, NULL, NULL)) {
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+uint32_t
+lyd_hash_value(uint32_t hash, const struct lyd_node_leaf_list *leaf)
+{
+    struct lys_tpdf *tpdf;
+    uint32_t uhash;
+
+    if ((leaf->value_flags & LY_VALUE_USER) && (tpdf = lyd_user_type_tpdf(leaf->schema))
+            && !lytype_hash(tpdf, &leaf->value, &uhash)) {
+        return dict_hash_multi(hash, (const char *)&uhash, sizeof uhash);
+    }
+    return dict_hash_multi(hash, leaf->value_str, strlen(leaf->value_str));
+}
+
+int
 lyd_leaf_val_equal(struct lyd_node *node1, struct lyd_node *node2, int diff_ctx)
 {
+    struct lyd_node_leaf_list *leaf1 = (struct lyd_node_leaf_list *)node1, *leaf2 = (struct lyd_node_leaf_list *)node2;
+    struct lys_tpdf *tpdf1, *tpdf2;
+    int r;
+
     assert(node1->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST));
     assert(node1->schema->nodetype == node2->schema->nodetype);
 
-    if (diff_ctx) {
-        return ly_strequal(((struct lyd_node_leaf_list *)node1)->value_str, ((struct lyd_node_leaf_list *)node2)->value_str, 0);
+    if ((leaf1->value_flags & LY_VALUE_USER) && (leaf2->value_flags & LY_VALUE_USER)
+            && (tpdf1 = lyd_user_type_tpdf(node1->schema)) && (tpdf2 = lyd_user_type_tpdf(node2->schema))
+            && ((r = lytype_compare(tpdf1, &leaf1->value, tpdf2, &leaf2->value)) > -1)) {
+        return r;
+    }
+
+    if (diff_ctx || ((leaf1->value_flags | leaf2->value_flags) & LY_VALUE_PRIVATE)) {
+        return ly_strequal(leaf1->value_str, leaf2->value_str, 0);
     } else {
-        return ly_strequal(((struct lyd_node_leaf_list *)node1)->value_str, ((struct lyd_node_leaf_list *)node2)->value_str, 1);
+        return ly_strequal(leaf1->value_str, leaf2->value_str, 1);
+    }
+}
+
+int
+lyd_value_private(const struct lys_node *snode)
+{
+    struct lys_tpdf *tpdf;
+    int types = snode->module->ctx->private_vals;
+
+    if (!types) {
+        return 0;
+    }
+
+    switch (((struct lys_node_leaf *)snode)->type.base) {
+    case LY_TYPE_INT8:
+    case LY_TYPE_INT16:
+    case LY_TYPE_INT32:
+    case LY_TYPE_INT64:
+    case LY_TYPE_UINT8:
+    case LY_TYPE_UINT16:
+    case LY_TYPE_UINT32:
+    case LY_TYPE_UINT64:
+    case LY_TYPE_DEC64:
+        return types & LY_PRIVVAL_NUMBERS;
+    case LY_TYPE_STRING:
+        return (types & LY_PRIVVAL_USER) && (tpdf = lyd_user_type_tpdf(snode)) && lytype_is_user(tpdf);
+    default:
+        /* few distinct values or the value strings are transformed in the dictionary */
+        return 0;
+    }
+}
+
+int
+lyd_leaf_val_order(const struct lyd_node *node, const struct lyd_node *node2, const char *value2, int *order)
+{
+    const struct lyd_node_leaf_list *leaf = (const struct lyd_node_leaf_list *)node;
+    const struct lyd_node_leaf_list *leaf2 = (const struct lyd_node_leaf_list *)node2;
+    struct lys_tpdf *tpdf, *tpdf2;
+    enum int_log_opts prev_ilo;
+    lyd_val val;
+    int r;
+
+    if (!(node->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST)) || !(leaf->value_flags & LY_VALUE_USER)
+            || !(tpdf = lyd_user_type_tpdf(node->schema))) {
+        return 1;
+    }
+
+    if (leaf2 && (leaf2->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST)) && (leaf2->value_flags & LY_VALUE_USER)
+            && (tpdf2 = lyd_user_type_tpdf(node2->schema))) {
+        return lytype_order(tpdf, &leaf->value, tpdf2, &leaf2->value, order);
+    }
+
+    if (leaf2) {
+        value2 = leaf2->value_str;
+    }
+    if (!value2) {
+        return 1;
+    }
+
+    /* store the string as a value of the same type, it does not have to be valid */
+    memset(&val, 0, sizeof val);
+    val.string = value2;
+    ly_ilo_change(NULL, ILO_IGNORE, &prev_ilo, NULL);
+    r = lytype_store(tpdf, value2, &val);
+    ly_ilo_restore(NULL, prev_ilo, NULL, 0);
+    if (r) {
+        return 1;
     }
+
+    r = lytype_order(tpdf, &leaf->value, tpdf, &val, order);
+    lytype_free(tpdf, val);
+    return r;
 }
 
 /*
@@ -313,30 +479,44 @@ lyd_hash_table_val_equal(void *val1_p, void *val2_p, int mod, void *UNUSED(cb_da
     return 0;
 }
 
-static void
-lyd_hash_keyless_list_dfs(struct lyd_node *child, uint32_t *hash)
+/**
+ * @brief Sum the hashes of terminal nodes in subtrees, it is the part of a key-less list hash the subtrees make.
+ *
+ * The hashes are summed so that a key-less list hash does not depend on the order of its descendants and can
+ * be adjusted when a subtree is inserted or removed, see lyd_keyless_list_hash_change().
+ *
+ * @param[in] child First subtree to sum.
+ * @param[in] siblings Whether to sum all the following sibling subtrees, too.
+ * @return Sum of the hashes.
+ */
+static uint32_t
+lyd_hash_keyless_list_sum(const struct lyd_node *child, int siblings)
 {
-    LY_TREE_FOR(child, child) {
+    uint32_t sum = 0;
+
+    for (; child; child = siblings ? child->next : NULL) {
         switch (child->schema->nodetype) {
         case LYS_CONTAINER:
-            lyd_hash_keyless_list_dfs(child->child, hash);
+            sum += lyd_hash_keyless_list_sum(child->child, 1);
             break;
         case LYS_LIST:
             /* ignore lists with missing keys */
-            if (lyd_list_has_keys(child)) {
-                lyd_hash_keyless_list_dfs(child->child, hash);
+            if (lyd_list_has_keys((struct lyd_node *)child)) {
+                sum += lyd_hash_keyless_list_sum(child->child, 1);
             }
             break;
         case LYS_LEAFLIST:
         case LYS_ANYXML:
         case LYS_ANYDATA:
         case LYS_LEAF:
-            *hash = dict_hash_multi(*hash, (char *)&child->hash, sizeof child->hash);
+            sum += child->hash;
             break;
         default:
             assert(0);
         }
     }
+
+    return sum;
 }
 
 int
@@ -351,18 +531,17 @@ lyd_hash(struct lyd_node *node)
         node->hash = dict_hash_multi(0, lyd_node_module(node)->name, strlen(lyd_node_module(node)->name));
         node->hash = dict_hash_multi(node->hash, node->schema->name, strlen(node->schema->name));
         if (node->schema->nodetype == LYS_LEAFLIST) {
-            node->hash = dict_hash_multi(node->hash, ((struct lyd_node_leaf_list *)node)->value_str,
-                                        strlen(((struct lyd_node_leaf_list *)node)->value_str));
+            node->hash = lyd_hash_value(node->hash, (struct lyd_node_leaf_list *)node);
         } else if (node->schema->nodetype == LYS_LIST) {
             if (((struct lys_node_list *)node->schema)->keys_size) {
                 for (i = 0, iter = node->child; i < ((struct lys_node_list *)node->schema)->keys_size; ++i, iter = iter->next) {
                     assert(iter);
-                    node->hash = dict_hash_multi(node->hash, ((struct lyd_node_leaf_list *)iter)->value_str,
-                                                 strlen(((struct lyd_node_leaf_list *)iter)->value_str));
+                    node->hash = lyd_hash_value(node->hash, (struct lyd_node_leaf_list *)iter);
                 }
             } else {
                 /* no-keys list */
-                lyd_hash_keyless_list_dfs(node->child, &node->hash);
+                node->hash = dict_hash_multi(node->hash, NULL, 0) + lyd_hash_keyless_list_sum(node->child, 1);
+                return 0;
             }
         }
         node->hash = dict_hash_multi(node->hash, NULL, 0);
@@ -372,22 +551,45 @@ lyd_hash(struct lyd_node *node)
     return 1;
 }
 
+/**
+ * @brief Adjust the hashes of the key-less lists (in state data) a subtree was inserted into or removed from.
+ *
+ * @param[in] parent Parent of the subtree.
+ * @param[in] first Subtree (its sum is computed only if there is a key-less list to adjust).
+ * @param[in] siblings Whether the following siblings of \p first were inserted/removed as well.
+ * @param[in] extra Additional hash sum to adjust by.
+ * @param[in] removed Whether the subtree was removed.
+ */
 static void
-lyd_keyless_list_hash_change(struct lyd_node *parent)
+lyd_keyless_list_hash_change(struct lyd_node *parent, const struct lyd_node *first, int siblings, uint32_t extra,
+                             int removed)
 {
-    int r;
+    uint32_t diff = 0;
+    int r, sum = 0;
 
     while (parent && (parent->schema->flags & LYS_CONFIG_R)) {
         if (parent->schema->nodetype == LYS_LIST) {
             if (!((struct lys_node_list *)parent->schema)->keys_size) {
+                if (!sum) {
+                    diff = lyd_hash_keyless_list_sum(first, siblings) + extra;
+                    sum = 1;
+                }
+                if (!diff) {
+                    break;
+                }
+
                 if (parent->parent && parent->parent->ht) {
                     /* remove the list from the parent */
                     r = lyht_remove(parent->parent->ht, &parent, parent->hash);
                     assert(!r);
                     (void)r;
                 }
-                /* recalculate the hash */
-                lyd_hash(parent);
+                /* adjust the hash, the same as recalculating it */
+                if (removed) {
+                    parent->hash -= diff;
+                } else {
+                    parent->hash += diff;
+                }
                 if (parent->parent && parent->parent->ht) {
                     /* re-add the list again */
                     r = lyht_insert(parent->parent->ht, &parent, parent->hash, NULL);
@@ -404,12 +606,55 @@ lyd_keyless_list_hash_change(struct lyd_node *parent)
     }
 }
 
+/**
+ * @brief Create the children hash table of a parent if it has enough hashed children.
+ *
+ * @param[in] parent Parent without a children hash table.
+ */
 static void
-_lyd_insert_hash(struct lyd_node *node, int keyless_list_check)
+lyd_children_ht_create(struct lyd_node *parent)
 {
     struct lyd_node *iter;
+    uint32_t count;
+    uint16_t threshold;
     int i;
 
+    assert(!parent->ht);
+
+    threshold = parent->schema->module->ctx->data_ht_threshold;
+    for (i = 0, iter = parent->child; threshold && iter && (i < threshold); ++i, iter = iter->next) {
+        if ((iter->schema->nodetype == LYS_LIST) && !lyd_list_has_keys(iter)) {
+            /* it will either never have keys and will never be hashed or has not all keys created yet */
+            --i;
+        }
+    }
+    /* the threshold may have been lowered since the other children were inserted */
+    if (!threshold || (i < threshold)) {
+        return;
+    }
+
+    /* create hash table large enough for all the children, insert them */
+    parent->ht = lyht_new(1, sizeof(struct lyd_node *), lyd_hash_table_val_equal, NULL, 1 | LYHT_RESIZE_INCREMENTAL);
+    lyht_set_stats(parent->ht, parent->schema->module->ctx);
+    for (count = 0, iter = parent->child; iter; iter = iter->next, ++count);
+    lyht_reserve(parent->ht, count);
+    LY_TREE_FOR(parent->child, iter) {
+        if ((iter->schema->nodetype == LYS_LIST) && !lyd_list_has_keys(iter)) {
+            /* skip lists without keys */
+            continue;
+        }
+
+        if (lyht_insert(parent->ht, &iter, iter->hash, NULL)) {
+            assert(0);
+        }
+    }
+}
+
+static void
+_lyd_insert_hash(struct lyd_node *node, int keyless_list_check)
+{
+    int parent_hashed = 0;
+
     if (node->parent) {
         if ((node->schema->nodetype != LYS_LIST) || lyd_list_has_keys(node)) {
             if ((node->schema->nodetype == LYS_LEAF) && lys_is_key((struct lys_node_leaf *)node->schema, NULL)) {
@@ -417,56 +662,279 @@ _lyd_insert_hash(struct lyd_node *node, int keyless_list_check)
                 if (!lyd_hash(node->parent)) {
                     /* yep, we successfully hashed node->parent so it is technically now added to its parent (hash-wise) */
                     _lyd_insert_hash(node->parent, 0);
+                    parent_hashed = 1;
                 }
             }
 
             /* create parent hash table if required, otherwise just add the new child */
             if (!node->parent->ht) {
-                for (i = 0, iter = node->parent->child; iter; ++i, iter = iter->next) {
-                    if ((iter->schema->nodetype == LYS_LIST) && !lyd_list_has_keys(iter)) {
-                        /* it will either never have keys and will never be hashed or has not all keys created yet */
-                        --i;
-                    }
-                }
-                assert(i <= LY_CACHE_HT_MIN_CHILDREN);
-                if (i == LY_CACHE_HT_MIN_CHILDREN) {
-                    /* create hash table, insert all the children */
-                    node->parent->ht = lyht_new(1, sizeof(struct lyd_node *), lyd_hash_table_val_equal, NULL, 1);
-                    LY_TREE_FOR(node->parent->child, iter) {
-                        if ((iter->schema->nodetype == LYS_LIST) && !lyd_list_has_keys(iter)) {
-                            /* skip lists without keys */
-                            continue;
-                        }
-
-                        if (lyht_insert(node->parent->ht, &iter, iter->hash, NULL)) {
-                            assert(0);
-                        }
-                    }
-                }
+                lyd_children_ht_create(node->parent);
             } else {
                 if (lyht_insert(node->parent->ht, &node, node->hash, NULL)) {
                     assert(0);
                 }
             }
 
-            /* if node was in a state data subtree, wasn't it a part of a key-less list hash? */
+            /* if node was in a state data subtree, wasn't it a part of a key-less list hash?
+             * (with the whole parent subtree if the parent got its last key) */
             if (keyless_list_check) {
-                lyd_keyless_list_hash_change(node->parent);
+                if (parent_hashed) {
+                    lyd_keyless_list_hash_change(node->parent, node->parent->child, 1, 0, 0);
+                } else {
+                    lyd_keyless_list_hash_change(node->parent, node, 0, 0, 0);
+                }
             }
         }
     }
 }
 
+/* the subtree filter was built, the other bits are set by the names of the descendants */
+#define LYD_BLOOM_BUILT ((uint64_t)1 << 63)
+
+uint64_t
+lyd_bloom_bits(const char *name, size_t len)
+{
+    uint32_t hash;
+
+    hash = dict_hash_multi(0, name, len);
+    hash = dict_hash_multi(hash, NULL, 0);
+
+    /* 2 of the 63 bits */
+    return ((uint64_t)1 << (hash % 63)) | ((uint64_t)1 << ((hash >> 16) % 63));
+}
+
+static int
+lyd_side_equal(void *val1_p, void *val2_p, int UNUSED(mod), void *UNUSED(cb_data))
+{
+    return (*(struct lyd_side **)val1_p)->node == (*(struct lyd_side **)val2_p)->node;
+}
+
+static uint32_t
+lyd_side_hash(const struct lyd_node *node)
+{
+    return dict_hash_multi(dict_hash_multi(0, (const char *)&node, sizeof node), NULL, 0);
+}
+
+struct lyd_side *
+lyd_side_get(struct lyd_node *node, int create)
+{
+    struct ly_ctx *ctx = node->schema->module->ctx;
+    struct lyd_side key, *rec = &key, **found;
+    uint32_t hash;
+
+    if (!node->side && !create) {
+        return NULL;
+    }
+
+    key.node = node;
+    hash = lyd_side_hash(node);
+
+    if (node->side) {
+        pthread_rwlock_rdlock(&ctx->data_side_lock);
+        rec = lyht_find(ctx->data_side, &rec, hash, (void **)&found) ? NULL : *found;
+        pthread_rwlock_unlock(&ctx->data_side_lock);
+        assert(rec);
+        return rec;
+    }
+
+    pthread_rwlock_wrlock(&ctx->data_side_lock);
+
+    if (!ctx->data_side) {
+        ctx->data_side = lyht_new(16, sizeof rec, lyd_side_equal, NULL, 1);
+        LY_CHECK_ERR_GOTO(!ctx->data_side, LOGMEM(ctx), error);
+    }
+
+    rec = calloc(1, sizeof *rec);
+    LY_CHECK_ERR_GOTO(!rec, LOGMEM(ctx), error);
+    rec->node = node;
+    if (lyht_insert(ctx->data_side, &rec, hash, NULL)) {
+        LOGMEM(ctx);
+        free(rec);
+        goto error;
+    }
+    node->side = 1;
+
+    pthread_rwlock_unlock(&ctx->data_side_lock);
+    return rec;
+
+error:
+    pthread_rwlock_unlock(&ctx->data_side_lock);
+    return NULL;
+}
+
+void
+lyd_side_free(struct lyd_node *node)
+{
+    struct ly_ctx *ctx = node->schema->module->ctx;
+    struct lyd_side key, *rec = &key, **found;
+    uint32_t hash;
+
+    if (!node->side) {
+        return;
+    }
+
+    key.node = node;
+    hash = lyd_side_hash(node);
+
+    pthread_rwlock_wrlock(&ctx->data_side_lock);
+    if (!lyht_find(ctx->data_side, &rec, hash, (void **)&found)) {
+        rec = *found;
+        lyht_remove(ctx->data_side, &rec, hash);
+    } else {
+        rec = NULL;
+    }
+    pthread_rwlock_unlock(&ctx->data_side_lock);
+    node->side = 0;
+
+    if (rec) {
+        lyv_uniq_idx_free(rec->uniq);
+        free(rec);
+    }
+}
+
+void
+lyd_side_clear(struct ly_ctx *ctx)
+{
+    struct ht_rec *ht_rec;
+    struct lyd_side *rec;
+    uint32_t i;
+
+    pthread_rwlock_wrlock(&ctx->data_side_lock);
+
+    if (ctx->data_side) {
+        for (i = 0; i < ctx->data_side->size; ++i) {
+            if (ctx->data_side->ctrl[i] & LYHT_CTRL_FULL) {
+                ht_rec = lyht_get_rec(ctx->data_side->recs, ctx->data_side->rec_size, i);
+                rec = *(struct lyd_side **)ht_rec->val;
+                lyv_uniq_idx_free(rec->uniq);
+                free(rec);
+            }
+        }
+        lyht_free(ctx->data_side);
+        ctx->data_side = NULL;
+    }
+
+    pthread_rwlock_unlock(&ctx->data_side_lock);
+}
+
+/* filter of a node, 0 if not built */
+static uint64_t
+lyd_bloom_get(struct lyd_node *node)
+{
+    struct lyd_side *side;
+
+    side = lyd_side_get(node, 0);
+    return side ? side->bloom : 0;
+}
+
+/* build the filter of a subtree, only the subtrees not yet built are traversed */
+static uint64_t
+lyd_bloom_build(struct lyd_node *node)
+{
+    struct lyd_node *iter;
+    struct lyd_side *side;
+    uint64_t bloom = LYD_BLOOM_BUILT;
+
+    side = lyd_side_get(node, 1);
+    if (!side) {
+        /* without a filter, the subtree can include anything */
+        return ~(uint64_t)0;
+    } else if (side->bloom & LYD_BLOOM_BUILT) {
+        return side->bloom;
+    }
+
+    LY_TREE_FOR(node->child, iter) {
+        bloom |= lyd_bloom_bits(iter->schema->name, strlen(iter->schema->name));
+        if (iter->schema->nodetype & LYD_BLOOM_INNER) {
+            bloom |= lyd_bloom_build(iter);
+        }
+    }
+
+    side->bloom = bloom;
+    return bloom;
+}
+
+int
+lyd_bloom_contains(struct lyd_node *node, uint64_t bits)
+{
+    if (!(node->schema->module->ctx->models.flags & LY_CTX_SUBTREE_FILTERS)
+            || !(node->schema->nodetype & LYD_BLOOM_INNER)) {
+        return 1;
+    }
+
+    return (lyd_bloom_build(node) & bits) == bits;
+}
+
+void
+lyd_bloom_build_tree(struct lyd_node *node)
+{
+    struct lyd_node *iter;
+
+    if (!(node->schema->module->ctx->models.flags & LY_CTX_SUBTREE_FILTERS)) {
+        return;
+    }
+
+    for (; node->parent; node = node->parent);
+    for (; node->prev->next; node = node->prev);
+    LY_TREE_FOR(node, iter) {
+        if (iter->schema->nodetype & LYD_BLOOM_INNER) {
+            lyd_bloom_build(iter);
+        }
+    }
+}
+
+/* a built filter includes the names of the whole subtree, so the parents with a built filter
+ * learn the names of a new child subtree (which gets a built filter itself) */
+static void
+lyd_bloom_insert(struct lyd_node *node)
+{
+    struct lyd_node *parent;
+    struct lyd_side *side;
+    uint64_t bits;
+
+    if (!node->parent || !(lyd_bloom_get(node->parent) & LYD_BLOOM_BUILT)) {
+        return;
+    }
+
+    bits = lyd_bloom_bits(node->schema->name, strlen(node->schema->name));
+    if (node->schema->nodetype & LYD_BLOOM_INNER) {
+        bits |= lyd_bloom_build(node) & ~LYD_BLOOM_BUILT;
+    }
+    for (parent = node->parent; parent && ((side = lyd_side_get(parent, 0))) && (side->bloom & LYD_BLOOM_BUILT);
+            parent = parent->parent) {
+        if ((side->bloom & bits) == bits) {
+            /* the parents above include these bits as well */
+            break;
+        }
+        side->bloom |= bits;
+    }
+}
+
+/* the removed names stay in the filters, so they are rebuilt when needed next time, only from the children
+ * of the parents on the way up */
+static void
+lyd_bloom_unlink(struct lyd_node *orig_parent)
+{
+    struct lyd_side *side;
+
+    for (; orig_parent && ((side = lyd_side_get(orig_parent, 0))) && (side->bloom & LYD_BLOOM_BUILT);
+            orig_parent = orig_parent->parent) {
+        side->bloom = 0;
+    }
+}
+
 /* we have inserted node into a parent */
 void
 lyd_insert_hash(struct lyd_node *node)
 {
     _lyd_insert_hash(node, 1);
+    lyd_bloom_insert(node);
 }
 
 static void
 _lyd_unlink_hash(struct lyd_node *node, struct lyd_node *orig_parent, int keyless_list_check)
 {
+    uint16_t threshold;
 #ifndef NDEBUG
     struct lyd_node *iter;
 
@@ -486,7 +954,8 @@ _lyd_unlink_hash(struct lyd_node *node, struct lyd_node *orig_parent, int keyles
                 }
 
                 /* if no longer enough children, free the whole hash table */
-                if (orig_parent->ht->used < LY_CACHE_HT_MIN_CHILDREN) {
+                threshold = node->schema->module->ctx->data_ht_threshold;
+                if (!threshold || (orig_parent->ht->used < threshold)) {
                     lyht_free(orig_parent->ht);
                     orig_parent->ht = NULL;
                 }
@@ -498,11 +967,16 @@ _lyd_unlink_hash(struct lyd_node *node, struct lyd_node *orig_parent, int keyles
 
                 _lyd_unlink_hash(orig_parent, orig_parent->parent, 0);
                 orig_parent->hash = 0;
+
+                /* the whole parent subtree is no longer a part of a key-less list hash */
+                if (keyless_list_check) {
+                    lyd_keyless_list_hash_change(orig_parent->parent, orig_parent->child, 1, node->hash, 1);
+                }
             }
 
             /* if node was in a state data subtree, shouldn't it be a part of a key-less list hash? */
             if (keyless_list_check) {
-                lyd_keyless_list_hash_change(orig_parent);
+                lyd_keyless_list_hash_change(orig_parent, node, 0, 0, 1);
             }
         }
     }
@@ -512,7 +986,11 @@ _lyd_unlink_hash(struct lyd_node *node, struct lyd_node *orig_parent, int keyles
 void
 lyd_unlink_hash(struct lyd_node *node, struct lyd_node *orig_parent)
 {
+    if (orig_parent && orig_parent->side && (node->schema->nodetype == LYS_LIST)) {
+        lyv_uniq_idx_unlink(node, orig_parent);
+    }
     _lyd_unlink_hash(node, orig_parent, 1);
+    lyd_bloom_unlink(orig_parent);
 }
 
 #endif
@@ -524,6 +1002,10 @@ static int
 lyd_get_node_siblings(const struct lyd_node *data, const struct lys_node *schema, struct ly_set *set)
 {
     const struct lyd_node *iter;
+#ifdef LY_ENABLED_CACHE
+    struct lyd_node dummy, *dummy_p = &dummy, **match_p;
+    uint32_t hash;
+#endif
 
     assert(set && !set->number);
     assert(schema);
@@ -534,6 +1016,20 @@ lyd_get_node_siblings(const struct lyd_node *data, const struct lys_node *schema
         return 0;
     }
 
+#ifdef LY_ENABLED_CACHE
+    if (data->parent && data->parent->ht && (schema->nodetype & (LYS_CONTAINER | LYS_LEAF | LYS_ANYDATA))) {
+        /* single instance, its hash depends only on the schema node */
+        hash = dict_hash_multi(0, lys_node_module(schema)->name, strlen(lys_node_module(schema)->name));
+        hash = dict_hash_multi(hash, schema->name, strlen(schema->name));
+        hash = dict_hash_multi(hash, NULL, 0);
+        dummy.schema = (struct lys_node *)schema;
+        if (!lyht_find(data->parent->ht, &dummy_p, hash, (void **)&match_p)) {
+            ly_set_add(set, *match_p, LY_SET_OPT_USEASLIST);
+        }
+        return set->number;
+    }
+#endif
+
     LY_TREE_FOR(data, iter) {
         if (iter->schema == schema) {
             ly_set_add(set, (void*)iter, LY_SET_OPT_USEASLIST);
@@ -560,8 +1056,11 @@ lyd_is_when_false(struct lyd_node *root, struct lyd_node *last_parent, struct ly
         if (schema->nodetype == LYS_CHOICE) {
             schema = (struct lys_node *)lys_getnext(NULL, schema, NULL, LYS_GETNEXT_NOSTATECHECK);
         }
+        /* the dummy nodes are removed right away, the tree is not really modified */
+        ++lyd_gen_frozen;
         dummy = lyd_new_dummy(root, last_parent, schema, NULL, 0);
         if (!dummy) {
+            --lyd_gen_frozen;
             return -1;
         }
         if (!dummy->parent && root) {
@@ -577,6 +1076,7 @@ lyd_is_when_false(struct lyd_node *root, struct lyd_node *last_parent, struct ly
             if (current->when_status & LYD_WHEN_FALSE) {
                 /* when evaluates to false */
                 lyd_free(dummy);
+                --lyd_gen_frozen;
                 return 1;
             }
 
@@ -586,6 +1086,7 @@ lyd_is_when_false(struct lyd_node *root, struct lyd_node *last_parent, struct ly
             }
         }
         lyd_free(dummy);
+        --lyd_gen_frozen;
     }
 
     return 0;
@@ -705,6 +1206,12 @@ lyd_check_mandatory_subtree(struct lyd_node *tree, struct lyd_node *subtree, str
 
     assert(schema);
 
+    if (!lys_mand_subtree(schema->module->ctx, schema)
+            && !resolve_applies_when(schema, 1, last_parent ? last_parent->schema : NULL)) {
+        /* there is nothing to check in the whole subtree */
+        return EXIT_SUCCESS;
+    }
+
     if (schema->nodetype & (LYS_LEAF | LYS_LIST | LYS_LEAFLIST | LYS_ANYDATA | LYS_CONTAINER)) {
         /* data node */
         present = ly_set_new();
@@ -920,50 +1427,53 @@ lyd_check_mandatory_tree(struct lyd_node *root, struct ly_ctx *ctx, const struct
 
 static struct lyd_node *
 lyd_parse_(struct ly_ctx *ctx, const struct lyd_node *rpc_act, const char *data, LYD_FORMAT format, int options,
-           const struct lyd_node *data_tree, const char *yang_data_name)
+           const struct lyd_node *data_tree, const char *yang_data_name, const struct ly_set *projection)
 {
-    struct lyxml_elem *xml;
     struct lyd_node *result = NULL;
-    int xmlopt = LYXML_PARSE_MULTIROOT;
+    int parsed = 0;
 
     if (!ctx || !data) {
         LOGARG;
         return NULL;
     }
 
-    if (options & LYD_OPT_NOSIBLINGS) {
-        xmlopt = 0;
-    }
-
     /* we must free all the errors, otherwise we are unable to properly check returned ly_errno :-/ */
     ly_errno = LY_SUCCESS;
+    ly_parse_budget_start();
+    LY_STATS_ADD(ctx, parse_calls, 1);
+    LY_TRACE(parse_start, ctx, format, options);
     switch (format) {
     case LYD_XML:
-        xml = lyxml_parse_mem(ctx, data, xmlopt);
-        if (ly_errno) {
+        /* the XML elements are read and freed one by one while creating the data nodes */
+        parsed = strlen(data);
+        if (ly_parse_charge(ctx, 0, parsed)) {
             break;
         }
-        if (options & LYD_OPT_RPCREPLY) {
-            result = lyd_parse_xml(ctx, &xml, options, rpc_act, data_tree);
-        } else if (options & (LYD_OPT_RPC | LYD_OPT_NOTIF)) {
-            result = lyd_parse_xml(ctx, &xml, options, data_tree);
-        } else if (options & LYD_OPT_DATA_TEMPLATE) {
-            result = lyd_parse_xml(ctx, &xml, options, yang_data_name);
-        } else {
-            result = lyd_parse_xml(ctx, &xml, options);
-        }
-        lyxml_free_withsiblings(ctx, xml);
+        result = xml_read_data(ctx, data, options, rpc_act, data_tree, yang_data_name, projection);
         break;
     case LYD_JSON:
-        result = lyd_parse_json(ctx, data, options, rpc_act, data_tree, yang_data_name);
+        parsed = strlen(data);
+        if (ly_parse_charge(ctx, 0, parsed)) {
+            break;
+        }
+        result = lyd_parse_json(ctx, data, options, rpc_act, data_tree, yang_data_name, projection);
         break;
     case LYD_LYB:
-        result = lyd_parse_lyb(ctx, data, options, data_tree, yang_data_name, NULL);
+        if (projection) {
+            LOGERR(ctx, LY_EINVAL, "%s: invalid parameter (LYD_OPT_PROJECTION with LYB data).", __func__);
+            break;
+        }
+        result = lyd_parse_lyb(ctx, data, options, data_tree, yang_data_name, &parsed);
         break;
     default:
         /* error */
         break;
     }
+    ly_parse_budget_stop();
+    if (parsed > 0) {
+        LY_STATS_ADD(ctx, parse_bytes, (uint64_t)parsed);
+    }
+    LY_TRACE(parse_done, ctx, format, parsed, result, ly_errno);
 
     if (ly_errno) {
         lyd_free_withsiblings(result);
@@ -978,6 +1488,7 @@ lyd_parse_data_(struct ly_ctx *ctx, const char *data, LYD_FORMAT format, int opt
 {
     const struct lyd_node *rpc_act = NULL, *data_tree = NULL, *iter;
     const char *yang_data_name = NULL;
+    const struct ly_set *projection = NULL;
 
     if (lyp_data_check_options(ctx, options, __func__)) {
         return NULL;
@@ -1020,8 +1531,11 @@ lyd_parse_data_(struct ly_ctx *ctx, const char *data, LYD_FORMAT format, int opt
     if (options & LYD_OPT_DATA_TEMPLATE) {
         yang_data_name = va_arg(ap, const char *);
     }
+    if (options & LYD_OPT_PROJECTION) {
+        projection = va_arg(ap, const struct ly_set *);
+    }
 
-    return lyd_parse_(ctx, rpc_act, data, format, options, data_tree, yang_data_name);
+    return lyd_parse_(ctx, rpc_act, data, format, options, data_tree, yang_data_name, projection);
 }
 
 API struct lyd_node *
@@ -1103,452 +1617,727 @@ lyd_parse_path(struct ly_ctx *ctx, const char *path, LYD_FORMAT format, int opti
     return ret;
 }
 
-static struct lys_node *
-lyd_new_find_schema(struct lyd_node *parent, const struct lys_module *module, int rpc_output)
+struct lyd_batch_thread {
+    struct ly_ctx *ctx;
+    struct lyd_batch_item *items;
+    unsigned int count;
+    atomic_uint next;                /* next item to parse, shared by all the threads */
+    LYD_FORMAT format;
+    int options;
+    enum int_log_opts log_opt;       /* internal logging options of the calling thread */
+};
+
+static void *
+lyd_parse_batch_thread(void *arg)
 {
-    struct lys_node *siblings;
+    struct lyd_batch_thread *bt = (struct lyd_batch_thread *)arg;
+    struct lyd_batch_item *item;
+    struct ly_err_item *eitem;
+    unsigned int i;
 
-    if (!parent) {
-        siblings = module->data;
-    } else {
-        if (!parent->schema) {
-            return NULL;
-        }
-        siblings = parent->schema->child;
-        if (siblings && (siblings->nodetype == (rpc_output ? LYS_INPUT : LYS_OUTPUT))) {
-            siblings = siblings->next;
-        }
-        if (siblings && (siblings->nodetype == (rpc_output ? LYS_OUTPUT : LYS_INPUT))) {
-            siblings = siblings->child;
+    log_opt = bt->log_opt;
+    while ((i = atomic_fetch_add_explicit(&bt->next, 1, memory_order_relaxed)) < bt->count) {
+        item = &bt->items[i];
+        item->tree = lyd_parse_(bt->ctx, NULL, item->data, bt->format, bt->options, NULL, NULL, NULL);
+        item->err = ly_errno;
+        if (item->err && (eitem = ly_err_first(bt->ctx))) {
+            /* the last error describes the failure */
+            eitem = eitem->prev;
+            item->vecode = eitem->vecode;
+            item->errmsg = eitem->msg ? strdup(eitem->msg) : NULL;
+            item->errpath = eitem->path ? strdup(eitem->path) : NULL;
         }
+        ly_err_clean(bt->ctx, NULL);
     }
 
-    return siblings;
+    return NULL;
 }
 
-struct lyd_node *
-_lyd_new(struct lyd_node *parent, const struct lys_node *schema, int dflt)
+API int
+lyd_parse_batch(struct ly_ctx *ctx, struct lyd_batch_item *items, unsigned int count, LYD_FORMAT format,
+                int options, unsigned int threads)
 {
-    struct lyd_node *ret;
+    struct lyd_batch_thread bt;
+    struct ly_err_item *prev_err;
+    pthread_t *tids = NULL;
+    unsigned int i;
 
-    ret = calloc(1, sizeof *ret);
-    LY_CHECK_ERR_RETURN(!ret, LOGMEM(schema->module->ctx), NULL);
+    if (!ctx || (!items && count)) {
+        LOGARG;
+        return EXIT_FAILURE;
+    }
 
-    ret->schema = (struct lys_node *)schema;
-    ret->validity = ly_new_node_validity(schema);
-    if (resolve_applies_when(schema, 0, NULL)) {
-        ret->when_status = LYD_WHEN;
+    if (lyp_data_check_options(ctx, options, __func__)) {
+        return EXIT_FAILURE;
+    }
+    if (options & (LYD_OPT_RPCREPLY | LYD_OPT_DATA_TEMPLATE | LYD_OPT_PROJECTION)) {
+        LOGERR(ctx, LY_EINVAL, "%s: invalid options 0x%x (variable arguments not supported).", __func__, options);
+        return EXIT_FAILURE;
     }
-    ret->prev = ret;
-    ret->dflt = dflt;
 
-#ifdef LY_ENABLED_CACHE
-    lyd_hash(ret);
-#endif
+    for (i = 0; i < count; ++i) {
+        items[i].tree = NULL;
+        items[i].err = LY_SUCCESS;
+        items[i].vecode = LYVE_SUCCESS;
+        items[i].errmsg = NULL;
+        items[i].errpath = NULL;
+    }
 
-    if (parent) {
-        if (lyd_insert(parent, ret)) {
-            lyd_free(ret);
-            return NULL;
+    bt.ctx = ctx;
+    bt.items = items;
+    bt.count = count;
+    atomic_init(&bt.next, 0);
+    bt.format = format;
+    bt.options = options;
+    bt.log_opt = log_opt;
+
+    if (threads > count) {
+        threads = count;
+    }
+    if (threads > 1) {
+        /* build the schema caches now so that the threads only read the schemas */
+        if (ly_ctx_precompile(ctx)) {
+            return EXIT_FAILURE;
         }
+
+        tids = malloc((threads - 1) * sizeof *tids);
+        LY_CHECK_ERR_RETURN(!tids, LOGMEM(ctx), EXIT_FAILURE);
     }
-    return ret;
+
+    /* keep the errors of the calling thread out of the way */
+    prev_err = ly_err_detach(ctx);
+
+    /* the calling thread parses too, threads that could not be created are simply missing */
+    for (i = 0; i + 1 < threads; ++i) {
+        if (pthread_create(&tids[i], NULL, lyd_parse_batch_thread, &bt)) {
+            break;
+        }
+    }
+    lyd_parse_batch_thread(&bt);
+    while (i) {
+        pthread_join(tids[--i], NULL);
+    }
+    free(tids);
+
+    ly_err_append(ctx, prev_err);
+    ly_errno = LY_SUCCESS;
+    for (i = 0; i < count; ++i) {
+        if (items[i].err) {
+            ly_errno = items[i].err;
+            return EXIT_FAILURE;
+        }
+    }
+    return EXIT_SUCCESS;
 }
 
-API struct lyd_node *
-lyd_new(struct lyd_node *parent, const struct lys_module *module, const char *name)
+API struct lyd_parser *
+lyd_parser_new(struct ly_ctx *ctx, LYD_FORMAT format, int options)
 {
-    const struct lys_node *snode = NULL, *siblings;
+    struct lyd_parser *parser;
 
-    if ((!parent && !module) || !name) {
+    if (!ctx || ((format != LYD_XML) && (format != LYD_JSON))) {
         LOGARG;
         return NULL;
     }
 
-    siblings = lyd_new_find_schema(parent, module, 0);
-    if (!siblings) {
-        LOGARG;
+    if (lyp_data_check_options(ctx, options, __func__)) {
         return NULL;
     }
-
-    if (lys_getnext_data(module, lys_parent(siblings), name, strlen(name), LYS_CONTAINER | LYS_LIST | LYS_NOTIF
-                         | LYS_RPC | LYS_ACTION, &snode) || !snode) {
-        LOGERR(siblings->module->ctx, LY_EINVAL, "Failed to find \"%s\" as a sibling to \"%s:%s\".",
-               name, lys_node_module(siblings)->name, siblings->name);
+    if (options & (LYD_OPT_RPC | LYD_OPT_RPCREPLY | LYD_OPT_NOTIF | LYD_OPT_DATA_TEMPLATE | LYD_OPT_NOSIBLINGS
+            | LYD_OPT_DESTRUCT)) {
+        LOGERR(ctx, LY_EINVAL, "%s: invalid options (only data trees can be parsed incrementally).", __func__);
+        return NULL;
+    }
+    if (options & LYD_OPT_PROJECTION) {
+        LOGERR(ctx, LY_EINVAL, "%s: invalid option (LYD_OPT_PROJECTION is not supported incrementally).", __func__);
         return NULL;
     }
 
-    return _lyd_new(parent, snode, 0);
-}
-
-static struct lyd_node *
-lyd_create_leaf(const struct lys_node *schema, const char *val_str, int dflt)
-{
-    struct lyd_node_leaf_list *ret;
-
-    ret = calloc(1, sizeof *ret);
-    LY_CHECK_ERR_RETURN(!ret, LOGMEM(schema->module->ctx), NULL);
+    parser = calloc(1, sizeof *parser);
+    LY_CHECK_ERR_RETURN(!parser, LOGMEM(ctx), NULL);
+    parser->ctx = ctx;
+    parser->format = format;
+    parser->options = options;
 
-    ret->schema = (struct lys_node *)schema;
-    ret->validity = ly_new_node_validity(schema);
-    if (resolve_applies_when(schema, 0, NULL)) {
-        ret->when_status = LYD_WHEN;
-    }
-    ret->prev = (struct lyd_node *)ret;
-    ret->value_type = ((struct lys_node_leaf *)schema)->type.base;
-    ret->value_str = lydict_insert(schema->module->ctx, val_str ? val_str : "", 0);
-    ret->dflt = dflt;
+    parser->size = 1024;
+    parser->buf = malloc(parser->size);
+    parser->unres = calloc(1, sizeof *parser->unres);
+    LY_CHECK_ERR_GOTO(!parser->buf || !parser->unres, LOGMEM(ctx), error);
+    parser->buf[0] = '\0';
 
-#ifdef LY_ENABLED_CACHE
-    lyd_hash((struct lyd_node *)ret);
-#endif
+    return parser;
 
-    return (struct lyd_node *)ret;
+error:
+    lyd_parser_free(parser);
+    return NULL;
 }
 
-static struct lyd_node *
-_lyd_new_leaf(struct lyd_node *parent, const struct lys_node *schema, const char *val_str, int dflt, int edit_leaf)
+API int
+lyd_parser_push(struct lyd_parser *parser, const char *data, size_t len)
 {
-    struct lyd_node *ret;
+    char *buf;
+    int r;
 
-    ret = lyd_create_leaf(schema, val_str, dflt);
-    if (!ret) {
-        return NULL;
+    if (!parser || (!data && len)) {
+        LOGARG;
+        return EXIT_FAILURE;
+    } else if (parser->failed) {
+        LOGERR(parser->ctx, LY_EINVAL, "%s: the parser has already failed.", __func__);
+        return EXIT_FAILURE;
     }
 
-    /* connect to parent */
-    if (parent) {
-        if (lyd_insert(parent, ret)) {
-            lyd_free(ret);
-            return NULL;
+    /* append the chunk, the input is kept zero-terminated */
+    if (parser->used + len + 1 > parser->size) {
+        while (parser->used + len + 1 > parser->size) {
+            parser->size *= 2;
         }
+        buf = ly_realloc(parser->buf, parser->size);
+        LY_CHECK_ERR_RETURN(!buf, LOGMEM(parser->ctx); parser->buf = NULL; parser->failed = 1, EXIT_FAILURE);
+        parser->buf = buf;
     }
+    memcpy(&parser->buf[parser->used], data, len);
+    parser->used += len;
+    parser->buf[parser->used] = '\0';
 
-    if (edit_leaf && !((struct lyd_node_leaf_list *)ret)->value_str[0]) {
-        /* empty edit leaf, it is fine */
-        ((struct lyd_node_leaf_list *)ret)->value_type = LY_TYPE_UNKNOWN;
-        return ret;
+    ly_errno = LY_SUCCESS;
+    if (parser->format == LYD_XML) {
+        r = xml_parser_push(parser);
+    } else {
+        r = json_parser_push(parser);
     }
-
-    /* resolve the type correctly (after it was connected to parent cause of log) */
-    if (!lyp_parse_value(&((struct lys_node_leaf *)ret->schema)->type, &((struct lyd_node_leaf_list *)ret)->value_str,
-                         NULL, (struct lyd_node_leaf_list *)ret, NULL, NULL, 1, dflt, 0)) {
-        lyd_free(ret);
-        return NULL;
+    if (r) {
+        parser->failed = 1;
+        return EXIT_FAILURE;
     }
 
-    if ((ret->schema->nodetype == LYS_LEAF) && (ret->schema->flags & LYS_UNIQUE)) {
-        for (; parent && (parent->schema->nodetype != LYS_LIST); parent = parent->parent);
-        if (parent) {
-            parent->validity |= LYD_VAL_UNIQUE;
-        } else {
-            LOGINT(schema->module->ctx);
-        }
+    /* drop the input of the already parsed subtrees */
+    if (parser->start) {
+        memmove(parser->buf, &parser->buf[parser->start], parser->used - parser->start + 1);
+        parser->used -= parser->start;
+        parser->scanned -= parser->start;
+        parser->start = 0;
     }
 
-    return ret;
+    return EXIT_SUCCESS;
 }
 
 API struct lyd_node *
-lyd_new_leaf(struct lyd_node *parent, const struct lys_module *module, const char *name, const char *val_str)
+lyd_parser_finish(struct lyd_parser *parser)
 {
-    const struct lys_node *snode = NULL, *siblings;
+    struct lyd_node *result = NULL;
 
-    if ((!parent && !module) || !name) {
+    if (!parser) {
         LOGARG;
         return NULL;
     }
 
-    siblings = lyd_new_find_schema(parent, module, 0);
-    if (!siblings) {
-        LOGARG;
-        return NULL;
+    ly_errno = LY_SUCCESS;
+    if (parser->failed) {
+        LOGERR(parser->ctx, LY_EINVAL, "%s: the parser has already failed.", __func__);
+    } else if (parser->format == LYD_XML) {
+        result = xml_parser_finish(parser);
+    } else {
+        result = json_parser_finish(parser);
     }
+    lyd_parser_free(parser);
 
-    if (lys_getnext_data(module, lys_parent(siblings), name, strlen(name), LYS_LEAFLIST | LYS_LEAF, &snode) || !snode) {
-        LOGERR(siblings->module->ctx, LY_EINVAL, "Failed to find \"%s\" as a sibling to \"%s:%s\".",
-               name, lys_node_module(siblings)->name, siblings->name);
+    if (ly_errno) {
+        lyd_free_withsiblings(result);
         return NULL;
     }
+    return result;
+}
 
-    return _lyd_new_leaf(parent, snode, val_str, 0, 0);
+API void
+lyd_parser_free(struct lyd_parser *parser)
+{
+    if (!parser) {
+        return;
+    }
+
+    if (parser->format == LYD_JSON) {
+        json_parser_clean(parser);
+    }
+    lyd_free_withsiblings(parser->result);
+    if (parser->unres) {
+        free(parser->unres->node);
+        free(parser->unres->type);
+        free(parser->unres);
+    }
+    free(parser->buf);
+    free(parser);
 }
 
-/**
- * @brief Update (add) default flag of the parents of the added node.
- *
- * @param[in] node Added node
- */
-static void
-lyd_wd_update_parents(struct lyd_node *node)
+static struct lys_node *
+lyd_new_find_schema(struct lyd_node *parent, const struct lys_module *module, int rpc_output)
 {
-    struct lyd_node *parent = node->parent, *iter;
+    struct lys_node *siblings;
 
-    for (parent = node->parent; parent; parent = node->parent) {
-        if (parent->dflt || parent->schema->nodetype != LYS_CONTAINER ||
-                ((struct lys_node_container *)parent->schema)->presence) {
-            /* parent is already default and there is nothing to update or
-             * it is not a non-presence container -> stop the loop */
-            break;
+    if (!parent) {
+        siblings = module->data;
+    } else {
+        if (!parent->schema) {
+            return NULL;
         }
-        /* check that there is still some non default sibling */
-        for (iter = node->prev; iter != node; iter = iter->prev) {
-            if (!iter->dflt) {
-                break;
-            }
+        siblings = parent->schema->child;
+        if (siblings && (siblings->nodetype == (rpc_output ? LYS_INPUT : LYS_OUTPUT))) {
+            siblings = siblings->next;
         }
-        if (iter == node && node->prev != node) {
-            /* all siblings are implicit default nodes, propagate it to the parent */
-            node = node->parent;
-            node->dflt = 1;
-            continue;
-        } else {
-            /* stop the loop */
-            break;
+        if (siblings && (siblings->nodetype == (rpc_output ? LYS_OUTPUT : LYS_INPUT))) {
+            siblings = siblings->child;
         }
     }
+
+    return siblings;
 }
 
-/* op - 0 add, 1 del, 2 mod (add + del) */
-static void
-check_leaf_list_backlinks(struct lyd_node *node, int op)
+#define LYD_ARENA_BLOCK_SIZE 16384
+#define LYD_ARENA_ALIGN (2 * sizeof(void *))
+
+struct lyd_arena_block {
+    struct lyd_arena_block *next;
+    size_t size;                     /* usable size of the block */
+    size_t used;
+    unsigned char mem[];
+};
+
+struct lyd_arena {
+    struct lyd_arena_block *blocks;  /* all the blocks */
+    struct lyd_arena_block *cur;     /* block currently allocated from */
+    size_t block_size;
+};
+
+/* arena active in the thread */
+static THREAD_LOCAL struct lyd_arena *lyd_arena_cur;
+
+API struct lyd_arena *
+lyd_arena_new(size_t block_size)
 {
-    struct lyd_node *next, *iter;
-    struct lyd_node_leaf_list *leaf_list;
-    struct ly_set *set, *data;
-    uint32_t i, j;
-    int validity_changed = 0;
+    struct lyd_arena *arena;
 
-    assert((op == 0) || (op == 1) || (op == 2));
+    arena = calloc(1, sizeof *arena);
+    LY_CHECK_ERR_RETURN(!arena, LOGMEM(NULL), NULL);
+    arena->block_size = block_size ? block_size : LYD_ARENA_BLOCK_SIZE;
 
-    /* fix leafrefs */
-    LY_TREE_DFS_BEGIN(node, next, iter) {
-        /* the node is target of a leafref */
-        if ((iter->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST)) && iter->schema->child) {
-            set = (struct ly_set *)iter->schema->child;
-            for (i = 0; i < set->number; i++) {
-                data = lyd_find_instance(iter, set->set.s[i]);
-                if (data) {
-                    for (j = 0; j < data->number; j++) {
-                        leaf_list = (struct lyd_node_leaf_list *)data->set.d[j];
-                        if (((op != 0) && (leaf_list->value_type == LY_TYPE_LEAFREF) && (leaf_list->value.leafref == iter))
-                                || ((op != 1) && (leaf_list->value_flags & LY_VALUE_UNRES))) {
-                            /* invalidate the leafref, a change concerning it happened */
-                            leaf_list->validity |= LYD_VAL_LEAFREF;
-                            validity_changed = 1;
-                            if (leaf_list->value_type == LY_TYPE_LEAFREF) {
-                                /* remove invalid link and put unresolved value back */
-                                lyp_parse_value(&((struct lys_node_leaf *)leaf_list->schema)->type, &leaf_list->value_str,
-                                                NULL, leaf_list, NULL, NULL, 1, leaf_list->dflt, 0);
-                            }
-                        }
-                    }
-                    ly_set_free(data);
-                } else {
-                    LOGINT(node->schema->module->ctx);
-                    return;
-                }
-            }
-        }
-        LY_TREE_DFS_END(node, next, iter)
-    }
+    return arena;
+}
 
-    /* invalidate parent to make sure it will be checked in future validation */
-    if (validity_changed && node->parent) {
-        node->parent->validity |= LYD_VAL_MAND;
-    }
+API struct lyd_arena *
+lyd_arena_use(struct lyd_arena *arena)
+{
+    struct lyd_arena *prev;
+
+    prev = lyd_arena_cur;
+    lyd_arena_cur = arena;
+    return prev;
 }
 
-API int
-lyd_change_leaf(struct lyd_node_leaf_list *leaf, const char *val_str)
+API void
+lyd_arena_reset(struct lyd_arena *arena)
 {
-    const char *backup;
-    int val_change, dflt_change;
-    struct lyd_node *parent;
+    struct lyd_arena_block *block;
 
-    if (!leaf || (leaf->schema->nodetype != LYS_LEAF)) {
-        LOGARG;
-        return -1;
+    if (!arena) {
+        return;
     }
 
-    backup = leaf->value_str;
-    leaf->value_str = lydict_insert(leaf->schema->module->ctx, val_str ? val_str : "", 0);
-    /* leaf->value is erased by lyp_parse_value() */
+    for (block = arena->blocks; block; block = block->next) {
+        block->used = 0;
+    }
+    arena->cur = arena->blocks;
+}
 
-    /* parse the type correctly, makes the value canonical if needed */
-    if (!lyp_parse_value(&((struct lys_node_leaf *)leaf->schema)->type, &leaf->value_str, NULL, leaf, NULL, NULL, 1, 0, 0)) {
-        lydict_remove(leaf->schema->module->ctx, backup);
-        return -1;
+API void
+lyd_arena_free(struct lyd_arena *arena)
+{
+    struct lyd_arena_block *block;
+
+    if (!arena) {
+        return;
     }
 
-    if (!strcmp(backup, leaf->value_str)) {
-        /* the value remains the same */
-        val_change = 0;
-    } else {
-        val_change = 1;
+    while (arena->blocks) {
+        block = arena->blocks;
+        arena->blocks = block->next;
+        free(block);
     }
+    free(arena);
+}
 
-    /* value is correct, remove backup */
-    lydict_remove(leaf->schema->module->ctx, backup);
+static void *
+lyd_arena_alloc(struct lyd_arena *arena, size_t size)
+{
+    struct lyd_arena_block *block;
+    void *ret;
 
-    /* clear the default flag, the value is different */
-    if (leaf->dflt) {
-        for (parent = (struct lyd_node *)leaf; parent; parent = parent->parent) {
-            parent->dflt = 0;
+    size = (size + LYD_ARENA_ALIGN - 1) & ~(LYD_ARENA_ALIGN - 1);
+
+    block = arena->cur;
+    if (block && (block->size - block->used < size)) {
+        /* reuse the following (reset) block, if it is big enough */
+        block = block->next;
+        if (block && (block->size < size)) {
+            block = NULL;
         }
-        dflt_change = 1;
-    } else {
-        dflt_change = 0;
     }
 
-    if (val_change) {
-        /* make the node non-validated */
-        leaf->validity = ly_new_node_validity(leaf->schema);
+    if (!block) {
+        block = malloc(sizeof *block + (size > arena->block_size ? size : arena->block_size));
+        LY_CHECK_ERR_RETURN(!block, LOGMEM(NULL), NULL);
+        block->size = (size > arena->block_size ? size : arena->block_size);
+        block->used = 0;
 
-        /* check possible leafref backlinks */
-        check_leaf_list_backlinks((struct lyd_node *)leaf, 2);
+        /* insert it after the current block */
+        if (arena->cur) {
+            block->next = arena->cur->next;
+            arena->cur->next = block;
+        } else {
+            block->next = arena->blocks;
+            arena->blocks = block;
+        }
     }
+    arena->cur = block;
 
-    if (val_change && (leaf->schema->flags & LYS_UNIQUE)) {
-        for (parent = leaf->parent; parent && (parent->schema->nodetype != LYS_LIST); parent = parent->parent);
-        if (parent) {
-            parent->validity |= LYD_VAL_UNIQUE;
-        } else {
-            LOGINT(leaf->schema->module->ctx);
-            return -1;
+    ret = &block->mem[block->used];
+    block->used += size;
+    memset(ret, 0, size);
+    return ret;
+}
+
+/* node structures of every size cached by a thread */
+#define LYD_CACHE_THREAD_MAX 256
+
+/* node structures moved between a thread and the shared pool at once */
+#define LYD_CACHE_BATCH 128
+
+/* maximum of the node structures of every size in the shared pool */
+#define LYD_CACHE_POOL_MAX (64 * LYD_CACHE_BATCH)
+
+/* sizes of the cached node structures */
+enum lyd_cache_class {
+    LYD_CACHE_NODE = 0,
+    LYD_CACHE_LEAF,
+    LYD_CACHE_ANY,
+    LYD_CACHE_CLASSES
+};
+
+static const size_t lyd_cache_size[LYD_CACHE_CLASSES] = {
+    sizeof(struct lyd_node), sizeof(struct lyd_node_leaf_list), sizeof(struct lyd_node_anydata)
+};
+
+/* a free node structure, the first one of a batch also links the batches */
+struct lyd_cache_free {
+    struct lyd_cache_free *next;
+    struct lyd_cache_free *next_batch;
+    uint32_t count;                      /* node structures in the batch */
+};
+
+/* free node structures of the thread */
+static THREAD_LOCAL struct {
+    struct lyd_cache_free *list[LYD_CACHE_CLASSES];
+    uint32_t count[LYD_CACHE_CLASSES];
+    int registered;                      /* the thread returns the structures to the pool on exit */
+} lyd_cache;
+
+/* batches of free node structures shared by all the threads */
+static struct {
+    pthread_mutex_t lock;
+    pthread_once_t once;
+    pthread_key_t key;
+    struct lyd_cache_free *batches[LYD_CACHE_CLASSES];
+    atomic_uint_least32_t count[LYD_CACHE_CLASSES];  /* also read without the lock */
+} lyd_cache_pool = {.lock = PTHREAD_MUTEX_INITIALIZER, .once = PTHREAD_ONCE_INIT};
+
+static void
+lyd_cache_free_list(struct lyd_cache_free *list)
+{
+    struct lyd_cache_free *next;
+
+    for (; list; list = next) {
+        next = list->next;
+        free(list);
+    }
+}
+
+/* move a batch of structures to the pool, they are freed if it is full */
+static void
+lyd_cache_put_batch(enum lyd_cache_class class, struct lyd_cache_free *batch, uint32_t count)
+{
+    pthread_mutex_lock(&lyd_cache_pool.lock);
+    if (lyd_cache_pool.count[class] + count <= LYD_CACHE_POOL_MAX) {
+        batch->count = count;
+        batch->next_batch = lyd_cache_pool.batches[class];
+        lyd_cache_pool.batches[class] = batch;
+        lyd_cache_pool.count[class] += count;
+        batch = NULL;
+    }
+    pthread_mutex_unlock(&lyd_cache_pool.lock);
+
+    lyd_cache_free_list(batch);
+}
+
+/* thread exit */
+static void
+lyd_cache_thread_flush(void *UNUSED(arg))
+{
+    int i;
+
+    for (i = 0; i < LYD_CACHE_CLASSES; ++i) {
+        if (lyd_cache.list[i]) {
+            lyd_cache_put_batch(i, lyd_cache.list[i], lyd_cache.count[i]);
+            lyd_cache.list[i] = NULL;
+            lyd_cache.count[i] = 0;
         }
     }
+    lyd_cache.registered = 0;
+}
 
-    return (val_change || dflt_change ? 0 : 1);
+static void
+lyd_cache_key_create(void)
+{
+    if (pthread_key_create(&lyd_cache_pool.key, lyd_cache_thread_flush)) {
+        /* without the key, the structures are never cached by threads */
+        lyd_cache_pool.key = (pthread_key_t)-1;
+    }
+}
+
+static void __attribute__((destructor))
+lyd_cache_destroy(void)
+{
+    int i;
+
+    for (i = 0; i < LYD_CACHE_CLASSES; ++i) {
+        lyd_cache_free_list(lyd_cache.list[i]);
+        lyd_cache.list[i] = NULL;
+        lyd_cache.count[i] = 0;
+        while (lyd_cache_pool.batches[i]) {
+            lyd_cache.list[i] = lyd_cache_pool.batches[i];
+            lyd_cache_pool.batches[i] = lyd_cache.list[i]->next_batch;
+            lyd_cache_free_list(lyd_cache.list[i]);
+        }
+        lyd_cache.list[i] = NULL;
+        lyd_cache_pool.count[i] = 0;
+    }
+}
+
+static int
+lyd_cache_class(size_t size)
+{
+    int i;
+
+    for (i = 0; i < LYD_CACHE_CLASSES; ++i) {
+        if (lyd_cache_size[i] == size) {
+            return i;
+        }
+    }
+    return -1;
 }
 
+/* zeroed node structure, from the thread cache, from the pool, or a new one */
 static struct lyd_node *
-lyd_create_anydata(struct lyd_node *parent, const struct lys_node *schema, void *value,
-                   LYD_ANYDATA_VALUETYPE value_type)
+lyd_cache_alloc(size_t size)
 {
-    struct lyd_node *iter;
-    struct lyd_node_anydata *ret;
-    int len;
+    struct lyd_cache_free *item;
+    int class;
 
-    ret = calloc(1, sizeof *ret);
-    LY_CHECK_ERR_RETURN(!ret, LOGMEM(schema->module->ctx), NULL);
+    class = lyd_cache_class(size);
+    if (class == -1) {
+        return calloc(1, size);
+    }
 
-    ret->schema = (struct lys_node *)schema;
-    ret->validity = ly_new_node_validity(schema);
-    if (resolve_applies_when(schema, 0, NULL)) {
-        ret->when_status = LYD_WHEN;
+    if (!lyd_cache.list[class] && atomic_load_explicit(&lyd_cache_pool.count[class], memory_order_relaxed)) {
+        pthread_mutex_lock(&lyd_cache_pool.lock);
+        item = lyd_cache_pool.batches[class];
+        if (item) {
+            lyd_cache_pool.batches[class] = item->next_batch;
+            lyd_cache_pool.count[class] -= item->count;
+            lyd_cache.list[class] = item;
+            lyd_cache.count[class] = item->count;
+        }
+        pthread_mutex_unlock(&lyd_cache_pool.lock);
     }
-    ret->prev = (struct lyd_node *)ret;
 
-    /* set the value */
-    switch (value_type) {
-    case LYD_ANYDATA_CONSTSTRING:
-    case LYD_ANYDATA_SXML:
-    case LYD_ANYDATA_JSON:
-        ret->value.str = lydict_insert(schema->module->ctx, (const char *)value, 0);
-        break;
-    case LYD_ANYDATA_STRING:
-    case LYD_ANYDATA_SXMLD:
-    case LYD_ANYDATA_JSOND:
-        ret->value.str = lydict_insert_zc(schema->module->ctx, (char *)value);
-        value_type &= ~LYD_ANYDATA_STRING; /* make const string from string */
+    item = lyd_cache.list[class];
+    if (!item) {
+        return calloc(1, size);
+    }
+    lyd_cache.list[class] = item->next;
+    --lyd_cache.count[class];
+
+    memset(item, 0, size);
+    return (struct lyd_node *)item;
+}
+
+static void
+lyd_cache_dealloc(struct lyd_node *node)
+{
+    struct lyd_cache_free *item, *batch;
+    int class;
+    uint32_t i;
+
+    switch (node->schema ? node->schema->nodetype : LYS_UNKNOWN) {
+    case LYS_LEAF:
+    case LYS_LEAFLIST:
+        class = LYD_CACHE_LEAF;
         break;
-    case LYD_ANYDATA_DATATREE:
-        ret->value.tree = (struct lyd_node *)value;
+    case LYS_ANYXML:
+    case LYS_ANYDATA:
+        class = LYD_CACHE_ANY;
         break;
-    case LYD_ANYDATA_XML:
-        ret->value.xml = (struct lyxml_elem *)value;
+    case LYS_UNKNOWN:
+        free(node);
+        return;
+    default:
+        class = LYD_CACHE_NODE;
         break;
-    case LYD_ANYDATA_LYB:
-        len = lyd_lyb_data_length(value);
-        if (len == -1) {
-            LOGERR(schema->module->ctx, LY_EINVAL, "Invalid LYB data.");
-            return NULL;
+    }
+
+    if (!lyd_cache.registered) {
+        pthread_once(&lyd_cache_pool.once, lyd_cache_key_create);
+        if ((lyd_cache_pool.key == (pthread_key_t)-1) || pthread_setspecific(lyd_cache_pool.key, &lyd_cache)) {
+            free(node);
+            return;
         }
-        ret->value.mem = malloc(len);
-        LY_CHECK_ERR_RETURN(!ret->value.mem, LOGMEM(schema->module->ctx); free(ret), NULL);
-        memcpy(ret->value.mem, value, len);
-        break;
-    case LYD_ANYDATA_LYBD:
-        ret->value.mem = value;
-        value_type &= ~LYD_ANYDATA_STRING; /* make const string from string */
-        break;
+        lyd_cache.registered = 1;
     }
-    ret->value_type = value_type;
 
-#ifdef LY_ENABLED_CACHE
-    lyd_hash((struct lyd_node *)ret);
-#endif
+    item = (struct lyd_cache_free *)node;
+    item->next = lyd_cache.list[class];
+    lyd_cache.list[class] = item;
+    if (++lyd_cache.count[class] < LYD_CACHE_THREAD_MAX) {
+        return;
+    }
 
-    /* connect to parent */
-    if (parent) {
-        if (lyd_insert(parent, (struct lyd_node*)ret)) {
-            lyd_free((struct lyd_node*)ret);
-            return NULL;
-        }
+    /* return the structures freed first to the pool, keep the ones likely still in the CPU cache */
+    for (item = lyd_cache.list[class], i = 1; i < LYD_CACHE_THREAD_MAX - LYD_CACHE_BATCH; ++i) {
+        item = item->next;
+    }
+    batch = item->next;
+    item->next = NULL;
+    lyd_cache.count[class] -= LYD_CACHE_BATCH;
+    lyd_cache_put_batch(class, batch, LYD_CACHE_BATCH);
+}
 
-        /* remove the flag from parents */
-        for (iter = parent; iter && iter->dflt; iter = iter->parent) {
-            iter->dflt = 0;
+struct lyd_node *
+lyd_node_alloc(struct ly_ctx *ctx, size_t size)
+{
+    struct lyd_node *node;
+
+    if (lyd_arena_cur) {
+        node = lyd_arena_alloc(lyd_arena_cur, size);
+        if (node) {
+            node->arena = 1;
         }
+    } else if (ctx->data_alloc) {
+        node = ctx->data_alloc(size, ctx->data_alloc_data);
+        if (node) {
+            memset(node, 0, size);
+            node->ext_alloc = 1;
+        }
+    } else {
+        node = lyd_cache_alloc(size);
+    }
+    if (node) {
+        LY_STATS_ADD(ctx, nodes_created, 1);
     }
 
-    return (struct lyd_node*)ret;
+    return node;
 }
 
-API struct lyd_node *
-lyd_new_anydata(struct lyd_node *parent, const struct lys_module *module, const char *name,
-                void *value, LYD_ANYDATA_VALUETYPE value_type)
+void
+lyd_node_dealloc(struct lyd_node *node)
 {
-    const struct lys_node *siblings, *snode;
+    struct ly_ctx *ctx;
 
-    if ((!parent && !module) || !name) {
-        LOGARG;
-        return NULL;
+    if (!node) {
+        return;
+    }
+    if (node->schema) {
+        LY_STATS_ADD(node->schema->module->ctx, nodes_freed, 1);
+    }
+    if (node->arena) {
+        return;
     }
 
-    siblings = lyd_new_find_schema(parent, module, 0);
-    if (!siblings) {
-        LOGARG;
-        return NULL;
+    if (node->ext_alloc) {
+        ctx = node->schema->module->ctx;
+        ctx->data_free(node, ctx->data_alloc_data);
+    } else {
+        lyd_cache_dealloc(node);
     }
+}
 
-    if (lys_getnext_data(module, lys_parent(siblings), name, strlen(name), LYS_ANYDATA, &snode) || !snode) {
-        LOGERR(siblings->module->ctx, LY_EINVAL, "Failed to find \"%s\" as a sibling to \"%s:%s\".",
-               name, lys_node_module(siblings)->name, siblings->name);
-        return NULL;
+void
+lyd_gen_bump(struct ly_ctx *ctx)
+{
+    if (lyd_gen_frozen) {
+        return;
     }
 
-    return lyd_create_anydata(parent, snode, value, value_type);
+    /* 64 bits never wrap */
+    atomic_fetch_add_explicit(&ctx->data_gen, 1, memory_order_relaxed);
 }
 
-API struct lyd_node *
-lyd_new_yangdata(const struct lys_module *module, const char *name_template, const char *name)
+uint64_t
+lyd_gen_get(struct ly_ctx *ctx)
 {
-    const struct lys_node *schema = NULL, *snode;
+    return atomic_load_explicit(&ctx->data_gen, memory_order_relaxed);
+}
 
-    if (!module || !name_template || !name) {
-        LOGARG;
-        return NULL;
-    }
+void
+lyd_gen_stamp(struct lyd_node_leaf_list *leaf)
+{
+    uint64_t gen;
 
-    schema = lyp_get_yang_data_template(module, name_template, strlen(name_template));
-    if (!schema) {
-        LOGERR(module->ctx, LY_EINVAL, "Failed to find yang-data template \"%s\".", name_template);
-        return NULL;
+    gen = lyd_gen_get(leaf->schema->module->ctx);
+    if (gen > LYD_REF_GEN_MAX) {
+        /* cannot be stored, 0 means no generation */
+        gen = 0;
     }
+    leaf->ref_gen = gen & 0xffffff;
+    leaf->ref_gen_hi = gen >> 24;
+}
 
-    if (lys_getnext_data(module, schema, name, strlen(name), LYS_CONTAINER, &snode) || !snode) {
-        LOGERR(module->ctx, LY_EINVAL, "Failed to find \"%s\" as a container child of \"%s:%s\".",
-               name, module->name, schema->name);
-        return NULL;
+int
+lyd_gen_stamp_current(const struct lyd_node_leaf_list *leaf)
+{
+    uint64_t gen;
+
+    gen = ((uint64_t)leaf->ref_gen_hi << 24) | leaf->ref_gen;
+    return gen && (gen == lyd_gen_get(leaf->schema->module->ctx));
+}
+
+struct lyd_node *
+_lyd_new(struct lyd_node *parent, const struct lys_node *schema, int dflt)
+{
+    struct lyd_node *ret;
+
+    ret = lyd_node_alloc(schema->module->ctx, sizeof *ret);
+    LY_CHECK_ERR_RETURN(!ret, LOGMEM(schema->module->ctx), NULL);
+
+    ret->schema = (struct lys_node *)schema;
+    ret->validity = ly_new_node_validity(schema);
+    if (resolve_applies_when(schema, 0, NULL)) {
+        ret->when_status = LYD_WHEN;
     }
+    ret->prev = ret;
+    ret->dflt = dflt;
 
-    return _lyd_new(NULL, snode, 0);
+#ifdef LY_ENABLED_CACHE
+    lyd_hash(ret);
+#endif
+
+    if (parent) {
+        if (lyd_insert(parent, ret)) {
+            lyd_free(ret);
+            return NULL;
+        }
+    }
+    return ret;
 }
 
 API struct lyd_node *
-lyd_new_output(struct lyd_node *parent, const struct lys_module *module, const char *name)
+lyd_new(struct lyd_node *parent, const struct lys_module *module, const char *name)
 {
     const struct lys_node *snode = NULL, *siblings;
 
@@ -1557,7 +2346,7 @@ lyd_new_output(struct lyd_node *parent, const struct lys_module *module, const c
         return NULL;
     }
 
-    siblings = lyd_new_find_schema(parent, module, 1);
+    siblings = lyd_new_find_schema(parent, module, 0);
     if (!siblings) {
         LOGARG;
         return NULL;
@@ -1573,6155 +2362,11545 @@ lyd_new_output(struct lyd_node *parent, const struct lys_module *module, const c
     return _lyd_new(parent, snode, 0);
 }
 
-API struct lyd_node *
-lyd_new_output_leaf(struct lyd_node *parent, const struct lys_module *module, const char *name, const char *val_str)
-{
-    const struct lys_node *snode = NULL, *siblings;
+static struct lyd_node *
+lyd_create_leaf(const struct lys_node *schema, const char *val_str, int dflt)
+{
+    struct lyd_node_leaf_list *ret;
 
-    if ((!parent && !module) || !name) {
-        LOGARG;
-        return NULL;
+    ret = (struct lyd_node_leaf_list *)lyd_node_alloc(schema->module->ctx, sizeof *ret);
+    LY_CHECK_ERR_RETURN(!ret, LOGMEM(schema->module->ctx), NULL);
+
+    ret->schema = (struct lys_node *)schema;
+    ret->validity = ly_new_node_validity(schema);
+    if (resolve_applies_when(schema, 0, NULL)) {
+        ret->when_status = LYD_WHEN;
+    }
+    ret->prev = (struct lyd_node *)ret;
+    ret->value_type = ((struct lys_node_leaf *)schema)->type.base;
+    if (!dflt && lyd_value_private(schema)) {
+        ret->value_flags = LY_VALUE_PRIVATE;
     }
+    ret->value_str = lydict_insert_priv(schema->module->ctx, val_str ? val_str : "", 0, ret->value_flags & LY_VALUE_PRIVATE);
+    ret->dflt = dflt;
 
-    siblings = lyd_new_find_schema(parent, module, 1);
-    if (!siblings) {
-        LOGARG;
+#ifdef LY_ENABLED_CACHE
+    lyd_hash((struct lyd_node *)ret);
+#endif
+
+    return (struct lyd_node *)ret;
+}
+
+static struct lyd_node *
+_lyd_new_leaf(struct lyd_node *parent, const struct lys_node *schema, const char *val_str, int dflt, int edit_leaf)
+{
+    struct lyd_node *ret;
+
+    ret = lyd_create_leaf(schema, val_str, dflt);
+    if (!ret) {
         return NULL;
     }
 
-    if (lys_getnext_data(module, lys_parent(siblings), name, strlen(name), LYS_LEAFLIST | LYS_LEAF, &snode) || !snode) {
-        LOGERR(siblings->module->ctx, LY_EINVAL, "Failed to find \"%s\" as a sibling to \"%s:%s\".",
-               name, lys_node_module(siblings)->name, siblings->name);
+    /* connect to parent */
+    if (parent) {
+        if (lyd_insert(parent, ret)) {
+            lyd_free(ret);
+            return NULL;
+        }
+    }
+
+    if (edit_leaf && !((struct lyd_node_leaf_list *)ret)->value_str[0]) {
+        /* empty edit leaf, it is fine */
+        ((struct lyd_node_leaf_list *)ret)->value_type = LY_TYPE_UNKNOWN;
+        return ret;
+    }
+
+    /* resolve the type correctly (after it was connected to parent cause of log) */
+    if (!lyp_parse_value(&((struct lys_node_leaf *)ret->schema)->type, &((struct lyd_node_leaf_list *)ret)->value_str,
+                         NULL, (struct lyd_node_leaf_list *)ret, NULL, NULL, 1, dflt, 0)) {
+        lyd_free(ret);
         return NULL;
     }
 
-    return _lyd_new_leaf(parent, snode, val_str, 0, 0);
+    if ((ret->schema->nodetype == LYS_LEAF) && (ret->schema->flags & LYS_UNIQUE)) {
+        for (; parent && (parent->schema->nodetype != LYS_LIST); parent = parent->parent);
+        if (parent) {
+            parent->validity |= LYD_VAL_UNIQUE;
+        } else {
+            LOGINT(schema->module->ctx);
+        }
+    }
+
+    return ret;
 }
 
 API struct lyd_node *
-lyd_new_output_anydata(struct lyd_node *parent, const struct lys_module *module, const char *name,
-                       void *value, LYD_ANYDATA_VALUETYPE value_type)
+lyd_new_leaf(struct lyd_node *parent, const struct lys_module *module, const char *name, const char *val_str)
 {
-    const struct lys_node *siblings, *snode;
+    const struct lys_node *snode = NULL, *siblings;
 
     if ((!parent && !module) || !name) {
         LOGARG;
         return NULL;
     }
 
-    siblings = lyd_new_find_schema(parent, module, 1);
+    siblings = lyd_new_find_schema(parent, module, 0);
     if (!siblings) {
         LOGARG;
         return NULL;
     }
 
-    if (lys_getnext_data(module, lys_parent(siblings), name, strlen(name), LYS_ANYDATA, &snode) || !snode) {
+    if (lys_getnext_data(module, lys_parent(siblings), name, strlen(name), LYS_LEAFLIST | LYS_LEAF, &snode) || !snode) {
         LOGERR(siblings->module->ctx, LY_EINVAL, "Failed to find \"%s\" as a sibling to \"%s:%s\".",
                name, lys_node_module(siblings)->name, siblings->name);
         return NULL;
     }
 
-    return lyd_create_anydata(parent, snode, value, value_type);
+    return _lyd_new_leaf(parent, snode, val_str, 0, 0);
 }
 
-static int
-lyd_new_path_list_predicate(struct lyd_node *list, const char *list_name, const char *predicate, int *parsed)
+/**
+ * @brief Update (add) default flag of the parents of the added node.
+ *
+ * @param[in] node Added node
+ */
+static void
+lyd_wd_update_parents(struct lyd_node *node)
 {
-    const char *mod_name, *name, *value;
-    char *key_val;
-    int r, i, mod_name_len, nam_len, val_len, has_predicate;
-    struct lys_node_list *slist;
-    struct lys_node *key;
+    struct lyd_node *parent = node->parent, *iter;
 
-    slist = (struct lys_node_list *)list->schema;
+    for (parent = node->parent; parent; parent = node->parent) {
+        if (parent->dflt || parent->schema->nodetype != LYS_CONTAINER ||
+                ((struct lys_node_container *)parent->schema)->presence) {
+            /* parent is already default and there is nothing to update or
+             * it is not a non-presence container -> stop the loop */
+            break;
+        }
+        /* check that there is still some non default sibling */
+        for (iter = node->prev; iter != node; iter = iter->prev) {
+            if (!iter->dflt) {
+                break;
+            }
+        }
+        if (iter == node && node->prev != node) {
+            /* all siblings are implicit default nodes, propagate it to the parent */
+            node = node->parent;
+            node->dflt = 1;
+            continue;
+        } else {
+            /* stop the loop */
+            break;
+        }
+    }
+}
 
-    /* is the predicate a number? */
-    if (((r = parse_schema_json_predicate(predicate, &mod_name, &mod_name_len, &name, &nam_len, &value, &val_len, &has_predicate)) < 1)
-            || !strncmp(name, ".", nam_len)) {
-        LOGVAL(slist->module->ctx, LYE_PATH_INCHAR, LY_VLOG_NONE, NULL, predicate[-r], &predicate[-r]);
-        return -1;
+/* op - 0 add, 1 del, 2 mod (add + del), the subtrees of node and all its following siblings up to last */
+static void
+check_leaf_list_backlinks_siblings(struct lyd_node *node, struct lyd_node *last, int op)
+{
+    struct lyd_node *next, *iter, *sibling;
+    struct lyd_node_leaf_list *leaf_list;
+    struct ly_set *set, *data, *lref_snodes;
+    uint32_t i, j;
+    int validity_changed = 0, match;
+
+    assert((op == 0) || (op == 1) || (op == 2));
+    assert((node == last) || (op == 0));
+
+    lref_snodes = ly_set_new();
+    LY_CHECK_ERR_RETURN(!lref_snodes, LOGMEM(node->schema->module->ctx), );
+
+    /* collect the leafrefs referring to the subtree nodes, each is searched for only once */
+    for (sibling = node; sibling; sibling = (sibling == last) ? NULL : sibling->next) {
+        LY_TREE_DFS_BEGIN(sibling, next, iter) {
+            /* the node is target of a leafref */
+            if ((iter->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST)) && iter->schema->child) {
+                set = (struct ly_set *)iter->schema->child;
+                for (i = 0; i < set->number; i++) {
+                    ly_set_add(lref_snodes, set->set.s[i], 0);
+                }
+            }
+            LY_TREE_DFS_END(sibling, next, iter)
+        }
     }
 
-    if (isdigit(name[0])) {
-        /* position index - creating without keys */
-        *parsed += r;
-        return 0;
+    /* fix leafrefs */
+    for (i = 0; i < lref_snodes->number; i++) {
+        data = lyd_find_instance(node, lref_snodes->set.s[i]);
+        if (!data) {
+            LOGINT(node->schema->module->ctx);
+            break;
+        }
+        for (j = 0; j < data->number; j++) {
+            leaf_list = (struct lyd_node_leaf_list *)data->set.d[j];
+            match = 0;
+            if ((op != 1) && (leaf_list->value_flags & LY_VALUE_UNRES)) {
+                match = 1;
+            } else if ((op != 0) && (leaf_list->value_type == LY_TYPE_LEAFREF)) {
+                /* the leafref refers to a node in the subtree */
+                for (iter = leaf_list->value.leafref; iter && (iter != node); iter = iter->parent);
+                match = iter ? 1 : 0;
+            }
+            if (match) {
+                /* invalidate the leafref, a change concerning it happened */
+                leaf_list->validity |= LYD_VAL_LEAFREF;
+                validity_changed = 1;
+                if (leaf_list->value_type == LY_TYPE_LEAFREF) {
+                    /* remove invalid link and put unresolved value back */
+                    lyp_parse_value(&((struct lys_node_leaf *)leaf_list->schema)->type, &leaf_list->value_str,
+                                    NULL, leaf_list, NULL, NULL, 1, leaf_list->dflt, 0);
+                }
+            }
+        }
+        ly_set_free(data);
     }
+    ly_set_free(lref_snodes);
 
-    /* it's not a number, so there must be some keys */
-    if (!slist->keys_size) {
-        /* there are none, so pretend we did not parse anything to get invalid char error later */
-        return 0;
+    /* invalidate parent to make sure it will be checked in future validation */
+    if (validity_changed && node->parent) {
+        node->parent->validity |= LYD_VAL_MAND;
     }
+}
 
-    /* go through all the keys */
-    i = 0;
-    goto check_parsed_values;
+/* op - 0 add, 1 del, 2 mod (add + del) */
+static void
+check_leaf_list_backlinks(struct lyd_node *node, int op)
+{
+    check_leaf_list_backlinks_siblings(node, node, op);
+}
 
-    for (; i < slist->keys_size; ++i) {
-        if (!has_predicate) {
-            LOGVAL(slist->module->ctx, LYE_PATH_MISSKEY, LY_VLOG_NONE, NULL, list_name);
-            return -1;
-        }
+/* finish a leaf value change, val_change - whether the canonical value differs from the previous one */
+static int
+lyd_change_leaf_finish(struct lyd_node_leaf_list *leaf, int val_change)
+{
+    int dflt_change;
+    struct lyd_node *parent;
 
-        if (((r = parse_schema_json_predicate(predicate, &mod_name, &mod_name_len, &name, &nam_len, &value, &val_len, &has_predicate)) < 1)
-                || !strncmp(name, ".", nam_len)) {
-            LOGVAL(slist->module->ctx, LYE_PATH_INCHAR, LY_VLOG_NONE, NULL, predicate[-r], &predicate[-r]);
-            return -1;
+    /* clear the default flag, the value is different */
+    if (leaf->dflt) {
+        for (parent = (struct lyd_node *)leaf; parent; parent = parent->parent) {
+            parent->dflt = 0;
         }
+        dflt_change = 1;
+    } else {
+        dflt_change = 0;
+    }
 
-check_parsed_values:
-        key = (struct lys_node *)slist->keys[i];
-        *parsed += r;
-        predicate += r;
+    if (val_change || dflt_change) {
+        lyd_journal_changed((struct lyd_node *)leaf, dflt_change);
+    }
 
-        if (!value || (!mod_name && (lys_node_module(key) != lys_node_module((struct lys_node *)slist)))
-                || (mod_name && (strncmp(lys_node_module(key)->name, mod_name, mod_name_len) || lys_node_module(key)->name[mod_name_len]))
-                || strncmp(key->name, name, nam_len) || key->name[nam_len]) {
-            LOGVAL(slist->module->ctx, LYE_PATH_INKEY, LY_VLOG_NONE, NULL, name);
-            return -1;
-        }
+    if (val_change) {
+        lyd_gen_bump(leaf->schema->module->ctx);
 
-        key_val = malloc((val_len + 1) * sizeof(char));
-        LY_CHECK_ERR_RETURN(!key_val, LOGMEM(slist->module->ctx), -1);
-        strncpy(key_val, value, val_len);
-        key_val[val_len] = '\0';
+        /* make the node non-validated */
+        leaf->validity = ly_new_node_validity(leaf->schema);
 
-        if (!_lyd_new_leaf(list, key, key_val, 0, 0)) {
-            free(key_val);
+        /* check possible leafref backlinks, only if some leafref refers to this leaf */
+        if (leaf->schema->child) {
+            check_leaf_list_backlinks((struct lyd_node *)leaf, 2);
+        }
+    }
+
+    if (val_change && (leaf->schema->flags & LYS_UNIQUE)) {
+        for (parent = leaf->parent; parent && (parent->schema->nodetype != LYS_LIST); parent = parent->parent);
+        if (parent) {
+            parent->validity |= LYD_VAL_UNIQUE;
+        } else {
+            LOGINT(leaf->schema->module->ctx);
             return -1;
         }
-        free(key_val);
     }
 
-    return 0;
+    return (val_change || dflt_change ? 0 : 1);
 }
 
-static struct lyd_node *
-lyd_new_path_update(struct lyd_node *node, void *value, LYD_ANYDATA_VALUETYPE value_type, int dflt)
+API int
+lyd_change_leaf(struct lyd_node_leaf_list *leaf, const char *val_str)
 {
-    struct ly_ctx *ctx = node->schema->module->ctx;
-    struct lyd_node_anydata *any;
-    int len;
+    const char *backup;
+    int val_change, backup_priv;
 
-    switch (node->schema->nodetype) {
-    case LYS_LEAF:
-        if (value_type > LYD_ANYDATA_STRING) {
-            LOGARG;
-            return NULL;
-        }
+    if (!leaf || (leaf->schema->nodetype != LYS_LEAF)) {
+        LOGARG;
+        return -1;
+    }
 
-        if (lyd_change_leaf((struct lyd_node_leaf_list *)node, value) == 0) {
-            /* there was an actual change */
-            if (dflt) {
-                node->dflt = 1;
-            }
-            return node;
-        }
+    backup = leaf->value_str;
+    backup_priv = leaf->value_flags & LY_VALUE_PRIVATE;
+    if (lyd_value_private(leaf->schema)) {
+        leaf->value_flags |= LY_VALUE_PRIVATE;
+    } else {
+        leaf->value_flags &= ~LY_VALUE_PRIVATE;
+    }
+    leaf->value_str = lydict_insert_priv(leaf->schema->module->ctx, val_str ? val_str : "", 0,
+                                         leaf->value_flags & LY_VALUE_PRIVATE);
+    /* leaf->value is erased by lyp_parse_value() */
 
-        if (dflt) {
-            /* maybe the value is the same, but the node is default now */
-            node->dflt = 1;
-            return node;
-        }
+    /* parse the type correctly, makes the value canonical if needed */
+    if (!lyp_parse_value(&((struct lys_node_leaf *)leaf->schema)->type, &leaf->value_str, NULL, leaf, NULL, NULL, 1, 0, 0)) {
+        lydict_remove_priv(leaf->schema->module->ctx, backup, backup_priv);
+        return -1;
+    }
 
-        break;
-    case LYS_ANYXML:
-    case LYS_ANYDATA:
-        /* the nodes are the same if:
-         * 1) the value types are strings (LYD_ANYDATA_STRING and LYD_ANYDATA_CONSTSTRING equals)
-         *    and the strings equals
-         * 2) the value types are the same, but not strings and the pointers (not the content) are the
-         *    same
-         */
-        any = (struct lyd_node_anydata *)node;
-        if (any->value_type <= LYD_ANYDATA_STRING && value_type <= LYD_ANYDATA_STRING) {
-            if (ly_strequal(any->value.str, (char *)value, 0)) {
-                /* values are the same */
-                return NULL;
-            }
-        } else if (any->value_type == value_type) {
-            /* compare pointers */
-            if ((void *)any->value.tree == value) {
-                /* values are the same */
-                return NULL;
-            }
-        }
-
-        /* values are not the same - 1) remove the old one ... */
-        switch (any->value_type) {
-        case LYD_ANYDATA_CONSTSTRING:
-        case LYD_ANYDATA_SXML:
-        case LYD_ANYDATA_JSON:
-            lydict_remove(ctx, any->value.str);
-            break;
-        case LYD_ANYDATA_DATATREE:
-            lyd_free_withsiblings(any->value.tree);
-            break;
-        case LYD_ANYDATA_XML:
-            lyxml_free_withsiblings(ctx, any->value.xml);
-            break;
-        case LYD_ANYDATA_LYB:
-            free(any->value.mem);
-            break;
-        case LYD_ANYDATA_STRING:
-        case LYD_ANYDATA_SXMLD:
-        case LYD_ANYDATA_JSOND:
-        case LYD_ANYDATA_LYBD:
-            /* dynamic strings are used only as input parameters */
-            assert(0);
-            break;
-        }
-        /* ... and 2) store the new one */
-        switch (value_type) {
-        case LYD_ANYDATA_CONSTSTRING:
-        case LYD_ANYDATA_SXML:
-        case LYD_ANYDATA_JSON:
-            any->value.str = lydict_insert(ctx, (const char *)value, 0);
-            break;
-        case LYD_ANYDATA_STRING:
-        case LYD_ANYDATA_SXMLD:
-        case LYD_ANYDATA_JSOND:
-            any->value.str = lydict_insert_zc(ctx, (char *)value);
-            value_type &= ~LYD_ANYDATA_STRING; /* make const string from string */
-            break;
-        case LYD_ANYDATA_DATATREE:
-            any->value.tree = value;
-            break;
-        case LYD_ANYDATA_XML:
-            any->value.xml = value;
-            break;
-        case LYD_ANYDATA_LYB:
-            len = lyd_lyb_data_length(value);
-            if (len == -1) {
-                LOGERR(ctx, LY_EINVAL, "Invalid LYB data.");
-                return NULL;
-            }
-            any->value.mem = malloc(len);
-            LY_CHECK_ERR_RETURN(!any->value.mem, LOGMEM(ctx), NULL);
-            memcpy(any->value.mem, value, len);
-            break;
-        case LYD_ANYDATA_LYBD:
-            any->value.mem = value;
-            value_type &= ~LYD_ANYDATA_STRING; /* make const string from string */
-            break;
-        }
-        return node;
-    default:
-        /* nothing needed - containers, lists and leaf-lists do not have value or it cannot be changed */
-        break;
+    if (!strcmp(backup, leaf->value_str)) {
+        /* the value remains the same */
+        val_change = 0;
+    } else {
+        val_change = 1;
     }
 
-    /* not updated */
-    return NULL;
+    /* value is correct, remove backup */
+    lydict_remove_priv(leaf->schema->module->ctx, backup, backup_priv);
+
+    return lyd_change_leaf_finish(leaf, val_change);
 }
 
-API struct lyd_node *
-lyd_new_path(struct lyd_node *data_tree, const struct ly_ctx *ctx, const char *path, void *value,
-             LYD_ANYDATA_VALUETYPE value_type, int options)
+API int
+lyd_change_leaf_val(struct lyd_node_leaf_list *leaf, const lyd_val *value)
 {
-    char *str;
-    const char *mod_name, *name, *val_name, *val, *node_mod_name, *id, *backup_mod_name = NULL, *yang_data_name = NULL;
-    struct lyd_node *ret = NULL, *node, *parent = NULL;
-    const struct lys_node *schild, *sparent, *tmp;
-    const struct lys_node_list *slist;
-    const struct lys_module *module, *prev_mod;
-    int r, i, parsed = 0, mod_name_len, nam_len, val_name_len, val_len;
-    int is_relative = -1, has_predicate, first_iter = 1, edit_leaf;
-    int backup_is_relative, backup_mod_name_len, yang_data_name_len;
+    struct ly_ctx *ctx;
+    struct lys_type *type;
+    char buf[LYP_NUM_BUFLEN], *str;
+    int rc, priv;
 
-    if (!path || (!data_tree && !ctx)
-            || (!data_tree && (path[0] != '/'))) {
+    if (!leaf || !value || (leaf->schema->nodetype != LYS_LEAF)) {
         LOGARG;
-        return NULL;
+        return -1;
     }
+    ctx = leaf->schema->module->ctx;
 
-    if (!ctx) {
-        ctx = data_tree->schema->module->ctx;
+    type = &((struct lys_node_leaf *)leaf->schema)->type;
+    if ((type->base == LY_TYPE_LEAFREF) || (leaf->value_flags & LY_VALUE_USER)) {
+        /* the value must be fully resolved, print it in the target type and take the generic path */
+        while (type->base == LY_TYPE_LEAFREF) {
+            type = &type->info.lref.target->type;
+        }
+        if (lyp_num_value(type, value, buf, NULL)) {
+            LOGERR(ctx, LY_EINVAL, "Leaf \"%s\" is not of a boolean or numeric type.", leaf->schema->name);
+            return -1;
+        }
+        return lyd_change_leaf(leaf, buf);
     }
 
-    id = path;
+    rc = lyp_num_value(type, value, buf, (struct lyd_node *)leaf);
+    if (rc == -1) {
+        LOGERR(ctx, LY_EINVAL, "Leaf \"%s\" is not of a boolean or numeric type.", leaf->schema->name);
+        return -1;
+    } else if (rc) {
+        return -1;
+    }
 
-    if (data_tree) {
-        /* go through all the siblings and try to find the right parent, if exists,
-         * first go through all the next siblings keeping the original order, for positional predicates */
-        LY_TREE_FOR(data_tree, node) {
-            parent = resolve_partial_json_data_nodeid(id, value_type > LYD_ANYDATA_STRING ? NULL : value, node,
-                                                      options, &parsed);
-            if (parsed) {
-                break;
+    if (strcmp(buf, leaf->value_str)) {
+        priv = lyd_value_private(leaf->schema);
+        if (priv && (leaf->value_flags & LY_VALUE_PRIVATE)) {
+            /* the private string is just rewritten */
+            str = realloc((char *)leaf->value_str, strlen(buf) + 1);
+            LY_CHECK_ERR_RETURN(!str, LOGMEM(ctx), -1);
+            leaf->value_str = strcpy(str, buf);
+        } else {
+            lydict_remove_priv(ctx, leaf->value_str, leaf->value_flags & LY_VALUE_PRIVATE);
+            leaf->value_str = lydict_insert_priv(ctx, buf, 0, priv);
+            if (priv) {
+                leaf->value_flags |= LY_VALUE_PRIVATE;
+            } else {
+                leaf->value_flags &= ~LY_VALUE_PRIVATE;
             }
         }
-        for (node = data_tree->prev; !parsed && node->next; node = node->prev) {
-            parent = resolve_partial_json_data_nodeid(id, value_type > LYD_ANYDATA_STRING ? NULL : value, node,
-                                                      options, &parsed);
-        }
-        if (parsed == -1) {
-            return NULL;
-        }
-        if (parsed) {
-            assert(parent);
-            /* if we parsed something we have a relative path now for sure, otherwise we don't know */
-            is_relative = 1;
+        leaf->value = *value;
+        leaf->value_type = type->base;
+        return lyd_change_leaf_finish(leaf, 1);
+    }
 
-            id += parsed;
+    return lyd_change_leaf_finish(leaf, 0);
+}
 
-            if (!id[0]) {
-                /* the node exists, are we supposed to update it or is it default? */
-                if (!(options & LYD_PATH_OPT_UPDATE) && (!parent->dflt || (options & LYD_PATH_OPT_DFLT))) {
-                    LOGVAL(ctx, LYE_PATH_EXISTS, LY_VLOG_STR, path);
-                    return NULL;
-                }
+static struct lyd_node *
+lyd_create_anydata(struct lyd_node *parent, const struct lys_node *schema, void *value,
+                   LYD_ANYDATA_VALUETYPE value_type)
+{
+    struct lyd_node *iter;
+    struct lyd_node_anydata *ret;
+    int len;
 
-                /* no change, the default node already exists */
-                if (parent->dflt && (options & LYD_PATH_OPT_DFLT)) {
-                    return NULL;
-                }
+    ret = (struct lyd_node_anydata *)lyd_node_alloc(schema->module->ctx, sizeof *ret);
+    LY_CHECK_ERR_RETURN(!ret, LOGMEM(schema->module->ctx), NULL);
 
-                return lyd_new_path_update(parent, value, value_type, options & LYD_PATH_OPT_DFLT);
-            }
-        }
+    ret->schema = (struct lys_node *)schema;
+    ret->validity = ly_new_node_validity(schema);
+    if (resolve_applies_when(schema, 0, NULL)) {
+        ret->when_status = LYD_WHEN;
     }
+    ret->prev = (struct lyd_node *)ret;
 
-    backup_is_relative = is_relative;
-    if ((r = parse_schema_nodeid(id, &mod_name, &mod_name_len, &name, &nam_len, &is_relative, NULL, NULL, 1)) < 1) {
-        LOGVAL(ctx, LYE_PATH_INCHAR, LY_VLOG_NONE, NULL, id[-r], &id[-r]);
-        return NULL;
+    /* set the value */
+    switch (value_type) {
+    case LYD_ANYDATA_CONSTSTRING:
+    case LYD_ANYDATA_SXML:
+    case LYD_ANYDATA_JSON:
+        ret->value.str = lydict_insert(schema->module->ctx, (const char *)value, 0);
+        break;
+    case LYD_ANYDATA_STRING:
+    case LYD_ANYDATA_SXMLD:
+    case LYD_ANYDATA_JSOND:
+        ret->value.str = lydict_insert_zc(schema->module->ctx, (char *)value);
+        value_type &= ~LYD_ANYDATA_STRING; /* make const string from string */
+        break;
+    case LYD_ANYDATA_DATATREE:
+        ret->value.tree = (struct lyd_node *)value;
+        break;
+    case LYD_ANYDATA_XML:
+        ret->value.xml = (struct lyxml_elem *)value;
+        break;
+    case LYD_ANYDATA_LYB:
+        len = lyd_lyb_data_length(value);
+        if (len == -1) {
+            LOGERR(schema->module->ctx, LY_EINVAL, "Invalid LYB data.");
+            return NULL;
+        }
+        ret->value.mem = malloc(len);
+        LY_CHECK_ERR_RETURN(!ret->value.mem, LOGMEM(schema->module->ctx); free(ret), NULL);
+        memcpy(ret->value.mem, value, len);
+        break;
+    case LYD_ANYDATA_LYBD:
+        ret->value.mem = value;
+        value_type &= ~LYD_ANYDATA_STRING; /* make const string from string */
+        break;
     }
+    ret->value_type = value_type;
 
-    if (name[0] == '#') {
-        if (is_relative) {
-            LOGVAL(ctx, LYE_PATH_INCHAR, LY_VLOG_NONE, NULL, '#', name);
+#ifdef LY_ENABLED_CACHE
+    lyd_hash((struct lyd_node *)ret);
+#endif
+
+    /* connect to parent */
+    if (parent) {
+        if (lyd_insert(parent, (struct lyd_node*)ret)) {
+            lyd_free((struct lyd_node*)ret);
             return NULL;
         }
-        yang_data_name = name + 1;
-        yang_data_name_len = nam_len - 1;
-        backup_mod_name = mod_name;
-        backup_mod_name_len = mod_name_len;
-        /* move to the next node in the path */
-        id += r;
-    } else {
-        is_relative = backup_is_relative;
+
+        /* remove the flag from parents */
+        for (iter = parent; iter && iter->dflt; iter = iter->parent) {
+            iter->dflt = 0;
+        }
     }
 
-    if ((r = parse_schema_nodeid(id, &mod_name, &mod_name_len, &name, &nam_len, &is_relative, &has_predicate, NULL, 0)) < 1) {
-        LOGVAL(ctx, LYE_PATH_INCHAR, LY_VLOG_NONE, NULL, id[-r], &id[-r]);
+    return (struct lyd_node*)ret;
+}
+
+API struct lyd_node *
+lyd_new_anydata(struct lyd_node *parent, const struct lys_module *module, const char *name,
+                void *value, LYD_ANYDATA_VALUETYPE value_type)
+{
+    const struct lys_node *siblings, *snode;
+
+    if ((!parent && !module) || !name) {
+        LOGARG;
         return NULL;
     }
-    /* move to the next node in the path */
-    id += r;
 
-    if (backup_mod_name) {
-        mod_name = backup_mod_name;
-        mod_name_len = backup_mod_name_len;
+    siblings = lyd_new_find_schema(parent, module, 0);
+    if (!siblings) {
+        LOGARG;
+        return NULL;
     }
 
-    /* prepare everything for the schema search loop */
-    if (is_relative) {
-        /* we are relative to data_tree or parent if some part of the path already exists */
-        if (!data_tree) {
-            LOGERR(ctx, LY_EINVAL, "%s: provided relative path (%s) without context node.", path);
+    if (lys_getnext_data(module, lys_parent(siblings), name, strlen(name), LYS_ANYDATA, &snode) || !snode) {
+        LOGERR(siblings->module->ctx, LY_EINVAL, "Failed to find \"%s\" as a sibling to \"%s:%s\".",
+               name, lys_node_module(siblings)->name, siblings->name);
+        return NULL;
+    }
+
+    return lyd_create_anydata(parent, snode, value, value_type);
+}
+
+API struct lyd_node *
+lyd_new_yangdata(const struct lys_module *module, const char *name_template, const char *name)
+{
+    const struct lys_node *schema = NULL, *snode;
+
+    if (!module || !name_template || !name) {
+        LOGARG;
+        return NULL;
+    }
+
+    schema = lyp_get_yang_data_template(module, name_template, strlen(name_template));
+    if (!schema) {
+        LOGERR(module->ctx, LY_EINVAL, "Failed to find yang-data template \"%s\".", name_template);
+        return NULL;
+    }
+
+    if (lys_getnext_data(module, schema, name, strlen(name), LYS_CONTAINER, &snode) || !snode) {
+        LOGERR(module->ctx, LY_EINVAL, "Failed to find \"%s\" as a container child of \"%s:%s\".",
+               name, module->name, schema->name);
+        return NULL;
+    }
+
+    return _lyd_new(NULL, snode, 0);
+}
+
+API struct lyd_node *
+lyd_new_output(struct lyd_node *parent, const struct lys_module *module, const char *name)
+{
+    const struct lys_node *snode = NULL, *siblings;
+
+    if ((!parent && !module) || !name) {
+        LOGARG;
+        return NULL;
+    }
+
+    siblings = lyd_new_find_schema(parent, module, 1);
+    if (!siblings) {
+        LOGARG;
+        return NULL;
+    }
+
+    if (lys_getnext_data(module, lys_parent(siblings), name, strlen(name), LYS_CONTAINER | LYS_LIST | LYS_NOTIF
+                         | LYS_RPC | LYS_ACTION, &snode) || !snode) {
+        LOGERR(siblings->module->ctx, LY_EINVAL, "Failed to find \"%s\" as a sibling to \"%s:%s\".",
+               name, lys_node_module(siblings)->name, siblings->name);
+        return NULL;
+    }
+
+    return _lyd_new(parent, snode, 0);
+}
+
+API struct lyd_node *
+lyd_new_output_leaf(struct lyd_node *parent, const struct lys_module *module, const char *name, const char *val_str)
+{
+    const struct lys_node *snode = NULL, *siblings;
+
+    if ((!parent && !module) || !name) {
+        LOGARG;
+        return NULL;
+    }
+
+    siblings = lyd_new_find_schema(parent, module, 1);
+    if (!siblings) {
+        LOGARG;
+        return NULL;
+    }
+
+    if (lys_getnext_data(module, lys_parent(siblings), name, strlen(name), LYS_LEAFLIST | LYS_LEAF, &snode) || !snode) {
+        LOGERR(siblings->module->ctx, LY_EINVAL, "Failed to find \"%s\" as a sibling to \"%s:%s\".",
+               name, lys_node_module(siblings)->name, siblings->name);
+        return NULL;
+    }
+
+    return _lyd_new_leaf(parent, snode, val_str, 0, 0);
+}
+
+API struct lyd_node *
+lyd_new_output_anydata(struct lyd_node *parent, const struct lys_module *module, const char *name,
+                       void *value, LYD_ANYDATA_VALUETYPE value_type)
+{
+    const struct lys_node *siblings, *snode;
+
+    if ((!parent && !module) || !name) {
+        LOGARG;
+        return NULL;
+    }
+
+    siblings = lyd_new_find_schema(parent, module, 1);
+    if (!siblings) {
+        LOGARG;
+        return NULL;
+    }
+
+    if (lys_getnext_data(module, lys_parent(siblings), name, strlen(name), LYS_ANYDATA, &snode) || !snode) {
+        LOGERR(siblings->module->ctx, LY_EINVAL, "Failed to find \"%s\" as a sibling to \"%s:%s\".",
+               name, lys_node_module(siblings)->name, siblings->name);
+        return NULL;
+    }
+
+    return lyd_create_anydata(parent, snode, value, value_type);
+}
+
+API int
+lyd_anydata_convert(struct lyd_node *node, LYD_ANYDATA_VALUETYPE value_type, int options)
+{
+    struct lyd_node_anydata *any = (struct lyd_node_anydata *)node;
+    struct ly_ctx *ctx;
+    struct lyxml_elem *xml = NULL;
+    struct lyd_node *tree = NULL;
+    char *str = NULL;
+
+    if (!node || !(node->schema->nodetype & LYS_ANYDATA)) {
+        LOGARG;
+        return EXIT_FAILURE;
+    }
+    ctx = node->schema->module->ctx;
+
+    if (any->value_type == value_type) {
+        return EXIT_SUCCESS;
+    }
+
+    ly_errno = LY_SUCCESS;
+    switch (value_type) {
+    case LYD_ANYDATA_XML:
+        if (any->value_type != LYD_ANYDATA_SXML) {
+            goto unsupported;
+        }
+        xml = lyxml_parse_mem(ctx, any->value.str, LYXML_PARSE_MULTIROOT);
+        if (!xml) {
+            if (ly_errno) {
+                return EXIT_FAILURE;
+            }
+            /* there are no elements in the content */
+            lydict_remove(ctx, any->value.str);
+            any->value.str = lydict_insert(ctx, "", 0);
+            any->value_type = LYD_ANYDATA_CONSTSTRING;
+            return EXIT_SUCCESS;
+        }
+        lydict_remove(ctx, any->value.str);
+        any->value.xml = xml;
+        break;
+    case LYD_ANYDATA_SXML:
+        if (any->value_type != LYD_ANYDATA_XML) {
+            goto unsupported;
+        }
+        if (any->value.xml) {
+            lyxml_print_mem(&str, any->value.xml, LYXML_PRINT_SIBLINGS);
+        }
+        lyxml_free_withsiblings(ctx, any->value.xml);
+        any->value.str = str ? lydict_insert_zc(ctx, str) : lydict_insert(ctx, "", 0);
+        break;
+    case LYD_ANYDATA_DATATREE:
+        if (lyp_data_check_options(ctx, options, __func__)) {
+            return EXIT_FAILURE;
+        }
+        if (options & (LYD_OPT_RPC | LYD_OPT_RPCREPLY | LYD_OPT_NOTIF | LYD_OPT_DATA_TEMPLATE | LYD_OPT_DESTRUCT
+                | LYD_OPT_PROJECTION)) {
+            LOGERR(ctx, LY_EINVAL, "%s: invalid options (only data trees can be parsed).", __func__);
+            return EXIT_FAILURE;
+        }
+
+        switch (any->value_type) {
+        case LYD_ANYDATA_SXML:
+            tree = lyd_parse_mem(ctx, any->value.str, LYD_XML, options);
+            break;
+        case LYD_ANYDATA_JSON:
+            tree = lyd_parse_mem(ctx, any->value.str, LYD_JSON, options);
+            break;
+        case LYD_ANYDATA_XML:
+            xml = any->value.xml;
+            tree = xml ? lyd_parse_xml(ctx, &xml, options) : NULL;
+            break;
+        default:
+            goto unsupported;
+        }
+        if (ly_errno) {
+            lyd_free_withsiblings(tree);
+            return EXIT_FAILURE;
+        }
+
+        if (any->value_type == LYD_ANYDATA_XML) {
+            lyxml_free_withsiblings(ctx, any->value.xml);
+        } else {
+            lydict_remove(ctx, any->value.str);
+        }
+        any->value.tree = tree;
+        break;
+    default:
+        goto unsupported;
+    }
+
+    any->value_type = value_type;
+    return EXIT_SUCCESS;
+
+unsupported:
+    LOGERR(ctx, LY_EINVAL, "%s: unsupported conversion of anydata value type %d to %d.", __func__, any->value_type,
+           value_type);
+    return EXIT_FAILURE;
+}
+
+static int
+lyd_new_path_list_predicate(struct lyd_node *list, const char *list_name, const char *predicate, int *parsed)
+{
+    const char *mod_name, *name, *value;
+    char *key_val;
+    int r, i, mod_name_len, nam_len, val_len, has_predicate;
+    struct lys_node_list *slist;
+    struct lys_node *key;
+
+    slist = (struct lys_node_list *)list->schema;
+
+    /* is the predicate a number? */
+    if (((r = parse_schema_json_predicate(predicate, &mod_name, &mod_name_len, &name, &nam_len, &value, &val_len, &has_predicate)) < 1)
+            || !strncmp(name, ".", nam_len)) {
+        LOGVAL(slist->module->ctx, LYE_PATH_INCHAR, LY_VLOG_NONE, NULL, predicate[-r], &predicate[-r]);
+        return -1;
+    }
+
+    if (isdigit(name[0])) {
+        /* position index - creating without keys */
+        *parsed += r;
+        return 0;
+    }
+
+    /* it's not a number, so there must be some keys */
+    if (!slist->keys_size) {
+        /* there are none, so pretend we did not parse anything to get invalid char error later */
+        return 0;
+    }
+
+    /* go through all the keys */
+    i = 0;
+    goto check_parsed_values;
+
+    for (; i < slist->keys_size; ++i) {
+        if (!has_predicate) {
+            LOGVAL(slist->module->ctx, LYE_PATH_MISSKEY, LY_VLOG_NONE, NULL, list_name);
+            return -1;
+        }
+
+        if (((r = parse_schema_json_predicate(predicate, &mod_name, &mod_name_len, &name, &nam_len, &value, &val_len, &has_predicate)) < 1)
+                || !strncmp(name, ".", nam_len)) {
+            LOGVAL(slist->module->ctx, LYE_PATH_INCHAR, LY_VLOG_NONE, NULL, predicate[-r], &predicate[-r]);
+            return -1;
+        }
+
+check_parsed_values:
+        key = (struct lys_node *)slist->keys[i];
+        *parsed += r;
+        predicate += r;
+
+        if (!value || (!mod_name && (lys_node_module(key) != lys_node_module((struct lys_node *)slist)))
+                || (mod_name && (strncmp(lys_node_module(key)->name, mod_name, mod_name_len) || lys_node_module(key)->name[mod_name_len]))
+                || strncmp(key->name, name, nam_len) || key->name[nam_len]) {
+            LOGVAL(slist->module->ctx, LYE_PATH_INKEY, LY_VLOG_NONE, NULL, name);
+            return -1;
+        }
+
+        key_val = malloc((val_len + 1) * sizeof(char));
+        LY_CHECK_ERR_RETURN(!key_val, LOGMEM(slist->module->ctx), -1);
+        strncpy(key_val, value, val_len);
+        key_val[val_len] = '\0';
+
+        if (!_lyd_new_leaf(list, key, key_val, 0, 0)) {
+            free(key_val);
+            return -1;
+        }
+        free(key_val);
+    }
+
+    return 0;
+}
+
+static struct lyd_node *
+lyd_new_path_update(struct lyd_node *node, void *value, LYD_ANYDATA_VALUETYPE value_type, int dflt)
+{
+    struct ly_ctx *ctx = node->schema->module->ctx;
+    struct lyd_node_anydata *any;
+    int len;
+
+    switch (node->schema->nodetype) {
+    case LYS_LEAF:
+        if (value_type > LYD_ANYDATA_STRING) {
+            LOGARG;
             return NULL;
-        } else if (!parent) {
+        }
+
+        if (lyd_change_leaf((struct lyd_node_leaf_list *)node, value) == 0) {
+            /* there was an actual change */
+            if (dflt) {
+                node->dflt = 1;
+            }
+            return node;
+        }
+
+        if (dflt) {
+            /* maybe the value is the same, but the node is default now */
+            node->dflt = 1;
+            return node;
+        }
+
+        break;
+    case LYS_ANYXML:
+    case LYS_ANYDATA:
+        /* the nodes are the same if:
+         * 1) the value types are strings (LYD_ANYDATA_STRING and LYD_ANYDATA_CONSTSTRING equals)
+         *    and the strings equals
+         * 2) the value types are the same, but not strings and the pointers (not the content) are the
+         *    same
+         */
+        any = (struct lyd_node_anydata *)node;
+        if (any->value_type <= LYD_ANYDATA_STRING && value_type <= LYD_ANYDATA_STRING) {
+            if (ly_strequal(any->value.str, (char *)value, 0)) {
+                /* values are the same */
+                return NULL;
+            }
+        } else if (any->value_type == value_type) {
+            /* compare pointers */
+            if ((void *)any->value.tree == value) {
+                /* values are the same */
+                return NULL;
+            }
+        }
+
+        /* values are not the same - 1) remove the old one ... */
+        switch (any->value_type) {
+        case LYD_ANYDATA_CONSTSTRING:
+        case LYD_ANYDATA_SXML:
+        case LYD_ANYDATA_JSON:
+            lydict_remove(ctx, any->value.str);
+            break;
+        case LYD_ANYDATA_DATATREE:
+            lyd_free_withsiblings(any->value.tree);
+            break;
+        case LYD_ANYDATA_XML:
+            lyxml_free_withsiblings(ctx, any->value.xml);
+            break;
+        case LYD_ANYDATA_LYB:
+            free(any->value.mem);
+            break;
+        case LYD_ANYDATA_STRING:
+        case LYD_ANYDATA_SXMLD:
+        case LYD_ANYDATA_JSOND:
+        case LYD_ANYDATA_LYBD:
+            /* dynamic strings are used only as input parameters */
+            assert(0);
+            break;
+        }
+        /* ... and 2) store the new one */
+        switch (value_type) {
+        case LYD_ANYDATA_CONSTSTRING:
+        case LYD_ANYDATA_SXML:
+        case LYD_ANYDATA_JSON:
+            any->value.str = lydict_insert(ctx, (const char *)value, 0);
+            break;
+        case LYD_ANYDATA_STRING:
+        case LYD_ANYDATA_SXMLD:
+        case LYD_ANYDATA_JSOND:
+            any->value.str = lydict_insert_zc(ctx, (char *)value);
+            value_type &= ~LYD_ANYDATA_STRING; /* make const string from string */
+            break;
+        case LYD_ANYDATA_DATATREE:
+            any->value.tree = value;
+            break;
+        case LYD_ANYDATA_XML:
+            any->value.xml = value;
+            break;
+        case LYD_ANYDATA_LYB:
+            len = lyd_lyb_data_length(value);
+            if (len == -1) {
+                LOGERR(ctx, LY_EINVAL, "Invalid LYB data.");
+                return NULL;
+            }
+            any->value.mem = malloc(len);
+            LY_CHECK_ERR_RETURN(!any->value.mem, LOGMEM(ctx), NULL);
+            memcpy(any->value.mem, value, len);
+            break;
+        case LYD_ANYDATA_LYBD:
+            any->value.mem = value;
+            value_type &= ~LYD_ANYDATA_STRING; /* make const string from string */
+            break;
+        }
+        return node;
+    default:
+        /* nothing needed - containers, lists and leaf-lists do not have value or it cannot be changed */
+        break;
+    }
+
+    /* not updated */
+    return NULL;
+}
+
+API struct lyd_node *
+lyd_new_path(struct lyd_node *data_tree, const struct ly_ctx *ctx, const char *path, void *value,
+             LYD_ANYDATA_VALUETYPE value_type, int options)
+{
+    char *str;
+    const char *mod_name, *name, *val_name, *val, *node_mod_name, *id, *backup_mod_name = NULL, *yang_data_name = NULL;
+    struct lyd_node *ret = NULL, *node, *parent = NULL;
+    const struct lys_node *schild, *sparent, *tmp;
+    const struct lys_node_list *slist;
+    const struct lys_module *module, *prev_mod;
+    int r, i, parsed = 0, mod_name_len, nam_len, val_name_len, val_len;
+    int is_relative = -1, has_predicate, first_iter = 1, edit_leaf;
+    int backup_is_relative, backup_mod_name_len, yang_data_name_len;
+
+    if (!path || (!data_tree && !ctx)
+            || (!data_tree && (path[0] != '/'))) {
+        LOGARG;
+        return NULL;
+    }
+
+    if (!ctx) {
+        ctx = data_tree->schema->module->ctx;
+    }
+
+    id = path;
+
+    if (data_tree) {
+        /* go through all the siblings and try to find the right parent, if exists,
+         * first go through all the next siblings keeping the original order, for positional predicates */
+        LY_TREE_FOR(data_tree, node) {
+            parent = resolve_partial_json_data_nodeid(id, value_type > LYD_ANYDATA_STRING ? NULL : value, node,
+                                                      options, &parsed);
+            if (parsed) {
+                break;
+            }
+        }
+        for (node = data_tree->prev; !parsed && node->next; node = node->prev) {
+            parent = resolve_partial_json_data_nodeid(id, value_type > LYD_ANYDATA_STRING ? NULL : value, node,
+                                                      options, &parsed);
+        }
+        if (parsed == -1) {
+            return NULL;
+        }
+        if (parsed) {
+            assert(parent);
+            /* if we parsed something we have a relative path now for sure, otherwise we don't know */
+            is_relative = 1;
+
+            id += parsed;
+
+            if (!id[0]) {
+                /* the node exists, are we supposed to update it or is it default? */
+                if (!(options & LYD_PATH_OPT_UPDATE) && (!parent->dflt || (options & LYD_PATH_OPT_DFLT))) {
+                    LOGVAL(ctx, LYE_PATH_EXISTS, LY_VLOG_STR, path);
+                    return NULL;
+                }
+
+                /* no change, the default node already exists */
+                if (parent->dflt && (options & LYD_PATH_OPT_DFLT)) {
+                    return NULL;
+                }
+
+                return lyd_new_path_update(parent, value, value_type, options & LYD_PATH_OPT_DFLT);
+            }
+        }
+    }
+
+    backup_is_relative = is_relative;
+    if ((r = parse_schema_nodeid(id, &mod_name, &mod_name_len, &name, &nam_len, &is_relative, NULL, NULL, 1)) < 1) {
+        LOGVAL(ctx, LYE_PATH_INCHAR, LY_VLOG_NONE, NULL, id[-r], &id[-r]);
+        return NULL;
+    }
+
+    if (name[0] == '#') {
+        if (is_relative) {
+            LOGVAL(ctx, LYE_PATH_INCHAR, LY_VLOG_NONE, NULL, '#', name);
+            return NULL;
+        }
+        yang_data_name = name + 1;
+        yang_data_name_len = nam_len - 1;
+        backup_mod_name = mod_name;
+        backup_mod_name_len = mod_name_len;
+        /* move to the next node in the path */
+        id += r;
+    } else {
+        is_relative = backup_is_relative;
+    }
+
+    if ((r = parse_schema_nodeid(id, &mod_name, &mod_name_len, &name, &nam_len, &is_relative, &has_predicate, NULL, 0)) < 1) {
+        LOGVAL(ctx, LYE_PATH_INCHAR, LY_VLOG_NONE, NULL, id[-r], &id[-r]);
+        return NULL;
+    }
+    /* move to the next node in the path */
+    id += r;
+
+    if (backup_mod_name) {
+        mod_name = backup_mod_name;
+        mod_name_len = backup_mod_name_len;
+    }
+
+    /* prepare everything for the schema search loop */
+    if (is_relative) {
+        /* we are relative to data_tree or parent if some part of the path already exists */
+        if (!data_tree) {
+            LOGERR(ctx, LY_EINVAL, "%s: provided relative path (%s) without context node.", path);
+            return NULL;
+        } else if (!parent) {
             parent = data_tree;
         }
-        sparent = parent->schema;
-        module = prev_mod = lys_node_module(sparent);
+        sparent = parent->schema;
+        module = prev_mod = lys_node_module(sparent);
+    } else {
+        /* we are starting from scratch, absolute path */
+        assert(!parent);
+        if (!mod_name) {
+            str = strndup(path, (name + nam_len) - path);
+            LOGVAL(ctx, LYE_PATH_MISSMOD, LY_VLOG_STR, str);
+            free(str);
+            return NULL;
+        }
+
+        module = ly_ctx_nget_module(ctx, mod_name, mod_name_len, NULL, 1);
+
+        if (!module) {
+            str = strndup(path, (mod_name + mod_name_len) - path);
+            LOGVAL(ctx, LYE_PATH_INMOD, LY_VLOG_STR, str);
+            free(str);
+            return NULL;
+        }
+        mod_name = NULL;
+        mod_name_len = 0;
+        prev_mod = module;
+
+        sparent = NULL;
+        if (yang_data_name) {
+            sparent = lyp_get_yang_data_template(module, yang_data_name, yang_data_name_len);
+            if (!sparent) {
+                str = strndup(path, (yang_data_name + yang_data_name_len) - path);
+                LOGVAL(ctx, LYE_PATH_INNODE, LY_VLOG_STR, str);
+                free(str);
+                return NULL;
+            }
+        }
+    }
+
+    /* create nodes in a loop */
+    while (1) {
+        /* find the schema node */
+        schild = NULL;
+        while ((schild = lys_getnext(schild, sparent, module, 0))) {
+            if (schild->nodetype & (LYS_CONTAINER | LYS_LEAF | LYS_LEAFLIST | LYS_LIST
+                                    | LYS_ANYDATA | LYS_NOTIF | LYS_RPC | LYS_ACTION)) {
+                /* module comparison */
+                if (mod_name) {
+                    node_mod_name = lys_node_module(schild)->name;
+                    if (strncmp(node_mod_name, mod_name, mod_name_len) || node_mod_name[mod_name_len]) {
+                        continue;
+                    }
+                } else if (lys_node_module(schild) != prev_mod) {
+                    continue;
+                }
+
+                /* name check */
+                if (strncmp(schild->name, name, nam_len) || schild->name[nam_len]) {
+                    continue;
+                }
+
+                /* RPC/action in/out check */
+                for (tmp = lys_parent(schild); tmp && (tmp->nodetype == LYS_USES); tmp = lys_parent(tmp));
+                if (tmp) {
+                    if (options & LYD_PATH_OPT_OUTPUT) {
+                        if (tmp->nodetype == LYS_INPUT) {
+                            continue;
+                        }
+                    } else {
+                        if (tmp->nodetype == LYS_OUTPUT) {
+                            continue;
+                        }
+                    }
+                }
+
+                break;
+            }
+        }
+
+        if (!schild) {
+            str = strndup(path, (name + nam_len) - path);
+            LOGVAL(ctx, LYE_PATH_INNODE, LY_VLOG_STR, str);
+            free(str);
+            lyd_free(ret);
+            return NULL;
+        }
+
+        /* we have the right schema node */
+        switch (schild->nodetype) {
+        case LYS_CONTAINER:
+        case LYS_LIST:
+        case LYS_NOTIF:
+        case LYS_RPC:
+        case LYS_ACTION:
+            if (options & LYD_PATH_OPT_NOPARENT) {
+                /* these were supposed to exist */
+                str = strndup(path, (name + nam_len) - path);
+                LOGVAL(ctx, LYE_PATH_MISSPAR, LY_VLOG_STR, str);
+                free(str);
+                lyd_free(ret);
+                return NULL;
+            }
+            node = _lyd_new(is_relative ? parent : NULL, schild, (options & LYD_PATH_OPT_DFLT) ? 1 : 0);
+            break;
+        case LYS_LEAF:
+        case LYS_LEAFLIST:
+            str = NULL;
+            if (has_predicate) {
+                if ((r = parse_schema_json_predicate(id, NULL, NULL, &val_name, &val_name_len, &val, &val_len, &has_predicate)) < 1) {
+                    LOGVAL(ctx, LYE_PATH_INCHAR, LY_VLOG_NONE, NULL, id[-r], &id[-r]);
+                    lyd_free(ret);
+                    return NULL;
+                }
+                id += r;
+
+                if ((val_name[0] != '.') || (val_name_len != 1)) {
+                    LOGVAL(ctx, LYE_PATH_INCHAR, LY_VLOG_NONE, NULL, val_name[0], val_name);
+                    lyd_free(ret);
+                    return NULL;
+                }
+
+                str = strndup(val, val_len);
+                if (!str) {
+                    LOGMEM(ctx);
+                    lyd_free(ret);
+                    return NULL;
+                }
+            }
+            if (id[0]) {
+                LOGVAL(ctx, LYE_PATH_INCHAR, LY_VLOG_NONE, NULL, id[0], id);
+                free(str);
+                lyd_free(ret);
+                return NULL;
+            }
+
+            if ((options & LYD_PATH_OPT_EDIT) && schild->nodetype == LYS_LEAF) {
+                edit_leaf = 1;
+            } else {
+                edit_leaf = 0;
+            }
+            node = _lyd_new_leaf(is_relative ? parent : NULL, schild, (str ? str : value),
+                                 (options & LYD_PATH_OPT_DFLT) ? 1 : 0, edit_leaf);
+            free(str);
+            break;
+        case LYS_ANYXML:
+        case LYS_ANYDATA:
+            if (id[0]) {
+                LOGVAL(ctx, LYE_PATH_INCHAR, LY_VLOG_NONE, NULL, id[0], id);
+                lyd_free(ret);
+                return NULL;
+            }
+            if (value_type <= LYD_ANYDATA_STRING && !value) {
+                value_type = LYD_ANYDATA_CONSTSTRING;
+                value = "";
+            }
+            node = lyd_create_anydata(is_relative ? parent : NULL, schild, value, value_type);
+            break;
+        default:
+            LOGINT(ctx);
+            node = NULL;
+            break;
+        }
+
+        if (!node) {
+            str = strndup(path, id - path);
+            if (is_relative) {
+                LOGVAL(ctx, LYE_SPEC, LY_VLOG_STR, str, "Failed to create node \"%s\" as a child of \"%s\".",
+                       schild->name, parent->schema->name);
+            } else {
+                LOGVAL(ctx, LYE_SPEC, LY_VLOG_STR, str, "Failed to create node \"%s\".", schild->name);
+            }
+            free(str);
+            lyd_free(ret);
+            return NULL;
+        }
+        /* special case when we are creating a sibling of a top-level data node */
+        if (!is_relative) {
+            if (data_tree) {
+                for (; data_tree->next; data_tree = data_tree->next);
+                if (lyd_insert_after(data_tree, node)) {
+                    lyd_free(ret);
+                    return NULL;
+                }
+            }
+            is_relative = 1;
+        }
+
+        if (first_iter) {
+            /* sort if needed, but only when inserted somewhere */
+            sparent = node->schema;
+            do {
+                sparent = lys_parent(sparent);
+            } while (sparent && (sparent->nodetype != ((options & LYD_PATH_OPT_OUTPUT) ? LYS_OUTPUT : LYS_INPUT)));
+            if (sparent && lyd_schema_sort(node, 0)) {
+                lyd_free(ret);
+                return NULL;
+            }
+
+            /* set first created node */
+            ret = node;
+            first_iter = 0;
+        }
+
+        parsed = 0;
+        if ((schild->nodetype == LYS_LIST) && has_predicate && lyd_new_path_list_predicate(node, name, id, &parsed)) {
+            lyd_free(ret);
+            return NULL;
+        }
+        id += parsed;
+
+        if (!id[0]) {
+            /* we are done */
+            if (options & LYD_PATH_OPT_NOPARENTRET) {
+                /* last created node */
+                return node;
+            }
+            return ret;
+        }
+
+        /* prepare for another iteration */
+        parent = node;
+        sparent = schild;
+        prev_mod = lys_node_module(schild);
+
+        /* parse another node */
+        if ((r = parse_schema_nodeid(id, &mod_name, &mod_name_len, &name, &nam_len, &is_relative, &has_predicate, NULL, 0)) < 1) {
+            LOGVAL(ctx, LYE_PATH_INCHAR, LY_VLOG_NONE, NULL, id[-r], &id[-r]);
+            lyd_free(ret);
+            return NULL;
+        }
+        id += r;
+
+        /* if a key of a list was supposed to be created, it is created as a part of the list instance creation */
+        if ((schild->nodetype == LYS_LIST) && !mod_name) {
+            slist = (const struct lys_node_list *)schild;
+            for (i = 0; i < slist->keys_size; ++i) {
+                if (!strncmp(slist->keys[i]->name, name, nam_len) && !slist->keys[i]->name[nam_len]) {
+                    /* the path continues? there cannot be anything after a key (leaf) */
+                    if (id[0]) {
+                        LOGVAL(ctx, LYE_PATH_INCHAR, LY_VLOG_NONE, NULL, id[0], id);
+                        lyd_free(ret);
+                        return NULL;
+                    }
+                    return ret;
+                }
+            }
+        }
+    }
+
+    LOGINT(ctx);
+    return NULL;
+}
+
+struct lyd_path_template {
+    struct ly_ctx *ctx;
+    int output;                       /* whether the path is in an RPC/action output */
+    uint32_t value_count;             /* number of values needed for an instance */
+    uint16_t count;                   /* number of data nodes on the path */
+    const struct lys_node *schema[];  /* data nodes on the path, top-level first */
+};
+
+#define LYD_PATH_TMPL_NODES (LYS_CONTAINER | LYS_LIST | LYS_LEAF | LYS_LEAFLIST | LYS_ANYDATA | LYS_NOTIF | LYS_RPC \
+                             | LYS_ACTION)
+
+API struct lyd_path_template *
+lyd_path_template_compile(const struct ly_ctx *ctx, const char *path, int options)
+{
+    struct lyd_path_template *tmpl;
+    const struct lys_node *snode, *siter;
+    uint16_t count = 0, i;
+
+    if (!ctx || !path || (path[0] != '/')) {
+        LOGARG;
+        return NULL;
+    }
+
+    snode = resolve_json_nodeid(path, (struct ly_ctx *)ctx, NULL, (options & LYD_PATH_OPT_OUTPUT) ? 1 : 0);
+    if (!snode) {
+        return NULL;
+    }
+    if (!(snode->nodetype & LYD_PATH_TMPL_NODES)) {
+        LOGVAL(ctx, LYE_PATH_INNODE, LY_VLOG_STR, path);
+        return NULL;
+    }
+
+    for (siter = snode; siter; siter = lys_parent(siter)) {
+        if (siter->nodetype & LYD_PATH_TMPL_NODES) {
+            ++count;
+        }
+    }
+
+    tmpl = calloc(1, sizeof *tmpl + count * sizeof *tmpl->schema);
+    LY_CHECK_ERR_RETURN(!tmpl, LOGMEM(ctx), NULL);
+    tmpl->ctx = (struct ly_ctx *)ctx;
+    tmpl->output = (options & LYD_PATH_OPT_OUTPUT) ? 1 : 0;
+    tmpl->count = count;
+
+    i = count;
+    for (siter = snode; siter; siter = lys_parent(siter)) {
+        if (siter->nodetype & LYD_PATH_TMPL_NODES) {
+            tmpl->schema[--i] = siter;
+            if (siter->nodetype == LYS_LIST) {
+                tmpl->value_count += ((struct lys_node_list *)siter)->keys_size;
+            }
+        }
+    }
+    if (snode->nodetype & (LYS_LEAF | LYS_LEAFLIST | LYS_ANYDATA)) {
+        /* the value of the node itself */
+        ++tmpl->value_count;
+    }
+
+    return tmpl;
+}
+
+API uint32_t
+lyd_path_template_value_count(const struct lyd_path_template *tmpl)
+{
+    if (!tmpl) {
+        LOGARG;
+        return 0;
+    }
+
+    return tmpl->value_count;
+}
+
+API void
+lyd_path_template_free(struct lyd_path_template *tmpl)
+{
+    free(tmpl);
+}
+
+/* whether an instance matches the key values (the value for leaf-lists) as strings */
+static int
+lyd_values_match(const struct lyd_node *node, const char **values)
+{
+    const struct lys_node_list *slist;
+    const struct lyd_node *key;
+    uint8_t i;
+
+    switch (node->schema->nodetype) {
+    case LYS_LEAFLIST:
+        return !strcmp(((struct lyd_node_leaf_list *)node)->value_str, values[0] ? values[0] : "");
+    case LYS_LIST:
+        slist = (const struct lys_node_list *)node->schema;
+        for (i = 0, key = node->child; i < slist->keys_size; ++i, key = key->next) {
+            if (!key || (key->schema != (struct lys_node *)slist->keys[i])
+                    || strcmp(((struct lyd_node_leaf_list *)key)->value_str, values[i] ? values[i] : "")) {
+                return 0;
+            }
+        }
+        return 1;
+    default:
+        return 1;
+    }
+}
+
+#ifdef LY_ENABLED_CACHE
+
+static int
+lyd_values_equal(void *val1_p, void *val2_p, int UNUSED(mod), void *cb_data)
+{
+    struct lyd_node *val1, *val2;
+
+    val1 = *((struct lyd_node **)val1_p);
+    val2 = *((struct lyd_node **)val2_p);
+
+    return (val1->schema == val2->schema) && lyd_values_match(val2, cb_data);
+}
+
+#endif
+
+struct lyd_node *
+lyd_find_values(struct lyd_node *parent, struct lyd_node *first, const struct lys_node *schema, const char **values)
+{
+    struct lyd_node *iter;
+#ifdef LY_ENABLED_CACHE
+    struct lyd_node dummy, *dummy_p = &dummy, **match_p;
+    const struct lys_node_list *slist;
+    uint32_t hash;
+    uint8_t i;
+    int r;
+#endif
+
+    if ((schema->nodetype == LYS_LIST) && !((struct lys_node_list *)schema)->keys_size) {
+        /* every instance is a new one */
+        return NULL;
+    }
+
+#ifdef LY_ENABLED_CACHE
+    if (parent && parent->ht && !lyd_hash_user_type(schema)) {
+        /* the values are hashed as strings the same way the instances are */
+        hash = dict_hash_multi(0, lys_node_module(schema)->name, strlen(lys_node_module(schema)->name));
+        hash = dict_hash_multi(hash, schema->name, strlen(schema->name));
+        if (schema->nodetype == LYS_LEAFLIST) {
+            hash = dict_hash_multi(hash, values[0] ? values[0] : "", values[0] ? strlen(values[0]) : 0);
+        } else if (schema->nodetype == LYS_LIST) {
+            slist = (const struct lys_node_list *)schema;
+            for (i = 0; i < slist->keys_size; ++i) {
+                hash = dict_hash_multi(hash, values[i] ? values[i] : "", values[i] ? strlen(values[i]) : 0);
+            }
+        }
+        hash = dict_hash_multi(hash, NULL, 0);
+
+        dummy.schema = (struct lys_node *)schema;
+        r = lyht_find_cb(parent->ht, &dummy_p, hash, lyd_values_equal, values, (void **)&match_p);
+        return r ? NULL : *match_p;
+    }
+#else
+    (void)parent;
+#endif
+
+    LY_TREE_FOR(first, iter) {
+        if ((iter->schema == schema) && lyd_values_match(iter, values)) {
+            return iter;
+        }
+    }
+    return NULL;
+}
+
+API struct lyd_node *
+lyd_new_path_template(struct lyd_node *data_tree, const struct lyd_path_template *tmpl, const char **values,
+                      int options)
+{
+    struct lyd_node *ret = NULL, *node = NULL, *parent = NULL, *first, *iter;
+    const struct lys_node *schema, *sparent;
+    const struct lys_node_list *slist;
+    const char *value = NULL;
+    uint32_t val_idx = 0;
+    uint16_t i;
+    uint8_t k;
+
+    if (!tmpl || (!values && tmpl->value_count) || (data_tree && (lyd_node_module(data_tree)->ctx != tmpl->ctx))) {
+        LOGARG;
+        return NULL;
+    }
+    if (tmpl->schema[tmpl->count - 1]->nodetype & (LYS_LEAF | LYS_LEAFLIST | LYS_ANYDATA)) {
+        value = values[tmpl->value_count - 1];
+    }
+
+    /* find the existing part of the path */
+    for (first = data_tree; first && first->prev->next; first = first->prev);
+    for (i = 0; i < tmpl->count; ++i) {
+        schema = tmpl->schema[i];
+        node = lyd_find_values(parent, first, schema,
+                                      (schema->nodetype == LYS_LEAFLIST) ? &value : &values[val_idx]);
+        if (!node) {
+            break;
+        }
+        if (schema->nodetype == LYS_LIST) {
+            val_idx += ((struct lys_node_list *)schema)->keys_size;
+        }
+        parent = node;
+        first = (schema->nodetype & (LYS_LEAF | LYS_LEAFLIST | LYS_ANYDATA)) ? NULL : node->child;
+    }
+
+    if (i == tmpl->count) {
+        /* the node exists, are we supposed to update it or is it default? */
+        if (!(options & LYD_PATH_OPT_UPDATE) && (!node->dflt || (options & LYD_PATH_OPT_DFLT))) {
+            LOGVAL(tmpl->ctx, LYE_PATH_EXISTS, LY_VLOG_LYD, node);
+            return NULL;
+        }
+
+        /* no change, the default node already exists */
+        if (node->dflt && (options & LYD_PATH_OPT_DFLT)) {
+            return NULL;
+        }
+
+        return lyd_new_path_update(node, (void *)value, LYD_ANYDATA_CONSTSTRING, options & LYD_PATH_OPT_DFLT);
+    }
+
+    /* create the rest */
+    for (; i < tmpl->count; ++i) {
+        schema = tmpl->schema[i];
+        switch (schema->nodetype) {
+        case LYS_CONTAINER:
+        case LYS_LIST:
+        case LYS_NOTIF:
+        case LYS_RPC:
+        case LYS_ACTION:
+            if (options & LYD_PATH_OPT_NOPARENT) {
+                /* these were supposed to exist */
+                LOGVAL(tmpl->ctx, LYE_PATH_MISSPAR, LY_VLOG_LYS, schema);
+                lyd_free(ret);
+                return NULL;
+            }
+            node = _lyd_new(parent, schema, (options & LYD_PATH_OPT_DFLT) ? 1 : 0);
+            if (node && (schema->nodetype == LYS_LIST)) {
+                slist = (const struct lys_node_list *)schema;
+                for (k = 0; k < slist->keys_size; ++k, ++val_idx) {
+                    if (!_lyd_new_leaf(node, (struct lys_node *)slist->keys[k], values[val_idx], 0, 0)) {
+                        lyd_free(node);
+                        node = NULL;
+                        break;
+                    }
+                }
+                if (node && !lyd_values_match(node, &values[val_idx - slist->keys_size])) {
+                    /* the key values were not canonical, the instance may exist after all */
+                    for (iter = first; iter; iter = iter->next) {
+                        if ((iter != node) && (iter->schema == schema) && lyd_list_equal(iter, node, 0)) {
+                            break;
+                        }
+                    }
+                    if (iter) {
+                        lyd_free(node);
+                        node = parent = iter;
+                        first = iter->child;
+                        continue;
+                    }
+                }
+            }
+            break;
+        case LYS_LEAF:
+        case LYS_LEAFLIST:
+            node = _lyd_new_leaf(parent, schema, value, (options & LYD_PATH_OPT_DFLT) ? 1 : 0,
+                                 ((options & LYD_PATH_OPT_EDIT) && (schema->nodetype == LYS_LEAF)) ? 1 : 0);
+            break;
+        case LYS_ANYXML:
+        case LYS_ANYDATA:
+            node = lyd_create_anydata(parent, schema, (void *)(value ? value : ""), LYD_ANYDATA_CONSTSTRING);
+            break;
+        default:
+            LOGINT(tmpl->ctx);
+            node = NULL;
+            break;
+        }
+
+        if (!node) {
+            if (parent) {
+                LOGVAL(tmpl->ctx, LYE_SPEC, LY_VLOG_LYD, parent, "Failed to create node \"%s\" as a child of \"%s\".",
+                       schema->name, parent->schema->name);
+            } else {
+                LOGVAL(tmpl->ctx, LYE_SPEC, LY_VLOG_NONE, NULL, "Failed to create node \"%s\".", schema->name);
+            }
+            lyd_free(ret);
+            return NULL;
+        }
+
+        /* special case when we are creating a sibling of a top-level data node */
+        if (!parent && data_tree) {
+            for (iter = data_tree; iter->next; iter = iter->next);
+            if (lyd_insert_after(iter, node)) {
+                lyd_free(node);
+                return NULL;
+            }
+        }
+
+        if (!ret) {
+            /* sort if needed, but only when inserted somewhere */
+            sparent = node->schema;
+            do {
+                sparent = lys_parent(sparent);
+            } while (sparent && (sparent->nodetype != (tmpl->output ? LYS_OUTPUT : LYS_INPUT)));
+            if (sparent && lyd_schema_sort(node, 0)) {
+                lyd_free(node);
+                return NULL;
+            }
+
+            /* set first created node */
+            ret = node;
+        }
+
+        parent = node;
+        first = NULL;
+    }
+
+    if (!ret) {
+        /* the list instance existed after all */
+        if (!(options & LYD_PATH_OPT_UPDATE)) {
+            LOGVAL(tmpl->ctx, LYE_PATH_EXISTS, LY_VLOG_LYD, node);
+        }
+        return NULL;
+    }
+    if (options & LYD_PATH_OPT_NOPARENTRET) {
+        /* last created node */
+        return node;
+    }
+    return ret;
+}
+
+API unsigned int
+lyd_list_pos(const struct lyd_node *node)
+{
+    unsigned int pos;
+    struct lys_node *schema;
+    struct ly_ctx *ctx;
+    const struct lyd_node *iter, *cached = NULL;
+    uint64_t gen = 0;
+
+    if (!node || ((node->schema->nodetype != LYS_LIST) && (node->schema->nodetype != LYS_LEAFLIST))) {
+        return 0;
+    }
+
+    schema = node->schema;
+    ctx = schema->module->ctx;
+    if (!lyd_gen_frozen) {
+        gen = lyd_gen_get(ctx);
+        if ((lyd_list_pos_cache.gen == gen) && (lyd_list_pos_cache.ctx == ctx) && (lyd_list_pos_cache.schema == schema)) {
+            /* no data of the context were modified since, the previous instance position is still valid */
+            cached = lyd_list_pos_cache.node;
+        }
+    }
+
+    /* count the instances back to the first sibling or the last instance with a known position,
+     * which makes it constant for consecutive instances */
+    pos = 0;
+    iter = node;
+    do {
+        if (iter == cached) {
+            pos += lyd_list_pos_cache.pos;
+            break;
+        }
+        if (iter->schema == schema) {
+            ++pos;
+        }
+        iter = iter->prev;
+    } while (iter->next);
+
+    if (gen) {
+        lyd_list_pos_cache.node = node;
+        lyd_list_pos_cache.schema = schema;
+        lyd_list_pos_cache.ctx = ctx;
+        lyd_list_pos_cache.gen = gen;
+        lyd_list_pos_cache.pos = pos;
+    }
+    return pos;
+}
+
+struct lyd_node *
+lyd_new_dummy(struct lyd_node *root, struct lyd_node *parent, const struct lys_node *schema, const char *value, int dflt)
+{
+    unsigned int index;
+    struct ly_set *spath;
+    const struct lys_node *siter;
+    struct lyd_node *iter, *dummy = NULL;
+
+    assert(schema);
+    assert(schema->nodetype & (LYS_CONTAINER | LYS_LEAF | LYS_LIST | LYS_LEAFLIST | LYS_ANYDATA | LYS_NOTIF |
+                               LYS_RPC | LYS_ACTION));
+
+    spath = ly_set_new();
+    if (!spath) {
+        LOGMEM(schema->module->ctx);
+        return NULL;
+    }
+
+    if (!parent && root) {
+        /* find data root */
+        for (; root->parent; root = root->parent);   /* vertical move (up) */
+        for (; root->prev->next; root = root->prev); /* horizontal move (left) */
+    }
+
+    /* build schema path */
+    for (siter = schema; siter; siter = lys_parent(siter)) {
+        /* stop if we know some of the parents */
+        if (parent && parent->schema == siter) {
+            break;
+        }
+
+        if (siter->nodetype & (LYS_CONTAINER | LYS_LEAF | LYS_LIST | LYS_LEAFLIST | LYS_ANYDATA | LYS_NOTIF |
+                               LYS_RPC | LYS_ACTION)) {
+            /* we have a node that can appear in data tree */
+            ly_set_add(spath, (void*)siter, LY_SET_OPT_USEASLIST);
+        } /* else skip the rest node types */
+    }
+
+    assert(spath->number > 0);
+    index = spath->number;
+    if (!parent && !(spath->set.s[index - 1]->nodetype & LYS_LEAFLIST)) {
+        /* start by searching for the top-level parent */
+        LY_TREE_FOR(root, iter) {
+            if (iter->schema == spath->set.s[index - 1]) {
+                parent = iter;
+                index--;
+                break;
+            }
+        }
+    }
+
+    iter = parent;
+    while (iter && index && !(spath->set.s[index - 1]->nodetype & LYS_LEAFLIST)) {
+        /* search for closer parent on the path */
+        LY_TREE_FOR(parent->child, iter) {
+            if (iter->schema == spath->set.s[index - 1]) {
+                index--;
+                parent = iter;
+                break;
+            }
+        }
+    }
+    while(index) {
+        /* create the missing part of the path */
+        switch (spath->set.s[index - 1]->nodetype) {
+        case LYS_LEAF:
+        case LYS_LEAFLIST:
+            if (value) {
+                iter = _lyd_new_leaf(parent, spath->set.s[index - 1], value, dflt, 0);
+            } else {
+                iter = lyd_create_leaf(spath->set.s[index - 1], value, dflt);
+                if (iter && parent) {
+                    if (lyd_insert(parent, iter)) {
+                        lyd_free(iter);
+                        goto error;
+                    }
+                }
+            }
+            break;
+        case LYS_CONTAINER:
+        case LYS_LIST:
+            iter = _lyd_new(parent, spath->set.s[index - 1], dflt);
+            break;
+        case LYS_ANYXML:
+        case LYS_ANYDATA:
+            iter = lyd_create_anydata(parent, spath->set.s[index - 1], "", LYD_ANYDATA_CONSTSTRING);
+            break;
+        default:
+            goto error;
+        }
+        if (!iter) {
+            LOGINT(schema->module->ctx);
+            goto error;
+        }
+
+        /* we say it is valid and it is dummy */
+        iter->validity = LYD_VAL_INUSE;
+
+        if (!dummy) {
+            dummy = iter;
+        }
+
+        /* continue */
+        parent = iter;
+        index--;
+    }
+
+    ly_set_free(spath);
+
+    return dummy;
+
+error:
+    ly_set_free(spath);
+    lyd_free(dummy);
+    return NULL;
+}
+
+static struct lys_node *
+lys_find_schema_inctx(struct lys_node *schema, struct ly_ctx *ctx)
+{
+    const struct lys_module *mod, *trg_mod = NULL;
+    struct lys_node *parent, *first_sibling = NULL, *iter = NULL;
+    struct ly_set *parents;
+    unsigned int index;
+    uint32_t idx;
+    void **ptr;
+
+    if (!ctx || schema->module->ctx == ctx) {
+        /* we have the same context */
+        return schema;
+    }
+
+    /* store the parents chain */
+    parents = ly_set_new();
+    for (parent = schema; parent; parent = lys_parent(parent)) {
+        /* note - augments are skipped so we will work only with the implemented modules
+         * (where the augments are applied) */
+        if (parent->nodetype != LYS_USES) {
+            ly_set_add(parents, parent, LY_SET_OPT_USEASLIST);
+        }
+    }
+    assert(parents->number);
+    index = parents->number - 1;
+
+    /* process the parents from the top level */
+    /* for the top-level node, we have to locate the module first */
+    parent = parents->set.s[index];
+    if (parent->nodetype == LYS_EXT) {
+        ptr = lys_ext_complex_get_substmt(LY_STMT_NODE, (struct lys_ext_instance_complex *)parent, NULL);
+        if (!ptr) {
+            ly_set_free(parents);
+            return NULL;
+        }
+        first_sibling = *(struct lys_node **)ptr;
+        parent = parents->set.s[--index];
+    }
+    idx = 0;
+    while ((mod = ly_ctx_get_module_iter(ctx, &idx))) {
+        trg_mod = lys_node_module(parent);
+        /* check module name */
+        if (strcmp(mod->name, trg_mod->name)) {
+            continue;
+        }
+
+        /* check revision */
+        if ((!mod->rev_size && !trg_mod->rev_size) ||
+                (mod->rev_size && trg_mod->rev_size && !strcmp(mod->rev[0].date, trg_mod->rev[0].date))) {
+            /* we have match */
+            break;
+        }
+    }
+    /* try data callback */
+    if (!mod && trg_mod && ctx->data_clb) {
+        LOGDBG(LY_LDGYANG, "Attempting to load '%s' into context using callback ...", trg_mod->name);
+        mod = ctx->data_clb(ctx, trg_mod->name, NULL, 0, ctx->data_clb_data);
+    }
+    if (!mod) {
+        ly_set_free(parents);
+        return NULL;
+    }
+    if (!first_sibling) {
+        first_sibling = mod->data;
+    }
+
+    /* now search in the schema tree for the matching node */
+    while (1) {
+        lys_get_sibling(first_sibling, trg_mod->name, 0, parent->name, 0, parent->nodetype,
+                        (const struct lys_node **)&iter);
+        if (!iter) {
+            /* not found, iter will be used as NULL result */
+            break;
+        }
+
+        if (index == 0) {
+            /* we are done, iter is the result */
+            break;
+        } else {
+            /* we are going to continue, so update variables for the next loop */
+            first_sibling = iter->child;
+            parent = parents->set.s[--index];
+            iter = NULL;
+        }
+    }
+
+    ly_set_free(parents);
+    return iter;
+}
+
+#ifdef LY_ENABLED_CACHE
+
+/* schema node of another context mapped into the context */
+struct lys_ctx_map_rec {
+    const struct lys_node *src;
+    uint32_t src_id;            /* unique ID of the source context */
+    uint32_t src_gen;           /* schema generation of the source context */
+    uint16_t src_set_id;        /* module set ID of the source context */
+    struct lys_node *trg;
+};
+
+static int
+lys_ctx_map_val_equal(void *val1_p, void *val2_p, int UNUSED(mod), void *UNUSED(cb_data))
+{
+    struct lys_ctx_map_rec *rec1 = val1_p, *rec2 = val2_p;
+
+    return (rec1->src == rec2->src) && (rec1->src_id == rec2->src_id) && (rec1->src_gen == rec2->src_gen)
+            && (rec1->src_set_id == rec2->src_set_id);
+}
+
+static uint32_t
+lys_ctx_map_hash(const struct lys_ctx_map_rec *rec)
+{
+    uint32_t hash;
+
+    hash = dict_hash_multi(0, (const char *)&rec->src, sizeof rec->src);
+    hash = dict_hash_multi(hash, (const char *)&rec->src_id, sizeof rec->src_id);
+    return dict_hash_multi(hash, NULL, 0);
+}
+
+#endif
+
+void
+lys_ctx_map_clear(struct ly_ctx *ctx)
+{
+#ifdef LY_ENABLED_CACHE
+    pthread_rwlock_wrlock(&ctx->ctx_map_lock);
+    lyht_free(ctx->ctx_map);
+    ctx->ctx_map = NULL;
+    pthread_rwlock_unlock(&ctx->ctx_map_lock);
+#else
+    (void)ctx;
+#endif
+}
+
+/* the schema nodes of the source contexts found in the context are remembered, until the module set of either
+ * context changes, so copying data between 2 contexts does not search the schema for every node */
+static struct lys_node *
+lys_get_schema_inctx(struct lys_node *schema, struct ly_ctx *ctx)
+{
+#ifdef LY_ENABLED_CACHE
+    struct ly_ctx *src_ctx;
+    struct lys_ctx_map_rec rec, *match;
+    uint32_t hash, gen;
+    uint16_t set_id;
+
+    if (!ctx || schema->module->ctx == ctx) {
+        /* we have the same context */
+        return schema;
+    }
+
+    src_ctx = schema->module->ctx;
+    rec.src = schema;
+    rec.src_id = src_ctx->errlist_id;
+    rec.src_gen = src_ctx->schema_gen;
+    rec.src_set_id = src_ctx->models.module_set_id;
+    rec.trg = NULL;
+    hash = lys_ctx_map_hash(&rec);
+
+    pthread_rwlock_rdlock(&ctx->ctx_map_lock);
+    if (ctx->ctx_map && (ctx->ctx_map_set_id == ctx->models.module_set_id) && (ctx->ctx_map_gen == ctx->schema_gen)
+            && !lyht_find(ctx->ctx_map, &rec, hash, (void **)&match)) {
+        rec.trg = match->trg;
+    }
+    pthread_rwlock_unlock(&ctx->ctx_map_lock);
+    if (rec.trg) {
+        return rec.trg;
+    }
+
+    /* the data callback may load a module into the context, search without the lock */
+    set_id = ctx->models.module_set_id;
+    gen = ctx->schema_gen;
+    rec.trg = lys_find_schema_inctx(schema, ctx);
+    if (!rec.trg) {
+        return NULL;
+    }
+
+    pthread_rwlock_wrlock(&ctx->ctx_map_lock);
+    if (ctx->ctx_map && ((ctx->ctx_map_set_id != ctx->models.module_set_id) || (ctx->ctx_map_gen != ctx->schema_gen))) {
+        /* the mapped nodes may not even exist anymore */
+        lyht_free(ctx->ctx_map);
+        ctx->ctx_map = NULL;
+    }
+    if ((set_id == ctx->models.module_set_id) && (gen == ctx->schema_gen)) {
+        if (!ctx->ctx_map) {
+            ctx->ctx_map = lyht_new(256, sizeof rec, lys_ctx_map_val_equal, NULL, 1);
+            ctx->ctx_map_set_id = set_id;
+            ctx->ctx_map_gen = gen;
+        }
+        if (ctx->ctx_map) {
+            /* may have been mapped by another thread meanwhile */
+            lyht_insert(ctx->ctx_map, &rec, hash, NULL);
+        }
+    }
+    pthread_rwlock_unlock(&ctx->ctx_map_lock);
+
+    return rec.trg;
+#else
+    return lys_find_schema_inctx(schema, ctx);
+#endif
+}
+
+static struct lys_node *
+lyd_get_schema_inctx(const struct lyd_node *node, struct ly_ctx *ctx)
+{
+    assert(node);
+
+    return lys_get_schema_inctx(node->schema, ctx);
+}
+
+/* both target and source were validated */
+static void
+lyd_merge_node_update_value(struct lyd_node *target, struct lyd_node *source)
+{
+    struct ly_ctx *ctx;
+    struct lyd_node_leaf_list *trg_leaf, *src_leaf;
+    struct lyd_node_anydata *trg_any, *src_any;
+    int len;
+
+    assert(target->schema->nodetype & (LYS_LEAF | LYS_ANYDATA));
+    ctx = target->schema->module->ctx;
+    lyd_gen_bump(ctx);
+
+    if (ctx == source->schema->module->ctx) {
+        /* source and targets are in the same context */
+        if (target->schema->nodetype == LYS_LEAF) {
+            trg_leaf = (struct lyd_node_leaf_list *)target;
+            src_leaf = (struct lyd_node_leaf_list *)source;
+
+            lydict_remove_priv(ctx, trg_leaf->value_str, trg_leaf->value_flags & LY_VALUE_PRIVATE);
+            trg_leaf->value_str = src_leaf->value_str;
+            src_leaf->value_str = NULL;
+            trg_leaf->value_flags = (trg_leaf->value_flags & ~LY_VALUE_PRIVATE) | (src_leaf->value_flags & LY_VALUE_PRIVATE);
+            src_leaf->value_flags &= ~LY_VALUE_PRIVATE;
+            trg_leaf->value_type = src_leaf->value_type;
+            src_leaf->value_type = 0;
+            if (trg_leaf->value_type == LY_TYPE_LEAFREF) {
+                trg_leaf->validity |= LYD_VAL_LEAFREF;
+                lyp_parse_value(&((struct lys_node_leaf *)trg_leaf->schema)->type, &trg_leaf->value_str,
+                                NULL, trg_leaf, NULL, NULL, 1, src_leaf->dflt, 0);
+            } else {
+                lyd_free_value(trg_leaf->value, trg_leaf->value_type, trg_leaf->value_flags,
+                               &((struct lys_node_leaf *)trg_leaf->schema)->type, NULL, NULL, NULL);
+                trg_leaf->value = src_leaf->value;
+            }
+            src_leaf->value = (lyd_val)0;
+            trg_leaf->dflt = src_leaf->dflt;
+
+            check_leaf_list_backlinks(target, 2);
+        } else { /* ANYDATA */
+            trg_any = (struct lyd_node_anydata *)target;
+            src_any = (struct lyd_node_anydata *)source;
+
+            switch(trg_any->value_type) {
+            case LYD_ANYDATA_CONSTSTRING:
+            case LYD_ANYDATA_SXML:
+            case LYD_ANYDATA_JSON:
+                lydict_remove(ctx, trg_any->value.str);
+                break;
+            case LYD_ANYDATA_DATATREE:
+                lyd_free_withsiblings(trg_any->value.tree);
+                break;
+            case LYD_ANYDATA_XML:
+                lyxml_free_withsiblings(ctx, trg_any->value.xml);
+                break;
+            case LYD_ANYDATA_LYB:
+                free(trg_any->value.mem);
+                break;
+            case LYD_ANYDATA_STRING:
+            case LYD_ANYDATA_SXMLD:
+            case LYD_ANYDATA_JSOND:
+            case LYD_ANYDATA_LYBD:
+                /* dynamic strings are used only as input parameters */
+                assert(0);
+                break;
+            }
+
+            trg_any->value_type = src_any->value_type;
+            trg_any->value = src_any->value;
+
+            src_any->value_type = LYD_ANYDATA_DATATREE;
+            src_any->value.tree = NULL;
+        }
+    } else {
+        /* we have different contexts for the target and source */
+        if (target->schema->nodetype == LYS_LEAF) {
+            trg_leaf = (struct lyd_node_leaf_list *)target;
+            src_leaf = (struct lyd_node_leaf_list *)source;
+
+            lydict_remove_priv(ctx, trg_leaf->value_str, trg_leaf->value_flags & LY_VALUE_PRIVATE);
+            trg_leaf->value_flags &= ~LY_VALUE_PRIVATE;
+            if (!src_leaf->dflt && lyd_value_private(target->schema)) {
+                trg_leaf->value_flags |= LY_VALUE_PRIVATE;
+            }
+            trg_leaf->value_str = lydict_insert_priv(ctx, src_leaf->value_str, 0, trg_leaf->value_flags & LY_VALUE_PRIVATE);
+            lyd_free_value(trg_leaf->value, trg_leaf->value_type, trg_leaf->value_flags,
+                           &((struct lys_node_leaf *)trg_leaf->schema)->type, NULL, NULL, NULL);
+            trg_leaf->value_type = src_leaf->value_type;
+            trg_leaf->dflt = src_leaf->dflt;
+
+            switch (trg_leaf->value_type) {
+            case LY_TYPE_BINARY:
+            case LY_TYPE_STRING:
+                /* value_str pointer is shared in these cases */
+                trg_leaf->value.string = trg_leaf->value_str;
+                break;
+            case LY_TYPE_LEAFREF:
+                trg_leaf->validity |= LYD_VAL_LEAFREF;
+                lyp_parse_value(&((struct lys_node_leaf *)trg_leaf->schema)->type, &trg_leaf->value_str,
+                                NULL, trg_leaf, NULL, NULL, 1, trg_leaf->dflt, 0);
+                break;
+            case LY_TYPE_INST:
+                trg_leaf->value.instance = NULL;
+                break;
+            case LY_TYPE_UNION:
+                /* unresolved union (this must be non-validated tree), duplicate the stored string (duplicated
+                 * because of possible change of the value in case of instance-identifier) */
+                trg_leaf->value.string = lydict_insert(ctx, src_leaf->value.string, 0);
+                break;
+            case LY_TYPE_BITS:
+            case LY_TYPE_ENUM:
+            case LY_TYPE_IDENT:
+                /* in case of duplicating bits (no matter if in the same context or not) or enum and identityref into
+                 * a different context, searching for the type and duplicating the data is almost as same as resolving
+                 * the string value, so due to a simplicity, parse the value for the duplicated leaf */
+                lyp_parse_value(&((struct lys_node_leaf *)trg_leaf->schema)->type, &trg_leaf->value_str, NULL,
+                                trg_leaf, NULL, NULL, 1, trg_leaf->dflt, 1);
+                break;
+            default:
+                trg_leaf->value = src_leaf->value;
+                break;
+            }
+
+            check_leaf_list_backlinks(target, 2);
+        } else { /* ANYDATA */
+            trg_any = (struct lyd_node_anydata *)target;
+            src_any = (struct lyd_node_anydata *)source;
+
+            switch(trg_any->value_type) {
+            case LYD_ANYDATA_CONSTSTRING:
+            case LYD_ANYDATA_SXML:
+            case LYD_ANYDATA_JSON:
+                lydict_remove(ctx, trg_any->value.str);
+                break;
+            case LYD_ANYDATA_DATATREE:
+                lyd_free_withsiblings(trg_any->value.tree);
+                break;
+            case LYD_ANYDATA_XML:
+                lyxml_free_withsiblings(ctx, trg_any->value.xml);
+                break;
+            case LYD_ANYDATA_LYB:
+                free(trg_any->value.mem);
+                break;
+            case LYD_ANYDATA_STRING:
+            case LYD_ANYDATA_SXMLD:
+            case LYD_ANYDATA_JSOND:
+            case LYD_ANYDATA_LYBD:
+                /* dynamic strings are used only as input parameters */
+                assert(0);
+                break;
+            }
+
+            trg_any->value_type = src_any->value_type;
+            if ((void*)src_any->value.tree) {
+                /* there is a value to duplicate */
+                switch (trg_any->value_type) {
+                case LYD_ANYDATA_CONSTSTRING:
+                case LYD_ANYDATA_SXML:
+                case LYD_ANYDATA_JSON:
+                    trg_any->value.str = lydict_insert(ctx, src_any->value.str, 0);
+                    break;
+                case LYD_ANYDATA_DATATREE:
+                    trg_any->value.tree = lyd_dup_to_ctx(src_any->value.tree, 1, ctx);
+                    break;
+                case LYD_ANYDATA_XML:
+                    trg_any->value.xml = lyxml_dup_elem(ctx, src_any->value.xml, NULL, 1);
+                    break;
+                case LYD_ANYDATA_LYB:
+                    len = lyd_lyb_data_length(src_any->value.mem);
+                    if (len == -1) {
+                        LOGERR(ctx, LY_EINVAL, "Invalid LYB data.");
+                        return;
+                    }
+                    trg_any->value.mem = malloc(len);
+                    LY_CHECK_ERR_RETURN(!trg_any->value.mem, LOGMEM(ctx), );
+                    memcpy(trg_any->value.mem, src_any->value.mem, len);
+                    break;
+                case LYD_ANYDATA_STRING:
+                case LYD_ANYDATA_SXMLD:
+                case LYD_ANYDATA_JSOND:
+                case LYD_ANYDATA_LYBD:
+                    /* dynamic strings are used only as input parameters */
+                    assert(0);
+                    break;
+                }
+            }
+        }
+    }
+}
+
+static void
+lyd_merge_node_update(struct lyd_node *target, struct lyd_node *source)
+{
+    struct ly_ctx *ctx = target->schema->module->ctx;
+    const char *value = NULL;
+    int dflt = target->dflt;
+
+    if (!lyd_journal_active) {
+        lyd_merge_node_update_value(target, source);
+        return;
+    }
+
+    /* record only a real change */
+    if (target->schema->nodetype == LYS_LEAF) {
+        value = lydict_insert(ctx, ((struct lyd_node_leaf_list *)target)->value_str, 0);
+    }
+    lyd_merge_node_update_value(target, source);
+    if ((target->schema->nodetype != LYS_LEAF) || !ly_strequal(value, ((struct lyd_node_leaf_list *)target)->value_str, 0)
+            || (dflt && !target->dflt)) {
+        lyd_journal_changed(target, dflt && !target->dflt);
+    }
+    lydict_remove(ctx, value);
+}
+
+/* return: 0 (not equal), 1 (equal), -1 (error) */
+static int
+lyd_merge_node_schema_equal(struct lyd_node *node1, struct lyd_node *node2)
+{
+    struct lys_node *sch1;
+
+    if (node1->schema->module->ctx == node2->schema->module->ctx) {
+        if (node1->schema != node2->schema) {
+            return 0;
+        }
+    } else {
+        /* the nodes are in different contexts, get the appropriate schema nodes from the
+         * same context */
+        sch1 = lyd_get_schema_inctx(node1, node2->schema->module->ctx);
+        if (!sch1) {
+            LOGERR(node2->schema->module->ctx, LY_EINVAL, "Target context does not contain a required schema node (%s:%s).",
+                   lyd_node_module(node1)->name, node1->schema->name);
+            return -1;
+        } else if (sch1 != node2->schema) {
+            /* not matching nodes */
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+#ifdef LY_ENABLED_CACHE
+
+/**
+ * @brief Create a temporary hash table of siblings without a parent, which has no children hash table.
+ *
+ * @param[in] first First sibling.
+ * @param[out] ht Created hash table, NULL if there are not enough siblings to be worth it.
+ * @return EXIT_SUCCESS or EXIT_FAILURE.
+ */
+static int
+lyd_siblings_ht(struct lyd_node *first, struct hash_table **ht)
+{
+    struct lyd_node *iter;
+    uint16_t threshold = first->schema->module->ctx->data_ht_threshold;
+    int i;
+
+    *ht = NULL;
+    for (i = 0, iter = first; threshold && iter && (i < threshold); iter = iter->next) {
+        if ((iter->schema->nodetype != LYS_LIST) || lyd_list_has_keys(iter)) {
+            ++i;
+        }
+    }
+    if (!threshold || (i < threshold)) {
+        return EXIT_SUCCESS;
+    }
+
+    *ht = lyht_new(1, sizeof(struct lyd_node *), lyd_hash_table_val_equal, NULL, 1);
+    LY_CHECK_ERR_RETURN(!*ht, LOGMEM(first->schema->module->ctx), EXIT_FAILURE);
+    lyht_set_stats(*ht, first->schema->module->ctx);
+    LY_TREE_FOR(first, iter) {
+        if ((iter->schema->nodetype == LYS_LIST) && !lyd_list_has_keys(iter)) {
+            /* skip lists without keys */
+            continue;
+        }
+
+        if (lyht_insert(*ht, &iter, iter->hash, NULL)) {
+            LOGINT(first->schema->module->ctx);
+            lyht_free(*ht);
+            *ht = NULL;
+            return EXIT_FAILURE;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
+
+#endif
+
+/* return: 0 (not equal), 1 (equal), 2 (equal and state leaf-/list marked), -1 (error) */
+static int
+lyd_merge_node_equal(struct lyd_node *node1, struct lyd_node *node2)
+{
+    int ret;
+
+    switch (node1->schema->nodetype) {
+    case LYS_CONTAINER:
+    case LYS_LEAF:
+    case LYS_ANYXML:
+    case LYS_ANYDATA:
+    case LYS_RPC:
+    case LYS_ACTION:
+    case LYS_NOTIF:
+        return 1;
+    case LYS_LEAFLIST:
+        if (node1->validity & LYD_VAL_INUSE) {
+            /* this instance was already matched, we want to find another so that the number of the istances matches */
+            assert(node1->schema->flags & LYS_CONFIG_R);
+            return 0;
+        }
+
+        ret = lyd_list_equal(node1, node2, 1);
+        if ((ret == 1) && (node1->schema->flags & LYS_CONFIG_R)) {
+            /* mark it as matched */
+            node1->validity |= LYD_VAL_INUSE;
+            ret = 2;
+        }
+        return ret;
+    case LYS_LIST:
+        if (node1->validity & LYD_VAL_INUSE) {
+            /* this instance was already matched, we want to find another so that the number of the istances matches */
+            assert(!((struct lys_node_list *)node1->schema)->keys_size);
+            return 0;
+        }
+
+        ret = lyd_list_equal(node1, node2, 1);
+        if ((ret == 1) && !((struct lys_node_list *)node1->schema)->keys_size) {
+            /* mark it as matched */
+            node1->validity |= LYD_VAL_INUSE;
+            ret = 2;
+        }
+        return ret;
+    default:
+        break;
+    }
+
+    LOGINT(node2->schema->module->ctx);
+    return -1;
+}
+
+#ifdef LY_ENABLED_CACHE
+
+/**
+ * @brief Find the target instance of a source node in a hash table of the target siblings.
+ * The nodes must be from the same context.
+ *
+ * @param[in] ht Hash table of the target siblings.
+ * @param[in] src_elem Source node.
+ * @param[out] trg_child Found target instance, NULL if none.
+ * @return 0 (not found), 1 (found), 2 (found and state leaf-/list marked).
+ */
+static int
+lyd_merge_find_ht(struct hash_table *ht, struct lyd_node *src_elem, struct lyd_node **trg_child)
+{
+    struct lyd_node **trg_child_p;
+
+    *trg_child = NULL;
+    if (lyht_find(ht, &src_elem, src_elem->hash, (void **)&trg_child_p)) {
+        return 0;
+    }
+    *trg_child = *trg_child_p;
+
+    /* it is a bit more difficult with keyless state lists and leaf-lists */
+    if ((((*trg_child)->schema->nodetype == LYS_LIST) && !((struct lys_node_list *)(*trg_child)->schema)->keys_size)
+            || (((*trg_child)->schema->nodetype == LYS_LEAFLIST) && ((*trg_child)->schema->flags & LYS_CONFIG_R))) {
+        assert((*trg_child)->schema->flags & LYS_CONFIG_R);
+
+        while (*trg_child && ((*trg_child)->validity & LYD_VAL_INUSE)) {
+            /* state lists, find one not-already-found */
+            if (lyht_find_next(ht, trg_child, (*trg_child)->hash, (void **)&trg_child_p)) {
+                *trg_child = NULL;
+            } else {
+                *trg_child = *trg_child_p;
+            }
+        }
+        if (!*trg_child) {
+            /* actually, it was matched already and no other instance found, so now not a match */
+            return 0;
+        }
+
+        /* mark it as matched */
+        (*trg_child)->validity |= LYD_VAL_INUSE;
+        return 2;
+    }
+
+    return 1;
+}
+
+#endif
+
+/* spends source */
+static int
+lyd_merge_parent_children(struct lyd_node *target, struct lyd_node *source, int options)
+{
+    struct lyd_node *trg_parent, *src, *src_backup, *src_elem, *src_elem_backup, *src_next, *trg_child, *trg_parent_backup;
+    int ret, clear_flag = 0;
+    struct ly_ctx *ctx = target->schema->module->ctx; /* shortcut */
+
+    LY_TREE_FOR_SAFE(source, src_backup, src) {
+        for (src_elem = src_next = src, trg_parent = target;
+            src_elem;
+            src_elem = src_next) {
+
+            /* it won't get inserted in this case */
+            if (src_elem->dflt && (options & LYD_OPT_EXPLICIT)) {
+                if (src_elem == src) {
+                    /* we are done with this subtree in this case */
+                    break;
+                }
+                trg_child = (struct lyd_node *)1;
+                goto src_skip;
+            }
+
+            ret = 0;
+
+#ifdef LY_ENABLED_CACHE
+            /* trees are supposed to be validated so all nodes must have their hash, but lets not be that strict */
+            if (!src_elem->hash) {
+                lyd_hash(src_elem);
+            }
+
+            if (trg_parent->ht && (ctx == src_elem->schema->module->ctx)) {
+                ret = lyd_merge_find_ht(trg_parent->ht, src_elem, &trg_child);
+            } else
+#endif
+            {
+                LY_TREE_FOR(trg_parent->child, trg_child) {
+                    /* schema match, data match? */
+                    ret = lyd_merge_node_schema_equal(trg_child, src_elem);
+                    if (ret == 1) {
+                        ret = lyd_merge_node_equal(trg_child, src_elem);
+                    }
+                    if (ret != 0) {
+                        /* even data match */
+                        break;
+                    }
+                }
+            }
+
+            if (ret > 0) {
+                if (trg_child->schema->nodetype & (LYS_LEAF | LYS_ANYDATA)) {
+                    lyd_merge_node_update(trg_child, src_elem);
+                } else if (ret == 2) {
+                    clear_flag = 1;
+                }
+            } else if (ret == -1) {
+                /* error */
+                lyd_free_withsiblings(source);
+                return 1;
+            }
+
+            /* first prepare for the next iteration */
+            src_elem_backup = src_elem;
+            trg_parent_backup = trg_parent;
+            if (((src_elem->schema->nodetype == LYS_CONTAINER) || ((src_elem->schema->nodetype == LYS_LIST)
+                    && ((struct lys_node_list *)src_elem->schema)->keys_size)) && src_elem->child && trg_child) {
+                /* go into children */
+                src_next = src_elem->child;
+                trg_parent = trg_child;
+            } else {
+src_skip:
+                /* no children (or the whole subtree will be inserted), try siblings */
+                if (src_elem == src) {
+                    /* we are done with this subtree */
+                    if (trg_child) {
+                        /* it's an empty container, list without keys, or an already-updated leaf/anydata, nothing else to do */
+                        break;
+                    } else {
+                        /* ... but we still need to insert it */
+                        src_next = NULL;
+                        goto src_insert;
+                    }
+                } else {
+                    src_next = src_elem->next;
+                    /* trg_parent does not change */
+                }
+            }
+            while (!src_next) {
+                src_elem = src_elem->parent;
+                if (src_elem->parent == src->parent) {
+                    /* we are done, no next element to process */
+                    break;
+                }
+
+                /* parent is already processed, go to its sibling */
+                src_next = src_elem->next;
+                trg_parent = trg_parent->parent;
+            }
+
+            if (!trg_child) {
+src_insert:
+                /* we need to insert the whole subtree */
+                if (ctx == src_elem_backup->schema->module->ctx) {
+                    /* same context - unlink the subtree and insert it into the target */
+                    lyd_unlink(src_elem_backup);
+                } else {
+                    /* different contexts - before inserting subtree, instead of unlinking, duplicate it into the
+                     * target context */
+                    src_elem_backup = lyd_dup_to_ctx(src_elem_backup, 1, ctx);
+                }
+
+                if (src_elem == source) {
+                    /* it will be linked into another data tree and the pointers changed */
+                    source = source->next;
+                }
+
+                /* insert subtree into the target */
+                if (lyd_insert(trg_parent_backup, src_elem_backup)) {
+                    LOGINT(ctx);
+                    lyd_free_withsiblings(source);
+                    return 1;
+                }
+                if (src_elem == src) {
+                    /* we are finished for this src */
+                    break;
+                }
+            }
+        }
+    }
+
+    lyd_free_withsiblings(source);
+    if (clear_flag) {
+        return 2;
+    }
+    return 0;
+}
+
+/**
+ * @brief Append an unlinked node to a list of siblings without a parent. Unlike lyd_insert_after(),
+ * it does not have to find the first sibling so appending many nodes does not get quadratic.
+ *
+ * @param[in,out] first First sibling, set to \p node if NULL.
+ * @param[in] node Unlinked node to append.
+ */
+static void
+lyd_merge_append(struct lyd_node **first, struct lyd_node *node)
+{
+    assert(!node->parent && (node->prev == node));
+
+    if (!*first) {
+        *first = node;
+        return;
+    }
+
+    node->prev = (*first)->prev;
+    (*first)->prev->next = node;
+    (*first)->prev = node;
+}
+
+/* return: 0 (not found), 1 (found), 2 (found and state leaf-/list marked), -1 (error) */
+static int
+lyd_merge_find_sibling(struct lyd_node *first, struct lyd_node *src, struct lyd_node **trg)
+{
+    int ret = 0;
+
+    LY_TREE_FOR(first, *trg) {
+        ret = lyd_merge_node_schema_equal(*trg, src);
+        if (ret == 1) {
+            ret = lyd_merge_node_equal(*trg, src);
+        }
+        if (ret) {
+            break;
+        }
+    }
+
+    return ret;
+}
+
+/* spends source */
+static int
+lyd_merge_siblings(struct lyd_node *target, struct lyd_node *source, int options)
+{
+    struct lyd_node *trg, *src, *src_backup, *ins, *pending = NULL;
+    struct hash_table *ht = NULL;
+    int ret, clear_flag = 0;
+    struct ly_ctx *ctx = target->schema->module->ctx; /* shortcut */
+
+    while (target->prev->next) {
+        target = target->prev;
+    }
+
+#ifdef LY_ENABLED_CACHE
+    /* top-level siblings have no hash table, create one unless there are only a few of them */
+    if (lyd_siblings_ht(target, &ht)) {
+        lyd_free_withsiblings(source);
+        return 1;
+    }
+#endif
+
+    LY_TREE_FOR_SAFE(source, src_backup, src) {
+        trg = NULL;
+        ret = 0;
+#ifdef LY_ENABLED_CACHE
+        if (!src->hash) {
+            lyd_hash(src);
+        }
+
+        /* list instances with missing keys are not in the hash table */
+        if (ht && (ctx == src->schema->module->ctx) && ((src->schema->nodetype != LYS_LIST) || lyd_list_has_keys(src))) {
+            ret = lyd_merge_find_ht(ht, src, &trg);
+        } else
+#endif
+        {
+            ret = lyd_merge_find_sibling(target, src, &trg);
+            if (!ret && pending) {
+                /* it can also be an instance of a previous source sibling */
+                ret = lyd_merge_find_sibling(pending, src, &trg);
+            }
+        }
+
+        if (ret > 0) {
+            /* sibling found, merge it */
+            if (ret == 2) {
+                clear_flag = 1;
+            }
+
+            switch (trg->schema->nodetype) {
+            case LYS_LEAF:
+            case LYS_ANYXML:
+            case LYS_ANYDATA:
+                lyd_merge_node_update(trg, src);
+                break;
+            case LYS_LEAFLIST:
+                /* it's already there, nothing to do */
+                break;
+            case LYS_LIST:
+            case LYS_CONTAINER:
+            case LYS_NOTIF:
+            case LYS_RPC:
+            case LYS_INPUT:
+            case LYS_OUTPUT:
+                ret = lyd_merge_parent_children(trg, src->child, options);
+                if (ret == 2) {
+                    clear_flag = 1;
+                } else if (ret) {
+                    goto error;
+                }
+                break;
+            default:
+                LOGINT(ctx);
+                goto error;
+            }
+        } else if (ret == -1) {
+            goto error;
+        } else {
+            /* sibling not found, insert it */
+            if (ctx != src->schema->module->ctx) {
+                ins = lyd_dup_to_ctx(src, 1, ctx);
+                if (!ins) {
+                    goto error;
+                }
+            } else {
+                lyd_unlink(src);
+                if (src == source) {
+                    /* just so source is not freed, we inserted it and need it further */
+                    source = src_backup;
+                }
+                ins = src;
+            }
+
+            /* collect the subtrees, they are all inserted at once because every top-level insert has to find
+             * the first sibling */
+            lyd_merge_append(&pending, ins);
+
+#ifdef LY_ENABLED_CACHE
+            if (!ins->hash) {
+                lyd_hash(ins);
+            }
+            if (ht && ((ins->schema->nodetype != LYS_LIST) || lyd_list_has_keys(ins))
+                    && lyht_insert(ht, &ins, ins->hash, NULL)) {
+                LOGINT(ctx);
+                goto error;
+            }
+#endif
+        }
+    }
+
+    if (pending && lyd_insert_after(target->prev, pending)) {
+        pending = NULL;
+        goto error;
+    }
+
+#ifdef LY_ENABLED_CACHE
+    lyht_free(ht);
+#endif
+    lyd_free_withsiblings(source);
+    if (clear_flag) {
+        return 2;
+    }
+    return 0;
+
+error:
+    lyd_free_withsiblings(pending);
+#ifdef LY_ENABLED_CACHE
+    lyht_free(ht);
+#endif
+    lyd_free_withsiblings(source);
+    return 1;
+}
+
+API int
+lyd_merge_to_ctx(struct lyd_node **trg, const struct lyd_node *src, int options, struct ly_ctx *ctx)
+{
+    struct lyd_node *node = NULL, *node2, *target, *trg_merge_start, *src_merge_start = NULL, *root;
+    const struct lyd_node *iter;
+    struct lys_node *src_snode, *sch = NULL;
+    int i, src_depth, depth, first_iter, ret, dflt = 1;
+    const struct lys_node *parent = NULL;
+
+    if (!trg || !(*trg) || !src) {
+        LOGARG;
+        return -1;
+    }
+    target = *trg;
+
+    parent = lys_parent(target->schema);
+
+    /* go up all uses */
+    while (parent && (parent->nodetype == LYS_USES)) {
+        parent = lys_parent(parent);
+    }
+
+    if (parent && !lyp_get_yang_data_template_name(target)) {
+        LOGERR(parent->module->ctx, LY_EINVAL, "Target not a top-level data tree.");
+        return -1;
+    }
+
+    /* get know if we are converting data into a different context */
+    if (ctx && target->schema->module->ctx != ctx) {
+        /* target's data tree context differs from the target context, move the target
+         * data tree into the target context */
+
+        /* get the first target's top-level and store it as the result */
+        for (; target->prev->next; target = target->prev);
+        *trg = target;
+
+        for (node = NULL, trg_merge_start = target; target; target = target->next) {
+            node2 = lyd_dup_to_ctx(target, 1, ctx);
+            if (!node2) {
+                goto error;
+            }
+            lyd_merge_append(&node, node2);
+        }
+        target = node;
+        node = NULL;
+    } else if (src->schema->module->ctx != target->schema->module->ctx) {
+        /* the source data will be converted into the target's context during the merge */
+        ctx = target->schema->module->ctx;
+    } else if (ctx == src->schema->module->ctx) {
+        /* no conversion is needed */
+        ctx = NULL;
+    }
+
+    /* find source top-level schema node */
+    for (src_snode = src->schema, src_depth = 0;
+         (src_snode = lys_parent(src_snode)) && src_snode->nodetype != LYS_EXT;
+         ++src_depth);
+
+    /* find first shared missing schema parent of the subtrees */
+    trg_merge_start = target;
+    depth = 0;
+    first_iter = 1;
+    if (src_depth) {
+        /* we are going to create missing parents in the following loop,
+         * but we will need to know a dflt flag for them. In case the newly
+         * created parent is going to have at least one non-default child,
+         * it will be also non-default, otherwise it will be the default node */
+        if (options & LYD_OPT_NOSIBLINGS) {
+            dflt = src->dflt;
+        } else {
+            LY_TREE_FOR(src, iter) {
+                if (!iter->dflt) {
+                    /* non default sibling -> parent is going to be
+                     * created also as non-default */
+                    dflt = 0;
+                    break;
+                }
+            }
+        }
+    }
+    while (1) {
+        /* going from down (source root) to up (top-level or the common node with target */
+        do {
+            for (src_snode = src->schema, i = 0; i < src_depth - depth; src_snode = lys_parent(src_snode), ++i);
+            ++depth;
+        } while (src_snode != src->schema && (src_snode->nodetype & (LYS_CHOICE | LYS_CASE | LYS_USES)));
+
+        if (src_snode == src->schema) {
+            break;
+        }
+
+        if (src_snode->nodetype != LYS_CONTAINER) {
+            /* we would have to create a list (the only data node with children except container), impossible */
+            LOGERR(ctx, LY_EINVAL, "Cannot create %s \"%s\" for the merge.", strnodetype(src_snode->nodetype), src_snode->name);
+            goto error;
+        }
+
+        /* have we created any missing containers already? if we did,
+         * it is totally useless to search for match, there won't ever be */
+        if (!src_merge_start) {
+            if (first_iter) {
+                node = trg_merge_start;
+                first_iter = 0;
+            } else {
+                node = trg_merge_start->child;
+            }
+
+            /* find it in target data nodes */
+            LY_TREE_FOR(node, node) {
+                if (ctx) {
+                    /* we have the schema nodes in the different context */
+                    sch = lys_get_schema_inctx(src_snode, ctx);
+                    if (!sch) {
+                        LOGERR(ctx, LY_EINVAL, "Target context does not contain schema node for the data node being "
+                               "merged (%s:%s).", lys_node_module(src_snode)->name, src_snode->name);
+                        goto error;
+                    }
+                } else {
+                    /* the context is same and comparison of the schema nodes will works fine */
+                    sch = src_snode;
+                }
+
+                if (node->schema == sch) {
+                    trg_merge_start = node;
+                    break;
+                }
+            }
+
+            if (!(options & LYD_OPT_DESTRUCT)) {
+                /* the source tree will be duplicated, so to save some work in case
+                 * of different target context, create also the parents nodes in the
+                 * correct context */
+                src_snode = sch;
+            }
+        } else if (ctx && !(options & LYD_OPT_DESTRUCT)) {
+            /* get the schema node in the correct (target) context, same as above,
+             * this is done to save some work and have the source in the same context
+             * when the provided source tree is below duplicated in the target context
+             * and connected into the parents created here */
+            src_snode = lys_get_schema_inctx(src_snode, ctx);
+            if (!src_snode) {
+                LOGERR(ctx, LY_EINVAL, "Target context does not contain schema node for the data node being "
+                       "merged (%s:%s).", lys_node_module(src_snode)->name, src_snode->name);
+                goto error;
+            }
+        }
+
+        if (!node) {
+            /* it is not there, create it */
+            node2 = _lyd_new(NULL, src_snode, dflt);
+            if (!src_merge_start) {
+                src_merge_start = node2;
+            } else {
+                if (lyd_insert(node2, src_merge_start)) {
+                    goto error;
+                }
+                src_merge_start = node2;
+            }
+        }
+    }
+
+    /* process source according to options */
+    if (options & LYD_OPT_DESTRUCT) {
+        LY_TREE_FOR(src, iter) {
+            check_leaf_list_backlinks((struct lyd_node *)iter, 2);
+            if (options & LYD_OPT_NOSIBLINGS) {
+                break;
+            }
+        }
+
+        node = (struct lyd_node *)src;
+        if ((node->prev != node) && (options & LYD_OPT_NOSIBLINGS)) {
+            node2 = node->prev;
+            lyd_unlink(node);
+            lyd_free_withsiblings(node2);
+        }
+    } else {
+        node = NULL;
+        for (; src; src = src->next) {
+            /* because we already have to duplicate it, do it in the correct context */
+            node2 = lyd_dup_to_ctx(src, 1, ctx);
+            if (!node2) {
+                lyd_free_withsiblings(node);
+                goto error;
+            }
+            lyd_merge_append(&node, node2);
+
+            if (options & LYD_OPT_NOSIBLINGS) {
+                break;
+            }
+        }
+    }
+
+    if (src_merge_start) {
+        /* insert data into the created parents */
+        /* first, get the lowest created parent, we don't have to check the nodetype since we are
+         * creating only a simple chain of containers */
+        for (node2 = src_merge_start; node2->child; node2 = node2->child);
+        node2->child = node;
+        LY_TREE_FOR(node, node) {
+            node->parent = node2;
+        }
+    } else {
+        src_merge_start = node;
+    }
+
+    if (!first_iter) {
+        /* !! src_merge start is a child(ren) of trg_merge_start */
+        ret = lyd_merge_parent_children(trg_merge_start, src_merge_start, options);
+    } else {
+        /* !! src_merge start is a (top-level) sibling(s) of trg_merge_start */
+        ret = lyd_merge_siblings(trg_merge_start, src_merge_start, options);
+    }
+    /* it was freed whatever the return value */
+    src_merge_start = NULL;
+    if (ret == 2) {
+        /* clear remporary LYD_VAL_INUSE validation flags, all the top-level siblings could have been marked */
+        root = target;
+        if (first_iter) {
+            while (root->prev->next) {
+                root = root->prev;
+            }
+        }
+        for (; root; root = (first_iter ? root->next : NULL)) {
+            LY_TREE_DFS_BEGIN(root, node2, node) {
+                node->validity &= ~LYD_VAL_INUSE;
+                LY_TREE_DFS_END(root, node2, node);
+            }
+        }
+        ret = 0;
+    } else if (ret) {
+        goto error;
+    }
+
+    if (target->schema->nodetype == LYS_RPC) {
+        lyd_schema_sort(target, 1);
+    }
+
+    /* update the pointer to the target tree if needed */
+    if (*trg != target) {
+        lyd_free_withsiblings(*trg);
+        (*trg) = target;
+    }
+    return ret;
+
+error:
+    if (*trg != target) {
+        /* target is duplication of the original target in different context,
+         * free it due to the error */
+        lyd_free_withsiblings(target);
+    }
+    lyd_free_withsiblings(src_merge_start);
+    return -1;
+}
+
+API int
+lyd_merge(struct lyd_node *target, const struct lyd_node *source, int options)
+{
+    if (!target || !source) {
+        LOGARG;
+        return -1;
+    }
+
+    return lyd_merge_to_ctx(&target, source, options, target->schema->module->ctx);
+}
+
+/* get the operation of an edit node, \p parent_op if it has none, and remove its operation attribute */
+static LYD_EDIT_OP
+lyd_edit_op(struct lyd_node *node, LYD_EDIT_OP parent_op)
+{
+    struct lyd_attr *attr;
+    LYD_EDIT_OP op;
+
+    LY_TREE_FOR(node->attr, attr) {
+        if (!strcmp(attr->annotation->arg_value, "operation")
+                && !strcmp(attr->annotation->module->name, "ietf-netconf")) {
+            op = attr->value.enm->value;
+            lyd_free_attr(node->schema->module->ctx, node, attr, 0);
+            return op;
+        }
+    }
+
+    return parent_op;
+}
+
+/* the whole subtree is going to be created, so apply the operations of its descendants */
+static int
+lyd_edit_create(struct lyd_node *node)
+{
+    struct lyd_node *next, *child;
+
+    if (!(node->schema->nodetype & (LYS_CONTAINER | LYS_LIST))) {
+        return EXIT_SUCCESS;
+    }
+
+    LY_TREE_FOR_SAFE(node->child, next, child) {
+        switch (lyd_edit_op(child, LYD_EDIT_CREATE)) {
+        case LYD_EDIT_DELETE:
+            LOGVAL(node->schema->module->ctx, LYE_SPEC, LY_VLOG_NONE, NULL, "Node \"%s\" to be deleted does not exist.",
+                   child->schema->name);
+            return EXIT_FAILURE;
+        case LYD_EDIT_REMOVE:
+            lyd_free(child);
+            break;
+        default:
+            if (lyd_edit_create(child)) {
+                return EXIT_FAILURE;
+            }
+            break;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Apply edit siblings to the children of a target node or to the top-level target siblings.
+ *
+ * Matching target instances are found using the hash tables, the edit nodes are moved into the target
+ * instead of being duplicated. Spends \p edit.
+ *
+ * @param[in,out] first First top-level target sibling, used only if \p trg_parent is NULL.
+ * @param[in] trg_parent Target parent of the nodes to edit.
+ * @param[in] edit First edit sibling.
+ * @param[in] parent_op Operation of the edit parent.
+ * @return EXIT_SUCCESS or EXIT_FAILURE.
+ */
+static int
+lyd_edit_siblings(struct lyd_node **first, struct lyd_node *trg_parent, struct lyd_node *edit, LYD_EDIT_OP parent_op)
+{
+    struct lyd_node *elem, *next, *trg, *pending = NULL;
+    struct hash_table *ht = NULL;
+    struct ly_ctx *ctx = edit->schema->module->ctx;
+    LYD_EDIT_OP op;
+    int ret;
+
+#ifdef LY_ENABLED_CACHE
+    if (trg_parent) {
+        ht = trg_parent->ht;
+    } else if (*first && lyd_siblings_ht(*first, &ht)) {
+        lyd_free_withsiblings(edit);
+        return EXIT_FAILURE;
+    }
+#endif
+
+    LY_TREE_FOR_SAFE(edit, next, elem) {
+        lyd_unlink(elem);
+        op = lyd_edit_op(elem, parent_op);
+
+        /* find the target instance */
+        trg = NULL;
+        ret = 0;
+#ifdef LY_ENABLED_CACHE
+        if (!elem->hash) {
+            lyd_hash(elem);
+        }
+        if (ht) {
+            ret = lyd_merge_find_ht(ht, elem, &trg);
+        } else
+#endif
+        if (trg_parent || *first) {
+            ret = lyd_merge_find_sibling(trg_parent ? trg_parent->child : *first, elem, &trg);
+        }
+        if (ret == -1) {
+            goto error;
+        } else if (!ret) {
+            trg = NULL;
+        }
+
+        switch (op) {
+        case LYD_EDIT_CREATE:
+            if (trg) {
+                LOGVAL(ctx, LYE_PATH_EXISTS, LY_VLOG_LYD, trg);
+                goto error;
+            }
+            break;
+        case LYD_EDIT_MERGE:
+        case LYD_EDIT_NONE:
+            if (!trg) {
+                if (op == LYD_EDIT_NONE) {
+                    LOGVAL(ctx, LYE_SPEC, trg_parent ? LY_VLOG_LYD : LY_VLOG_NONE, trg_parent,
+                           "Node \"%s\" to be edited does not exist.", elem->schema->name);
+                    goto error;
+                }
+                break;
+            }
+
+            /* merge into the existing instance */
+            if ((trg->schema->nodetype & (LYS_LEAF | LYS_ANYDATA)) && (op == LYD_EDIT_MERGE)) {
+                lyd_merge_node_update(trg, elem);
+            } else if ((trg->schema->nodetype & (LYS_CONTAINER | LYS_LIST)) && elem->child
+                    && lyd_edit_siblings(NULL, trg, elem->child, op)) {
+                goto error;
+            }
+            lyd_free(elem);
+            continue;
+        case LYD_EDIT_DELETE:
+        case LYD_EDIT_REMOVE:
+        case LYD_EDIT_REPLACE:
+            if (!trg && (op == LYD_EDIT_DELETE)) {
+                LOGVAL(ctx, LYE_SPEC, trg_parent ? LY_VLOG_LYD : LY_VLOG_NONE, trg_parent,
+                       "Node \"%s\" to be deleted does not exist.", elem->schema->name);
+                goto error;
+            }
+
+            if (trg) {
+                if (!trg_parent) {
+#ifdef LY_ENABLED_CACHE
+                    if (ht && lyht_remove(ht, &trg, trg->hash)) {
+                        LOGINT(ctx);
+                        goto error;
+                    }
+#endif
+                    if (trg == *first) {
+                        *first = trg->next;
+                    }
+                }
+                lyd_free(trg);
+            }
+            if (op != LYD_EDIT_REPLACE) {
+                lyd_free(elem);
+                continue;
+            }
+            break;
+        }
+
+        /* the node does not exist (anymore), move the whole subtree into the target */
+        if (lyd_edit_create(elem)) {
+            goto error;
+        }
+        if (trg_parent) {
+            if (lyd_insert(trg_parent, elem)) {
+                goto error;
+            }
+        } else {
+            /* top-level siblings are inserted all at once, each insert would have to find the first sibling */
+            lyd_merge_append(&pending, elem);
+        }
+    }
+
+    if (pending) {
+        if (!*first) {
+            *first = pending;
+        } else if (lyd_insert_after((*first)->prev, pending)) {
+            pending = NULL;
+            goto error;
+        }
+    }
+
+#ifdef LY_ENABLED_CACHE
+    if (!trg_parent) {
+        lyht_free(ht);
+    }
+#endif
+    return EXIT_SUCCESS;
+
+error:
+    lyd_free(elem);
+    lyd_free_withsiblings(next);
+    lyd_free_withsiblings(pending);
+#ifdef LY_ENABLED_CACHE
+    if (!trg_parent) {
+        lyht_free(ht);
+    }
+#endif
+    return EXIT_FAILURE;
+}
+
+API int
+lyd_parse_edit(struct ly_ctx *ctx, struct lyd_node **target, const char *data, LYD_FORMAT format, int options,
+               LYD_EDIT_OP default_op)
+{
+    struct lyd_node *edit;
+
+    if (!ctx || !target || !data || ((default_op != LYD_EDIT_MERGE) && (default_op != LYD_EDIT_REPLACE)
+            && (default_op != LYD_EDIT_NONE))) {
+        LOGARG;
+        return EXIT_FAILURE;
+    }
+    if (*target && (((*target)->schema->module->ctx != ctx) || (*target)->parent)) {
+        LOGERR(ctx, LY_EINVAL, "%s: invalid parameter (target must be a top-level data tree in the same context).",
+               __func__);
+        return EXIT_FAILURE;
+    }
+    if (options & (LYD_OPT_TYPEMASK | LYD_OPT_DESTRUCT | LYD_OPT_PROJECTION)) {
+        LOGERR(ctx, LY_EINVAL, "%s: invalid options 0x%x (the data are always parsed as LYD_OPT_EDIT).", __func__,
+               options);
+        return EXIT_FAILURE;
+    }
+
+    if (*target) {
+        for (; (*target)->prev->next; *target = (*target)->prev);
+    }
+
+    ly_errno = LY_SUCCESS;
+    edit = lyd_parse_mem(ctx, data, format, options | LYD_OPT_EDIT);
+    if (!edit) {
+        return ly_errno ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+    return lyd_edit_siblings(target, NULL, edit, default_op);
+}
+
+API void
+lyd_free_diff(struct lyd_difflist *diff)
+{
+    if (diff) {
+        free(diff->type);
+        free(diff->first);
+        free(diff->second);
+        free(diff);
+    }
+}
+
+static int
+lyd_difflist_add_ctx(struct ly_ctx *ctx, struct lyd_difflist *diff, unsigned int *size, unsigned int index,
+                     LYD_DIFFTYPE type, struct lyd_node *first, struct lyd_node *second)
+{
+    void *new;
+
+    assert(diff);
+    assert(size && *size);
+
+    if (index + 1 == *size) {
+        /* it's time to enlarge */
+        *size = *size + 16;
+        new = realloc(diff->type, *size * sizeof *diff->type);
+        LY_CHECK_ERR_RETURN(!new, LOGMEM(ctx), EXIT_FAILURE);
+        diff->type = new;
+
+        new = realloc(diff->first, *size * sizeof *diff->first);
+        LY_CHECK_ERR_RETURN(!new, LOGMEM(ctx), EXIT_FAILURE);
+        diff->first = new;
+
+        new = realloc(diff->second, *size * sizeof *diff->second);
+        LY_CHECK_ERR_RETURN(!new, LOGMEM(ctx), EXIT_FAILURE);
+        diff->second = new;
+    }
+
+    /* insert the item */
+    diff->type[index] = type;
+    diff->first[index] = first;
+    diff->second[index] = second;
+
+    /* terminate the arrays */
+    index++;
+    diff->type[index] = LYD_DIFF_END;
+    diff->first[index] = NULL;
+    diff->second[index] = NULL;
+
+    return EXIT_SUCCESS;
+}
+
+static int
+lyd_difflist_add(struct lyd_difflist *diff, unsigned int *size, unsigned int index,
+                 LYD_DIFFTYPE type, struct lyd_node *first, struct lyd_node *second)
+{
+    struct ly_ctx *ctx = (first ? first->schema->module->ctx : second->schema->module->ctx);
+
+    return lyd_difflist_add_ctx(ctx, diff, size, index, type, first, second);
+}
+
+struct diff_ordered_item {
+    struct lyd_node *first;
+    struct lyd_node *second;
+    unsigned int pos2;               /* position of the second node */
+    unsigned int prev;               /* previous item in an increasing subsequence, see lyd_diff_moves() */
+};
+struct diff_ordered_pos {
+    struct lyd_node *first;
+    unsigned int pos;
+};
+struct diff_ordered {
+    struct lys_node *schema;
+    struct lyd_node *parent;
+    unsigned int count;
+    struct diff_ordered_item *items; /* array indexed by the positions in the first tree */
+    struct hash_table *pos;          /* positions of the matched instances in the first tree (diff_ordered_pos) */
+};
+
+static int
+diff_ordered_pos_equal(void *val1_p, void *val2_p, int UNUSED(mod), void *UNUSED(cb_data))
+{
+    return ((struct diff_ordered_pos *)val1_p)->first == ((struct diff_ordered_pos *)val2_p)->first;
+}
+
+static uint32_t
+diff_ordered_pos_hash(const struct lyd_node *first)
+{
+    uint32_t hash;
+
+    hash = dict_hash_multi(0, (const char *)&first, sizeof first);
+    return dict_hash_multi(hash, NULL, 0);
+}
+
+/**
+ * @brief Remember the positions of all the matched instances of a user-ordered list in the first tree
+ * so that lyd_diff_move_preprocess() does not have to count the preceding siblings for each of them.
+ *
+ * @param[in] ordered User-ordered list information.
+ * @param[in] sibling Any sibling of the instances in the first tree.
+ * @return EXIT_SUCCESS or EXIT_FAILURE.
+ */
+static int
+diff_ordered_pos_fill(struct diff_ordered *ordered, struct lyd_node *sibling)
+{
+    struct diff_ordered_pos rec;
+    struct lyd_node *iter;
+
+    ordered->pos = lyht_new(1, sizeof rec, diff_ordered_pos_equal, NULL, 1);
+    LY_CHECK_ERR_RETURN(!ordered->pos, LOGMEM(sibling->schema->module->ctx), EXIT_FAILURE);
+
+    if (sibling->parent) {
+        sibling = sibling->parent->child;
+    } else {
+        for (; sibling->prev->next; sibling = sibling->prev);
+    }
+
+    rec.pos = 0;
+    LY_TREE_FOR(sibling, iter) {
+        if ((iter->schema != ordered->schema) || !(iter->validity & LYD_VAL_INUSE)) {
+            /* skip deleted nodes */
+            continue;
+        }
+
+        rec.first = iter;
+        if (lyht_insert(ordered->pos, &rec, diff_ordered_pos_hash(iter), NULL)) {
+            LOGINT(sibling->schema->module->ctx);
+            return EXIT_FAILURE;
+        }
+        ++rec.pos;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+static int
+diff_ordset_insert(struct lyd_node *node, struct ly_set *ordset)
+{
+    unsigned int i;
+    struct diff_ordered *new_ordered, *iter;
+
+    for (i = 0; i < ordset->number; i++) {
+        iter = (struct diff_ordered *)ordset->set.g[i];
+        if (iter->schema == node->schema && iter->parent == node->parent) {
+            break;
+        }
+    }
+    if (i == ordset->number) {
+        /* not seen user-ordered list */
+        new_ordered = calloc(1, sizeof *new_ordered);
+        LY_CHECK_ERR_RETURN(!new_ordered, LOGMEM(node->schema->module->ctx), EXIT_FAILURE);
+        new_ordered->schema = node->schema;
+        new_ordered->parent = node->parent;
+
+        ly_set_add(ordset, new_ordered, LY_SET_OPT_USEASLIST);
+    }
+    ((struct diff_ordered *)ordset->set.g[i])->count++;
+
+    return EXIT_SUCCESS;
+}
+
+static void
+diff_ordset_free(struct ly_set *set)
+{
+    unsigned int i;
+    struct diff_ordered *ord;
+
+    if (!set) {
+        return;
+    }
+
+    for (i = 0; i < set->number; i++) {
+        ord = (struct diff_ordered *)set->set.g[i];
+        free(ord->items);
+        lyht_free(ord->pos);
+        free(ord);
+    }
+
+    ly_set_free(set);
+}
+
+/*
+ * -1 - error
+ *  0 - ok
+ *  1 - first and second not the same
+ */
+static int
+lyd_diff_compare(struct lyd_node *first, struct lyd_node *second, int options)
+{
+    int rc;
+
+    if (first->dflt && !(options & LYD_DIFFOPT_WITHDEFAULTS)) {
+        /* the second one cannot be default (see lyd_diff()),
+         * so the nodes differs (first one is default node) */
+        return 1;
+    }
+
+    if (first->schema->nodetype & (LYS_LEAFLIST | LYS_LIST)) {
+        if (first->validity & LYD_VAL_INUSE) {
+            /* this node was already matched, it cannot be matched twice (except for state leaf-/lists,
+             * which we want to keep the count on this way) */
+            return 1;
+        }
+
+        rc = lyd_list_equal(first, second, (options & LYD_DIFFOPT_WITHDEFAULTS ? 1 : 0));
+        if (rc == -1) {
+            return -1;
+        } else if (!rc) {
+            /* list instances differs */
+            return 1;
+        }
+        /* matches */
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Find the instance of a second tree node among the (not yet matched) first tree siblings.
+ *
+ * @param[in] elem1 First sibling in the first tree, may be NULL.
+ * @param[in] ht Hash table of \p elem1 siblings, NULL if there is none.
+ * @param[in] elem2 Second tree node.
+ * @param[in] options Diff options.
+ * @param[out] match Found instance, NULL if there is none.
+ * @return 0 on success, -1 on error.
+ */
+static int
+lyd_diff_find_match(struct lyd_node *elem1, struct hash_table *ht, struct lyd_node *elem2, int options,
+                    struct lyd_node **match)
+{
+    struct lyd_node *iter;
+    int rc;
+
+#ifdef LY_ENABLED_CACHE
+    struct lyd_node **iter_p;
+
+    if (ht) {
+        iter = NULL;
+        if (!lyht_find(ht, &elem2, elem2->hash, (void **)&iter_p)) {
+            iter = *iter_p;
+            /* we found a match */
+            if (iter->dflt && !(options & LYD_DIFFOPT_WITHDEFAULTS)) {
+                /* the second one cannot be default (see lyd_diff()),
+                 * so the nodes differs (first one is default node) */
+                iter = NULL;
+            }
+            while (iter && (iter->validity & LYD_VAL_INUSE)) {
+                /* state lists, find one not-already-found */
+                assert((iter->schema->nodetype & (LYS_LIST | LYS_LEAFLIST)) && (iter->schema->flags & LYS_CONFIG_R));
+                if (lyht_find_next(ht, &iter, iter->hash, (void **)&iter_p)) {
+                    iter = NULL;
+                } else {
+                    iter = *iter_p;
+                }
+            }
+        }
+    } else
+#else
+    (void)ht;
+#endif
+    {
+        /* search for elem2 instance in the first */
+        LY_TREE_FOR(elem1, iter) {
+            if (iter->schema != elem2->schema) {
+                continue;
+            }
+
+            /* elem2 instance found */
+            rc = lyd_diff_compare(iter, elem2, options);
+            if (rc == -1) {
+                return -1;
+            } else if (rc == 0) {
+                /* match */
+                break;
+            } /* else, continue */
+        }
+    }
+
+    *match = iter;
+    return 0;
+}
+
+/*
+ * -1 - error
+ *  0 - ok
+ */
+static int
+lyd_diff_match(struct lyd_node *first, struct lyd_node *second, struct lyd_difflist *diff, unsigned int *size,
+               unsigned int *i, struct ly_set *matchset, struct ly_set *ordset, int options)
+{
+    switch (first->schema->nodetype) {
+    case LYS_LEAFLIST:
+    case LYS_LIST:
+        /* additional work for future move matching in case of user ordered lists */
+        if (first->schema->flags & LYS_USERORDERED) {
+            diff_ordset_insert(first, ordset);
+        }
+
+        /* falls through */
+    case LYS_CONTAINER:
+        assert(!(second->validity & LYD_VAL_INUSE));
+        second->validity |= LYD_VAL_INUSE;
+        /* remember the matching node in first for keeping correct pointer in first
+         * for comparing when passing through the second tree in lyd_diff().
+         * Duplicities are not allowed actually, but they cannot happen since single
+         * node can match only one node in the other tree */
+        ly_set_add(matchset, first, LY_SET_OPT_USEASLIST);
+        break;
+    case LYS_LEAF:
+        /* check for leaf's modification */
+        if (!lyd_leaf_val_equal(first, second, 0) || ((options & LYD_DIFFOPT_WITHDEFAULTS) && (first->dflt != second->dflt))) {
+            if (lyd_difflist_add(diff, size, (*i)++, LYD_DIFF_CHANGED, first, second)) {
+               return -1;
+            }
+        }
+        break;
+    case LYS_ANYXML:
+    case LYS_ANYDATA:
+        /* check for anydata/anyxml's modification */
+        if (!lyd_anydata_equal(first, second) && lyd_difflist_add(diff, size, (*i)++, LYD_DIFF_CHANGED, first, second)) {
+            return -1;
+        }
+        break;
+    default:
+        LOGINT(first->schema->module->ctx);
+        return -1;
+    }
+
+    /* mark both that they have matching instance in the other tree */
+    assert(!(first->validity & LYD_VAL_INUSE));
+    first->validity |= LYD_VAL_INUSE;
+
+    return 0;
+}
+
+/* @brief compare if the nodes are equivalent including checking the list's keys
+ * Go through the nodes and their parents and in the case of list, compare its keys.
+ *
+ * @return 0 different, 1 equivalent
+ */
+static int
+lyd_diff_equivnode(struct lyd_node *first, struct lyd_node *second)
+{
+    struct lyd_node *iter1, *iter2;
+
+    for (iter1 = first, iter2 = second; iter1 && iter2; iter1 = iter1->parent, iter2 = iter2->parent) {
+        if (iter1->schema->module->ctx == iter2->schema->module->ctx) {
+            if (iter1->schema != iter2->schema) {
+                return 0;
+            }
+        } else {
+            if (!ly_strequal(iter1->schema->name, iter2->schema->name, 0)) {
+                /* comparing the names is fine, even if they are, in fact, 2 different nodes
+                 * with equal names, some of their parents will differ */
+                return 0;
+            }
+        }
+        if (iter1->schema->nodetype == LYS_LIST) {
+            /* compare keys */
+            if (lyd_list_equal(iter1, iter2, 0) != 1) {
+                return 0;
+            }
+        }
+    }
+
+    if (iter1 != iter2) {
+        /* we are supposed to be in root (NULL) in both trees */
+        return 0;
+    }
+
+    return 1;
+}
+
+static int
+lyd_diff_move_preprocess(struct diff_ordered *ordered, struct lyd_node *first, struct lyd_node *second)
+{
+    struct ly_ctx *ctx = first->schema->module->ctx;
+    struct diff_ordered_pos rec, *rec_p;
+    unsigned int pos;
+    char *str = NULL;
+
+    /* ordered->count was zeroed and now it is incremented with each added
+     * item's information, so it is actually position of the second node
+     */
+
+    /* get the position of the first node */
+    if (!ordered->pos && diff_ordered_pos_fill(ordered, first)) {
+        return EXIT_FAILURE;
+    }
+    rec.first = first;
+    if (lyht_find(ordered->pos, &rec, diff_ordered_pos_hash(first), (void **)&rec_p)) {
+        LOGINT(ctx);
+        return EXIT_FAILURE;
+    }
+    pos = rec_p->pos;
+    if (pos != ordered->count) {
+        LOGDBG(LY_LDGDIFF, "detected moved element \"%s\" from %d to %d (distance %d)",
+               str = lyd_path(first), pos, ordered->count, ordered->count - pos);
+        free(str);
+    }
+
+    /* store information */
+    ordered->items[pos].first = first;
+    ordered->items[pos].second = second;
+    ordered->items[pos].pos2 = ordered->count;
+    ordered->count++;
+
+    return 0;
+}
+
+/**
+ * @brief Get the moves of user-ordered instances transforming their order in the first tree into their order
+ * in the second tree. The instances forming a longest increasing subsequence of the second tree positions keep
+ * their places, every other instance is moved after its predecessor in the second tree. That is the minimal
+ * number of moves and it is found in O(n log n).
+ *
+ * @param[in] ordered User-ordered instances information.
+ * @param[in] diff Difflist to add the moves into.
+ * @param[in,out] size Allocated size of \p diff.
+ * @param[in,out] index Index of the next item in \p diff.
+ * @return EXIT_SUCCESS or EXIT_FAILURE.
+ */
+static int
+lyd_diff_moves(struct diff_ordered *ordered, struct lyd_difflist *diff, unsigned int *size, unsigned int *index)
+{
+    struct ly_ctx *ctx = ordered->schema->module->ctx;
+    struct diff_ordered_item *items = ordered->items;
+    unsigned int *tails = NULL, *order = NULL, len, lo, hi, mid, i;
+    int8_t *keep = NULL;
+    int ret = EXIT_FAILURE;
+
+    for (i = 0; (i < ordered->count) && (items[i].pos2 == i); ++i);
+    if (i == ordered->count) {
+        /* nothing changed in the order of these instances */
+        return EXIT_SUCCESS;
+    }
+
+    tails = malloc(ordered->count * sizeof *tails);
+    order = malloc(ordered->count * sizeof *order);
+    keep = calloc(ordered->count, sizeof *keep);
+    LY_CHECK_ERR_GOTO(!tails || !order || !keep, LOGMEM(ctx), cleanup);
+
+    /* tails[k] is the item ending the increasing subsequence of length k + 1 with the smallest position */
+    len = 0;
+    for (i = 0; i < ordered->count; ++i) {
+        lo = 0;
+        hi = len;
+        while (lo < hi) {
+            mid = (lo + hi) / 2;
+            if (items[tails[mid]].pos2 < items[i].pos2) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+
+        items[i].prev = lo ? tails[lo - 1] : i;
+        tails[lo] = i;
+        if (lo == len) {
+            ++len;
+        }
+    }
+
+    /* mark the instances of the subsequence */
+    for (i = tails[len - 1]; ; i = items[i].prev) {
+        keep[i] = 1;
+        if (items[i].prev == i) {
+            break;
+        }
+    }
+
+    /* move the rest in the order of the second tree, so their predecessors are always already in place */
+    for (i = 0; i < ordered->count; ++i) {
+        order[items[i].pos2] = i;
+    }
+    for (i = 0; i < ordered->count; ++i) {
+        if (keep[order[i]]) {
+            continue;
+        }
+
+        if (lyd_difflist_add(diff, size, (*index)++, LYD_DIFF_MOVEDAFTER1, items[order[i]].first,
+                             i ? items[order[i - 1]].first : NULL)) {
+            goto cleanup;
+        }
+    }
+
+    ret = EXIT_SUCCESS;
+
+cleanup:
+    free(tails);
+    free(order);
+    free(keep);
+    return ret;
+}
+
+static struct lyd_difflist *
+lyd_diff_init_difflist(struct ly_ctx *ctx, unsigned int *size)
+{
+    struct lyd_difflist *result;
+
+    result = malloc(sizeof *result);
+    LY_CHECK_ERR_RETURN(!result, LOGMEM(ctx); *size = 0, NULL);
+
+    *size = 1;
+    result->type = calloc(*size, sizeof *result->type);
+    result->first = calloc(*size, sizeof *result->first);
+    result->second = calloc(*size, sizeof *result->second);
+    if (!result->type || !result->first || !result->second) {
+        LOGMEM(ctx);
+        free(result->second);
+        free(result->first);
+        free(result->type);
+        free(result);
+        *size = 0;
+        return NULL;
+    }
+
+    return result;
+}
+
+static int
+lyd_diff_append(struct ly_ctx *ctx, struct lyd_difflist *diff, unsigned int *size, unsigned int *index,
+                struct lyd_difflist *src)
+{
+    unsigned int count;
+    void *new;
+
+    for (count = 0; src->type[count] != LYD_DIFF_END; ++count);
+    if (!count) {
+        return EXIT_SUCCESS;
+    }
+
+    if (*index + count + 1 >= *size) {
+        /* enlarge at once */
+        *size = *index + count + 1;
+        new = realloc(diff->type, *size * sizeof *diff->type);
+        LY_CHECK_ERR_RETURN(!new, LOGMEM(ctx), EXIT_FAILURE);
+        diff->type = new;
+
+        new = realloc(diff->first, *size * sizeof *diff->first);
+        LY_CHECK_ERR_RETURN(!new, LOGMEM(ctx), EXIT_FAILURE);
+        diff->first = new;
+
+        new = realloc(diff->second, *size * sizeof *diff->second);
+        LY_CHECK_ERR_RETURN(!new, LOGMEM(ctx), EXIT_FAILURE);
+        diff->second = new;
+    }
+
+    /* append including the terminating item */
+    memcpy(&diff->type[*index], src->type, (count + 1) * sizeof *diff->type);
+    memcpy(&diff->first[*index], src->first, (count + 1) * sizeof *diff->first);
+    memcpy(&diff->second[*index], src->second, (count + 1) * sizeof *diff->second);
+    *index += count;
+
+    return EXIT_SUCCESS;
+}
+
+struct lyd_diff_job {
+    struct lyd_node *first;          /* matching top-level nodes */
+    struct lyd_node *second;
+    struct lyd_difflist *diff;       /* differences of their subtrees */
+};
+
+struct lyd_diff_thread {
+    struct lyd_diff_job *jobs;       /* subtrees to be compared by the thread */
+    unsigned int count;
+    int options;
+    enum int_log_opts log_opt;       /* internal logging options of the calling thread */
+    struct ly_err_item *err;         /* errors logged by the thread */
+    int ret;
+};
+
+/**
+ * @brief Compare the subtrees of 2 matching nodes.
+ *
+ * @param[in] job Matching nodes, the differences are stored in it.
+ * @param[in] options Diff options.
+ * @return EXIT_SUCCESS or EXIT_FAILURE.
+ */
+static int
+lyd_diff_subtree(struct lyd_diff_job *job, int options)
+{
+    struct lyd_node *iter;
+    unsigned int size, index = 0;
+
+    if (job->first->child && job->second->child) {
+        job->diff = lyd_diff(job->first, job->second, options | LYD_DIFFOPT_NOSIBLINGS);
+        return job->diff ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    /* one of the nodes has no children, lyd_diff() does not accept such trees */
+    job->diff = lyd_diff_init_difflist(job->first->schema->module->ctx, &size);
+    if (!job->diff) {
+        return EXIT_FAILURE;
+    }
+    LY_TREE_FOR(job->first->child, iter) {
+        if ((!iter->dflt || (options & LYD_DIFFOPT_WITHDEFAULTS))
+                && lyd_difflist_add(job->diff, &size, index++, LYD_DIFF_DELETED, iter, NULL)) {
+            return EXIT_FAILURE;
+        }
+    }
+    LY_TREE_FOR(job->second->child, iter) {
+        if ((!iter->dflt || (options & LYD_DIFFOPT_WITHDEFAULTS))
+                && lyd_difflist_add(job->diff, &size, index++, LYD_DIFF_CREATED, job->first, iter)) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
+
+static void *
+lyd_diff_thread(void *arg)
+{
+    struct lyd_diff_thread *dt = (struct lyd_diff_thread *)arg;
+    unsigned int i;
+
+    log_opt = dt->log_opt;
+    dt->ret = EXIT_SUCCESS;
+    for (i = 0; i < dt->count; ++i) {
+        if (lyd_diff_subtree(&dt->jobs[i], dt->options)) {
+            dt->ret = EXIT_FAILURE;
+            break;
+        }
+    }
+
+    /* the errors are passed to the calling thread */
+    dt->err = ly_err_detach(dt->jobs[0].first->schema->module->ctx);
+    return NULL;
+}
+
+/**
+ * @brief Compare the matching top-level subtrees in several threads, see #LYD_DIFFOPT_PARALLEL.
+ *
+ * @param[in] first First top-level sibling of the first tree.
+ * @param[in] second First top-level sibling of the second tree.
+ * @param[in] options Diff options.
+ * @param[out] diff Differences of the trees.
+ * @return 0 on success, 1 if the trees cannot be compared this way, -1 on error.
+ */
+static int
+lyd_diff_parallel(struct lyd_node *first, struct lyd_node *second, int options, struct lyd_difflist **diff)
+{
+    struct ly_ctx *ctx = first->schema->module->ctx;
+    struct lyd_node *elem2, *iter;
+    struct lyd_difflist *result = NULL, *created = NULL;
+    struct lyd_diff_job *jobs = NULL;
+    struct lyd_diff_thread *dt = NULL;
+    struct hash_table *ht = NULL;
+    pthread_t *tids = NULL;
+    int8_t *started = NULL;
+    unsigned int size, size2, index = 0, index2 = 0, i, count = 0, thread_count, start;
+    int ret = -1;
+
+    /* moves of the top-level user-ordered instances are detected only by the full diff */
+    LY_TREE_FOR(first, iter) {
+        if ((iter->schema->nodetype & (LYS_LIST | LYS_LEAFLIST)) && (iter->schema->flags & LYS_USERORDERED)) {
+            return 1;
+        }
+    }
+    LY_TREE_FOR(second, iter) {
+        if ((iter->schema->nodetype & (LYS_LIST | LYS_LEAFLIST)) && (iter->schema->flags & LYS_USERORDERED)) {
+            return 1;
+        }
+        ++count;
+    }
+
+    result = lyd_diff_init_difflist(ctx, &size);
+    created = lyd_diff_init_difflist(ctx, &size2);
+    jobs = calloc(count, sizeof *jobs);
+    LY_CHECK_ERR_GOTO(!result || !created || !jobs, LOGMEM(ctx), cleanup);
+#ifdef LY_ENABLED_CACHE
+    if (lyd_siblings_ht(first, &ht)) {
+        goto cleanup;
+    }
+#endif
+
+    /* match the top-level nodes, the matching nodes with children are compared later */
+    count = 0;
+    LY_TREE_FOR(second, elem2) {
+        if (elem2->dflt && !(options & LYD_DIFFOPT_WITHDEFAULTS)) {
+            /* default elements could not be created or changed, just deleted */
+            continue;
+        }
+
+        if (lyd_diff_find_match(first, ht, elem2, options, &iter)) {
+            goto cleanup;
+        }
+        if (!iter) {
+            if (lyd_difflist_add(created, &size2, index2++, LYD_DIFF_CREATED, NULL, elem2)) {
+                goto cleanup;
+            }
+            continue;
+        }
+        iter->validity |= LYD_VAL_INUSE;
+
+        switch (iter->schema->nodetype) {
+        case LYS_LEAF:
+            if ((!lyd_leaf_val_equal(iter, elem2, 0) || ((options & LYD_DIFFOPT_WITHDEFAULTS) && (iter->dflt != elem2->dflt)))
+                    && lyd_difflist_add(result, &size, index++, LYD_DIFF_CHANGED, iter, elem2)) {
+                goto cleanup;
+            }
+            break;
+        case LYS_ANYXML:
+        case LYS_ANYDATA:
+            if (!lyd_anydata_equal(iter, elem2) && lyd_difflist_add(result, &size, index++, LYD_DIFF_CHANGED, iter, elem2)) {
+                goto cleanup;
+            }
+            break;
+        case LYS_CONTAINER:
+            jobs[count].first = iter;
+            jobs[count].second = elem2;
+            ++count;
+            break;
+        case LYS_LIST:
+            if (((struct lys_node_list *)iter->schema)->keys_size) {
+                jobs[count].first = iter;
+                jobs[count].second = elem2;
+                ++count;
+            }
+            /* else equal key-less list instances */
+            break;
+        default:
+            /* equal leaf-list instances */
+            break;
+        }
+    }
+
+    if (count) {
+        thread_count = (count < ctx->val_threads) ? count : ctx->val_threads;
+        dt = calloc(thread_count, sizeof *dt);
+        tids = malloc(thread_count * sizeof *tids);
+        started = calloc(thread_count, sizeof *started);
+        LY_CHECK_ERR_GOTO(!dt || !tids || !started, LOGMEM(ctx), cleanup);
+
+        /* split the subtrees into contiguous parts to keep the order of the differences */
+        for (i = 0, start = 0; i < thread_count; ++i) {
+            dt[i].jobs = &jobs[start];
+            dt[i].count = (count - start) / (thread_count - i);
+            dt[i].options = options & ~LYD_DIFFOPT_PARALLEL;
+            dt[i].log_opt = log_opt;
+            start += dt[i].count;
+        }
+
+        /* the calling thread compares the first part itself */
+        for (i = 1; i < thread_count; ++i) {
+            started[i] = pthread_create(&tids[i], NULL, lyd_diff_thread, &dt[i]) ? 0 : 1;
+        }
+        for (i = 0; i < thread_count; ++i) {
+            if (started[i]) {
+                pthread_join(tids[i], NULL);
+            } else {
+                /* the first part or a thread could not be created */
+                lyd_diff_thread(&dt[i]);
+            }
+        }
+
+        for (i = 0; i < thread_count; ++i) {
+            /* errors in the order of the subtrees */
+            ly_err_append(ctx, dt[i].err);
+            dt[i].err = NULL;
+            if (dt[i].ret) {
+                goto cleanup;
+            }
+        }
+
+        /* differences in the order of the subtrees */
+        for (i = 0; i < count; ++i) {
+            if (lyd_diff_append(ctx, result, &size, &index, jobs[i].diff)) {
+                goto cleanup;
+            }
+        }
+    }
+
+    /* deleted nodes */
+    LY_TREE_FOR(first, iter) {
+        if (iter->validity & LYD_VAL_INUSE) {
+            iter->validity &= ~LYD_VAL_INUSE;
+        } else if ((!iter->dflt || (options & LYD_DIFFOPT_WITHDEFAULTS))
+                && lyd_difflist_add(result, &size, index++, LYD_DIFF_DELETED, iter, NULL)) {
+            goto cleanup;
+        }
+    }
+
+    /* created nodes */
+    if (lyd_diff_append(ctx, result, &size, &index, created)) {
+        goto cleanup;
+    }
+
+    *diff = result;
+    result = NULL;
+    ret = 0;
+
+cleanup:
+    if (ret) {
+        /* clear the match flags */
+        LY_TREE_FOR(first, iter) {
+            iter->validity &= ~LYD_VAL_INUSE;
+        }
+    }
+    if (jobs) {
+        for (i = 0; i < count; ++i) {
+            lyd_free_diff(jobs[i].diff);
+        }
+    }
+    lyht_free(ht);
+    lyd_free_diff(result);
+    lyd_free_diff(created);
+    free(jobs);
+    free(dt);
+    free(tids);
+    free(started);
+    return ret;
+}
+
+API struct lyd_difflist *
+lyd_diff(struct lyd_node *first, struct lyd_node *second, int options)
+{
+    struct ly_ctx *ctx;
+    int rc;
+    struct lyd_node *elem1, *elem2, *iter, *aux, *parent = NULL, *next1, *next2;
+    struct lyd_difflist *result, *result2 = NULL;
+    void *new;
+    unsigned int size, size2, index = 0, index2 = 0, i, j;
+    struct matchlist_s {
+        struct matchlist_s *prev;
+        struct ly_set *match;
+        unsigned int i;
+    } *matchlist = NULL, *mlaux;
+    struct ly_set *ordset = NULL;
+    struct diff_ordered *ordered;
+    struct hash_table *top_ht = NULL;
+
+    if (!first) {
+        /* all nodes in second were created,
+         * but the second must be top level */
+        if (second && second->parent) {
+            LOGERR(second->schema->module->ctx, LY_EINVAL, "%s: \"first\" parameter is NULL and \"second\" is not top level.", __func__);
+            return NULL;
+        }
+        result = lyd_diff_init_difflist(NULL, &size);
+        LY_TREE_FOR(second, iter) {
+            if (!iter->dflt || (options & LYD_DIFFOPT_WITHDEFAULTS)) { /* skip the implicit nodes */
+                if (lyd_difflist_add(result, &size, index++, LYD_DIFF_CREATED, NULL, iter)) {
+                    goto error;
+                }
+            }
+            if (options & LYD_DIFFOPT_NOSIBLINGS) {
+                break;
+            }
+        }
+        return result;
+    } else if (!second) {
+        /* all nodes from first were deleted */
+        result = lyd_diff_init_difflist(first->schema->module->ctx, &size);
+        LY_TREE_FOR(first, iter) {
+            if (!iter->dflt || (options & LYD_DIFFOPT_WITHDEFAULTS)) { /* skip the implicit nodes */
+                if (lyd_difflist_add(result, &size, index++, LYD_DIFF_DELETED, iter, NULL)) {
+                    goto error;
+                }
+            }
+            if (options & LYD_DIFFOPT_NOSIBLINGS) {
+                break;
+            }
+        }
+        return result;
+    }
+
+    ctx = first->schema->module->ctx;
+
+    if (options & LYD_DIFFOPT_NOSIBLINGS) {
+        /* both trees must start at the same (schema) node */
+        if (first->schema != second->schema) {
+            LOGERR(ctx, LY_EINVAL, "%s: incompatible trees to compare with LYD_OPT_NOSIBLINGS option.", __func__);
+            return NULL;
+        }
+        /* use first's and second's child to make comparison the same as without LYD_OPT_NOSIBLINGS */
+        first = first->child;
+        second = second->child;
+    } else {
+        /* go to the first sibling in both trees */
+        if (first->parent) {
+            first = first->parent->child;
+        } else {
+            while (first->prev->next) {
+                first = first->prev;
+            }
+        }
+
+        if (second->parent) {
+            second = second->parent->child;
+        } else {
+            for (; second->prev->next; second = second->prev);
+        }
+
+        /* check that both has the same (schema) parent or that they are top-level nodes */
+        if ((first->parent && second->parent && first->parent->schema != second->parent->schema) ||
+                (!first->parent && first->parent != second->parent)) {
+            LOGERR(ctx, LY_EINVAL, "%s: incompatible trees with different parents.", __func__);
+            return NULL;
+        }
+    }
+    if (first == second) {
+        LOGERR(ctx, LY_EINVAL, "%s: comparing the same tree does not make sense.", __func__);
+        return NULL;
+    }
+
+    if ((options & LYD_DIFFOPT_PARALLEL) && !(options & LYD_DIFFOPT_NOSIBLINGS) && !first->parent && (ctx->val_threads > 1)) {
+        /* compare the top-level subtrees concurrently */
+        rc = lyd_diff_parallel(first, second, options, &result);
+        if (rc != 1) {
+            return rc ? NULL : result;
+        }
+    }
+
+    /* initiate resulting structure */
+    result = lyd_diff_init_difflist(ctx, &size);
+    LY_CHECK_ERR_GOTO(!result, , error);
+
+    /* the records about created and moved items are created in
+     * bad order, so the records about created nodes (and their
+     * possible moving) is stored separately and added to the
+     * main result at the end.
+     */
+    result2 = lyd_diff_init_difflist(ctx, &size2);
+    LY_CHECK_ERR_GOTO(!result2, , error);
+
+    matchlist = malloc(sizeof *matchlist);
+    LY_CHECK_ERR_GOTO(!matchlist, LOGMEM(ctx), error);
+
+    matchlist->i = 0;
+    matchlist->match = ly_set_new();
+    matchlist->prev = NULL;
+
+    ordset = ly_set_new();
+    LY_CHECK_ERR_GOTO(!ordset, , error);
+
+#ifdef LY_ENABLED_CACHE
+    if (first && !first->parent && lyd_siblings_ht(first, &top_ht)) {
+        /* top-level nodes have no parent with the children hash table */
+        goto error;
+    }
+#endif
+
+    /*
+     * compare trees
+     */
+    /* 1) newly created nodes + changed leafs/anyxmls */
+    next1 = first;
+    for (elem2 = next2 = second; elem2; elem2 = next2) {
+        /* keep right pointer for searching in the first tree */
+        elem1 = next1;
+
+        if (elem2->dflt && !(options & LYD_DIFFOPT_WITHDEFAULTS)) {
+            /* skip default elements, they could not be created or changed, just deleted */
+            goto cmp_continue;
+        }
+
+        if (lyd_diff_find_match(elem1, (elem1 && elem1->parent) ? elem1->parent->ht : top_ht, elem2, options, &iter)) {
+            goto error;
+        }
+
+        /* we have a match */
+        if (iter && lyd_diff_match(iter, elem2, result, &size, &index, matchlist->match, ordset, options)) {
+            goto error;
+        }
+
+        if (!iter) {
+            /* elem2 not found in the first tree */
+            if (lyd_difflist_add(result2, &size2, index2++, LYD_DIFF_CREATED, elem1 ? elem1->parent : parent, elem2)) {
+                goto error;
+            }
+
+            if (elem1 && (elem2->schema->flags & LYS_USERORDERED)) {
+                /* store the correct place where the node is supposed to be moved after creation */
+                /* if elem1 does not exist, all nodes were created and they will be created in
+                 * correct order, so it is not needed to detect moves */
+                for (aux = elem2->prev; aux->next; aux = aux->prev) {
+                    if (aux->schema == elem2->schema) {
+                        /* predecessor found */
+                        break;
+                    }
+                }
+                if (!aux->next) {
+                    /* predecessor not found */
+                    aux = NULL;
+                }
+                if (lyd_difflist_add(result2, &size2, index2++, LYD_DIFF_MOVEDAFTER2, aux, elem2)) {
+                    goto error;
+                }
+            }
+        }
+
+cmp_continue:
+        /* select element for the next run                                    1     2
+         * - first, process all siblings of a single parent                  / \   / \
+         * - then, go to children (deep)                                    3   4 7   8
+         * - return to the parent's next sibling children                  / \
+         *                                                                5   6
+         */
+        /* siblings first */
+        next1 = elem1;
+        next2 = elem2->next;
+
+        if (!next2) {
+            /* children */
+
+            /* first pass of the siblings done, some additional work for future
+             * detection of move may be needed */
+            for (i = ordset->number; i > 0; i--) {
+                ordered = (struct diff_ordered *)ordset->set.g[i - 1];
+                if (ordered->items) {
+                    /* already preprocessed ordered structure */
+                    break;
+                }
+                ordered->items = calloc(ordered->count, sizeof *ordered->items);
+                LY_CHECK_ERR_GOTO(!ordered->items, LOGMEM(ctx), error);
+                /* zero the count to be used as a node position in lyd_diff_move_preprocess() */
+                ordered->count = 0;
+            }
+
+            /* first, get the first sibling */
+            if (elem2->parent == second->parent) {
+                elem2 = second;
+            } else {
+                elem2 = elem2->parent->child;
+            }
+
+            /* and then find the first child */
+            LY_TREE_FOR(elem2, iter) {
+                if (!(iter->validity & LYD_VAL_INUSE)) {
+                    /* the iter is not present in both trees */
+                    continue;
+                } else if (matchlist->i == matchlist->match->number) {
+                    if (iter == elem2) {
+                        /* we already went through all the matching nodes and now we are just supposed to stop
+                         * the loop with no iter */
+                        iter = NULL;
+                        break;
+                    } else {
+                        /* we have started with some not processed data in matchlist, but now we have
+                         * the INUSE iter and no nodes in matchlist to find its equivalent,
+                         * so something went wrong somewhere */
+                        LOGINT(ctx);
+                        goto error;
+                    }
+                }
+
+                iter->validity &= ~LYD_VAL_INUSE;
+                if ((iter->schema->nodetype & (LYS_LEAFLIST | LYS_LIST)) && (iter->schema->flags & LYS_USERORDERED)) {
+                    for (j = ordset->number; j > 0; j--) {
+                        ordered = (struct diff_ordered *)ordset->set.g[j - 1];
+                        if (ordered->schema != iter->schema || !lyd_diff_equivnode(ordered->parent, iter->parent)) {
+                            continue;
+                        }
+
+                        /* store necessary information for move detection */
+                        lyd_diff_move_preprocess(ordered, matchlist->match->set.d[matchlist->i], iter);
+                        break;
+                    }
+                }
+
+                if (((iter->schema->nodetype == LYS_CONTAINER) || ((iter->schema->nodetype == LYS_LIST)
+                        && ((struct lys_node_list *)iter->schema)->keys_size)) && iter->child) {
+                    while (matchlist->i < matchlist->match->number && matchlist->match->set.d[matchlist->i]->schema != iter->schema) {
+                        matchlist->i++;
+                    }
+                    if (matchlist->i == matchlist->match->number) {
+                        /* we have the INUSE iter, so we have to find its equivalent in match list */
+                        LOGINT(ctx);
+                        goto error;
+                    }
+                    next1 = matchlist->match->set.d[matchlist->i]->child;
+                    if (!next1) {
+                        parent = matchlist->match->set.d[matchlist->i];
+                    }
+                    matchlist->i++;
+                    next2 = iter->child;
+                    break;
+                }
+                matchlist->i++;
+            }
+
+            if (!iter) {
+                /* no child/data on next level */
+                if (elem2 == second) {
+                    /* done */
+                    break;
+                }
+            } else {
+                /* create new matchlist item */
+                mlaux = malloc(sizeof *mlaux);
+                LY_CHECK_ERR_GOTO(!mlaux, LOGMEM(ctx), error);
+                mlaux->i = 0;
+                mlaux->match = ly_set_new();
+                mlaux->prev = matchlist;
+                matchlist = mlaux;
+            }
+        }
+
+        while (!next2) {
+            /* parent */
+
+            /* clean the last match set */
+            ly_set_clean(matchlist->match);
+            matchlist->i = 0;
+
+            /* try to go to a cousin - child of the next parent's sibling */
+            mlaux = matchlist->prev;
+            LY_TREE_FOR(elem2->parent->next, iter) {
+                if (!(iter->validity & LYD_VAL_INUSE)) {
+                    continue;
+                } else if (mlaux->i == mlaux->match->number) {
+                    if (iter == elem2->parent->next) {
+                        /* we already went through all the matching nodes and now we are just supposed to stop
+                         * the loop with no iter */
+                        iter = NULL;
+                        break;
+                    } else {
+                        /* we have started with some not processed data in matchlist, but now we have
+                         * the INUSE iter and no nodes in matchlist to find its equivalent,
+                         * so something went wrong somewhere */
+                        LOGINT(ctx);
+                        goto error;
+                    }
+                }
+
+                iter->validity &= ~LYD_VAL_INUSE;
+                if ((iter->schema->nodetype & (LYS_LEAFLIST | LYS_LIST)) && (iter->schema->flags & LYS_USERORDERED)) {
+                    for (j = ordset->number ; j > 0; j--) {
+                        ordered = (struct diff_ordered *)ordset->set.g[j - 1];
+                        if (ordered->schema != iter->schema || !lyd_diff_equivnode(ordered->parent, iter->parent)) {
+                            continue;
+                        }
+
+                        /* store necessary information for move detection */
+                        lyd_diff_move_preprocess(ordered, mlaux->match->set.d[mlaux->i], iter);
+                        break;
+                    }
+                }
+
+                if (((iter->schema->nodetype == LYS_CONTAINER) || ((iter->schema->nodetype == LYS_LIST)
+                        && ((struct lys_node_list *)iter->schema)->keys_size)) && iter->child) {
+                    while (mlaux->i < mlaux->match->number && mlaux->match->set.d[mlaux->i]->schema != iter->schema) {
+                        mlaux->i++;
+                    }
+                    if (mlaux->i == mlaux->match->number) {
+                        /* we have the INUSE iter, so we have to find its equivalent in match list */
+                        LOGINT(ctx);
+                        goto error;
+                    }
+                    next1 = mlaux->match->set.d[mlaux->i]->child;
+                    if (!next1) {
+                        parent = mlaux->match->set.d[mlaux->i];
+                    }
+                    mlaux->i++;
+                    next2 = iter->child;
+                    break;
+                }
+                mlaux->i++;
+            }
+
+            /* if no cousin exists, continue next loop on higher level */
+            if (!iter) {
+                elem2 = elem2->parent;
+
+                /* remove matchlist item */
+                ly_set_free(matchlist->match);
+                mlaux = matchlist;
+                matchlist = matchlist->prev;
+                free(mlaux);
+
+                if (!matchlist->prev) { /* elem2->parent == second->parent */
+                    /* done */
+                    break;
+                }
+            }
+        }
+    }
+
+    ly_set_free(matchlist->match);
+    free(matchlist);
+    matchlist = NULL;
+
+    /* 2) deleted nodes */
+    LY_TREE_DFS_BEGIN(first, next1, elem1) {
+        /* search for elem1s deleted in the second */
+        if (elem1->validity & LYD_VAL_INUSE) {
+            /* erase temporary LYD_VAL_INUSE flag and continue into children */
+            elem1->validity &= ~LYD_VAL_INUSE;
+        } else if (!elem1->dflt || (options & LYD_DIFFOPT_WITHDEFAULTS)) {
+            /* elem1 has no matching node in second, add it into result */
+            if (lyd_difflist_add(result, &size, index++, LYD_DIFF_DELETED, elem1, NULL)) {
+                goto error;
+            }
+
+            /* skip subtree processing of data missing in the second tree */
+            goto dfs_nextsibling;
+        }
+
+        /* modified LY_TREE_DFS_END() */
+        /* select element for the next run - children first */
+        if ((elem1->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST | LYS_ANYDATA)) || ((elem1->schema->nodetype == LYS_LIST)
+                && !((struct lys_node_list *)elem1->schema)->keys_size)) {
+            next1 = NULL;
+        } else {
+            next1 = elem1->child;
+        }
+        if (!next1) {
+dfs_nextsibling:
+            /* try siblings */
+            next1 = elem1->next;
+        }
+        while (!next1) {
+            /* parent is already processed, go to its sibling */
+
+            elem1 = elem1->parent;
+            if (elem1 == first->parent) {
+                /* we are done, no next element to process */
+                break;
+            }
+
+            next1 = elem1->next;
+        }
+    }
+
+    /* 3) moved nodes (when user-ordered) */
+    for (i = 0; i < ordset->number; i++) {
+        ordered = (struct diff_ordered *)ordset->set.g[i];
+        if (lyd_diff_moves(ordered, result, &size, &index)) {
+            goto error;
+        }
+    }
+
+    diff_ordset_free(ordset);
+    ordset = NULL;
+    lyht_free(top_ht);
+    top_ht = NULL;
+
+    if (index2) {
+        /* append result2 with newly created
+         * (and possibly moved) nodes */
+        if (index + index2 + 1 >= size) {
+            /* result must be enlarged */
+            size = index + index2 + 1;
+            new = realloc(result->type, size * sizeof *result->type);
+            LY_CHECK_ERR_GOTO(!new, LOGMEM(ctx), error);
+            result->type = new;
+
+            new = realloc(result->first, size * sizeof *result->first);
+            LY_CHECK_ERR_GOTO(!new, LOGMEM(ctx), error);
+            result->first = new;
+
+            new = realloc(result->second, size * sizeof *result->second);
+            LY_CHECK_ERR_GOTO(!new, LOGMEM(ctx), error);
+            result->second = new;
+        }
+
+        /* append */
+        memcpy(&result->type[index], result2->type, (index2 + 1) * sizeof *result->type);
+        memcpy(&result->first[index], result2->first, (index2 + 1) * sizeof *result->first);
+        memcpy(&result->second[index], result2->second, (index2 + 1) * sizeof *result->second);
+    }
+    lyd_free_diff(result2);
+
+    return result;
+
+error:
+    while (matchlist) {
+        mlaux = matchlist;
+        matchlist = mlaux->prev;
+        ly_set_free(mlaux->match);
+        free(mlaux);
+
+    }
+    diff_ordset_free(ordset);
+    lyht_free(top_ht);
+
+    lyd_free_diff(result);
+    lyd_free_diff(result2);
+
+    return NULL;
+}
+
+static void
+lyd_insert_setinvalid(struct lyd_node *node)
+{
+    struct lyd_node *next, *elem, *parent_list;
+
+    assert(node);
+
+    /* overall validity of the node itself */
+    node->validity = ly_new_node_validity(node->schema);
+
+    /* explore changed unique leaves */
+    /* first, get know if there is a list in parents chain */
+    for (parent_list = node->parent;
+         parent_list && parent_list->schema->nodetype != LYS_LIST;
+         parent_list = parent_list->parent);
+    if (parent_list && !(parent_list->validity & LYD_VAL_UNIQUE)) {
+        /* there is a list, so check if we inserted a leaf supposed to be unique */
+        for (elem = node; elem; elem = next) {
+            if (elem->schema->nodetype == LYS_LIST) {
+                /* stop searching to the depth, children would be unique to a list in subtree */
+                goto nextsibling;
+            }
+
+            if (elem->schema->nodetype == LYS_LEAF && (elem->schema->flags & LYS_UNIQUE)) {
+                /* set flag to list for future validation */
+                parent_list->validity |= LYD_VAL_UNIQUE;
+                break;
+            }
+
+            if (elem->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST | LYS_ANYDATA)) {
+                if (elem == node) {
+                    /* stop the loop */
+                    break;
+                }
+                goto nextsibling;
+            }
+
+            /* select next elem to process */
+            /* go into children */
+            next = elem->child;
+            /* go through siblings */
+            if (!next) {
+nextsibling:
+                next = elem->next;
+                if (!next) {
+                    /* no sibling */
+                    if (elem == node) {
+                        /* we are done, back in start node */
+                        break;
+                    }
+                }
+            }
+            /* go back to parents */
+            while (!next) {
+                elem = elem->parent;
+                if (elem->parent == node->parent) {
+                    /* we are done, back in start node */
+                    break;
+                }
+                /* parent was actually already processed, so go to the parent's sibling */
+                next = elem->parent->next;
+            }
+        }
+    }
+
+    if (node->parent) {
+        /* if the inserted node is list/leaflist with constraint on max instances,
+         * invalidate the parent to make it validate this */
+        if (node->schema->nodetype & LYS_LEAFLIST) {
+            if (((struct lys_node_leaflist *)node->schema)->max) {
+                node->parent->validity |= LYD_VAL_MAND;
+            }
+        } else if (node->schema->nodetype & LYS_LIST) {
+            if (((struct lys_node_list *)node->schema)->max) {
+                node->parent->validity |= LYD_VAL_MAND;
+            }
+        }
+    }
+}
+
+static void
+lyd_replace(struct lyd_node *orig, struct lyd_node *repl, int destroy)
+{
+    struct lyd_node *iter, *last;
+
+    lyd_gen_bump(orig->schema->module->ctx);
+
+    if (!repl) {
+        /* remove the old one */
+        goto finish;
+    }
+
+    if (repl->parent || repl->prev->next) {
+        /* isolate the new node */
+        repl->next = NULL;
+        repl->prev = repl;
+        last = repl;
     } else {
-        /* we are starting from scratch, absolute path */
-        assert(!parent);
-        if (!mod_name) {
-            str = strndup(path, (name + nam_len) - path);
-            LOGVAL(ctx, LYE_PATH_MISSMOD, LY_VLOG_STR, str);
-            free(str);
-            return NULL;
+        /* get the last node of a possible list of nodes to be inserted */
+        for(last = repl; last->next; last = last->next) {
+            /* part of the parent changes */
+            last->parent = orig->parent;
+        }
+    }
+
+    /* parent */
+    if (orig->parent) {
+        if (orig->parent->child == orig) {
+            orig->parent->child = repl;
+        }
+        orig->parent = NULL;
+    }
+
+    /* predecessor */
+    if (orig->prev == orig) {
+        /* the old was alone */
+        goto finish;
+    }
+    if (orig->prev->next) {
+        orig->prev->next = repl;
+    }
+    repl->prev = orig->prev;
+    orig->prev = orig;
+
+    /* successor */
+    if (orig->next) {
+        orig->next->prev = last;
+        last->next = orig->next;
+        orig->next = NULL;
+    } else {
+        /* fix the last pointer */
+        if (repl->parent) {
+            repl->parent->child->prev = last;
+        } else {
+            /* get the first sibling */
+            for (iter = repl; iter->prev != orig; iter = iter->prev);
+            iter->prev = last;
+        }
+    }
+
+finish:
+    /* remove the old one */
+    if (destroy) {
+        lyd_free(orig);
+    }
+}
+
+static uint32_t lys_module_pos(struct lys_module *module);
+
+#ifdef LY_ENABLED_CACHE
+
+/**
+ * @brief Find the sibling a node is to be inserted before to keep the siblings in the schema order
+ * (with #LY_CTX_SORTED_INSERT). The siblings are searched from the last one so that inserting in the schema
+ * order costs a single comparison.
+ *
+ * @param[in] start First sibling.
+ * @param[in] ins Node to insert.
+ * @return Sibling to insert \p ins before, NULL to append it.
+ */
+static struct lyd_node *
+lyd_insert_sorted_next(struct lyd_node *start, struct lyd_node *ins)
+{
+    struct lyd_node *iter, *next = NULL;
+    struct lys_module *mod, *iter_mod;
+    uint32_t mpos = 0;
+    uint8_t key;
+
+    if (!ins->schema->pos || ((ins->schema->nodetype == LYS_LEAF) && lys_is_key((struct lys_node_leaf *)ins->schema, &key))) {
+        /* position not known or a list key placed on its own */
+        return NULL;
+    }
+    mod = lyd_node_module(ins);
+
+    iter = start->prev;
+    do {
+        if ((iter->schema->nodetype == LYS_LEAF) && iter->parent && (iter->parent->schema->nodetype == LYS_LIST)
+                && lys_is_key((struct lys_node_leaf *)iter->schema, &key)) {
+            /* list keys always stay first */
+            break;
+        }
+
+        iter_mod = lyd_node_module(iter);
+        if (iter_mod != mod) {
+            if (!mpos) {
+                mpos = lys_module_pos(mod);
+            }
+            if (lys_module_pos(iter_mod) < mpos) {
+                break;
+            }
+        } else if (!iter->schema->pos || (iter->schema->pos <= ins->schema->pos)) {
+            break;
+        }
+
+        next = iter;
+        iter = iter->prev;
+    } while (next != start);
+
+    return next;
+}
+
+#endif
+
+int
+lyd_insert_common(struct lyd_node *parent, struct lyd_node **sibling, struct lyd_node *node, int invalidate)
+{
+    struct lys_node *par1, *par2;
+    const struct lys_node *siter;
+    struct lyd_node *start, *iter, *ins, *next1, *next2;
+    int invalid = 0, isrpc = 0, clrdflt = 0;
+    struct ly_set *llists = NULL;
+    int i;
+    uint8_t pos;
+    int stype = LYS_INPUT | LYS_OUTPUT;
+
+    assert(parent || sibling);
+
+    /* get first sibling */
+    if (parent) {
+        start = parent->child;
+    } else {
+        for (start = *sibling; start->prev->next; start = start->prev);
+    }
+
+    /* check placing the node to the appropriate place according to the schema */
+    if (!start) {
+        if (!parent) {
+            /* empty tree to insert */
+            if (node->parent || node->prev->next) {
+                /* unlink the node first */
+                lyd_unlink_internal(node, 1);
+            } /* else insert also node's siblings */
+            *sibling = node;
+            return EXIT_SUCCESS;
+        }
+        par1 = parent->schema;
+        if (par1->nodetype & (LYS_RPC | LYS_ACTION)) {
+            /* it is not clear if the tree being created is going to
+             * be rpc (LYS_INPUT) or rpc-reply (LYS_OUTPUT) so we have to
+             * compare against LYS_RPC or LYS_ACTION in par2
+             */
+            stype = LYS_RPC | LYS_ACTION;
+        }
+    } else if (parent && (parent->schema->nodetype & (LYS_RPC | LYS_ACTION))) {
+        par1 = parent->schema;
+        stype = LYS_RPC | LYS_ACTION;
+    } else {
+        for (par1 = lys_parent(start->schema);
+             par1 && !(par1->nodetype & (LYS_CONTAINER | LYS_LIST | LYS_INPUT | LYS_OUTPUT | LYS_NOTIF));
+             par1 = lys_parent(par1));
+    }
+    for (par2 = lys_parent(node->schema);
+         par2 && !(par2->nodetype & (LYS_CONTAINER | LYS_LIST | stype | LYS_NOTIF));
+         par2 = lys_parent(par2));
+    if (par1 != par2) {
+        LOGERR(parent->schema->module->ctx, LY_EINVAL, "Cannot insert, different parents (\"%s\" and \"%s\").",
+               (par1 ? par1->name : "<top-lvl>"), (par2 ? par2->name : "<top-lvl>"));
+        return EXIT_FAILURE;
+    }
+    lyd_gen_bump(node->schema->module->ctx);
+
+    if (invalidate) {
+        invalid = isrpc = lyp_is_rpc_action(node->schema);
+        if (!parent || node->parent != parent || isrpc) {
+            /* it is not just moving under a parent node or it is in an RPC where
+             * nodes order matters, so the validation will be necessary */
+            invalid++;
         }
+    }
 
-        module = ly_ctx_nget_module(ctx, mod_name, mod_name_len, NULL, 1);
+    /* unlink only if it is not a list of siblings without a parent and node is not the first sibling */
+    if (node->parent || node->prev->next) {
+        /* do it permanent if the parents are not exact same or if it is top-level */
+        lyd_unlink_internal(node, invalid);
+    }
 
-        if (!module) {
-            str = strndup(path, (mod_name + mod_name_len) - path);
-            LOGVAL(ctx, LYE_PATH_INMOD, LY_VLOG_STR, str);
-            free(str);
-            return NULL;
-        }
-        mod_name = NULL;
-        mod_name_len = 0;
-        prev_mod = module;
+    llists = ly_set_new();
 
-        sparent = NULL;
-        if (yang_data_name) {
-            sparent = lyp_get_yang_data_template(module, yang_data_name, yang_data_name_len);
-            if (!sparent) {
-                str = strndup(path, (yang_data_name + yang_data_name_len) - path);
-                LOGVAL(ctx, LYE_PATH_INNODE, LY_VLOG_STR, str);
-                free(str);
-                return NULL;
+    /* process the nodes to insert one by one */
+    LY_TREE_FOR_SAFE(node, next1, ins) {
+        if (invalid == 1) {
+            /* auto delete nodes from other cases, if any;
+             * this is done only if node->parent != parent */
+            if (lyv_multicases(ins, NULL, &start, 1, NULL)) {
+                goto error;
             }
         }
-    }
 
-    /* create nodes in a loop */
-    while (1) {
-        /* find the schema node */
-        schild = NULL;
-        while ((schild = lys_getnext(schild, sparent, module, 0))) {
-            if (schild->nodetype & (LYS_CONTAINER | LYS_LEAF | LYS_LEAFLIST | LYS_LIST
-                                    | LYS_ANYDATA | LYS_NOTIF | LYS_RPC | LYS_ACTION)) {
-                /* module comparison */
-                if (mod_name) {
-                    node_mod_name = lys_node_module(schild)->name;
-                    if (strncmp(node_mod_name, mod_name, mod_name_len) || node_mod_name[mod_name_len]) {
-                        continue;
-                    }
-                } else if (lys_node_module(schild) != prev_mod) {
-                    continue;
+        /* isolate the node to be handled separately */
+        ins->prev = ins;
+        ins->next = NULL;
+
+        iter = NULL;
+        if (!ins->dflt) {
+            clrdflt = 1;
+        }
+
+        /* are we inserting list key? */
+        if (!ins->dflt && ins->schema->nodetype == LYS_LEAF && lys_is_key((struct lys_node_leaf *)ins->schema, &pos)) {
+            /* yes, we have a key, get know its position */
+            for (i = 0, iter = parent->child;
+                    iter && i < pos && iter->schema->nodetype == LYS_LEAF;
+                    i++, iter = iter->next);
+            if (iter) {
+                /* insert list's key to the correct position - before the iter */
+                if (parent->child == iter) {
+                    parent->child = ins;
+                }
+                if (iter->prev->next) {
+                    iter->prev->next = ins;
                 }
+                ins->prev = iter->prev;
+                iter->prev = ins;
+                ins->next = iter;
 
-                /* name check */
-                if (strncmp(schild->name, name, nam_len) || schild->name[nam_len]) {
-                    continue;
+                /* update start element */
+                if (parent->child != start) {
+                    start = parent->child;
                 }
+            }
 
-                /* RPC/action in/out check */
-                for (tmp = lys_parent(schild); tmp && (tmp->nodetype == LYS_USES); tmp = lys_parent(tmp));
-                if (tmp) {
-                    if (options & LYD_PATH_OPT_OUTPUT) {
-                        if (tmp->nodetype == LYS_INPUT) {
-                            continue;
+            /* try to find previously present default instance to replace */
+        } else if (ins->schema->nodetype == LYS_LEAFLIST) {
+            i = (int)llists->number;
+            if ((ly_set_add(llists, ins->schema, 0) != i) || ins->dflt) {
+                /* each leaf-list must be cleared only once (except when looking for exact same existing dflt nodes) */
+                LY_TREE_FOR_SAFE(start, next2, iter) {
+                    if (iter->schema == ins->schema) {
+                        if ((ins->dflt && (!iter->dflt || ((iter->schema->flags & LYS_CONFIG_W) &&
+                                                           !strcmp(((struct lyd_node_leaf_list *)iter)->value_str,
+                                                                  ((struct lyd_node_leaf_list *)ins)->value_str))))
+                                || (!ins->dflt && iter->dflt)) {
+                            if (iter == start) {
+                                start = next2;
+                            }
+                            lyd_free(iter);
                         }
+                    }
+                }
+            }
+        } else if (ins->schema->nodetype == LYS_LEAF || (ins->schema->nodetype == LYS_CONTAINER
+                        && !((struct lys_node_container *)ins->schema)->presence)) {
+            LY_TREE_FOR(start, iter) {
+                if (iter->schema == ins->schema) {
+                    if (ins->dflt || iter->dflt) {
+                        /* replace existing (either explicit or default) node with the new (either explicit or default) node */
+                        lyd_journal_deleted(iter);
+                        lyd_replace(iter, ins, 1);
                     } else {
-                        if (tmp->nodetype == LYS_OUTPUT) {
-                            continue;
-                        }
+                        /* keep both explicit nodes, let the caller solve it later */
+                        iter = NULL;
                     }
+                    break;
                 }
+            }
+        }
 
-                break;
+        if (!iter) {
+            if (!start) {
+                /* add as the only child of the parent */
+                start = ins;
+                if (parent) {
+                    parent->child = ins;
+                }
+            } else if (isrpc) {
+                /* add to the specific position in rpc/rpc-reply/action */
+                for (par1 = ins->schema->parent; !(par1->nodetype & (LYS_INPUT | LYS_OUTPUT)); par1 = lys_parent(par1));
+                siter = NULL;
+                LY_TREE_FOR(start, iter) {
+                    while ((siter = lys_getnext(siter, par1, lys_node_module(par1), 0))) {
+                        if (iter->schema == siter || ins->schema == siter) {
+                            break;
+                        }
+                    }
+                    if (ins->schema == siter) {
+                        if ((siter->nodetype & (LYS_LEAFLIST | LYS_LIST)) && iter->schema == siter) {
+                            /* we are inserting leaflist/list instance, but since there are already
+                             * some instances of the same leaflist/list, we want to insert the new one
+                             * as the last instance, so here we have to move on */
+                            while (iter && iter->schema == siter) {
+                                iter = iter->next;
+                            }
+                            if (!iter) {
+                                break;
+                            }
+                        }
+                        /* we have the correct place for new node (before the iter) */
+                        if (iter == start) {
+                            start = ins;
+                            if (parent) {
+                                parent->child = ins;
+                            }
+                        } else {
+                            iter->prev->next = ins;
+                        }
+                        ins->prev = iter->prev;
+                        iter->prev = ins;
+                        ins->next = iter;
+
+                        /* we are done */
+                        break;
+                    }
+                }
+                if (!iter) {
+                    /* add as the last child of the parent */
+                    start->prev->next = ins;
+                    ins->prev = start->prev;
+                    start->prev = ins;
+                }
+#ifdef LY_ENABLED_CACHE
+            } else if ((ins->schema->module->ctx->models.flags & LY_CTX_SORTED_INSERT)
+                    && (iter = lyd_insert_sorted_next(start, ins))) {
+                /* add to the schema-order position (before the iter) */
+                if (iter == start) {
+                    start = ins;
+                    if (parent) {
+                        parent->child = ins;
+                    }
+                } else {
+                    iter->prev->next = ins;
+                }
+                ins->prev = iter->prev;
+                iter->prev = ins;
+                ins->next = iter;
+#endif
+            } else {
+                /* add as the last child of the parent */
+                start->prev->next = ins;
+                ins->prev = start->prev;
+                start->prev = ins;
             }
         }
 
-        if (!schild) {
-            str = strndup(path, (name + nam_len) - path);
-            LOGVAL(ctx, LYE_PATH_INNODE, LY_VLOG_STR, str);
-            free(str);
-            lyd_free(ret);
-            return NULL;
+#ifdef LY_ENABLED_CACHE
+        lyd_unlink_hash(ins, ins->parent);
+#endif
+
+        ins->parent = parent;
+
+#ifdef LY_ENABLED_CACHE
+        lyd_insert_hash(ins);
+#endif
+        lyd_journal_created(ins);
+
+        if (invalidate) {
+            check_leaf_list_backlinks(ins, 0);
         }
 
-        /* we have the right schema node */
-        switch (schild->nodetype) {
-        case LYS_CONTAINER:
-        case LYS_LIST:
-        case LYS_NOTIF:
-        case LYS_RPC:
-        case LYS_ACTION:
-            if (options & LYD_PATH_OPT_NOPARENT) {
-                /* these were supposed to exist */
-                str = strndup(path, (name + nam_len) - path);
-                LOGVAL(ctx, LYE_PATH_MISSPAR, LY_VLOG_STR, str);
-                free(str);
-                lyd_free(ret);
-                return NULL;
-            }
-            node = _lyd_new(is_relative ? parent : NULL, schild, (options & LYD_PATH_OPT_DFLT) ? 1 : 0);
-            break;
-        case LYS_LEAF:
-        case LYS_LEAFLIST:
-            str = NULL;
-            if (has_predicate) {
-                if ((r = parse_schema_json_predicate(id, NULL, NULL, &val_name, &val_name_len, &val, &val_len, &has_predicate)) < 1) {
-                    LOGVAL(ctx, LYE_PATH_INCHAR, LY_VLOG_NONE, NULL, id[-r], &id[-r]);
-                    lyd_free(ret);
-                    return NULL;
-                }
-                id += r;
+        if (invalid) {
+            lyd_insert_setinvalid(ins);
+        }
+    }
+    ly_set_free(llists);
+
+    if (clrdflt) {
+        /* remove the dflt flag from parents */
+        for (iter = parent; iter && iter->dflt; iter = iter->parent) {
+            iter->dflt = 0;
+        }
+    }
+
+    if (sibling) {
+        *sibling = start;
+    }
+    return EXIT_SUCCESS;
+
+error:
+    ly_set_free(llists);
+    return EXIT_FAILURE;
+}
 
-                if ((val_name[0] != '.') || (val_name_len != 1)) {
-                    LOGVAL(ctx, LYE_PATH_INCHAR, LY_VLOG_NONE, NULL, val_name[0], val_name);
-                    lyd_free(ret);
-                    return NULL;
-                }
+API int
+lyd_insert(struct lyd_node *parent, struct lyd_node *node)
+{
+    if (!node || !parent || (parent->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST | LYS_ANYDATA))) {
+        LOGARG;
+        return EXIT_FAILURE;
+    }
 
-                str = strndup(val, val_len);
-                if (!str) {
-                    LOGMEM(ctx);
-                    lyd_free(ret);
-                    return NULL;
-                }
-            }
-            if (id[0]) {
-                LOGVAL(ctx, LYE_PATH_INCHAR, LY_VLOG_NONE, NULL, id[0], id);
-                free(str);
-                lyd_free(ret);
-                return NULL;
-            }
+    return lyd_insert_common(parent, NULL, node, 1);
+}
 
-            if ((options & LYD_PATH_OPT_EDIT) && schild->nodetype == LYS_LEAF) {
-                edit_leaf = 1;
-            } else {
-                edit_leaf = 0;
-            }
-            node = _lyd_new_leaf(is_relative ? parent : NULL, schild, (str ? str : value),
-                                 (options & LYD_PATH_OPT_DFLT) ? 1 : 0, edit_leaf);
-            free(str);
-            break;
-        case LYS_ANYXML:
-        case LYS_ANYDATA:
-            if (id[0]) {
-                LOGVAL(ctx, LYE_PATH_INCHAR, LY_VLOG_NONE, NULL, id[0], id);
-                lyd_free(ret);
-                return NULL;
-            }
-            if (value_type <= LYD_ANYDATA_STRING && !value) {
-                value_type = LYD_ANYDATA_CONSTSTRING;
-                value = "";
-            }
-            node = lyd_create_anydata(is_relative ? parent : NULL, schild, value, value_type);
-            break;
-        default:
-            LOGINT(ctx);
-            node = NULL;
-            break;
-        }
+API int
+lyd_insert_batch(struct lyd_node *parent, struct lyd_node *first)
+{
+    struct ly_ctx *ctx;
+    struct lyd_node *iter, *next, *elem, *last;
+    const struct lys_node *schema = NULL, *sparent;
+    struct ly_set *llists = NULL;
+    uint32_t count = 0, i;
+    int max = 0;
 
-        if (!node) {
-            str = strndup(path, id - path);
-            if (is_relative) {
-                LOGVAL(ctx, LYE_SPEC, LY_VLOG_STR, str, "Failed to create node \"%s\" as a child of \"%s\".",
-                       schild->name, parent->schema->name);
-            } else {
-                LOGVAL(ctx, LYE_SPEC, LY_VLOG_STR, str, "Failed to create node \"%s\".", schild->name);
-            }
-            free(str);
-            lyd_free(ret);
-            return NULL;
+    if (!parent || !first || first->parent || first->prev->next
+            || (parent->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST | LYS_ANYDATA))) {
+        LOGARG;
+        return EXIT_FAILURE;
+    }
+    ctx = parent->schema->module->ctx;
+
+    /* only new non-default instances of lists and leaf-lists directly in the parent are inserted at once,
+     * anything else (or anything with a sorted insert) in the standard way */
+    LY_TREE_FOR(first, iter) {
+        if (!(iter->schema->nodetype & (LYS_LIST | LYS_LEAFLIST)) || iter->dflt || (iter->schema->module->ctx != ctx)
+                || (ctx->models.flags & LY_CTX_SORTED_INSERT)) {
+            return lyd_insert_common(parent, NULL, first, 1);
         }
-        /* special case when we are creating a sibling of a top-level data node */
-        if (!is_relative) {
-            if (data_tree) {
-                for (; data_tree->next; data_tree = data_tree->next);
-                if (lyd_insert_after(data_tree, node)) {
-                    lyd_free(ret);
-                    return NULL;
+        if (iter->schema != schema) {
+            for (sparent = lys_parent(iter->schema); sparent && (sparent->nodetype == LYS_USES); sparent = lys_parent(sparent));
+            if (sparent != parent->schema) {
+                return lyd_insert_common(parent, NULL, first, 1);
+            }
+            schema = iter->schema;
+            if (schema->nodetype == LYS_LEAFLIST) {
+                if (!llists) {
+                    llists = ly_set_new();
+                    LY_CHECK_ERR_RETURN(!llists, LOGMEM(ctx), EXIT_FAILURE);
                 }
+                ly_set_add(llists, (void *)schema, 0);
             }
-            is_relative = 1;
         }
+        ++count;
+    }
+    lyd_gen_bump(ctx);
 
-        if (first_iter) {
-            /* sort if needed, but only when inserted somewhere */
-            sparent = node->schema;
-            do {
-                sparent = lys_parent(sparent);
-            } while (sparent && (sparent->nodetype != ((options & LYD_PATH_OPT_OUTPUT) ? LYS_OUTPUT : LYS_INPUT)));
-            if (sparent && lyd_schema_sort(node, 0)) {
-                lyd_free(ret);
-                return NULL;
+    /* explicit leaf-list instances replace the default ones */
+    for (i = 0; llists && (i < llists->number); ++i) {
+        LY_TREE_FOR_SAFE(parent->child, next, elem) {
+            if ((elem->schema == llists->set.s[i]) && elem->dflt) {
+                lyd_free(elem);
             }
+        }
+    }
+    ly_set_free(llists);
 
-            /* set first created node */
-            ret = node;
-            first_iter = 0;
+    /* link the siblings at once */
+    last = first->prev;
+    if (parent->child) {
+        first->prev = parent->child->prev;
+        parent->child->prev->next = first;
+        parent->child->prev = last;
+    } else {
+        parent->child = first;
+    }
+
+#ifdef LY_ENABLED_CACHE
+    if (parent->ht && lyht_reserve(parent->ht, count)) {
+        LOGMEM(ctx);
+    }
+#endif
+    LY_TREE_FOR(first, iter) {
+        iter->parent = parent;
+#ifdef LY_ENABLED_CACHE
+        if (parent->ht && ((iter->schema->nodetype != LYS_LIST) || lyd_list_has_keys(iter))
+                && lyht_insert(parent->ht, &iter, iter->hash, NULL)) {
+            assert(0);
+        }
+        lyd_bloom_insert(iter);
+#endif
+        iter->validity = ly_new_node_validity(iter->schema);
+        if (iter->schema->nodetype == LYS_LIST) {
+            max |= ((struct lys_node_list *)iter->schema)->max ? 1 : 0;
+        } else {
+            max |= ((struct lys_node_leaflist *)iter->schema)->max ? 1 : 0;
         }
+    }
+#ifdef LY_ENABLED_CACHE
+    if (!parent->ht) {
+        lyd_children_ht_create(parent);
+    }
+    lyd_keyless_list_hash_change(parent, first, 1, 0, 0);
+#endif
 
-        parsed = 0;
-        if ((schild->nodetype == LYS_LIST) && has_predicate && lyd_new_path_list_predicate(node, name, id, &parsed)) {
-            lyd_free(ret);
-            return NULL;
+    if (lyd_journal_active) {
+        LY_TREE_FOR(first, iter) {
+            lyd_journal_created(iter);
         }
-        id += parsed;
+    }
 
-        if (!id[0]) {
-            /* we are done */
-            if (options & LYD_PATH_OPT_NOPARENTRET) {
-                /* last created node */
-                return node;
+    /* invalidate once for all the siblings */
+    check_leaf_list_backlinks_siblings(first, last, 0);
+    if (max) {
+        parent->validity |= LYD_VAL_MAND;
+    }
+    for (iter = parent; iter && iter->dflt; iter = iter->parent) {
+        iter->dflt = 0;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+API int
+lyd_insert_sibling(struct lyd_node **sibling, struct lyd_node *node)
+{
+    if (!sibling || !node) {
+        LOGARG;
+        return EXIT_FAILURE;
+    }
+
+    return lyd_insert_common((*sibling) ? (*sibling)->parent : NULL, sibling, node, 1);
+
+}
+
+int
+lyd_insert_nextto(struct lyd_node *sibling, struct lyd_node *node, int before, int invalidate)
+{
+    struct ly_ctx *ctx;
+    struct lys_node *par1, *par2;
+    struct lyd_node *iter, *start = NULL, *ins, *next1, *next2, *last;
+    struct lyd_node *orig_parent = NULL, *orig_prev = NULL, *orig_next = NULL;
+    int invalid = 0;
+    char *str;
+
+    assert(sibling);
+    assert(node);
+
+    ctx = sibling->schema->module->ctx;
+
+    if (sibling == node) {
+        return EXIT_SUCCESS;
+    }
+
+    /* check placing the node to the appropriate place according to the schema */
+    for (par1 = lys_parent(sibling->schema);
+         par1 && !(par1->nodetype & (LYS_CONTAINER | LYS_LIST | LYS_INPUT | LYS_OUTPUT | LYS_ACTION | LYS_NOTIF));
+         par1 = lys_parent(par1));
+    for (par2 = lys_parent(node->schema);
+         par2 && !(par2->nodetype & (LYS_CONTAINER | LYS_LIST | LYS_INPUT | LYS_OUTPUT | LYS_ACTION | LYS_NOTIF));
+         par2 = lys_parent(par2));
+    if (par1 != par2) {
+        LOGERR(ctx, LY_EINVAL, "Cannot insert, different parents (\"%s\" and \"%s\").",
+               (par1 ? par1->name : "<top-lvl>"), (par2 ? par2->name : "<top-lvl>"));
+        return EXIT_FAILURE;
+    }
+    lyd_gen_bump(ctx);
+
+    if (invalidate && ((node->parent != sibling->parent) || (invalid = lyp_is_rpc_action(node->schema)) || !node->parent)) {
+        /* a) it is not just moving under a parent node (invalid = 1) or
+         * b) it is in an RPC where nodes order matters (invalid = 2) or
+         * c) it is top-level where we don't know if it is the same tree (invalid = 1),
+         * so the validation will be necessary */
+        if (!node->parent && !invalid) {
+            /* c) search in siblings */
+            for (iter = node->prev; iter != node; iter = iter->prev) {
+                if (iter == sibling) {
+                    break;
+                }
             }
-            return ret;
+            if (iter == node) {
+                /* node and siblings are not currently in the same data tree */
+                invalid++;
+            }
+        } else { /* a) and b) */
+            invalid++;
         }
+    }
 
-        /* prepare for another iteration */
-        parent = node;
-        sparent = schild;
-        prev_mod = lys_node_module(schild);
-
-        /* parse another node */
-        if ((r = parse_schema_nodeid(id, &mod_name, &mod_name_len, &name, &nam_len, &is_relative, &has_predicate, NULL, 0)) < 1) {
-            LOGVAL(ctx, LYE_PATH_INCHAR, LY_VLOG_NONE, NULL, id[-r], &id[-r]);
-            lyd_free(ret);
-            return NULL;
+    /* unlink only if it is not a list of siblings without a parent or node is not the first sibling,
+     * always unlink if just moving a node */
+    if ((!invalid) || node->parent || node->prev->next) {
+        /* remember the original position to be able to revert
+         * unlink in case of error */
+        orig_parent = node->parent;
+        if (node->prev != node) {
+            orig_prev = node->prev;
         }
-        id += r;
+        orig_next = node->next;
+        lyd_unlink_internal(node, invalid);
+    }
 
-        /* if a key of a list was supposed to be created, it is created as a part of the list instance creation */
-        if ((schild->nodetype == LYS_LIST) && !mod_name) {
-            slist = (const struct lys_node_list *)schild;
-            for (i = 0; i < slist->keys_size; ++i) {
-                if (!strncmp(slist->keys[i]->name, name, nam_len) && !slist->keys[i]->name[nam_len]) {
-                    /* the path continues? there cannot be anything after a key (leaf) */
-                    if (id[0]) {
-                        LOGVAL(ctx, LYE_PATH_INCHAR, LY_VLOG_NONE, NULL, id[0], id);
-                        lyd_free(ret);
-                        return NULL;
+    /* find first sibling node */
+    if (sibling->parent) {
+        start = sibling->parent->child;
+    } else {
+        for (start = sibling; start->prev->next; start = start->prev);
+    }
+
+    /* process the nodes one by one to clean the current tree */
+    if (!invalid) {
+        /* just moving one sibling */
+        last = node;
+        node->parent = sibling->parent;
+    } else {
+        LY_TREE_FOR_SAFE(node, next1, ins) {
+            lyd_insert_setinvalid(ins);
+
+            if (invalid == 1) {
+                /* auto delete nodes from other cases */
+                if (lyv_multicases(ins, NULL, &start, 1, sibling) == 2) {
+                    LOGVAL(ctx, LYE_SPEC, LY_VLOG_LYD, sibling, "Insert request refers node (%s) that is going to be auto-deleted.",
+                        ly_errpath(ctx));
+                    goto error;
+                }
+            }
+
+            /* try to find previously present default instance to remove because of
+            * inserting the specified node */
+            if (ins->schema->nodetype == LYS_LEAFLIST) {
+                LY_TREE_FOR_SAFE(start, next2, iter) {
+                    if (iter->schema == ins->schema) {
+                        if ((ins->dflt && (!iter->dflt || ((iter->schema->flags & LYS_CONFIG_W) &&
+                                                        !strcmp(((struct lyd_node_leaf_list *)iter)->value_str,
+                                                                ((struct lyd_node_leaf_list *)ins)->value_str))))
+                                || (!ins->dflt && iter->dflt)) {
+                            /* iter will get deleted */
+                            if (iter == sibling) {
+                                LOGERR(ctx, LY_EINVAL, "Insert request refers node (%s) that is going to be auto-deleted.",
+                                    str = lyd_path(sibling));
+                                free(str);
+                                goto error;
+                            }
+                            if (iter == start) {
+                                start = next2;
+                            }
+                            lyd_free(iter);
+                        }
+                    }
+                }
+            } else if (ins->schema->nodetype == LYS_LEAF ||
+                    (ins->schema->nodetype == LYS_CONTAINER && !((struct lys_node_container *)ins->schema)->presence)) {
+                LY_TREE_FOR(start, iter) {
+                    if (iter->schema == ins->schema) {
+                        if (iter->dflt || ins->dflt) {
+                            /* iter gets deleted */
+                            if (iter == sibling) {
+                                LOGERR(ctx, LY_EINVAL, "Insert request refers node (%s) that is going to be auto-deleted.",
+                                    str = lyd_path(sibling));
+                                free(str);
+                                goto error;
+                            }
+                            if (iter == start) {
+                                start = iter->next;
+                            }
+                            lyd_free(iter);
+                        }
+                        break;
                     }
-                    return ret;
                 }
             }
-        }
-    }
-
-    LOGINT(ctx);
-    return NULL;
-}
 
-API unsigned int
-lyd_list_pos(const struct lyd_node *node)
-{
-    unsigned int pos;
-    struct lys_node *schema;
+#ifdef LY_ENABLED_CACHE
+            lyd_unlink_hash(ins, ins->parent);
+#endif
 
-    if (!node || ((node->schema->nodetype != LYS_LIST) && (node->schema->nodetype != LYS_LEAFLIST))) {
-        return 0;
-    }
+            ins->parent = sibling->parent;
 
-    schema = node->schema;
-    pos = 0;
-    do {
-        if (node->schema == schema) {
-            ++pos;
+#ifdef LY_ENABLED_CACHE
+            lyd_insert_hash(ins);
+#endif
+            last = ins;
         }
-        node = node->prev;
-    } while (node->next);
-
-    return pos;
-}
-
-struct lyd_node *
-lyd_new_dummy(struct lyd_node *root, struct lyd_node *parent, const struct lys_node *schema, const char *value, int dflt)
-{
-    unsigned int index;
-    struct ly_set *spath;
-    const struct lys_node *siter;
-    struct lyd_node *iter, *dummy = NULL;
-
-    assert(schema);
-    assert(schema->nodetype & (LYS_CONTAINER | LYS_LEAF | LYS_LIST | LYS_LEAFLIST | LYS_ANYDATA | LYS_NOTIF |
-                               LYS_RPC | LYS_ACTION));
-
-    spath = ly_set_new();
-    if (!spath) {
-        LOGMEM(schema->module->ctx);
-        return NULL;
-    }
-
-    if (!parent && root) {
-        /* find data root */
-        for (; root->parent; root = root->parent);   /* vertical move (up) */
-        for (; root->prev->next; root = root->prev); /* horizontal move (left) */
     }
 
-    /* build schema path */
-    for (siter = schema; siter; siter = lys_parent(siter)) {
-        /* stop if we know some of the parents */
-        if (parent && parent->schema == siter) {
-            break;
+    /* insert the (list of) node(s) to the specified position */
+    if (before) {
+        if (sibling->prev->next) {
+            /* adding into a middle */
+            sibling->prev->next = node;
+        } else if (sibling->parent) {
+            /* at the beginning */
+            sibling->parent->child = node;
         }
-
-        if (siter->nodetype & (LYS_CONTAINER | LYS_LEAF | LYS_LIST | LYS_LEAFLIST | LYS_ANYDATA | LYS_NOTIF |
-                               LYS_RPC | LYS_ACTION)) {
-            /* we have a node that can appear in data tree */
-            ly_set_add(spath, (void*)siter, LY_SET_OPT_USEASLIST);
-        } /* else skip the rest node types */
+        node->prev = sibling->prev;
+        sibling->prev = last;
+        last->next = sibling;
+    } else { /* after */
+        if (sibling->next) {
+            /* adding into a middle - fix the prev pointer of the node after inserted nodes */
+            last->next = sibling->next;
+            sibling->next->prev = last;
+        } else {
+            /* at the end - fix the prev pointer of the first node */
+            start->prev = last;
+        }
+        sibling->next = node;
+        node->prev = sibling;
     }
 
-    assert(spath->number > 0);
-    index = spath->number;
-    if (!parent && !(spath->set.s[index - 1]->nodetype & LYS_LEAFLIST)) {
-        /* start by searching for the top-level parent */
-        LY_TREE_FOR(root, iter) {
-            if (iter->schema == spath->set.s[index - 1]) {
-                parent = iter;
-                index--;
+    if (lyd_journal_active) {
+        LY_TREE_FOR(node, next1) {
+            lyd_journal_created(next1);
+            if (next1 == last) {
                 break;
             }
         }
     }
 
-    iter = parent;
-    while (iter && index && !(spath->set.s[index - 1]->nodetype & LYS_LEAFLIST)) {
-        /* search for closer parent on the path */
-        LY_TREE_FOR(parent->child, iter) {
-            if (iter->schema == spath->set.s[index - 1]) {
-                index--;
-                parent = iter;
+    if (invalidate) {
+        LY_TREE_FOR(node, next1) {
+            check_leaf_list_backlinks(next1, 0);
+            if (next1 == last) {
                 break;
             }
         }
     }
-    while(index) {
-        /* create the missing part of the path */
-        switch (spath->set.s[index - 1]->nodetype) {
-        case LYS_LEAF:
-        case LYS_LEAFLIST:
-            if (value) {
-                iter = _lyd_new_leaf(parent, spath->set.s[index - 1], value, dflt, 0);
-            } else {
-                iter = lyd_create_leaf(spath->set.s[index - 1], value, dflt);
-                if (iter && parent) {
-                    if (lyd_insert(parent, iter)) {
-                        lyd_free(iter);
-                        goto error;
-                    }
-                }
-            }
-            break;
-        case LYS_CONTAINER:
-        case LYS_LIST:
-            iter = _lyd_new(parent, spath->set.s[index - 1], dflt);
-            break;
-        case LYS_ANYXML:
-        case LYS_ANYDATA:
-            iter = lyd_create_anydata(parent, spath->set.s[index - 1], "", LYD_ANYDATA_CONSTSTRING);
-            break;
-        default:
-            goto error;
-        }
-        if (!iter) {
-            LOGINT(schema->module->ctx);
-            goto error;
-        }
-
-        /* we say it is valid and it is dummy */
-        iter->validity = LYD_VAL_INUSE;
-
-        if (!dummy) {
-            dummy = iter;
-        }
-
-        /* continue */
-        parent = iter;
-        index--;
-    }
-
-    ly_set_free(spath);
 
-    return dummy;
+    return EXIT_SUCCESS;
 
 error:
-    ly_set_free(spath);
-    lyd_free(dummy);
-    return NULL;
+    /* insert back to the original position */
+    if (orig_prev) {
+        lyd_insert_after(orig_prev, node);
+    } else if (orig_next) {
+        lyd_insert_before(orig_next, node);
+    } else if (orig_parent) {
+        /* there were no siblings */
+        orig_parent->child = node;
+        node->parent = orig_parent;
+    }
+    return EXIT_FAILURE;
 }
 
-static struct lys_node *
-lys_get_schema_inctx(struct lys_node *schema, struct ly_ctx *ctx)
+API int
+lyd_insert_before(struct lyd_node *sibling, struct lyd_node *node)
 {
-    const struct lys_module *mod, *trg_mod = NULL;
-    struct lys_node *parent, *first_sibling = NULL, *iter = NULL;
-    struct ly_set *parents;
-    unsigned int index;
-    uint32_t idx;
-    void **ptr;
-
-    if (!ctx || schema->module->ctx == ctx) {
-        /* we have the same context */
-        return schema;
+    if (!node || !sibling) {
+        LOGARG;
+        return EXIT_FAILURE;
     }
 
-    /* store the parents chain */
-    parents = ly_set_new();
-    for (parent = schema; parent; parent = lys_parent(parent)) {
-        /* note - augments are skipped so we will work only with the implemented modules
-         * (where the augments are applied) */
-        if (parent->nodetype != LYS_USES) {
-            ly_set_add(parents, parent, LY_SET_OPT_USEASLIST);
-        }
-    }
-    assert(parents->number);
-    index = parents->number - 1;
+    return lyd_insert_nextto(sibling, node, 1, 1);
+}
 
-    /* process the parents from the top level */
-    /* for the top-level node, we have to locate the module first */
-    parent = parents->set.s[index];
-    if (parent->nodetype == LYS_EXT) {
-        ptr = lys_ext_complex_get_substmt(LY_STMT_NODE, (struct lys_ext_instance_complex *)parent, NULL);
-        if (!ptr) {
-            ly_set_free(parents);
-            return NULL;
-        }
-        first_sibling = *(struct lys_node **)ptr;
-        parent = parents->set.s[--index];
+API int
+lyd_insert_after(struct lyd_node *sibling, struct lyd_node *node)
+{
+    if (!node || !sibling) {
+        LOGARG;
+        return EXIT_FAILURE;
     }
-    idx = 0;
-    while ((mod = ly_ctx_get_module_iter(ctx, &idx))) {
-        trg_mod = lys_node_module(parent);
-        /* check module name */
-        if (strcmp(mod->name, trg_mod->name)) {
-            continue;
-        }
 
-        /* check revision */
-        if ((!mod->rev_size && !trg_mod->rev_size) ||
-                (mod->rev_size && trg_mod->rev_size && !strcmp(mod->rev[0].date, trg_mod->rev[0].date))) {
-            /* we have match */
-            break;
+    return lyd_insert_nextto(sibling, node, 0, 1);
+}
+
+static uint32_t
+lys_module_pos(struct lys_module *module)
+{
+    int i;
+    uint32_t pos = 1;
+
+    for (i = 0; i < module->ctx->models.used; ++i) {
+        if (module->ctx->models.list[i] == module) {
+            return pos;
         }
-    }
-    /* try data callback */
-    if (!mod && trg_mod && ctx->data_clb) {
-        LOGDBG(LY_LDGYANG, "Attempting to load '%s' into context using callback ...", trg_mod->name);
-        mod = ctx->data_clb(ctx, trg_mod->name, NULL, 0, ctx->data_clb_data);
-    }
-    if (!mod) {
-        ly_set_free(parents);
-        return NULL;
-    }
-    if (!first_sibling) {
-        first_sibling = mod->data;
+        ++pos;
     }
 
-    /* now search in the schema tree for the matching node */
-    while (1) {
-        lys_get_sibling(first_sibling, trg_mod->name, 0, parent->name, 0, parent->nodetype,
-                        (const struct lys_node **)&iter);
-        if (!iter) {
-            /* not found, iter will be used as NULL result */
-            break;
-        }
+    LOGINT(module->ctx);
+    return 0;
+}
 
-        if (index == 0) {
-            /* we are done, iter is the result */
-            break;
-        } else {
-            /* we are going to continue, so update variables for the next loop */
-            first_sibling = iter->child;
-            parent = parents->set.s[--index];
-            iter = NULL;
+static int
+lys_module_node_pos_r(struct lys_node *first_sibling, struct lys_node *target, uint32_t *pos)
+{
+    const struct lys_node *next = NULL;
+
+    /* the schema nodes are actually from data, lys_getnext skips non-data schema nodes for us (we know the parent will not be uses) */
+    while ((next = lys_getnext(next, lys_parent(first_sibling), lys_node_module(first_sibling), LYS_GETNEXT_NOSTATECHECK))) {
+        ++(*pos);
+        if (target == next) {
+            return 0;
         }
     }
 
-    ly_set_free(parents);
-    return iter;
+    LOGINT(first_sibling->module->ctx);
+    return 1;
 }
 
-static struct lys_node *
-lyd_get_schema_inctx(const struct lyd_node *node, struct ly_ctx *ctx)
+static int
+lyd_node_pos_cmp(const void *item1, const void *item2)
 {
-    assert(node);
+    struct lyd_node_pos *np1, *np2;
 
-    return lys_get_schema_inctx(node->schema, ctx);
+    np1 = (struct lyd_node_pos *)item1;
+    np2 = (struct lyd_node_pos *)item2;
+
+    /* different modules? if lys_module_pos() failed, there is nothing we can do anyway,
+     * at least internal error was printed */
+    if (np1->mpos != np2->mpos) {
+        return (np1->mpos > np2->mpos) ? 1 : -1;
+    }
+
+    if (np1->pos != np2->pos) {
+        return (np1->pos > np2->pos) ? 1 : -1;
+    }
+
+    /* keep the order of the instances of the same node */
+    if (np1->idx != np2->idx) {
+        return (np1->idx > np2->idx) ? 1 : -1;
+    }
+    return 0;
 }
 
-/* both target and source were validated */
-static void
-lyd_merge_node_update(struct lyd_node *target, struct lyd_node *source)
+API int
+lyd_schema_sort(struct lyd_node *sibling, int recursive)
 {
-    struct ly_ctx *ctx;
-    struct lyd_node_leaf_list *trg_leaf, *src_leaf;
-    struct lyd_node_anydata *trg_any, *src_any;
-    int len;
+    uint32_t len, i, mpos = 0;
+    uint8_t key;
+    struct lyd_node *node;
+    struct lys_node *first_ssibling = NULL;
+    struct lyd_node_pos *array;
 
-    assert(target->schema->nodetype & (LYS_LEAF | LYS_ANYDATA));
-    ctx = target->schema->module->ctx;
+    if (!sibling) {
+        LOGARG;
+        return -1;
+    }
 
-    if (ctx == source->schema->module->ctx) {
-        /* source and targets are in the same context */
-        if (target->schema->nodetype == LYS_LEAF) {
-            trg_leaf = (struct lyd_node_leaf_list *)target;
-            src_leaf = (struct lyd_node_leaf_list *)source;
+    /* something actually to sort */
+    if (sibling->prev != sibling) {
+        lyd_gen_bump(sibling->schema->module->ctx);
 
-            lydict_remove(ctx, trg_leaf->value_str);
-            trg_leaf->value_str = src_leaf->value_str;
-            src_leaf->value_str = NULL;
-            trg_leaf->value_type = src_leaf->value_type;
-            src_leaf->value_type = 0;
-            if (trg_leaf->value_type == LY_TYPE_LEAFREF) {
-                trg_leaf->validity |= LYD_VAL_LEAFREF;
-                lyp_parse_value(&((struct lys_node_leaf *)trg_leaf->schema)->type, &trg_leaf->value_str,
-                                NULL, trg_leaf, NULL, NULL, 1, src_leaf->dflt, 0);
-            } else {
-                lyd_free_value(trg_leaf->value, trg_leaf->value_type, trg_leaf->value_flags,
-                               &((struct lys_node_leaf *)trg_leaf->schema)->type, NULL, NULL, NULL);
-                trg_leaf->value = src_leaf->value;
-            }
-            src_leaf->value = (lyd_val)0;
-            trg_leaf->dflt = src_leaf->dflt;
+        /* find the beginning */
+        sibling = lyd_first_sibling(sibling);
 
-            check_leaf_list_backlinks(target, 2);
-        } else { /* ANYDATA */
-            trg_any = (struct lyd_node_anydata *)target;
-            src_any = (struct lyd_node_anydata *)source;
+        /* count siblings */
+        len = 0;
+        for (node = sibling; node; node = node->next) {
+            ++len;
+        }
 
-            switch(trg_any->value_type) {
-            case LYD_ANYDATA_CONSTSTRING:
-            case LYD_ANYDATA_SXML:
-            case LYD_ANYDATA_JSON:
-                lydict_remove(ctx, trg_any->value.str);
-                break;
-            case LYD_ANYDATA_DATATREE:
-                lyd_free_withsiblings(trg_any->value.tree);
-                break;
-            case LYD_ANYDATA_XML:
-                lyxml_free_withsiblings(ctx, trg_any->value.xml);
-                break;
-            case LYD_ANYDATA_LYB:
-                free(trg_any->value.mem);
-                break;
-            case LYD_ANYDATA_STRING:
-            case LYD_ANYDATA_SXMLD:
-            case LYD_ANYDATA_JSOND:
-            case LYD_ANYDATA_LYBD:
-                /* dynamic strings are used only as input parameters */
-                assert(0);
-                break;
+        array = malloc(len * sizeof *array);
+        LY_CHECK_ERR_RETURN(!array, LOGMEM(sibling->schema->module->ctx), -1);
+
+        /* fill arrays with positions and corresponding nodes */
+        for (i = 0, node = sibling; i < len; ++i, node = node->next) {
+            if (node->parent && (node->parent->schema->nodetype == LYS_LIST) && (node->schema->nodetype == LYS_LEAF)
+                    && lys_is_key((struct lys_node_leaf *)node->schema, &key)) {
+                /* list keys stay first, in their order */
+                array[i].mpos = 0;
+                array[i].pos = key;
+                array[i].node = node;
+                array[i].idx = i;
+                continue;
+            }
+            if (!i || (lyd_node_module(node) != lyd_node_module(array[i - 1].node))) {
+                mpos = lys_module_pos(lyd_node_module(node));
             }
+            array[i].mpos = mpos;
+#ifdef LY_ENABLED_CACHE
+            /* numbered when the module was added into the context */
+            array[i].pos = node->schema->pos;
+#else
+            array[i].pos = 0;
+#endif
 
-            trg_any->value_type = src_any->value_type;
-            trg_any->value = src_any->value;
+            if (!array[i].pos) {
+                /* we need to repeat this for every module */
+                if (!first_ssibling || (lyd_node_module(node) != lys_node_module(first_ssibling))) {
+                    /* find the data node schema parent */
+                    first_ssibling = node->schema;
+                    while (lys_parent(first_ssibling)
+                            && (lys_parent(first_ssibling)->nodetype & (LYS_CHOICE | LYS_CASE | LYS_USES))) {
+                        first_ssibling = lys_parent(first_ssibling);
+                    }
 
-            src_any->value_type = LYD_ANYDATA_DATATREE;
-            src_any->value.tree = NULL;
+                    /* find the beginning */
+                    if (lys_parent(first_ssibling)) {
+                        first_ssibling = lys_parent(first_ssibling)->child;
+                    } else {
+                        while (first_ssibling->prev->next) {
+                            first_ssibling = first_ssibling->prev;
+                        }
+                    }
+                }
+
+                if (lys_module_node_pos_r(first_ssibling, node->schema, &array[i].pos)) {
+                    free(array);
+                    return -1;
+                }
+            }
+
+            array[i].node = node;
+            array[i].idx = i;
         }
-    } else {
-        /* we have different contexts for the target and source */
-        if (target->schema->nodetype == LYS_LEAF) {
-            trg_leaf = (struct lyd_node_leaf_list *)target;
-            src_leaf = (struct lyd_node_leaf_list *)source;
 
-            lydict_remove(ctx, trg_leaf->value_str);
-            trg_leaf->value_str = lydict_insert(ctx, src_leaf->value_str, 0);
-            lyd_free_value(trg_leaf->value, trg_leaf->value_type, trg_leaf->value_flags,
-                           &((struct lys_node_leaf *)trg_leaf->schema)->type, NULL, NULL, NULL);
-            trg_leaf->value_type = src_leaf->value_type;
-            trg_leaf->dflt = src_leaf->dflt;
+        /* sort the arrays */
+        qsort(array, len, sizeof *array, lyd_node_pos_cmp);
 
-            switch (trg_leaf->value_type) {
-            case LY_TYPE_BINARY:
-            case LY_TYPE_STRING:
-                /* value_str pointer is shared in these cases */
-                trg_leaf->value.string = trg_leaf->value_str;
-                break;
-            case LY_TYPE_LEAFREF:
-                trg_leaf->validity |= LYD_VAL_LEAFREF;
-                lyp_parse_value(&((struct lys_node_leaf *)trg_leaf->schema)->type, &trg_leaf->value_str,
-                                NULL, trg_leaf, NULL, NULL, 1, trg_leaf->dflt, 0);
-                break;
-            case LY_TYPE_INST:
-                trg_leaf->value.instance = NULL;
-                break;
-            case LY_TYPE_UNION:
-                /* unresolved union (this must be non-validated tree), duplicate the stored string (duplicated
-                 * because of possible change of the value in case of instance-identifier) */
-                trg_leaf->value.string = lydict_insert(ctx, src_leaf->value.string, 0);
-                break;
-            case LY_TYPE_BITS:
-            case LY_TYPE_ENUM:
-            case LY_TYPE_IDENT:
-                /* in case of duplicating bits (no matter if in the same context or not) or enum and identityref into
-                 * a different context, searching for the type and duplicating the data is almost as same as resolving
-                 * the string value, so due to a simplicity, parse the value for the duplicated leaf */
-                lyp_parse_value(&((struct lys_node_leaf *)trg_leaf->schema)->type, &trg_leaf->value_str, NULL,
-                                trg_leaf, NULL, NULL, 1, trg_leaf->dflt, 1);
-                break;
-            default:
-                trg_leaf->value = src_leaf->value;
-                break;
+        /* adjust siblings based on the sorted array */
+        for (i = 0; i < len; ++i) {
+            /* parent child */
+            if (i == 0) {
+                /* adjust sibling so that it still points to the beginning */
+                sibling = array[i].node;
+                if (array[i].node->parent) {
+                    array[i].node->parent->child = array[i].node;
+                }
+            }
+
+            /* prev */
+            if (i > 0) {
+                array[i].node->prev = array[i - 1].node;
+            } else {
+                array[i].node->prev = array[len - 1].node;
+            }
+
+            /* next */
+            if (i < len - 1) {
+                array[i].node->next = array[i + 1].node;
+            } else {
+                array[i].node->next = NULL;
+            }
+        }
+        free(array);
+    }
+
+    /* sort all the children recursively */
+    if (recursive) {
+        LY_TREE_FOR(sibling, node) {
+            if ((node->schema->nodetype & (LYS_CONTAINER | LYS_LIST | LYS_RPC | LYS_ACTION | LYS_NOTIF))
+                    && node->child && lyd_schema_sort(node->child, recursive)) {
+                return -1;
             }
+        }
+    }
 
-            check_leaf_list_backlinks(target, 2);
-        } else { /* ANYDATA */
-            trg_any = (struct lyd_node_anydata *)target;
-            src_any = (struct lyd_node_anydata *)source;
+    return EXIT_SUCCESS;
+}
 
-            switch(trg_any->value_type) {
-            case LYD_ANYDATA_CONSTSTRING:
-            case LYD_ANYDATA_SXML:
-            case LYD_ANYDATA_JSON:
-                lydict_remove(ctx, trg_any->value.str);
-                break;
-            case LYD_ANYDATA_DATATREE:
-                lyd_free_withsiblings(trg_any->value.tree);
-                break;
-            case LYD_ANYDATA_XML:
-                lyxml_free_withsiblings(ctx, trg_any->value.xml);
-                break;
-            case LYD_ANYDATA_LYB:
-                free(trg_any->value.mem);
-                break;
-            case LYD_ANYDATA_STRING:
-            case LYD_ANYDATA_SXMLD:
-            case LYD_ANYDATA_JSOND:
-            case LYD_ANYDATA_LYBD:
-                /* dynamic strings are used only as input parameters */
-                assert(0);
-                break;
-            }
+static int
+lyd_validate_module_selected(struct lyd_node *root, const struct lys_module **modules, int mod_count)
+{
+    int i;
 
-            trg_any->value_type = src_any->value_type;
-            if ((void*)src_any->value.tree) {
-                /* there is a value to duplicate */
-                switch (trg_any->value_type) {
-                case LYD_ANYDATA_CONSTSTRING:
-                case LYD_ANYDATA_SXML:
-                case LYD_ANYDATA_JSON:
-                    trg_any->value.str = lydict_insert(ctx, src_any->value.str, 0);
-                    break;
-                case LYD_ANYDATA_DATATREE:
-                    trg_any->value.tree = lyd_dup_to_ctx(src_any->value.tree, 1, ctx);
-                    break;
-                case LYD_ANYDATA_XML:
-                    trg_any->value.xml = lyxml_dup_elem(ctx, src_any->value.xml, NULL, 1);
-                    break;
-                case LYD_ANYDATA_LYB:
-                    len = lyd_lyb_data_length(src_any->value.mem);
-                    if (len == -1) {
-                        LOGERR(ctx, LY_EINVAL, "Invalid LYB data.");
-                        return;
-                    }
-                    trg_any->value.mem = malloc(len);
-                    LY_CHECK_ERR_RETURN(!trg_any->value.mem, LOGMEM(ctx), );
-                    memcpy(trg_any->value.mem, src_any->value.mem, len);
-                    break;
-                case LYD_ANYDATA_STRING:
-                case LYD_ANYDATA_SXMLD:
-                case LYD_ANYDATA_JSOND:
-                case LYD_ANYDATA_LYBD:
-                    /* dynamic strings are used only as input parameters */
-                    assert(0);
-                    break;
-                }
-            }
+    for (i = 0; i < mod_count; ++i) {
+        if (lyd_node_module(root) == modules[i]) {
+            return 1;
         }
     }
+
+    return 0;
 }
 
-/* return: 0 (not equal), 1 (equal), -1 (error) */
+/**
+ * @brief Check all the nodes of a (top-level) subtree, the checks requiring the whole data tree are only
+ * added into \p unres. Logs directly.
+ *
+ * @param[in] root Root of the subtree.
+ * @param[in] options Validation options.
+ * @param[in] unres Unresolved data items to add into.
+ * @param[in,out] act_notif Found action/notification node.
+ * @return EXIT_SUCCESS or EXIT_FAILURE.
+ */
 static int
-lyd_merge_node_schema_equal(struct lyd_node *node1, struct lyd_node *node2)
+lyd_validate_subtree(struct lyd_node *root, int options, struct unres_data *unres, struct lyd_node **act_notif)
 {
-    struct lys_node *sch1;
+    struct lyd_node *next, *iter;
+    struct ly_ctx *ctx = root->schema->module->ctx;
+
+    LY_TREE_DFS_BEGIN(root, next, iter) {
+        if (iter->parent && (iter->schema->nodetype & (LYS_ACTION | LYS_NOTIF))) {
+            if (!(options & LYD_OPT_ACT_NOTIF) || *act_notif) {
+                LOGVAL(ctx, LYE_INELEM, LY_VLOG_LYD, iter, iter->schema->name);
+                LOGVAL(ctx, LYE_SPEC, LY_VLOG_PREV, NULL, "Unexpected %s node \"%s\".",
+                       (options & LYD_OPT_RPC ? "action" : "notification"), iter->schema->name);
+                return EXIT_FAILURE;
+            }
+            *act_notif = iter;
+        }
 
-    if (node1->schema->module->ctx == node2->schema->module->ctx) {
-        if (node1->schema != node2->schema) {
-            return 0;
+        if (lyv_data_context(iter, options, unres) || lyv_data_content(iter, options, unres)) {
+            return EXIT_FAILURE;
         }
-    } else {
-        /* the nodes are in different contexts, get the appropriate schema nodes from the
-         * same context */
-        sch1 = lyd_get_schema_inctx(node1, node2->schema->module->ctx);
-        if (!sch1) {
-            LOGERR(node2->schema->module->ctx, LY_EINVAL, "Target context does not contain a required schema node (%s:%s).",
-                   lyd_node_module(node1)->name, node1->schema->name);
-            return -1;
-        } else if (sch1 != node2->schema) {
-            /* not matching nodes */
-            return 0;
+
+        /* basic validation successful */
+        iter->validity &= ~(LYD_VAL_MAND | LYD_VAL_TOPDEL);
+
+        /* empty non-default, non-presence container without attributes, make it default */
+        if (!iter->dflt && (iter->schema->nodetype == LYS_CONTAINER) && !iter->child
+                    && !((struct lys_node_container *)iter->schema)->presence && !iter->attr) {
+            iter->dflt = 1;
         }
+
+        LY_TREE_DFS_END(root, next, iter);
     }
 
-    return 1;
+    return EXIT_SUCCESS;
 }
 
-/* return: 0 (not equal), 1 (equal), 2 (equal and state leaf-/list marked), -1 (error) */
+struct lyd_val_thread {
+    struct lyd_node **roots;         /* subtrees to be validated by the thread */
+    unsigned int count;
+    int options;
+    enum int_log_opts log_opt;       /* internal logging options of the calling thread */
+    struct unres_data unres;         /* unresolved items of the subtrees */
+    struct ly_err_item *err;         /* errors logged by the thread */
+    int ret;
+};
+
+static void *
+lyd_validate_thread(void *arg)
+{
+    struct lyd_val_thread *vt = (struct lyd_val_thread *)arg;
+    struct lyd_node *act_notif = NULL;
+    unsigned int i;
+
+    log_opt = vt->log_opt;
+    vt->ret = EXIT_SUCCESS;
+    for (i = 0; i < vt->count; ++i) {
+        if (lyd_validate_subtree(vt->roots[i], vt->options, &vt->unres, &act_notif)) {
+            vt->ret = EXIT_FAILURE;
+            break;
+        }
+    }
+
+    /* the errors are passed to the calling thread */
+    vt->err = ly_err_detach(vt->roots[0]->schema->module->ctx);
+    return NULL;
+}
+
+/**
+ * @brief Check the top-level subtrees in several threads, see ly_ctx_set_validation_threads(). Logs directly.
+ *
+ * @param[in] first First top-level node.
+ * @param[in] modules Only subtrees of these modules are validated, all if NULL.
+ * @param[in] mod_count Count of \p modules.
+ * @param[in] options Validation options.
+ * @param[in] unres Unresolved data items to add the items of all the subtrees into.
+ * @return 0 on success, 1 if there are not enough subtrees, -1 on error.
+ */
 static int
-lyd_merge_node_equal(struct lyd_node *node1, struct lyd_node *node2)
+lyd_validate_threads(struct lyd_node *first, const struct lys_module **modules, int mod_count, int options,
+                     struct unres_data *unres)
 {
-    int ret;
+    struct ly_ctx *ctx = first->schema->module->ctx;
+    struct lyd_node *root, **roots = NULL;
+    struct lyd_val_thread *vt = NULL;
+    pthread_t *tids = NULL;
+    int8_t *started = NULL;
+    unsigned int i, count = 0, thread_count, start;
+    void *mem;
+    int ret = -1;
 
-    switch (node1->schema->nodetype) {
-    case LYS_CONTAINER:
-    case LYS_LEAF:
-    case LYS_ANYXML:
-    case LYS_ANYDATA:
-    case LYS_RPC:
-    case LYS_ACTION:
-    case LYS_NOTIF:
+    LY_TREE_FOR(first, root) {
+        if (!modules || lyd_validate_module_selected(root, modules, mod_count)) {
+            ++count;
+        }
+    }
+    if (count < 2) {
         return 1;
-    case LYS_LEAFLIST:
-        if (node1->validity & LYD_VAL_INUSE) {
-            /* this instance was already matched, we want to find another so that the number of the istances matches */
-            assert(node1->schema->flags & LYS_CONFIG_R);
-            return 0;
+    }
+
+    thread_count = (count < ctx->val_threads) ? count : ctx->val_threads;
+    roots = malloc(count * sizeof *roots);
+    vt = calloc(thread_count, sizeof *vt);
+    tids = malloc(thread_count * sizeof *tids);
+    started = calloc(thread_count, sizeof *started);
+    LY_CHECK_ERR_GOTO(!roots || !vt || !tids || !started, LOGMEM(ctx), cleanup);
+
+    i = 0;
+    LY_TREE_FOR(first, root) {
+        if (!modules || lyd_validate_module_selected(root, modules, mod_count)) {
+            roots[i++] = root;
         }
+    }
 
-        ret = lyd_list_equal(node1, node2, 1);
-        if ((ret == 1) && (node1->schema->flags & LYS_CONFIG_R)) {
-            /* mark it as matched */
-            node1->validity |= LYD_VAL_INUSE;
-            ret = 2;
+    /* split the subtrees into contiguous parts to keep the order of the unresolved items */
+    for (i = 0, start = 0; i < thread_count; ++i) {
+        vt[i].roots = &roots[start];
+        vt[i].count = (count - start) / (thread_count - i);
+        vt[i].options = options;
+        vt[i].log_opt = log_opt;
+        start += vt[i].count;
+    }
+
+    /* the calling thread validates the first part itself */
+    for (i = 1; i < thread_count; ++i) {
+        started[i] = pthread_create(&tids[i], NULL, lyd_validate_thread, &vt[i]) ? 0 : 1;
+    }
+    for (i = 0; i < thread_count; ++i) {
+        if (started[i]) {
+            pthread_join(tids[i], NULL);
+        } else {
+            /* the first part or a thread could not be created */
+            lyd_validate_thread(&vt[i]);
         }
-        return ret;
-    case LYS_LIST:
-        if (node1->validity & LYD_VAL_INUSE) {
-            /* this instance was already matched, we want to find another so that the number of the istances matches */
-            assert(!((struct lys_node_list *)node1->schema)->keys_size);
-            return 0;
+    }
+
+    ret = 0;
+    for (i = 0; i < thread_count; ++i) {
+        /* errors in the order of the subtrees */
+        ly_err_append(ctx, vt[i].err);
+        vt[i].err = NULL;
+        if (vt[i].ret) {
+            ret = -1;
         }
 
-        ret = lyd_list_equal(node1, node2, 1);
-        if ((ret == 1) && !((struct lys_node_list *)node1->schema)->keys_size) {
-            /* mark it as matched */
-            node1->validity |= LYD_VAL_INUSE;
-            ret = 2;
+        /* merge the unresolved items */
+        if (!ret && vt[i].unres.count) {
+            mem = realloc(unres->node, (unres->count + vt[i].unres.count) * sizeof *unres->node);
+            LY_CHECK_ERR_GOTO(!mem, LOGMEM(ctx); ret = -1, cleanup);
+            unres->node = mem;
+            mem = realloc(unres->type, (unres->count + vt[i].unres.count) * sizeof *unres->type);
+            LY_CHECK_ERR_GOTO(!mem, LOGMEM(ctx); ret = -1, cleanup);
+            unres->type = mem;
+
+            memcpy(&unres->node[unres->count], vt[i].unres.node, vt[i].unres.count * sizeof *unres->node);
+            memcpy(&unres->type[unres->count], vt[i].unres.type, vt[i].unres.count * sizeof *unres->type);
+            unres->count += vt[i].unres.count;
         }
-        return ret;
-    default:
-        break;
+    }
+    if (ret) {
+        ly_errno = LY_EVALID;
     }
 
-    LOGINT(node2->schema->module->ctx);
-    return -1;
+cleanup:
+    if (vt) {
+        for (i = 0; i < thread_count; ++i) {
+            free(vt[i].unres.node);
+            free(vt[i].unres.type);
+            ly_err_append(ctx, vt[i].err);
+        }
+    }
+    free(roots);
+    free(vt);
+    free(tids);
+    free(started);
+    return ret;
 }
 
-/* spends source */
-static int
-lyd_merge_parent_children(struct lyd_node *target, struct lyd_node *source, int options)
+/**
+ * @brief Collect the schema nodes of all the changed data nodes (including their schema descendants).
+ *
+ * @param[in] first First top-level node.
+ * @param[in] modules Only subtrees of these modules are validated, all if NULL.
+ * @param[in] mod_count Count of \p modules.
+ * @param[in] options Validation options.
+ * @return Set of changed schema nodes, NULL if all the conditions must be evaluated.
+ */
+static struct hash_table *
+lyd_validate_changed_snodes(struct lyd_node *first, const struct lys_module **modules, int mod_count, int options)
 {
-    struct lyd_node *trg_parent, *src, *src_backup, *src_elem, *src_elem_backup, *src_next, *trg_child, *trg_parent_backup;
-    int ret, clear_flag = 0;
-    struct ly_ctx *ctx = target->schema->module->ctx; /* shortcut */
+    struct hash_table *changed;
+    struct lyd_node *root, *next, *iter;
 
-    LY_TREE_FOR_SAFE(source, src_backup, src) {
-        for (src_elem = src_next = src, trg_parent = target;
-            src_elem;
-            src_elem = src_next) {
+    LY_TREE_FOR(first, root) {
+        if (root->validity & LYD_VAL_TOPDEL) {
+            /* a top-level node was removed, we do not know which */
+            return NULL;
+        }
+    }
 
-            /* it won't get inserted in this case */
-            if (src_elem->dflt && (options & LYD_OPT_EXPLICIT)) {
-                if (src_elem == src) {
-                    /* we are done with this subtree in this case */
-                    break;
-                }
-                trg_child = (struct lyd_node *)1;
-                goto src_skip;
+    changed = changed_snodes_new();
+    if (!changed) {
+        return NULL;
+    }
+
+    LY_TREE_FOR(first, root) {
+        if (modules && !lyd_validate_module_selected(root, modules, mod_count)) {
+            continue;
+        }
+
+        LY_TREE_DFS_BEGIN(root, next, iter) {
+            /* new and modified nodes and parents of added or removed nodes */
+            if ((iter->validity & LYD_VAL_MAND) && changed_snodes_add(changed, iter->schema)) {
+                lyht_free(changed);
+                return NULL;
             }
+            LY_TREE_DFS_END(root, next, iter);
+        }
 
-            ret = 0;
+        if (options & LYD_OPT_NOSIBLINGS) {
+            break;
+        }
+    }
 
-#ifdef LY_ENABLED_CACHE
-            struct lyd_node **trg_child_p;
+    return changed;
+}
 
-            /* trees are supposed to be validated so all nodes must have their hash, but lets not be that strict */
-            if (!src_elem->hash) {
-                lyd_hash(src_elem);
+/* the validation changes stored as references, the deleted subtrees are still in the diff */
+static struct lyd_val_change *
+lyd_val_changes_get(struct ly_ctx *ctx, struct unres_data *unres)
+{
+    struct lyd_val_change *changes;
+    struct lyd_node *node, *parent, *top;
+    unsigned int i, j, count = 0;
+
+    changes = malloc((unres->diff_idx + 1) * sizeof *changes);
+    LY_CHECK_ERR_RETURN(!changes, LOGMEM(ctx), NULL);
+
+    for (i = 0; i < unres->diff_idx; ++i) {
+        if (unres->diff->type[i] == LYD_DIFF_CREATED) {
+            node = unres->diff->second[i];
+            parent = node->parent;
+        } else {
+            node = unres->diff->first[i];
+            parent = unres->diff->second[i];
+            if (parent) {
+                /* the parent could have been deleted later, that change includes this one */
+                for (top = parent; top->parent; top = top->parent);
+                for (j = 0; j < unres->diff_idx; ++j) {
+                    if ((unres->diff->type[j] == LYD_DIFF_DELETED) && (unres->diff->first[j] == top)) {
+                        break;
+                    }
+                }
+                if (j < unres->diff_idx) {
+                    continue;
+                }
             }
+        }
+
+        changes[count].type = unres->diff->type[i];
+        changes[count].schema = node->schema;
+        changes[count].parent = parent;
+        if (unres->diff->type[i] == LYD_DIFF_CREATED) {
+            changes[count].node = node;
+            changes[count].value = NULL;
+        } else {
+            changes[count].node = NULL;
+            changes[count].value = (node->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST))
+                    ? lydict_insert(ctx, ((struct lyd_node_leaf_list *)node)->value_str, 0) : NULL;
+        }
+        ++count;
+    }
+    changes[count].type = LYD_DIFF_END;
+
+    return changes;
+}
+
+static int
+_lyd_validate(struct lyd_node **node, struct lyd_node *data_tree, struct ly_ctx *ctx, const struct lys_module **modules,
+              int mod_count, struct lyd_difflist **diff, struct lyd_val_change **changes, int options)
+{
+    struct lyd_node *root, *next1, *act_notif = NULL;
+    int ret = EXIT_FAILURE, r;
+    unsigned int i;
+    struct unres_data *unres = NULL;
+    struct hash_table *changed = NULL;
+    const struct lys_module *yanglib_mod;
+
+    unres = calloc(1, sizeof *unres);
+    LY_CHECK_ERR_RETURN(!unres, LOGMEM(NULL), EXIT_FAILURE);
+
+    if (diff || changes) {
+        unres->store_diff = 1;
+        unres->diff_ref = changes ? 1 : 0;
+        unres->diff = lyd_diff_init_difflist(ctx, &unres->diff_size);
+    }
+
+    if ((options & (LYD_OPT_RPC | LYD_OPT_RPCREPLY)) && *node && ((*node)->schema->nodetype != LYS_RPC)) {
+        options |= LYD_OPT_ACT_NOTIF;
+    }
+    if ((options & (LYD_OPT_NOTIF | LYD_OPT_NOTIF_FILTER)) && *node && ((*node)->schema->nodetype != LYS_NOTIF)) {
+        options |= LYD_OPT_ACT_NOTIF;
+    }
 
-            if (trg_parent->ht) {
-                trg_child = NULL;
-                if (!lyht_find(trg_parent->ht, &src_elem, src_elem->hash, (void **)&trg_child_p)) {
-                    trg_child = *trg_child_p;
-                    ret = 1;
+    if ((options & LYD_OPT_VAL_CHANGED) && *node
+            && !(options & (LYD_OPT_ACT_NOTIF | LYD_OPT_RPC | LYD_OPT_RPCREPLY | LYD_OPT_NOTIF | LYD_OPT_NOTIF_FILTER))) {
+        /* must be learned before the flags are cleared */
+        changed = lyd_validate_changed_snodes(*node, modules, mod_count, options);
+    }
 
-                    /* it is a bit more difficult with keyless state lists and leaf-lists */
-                    if (((trg_child->schema->nodetype == LYS_LIST) && !((struct lys_node_list *)trg_child->schema)->keys_size)
-                            || ((trg_child->schema->nodetype == LYS_LEAFLIST) && (trg_child->schema->flags & LYS_CONFIG_R))) {
-                        assert(trg_child->schema->flags & LYS_CONFIG_R);
+    if (*node && ((*node)->schema->module->ctx->val_threads > 1)
+            && !(options & (LYD_OPT_ACT_NOTIF | LYD_OPT_NOSIBLINGS | LYD_OPT_RPC | LYD_OPT_RPCREPLY | LYD_OPT_NOTIF
+                            | LYD_OPT_NOTIF_FILTER | LYD_OPT_DATA_TEMPLATE))) {
+        /* check the top-level subtrees concurrently */
+        r = lyd_validate_threads(*node, modules, mod_count, options, unres);
+        if (r == -1) {
+            goto cleanup;
+        }
+    } else {
+        r = 1;
+    }
 
-                        while (trg_child && (trg_child->validity & LYD_VAL_INUSE)) {
-                            /* state lists, find one not-already-found */
-                            if (lyht_find_next(trg_parent->ht, &trg_child, trg_child->hash, (void **)&trg_child_p)) {
-                                trg_child = NULL;
-                            } else {
-                                trg_child = *trg_child_p;
-                            }
-                        }
-                        if (trg_child) {
-                            /* mark it as matched */
-                            trg_child->validity |= LYD_VAL_INUSE;
-                            ret = 2;
-                        } else {
-                            /* actually, it was matched already and no other instance found, so now not a match */
-                            ret = 0;
-                        }
-                    }
-                }
-            } else
-#endif
-            {
-                LY_TREE_FOR(trg_parent->child, trg_child) {
-                    /* schema match, data match? */
-                    ret = lyd_merge_node_schema_equal(trg_child, src_elem);
-                    if (ret == 1) {
-                        ret = lyd_merge_node_equal(trg_child, src_elem);
-                    }
-                    if (ret != 0) {
-                        /* even data match */
-                        break;
-                    }
-                }
+    if (r == 1) {
+        LY_TREE_FOR_SAFE(*node, next1, root) {
+            if (modules && !lyd_validate_module_selected(root, modules, mod_count)) {
+                /* skip data that should not be validated */
+                continue;
             }
 
-            if (ret > 0) {
-                if (trg_child->schema->nodetype & (LYS_LEAF | LYS_ANYDATA)) {
-                    lyd_merge_node_update(trg_child, src_elem);
-                } else if (ret == 2) {
-                    clear_flag = 1;
-                }
-            } else if (ret == -1) {
-                /* error */
-                lyd_free_withsiblings(source);
-                return 1;
+            if (lyd_validate_subtree(root, options, unres, &act_notif)) {
+                goto cleanup;
             }
 
-            /* first prepare for the next iteration */
-            src_elem_backup = src_elem;
-            trg_parent_backup = trg_parent;
-            if (((src_elem->schema->nodetype == LYS_CONTAINER) || ((src_elem->schema->nodetype == LYS_LIST)
-                    && ((struct lys_node_list *)src_elem->schema)->keys_size)) && src_elem->child && trg_child) {
-                /* go into children */
-                src_next = src_elem->child;
-                trg_parent = trg_child;
-            } else {
-src_skip:
-                /* no children (or the whole subtree will be inserted), try siblings */
-                if (src_elem == src) {
-                    /* we are done with this subtree */
-                    if (trg_child) {
-                        /* it's an empty container, list without keys, or an already-updated leaf/anydata, nothing else to do */
-                        break;
-                    } else {
-                        /* ... but we still need to insert it */
-                        src_next = NULL;
-                        goto src_insert;
-                    }
-                } else {
-                    src_next = src_elem->next;
-                    /* trg_parent does not change */
-                }
+            if (options & LYD_OPT_NOSIBLINGS) {
+                break;
             }
-            while (!src_next) {
-                src_elem = src_elem->parent;
-                if (src_elem->parent == src->parent) {
-                    /* we are done, no next element to process */
-                    break;
-                }
+        }
+    }
 
-                /* parent is already processed, go to its sibling */
-                src_next = src_elem->next;
-                trg_parent = trg_parent->parent;
+    if (changed) {
+        /* skip the conditions that cannot have changed */
+        unres_data_filter_changed(unres, changed);
+    }
+
+    if (options & LYD_OPT_ACT_NOTIF) {
+        if (!act_notif) {
+            LOGVAL(ctx, LYE_MISSELEM, LY_VLOG_LYD, *node, (options & LYD_OPT_RPC ? "action" : "notification"), (*node)->schema->name);
+            goto cleanup;
+        }
+        options &= ~LYD_OPT_ACT_NOTIF;
+    }
+
+    if (*node) {
+        /* check for uniqueness of top-level lists/leaflists because
+         * only the inner instances were tested in lyv_data_content() */
+        yanglib_mod = ly_ctx_get_module(ctx ? ctx : (*node)->schema->module->ctx, "ietf-yang-library", NULL, 1);
+        LY_TREE_FOR(*node, root) {
+            if ((options & LYD_OPT_DATA_ADD_YANGLIB) && yanglib_mod && (root->schema->module == yanglib_mod)) {
+                /* ietf-yang-library data present, so ignore the option to add them */
+                options &= ~LYD_OPT_DATA_ADD_YANGLIB;
             }
 
-            if (!trg_child) {
-src_insert:
-                /* we need to insert the whole subtree */
-                if (ctx == src_elem_backup->schema->module->ctx) {
-                    /* same context - unlink the subtree and insert it into the target */
-                    lyd_unlink(src_elem_backup);
-                } else {
-                    /* different contexts - before inserting subtree, instead of unlinking, duplicate it into the
-                     * target context */
-                    src_elem_backup = lyd_dup_to_ctx(src_elem_backup, 1, ctx);
-                }
+            if (!(root->schema->nodetype & (LYS_LIST | LYS_LEAFLIST)) || !(root->validity & LYD_VAL_DUP)) {
+                continue;
+            }
 
-                if (src_elem == source) {
-                    /* it will be linked into another data tree and the pointers changed */
-                    source = source->next;
-                }
+            if (options & LYD_OPT_TRUSTED) {
+                /* just clear the flag */
+                root->validity &= ~LYD_VAL_DUP;
+                continue;
+            }
 
-                /* insert subtree into the target */
-                if (lyd_insert(trg_parent_backup, src_elem_backup)) {
-                    LOGINT(ctx);
-                    lyd_free_withsiblings(source);
-                    return 1;
-                }
-                if (src_elem == src) {
-                    /* we are finished for this src */
-                    break;
-                }
+            if (lyv_data_dup(root, *node)) {
+                goto cleanup;
             }
         }
     }
 
-    lyd_free_withsiblings(source);
-    if (clear_flag) {
-        return 2;
+    /* add missing ietf-yang-library if requested */
+    if (options & LYD_OPT_DATA_ADD_YANGLIB) {
+        if (!(*node)) {
+            (*node) = ly_ctx_info(ctx);
+        } else if (lyd_merge((*node), ly_ctx_info(ctx), LYD_OPT_DESTRUCT | LYD_OPT_EXPLICIT)) {
+            LOGERR(ctx, LY_EINT, "Adding ietf-yang-library data failed.");
+            goto cleanup;
+        }
     }
-    return 0;
-}
-
-/* spends source */
-static int
-lyd_merge_siblings(struct lyd_node *target, struct lyd_node *source, int options)
-{
-    struct lyd_node *trg, *src, *src_backup, *ins;
-    int ret, clear_flag = 0;
-    struct ly_ctx *ctx = target->schema->module->ctx; /* shortcut */
 
-    while (target->prev->next) {
-        target = target->prev;
+    /* add default values, resolve unres and check for mandatory nodes in final tree */
+    if (lyd_defaults_add_unres(node, options, ctx, modules, mod_count, data_tree, act_notif, unres, 1)) {
+        goto cleanup;
+    }
+    if (act_notif) {
+        if (lyd_check_mandatory_tree(act_notif, ctx, modules, mod_count, options)) {
+            goto cleanup;
+        }
+    } else {
+        if (lyd_check_mandatory_tree(*node, ctx, modules, mod_count, options)) {
+            goto cleanup;
+        }
     }
 
-    LY_TREE_FOR_SAFE(source, src_backup, src) {
-        LY_TREE_FOR(target, trg) {
-            /* sibling found, merge it */
-            ret = lyd_merge_node_schema_equal(trg, src);
-            if (ret == 1) {
-                ret = lyd_merge_node_equal(trg, src);
-            }
-            if (ret > 0) {
-                if (ret == 2) {
-                    clear_flag = 1;
-                }
+    /* consolidate diff if created */
+    if (diff) {
+        assert(unres->store_diff);
 
-                switch (trg->schema->nodetype) {
-                case LYS_LEAF:
-                case LYS_ANYXML:
-                case LYS_ANYDATA:
-                    lyd_merge_node_update(trg, src);
-                    break;
-                case LYS_LEAFLIST:
-                    /* it's already there, nothing to do */
-                    break;
-                case LYS_LIST:
-                case LYS_CONTAINER:
-                case LYS_NOTIF:
-                case LYS_RPC:
-                case LYS_INPUT:
-                case LYS_OUTPUT:
-                    ret = lyd_merge_parent_children(trg, src->child, options);
-                    if (ret == 2) {
-                        clear_flag = 1;
-                    } else if (ret) {
-                        lyd_free_withsiblings(source);
-                        return 1;
-                    }
-                    break;
-                default:
-                    LOGINT(ctx);
-                    lyd_free_withsiblings(source);
-                    return 1;
+        for (i = 0; i < unres->diff_idx; ++i) {
+            if (unres->diff->type[i] == LYD_DIFF_CREATED) {
+                if (unres->diff->second[i]->parent) {
+                    unres->diff->first[i] = (struct lyd_node *)lyd_path(unres->diff->second[i]->parent);
                 }
-                break;
-            } else if (ret == -1) {
-                lyd_free_withsiblings(source);
-                return 1;
-            } /* else not equal, nothing to do */
+                unres->diff->second[i] = lyd_dup(unres->diff->second[i], LYD_DUP_OPT_RECURSIVE);
+            }
         }
 
-        /* sibling not found, insert it */
-        if (!trg) {
-            if (ctx != src->schema->module->ctx) {
-                ins = lyd_dup_to_ctx(src, 1, ctx);
-            } else {
-                lyd_unlink(src);
-                if (src == source) {
-                    /* just so source is not freed, we inserted it and need it further */
-                    source = src_backup;
+        *diff = unres->diff;
+        unres->diff = 0;
+        unres->diff_idx = 0;
+    } else if (changes) {
+        assert(unres->store_diff);
+
+        /* the deleted subtrees are freed with the diff */
+        *changes = lyd_val_changes_get(ctx, unres);
+        if (!*changes) {
+            goto cleanup;
+        }
+    }
+
+    ret = EXIT_SUCCESS;
+
+cleanup:
+    lyht_free(changed);
+    if (unres) {
+        free(unres->node);
+        free(unres->type);
+        for (i = 0; i < unres->diff_idx; ++i) {
+            if (unres->diff->type[i] == LYD_DIFF_DELETED) {
+                lyd_free_withsiblings(unres->diff->first[i]);
+                if (!unres->diff_ref) {
+                    free(unres->diff->second[i]);
                 }
-                ins = src;
             }
-            lyd_insert_after(target->prev, ins);
         }
+        lyd_free_diff(unres->diff);
+        free(unres);
     }
 
-    lyd_free_withsiblings(source);
-    if (clear_flag) {
-        return 2;
-    }
-    return 0;
+    return ret;
 }
 
 API int
-lyd_merge_to_ctx(struct lyd_node **trg, const struct lyd_node *src, int options, struct ly_ctx *ctx)
+lyd_validate(struct lyd_node **node, int options, void *var_arg, ...)
 {
-    struct lyd_node *node = NULL, *node2, *target, *trg_merge_start, *src_merge_start = NULL;
-    const struct lyd_node *iter;
-    struct lys_node *src_snode, *sch = NULL;
-    int i, src_depth, depth, first_iter, ret, dflt = 1;
-    const struct lys_node *parent = NULL;
+    struct lyd_node *iter, *data_tree = NULL;
+    struct lyd_difflist **diff = NULL;
+    struct lyd_val_change **changes = NULL;
+    struct ly_ctx *ctx = NULL;
+    va_list ap;
+    int ret;
 
-    if (!trg || !(*trg) || !src) {
+    if (!node) {
         LOGARG;
-        return -1;
-    }
-    target = *trg;
-
-    parent = lys_parent(target->schema);
-
-    /* go up all uses */
-    while (parent && (parent->nodetype == LYS_USES)) {
-        parent = lys_parent(parent);
+        return EXIT_FAILURE;
     }
 
-    if (parent && !lyp_get_yang_data_template_name(target)) {
-        LOGERR(parent->module->ctx, LY_EINVAL, "Target not a top-level data tree.");
-        return -1;
+    if (lyp_data_check_options(NULL, options, __func__)) {
+        return EXIT_FAILURE;
     }
 
-    /* get know if we are converting data into a different context */
-    if (ctx && target->schema->module->ctx != ctx) {
-        /* target's data tree context differs from the target context, move the target
-         * data tree into the target context */
+    data_tree = *node;
 
-        /* get the first target's top-level and store it as the result */
-        for (; target->prev->next; target = target->prev);
-        *trg = target;
+    if ((!(options & LYD_OPT_TYPEMASK)
+            || (options & (LYD_OPT_CONFIG | LYD_OPT_GET | LYD_OPT_GETCONFIG | LYD_OPT_EDIT))) && !(*node)) {
+        /* get context with schemas from the var_arg */
+        ctx = (struct ly_ctx *)var_arg;
+        if (!ctx) {
+            LOGERR(NULL, LY_EINVAL, "%s: invalid variable parameter (struct ly_ctx *ctx).", __func__);
+            return EXIT_FAILURE;
+        }
 
-        for (node = NULL, trg_merge_start = target; target; target = target->next) {
-            node2 = lyd_dup_to_ctx(target, 1, ctx);
-            if (!node2) {
-                goto error;
+        /* LYD_OPT_NOSIBLINGS has no meaning here */
+        options &= ~LYD_OPT_NOSIBLINGS;
+    } else if (options & (LYD_OPT_RPC | LYD_OPT_RPCREPLY | LYD_OPT_NOTIF)) {
+        /* LYD_OPT_NOSIBLINGS cannot be set in this case */
+        if (options & LYD_OPT_NOSIBLINGS) {
+            LOGERR(NULL, LY_EINVAL, "%s: invalid parameter (variable arg const struct lyd_node *data_tree with LYD_OPT_NOSIBLINGS).", __func__);
+            return EXIT_FAILURE;
+        } else if (!(*node)) {
+            LOGARG;
+            return EXIT_FAILURE;
+        }
+
+        /* get the additional data tree if given */
+        data_tree = (struct lyd_node *)var_arg;
+        if (data_tree) {
+            if (options & LYD_OPT_NOEXTDEPS) {
+                LOGERR(NULL, LY_EINVAL, "%s: invalid parameter (variable arg const struct lyd_node *data_tree and LYD_OPT_NOEXTDEPS set).",
+                       __func__);
+                return EXIT_FAILURE;
             }
-            if (node) {
-                if (lyd_insert_after(node->prev, node2)) {
-                    goto error;
+
+            LY_TREE_FOR(data_tree, iter) {
+                if (iter->parent) {
+                    /* a sibling is not top-level */
+                    LOGERR(NULL, LY_EINVAL, "%s: invalid variable parameter (const struct lyd_node *data_tree).", __func__);
+                    return EXIT_FAILURE;
                 }
-            } else {
-                node = node2;
             }
+
+            /* move it to the beginning */
+            for (; data_tree->prev->next; data_tree = data_tree->prev);
+        }
+    } else if (options & LYD_OPT_DATA_TEMPLATE) {
+        /* get context with schemas from the var_arg */
+        if (*node && ((*node)->prev->next || (*node)->next)) {
+            /* not allow sibling in top-level */
+            LOGERR(NULL, LY_EINVAL, "%s: invalid variable parameter (struct lyd_node *node).", __func__);
+            return EXIT_FAILURE;
         }
-        target = node;
-        node = NULL;
-    } else if (src->schema->module->ctx != target->schema->module->ctx) {
-        /* the source data will be converted into the target's context during the merge */
-        ctx = target->schema->module->ctx;
-    } else if (ctx == src->schema->module->ctx) {
-        /* no conversion is needed */
-        ctx = NULL;
     }
 
-    /* find source top-level schema node */
-    for (src_snode = src->schema, src_depth = 0;
-         (src_snode = lys_parent(src_snode)) && src_snode->nodetype != LYS_EXT;
-         ++src_depth);
+    if (options & LYD_OPT_VAL_DIFF_REF) {
+        va_start(ap, var_arg);
+        changes = va_arg(ap, struct lyd_val_change **);
+        va_end(ap);
+        if (!changes) {
+            LOGERR(ctx, LY_EINVAL, "%s: invalid variable parameter (struct lyd_val_change **).", __func__);
+            return EXIT_FAILURE;
+        }
+    } else if (options & LYD_OPT_VAL_DIFF) {
+        va_start(ap, var_arg);
+        diff = va_arg(ap, struct lyd_difflist **);
+        va_end(ap);
+        if (!diff) {
+            LOGERR(ctx, LY_EINVAL, "%s: invalid variable parameter (struct lyd_difflist **).", __func__);
+            return EXIT_FAILURE;
+        }
+    }
 
-    /* find first shared missing schema parent of the subtrees */
-    trg_merge_start = target;
-    depth = 0;
-    first_iter = 1;
-    if (src_depth) {
-        /* we are going to create missing parents in the following loop,
-         * but we will need to know a dflt flag for them. In case the newly
-         * created parent is going to have at least one non-default child,
-         * it will be also non-default, otherwise it will be the default node */
-        if (options & LYD_OPT_NOSIBLINGS) {
-            dflt = src->dflt;
-        } else {
-            LY_TREE_FOR(src, iter) {
-                if (!iter->dflt) {
-                    /* non default sibling -> parent is going to be
-                     * created also as non-default */
-                    dflt = 0;
-                    break;
-                }
+    if (*node) {
+        if (!ctx) {
+            ctx = (*node)->schema->module->ctx;
+        }
+        if (!(options & LYD_OPT_NOSIBLINGS)) {
+            /* check that the node is the first sibling */
+            while ((*node)->prev->next) {
+                *node = (*node)->prev;
             }
         }
     }
-    while (1) {
-        /* going from down (source root) to up (top-level or the common node with target */
-        do {
-            for (src_snode = src->schema, i = 0; i < src_depth - depth; src_snode = lys_parent(src_snode), ++i);
-            ++depth;
-        } while (src_snode != src->schema && (src_snode->nodetype & (LYS_CHOICE | LYS_CASE | LYS_USES)));
 
-        if (src_snode == src->schema) {
-            break;
-        }
+    LY_TRACE(validate_start, ctx, *node, options);
+    ret = _lyd_validate(node, data_tree, ctx, NULL, 0, diff, changes, options);
+    LY_TRACE(validate_done, ctx, *node, ret);
 
-        if (src_snode->nodetype != LYS_CONTAINER) {
-            /* we would have to create a list (the only data node with children except container), impossible */
-            LOGERR(ctx, LY_EINVAL, "Cannot create %s \"%s\" for the merge.", strnodetype(src_snode->nodetype), src_snode->name);
-            goto error;
-        }
+    return ret;
+}
 
-        /* have we created any missing containers already? if we did,
-         * it is totally useless to search for match, there won't ever be */
-        if (!src_merge_start) {
-            if (first_iter) {
-                node = trg_merge_start;
-                first_iter = 0;
-            } else {
-                node = trg_merge_start->child;
-            }
+API int
+lyd_validate_modules(struct lyd_node **node, const struct lys_module **modules, int mod_count, int options, ...)
+{
+    struct ly_ctx *ctx;
+    struct lyd_difflist **diff = NULL;
+    struct lyd_val_change **changes = NULL;
+    va_list ap;
 
-            /* find it in target data nodes */
-            LY_TREE_FOR(node, node) {
-                if (ctx) {
-                    /* we have the schema nodes in the different context */
-                    sch = lys_get_schema_inctx(src_snode, ctx);
-                    if (!sch) {
-                        LOGERR(ctx, LY_EINVAL, "Target context does not contain schema node for the data node being "
-                               "merged (%s:%s).", lys_node_module(src_snode)->name, src_snode->name);
-                        goto error;
-                    }
-                } else {
-                    /* the context is same and comparison of the schema nodes will works fine */
-                    sch = src_snode;
-                }
+    if (!node || !modules || !mod_count) {
+        LOGARG;
+        return EXIT_FAILURE;
+    }
 
-                if (node->schema == sch) {
-                    trg_merge_start = node;
-                    break;
-                }
-            }
+    ctx = modules[0]->ctx;
 
-            if (!(options & LYD_OPT_DESTRUCT)) {
-                /* the source tree will be duplicated, so to save some work in case
-                 * of different target context, create also the parents nodes in the
-                 * correct context */
-                src_snode = sch;
-            }
-        } else if (ctx && !(options & LYD_OPT_DESTRUCT)) {
-            /* get the schema node in the correct (target) context, same as above,
-             * this is done to save some work and have the source in the same context
-             * when the provided source tree is below duplicated in the target context
-             * and connected into the parents created here */
-            src_snode = lys_get_schema_inctx(src_snode, ctx);
-            if (!src_snode) {
-                LOGERR(ctx, LY_EINVAL, "Target context does not contain schema node for the data node being "
-                       "merged (%s:%s).", lys_node_module(src_snode)->name, src_snode->name);
-                goto error;
-            }
+    if (*node && !(options & LYD_OPT_NOSIBLINGS)) {
+        /* check that the node is the first sibling */
+        while ((*node)->prev->next) {
+            *node = (*node)->prev;
         }
+    }
 
-        if (!node) {
-            /* it is not there, create it */
-            node2 = _lyd_new(NULL, src_snode, dflt);
-            if (!src_merge_start) {
-                src_merge_start = node2;
-            } else {
-                if (lyd_insert(node2, src_merge_start)) {
-                    goto error;
-                }
-                src_merge_start = node2;
-            }
-        }
+    if (lyp_data_check_options(ctx, options, __func__)) {
+        return EXIT_FAILURE;
     }
 
-    /* process source according to options */
-    if (options & LYD_OPT_DESTRUCT) {
-        LY_TREE_FOR(src, iter) {
-            check_leaf_list_backlinks((struct lyd_node *)iter, 2);
-            if (options & LYD_OPT_NOSIBLINGS) {
-                break;
-            }
-        }
+    if ((options & LYD_OPT_TYPEMASK) && !(options & (LYD_OPT_CONFIG | LYD_OPT_GET | LYD_OPT_GETCONFIG | LYD_OPT_EDIT))) {
+        LOGERR(NULL, LY_EINVAL, "%s: options include a forbidden data type.", __func__);
+        return EXIT_FAILURE;
+    }
 
-        node = (struct lyd_node *)src;
-        if ((node->prev != node) && (options & LYD_OPT_NOSIBLINGS)) {
-            node2 = node->prev;
-            lyd_unlink(node);
-            lyd_free_withsiblings(node2);
+    if (options & LYD_OPT_VAL_DIFF_REF) {
+        va_start(ap, options);
+        changes = va_arg(ap, struct lyd_val_change **);
+        va_end(ap);
+        if (!changes) {
+            LOGERR(ctx, LY_EINVAL, "%s: invalid variable parameter (struct lyd_val_change **).", __func__);
+            return EXIT_FAILURE;
         }
-    } else {
-        node = NULL;
-        for (; src; src = src->next) {
-            /* because we already have to duplicate it, do it in the correct context */
-            node2 = lyd_dup_to_ctx(src, 1, ctx);
-            if (!node2) {
-                lyd_free_withsiblings(node);
-                goto error;
-            }
-            if (node) {
-                if (lyd_insert_after(node->prev, node2)) {
-                    lyd_free_withsiblings(node);
-                    goto error;
-                }
-            } else {
-                node = node2;
-            }
-
-            if (options & LYD_OPT_NOSIBLINGS) {
-                break;
-            }
+    } else if (options & LYD_OPT_VAL_DIFF) {
+        va_start(ap, options);
+        diff = va_arg(ap, struct lyd_difflist **);
+        va_end(ap);
+        if (!diff) {
+            LOGERR(ctx, LY_EINVAL, "%s: invalid variable parameter (struct lyd_difflist **).", __func__);
+            return EXIT_FAILURE;
         }
     }
 
-    if (src_merge_start) {
-        /* insert data into the created parents */
-        /* first, get the lowest created parent, we don't have to check the nodetype since we are
-         * creating only a simple chain of containers */
-        for (node2 = src_merge_start; node2->child; node2 = node2->child);
-        node2->child = node;
-        LY_TREE_FOR(node, node) {
-            node->parent = node2;
-        }
-    } else {
-        src_merge_start = node;
+    return _lyd_validate(node, *node, ctx, modules, mod_count, diff, changes, options);
+}
+
+API int
+lyd_validate_value(struct lys_node *node, const char *value)
+{
+    struct lyd_node_leaf_list leaf;
+    struct lys_node_leaf *sleaf = (struct lys_node_leaf*)node;
+    int ret = EXIT_SUCCESS;
+
+    if (!node || !(node->nodetype & (LYS_LEAF | LYS_LEAFLIST))) {
+        LOGARG;
+        return EXIT_FAILURE;
+    }
+
+    if (!value) {
+        value = "";
     }
 
-    if (!first_iter) {
-        /* !! src_merge start is a child(ren) of trg_merge_start */
-        ret = lyd_merge_parent_children(trg_merge_start, src_merge_start, options);
+    /* dummy leaf */
+    memset(&leaf, 0, sizeof leaf);
+    leaf.value_str = lydict_insert(node->module->ctx, value, 0);
+
+repeat:
+    leaf.value_type = sleaf->type.base;
+    leaf.schema = node;
+
+    if (leaf.value_type == LY_TYPE_LEAFREF) {
+        if (!sleaf->type.info.lref.target) {
+            /* it should either be unresolved leafref (leaf.value_type are ORed flags) or it will be resolved */
+            LOGINT(node->module->ctx);
+            ret = EXIT_FAILURE;
+            goto cleanup;
+        }
+        sleaf = sleaf->type.info.lref.target;
+        goto repeat;
     } else {
-        /* !! src_merge start is a (top-level) sibling(s) of trg_merge_start */
-        ret = lyd_merge_siblings(trg_merge_start, src_merge_start, options);
-    }
-    /* it was freed whatever the return value */
-    src_merge_start = NULL;
-    if (ret == 2) {
-        /* clear remporary LYD_VAL_INUSE validation flags */
-        LY_TREE_DFS_BEGIN(target, node2, node) {
-            node->validity &= ~LYD_VAL_INUSE;
-            LY_TREE_DFS_END(target, node2, node);
+        if (!lyp_parse_value(&sleaf->type, &leaf.value_str, NULL, &leaf, NULL, NULL, 0, 0, 0)) {
+            ret = EXIT_FAILURE;
+            goto cleanup;
         }
-        ret = 0;
-    } else if (ret) {
-        goto error;
     }
 
-    if (target->schema->nodetype == LYS_RPC) {
-        lyd_schema_sort(target, 1);
+cleanup:
+    lydict_remove(node->module->ctx, leaf.value_str);
+    return ret;
+}
+
+struct lyd_value_checker {
+    struct lys_node *node;          /* leaf or leaf-list */
+    int fallback;                   /* values checked by lyd_validate_value() */
+    uint32_t count;                 /* number of the types, union members in order */
+    struct {
+        struct lys_type *type;
+#ifdef LY_ENABLED_CACHE
+        struct lys_type_eff *eff;
+#endif
+    } types[];
+};
+
+/* whether a type can be checked directly, union members are added one by one */
+static int
+lyd_value_checker_add(struct ly_ctx *ctx, struct lys_type *type, struct lyd_value_checker *checker, uint32_t *count)
+{
+    struct lys_type *t = NULL;
+    int found = 0;
+
+    while (type->base == LY_TYPE_LEAFREF) {
+        if (!type->info.lref.target) {
+            return 0;
+        }
+        type = &type->info.lref.target->type;
     }
 
-    /* update the pointer to the target tree if needed */
-    if (*trg != target) {
-        lyd_free_withsiblings(*trg);
-        (*trg) = target;
+    switch (type->base) {
+    case LY_TYPE_UNION:
+        if (type->info.uni.has_ptr_type) {
+            return 0;
+        }
+        while ((t = lyp_get_next_union_type(type, t, &found))) {
+            found = 0;
+            if (!lyd_value_checker_add(ctx, t, checker, count)) {
+                return 0;
+            }
+        }
+        return 1;
+    case LY_TYPE_IDENT:
+    case LY_TYPE_INST:
+        return 0;
+    default:
+        break;
     }
-    return ret;
 
-error:
-    if (*trg != target) {
-        /* target is duplication of the original target in different context,
-         * free it due to the error */
-        lyd_free_withsiblings(target);
+#ifdef LY_ENABLED_CACHE
+    if (checker) {
+        checker->types[*count].type = type;
+        checker->types[*count].eff = lys_type_eff(ctx, type);
+        if (!checker->types[*count].eff) {
+            return 0;
+        }
     }
-    lyd_free_withsiblings(src_merge_start);
-    return -1;
+    ++(*count);
+    return 1;
+#else
+    (void)ctx;
+    (void)checker;
+    (void)count;
+    return 0;
+#endif
 }
 
-API int
-lyd_merge(struct lyd_node *target, const struct lyd_node *source, int options)
+API struct lyd_value_checker *
+lyd_value_checker_new(const struct lys_node *node)
 {
-    if (!target || !source) {
+    struct lyd_value_checker *checker;
+    struct ly_ctx *ctx;
+    uint32_t count = 0;
+
+    if (!node || !(node->nodetype & (LYS_LEAF | LYS_LEAFLIST))) {
         LOGARG;
-        return -1;
+        return NULL;
     }
+    ctx = node->module->ctx;
 
-    return lyd_merge_to_ctx(&target, source, options, target->schema->module->ctx);
+    if (!lyd_value_checker_add(ctx, &((struct lys_node_leaf *)node)->type, NULL, &count)) {
+        count = 0;
+    }
+    checker = calloc(1, sizeof *checker + count * sizeof *checker->types);
+    LY_CHECK_ERR_RETURN(!checker, LOGMEM(ctx), NULL);
+    checker->node = (struct lys_node *)node;
+
+    if (!count) {
+        checker->fallback = 1;
+    } else if (!lyd_value_checker_add(ctx, &((struct lys_node_leaf *)node)->type, checker, &checker->count)) {
+        /* the effective types could not be built */
+        free(checker);
+        return NULL;
+    }
+
+    return checker;
 }
 
 API void
-lyd_free_diff(struct lyd_difflist *diff)
+lyd_value_checker_free(struct lyd_value_checker *checker)
 {
-    if (diff) {
-        free(diff->type);
-        free(diff->first);
-        free(diff->second);
-        free(diff);
+    free(checker);
+}
+
+#ifdef LY_ENABLED_CACHE
+
+/* every length or range restriction of the chain */
+static int
+lyd_value_check_intv(const struct lys_type_eff *eff, uint64_t value)
+{
+    uint32_t i;
+
+    for (i = 0; eff->intv && (i < eff->intv->group_count); ++i) {
+        if (!resolve_len_ran_match(&eff->intv->group[i], value)) {
+            return EXIT_FAILURE;
+        }
     }
+    return EXIT_SUCCESS;
 }
 
+/* the same lexical rules as lyp_parse_value() for instance values */
 static int
-lyd_difflist_add(struct lyd_difflist *diff, unsigned int *size, unsigned int index,
-                 LYD_DIFFTYPE type, struct lyd_node *first, struct lyd_node *second)
+lyd_value_check_type(struct ly_ctx *ctx, struct lys_type *type, const struct lys_type_eff *eff, const char *value)
 {
-    void *new;
-    struct ly_ctx *ctx = (first ? first->schema->module->ctx : second->schema->module->ctx);
+    const char *ptr, *ptr2;
+    char *end;
+    size_t len, len2, u, chars;
+    int64_t num, min, max;
+    uint64_t unum, umax;
+    uint32_t i, j;
+    int pad = 0;
+    struct lys_type_enum *enm;
+    struct lys_type_bit *bit;
 
-    assert(diff);
-    assert(size && *size);
+    switch (type->base) {
+    case LY_TYPE_BINARY:
+        for (ptr = value; isspace(*ptr); ++ptr);
+        len = strlen(ptr);
+        while (len && isspace(ptr[len - 1])) {
+            --len;
+        }
+        chars = len;
+        for (u = lyp_base64_span(ptr, len); u < len; ++u) {
+            if (ptr[u] == '\n') {
+                --chars;
+            } else if (((ptr[u] < '/') && (ptr[u] != '+')) || ((ptr[u] > '9') && (ptr[u] < 'A'))
+                    || ((ptr[u] > 'Z') && (ptr[u] < 'a')) || (ptr[u] > 'z')) {
+                if ((ptr[u] == '=') && (u == len - 2) && (ptr[u + 1] == '=')) {
+                    pad = 2;
+                    ++u;
+                } else if ((ptr[u] == '=') && (u == len - 1)) {
+                    pad = 1;
+                } else {
+                    return EXIT_FAILURE;
+                }
+            }
+        }
+        if (chars & 3) {
+            return EXIT_FAILURE;
+        }
+        return lyd_value_check_intv(eff, ((chars / 4) * 3) - pad);
 
-    if (index + 1 == *size) {
-        /* it's time to enlarge */
-        *size = *size + 16;
-        new = realloc(diff->type, *size * sizeof *diff->type);
-        LY_CHECK_ERR_RETURN(!new, LOGMEM(ctx), EXIT_FAILURE);
-        diff->type = new;
+    case LY_TYPE_BITS:
+        type = eff->info;
+        for (ptr = value; *ptr; ptr += len) {
+            for (; isspace(*ptr); ++ptr);
+            if (!*ptr) {
+                break;
+            }
+            for (len = 0; ptr[len] && !isspace(ptr[len]); ++len);
 
-        new = realloc(diff->first, *size * sizeof *diff->first);
-        LY_CHECK_ERR_RETURN(!new, LOGMEM(ctx), EXIT_FAILURE);
-        diff->first = new;
+            if (!lys_find_bit_hash(ctx, type, ptr, len, &bit)) {
+                i = bit ? bit - type->info.bits.bit : type->info.bits.count;
+            } else {
+                for (i = 0; i < type->info.bits.count; i++) {
+                    if (!strncmp(type->info.bits.bit[i].name, ptr, len) && !type->info.bits.bit[i].name[len]) {
+                        break;
+                    }
+                }
+            }
+            if (i == type->info.bits.count) {
+                return EXIT_FAILURE;
+            }
+            for (j = 0; j < type->info.bits.bit[i].iffeature_size; ++j) {
+                if (!resolve_iffeature(&type->info.bits.bit[i].iffeature[j])) {
+                    return EXIT_FAILURE;
+                }
+            }
 
-        new = realloc(diff->second, *size * sizeof *diff->second);
-        LY_CHECK_ERR_RETURN(!new, LOGMEM(ctx), EXIT_FAILURE);
-        diff->second = new;
-    }
+            /* used multiple times */
+            for (ptr2 = value; ptr2 < ptr; ptr2 += len2) {
+                for (; isspace(*ptr2); ++ptr2);
+                if (ptr2 == ptr) {
+                    break;
+                }
+                for (len2 = 0; ptr2[len2] && !isspace(ptr2[len2]); ++len2);
+                if ((len2 == len) && !strncmp(ptr2, ptr, len)) {
+                    return EXIT_FAILURE;
+                }
+            }
+        }
+        return EXIT_SUCCESS;
 
-    /* insert the item */
-    diff->type[index] = type;
-    diff->first[index] = first;
-    diff->second[index] = second;
+    case LY_TYPE_BOOL:
+        return (!strcmp(value, "true") || !strcmp(value, "false")) ? EXIT_SUCCESS : EXIT_FAILURE;
 
-    /* terminate the arrays */
-    index++;
-    diff->type[index] = LYD_DIFF_END;
-    diff->first[index] = NULL;
-    diff->second[index] = NULL;
+    case LY_TYPE_DEC64:
+        ptr = value;
+        if (!value[0] || parse_range_dec64(&ptr, type->info.dec64.dig, &num) || ptr[0]) {
+            return EXIT_FAILURE;
+        }
+        return lyd_value_check_intv(eff, LEN_RAN_SIGNED(num));
 
-    return EXIT_SUCCESS;
-}
+    case LY_TYPE_EMPTY:
+        return value[0] ? EXIT_FAILURE : EXIT_SUCCESS;
 
-struct diff_ordered_dist {
-    struct diff_ordered_dist *next;
-    int dist;
-};
-struct diff_ordered_item {
-    struct lyd_node *first;
-    struct lyd_node *second;
-    struct diff_ordered_dist *dist;
-};
-struct diff_ordered {
-    struct lys_node *schema;
-    struct lyd_node *parent;
-    unsigned int count;
-    struct diff_ordered_item *items; /* array */
-    struct diff_ordered_dist *dist;  /* linked list (1-way, ring) */
-    struct diff_ordered_dist *dist_last;  /* aux pointer for faster insertion sort */
-};
+    case LY_TYPE_ENUM:
+        type = eff->info;
+        if (!lys_find_enum_hash(ctx, type, value, &enm)) {
+            i = enm ? enm - type->info.enums.enm : type->info.enums.count;
+        } else {
+            for (i = 0; (i < type->info.enums.count) && strcmp(value, type->info.enums.enm[i].name); i++);
+        }
+        if (i == type->info.enums.count) {
+            return EXIT_FAILURE;
+        }
+        for (j = 0; j < type->info.enums.enm[i].iffeature_size; ++j) {
+            if (!resolve_iffeature(&type->info.enums.enm[i].iffeature[j])) {
+                return EXIT_FAILURE;
+            }
+        }
+        return EXIT_SUCCESS;
 
-static int
-diff_ordset_insert(struct lyd_node *node, struct ly_set *ordset)
-{
-    unsigned int i;
-    struct diff_ordered *new_ordered, *iter;
+    case LY_TYPE_STRING:
+        if (lyd_value_check_intv(eff, ly_utf8_count(value, strlen(value)))) {
+            return EXIT_FAILURE;
+        }
+        for (i = 0; i < eff->pat_count; ++i) {
+            if (lyp_regex_exec((pcre *)eff->pat[i].regex, (pcre_extra *)eff->pat[i].study, value)) {
+                /* no match */
+                if (eff->pat[i].restr->expr[0] == 0x06) {
+                    return EXIT_FAILURE;
+                }
+            } else if (eff->pat[i].restr->expr[0] == 0x15) {
+                /* inverted match */
+                return EXIT_FAILURE;
+            }
+        }
+        return EXIT_SUCCESS;
 
-    for (i = 0; i < ordset->number; i++) {
-        iter = (struct diff_ordered *)ordset->set.g[i];
-        if (iter->schema == node->schema && iter->parent == node->parent) {
+    case LY_TYPE_INT8:
+    case LY_TYPE_INT16:
+    case LY_TYPE_INT32:
+    case LY_TYPE_INT64:
+        switch (type->base) {
+        case LY_TYPE_INT8:
+            min = INT8_MIN;
+            max = INT8_MAX;
+            break;
+        case LY_TYPE_INT16:
+            min = INT16_MIN;
+            max = INT16_MAX;
+            break;
+        case LY_TYPE_INT32:
+            min = INT32_MIN;
+            max = INT32_MAX;
+            break;
+        default:
+            min = INT64_MIN;
+            max = INT64_MAX;
             break;
         }
-    }
-    if (i == ordset->number) {
-        /* not seen user-ordered list */
-        new_ordered = calloc(1, sizeof *new_ordered);
-        LY_CHECK_ERR_RETURN(!new_ordered, LOGMEM(node->schema->module->ctx), EXIT_FAILURE);
-        new_ordered->schema = node->schema;
-        new_ordered->parent = node->parent;
+        if (!value[0]) {
+            return EXIT_FAILURE;
+        }
+        errno = 0;
+        num = strtoll(value, &end, 10);
+        if (errno || (num < min) || (num > max)) {
+            return EXIT_FAILURE;
+        }
+        for (; isspace(*end); ++end);
+        if (*end) {
+            return EXIT_FAILURE;
+        }
+        return lyd_value_check_intv(eff, LEN_RAN_SIGNED(num));
 
-        ly_set_add(ordset, new_ordered, LY_SET_OPT_USEASLIST);
-    }
-    ((struct diff_ordered *)ordset->set.g[i])->count++;
+    case LY_TYPE_UINT8:
+    case LY_TYPE_UINT16:
+    case LY_TYPE_UINT32:
+    case LY_TYPE_UINT64:
+        switch (type->base) {
+        case LY_TYPE_UINT8:
+            umax = UINT8_MAX;
+            break;
+        case LY_TYPE_UINT16:
+            umax = UINT16_MAX;
+            break;
+        case LY_TYPE_UINT32:
+            umax = UINT32_MAX;
+            break;
+        default:
+            umax = UINT64_MAX;
+            break;
+        }
+        if (!value[0]) {
+            return EXIT_FAILURE;
+        }
+        errno = 0;
+        unum = strtoull(value, &end, 10);
+        if (errno || (unum > umax)) {
+            return EXIT_FAILURE;
+        }
+        if (*end) {
+            for (; isspace(*end); ++end);
+            if (*end) {
+                return EXIT_FAILURE;
+            }
+        } else if (unum && (value[0] == '-')) {
+            return EXIT_FAILURE;
+        }
+        return lyd_value_check_intv(eff, unum);
 
-    return EXIT_SUCCESS;
+    default:
+        return EXIT_FAILURE;
+    }
 }
 
-static void
-diff_ordset_free(struct ly_set *set)
+#endif
+
+API int
+lyd_value_check(const struct lyd_value_checker *checker, const char *value)
 {
-    unsigned int i, j;
-    struct diff_ordered *ord;
+    enum int_log_opts prev_ilo;
+    int ret;
+#ifdef LY_ENABLED_CACHE
+    uint32_t u;
+#endif
 
-    if (!set) {
-        return;
+    if (!checker) {
+        LOGARG;
+        return EXIT_FAILURE;
     }
 
-    for (i = 0; i < set->number; i++) {
-        ord = (struct diff_ordered *)set->set.g[i];
-        for (j = 0; j < ord->count; j++) {
-            free(ord->items[j].dist);
-        }
-        free(ord->items);
-        free(ord);
+    if (!value) {
+        value = "";
     }
 
-    ly_set_free(set);
-}
-
-/*
- * -1 - error
- *  0 - ok
- *  1 - first and second not the same
- */
-static int
-lyd_diff_compare(struct lyd_node *first, struct lyd_node *second, int options)
-{
-    int rc;
-
-    if (first->dflt && !(options & LYD_DIFFOPT_WITHDEFAULTS)) {
-        /* the second one cannot be default (see lyd_diff()),
-         * so the nodes differs (first one is default node) */
-        return 1;
+    if (checker->fallback) {
+        ly_ilo_change(NULL, ILO_IGNORE, &prev_ilo, NULL);
+        ret = lyd_validate_value(checker->node, value);
+        ly_ilo_restore(NULL, prev_ilo, NULL, 0);
+        return ret;
     }
 
-    if (first->schema->nodetype & (LYS_LEAFLIST | LYS_LIST)) {
-        if (first->validity & LYD_VAL_INUSE) {
-            /* this node was already matched, it cannot be matched twice (except for state leaf-/lists,
-             * which we want to keep the count on this way) */
-            return 1;
-        }
-
-        rc = lyd_list_equal(first, second, (options & LYD_DIFFOPT_WITHDEFAULTS ? 1 : 0));
-        if (rc == -1) {
-            return -1;
-        } else if (!rc) {
-            /* list instances differs */
-            return 1;
+#ifdef LY_ENABLED_CACHE
+    /* any union member */
+    for (u = 0; u < checker->count; ++u) {
+        if (!lyd_value_check_type(checker->node->module->ctx, checker->types[u].type, checker->types[u].eff, value)) {
+            return EXIT_SUCCESS;
         }
-        /* matches */
     }
-
-    return 0;
+#endif
+    return EXIT_FAILURE;
 }
 
-/*
- * -1 - error
- *  0 - ok
- */
-static int
-lyd_diff_match(struct lyd_node *first, struct lyd_node *second, struct lyd_difflist *diff, unsigned int *size,
-               unsigned int *i, struct ly_set *matchset, struct ly_set *ordset, int options)
+/* create an attribute copy */
+static struct lyd_attr *
+lyd_dup_attr(struct ly_ctx *ctx, struct lyd_node *parent, struct lyd_attr *attr)
 {
-    switch (first->schema->nodetype) {
-    case LYS_LEAFLIST:
-    case LYS_LIST:
-        /* additional work for future move matching in case of user ordered lists */
-        if (first->schema->flags & LYS_USERORDERED) {
-            diff_ordset_insert(first, ordset);
-        }
+    struct lyd_attr *ret;
 
-        /* falls through */
-    case LYS_CONTAINER:
-        assert(!(second->validity & LYD_VAL_INUSE));
-        second->validity |= LYD_VAL_INUSE;
-        /* remember the matching node in first for keeping correct pointer in first
-         * for comparing when passing through the second tree in lyd_diff().
-         * Duplicities are not allowed actually, but they cannot happen since single
-         * node can match only one node in the other tree */
-        ly_set_add(matchset, first, LY_SET_OPT_USEASLIST);
+    /* allocate new attr */
+    if (!parent->attr) {
+        parent->attr = malloc(sizeof *parent->attr);
+        ret = parent->attr;
+    } else {
+        for (ret = parent->attr; ret->next; ret = ret->next);
+        ret->next = calloc(1, sizeof *ret);
+        ret = ret->next;
+    }
+    LY_CHECK_ERR_RETURN(!ret, LOGMEM(ctx), NULL);
+
+    /* fill new attr except */
+    ret->parent = parent;
+    ret->next = NULL;
+    ret->annotation = attr->annotation;
+    ret->name = lydict_insert(ctx, attr->name, 0);
+    ret->value_str = lydict_insert(ctx, attr->value_str, 0);
+    ret->value_type = attr->value_type;
+    ret->value_flags = attr->value_flags;
+    switch (ret->value_type) {
+    case LY_TYPE_BINARY:
+    case LY_TYPE_STRING:
+        /* value_str pointer is shared in these cases */
+        ret->value.string = ret->value_str;
         break;
-    case LYS_LEAF:
-        /* check for leaf's modification */
-        if (!lyd_leaf_val_equal(first, second, 0) || ((options & LYD_DIFFOPT_WITHDEFAULTS) && (first->dflt != second->dflt))) {
-            if (lyd_difflist_add(diff, size, (*i)++, LYD_DIFF_CHANGED, first, second)) {
-               return -1;
-            }
-        }
+    case LY_TYPE_LEAFREF:
+        lyp_parse_value(*((struct lys_type **)lys_ext_complex_get_substmt(LY_STMT_TYPE, ret->annotation, NULL)),
+                             &ret->value_str, NULL, NULL, ret, NULL, 1, 0, 0);
         break;
-    case LYS_ANYXML:
-    case LYS_ANYDATA:
-        /* check for anydata/anyxml's modification */
-        if (!lyd_anydata_equal(first, second) && lyd_difflist_add(diff, size, (*i)++, LYD_DIFF_CHANGED, first, second)) {
-            return -1;
-        }
+    case LY_TYPE_INST:
+        ret->value.instance = NULL;
+        break;
+    case LY_TYPE_UNION:
+        /* unresolved union (this must be non-validated tree), duplicate the stored string (duplicated
+         * because of possible change of the value in case of instance-identifier) */
+        ret->value.string = lydict_insert(ctx, attr->value.string, 0);
+        break;
+    case LY_TYPE_ENUM:
+    case LY_TYPE_IDENT:
+    case LY_TYPE_BITS:
+        /* in case of duplicating bits (no matter if in the same context or not) or enum and identityref into
+         * a different context, searching for the type and duplicating the data is almost as same as resolving
+         * the string value, so due to a simplicity, parse the value for the duplicated leaf */
+        lyp_parse_value(*((struct lys_type **)lys_ext_complex_get_substmt(LY_STMT_TYPE, ret->annotation, NULL)),
+                             &ret->value_str, NULL, NULL, ret, NULL, 1, 0, 0);
         break;
     default:
-        LOGINT(first->schema->module->ctx);
-        return -1;
-    }
-
-    /* mark both that they have matching instance in the other tree */
-    assert(!(first->validity & LYD_VAL_INUSE));
-    first->validity |= LYD_VAL_INUSE;
-
-    return 0;
-}
-
-/* @brief compare if the nodes are equivalent including checking the list's keys
- * Go through the nodes and their parents and in the case of list, compare its keys.
- *
- * @return 0 different, 1 equivalent
- */
-static int
-lyd_diff_equivnode(struct lyd_node *first, struct lyd_node *second)
-{
-    struct lyd_node *iter1, *iter2;
-
-    for (iter1 = first, iter2 = second; iter1 && iter2; iter1 = iter1->parent, iter2 = iter2->parent) {
-        if (iter1->schema->module->ctx == iter2->schema->module->ctx) {
-            if (iter1->schema != iter2->schema) {
-                return 0;
-            }
-        } else {
-            if (!ly_strequal(iter1->schema->name, iter2->schema->name, 0)) {
-                /* comparing the names is fine, even if they are, in fact, 2 different nodes
-                 * with equal names, some of their parents will differ */
-                return 0;
-            }
-        }
-        if (iter1->schema->nodetype == LYS_LIST) {
-            /* compare keys */
-            if (lyd_list_equal(iter1, iter2, 0) != 1) {
-                return 0;
-            }
-        }
-    }
-
-    if (iter1 != iter2) {
-        /* we are supposed to be in root (NULL) in both trees */
-        return 0;
+        ret->value = attr->value;
+        break;
     }
-
-    return 1;
+    return ret;
 }
 
-static int
-lyd_diff_move_preprocess(struct diff_ordered *ordered, struct lyd_node *first, struct lyd_node *second)
+int
+lyd_unlink_internal(struct lyd_node *node, int permanent)
 {
-    struct ly_ctx *ctx = first->schema->module->ctx;
     struct lyd_node *iter;
-    unsigned int pos = 0;
-    int abs_dist;
-    struct diff_ordered_dist *dist_aux;
-    struct diff_ordered_dist *dist_iter, *dist_last;
-    char *str = NULL;
 
-    /* ordered->count was zeroed and now it is incremented with each added
-     * item's information, so it is actually position of the second node
-     */
+    if (!node) {
+        LOGARG;
+        return EXIT_FAILURE;
+    }
 
-    /* get the position of the first node */
-    for (iter = first->prev; iter->next; iter = iter->prev) {
-        if (!(iter->validity & LYD_VAL_INUSE)) {
-            /* skip deleted nodes */
-            continue;
-        }
-        if (iter->schema == first->schema) {
-            pos++;
-        }
+    if (permanent) {
+        check_leaf_list_backlinks(node, 1);
     }
-    if (pos != ordered->count) {
-        LOGDBG(LY_LDGDIFF, "detected moved element \"%s\" from %d to %d (distance %d)",
-               str = lyd_path(first), pos, ordered->count, ordered->count - pos);
-        free(str);
+    lyd_gen_bump(node->schema->module->ctx);
+    if (permanent != 2) {
+        lyd_journal_deleted(node);
     }
 
-    /* store information, count distance */
-    ordered->items[pos].dist = dist_aux = calloc(1, sizeof *dist_aux);
-    LY_CHECK_ERR_RETURN(!dist_aux, LOGMEM(ctx), EXIT_FAILURE);
-    ordered->items[pos].dist->dist = ordered->count - pos;
-    abs_dist = abs(ordered->items[pos].dist->dist);
-    ordered->items[pos].first = first;
-    ordered->items[pos].second = second;
-    ordered->count++;
+    /* remember the removal for LYD_OPT_VAL_CHANGED validation */
+    if (node->parent) {
+        node->parent->validity |= LYD_VAL_MAND;
+    } else if (node->next) {
+        node->next->validity |= LYD_VAL_TOPDEL;
+    } else if (node->prev != node) {
+        node->prev->validity |= LYD_VAL_TOPDEL;
+    }
 
-    /* insert sort of distances, higher first */
-    for (dist_iter = ordered->dist, dist_last = NULL;
-            dist_iter;
-            dist_last = dist_iter, dist_iter = dist_iter->next) {
-        if (abs_dist >= abs(dist_iter->dist)) {
-            /* found correct place */
-            dist_aux->next = dist_iter;
-            if (dist_last) {
-                dist_last->next = dist_aux;
-            }
-            break;
-        } else if (dist_iter->next == ordered->dist) {
-            /* last item */
-            dist_aux->next = ordered->dist; /* ring list */
-            ordered->dist_last = dist_aux;
-            break;
-        }
+    /* unlink from siblings */
+    if (node->prev->next) {
+        node->prev->next = node->next;
     }
-    if (dist_aux->next == ordered->dist) {
-        if (ordered->dist_last == dist_aux) {
-            /* last item */
-            if (!ordered->dist) {
-                /* the only item */
-                dist_aux->next = dist_aux;
-                ordered->dist = ordered->dist_last = dist_aux;
-            }
+    if (node->next) {
+        node->next->prev = node->prev;
+    } else {
+        /* unlinking the last node */
+        if (node->parent) {
+            iter = node->parent->child;
         } else {
-            /* first item */
-            ordered->dist = dist_aux;
-            if (dist_aux->next) {
-                /* more than one item, update the last one's next */
-                ordered->dist_last->next = dist_aux;
-            } else {
-                /* the only item */
-                ordered->dist_last = dist_aux;
-                dist_aux->next = dist_aux; /* ring list */
+            iter = node->prev;
+            while (iter->prev != node) {
+                iter = iter->prev;
             }
         }
+        /* update the "last" pointer from the first node */
+        iter->prev = node->prev;
+    }
+
+    /* unlink from parent */
+    if (node->parent) {
+        if (node->parent->child == node) {
+            /* the node is the first child */
+            node->parent->child = node->next;
+        }
+
+#ifdef LY_ENABLED_CACHE
+        /* do not remove from parent hash table if freeing the whole subtree */
+        if (permanent != 2) {
+            lyd_unlink_hash(node, node->parent);
+        }
+#endif
+
+        node->parent = NULL;
     }
 
-    return 0;
+    node->next = NULL;
+    node->prev = node;
+
+    return EXIT_SUCCESS;
 }
 
-static struct lyd_difflist *
-lyd_diff_init_difflist(struct ly_ctx *ctx, unsigned int *size)
+API int
+lyd_unlink(struct lyd_node *node)
 {
-    struct lyd_difflist *result;
+    return lyd_unlink_internal(node, 1);
+}
 
-    result = malloc(sizeof *result);
-    LY_CHECK_ERR_RETURN(!result, LOGMEM(ctx); *size = 0, NULL);
+/*
+ * - in leaflist it must be added with value_str
+ */
+static int
+_lyd_dup_node_common(struct lyd_node *new_node, const struct lyd_node *orig, struct ly_ctx *ctx, int options)
+{
+    struct lyd_attr *attr;
 
-    *size = 1;
-    result->type = calloc(*size, sizeof *result->type);
-    result->first = calloc(*size, sizeof *result->first);
-    result->second = calloc(*size, sizeof *result->second);
-    if (!result->type || !result->first || !result->second) {
-        LOGMEM(ctx);
-        free(result->second);
-        free(result->first);
-        free(result->type);
-        free(result);
-        *size = 0;
-        return NULL;
+    new_node->attr = NULL;
+    if (!(options & LYD_DUP_OPT_NO_ATTR)) {
+        LY_TREE_FOR(orig->attr, attr) {
+            lyd_dup_attr(ctx, new_node, attr);
+        }
+    }
+    new_node->next = NULL;
+    new_node->prev = new_node;
+    new_node->parent = NULL;
+    new_node->validity = ly_new_node_validity(new_node->schema);
+    new_node->dflt = orig->dflt;
+    new_node->when_status = orig->when_status & LYD_WHEN;
+#ifdef LY_ENABLED_CACHE
+    /* just copy the hash, it will not change (key-less list hashes are adjusted by its children inserted later) */
+    if ((new_node->schema->nodetype == LYS_LIST) && !((struct lys_node_list *)new_node->schema)->keys_size) {
+        lyd_hash(new_node);
+    } else if ((new_node->schema->nodetype != LYS_LIST) || lyd_list_has_keys(new_node)) {
+        new_node->hash = orig->hash;
     }
+#endif
 
-    return result;
+#ifdef LY_ENABLED_LYD_PRIV
+    if (ctx->priv_dup_clb) {
+        new_node->priv = ctx->priv_dup_clb(orig->priv);
+    }
+#endif
+
+    return EXIT_SUCCESS;
 }
 
-API struct lyd_difflist *
-lyd_diff(struct lyd_node *first, struct lyd_node *second, int options)
+static struct lyd_node *
+_lyd_dup_node(const struct lyd_node *node, const struct lys_node *schema, struct ly_ctx *ctx, int options)
 {
-    struct ly_ctx *ctx;
-    int rc;
-    struct lyd_node *elem1, *elem2, *iter, *aux, *parent = NULL, *next1, *next2;
-    struct lyd_difflist *result, *result2 = NULL;
-    void *new;
-    unsigned int size, size2, index = 0, index2 = 0, i, j, k;
-    struct matchlist_s {
-        struct matchlist_s *prev;
-        struct ly_set *match;
-        unsigned int i;
-    } *matchlist = NULL, *mlaux;
-    struct ly_set *ordset = NULL;
-    struct diff_ordered *ordered;
-    struct diff_ordered_dist *dist_aux, *dist_iter;
-    struct diff_ordered_item item_aux;
+    struct lyd_node *new_node = NULL;
+    struct lys_node_leaf *sleaf;
+    struct lyd_node_leaf_list *new_leaf;
+    struct lyd_node_anydata *new_any, *old_any;
+    int r;
 
-    if (!first) {
-        /* all nodes in second were created,
-         * but the second must be top level */
-        if (second && second->parent) {
-            LOGERR(second->schema->module->ctx, LY_EINVAL, "%s: \"first\" parameter is NULL and \"second\" is not top level.", __func__);
-            return NULL;
+    /* fill specific part */
+    switch (node->schema->nodetype) {
+    case LYS_LEAF:
+    case LYS_LEAFLIST:
+        new_leaf = (struct lyd_node_leaf_list *)lyd_node_alloc(ctx, sizeof *new_leaf);
+        new_node = (struct lyd_node *)new_leaf;
+        LY_CHECK_ERR_GOTO(!new_node, LOGMEM(ctx), error);
+        new_node->schema = (struct lys_node *)schema;
+
+        new_leaf->value_type = ((struct lyd_node_leaf_list *)node)->value_type;
+        new_leaf->value_flags = ((struct lyd_node_leaf_list *)node)->value_flags & ~LY_VALUE_PRIVATE;
+        if ((ctx == node->schema->module->ctx) ? (((struct lyd_node_leaf_list *)node)->value_flags & LY_VALUE_PRIVATE)
+                : (!node->dflt && lyd_value_private(schema))) {
+            new_leaf->value_flags |= LY_VALUE_PRIVATE;
         }
-        result = lyd_diff_init_difflist(NULL, &size);
-        LY_TREE_FOR(second, iter) {
-            if (!iter->dflt || (options & LYD_DIFFOPT_WITHDEFAULTS)) { /* skip the implicit nodes */
-                if (lyd_difflist_add(result, &size, index++, LYD_DIFF_CREATED, NULL, iter)) {
-                    goto error;
-                }
-            }
-            if (options & LYD_DIFFOPT_NOSIBLINGS) {
-                break;
-            }
+        new_leaf->value_str = lydict_insert_priv(ctx, ((struct lyd_node_leaf_list *)node)->value_str, 0,
+                                                 new_leaf->value_flags & LY_VALUE_PRIVATE);
+        if (_lyd_dup_node_common(new_node, node, ctx, options)) {
+            goto error;
         }
-        return result;
-    } else if (!second) {
-        /* all nodes from first were deleted */
-        result = lyd_diff_init_difflist(first->schema->module->ctx, &size);
-        LY_TREE_FOR(first, iter) {
-            if (!iter->dflt || (options & LYD_DIFFOPT_WITHDEFAULTS)) { /* skip the implicit nodes */
-                if (lyd_difflist_add(result, &size, index++, LYD_DIFF_DELETED, iter, NULL)) {
-                    goto error;
+
+        /* get schema from the correct context */
+        sleaf = (struct lys_node_leaf *)new_leaf->schema;
+
+        switch (new_leaf->value_type) {
+        case LY_TYPE_BINARY:
+        case LY_TYPE_STRING:
+            /* value_str pointer is shared in these cases */
+            new_leaf->value.string = new_leaf->value_str;
+            break;
+        case LY_TYPE_LEAFREF:
+            new_leaf->validity |= LYD_VAL_LEAFREF;
+            lyp_parse_value(&sleaf->type, &new_leaf->value_str, NULL, new_leaf, NULL, NULL, 1, node->dflt, 0);
+            break;
+        case LY_TYPE_INST:
+            new_leaf->value.instance = NULL;
+            break;
+        case LY_TYPE_UNION:
+            /* unresolved union (this must be non-validated tree), duplicate the stored string (duplicated
+             * because of possible change of the value in case of instance-identifier) */
+            new_leaf->value.string = lydict_insert(ctx, ((struct lyd_node_leaf_list *)node)->value.string, 0);
+            break;
+        case LY_TYPE_ENUM:
+        case LY_TYPE_IDENT:
+        case LY_TYPE_BITS:
+            if ((ctx == node->schema->module->ctx) && !(new_leaf->value_flags & LY_VALUE_USER)) {
+                /* same context, the value references the same schema so it can be copied */
+                if (new_leaf->value_type != LY_TYPE_BITS) {
+                    new_leaf->value = ((struct lyd_node_leaf_list *)node)->value;
+                    break;
+                }
+
+                if (((struct lyd_node_leaf_list *)node)->value.bit) {
+                    /* the bits value is shared */
+                    new_leaf->value.bit = lyd_bits_dup(((struct lyd_node_leaf_list *)node)->value.bit);
+                    break;
                 }
             }
-            if (options & LYD_DIFFOPT_NOSIBLINGS) {
-                break;
+
+            /* in case of duplicating bits in a union or enum and identityref into a different context,
+             * searching for the type and duplicating the data is almost as same as resolving the string value,
+             * so due to a simplicity, parse the value for the duplicated leaf */
+            if (!lyp_parse_value(&sleaf->type, &new_leaf->value_str, NULL, new_leaf, NULL, NULL, 1, node->dflt, 0)) {
+                goto error;
             }
+            break;
+        default:
+            new_leaf->value = ((struct lyd_node_leaf_list *)node)->value;
+            break;
         }
-        return result;
-    }
 
-    ctx = first->schema->module->ctx;
-
-    if (options & LYD_DIFFOPT_NOSIBLINGS) {
-        /* both trees must start at the same (schema) node */
-        if (first->schema != second->schema) {
-            LOGERR(ctx, LY_EINVAL, "%s: incompatible trees to compare with LYD_OPT_NOSIBLINGS option.", __func__);
-            return NULL;
-        }
-        /* use first's and second's child to make comparison the same as without LYD_OPT_NOSIBLINGS */
-        first = first->child;
-        second = second->child;
-    } else {
-        /* go to the first sibling in both trees */
-        if (first->parent) {
-            first = first->parent->child;
-        } else {
-            while (first->prev->next) {
-                first = first->prev;
+        if (sleaf->type.der && sleaf->type.der->module) {
+            r = lytype_store(sleaf->type.der, new_leaf->value_str, &new_leaf->value);
+            if (r == -1) {
+                goto error;
+            } else if (!r) {
+                new_leaf->value_flags |= LY_VALUE_USER;
             }
         }
+        break;
+    case LYS_ANYXML:
+    case LYS_ANYDATA:
+        old_any = (struct lyd_node_anydata *)node;
+        new_any = (struct lyd_node_anydata *)lyd_node_alloc(ctx, sizeof *new_any);
+        new_node = (struct lyd_node *)new_any;
+        LY_CHECK_ERR_GOTO(!new_node, LOGMEM(ctx), error);
+        new_node->schema = (struct lys_node *)schema;
 
-        if (second->parent) {
-            second = second->parent->child;
-        } else {
-            for (; second->prev->next; second = second->prev);
+        if (_lyd_dup_node_common(new_node, node, ctx, options)) {
+            goto error;
         }
 
-        /* check that both has the same (schema) parent or that they are top-level nodes */
-        if ((first->parent && second->parent && first->parent->schema != second->parent->schema) ||
-                (!first->parent && first->parent != second->parent)) {
-            LOGERR(ctx, LY_EINVAL, "%s: incompatible trees with different parents.", __func__);
-            return NULL;
+        new_any->value_type = old_any->value_type;
+        if (!(void*)old_any->value.tree) {
+            /* no value to duplicate */
+            break;
         }
-    }
-    if (first == second) {
-        LOGERR(ctx, LY_EINVAL, "%s: comparing the same tree does not make sense.", __func__);
-        return NULL;
-    }
-
-    /* initiate resulting structure */
-    result = lyd_diff_init_difflist(ctx, &size);
-    LY_CHECK_ERR_GOTO(!result, , error);
-
-    /* the records about created and moved items are created in
-     * bad order, so the records about created nodes (and their
-     * possible moving) is stored separately and added to the
-     * main result at the end.
-     */
-    result2 = lyd_diff_init_difflist(ctx, &size2);
-    LY_CHECK_ERR_GOTO(!result2, , error);
-
-    matchlist = malloc(sizeof *matchlist);
-    LY_CHECK_ERR_GOTO(!matchlist, LOGMEM(ctx), error);
+        /* duplicate the value */
+        switch (old_any->value_type) {
+        case LYD_ANYDATA_CONSTSTRING:
+        case LYD_ANYDATA_SXML:
+        case LYD_ANYDATA_JSON:
+            new_any->value.str = lydict_insert(ctx, old_any->value.str, 0);
+            break;
+        case LYD_ANYDATA_DATATREE:
+            new_any->value.tree = lyd_dup_to_ctx(old_any->value.tree, 1, ctx);
+            break;
+        case LYD_ANYDATA_XML:
+            new_any->value.xml = lyxml_dup_elem(ctx, old_any->value.xml, NULL, 1);
+            break;
+        case LYD_ANYDATA_LYB:
+            r = lyd_lyb_data_length(old_any->value.mem);
+            if (r == -1) {
+                LOGERR(ctx, LY_EINVAL, "Invalid LYB data.");
+                goto error;
+            }
+            new_any->value.mem = malloc(r);
+            LY_CHECK_ERR_GOTO(!new_any->value.mem, LOGMEM(ctx), error);
+            memcpy(new_any->value.mem, old_any->value.mem, r);
+            break;
+        case LYD_ANYDATA_STRING:
+        case LYD_ANYDATA_SXMLD:
+        case LYD_ANYDATA_JSOND:
+        case LYD_ANYDATA_LYBD:
+            /* dynamic strings are used only as input parameters */
+            assert(0);
+            break;
+        }
+        break;
+    case LYS_CONTAINER:
+    case LYS_LIST:
+    case LYS_NOTIF:
+    case LYS_RPC:
+    case LYS_ACTION:
+        new_node = lyd_node_alloc(ctx, sizeof *new_node);
+        LY_CHECK_ERR_GOTO(!new_node, LOGMEM(ctx), error);
+        new_node->schema = (struct lys_node *)schema;
 
-    matchlist->i = 0;
-    matchlist->match = ly_set_new();
-    matchlist->prev = NULL;
+        if (_lyd_dup_node_common(new_node, node, ctx, options)) {
+            goto error;
+        }
+        break;
+    default:
+        LOGINT(ctx);
+        goto error;
+    }
 
-    ordset = ly_set_new();
-    LY_CHECK_ERR_GOTO(!ordset, , error);
+    return new_node;
 
-    /*
-     * compare trees
-     */
-    /* 1) newly created nodes + changed leafs/anyxmls */
-    next1 = first;
-    for (elem2 = next2 = second; elem2; elem2 = next2) {
-        /* keep right pointer for searching in the first tree */
-        elem1 = next1;
+error:
+    lyd_free(new_node);
+    return NULL;
+}
 
-        if (elem2->dflt && !(options & LYD_DIFFOPT_WITHDEFAULTS)) {
-            /* skip default elements, they could not be created or changed, just deleted */
-            goto cmp_continue;
+/* skip the state siblings when duplicating only the configuration */
+static const struct lyd_node *
+lyd_dup_next_config(const struct lyd_node *node, int options)
+{
+    if (options & LYD_DUP_OPT_CONFIG) {
+        while (node && (node->schema->flags & LYS_CONFIG_R)) {
+            node = node->next;
         }
+    }
+    return node;
+}
 
-#ifdef LY_ENABLED_CACHE
-        struct lyd_node **iter_p;
+API struct lyd_node *
+lyd_dup_to_ctx(const struct lyd_node *node, int options, struct ly_ctx *ctx)
+{
+    struct ly_ctx *log_ctx;
+    struct lys_node_list *slist;
+    struct lys_node *schema;
+    const char *yang_data_name;
+    const struct lys_module *trg_mod;
+    const struct lyd_node *next, *elem;
+    struct lyd_node *ret, *parent, *key, *key_dup, *new_node = NULL;
+    uint16_t i;
 
-        if (elem1 && elem1->parent && elem1->parent->ht) {
-            iter = NULL;
-            if (!lyht_find(elem1->parent->ht, &elem2, elem2->hash, (void **)&iter_p)) {
-                iter = *iter_p;
-                /* we found a match */
-                if (iter->dflt && !(options & LYD_DIFFOPT_WITHDEFAULTS)) {
-                    /* the second one cannot be default (see lyd_diff()),
-                     * so the nodes differs (first one is default node) */
-                    iter = NULL;
-                }
-                while (iter && (iter->validity & LYD_VAL_INUSE)) {
-                    /* state lists, find one not-already-found */
-                    assert((iter->schema->nodetype & (LYS_LIST | LYS_LEAFLIST)) && (iter->schema->flags & LYS_CONFIG_R));
-                    if (lyht_find_next(elem1->parent->ht, &iter, iter->hash, (void **)&iter_p)) {
-                        iter = NULL;
-                    } else {
-                        iter = *iter_p;
-                    }
-                }
-            }
-        } else
-#endif
-        {
-            /* search for elem2 instance in the first */
-            LY_TREE_FOR(elem1, iter) {
-                if (iter->schema != elem2->schema) {
-                    continue;
-                }
+    if (!node) {
+        LOGARG;
+        return NULL;
+    }
 
-                /* elem2 instance found */
-                rc = lyd_diff_compare(iter, elem2, options);
-                if (rc == -1) {
-                    goto error;
-                } else if (rc == 0) {
-                    /* match */
-                    break;
-                } /* else, continue */
-            }
-        }
-        /* we have a match */
-        if (iter && lyd_diff_match(iter, elem2, result, &size, &index, matchlist->match, ordset, options)) {
-            goto error;
-        }
+    log_ctx = (ctx ? ctx : node->schema->module->ctx);
+    if (ctx == node->schema->module->ctx) {
+        /* target context is actually the same as the source context,
+         * ignore the target context */
+        ctx = NULL;
+    }
 
-        if (!iter) {
-            /* elem2 not found in the first tree */
-            if (lyd_difflist_add(result2, &size2, index2++, LYD_DIFF_CREATED, elem1 ? elem1->parent : parent, elem2)) {
-                goto error;
-            }
+    ret = NULL;
+    parent = NULL;
 
-            if (elem1 && (elem2->schema->flags & LYS_USERORDERED)) {
-                /* store the correct place where the node is supposed to be moved after creation */
-                /* if elem1 does not exist, all nodes were created and they will be created in
-                 * correct order, so it is not needed to detect moves */
-                for (aux = elem2->prev; aux->next; aux = aux->prev) {
-                    if (aux->schema == elem2->schema) {
-                        /* predecessor found */
-                        break;
-                    }
-                }
-                if (!aux->next) {
-                    /* predecessor not found */
-                    aux = NULL;
-                }
-                if (lyd_difflist_add(result2, &size2, index2++, LYD_DIFF_MOVEDAFTER2, aux, elem2)) {
+    /* LY_TREE_DFS */
+    for (elem = next = node; elem; elem = next) {
+
+        /* find the correct schema */
+        if (ctx) {
+            schema = NULL;
+#ifdef LY_ENABLED_CACHE
+            /* the mapped schema nodes are cached in the target context */
+            schema = lyd_get_schema_inctx(elem, ctx);
+#endif
+            if (schema) {
+                /* found */
+            } else if (parent) {
+                trg_mod = lyp_get_module(parent->schema->module, NULL, 0, lyd_node_module(elem)->name,
+                                         strlen(lyd_node_module(elem)->name), 1);
+                if (!trg_mod) {
+                    LOGERR(log_ctx, LY_EINVAL, "Target context does not contain model for the data node being duplicated (%s).",
+                                lyd_node_module(elem)->name);
                     goto error;
                 }
+                /* we know its parent, so we can start with it */
+                lys_getnext_data(trg_mod, parent->schema, elem->schema->name, strlen(elem->schema->name),
+                                 elem->schema->nodetype, (const struct lys_node **)&schema);
+            } else {
+                /* we have to search in complete context */
+                schema = lyd_get_schema_inctx(elem, ctx);
             }
-        }
-
-cmp_continue:
-        /* select element for the next run                                    1     2
-         * - first, process all siblings of a single parent                  / \   / \
-         * - then, go to children (deep)                                    3   4 7   8
-         * - return to the parent's next sibling children                  / \
-         *                                                                5   6
-         */
-        /* siblings first */
-        next1 = elem1;
-        next2 = elem2->next;
 
-        if (!next2) {
-            /* children */
-
-            /* first pass of the siblings done, some additional work for future
-             * detection of move may be needed */
-            for (i = ordset->number; i > 0; i--) {
-                ordered = (struct diff_ordered *)ordset->set.g[i - 1];
-                if (ordered->items) {
-                    /* already preprocessed ordered structure */
-                    break;
+            if (!schema) {
+                yang_data_name = lyp_get_yang_data_template_name(elem);
+                if (yang_data_name) {
+                    LOGERR(log_ctx, LY_EINVAL, "Target context does not contain schema node for the data node being duplicated "
+                                        "(%s:#%s/%s).", lyd_node_module(elem)->name, yang_data_name, elem->schema->name);
+                } else {
+                    LOGERR(log_ctx, LY_EINVAL, "Target context does not contain schema node for the data node being duplicated "
+                                        "(%s:%s).", lyd_node_module(elem)->name, elem->schema->name);
                 }
-                ordered->items = calloc(ordered->count, sizeof *ordered->items);
-                LY_CHECK_ERR_GOTO(!ordered->items, LOGMEM(ctx), error);
-                ordered->dist = NULL;
-                /* zero the count to be used as a node position in lyd_diff_move_preprocess() */
-                ordered->count = 0;
-            }
-
-            /* first, get the first sibling */
-            if (elem2->parent == second->parent) {
-                elem2 = second;
-            } else {
-                elem2 = elem2->parent->child;
+                goto error;
             }
+        } else {
+            schema = elem->schema;
+        }
 
-            /* and then find the first child */
-            LY_TREE_FOR(elem2, iter) {
-                if (!(iter->validity & LYD_VAL_INUSE)) {
-                    /* the iter is not present in both trees */
-                    continue;
-                } else if (matchlist->i == matchlist->match->number) {
-                    if (iter == elem2) {
-                        /* we already went through all the matching nodes and now we are just supposed to stop
-                         * the loop with no iter */
-                        iter = NULL;
-                        break;
-                    } else {
-                        /* we have started with some not processed data in matchlist, but now we have
-                         * the INUSE iter and no nodes in matchlist to find its equivalent,
-                         * so something went wrong somewhere */
-                        LOGINT(ctx);
-                        goto error;
-                    }
-                }
+        /* make node copy */
+        new_node = _lyd_dup_node(elem, schema, log_ctx, options);
+        if (!new_node) {
+            goto error;
+        }
 
-                iter->validity &= ~LYD_VAL_INUSE;
-                if ((iter->schema->nodetype & (LYS_LEAFLIST | LYS_LIST)) && (iter->schema->flags & LYS_USERORDERED)) {
-                    for (j = ordset->number; j > 0; j--) {
-                        ordered = (struct diff_ordered *)ordset->set.g[j - 1];
-                        if (ordered->schema != iter->schema || !lyd_diff_equivnode(ordered->parent, iter->parent)) {
-                            continue;
-                        }
+        if (parent && lyd_insert(parent, new_node)) {
+            goto error;
+        }
 
-                        /* store necessary information for move detection */
-                        lyd_diff_move_preprocess(ordered, matchlist->match->set.d[matchlist->i], iter);
-                        break;
-                    }
-                }
+        if (!ret) {
+            ret = new_node;
+        }
 
-                if (((iter->schema->nodetype == LYS_CONTAINER) || ((iter->schema->nodetype == LYS_LIST)
-                        && ((struct lys_node_list *)iter->schema)->keys_size)) && iter->child) {
-                    while (matchlist->i < matchlist->match->number && matchlist->match->set.d[matchlist->i]->schema != iter->schema) {
-                        matchlist->i++;
-                    }
-                    if (matchlist->i == matchlist->match->number) {
-                        /* we have the INUSE iter, so we have to find its equivalent in match list */
-                        LOGINT(ctx);
-                        goto error;
-                    }
-                    next1 = matchlist->match->set.d[matchlist->i]->child;
-                    if (!next1) {
-                        parent = matchlist->match->set.d[matchlist->i];
-                    }
-                    matchlist->i++;
-                    next2 = iter->child;
-                    break;
-                }
-                matchlist->i++;
-            }
+        if (!(options & LYD_DUP_OPT_RECURSIVE)) {
+            break;
+        }
 
-            if (!iter) {
-                /* no child/data on next level */
-                if (elem2 == second) {
-                    /* done */
-                    break;
-                }
-            } else {
-                /* create new matchlist item */
-                mlaux = malloc(sizeof *mlaux);
-                LY_CHECK_ERR_GOTO(!mlaux, LOGMEM(ctx), error);
-                mlaux->i = 0;
-                mlaux->match = ly_set_new();
-                mlaux->prev = matchlist;
-                matchlist = mlaux;
+        /* LY_TREE_DFS_END */
+        /* select element for the next run - children first,
+         * child exception for lyd_node_leaf and lyd_node_leaflist */
+        if (elem->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST | LYS_ANYDATA)) {
+            next = NULL;
+        } else {
+            next = lyd_dup_next_config(elem->child, options);
+        }
+        if (!next) {
+            if (elem->parent == node->parent) {
+                break;
             }
+            /* no children, so try siblings */
+            next = lyd_dup_next_config(elem->next, options);
+        } else {
+            parent = new_node;
         }
+        new_node = NULL;
 
-        while (!next2) {
-            /* parent */
+        while (!next) {
+            /* no siblings, go back through parents */
+            elem = elem->parent;
+            if (elem->parent == node->parent) {
+                break;
+            }
+            if (!parent) {
+                LOGINT(log_ctx);
+                goto error;
+            }
+            parent = parent->parent;
+            /* parent is already processed, go to its sibling */
+            next = lyd_dup_next_config(elem->next, options);
+        }
+    }
 
-            /* clean the last match set */
-            ly_set_clean(matchlist->match);
-            matchlist->i = 0;
+    /* dup all the parents */
+    if (options & LYD_DUP_OPT_WITH_PARENTS) {
+        parent = ret;
+        for (elem = node->parent; elem; elem = elem->parent) {
+            new_node = lyd_dup(elem, options & LYD_DUP_OPT_NO_ATTR);
+            LY_CHECK_ERR_GOTO(!new_node, LOGMEM(log_ctx), error);
 
-            /* try to go to a cousin - child of the next parent's sibling */
-            mlaux = matchlist->prev;
-            LY_TREE_FOR(elem2->parent->next, iter) {
-                if (!(iter->validity & LYD_VAL_INUSE)) {
-                    continue;
-                } else if (mlaux->i == mlaux->match->number) {
-                    if (iter == elem2->parent->next) {
-                        /* we already went through all the matching nodes and now we are just supposed to stop
-                         * the loop with no iter */
-                        iter = NULL;
-                        break;
-                    } else {
-                        /* we have started with some not processed data in matchlist, but now we have
-                         * the INUSE iter and no nodes in matchlist to find its equivalent,
-                         * so something went wrong somewhere */
-                        LOGINT(ctx);
+            /* dup all list keys */
+            if (new_node->schema->nodetype == LYS_LIST) {
+                slist = (struct lys_node_list *)new_node->schema;
+                for (key = elem->child, i = 0; key && (i < slist->keys_size); ++i, key = key->next) {
+                    if (key->schema != (struct lys_node *)slist->keys[i]) {
+                        LOGVAL(log_ctx, LYE_PATH_INKEY, LY_VLOG_LYD, new_node, slist->keys[i]->name);
                         goto error;
                     }
-                }
-
-                iter->validity &= ~LYD_VAL_INUSE;
-                if ((iter->schema->nodetype & (LYS_LEAFLIST | LYS_LIST)) && (iter->schema->flags & LYS_USERORDERED)) {
-                    for (j = ordset->number ; j > 0; j--) {
-                        ordered = (struct diff_ordered *)ordset->set.g[j - 1];
-                        if (ordered->schema != iter->schema || !lyd_diff_equivnode(ordered->parent, iter->parent)) {
-                            continue;
-                        }
 
-                        /* store necessary information for move detection */
-                        lyd_diff_move_preprocess(ordered, mlaux->match->set.d[mlaux->i], iter);
-                        break;
-                    }
-                }
+                    key_dup = lyd_dup(key, options & LYD_DUP_OPT_NO_ATTR);
+                    LY_CHECK_ERR_GOTO(!key_dup, LOGMEM(log_ctx), error);
 
-                if (((iter->schema->nodetype == LYS_CONTAINER) || ((iter->schema->nodetype == LYS_LIST)
-                        && ((struct lys_node_list *)iter->schema)->keys_size)) && iter->child) {
-                    while (mlaux->i < mlaux->match->number && mlaux->match->set.d[mlaux->i]->schema != iter->schema) {
-                        mlaux->i++;
-                    }
-                    if (mlaux->i == mlaux->match->number) {
-                        /* we have the INUSE iter, so we have to find its equivalent in match list */
-                        LOGINT(ctx);
+                    if (lyd_insert(new_node, key_dup)) {
+                        lyd_free(key_dup);
                         goto error;
                     }
-                    next1 = mlaux->match->set.d[mlaux->i]->child;
-                    if (!next1) {
-                        parent = mlaux->match->set.d[mlaux->i];
-                    }
-                    mlaux->i++;
-                    next2 = iter->child;
-                    break;
                 }
-                mlaux->i++;
+                if (!key && (i < slist->keys_size)) {
+                    LOGVAL(log_ctx, LYE_PATH_INKEY, LY_VLOG_LYD, new_node, slist->keys[i]->name);
+                    goto error;
+                }
             }
 
-            /* if no cousin exists, continue next loop on higher level */
-            if (!iter) {
-                elem2 = elem2->parent;
-
-                /* remove matchlist item */
-                ly_set_free(matchlist->match);
-                mlaux = matchlist;
-                matchlist = matchlist->prev;
-                free(mlaux);
-
-                if (!matchlist->prev) { /* elem2->parent == second->parent */
-                    /* done */
-                    break;
-                }
+            /* link together */
+            if (lyd_insert(new_node, parent)) {
+                ret = parent;
+                goto error;
             }
+            parent = new_node;
         }
     }
 
-    ly_set_free(matchlist->match);
-    free(matchlist);
-    matchlist = NULL;
+    return ret;
 
-    /* 2) deleted nodes */
-    LY_TREE_DFS_BEGIN(first, next1, elem1) {
-        /* search for elem1s deleted in the second */
-        if (elem1->validity & LYD_VAL_INUSE) {
-            /* erase temporary LYD_VAL_INUSE flag and continue into children */
-            elem1->validity &= ~LYD_VAL_INUSE;
-        } else if (!elem1->dflt || (options & LYD_DIFFOPT_WITHDEFAULTS)) {
-            /* elem1 has no matching node in second, add it into result */
-            if (lyd_difflist_add(result, &size, index++, LYD_DIFF_DELETED, elem1, NULL)) {
-                goto error;
-            }
+error:
+    lyd_free(ret);
+    return NULL;
+}
 
-            /* skip subtree processing of data missing in the second tree */
-            goto dfs_nextsibling;
+API struct lyd_node *
+lyd_dup(const struct lyd_node *node, int options)
+{
+    return lyd_dup_to_ctx(node, options, NULL);
+}
+
+static struct lyd_node *
+lyd_dup_withsiblings_r(const struct lyd_node *first, struct lyd_node *parent_dup, int options)
+{
+    struct lyd_node *first_dup = NULL, *prev_dup = NULL, *last_dup;
+    const struct lyd_node *next, *child;
+    int child_options;
+
+    assert(first);
+
+    /* duplicate and connect all siblings */
+    for (next = first; next; next = lyd_dup_next_config(next->next, options)) {
+        last_dup = _lyd_dup_node(next, next->schema, next->schema->module->ctx, options);
+        if (!last_dup) {
+            goto error;
         }
 
-        /* modified LY_TREE_DFS_END() */
-        /* select element for the next run - children first */
-        if ((elem1->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST | LYS_ANYDATA)) || ((elem1->schema->nodetype == LYS_LIST)
-                && !((struct lys_node_list *)elem1->schema)->keys_size)) {
-            next1 = NULL;
-        } else {
-            next1 = elem1->child;
+        if (!(options & LYD_DUP_OPT_CONFIG)) {
+            /* the whole data tree is exactly the same so we can safely copy the validation flags */
+            last_dup->validity = next->validity;
+            last_dup->when_status = next->when_status;
         }
-        if (!next1) {
-dfs_nextsibling:
-            /* try siblings */
-            next1 = elem1->next;
+
+        last_dup->parent = parent_dup;
+        if (!first_dup) {
+            first_dup = last_dup;
+        } else {
+            assert(prev_dup);
+            prev_dup->next = last_dup;
+            last_dup->prev = prev_dup;
         }
-        while (!next1) {
-            /* parent is already processed, go to its sibling */
 
-            elem1 = elem1->parent;
-            if (elem1 == first->parent) {
-                /* we are done, no next element to process */
-                break;
+        if ((next->schema->nodetype & (LYS_LIST | LYS_CONTAINER | LYS_RPC | LYS_ACTION | LYS_NOTIF))
+                && (child = lyd_dup_next_config(next->child, options))) {
+            child_options = options;
+            if ((next->schema->nodetype & (LYS_LIST | LYS_CONTAINER)) && !(next->schema->flags & LYS_INCL_STATUS)) {
+                /* the schema allows no state data in the subtree, nothing to skip there */
+                child_options &= ~LYD_DUP_OPT_CONFIG;
             }
 
-            next1 = elem1->next;
+            /* recursively duplicate all children */
+            if (!lyd_dup_withsiblings_r(child, last_dup, child_options)) {
+                goto error;
+            }
         }
+
+        prev_dup = last_dup;
     }
 
-    /* 3) moved nodes (when user-ordered) */
-    for (i = 0; i < ordset->number; i++) {
-        ordered = (struct diff_ordered *)ordset->set.g[i];
-        if (!ordered->dist->dist) {
-            /* the dist list is sorted here, but the biggest dist is 0,
-             * so nothing changed in order of these items between first
-             * and second. We can continue with another user-ordered list.
-             */
-            continue;
-        }
+    /* correctly set last sibling and parent child pointer */
+    assert(!prev_dup->next);
+    first_dup->prev = prev_dup;
+    if (parent_dup) {
+        parent_dup->child = first_dup;
+    }
 
-        /* get needed movements
-         * - from the biggest distances try to apply node movements
-         * on first tree node until they will be ordered as in the
-         * second tree - i.e. until there will be no position difference
-         */
+    return first_dup;
 
-        for (dist_iter = ordered->dist; ; dist_iter = dist_iter->next) {
-            /* dist list is sorted at the beginning, since applying a move causes
-             * just a small change in other distances, we assume that the biggest
-             * dist is the next one (note that dist list is implemented as ring
-             * list). This way we avoid sorting distances after each move. The loop
-             * stops when all distances are zero.
-             */
-            dist_aux = dist_iter;
-            while (!dist_iter->dist) {
-                /* no dist, so no move. Try another, but when
-                 * there is no dist at all, stop the loop
-                 */
-                dist_iter = dist_iter->next;
-                if (dist_iter == dist_aux) {
-                    /* all dist we zeroed */
-                    goto movedone;
-                }
-            }
-            /* something to move */
-
-            /* get the item to move */
-            for (k = 0; k < ordered->count; k++) {
-                if (ordered->items[k].dist == dist_iter) {
-                    break;
-                }
-            }
+error:
+    /* disconnect and free */
+    first_dup->parent = NULL;
+    lyd_free_withsiblings(first_dup);
+    return NULL;
+}
 
-            /* apply the move (distance) */
-            memcpy(&item_aux, &ordered->items[k], sizeof item_aux);
-            if (dist_iter->dist > 0) {
-                /* move to right (other move to left) */
-                while (dist_iter->dist) {
-                    memcpy(&ordered->items[k], &ordered->items[k + 1], sizeof *ordered->items);
-                    ordered->items[k].dist->dist++; /* update moved item distance */
-                    dist_iter->dist--;
-                    k++;
-                }
-            } else {
-                /* move to left (other move to right) */
-                while (dist_iter->dist) {
-                    memcpy(&ordered->items[k], &ordered->items[k - 1], sizeof *ordered->items);
-                    ordered->items[k].dist->dist--; /* update moved item distance */
-                    dist_iter->dist++;
-                    k--;
-                }
-            }
-            memcpy(&ordered->items[k], &item_aux, sizeof *ordered->items);
+API struct lyd_node *
+lyd_dup_withsiblings(const struct lyd_node *node, int options)
+{
+    const struct lyd_node *iter;
+    struct lyd_node *ret, *ret_iter, *tmp;
 
-            /* store the transaction into the difflist */
-            if (lyd_difflist_add(result, &size, index++, LYD_DIFF_MOVEDAFTER1, item_aux.first,
-                                 (k > 0) ? ordered->items[k - 1].first : NULL)) {
-                goto error;
+    if (!node) {
+        return NULL;
+    }
+
+    /* find first sibling */
+    while (node->prev->next) {
+        node = node->prev;
+    }
+    node = lyd_dup_next_config(node, options);
+    if (!node) {
+        /* only state data */
+        return NULL;
+    }
+
+    if (node->parent) {
+        ret = lyd_dup(node, options);
+        if (!ret) {
+            return NULL;
+        }
+
+        /* copy following siblings */
+        ret_iter = ret;
+        for (iter = lyd_dup_next_config(node->next, options); iter; iter = lyd_dup_next_config(iter->next, options)) {
+            tmp = lyd_dup(iter, options);
+            if (!tmp) {
+                lyd_free_withsiblings(ret);
+                return NULL;
             }
-            continue;
 
-movedone:
-            break;
+            if (lyd_insert_after(ret_iter, tmp)) {
+                lyd_free_withsiblings(ret);
+                return NULL;
+            }
+            ret_iter = ret_iter->next;
+            assert(ret_iter == tmp);
         }
+    } else {
+        /* duplicating top-level siblings, we can duplicate much more efficiently */
+        ret = lyd_dup_withsiblings_r(node, NULL, options);
+    }
+
+    return ret;
+}
+
+static size_t
+lyd_node_arena_size(const struct lyd_node *node)
+{
+    size_t size;
+
+    switch (node->schema->nodetype) {
+    case LYS_LEAF:
+    case LYS_LEAFLIST:
+        size = sizeof(struct lyd_node_leaf_list);
+        break;
+    case LYS_ANYXML:
+    case LYS_ANYDATA:
+        size = sizeof(struct lyd_node_anydata);
+        break;
+    default:
+        size = sizeof(struct lyd_node);
+        break;
     }
 
-    diff_ordset_free(ordset);
-    ordset = NULL;
+    return (size + LYD_ARENA_ALIGN - 1) & ~(LYD_ARENA_ALIGN - 1);
+}
 
-    if (index2) {
-        /* append result2 with newly created
-         * (and possibly moved) nodes */
-        if (index + index2 + 1 >= size) {
-            /* result must be enlarged */
-            size = index + index2 + 1;
-            new = realloc(result->type, size * sizeof *result->type);
-            LY_CHECK_ERR_GOTO(!new, LOGMEM(ctx), error);
-            result->type = new;
+API struct lyd_arena *
+lyd_compact(struct lyd_node **tree)
+{
+    struct lyd_node *first, *iter, *next, *elem, *dup;
+    struct lyd_arena *arena, *prev_arena;
+    size_t size = 0;
+    int idx, i;
 
-            new = realloc(result->first, size * sizeof *result->first);
-            LY_CHECK_ERR_GOTO(!new, LOGMEM(ctx), error);
-            result->first = new;
+    if (!tree || !*tree || (*tree)->parent) {
+        LOGARG;
+        return NULL;
+    }
 
-            new = realloc(result->second, size * sizeof *result->second);
-            LY_CHECK_ERR_GOTO(!new, LOGMEM(ctx), error);
-            result->second = new;
-        }
+    /* find the first sibling and the index of the node to return */
+    for (first = *tree, idx = 0; first->prev->next; first = first->prev, ++idx);
 
-        /* append */
-        memcpy(&result->type[index], result2->type, (index2 + 1) * sizeof *result->type);
-        memcpy(&result->first[index], result2->first, (index2 + 1) * sizeof *result->first);
-        memcpy(&result->second[index], result2->second, (index2 + 1) * sizeof *result->second);
+    /* a single block fits the whole tree */
+    LY_TREE_FOR(first, iter) {
+        LY_TREE_DFS_BEGIN(iter, next, elem) {
+            size += lyd_node_arena_size(elem);
+            LY_TREE_DFS_END(iter, next, elem);
+        }
     }
-    lyd_free_diff(result2);
 
-    return result;
+    arena = lyd_arena_new(size);
+    if (!arena) {
+        return NULL;
+    }
 
-error:
-    while (matchlist) {
-        mlaux = matchlist;
-        matchlist = mlaux->prev;
-        ly_set_free(mlaux->match);
-        free(mlaux);
+    /* the duplicate nodes are allocated in the DFS preorder, no children hash tables are created */
+    prev_arena = lyd_arena_use(arena);
+    dup = lyd_dup_withsiblings(first, LYD_DUP_OPT_RECURSIVE);
+    lyd_arena_use(prev_arena);
+    if (!dup) {
+        lyd_arena_free(arena);
+        return NULL;
+    }
 
+#ifdef LY_ENABLED_CACHE
+    /* create all the children hash tables at once */
+    LY_TREE_FOR(dup, iter) {
+        LY_TREE_DFS_BEGIN(iter, next, elem) {
+            if ((elem->schema->nodetype & (LYS_LIST | LYS_CONTAINER | LYS_RPC | LYS_ACTION | LYS_NOTIF))
+                    && elem->child && !elem->ht) {
+                lyd_children_ht_create(elem);
+            }
+            LY_TREE_DFS_END(iter, next, elem);
+        }
     }
-    diff_ordset_free(ordset);
+#endif
 
-    lyd_free_diff(result);
-    lyd_free_diff(result2);
+    lyd_free_withsiblings(first);
 
-    return NULL;
+    for (i = 0, *tree = dup; i < idx; ++i, *tree = (*tree)->next);
+    return arena;
 }
 
-static void
-lyd_insert_setinvalid(struct lyd_node *node)
-{
-    struct lyd_node *next, *elem, *parent_list;
+struct lyd_vtree_ver {
+    struct lyd_node *root;           /* data tree of the version, never modified */
+    uint64_t id;                     /* version number */
+    atomic_uint_least32_t refcount;  /* pins of the version, including the one of the versioned tree */
+};
 
-    assert(node);
+struct lyd_vtree {
+    pthread_mutex_t lock;            /* protects cur */
+    struct lyd_vtree_ver *cur;       /* the latest published version */
+};
 
-    /* overall validity of the node itself */
-    node->validity = ly_new_node_validity(node->schema);
+static struct lyd_vtree_ver *
+lyd_vtree_ver_new(struct lyd_node *root, uint64_t id)
+{
+    struct lyd_vtree_ver *ver;
 
-    /* explore changed unique leaves */
-    /* first, get know if there is a list in parents chain */
-    for (parent_list = node->parent;
-         parent_list && parent_list->schema->nodetype != LYS_LIST;
-         parent_list = parent_list->parent);
-    if (parent_list && !(parent_list->validity & LYD_VAL_UNIQUE)) {
-        /* there is a list, so check if we inserted a leaf supposed to be unique */
-        for (elem = node; elem; elem = next) {
-            if (elem->schema->nodetype == LYS_LIST) {
-                /* stop searching to the depth, children would be unique to a list in subtree */
-                goto nextsibling;
-            }
+    ver = malloc(sizeof *ver);
+    LY_CHECK_ERR_RETURN(!ver, LOGMEM(root ? root->schema->module->ctx : NULL), NULL);
+    ver->root = root;
+    ver->id = id;
+    atomic_init(&ver->refcount, 1);
 
-            if (elem->schema->nodetype == LYS_LEAF && (elem->schema->flags & LYS_UNIQUE)) {
-                /* set flag to list for future validation */
-                parent_list->validity |= LYD_VAL_UNIQUE;
-                break;
-            }
+    return ver;
+}
 
-            if (elem->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST | LYS_ANYDATA)) {
-                if (elem == node) {
-                    /* stop the loop */
-                    break;
-                }
-                goto nextsibling;
-            }
+API struct lyd_vtree *
+lyd_vtree_new(struct lyd_node *root)
+{
+    struct lyd_vtree *vtree;
 
-            /* select next elem to process */
-            /* go into children */
-            next = elem->child;
-            /* go through siblings */
-            if (!next) {
-nextsibling:
-                next = elem->next;
-                if (!next) {
-                    /* no sibling */
-                    if (elem == node) {
-                        /* we are done, back in start node */
-                        break;
-                    }
-                }
-            }
-            /* go back to parents */
-            while (!next) {
-                elem = elem->parent;
-                if (elem->parent == node->parent) {
-                    /* we are done, back in start node */
-                    break;
-                }
-                /* parent was actually already processed, so go to the parent's sibling */
-                next = elem->parent->next;
-            }
-        }
+    if (root && root->parent) {
+        LOGARG;
+        return NULL;
     }
 
-    if (node->parent) {
-        /* if the inserted node is list/leaflist with constraint on max instances,
-         * invalidate the parent to make it validate this */
-        if (node->schema->nodetype & LYS_LEAFLIST) {
-            if (((struct lys_node_leaflist *)node->schema)->max) {
-                node->parent->validity |= LYD_VAL_MAND;
-            }
-        } else if (node->schema->nodetype & LYS_LIST) {
-            if (((struct lys_node_list *)node->schema)->max) {
-                node->parent->validity |= LYD_VAL_MAND;
-            }
-        }
+    for (; root && root->prev->next; root = root->prev);
+
+    vtree = malloc(sizeof *vtree);
+    LY_CHECK_ERR_RETURN(!vtree, LOGMEM(root ? root->schema->module->ctx : NULL), NULL);
+    vtree->cur = lyd_vtree_ver_new(root, 1);
+    if (!vtree->cur) {
+        free(vtree);
+        return NULL;
     }
+    pthread_mutex_init(&vtree->lock, NULL);
+
+    return vtree;
 }
 
-static void
-lyd_replace(struct lyd_node *orig, struct lyd_node *repl, int destroy)
+API struct lyd_vtree_ver *
+lyd_vtree_pin(struct lyd_vtree *vtree, struct lyd_node **root)
 {
-    struct lyd_node *iter, *last;
-
-    if (!repl) {
-        /* remove the old one */
-        goto finish;
-    }
+    struct lyd_vtree_ver *ver;
 
-    if (repl->parent || repl->prev->next) {
-        /* isolate the new node */
-        repl->next = NULL;
-        repl->prev = repl;
-        last = repl;
-    } else {
-        /* get the last node of a possible list of nodes to be inserted */
-        for(last = repl; last->next; last = last->next) {
-            /* part of the parent changes */
-            last->parent = orig->parent;
-        }
+    if (!vtree) {
+        LOGARG;
+        return NULL;
     }
 
-    /* parent */
-    if (orig->parent) {
-        if (orig->parent->child == orig) {
-            orig->parent->child = repl;
-        }
-        orig->parent = NULL;
-    }
+    /* the version cannot be released by the writer before the reference is taken */
+    pthread_mutex_lock(&vtree->lock);
+    ver = vtree->cur;
+    atomic_fetch_add_explicit(&ver->refcount, 1, memory_order_relaxed);
+    pthread_mutex_unlock(&vtree->lock);
 
-    /* predecessor */
-    if (orig->prev == orig) {
-        /* the old was alone */
-        goto finish;
+    if (root) {
+        *root = ver->root;
     }
-    if (orig->prev->next) {
-        orig->prev->next = repl;
-    }
-    repl->prev = orig->prev;
-    orig->prev = orig;
+    return ver;
+}
 
-    /* successor */
-    if (orig->next) {
-        orig->next->prev = last;
-        last->next = orig->next;
-        orig->next = NULL;
-    } else {
-        /* fix the last pointer */
-        if (repl->parent) {
-            repl->parent->child->prev = last;
-        } else {
-            /* get the first sibling */
-            for (iter = repl; iter->prev != orig; iter = iter->prev);
-            iter->prev = last;
-        }
+API void
+lyd_vtree_unpin(struct lyd_vtree_ver *ver)
+{
+    if (!ver) {
+        return;
     }
 
-finish:
-    /* remove the old one */
-    if (destroy) {
-        lyd_free(orig);
+    /* the last reader frees the version, all its reads must happen before */
+    if (atomic_fetch_sub_explicit(&ver->refcount, 1, memory_order_acq_rel) == 1) {
+        lyd_free_withsiblings(ver->root);
+        free(ver);
     }
 }
 
-int
-lyd_insert_common(struct lyd_node *parent, struct lyd_node **sibling, struct lyd_node *node, int invalidate)
+API uint64_t
+lyd_vtree_ver_id(const struct lyd_vtree_ver *ver)
 {
-    struct lys_node *par1, *par2;
-    const struct lys_node *siter;
-    struct lyd_node *start, *iter, *ins, *next1, *next2;
-    int invalid = 0, isrpc = 0, clrdflt = 0;
-    struct ly_set *llists = NULL;
-    int i;
-    uint8_t pos;
-    int stype = LYS_INPUT | LYS_OUTPUT;
-
-    assert(parent || sibling);
+    return ver ? ver->id : 0;
+}
 
-    /* get first sibling */
-    if (parent) {
-        start = parent->child;
-    } else {
-        for (start = *sibling; start->prev->next; start = start->prev);
-    }
+API struct lyd_node *
+lyd_vtree_copy(struct lyd_vtree *vtree)
+{
+    struct lyd_vtree_ver *ver;
+    struct lyd_node *root, *dup = NULL;
 
-    /* check placing the node to the appropriate place according to the schema */
-    if (!start) {
-        if (!parent) {
-            /* empty tree to insert */
-            if (node->parent || node->prev->next) {
-                /* unlink the node first */
-                lyd_unlink_internal(node, 1);
-            } /* else insert also node's siblings */
-            *sibling = node;
-            return EXIT_SUCCESS;
-        }
-        par1 = parent->schema;
-        if (par1->nodetype & (LYS_RPC | LYS_ACTION)) {
-            /* it is not clear if the tree being created is going to
-             * be rpc (LYS_INPUT) or rpc-reply (LYS_OUTPUT) so we have to
-             * compare against LYS_RPC or LYS_ACTION in par2
-             */
-            stype = LYS_RPC | LYS_ACTION;
-        }
-    } else if (parent && (parent->schema->nodetype & (LYS_RPC | LYS_ACTION))) {
-        par1 = parent->schema;
-        stype = LYS_RPC | LYS_ACTION;
-    } else {
-        for (par1 = lys_parent(start->schema);
-             par1 && !(par1->nodetype & (LYS_CONTAINER | LYS_LIST | LYS_INPUT | LYS_OUTPUT | LYS_NOTIF));
-             par1 = lys_parent(par1));
+    ver = lyd_vtree_pin(vtree, &root);
+    if (!ver) {
+        return NULL;
     }
-    for (par2 = lys_parent(node->schema);
-         par2 && !(par2->nodetype & (LYS_CONTAINER | LYS_LIST | stype | LYS_NOTIF));
-         par2 = lys_parent(par2));
-    if (par1 != par2) {
-        LOGERR(parent->schema->module->ctx, LY_EINVAL, "Cannot insert, different parents (\"%s\" and \"%s\").",
-               (par1 ? par1->name : "<top-lvl>"), (par2 ? par2->name : "<top-lvl>"));
-        return EXIT_FAILURE;
+    if (root) {
+        dup = lyd_dup_withsiblings(root, LYD_DUP_OPT_RECURSIVE);
     }
+    lyd_vtree_unpin(ver);
 
-    if (invalidate) {
-        invalid = isrpc = lyp_is_rpc_action(node->schema);
-        if (!parent || node->parent != parent || isrpc) {
-            /* it is not just moving under a parent node or it is in an RPC where
-             * nodes order matters, so the validation will be necessary */
-            invalid++;
-        }
-    }
+    return dup;
+}
+
+API int
+lyd_vtree_publish(struct lyd_vtree *vtree, struct lyd_node *root)
+{
+    struct lyd_vtree_ver *ver, *old;
 
-    /* unlink only if it is not a list of siblings without a parent and node is not the first sibling */
-    if (node->parent || node->prev->next) {
-        /* do it permanent if the parents are not exact same or if it is top-level */
-        lyd_unlink_internal(node, invalid);
+    if (!vtree || (root && root->parent)) {
+        LOGARG;
+        return EXIT_FAILURE;
     }
 
-    llists = ly_set_new();
+    for (; root && root->prev->next; root = root->prev);
 
-    /* process the nodes to insert one by one */
-    LY_TREE_FOR_SAFE(node, next1, ins) {
-        if (invalid == 1) {
-            /* auto delete nodes from other cases, if any;
-             * this is done only if node->parent != parent */
-            if (lyv_multicases(ins, NULL, &start, 1, NULL)) {
-                goto error;
-            }
-        }
+    pthread_mutex_lock(&vtree->lock);
+    ver = lyd_vtree_ver_new(root, vtree->cur->id + 1);
+    if (!ver) {
+        pthread_mutex_unlock(&vtree->lock);
+        return EXIT_FAILURE;
+    }
+    old = vtree->cur;
+    vtree->cur = ver;
+    pthread_mutex_unlock(&vtree->lock);
 
-        /* isolate the node to be handled separately */
-        ins->prev = ins;
-        ins->next = NULL;
+    /* the old version is freed once the last reader unpins it */
+    lyd_vtree_unpin(old);
+    return EXIT_SUCCESS;
+}
 
-        iter = NULL;
-        if (!ins->dflt) {
-            clrdflt = 1;
-        }
+API void
+lyd_vtree_free(struct lyd_vtree *vtree)
+{
+    if (!vtree) {
+        return;
+    }
 
-        /* are we inserting list key? */
-        if (!ins->dflt && ins->schema->nodetype == LYS_LEAF && lys_is_key((struct lys_node_leaf *)ins->schema, &pos)) {
-            /* yes, we have a key, get know its position */
-            for (i = 0, iter = parent->child;
-                    iter && i < pos && iter->schema->nodetype == LYS_LEAF;
-                    i++, iter = iter->next);
-            if (iter) {
-                /* insert list's key to the correct position - before the iter */
-                if (parent->child == iter) {
-                    parent->child = ins;
-                }
-                if (iter->prev->next) {
-                    iter->prev->next = ins;
-                }
-                ins->prev = iter->prev;
-                iter->prev = ins;
-                ins->next = iter;
+    lyd_vtree_unpin(vtree->cur);
+    pthread_mutex_destroy(&vtree->lock);
+    free(vtree);
+}
 
-                /* update start element */
-                if (parent->child != start) {
-                    start = parent->child;
-                }
-            }
+API void
+lyd_free_attr(struct ly_ctx *ctx, struct lyd_node *parent, struct lyd_attr *attr, int recursive)
+{
+    struct lyd_attr *iter;
+    struct lys_type **type;
 
-            /* try to find previously present default instance to replace */
-        } else if (ins->schema->nodetype == LYS_LEAFLIST) {
-            i = (int)llists->number;
-            if ((ly_set_add(llists, ins->schema, 0) != i) || ins->dflt) {
-                /* each leaf-list must be cleared only once (except when looking for exact same existing dflt nodes) */
-                LY_TREE_FOR_SAFE(start, next2, iter) {
-                    if (iter->schema == ins->schema) {
-                        if ((ins->dflt && (!iter->dflt || ((iter->schema->flags & LYS_CONFIG_W) &&
-                                                           !strcmp(((struct lyd_node_leaf_list *)iter)->value_str,
-                                                                  ((struct lyd_node_leaf_list *)ins)->value_str))))
-                                || (!ins->dflt && iter->dflt)) {
-                            if (iter == start) {
-                                start = next2;
-                            }
-                            lyd_free(iter);
-                        }
-                    }
-                }
+    if (!ctx || !attr) {
+        return;
+    }
+
+    if (parent) {
+        if (parent->attr == attr) {
+            if (recursive) {
+                parent->attr = NULL;
+            } else {
+                parent->attr = attr->next;
             }
-        } else if (ins->schema->nodetype == LYS_LEAF || (ins->schema->nodetype == LYS_CONTAINER
-                        && !((struct lys_node_container *)ins->schema)->presence)) {
-            LY_TREE_FOR(start, iter) {
-                if (iter->schema == ins->schema) {
-                    if (ins->dflt || iter->dflt) {
-                        /* replace existing (either explicit or default) node with the new (either explicit or default) node */
-                        lyd_replace(iter, ins, 1);
-                    } else {
-                        /* keep both explicit nodes, let the caller solve it later */
-                        iter = NULL;
-                    }
-                    break;
+        } else {
+            for (iter = parent->attr; iter->next != attr; iter = iter->next);
+            if (iter->next) {
+                if (recursive) {
+                    iter->next = NULL;
+                } else {
+                    iter->next = attr->next;
                 }
             }
         }
+    }
 
-        if (!iter) {
-            if (!start) {
-                /* add as the only child of the parent */
-                start = ins;
-                if (parent) {
-                    parent->child = ins;
-                }
-            } else if (isrpc) {
-                /* add to the specific position in rpc/rpc-reply/action */
-                for (par1 = ins->schema->parent; !(par1->nodetype & (LYS_INPUT | LYS_OUTPUT)); par1 = lys_parent(par1));
-                siter = NULL;
-                LY_TREE_FOR(start, iter) {
-                    while ((siter = lys_getnext(siter, par1, lys_node_module(par1), 0))) {
-                        if (iter->schema == siter || ins->schema == siter) {
-                            break;
-                        }
-                    }
-                    if (ins->schema == siter) {
-                        if ((siter->nodetype & (LYS_LEAFLIST | LYS_LIST)) && iter->schema == siter) {
-                            /* we are inserting leaflist/list instance, but since there are already
-                             * some instances of the same leaflist/list, we want to insert the new one
-                             * as the last instance, so here we have to move on */
-                            while (iter && iter->schema == siter) {
-                                iter = iter->next;
-                            }
-                            if (!iter) {
-                                break;
-                            }
-                        }
-                        /* we have the correct place for new node (before the iter) */
-                        if (iter == start) {
-                            start = ins;
-                            if (parent) {
-                                parent->child = ins;
-                            }
-                        } else {
-                            iter->prev->next = ins;
-                        }
-                        ins->prev = iter->prev;
-                        iter->prev = ins;
-                        ins->next = iter;
+    if (!recursive) {
+        attr->next = NULL;
+    }
 
-                        /* we are done */
-                        break;
-                    }
-                }
-                if (!iter) {
-                    /* add as the last child of the parent */
-                    start->prev->next = ins;
-                    ins->prev = start->prev;
-                    start->prev = ins;
-                }
-            } else {
-                /* add as the last child of the parent */
-                start->prev->next = ins;
-                ins->prev = start->prev;
-                start->prev = ins;
+    for(iter = attr; iter; ) {
+        attr = iter;
+        iter = iter->next;
+
+        lydict_remove(ctx, attr->name);
+        type = lys_ext_complex_get_substmt(LY_STMT_TYPE, attr->annotation, NULL);
+        assert(type);
+        lyd_free_value(attr->value, attr->value_type, attr->value_flags, *type, NULL, NULL, NULL);
+        lydict_remove(ctx, attr->value_str);
+        free(attr);
+    }
+}
+
+API struct lyd_attr *
+lyd_find_attr(const struct lyd_node *node, const struct lys_ext_instance_complex *annotation)
+{
+    struct lyd_attr *attr;
+
+    if (!node || !annotation) {
+        LOGARG;
+        return NULL;
+    }
+
+    for (attr = node->attr; attr && (attr->annotation != annotation); attr = attr->next);
+    return attr;
+}
+
+const struct lyd_node *
+lyd_attr_parent(const struct lyd_node *root, struct lyd_attr *attr)
+{
+    const struct lyd_node *next, *elem;
+    struct lyd_attr *node_attr;
+
+    LY_TREE_DFS_BEGIN(root, next, elem) {
+        for (node_attr = elem->attr; node_attr; node_attr = node_attr->next) {
+            if (node_attr == attr) {
+                return elem;
             }
         }
+        LY_TREE_DFS_END(root, next, elem)
+    }
 
-#ifdef LY_ENABLED_CACHE
-        lyd_unlink_hash(ins, ins->parent);
-#endif
+    return NULL;
+}
 
-        ins->parent = parent;
+API struct lyd_attr *
+lyd_insert_attr(struct lyd_node *parent, const struct lys_module *mod, const char *name, const char *value)
+{
+    struct lyd_attr *a, *iter;
+    struct ly_ctx *ctx;
+    const struct lys_module *module;
+    struct lys_ext_instance_complex *annot;
+    const char *p;
+    char *aux;
 
-#ifdef LY_ENABLED_CACHE
-        lyd_insert_hash(ins);
-#endif
+    if (!parent || !name || !value) {
+        LOGARG;
+        return NULL;
+    }
+    ctx = parent->schema->module->ctx;
 
-        if (invalidate) {
-            check_leaf_list_backlinks(ins, 0);
+    if ((p = strchr(name, ':'))) {
+        /* search for the namespace */
+        aux = strndup(name, p - name);
+        if (!aux) {
+            LOGMEM(ctx);
+            return NULL;
         }
+        module = ly_ctx_get_module(ctx, aux, NULL, 1);
+        free(aux);
+        name = p + 1;
 
-        if (invalid) {
-            lyd_insert_setinvalid(ins);
+        if (!module) {
+            /* module not found */
+            LOGERR(ctx, LY_EINVAL, "Attribute prefix does not match any implemented schema in the context.");
+            return NULL;
+        }
+    } else if (mod) {
+        module = mod;
+    } else if (!mod && (!strcmp(name, "type") || !strcmp(name, "select")) && !strcmp(parent->schema->name, "filter")) {
+        /* special case of inserting unqualified filter attributes "type" and "select" */
+        module = ly_ctx_get_module(ctx, "ietf-netconf", NULL, 1);
+        if (!module) {
+            LOGERR(ctx, LY_EINVAL, "Attribute prefix does not match any implemented schema in the context.");
+            return NULL;
         }
+    } else {
+        /* no prefix -> module is the same as for the parent */
+        module = lyd_node_module(parent);
+    }
+
+    annot = lys_find_annotation(module, name);
+    if (!annot) {
+        LOGERR(ctx, LY_EINVAL, "Attribute does not match any annotation instance definition.");
+        return NULL;
     }
-    ly_set_free(llists);
 
-    if (clrdflt) {
-        /* remove the dflt flag from parents */
-        for (iter = parent; iter && iter->dflt; iter = iter->parent) {
-            iter->dflt = 0;
-        }
+    a = calloc(1, sizeof *a);
+    LY_CHECK_ERR_RETURN(!a, LOGMEM(ctx), NULL);
+    a->parent = parent;
+    a->next = NULL;
+    a->annotation = annot;
+    a->name = lydict_insert(ctx, name, 0);
+    a->value_str = lydict_insert(ctx, value, 0);
+    if (!lyp_parse_value(*((struct lys_type **)lys_ext_complex_get_substmt(LY_STMT_TYPE, a->annotation, NULL)),
+                         &a->value_str, NULL, NULL, a, NULL, 1, 0, 0)) {
+        lyd_free_attr(ctx, NULL, a, 0);
+        return NULL;
     }
 
-    if (sibling) {
-        *sibling = start;
+    if (!parent->attr) {
+        parent->attr = a;
+    } else {
+        for (iter = parent->attr; iter->next; iter = iter->next);
+        iter->next = a;
     }
-    return EXIT_SUCCESS;
 
-error:
-    ly_set_free(llists);
-    return EXIT_FAILURE;
+    return a;
 }
 
-API int
-lyd_insert(struct lyd_node *parent, struct lyd_node *node)
+/* bits value array shared by all the data nodes with the same value */
+struct lyd_bits {
+    struct ly_ctx *ctx;
+    uint32_t refs;                  /* 0 if not shared yet */
+    uint32_t count;
+    struct lys_type_bit *bit[];
+};
+
+#define LYD_BITS_REC(array) ((struct lyd_bits *)((char *)(array) - offsetof(struct lyd_bits, bit)))
+
+static int
+lyd_bits_val_equal(void *val1_p, void *val2_p, int UNUSED(mod), void *UNUSED(cb_data))
 {
-    if (!node || !parent || (parent->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST | LYS_ANYDATA))) {
-        LOGARG;
-        return EXIT_FAILURE;
-    }
+    struct lyd_bits *rec1 = *(struct lyd_bits **)val1_p, *rec2 = *(struct lyd_bits **)val2_p;
 
-    return lyd_insert_common(parent, NULL, node, 1);
+    return (rec1->count == rec2->count) && !memcmp(rec1->bit, rec2->bit, rec1->count * sizeof *rec1->bit);
 }
 
-API int
-lyd_insert_sibling(struct lyd_node **sibling, struct lyd_node *node)
+static uint32_t
+lyd_bits_hash(const struct lyd_bits *rec)
 {
-    if (!sibling || !node) {
-        LOGARG;
-        return EXIT_FAILURE;
-    }
+    uint32_t hash;
 
-    return lyd_insert_common((*sibling) ? (*sibling)->parent : NULL, sibling, node, 1);
+    hash = dict_hash_multi(0, (const char *)rec->bit, rec->count * sizeof *rec->bit);
+    return dict_hash_multi(hash, NULL, 0);
+}
+
+struct lys_type_bit **
+lyd_bits_new(struct ly_ctx *ctx, uint32_t count)
+{
+    struct lyd_bits *rec;
 
+    rec = calloc(1, sizeof *rec + count * sizeof *rec->bit);
+    LY_CHECK_ERR_RETURN(!rec, LOGMEM(ctx), NULL);
+    rec->ctx = ctx;
+    rec->count = count;
+
+    return rec->bit;
 }
 
-int
-lyd_insert_nextto(struct lyd_node *sibling, struct lyd_node *node, int before, int invalidate)
+struct lys_type_bit **
+lyd_bits_share(struct lys_type_bit **bit)
 {
-    struct ly_ctx *ctx;
-    struct lys_node *par1, *par2;
-    struct lyd_node *iter, *start = NULL, *ins, *next1, *next2, *last;
-    struct lyd_node *orig_parent = NULL, *orig_prev = NULL, *orig_next = NULL;
-    int invalid = 0;
-    char *str;
+    struct lyd_bits *rec = LYD_BITS_REC(bit), **found;
+    struct ly_ctx *ctx = rec->ctx;
+    uint32_t hash;
 
-    assert(sibling);
-    assert(node);
+    assert(!rec->refs);
+    hash = lyd_bits_hash(rec);
 
-    ctx = sibling->schema->module->ctx;
+    pthread_mutex_lock(&ctx->bits_lock);
 
-    if (sibling == node) {
-        return EXIT_SUCCESS;
+    if (!ctx->bits_ht) {
+        ctx->bits_ht = lyht_new(16, sizeof rec, lyd_bits_val_equal, NULL, 1);
+        LY_CHECK_ERR_GOTO(!ctx->bits_ht, LOGMEM(ctx), error);
     }
 
-    /* check placing the node to the appropriate place according to the schema */
-    for (par1 = lys_parent(sibling->schema);
-         par1 && !(par1->nodetype & (LYS_CONTAINER | LYS_LIST | LYS_INPUT | LYS_OUTPUT | LYS_ACTION | LYS_NOTIF));
-         par1 = lys_parent(par1));
-    for (par2 = lys_parent(node->schema);
-         par2 && !(par2->nodetype & (LYS_CONTAINER | LYS_LIST | LYS_INPUT | LYS_OUTPUT | LYS_ACTION | LYS_NOTIF));
-         par2 = lys_parent(par2));
-    if (par1 != par2) {
-        LOGERR(ctx, LY_EINVAL, "Cannot insert, different parents (\"%s\" and \"%s\").",
-               (par1 ? par1->name : "<top-lvl>"), (par2 ? par2->name : "<top-lvl>"));
-        return EXIT_FAILURE;
+    if (!lyht_find(ctx->bits_ht, &rec, hash, (void **)&found)) {
+        /* the same value is already shared */
+        free(rec);
+        rec = *found;
+    } else if (lyht_insert(ctx->bits_ht, &rec, hash, NULL)) {
+        LOGMEM(ctx);
+        goto error;
     }
+    ++rec->refs;
 
-    if (invalidate && ((node->parent != sibling->parent) || (invalid = lyp_is_rpc_action(node->schema)) || !node->parent)) {
-        /* a) it is not just moving under a parent node (invalid = 1) or
-         * b) it is in an RPC where nodes order matters (invalid = 2) or
-         * c) it is top-level where we don't know if it is the same tree (invalid = 1),
-         * so the validation will be necessary */
-        if (!node->parent && !invalid) {
-            /* c) search in siblings */
-            for (iter = node->prev; iter != node; iter = iter->prev) {
-                if (iter == sibling) {
-                    break;
-                }
-            }
-            if (iter == node) {
-                /* node and siblings are not currently in the same data tree */
-                invalid++;
-            }
-        } else { /* a) and b) */
-            invalid++;
-        }
+    pthread_mutex_unlock(&ctx->bits_lock);
+    return rec->bit;
+
+error:
+    pthread_mutex_unlock(&ctx->bits_lock);
+    free(rec);
+    return NULL;
+}
+
+struct lys_type_bit **
+lyd_bits_dup(struct lys_type_bit **bit)
+{
+    struct lyd_bits *rec = LYD_BITS_REC(bit);
+
+    assert(rec->refs);
+
+    pthread_mutex_lock(&rec->ctx->bits_lock);
+    ++rec->refs;
+    pthread_mutex_unlock(&rec->ctx->bits_lock);
+
+    return bit;
+}
+
+void
+lyd_bits_free(struct lys_type_bit **bit)
+{
+    struct lyd_bits *rec;
+    struct ly_ctx *ctx;
+
+    if (!bit) {
+        return;
     }
 
-    /* unlink only if it is not a list of siblings without a parent or node is not the first sibling,
-     * always unlink if just moving a node */
-    if ((!invalid) || node->parent || node->prev->next) {
-        /* remember the original position to be able to revert
-         * unlink in case of error */
-        orig_parent = node->parent;
-        if (node->prev != node) {
-            orig_prev = node->prev;
-        }
-        orig_next = node->next;
-        lyd_unlink_internal(node, invalid);
+    rec = LYD_BITS_REC(bit);
+    if (!rec->refs) {
+        /* never shared */
+        free(rec);
+        return;
     }
 
-    /* find first sibling node */
-    if (sibling->parent) {
-        start = sibling->parent->child;
-    } else {
-        for (start = sibling; start->prev->next; start = start->prev);
+    ctx = rec->ctx;
+    pthread_mutex_lock(&ctx->bits_lock);
+    if (!--rec->refs) {
+        lyht_remove(ctx->bits_ht, &rec, lyd_bits_hash(rec));
+        free(rec);
     }
+    pthread_mutex_unlock(&ctx->bits_lock);
+}
 
-    /* process the nodes one by one to clean the current tree */
-    if (!invalid) {
-        /* just moving one sibling */
-        last = node;
-        node->parent = sibling->parent;
-    } else {
-        LY_TREE_FOR_SAFE(node, next1, ins) {
-            lyd_insert_setinvalid(ins);
+size_t
+lyd_bits_mem_size(struct lys_type_bit **bit)
+{
+    struct lyd_bits *rec = LYD_BITS_REC(bit);
+    size_t size;
 
-            if (invalid == 1) {
-                /* auto delete nodes from other cases */
-                if (lyv_multicases(ins, NULL, &start, 1, sibling) == 2) {
-                    LOGVAL(ctx, LYE_SPEC, LY_VLOG_LYD, sibling, "Insert request refers node (%s) that is going to be auto-deleted.",
-                        ly_errpath(ctx));
-                    goto error;
-                }
-            }
+    size = sizeof *rec + rec->count * sizeof *rec->bit;
+    return rec->refs > 1 ? size / rec->refs : size;
+}
 
-            /* try to find previously present default instance to remove because of
-            * inserting the specified node */
-            if (ins->schema->nodetype == LYS_LEAFLIST) {
-                LY_TREE_FOR_SAFE(start, next2, iter) {
-                    if (iter->schema == ins->schema) {
-                        if ((ins->dflt && (!iter->dflt || ((iter->schema->flags & LYS_CONFIG_W) &&
-                                                        !strcmp(((struct lyd_node_leaf_list *)iter)->value_str,
-                                                                ((struct lyd_node_leaf_list *)ins)->value_str))))
-                                || (!ins->dflt && iter->dflt)) {
-                            /* iter will get deleted */
-                            if (iter == sibling) {
-                                LOGERR(ctx, LY_EINVAL, "Insert request refers node (%s) that is going to be auto-deleted.",
-                                    str = lyd_path(sibling));
-                                free(str);
-                                goto error;
-                            }
-                            if (iter == start) {
-                                start = next2;
-                            }
-                            lyd_free(iter);
-                        }
-                    }
-                }
-            } else if (ins->schema->nodetype == LYS_LEAF ||
-                    (ins->schema->nodetype == LYS_CONTAINER && !((struct lys_node_container *)ins->schema)->presence)) {
-                LY_TREE_FOR(start, iter) {
-                    if (iter->schema == ins->schema) {
-                        if (iter->dflt || ins->dflt) {
-                            /* iter gets deleted */
-                            if (iter == sibling) {
-                                LOGERR(ctx, LY_EINVAL, "Insert request refers node (%s) that is going to be auto-deleted.",
-                                    str = lyd_path(sibling));
-                                free(str);
-                                goto error;
-                            }
-                            if (iter == start) {
-                                start = iter->next;
-                            }
-                            lyd_free(iter);
-                        }
-                        break;
-                    }
-                }
-            }
+size_t
+lyd_bits_ht_mem_size(struct ly_ctx *ctx)
+{
+    size_t size;
 
-#ifdef LY_ENABLED_CACHE
-            lyd_unlink_hash(ins, ins->parent);
-#endif
+    pthread_mutex_lock(&ctx->bits_lock);
+    size = lyht_mem_size(ctx->bits_ht);
+    pthread_mutex_unlock(&ctx->bits_lock);
 
-            ins->parent = sibling->parent;
+    return size;
+}
 
-#ifdef LY_ENABLED_CACHE
-            lyd_insert_hash(ins);
-#endif
-            last = ins;
-        }
-    }
+void
+lyd_bits_clear(struct ly_ctx *ctx)
+{
+    struct ht_rec *ht_rec;
+    uint32_t i;
 
-    /* insert the (list of) node(s) to the specified position */
-    if (before) {
-        if (sibling->prev->next) {
-            /* adding into a middle */
-            sibling->prev->next = node;
-        } else if (sibling->parent) {
-            /* at the beginning */
-            sibling->parent->child = node;
-        }
-        node->prev = sibling->prev;
-        sibling->prev = last;
-        last->next = sibling;
-    } else { /* after */
-        if (sibling->next) {
-            /* adding into a middle - fix the prev pointer of the node after inserted nodes */
-            last->next = sibling->next;
-            sibling->next->prev = last;
-        } else {
-            /* at the end - fix the prev pointer of the first node */
-            start->prev = last;
+    pthread_mutex_lock(&ctx->bits_lock);
+
+    if (ctx->bits_ht) {
+        /* values of data trees not freed before the context */
+        for (i = 0; i < ctx->bits_ht->size; ++i) {
+            if (ctx->bits_ht->ctrl[i] & LYHT_CTRL_FULL) {
+                ht_rec = lyht_get_rec(ctx->bits_ht->recs, ctx->bits_ht->rec_size, i);
+                free(*(struct lyd_bits **)ht_rec->val);
+            }
         }
-        sibling->next = node;
-        node->prev = sibling;
+        lyht_free(ctx->bits_ht);
+        ctx->bits_ht = NULL;
     }
 
-    if (invalidate) {
-        LY_TREE_FOR(node, next1) {
-            check_leaf_list_backlinks(next1, 0);
-            if (next1 == last) {
-                break;
-            }
+    pthread_mutex_unlock(&ctx->bits_lock);
+}
+
+/* decoded binary value, the context holds a dictionary reference of the encoded value */
+struct lyd_binary {
+    const char *str;
+    uint8_t *data;
+    size_t len;
+};
+
+static int
+lyd_binary_val_equal(void *val1_p, void *val2_p, int UNUSED(mod), void *UNUSED(cb_data))
+{
+    return ((struct lyd_binary *)val1_p)->str == ((struct lyd_binary *)val2_p)->str;
+}
+
+static uint32_t
+lyd_binary_hash(const char *str)
+{
+    uint32_t hash;
+
+    hash = dict_hash_multi(0, (const char *)&str, sizeof str);
+    return dict_hash_multi(hash, NULL, 0);
+}
+
+/* decode a valid Base64 value, line breaks are skipped */
+static int
+lyd_binary_decode(struct ly_ctx *ctx, const char *str, uint8_t **data, size_t *len)
+{
+    size_t i, n = 0;
+    uint32_t quad = 0;
+    int count = 0, v;
+
+    *data = malloc(strlen(str) / 4 * 3 + 1);
+    LY_CHECK_ERR_RETURN(!*data, LOGMEM(ctx), -1);
+
+    for (i = 0; str[i] && (str[i] != '='); ++i) {
+        if ((str[i] >= 'A') && (str[i] <= 'Z')) {
+            v = str[i] - 'A';
+        } else if ((str[i] >= 'a') && (str[i] <= 'z')) {
+            v = str[i] - 'a' + 26;
+        } else if ((str[i] >= '0') && (str[i] <= '9')) {
+            v = str[i] - '0' + 52;
+        } else if (str[i] == '+') {
+            v = 62;
+        } else if (str[i] == '/') {
+            v = 63;
+        } else {
+            continue;
         }
-    }
 
-    return EXIT_SUCCESS;
+        quad = (quad << 6) | v;
+        if (++count == 4) {
+            (*data)[n++] = quad >> 16;
+            (*data)[n++] = quad >> 8;
+            (*data)[n++] = quad;
+            quad = 0;
+            count = 0;
+        }
+    }
 
-error:
-    /* insert back to the original position */
-    if (orig_prev) {
-        lyd_insert_after(orig_prev, node);
-    } else if (orig_next) {
-        lyd_insert_before(orig_next, node);
-    } else if (orig_parent) {
-        /* there were no siblings */
-        orig_parent->child = node;
-        node->parent = orig_parent;
+    /* padded end */
+    if (count == 3) {
+        (*data)[n++] = quad >> 10;
+        (*data)[n++] = quad >> 2;
+    } else if (count == 2) {
+        (*data)[n++] = quad >> 4;
     }
-    return EXIT_FAILURE;
+
+    *len = n;
+    return 0;
 }
 
-API int
-lyd_insert_before(struct lyd_node *sibling, struct lyd_node *node)
+API const void *
+lyd_binary_value(const struct lyd_node *node, size_t *len)
 {
-    if (!node || !sibling) {
+    const struct lyd_node_leaf_list *leaf = (const struct lyd_node_leaf_list *)node;
+    struct ly_ctx *ctx;
+    struct lyd_binary rec, *found;
+    uint32_t hash;
+    const void *data = NULL;
+
+    if (!node || !(node->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST)) || !len || (leaf->value_type != LY_TYPE_BINARY)
+            || (leaf->value_flags & LY_VALUE_USER)) {
         LOGARG;
-        return EXIT_FAILURE;
+        return NULL;
     }
+    ctx = node->schema->module->ctx;
 
-    return lyd_insert_nextto(sibling, node, 1, 1);
+    if (!leaf->value.binary || !leaf->value.binary[0]) {
+        *len = 0;
+        return "";
+    }
+
+    rec.str = leaf->value.binary;
+    hash = lyd_binary_hash(rec.str);
+
+    pthread_mutex_lock(&ctx->binary_lock);
+
+    if (ctx->binary_ht && !lyht_find(ctx->binary_ht, &rec, hash, (void **)&found)) {
+        *len = found->len;
+        data = found->data;
+        goto cleanup;
+    }
+
+    if (!ctx->binary_ht) {
+        ctx->binary_ht = lyht_new(8, sizeof rec, lyd_binary_val_equal, NULL, 1);
+        LY_CHECK_ERR_GOTO(!ctx->binary_ht, LOGMEM(ctx), cleanup);
+    }
+    if (lyd_binary_decode(ctx, rec.str, &rec.data, &rec.len)) {
+        goto cleanup;
+    }
+    if (lyht_insert(ctx->binary_ht, &rec, hash, NULL)) {
+        LOGMEM(ctx);
+        free(rec.data);
+        goto cleanup;
+    }
+    /* the value string cannot be freed and reused while decoded */
+    lydict_insert(ctx, rec.str, 0);
+
+    *len = rec.len;
+    data = rec.data;
+
+cleanup:
+    pthread_mutex_unlock(&ctx->binary_lock);
+    return data;
 }
 
-API int
-lyd_insert_after(struct lyd_node *sibling, struct lyd_node *node)
+size_t
+lyd_binary_mem_size(struct ly_ctx *ctx)
 {
-    if (!node || !sibling) {
-        LOGARG;
-        return EXIT_FAILURE;
+    struct ht_rec *ht_rec;
+    size_t size;
+    uint32_t i;
+
+    pthread_mutex_lock(&ctx->binary_lock);
+
+    size = lyht_mem_size(ctx->binary_ht);
+    if (ctx->binary_ht) {
+        for (i = 0; i < ctx->binary_ht->size; ++i) {
+            if (ctx->binary_ht->ctrl[i] & LYHT_CTRL_FULL) {
+                ht_rec = lyht_get_rec(ctx->binary_ht->recs, ctx->binary_ht->rec_size, i);
+                size += ((struct lyd_binary *)ht_rec->val)->len;
+            }
+        }
     }
 
-    return lyd_insert_nextto(sibling, node, 0, 1);
+    pthread_mutex_unlock(&ctx->binary_lock);
+    return size;
 }
 
-static uint32_t
-lys_module_pos(struct lys_module *module)
+void
+lyd_binary_clear(struct ly_ctx *ctx)
 {
-    int i;
-    uint32_t pos = 1;
+    struct ht_rec *ht_rec;
+    struct lyd_binary *bin;
+    uint32_t i;
 
-    for (i = 0; i < module->ctx->models.used; ++i) {
-        if (module->ctx->models.list[i] == module) {
-            return pos;
+    pthread_mutex_lock(&ctx->binary_lock);
+
+    if (ctx->binary_ht) {
+        for (i = 0; i < ctx->binary_ht->size; ++i) {
+            if (ctx->binary_ht->ctrl[i] & LYHT_CTRL_FULL) {
+                ht_rec = lyht_get_rec(ctx->binary_ht->recs, ctx->binary_ht->rec_size, i);
+                bin = (struct lyd_binary *)ht_rec->val;
+                lydict_remove(ctx, bin->str);
+                free(bin->data);
+            }
         }
-        ++pos;
+        lyht_free(ctx->binary_ht);
+        ctx->binary_ht = NULL;
     }
 
-    LOGINT(module->ctx);
-    return 0;
+    pthread_mutex_unlock(&ctx->binary_lock);
 }
 
-static int
-lys_module_node_pos_r(struct lys_node *first_sibling, struct lys_node *target, uint32_t *pos)
+void
+lyd_free_value(lyd_val value, LY_DATA_TYPE value_type, uint8_t value_flags, struct lys_type *type, lyd_val *old_val,
+               LY_DATA_TYPE *old_val_type, uint8_t *old_val_flags)
 {
-    const struct lys_node *next = NULL;
+    if (old_val) {
+        *old_val = value;
+        *old_val_type = value_type;
+        *old_val_flags = value_flags;
+        /* we only backup the values for now */
+        return;
+    }
 
-    /* the schema nodes are actually from data, lys_getnext skips non-data schema nodes for us (we know the parent will not be uses) */
-    while ((next = lys_getnext(next, lys_parent(first_sibling), lys_node_module(first_sibling), LYS_GETNEXT_NOSTATECHECK))) {
-        ++(*pos);
-        if (target == next) {
-            return 0;
+    /* otherwise the value is correctly freed */
+    if (value_flags & LY_VALUE_USER) {
+        assert(type->der && type->der->module);
+        lytype_free(type->der, value);
+    } else {
+        switch (value_type) {
+        case LY_TYPE_BITS:
+            lyd_bits_free(value.bit);
+            break;
+        case LY_TYPE_INST:
+            if (!(value_flags & LY_VALUE_UNRES)) {
+                break;
+            }
+            /* fallthrough */
+        case LY_TYPE_UNION:
+            /* unresolved union leaf */
+            lydict_remove(type->parent->module->ctx, value.string);
+            break;
+        default:
+            break;
         }
     }
+}
 
-    LOGINT(first_sibling->module->ctx);
-    return 1;
+static void
+_lyd_free_node(struct lyd_node *node)
+{
+    struct lyd_node_leaf_list *leaf;
+
+    if (!node) {
+        return;
+    }
+
+    switch (node->schema->nodetype) {
+    case LYS_CONTAINER:
+    case LYS_LIST:
+    case LYS_RPC:
+    case LYS_ACTION:
+    case LYS_NOTIF:
+#ifdef LY_ENABLED_CACHE
+        /* it should be empty because all the children are freed already (only if in debug mode) */
+        lyht_free(node->ht);
+        lyd_side_free(node);
+#endif
+        break;
+    case LYS_ANYDATA:
+    case LYS_ANYXML:
+        switch (((struct lyd_node_anydata *)node)->value_type) {
+        case LYD_ANYDATA_CONSTSTRING:
+        case LYD_ANYDATA_SXML:
+        case LYD_ANYDATA_JSON:
+            lydict_remove(node->schema->module->ctx, ((struct lyd_node_anydata *)node)->value.str);
+            break;
+        case LYD_ANYDATA_DATATREE:
+            lyd_free_withsiblings(((struct lyd_node_anydata *)node)->value.tree);
+            break;
+        case LYD_ANYDATA_XML:
+            lyxml_free_withsiblings(node->schema->module->ctx, ((struct lyd_node_anydata *)node)->value.xml);
+            break;
+        case LYD_ANYDATA_LYB:
+            free(((struct lyd_node_anydata *)node)->value.mem);
+            break;
+        case LYD_ANYDATA_STRING:
+        case LYD_ANYDATA_SXMLD:
+        case LYD_ANYDATA_JSOND:
+        case LYD_ANYDATA_LYBD:
+            /* dynamic strings are used only as input parameters */
+            assert(0);
+            break;
+        }
+        break;
+    case LYS_LEAF:
+    case LYS_LEAFLIST:
+        leaf = (struct lyd_node_leaf_list *)node;
+        lyd_free_value(leaf->value, leaf->value_type, leaf->value_flags, &((struct lys_node_leaf *)leaf->schema)->type,
+                       NULL, NULL, NULL);
+        lydict_remove_priv(leaf->schema->module->ctx, leaf->value_str, leaf->value_flags & LY_VALUE_PRIVATE);
+        break;
+    default:
+        assert(0);
+    }
+
+    lyd_free_attr(node->schema->module->ctx, node, node->attr, 1);
+    lyd_node_dealloc(node);
 }
 
-static int
-lyd_node_pos_cmp(const void *item1, const void *item2)
+static void
+lyd_free_internal_r(struct lyd_node *node, int top)
 {
-    uint32_t mpos1, mpos2;
-    struct lyd_node_pos *np1, *np2;
+    struct lyd_node *next, *iter;
 
-    np1 = (struct lyd_node_pos *)item1;
-    np2 = (struct lyd_node_pos *)item2;
+    if (!node) {
+        return;
+    }
 
-    /* different modules? */
-    if (lys_node_module(np1->node->schema) != lys_node_module(np2->node->schema)) {
-        mpos1 = lys_module_pos(lys_node_module(np1->node->schema));
-        mpos2 = lys_module_pos(lys_node_module(np2->node->schema));
-        /* if lys_module_pos failed, there is nothing we can do anyway,
-         * at least internal error will be printed */
+    /* if freeing top-level, always remove it from the parent hash table */
+    lyd_unlink_internal(node, (top ? 1 : 2));
 
-        if (mpos1 > mpos2) {
-            return 1;
-        } else {
-            return -1;
+    if (!(node->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST | LYS_ANYDATA))) {
+        /* free children */
+        LY_TREE_FOR_SAFE(node->child, next, iter) {
+            lyd_free_internal_r(iter, 0);
         }
     }
 
-    if (np1->pos > np2->pos) {
-        return 1;
-    } else if (np1->pos < np2->pos) {
-        return -1;
+    _lyd_free_node(node);
+}
+
+API void
+lyd_free(struct lyd_node *node)
+{
+    lyd_free_internal_r(node, 1);
+}
+
+static void
+lyd_free_withsiblings_r(struct lyd_node *first)
+{
+    struct lyd_node *next, *node;
+
+    LY_TREE_FOR_SAFE(first, next, node) {
+        if (node->schema->nodetype & (LYS_CONTAINER | LYS_LIST | LYS_RPC | LYS_ACTION | LYS_NOTIF)) {
+            lyd_free_withsiblings_r(node->child);
+        }
+        _lyd_free_node(node);
     }
-    return 0;
 }
 
-API int
-lyd_schema_sort(struct lyd_node *sibling, int recursive)
+API void
+lyd_free_withsiblings(struct lyd_node *node)
 {
-    uint32_t len, i;
-    struct lyd_node *node;
-    struct lys_node *first_ssibling = NULL;
-    struct lyd_node_pos *array;
+    struct lyd_node *iter, *aux;
 
-    if (!sibling) {
-        LOGARG;
-        return -1;
+    if (!node) {
+        return;
     }
+    lyd_gen_bump(node->schema->module->ctx);
 
-    /* something actually to sort */
-    if (sibling->prev != sibling) {
+    if (node->parent) {
+        /* optimization - avoid freeing (unlinking) the last node of the siblings list */
+        /* so, first, free the node's predecessors to the beginning of the list ... */
+        for(iter = node->prev; iter->next; iter = aux) {
+            aux = iter->prev;
+            lyd_free(iter);
+        }
+        /* ... then, the node is the first in the siblings list, so free them all */
+        LY_TREE_FOR_SAFE(node, aux, iter) {
+            lyd_free(iter);
+        }
+    } else {
+        /* node is top-level so we are freeing the whole data tree, we can just free nodes without any unlinking */
+        while (node->prev->next) {
+            /* find the first sibling */
+            node = node->prev;
+        }
 
-        /* find the beginning */
-        sibling = lyd_first_sibling(sibling);
+        /* free it all */
+        lyd_free_tree(node);
+    }
+}
 
-        /* count siblings */
-        len = 0;
-        for (node = sibling; node; node = node->next) {
-            ++len;
+/* number of subtrees assigned to every freeing thread before it is worth splitting the subtrees further */
+#define LYD_FREE_SUBTREES_PER_THREAD 4
+
+struct lyd_free_thread {
+    struct lyd_node **roots;        /* subtrees to be freed by the thread */
+    uint32_t count;
+    struct ly_ctx *ctx;
+};
+
+static void *
+lyd_free_thread(void *arg)
+{
+    struct lyd_free_thread *ft = (struct lyd_free_thread *)arg;
+    struct lyd_node *root;
+    uint32_t i;
+
+    lydict_batch_start(ft->ctx);
+    for (i = 0; i < ft->count; ++i) {
+        root = ft->roots[i];
+        if (root->schema->nodetype & (LYS_CONTAINER | LYS_LIST | LYS_RPC | LYS_ACTION | LYS_NOTIF)) {
+            lyd_free_withsiblings_r(root->child);
         }
+        _lyd_free_node(root);
+    }
+    lydict_batch_stop();
 
-        array = malloc(len * sizeof *array);
-        LY_CHECK_ERR_RETURN(!array, LOGMEM(sibling->schema->module->ctx), -1);
+    return NULL;
+}
 
-        /* fill arrays with positions and corresponding nodes */
-        for (i = 0, node = sibling; i < len; ++i, node = node->next) {
-            array[i].pos = 0;
+/**
+ * @brief Free the independent subtrees of a data tree in several threads, see ly_ctx_set_free_threads().
+ *
+ * The top-level siblings are split among the threads. If there are only a few of them, their children are split
+ * instead (repeatedly) and the emptied parents are freed by the calling thread at the end.
+ *
+ * @param[in] first First top-level sibling of the data tree.
+ * @param[in] threads Number of threads to use.
+ * @return EXIT_SUCCESS or EXIT_FAILURE if the tree was not freed at all.
+ */
+static int
+lyd_free_parallel(struct lyd_node *first, uint16_t threads)
+{
+    struct ly_ctx *ctx = first->schema->module->ctx;
+    struct ly_set *roots, *next, *shells;
+    struct lyd_node *iter, *node;
+    struct lyd_free_thread *ft = NULL;
+    pthread_t *tids = NULL;
+    int *started = NULL, split;
+    uint32_t i, start, thread_count;
+    int ret = EXIT_FAILURE;
 
-            /* we need to repeat this for every module */
-            if (!first_ssibling || (lyd_node_module(node) != lys_node_module(first_ssibling))) {
-                /* find the data node schema parent */
-                first_ssibling = node->schema;
-                while (lys_parent(first_ssibling)
-                        && (lys_parent(first_ssibling)->nodetype & (LYS_CHOICE | LYS_CASE | LYS_USES))) {
-                    first_ssibling = lys_parent(first_ssibling);
-                }
+    roots = ly_set_new();
+    shells = ly_set_new();
+    LY_CHECK_ERR_GOTO(!roots || !shells, LOGMEM(ctx), cleanup);
+    LY_TREE_FOR(first, iter) {
+        LY_CHECK_GOTO(ly_set_add(roots, iter, LY_SET_OPT_USEASLIST) == -1, cleanup);
+    }
 
-                /* find the beginning */
-                if (lys_parent(first_ssibling)) {
-                    first_ssibling = lys_parent(first_ssibling)->child;
-                } else {
-                    while (first_ssibling->prev->next) {
-                        first_ssibling = first_ssibling->prev;
-                    }
+    /* descend until there are enough independent subtrees */
+    do {
+        split = 0;
+        if (roots->number >= (unsigned)threads * LYD_FREE_SUBTREES_PER_THREAD) {
+            break;
+        }
+        next = ly_set_new();
+        LY_CHECK_ERR_GOTO(!next, LOGMEM(ctx), cleanup);
+        for (i = 0; i < roots->number; ++i) {
+            node = roots->set.d[i];
+            if ((node->schema->nodetype & (LYS_CONTAINER | LYS_LIST | LYS_RPC | LYS_ACTION | LYS_NOTIF)) && node->child) {
+                LY_CHECK_ERR_GOTO(ly_set_add(shells, node, LY_SET_OPT_USEASLIST) == -1, ly_set_free(next), cleanup);
+                LY_TREE_FOR(node->child, iter) {
+                    LY_CHECK_ERR_GOTO(ly_set_add(next, iter, LY_SET_OPT_USEASLIST) == -1, ly_set_free(next), cleanup);
                 }
+                split = 1;
+            } else {
+                LY_CHECK_ERR_GOTO(ly_set_add(next, node, LY_SET_OPT_USEASLIST) == -1, ly_set_free(next), cleanup);
             }
+        }
+        ly_set_free(roots);
+        roots = next;
+    } while (split);
 
-            if (lys_module_node_pos_r(first_ssibling, node->schema, &array[i].pos)) {
-                free(array);
-                return -1;
-            }
+    thread_count = (roots->number < threads) ? roots->number : threads;
+    ft = calloc(thread_count, sizeof *ft);
+    tids = malloc(thread_count * sizeof *tids);
+    started = calloc(thread_count, sizeof *started);
+    LY_CHECK_ERR_GOTO(!ft || !tids || !started, LOGMEM(ctx), cleanup);
 
-            array[i].node = node;
+    for (i = 0, start = 0; i < thread_count; ++i) {
+        ft[i].roots = (struct lyd_node **)&roots->set.d[start];
+        ft[i].count = (roots->number - start) / (thread_count - i);
+        ft[i].ctx = ctx;
+        start += ft[i].count;
+    }
+
+    /* the calling thread frees the first part itself */
+    for (i = 1; i < thread_count; ++i) {
+        started[i] = pthread_create(&tids[i], NULL, lyd_free_thread, &ft[i]) ? 0 : 1;
+    }
+    for (i = 0; i < thread_count; ++i) {
+        if (started[i]) {
+            pthread_join(tids[i], NULL);
+        } else {
+            lyd_free_thread(&ft[i]);
         }
+    }
 
-        /* sort the arrays */
-        qsort(array, len, sizeof *array, lyd_node_pos_cmp);
+    /* the parents of the split subtrees, the deeper ones first */
+    lydict_batch_start(ctx);
+    for (i = shells->number; i > 0; --i) {
+        _lyd_free_node(shells->set.d[i - 1]);
+    }
+    lydict_batch_stop();
+    ret = EXIT_SUCCESS;
 
-        /* adjust siblings based on the sorted array */
-        for (i = 0; i < len; ++i) {
-            /* parent child */
-            if (i == 0) {
-                /* adjust sibling so that it still points to the beginning */
-                sibling = array[i].node;
-                if (array[i].node->parent) {
-                    array[i].node->parent->child = array[i].node;
-                }
-            }
+cleanup:
+    ly_set_free(roots);
+    ly_set_free(shells);
+    free(ft);
+    free(tids);
+    free(started);
+    return ret;
+}
 
-            /* prev */
-            if (i > 0) {
-                array[i].node->prev = array[i - 1].node;
-            } else {
-                array[i].node->prev = array[len - 1].node;
-            }
+void
+lyd_free_tree(struct lyd_node *first)
+{
+    struct ly_ctx *ctx = first->schema->module->ctx;
 
-            /* next */
-            if (i < len - 1) {
-                array[i].node->next = array[i + 1].node;
-            } else {
-                array[i].node->next = NULL;
-            }
-        }
-        free(array);
+    if ((ctx->free_threads > 1) && !lyd_free_parallel(first, ctx->free_threads)) {
+        return;
     }
 
-    /* sort all the children recursively */
-    if (recursive) {
-        LY_TREE_FOR(sibling, node) {
-            if ((node->schema->nodetype & (LYS_CONTAINER | LYS_LIST | LYS_RPC | LYS_ACTION | LYS_NOTIF))
-                    && node->child && lyd_schema_sort(node->child, recursive)) {
-                return -1;
-            }
+    lydict_batch_start(ctx);
+    lyd_free_withsiblings_r(first);
+    lydict_batch_stop();
+}
+
+struct lyd_reclaim {
+    struct lyd_node *tree;
+    struct lyd_reclaim *next;
+};
+
+static void *
+lyd_reclaim_thread(void *arg)
+{
+    struct ly_ctx *ctx = (struct ly_ctx *)arg;
+    struct lyd_reclaim *item;
+
+    pthread_mutex_lock(&ctx->reclaim_lock);
+    while (1) {
+        while (!ctx->reclaim_queue && !ctx->reclaim_stop) {
+            pthread_cond_wait(&ctx->reclaim_cond, &ctx->reclaim_lock);
+        }
+        item = ctx->reclaim_queue;
+        if (!item) {
+            /* stopped and there is nothing left */
+            break;
         }
+        ctx->reclaim_queue = item->next;
+        ctx->reclaim_busy = 1;
+        pthread_mutex_unlock(&ctx->reclaim_lock);
+
+        lyd_free_tree(item->tree);
+        free(item);
+
+        pthread_mutex_lock(&ctx->reclaim_lock);
+        ctx->reclaim_busy = 0;
+        pthread_cond_broadcast(&ctx->reclaim_cond);
     }
+    pthread_mutex_unlock(&ctx->reclaim_lock);
 
-    return EXIT_SUCCESS;
+    return NULL;
 }
 
-static int
-_lyd_validate(struct lyd_node **node, struct lyd_node *data_tree, struct ly_ctx *ctx, const struct lys_module **modules,
-              int mod_count, struct lyd_difflist **diff, int options)
+API void
+lyd_free_deferred(struct lyd_node *node)
 {
-    struct lyd_node *root, *next1, *next2, *iter, *act_notif = NULL;
-    int ret = EXIT_FAILURE;
-    unsigned int i;
-    struct unres_data *unres = NULL;
-    const struct lys_module *yanglib_mod;
-
-    unres = calloc(1, sizeof *unres);
-    LY_CHECK_ERR_RETURN(!unres, LOGMEM(NULL), EXIT_FAILURE);
+    struct ly_ctx *ctx;
+    struct lyd_reclaim *item;
 
-    if (diff) {
-        unres->store_diff = 1;
-        unres->diff = lyd_diff_init_difflist(ctx, &unres->diff_size);
+    if (!node) {
+        return;
+    } else if (node->parent) {
+        /* the nodes must be unlinked now anyway */
+        lyd_free_withsiblings(node);
+        return;
     }
 
-    if ((options & (LYD_OPT_RPC | LYD_OPT_RPCREPLY)) && *node && ((*node)->schema->nodetype != LYS_RPC)) {
-        options |= LYD_OPT_ACT_NOTIF;
+    ctx = node->schema->module->ctx;
+    lyd_gen_bump(ctx);
+    while (node->prev->next) {
+        node = node->prev;
     }
-    if ((options & (LYD_OPT_NOTIF | LYD_OPT_NOTIF_FILTER)) && *node && ((*node)->schema->nodetype != LYS_NOTIF)) {
-        options |= LYD_OPT_ACT_NOTIF;
+
+    item = malloc(sizeof *item);
+    if (!item) {
+        lyd_free_tree(node);
+        return;
     }
+    item->tree = node;
 
-    LY_TREE_FOR_SAFE(*node, next1, root) {
-        if (modules) {
-            for (i = 0; i < (unsigned)mod_count; ++i) {
-                if (lyd_node_module(root) == modules[i]) {
-                    break;
-                }
-            }
-            if (i == (unsigned)mod_count) {
-                /* skip data that should not be validated */
-                continue;
-            }
+    pthread_mutex_lock(&ctx->reclaim_lock);
+    if (!ctx->reclaim_started) {
+        if (pthread_create(&ctx->reclaim_tid, NULL, lyd_reclaim_thread, ctx)) {
+            /* no background thread, free it right away */
+            pthread_mutex_unlock(&ctx->reclaim_lock);
+            free(item);
+            lyd_free_tree(node);
+            return;
         }
+        ctx->reclaim_started = 1;
+    }
+    item->next = ctx->reclaim_queue;
+    ctx->reclaim_queue = item;
+    pthread_cond_broadcast(&ctx->reclaim_cond);
+    pthread_mutex_unlock(&ctx->reclaim_lock);
+}
 
-        LY_TREE_DFS_BEGIN(root, next2, iter) {
-            if (iter->parent && (iter->schema->nodetype & (LYS_ACTION | LYS_NOTIF))) {
-                if (!(options & LYD_OPT_ACT_NOTIF) || act_notif) {
-                    LOGVAL(ctx, LYE_INELEM, LY_VLOG_LYD, iter, iter->schema->name);
-                    LOGVAL(ctx, LYE_SPEC, LY_VLOG_PREV, NULL, "Unexpected %s node \"%s\".",
-                           (options & LYD_OPT_RPC ? "action" : "notification"), iter->schema->name);
-                    goto cleanup;
-                }
-                act_notif = iter;
-            }
+API void
+lyd_free_deferred_wait(struct ly_ctx *ctx)
+{
+    if (!ctx) {
+        return;
+    }
 
-            if (lyv_data_context(iter, options, unres) || lyv_data_content(iter, options, unres)) {
-                goto cleanup;
-            }
+    pthread_mutex_lock(&ctx->reclaim_lock);
+    while (ctx->reclaim_queue || ctx->reclaim_busy) {
+        pthread_cond_wait(&ctx->reclaim_cond, &ctx->reclaim_lock);
+    }
+    pthread_mutex_unlock(&ctx->reclaim_lock);
+}
 
-            /* basic validation successful */
-            iter->validity &= ~LYD_VAL_MAND;
+void
+lyd_reclaim_stop(struct ly_ctx *ctx)
+{
+    pthread_mutex_lock(&ctx->reclaim_lock);
+    if (!ctx->reclaim_started) {
+        pthread_mutex_unlock(&ctx->reclaim_lock);
+        return;
+    }
+    ctx->reclaim_stop = 1;
+    pthread_cond_broadcast(&ctx->reclaim_cond);
+    pthread_mutex_unlock(&ctx->reclaim_lock);
 
-            /* empty non-default, non-presence container without attributes, make it default */
-            if (!iter->dflt && (iter->schema->nodetype == LYS_CONTAINER) && !iter->child
-                        && !((struct lys_node_container *)iter->schema)->presence && !iter->attr) {
-                iter->dflt = 1;
-            }
+    /* the queued trees are freed before the thread ends */
+    pthread_join(ctx->reclaim_tid, NULL);
+    ctx->reclaim_started = 0;
+    ctx->reclaim_stop = 0;
+}
 
-            LY_TREE_DFS_END(root, next2, iter);
-        }
+/**
+ * Expectations:
+ * - list exists in data tree
+ * - the leaf (defined by the unique_expr) is not instantiated under the list
+ */
+int
+lyd_get_unique_default(const char* unique_expr, struct lyd_node *list, const char **dflt)
+{
+    struct ly_ctx *ctx = list->schema->module->ctx;
+    const struct lys_node *parent;
+    const struct lys_node_leaf *sleaf = NULL;
+    struct lys_tpdf *tpdf;
+    struct lyd_node *last, *node;
+    struct ly_set *s, *r;
+    unsigned int i;
+    enum int_log_opts prev_ilo;
 
-        if (options & LYD_OPT_NOSIBLINGS) {
-            break;
+    assert(unique_expr && list && dflt);
+    *dflt = NULL;
+
+    if (resolve_descendant_schema_nodeid(unique_expr, list->schema->child, LYS_LEAF, 1, &parent) || !parent) {
+        /* error, but unique expression was checked when the schema was parsed so this should not happened */
+        LOGINT(ctx);
+        return -1;
+    }
+
+    sleaf = (struct lys_node_leaf *)parent;
+    if (sleaf->dflt) {
+        /* leaf has a default value */
+        *dflt = sleaf->dflt;
+    } else if (!(sleaf->flags & LYS_MAND_TRUE)) {
+        /* get the default value from the type */
+        for (tpdf = sleaf->type.der; tpdf && !(*dflt); tpdf = tpdf->type.der) {
+            *dflt = tpdf->dflt;
         }
+    }
 
+    if (!(*dflt)) {
+        return 0;
     }
 
-    if (options & LYD_OPT_ACT_NOTIF) {
-        if (!act_notif) {
-            LOGVAL(ctx, LYE_MISSELEM, LY_VLOG_LYD, *node, (options & LYD_OPT_RPC ? "action" : "notification"), (*node)->schema->name);
-            goto cleanup;
+    /* it has default value, but check if it can appear in the data tree under the list */
+    s = ly_set_new();
+    for (parent = lys_parent((struct lys_node *)sleaf); parent != list->schema; parent = lys_parent(parent)) {
+        if (!(parent->nodetype & (LYS_CONTAINER | LYS_CASE | LYS_CHOICE | LYS_USES))) {
+            /* This should be already detected when parsing schema */
+            LOGINT(ctx);
+            ly_set_free(s);
+            return -1;
         }
-        options &= ~LYD_OPT_ACT_NOTIF;
+        ly_set_add(s, (void *)parent, LY_SET_OPT_USEASLIST);
     }
 
-    if (*node) {
-        /* check for uniqueness of top-level lists/leaflists because
-         * only the inner instances were tested in lyv_data_content() */
-        yanglib_mod = ly_ctx_get_module(ctx ? ctx : (*node)->schema->module->ctx, "ietf-yang-library", NULL, 1);
-        LY_TREE_FOR(*node, root) {
-            if ((options & LYD_OPT_DATA_ADD_YANGLIB) && yanglib_mod && (root->schema->module == yanglib_mod)) {
-                /* ietf-yang-library data present, so ignore the option to add them */
-                options &= ~LYD_OPT_DATA_ADD_YANGLIB;
-            }
+    ly_ilo_change(NULL, ILO_IGNORE, &prev_ilo, NULL);
+    for (i = 0, last = list; i < s->number; i++) {
+        parent = s->set.s[i]; /* shortcut */
 
-            if (!(root->schema->nodetype & (LYS_LIST | LYS_LEAFLIST)) || !(root->validity & LYD_VAL_DUP)) {
+        switch (parent->nodetype) {
+        case LYS_CONTAINER:
+            if (last) {
+                /* find instance in the data */
+                r = lyd_find_path(last, parent->name);
+                if (!r || r->number > 1) {
+                    ly_set_free(r);
+                    *dflt = NULL;
+                    goto end;
+                }
+                if (r->number) {
+                    last = r->set.d[0];
+                } else {
+                    last = NULL;
+                }
+                ly_set_free(r);
+            }
+            if (((struct lys_node_container *)parent)->presence) {
+                /* not-instantiated presence container on path */
+                *dflt = NULL;
+                goto end;
+            }
+            break;
+        case LYS_CHOICE :
+            /* check presence of another case */
+            if (!last) {
                 continue;
             }
 
-            if (options & LYD_OPT_TRUSTED) {
-                /* just clear the flag */
-                root->validity &= ~LYD_VAL_DUP;
+            /* remember the case to be searched in choice by lyv_multicases() */
+            if (i + 1 == s->number) {
+                parent = (struct lys_node *)sleaf;
+            } else if (s->set.s[i + 1]->nodetype == LYS_CASE && (i + 2 < s->number) &&
+                    s->set.s[i + 2]->nodetype == LYS_CHOICE) {
+                /* nested choices are covered by lyv_multicases, we just have to pass
+                 * the lowest choice */
+                i++;
                 continue;
+            } else {
+                parent = s->set.s[i + 1];
+            }
+            node = last->child;
+            if (lyv_multicases(NULL, (struct lys_node *)parent, &node, 0, NULL)) {
+                /* another case is present */
+                *dflt = NULL;
+                goto end;
             }
+            break;
+        default:
+            /* LYS_CASE, LYS_USES */
+            continue;
+        }
+    }
+
+end:
+    ly_ilo_restore(NULL, prev_ilo, NULL, 0);
+    ly_set_free(s);
+    return 0;
+}
 
-            if (lyv_data_dup(root, *node)) {
-                goto cleanup;
-            }
-        }
-    }
+API char *
+lyd_path(const struct lyd_node *node)
+{
+    char sbuf[256], *buf;
+    int len;
 
-    /* add missing ietf-yang-library if requested */
-    if (options & LYD_OPT_DATA_ADD_YANGLIB) {
-        if (!(*node)) {
-            (*node) = ly_ctx_info(ctx);
-        } else if (lyd_merge((*node), ly_ctx_info(ctx), LYD_OPT_DESTRUCT | LYD_OPT_EXPLICIT)) {
-            LOGERR(ctx, LY_EINT, "Adding ietf-yang-library data failed.");
-            goto cleanup;
-        }
+    if (!node) {
+        LOGARG;
+        return NULL;
     }
 
-    /* add default values, resolve unres and check for mandatory nodes in final tree */
-    if (lyd_defaults_add_unres(node, options, ctx, modules, mod_count, data_tree, act_notif, unres, 1)) {
-        goto cleanup;
+    len = lyd_path_buf(node, sbuf, sizeof sbuf);
+    if (len < 0) {
+        return NULL;
+    } else if ((size_t)len < sizeof sbuf) {
+        buf = strdup(sbuf);
+        LY_CHECK_ERR_RETURN(!buf, LOGMEM(lyd_node_module(node)->ctx), NULL);
+        return buf;
     }
-    if (act_notif) {
-        if (lyd_check_mandatory_tree(act_notif, ctx, modules, mod_count, options)) {
-            goto cleanup;
-        }
-    } else {
-        if (lyd_check_mandatory_tree(*node, ctx, modules, mod_count, options)) {
-            goto cleanup;
-        }
+
+    /* too long for the static buffer */
+    buf = malloc(len + 1);
+    LY_CHECK_ERR_RETURN(!buf, LOGMEM(lyd_node_module(node)->ctx), NULL);
+    lyd_path_buf(node, buf, len + 1);
+    return buf;
+}
+
+/* append a string to the path buffer, the length is counted even if it does not fit */
+static void
+lyd_path_buf_add(char *buf, size_t buf_len, size_t *len, const char *str, size_t str_len)
+{
+    if (*len < buf_len) {
+        memcpy(buf + *len, str, (*len + str_len <= buf_len) ? str_len : buf_len - *len);
     }
+    *len += str_len;
+}
 
-    /* consolidate diff if created */
-    if (diff) {
-        assert(unres->store_diff);
+static void
+lyd_path_buf_value(char *buf, size_t buf_len, size_t *len, const char *value)
+{
+    const char *quot;
+
+    quot = strchr(value, '\'') ? "\"" : "'";
+    lyd_path_buf_add(buf, buf_len, len, "=", 1);
+    lyd_path_buf_add(buf, buf_len, len, quot, 1);
+    lyd_path_buf_add(buf, buf_len, len, value, strlen(value));
+    lyd_path_buf_add(buf, buf_len, len, quot, 1);
+    lyd_path_buf_add(buf, buf_len, len, "]", 1);
+}
 
-        for (i = 0; i < unres->diff_idx; ++i) {
-            if (unres->diff->type[i] == LYD_DIFF_CREATED) {
-                if (unres->diff->second[i]->parent) {
-                    unres->diff->first[i] = (struct lyd_node *)lyd_path(unres->diff->second[i]->parent);
+static void
+lyd_path_buf_r(const struct lyd_node *node, char *buf, size_t buf_len, size_t *len)
+{
+    const struct lys_module *mod, *kmod;
+    const struct lys_node_list *slist;
+    const struct lyd_node *key;
+    const char *ext_name = NULL, *name;
+    char pos[16];
+    int i;
+
+    mod = lyd_node_module(node);
+    if (node->parent) {
+        lyd_path_buf_r(node->parent, buf, buf_len, len);
+    } else {
+        ext_name = lyp_get_yang_data_template_name(node);
+    }
+
+    /* node identifier, module-qualified where the module changes */
+    lyd_path_buf_add(buf, buf_len, len, "/", 1);
+    if (!node->parent || (lyd_node_module(node->parent) != mod)) {
+        lyd_path_buf_add(buf, buf_len, len, mod->name, strlen(mod->name));
+        lyd_path_buf_add(buf, buf_len, len, ":", 1);
+    }
+    if (ext_name) {
+        lyd_path_buf_add(buf, buf_len, len, "#", 1);
+        lyd_path_buf_add(buf, buf_len, len, ext_name, strlen(ext_name));
+        lyd_path_buf_add(buf, buf_len, len, "/", 1);
+    }
+    name = node->schema->name;
+    lyd_path_buf_add(buf, buf_len, len, name, strlen(name));
+
+    /* predicates */
+    if (node->schema->nodetype == LYS_LIST) {
+        slist = (const struct lys_node_list *)node->schema;
+        if (!slist->keys_size) {
+            /* instance position */
+            sprintf(pos, "[%u]", lyd_list_pos(node));
+            lyd_path_buf_add(buf, buf_len, len, pos, strlen(pos));
+        }
+        for (i = 0; i < slist->keys_size; ++i) {
+            LY_TREE_FOR(node->child, key) {
+                if (key->schema == (struct lys_node *)slist->keys[i]) {
+                    break;
                 }
-                unres->diff->second[i] = lyd_dup(unres->diff->second[i], LYD_DUP_OPT_RECURSIVE);
             }
-        }
-
-        *diff = unres->diff;
-        unres->diff = 0;
-        unres->diff_idx = 0;
-    }
-
-    ret = EXIT_SUCCESS;
+            if (!key || !((struct lyd_node_leaf_list *)key)->value_str) {
+                continue;
+            }
 
-cleanup:
-    if (unres) {
-        free(unres->node);
-        free(unres->type);
-        for (i = 0; i < unres->diff_idx; ++i) {
-            if (unres->diff->type[i] == LYD_DIFF_DELETED) {
-                lyd_free_withsiblings(unres->diff->first[i]);
-                free(unres->diff->second[i]);
+            lyd_path_buf_add(buf, buf_len, len, "[", 1);
+            kmod = lyd_node_module(key);
+            if (kmod != mod) {
+                lyd_path_buf_add(buf, buf_len, len, kmod->name, strlen(kmod->name));
+                lyd_path_buf_add(buf, buf_len, len, ":", 1);
             }
+            lyd_path_buf_add(buf, buf_len, len, key->schema->name, strlen(key->schema->name));
+            lyd_path_buf_value(buf, buf_len, len, ((struct lyd_node_leaf_list *)key)->value_str);
         }
-        lyd_free_diff(unres->diff);
-        free(unres);
+    } else if ((node->schema->nodetype == LYS_LEAFLIST) && ((struct lyd_node_leaf_list *)node)->value_str) {
+        lyd_path_buf_add(buf, buf_len, len, "[.", 2);
+        lyd_path_buf_value(buf, buf_len, len, ((struct lyd_node_leaf_list *)node)->value_str);
     }
-
-    return ret;
 }
 
 API int
-lyd_validate(struct lyd_node **node, int options, void *var_arg, ...)
+lyd_path_buf(const struct lyd_node *node, char *buf, size_t buf_len)
 {
-    struct lyd_node *iter, *data_tree = NULL;
-    struct lyd_difflist **diff = NULL;
-    struct ly_ctx *ctx = NULL;
-    va_list ap;
+    size_t len = 0;
 
-    if (!node) {
+    if (!node || (!buf && buf_len)) {
         LOGARG;
-        return EXIT_FAILURE;
+        return -1;
     }
 
-    if (lyp_data_check_options(NULL, options, __func__)) {
-        return EXIT_FAILURE;
+    lyd_path_buf_r(node, buf, buf_len, &len);
+    if (buf_len) {
+        buf[(len < buf_len) ? len : buf_len - 1] = '\0';
     }
 
-    data_tree = *node;
+    return (len > INT_MAX) ? INT_MAX : (int)len;
+}
 
-    if ((!(options & LYD_OPT_TYPEMASK)
-            || (options & (LYD_OPT_CONFIG | LYD_OPT_GET | LYD_OPT_GETCONFIG | LYD_OPT_EDIT))) && !(*node)) {
-        /* get context with schemas from the var_arg */
-        ctx = (struct ly_ctx *)var_arg;
-        if (!ctx) {
-            LOGERR(NULL, LY_EINVAL, "%s: invalid variable parameter (struct ly_ctx *ctx).", __func__);
-            return EXIT_FAILURE;
-        }
+int
+lyd_build_relative_data_path(const struct lys_module *module, const struct lyd_node *node, const char *schema_id,
+                             char *buf)
+{
+    const struct lys_node *snode, *schema;
+    const char *mod_name, *name;
+    int mod_name_len, name_len, len = 0;
+    int r, is_relative = -1;
 
-        /* LYD_OPT_NOSIBLINGS has no meaning here */
-        options &= ~LYD_OPT_NOSIBLINGS;
-    } else if (options & (LYD_OPT_RPC | LYD_OPT_RPCREPLY | LYD_OPT_NOTIF)) {
-        /* LYD_OPT_NOSIBLINGS cannot be set in this case */
-        if (options & LYD_OPT_NOSIBLINGS) {
-            LOGERR(NULL, LY_EINVAL, "%s: invalid parameter (variable arg const struct lyd_node *data_tree with LYD_OPT_NOSIBLINGS).", __func__);
-            return EXIT_FAILURE;
-        } else if (!(*node)) {
-            LOGARG;
-            return EXIT_FAILURE;
-        }
+    assert(schema_id && buf);
+    schema = node->schema;
 
-        /* get the additional data tree if given */
-        data_tree = (struct lyd_node *)var_arg;
-        if (data_tree) {
-            if (options & LYD_OPT_NOEXTDEPS) {
-                LOGERR(NULL, LY_EINVAL, "%s: invalid parameter (variable arg const struct lyd_node *data_tree and LYD_OPT_NOEXTDEPS set).",
-                       __func__);
-                return EXIT_FAILURE;
-            }
+    while (*schema_id) {
+        if ((r = parse_schema_nodeid(schema_id, &mod_name, &mod_name_len, &name, &name_len, &is_relative, NULL, NULL, 0)) < 1) {
+            LOGINT(module->ctx);
+            return -1;
+        }
+        schema_id += r;
 
-            LY_TREE_FOR(data_tree, iter) {
-                if (iter->parent) {
-                    /* a sibling is not top-level */
-                    LOGERR(NULL, LY_EINVAL, "%s: invalid variable parameter (const struct lyd_node *data_tree).", __func__);
-                    return EXIT_FAILURE;
-                }
+        snode = NULL;
+        while ((snode = lys_getnext(snode, schema, NULL, LYS_GETNEXT_WITHCHOICE | LYS_GETNEXT_WITHCASE | LYS_GETNEXT_NOSTATECHECK))) {
+            r = schema_nodeid_siblingcheck(snode, module, mod_name, mod_name_len, name, name_len);
+            if (r == 0) {
+                schema = snode;
+                break;
+            } else if (r == 1) {
+                continue;
+            } else {
+                return -1;
             }
-
-            /* move it to the beginning */
-            for (; data_tree->prev->next; data_tree = data_tree->prev);
         }
-    } else if (options & LYD_OPT_DATA_TEMPLATE) {
-        /* get context with schemas from the var_arg */
-        if (*node && ((*node)->prev->next || (*node)->next)) {
-            /* not allow sibling in top-level */
-            LOGERR(NULL, LY_EINVAL, "%s: invalid variable parameter (struct lyd_node *node).", __func__);
-            return EXIT_FAILURE;
+        /* no match */
+        if (!snode || (!schema_id[0] && snode->nodetype != LYS_LEAF)) {
+            LOGINT(module->ctx);
+            return -1;
         }
-    }
 
-    if (options & LYD_OPT_VAL_DIFF) {
-        va_start(ap, var_arg);
-        diff = va_arg(ap, struct lyd_difflist **);
-        va_end(ap);
-        if (!diff) {
-            LOGERR(ctx, LY_EINVAL, "%s: invalid variable parameter (struct lyd_difflist **).", __func__);
-            return EXIT_FAILURE;
+        if (!(snode->nodetype & (LYS_CHOICE | LYS_CASE))) {
+            len += sprintf(&buf[len], "%s%s", (len ? "/" : ""), snode->name);
         }
     }
 
-    if (*node) {
-        if (!ctx) {
-            ctx = (*node)->schema->module->ctx;
-        }
-        if (!(options & LYD_OPT_NOSIBLINGS)) {
-            /* check that the node is the first sibling */
-            while ((*node)->prev->next) {
-                *node = (*node)->prev;
+    return len;
+}
+
+/* skip the "module:#name" yang-data extension prefix, NULL if the path belongs to another module */
+static const char *
+lyd_path_skip_ext(const struct lys_module *module, const char *path)
+{
+    const char *mod_name, *name;
+    int mod_name_len, name_len, is_relative = -1;
+
+    if (parse_schema_nodeid(path, &mod_name, &mod_name_len, &name, &name_len, &is_relative, NULL, NULL, 1) > 0) {
+        if (name[0] == '#' && !is_relative) {
+            if (strncmp(mod_name, module->name, mod_name_len) || module->name[mod_name_len]) {
+                return NULL;
             }
+            path = name + name_len;
         }
     }
 
-    return _lyd_validate(node, data_tree, ctx, NULL, 0, diff, options);
+    return path;
 }
 
-API int
-lyd_validate_modules(struct lyd_node **node, const struct lys_module **modules, int mod_count, int options, ...)
+static struct ly_set *
+lyd_find_expr(const struct lyd_node *ctx_node, const struct lyxp_expr *exp)
 {
-    struct ly_ctx *ctx;
-    struct lyd_difflist **diff = NULL;
-    va_list ap;
+    struct lyxp_set xp_set;
+    struct ly_set *set;
+    uint32_t i;
 
-    if (!node || !modules || !mod_count) {
-        LOGARG;
-        return EXIT_FAILURE;
+    memset(&xp_set, 0, sizeof xp_set);
+
+    if (lyxp_eval_expr(exp, ctx_node, LYXP_NODE_ELEM, lyd_node_module(ctx_node), &xp_set, 0) != EXIT_SUCCESS) {
+        return NULL;
     }
 
-    ctx = modules[0]->ctx;
+    set = ly_set_new();
+    LY_CHECK_ERR_RETURN(!set, LOGMEM(ctx_node->schema->module->ctx), NULL);
 
-    if (*node && !(options & LYD_OPT_NOSIBLINGS)) {
-        /* check that the node is the first sibling */
-        while ((*node)->prev->next) {
-            *node = (*node)->prev;
+    if (xp_set.type == LYXP_SET_NODE_SET) {
+        for (i = 0; i < xp_set.used; ++i) {
+            if (xp_set.val.nodes[i].type == LYXP_NODE_ELEM) {
+                if (ly_set_add(set, xp_set.val.nodes[i].node, LY_SET_OPT_USEASLIST) < 0) {
+                    ly_set_free(set);
+                    set = NULL;
+                    break;
+                }
+            }
         }
     }
+    /* free xp_set content */
+    lyxp_set_cast(&xp_set, LYXP_SET_EMPTY, ctx_node, NULL, 0);
+
+    return set;
+}
+
+API struct ly_set *
+lyd_find_path(const struct lyd_node *ctx_node, const char *path)
+{
+    struct ly_set *set;
+    struct lyxp_expr *exp;
+    char *yang_xpath;
+
+    if (!ctx_node || !path) {
+        LOGARG;
+        return NULL;
+    }
 
-    if (lyp_data_check_options(ctx, options, __func__)) {
-        return EXIT_FAILURE;
+    path = lyd_path_skip_ext(lyd_node_module(ctx_node), path);
+    if (!path) {
+        return NULL;
     }
 
-    if ((options & LYD_OPT_TYPEMASK) && !(options & (LYD_OPT_CONFIG | LYD_OPT_GET | LYD_OPT_GETCONFIG | LYD_OPT_EDIT))) {
-        LOGERR(NULL, LY_EINVAL, "%s: options include a forbidden data type.", __func__);
-        return EXIT_FAILURE;
+    /* transform JSON into YANG XPATH */
+    yang_xpath = transform_json2xpath(lyd_node_module(ctx_node), path);
+    if (!yang_xpath) {
+        return NULL;
     }
 
-    if (options & LYD_OPT_VAL_DIFF) {
-        va_start(ap, options);
-        diff = va_arg(ap, struct lyd_difflist **);
-        va_end(ap);
-        if (!diff) {
-            LOGERR(ctx, LY_EINVAL, "%s: invalid variable parameter (struct lyd_difflist **).", __func__);
-            return EXIT_FAILURE;
-        }
+    exp = lyxp_compile_expr(ctx_node->schema->module->ctx, yang_xpath);
+    free(yang_xpath);
+    if (!exp) {
+        return NULL;
     }
 
-    return _lyd_validate(node, *node, ctx, modules, mod_count, diff, options);
+    set = lyd_find_expr(ctx_node, exp);
+    lyxp_expr_free(exp);
+    return set;
 }
 
-API int
-lyd_validate_value(struct lys_node *node, const char *value)
+struct lyd_path_query {
+    const struct lys_module *module; /* module of the context nodes, unprefixed names belong to it */
+    struct lyxp_expr *exp;
+};
+
+API struct lyd_path_query *
+lyd_path_compile(const struct lys_module *module, const char *path)
 {
-    struct lyd_node_leaf_list leaf;
-    struct lys_node_leaf *sleaf = (struct lys_node_leaf*)node;
-    int ret = EXIT_SUCCESS;
+    struct lyd_path_query *query;
+    char *yang_xpath;
 
-    if (!node || !(node->nodetype & (LYS_LEAF | LYS_LEAFLIST))) {
+    if (!module || !path) {
         LOGARG;
-        return EXIT_FAILURE;
+        return NULL;
     }
 
-    if (!value) {
-        value = "";
+    path = lyd_path_skip_ext(module, path);
+    if (!path) {
+        LOGERR(module->ctx, LY_EINVAL, "Path does not belong to the module \"%s\".", module->name);
+        return NULL;
     }
 
-    /* dummy leaf */
-    memset(&leaf, 0, sizeof leaf);
-    leaf.value_str = lydict_insert(node->module->ctx, value, 0);
+    query = calloc(1, sizeof *query);
+    LY_CHECK_ERR_RETURN(!query, LOGMEM(module->ctx), NULL);
+    query->module = module;
 
-repeat:
-    leaf.value_type = sleaf->type.base;
-    leaf.schema = node;
+    /* transform JSON into YANG XPATH, the modules of all the prefixes are checked */
+    yang_xpath = transform_json2xpath(module, path);
+    if (!yang_xpath) {
+        free(query);
+        return NULL;
+    }
 
-    if (leaf.value_type == LY_TYPE_LEAFREF) {
-        if (!sleaf->type.info.lref.target) {
-            /* it should either be unresolved leafref (leaf.value_type are ORed flags) or it will be resolved */
-            LOGINT(node->module->ctx);
-            ret = EXIT_FAILURE;
-            goto cleanup;
-        }
-        sleaf = sleaf->type.info.lref.target;
-        goto repeat;
-    } else {
-        if (!lyp_parse_value(&sleaf->type, &leaf.value_str, NULL, &leaf, NULL, NULL, 0, 0, 0)) {
-            ret = EXIT_FAILURE;
-            goto cleanup;
-        }
+    /* parse it and resolve the name tests, only once */
+    query->exp = lyxp_compile_expr(module->ctx, yang_xpath);
+    free(yang_xpath);
+    if (!query->exp) {
+        free(query);
+        return NULL;
     }
 
-cleanup:
-    lydict_remove(node->module->ctx, leaf.value_str);
-    return ret;
+    return query;
 }
 
-/* create an attribute copy */
-static struct lyd_attr *
-lyd_dup_attr(struct ly_ctx *ctx, struct lyd_node *parent, struct lyd_attr *attr)
+API struct ly_set *
+lyd_find_compiled(const struct lyd_node *ctx_node, const struct lyd_path_query *query)
 {
-    struct lyd_attr *ret;
-
-    /* allocate new attr */
-    if (!parent->attr) {
-        parent->attr = malloc(sizeof *parent->attr);
-        ret = parent->attr;
-    } else {
-        for (ret = parent->attr; ret->next; ret = ret->next);
-        ret->next = calloc(1, sizeof *ret);
-        ret = ret->next;
+    if (!ctx_node || !query) {
+        LOGARG;
+        return NULL;
     }
-    LY_CHECK_ERR_RETURN(!ret, LOGMEM(ctx), NULL);
 
-    /* fill new attr except */
-    ret->parent = parent;
-    ret->next = NULL;
-    ret->annotation = attr->annotation;
-    ret->name = lydict_insert(ctx, attr->name, 0);
-    ret->value_str = lydict_insert(ctx, attr->value_str, 0);
-    ret->value_type = attr->value_type;
-    ret->value_flags = attr->value_flags;
-    switch (ret->value_type) {
-    case LY_TYPE_BINARY:
-    case LY_TYPE_STRING:
-        /* value_str pointer is shared in these cases */
-        ret->value.string = ret->value_str;
-        break;
-    case LY_TYPE_LEAFREF:
-        lyp_parse_value(*((struct lys_type **)lys_ext_complex_get_substmt(LY_STMT_TYPE, ret->annotation, NULL)),
-                             &ret->value_str, NULL, NULL, ret, NULL, 1, 0, 0);
-        break;
-    case LY_TYPE_INST:
-        ret->value.instance = NULL;
-        break;
-    case LY_TYPE_UNION:
-        /* unresolved union (this must be non-validated tree), duplicate the stored string (duplicated
-         * because of possible change of the value in case of instance-identifier) */
-        ret->value.string = lydict_insert(ctx, attr->value.string, 0);
-        break;
-    case LY_TYPE_ENUM:
-    case LY_TYPE_IDENT:
-    case LY_TYPE_BITS:
-        /* in case of duplicating bits (no matter if in the same context or not) or enum and identityref into
-         * a different context, searching for the type and duplicating the data is almost as same as resolving
-         * the string value, so due to a simplicity, parse the value for the duplicated leaf */
-        lyp_parse_value(*((struct lys_type **)lys_ext_complex_get_substmt(LY_STMT_TYPE, ret->annotation, NULL)),
-                             &ret->value_str, NULL, NULL, ret, NULL, 1, 0, 0);
-        break;
-    default:
-        ret->value = attr->value;
-        break;
+    if (lyd_node_module(ctx_node) != query->module) {
+        LOGERR(query->module->ctx, LY_EINVAL, "Path compiled for the module \"%s\" used from a node of the module \"%s\".",
+               query->module->name, lyd_node_module(ctx_node)->name);
+        return NULL;
     }
-    return ret;
+
+    return lyd_find_expr(ctx_node, query->exp);
 }
 
-int
-lyd_unlink_internal(struct lyd_node *node, int permanent)
+API void
+lyd_path_query_free(struct lyd_path_query *query)
 {
-    struct lyd_node *iter;
-
-    if (!node) {
-        LOGARG;
-        return EXIT_FAILURE;
+    if (!query) {
+        return;
     }
 
-    if (permanent) {
-        check_leaf_list_backlinks(node, 1);
-    }
+    lyxp_expr_free(query->exp);
+    free(query);
+}
 
-    /* unlink from siblings */
-    if (node->prev->next) {
-        node->prev->next = node->next;
-    }
-    if (node->next) {
-        node->next->prev = node->prev;
-    } else {
-        /* unlinking the last node */
-        if (node->parent) {
-            iter = node->parent->child;
-        } else {
-            iter = node->prev;
-            while (iter->prev != node) {
-                iter = iter->prev;
-            }
-        }
-        /* update the "last" pointer from the first node */
-        iter->prev = node->prev;
-    }
+struct lyd_find_step {
+    const struct lys_module *mod;   /* module of the matching nodes, NULL for any */
+    const char *name;               /* dictionary name of the matching nodes, "*" for any */
+    struct lyxp_expr **preds;       /* predicates, each compiled separately */
+    uint32_t *pos;                  /* proximity position of the last node checked by each predicate */
+    uint16_t pred_count;
+    struct lyd_node *next;          /* next node to check on this level */
+};
 
-    /* unlink from parent */
-    if (node->parent) {
-        if (node->parent->child == node) {
-            /* the node is the first child */
-            node->parent->child = node->next;
-        }
+struct lyd_find_iter {
+    const struct lyd_node *ctx_node;
+    struct lyxp_expr *exp;          /* whole path, holds the names of the steps */
+    struct lyd_find_step *steps;    /* steps of a plain location path, NULL if it cannot be streamed */
+    uint16_t step_count;
+    uint16_t level;                 /* step being currently matched */
+    int started;
+    struct ly_set *set;             /* whole result of the paths that cannot be streamed */
+    uint32_t set_idx;
+};
 
-#ifdef LY_ENABLED_CACHE
-        /* do not remove from parent hash table if freeing the whole subtree */
-        if (permanent != 2) {
-            lyd_unlink_hash(node, node->parent);
-        }
-#endif
+static void
+lyd_find_iter_clear_steps(struct lyd_find_iter *iter)
+{
+    uint16_t i, j;
 
-        node->parent = NULL;
+    for (i = 0; i < iter->step_count; ++i) {
+        for (j = 0; j < iter->steps[i].pred_count; ++j) {
+            lyxp_expr_free(iter->steps[i].preds[j]);
+        }
+        free(iter->steps[i].preds);
+        free(iter->steps[i].pos);
     }
-
-    node->next = NULL;
-    node->prev = node;
-
-    return EXIT_SUCCESS;
-}
-
-API int
-lyd_unlink(struct lyd_node *node)
-{
-    return lyd_unlink_internal(node, 1);
+    free(iter->steps);
+    iter->steps = NULL;
+    iter->step_count = 0;
 }
 
-/*
- * - in leaflist it must be added with value_str
- */
+/* compile a predicate of the last step, the tokens between [start, end) */
 static int
-_lyd_dup_node_common(struct lyd_node *new_node, const struct lyd_node *orig, struct ly_ctx *ctx, int options)
+lyd_find_iter_add_pred(struct lyd_find_iter *iter, struct ly_ctx *ctx, uint16_t start, uint16_t end)
 {
-    struct lyd_attr *attr;
+    struct lyd_find_step *step = &iter->steps[iter->step_count - 1];
+    const struct lyxp_expr *exp = iter->exp;
+    struct lyxp_expr *pred;
+    void *r;
+    char *str;
 
-    new_node->attr = NULL;
-    if (!(options & LYD_DUP_OPT_NO_ATTR)) {
-        LY_TREE_FOR(orig->attr, attr) {
-            lyd_dup_attr(ctx, new_node, attr);
-        }
-    }
-    new_node->next = NULL;
-    new_node->prev = new_node;
-    new_node->parent = NULL;
-    new_node->validity = ly_new_node_validity(new_node->schema);
-    new_node->dflt = orig->dflt;
-    new_node->when_status = orig->when_status & LYD_WHEN;
-#ifdef LY_ENABLED_CACHE
-    /* just copy the hash, it will not change */
-    if ((new_node->schema->nodetype != LYS_LIST) || lyd_list_has_keys(new_node)) {
-        new_node->hash = orig->hash;
+    str = strndup(&exp->expr[exp->expr_pos[start]], exp->expr_pos[end] - exp->expr_pos[start]);
+    LY_CHECK_ERR_RETURN(!str, LOGMEM(ctx), -1);
+    pred = lyxp_compile_expr(ctx, str);
+    free(str);
+    if (!pred) {
+        return -1;
     }
-#endif
 
-#ifdef LY_ENABLED_LYD_PRIV
-    if (ctx->priv_dup_clb) {
-        new_node->priv = ctx->priv_dup_clb(orig->priv);
-    }
-#endif
+    r = realloc(step->preds, (step->pred_count + 1) * sizeof *step->preds);
+    LY_CHECK_ERR_RETURN(!r, LOGMEM(ctx); lyxp_expr_free(pred), -1);
+    step->preds = r;
+    r = realloc(step->pos, (step->pred_count + 1) * sizeof *step->pos);
+    LY_CHECK_ERR_RETURN(!r, LOGMEM(ctx); lyxp_expr_free(pred), -1);
+    step->pos = r;
 
-    return EXIT_SUCCESS;
+    step->preds[step->pred_count] = pred;
+    step->pos[step->pred_count] = 0;
+    ++step->pred_count;
+    return 0;
 }
 
-static struct lyd_node *
-_lyd_dup_node(const struct lyd_node *node, const struct lys_node *schema, struct ly_ctx *ctx, int options)
+/*
+ * Split a plain location path (child steps with name tests and predicates) into its steps.
+ * Returns 0 on success, 1 if the path is not plain, -1 on error.
+ */
+static int
+lyd_find_iter_plan(struct lyd_find_iter *iter, const struct lys_module *module)
 {
-    struct lyd_node *new_node = NULL;
-    struct lys_node_leaf *sleaf;
-    struct lyd_node_leaf_list *new_leaf;
-    struct lyd_node_anydata *new_any, *old_any;
-    int r;
-
-    /* fill specific part */
-    switch (node->schema->nodetype) {
-    case LYS_LEAF:
-    case LYS_LEAFLIST:
-        new_leaf = calloc(1, sizeof *new_leaf);
-        new_node = (struct lyd_node *)new_leaf;
-        LY_CHECK_ERR_GOTO(!new_node, LOGMEM(ctx), error);
-        new_node->schema = (struct lys_node *)schema;
+    const struct lyxp_expr *exp = iter->exp;
+    struct lyd_find_step *step;
+    uint16_t i = 0, start, depth;
+    const char *name;
+    void *r;
+
+    if (exp->tokens[0] == LYXP_TOKEN_OPERATOR_PATH) {
+        if (exp->tok_len[0] != 1) {
+            return 1;
+        }
+        ++i;
+    }
 
-        new_leaf->value_str = lydict_insert(ctx, ((struct lyd_node_leaf_list *)node)->value_str, 0);
-        new_leaf->value_type = ((struct lyd_node_leaf_list *)node)->value_type;
-        new_leaf->value_flags = ((struct lyd_node_leaf_list *)node)->value_flags;
-        if (_lyd_dup_node_common(new_node, node, ctx, options)) {
-            goto error;
+    while (1) {
+        if ((i == exp->used) || (exp->tokens[i] != LYXP_TOKEN_NAMETEST) || !exp->tok_data[i].name) {
+            return 1;
         }
 
-        /* get schema from the correct context */
-        sleaf = (struct lys_node_leaf *)new_leaf->schema;
+        r = realloc(iter->steps, (iter->step_count + 1) * sizeof *iter->steps);
+        LY_CHECK_ERR_RETURN(!r, LOGMEM(module->ctx), -1);
+        iter->steps = r;
+        step = &iter->steps[iter->step_count];
+        memset(step, 0, sizeof *step);
+        ++iter->step_count;
 
-        switch (new_leaf->value_type) {
-        case LY_TYPE_BINARY:
-        case LY_TYPE_STRING:
-            /* value_str pointer is shared in these cases */
-            new_leaf->value.string = new_leaf->value_str;
-            break;
-        case LY_TYPE_LEAFREF:
-            new_leaf->validity |= LYD_VAL_LEAFREF;
-            lyp_parse_value(&sleaf->type, &new_leaf->value_str, NULL, new_leaf, NULL, NULL, 1, node->dflt, 0);
-            break;
-        case LY_TYPE_INST:
-            new_leaf->value.instance = NULL;
-            break;
-        case LY_TYPE_UNION:
-            /* unresolved union (this must be non-validated tree), duplicate the stored string (duplicated
-             * because of possible change of the value in case of instance-identifier) */
-            new_leaf->value.string = lydict_insert(ctx, ((struct lyd_node_leaf_list *)node)->value.string, 0);
-            break;
-        case LY_TYPE_ENUM:
-        case LY_TYPE_IDENT:
-        case LY_TYPE_BITS:
-            /* in case of duplicating bits (no matter if in the same context or not) or enum and identityref into
-             * a different context, searching for the type and duplicating the data is almost as same as resolving
-             * the string value, so due to a simplicity, parse the value for the duplicated leaf */
-            if (!lyp_parse_value(&sleaf->type, &new_leaf->value_str, NULL, new_leaf, NULL, NULL, 1, node->dflt, 0)) {
-                goto error;
-            }
-            break;
-        default:
-            new_leaf->value = ((struct lyd_node_leaf_list *)node)->value;
-            break;
+        step->name = exp->tok_data[i].name;
+        step->mod = exp->tok_data[i].mod;
+        if (!step->mod && strcmp(step->name, "*")) {
+            step->mod = module;
         }
+        ++i;
 
-        if (sleaf->type.der && sleaf->type.der->module) {
-            r = lytype_store(sleaf->type.der->module, sleaf->type.der->name, new_leaf->value_str, &new_leaf->value);
-            if (r == -1) {
-                goto error;
-            } else if (!r) {
-                new_leaf->value_flags |= LY_VALUE_USER;
+        while ((i < exp->used) && (exp->tokens[i] == LYXP_TOKEN_BRACK1)) {
+            /* the predicates are evaluated with the nodes as their context nodes, so unprefixed names
+             * in them would belong to their modules instead of the module of the path */
+            if (step->mod != module) {
+                return 1;
             }
-        }
-        break;
-    case LYS_ANYXML:
-    case LYS_ANYDATA:
-        old_any = (struct lyd_node_anydata *)node;
-        new_any = calloc(1, sizeof *new_any);
-        new_node = (struct lyd_node *)new_any;
-        LY_CHECK_ERR_GOTO(!new_node, LOGMEM(ctx), error);
-        new_node->schema = (struct lys_node *)schema;
 
-        if (_lyd_dup_node_common(new_node, node, ctx, options)) {
-            goto error;
+            start = ++i;
+            for (depth = 1; depth; ++i) {
+                if (exp->tokens[i] == LYXP_TOKEN_BRACK1) {
+                    ++depth;
+                } else if (exp->tokens[i] == LYXP_TOKEN_BRACK2) {
+                    --depth;
+                } else if (exp->tokens[i] == LYXP_TOKEN_FUNCNAME) {
+                    /* these depend on the whole node set or the original context node */
+                    name = &exp->expr[exp->expr_pos[i]];
+                    if (((exp->tok_len[i] == 8) && !strncmp(name, "position", 8))
+                            || ((exp->tok_len[i] == 4) && !strncmp(name, "last", 4))
+                            || ((exp->tok_len[i] == 7) && !strncmp(name, "current", 7))) {
+                        return 1;
+                    }
+                }
+            }
+
+            if (lyd_find_iter_add_pred(iter, module->ctx, start, i - 1)) {
+                return -1;
+            }
         }
 
-        new_any->value_type = old_any->value_type;
-        if (!(void*)old_any->value.tree) {
-            /* no value to duplicate */
-            break;
+        if (i == exp->used) {
+            return 0;
         }
-        /* duplicate the value */
-        switch (old_any->value_type) {
-        case LYD_ANYDATA_CONSTSTRING:
-        case LYD_ANYDATA_SXML:
-        case LYD_ANYDATA_JSON:
-            new_any->value.str = lydict_insert(ctx, old_any->value.str, 0);
-            break;
-        case LYD_ANYDATA_DATATREE:
-            new_any->value.tree = lyd_dup_to_ctx(old_any->value.tree, 1, ctx);
-            break;
-        case LYD_ANYDATA_XML:
-            new_any->value.xml = lyxml_dup_elem(ctx, old_any->value.xml, NULL, 1);
-            break;
-        case LYD_ANYDATA_LYB:
-            r = lyd_lyb_data_length(old_any->value.mem);
-            if (r == -1) {
-                LOGERR(ctx, LY_EINVAL, "Invalid LYB data.");
-                goto error;
-            }
-            new_any->value.mem = malloc(r);
-            LY_CHECK_ERR_GOTO(!new_any->value.mem, LOGMEM(ctx), error);
-            memcpy(new_any->value.mem, old_any->value.mem, r);
-            break;
-        case LYD_ANYDATA_STRING:
-        case LYD_ANYDATA_SXMLD:
-        case LYD_ANYDATA_JSOND:
-        case LYD_ANYDATA_LYBD:
-            /* dynamic strings are used only as input parameters */
-            assert(0);
-            break;
+        if ((exp->tokens[i] != LYXP_TOKEN_OPERATOR_PATH) || (exp->tok_len[i] != 1)) {
+            return 1;
         }
-        break;
-    case LYS_CONTAINER:
-    case LYS_LIST:
-    case LYS_NOTIF:
-    case LYS_RPC:
-    case LYS_ACTION:
-        new_node = calloc(1, sizeof *new_node);
-        LY_CHECK_ERR_GOTO(!new_node, LOGMEM(ctx), error);
-        new_node->schema = (struct lys_node *)schema;
+        ++i;
+    }
+}
 
-        if (_lyd_dup_node_common(new_node, node, ctx, options)) {
+API struct lyd_find_iter *
+lyd_find_iter_new(const struct lyd_node *ctx_node, const char *path)
+{
+    struct lyd_find_iter *iter;
+    char *yang_xpath;
+    int ret;
+
+    if (!ctx_node || !path) {
+        LOGARG;
+        return NULL;
+    }
+
+    path = lyd_path_skip_ext(lyd_node_module(ctx_node), path);
+    if (!path) {
+        return NULL;
+    }
+
+    iter = calloc(1, sizeof *iter);
+    LY_CHECK_ERR_RETURN(!iter, LOGMEM(ctx_node->schema->module->ctx), NULL);
+    iter->ctx_node = ctx_node;
+
+    /* transform JSON into YANG XPATH */
+    yang_xpath = transform_json2xpath(lyd_node_module(ctx_node), path);
+    if (!yang_xpath) {
+        goto error;
+    }
+
+    iter->exp = lyxp_compile_expr(ctx_node->schema->module->ctx, yang_xpath);
+    free(yang_xpath);
+    if (!iter->exp) {
+        goto error;
+    }
+
+    ret = lyd_find_iter_plan(iter, lyd_node_module(ctx_node));
+    if (ret == -1) {
+        goto error;
+    } else if (ret) {
+        /* generic XPath, evaluate it all at once */
+        lyd_find_iter_clear_steps(iter);
+        iter->set = lyd_find_expr(ctx_node, iter->exp);
+        if (!iter->set) {
             goto error;
         }
-        break;
-    default:
-        LOGINT(ctx);
-        goto error;
     }
 
-    return new_node;
+    return iter;
 
 error:
-    lyd_free(new_node);
+    lyd_find_iter_free(iter);
     return NULL;
 }
 
-API struct lyd_node *
-lyd_dup_to_ctx(const struct lyd_node *node, int options, struct ly_ctx *ctx)
+/* returns 1 if the node matches the step, 0 if not, -1 on error */
+static int
+lyd_find_iter_match(struct lyd_find_iter *iter, struct lyd_find_step *step, struct lyd_node *node)
 {
-    struct ly_ctx *log_ctx;
-    struct lys_node_list *slist;
-    struct lys_node *schema;
-    const char *yang_data_name;
-    const struct lys_module *trg_mod;
-    const struct lyd_node *next, *elem;
-    struct lyd_node *ret, *parent, *key, *key_dup, *new_node = NULL;
+    struct lyxp_set set;
     uint16_t i;
+    int match;
 
-    if (!node) {
-        LOGARG;
+    if ((step->mod && (lyd_node_module(node) != step->mod))
+            || (strcmp(step->name, "*") && !ly_strequal(node->schema->name, step->name, 1))) {
+        return 0;
+    }
+
+    for (i = 0; i < step->pred_count; ++i) {
+        memset(&set, 0, sizeof set);
+        if (lyxp_eval_expr(step->preds[i], node, LYXP_NODE_ELEM, lyd_node_module(iter->ctx_node), &set, 0)) {
+            return -1;
+        }
+
+        /* a number is the required proximity position */
+        ++step->pos[i];
+        if (set.type == LYXP_SET_NUMBER) {
+            match = (lyxp_set_num(&set) == step->pos[i]);
+        } else {
+            lyxp_set_cast(&set, LYXP_SET_BOOLEAN, node, NULL, 0);
+            match = set.val.bool;
+        }
+        lyxp_set_cast(&set, LYXP_SET_EMPTY, node, NULL, 0);
+
+        if (!match) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+static struct lyd_node *
+lyd_find_iter_children(const struct lyd_node *node)
+{
+    if (node->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST | LYS_ANYDATA)) {
         return NULL;
     }
+    lyd_wd_materialize((struct lyd_node *)node, NULL);
+    return node->child;
+}
 
-    log_ctx = (ctx ? ctx : node->schema->module->ctx);
-    if (ctx == node->schema->module->ctx) {
-        /* target context is actually the same as the source context,
-         * ignore the target context */
-        ctx = NULL;
+static void
+lyd_find_iter_enter(struct lyd_find_iter *iter, struct lyd_node *first)
+{
+    struct lyd_find_step *step = &iter->steps[iter->level];
+
+    step->next = first;
+    if (step->pred_count) {
+        memset(step->pos, 0, step->pred_count * sizeof *step->pos);
     }
+}
 
-    ret = NULL;
-    parent = NULL;
+API struct lyd_node *
+lyd_find_iter_next(struct lyd_find_iter *iter)
+{
+    struct lyd_find_step *step;
+    struct lyd_node *node;
+    const struct lyd_node *root;
+    int ret;
 
-    /* LY_TREE_DFS */
-    for (elem = next = node; elem; elem = next) {
+    if (!iter) {
+        LOGARG;
+        return NULL;
+    }
 
-        /* find the correct schema */
-        if (ctx) {
-            schema = NULL;
-            if (parent) {
-                trg_mod = lyp_get_module(parent->schema->module, NULL, 0, lyd_node_module(elem)->name,
-                                         strlen(lyd_node_module(elem)->name), 1);
-                if (!trg_mod) {
-                    LOGERR(log_ctx, LY_EINVAL, "Target context does not contain model for the data node being duplicated (%s).",
-                                lyd_node_module(elem)->name);
-                    goto error;
-                }
-                /* we know its parent, so we can start with it */
-                lys_getnext_data(trg_mod, parent->schema, elem->schema->name, strlen(elem->schema->name),
-                                 elem->schema->nodetype, (const struct lys_node **)&schema);
-            } else {
-                /* we have to search in complete context */
-                schema = lyd_get_schema_inctx(elem, ctx);
-            }
+    if (iter->set) {
+        if (iter->set_idx == iter->set->number) {
+            return NULL;
+        }
+        return iter->set->set.d[iter->set_idx++];
+    }
 
-            if (!schema) {
-                yang_data_name = lyp_get_yang_data_template_name(elem);
-                if (yang_data_name) {
-                    LOGERR(log_ctx, LY_EINVAL, "Target context does not contain schema node for the data node being duplicated "
-                                        "(%s:#%s/%s).", lyd_node_module(elem)->name, yang_data_name, elem->schema->name);
-                } else {
-                    LOGERR(log_ctx, LY_EINVAL, "Target context does not contain schema node for the data node being duplicated "
-                                        "(%s:%s).", lyd_node_module(elem)->name, elem->schema->name);
-                }
-                goto error;
-            }
+    if (!iter->started) {
+        iter->started = 1;
+        iter->level = 0;
+        if (iter->exp->tokens[0] == LYXP_TOKEN_OPERATOR_PATH) {
+            /* absolute path, start from all the top-level nodes */
+            for (root = iter->ctx_node; root->parent; root = root->parent);
+            for (; root->prev->next; root = root->prev);
+            lyd_find_iter_enter(iter, (struct lyd_node *)root);
         } else {
-            schema = elem->schema;
+            lyd_find_iter_enter(iter, lyd_find_iter_children(iter->ctx_node));
         }
+    }
 
-        /* make node copy */
-        new_node = _lyd_dup_node(elem, schema, log_ctx, options);
-        if (!new_node) {
-            goto error;
+    /* depth-first search matching the steps, so the nodes are found in the document order */
+    while (1) {
+        step = &iter->steps[iter->level];
+        node = step->next;
+        if (!node) {
+            if (!iter->level) {
+                /* finished */
+                return NULL;
+            }
+            --iter->level;
+            iter->steps[iter->level].next = iter->steps[iter->level].next->next;
+            continue;
         }
 
-        if (parent && lyd_insert(parent, new_node)) {
-            goto error;
+        ret = lyd_find_iter_match(iter, step, node);
+        if (ret == -1) {
+            return NULL;
+        } else if (!ret) {
+            step->next = node->next;
+        } else if (iter->level == iter->step_count - 1) {
+            step->next = node->next;
+            return node;
+        } else {
+            ++iter->level;
+            lyd_find_iter_enter(iter, lyd_find_iter_children(node));
         }
+    }
+}
 
-        if (!ret) {
-            ret = new_node;
-        }
+API void
+lyd_find_iter_free(struct lyd_find_iter *iter)
+{
+    if (!iter) {
+        return;
+    }
+
+    lyd_find_iter_clear_steps(iter);
+    lyxp_expr_free(iter->exp);
+    ly_set_free(iter->set);
+    free(iter);
+}
+
+API struct ly_set *
+lyd_find_instance(const struct lyd_node *data, const struct lys_node *schema)
+{
+    struct ly_set *ret, *ret_aux, *spath;
+    const struct lys_node *siter;
+    struct lyd_node *iter;
+    unsigned int i, j;
+#ifdef LY_ENABLED_CACHE
+    uint64_t bits = lyd_bloom_bits(schema->name, strlen(schema->name));
+#endif
+
+    if (!data || !schema ||
+            !(schema->nodetype & (LYS_CONTAINER | LYS_LEAF | LYS_LIST | LYS_LEAFLIST | LYS_ANYDATA | LYS_NOTIF | LYS_RPC | LYS_ACTION))) {
+        LOGARG;
+        return NULL;
+    }
+
+    ret = ly_set_new();
+    spath = ly_set_new();
+    if (!ret || !spath) {
+        LOGMEM(schema->module->ctx);
+        goto error;
+    }
+
+    /* find data root */
+    while (data->parent) {
+        /* vertical move (up) */
+        data = data->parent;
+    }
+    while (data->prev->next) {
+        /* horizontal move (left) */
+        data = data->prev;
+    }
+
+    /* build schema path */
+    for (siter = schema; siter; ) {
+        if (siter->nodetype == LYS_AUGMENT) {
+            siter = ((struct lys_node_augment *)siter)->target;
+            continue;
+        } else if (siter->nodetype & (LYS_CONTAINER | LYS_LEAF | LYS_LIST | LYS_LEAFLIST | LYS_ANYDATA | LYS_NOTIF | LYS_RPC | LYS_ACTION)) {
+            /* standard data node */
+            ly_set_add(spath, (void*)siter, LY_SET_OPT_USEASLIST);
+
+        } /* else skip the rest node types */
+        siter = siter->parent;
+    }
+    if (!spath->number) {
+        /* no valid path */
+        goto error;
+    }
 
-        if (!(options & LYD_DUP_OPT_RECURSIVE)) {
+    /* start searching */
+    LY_TREE_FOR((struct lyd_node *)data, iter) {
+        if (iter->schema == spath->set.s[spath->number - 1]) {
+            ly_set_add(ret, iter, LY_SET_OPT_USEASLIST);
+        }
+    }
+    for (i = spath->number - 1; i; i--) {
+        if (!ret->number) {
+            /* nothing found */
             break;
         }
 
-        /* LY_TREE_DFS_END */
-        /* select element for the next run - children first,
-         * child exception for lyd_node_leaf and lyd_node_leaflist */
-        if (elem->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST | LYS_ANYDATA)) {
-            next = NULL;
-        } else {
-            next = elem->child;
-        }
-        if (!next) {
-            if (elem->parent == node->parent) {
-                break;
-            }
-            /* no children, so try siblings */
-            next = elem->next;
-        } else {
-            parent = new_node;
+        ret_aux = ly_set_new();
+        if (!ret_aux) {
+            LOGMEM(schema->module->ctx);
+            goto error;
         }
-        new_node = NULL;
-
-        while (!next) {
-            /* no siblings, go back through parents */
-            elem = elem->parent;
-            if (elem->parent == node->parent) {
-                break;
-            }
-            if (!parent) {
-                LOGINT(log_ctx);
-                goto error;
+        for (j = 0; j < ret->number; j++) {
+#ifdef LY_ENABLED_CACHE
+            if (!lyd_bloom_contains(ret->set.d[j], bits)) {
+                /* no instance in this subtree */
+                continue;
             }
-            parent = parent->parent;
-            /* parent is already processed, go to its sibling */
-            next = elem->next;
-        }
-    }
-
-    /* dup all the parents */
-    if (options & LYD_DUP_OPT_WITH_PARENTS) {
-        parent = ret;
-        for (elem = node->parent; elem; elem = elem->parent) {
-            new_node = lyd_dup(elem, options & LYD_DUP_OPT_NO_ATTR);
-            LY_CHECK_ERR_GOTO(!new_node, LOGMEM(log_ctx), error);
-
-            /* dup all list keys */
-            if (new_node->schema->nodetype == LYS_LIST) {
-                slist = (struct lys_node_list *)new_node->schema;
-                for (key = elem->child, i = 0; key && (i < slist->keys_size); ++i, key = key->next) {
-                    if (key->schema != (struct lys_node *)slist->keys[i]) {
-                        LOGVAL(log_ctx, LYE_PATH_INKEY, LY_VLOG_LYD, new_node, slist->keys[i]->name);
-                        goto error;
-                    }
-
-                    key_dup = lyd_dup(key, options & LYD_DUP_OPT_NO_ATTR);
-                    LY_CHECK_ERR_GOTO(!key_dup, LOGMEM(log_ctx), error);
-
-                    if (lyd_insert(new_node, key_dup)) {
-                        lyd_free(key_dup);
-                        goto error;
-                    }
-                }
-                if (!key && (i < slist->keys_size)) {
-                    LOGVAL(log_ctx, LYE_PATH_INKEY, LY_VLOG_LYD, new_node, slist->keys[i]->name);
-                    goto error;
+#endif
+            LY_TREE_FOR(ret->set.d[j]->child, iter) {
+                if (iter->schema == spath->set.s[i - 1]) {
+                    ly_set_add(ret_aux, iter, LY_SET_OPT_USEASLIST);
                 }
             }
-
-            /* link together */
-            if (lyd_insert(new_node, parent)) {
-                ret = parent;
-                goto error;
-            }
-            parent = new_node;
         }
+        ly_set_free(ret);
+        ret = ret_aux;
     }
 
+    ly_set_free(spath);
     return ret;
 
 error:
-    lyd_free(ret);
+    ly_set_free(ret);
+    ly_set_free(spath);
+
     return NULL;
 }
 
 API struct lyd_node *
-lyd_dup(const struct lyd_node *node, int options)
+lyd_find_sibling_val(const struct lyd_node *siblings, const struct lys_node *schema, const char **values)
 {
-    return lyd_dup_to_ctx(node, options, NULL);
-}
+    struct lyd_node *first, *iter;
 
-static struct lyd_node *
-lyd_dup_withsiblings_r(const struct lyd_node *first, struct lyd_node *parent_dup, int options)
-{
-    struct lyd_node *first_dup = NULL, *prev_dup = NULL, *last_dup;
-    const struct lyd_node *next;
+    if (!siblings || !schema || !(schema->nodetype & (LYS_CONTAINER | LYS_LEAF | LYS_LEAFLIST | LYS_LIST | LYS_ANYDATA
+            | LYS_NOTIF | LYS_RPC | LYS_ACTION)) || (lys_node_module(schema)->ctx != lyd_node_module(siblings)->ctx)
+            || (!values && (schema->nodetype & (LYS_LIST | LYS_LEAFLIST))
+                && ((schema->nodetype == LYS_LEAFLIST) || ((struct lys_node_list *)schema)->keys_size))) {
+        LOGARG;
+        return NULL;
+    }
 
-    assert(first);
+    if (siblings->parent) {
+        first = siblings->parent->child;
+    } else {
+        for (first = (struct lyd_node *)siblings; first->prev->next; first = first->prev);
+    }
 
-    /* duplicate and connect all siblings */
-    LY_TREE_FOR(first, next) {
-        last_dup = _lyd_dup_node(next, next->schema, next->schema->module->ctx, options);
-        if (!last_dup) {
-            goto error;
+    if ((schema->nodetype == LYS_LIST) && !((struct lys_node_list *)schema)->keys_size) {
+        /* keyless list instances cannot be told apart, the first one */
+        LY_TREE_FOR(first, iter) {
+            if (iter->schema == schema) {
+                return iter;
+            }
         }
+        return NULL;
+    }
 
-        /* the whole data tree is exactly the same so we can safely copy the validation flags */
-        last_dup->validity = next->validity;
-        last_dup->when_status = next->when_status;
-
-        last_dup->parent = parent_dup;
-        if (!first_dup) {
-            first_dup = last_dup;
-        } else {
-            assert(prev_dup);
-            prev_dup->next = last_dup;
-            last_dup->prev = prev_dup;
-        }
+    return lyd_find_values(siblings->parent, first, schema, values);
+}
 
-        if ((next->schema->nodetype & (LYS_LIST | LYS_CONTAINER | LYS_RPC | LYS_ACTION | LYS_NOTIF)) && next->child) {
-            /* recursively duplicate all children */
-            if (!lyd_dup_withsiblings_r(next->child, last_dup, options)) {
-                goto error;
-            }
-        }
+API struct lyd_node *
+lyd_first_sibling(struct lyd_node *node)
+{
+    struct lyd_node *start;
 
-        prev_dup = last_dup;
+    if (!node) {
+        return NULL;
     }
 
-    /* correctly set last sibling and parent child pointer */
-    assert(!prev_dup->next);
-    first_dup->prev = prev_dup;
-    if (parent_dup) {
-        parent_dup->child = first_dup;
+    /* get the first sibling */
+    if (node->parent) {
+        start = node->parent->child;
+    } else {
+        for (start = node; start->prev->next; start = start->prev);
     }
 
-    return first_dup;
+    return start;
+}
 
-error:
-    /* disconnect and free */
-    first_dup->parent = NULL;
-    lyd_free_withsiblings(first_dup);
-    return NULL;
+#ifdef LY_ENABLED_CACHE
+
+/* record of the ly_set index */
+struct ly_set_ht_rec {
+    void *item;
+    unsigned int index;
+};
+
+static int
+ly_set_ht_val_equal(void *val1_p, void *val2_p, int UNUSED(mod), void *UNUSED(cb_data))
+{
+    return ((struct ly_set_ht_rec *)val1_p)->item == ((struct ly_set_ht_rec *)val2_p)->item;
 }
 
-API struct lyd_node *
-lyd_dup_withsiblings(const struct lyd_node *node, int options)
+static uint32_t
+ly_set_ht_hash(const void *item)
 {
-    const struct lyd_node *iter;
-    struct lyd_node *ret, *ret_iter, *tmp;
+    uint32_t hash;
 
-    if (!node) {
-        return NULL;
+    hash = dict_hash_multi(0, (const char *)&item, sizeof item);
+    return dict_hash_multi(hash, NULL, 0);
+}
+
+static void
+ly_set_ht_drop(struct ly_set *set)
+{
+    lyht_free(set->ht);
+    set->ht = NULL;
+}
+
+/**
+ * @brief Create the index of a set with enough items. Sets with duplicate items (see #LY_SET_OPT_USEASLIST)
+ * are not indexed.
+ *
+ * @param[in] set Set to index.
+ */
+static void
+ly_set_ht_build(struct ly_set *set)
+{
+    struct ly_set_ht_rec rec;
+    uint32_t size;
+
+    if (set->ht || (set->number < LY_CACHE_SET_HT_MIN_ITEMS)) {
+        return;
     }
 
-    /* find first sibling */
-    while (node->prev->next) {
-        node = node->prev;
+    for (size = LY_CACHE_SET_HT_MIN_ITEMS; size < set->number; size <<= 1);
+    set->ht = lyht_new(size << 1, sizeof rec, ly_set_ht_val_equal, NULL, 1);
+    if (!set->ht) {
+        /* the index only speeds up the lookups */
+        return;
     }
 
-    if (node->parent) {
-        ret = lyd_dup(node, options);
-        if (!ret) {
-            return NULL;
+    for (rec.index = 0; rec.index < set->number; ++rec.index) {
+        rec.item = set->set.g[rec.index];
+        if (lyht_insert(set->ht, &rec, ly_set_ht_hash(rec.item), NULL)) {
+            /* duplicate item or an error */
+            ly_set_ht_drop(set);
+            return;
         }
+    }
+}
 
-        /* copy following siblings */
-        ret_iter = ret;
-        LY_TREE_FOR(node->next, iter) {
-            tmp = lyd_dup(iter, options);
-            if (!tmp) {
-                lyd_free_withsiblings(ret);
-                return NULL;
-            }
+/**
+ * @brief Add an item into the index of a set.
+ *
+ * @param[in] set Set with the item already stored in the array.
+ * @param[in] index Index of the item.
+ */
+static void
+ly_set_ht_add(struct ly_set *set, unsigned int index)
+{
+    struct ly_set_ht_rec rec;
 
-            if (lyd_insert_after(ret_iter, tmp)) {
-                lyd_free_withsiblings(ret);
-                return NULL;
-            }
-            ret_iter = ret_iter->next;
-            assert(ret_iter == tmp);
-        }
-    } else {
-        /* duplicating top-level siblings, we can duplicate much more efficiently */
-        ret = lyd_dup_withsiblings_r(node, NULL, options);
+    if (!set->ht) {
+        return;
     }
 
-    return ret;
+    rec.item = set->set.g[index];
+    rec.index = index;
+    if (lyht_insert(set->ht, &rec, ly_set_ht_hash(rec.item), NULL)) {
+        /* duplicate item or an error */
+        ly_set_ht_drop(set);
+    }
 }
 
-API void
-lyd_free_attr(struct ly_ctx *ctx, struct lyd_node *parent, struct lyd_attr *attr, int recursive)
+/**
+ * @brief Find an item using the index of a set.
+ *
+ * @param[in] set Set to search in.
+ * @param[in] item Item to find.
+ * @param[out] index Index of the found item.
+ * @return 0 if found, 1 if not found, -1 if the set is not indexed.
+ */
+static int
+ly_set_ht_find(struct ly_set *set, void *item, unsigned int *index)
 {
-    struct lyd_attr *iter;
-    struct lys_type **type;
+    struct ly_set_ht_rec rec, *match;
 
-    if (!ctx || !attr) {
-        return;
+    ly_set_ht_build(set);
+    if (!set->ht) {
+        return -1;
     }
 
-    if (parent) {
-        if (parent->attr == attr) {
-            if (recursive) {
-                parent->attr = NULL;
-            } else {
-                parent->attr = attr->next;
-            }
-        } else {
-            for (iter = parent->attr; iter->next != attr; iter = iter->next);
-            if (iter->next) {
-                if (recursive) {
-                    iter->next = NULL;
-                } else {
-                    iter->next = attr->next;
-                }
-            }
-        }
+    rec.item = item;
+    if (lyht_find(set->ht, &rec, ly_set_ht_hash(item), (void **)&match)) {
+        return 1;
+    }
+    if ((match->index >= set->number) || (set->set.g[match->index] != item)) {
+        /* the array was modified directly, do not trust the index anymore */
+        ly_set_ht_drop(set);
+        return -1;
     }
 
-    if (!recursive) {
-        attr->next = NULL;
+    *index = match->index;
+    return 0;
+}
+
+/**
+ * @brief Update the index of a set before removing an item, the last item is moved to its place.
+ *
+ * @param[in] set Set with the item still stored in the array.
+ * @param[in] index Index of the removed item.
+ */
+static void
+ly_set_ht_rm(struct ly_set *set, unsigned int index)
+{
+    struct ly_set_ht_rec rec, *match;
+
+    if (!set->ht) {
+        return;
     }
 
-    for(iter = attr; iter; ) {
-        attr = iter;
-        iter = iter->next;
+    rec.item = set->set.g[index];
+    if (lyht_remove(set->ht, &rec, ly_set_ht_hash(rec.item))) {
+        ly_set_ht_drop(set);
+        return;
+    }
 
-        lydict_remove(ctx, attr->name);
-        type = lys_ext_complex_get_substmt(LY_STMT_TYPE, attr->annotation, NULL);
-        assert(type);
-        lyd_free_value(attr->value, attr->value_type, attr->value_flags, *type, NULL, NULL, NULL);
-        lydict_remove(ctx, attr->value_str);
-        free(attr);
+    if (index < set->number - 1) {
+        rec.item = set->set.g[set->number - 1];
+        if (lyht_find(set->ht, &rec, ly_set_ht_hash(rec.item), (void **)&match)) {
+            ly_set_ht_drop(set);
+            return;
+        }
+        match->index = index;
     }
 }
 
-const struct lyd_node *
-lyd_attr_parent(const struct lyd_node *root, struct lyd_attr *attr)
+#endif
+
+/**
+ * @brief Find an item in a set.
+ *
+ * @param[in] set Set to search in.
+ * @param[in] item Item to find.
+ * @return Index of the item, -1 if not found.
+ */
+static int
+ly_set_find(struct ly_set *set, void *item)
 {
-    const struct lyd_node *next, *elem;
-    struct lyd_attr *node_attr;
+    unsigned int i;
 
-    LY_TREE_DFS_BEGIN(root, next, elem) {
-        for (node_attr = elem->attr; node_attr; node_attr = node_attr->next) {
-            if (node_attr == attr) {
-                return elem;
-            }
+#ifdef LY_ENABLED_CACHE
+    switch (ly_set_ht_find(set, item, &i)) {
+    case 0:
+        return i;
+    case 1:
+        return -1;
+    default:
+        break;
+    }
+#endif
+
+    for (i = 0; i < set->number; i++) {
+        if (set->set.g[i] == item) {
+            /* object found */
+            return i;
         }
-        LY_TREE_DFS_END(root, next, elem)
     }
 
-    return NULL;
+    /* object not found */
+    return -1;
 }
 
-API struct lyd_attr *
-lyd_insert_attr(struct lyd_node *parent, const struct lys_module *mod, const char *name, const char *value)
+API struct ly_set *
+ly_set_new(void)
 {
-    struct lyd_attr *a, *iter;
-    struct ly_ctx *ctx;
-    const struct lys_module *module;
-    const char *p;
-    char *aux;
-    int pos, i;
+    struct ly_set *new;
 
-    if (!parent || !name || !value) {
-        LOGARG;
-        return NULL;
+    new = calloc(1, sizeof(struct ly_set));
+    LY_CHECK_ERR_RETURN(!new, LOGMEM(NULL), NULL);
+    return new;
+}
+
+API void
+ly_set_free(struct ly_set *set)
+{
+    if (!set) {
+        return;
     }
-    ctx = parent->schema->module->ctx;
 
-    if ((p = strchr(name, ':'))) {
-        /* search for the namespace */
-        aux = strndup(name, p - name);
-        if (!aux) {
-            LOGMEM(ctx);
-            return NULL;
-        }
-        module = ly_ctx_get_module(ctx, aux, NULL, 1);
-        free(aux);
-        name = p + 1;
+#ifdef LY_ENABLED_CACHE
+    lyht_free(set->ht);
+#endif
+    free(set->set.g);
+    free(set);
+}
 
-        if (!module) {
-            /* module not found */
-            LOGERR(ctx, LY_EINVAL, "Attribute prefix does not match any implemented schema in the context.");
-            return NULL;
-        }
-    } else if (mod) {
-        module = mod;
-    } else if (!mod && (!strcmp(name, "type") || !strcmp(name, "select")) && !strcmp(parent->schema->name, "filter")) {
-        /* special case of inserting unqualified filter attributes "type" and "select" */
-        module = ly_ctx_get_module(ctx, "ietf-netconf", NULL, 1);
-        if (!module) {
-            LOGERR(ctx, LY_EINVAL, "Attribute prefix does not match any implemented schema in the context.");
-            return NULL;
-        }
-    } else {
-        /* no prefix -> module is the same as for the parent */
-        module = lyd_node_module(parent);
+API int
+ly_set_contains(const struct ly_set *set, void *node)
+{
+    if (!set) {
+        return -1;
     }
 
-    pos = -1;
-    do {
-        if ((unsigned int)(pos + 1) < module->ext_size) {
-            i = lys_ext_instance_presence(&ctx->models.list[0]->extensions[0],
-                                          &module->ext[pos + 1], module->ext_size - (pos + 1));
-            pos = (i == -1) ? -1 : pos + 1 + i;
-        } else {
-            pos = -1;
-        }
-        if (pos == -1) {
-            LOGERR(ctx, LY_EINVAL, "Attribute does not match any annotation instance definition.");
-            return NULL;
-        }
-    } while (!ly_strequal(module->ext[pos]->arg_value, name, 0));
+    /* the index of the items may be created */
+    return ly_set_find((struct ly_set *)set, node);
+}
 
-    a = calloc(1, sizeof *a);
-    LY_CHECK_ERR_RETURN(!a, LOGMEM(ctx), NULL);
-    a->parent = parent;
-    a->next = NULL;
-    a->annotation = (struct lys_ext_instance_complex *)module->ext[pos];
-    a->name = lydict_insert(ctx, name, 0);
-    a->value_str = lydict_insert(ctx, value, 0);
-    if (!lyp_parse_value(*((struct lys_type **)lys_ext_complex_get_substmt(LY_STMT_TYPE, a->annotation, NULL)),
-                         &a->value_str, NULL, NULL, a, NULL, 1, 0, 0)) {
-        lyd_free_attr(ctx, NULL, a, 0);
+API struct ly_set *
+ly_set_dup(const struct ly_set *set)
+{
+    struct ly_set *new;
+
+    if (!set) {
         return NULL;
     }
 
-    if (!parent->attr) {
-        parent->attr = a;
-    } else {
-        for (iter = parent->attr; iter->next; iter = iter->next);
-        iter->next = a;
-    }
+    new = malloc(sizeof *new);
+    LY_CHECK_ERR_RETURN(!new, LOGMEM(NULL), NULL);
+    new->number = set->number;
+    new->size = set->size;
+    new->set.g = malloc(new->size * sizeof *(new->set.g));
+    LY_CHECK_ERR_RETURN(!new->set.g, LOGMEM(NULL); free(new), NULL);
+    memcpy(new->set.g, set->set.g, new->size * sizeof *(new->set.g));
+#ifdef LY_ENABLED_CACHE
+    new->ht = NULL;
+#endif
 
-    return a;
+    return new;
 }
 
-void
-lyd_free_value(lyd_val value, LY_DATA_TYPE value_type, uint8_t value_flags, struct lys_type *type, lyd_val *old_val,
-               LY_DATA_TYPE *old_val_type, uint8_t *old_val_flags)
+API int
+ly_set_add(struct ly_set *set, void *node, int options)
 {
-    if (old_val) {
-        *old_val = value;
-        *old_val_type = value_type;
-        *old_val_flags = value_flags;
-        /* we only backup the values for now */
-        return;
+    int i;
+    void **new;
+
+    if (!set || !node) {
+        LOGARG;
+        return -1;
     }
 
-    /* otherwise the value is correctly freed */
-    if (value_flags & LY_VALUE_USER) {
-        assert(type->der && type->der->module);
-        lytype_free(type->der->module, type->der->name, value);
-    } else {
-        switch (value_type) {
-        case LY_TYPE_BITS:
-            if (value.bit) {
-                free(value.bit);
-            }
-            break;
-        case LY_TYPE_INST:
-            if (!(value_flags & LY_VALUE_UNRES)) {
-                break;
-            }
-            /* fallthrough */
-        case LY_TYPE_UNION:
-            /* unresolved union leaf */
-            lydict_remove(type->parent->module->ctx, value.string);
-            break;
-        default:
-            break;
+    if (!(options & LY_SET_OPT_USEASLIST)) {
+        /* search for duplication */
+        i = ly_set_find(set, node);
+        if (i > -1) {
+            /* already in set */
+            return i;
         }
     }
+
+    if (set->size == set->number) {
+        new = realloc(set->set.g, (set->size + 8) * sizeof *(set->set.g));
+        LY_CHECK_ERR_RETURN(!new, LOGMEM(NULL), -1);
+        set->size += 8;
+        set->set.g = new;
+    }
+
+    set->set.g[set->number++] = node;
+#ifdef LY_ENABLED_CACHE
+    ly_set_ht_add(set, set->number - 1);
+#endif
+
+    return set->number - 1;
 }
 
-static void
-_lyd_free_node(struct lyd_node *node)
+API int
+ly_set_merge(struct ly_set *trg, struct ly_set *src, int options)
 {
-    struct lyd_node_leaf_list *leaf;
+    unsigned int i, ret;
+    void **new;
 
-    if (!node) {
-        return;
+    if (!trg) {
+        LOGARG;
+        return -1;
     }
 
-    switch (node->schema->nodetype) {
-    case LYS_CONTAINER:
-    case LYS_LIST:
-    case LYS_RPC:
-    case LYS_ACTION:
-    case LYS_NOTIF:
-#ifdef LY_ENABLED_CACHE
-        /* it should be empty because all the children are freed already (only if in debug mode) */
-        lyht_free(node->ht);
-#endif
-        break;
-    case LYS_ANYDATA:
-    case LYS_ANYXML:
-        switch (((struct lyd_node_anydata *)node)->value_type) {
-        case LYD_ANYDATA_CONSTSTRING:
-        case LYD_ANYDATA_SXML:
-        case LYD_ANYDATA_JSON:
-            lydict_remove(node->schema->module->ctx, ((struct lyd_node_anydata *)node)->value.str);
-            break;
-        case LYD_ANYDATA_DATATREE:
-            lyd_free_withsiblings(((struct lyd_node_anydata *)node)->value.tree);
-            break;
-        case LYD_ANYDATA_XML:
-            lyxml_free_withsiblings(node->schema->module->ctx, ((struct lyd_node_anydata *)node)->value.xml);
-            break;
-        case LYD_ANYDATA_LYB:
-            free(((struct lyd_node_anydata *)node)->value.mem);
-            break;
-        case LYD_ANYDATA_STRING:
-        case LYD_ANYDATA_SXMLD:
-        case LYD_ANYDATA_JSOND:
-        case LYD_ANYDATA_LYBD:
-            /* dynamic strings are used only as input parameters */
-            assert(0);
-            break;
+    if (!src) {
+        return 0;
+    }
+
+    if (!(options & LY_SET_OPT_USEASLIST)) {
+        /* remove duplicates */
+        i = 0;
+        while (i < src->number) {
+            if (ly_set_contains(trg, src->set.g[i]) > -1) {
+                ly_set_rm_index(src, i);
+            } else {
+                ++i;
+            }
         }
-        break;
-    case LYS_LEAF:
-    case LYS_LEAFLIST:
-        leaf = (struct lyd_node_leaf_list *)node;
-        lyd_free_value(leaf->value, leaf->value_type, leaf->value_flags, &((struct lys_node_leaf *)leaf->schema)->type,
-                       NULL, NULL, NULL);
-        lydict_remove(leaf->schema->module->ctx, leaf->value_str);
-        break;
-    default:
-        assert(0);
     }
 
-    lyd_free_attr(node->schema->module->ctx, node, node->attr, 1);
-    free(node);
+    /* allocate more memory if needed */
+    if (trg->size < trg->number + src->number) {
+        new = realloc(trg->set.g, (trg->number + src->number) * sizeof *(trg->set.g));
+        LY_CHECK_ERR_RETURN(!new, LOGMEM(NULL), -1);
+        trg->size = trg->number + src->number;
+        trg->set.g = new;
+    }
+
+    /* copy contents from src into trg */
+    memcpy(trg->set.g + trg->number, src->set.g, src->number * sizeof *(src->set.g));
+    ret = src->number;
+    trg->number += ret;
+#ifdef LY_ENABLED_CACHE
+    for (i = trg->number - ret; trg->ht && (i < trg->number); ++i) {
+        ly_set_ht_add(trg, i);
+    }
+#endif
+
+    /* cleanup */
+    ly_set_free(src);
+    return ret;
 }
 
-static void
-lyd_free_internal_r(struct lyd_node *node, int top)
+API int
+ly_set_rm_index(struct ly_set *set, unsigned int index)
 {
-    struct lyd_node *next, *iter;
-
-    if (!node) {
-        return;
+    if (!set || (index + 1) > set->number) {
+        LOGARG;
+        return EXIT_FAILURE;
     }
 
-    /* if freeing top-level, always remove it from the parent hash table */
-    lyd_unlink_internal(node, (top ? 1 : 2));
-
-    if (!(node->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST | LYS_ANYDATA))) {
-        /* free children */
-        LY_TREE_FOR_SAFE(node->child, next, iter) {
-            lyd_free_internal_r(iter, 0);
-        }
+#ifdef LY_ENABLED_CACHE
+    ly_set_ht_rm(set, index);
+#endif
+    if (index == set->number - 1) {
+        /* removing last item in set */
+        set->set.g[index] = NULL;
+    } else {
+        /* removing item somewhere in a middle, so put there the last item */
+        set->set.g[index] = set->set.g[set->number - 1];
+        set->set.g[set->number - 1] = NULL;
     }
+    set->number--;
 
-    _lyd_free_node(node);
+    return EXIT_SUCCESS;
 }
 
-API void
-lyd_free(struct lyd_node *node)
+API int
+ly_set_rm(struct ly_set *set, void *node)
 {
-    lyd_free_internal_r(node, 1);
+    int i;
+
+    if (!set || !node) {
+        LOGARG;
+        return EXIT_FAILURE;
+    }
+
+    /* get index */
+    i = ly_set_find(set, node);
+    if (i == -1) {
+        /* node is not in set */
+        LOGARG;
+        return EXIT_FAILURE;
+    }
+
+    return ly_set_rm_index(set, i);
 }
 
-static void
-lyd_free_withsiblings_r(struct lyd_node *first)
+API int
+ly_set_clean(struct ly_set *set)
 {
-    struct lyd_node *next, *node;
-
-    LY_TREE_FOR_SAFE(first, next, node) {
-        if (node->schema->nodetype & (LYS_CONTAINER | LYS_LIST | LYS_RPC | LYS_ACTION | LYS_NOTIF)) {
-            lyd_free_withsiblings_r(node->child);
-        }
-        _lyd_free_node(node);
+    if (!set) {
+        return EXIT_FAILURE;
     }
+
+#ifdef LY_ENABLED_CACHE
+    ly_set_ht_drop(set);
+#endif
+    set->number = 0;
+    return EXIT_SUCCESS;
 }
 
-API void
-lyd_free_withsiblings(struct lyd_node *node)
+API int
+lyd_wd_default(struct lyd_node_leaf_list *node)
 {
-    struct lyd_node *iter, *aux;
+    struct lys_node_leaf *leaf;
+    struct lys_node_leaflist *llist;
+    struct lyd_node *iter;
+    struct lys_tpdf *tpdf;
+    const char *dflt = NULL, **dflts = NULL;
+    uint8_t dflts_size = 0, c, i;
 
-    if (!node) {
-        return;
+    if (!node || !(node->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST))) {
+        return 0;
     }
 
-    if (node->parent) {
-        /* optimization - avoid freeing (unlinking) the last node of the siblings list */
-        /* so, first, free the node's predecessors to the beginning of the list ... */
-        for(iter = node->prev; iter->next; iter = aux) {
-            aux = iter->prev;
-            lyd_free(iter);
+    if (node->dflt) {
+        return 1;
+    }
+
+    if (node->schema->nodetype == LYS_LEAF) {
+        leaf = (struct lys_node_leaf *)node->schema;
+
+        /* get know if there is a default value */
+        if (leaf->dflt) {
+            /* leaf has a default value */
+            dflt = leaf->dflt;
+        } else if (!(leaf->flags & LYS_MAND_TRUE)) {
+            /* get the default value from the type */
+            for (tpdf = leaf->type.der; tpdf && !dflt; tpdf = tpdf->type.der) {
+                dflt = tpdf->dflt;
+            }
         }
-        /* ... then, the node is the first in the siblings list, so free them all */
-        LY_TREE_FOR_SAFE(node, aux, iter) {
-            lyd_free(iter);
+        if (!dflt) {
+            /* no default value */
+            return 0;
         }
-    } else {
-        /* node is top-level so we are freeing the whole data tree, we can just free nodes without any unlinking */
-        while (node->prev->next) {
-            /* find the first sibling */
-            node = node->prev;
+
+        /* compare the default value with the value of the leaf, which may be private (not in the dictionary) */
+        if (!ly_strequal(dflt, node->value_str, 0)) {
+            return 0;
         }
+    } else if (node->schema->module->version >= LYS_VERSION_1_1) { /* LYS_LEAFLIST */
+        llist = (struct lys_node_leaflist *)node->schema;
 
-        /* free it all */
-        lyd_free_withsiblings_r(node);
+        /* get know if there is a default value */
+        if (llist->dflt_size) {
+            /* there are default values */
+            dflts_size = llist->dflt_size;
+            dflts = llist->dflt;
+        } else if (!llist->min) {
+            /* get the default value from the type */
+            for (tpdf = llist->type.der; tpdf && !dflts; tpdf = tpdf->type.der) {
+                if (tpdf->dflt) {
+                    dflts = &tpdf->dflt;
+                    dflts_size = 1;
+                    break;
+                }
+            }
+        }
+
+        if (!dflts_size) {
+            /* no default values to use */
+            return 0;
+        }
+
+        /* compare the default value with the value of the leaf */
+        /* first, find the first leaf-list's sibling */
+        iter = (struct lyd_node *)node;
+        if (iter->parent) {
+            iter = iter->parent->child;
+        } else {
+            for (; iter->prev->next; iter = iter->prev);
+        }
+        for (c = 0; iter; iter = iter->next) {
+            if (iter->schema != node->schema) {
+                continue;
+            }
+            if (c == dflts_size) {
+                /* to many leaf-list instances */
+                return 0;
+            }
+
+            if (llist->flags & LYS_USERORDERED) {
+                /* we have strict order */
+                if (!ly_strequal(dflts[c], ((struct lyd_node_leaf_list *)iter)->value_str, 0)) {
+                    return 0;
+                }
+            } else {
+                /* node's value is supposed to match with one of the default values */
+                for (i = 0; i < dflts_size; i++) {
+                    if (ly_strequal(dflts[i], ((struct lyd_node_leaf_list *)iter)->value_str, 0)) {
+                        break;
+                    }
+                }
+                if (i == dflts_size) {
+                    /* values do not match */
+                    return 0;
+                }
+            }
+            c++;
+        }
+        if (c != dflts_size) {
+            /* different sets of leaf-list instances */
+            return 0;
+        }
+    } else {
+        return 0;
     }
+
+    /* all checks ok */
+    return 1;
 }
 
-/**
- * Expectations:
- * - list exists in data tree
- * - the leaf (defined by the unique_expr) is not instantiated under the list
- */
 int
-lyd_get_unique_default(const char* unique_expr, struct lyd_node *list, const char **dflt)
+unres_data_diff_new(struct unres_data *unres, struct lyd_node *subtree, struct lyd_node *parent, int created)
 {
-    struct ly_ctx *ctx = list->schema->module->ctx;
-    const struct lys_node *parent;
-    const struct lys_node_leaf *sleaf = NULL;
-    struct lys_tpdf *tpdf;
-    struct lyd_node *last, *node;
-    struct ly_set *s, *r;
-    unsigned int i;
-    enum int_log_opts prev_ilo;
-
-    assert(unique_expr && list && dflt);
-    *dflt = NULL;
+    char *parent_xpath = NULL;
 
-    if (resolve_descendant_schema_nodeid(unique_expr, list->schema->child, LYS_LEAF, 1, &parent) || !parent) {
-        /* error, but unique expression was checked when the schema was parsed so this should not happened */
-        LOGINT(ctx);
-        return -1;
+    if (created) {
+        return lyd_difflist_add(unres->diff, &unres->diff_size, unres->diff_idx++, LYD_DIFF_CREATED, NULL, subtree);
+    } else if (unres->diff_ref) {
+        return lyd_difflist_add(unres->diff, &unres->diff_size, unres->diff_idx++, LYD_DIFF_DELETED, subtree, parent);
+    } else {
+        if (parent) {
+            parent_xpath = lyd_path(parent);
+            LY_CHECK_ERR_RETURN(!parent_xpath, LOGMEM(lyd_node_module(subtree)->ctx), -1);
+        }
+        return lyd_difflist_add(unres->diff, &unres->diff_size, unres->diff_idx++, LYD_DIFF_DELETED,
+                                subtree, (struct lyd_node *)parent_xpath);
     }
-
-    sleaf = (struct lys_node_leaf *)parent;
-    if (sleaf->dflt) {
-        /* leaf has a default value */
-        *dflt = sleaf->dflt;
-    } else if (!(sleaf->flags & LYS_MAND_TRUE)) {
-        /* get the default value from the type */
-        for (tpdf = sleaf->type.der; tpdf && !(*dflt); tpdf = tpdf->type.der) {
-            *dflt = tpdf->dflt;
+}
+
+void
+unres_data_diff_rem(struct unres_data *unres, unsigned int idx)
+{
+    if (unres->diff->type[idx] == LYD_DIFF_DELETED) {
+        lyd_free_withsiblings(unres->diff->first[idx]);
+        if (!unres->diff_ref) {
+            free(unres->diff->second[idx]);
         }
     }
 
-    if (!(*dflt)) {
-        return 0;
+    /* replace by last real value */
+    if (idx < unres->diff_idx - 1) {
+        unres->diff->type[idx] = unres->diff->type[unres->diff_idx - 1];
+        unres->diff->first[idx] = unres->diff->first[unres->diff_idx - 1];
+        unres->diff->second[idx] = unres->diff->second[unres->diff_idx - 1];
     }
 
-    /* it has default value, but check if it can appear in the data tree under the list */
-    s = ly_set_new();
-    for (parent = lys_parent((struct lys_node *)sleaf); parent != list->schema; parent = lys_parent(parent)) {
-        if (!(parent->nodetype & (LYS_CONTAINER | LYS_CASE | LYS_CHOICE | LYS_USES))) {
-            /* This should be already detected when parsing schema */
-            LOGINT(ctx);
-            ly_set_free(s);
-            return -1;
-        }
-        ly_set_add(s, (void *)parent, LY_SET_OPT_USEASLIST);
-    }
+    /* move the end */
+    assert(unres->diff->type[unres->diff_idx] == LYD_DIFF_END);
+    unres->diff->type[unres->diff_idx - 1] = unres->diff->type[unres->diff_idx];
+    --unres->diff_idx;
+}
 
-    ly_ilo_change(NULL, ILO_IGNORE, &prev_ilo, NULL);
-    for (i = 0, last = list; i < s->number; i++) {
-        parent = s->set.s[i]; /* shortcut */
+API void
+lyd_free_val_diff(struct lyd_difflist *diff)
+{
+    uint32_t i;
 
-        switch (parent->nodetype) {
-        case LYS_CONTAINER:
-            if (last) {
-                /* find instance in the data */
-                r = lyd_find_path(last, parent->name);
-                if (!r || r->number > 1) {
-                    ly_set_free(r);
-                    *dflt = NULL;
-                    goto end;
-                }
-                if (r->number) {
-                    last = r->set.d[0];
-                } else {
-                    last = NULL;
-                }
-                ly_set_free(r);
-            }
-            if (((struct lys_node_container *)parent)->presence) {
-                /* not-instantiated presence container on path */
-                *dflt = NULL;
-                goto end;
-            }
-            break;
-        case LYS_CHOICE :
-            /* check presence of another case */
-            if (!last) {
-                continue;
-            }
+    if (!diff) {
+        return;
+    }
 
-            /* remember the case to be searched in choice by lyv_multicases() */
-            if (i + 1 == s->number) {
-                parent = (struct lys_node *)sleaf;
-            } else if (s->set.s[i + 1]->nodetype == LYS_CASE && (i + 2 < s->number) &&
-                    s->set.s[i + 2]->nodetype == LYS_CHOICE) {
-                /* nested choices are covered by lyv_multicases, we just have to pass
-                 * the lowest choice */
-                i++;
-                continue;
-            } else {
-                parent = s->set.s[i + 1];
-            }
-            node = last->child;
-            if (lyv_multicases(NULL, (struct lys_node *)parent, &node, 0, NULL)) {
-                /* another case is present */
-                *dflt = NULL;
-                goto end;
-            }
+    for (i = 0; diff->type[i] != LYD_DIFF_END; ++i) {
+        switch (diff->type[i]) {
+        case LYD_DIFF_CREATED:
+            free(diff->first[i]);
+            lyd_free_withsiblings(diff->second[i]);
+            break;
+        case LYD_DIFF_DELETED:
+            lyd_free_withsiblings(diff->first[i]);
+            free(diff->second[i]);
+            break;
+        case LYD_DIFF_CHANGED:
+            free(diff->first[i]);
+            lyd_free_withsiblings(diff->second[i]);
+            break;
+        case LYD_DIFF_MOVEDAFTER2:
+            free(diff->first[i]);
+            free(diff->second[i]);
             break;
         default:
-            /* LYS_CASE, LYS_USES */
-            continue;
+            /* what to do? */
+            break;
         }
     }
 
-end:
-    ly_ilo_restore(NULL, prev_ilo, NULL, 0);
-    ly_set_free(s);
-    return 0;
+    lyd_free_diff(diff);
 }
 
 API char *
-lyd_path(const struct lyd_node *node)
+lyd_val_change_path(const struct lyd_val_change *change)
 {
-    char *buf = NULL;
+    const struct lys_module *mod;
+    char *parent_path = NULL, *path;
+    const char *quot;
+    int r;
 
-    if (!node) {
+    if (!change || !change->schema || ((change->type != LYD_DIFF_CREATED) && (change->type != LYD_DIFF_DELETED))) {
         LOGARG;
         return NULL;
     }
 
-    if (ly_vlog_build_path(LY_VLOG_LYD, node, &buf, 0, 0)) {
-        return NULL;
+    if (change->node) {
+        return lyd_path(change->node);
     }
 
-    return buf;
-}
-
-int
-lyd_build_relative_data_path(const struct lys_module *module, const struct lyd_node *node, const char *schema_id,
-                             char *buf)
-{
-    const struct lys_node *snode, *schema;
-    const char *mod_name, *name;
-    int mod_name_len, name_len, len = 0;
-    int r, is_relative = -1;
-
-    assert(schema_id && buf);
-    schema = node->schema;
-
-    while (*schema_id) {
-        if ((r = parse_schema_nodeid(schema_id, &mod_name, &mod_name_len, &name, &name_len, &is_relative, NULL, NULL, 0)) < 1) {
-            LOGINT(module->ctx);
-            return -1;
-        }
-        schema_id += r;
-
-        snode = NULL;
-        while ((snode = lys_getnext(snode, schema, NULL, LYS_GETNEXT_WITHCHOICE | LYS_GETNEXT_WITHCASE | LYS_GETNEXT_NOSTATECHECK))) {
-            r = schema_nodeid_siblingcheck(snode, module, mod_name, mod_name_len, name, name_len);
-            if (r == 0) {
-                schema = snode;
-                break;
-            } else if (r == 1) {
-                continue;
-            } else {
-                return -1;
-            }
-        }
-        /* no match */
-        if (!snode || (!schema_id[0] && snode->nodetype != LYS_LEAF)) {
-            LOGINT(module->ctx);
-            return -1;
+    if (change->parent) {
+        parent_path = lyd_path(change->parent);
+        if (!parent_path) {
+            return NULL;
         }
+    }
 
-        if (!(snode->nodetype & (LYS_CHOICE | LYS_CASE))) {
-            len += sprintf(&buf[len], "%s%s", (len ? "/" : ""), snode->name);
-        }
+    /* the module name is printed the same way as by lyd_path() */
+    mod = lys_node_module(change->schema);
+    if (change->parent && (lyd_node_module(change->parent) == mod)) {
+        mod = NULL;
     }
+    if ((change->schema->nodetype == LYS_LEAFLIST) && change->value) {
+        quot = strchr(change->value, '\'') ? "\"" : "'";
+        r = asprintf(&path, "%s/%s%s%s[.=%s%s%s]", parent_path ? parent_path : "", mod ? mod->name : "", mod ? ":" : "",
+                     change->schema->name, quot, change->value, quot);
+    } else {
+        r = asprintf(&path, "%s/%s%s%s", parent_path ? parent_path : "", mod ? mod->name : "", mod ? ":" : "",
+                     change->schema->name);
+    }
+    free(parent_path);
+    LY_CHECK_ERR_RETURN(r == -1, LOGMEM(change->schema->module->ctx), NULL);
 
-    return len;
+    return path;
 }
 
-API struct ly_set *
-lyd_find_path(const struct lyd_node *ctx_node, const char *path)
+API void
+lyd_free_val_changes(struct lyd_val_change *changes)
 {
-    struct lyxp_set xp_set;
-    struct ly_set *set;
-    char *yang_xpath;
-    const char * node_mod_name, *mod_name, *name;
-    int mod_name_len, name_len, is_relative = -1;
     uint32_t i;
 
-    if (!ctx_node || !path) {
-        LOGARG;
-        return NULL;
+    if (!changes) {
+        return;
     }
 
-    if (parse_schema_nodeid(path, &mod_name, &mod_name_len, &name, &name_len, &is_relative, NULL, NULL, 1) > 0) {
-        if (name[0] == '#' && !is_relative) {
-            node_mod_name = lyd_node_module(ctx_node)->name;
-            if (strncmp(mod_name, node_mod_name, mod_name_len) || node_mod_name[mod_name_len]) {
-                return NULL;
-            }
-            path = name + name_len;
+    for (i = 0; changes[i].type != LYD_DIFF_END; ++i) {
+        if (changes[i].value) {
+            lydict_remove(changes[i].schema->module->ctx, changes[i].value);
         }
     }
+    free(changes);
+}
 
-    /* transform JSON into YANG XPATH */
-    yang_xpath = transform_json2xpath(lyd_node_module(ctx_node), path);
-    if (!yang_xpath) {
-        return NULL;
-    }
-
-    memset(&xp_set, 0, sizeof xp_set);
+/* is the node (still) connected to one of the journaled top-level nodes? */
+static int
+lyd_journal_member(struct lyd_journal *journal, struct lyd_node *node)
+{
+    struct lyd_node *top, *sibling;
 
-    if (lyxp_eval(yang_xpath, ctx_node, LYXP_NODE_ELEM, lyd_node_module(ctx_node), &xp_set, 0) != EXIT_SUCCESS) {
-        free(yang_xpath);
-        return NULL;
+    if (node->parent) {
+        for (top = node->parent; top->parent; top = top->parent);
+        return (ly_set_contains(journal->tops, top) > -1);
     }
-    free(yang_xpath);
 
-    set = ly_set_new();
-    LY_CHECK_ERR_RETURN(!set, LOGMEM(ctx_node->schema->module->ctx), NULL);
+    if (ly_set_contains(journal->tops, node) > -1) {
+        return 1;
+    }
 
-    if (xp_set.type == LYXP_SET_NODE_SET) {
-        for (i = 0; i < xp_set.used; ++i) {
-            if (xp_set.val.nodes[i].type == LYXP_NODE_ELEM) {
-                if (ly_set_add(set, xp_set.val.nodes[i].node, LY_SET_OPT_USEASLIST) < 0) {
-                    ly_set_free(set);
-                    set = NULL;
-                    break;
-                }
-            }
-        }
+    /* newly inserted top-level node, check its siblings */
+    sibling = (node->prev != node) ? node->prev : node->next;
+    if (sibling && (ly_set_contains(journal->tops, sibling) > -1)) {
+        ly_set_add(journal->tops, node, LY_SET_OPT_USEASLIST);
+        return 1;
     }
-    /* free xp_set content */
-    lyxp_set_cast(&xp_set, LYXP_SET_EMPTY, ctx_node, NULL, 0);
 
-    return set;
+    return 0;
 }
 
-API struct ly_set *
-lyd_find_instance(const struct lyd_node *data, const struct lys_node *schema)
+/* is the change of the node supposed to be recorded in the active journal? */
+static struct lyd_journal *
+lyd_journal_get(struct lyd_node *node)
 {
-    struct ly_set *ret, *ret_aux, *spath;
-    const struct lys_node *siter;
-    struct lyd_node *iter;
-    unsigned int i, j;
+    struct lyd_journal *journal = lyd_journal_active;
 
-    if (!data || !schema ||
-            !(schema->nodetype & (LYS_CONTAINER | LYS_LEAF | LYS_LIST | LYS_LEAFLIST | LYS_ANYDATA | LYS_NOTIF | LYS_RPC | LYS_ACTION))) {
-        LOGARG;
+    if (!journal || journal->busy || lyd_gen_frozen || (journal->ctx != node->schema->module->ctx)) {
         return NULL;
     }
-
-    ret = ly_set_new();
-    spath = ly_set_new();
-    if (!ret || !spath) {
-        LOGMEM(schema->module->ctx);
-        goto error;
+    if (!lyd_journal_member(journal, node)) {
+        return NULL;
     }
 
-    /* find data root */
-    while (data->parent) {
-        /* vertical move (up) */
-        data = data->parent;
-    }
-    while (data->prev->next) {
-        /* horizontal move (left) */
-        data = data->prev;
+    return journal;
+}
+
+static void
+lyd_journal_add(struct lyd_journal *journal, LYD_DIFFTYPE type, void *first, void *second)
+{
+    if (lyd_difflist_add_ctx(journal->ctx, journal->diff, &journal->size, journal->index, type, first, second)) {
+        return;
     }
+    ++journal->index;
+}
 
-    /* build schema path */
-    for (siter = schema; siter; ) {
-        if (siter->nodetype == LYS_AUGMENT) {
-            siter = ((struct lys_node_augment *)siter)->target;
-            continue;
-        } else if (siter->nodetype & (LYS_CONTAINER | LYS_LEAF | LYS_LIST | LYS_LEAFLIST | LYS_ANYDATA | LYS_NOTIF | LYS_RPC | LYS_ACTION)) {
-            /* standard data node */
-            ly_set_add(spath, (void*)siter, LY_SET_OPT_USEASLIST);
+static void
+lyd_journal_created(struct lyd_node *node)
+{
+    struct lyd_journal *journal;
+    struct lyd_node *dup;
+    char *path;
 
-        } /* else skip the rest node types */
-        siter = siter->parent;
+    if (node->dflt || !(journal = lyd_journal_get(node))) {
+        return;
     }
-    if (!spath->number) {
-        /* no valid path */
-        goto error;
+
+    journal->busy = 1;
+    dup = lyd_dup(node, LYD_DUP_OPT_RECURSIVE);
+    path = node->parent ? lyd_path(node->parent) : NULL;
+    lyd_journal_add(journal, LYD_DIFF_CREATED, path, dup);
+
+    /* not appended as the last instance, remember the position */
+    if ((node->schema->flags & LYS_USERORDERED) && node->next && (node->next->schema == node->schema)) {
+        path = (node->prev->next && (node->prev->schema == node->schema)) ? lyd_path(node->prev) : NULL;
+        lyd_journal_add(journal, LYD_DIFF_MOVEDAFTER2, path, lyd_path(node));
     }
+    journal->busy = 0;
+}
 
-    /* start searching */
-    LY_TREE_FOR((struct lyd_node *)data, iter) {
-        if (iter->schema == spath->set.s[spath->number - 1]) {
-            ly_set_add(ret, iter, LY_SET_OPT_USEASLIST);
-        }
+static void
+lyd_journal_deleted(struct lyd_node *node)
+{
+    struct lyd_journal *journal;
+    struct lyd_node *dup;
+    char *path;
+
+    if (node->dflt || !(journal = lyd_journal_get(node))) {
+        return;
     }
-    for (i = spath->number - 1; i; i--) {
-        if (!ret->number) {
-            /* nothing found */
-            break;
-        }
 
-        ret_aux = ly_set_new();
-        if (!ret_aux) {
-            LOGMEM(schema->module->ctx);
-            goto error;
-        }
-        for (j = 0; j < ret->number; j++) {
-            LY_TREE_FOR(ret->set.d[j]->child, iter) {
-                if (iter->schema == spath->set.s[i - 1]) {
-                    ly_set_add(ret_aux, iter, LY_SET_OPT_USEASLIST);
-                }
-            }
-        }
-        ly_set_free(ret);
-        ret = ret_aux;
+    journal->busy = 1;
+    dup = lyd_dup(node, LYD_DUP_OPT_RECURSIVE);
+    path = node->parent ? lyd_path(node->parent) : NULL;
+    lyd_journal_add(journal, LYD_DIFF_DELETED, dup, path);
+    journal->busy = 0;
+
+    if (!node->parent) {
+        ly_set_rm(journal->tops, node);
     }
+}
 
-    ly_set_free(spath);
-    return ret;
+static void
+lyd_journal_changed(struct lyd_node *node, int was_dflt)
+{
+    struct lyd_journal *journal;
 
-error:
-    ly_set_free(ret);
-    ly_set_free(spath);
+    if (node->dflt || !(journal = lyd_journal_get(node))) {
+        return;
+    }
 
-    return NULL;
+    if (was_dflt) {
+        /* the implicit default node was not recorded, so it is created now */
+        lyd_journal_created(node);
+        return;
+    }
+
+    journal->busy = 1;
+    lyd_journal_add(journal, LYD_DIFF_CHANGED, lyd_path(node), lyd_dup(node, 0));
+    journal->busy = 0;
 }
 
-API struct lyd_node *
-lyd_first_sibling(struct lyd_node *node)
+API struct lyd_journal *
+lyd_journal_start(struct lyd_node *tree)
 {
-    struct lyd_node *start;
+    struct lyd_journal *journal;
+    struct ly_ctx *ctx;
+    struct lyd_node *iter;
 
-    if (!node) {
+    if (!tree || tree->parent) {
+        LOGARG;
         return NULL;
     }
+    ctx = tree->schema->module->ctx;
 
-    /* get the first sibling */
-    if (node->parent) {
-        start = node->parent->child;
-    } else {
-        for (start = node; start->prev->next; start = start->prev);
+    if (lyd_journal_active) {
+        LOGERR(ctx, LY_EINVAL, "Another data journal is already active in this thread.");
+        return NULL;
     }
 
-    return start;
+    journal = calloc(1, sizeof *journal);
+    LY_CHECK_ERR_RETURN(!journal, LOGMEM(ctx), NULL);
+    journal->ctx = ctx;
+    journal->tops = ly_set_new();
+    journal->diff = lyd_diff_init_difflist(ctx, &journal->size);
+    if (!journal->tops || !journal->diff) {
+        LOGMEM(ctx);
+        ly_set_free(journal->tops);
+        lyd_free_diff(journal->diff);
+        free(journal);
+        return NULL;
+    }
+
+    for (iter = tree; iter->prev->next; iter = iter->prev);
+    LY_TREE_FOR(iter, iter) {
+        ly_set_add(journal->tops, iter, LY_SET_OPT_USEASLIST);
+    }
+
+    lyd_journal_active = journal;
+    return journal;
 }
 
-API struct ly_set *
-ly_set_new(void)
+API struct lyd_difflist *
+lyd_journal_diff(struct lyd_journal *journal)
 {
-    struct ly_set *new;
+    struct lyd_difflist *diff, *new_diff;
+    unsigned int size;
 
-    new = calloc(1, sizeof(struct ly_set));
-    LY_CHECK_ERR_RETURN(!new, LOGMEM(NULL), NULL);
-    return new;
+    if (!journal) {
+        LOGARG;
+        return NULL;
+    }
+
+    new_diff = lyd_diff_init_difflist(journal->ctx, &size);
+    if (!new_diff) {
+        return NULL;
+    }
+
+    diff = journal->diff;
+    journal->diff = new_diff;
+    journal->size = size;
+    journal->index = 0;
+    return diff;
 }
 
 API void
-ly_set_free(struct ly_set *set)
+lyd_journal_stop(struct lyd_journal *journal)
 {
-    if (!set) {
+    if (!journal) {
         return;
     }
 
-    free(set->set.g);
-    free(set);
+    if (lyd_journal_active == journal) {
+        lyd_journal_active = NULL;
+    }
+    lyd_free_val_diff(journal->diff);
+    ly_set_free(journal->tops);
+    free(journal);
 }
 
-API int
-ly_set_contains(const struct ly_set *set, void *node)
+static const char *
+lyd_wd_leaf_dflt(const struct lys_node_leaf *leaf)
 {
-    unsigned int i;
+    struct lys_tpdf *tpdf;
+    const char *dflt = NULL;
 
-    if (!set) {
-        return -1;
+    /* get know if there is a default value */
+    if (leaf->dflt) {
+        /* leaf has a default value */
+        dflt = leaf->dflt;
+    } else if (!(leaf->flags & LYS_MAND_TRUE)) {
+        /* get the default value from the type */
+        for (tpdf = leaf->type.der; tpdf && !dflt; tpdf = tpdf->type.der) {
+            dflt = tpdf->dflt;
+        }
     }
 
-    for (i = 0; i < set->number; i++) {
-        if (set->set.g[i] == node) {
-            /* object found */
-            return i;
-        }
+    return dflt;
+}
+
+/* default leaves not created with LY_CTX_VIRTUAL_DFLT, there is nothing to check or resolve in them and they
+ * cannot affect any other validation, they are always instantiated directly in their existing data parent */
+static int
+lyd_wd_leaf_virtual(const struct lys_node_leaf *leaf, const struct lyd_node *data_parent)
+{
+    const struct lys_node *parent;
+
+    if (!(leaf->module->ctx->models.flags & LY_CTX_VIRTUAL_DFLT)
+            || (leaf->flags & (LYS_CONFIG_R | LYS_UNIQUE | LYS_VALID_EXT)) || leaf->must_size
+            || (leaf->type.base == LY_TYPE_LEAFREF) || (leaf->type.base == LY_TYPE_INST)
+            || ((leaf->type.base == LY_TYPE_UNION) && leaf->type.info.uni.has_ptr_type)
+            || lys_is_key(leaf, NULL) || resolve_applies_when((struct lys_node *)leaf, 0, NULL)) {
+        return 0;
     }
 
-    /* object not found */
-    return -1;
+    for (parent = lys_parent((struct lys_node *)leaf); parent && (parent->nodetype == LYS_USES); parent = lys_parent(parent));
+    return (data_parent && (data_parent->schema == parent)
+            && (parent->nodetype & (LYS_CONTAINER | LYS_LIST | LYS_NOTIF))) ? 1 : 0;
 }
 
-API struct ly_set *
-ly_set_dup(const struct ly_set *set)
+void
+lyd_wd_materialize(struct lyd_node *parent, struct ly_set *created)
 {
-    struct ly_set *new;
+    const struct lys_node *siter = NULL;
+    struct lyd_node *iter, *node;
+    const char *dflt;
+    uint8_t validity;
 
-    if (!set) {
-        return NULL;
+    if (!(parent->schema->module->ctx->models.flags & LY_CTX_VIRTUAL_DFLT)
+            || !(parent->schema->nodetype & (LYS_CONTAINER | LYS_LIST | LYS_NOTIF)) || (parent->validity & LYD_VAL_INUSE)) {
+        return;
     }
 
-    new = malloc(sizeof *new);
-    LY_CHECK_ERR_RETURN(!new, LOGMEM(NULL), NULL);
-    new->number = set->number;
-    new->size = set->size;
-    new->set.g = malloc(new->size * sizeof *(new->set.g));
-    LY_CHECK_ERR_RETURN(!new->set.g, LOGMEM(NULL); free(new), NULL);
-    memcpy(new->set.g, set->set.g, new->size * sizeof *(new->set.g));
+    while ((siter = lys_getnext(siter, parent->schema, NULL, 0))) {
+        if ((siter->nodetype != LYS_LEAF) || !lyd_wd_leaf_virtual((struct lys_node_leaf *)siter, parent)
+                || !(dflt = lyd_wd_leaf_dflt((struct lys_node_leaf *)siter))) {
+            continue;
+        }
+        LY_TREE_FOR(parent->child, iter) {
+            if (iter->schema == siter) {
+                break;
+            }
+        }
+        if (iter) {
+            continue;
+        }
 
-    return new;
+        /* the tree does not change from the outside, keep all the references to it valid */
+        validity = parent->validity;
+        ++lyd_gen_frozen;
+        node = _lyd_new_leaf(parent, siter, dflt, 1, 0);
+        --lyd_gen_frozen;
+        parent->validity = validity;
+        if (!node) {
+            /* errors are logged, the default is just missing */
+            continue;
+        }
+        node->validity = LYD_VAL_OK;
+        if (created) {
+            ly_set_add(created, node, LY_SET_OPT_USEASLIST);
+        }
+    }
 }
 
-API int
-ly_set_add(struct ly_set *set, void *node, int options)
+void
+lyd_wd_virtualize(struct ly_set *created)
 {
+    struct lyd_node *parent;
     unsigned int i;
-    void **new;
+    uint8_t validity;
+
+    ++lyd_gen_frozen;
+    for (i = 0; i < created->number; ++i) {
+        /* the parent is not changed by removing its default */
+        parent = created->set.d[i]->parent;
+        validity = parent->validity;
+        lyd_free(created->set.d[i]);
+        parent->validity = validity;
+    }
+    --lyd_gen_frozen;
+    created->number = 0;
+}
 
-    if (!set || !node) {
-        LOGARG;
-        return -1;
+static int
+lyd_wd_add_leaf(struct lyd_node **tree, struct lyd_node *last_parent, struct lys_node_leaf *leaf, struct unres_data *unres,
+                int check_when_must)
+{
+    struct lyd_node *dummy = NULL, *current;
+    const char *dflt;
+    int ret;
+
+    dflt = lyd_wd_leaf_dflt(leaf);
+    if (!dflt || lyd_wd_leaf_virtual(leaf, last_parent)) {
+        /* no default value or it is resolved when accessed */
+        return EXIT_SUCCESS;
     }
 
-    if (!(options & LY_SET_OPT_USEASLIST)) {
-        /* search for duplication */
-        for (i = 0; i < set->number; i++) {
-            if (set->set.g[i] == node) {
-                /* already in set */
-                return i;
+    /* create the node */
+    if (!(dummy = lyd_new_dummy(*tree, last_parent, (struct lys_node*)leaf, dflt, 1))) {
+        goto error;
+    }
+
+    if (unres->store_diff) {
+        /* remember this subtree in the diff */
+        if (unres_data_diff_new(unres, dummy, NULL, 1)) {
+            goto error;
+        }
+    }
+
+    if (!dummy->parent && (*tree)) {
+        /* connect dummy nodes into the data tree (at the end of top level nodes) */
+        if (lyd_insert_sibling(tree, dummy)) {
+            goto error;
+        }
+    }
+    for (current = dummy; ; current = current->child) {
+        /* remember the created data in unres */
+        if (check_when_must) {
+            if ((current->when_status & LYD_WHEN) && unres_data_add(unres, current, UNRES_WHEN) == -1) {
+                goto error;
+            }
+            if (check_when_must == 2) {
+                ret = resolve_applies_must(current);
+                if ((ret & 0x1) && (unres_data_add(unres, current, UNRES_MUST) == -1)) {
+                    goto error;
+                }
+                if ((ret & 0x2) && (unres_data_add(unres, current, UNRES_MUST_INOUT) == -1)) {
+                    goto error;
+                }
             }
         }
+
+        /* clear dummy-node flag */
+        current->validity &= ~LYD_VAL_INUSE;
+
+        if (current->schema == (struct lys_node *)leaf) {
+            break;
+        }
     }
+    /* update parent's default flag if needed */
+    lyd_wd_update_parents(dummy);
 
-    if (set->size == set->number) {
-        new = realloc(set->set.g, (set->size + 8) * sizeof *(set->set.g));
-        LY_CHECK_ERR_RETURN(!new, LOGMEM(NULL), -1);
-        set->size += 8;
-        set->set.g = new;
+    /* if necessary, remember the created data value in unres */
+    if (((struct lyd_node_leaf_list *)current)->value_type == LY_TYPE_LEAFREF) {
+        if (unres_data_add(unres, current, UNRES_LEAFREF)) {
+            goto error;
+        }
+    } else if (((struct lyd_node_leaf_list *)current)->value_type == LY_TYPE_INST) {
+        if (unres_data_add(unres, current, UNRES_INSTID)) {
+            goto error;
+        }
     }
 
-    set->set.g[set->number++] = node;
+    if (!(*tree)) {
+        *tree = dummy;
+    }
+    return EXIT_SUCCESS;
 
-    return set->number - 1;
+error:
+    lyd_free(dummy);
+    return EXIT_FAILURE;
 }
 
-API int
-ly_set_merge(struct ly_set *trg, struct ly_set *src, int options)
+static int
+lyd_wd_add_leaflist(struct lyd_node **tree, struct lyd_node *last_parent, struct lys_node_leaflist *llist,
+                    struct unres_data *unres, int check_when_must)
 {
-    unsigned int i, ret;
-    void **new;
+    struct lyd_node *dummy, *current, *first = NULL;
+    struct lys_tpdf *tpdf;
+    const char **dflt = NULL;
+    uint8_t dflt_size = 0;
+    int i, ret;
 
-    if (!trg) {
-        LOGARG;
-        return -1;
+    if (llist->module->version < LYS_VERSION_1_1) {
+        /* default values on leaf-lists are allowed from YANG 1.1 */
+        return EXIT_SUCCESS;
+    }
+
+    /* get know if there is a default value */
+    if (llist->dflt_size) {
+        /* there are default values */
+        dflt_size = llist->dflt_size;
+        dflt = llist->dflt;
+    } else if (!llist->min) {
+        /* get the default value from the type */
+        for (tpdf = llist->type.der; tpdf && !dflt; tpdf = tpdf->type.der) {
+            if (tpdf->dflt) {
+                dflt = &tpdf->dflt;
+                dflt_size = 1;
+                break;
+            }
+        }
     }
 
-    if (!src) {
-        return 0;
+    if (!dflt_size) {
+        /* no default values to use */
+        return EXIT_SUCCESS;
     }
 
-    if (!(options & LY_SET_OPT_USEASLIST)) {
-        /* remove duplicates */
-        i = 0;
-        while (i < src->number) {
-            if (ly_set_contains(trg, src->set.g[i]) > -1) {
-                ly_set_rm_index(src, i);
-            } else {
-                ++i;
+    for (i = 0; i < dflt_size; i++) {
+        /* create the node */
+        if (!(dummy = lyd_new_dummy(*tree, last_parent, (struct lys_node*)llist, dflt[i], 1))) {
+            goto error;
+        }
+
+        if (unres->store_diff) {
+            /* remember this subtree in the diff */
+            if (unres_data_diff_new(unres, dummy, NULL, 1)) {
+                goto error;
             }
         }
-    }
 
-    /* allocate more memory if needed */
-    if (trg->size < trg->number + src->number) {
-        new = realloc(trg->set.g, (trg->number + src->number) * sizeof *(trg->set.g));
-        LY_CHECK_ERR_RETURN(!new, LOGMEM(NULL), -1);
-        trg->size = trg->number + src->number;
-        trg->set.g = new;
-    }
+        if (!first) {
+            first = dummy;
+        } else if (!dummy->parent) {
+            /* interconnect with the rest of leaf-lists */
+            first->prev->next = dummy;
+            dummy->prev = first->prev;
+            first->prev = dummy;
+        }
 
-    /* copy contents from src into trg */
-    memcpy(trg->set.g + trg->number, src->set.g, src->number * sizeof *(src->set.g));
-    ret = src->number;
-    trg->number += ret;
+        for (current = dummy; ; current = current->child) {
+            /* remember the created data in unres */
+            if (check_when_must) {
+                if ((current->when_status & LYD_WHEN) && unres_data_add(unres, current, UNRES_WHEN) == -1) {
+                    goto error;
+                }
+                if (check_when_must == 2) {
+                    ret = resolve_applies_must(current);
+                    if ((ret & 0x1) && (unres_data_add(unres, current, UNRES_MUST) == -1)) {
+                        goto error;
+                    }
+                    if ((ret & 0x2) && (unres_data_add(unres, current, UNRES_MUST_INOUT) == -1)) {
+                        goto error;
+                    }
+                }
+            }
 
-    /* cleanup */
-    ly_set_free(src);
-    return ret;
-}
+            /* clear dummy-node flag */
+            current->validity &= ~LYD_VAL_INUSE;
 
-API int
-ly_set_rm_index(struct ly_set *set, unsigned int index)
-{
-    if (!set || (index + 1) > set->number) {
-        LOGARG;
-        return EXIT_FAILURE;
+            if (current->schema == (struct lys_node *)llist) {
+                break;
+            }
+        }
+
+        /* if necessary, remember the created data value in unres */
+        if (((struct lyd_node_leaf_list *)current)->value_type == LY_TYPE_LEAFREF) {
+            if (unres_data_add(unres, current, UNRES_LEAFREF)) {
+                goto error;
+            }
+        } else if (((struct lyd_node_leaf_list *)current)->value_type == LY_TYPE_INST) {
+            if (unres_data_add(unres, current, UNRES_INSTID)) {
+                goto error;
+            }
+        }
     }
 
-    if (index == set->number - 1) {
-        /* removing last item in set */
-        set->set.g[index] = NULL;
-    } else {
-        /* removing item somewhere in a middle, so put there the last item */
-        set->set.g[index] = set->set.g[set->number - 1];
-        set->set.g[set->number - 1] = NULL;
+    /* insert into the tree */
+    if (first && !first->parent && (*tree)) {
+        /* connect dummy nodes into the data tree (at the end of top level nodes) */
+        if (lyd_insert_sibling(tree, first)) {
+            goto error;
+        }
+    } else if (!(*tree)) {
+        *tree = first;
     }
-    set->number--;
+
+    /* update parent's default flag if needed */
+    lyd_wd_update_parents(first);
 
     return EXIT_SUCCESS;
+
+error:
+    lyd_free_withsiblings(first);
+    return EXIT_FAILURE;
 }
 
-API int
-ly_set_rm(struct ly_set *set, void *node)
+static void
+lyd_wd_leaflist_cleanup(struct ly_set *set, struct unres_data *unres)
 {
     unsigned int i;
 
-    if (!set || !node) {
-        LOGARG;
-        return EXIT_FAILURE;
-    }
+    assert(set);
 
-    /* get index */
+    /* if there is an instance without the dflt flag, we have to
+     * remove all instances with the flag - an instance could be
+     * explicitely added, so the default leaflists were invalidated */
     for (i = 0; i < set->number; i++) {
-        if (set->set.g[i] == node) {
+        if (!set->set.d[i]->dflt) {
             break;
         }
     }
-    if (i == set->number) {
-        /* node is not in set */
-        LOGARG;
-        return EXIT_FAILURE;
-    }
-
-    return ly_set_rm_index(set, i);
-}
-
-API int
-ly_set_clean(struct ly_set *set)
-{
-    if (!set) {
-        return EXIT_FAILURE;
+    if (i < set->number) {
+        for (i = 0; i < set->number; i++) {
+            if (set->set.d[i]->dflt) {
+                /* remove this default instance */
+                if (unres->store_diff) {
+                    /* just move it to diff if is being generated */
+                    unres_data_diff_new(unres, set->set.d[i], set->set.d[i]->parent, 0);
+                    lyd_unlink(set->set.d[i]);
+                } else {
+                    lyd_free(set->set.d[i]);
+                }
+            }
+        }
     }
-
-    set->number = 0;
-    return EXIT_SUCCESS;
 }
 
-API int
-lyd_wd_default(struct lyd_node_leaf_list *node)
+/**
+ * @brief Process (add/clean flags) default nodes in the schema subtree
+ *
+ * @param[in,out] root Pointer to the root node of the complete data tree, the root node can be NULL if the data tree
+ *                     is empty
+ * @param[in] last_parent The closest parent in the data tree to the currently processed \p schema node
+ * @param[in] subroot  The root node of a data subtree, the node is instance of the \p schema node, NULL in case the
+ *                     schema node is not instantiated in the data tree
+ * @param[in] schema The schema node to be processed
+ * @param[in] toplevel Flag for processing top level schema nodes when \p last_parent and \p subroot are consider as
+ *                     unknown
+ * @param[in] options  Parser options to know the data tree type, see @ref parseroptions.
+ * @param[in] unres    Unresolved data list, the newly added default nodes may need to add some unresolved items
+ * @return EXIT_SUCCESS or EXIT_FAILURE
+ */
+static int
+lyd_wd_add_subtree(struct lyd_node **root, struct lyd_node *last_parent, struct lyd_node *subroot,
+                   struct lys_node *schema, int toplevel, int options, struct unres_data *unres)
 {
-    struct lys_node_leaf *leaf;
-    struct lys_node_leaflist *llist;
+    struct ly_set *present = NULL;
+    struct lys_node *siter, *siter_prev;
     struct lyd_node *iter;
-    struct lys_tpdf *tpdf;
-    const char *dflt = NULL, **dflts = NULL;
-    uint8_t dflts_size = 0, c, i;
+    int i, check_when_must, storing_diff = 0;
 
-    if (!node || !(node->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST))) {
-        return 0;
-    }
+    assert(root);
 
-    if (node->dflt) {
-        return 1;
+    if ((options & LYD_OPT_TYPEMASK) && (schema->flags & LYS_CONFIG_R)) {
+        /* non LYD_OPT_DATA tree, status data are not expected here */
+        return EXIT_SUCCESS;
     }
 
-    if (node->schema->nodetype == LYS_LEAF) {
-        leaf = (struct lys_node_leaf *)node->schema;
+    if (options & (LYD_OPT_NOTIF_FILTER | LYD_OPT_EDIT | LYD_OPT_GET | LYD_OPT_GETCONFIG)) {
+        check_when_must = 0; /* check neither */
+    } else if (options & LYD_OPT_TRUSTED) {
+        check_when_must = 1; /* check only when */
+    } else {
+        check_when_must = 2; /* check both when and must */
+    }
 
-        /* get know if there is a default value */
-        if (leaf->dflt) {
-            /* leaf has a default value */
-            dflt = leaf->dflt;
-        } else if (!(leaf->flags & LYS_MAND_TRUE)) {
-            /* get the default value from the type */
-            for (tpdf = leaf->type.der; tpdf && !dflt; tpdf = tpdf->type.der) {
-                dflt = tpdf->dflt;
-            }
+    if (toplevel && (schema->nodetype & (LYS_LEAF | LYS_LIST | LYS_LEAFLIST | LYS_CONTAINER))) {
+        /* search for the schema node instance */
+        present = ly_set_new();
+        if (!present) {
+            goto error;
         }
-        if (!dflt) {
-            /* no default value */
-            return 0;
+        if ((*root) && lyd_get_node_siblings(*root, schema, present)) {
+            /* there are some instances */
+            for (i = 0; i < (signed)present->number; i++) {
+                if (schema->nodetype & LYS_LEAFLIST) {
+                    lyd_wd_leaflist_cleanup(present, unres);
+                } else if (schema->nodetype != LYS_LEAF) {
+                    if (lyd_wd_add_subtree(root, present->set.d[i], present->set.d[i], schema, 0, options, unres)) {
+                        goto error;
+                    }
+                } /* else LYS_LEAF - nothing to do */
+            }
+        } else {
+            /* no instance */
+            if (lyd_wd_add_subtree(root, last_parent, NULL, schema, 0, options, unres)) {
+                goto error;
+            }
         }
 
-        /* compare the default value with the value of the leaf */
-        if (!ly_strequal(dflt, node->value_str, 1)) {
-            return 0;
-        }
-    } else if (node->schema->module->version >= LYS_VERSION_1_1) { /* LYS_LEAFLIST */
-        llist = (struct lys_node_leaflist *)node->schema;
+        ly_set_free(present);
+        return EXIT_SUCCESS;
+    }
 
-        /* get know if there is a default value */
-        if (llist->dflt_size) {
-            /* there are default values */
-            dflts_size = llist->dflt_size;
-            dflts = llist->dflt;
-        } else if (!llist->min) {
-            /* get the default value from the type */
-            for (tpdf = llist->type.der; tpdf && !dflts; tpdf = tpdf->type.der) {
-                if (tpdf->dflt) {
-                    dflts = &tpdf->dflt;
-                    dflts_size = 1;
-                    break;
-                }
+    /* skip disabled parts of schema */
+    if (!subroot) {
+        /* go through all the uses and check whether they are enabled */
+        for (siter = schema->parent; siter && (siter->nodetype & (LYS_USES | LYS_CHOICE)); siter = siter->parent) {
+            if (lys_is_disabled(siter, 0)) {
+                /* ignore disabled uses nodes */
+                return EXIT_SUCCESS;
             }
         }
 
-        if (!dflts_size) {
-            /* no default values to use */
-            return 0;
+        /* check augment state */
+        if (siter && siter->nodetype == LYS_AUGMENT) {
+            if (lys_is_disabled(siter, 0)) {
+                /* ignore disabled augment */
+                return EXIT_SUCCESS;
+            }
         }
 
-        /* compare the default value with the value of the leaf */
-        /* first, find the first leaf-list's sibling */
-        iter = (struct lyd_node *)node;
-        if (iter->parent) {
-            iter = iter->parent->child;
-        } else {
-            for (; iter->prev->next; iter = iter->prev);
+        /* check the node itself */
+        if (lys_is_disabled(schema, 0)) {
+            /* ignore disabled data */
+            return EXIT_SUCCESS;
         }
-        for (c = 0; iter; iter = iter->next) {
-            if (iter->schema != node->schema) {
-                continue;
+    }
+
+    /* go recursively */
+    switch (schema->nodetype) {
+    case LYS_LIST:
+        if (!subroot) {
+            /* stop recursion */
+            break;
+        }
+        /* falls through */
+    case LYS_CONTAINER:
+        if (!subroot) {
+            /* container does not exists, continue only in case of non presence container */
+            if (((struct lys_node_container *)schema)->presence) {
+                /* stop recursion */
+                break;
             }
-            if (c == dflts_size) {
-                /* to many leaf-list instances */
-                return 0;
+            /* always create empty NP container even if there is no default node,
+             * because accroding to RFC, the empty NP container is always part of
+             * accessible tree (e.g. for evaluating when and must conditions) */
+            subroot = _lyd_new(last_parent, schema, 1);
+            /* useless to set mand flag */
+            subroot->validity &= ~LYD_VAL_MAND;
+
+            if (unres->store_diff) {
+                /* remember this container in the diff */
+                if (unres_data_diff_new(unres, subroot, NULL, 1)) {
+                    goto error;
+                }
+
+                /* do not store diff for recursive calls, created values will be connected to this one */
+                storing_diff = 1;
+                unres->store_diff = 0;
             }
 
-            if (llist->flags & LYS_USERORDERED) {
-                /* we have strict order */
-                if (!ly_strequal(dflts[c], ((struct lyd_node_leaf_list *)iter)->value_str, 1)) {
-                    return 0;
+            if (!last_parent) {
+                if (*root) {
+                    lyd_insert_common((*root)->parent, root, subroot, 0);
+                } else {
+                    *root = subroot;
                 }
-            } else {
-                /* node's value is supposed to match with one of the default values */
-                for (i = 0; i < dflts_size; i++) {
-                    if (ly_strequal(dflts[i], ((struct lyd_node_leaf_list *)iter)->value_str, 1)) {
-                        break;
-                    }
+            }
+            last_parent = subroot;
+
+            /* remember the created container in unres */
+            if (check_when_must) {
+                if ((subroot->when_status & LYD_WHEN) && unres_data_add(unres, subroot, UNRES_WHEN) == -1) {
+                    goto error;
                 }
-                if (i == dflts_size) {
-                    /* values do not match */
-                    return 0;
+                if (check_when_must == 2) {
+                    i = resolve_applies_must(subroot);
+                    if ((i & 0x1) && (unres_data_add(unres, subroot, UNRES_MUST) == -1)) {
+                        goto error;
+                    }
+                    if ((i & 0x2) && (unres_data_add(unres, subroot, UNRES_MUST_INOUT) == -1)) {
+                        goto error;
+                    }
                 }
             }
-            c++;
-        }
-        if (c != dflts_size) {
-            /* different sets of leaf-list instances */
-            return 0;
+        } else if (!((struct lys_node_container *)schema)->presence) {
+            /* fix default flag on existing containers - set it on all non-presence containers and in case we will
+             * have in recursion function some non-default node, it will unset it */
+            subroot->dflt = 1;
         }
-    } else {
-        return 0;
-    }
-
-    /* all checks ok */
-    return 1;
-}
-
-int
-unres_data_diff_new(struct unres_data *unres, struct lyd_node *subtree, struct lyd_node *parent, int created)
-{
-    char *parent_xpath = NULL;
+        /* falls through */
+    case LYS_CASE:
+    case LYS_USES:
+    case LYS_INPUT:
+    case LYS_OUTPUT:
+    case LYS_NOTIF:
 
-    if (created) {
-        return lyd_difflist_add(unres->diff, &unres->diff_size, unres->diff_idx++, LYD_DIFF_CREATED, NULL, subtree);
-    } else {
-        if (parent) {
-            parent_xpath = lyd_path(parent);
-            LY_CHECK_ERR_RETURN(!parent_xpath, LOGMEM(lyd_node_module(subtree)->ctx), -1);
+        /* recursion */
+        present = ly_set_new();
+        if (!present) {
+            goto error;
         }
-        return lyd_difflist_add(unres->diff, &unres->diff_size, unres->diff_idx++, LYD_DIFF_DELETED,
-                                subtree, (struct lyd_node *)parent_xpath);
-    }
-}
-
-void
-unres_data_diff_rem(struct unres_data *unres, unsigned int idx)
-{
-    if (unres->diff->type[idx] == LYD_DIFF_DELETED) {
-        lyd_free_withsiblings(unres->diff->first[idx]);
-        free(unres->diff->second[idx]);
-    }
-
-    /* replace by last real value */
-    if (idx < unres->diff_idx - 1) {
-        unres->diff->type[idx] = unres->diff->type[unres->diff_idx - 1];
-        unres->diff->first[idx] = unres->diff->first[unres->diff_idx - 1];
-        unres->diff->second[idx] = unres->diff->second[unres->diff_idx - 1];
-    }
-
-    /* move the end */
-    assert(unres->diff->type[unres->diff_idx] == LYD_DIFF_END);
-    unres->diff->type[unres->diff_idx - 1] = unres->diff->type[unres->diff_idx];
-    --unres->diff_idx;
-}
-
-API void
-lyd_free_val_diff(struct lyd_difflist *diff)
-{
-    uint32_t i;
+        LY_TREE_FOR(schema->child, siter) {
+            if (siter->nodetype & (LYS_CHOICE | LYS_USES)) {
+                /* go into without searching for data instance */
+                if (lyd_wd_add_subtree(root, last_parent, subroot, siter, toplevel, options, unres)) {
+                    goto error;
+                }
+            } else if (siter->nodetype & (LYS_CONTAINER | LYS_LEAF | LYS_LEAFLIST | LYS_LIST | LYS_ANYDATA)) {
+                /* search for the schema node instance */
+                if (subroot && lyd_get_node_siblings(subroot->child, siter, present)) {
+                    /* there are some instances in the data root */
+                    if (siter->nodetype & LYS_LEAFLIST) {
+                        /* already have some leaflists, check that they are all
+                         * default, if not, remove the default leaflists */
+                        lyd_wd_leaflist_cleanup(present, unres);
+                    } else if (siter->nodetype != LYS_LEAF) {
+                        /* recursion */
+                        for (i = 0; i < (signed)present->number; i++) {
+                            if (lyd_wd_add_subtree(root, present->set.d[i], present->set.d[i], siter, toplevel, options,
+                                                   unres)) {
+                                goto error;
+                            }
+                        }
+                    } /* else LYS_LEAF - nothing to do */
 
-    if (!diff) {
-        return;
-    }
+                    /* fix default flag (2nd part) - for non-default node with default parent, unset the default flag
+                     * from the parents (starting from subroot node) */
+                    if (subroot->dflt) {
+                        for (i = 0; i < (signed)present->number; i++) {
+                            if (!present->set.d[i]->dflt) {
+                                for (iter = subroot; iter && iter->dflt; iter = iter->parent) {
+                                    iter->dflt = 0;
+                                }
+                                break;
+                            }
+                        }
+                    }
+                    ly_set_clean(present);
+                } else {
+                    /* no instance */
+                    if (lyd_wd_add_subtree(root, last_parent, NULL, siter, toplevel, options, unres)) {
+                        goto error;
+                    }
+                }
+            }
+        }
 
-    for (i = 0; diff->type[i] != LYD_DIFF_END; ++i) {
-        switch (diff->type[i]) {
-        case LYD_DIFF_CREATED:
-            free(diff->first[i]);
-            lyd_free_withsiblings(diff->second[i]);
-            break;
-        case LYD_DIFF_DELETED:
-            lyd_free_withsiblings(diff->first[i]);
-            free(diff->second[i]);
-            break;
-        default:
-            /* what to do? */
-            break;
+        if (storing_diff) {
+            /* continue generating the diff in functions above this one */
+            unres->store_diff = 1;
+        }
+        break;
+    case LYS_LEAF:
+    case LYS_LEAFLIST:
+        if (subroot) {
+            /* default shortcase of a choice */
+            present = ly_set_new();
+            if (!present) {
+                goto error;
+            }
+            lyd_get_node_siblings(subroot->child, schema, present);
+            if (present->number) {
+                /* the shortcase leaf(-list) exists, stop the processing */
+                break;
+            }
+        }
+        if (schema->nodetype == LYS_LEAF) {
+            if (lyd_wd_add_leaf(root, last_parent, (struct lys_node_leaf*)schema, unres, check_when_must)) {
+                return EXIT_FAILURE;
+            }
+        } else { /* LYS_LEAFLIST */
+            if (lyd_wd_add_leaflist(root, last_parent, (struct lys_node_leaflist*)schema, unres, check_when_must)) {
+                goto error;
+            }
+        }
+        break;
+    case LYS_CHOICE:
+        /* get existing node in the data root from the choice */
+        iter = NULL;
+        if ((toplevel && (*root)) || (!toplevel && subroot)) {
+            LY_TREE_FOR(toplevel ? (*root) : subroot->child, iter) {
+                for (siter = lys_parent(iter->schema), siter_prev = iter->schema;
+                        siter && (siter->nodetype & (LYS_CASE | LYS_USES | LYS_CHOICE));
+                        siter_prev = siter, siter = lys_parent(siter)) {
+                    if (siter == schema) {
+                        /* we have the choice instance */
+                        break;
+                    }
+                }
+                if (siter == schema) {
+                    /* we have the choice instance;
+                     * the condition must be the same as in the loop because of
+                     * choice's sibling nodes that break the loop, so siter is not NULL,
+                     * but it is not the same as schema */
+                    break;
+                }
+            }
+        }
+        if (!iter) {
+            if (((struct lys_node_choice *)schema)->dflt) {
+                /* there is a default case */
+                if (lyd_wd_add_subtree(root, last_parent, subroot, ((struct lys_node_choice *)schema)->dflt,
+                                       toplevel, options, unres)) {
+                    goto error;
+                }
+            }
+        } else {
+            /* one of the choice's cases is instantiated, continue into this case */
+            /* since iter != NULL, siter must be also != NULL and we also know siter_prev
+             * which points to the child of schema leading towards the instantiated data */
+            assert(siter && siter_prev);
+            if (lyd_wd_add_subtree(root, last_parent, subroot, siter_prev, toplevel, options, unres)) {
+                goto error;
+            }
         }
+        break;
+    default:
+        /* LYS_ANYXML, LYS_ANYDATA, LYS_USES, LYS_GROUPING - do nothing */
+        break;
     }
 
-    lyd_free_diff(diff);
+    ly_set_free(present);
+    return EXIT_SUCCESS;
+
+error:
+    ly_set_free(present);
+    return EXIT_FAILURE;
 }
 
+/**
+ * @brief Covering function to process (add/clean) default nodes in the data tree
+ * @param[in,out] root Pointer to the root node of the complete data tree, the root node can be NULL if the data tree
+ *                     is empty
+ * @param[in] ctx      Context for the case the data tree is empty (in that case \p ctx must not be NULL)
+ * @param[in] options  Parser options to know the data tree type, see @ref parseroptions.
+ * @param[in] unres    Unresolved data list, the newly added default nodes may need to add some unresolved items
+ * @return EXIT_SUCCESS or EXIT_FAILURE
+ */
 static int
-lyd_wd_add_leaf(struct lyd_node **tree, struct lyd_node *last_parent, struct lys_node_leaf *leaf, struct unres_data *unres,
-                int check_when_must)
+lyd_wd_add(struct lyd_node **root, struct ly_ctx *ctx, const struct lys_module **modules, int mod_count,
+           struct unres_data *unres, int options)
 {
-    struct lyd_node *dummy = NULL, *current;
-    struct lys_tpdf *tpdf;
-    const char *dflt = NULL;
-    int ret;
+    struct lys_node *siter;
+    int i;
 
-    /* get know if there is a default value */
-    if (leaf->dflt) {
-        /* leaf has a default value */
-        dflt = leaf->dflt;
-    } else if (!(leaf->flags & LYS_MAND_TRUE)) {
-        /* get the default value from the type */
-        for (tpdf = leaf->type.der; tpdf && !dflt; tpdf = tpdf->type.der) {
-            dflt = tpdf->dflt;
-        }
-    }
-    if (!dflt) {
-        /* no default value */
-        return EXIT_SUCCESS;
-    }
+    assert(root && !(options & LYD_OPT_ACT_NOTIF));
+    assert(*root || ctx);
+    assert(!(options & LYD_OPT_NOSIBLINGS) || *root);
 
-    /* create the node */
-    if (!(dummy = lyd_new_dummy(*tree, last_parent, (struct lys_node*)leaf, dflt, 1))) {
-        goto error;
+    if (options & (LYD_OPT_EDIT | LYD_OPT_GET | LYD_OPT_GETCONFIG)) {
+        /* no change supposed */
+        return EXIT_SUCCESS;
     }
 
-    if (unres->store_diff) {
-        /* remember this subtree in the diff */
-        if (unres_data_diff_new(unres, dummy, NULL, 1)) {
-            goto error;
-        }
+    if (!ctx) {
+        ctx = (*root)->schema->module->ctx;
     }
 
-    if (!dummy->parent && (*tree)) {
-        /* connect dummy nodes into the data tree (at the end of top level nodes) */
-        if (lyd_insert_sibling(tree, dummy)) {
-            goto error;
-        }
-    }
-    for (current = dummy; ; current = current->child) {
-        /* remember the created data in unres */
-        if (check_when_must) {
-            if ((current->when_status & LYD_WHEN) && unres_data_add(unres, current, UNRES_WHEN) == -1) {
-                goto error;
+    if (!(options & LYD_OPT_TYPEMASK) || (options & LYD_OPT_CONFIG)) {
+        if (options & LYD_OPT_NOSIBLINGS) {
+            if (lyd_wd_add_subtree(root, NULL, NULL, (*root)->schema, 1, options, unres)) {
+                return EXIT_FAILURE;
             }
-            if (check_when_must == 2) {
-                ret = resolve_applies_must(current);
-                if ((ret & 0x1) && (unres_data_add(unres, current, UNRES_MUST) == -1)) {
-                    goto error;
+        } else if (modules && mod_count) {
+            for (i = 0; i < mod_count; ++i) {
+                LY_TREE_FOR(modules[i]->data, siter) {
+                    if (!(siter->nodetype & (LYS_CONTAINER | LYS_CHOICE | LYS_LEAF | LYS_LEAFLIST | LYS_LIST | LYS_ANYDATA |
+                                             LYS_USES))) {
+                        continue;
+                    }
+                    if (lyd_wd_add_subtree(root, NULL, NULL, siter, 1, options, unres)) {
+                        return EXIT_FAILURE;
+                    }
                 }
-                if ((ret & 0x2) && (unres_data_add(unres, current, UNRES_MUST_INOUT) == -1)) {
-                    goto error;
+            }
+        } else {
+            for (i = 0; i < ctx->models.used; i++) {
+                /* skip not implemented and disabled modules */
+                if (!ctx->models.list[i]->implemented || ctx->models.list[i]->disabled) {
+                    continue;
+                }
+                LY_TREE_FOR(ctx->models.list[i]->data, siter) {
+                    if (!(siter->nodetype & (LYS_CONTAINER | LYS_CHOICE | LYS_LEAF | LYS_LEAFLIST | LYS_LIST | LYS_ANYDATA |
+                                             LYS_USES))) {
+                        continue;
+                    }
+                    if (lyd_wd_add_subtree(root, NULL, NULL, siter, 1, options, unres)) {
+                        return EXIT_FAILURE;
+                    }
                 }
             }
         }
-
-        /* clear dummy-node flag */
-        current->validity &= ~LYD_VAL_INUSE;
-
-        if (current->schema == (struct lys_node *)leaf) {
-            break;
+    } else if (options & LYD_OPT_NOTIF) {
+        if (!(*root) || ((*root)->schema->nodetype != LYS_NOTIF)) {
+            LOGERR(ctx, LY_EINVAL, "Subtree is not a single notification.");
+            return EXIT_FAILURE;
         }
-    }
-    /* update parent's default flag if needed */
-    lyd_wd_update_parents(dummy);
-
-    /* if necessary, remember the created data value in unres */
-    if (((struct lyd_node_leaf_list *)current)->value_type == LY_TYPE_LEAFREF) {
-        if (unres_data_add(unres, current, UNRES_LEAFREF)) {
-            goto error;
+        if (lyd_wd_add_subtree(root, *root, *root, (*root)->schema, 0, options, unres)) {
+            return EXIT_FAILURE;
         }
-    } else if (((struct lyd_node_leaf_list *)current)->value_type == LY_TYPE_INST) {
-        if (unres_data_add(unres, current, UNRES_INSTID)) {
-            goto error;
+    } else if (options & (LYD_OPT_RPC | LYD_OPT_RPCREPLY)) {
+        if (!(*root) || !((*root)->schema->nodetype & (LYS_RPC | LYS_ACTION))) {
+            LOGERR(ctx, LY_EINVAL, "Subtree is not a single RPC/action/reply.");
+            return EXIT_FAILURE;
+        }
+        if (options & LYD_OPT_RPC) {
+            for (siter = (*root)->schema->child; siter && siter->nodetype != LYS_INPUT; siter = siter->next);
+        } else { /* LYD_OPT_RPCREPLY */
+            for (siter = (*root)->schema->child; siter && siter->nodetype != LYS_OUTPUT; siter = siter->next);
+        }
+        if (siter) {
+            if (lyd_wd_add_subtree(root, *root, *root, siter, 0, options, unres)) {
+                return EXIT_FAILURE;
+            }
+        }
+    } else if (options & LYD_OPT_DATA_TEMPLATE) {
+        if (lyd_wd_add_subtree(root, NULL, NULL, (*root)->schema, 1, options, unres)) {
+            return EXIT_FAILURE;
         }
+    } else {
+        LOGINT(ctx);
+        return EXIT_FAILURE;
     }
 
-    if (!(*tree)) {
-        *tree = dummy;
-    }
     return EXIT_SUCCESS;
-
-error:
-    lyd_free(dummy);
-    return EXIT_FAILURE;
 }
 
-static int
-lyd_wd_add_leaflist(struct lyd_node **tree, struct lyd_node *last_parent, struct lys_node_leaflist *llist,
-                    struct unres_data *unres, int check_when_must)
+int
+lyd_defaults_add_unres(struct lyd_node **root, int options, struct ly_ctx *ctx, const struct lys_module **modules,
+                       int mod_count, const struct lyd_node *data_tree, struct lyd_node *act_notif,
+                       struct unres_data *unres, int wd)
 {
-    struct lyd_node *dummy, *current, *first = NULL;
-    struct lys_tpdf *tpdf;
-    const char **dflt = NULL;
-    uint8_t dflt_size = 0;
-    int i, ret;
+    struct lyd_node *msg_sibling = NULL, *msg_parent = NULL, *data_tree_sibling, *data_tree_parent;
+    struct lys_node *msg_op = NULL;
+    struct ly_set *set;
+    int ret = EXIT_FAILURE;
 
-    if (llist->module->version < LYS_VERSION_1_1) {
-        /* default values on leaf-lists are allowed from YANG 1.1 */
-        return EXIT_SUCCESS;
+    assert(root && (*root || ctx) && unres && !(options & LYD_OPT_ACT_NOTIF));
+
+    if (!ctx) {
+        ctx = (*root)->schema->module->ctx;
     }
 
-    /* get know if there is a default value */
-    if (llist->dflt_size) {
-        /* there are default values */
-        dflt_size = llist->dflt_size;
-        dflt = llist->dflt;
-    } else if (!llist->min) {
-        /* get the default value from the type */
-        for (tpdf = llist->type.der; tpdf && !dflt; tpdf = tpdf->type.der) {
-            if (tpdf->dflt) {
-                dflt = &tpdf->dflt;
-                dflt_size = 1;
-                break;
-            }
+    if ((options & LYD_OPT_NOSIBLINGS) && !(*root)) {
+        LOGERR(ctx, LY_EINVAL, "Cannot add default values for one module (LYD_OPT_NOSIBLINGS) without any data.");
+        return EXIT_FAILURE;
+    }
+
+    if (options & (LYD_OPT_RPC | LYD_OPT_RPCREPLY | LYD_OPT_NOTIF)) {
+        if (!(*root)) {
+            LOGERR(ctx, LY_EINVAL, "Cannot add default values to RPC, RPC reply, and notification without at least the empty container.");
+            return EXIT_FAILURE;
+        }
+        if ((options & LYD_OPT_RPC) && !act_notif && ((*root)->schema->nodetype != LYS_RPC)) {
+            LOGERR(ctx, LY_EINVAL, "Not valid RPC/action data.");
+            return EXIT_FAILURE;
+        }
+        if ((options & LYD_OPT_RPCREPLY) && !act_notif && ((*root)->schema->nodetype != LYS_RPC)) {
+            LOGERR(ctx, LY_EINVAL, "Not valid reply data.");
+            return EXIT_FAILURE;
+        }
+        if ((options & LYD_OPT_NOTIF) && !act_notif && ((*root)->schema->nodetype != LYS_NOTIF)) {
+            LOGERR(ctx, LY_EINVAL, "Not valid notification data.");
+            return EXIT_FAILURE;
+        }
+
+        /* remember the operation/notification schema */
+        msg_op = act_notif ? act_notif->schema : (*root)->schema;
+
+        /* nothing in the message can reference the data tree, do not link it there at all */
+        if (data_tree && !lys_op_ext_deps(ctx, msg_op, options & LYD_OPT_RPCREPLY)) {
+            data_tree = NULL;
         }
+    } else if (*root && (*root)->parent) {
+        /* we have inner node, so it will be considered as
+         * a root of subtree where to add default nodes and
+         * no of its siblings will be affected */
+        options |= LYD_OPT_NOSIBLINGS;
     }
 
-    if (!dflt_size) {
-        /* no default values to use */
-        return EXIT_SUCCESS;
+    /* add missing default nodes */
+    if (wd && lyd_wd_add((act_notif ? &act_notif : root), ctx, modules, mod_count, unres, options)) {
+        return EXIT_FAILURE;
     }
 
-    for (i = 0; i < dflt_size; i++) {
-        /* create the node */
-        if (!(dummy = lyd_new_dummy(*tree, last_parent, (struct lys_node*)llist, dflt[i], 1))) {
-            goto error;
+    /* check leafrefs and/or instids if any */
+    if (unres && unres->count) {
+        if (!(*root)) {
+            LOGINT(ctx);
+            return EXIT_FAILURE;
         }
 
-        if (unres->store_diff) {
-            /* remember this subtree in the diff */
-            if (unres_data_diff_new(unres, dummy, NULL, 1)) {
-                goto error;
-            }
-        }
+        /* temporarily link the additional data tree to the RPC/action/notification */
+        if (data_tree && (options & (LYD_OPT_RPC | LYD_OPT_RPCREPLY | LYD_OPT_NOTIF))) {
+            /* duplicate the message tree - if it gets deleted we would not be able to positively identify it */
+            msg_parent = NULL;
+            msg_sibling = *root;
 
-        if (!first) {
-            first = dummy;
-        } else if (!dummy->parent) {
-            /* interconnect with the rest of leaf-lists */
-            first->prev->next = dummy;
-            dummy->prev = first->prev;
-            first->prev = dummy;
-        }
+            if (act_notif) {
+                /* fun case */
+                data_tree_parent = NULL;
+                data_tree_sibling = (struct lyd_node *)data_tree;
+                while (data_tree_sibling) {
+                    while (data_tree_sibling) {
+                        if ((data_tree_sibling->schema == msg_sibling->schema)
+                                && ((msg_sibling->schema->nodetype != LYS_LIST)
+                                    || lyd_list_equal(data_tree_sibling, msg_sibling, 0))) {
+                            /* match */
+                            break;
+                        }
 
-        for (current = dummy; ; current = current->child) {
-            /* remember the created data in unres */
-            if (check_when_must) {
-                if ((current->when_status & LYD_WHEN) && unres_data_add(unres, current, UNRES_WHEN) == -1) {
-                    goto error;
-                }
-                if (check_when_must == 2) {
-                    ret = resolve_applies_must(current);
-                    if ((ret & 0x1) && (unres_data_add(unres, current, UNRES_MUST) == -1)) {
-                        goto error;
+                        data_tree_sibling = data_tree_sibling->next;
                     }
-                    if ((ret & 0x2) && (unres_data_add(unres, current, UNRES_MUST_INOUT) == -1)) {
-                        goto error;
+
+                    if (data_tree_sibling) {
+                        /* prepare for the new data_tree iteration */
+                        data_tree_parent = data_tree_sibling;
+                        data_tree_sibling = data_tree_sibling->child;
+
+                        /* find new action sibling to search for later (skip list keys) */
+                        msg_parent = msg_sibling;
+                        assert(msg_sibling->child);
+                        for (msg_sibling = msg_sibling->child;
+                                msg_sibling->schema->nodetype == LYS_LEAF;
+                                msg_sibling = msg_sibling->next) {
+                            assert(msg_sibling->next);
+                        }
+                        if (msg_sibling->schema->nodetype & (LYS_ACTION | LYS_NOTIF)) {
+                            /* we are done */
+                            assert(act_notif->parent);
+                            assert(act_notif->parent->schema == data_tree_parent->schema);
+                            assert(msg_sibling == act_notif);
+                            break;
+                        }
                     }
                 }
-            }
 
-            /* clear dummy-node flag */
-            current->validity &= ~LYD_VAL_INUSE;
+                /* loop ended after the first iteration, set the values correctly */
+                if (!data_tree_parent) {
+                    data_tree_sibling = (struct lyd_node *)data_tree;
+                }
 
-            if (current->schema == (struct lys_node *)llist) {
-                break;
+            } else {
+                /* easy case */
+                data_tree_parent = NULL;
+                data_tree_sibling = (struct lyd_node *)data_tree;
             }
-        }
 
-        /* if necessary, remember the created data value in unres */
-        if (((struct lyd_node_leaf_list *)current)->value_type == LY_TYPE_LEAFREF) {
-            if (unres_data_add(unres, current, UNRES_LEAFREF)) {
-                goto error;
-            }
-        } else if (((struct lyd_node_leaf_list *)current)->value_type == LY_TYPE_INST) {
-            if (unres_data_add(unres, current, UNRES_INSTID)) {
-                goto error;
+            /* unlink msg_sibling if needed (won't do anything otherwise) */
+            lyd_unlink_internal(msg_sibling, 0);
+
+            /* now we can insert msg_sibling into data_tree_parent or next to data_tree_sibling */
+            assert(data_tree_parent || data_tree_sibling);
+            if (data_tree_parent) {
+                if (lyd_insert_common(data_tree_parent, NULL, msg_sibling, 0)) {
+                    goto unlink_datatree;
+                }
+            } else {
+                assert(!data_tree_sibling->parent);
+                if (lyd_insert_nextto(data_tree_sibling->prev, msg_sibling, 0, 0)) {
+                    goto unlink_datatree;
+                }
             }
         }
-    }
 
-    /* insert into the tree */
-    if (first && !first->parent && (*tree)) {
-        /* connect dummy nodes into the data tree (at the end of top level nodes) */
-        if (lyd_insert_sibling(tree, first)) {
-            goto error;
+        if (resolve_unres_data(ctx, unres, root, options)) {
+            goto unlink_datatree;
         }
-    } else if (!(*tree)) {
-        *tree = first;
-    }
-
-    /* update parent's default flag if needed */
-    lyd_wd_update_parents(first);
-
-    return EXIT_SUCCESS;
 
-error:
-    lyd_free_withsiblings(first);
-    return EXIT_FAILURE;
-}
-
-static void
-lyd_wd_leaflist_cleanup(struct ly_set *set, struct unres_data *unres)
-{
-    unsigned int i;
-
-    assert(set);
+        /* we are done */
+        ret = EXIT_SUCCESS;
 
-    /* if there is an instance without the dflt flag, we have to
-     * remove all instances with the flag - an instance could be
-     * explicitely added, so the default leaflists were invalidated */
-    for (i = 0; i < set->number; i++) {
-        if (!set->set.d[i]->dflt) {
-            break;
+        /* check that the operation/notification tree was not removed */
+        if (options & (LYD_OPT_RPC | LYD_OPT_RPCREPLY | LYD_OPT_NOTIF)) {
+            set = NULL;
+            if (data_tree) {
+                set = lyd_find_instance(data_tree_parent ? data_tree_parent : data_tree_sibling, msg_op);
+                assert(set && ((set->number == 0) || (set->number == 1)));
+            } else if (*root) {
+                set = lyd_find_instance(*root, msg_op);
+                assert(set && ((set->number == 0) || (set->number == 1)));
+            }
+            if (!set || !set->number) {
+                /* it was removed, handle specially */
+                LOGVAL(ctx, LYE_SPEC, LY_VLOG_LYS, msg_op, "Operation/notification not supported because of the current configuration.");
+                ret = EXIT_FAILURE;
+            }
+            ly_set_free(set);
         }
-    }
-    if (i < set->number) {
-        for (i = 0; i < set->number; i++) {
-            if (set->set.d[i]->dflt) {
-                /* remove this default instance */
-                if (unres->store_diff) {
-                    /* just move it to diff if is being generated */
-                    unres_data_diff_new(unres, set->set.d[i], set->set.d[i]->parent, 0);
-                    lyd_unlink(set->set.d[i]);
-                } else {
-                    lyd_free(set->set.d[i]);
-                }
+
+unlink_datatree:
+        /* put the trees back in order */
+        if (data_tree && (options & (LYD_OPT_RPC | LYD_OPT_RPCREPLY | LYD_OPT_NOTIF))) {
+            /* unlink and insert it back, if there is a parent  */
+            lyd_unlink_internal(msg_sibling, 0);
+            if (msg_parent) {
+                lyd_insert_common(msg_parent, NULL, msg_sibling, 0);
             }
         }
+    } else {
+        /* we are done */
+        ret = EXIT_SUCCESS;
     }
+
+    return ret;
 }
 
-/**
- * @brief Process (add/clean flags) default nodes in the schema subtree
- *
- * @param[in,out] root Pointer to the root node of the complete data tree, the root node can be NULL if the data tree
- *                     is empty
- * @param[in] last_parent The closest parent in the data tree to the currently processed \p schema node
- * @param[in] subroot  The root node of a data subtree, the node is instance of the \p schema node, NULL in case the
- *                     schema node is not instantiated in the data tree
- * @param[in] schema The schema node to be processed
- * @param[in] toplevel Flag for processing top level schema nodes when \p last_parent and \p subroot are consider as
- *                     unknown
- * @param[in] options  Parser options to know the data tree type, see @ref parseroptions.
- * @param[in] unres    Unresolved data list, the newly added default nodes may need to add some unresolved items
- * @return EXIT_SUCCESS or EXIT_FAILURE
- */
-static int
-lyd_wd_add_subtree(struct lyd_node **root, struct lyd_node *last_parent, struct lyd_node *subroot,
-                   struct lys_node *schema, int toplevel, int options, struct unres_data *unres)
+API struct lys_module *
+lyd_node_module(const struct lyd_node *node)
 {
-    struct ly_set *present = NULL;
-    struct lys_node *siter, *siter_prev;
-    struct lyd_node *iter;
-    int i, check_when_must, storing_diff = 0;
-
-    assert(root);
-
-    if ((options & LYD_OPT_TYPEMASK) && (schema->flags & LYS_CONFIG_R)) {
-        /* non LYD_OPT_DATA tree, status data are not expected here */
-        return EXIT_SUCCESS;
-    }
-
-    if (options & (LYD_OPT_NOTIF_FILTER | LYD_OPT_EDIT | LYD_OPT_GET | LYD_OPT_GETCONFIG)) {
-        check_when_must = 0; /* check neither */
-    } else if (options & LYD_OPT_TRUSTED) {
-        check_when_must = 1; /* check only when */
-    } else {
-        check_when_must = 2; /* check both when and must */
+    if (!node) {
+        return NULL;
     }
 
-    if (toplevel && (schema->nodetype & (LYS_LEAF | LYS_LIST | LYS_LEAFLIST | LYS_CONTAINER))) {
-        /* search for the schema node instance */
-        present = ly_set_new();
-        if (!present) {
-            goto error;
-        }
-        if ((*root) && lyd_get_node_siblings(*root, schema, present)) {
-            /* there are some instances */
-            for (i = 0; i < (signed)present->number; i++) {
-                if (schema->nodetype & LYS_LEAFLIST) {
-                    lyd_wd_leaflist_cleanup(present, unres);
-                } else if (schema->nodetype != LYS_LEAF) {
-                    if (lyd_wd_add_subtree(root, present->set.d[i], present->set.d[i], schema, 0, options, unres)) {
-                        goto error;
-                    }
-                } /* else LYS_LEAF - nothing to do */
-            }
-        } else {
-            /* no instance */
-            if (lyd_wd_add_subtree(root, last_parent, NULL, schema, 0, options, unres)) {
-                goto error;
-            }
-        }
+    return node->schema->module->type ? ((struct lys_submodule *)node->schema->module)->belongsto : node->schema->module;
+}
 
-        ly_set_free(present);
-        return EXIT_SUCCESS;
+API double
+lyd_dec64_to_double(const struct lyd_node *node)
+{
+    if (!node || !(node->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST))
+            || (((struct lys_node_leaf *)node->schema)->type.base != LY_TYPE_DEC64)) {
+        LOGARG;
+        return 0;
     }
 
-    /* skip disabled parts of schema */
-    if (!subroot) {
-        /* go through all the uses and check whether they are enabled */
-        for (siter = schema->parent; siter && (siter->nodetype & (LYS_USES | LYS_CHOICE)); siter = siter->parent) {
-            if (lys_is_disabled(siter, 0)) {
-                /* ignore disabled uses nodes */
-                return EXIT_SUCCESS;
-            }
-        }
+    return atof(((struct lyd_node_leaf_list *)node)->value_str);
+}
 
-        /* check augment state */
-        if (siter && siter->nodetype == LYS_AUGMENT) {
-            if (lys_is_disabled(siter, 0)) {
-                /* ignore disabled augment */
-                return EXIT_SUCCESS;
+static size_t
+lyd_xml_mem_usage(struct ly_ctx *ctx, const struct lyxml_elem *xml)
+{
+    const struct lyxml_elem *elem;
+    const struct lyxml_attr *attr;
+    size_t size = 0;
+
+    LY_TREE_FOR(xml, elem) {
+        size += sizeof *elem + lydict_val_mem_size(ctx, elem->name) + lydict_val_mem_size(ctx, elem->content);
+        for (attr = elem->attr; attr; attr = attr->next) {
+            if (attr->type == LYXML_ATTR_NS) {
+                size += sizeof(struct lyxml_ns) + lydict_val_mem_size(ctx, ((struct lyxml_ns *)attr)->prefix)
+                        + lydict_val_mem_size(ctx, ((struct lyxml_ns *)attr)->value);
+            } else {
+                size += sizeof *attr + lydict_val_mem_size(ctx, attr->name) + lydict_val_mem_size(ctx, attr->value);
             }
         }
+        size += lyd_xml_mem_usage(ctx, elem->child);
+    }
 
-        /* check the node itself */
-        if (lys_is_disabled(schema, 0)) {
-            /* ignore disabled data */
-            return EXIT_SUCCESS;
+    return size;
+}
+
+/* memory of the value not counting value_str */
+static size_t
+lyd_value_mem_usage(struct ly_ctx *ctx, lyd_val value, LY_DATA_TYPE value_type, uint8_t value_flags)
+{
+    if (value_flags & LY_VALUE_USER) {
+        /* opaque for us */
+        return 0;
+    }
+
+    switch (value_type) {
+    case LY_TYPE_BITS:
+        return value.bit ? lyd_bits_mem_size(value.bit) : 0;
+    case LY_TYPE_INST:
+        if (!(value_flags & LY_VALUE_UNRES)) {
+            return 0;
         }
+        /* fallthrough */
+    case LY_TYPE_UNION:
+        return lydict_val_mem_size(ctx, value.string);
+    default:
+        return 0;
     }
+}
 
-    /* go recursively */
-    switch (schema->nodetype) {
-    case LYS_LIST:
-        if (!subroot) {
-            /* stop recursion */
+static size_t
+lyd_node_mem_usage(const struct lyd_node *node)
+{
+    struct ly_ctx *ctx = node->schema->module->ctx;
+    const struct lyd_node_leaf_list *leaf;
+    const struct lyd_node_anydata *any;
+    const struct lyd_attr *attr;
+    size_t size;
+
+    switch (node->schema->nodetype) {
+    case LYS_LEAF:
+    case LYS_LEAFLIST:
+        leaf = (const struct lyd_node_leaf_list *)node;
+        if (leaf->value_flags & LY_VALUE_PRIVATE) {
+            size = sizeof *leaf + strlen(leaf->value_str) + 1;
+        } else {
+            size = sizeof *leaf + lydict_val_mem_size(ctx, leaf->value_str);
+        }
+        size += lyd_value_mem_usage(ctx, leaf->value, leaf->value_type, leaf->value_flags);
+        break;
+    case LYS_ANYDATA:
+    case LYS_ANYXML:
+        any = (const struct lyd_node_anydata *)node;
+        size = sizeof *any;
+        switch (any->value_type) {
+        case LYD_ANYDATA_CONSTSTRING:
+        case LYD_ANYDATA_SXML:
+        case LYD_ANYDATA_JSON:
+            size += lydict_val_mem_size(ctx, any->value.str);
+            break;
+        case LYD_ANYDATA_DATATREE:
+            size += any->value.tree ? lyd_mem_usage(any->value.tree, LYD_MEM_WITHSIBLINGS) : 0;
+            break;
+        case LYD_ANYDATA_XML:
+            size += lyd_xml_mem_usage(ctx, any->value.xml);
+            break;
+        case LYD_ANYDATA_LYB:
+            size += any->value.mem ? (size_t)lyd_lyb_data_length(any->value.mem) : 0;
+            break;
+        default:
             break;
         }
-        /* falls through */
-    case LYS_CONTAINER:
-        if (!subroot) {
-            /* container does not exists, continue only in case of non presence container */
-            if (((struct lys_node_container *)schema)->presence) {
-                /* stop recursion */
-                break;
-            }
-            /* always create empty NP container even if there is no default node,
-             * because accroding to RFC, the empty NP container is always part of
-             * accessible tree (e.g. for evaluating when and must conditions) */
-            subroot = _lyd_new(last_parent, schema, 1);
-            /* useless to set mand flag */
-            subroot->validity &= ~LYD_VAL_MAND;
-
-            if (unres->store_diff) {
-                /* remember this container in the diff */
-                if (unres_data_diff_new(unres, subroot, NULL, 1)) {
-                    goto error;
-                }
+        break;
+    default:
+        size = sizeof *node;
+#ifdef LY_ENABLED_CACHE
+        size += lyht_mem_size(node->ht);
+#endif
+        break;
+    }
 
-                /* do not store diff for recursive calls, created values will be connected to this one */
-                storing_diff = 1;
-                unres->store_diff = 0;
-            }
+    for (attr = node->attr; attr; attr = attr->next) {
+        size += sizeof *attr + lydict_val_mem_size(ctx, attr->name) + lydict_val_mem_size(ctx, attr->value_str);
+        size += lyd_value_mem_usage(ctx, attr->value, attr->value_type, attr->value_flags);
+    }
 
-            if (!last_parent) {
-                if (*root) {
-                    lyd_insert_common((*root)->parent, root, subroot, 0);
-                } else {
-                    *root = subroot;
-                }
-            }
-            last_parent = subroot;
+    return size;
+}
 
-            /* remember the created container in unres */
-            if (check_when_must) {
-                if ((subroot->when_status & LYD_WHEN) && unres_data_add(unres, subroot, UNRES_WHEN) == -1) {
-                    goto error;
-                }
-                if (check_when_must == 2) {
-                    i = resolve_applies_must(subroot);
-                    if ((i & 0x1) && (unres_data_add(unres, subroot, UNRES_MUST) == -1)) {
-                        goto error;
-                    }
-                    if ((i & 0x2) && (unres_data_add(unres, subroot, UNRES_MUST_INOUT) == -1)) {
-                        goto error;
-                    }
-                }
-            }
-        } else if (!((struct lys_node_container *)schema)->presence) {
-            /* fix default flag on existing containers - set it on all non-presence containers and in case we will
-             * have in recursion function some non-default node, it will unset it */
-            subroot->dflt = 1;
-        }
-        /* falls through */
-    case LYS_CASE:
-    case LYS_USES:
-    case LYS_INPUT:
-    case LYS_OUTPUT:
-    case LYS_NOTIF:
+API size_t
+lyd_mem_usage(const struct lyd_node *node, int options)
+{
+    const struct lyd_node *start, *elem, *next;
+    size_t size = 0;
 
-        /* recursion */
-        present = ly_set_new();
-        if (!present) {
-            goto error;
-        }
-        LY_TREE_FOR(schema->child, siter) {
-            if (siter->nodetype & (LYS_CHOICE | LYS_USES)) {
-                /* go into without searching for data instance */
-                if (lyd_wd_add_subtree(root, last_parent, subroot, siter, toplevel, options, unres)) {
-                    goto error;
-                }
-            } else if (siter->nodetype & (LYS_CONTAINER | LYS_LEAF | LYS_LEAFLIST | LYS_LIST | LYS_ANYDATA)) {
-                /* search for the schema node instance */
-                if (subroot && lyd_get_node_siblings(subroot->child, siter, present)) {
-                    /* there are some instances in the data root */
-                    if (siter->nodetype & LYS_LEAFLIST) {
-                        /* already have some leaflists, check that they are all
-                         * default, if not, remove the default leaflists */
-                        lyd_wd_leaflist_cleanup(present, unres);
-                    } else if (siter->nodetype != LYS_LEAF) {
-                        /* recursion */
-                        for (i = 0; i < (signed)present->number; i++) {
-                            if (lyd_wd_add_subtree(root, present->set.d[i], present->set.d[i], siter, toplevel, options,
-                                                   unres)) {
-                                goto error;
-                            }
-                        }
-                    } /* else LYS_LEAF - nothing to do */
+    if (!node) {
+        LOGARG;
+        return 0;
+    }
 
-                    /* fix default flag (2nd part) - for non-default node with default parent, unset the default flag
-                     * from the parents (starting from subroot node) */
-                    if (subroot->dflt) {
-                        for (i = 0; i < (signed)present->number; i++) {
-                            if (!present->set.d[i]->dflt) {
-                                for (iter = subroot; iter && iter->dflt; iter = iter->parent) {
-                                    iter->dflt = 0;
-                                }
-                                break;
-                            }
-                        }
-                    }
-                    ly_set_clean(present);
-                } else {
-                    /* no instance */
-                    if (lyd_wd_add_subtree(root, last_parent, NULL, siter, toplevel, options, unres)) {
-                        goto error;
-                    }
-                }
-            }
-        }
+    if (options & LYD_MEM_WITHSIBLINGS) {
+        for (start = node; start->prev->next; start = start->prev);
+    } else {
+        start = node;
+    }
 
-        if (storing_diff) {
-            /* continue generating the diff in functions above this one */
-            unres->store_diff = 1;
-        }
-        break;
-    case LYS_LEAF:
-    case LYS_LEAFLIST:
-        if (subroot) {
-            /* default shortcase of a choice */
-            present = ly_set_new();
-            if (!present) {
-                goto error;
-            }
-            lyd_get_node_siblings(subroot->child, schema, present);
-            if (present->number) {
-                /* the shortcase leaf(-list) exists, stop the processing */
-                break;
-            }
+    for (; start; start = start->next) {
+        LY_TREE_DFS_BEGIN(start, next, elem) {
+            size += lyd_node_mem_usage(elem);
+            LY_TREE_DFS_END(start, next, elem);
         }
-        if (schema->nodetype == LYS_LEAF) {
-            if (lyd_wd_add_leaf(root, last_parent, (struct lys_node_leaf*)schema, unres, check_when_must)) {
-                return EXIT_FAILURE;
-            }
-        } else { /* LYS_LEAFLIST */
-            if (lyd_wd_add_leaflist(root, last_parent, (struct lys_node_leaflist*)schema, unres, check_when_must)) {
-                goto error;
-            }
+        if (!(options & LYD_MEM_WITHSIBLINGS)) {
+            break;
         }
-        break;
-    case LYS_CHOICE:
-        /* get existing node in the data root from the choice */
-        iter = NULL;
-        if ((toplevel && (*root)) || (!toplevel && subroot)) {
-            LY_TREE_FOR(toplevel ? (*root) : subroot->child, iter) {
-                for (siter = lys_parent(iter->schema), siter_prev = iter->schema;
-                        siter && (siter->nodetype & (LYS_CASE | LYS_USES | LYS_CHOICE));
-                        siter_prev = siter, siter = lys_parent(siter)) {
-                    if (siter == schema) {
-                        /* we have the choice instance */
-                        break;
-                    }
-                }
-                if (siter == schema) {
-                    /* we have the choice instance;
-                     * the condition must be the same as in the loop because of
-                     * choice's sibling nodes that break the loop, so siter is not NULL,
-                     * but it is not the same as schema */
-                    break;
-                }
-            }
+    }
+
+    return size;
+}
+
+API int
+lyd_bit_is_set(const struct lyd_node *node, const char *name)
+{
+    const struct lyd_node_leaf_list *leaf = (const struct lyd_node_leaf_list *)node;
+    const struct lyd_bits *rec;
+    uint32_t i;
+
+    if (!node || !(node->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST)) || !name) {
+        LOGARG;
+        return -1;
+    }
+
+    if ((leaf->value_type != LY_TYPE_BITS) || (leaf->value_flags & LY_VALUE_USER) || !leaf->value.bit) {
+        return 0;
+    }
+
+    /* the shared value knows the number of the bits even for a derived type */
+    rec = LYD_BITS_REC(leaf->value.bit);
+    for (i = 0; i < rec->count; ++i) {
+        if (rec->bit[i] && !strcmp(rec->bit[i]->name, name)) {
+            return 1;
         }
-        if (!iter) {
-            if (((struct lys_node_choice *)schema)->dflt) {
-                /* there is a default case */
-                if (lyd_wd_add_subtree(root, last_parent, subroot, ((struct lys_node_choice *)schema)->dflt,
-                                       toplevel, options, unres)) {
-                    goto error;
-                }
+    }
+
+    return 0;
+}
+
+API const struct lys_type *
+lyd_leaf_type(const struct lyd_node_leaf_list *leaf)
+{
+    struct lys_type *type;
+
+    if (!leaf || !(leaf->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST))) {
+        return NULL;
+    }
+
+    type = &((struct lys_node_leaf *)leaf->schema)->type;
+
+    do {
+        if (type->base == LY_TYPE_LEAFREF) {
+            type = &type->info.lref.target->type;
+        } else if (type->base == LY_TYPE_UNION) {
+            if (type->info.uni.has_ptr_type && leaf->validity) {
+                /* we don't know what it will be after resolution (validation) */
+                LOGVAL(leaf->schema->module->ctx, LYE_SPEC, LY_VLOG_LYD, leaf,
+                       "Unable to determine the type of value \"%s\" from union type \"%s\" prior to validation.",
+                       leaf->value_str, type->der->name);
+                return NULL;
             }
-        } else {
-            /* one of the choice's cases is instantiated, continue into this case */
-            /* since iter != NULL, siter must be also != NULL and we also know siter_prev
-             * which points to the child of schema leading towards the instantiated data */
-            assert(siter && siter_prev);
-            if (lyd_wd_add_subtree(root, last_parent, subroot, siter_prev, toplevel, options, unres)) {
-                goto error;
+
+            if (resolve_union((struct lyd_node_leaf_list *)leaf, type, 0, 0, &type)) {
+                /* resolve union failed */
+                return NULL;
             }
         }
-        break;
-    default:
-        /* LYS_ANYXML, LYS_ANYDATA, LYS_USES, LYS_GROUPING - do nothing */
-        break;
+    } while (type->base == LY_TYPE_LEAFREF);
+
+    return type;
+}
+
+API struct lyd_node *
+lyd_parse_lyb_subtrees(struct ly_ctx *ctx, const char *data, size_t length, int options, const char *path)
+{
+    struct lyd_node *result;
+
+    if (!ctx || !data || !path) {
+        LOGARG;
+        return NULL;
+    }
+    if (lyp_data_check_options(ctx, options, __func__)) {
+        return NULL;
+    }
+    if (options & (LYD_OPT_RPCREPLY | LYD_OPT_DATA_TEMPLATE)) {
+        LOGERR(ctx, LY_EINVAL, "%s: unsupported parser options.", __func__);
+        return NULL;
     }
 
-    ly_set_free(present);
-    return EXIT_SUCCESS;
+    ly_errno = LY_SUCCESS;
+    result = lyd_parse_lyb_index(ctx, data, length, options, path);
+    if (ly_errno) {
+        lyd_free_withsiblings(result);
+        return NULL;
+    }
+    return result;
+}
 
-error:
-    ly_set_free(present);
-    return EXIT_FAILURE;
+API int
+lyd_apply_lyb_patch(struct ly_ctx *ctx, struct lyd_node **root, const char *data)
+{
+    if (!ctx || !root || !data || (*root && (lyd_node_module(*root)->ctx != ctx))) {
+        LOGARG;
+        return -1;
+    }
+
+    return lyd_parse_lyb_patch(ctx, root, data);
 }
 
-/**
- * @brief Covering function to process (add/clean) default nodes in the data tree
- * @param[in,out] root Pointer to the root node of the complete data tree, the root node can be NULL if the data tree
- *                     is empty
- * @param[in] ctx      Context for the case the data tree is empty (in that case \p ctx must not be NULL)
- * @param[in] options  Parser options to know the data tree type, see @ref parseroptions.
- * @param[in] unres    Unresolved data list, the newly added default nodes may need to add some unresolved items
- * @return EXIT_SUCCESS or EXIT_FAILURE
- */
-static int
-lyd_wd_add(struct lyd_node **root, struct ly_ctx *ctx, const struct lys_module **modules, int mod_count,
-           struct unres_data *unres, int options)
+API struct lyd_lyb_stream *
+lyd_lyb_stream_new(struct ly_ctx *ctx, int options)
 {
-    struct lys_node *siter;
-    int i;
+    struct lyd_lyb_stream *stream;
 
-    assert(root && !(options & LYD_OPT_ACT_NOTIF));
-    assert(*root || ctx);
-    assert(!(options & LYD_OPT_NOSIBLINGS) || *root);
+    if (!ctx || (options & ~LYP_STRTABLE)) {
+        LOGARG;
+        return NULL;
+    }
 
-    if (options & (LYD_OPT_EDIT | LYD_OPT_GET | LYD_OPT_GETCONFIG)) {
-        /* no change supposed */
-        return EXIT_SUCCESS;
+    stream = calloc(1, sizeof *stream);
+    LY_CHECK_ERR_RETURN(!stream, LOGMEM(ctx), NULL);
+    stream->ctx = ctx;
+    stream->options = options;
+
+    return stream;
+}
+
+API void
+lyd_lyb_stream_free(struct lyd_lyb_stream *stream)
+{
+    int i;
+
+    if (!stream) {
+        return;
     }
 
-    if (!ctx) {
-        ctx = (*root)->schema->module->ctx;
+    for (i = 0; stream->mod_names && (i < stream->mod_count); ++i) {
+        lydict_remove(stream->ctx, stream->mod_names[i]);
+        lydict_remove(stream->ctx, stream->mod_revs[i]);
     }
+    free(stream->mod_names);
+    free(stream->mod_revs);
+    free(stream->models);
+    lyht_free(stream->snode_ht);
+    free(stream);
+}
 
-    if (!(options & LYD_OPT_TYPEMASK) || (options & LYD_OPT_CONFIG)) {
-        if (options & LYD_OPT_NOSIBLINGS) {
-            if (lyd_wd_add_subtree(root, NULL, NULL, (*root)->schema, 1, options, unres)) {
-                return EXIT_FAILURE;
-            }
-        } else if (modules && mod_count) {
-            for (i = 0; i < mod_count; ++i) {
-                LY_TREE_FOR(modules[i]->data, siter) {
-                    if (!(siter->nodetype & (LYS_CONTAINER | LYS_CHOICE | LYS_LEAF | LYS_LEAFLIST | LYS_LIST | LYS_ANYDATA |
-                                             LYS_USES))) {
-                        continue;
-                    }
-                    if (lyd_wd_add_subtree(root, NULL, NULL, siter, 1, options, unres)) {
-                        return EXIT_FAILURE;
-                    }
-                }
-            }
-        } else {
-            for (i = 0; i < ctx->models.used; i++) {
-                /* skip not implemented and disabled modules */
-                if (!ctx->models.list[i]->implemented || ctx->models.list[i]->disabled) {
-                    continue;
-                }
-                LY_TREE_FOR(ctx->models.list[i]->data, siter) {
-                    if (!(siter->nodetype & (LYS_CONTAINER | LYS_CHOICE | LYS_LEAF | LYS_LEAFLIST | LYS_LIST | LYS_ANYDATA |
-                                             LYS_USES))) {
-                        continue;
-                    }
-                    if (lyd_wd_add_subtree(root, NULL, NULL, siter, 1, options, unres)) {
-                        return EXIT_FAILURE;
-                    }
-                }
-            }
-        }
-    } else if (options & LYD_OPT_NOTIF) {
-        if (!(*root) || ((*root)->schema->nodetype != LYS_NOTIF)) {
-            LOGERR(ctx, LY_EINVAL, "Subtree is not a single notification.");
-            return EXIT_FAILURE;
-        }
-        if (lyd_wd_add_subtree(root, *root, *root, (*root)->schema, 0, options, unres)) {
-            return EXIT_FAILURE;
-        }
-    } else if (options & (LYD_OPT_RPC | LYD_OPT_RPCREPLY)) {
-        if (!(*root) || !((*root)->schema->nodetype & (LYS_RPC | LYS_ACTION))) {
-            LOGERR(ctx, LY_EINVAL, "Subtree is not a single RPC/action/reply.");
-            return EXIT_FAILURE;
-        }
-        if (options & LYD_OPT_RPC) {
-            for (siter = (*root)->schema->child; siter && siter->nodetype != LYS_INPUT; siter = siter->next);
-        } else { /* LYD_OPT_RPCREPLY */
-            for (siter = (*root)->schema->child; siter && siter->nodetype != LYS_OUTPUT; siter = siter->next);
-        }
-        if (siter) {
-            if (lyd_wd_add_subtree(root, *root, *root, siter, 0, options, unres)) {
-                return EXIT_FAILURE;
-            }
-        }
-    } else if (options & LYD_OPT_DATA_TEMPLATE) {
-        if (lyd_wd_add_subtree(root, NULL, NULL, (*root)->schema, 1, options, unres)) {
-            return EXIT_FAILURE;
+/* remember the names of the header models to find them again after the module set changes */
+int
+lyb_stream_set_models(struct lyd_lyb_stream *stream)
+{
+    int i;
+
+    stream->mod_names = calloc(stream->mod_count, sizeof *stream->mod_names);
+    stream->mod_revs = calloc(stream->mod_count, sizeof *stream->mod_revs);
+    LY_CHECK_ERR_RETURN(stream->mod_count && (!stream->mod_names || !stream->mod_revs), LOGMEM(stream->ctx), -1);
+
+    for (i = 0; i < stream->mod_count; ++i) {
+        stream->mod_names[i] = lydict_insert(stream->ctx, stream->models[i]->name, 0);
+        if (stream->models[i]->rev_size) {
+            stream->mod_revs[i] = lydict_insert(stream->ctx, stream->models[i]->rev[0].date, 0);
         }
-    } else {
-        LOGINT(ctx);
-        return EXIT_FAILURE;
     }
+    stream->set_id = stream->ctx->models.module_set_id;
+    stream->header = 1;
 
-    return EXIT_SUCCESS;
+    return 0;
 }
 
-int
-lyd_defaults_add_unres(struct lyd_node **root, int options, struct ly_ctx *ctx, const struct lys_module **modules,
-                       int mod_count, const struct lyd_node *data_tree, struct lyd_node *act_notif,
-                       struct unres_data *unres, int wd)
+void
+lyb_stream_check(struct lyd_lyb_stream *stream)
 {
-    struct lyd_node *msg_sibling = NULL, *msg_parent = NULL, *data_tree_sibling, *data_tree_parent;
-    struct lys_node *msg_op = NULL;
-    struct ly_set *set;
-    int ret = EXIT_FAILURE;
+    int i;
 
-    assert(root && (*root || ctx) && unres && !(options & LYD_OPT_ACT_NOTIF));
+    if (stream->set_id == stream->ctx->models.module_set_id) {
+        return;
+    }
 
-    if (!ctx) {
-        ctx = (*root)->schema->module->ctx;
+    /* the modules may have been removed and the schema nodes changed */
+    for (i = 0; i < stream->mod_count; ++i) {
+        stream->models[i] = ly_ctx_get_module(stream->ctx, stream->mod_names[i], stream->mod_revs[i], 1);
+    }
+    lyht_free(stream->snode_ht);
+    stream->snode_ht = NULL;
+    stream->set_id = stream->ctx->models.module_set_id;
+}
+
+API int
+lyd_lyb_stream_parse_header(struct lyd_lyb_stream *stream, const char *data)
+{
+    int ret;
+
+    if (!stream || !data) {
+        LOGARG;
+        return -1;
+    }
+    if (stream->header) {
+        LOGERR(stream->ctx, LY_EINVAL, "%s: the LYB stream header was already processed.", __func__);
+        return -1;
+    }
+
+    ret = lyd_parse_lyb_stream_header(stream, data);
+    if ((ret == -1) || lyb_stream_set_models(stream)) {
+        return -1;
+    }
+
+    return ret;
+}
+
+API struct lyd_node *
+lyd_lyb_stream_parse(struct lyd_lyb_stream *stream, const char *data, int options)
+{
+    struct lyd_node *result;
+    int parsed = 0;
+
+    if (!stream || !data) {
+        LOGARG;
+        return NULL;
+    }
+    if (!stream->header) {
+        LOGERR(stream->ctx, LY_EINVAL, "%s: the LYB stream header was not parsed.", __func__);
+        return NULL;
+    }
+    if (lyp_data_check_options(stream->ctx, options, __func__)) {
+        return NULL;
+    }
+    if (options & (LYD_OPT_RPCREPLY | LYD_OPT_DATA_TEMPLATE)) {
+        LOGERR(stream->ctx, LY_EINVAL, "%s: unsupported parser options.", __func__);
+        return NULL;
+    }
+    lyb_stream_check(stream);
+
+    ly_errno = LY_SUCCESS;
+    result = lyd_parse_lyb_stream_frame(stream, data, options, &parsed);
+    if (parsed > 0) {
+        LY_STATS_ADD(stream->ctx, parse_bytes, (uint64_t)parsed);
+    }
+    if (ly_errno) {
+        lyd_free_withsiblings(result);
+        return NULL;
+    }
+    return result;
+}
+
+API struct lyd_lazy *
+lyd_lazy_new(struct ly_ctx *ctx, const char *data, size_t length, int options)
+{
+    struct lyd_lazy *lazy;
+
+    if (!ctx || !data) {
+        LOGARG;
+        return NULL;
+    }
+    if (lyp_data_check_options(ctx, options, __func__)) {
+        return NULL;
+    }
+    switch (options & LYD_OPT_TYPEMASK) {
+    case LYD_OPT_DATA:
+    case LYD_OPT_CONFIG:
+    case LYD_OPT_GET:
+    case LYD_OPT_GETCONFIG:
+        break;
+    default:
+        LOGERR(ctx, LY_EINVAL, "%s: unsupported parser options.", __func__);
+        return NULL;
     }
 
-    if ((options & LYD_OPT_NOSIBLINGS) && !(*root)) {
-        LOGERR(ctx, LY_EINVAL, "Cannot add default values for one module (LYD_OPT_NOSIBLINGS) without any data.");
-        return EXIT_FAILURE;
+    lazy = calloc(1, sizeof *lazy);
+    LY_CHECK_ERR_RETURN(!lazy, LOGMEM(ctx), NULL);
+    lazy->ctx = ctx;
+    lazy->data = data;
+    lazy->options = options | LYD_OPT_TRUSTED;
+
+    if (lyd_parse_lyb_lazy(lazy, length)) {
+        lyd_lazy_free(lazy);
+        return NULL;
     }
+    return lazy;
+}
 
-    if (options & (LYD_OPT_RPC | LYD_OPT_RPCREPLY | LYD_OPT_NOTIF)) {
-        if (!(*root)) {
-            LOGERR(ctx, LY_EINVAL, "Cannot add default values to RPC, RPC reply, and notification without at least the empty container.");
-            return EXIT_FAILURE;
-        }
-        if ((options & LYD_OPT_RPC) && !act_notif && ((*root)->schema->nodetype != LYS_RPC)) {
-            LOGERR(ctx, LY_EINVAL, "Not valid RPC/action data.");
-            return EXIT_FAILURE;
-        }
-        if ((options & LYD_OPT_RPCREPLY) && !act_notif && ((*root)->schema->nodetype != LYS_RPC)) {
-            LOGERR(ctx, LY_EINVAL, "Not valid reply data.");
-            return EXIT_FAILURE;
-        }
-        if ((options & LYD_OPT_NOTIF) && !act_notif && ((*root)->schema->nodetype != LYS_NOTIF)) {
-            LOGERR(ctx, LY_EINVAL, "Not valid notification data.");
-            return EXIT_FAILURE;
-        }
+/* parse a top-level subtree of lazy data, if not yet, and link it among the others in the order of the data */
+static int
+lyd_lazy_load(struct lyd_lazy *lazy, uint32_t idx)
+{
+    struct lyd_node *node, *prev = NULL;
+    uint32_t i;
 
-        /* remember the operation/notification schema */
-        msg_op = act_notif ? act_notif->schema : (*root)->schema;
-    } else if (*root && (*root)->parent) {
-        /* we have inner node, so it will be considered as
-         * a root of subtree where to add default nodes and
-         * no of its siblings will be affected */
-        options |= LYD_OPT_NOSIBLINGS;
+    lazy->subtrees[idx].used = ++lazy->clock;
+    if (lazy->subtrees[idx].node) {
+        return 0;
     }
 
-    /* add missing default nodes */
-    if (wd && lyd_wd_add((act_notif ? &act_notif : root), ctx, modules, mod_count, unres, options)) {
-        return EXIT_FAILURE;
+    node = lyd_parse_lyb_lazy_subtree(lazy, idx);
+    if (!node) {
+        return -1;
     }
+    lazy->subtrees[idx].node = node;
 
-    /* check leafrefs and/or instids if any */
-    if (unres && unres->count) {
-        if (!(*root)) {
-            LOGINT(ctx);
-            return EXIT_FAILURE;
-        }
+    for (i = idx; i && !prev; --i) {
+        prev = lazy->subtrees[i - 1].node;
+    }
 
-        /* temporarily link the additional data tree to the RPC/action/notification */
-        if (data_tree && (options & (LYD_OPT_RPC | LYD_OPT_RPCREPLY | LYD_OPT_NOTIF))) {
-            /* duplicate the message tree - if it gets deleted we would not be able to positively identify it */
-            msg_parent = NULL;
-            msg_sibling = *root;
+    /* top-level siblings, there are no hash tables to update */
+    if (prev) {
+        node->prev = prev;
+        node->next = prev->next;
+        if (prev->next) {
+            prev->next->prev = node;
+        } else {
+            lazy->tree->prev = node;
+        }
+        prev->next = node;
+    } else if (lazy->tree) {
+        node->prev = lazy->tree->prev;
+        node->next = lazy->tree;
+        lazy->tree->prev = node;
+        lazy->tree = node;
+    } else {
+        lazy->tree = node;
+    }
 
-            if (act_notif) {
-                /* fun case */
-                data_tree_parent = NULL;
-                data_tree_sibling = (struct lyd_node *)data_tree;
-                while (data_tree_sibling) {
-                    while (data_tree_sibling) {
-                        if ((data_tree_sibling->schema == msg_sibling->schema)
-                                && ((msg_sibling->schema->nodetype != LYS_LIST)
-                                    || lyd_list_equal(data_tree_sibling, msg_sibling, 0))) {
-                            /* match */
-                            break;
-                        }
+    return 0;
+}
 
-                        data_tree_sibling = data_tree_sibling->next;
-                    }
+API struct lyd_node *
+lyd_lazy_tree(struct lyd_lazy *lazy, const char *path)
+{
+    uint32_t i;
 
-                    if (data_tree_sibling) {
-                        /* prepare for the new data_tree iteration */
-                        data_tree_parent = data_tree_sibling;
-                        data_tree_sibling = data_tree_sibling->child;
+    if (!lazy) {
+        LOGARG;
+        return NULL;
+    }
 
-                        /* find new action sibling to search for later (skip list keys) */
-                        msg_parent = msg_sibling;
-                        assert(msg_sibling->child);
-                        for (msg_sibling = msg_sibling->child;
-                                msg_sibling->schema->nodetype == LYS_LEAF;
-                                msg_sibling = msg_sibling->next) {
-                            assert(msg_sibling->next);
-                        }
-                        if (msg_sibling->schema->nodetype & (LYS_ACTION | LYS_NOTIF)) {
-                            /* we are done */
-                            assert(act_notif->parent);
-                            assert(act_notif->parent->schema == data_tree_parent->schema);
-                            assert(msg_sibling == act_notif);
-                            break;
-                        }
-                    }
-                }
+    ly_errno = LY_SUCCESS;
+    for (i = 0; i < lazy->count; ++i) {
+        if ((!path || lyb_index_match(lazy->subtrees[i].path, lazy->subtrees[i].path_len, path))
+                && lyd_lazy_load(lazy, i)) {
+            return NULL;
+        }
+    }
 
-                /* loop ended after the first iteration, set the values correctly */
-                if (!data_tree_parent) {
-                    data_tree_sibling = (struct lyd_node *)data_tree;
-                }
+    return lazy->tree;
+}
 
-            } else {
-                /* easy case */
-                data_tree_parent = NULL;
-                data_tree_sibling = (struct lyd_node *)data_tree;
-            }
+API struct ly_set *
+lyd_lazy_find_path(struct lyd_lazy *lazy, const char *path)
+{
+    const char *ptr;
+    char *name = NULL, quot;
+    size_t name_len = 0, step_len = 0;
+    uint32_t i;
+    int exact = 0;
 
-            /* unlink msg_sibling if needed (won't do anything otherwise) */
-            lyd_unlink_internal(msg_sibling, 0);
+    if (!lazy || !path) {
+        LOGARG;
+        return NULL;
+    }
 
-            /* now we can insert msg_sibling into data_tree_parent or next to data_tree_sibling */
-            assert(data_tree_parent || data_tree_sibling);
-            if (data_tree_parent) {
-                if (lyd_insert_common(data_tree_parent, NULL, msg_sibling, 0)) {
-                    goto unlink_datatree;
-                }
-            } else {
-                assert(!data_tree_sibling->parent);
-                if (lyd_insert_nextto(data_tree_sibling->prev, msg_sibling, 0, 0)) {
-                    goto unlink_datatree;
+    /* the first step of a simple absolute path */
+    if ((path[0] == '/') && (path[1] != '/') && !strchr(path, '|') && !strstr(path, "..")) {
+        for (ptr = path + 1; *ptr && (*ptr != '/') && (*ptr != '['); ++ptr);
+        name_len = ptr - path;
+        while (*ptr == '[') {
+            for (++ptr; *ptr && (*ptr != ']'); ++ptr) {
+                if ((*ptr == '\'') || (*ptr == '\"')) {
+                    quot = *ptr;
+                    for (++ptr; *ptr && (*ptr != quot); ++ptr);
+                    if (!*ptr) {
+                        break;
+                    }
                 }
             }
+            if (*ptr) {
+                ++ptr;
+            }
         }
-
-        if (resolve_unres_data(ctx, unres, root, options)) {
-            goto unlink_datatree;
+        step_len = ptr - path;
+        if (!memchr(path, ':', name_len)) {
+            name_len = 0;
         }
+    }
 
-        /* we are done */
-        ret = EXIT_SUCCESS;
-
-        /* check that the operation/notification tree was not removed */
-        if (options & (LYD_OPT_RPC | LYD_OPT_RPCREPLY | LYD_OPT_NOTIF)) {
-            set = NULL;
-            if (data_tree) {
-                set = lyd_find_instance(data_tree_parent ? data_tree_parent : data_tree_sibling, msg_op);
-                assert(set && ((set->number == 0) || (set->number == 1)));
-            } else if (*root) {
-                set = lyd_find_instance(*root, msg_op);
-                assert(set && ((set->number == 0) || (set->number == 1)));
-            }
-            if (!set || !set->number) {
-                /* it was removed, handle specially */
-                LOGVAL(ctx, LYE_SPEC, LY_VLOG_LYS, msg_op, "Operation/notification not supported because of the current configuration.");
-                ret = EXIT_FAILURE;
+    if (name_len) {
+        /* the instance itself, if the predicates are the same as in the index */
+        if (step_len > name_len) {
+            for (i = 0; i < lazy->count; ++i) {
+                if ((lazy->subtrees[i].path_len == step_len) && !strncmp(lazy->subtrees[i].path, path, step_len)) {
+                    if (lyd_lazy_load(lazy, i)) {
+                        return NULL;
+                    }
+                    exact = 1;
+                }
             }
-            ly_set_free(set);
         }
 
-unlink_datatree:
-        /* put the trees back in order */
-        if (data_tree && (options & (LYD_OPT_RPC | LYD_OPT_RPCREPLY | LYD_OPT_NOTIF))) {
-            /* unlink and insert it back, if there is a parent  */
-            lyd_unlink_internal(msg_sibling, 0);
-            if (msg_parent) {
-                lyd_insert_common(msg_parent, NULL, msg_sibling, 0);
+        if (!exact) {
+            name = strndup(path, name_len);
+            LY_CHECK_ERR_RETURN(!name, LOGMEM(lazy->ctx), NULL);
+            if (!lyd_lazy_tree(lazy, name) && ly_errno) {
+                free(name);
+                return NULL;
             }
+            free(name);
         }
-    } else {
-        /* we are done */
-        ret = EXIT_SUCCESS;
+    } else if (!lyd_lazy_tree(lazy, NULL) && ly_errno) {
+        return NULL;
     }
 
-    return ret;
+    if (!lazy->tree) {
+        return ly_set_new();
+    }
+    return lyd_find_path(lazy->tree, path);
 }
 
-API struct lys_module *
-lyd_node_module(const struct lyd_node *node)
+API int
+lyd_lazy_print_mem(char **strp, struct lyd_lazy *lazy, LYD_FORMAT format, int options)
 {
-    if (!node) {
-        return NULL;
+    if (!strp || !lazy) {
+        LOGARG;
+        return EXIT_FAILURE;
     }
 
-    return node->schema->module->type ? ((struct lys_submodule *)node->schema->module)->belongsto : node->schema->module;
+    if (!lyd_lazy_tree(lazy, NULL) && ly_errno) {
+        return EXIT_FAILURE;
+    }
+    return lyd_print_mem(strp, lazy->tree, format, options | LYP_WITHSIBLINGS);
 }
 
-API double
-lyd_dec64_to_double(const struct lyd_node *node)
+/* the least recently used parsed subtrees first */
+static int
+lyd_lazy_used_cmp(const void *ptr1, const void *ptr2)
 {
-    if (!node || !(node->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST))
-            || (((struct lys_node_leaf *)node->schema)->type.base != LY_TYPE_DEC64)) {
+    const struct lyd_lazy_subtree *sub1 = *(struct lyd_lazy_subtree **)ptr1, *sub2 = *(struct lyd_lazy_subtree **)ptr2;
+
+    return (sub1->used > sub2->used) - (sub1->used < sub2->used);
+}
+
+API uint32_t
+lyd_lazy_evict(struct lyd_lazy *lazy, uint32_t keep)
+{
+    struct lyd_lazy_subtree **parsed;
+    uint32_t i, count = 0;
+
+    if (!lazy) {
         LOGARG;
         return 0;
     }
 
-    return atof(((struct lyd_node_leaf_list *)node)->value_str);
+    for (i = 0; i < lazy->count; ++i) {
+        if (lazy->subtrees[i].node) {
+            ++count;
+        }
+    }
+    if (count <= keep) {
+        return 0;
+    }
+
+    parsed = malloc(count * sizeof *parsed);
+    LY_CHECK_ERR_RETURN(!parsed, LOGMEM(lazy->ctx), 0);
+    for (i = count = 0; i < lazy->count; ++i) {
+        if (lazy->subtrees[i].node) {
+            parsed[count++] = &lazy->subtrees[i];
+        }
+    }
+    qsort(parsed, count, sizeof *parsed, lyd_lazy_used_cmp);
+
+    for (i = 0; i < count - keep; ++i) {
+        if (parsed[i]->node == lazy->tree) {
+            lazy->tree = lazy->tree->next;
+        }
+        lyd_free(parsed[i]->node);
+        parsed[i]->node = NULL;
+    }
+    free(parsed);
+
+    return count - keep;
 }
 
-API const struct lys_type *
-lyd_leaf_type(const struct lyd_node_leaf_list *leaf)
+API void
+lyd_lazy_free(struct lyd_lazy *lazy)
 {
-    struct lys_type *type;
-
-    if (!leaf || !(leaf->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST))) {
-        return NULL;
+    if (!lazy) {
+        return;
     }
 
-    type = &((struct lys_node_leaf *)leaf->schema)->type;
+    lyd_free_withsiblings(lazy->tree);
+    free(lazy->subtrees);
+    free(lazy->models);
+    lyht_free(lazy->snode_ht);
+    free(lazy);
+}
+
+/* skip a top-level LYB subtree */
+static const char *
+lyb_skip_subtree(const char *ptr)
+{
+    LYB_META meta;
 
     do {
-        if (type->base == LY_TYPE_LEAFREF) {
-            type = &type->info.lref.target->type;
-        } else if (type->base == LY_TYPE_UNION) {
-            if (type->info.uni.has_ptr_type && leaf->validity) {
-                /* we don't know what it will be after resolution (validation) */
-                LOGVAL(leaf->schema->module->ctx, LYE_SPEC, LY_VLOG_LYD, leaf,
-                       "Unable to determine the type of value \"%s\" from union type \"%s\" prior to validation.",
-                       leaf->value_str, type->der->name);
-                return NULL;
-            }
+        memcpy(&meta, ptr, LYB_META_BYTES);
+        ptr += LYB_META_BYTES;
 
-            if (resolve_union((struct lyd_node_leaf_list *)leaf, type, 0, 0, &type)) {
-                /* resolve union failed */
-                return NULL;
-            }
-        }
-    } while (type->base == LY_TYPE_LEAFREF);
+        /* read whole subtree (chunk size) */
+        ptr += *((uint8_t *)&meta);
+        /* skip inner chunks (inner chunk count) */
+        ptr += *(((uint8_t *)&meta) + LYB_SIZE_BYTES) * LYB_META_BYTES;
+    } while (*((uint8_t *)&meta) == LYB_SIZE_MAX);
 
-    return type;
+    return ptr;
 }
 
 API int
@@ -7729,8 +13908,8 @@ lyd_lyb_data_length(const char *data)
 {
     const char *ptr;
     uint16_t i, mod_count, str_len;
-    uint8_t tmp_buf[2];
-    LYB_META meta;
+    uint32_t j, index_count;
+    uint8_t tmp_buf[4], flags, op;
 
     if (!data) {
         return -1;
@@ -7745,8 +13924,16 @@ lyd_lyb_data_length(const char *data)
     ptr += 3;
 
     /* header */
+    flags = ptr[0];
     ++ptr;
 
+    if (flags & LYB_HEADER_STREAM) {
+        /* only the length of the models follows */
+        memcpy(tmp_buf, ptr, 4);
+        ptr += 4;
+        return (ptr - data) + (tmp_buf[0] | (tmp_buf[1] << 8) | (tmp_buf[2] << 16) | ((uint32_t)tmp_buf[3] << 24));
+    }
+
     /* models */
     memcpy(tmp_buf, ptr, 2);
     ptr += 2;
@@ -7764,22 +13951,58 @@ lyd_lyb_data_length(const char *data)
         ptr += 2;
     }
 
-    if (ptr[0]) {
-        /* subtrees */
-        do {
-            memcpy(&meta, ptr, LYB_META_BYTES);
-            ptr += LYB_META_BYTES;
+    if (flags & LYB_HEADER_PATCH) {
+        /* operations */
+        while (ptr[0]) {
+            op = ptr[0];
+            ++ptr;
+
+            /* depth */
+            for (; ptr[0] & 0x80; ++ptr);
+            ++ptr;
+            ptr = lyb_skip_subtree(ptr);
 
-            /* read whole subtree (chunk size) */
-            ptr += *((uint8_t *)&meta);
-            /* skip inner chunks (inner chunk count) */
-            ptr += *(((uint8_t *)&meta) + LYB_SIZE_BYTES) * LYB_META_BYTES;
-        } while ((*((uint8_t *)&meta) == LYB_SIZE_MAX) || ptr[0]);
+            if ((op == LYD_DIFF_MOVEDAFTER1) || (op == LYD_DIFF_MOVEDAFTER2)) {
+                /* preceding instance */
+                ++ptr;
+                if (ptr[-1]) {
+                    for (; ptr[0] & 0x80; ++ptr);
+                    ++ptr;
+                    ptr = lyb_skip_subtree(ptr);
+                }
+            }
+        }
+    } else {
+        /* subtrees */
+        while (ptr[0]) {
+            ptr = lyb_skip_subtree(ptr);
+        }
     }
 
     /* ending zero */
     ++ptr;
 
+    if (flags & LYB_HEADER_INDEX) {
+        /* index */
+        memcpy(tmp_buf, ptr, 4);
+        ptr += 4;
+        index_count = tmp_buf[0] | (tmp_buf[1] << 8) | (tmp_buf[2] << 16) | ((uint32_t)tmp_buf[3] << 24);
+
+        for (j = 0; j < index_count; ++j) {
+            /* offset */
+            ptr += 8;
+
+            /* path */
+            memcpy(tmp_buf, ptr, 2);
+            ptr += 2;
+            str_len = tmp_buf[0] | (tmp_buf[1] << 8);
+            ptr += str_len;
+        }
+
+        /* index offset */
+        ptr += 8;
+    }
+
     return ptr - data;
 }
 
@@ -94,14 +94,17 @@ typedef enum {
 typedef union lyd_value_u {
     const char *binary;          /**< base64 encoded, NULL terminated string */
     struct lys_type_bit **bit;   /**< bitmap of pointers to the schema definition of the bit value that are set,
-                                      its size is always the number of defined bits in the schema */
+                                      its size is always the number of defined bits in the schema, the array is
+                                      shared by all the data nodes with the same value and must not be modified,
+                                      see lyd_bit_is_set() */
     int8_t bln;                  /**< 0 as false, 1 as true */
     int64_t dec64;               /**< decimal64: value = dec64 / 10^fraction-digits  */
     struct lys_type_enum *enm;   /**< pointer to the schema definition of the enumeration value */
     struct lys_ident *ident;     /**< pointer to the schema definition of the identityref value */
     struct lyd_node *instance;   /**< pointer to the instance-identifier target, note that if the tree was modified,
                                       the target (address) can be invalid - the pointer is correctly checked and updated
-                                      by lyd_validate() */
+                                      by lyd_validate(), which resolves it again only if some data tree of the context
+                                      was modified since */
     int8_t int8;                 /**< 8-bit signed integer */
     int16_t int16;               /**< 16-bit signed integer */
     int32_t int32;               /**< 32-bit signed integer */
@@ -156,6 +159,8 @@ struct lyd_attr {
                                       are checked for this node if flag #LYD_OPT_OBSOLETE is used. */
 #define LYD_VAL_LEAFREF  0x08    /**< Node is a leafref, which needs to be resolved (it is invalid, new possible
                                       resolvent, or something similar) */
+#define LYD_VAL_TOPDEL   0x10    /**< Internal flag set on a top-level node when any of its siblings is removed, it means that
+                                      #LYD_OPT_VAL_CHANGED validation must check the whole data tree */
 #define LYD_VAL_INUSE    0x80    /**< Internal flag for note about various processing on data, should be used only
                                       internally and removed before libyang returns the node to the caller */
 /**
@@ -181,6 +186,15 @@ struct lyd_node {
     uint8_t dflt:1;                  /**< flag for implicit default node */
     uint8_t when_status:3;           /**< bit for checking if the when-stmt condition is resolved - internal use only,
                                           do not use this value! */
+    uint8_t arena:1;                 /**< flag for nodes allocated from a ::lyd_arena - internal use only,
+                                          do not use this value! */
+    uint8_t ext_alloc:1;             /**< flag for nodes allocated by the context data allocator - internal use only,
+                                          do not use this value! */
+    uint8_t side:1;                  /**< flag for nodes with a record in the context side table (subtree filter,
+                                          unique indexes) - internal use only, do not use this value! */
+#ifdef LY_ENABLED_CACHE
+    uint32_t hash;                   /**< hash of this particular node (module name + schema name + key string values if list) */
+#endif
 
     struct lyd_attr *attr;           /**< pointer to the list of attributes of this node */
     struct lyd_node *next;           /**< pointer to the next sibling node (NULL if there is no one) */
@@ -195,7 +209,6 @@ struct lyd_node {
 #endif
 
 #ifdef LY_ENABLED_CACHE
-    uint32_t hash;                   /**< hash of this particular node (module name + schema name + key string values if list) */
     struct hash_table *ht;           /**< hash table with all the direct children (except keys for a list, lists without keys) */
 #endif
 
@@ -223,6 +236,14 @@ struct lyd_node_leaf_list {
     uint8_t dflt:1;                  /**< flag for implicit default node */
     uint8_t when_status:3;           /**< bit for checking if the when-stmt condition is resolved - internal use only,
                                           do not use this value! */
+    uint8_t arena:1;                 /**< flag for nodes allocated from a ::lyd_arena - internal use only,
+                                          do not use this value! */
+    uint8_t ext_alloc:1;             /**< flag for nodes allocated by the context data allocator - internal use only,
+                                          do not use this value! */
+    uint16_t ref_gen_hi;             /**< high bits of #ref_gen - internal use only, do not use this value! */
+#ifdef LY_ENABLED_CACHE
+    uint32_t hash;                   /**< hash of this particular node (module name + schema name + string value if leaf-list) */
+#endif
 
     struct lyd_attr *attr;           /**< pointer to the list of attributes of this node */
     struct lyd_node *next;           /**< pointer to the next sibling node (NULL if there is no one) */
@@ -236,10 +257,6 @@ struct lyd_node_leaf_list {
     void *priv;                      /**< private user data, not used by libyang */
 #endif
 
-#ifdef LY_ENABLED_CACHE
-    uint32_t hash;                   /**< hash of this particular node (module name + schema name + string value if leaf-list) */
-#endif
-
     /* struct lyd_node *child; should be here, but is not */
 
     /* leaflist's specific members */
@@ -247,6 +264,9 @@ struct lyd_node_leaf_list {
     lyd_val value;                   /**< node's value representation, always corresponds to schema->type.base */
     LY_DATA_TYPE _PACKED value_type; /**< type of the value in the node, mainly for union to avoid repeating of type detection */
     uint8_t value_flags;             /**< value type flags */
+    uint32_t ref_gen:24;             /**< low bits of the data modification generation of the context the leafref or
+                                          instance-identifier target in #value was resolved in, the high bits are in
+                                          #ref_gen_hi - internal use only, do not use this value! */
 };
 
 /**
@@ -256,6 +276,8 @@ struct lyd_node_leaf_list {
                                    leafref - value union is filled as if being the target node's type,
                                    instance-identifier - value union should not be accessed */
 #define LY_VALUE_USER 0x02    /**< flag for a user type stored value */
+#define LY_VALUE_PRIVATE 0x04 /**< flag for a value string owned by the data node instead of the dictionary,
+                                   see ly_ctx_set_private_values() */
 /* 0x80 is reserved for internal use */
 
 /**
@@ -273,6 +295,13 @@ struct lyd_node_anydata {
     uint8_t dflt:1;                  /**< flag for implicit default node */
     uint8_t when_status:3;           /**< bit for checking if the when-stmt condition is resolved - internal use only,
                                           do not use this value! */
+    uint8_t arena:1;                 /**< flag for nodes allocated from a ::lyd_arena - internal use only,
+                                          do not use this value! */
+    uint8_t ext_alloc:1;             /**< flag for nodes allocated by the context data allocator - internal use only,
+                                          do not use this value! */
+#ifdef LY_ENABLED_CACHE
+    uint32_t hash;                   /**< hash of this particular node (module name + schema name) */
+#endif
 
     struct lyd_attr *attr;           /**< pointer to the list of attributes of this node */
     struct lyd_node *next;           /**< pointer to the next sibling node (NULL if there is no one) */
@@ -286,10 +315,6 @@ struct lyd_node_anydata {
     void *priv;                      /**< private user data, not used by libyang */
 #endif
 
-#ifdef LY_ENABLED_CACHE
-    uint32_t hash;                   /**< hash of this particular node (module name + schema name) */
-#endif
-
     /* struct lyd_node *child; should be here, but is not */
 
     /* anyxml's specific members */
@@ -430,6 +455,12 @@ struct lyd_difflist *lyd_diff(struct lyd_node *first, struct lyd_node *second, i
                                              transactions on the first tree does not result to the exact second tree,
                                              because instead of having implicit default nodes you are going to have
                                              explicit default nodes. */
+#define LYD_DIFFOPT_PARALLEL     0x0002 /**< Compare the matching top-level subtrees concurrently, using as many threads
+                                             as set by ly_ctx_set_validation_threads(). The differences are grouped by
+                                             the top-level subtrees, so their order may differ from the order without
+                                             this option, but they can still be applied in order. Not used with
+                                             #LYD_DIFFOPT_NOSIBLINGS or if there is a top-level user-ordered list or
+                                             leaf-list. Neither tree may be accessed by other threads meanwhile. */
 /**@} diffoptions */
 
 /**
@@ -441,6 +472,20 @@ struct lyd_difflist *lyd_diff(struct lyd_node *first, struct lyd_node *second, i
  */
 char *lyd_path(const struct lyd_node *node);
 
+/**
+ * @brief Print data path of the data node (the same as lyd_path() generates) into a buffer.
+ *
+ * The path is written in a single pass without any allocations, so it is meant for generating paths of many nodes
+ * (such as all the changed nodes of a diff) into a reused buffer.
+ *
+ * @param[in] node Data node to be processed, see lyd_path().
+ * @param[in] buf Buffer to print into, the path is always terminated with a zero byte (truncated if needed).
+ * @param[in] buf_len Size of \p buf, can be 0 to only learn the length.
+ * @return Length of the whole path (without the terminating zero byte), if it is not lower than \p buf_len,
+ * the path was truncated; -1 on error.
+ */
+int lyd_path_buf(const struct lyd_node *node, char *buf, size_t buf_len);
+
 /**
  * @defgroup parseroptions Data parser options
  * @ingroup datatree
@@ -529,6 +574,36 @@ char *lyd_path(const struct lyd_node *node);
                                               preserved and option is ignored. */
 #define LYD_OPT_VAL_DIFF 0x40000 /**< Flag only for validation, store all the data node changes performed by the validation
                                       in a diff structure. */
+#define LYD_OPT_VAL_CHANGED 0x80000 /**< Flag only for validation, evaluate the must and when conditions only of the data
+                                        nodes changed since the last validation (see @ref validityflags) and of the nodes
+                                        with conditions referencing any of the changed data. The data tree is expected
+                                        to be valid before the changes. The conditions depending only on the data
+                                        automatically added or removed by the same validation (default nodes, nodes
+                                        with false when condition and #LYD_OPT_WHENAUTODEL) are not re-evaluated.
+                                        Without the cache (ENABLE_CACHE), all the must and when conditions are always
+                                        evaluated. */
+#define LYD_OPT_ANYDATA_RAW 0x100000 /**< Do not parse the content of anydata and anyxml nodes read from XML input,
+                                          store it as #LYD_ANYDATA_SXML instead. The namespaces in scope are declared
+                                          on its top-level elements. Use lyd_anydata_convert() to get the content
+                                          as another value type when it is needed. JSON input content is always
+                                          stored unparsed as #LYD_ANYDATA_JSON. */
+#define LYD_OPT_PROJECTION 0x200000 /**< Parse only the instances of selected schema nodes (with all their descendants),
+                                         their ancestors and the list keys, skip all the other data without creating
+                                         any nodes for them. The selected schema nodes are passed as a variadic
+                                         argument, see lyd_parse_mem(), for example a set returned by
+                                         ly_ctx_find_path(). Applicable only with #LYD_OPT_GET and
+                                         #LYD_OPT_GETCONFIG, the option is not supported for #LYD_LYB. */
+#define LYD_OPT_CANONICAL 0x400000 /**< Stronger #LYD_OPT_TRUSTED, applicable only together with it. The values are
+                                        expected in their canonical form (as printed by libyang), so they are only
+                                        parsed and stored, not canonized, and union values are stored as the first
+                                        member type accepting the value without checking the member restrictions.
+                                        Leafref and instance-identifier values stay unresolved until the data are
+                                        validated. Suitable for loading data previously stored by the application
+                                        itself. */
+#define LYD_OPT_VAL_DIFF_REF 0x800000 /**< Modifier of #LYD_OPT_VAL_DIFF, applicable only together with it. The changes
+                                           are stored as an array of compact ::lyd_val_change records referencing
+                                           the validated tree instead of a diff with duplicated subtrees, see
+                                           lyd_validate(). */
 #define LYD_OPT_DATA_TEMPLATE 0x1000000 /**< Data represents YANG data template. */
 
 /**@} parseroptions */
@@ -563,6 +638,8 @@ char *lyd_path(const struct lyd_node *node);
  *                  - const struct ::lyd_node *data_tree - additional data tree that will be used
  *                    when checking any "when" or "must" conditions in the parsed tree that require
  *                    some nodes outside their subtree. It must be a list of top-level elements!
+ *                - #LYD_OPT_PROJECTION (after all the other variadic arguments):
+ *                  - const struct ::ly_set *projection - set of the schema nodes to parse the data of.
  * @return Pointer to the built data tree or NULL in case of empty \p data. To free the returned structure,
  *         use lyd_free(). In these cases, the function sets #ly_errno to LY_SUCCESS. In case of error,
  *         #ly_errno contains appropriate error code (see #LY_ERR).
@@ -601,6 +678,8 @@ struct lyd_node *lyd_parse_mem(struct ly_ctx *ctx, const char *data, LYD_FORMAT
  *                  - const struct ::lyd_node *data_tree - additional data tree that will be used
  *                    when checking any "when" or "must" conditions in the parsed tree that require
  *                    some nodes outside their subtree. It must be a list of top-level elements!
+ *                - #LYD_OPT_PROJECTION (after all the other variadic arguments):
+ *                  - const struct ::ly_set *projection - set of the schema nodes to parse the data of.
  * @return Pointer to the built data tree or NULL in case of empty file. To free the returned structure,
  *         use lyd_free(). In these cases, the function sets #ly_errno to LY_SUCCESS. In case of error,
  *         #ly_errno contains appropriate error code (see #LY_ERR).
@@ -637,12 +716,101 @@ struct lyd_node *lyd_parse_fd(struct ly_ctx *ctx, int fd, LYD_FORMAT format, int
  *                  - const struct ::lyd_node *data_tree - additional data tree that will be used
  *                    when checking any "when" or "must" conditions in the parsed tree that require
  *                    some nodes outside their subtree. It must be a list of top-level elements!
+ *                - #LYD_OPT_PROJECTION (after all the other variadic arguments):
+ *                  - const struct ::ly_set *projection - set of the schema nodes to parse the data of.
  * @return Pointer to the built data tree or NULL in case of empty file. To free the returned structure,
  *         use lyd_free(). In these cases, the function sets #ly_errno to LY_SUCCESS. In case of error,
  *         #ly_errno contains appropriate error code (see #LY_ERR).
  */
 struct lyd_node *lyd_parse_path(struct ly_ctx *ctx, const char *path, LYD_FORMAT format, int options, ...);
 
+/**
+ * @brief A single document parsed by lyd_parse_batch().
+ */
+struct lyd_batch_item {
+    const char *data;               /**< [in] data to parse */
+    struct lyd_node *tree;          /**< [out] parsed data tree, NULL on error or for empty data */
+    int err;                        /**< [out] error code (#LY_ERR) of the parsing, LY_SUCCESS on success */
+    int vecode;                     /**< [out] validation error code (#LY_VECODE) of the last error */
+    char *errmsg;                   /**< [out] message of the last error, to be freed by the caller */
+    char *errpath;                  /**< [out] data path of the last error, to be freed by the caller */
+};
+
+/**
+ * @brief Parse many independent documents of the same format and type, possibly in several threads.
+ *
+ * Equivalent to calling lyd_parse_mem() for each item, but the options are checked only once and each
+ * thread keeps its logging setting for all of its documents. The documents are distributed to the threads
+ * one by one as they finish the previous ones so a few large documents do not stall the others.
+ *
+ * The errors of each document are stored only in its item, the error list of the calling thread
+ * (see ly_err_first()) is not changed. The context must not be modified while parsing and its data
+ * callback (see ly_ctx_set_module_data_clb()) must be thread-safe. With more threads, the schema caches are
+ * built by ly_ctx_precompile() first.
+ *
+ * @param[in] ctx Context to connect with the data trees being built.
+ * @param[in,out] items Documents to parse, the output members are overwritten.
+ * @param[in] count Count of \p items.
+ * @param[in] format Format of the input data.
+ * @param[in] options Parser options, see @ref parseroptions. Options requiring variable arguments of lyd_parse_mem()
+ *            other than the data tree (#LYD_OPT_RPCREPLY, #LYD_OPT_DATA_TEMPLATE, #LYD_OPT_PROJECTION) are not
+ *            supported, #LYD_OPT_RPC and #LYD_OPT_NOTIF data are parsed without any additional data tree.
+ * @param[in] threads Maximum number of threads to use, including the calling one. 0 and 1 parse all the documents
+ *            in the calling thread.
+ * @return EXIT_SUCCESS if all the documents were parsed, EXIT_FAILURE if any of them failed (see their items)
+ *         or on invalid arguments.
+ */
+int lyd_parse_batch(struct ly_ctx *ctx, struct lyd_batch_item *items, unsigned int count, LYD_FORMAT format,
+                    int options, unsigned int threads);
+
+/**
+ * @brief Incremental data parser, opaque structure.
+ */
+struct lyd_parser;
+
+/**
+ * @brief Create an incremental parser reading data that arrive in chunks, for example from a socket.
+ *
+ * Every top-level subtree is parsed as soon as all of its input is pushed into the parser so only
+ * the input of the subtree being read is kept in memory. The data are validated in lyd_parser_finish().
+ *
+ * @param[in] ctx Context to connect with the data tree being built.
+ * @param[in] format Format of the input data, only #LYD_XML and #LYD_JSON are supported.
+ * @param[in] options Parser options, see @ref parseroptions. The data type must be one of #LYD_OPT_DATA,
+ *            #LYD_OPT_CONFIG, #LYD_OPT_GET, #LYD_OPT_GETCONFIG, or #LYD_OPT_EDIT. #LYD_OPT_NOSIBLINGS and
+ *            #LYD_OPT_DESTRUCT are not supported.
+ * @return Created parser, NULL on error.
+ */
+struct lyd_parser *lyd_parser_new(struct ly_ctx *ctx, LYD_FORMAT format, int options);
+
+/**
+ * @brief Push the next chunk of input data into an incremental parser.
+ *
+ * @param[in] parser Incremental parser.
+ * @param[in] data Chunk of the input data, it does not need to end on any particular boundary.
+ * @param[in] len Length of \p data.
+ * @return EXIT_SUCCESS on success, EXIT_FAILURE on error. After an error, only lyd_parser_finish()
+ *         or lyd_parser_free() can be called on the parser.
+ */
+int lyd_parser_push(struct lyd_parser *parser, const char *data, size_t len);
+
+/**
+ * @brief Finish parsing the input pushed into an incremental parser, validate the data and free the parser.
+ *
+ * @param[in] parser Incremental parser, it is freed.
+ * @return Pointer to the built data tree or NULL in case of empty data. To free the returned structure,
+ *         use lyd_free(). In these cases, the function sets #ly_errno to LY_SUCCESS. In case of error,
+ *         #ly_errno contains appropriate error code (see #LY_ERR).
+ */
+struct lyd_node *lyd_parser_finish(struct lyd_parser *parser);
+
+/**
+ * @brief Free an incremental parser including all the data parsed so far.
+ *
+ * @param[in] parser Incremental parser to free.
+ */
+void lyd_parser_free(struct lyd_parser *parser);
+
 /**
  * @brief Parse (and validate) XML tree.
  *
@@ -683,6 +851,8 @@ struct lyd_node *lyd_parse_path(struct ly_ctx *ctx, const char *path, LYD_FORMAT
  *                  - const struct ::lyd_node *data_tree - additional data tree that will be used
  *                    when checking any "when" or "must" conditions in the parsed tree that require
  *                    some nodes outside their subtree. It must be a list of top-level elements!
+ *                - #LYD_OPT_PROJECTION (after all the other variadic arguments):
+ *                  - const struct ::ly_set *projection - set of the schema nodes to parse the data of.
  * @return Pointer to the built data tree or NULL in case of empty \p root. To free the returned structure,
  *         use lyd_free(). In these cases, the function sets #ly_errno to LY_SUCCESS. In case of error,
  *         #ly_errno contains appropriate error code (see #LY_ERR).
@@ -735,6 +905,23 @@ struct lyd_node *lyd_new_leaf(struct lyd_node *parent, const struct lys_module *
  */
 int lyd_change_leaf(struct lyd_node_leaf_list *leaf, const char *val_str);
 
+/**
+ * @brief Change value of a boolean or numeric leaf node using its binary value.
+ *
+ * __PARTIAL CHANGE__ - validate after the final change on the data tree (see @ref howtodatamanipulators).
+ *
+ * Works the same way as lyd_change_leaf() but the value is not parsed from a string, the binary value is only
+ * checked against the type restrictions and its canonical string form is printed. Leafref backlinks
+ * are updated only if the leaf is a target of some leafref. Meant for frequently updated leaves such as counters.
+ *
+ * @param[in] leaf A leaf node of a boolean, decimal64, or integer type (possibly via a leafref) to change.
+ * @param[in] value New value, the member corresponding to the leaf type is used.
+ * @return 0 if the leaf was changed successfully (either its value changed or at least its default flag was cleared),
+ *         <0 on error,
+ *         1 if the value matched the original one and no value neither default flag change occured.
+ */
+int lyd_change_leaf_val(struct lyd_node_leaf_list *leaf, const lyd_val *value);
+
 /**
  * @brief Create a new anydata or anyxml node in a data tree.
  *
@@ -783,6 +970,23 @@ struct lyd_node *lyd_new_output(struct lyd_node *parent, const struct lys_module
 struct lyd_node *lyd_new_output_leaf(struct lyd_node *parent, const struct lys_module *module, const char *name,
                                      const char *val_str);
 
+/**
+ * @brief Convert the value of an anydata or anyxml node into another value type, typically to parse the content
+ * stored unparsed by #LYD_OPT_ANYDATA_RAW or read from JSON input.
+ *
+ * Supported conversions are from #LYD_ANYDATA_SXML to #LYD_ANYDATA_XML and back, and from #LYD_ANYDATA_SXML,
+ * #LYD_ANYDATA_XML, and #LYD_ANYDATA_JSON to #LYD_ANYDATA_DATATREE. Converting to the current value type
+ * does nothing. #LYD_ANYDATA_SXML content without any elements becomes an empty #LYD_ANYDATA_CONSTSTRING
+ * instead of #LYD_ANYDATA_XML.
+ *
+ * @param[in] node Anydata or anyxml node to convert.
+ * @param[in] value_type Requested value type.
+ * @param[in] options Parser options for #LYD_ANYDATA_DATATREE, see @ref parseroptions. Only data trees
+ * (not RPCs, replies, or notifications) can be parsed.
+ * @return EXIT_SUCCESS on success, EXIT_FAILURE on error, the value is not changed then.
+ */
+int lyd_anydata_convert(struct lyd_node *node, LYD_ANYDATA_VALUETYPE value_type, int options);
+
 /**
  * @brief Create a new anydata or anyxml node in a data tree. Ignore RPC/action input nodes and instead use
  * RPC/action output ones.
@@ -877,6 +1081,65 @@ struct lyd_node *lyd_new_yangdata(const struct lys_module *module, const char *n
 struct lyd_node *lyd_new_path(struct lyd_node *data_tree, const struct ly_ctx *ctx, const char *path, void *value,
                               LYD_ANYDATA_VALUETYPE value_type, int options);
 
+/**
+ * @brief Opaque structure of a compiled path template, see lyd_path_template_compile().
+ */
+struct lyd_path_template;
+
+/**
+ * @brief Compile a data path into a template for creating many data nodes with the same schema path,
+ * see lyd_new_path_template().
+ *
+ * The schema nodes on the path are resolved only once. Predicates in \p path are optional and their values
+ * are ignored, the instances are given all the key values on creation. The template must not be used after
+ * any module it refers to is removed from its context.
+ *
+ * @param[in] ctx Context to use.
+ * @param[in] path Absolute simple data path (see @ref howtoxpath) to a container, list, leaf, leaf-list,
+ * anydata, anyxml, notification, RPC, or action.
+ * @param[in] options Only #LYD_PATH_OPT_OUTPUT is considered, see @ref pathoptions.
+ * @return Compiled template to be freed by lyd_path_template_free(), NULL on error.
+ */
+struct lyd_path_template *lyd_path_template_compile(const struct ly_ctx *ctx, const char *path, int options);
+
+/**
+ * @brief Get the number of values needed for creating an instance of a path template.
+ *
+ * @param[in] tmpl Path template.
+ * @return Number of values, see lyd_new_path_template().
+ */
+uint32_t lyd_path_template_value_count(const struct lyd_path_template *tmpl);
+
+/**
+ * @brief Free a compiled path template.
+ *
+ * @param[in] tmpl Path template to free.
+ */
+void lyd_path_template_free(struct lyd_path_template *tmpl);
+
+/**
+ * @brief Create a new data node based on a compiled path template. Works the same way as lyd_new_path()
+ * with a path having predicates for all the lists.
+ *
+ * __PARTIAL CHANGE__ - validate after the final change on the data tree (see @ref howtodatamanipulators).
+ *
+ * The existing list and leaf-list instances are compared with the values as strings so they are found
+ * directly only if the values are canonical. Otherwise, the existing list instance is found after creating
+ * a new one.
+ *
+ * @param[in] data_tree Existing data tree to add to/modify (including siblings). Can be NULL.
+ * @param[in] tmpl Compiled path template.
+ * @param[in] values Array of lyd_path_template_value_count() values, the key values of all the lists on the path
+ * (in the order of the lists and their keys) followed by the value of the created leaf, leaf-list, anydata,
+ * or anyxml (as #LYD_ANYDATA_CONSTSTRING).
+ * @param[in] options Bitmask of options flags, see @ref pathoptions. #LYD_PATH_OPT_OUTPUT is taken from \p tmpl.
+ * @return First created (or updated with #LYD_PATH_OPT_UPDATE) node,
+ * NULL if #LYD_PATH_OPT_UPDATE was used and the full path exists or the leaf original value matches the value,
+ * NULL and ly_errno is set on error.
+ */
+struct lyd_node *lyd_new_path_template(struct lyd_node *data_tree, const struct lyd_path_template *tmpl,
+                                       const char **values, int options);
+
 /**
  * @brief Learn the relative instance position of a list or leaf-list within other instances of the
  * same schema node.
@@ -902,6 +1165,9 @@ unsigned int lyd_list_pos(const struct lyd_node *node);
 #define LYD_DUP_OPT_NO_ATTR      0x02 /**< Do not duplicate attributes of any node. */
 #define LYD_DUP_OPT_WITH_PARENTS 0x04 /**< If a nested node is being duplicated, duplicate also all the parents.
                                            Keys are also duplicated for lists. Return value does not change! */
+#define LYD_DUP_OPT_CONFIG       0x08 /**< Do not duplicate the state (config false) nodes with their subtrees, only
+                                           the configuration. Applies to the children and the duplicated siblings,
+                                           not to the \p node itself. */
 
 /** @} dupoptions */
 
@@ -993,6 +1259,43 @@ int lyd_merge(struct lyd_node *target, const struct lyd_node *source, int option
  */
 int lyd_merge_to_ctx(struct lyd_node **trg, const struct lyd_node *src, int options, struct ly_ctx *ctx);
 
+/**
+ * @brief NETCONF \<edit-config\> operations, the values match the ietf-netconf "operation" attribute.
+ */
+typedef enum {
+    LYD_EDIT_MERGE = 0,      /**< merge the node into the target, the default */
+    LYD_EDIT_REPLACE,        /**< replace the target node (subtree) */
+    LYD_EDIT_CREATE,         /**< create the node, it must not exist */
+    LYD_EDIT_DELETE,         /**< delete the node, it must exist */
+    LYD_EDIT_REMOVE,         /**< delete the node if it exists */
+    LYD_EDIT_NONE            /**< do not change the node, only its descendants with an operation, as the default only */
+} LYD_EDIT_OP;
+
+/**
+ * @brief Parse the content of a NETCONF \<edit-config\>'s config element and apply it directly to a data tree.
+ *
+ * __PARTIAL CHANGE__ - validate after the final change on the data tree (see @ref howtodatamanipulators).
+ *
+ * The data are parsed as #LYD_OPT_EDIT and each parsed node is matched with its instance in \p target
+ * using the data hash tables. The ietf-netconf "operation" attributes are then applied in place and
+ * the parsed nodes are moved into \p target instead of being duplicated as with lyd_merge(). The operations
+ * follow RFC 6241, section 7.2, the "insert" attributes are not applied, new user-ordered instances are
+ * always appended.
+ *
+ * On error, \p target can already be partially modified.
+ *
+ * @param[in] ctx Context of the data.
+ * @param[in,out] target Top-level data tree to edit, can point to NULL for an empty tree. Set to the first
+ * top-level sibling after the change.
+ * @param[in] data Serialized edit data.
+ * @param[in] format Format of the \p data, XML or JSON.
+ * @param[in] options Parser options, see @ref parseroptions, without any data type option.
+ * @param[in] default_op Default operation, one of #LYD_EDIT_MERGE, #LYD_EDIT_REPLACE, or #LYD_EDIT_NONE.
+ * @return EXIT_SUCCESS or EXIT_FAILURE.
+ */
+int lyd_parse_edit(struct ly_ctx *ctx, struct lyd_node **target, const char *data, LYD_FORMAT format, int options,
+                   LYD_EDIT_OP default_op);
+
 #define LYD_OPT_EXPLICIT 0x0100
 
 /**
@@ -1011,6 +1314,8 @@ int lyd_merge_to_ctx(struct lyd_node **trg, const struct lyd_node *src, int opti
  * instance is silently replaced. If it contains the exact same default node, it is replaced as well.
  * - if a non-default node is being inserted and there is already its non-default instance in the target tree, the new
  * node is inserted and it is up to the caller to solve the presence of multiple instances afterwards.
+ * - if the context was created with #LY_CTX_SORTED_INSERT, the node is placed in the schema order of the siblings
+ * (after the existing instances of the same list or leaf-list) instead of being placed as the last element.
  *
  * Note that this function differs from lyd_insert_before() and lyd_insert_after() because the position of the
  * node being inserted is determined automatically according to the rules described above. In contrast to
@@ -1025,6 +1330,22 @@ int lyd_merge_to_ctx(struct lyd_node **trg, const struct lyd_node *src, int opti
  */
 int lyd_insert(struct lyd_node *parent, struct lyd_node *node);
 
+/**
+ * @brief Insert a chain of new sibling nodes as the last children of the \p parent element at once.
+ *
+ * __PARTIAL CHANGE__ - validate after the final change on the data tree (see @ref howtodatamanipulators).
+ *
+ * Works the same way as lyd_insert() with all the siblings. If they are all non-default list and leaf-list
+ * instances of the parent, they are linked at once, the hash table of the parent children is enlarged only
+ * once, and the parent is invalidated only once, which is much faster for many instances.
+ *
+ * @param[in] parent Parent node for the \p first node and its siblings.
+ * @param[in] first First node of a chain of siblings without a parent (created by lyd_new() with NULL parent
+ * and connected by lyd_insert_after(), for instance).
+ * @return 0 on success, nonzero in case of error, e.g. when the nodes do not belong under the parent.
+ */
+int lyd_insert_batch(struct lyd_node *parent, struct lyd_node *first);
+
 /**
  * @brief Insert the \p node element as a last sibling of the specified \p sibling element.
  *
@@ -1040,6 +1361,8 @@ int lyd_insert(struct lyd_node *parent, struct lyd_node *node);
  * instance is silently replaced. If it contains the exact same default node, it is replaced as well.
  * - if a non-default node is being inserted and there is already its non-default instance in the target tree, the new
  * node is inserted and it is up to the caller to solve the presence of multiple instances afterwards.
+ * - if the context was created with #LY_CTX_SORTED_INSERT, the node is placed in the schema order of the siblings
+ * (after the existing instances of the same list or leaf-list) instead of being placed as the last element.
  *
  * Note that this function differs from lyd_insert_before() and lyd_insert_after() because the position of the
  * node being inserted is determined automatically as in the case of lyd_insert(). In contrast to lyd_insert(),
@@ -1121,6 +1444,77 @@ int lyd_schema_sort(struct lyd_node *sibling, int recursive);
  */
 struct ly_set *lyd_find_path(const struct lyd_node *ctx_node, const char *path);
 
+/**
+ * @brief Opaque structure of a compiled data path, see lyd_path_compile().
+ */
+struct lyd_path_query;
+
+/**
+ * @brief Compile a data path so that it can be repeatedly evaluated by lyd_find_compiled().
+ *
+ * The path is parsed, its module prefixes checked and its name tests and functions resolved only once,
+ * so it is meant for paths that are evaluated many times on different data trees. The compiled path
+ * must not be used after \p module is removed from its context.
+ *
+ * @param[in] module Module of the context nodes the path is going to be evaluated on, unprefixed node
+ * names in relative paths belong to it.
+ * @param[in] path Data path expression in the same format as for lyd_find_path().
+ * @return Compiled path to be freed by lyd_path_query_free(), NULL on error.
+ */
+struct lyd_path_query *lyd_path_compile(const struct lys_module *module, const char *path);
+
+/**
+ * @brief Search in the given data for instances of nodes matching the compiled path.
+ *
+ * @param[in] ctx_node Path context node, it must be from the module the path was compiled for.
+ * @param[in] query Compiled path.
+ * @return Set of found data nodes, the same as for lyd_find_path(). In case of an error, NULL is returned.
+ */
+struct ly_set *lyd_find_compiled(const struct lyd_node *ctx_node, const struct lyd_path_query *query);
+
+/**
+ * @brief Free a compiled path.
+ *
+ * @param[in] query Compiled path to free.
+ */
+void lyd_path_query_free(struct lyd_path_query *query);
+
+/**
+ * @brief Opaque structure of an iterator over data nodes matching a path, see lyd_find_iter_new().
+ */
+struct lyd_find_iter;
+
+/**
+ * @brief Create an iterator over the instances of nodes matching the provided path.
+ *
+ * Plain location paths, meaning node name tests separated by '/' with optional predicates that
+ * do not use position(), last(), or current(), are evaluated incrementally by lyd_find_iter_next()
+ * without building the whole result. Any other path is evaluated at once as by lyd_find_path().
+ * The data tree must not be modified while the iterator is used.
+ *
+ * @param[in] ctx_node Path context node.
+ * @param[in] path Data path expression in the same format as for lyd_find_path().
+ * @return Iterator to be freed by lyd_find_iter_free(), NULL on error.
+ */
+struct lyd_find_iter *lyd_find_iter_new(const struct lyd_node *ctx_node, const char *path);
+
+/**
+ * @brief Get the next data node matching the path of an iterator.
+ *
+ * The nodes are returned in the document order.
+ *
+ * @param[in] iter Iterator created by lyd_find_iter_new().
+ * @return Next matching data node, NULL if there are no more or on error.
+ */
+struct lyd_node *lyd_find_iter_next(struct lyd_find_iter *iter);
+
+/**
+ * @brief Free a data node iterator.
+ *
+ * @param[in] iter Iterator to free.
+ */
+void lyd_find_iter_free(struct lyd_find_iter *iter);
+
 /**
  * @brief Search in the given data for instances of the provided schema node.
  *
@@ -1133,6 +1527,22 @@ struct ly_set *lyd_find_path(const struct lyd_node *ctx_node, const char *path);
  */
 struct ly_set *lyd_find_instance(const struct lyd_node *data, const struct lys_node *schema);
 
+/**
+ * @brief Find an instance of the provided schema node among siblings by its key values (lists) or value (leaf-lists).
+ *
+ * Unlike lyd_find_path(), no path is parsed and, if libyang is built with the data cache, the instance is
+ * looked up in the hash table of the parent children directly, so it takes a constant time.
+ *
+ * @param[in] siblings Any of the siblings to search (the first child of a parent, for instance).
+ * @param[in] schema Schema node of the data node to find.
+ * @param[in] values Values of all the keys of a list in their schema order, a single value of a leaf-list,
+ * ignored for other nodes (their first instance is found, the same as for keyless lists). The values must be
+ * in the canonical form.
+ * @return Found data node, NULL if there is none or in case of an error.
+ */
+struct lyd_node *lyd_find_sibling_val(const struct lyd_node *siblings, const struct lys_node *schema,
+                                     const char **values);
+
 /**
  * @brief Get the first sibling of the given node.
  *
@@ -1171,6 +1581,9 @@ struct lyd_node *lyd_first_sibling(struct lyd_node *node);
  *                   - LYD_DIFF_DELETED:
  *                      - first - Unlinked subtree of the deleted nodes.
  *                      - second - Path identifying the original parent (format of lyd_path()).
+ *                If options also include #LYD_OPT_VAL_DIFF_REF, a (struct lyd_val_change **) is expected instead
+ *                and the changes are stored as an array of ::lyd_val_change records, to be freed
+ *                by lyd_free_val_changes().
  * @return 0 on success, nonzero in case of an error.
  */
 int lyd_validate(struct lyd_node **node, int options, void *var_arg, ...);
@@ -1195,17 +1608,94 @@ int lyd_validate(struct lyd_node **node, int options, void *var_arg, ...);
  *                   - LYD_DIFF_DELETED:
  *                      - first - Unlinked subtree of the deleted nodes.
  *                      - second - Path identifying the original parent (format of lyd_path()).
+ *                If options also include #LYD_OPT_VAL_DIFF_REF, a (struct lyd_val_change **) is expected instead
+ *                and the changes are stored as an array of ::lyd_val_change records, to be freed
+ *                by lyd_free_val_changes().
  * @return 0 on success, nonzero in case of an error.
  */
 int lyd_validate_modules(struct lyd_node **node, const struct lys_module **modules, int mod_count, int options, ...);
 
 /**
- * @brief Free special diff that was returned by lyd_validate() or lyd_validate_modules().
+ * @brief Free special diff that was returned by lyd_validate(), lyd_validate_modules() or lyd_journal_diff().
  *
  * @param[in] diff Diff to free.
  */
 void lyd_free_val_diff(struct lyd_difflist *diff);
 
+/**
+ * @brief Compact record of a data node change performed by the validation, returned instead of a diff
+ * with #LYD_OPT_VAL_DIFF_REF.
+ *
+ * No subtrees are duplicated, the created nodes are referenced directly in the validated tree. The records
+ * are valid only until the validated tree is modified or freed. The deleted nodes are freed by the validation,
+ * only the nodes deleted directly are recorded, not their descendants or nodes whose ancestor was deleted, too.
+ */
+struct lyd_val_change {
+    LYD_DIFFTYPE type;              /**< #LYD_DIFF_CREATED or #LYD_DIFF_DELETED, #LYD_DIFF_END terminates the array */
+    const struct lys_node *schema;  /**< schema node of the created or deleted node */
+    struct lyd_node *parent;        /**< parent of the node in the validated tree, NULL for top-level nodes */
+    struct lyd_node *node;          /**< created node (with its subtree) in the validated tree, NULL if deleted */
+    const char *value;              /**< value of a deleted leaf or leaf-list (in the dictionary), NULL otherwise */
+};
+
+/**
+ * @brief Get the path of a node changed by the validation, the same format as lyd_path().
+ *
+ * The path of a deleted list instance has no key predicates, the keys were deleted with it.
+ *
+ * @param[in] change Record from the array returned by lyd_validate() with #LYD_OPT_VAL_DIFF_REF.
+ * @return Path of the node (to be freed by the caller), NULL on error.
+ */
+char *lyd_val_change_path(const struct lyd_val_change *change);
+
+/**
+ * @brief Free the array of changes returned by lyd_validate() or lyd_validate_modules() with #LYD_OPT_VAL_DIFF_REF.
+ *
+ * @param[in] changes Array of changes to free.
+ */
+void lyd_free_val_changes(struct lyd_val_change *changes);
+
+/**
+ * @brief Opaque journal of data tree changes, see lyd_journal_start().
+ */
+struct lyd_journal;
+
+/**
+ * @brief Start recording changes of a data tree.
+ *
+ * The changes performed by lyd_new*(), lyd_insert*(), lyd_unlink(), lyd_free*(), lyd_change_leaf() and lyd_merge*()
+ * on the tree are recorded as they happen so that the diff can be get without comparing the whole trees
+ * with lyd_diff(). Only the changes performed in the calling thread are recorded and only one journal can be
+ * active in a thread. Implicit default nodes (created or removed by the validation) are not recorded.
+ * The journal must be stopped before the whole tree is freed.
+ *
+ * @param[in] tree Any top-level node of the data tree, all its siblings are journaled.
+ * @return Started journal, NULL on error.
+ */
+struct lyd_journal *lyd_journal_start(struct lyd_node *tree);
+
+/**
+ * @brief Get the changes recorded since the journal was started or since the last call of this function.
+ *
+ * The records are in the order the changes were performed. #LYD_DIFF_CREATED and #LYD_DIFF_DELETED have
+ * the same meaning as in the diff returned by lyd_validate() with #LYD_OPT_VAL_DIFF, #LYD_DIFF_CHANGED has
+ * the path of the leaf/anydata in lyd_difflist::first and its duplicate in lyd_difflist::second. A user-ordered
+ * instance created before an existing instance is followed by #LYD_DIFF_MOVEDAFTER2 with the path of the preceding
+ * instance (NULL if it is the first one) in lyd_difflist::first and the path of the created instance in
+ * lyd_difflist::second.
+ *
+ * @param[in] journal Journal to read.
+ * @return Diff to be freed by lyd_free_val_diff(), NULL on error.
+ */
+struct lyd_difflist *lyd_journal_diff(struct lyd_journal *journal);
+
+/**
+ * @brief Stop recording the changes and free the journal with the changes not read by lyd_journal_diff().
+ *
+ * @param[in] journal Journal to stop.
+ */
+void lyd_journal_stop(struct lyd_journal *journal);
+
 /**
  * @brief Check restrictions applicable to the particular leaf/leaf-list on the given string value.
  *
@@ -1222,6 +1712,46 @@ void lyd_free_val_diff(struct lyd_difflist *diff);
  */
 int lyd_validate_value(struct lys_node *node, const char *value);
 
+/**
+ * @brief Value checker of a leaf or leaf-list, see lyd_value_checker_new().
+ */
+struct lyd_value_checker;
+
+/**
+ * @brief Create a value checker of a leaf or leaf-list for checking many values the same way as
+ * lyd_validate_value() does.
+ *
+ * The type of the node (the type of the target for a leafref) is resolved once, together with the union members,
+ * the compiled patterns, and the length and range intervals of the whole typedef chain. Values of the built-in
+ * types except identityref and instance-identifier are then checked by lyd_value_check() without any allocation
+ * or logging. The values of the other types (including the unions with them) are checked by lyd_validate_value()
+ * without logging.
+ *
+ * The checker refers to the schema, so it must be freed before the schema of the node is changed or removed.
+ *
+ * @param[in] node Schema node of a leaf or leaf-list.
+ * @return Value checker to be freed by lyd_value_checker_free(), NULL on error.
+ */
+struct lyd_value_checker *lyd_value_checker_new(const struct lys_node *node);
+
+/**
+ * @brief Check a value using a value checker, see lyd_value_checker_new(). Does not log.
+ *
+ * Can be called concurrently with the same checker.
+ *
+ * @param[in] checker Value checker.
+ * @param[in] value Value to be checked (NULL is checked as empty string).
+ * @return EXIT_SUCCESS if the \p value conforms to the restrictions, EXIT_FAILURE otherwise.
+ */
+int lyd_value_check(const struct lyd_value_checker *checker, const char *value);
+
+/**
+ * @brief Free a value checker.
+ *
+ * @param[in] checker Value checker to free.
+ */
+void lyd_value_checker_free(struct lyd_value_checker *checker);
+
 /**
  * @brief Get know if the node contain (despite implicit or explicit) default value.
  *
@@ -1268,68 +1798,286 @@ void lyd_free(struct lyd_node *node);
 void lyd_free_withsiblings(struct lyd_node *node);
 
 /**
- * @brief Insert attribute into the data node.
+ * @brief Free the specified data tree and all its siblings in a background thread of the context.
  *
- * @param[in] parent Data node where to place the attribute
- * @param[in] mod An alternative way to specify attribute's module (namespace) used in case the \p name does
- *            not include prefix. If neither prefix in the \p name nor mod is specified, the attribute's
- *            module is inherited from the \p parent node. It is not allowed to have attributes with no
- *            module (namespace).
- * @param[in] name Attribute name. The string can include the attribute's module (namespace) as the name's
- *            prefix (prefix:name). Prefix must be the name of one of the schema in the \p parent's context.
- *            If the prefix is not specified, the \p mod parameter is used. If neither of these parameters is
- *            usable, attribute inherits module (namespace) from the \p parent node. It is not allowed to
- *            have attributes with no module (namespace).
- * @param[in] value Attribute value
- * @return pointer to the created attribute (which is already connected in \p parent) or NULL on error.
+ * Meant for large trees that are no longer needed, the calling thread does not wait for them to be freed.
+ * The tree must not be accessed in any way after calling this function. If \p node is not a top-level node,
+ * the siblings are unlinked and freed immediately by lyd_free_withsiblings(). The context modules are not
+ * removed until all the trees are freed, and the freeing is finished by ly_ctx_destroy() at the latest.
+ *
+ * @param[in] node One of the top-level siblings of the data tree to be freed.
  */
-struct lyd_attr *lyd_insert_attr(struct lyd_node *parent, const struct lys_module *mod, const char *name,
-                                 const char *value);
+void lyd_free_deferred(struct lyd_node *node);
 
 /**
- * @brief Destroy data attribute
+ * @brief Wait until all the data trees passed to lyd_free_deferred() are freed.
  *
- * If the attribute to destroy is a member of a node attribute list, it is necessary to
- * provide the node itself as \p parent to keep the list consistent.
+ * Needed before freeing an arena (see lyd_arena_free()) with nodes of such trees.
  *
- * @param[in] ctx Context where the attribute was created (usually it is the context of the \p parent)
- * @param[in] parent Parent node where the attribute is placed
- * @param[in] attr Attribute to destroy
- * @param[in] recursive Zero to destroy only the attribute, non-zero to destroy also all the subsequent attributes
- *            in the list.
+ * @param[in] ctx Context of the trees.
  */
-void lyd_free_attr(struct ly_ctx *ctx, struct lyd_node *parent, struct lyd_attr *attr, int recursive);
+void lyd_free_deferred_wait(struct ly_ctx *ctx);
 
 /**
- * @brief Return main module of the data tree node.
+ * @brief Opaque structure of a data node arena, see lyd_arena_new().
+ */
+struct lyd_arena;
+
+/**
+ * @brief Create a new arena for allocating data nodes.
  *
- * In case of regular YANG module, it returns ::lys_node#module pointer,
- * but in case of submodule, it returns pointer to the main module.
+ * When the arena is activated in a thread by lyd_arena_use(), all the data nodes created in that thread
+ * (by the parsers, lyd_new*() or lyd_dup*() functions) are allocated from contiguous memory blocks of the
+ * arena instead of separate heap allocations. Freeing such nodes with lyd_free() and similar functions
+ * releases only the values referenced by the nodes, the memory of the nodes themselves is released
+ * at once by lyd_arena_free(). It is meant for short-lived data trees that are created and freed repeatedly.
  *
- * @param[in] node Data tree node to be examined
- * @return pointer to the main module (schema structure), NULL in case of error.
+ * An arena can be active only in one thread at a time.
+ *
+ * @param[in] block_size Size of the blocks allocated by the arena, 0 for the default size.
+ * @return New arena, NULL on error.
  */
-struct lys_module *lyd_node_module(const struct lyd_node *node);
+struct lyd_arena *lyd_arena_new(size_t block_size);
 
 /**
- * @brief Get the type structure of a leaf.
+ * @brief Activate an arena for the calling thread.
  *
- * In case of a union, the correct specific type is found.
- * In case of a leafref, the final (if there is a chain of leafrefs) target's type is found.
+ * @param[in] arena Arena to allocate the data nodes from, NULL to use the standard allocation again.
+ * @return Previously active arena of the thread, NULL if there was none.
+ */
+struct lyd_arena *lyd_arena_use(struct lyd_arena *arena);
+
+/**
+ * @brief Free all the data nodes allocated from the arena and the arena itself.
  *
- * @param[in] leaf Leaf to examine.
- * @return Found type, NULL on error.
+ * The data trees with nodes from the arena must be freed by lyd_free_withsiblings() (or any other freeing
+ * function) before, because the arena does not know which values the nodes reference. The arena must not be
+ * active in any thread.
+ *
+ * @param[in] arena Arena to free.
  */
-const struct lys_type *lyd_leaf_type(const struct lyd_node_leaf_list *leaf);
+void lyd_arena_free(struct lyd_arena *arena);
 
 /**
-* @brief Print data tree in the specified format.
-*
+ * @brief Release all the memory of the arena for reuse, without freeing the blocks.
+ *
+ * The same conditions as for lyd_arena_free() apply.
+ *
+ * @param[in] arena Arena to reset.
+ */
+void lyd_arena_reset(struct lyd_arena *arena);
+
+/**
+ * @brief Relocate a data tree into a single new arena to improve its memory locality.
+ *
+ * All the siblings of \p tree (which must be top-level) with all their descendants are duplicated into
+ * one contiguous block in the depth-first order and the children hash tables of all the inner nodes
+ * are created at once. The original nodes are freed. The tree is meant to be only read afterwards, modifying
+ * it is possible but any new nodes are allocated separately.
+ *
+ * When no longer needed, the tree must be freed by lyd_free_withsiblings() and then the arena by lyd_arena_free().
+ *
+ * @param[in,out] tree Top-level data tree to compact, it is replaced by its relocated copy.
+ * @return Arena holding the tree nodes, NULL on error (\p tree is left unchanged).
+ */
+struct lyd_arena *lyd_compact(struct lyd_node **tree);
+
+/**
+ * @brief Opaque structure of a versioned data tree, see lyd_vtree_new().
+ */
+struct lyd_vtree;
+
+/**
+ * @brief Opaque structure of a single version of a versioned data tree, see lyd_vtree_pin().
+ */
+struct lyd_vtree_ver;
+
+/**
+ * @brief Create a versioned data tree allowing concurrent readers and a single writer.
+ *
+ * Every version is a separate data tree that is never modified after it was published. Readers pin
+ * the latest version by lyd_vtree_pin() and can then use it without any locking (printing, searching,
+ * XPath evaluation), even while the writer publishes new versions. The writer gets its own copy of the latest
+ * version by lyd_vtree_copy(), modifies it, and makes it the latest version by lyd_vtree_publish().
+ * A version is freed when it is no longer the latest one and the last reader unpins it.
+ *
+ * The functions modifying the data trees (including validation and functions that may add default nodes)
+ * must not be used on the pinned trees.
+ *
+ * @param[in] root First top-level node of the initial version, the versioned tree takes ownership of it.
+ * Can be NULL for an empty tree.
+ * @return Versioned data tree, NULL on error.
+ */
+struct lyd_vtree *lyd_vtree_new(struct lyd_node *root);
+
+/**
+ * @brief Pin the latest version of a versioned data tree for reading.
+ *
+ * @param[in] vtree Versioned data tree.
+ * @param[out] root Optional first top-level node of the version, NULL if it is empty.
+ * @return Pinned version to be unpinned by lyd_vtree_unpin(), NULL on error.
+ */
+struct lyd_vtree_ver *lyd_vtree_pin(struct lyd_vtree *vtree, struct lyd_node **root);
+
+/**
+ * @brief Unpin a version of a versioned data tree, its data tree must not be accessed afterwards.
+ *
+ * @param[in] ver Version returned by lyd_vtree_pin().
+ */
+void lyd_vtree_unpin(struct lyd_vtree_ver *ver);
+
+/**
+ * @brief Get the number of a version, the initial version is 1 and every published version increments it.
+ *
+ * @param[in] ver Pinned version.
+ * @return Version number.
+ */
+uint64_t lyd_vtree_ver_id(const struct lyd_vtree_ver *ver);
+
+/**
+ * @brief Get a private copy of the latest version of a versioned data tree to be modified and published.
+ *
+ * @param[in] vtree Versioned data tree.
+ * @return Duplicated data tree, NULL on error or if the latest version is empty.
+ */
+struct lyd_node *lyd_vtree_copy(struct lyd_vtree *vtree);
+
+/**
+ * @brief Publish a new latest version of a versioned data tree.
+ *
+ * Only a single thread is expected to publish new versions, otherwise the changes of concurrent writers
+ * are overwritten. The previous version stays valid for its current readers.
+ *
+ * @param[in] vtree Versioned data tree.
+ * @param[in] root First top-level node of the new version, the versioned tree takes ownership of it.
+ * Can be NULL for an empty tree.
+ * @return EXIT_SUCCESS or EXIT_FAILURE.
+ */
+int lyd_vtree_publish(struct lyd_vtree *vtree, struct lyd_node *root);
+
+/**
+ * @brief Free a versioned data tree. The pinned versions stay valid until they are unpinned.
+ *
+ * @param[in] vtree Versioned data tree to free.
+ */
+void lyd_vtree_free(struct lyd_vtree *vtree);
+
+/**
+ * @brief Insert attribute into the data node.
+ *
+ * @param[in] parent Data node where to place the attribute
+ * @param[in] mod An alternative way to specify attribute's module (namespace) used in case the \p name does
+ *            not include prefix. If neither prefix in the \p name nor mod is specified, the attribute's
+ *            module is inherited from the \p parent node. It is not allowed to have attributes with no
+ *            module (namespace).
+ * @param[in] name Attribute name. The string can include the attribute's module (namespace) as the name's
+ *            prefix (prefix:name). Prefix must be the name of one of the schema in the \p parent's context.
+ *            If the prefix is not specified, the \p mod parameter is used. If neither of these parameters is
+ *            usable, attribute inherits module (namespace) from the \p parent node. It is not allowed to
+ *            have attributes with no module (namespace).
+ * @param[in] value Attribute value
+ * @return pointer to the created attribute (which is already connected in \p parent) or NULL on error.
+ */
+struct lyd_attr *lyd_insert_attr(struct lyd_node *parent, const struct lys_module *mod, const char *name,
+                                 const char *value);
+
+/**
+ * @brief Destroy data attribute
+ *
+ * If the attribute to destroy is a member of a node attribute list, it is necessary to
+ * provide the node itself as \p parent to keep the list consistent.
+ *
+ * @param[in] ctx Context where the attribute was created (usually it is the context of the \p parent)
+ * @param[in] parent Parent node where the attribute is placed
+ * @param[in] attr Attribute to destroy
+ * @param[in] recursive Zero to destroy only the attribute, non-zero to destroy also all the subsequent attributes
+ *            in the list.
+ */
+void lyd_free_attr(struct ly_ctx *ctx, struct lyd_node *parent, struct lyd_attr *attr, int recursive);
+
+/**
+ * @brief Find an attribute of a data node by its annotation definition.
+ *
+ * The attributes are matched by the definition pointer, no names or modules are compared, so the
+ * definition should be found once by lys_find_annotation() and used for all the nodes.
+ *
+ * @param[in] node Data node with the attributes.
+ * @param[in] annotation Annotation definition, see lys_find_annotation().
+ * @return Found attribute, NULL if the node has no such attribute.
+ */
+struct lyd_attr *lyd_find_attr(const struct lyd_node *node, const struct lys_ext_instance_complex *annotation);
+
+/**
+ * @brief Return main module of the data tree node.
+ *
+ * In case of regular YANG module, it returns ::lys_node#module pointer,
+ * but in case of submodule, it returns pointer to the main module.
+ *
+ * @param[in] node Data tree node to be examined
+ * @return pointer to the main module (schema structure), NULL in case of error.
+ */
+struct lys_module *lyd_node_module(const struct lyd_node *node);
+
+/**
+ * @brief Get the type structure of a leaf.
+ *
+ * In case of a union, the correct specific type is found.
+ * In case of a leafref, the final (if there is a chain of leafrefs) target's type is found.
+ *
+ * @param[in] leaf Leaf to examine.
+ * @return Found type, NULL on error.
+ */
+const struct lys_type *lyd_leaf_type(const struct lyd_node_leaf_list *leaf);
+
+/**
+ * @brief Learn whether a bit is set in the value of a bits leaf or leaf-list.
+ *
+ * @param[in] node Leaf or leaf-list with a bits value.
+ * @param[in] name Name of the bit.
+ * @return 1 if the bit is set, 0 if not or the node value is not a bits value, -1 on error.
+ */
+int lyd_bit_is_set(const struct lyd_node *node, const char *name);
+
+/**
+ * @brief Get the decoded value of a binary leaf or leaf-list.
+ *
+ * Every value is decoded only once and kept in the context, the following calls for the same value
+ * (even of other nodes) return the same data. They remain valid until ly_ctx_clean_binary() is called
+ * or the context is destroyed.
+ *
+ * @param[in] node Leaf or leaf-list with a binary value.
+ * @param[out] len Length of the decoded data.
+ * @return Decoded data, NULL on error.
+ */
+const void *lyd_binary_value(const struct lyd_node *node, size_t *len);
+
+/**
+ * @brief Options for lyd_mem_usage().
+ */
+#define LYD_MEM_WITHSIBLINGS 0x01 /**< count also all the siblings of the node with their subtrees */
+
+/**
+ * @brief Get the memory occupied by a data subtree.
+ *
+ * Counted are the nodes, their attributes, child hash tables and values. The strings shared in the context
+ * dictionary are attributed to every reference equally, so the sizes of independent trees add up. Values
+ * of user types are opaque and not counted.
+ *
+ * @param[in] node Root of the subtree to examine.
+ * @param[in] options Bitmask of LYD_MEM_* options.
+ * @return Size in bytes, 0 on error.
+ */
+size_t lyd_mem_usage(const struct lyd_node *node, int options);
+
+/**
+* @brief Print data tree in the specified format.
+*
 * @param[out] strp Pointer to store the resulting dump.
 * @param[in] root Root node of the data tree to print. It can be actually any (not only real root)
 * node of the data tree to print the specific subtree.
 * @param[in] format Data output format.
-* @param[in] options [printer flags](@ref printerflags). \p format LYD_LYB accepts only #LYP_WITHSIBLINGS option.
+* @param[in] options [printer flags](@ref printerflags). \p format LYD_LYB accepts only #LYP_WITHSIBLINGS, #LYP_STRTABLE,
+ * #LYP_INDEX, and #LYP_IDENTIDX options.
 * @return 0 on success, 1 on failure (#ly_errno is set).
 */
 int lyd_print_mem(char **strp, const struct lyd_node *root, LYD_FORMAT format, int options);
@@ -1341,11 +2089,60 @@ int lyd_print_mem(char **strp, const struct lyd_node *root, LYD_FORMAT format, i
  * @param[in] root Root node of the data tree to print. It can be actually any (not only real root)
  * node of the data tree to print the specific subtree.
  * @param[in] format Data output format.
- * @param[in] options [printer flags](@ref printerflags). \p format LYD_LYB accepts only #LYP_WITHSIBLINGS option.
+ * @param[in] options [printer flags](@ref printerflags). \p format LYD_LYB accepts only #LYP_WITHSIBLINGS, #LYP_STRTABLE,
+ * #LYP_INDEX, and #LYP_IDENTIDX options.
  * @return 0 on success, 1 on failure (#ly_errno is set).
  */
 int lyd_print_fd(int fd, const struct lyd_node *root, LYD_FORMAT format, int options);
 
+/**
+ * @brief Queued output of lyd_print_fd_nb() waiting for its file descriptor.
+ */
+struct lyd_print_pending;
+
+/**
+ * @brief Print data tree in the specified format into a nonblocking file descriptor.
+ *
+ * The printing never waits for the file descriptor. The output is written in large chunks and once the file
+ * descriptor would block (EAGAIN), the rest of the output is queued in memory. The caller then writes the queued
+ * output by lyd_print_pending_write() whenever the file descriptor is writable (such as signaled by poll(2)).
+ *
+ * @param[in] fd Nonblocking file descriptor where to print the data.
+ * @param[in] root Root node of the data tree to print. It can be actually any (not only real root)
+ * node of the data tree to print the specific subtree.
+ * @param[in] format Data output format.
+ * @param[in] options [printer flags](@ref printerflags). \p format LYD_LYB accepts only #LYP_WITHSIBLINGS, #LYP_STRTABLE,
+ * #LYP_INDEX, and #LYP_IDENTIDX options.
+ * @param[out] pending Queued output to be written by lyd_print_pending_write() and freed by lyd_print_pending_free(),
+ * NULL if the whole output was written.
+ * @return 0 on success, 1 on failure (#ly_errno is set).
+ */
+int lyd_print_fd_nb(int fd, const struct lyd_node *root, LYD_FORMAT format, int options,
+                    struct lyd_print_pending **pending);
+
+/**
+ * @brief Continue writing the queued output of lyd_print_fd_nb() until its file descriptor would block.
+ *
+ * @param[in] pending Queued output.
+ * @return 0 if all the output was written, 1 if the file descriptor would block again, -1 on error (#ly_errno is set).
+ */
+int lyd_print_pending_write(struct lyd_print_pending *pending);
+
+/**
+ * @brief Get the length of the queued output of lyd_print_fd_nb() not written yet.
+ *
+ * @param[in] pending Queued output.
+ * @return Length in bytes.
+ */
+size_t lyd_print_pending_len(const struct lyd_print_pending *pending);
+
+/**
+ * @brief Free the queued output of lyd_print_fd_nb().
+ *
+ * @param[in] pending Queued output to free.
+ */
+void lyd_print_pending_free(struct lyd_print_pending *pending);
+
 /**
  * @brief Print data tree in the specified format.
  *
@@ -1353,7 +2150,8 @@ int lyd_print_fd(int fd, const struct lyd_node *root, LYD_FORMAT format, int opt
  * @param[in] root Root node of the data tree to print. It can be actually any (not only real root)
  * node of the data tree to print the specific subtree.
  * @param[in] format Data output format.
- * @param[in] options [printer flags](@ref printerflags). \p format LYD_LYB accepts only #LYP_WITHSIBLINGS option.
+ * @param[in] options [printer flags](@ref printerflags). \p format LYD_LYB accepts only #LYP_WITHSIBLINGS, #LYP_STRTABLE,
+ * #LYP_INDEX, and #LYP_IDENTIDX options.
  * @return 0 on success, 1 on failure (#ly_errno is set).
  */
 int lyd_print_file(FILE *f, const struct lyd_node *root, LYD_FORMAT format, int options);
@@ -1365,7 +2163,8 @@ int lyd_print_file(FILE *f, const struct lyd_node *root, LYD_FORMAT format, int
  * @param[in] root Root node of the data tree to print. It can be actually any (not only real root)
  * node of the data tree to print the specific subtree.
  * @param[in] format Data output format.
- * @param[in] options [printer flags](@ref printerflags). \p format LYD_LYB accepts only #LYP_WITHSIBLINGS option.
+ * @param[in] options [printer flags](@ref printerflags). \p format LYD_LYB accepts only #LYP_WITHSIBLINGS, #LYP_STRTABLE,
+ * #LYP_INDEX, and #LYP_IDENTIDX options.
  * @return 0 on success, 1 on failure (#ly_errno is set).
  */
 int lyd_print_path(const char *path, const struct lyd_node *root, LYD_FORMAT format, int options);
@@ -1378,12 +2177,81 @@ int lyd_print_path(const char *path, const struct lyd_node *root, LYD_FORMAT for
  * node of the data tree to print the specific subtree.
  * @param[in] arg Optional caller-specific argument to be passed to the \p writeclb callback.
  * @param[in] format Data output format.
- * @param[in] options [printer flags](@ref printerflags). \p format LYD_LYB accepts only #LYP_WITHSIBLINGS option.
+ * @param[in] options [printer flags](@ref printerflags). \p format LYD_LYB accepts only #LYP_WITHSIBLINGS, #LYP_STRTABLE,
+ * #LYP_INDEX, and #LYP_IDENTIDX options.
  * @return 0 on success, 1 on failure (#ly_errno is set).
  */
 int lyd_print_clb(ssize_t (*writeclb)(void *arg, const void *buf, size_t count), void *arg,
                   const struct lyd_node *root, LYD_FORMAT format, int options);
 
+struct iovec;
+
+/**
+ * @brief Print data tree in the specified format as a sequence of memory segments.
+ *
+ * The segments are passed to the callback in batches. Long leaf and anydata values are not copied,
+ * their segments reference the data tree directly, so it must not be modified until the printing finishes.
+ *
+ * @param[in] writeclb Callback function to write the segments (see writev(2)).
+ * @param[in] arg Optional caller-specific argument to be passed to the \p writeclb callback.
+ * @param[in] root Root node of the data tree to print. It can be actually any (not only real root)
+ * node of the data tree to print the specific subtree.
+ * @param[in] format Data output format.
+ * @param[in] options [printer flags](@ref printerflags). \p format LYD_LYB accepts only #LYP_WITHSIBLINGS, #LYP_STRTABLE,
+ * #LYP_INDEX, and #LYP_IDENTIDX options.
+ * @return 0 on success, 1 on failure (#ly_errno is set).
+ */
+int lyd_print_iov(ssize_t (*writeclb)(void *arg, const struct iovec *iov, int iovcnt), void *arg,
+                  const struct lyd_node *root, LYD_FORMAT format, int options);
+
+/**
+ * @brief Print a page of list or leaf-list instances into a memory buffer.
+ *
+ * Only \p count instances starting with \p first are printed, enclosed in their ancestors (with the keys
+ * of the ancestor list instances), so the cost depends on the page size, not on the size of the tree.
+ * The returned \p next instance can be used as the start of the next page as long as the tree is not modified.
+ *
+ * @param[out] strp Pointer to store the resulting dump.
+ * @param[in] first First list or leaf-list instance of the page.
+ * @param[in] count Maximum number of instances to print, must not be 0.
+ * @param[in] format Data output format, only LYD_XML and LYD_JSON are supported.
+ * @param[in] options [printer flags](@ref printerflags), #LYP_WITHSIBLINGS and #LYP_NETCONF are ignored.
+ * @param[out] next Optional pointer to store the first instance of the following page, NULL if there is none.
+ * @return 0 on success, 1 on failure (#ly_errno is set).
+ */
+int lyd_print_page(char **strp, const struct lyd_node *first, uint32_t count, LYD_FORMAT format, int options,
+                   const struct lyd_node **next);
+
+/**
+ * @brief Callback producing the list instances printed by lyd_print_gen().
+ *
+ * @param[in] instance Empty list instance to fill with the keys and other children (such as by lyd_new_leaf()),
+ * it is freed by libyang once printed.
+ * @param[in] user_data User-supplied callback data.
+ * @return 0 if \p instance was filled, 1 if there are no more instances, -1 on error.
+ */
+typedef int (*lyd_print_gen_clb)(struct lyd_node *instance, void *user_data);
+
+/**
+ * @brief Print list instances produced one by one by a callback without building the whole data tree.
+ *
+ * The instances are printed enclosed in \p parent and its ancestors (with the keys of the ancestor list instances),
+ * as lyd_print_page() does, and each is printed and freed before the next one is produced, so the memory used does
+ * not depend on the number of the instances. Other children of \p parent are not printed.
+ *
+ * @param[in] writeclb Callback function to write the data (see write(1)).
+ * @param[in] arg Optional caller-specific argument to be passed to the \p writeclb callback.
+ * @param[in] parent Data parent of the instances, NULL for a top-level list.
+ * @param[in] list Schema node of the printed list.
+ * @param[in] format Data output format, only LYD_XML and LYD_JSON are supported.
+ * @param[in] options [printer flags](@ref printerflags), #LYP_WITHSIBLINGS and #LYP_NETCONF are ignored.
+ * @param[in] clb Callback producing the instances.
+ * @param[in] user_data Optional caller-specific argument to be passed to \p clb.
+ * @return 0 on success, 1 on failure (#ly_errno is set).
+ */
+int lyd_print_gen(ssize_t (*writeclb)(void *arg, const void *buf, size_t count), void *arg, const struct lyd_node *parent,
+                  const struct lys_node *list, LYD_FORMAT format, int options, lyd_print_gen_clb clb, void *user_data);
+
 /**
  * @brief Get the double value of a decimal64 leaf/leaf-list.
  *
@@ -1395,6 +2263,23 @@ int lyd_print_clb(ssize_t (*writeclb)(void *arg, const void *buf, size_t count),
  */
 double lyd_dec64_to_double(const struct lyd_node *node);
 
+/**
+ * @brief Parse only some top-level subtrees of LYB data printed with #LYP_INDEX.
+ *
+ * The subtrees are found in the index at the end of the data, the other subtrees are not read at all.
+ *
+ * @param[in] ctx Context to connect with the data tree being built here.
+ * @param[in] data LYB data.
+ * @param[in] length Length of \p data, 0 to learn it from the data, which must then be read until their end.
+ * @param[in] options [Parser options](@ref parseroptions), #LYD_OPT_RPCREPLY and #LYD_OPT_DATA_TEMPLATE are
+ * not supported.
+ * @param[in] path Path of the top-level node as returned by lyd_path(). A path without the list keys or
+ * the leaf-list value selects all the instances, a path in the form "/module:*" all the top-level nodes of a module.
+ * @return Pointer to the built data tree, NULL if no subtree matched or on error.
+ */
+struct lyd_node *lyd_parse_lyb_subtrees(struct ly_ctx *ctx, const char *data, size_t length, int options,
+                                        const char *path);
+
 /**
  * @brief Get the length of a printed LYB data tree.
  *
@@ -1403,6 +2288,423 @@ double lyd_dec64_to_double(const struct lyd_node *node);
  */
 int lyd_lyb_data_length(const char *data);
 
+/**
+ * @brief Print the changes of a diff as a LYB patch.
+ *
+ * Unlike printing the whole changed tree, the patch includes only the changed nodes, each identified by the schema
+ * hashes and the list keys (or leaf-list values) of its ancestors, so its size depends only on the changes.
+ * The patch is applied to a copy of the first tree of the diff with lyd_apply_lyb_patch(). Keyless list instances
+ * cannot be identified so the diff must not include any such changed nodes or their descendants.
+ *
+ * @param[out] strp Pointer to store the resulting patch. It is up to the caller to free the returned memory, its
+ * length can be learned with lyd_lyb_data_length().
+ * @param[in] diff Diff returned by lyd_diff().
+ * @param[in] options [printer flags](@ref printerflags), only #LYP_STRTABLE and #LYP_IDENTIDX are accepted.
+ * @return 0 on success, 1 on failure (#ly_errno is set).
+ */
+int lyd_print_lyb_patch(char **strp, const struct lyd_difflist *diff, int options);
+
+/**
+ * @brief Apply a LYB patch printed by lyd_print_lyb_patch() to a data tree.
+ *
+ * The changes are performed in the order they were in the diff, the nodes are found directly in the child hash
+ * tables if libyang is built with the data cache, so the time depends only on the number of the changes.
+ *
+ * __PARTIAL CHANGE__ - validate after the final change on the data tree (see @ref howtodatamanipulators).
+ *
+ * @param[in] ctx Context of the data tree.
+ * @param[in,out] root First top-level node of the data tree to patch, NULL for an empty tree, updated if the first
+ * top-level node changes.
+ * @param[in] data LYB patch.
+ * @return 0 on success, -1 on error, for example if the patched node is not in the tree, in which case
+ * the tree can be partially patched.
+ */
+int lyd_apply_lyb_patch(struct ly_ctx *ctx, struct lyd_node **root, const char *data);
+
+/**
+ * @brief LYB stream of data trees sharing a single header, see lyd_lyb_stream_new().
+ */
+struct lyd_lyb_stream;
+
+/**
+ * @brief Create a LYB stream for printing or parsing many data trees.
+ *
+ * The stream header with the models is printed (lyd_lyb_stream_print_header()) or parsed
+ * (lyd_lyb_stream_parse_header()) once and it is followed by any number of frames, each with some data trees
+ * (lyd_lyb_stream_print(), lyd_lyb_stream_parse()). The header includes all the implemented modules of the context
+ * so the frames refer to the modules only by their index and the modules found for the header are used for all
+ * the frames. The header starts with the magic number (3B) and flags (1B), it is followed by the length (4B,
+ * little-endian) of the rest of the header. Every frame starts with the length (4B, little-endian) of the rest of
+ * the frame so the data can be read from a connection in the same way. A stream is used for printing or for
+ * parsing, not both. The identityref values in the frames are always stored by their index (#LYP_IDENTIDX).
+ *
+ * @param[in] ctx Context of the data trees.
+ * @param[in] options [printer flags](@ref printerflags) of the printed frames, only #LYP_STRTABLE is accepted.
+ * @return New stream, NULL on error.
+ */
+struct lyd_lyb_stream *lyd_lyb_stream_new(struct ly_ctx *ctx, int options);
+
+/**
+ * @brief Free a LYB stream.
+ *
+ * @param[in] stream Stream to free.
+ */
+void lyd_lyb_stream_free(struct lyd_lyb_stream *stream);
+
+/**
+ * @brief Print the header of a LYB stream, it must be printed once, before any frame.
+ *
+ * The modules added into the context later cannot be printed in the frames of the stream.
+ *
+ * @param[out] strp Pointer to store the resulting header. It is up to the caller to free the returned memory, its
+ * length can be learned with lyd_lyb_data_length().
+ * @param[in] stream Stream to print.
+ * @return 0 on success, 1 on failure (#ly_errno is set).
+ */
+int lyd_lyb_stream_print_header(char **strp, struct lyd_lyb_stream *stream);
+
+/**
+ * @brief Print data trees as a frame of a LYB stream.
+ *
+ * @param[out] strp Pointer to store the resulting frame. It is up to the caller to free the returned memory, its
+ * length is 4 added to the number stored in its first 4 bytes.
+ * @param[in] stream Stream with the printed header.
+ * @param[in] root Top-level node of the data tree to print, NULL for an empty frame.
+ * @param[in] options [printer flags](@ref printerflags), only #LYP_WITHSIBLINGS is accepted.
+ * @return 0 on success, 1 on failure (#ly_errno is set).
+ */
+int lyd_lyb_stream_print(char **strp, struct lyd_lyb_stream *stream, const struct lyd_node *root, int options);
+
+/**
+ * @brief Parse the header of a LYB stream printed by lyd_lyb_stream_print_header().
+ *
+ * @param[in] stream Stream to parse.
+ * @param[in] data LYB stream header.
+ * @return Number of parsed bytes, -1 on error.
+ */
+int lyd_lyb_stream_parse_header(struct lyd_lyb_stream *stream, const char *data);
+
+/**
+ * @brief Parse a frame of a LYB stream printed by lyd_lyb_stream_print().
+ *
+ * The schema nodes found by the hashes of the frame are remembered by the stream so the following frames
+ * find them directly.
+ *
+ * @param[in] stream Stream with the parsed header.
+ * @param[in] data LYB stream frame.
+ * @param[in] options [Parser options](@ref parseroptions), #LYD_OPT_RPCREPLY and #LYD_OPT_DATA_TEMPLATE are
+ * not supported.
+ * @return Pointer to the built data tree, NULL if the frame is empty or on error (#ly_errno is set).
+ */
+struct lyd_node *lyd_lyb_stream_parse(struct lyd_lyb_stream *stream, const char *data, int options);
+
+/**
+ * @brief Lazily parsed LYB data, see lyd_lazy_new().
+ */
+struct lyd_lazy;
+
+/**
+ * @brief Open LYB data printed with #LYP_INDEX for parsing their top-level subtrees only when needed.
+ *
+ * Only the models and the index are read, every top-level subtree stays a stub until it is first needed by
+ * lyd_lazy_find_path(), lyd_lazy_tree(), or lyd_lazy_print_mem(). Then it is parsed from the data and linked
+ * among the other parsed top-level subtrees, in the order of the data. The subtrees not used recently can be
+ * freed again by lyd_lazy_evict().
+ *
+ * The data are not copied, they must be kept unchanged until lyd_lazy_free(). The data are trusted, they are
+ * not validated (#LYD_OPT_TRUSTED), and the references (leafrefs, instance-identifiers) are resolved only within
+ * their top-level subtree. The parsed subtrees must not be modified or unlinked, and the module set of the
+ * context must not change. The lazy data are not thread-safe.
+ *
+ * @param[in] ctx Context of the data.
+ * @param[in] data LYB data printed with #LYP_INDEX.
+ * @param[in] length Length of \p data, 0 to learn it from the data, which must then be read until their end.
+ * @param[in] options [Parser options](@ref parseroptions), only #LYD_OPT_DATA, #LYD_OPT_CONFIG, #LYD_OPT_GET,
+ * and #LYD_OPT_GETCONFIG data are supported.
+ * @return Lazy data to be freed by lyd_lazy_free(), NULL on error.
+ */
+struct lyd_lazy *lyd_lazy_new(struct ly_ctx *ctx, const char *data, size_t length, int options);
+
+/**
+ * @brief Get the data tree of lazy data with the required top-level subtrees parsed, see lyd_lazy_new().
+ *
+ * The returned tree can be traversed as any other data tree. Any lazy data function may parse more top-level
+ * subtrees, so the first node of the tree may change, and lyd_lazy_evict() frees some of them.
+ *
+ * @param[in] lazy Lazy data.
+ * @param[in] path Path of the top-level nodes to parse, in the form accepted by lyd_parse_lyb_subtrees(),
+ * NULL to parse all of them.
+ * @return First top-level node of the parsed subtrees, NULL if there are none or on error (#ly_errno is set).
+ */
+struct lyd_node *lyd_lazy_tree(struct lyd_lazy *lazy, const char *path);
+
+/**
+ * @brief Search lazy data for nodes matching a path, see lyd_find_path().
+ *
+ * Only the top-level subtrees matching the first step of an absolute \p path are parsed, exactly the list
+ * instance if its predicate is written as in the lyd_path() of the instance. Any other paths parse all
+ * the top-level subtrees.
+ *
+ * @param[in] lazy Lazy data.
+ * @param[in] path Data path.
+ * @return Set of found data nodes, NULL on error.
+ */
+struct ly_set *lyd_lazy_find_path(struct lyd_lazy *lazy, const char *path);
+
+/**
+ * @brief Print lazy data, see lyd_print_mem(). All the top-level subtrees are parsed first.
+ *
+ * @param[out] strp Pointer to store the resulting dump.
+ * @param[in] lazy Lazy data.
+ * @param[in] format Data output format.
+ * @param[in] options [printer flags](@ref printerflags), #LYP_WITHSIBLINGS is implied.
+ * @return 0 on success, 1 on failure (#ly_errno is set).
+ */
+int lyd_lazy_print_mem(char **strp, struct lyd_lazy *lazy, LYD_FORMAT format, int options);
+
+/**
+ * @brief Free the least recently used parsed top-level subtrees of lazy data, they become stubs again.
+ *
+ * Any pointers into the freed subtrees become invalid.
+ *
+ * @param[in] lazy Lazy data.
+ * @param[in] keep Number of the most recently used parsed top-level subtrees to keep.
+ * @return Number of the freed top-level subtrees.
+ */
+uint32_t lyd_lazy_evict(struct lyd_lazy *lazy, uint32_t keep);
+
+/**
+ * @brief Free lazy data with all the parsed subtrees.
+ *
+ * @param[in] lazy Lazy data to free.
+ */
+void lyd_lazy_free(struct lyd_lazy *lazy);
+
+/**
+ * @defgroup nacmoptions NACM access operations and options
+ * @ingroup datatree
+ *
+ * Access operations of the NACM rules (RFC 8341 access-operations) and options of lyd_nacm_apply().
+ *
+ * @{
+ */
+#define LYD_NACM_READ    0x01 /**< read access */
+#define LYD_NACM_CREATE  0x02 /**< create access */
+#define LYD_NACM_UPDATE  0x04 /**< update access */
+#define LYD_NACM_DELETE  0x08 /**< delete access */
+#define LYD_NACM_EXEC    0x10 /**< exec access */
+#define LYD_NACM_ALL     0x1f /**< all the access operations */
+
+#define LYD_NACM_PRUNE   0x01 /**< lyd_nacm_apply() option to free the denied subtrees instead of returning them */
+/** @} nacmoptions */
+
+/**
+ * @brief NACM rule, as in the rule list of a NACM group (RFC 8341).
+ */
+struct lyd_nacm_rule {
+    const char *module;          /**< name of the module of the nodes the rule applies to, NULL or "*" for any module */
+    const char *path;            /**< optional data path (with predicates) of the subtree the rule applies to,
+                                      NULL for a module rule */
+    uint8_t access;              /**< [access operations](@ref nacmoptions) the rule applies to */
+    uint8_t deny;                /**< whether the rule denies (1) or permits (0) the access */
+};
+
+/**
+ * @brief NACM rule list compiled for one access operation, see lyd_nacm_compile().
+ */
+struct lyd_nacm;
+
+/**
+ * @brief Compile NACM rules for checking one access operation on data trees.
+ *
+ * Module rules are indexed by their modules, rules with a path without predicates by their schema nodes,
+ * so checking a data node costs a few hash lookups regardless of the number of the rules. Paths with predicates
+ * are evaluated once for every data tree the rules are applied to. A rule with both a module and a path applies
+ * only if its path is in the module. The rules not applying to \p access are skipped.
+ *
+ * @param[in] ctx Context with the modules of the rules.
+ * @param[in] rules Rules in the order they are checked in, the first matching rule decides.
+ * @param[in] count Number of \p rules.
+ * @param[in] access The [access operation](@ref nacmoptions) to compile the rules for.
+ * @param[in] dflt_deny Whether the access is denied (1) or permitted (0) if no rule matches and there is no
+ * default-deny extension instance in the node (read-default, write-default or exec-default of RFC 8341).
+ * @return Compiled rules, NULL on error.
+ */
+struct lyd_nacm *lyd_nacm_compile(struct ly_ctx *ctx, const struct lyd_nacm_rule *rules, uint32_t count,
+                                  uint8_t access, int dflt_deny);
+
+/**
+ * @brief Free compiled NACM rules.
+ *
+ * @param[in] nacm Compiled rules to free.
+ */
+void lyd_nacm_free(struct lyd_nacm *nacm);
+
+/**
+ * @brief Apply compiled NACM rules to a data tree in a single pass.
+ *
+ * A node is decided by the first matching rule, which is the first of the module rules of its module and
+ * the path rules of the node and its ancestors. With no matching rule, the node is denied if it has
+ * a default-deny-all extension instance, a default-deny-write extension instance and the access is a write,
+ * or the default access is deny. The default-deny flags are precomputed in the schema nodes
+ * (#LYS_NACM_DENYW, #LYS_NACM_DENYA), no extension instances are searched. Denied nodes are never descended into
+ * and a list instance with a denied key is denied.
+ *
+ * @param[in] nacm Compiled rules.
+ * @param[in,out] root First top-level sibling of the data tree, it changes if it is pruned.
+ * @param[in] options [NACM options](@ref nacmoptions).
+ * @param[out] denied Set of the roots of the denied subtrees, must be NULL with #LYD_NACM_PRUNE.
+ * @return 0 on success, -1 on error.
+ */
+int lyd_nacm_apply(const struct lyd_nacm *nacm, struct lyd_node **root, int options, struct ly_set **denied);
+
+/**
+ * @brief Compiled NETCONF subtree filter, see lyd_filter_compile().
+ */
+struct lyd_filter;
+
+/**
+ * @brief Compile a NETCONF subtree filter (RFC 6241 section 6).
+ *
+ * The filter elements are bound to the schema nodes, an element with no namespace to the nodes of that name
+ * in all the implemented modules. The values of the content match nodes are stored in their canonical form
+ * and a list instance with all its keys given by content match nodes is found directly when evaluating the filter.
+ * Elements not matching any schema node do not select anything, attribute match expressions are not supported.
+ *
+ * @param[in] ctx Context with the schemas of the filtered data.
+ * @param[in] filter XML content of the filter element, its top-level elements.
+ * @return Compiled filter, NULL on error.
+ */
+struct lyd_filter *lyd_filter_compile(struct ly_ctx *ctx, const char *filter);
+
+/**
+ * @brief Free a compiled subtree filter.
+ *
+ * @param[in] filter Compiled filter to free.
+ */
+void lyd_filter_free(struct lyd_filter *filter);
+
+/**
+ * @brief Evaluate a compiled subtree filter on a data tree in a single pass.
+ *
+ * Exactly one of \p result and \p set is to be used.
+ *
+ * @param[in] filter Compiled filter.
+ * @param[in] root Any node of the data tree to filter, NULL for an empty tree.
+ * @param[out] result Copy of the selected parts of the data tree (list instances with their keys), NULL if nothing
+ * was selected.
+ * @param[out] set Set of the roots of the selected subtrees of the data tree, in the document order.
+ * @return 0 on success, -1 on error.
+ */
+int lyd_filter_apply(const struct lyd_filter *filter, const struct lyd_node *root, struct lyd_node **result,
+                     struct ly_set **set);
+
+/**
+ * @brief Column of the list instances exported by lyd_export_columns(), laid out as an Apache Arrow array.
+ */
+struct lyd_column {
+    const struct lys_node_leaf *schema; /**< leaf of the column */
+    LY_DATA_TYPE type;      /**< type of #values, an integer type, #LY_TYPE_DEC64 (int64_t values scaled by
+                                 #fraction_digits), #LY_TYPE_BOOL (bitmap), #LY_TYPE_EMPTY (no values, only #validity),
+                                 or #LY_TYPE_STRING with the canonical values of all the other types */
+    uint8_t fraction_digits; /**< fraction digits of #LY_TYPE_DEC64 values */
+    uint32_t null_count;    /**< number of rows without the leaf */
+    uint8_t *validity;      /**< bitmap of the rows with the leaf, the least significant bit first */
+    void *values;           /**< array of the fixed-width values or the bitmap of #LY_TYPE_BOOL values */
+    int32_t *offsets;       /**< #LY_TYPE_STRING values, offsets of the rows in #data, number of rows + 1 of them */
+    char *data;             /**< #LY_TYPE_STRING values, concatenated without terminating zeroes */
+};
+
+/**
+ * @brief List instances exported by lyd_export_columns().
+ */
+struct lyd_columns {
+    uint32_t rows;              /**< number of the list instances */
+    uint32_t count;             /**< number of the columns */
+    struct lyd_column *columns; /**< array of the columns */
+};
+
+/**
+ * @brief Export the leaves of all the instances of a list into contiguous per-column arrays.
+ *
+ * The instances are the rows, in the order of lyd_find_instance(), and their leaves given by \p columns are
+ * the columns. The columns are filled in a single pass over the instances. A row without the leaf is marked only
+ * in the validity bitmap of the column, its value is zero. A leaf of an integer, decimal64, boolean, or empty type
+ * not stored in its native representation (by a user type plugin) is also exported as a missing one.
+ *
+ * @param[in] data Any node of the data tree with the instances, NULL for no instances.
+ * @param[in] list List schema node.
+ * @param[in] columns Names of the leaves of \p list, optionally prefixed with their module names.
+ * @param[in] count Number of \p columns.
+ * @param[out] result Exported columns, to be freed by lyd_free_columns().
+ * @return 0 on success, -1 on error.
+ */
+int lyd_export_columns(const struct lyd_node *data, const struct lys_node *list, const char **columns, uint32_t count,
+                       struct lyd_columns **result);
+
+/**
+ * @brief Free the exported columns.
+ *
+ * @param[in] columns Columns to free.
+ */
+void lyd_free_columns(struct lyd_columns *columns);
+
+/**
+ * @brief Data tree persisted in a file, see lyd_store_open().
+ */
+struct lyd_store;
+
+/**
+ * @brief Open a data tree persisted as a LYB snapshot and a log of the later changes.
+ *
+ * The snapshot is stored in the file \p path and the changes are appended as LYB patches (see lyd_print_lyb_patch())
+ * into the file \p path with ".log" added, so a commit costs writing and syncing only the changes. The tree is
+ * recovered by parsing the snapshot and applying the patches of the log, a patch not written whole is cut off.
+ * Once the log is larger than \p compact, the whole tree is stored as a new snapshot and the log is emptied.
+ * A snapshot and a log that are missing are created.
+ *
+ * @param[in] ctx Context of the data tree.
+ * @param[in] path Path of the snapshot file.
+ * @param[in] options [Parser options](@ref parseroptions) of the data tree, only #LYD_OPT_DATA and #LYD_OPT_CONFIG
+ * trees can be persisted.
+ * @param[in] compact Size of the log to compact at, 0 for the size of the snapshot.
+ * @param[out] root Recovered data tree, NULL if empty.
+ * @return Opened data store, NULL on error.
+ */
+struct lyd_store *lyd_store_open(struct ly_ctx *ctx, const char *path, int options, size_t compact,
+                                 struct lyd_node **root);
+
+/**
+ * @brief Close a data store, the data are already persisted.
+ *
+ * @param[in] store Data store to close.
+ */
+void lyd_store_close(struct lyd_store *store);
+
+/**
+ * @brief Persist the changes of the data tree, the log is synced before returning.
+ *
+ * @param[in] store Data store of the data tree.
+ * @param[in] diff Diff of the previous and the current data tree, see lyd_diff().
+ * @param[in] root Current data tree, stored if the log is to be compacted, NULL if empty.
+ * @return 0 on success, 1 if the changes were persisted but the log could not be compacted (the changes must not be
+ * committed again, the compaction is tried again by the next commit or it can be done by lyd_store_compact()),
+ * -1 on error when the changes were not persisted.
+ */
+int lyd_store_commit(struct lyd_store *store, const struct lyd_difflist *diff, const struct lyd_node *root);
+
+/**
+ * @brief Store the whole data tree as a new snapshot and empty the log.
+ *
+ * The previous snapshot is replaced only once the new one is synced, an interrupted compaction leaves the previous
+ * snapshot and its log.
+ *
+ * @param[in] store Data store of the data tree.
+ * @param[in] root Current data tree, NULL if empty.
+ * @return 0 on success, -1 on error.
+ */
+int lyd_store_compact(struct lyd_store *store, const struct lyd_node *root);
+
 #ifdef LY_ENABLED_LYD_PRIV
 
 /**
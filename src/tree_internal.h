@@ -17,10 +17,12 @@
 #define LY_TREE_INTERNAL_H_
 
 #include <stdint.h>
+#include <stdatomic.h>
 
 #include "libyang.h"
 #include "tree_schema.h"
 #include "tree_data.h"
+#include "user_types.h"
 #include "resolve.h"
 
 /* this is used to distinguish lyxml_elem * from a YANG temporary parsing structure, the first byte is compared */
@@ -61,7 +63,9 @@ extern struct lys_tpdf *ly_types[LY_DATA_TYPE_COUNT];
  */
 struct lyd_node_pos {
     struct lyd_node *node;
+    uint32_t mpos;
     uint32_t pos;
+    uint32_t idx;
 };
 
 /**
@@ -75,6 +79,18 @@ struct lyb_state {
     int size;
     const struct lys_module **models;
     int mod_count;
+    int str_table;              /* whether string values are stored in a string table (#LYB_HEADER_STRTABLE) */
+    uint32_t str_count;         /* number of strings in the string table */
+    int index;                  /* whether there is an index of the top-level subtrees (#LYB_HEADER_INDEX) */
+    int stream;                 /* whether the data are a stream frame, top-level models are indexes (#LYB_HEADER_STREAM) */
+    int ident_idx;              /* whether identities are stored by their index (#LYB_HEADER_IDENTIDX) */
+
+    /* LYB parser only */
+    const char **strs;          /* string table, dictionary strings */
+    int trusted;                /* whether the data are trusted (#LYD_OPT_TRUSTED) and need not be validated */
+    const struct lys_module *ident_mod; /* module of the last read identity */
+    int patch;                  /* whether the data are a patch (#LYB_HEADER_PATCH) */
+    struct hash_table *snode_ht; /* schema nodes found by their hashes, kept by the stream for all its frames */
 
     /* LYB printer only */
     struct {
@@ -82,11 +98,93 @@ struct lyb_state {
         struct hash_table *ht;
     } *sib_ht;
     int sib_ht_count;
+    struct hash_table *str_ht;  /* string table, dictionary strings with their index */
 };
 
 /* struct lyb_state allocation step */
 #define LYB_STATE_STEP 4
 
+/* LYB header flag, every string value is preceded by a variable-length number, 0 for a new string
+ * that follows and is added into the string table, an index into the string table increased by 1 otherwise */
+#define LYB_HEADER_STRTABLE 0x01
+
+/* LYB header flag, the ending zero is followed by an index of the top-level subtrees - their count (4B) and for
+ * each its offset (8B) and its path with its length (2B), the offset of the index (8B) is stored last,
+ * the string table (if used) is started again for every top-level subtree */
+#define LYB_HEADER_INDEX 0x02
+
+/* LYB header flag, identityref values are stored as a variable-length index of the identity in its module identities
+ * and then in the module submodules identities followed by the name of the (main) module of the identity */
+#define LYB_HEADER_IDENTIDX 0x04
+
+/* LYB header flag, the data are a patch created from a diff instead of data subtrees, a sequence of operations each
+ * being its #LYD_DIFFTYPE (1B), the depth of the node (variable-length number) and a top-level subtree with
+ * the ancestors of the node and their keys, the node itself is the last child of its parent, with all its
+ * subtree for #LYD_DIFF_CREATED and #LYD_DIFF_CHANGED, the moves are followed by a byte whether the preceding
+ * instance follows in the same form, #LYD_DIFF_END terminates the sequence */
+#define LYB_HEADER_PATCH 0x08
+
+/* LYB header flag, the header starts a stream and is followed only by the length (4B) of the models and the models,
+ * all the used models of the context, each frame of the stream is then the length (4B) of the rest of the frame,
+ * the top-level subtrees and the ending zero, the models of the top-level subtrees are written as their index (2B)
+ * in the header models, the string table (if used) is started again for every frame */
+#define LYB_HEADER_STREAM 0x10
+
+/**
+ * @brief LYB stream, see lyd_lyb_stream_new().
+ */
+struct lyd_lyb_stream {
+    struct ly_ctx *ctx;
+    int options;                /* printer options of the frames */
+    int header;                 /* whether the header was printed or parsed */
+    int str_table;              /* whether the frames use a string table (#LYB_HEADER_STRTABLE) */
+    uint16_t set_id;            /* module set ID the models were found for */
+    int mod_count;
+    const struct lys_module **models; /* models of the header, NULL if not in the context anymore */
+    const char **mod_names;     /* dictionary names and revisions of the models to find them again */
+    const char **mod_revs;
+    struct hash_table *snode_ht; /* parser only, schema nodes found by their hashes in all the frames */
+};
+
+/**
+ * @brief Find the models of a LYB stream again if the module set of its context changed.
+ *
+ * @param[in] stream LYB stream with the header printed or parsed.
+ */
+void lyb_stream_check(struct lyd_lyb_stream *stream);
+
+/**
+ * @brief Remember the models of a LYB stream header just printed or parsed.
+ *
+ * @param[in] stream LYB stream with the header models.
+ * @return 0 on success, -1 on error.
+ */
+int lyb_stream_set_models(struct lyd_lyb_stream *stream);
+
+/**
+ * @brief Lazily parsed LYB data, see lyd_lazy_new().
+ */
+struct lyd_lazy {
+    struct ly_ctx *ctx;
+    const char *data;           /* LYB data of the caller, not copied */
+    int options;                /* parser options, always with #LYD_OPT_TRUSTED */
+    int str_table;              /* whether the subtrees use a string table (#LYB_HEADER_STRTABLE) */
+    int ident_idx;              /* whether identities are stored by their index (#LYB_HEADER_IDENTIDX) */
+    int mod_count;
+    const struct lys_module **models;
+    struct hash_table *snode_ht; /* schema nodes found by their hashes in all the parsed subtrees */
+    uint32_t count;
+    struct lyd_lazy_subtree {
+        uint64_t offset;        /* offset of the top-level subtree in the data */
+        const char *path;       /* path of the top-level node in the index, not terminated */
+        uint16_t path_len;
+        uint64_t used;          /* clock of the last use, the least recently used are evicted first */
+        struct lyd_node *node;  /* parsed subtree, NULL if not parsed */
+    } *subtrees;                /* all the top-level subtrees in the order of the data */
+    uint64_t clock;
+    struct lyd_node *tree;      /* first of the parsed subtrees, linked in the order of the data */
+};
+
 /**
  * LYB schema hash constants
  *
@@ -152,18 +250,130 @@ int lyb_has_schema_model(struct lys_node *sibling, const struct lys_module **mod
  */
 #define LY_VALUE_UNRESGRP 0x80
 
+/**
+ * @brief Type flag for a type sharing the restrictions of the type in a grouping, see #LY_CTX_SHARE_GROUPINGS.
+ */
+#define LY_VALUE_SHARED 0x40
+
 #ifdef LY_ENABLED_CACHE
 
 /**
- * @brief Minimum number of children for the parent to create a hash table for them.
+ * @brief Default minimum number of children for the parent to create a hash table for them,
+ * see ly_ctx_set_data_hash_threshold().
  */
 #   define LY_CACHE_HT_MIN_CHILDREN 4
 
+/**
+ * @brief Minimum number of items for a ::ly_set to create the index of its items.
+ */
+#   define LY_CACHE_SET_HT_MIN_ITEMS 32
+
+/**
+ * @brief Maximum number of resolved schema paths cached in a context, see lys_path_hash_find().
+ */
+#   define LY_CACHE_PATH_MAX 4096
+
     int lyd_hash(struct lyd_node *node);
 
     void lyd_insert_hash(struct lyd_node *node);
 
     void lyd_unlink_hash(struct lyd_node *node, struct lyd_node *orig_parent);
+
+/**
+ * @brief Data node types with a subtree filter, see #LY_CTX_SUBTREE_FILTERS.
+ */
+#   define LYD_BLOOM_INNER (LYS_CONTAINER | LYS_LIST | LYS_RPC | LYS_ACTION | LYS_NOTIF)
+
+/**
+ * @brief Get the subtree filter bits of a node name.
+ *
+ * @param[in] name Node name.
+ * @param[in] len Length of \p name.
+ * @return Filter bits.
+ */
+    uint64_t lyd_bloom_bits(const char *name, size_t len);
+
+/**
+ * @brief Learn whether a subtree can include descendants with all the filter bits, see #LY_CTX_SUBTREE_FILTERS.
+ * The filter is built if it was not yet.
+ *
+ * @param[in] node Container, list, RPC, action, or notification.
+ * @param[in] bits Filter bits of the descendants.
+ * @return 0 if there are certainly no such descendants, 1 if there can be, always 1 without the option.
+ */
+    int lyd_bloom_contains(struct lyd_node *node, uint64_t bits);
+
+/**
+ * @brief Build the subtree filters of a whole data tree so that they are only read afterwards.
+ *
+ * @param[in] node Any node of the tree.
+ */
+    void lyd_bloom_build_tree(struct lyd_node *node);
+
+/**
+ * @brief Data of an inner data node kept in the context side table instead of the node itself so that
+ * the nodes do not grow for the features used only by some trees.
+ */
+struct lyd_side {
+    struct lyd_node *node;          /**< node of the record */
+    struct lyd_uniq_idx *uniq;      /**< indexes of the unique values of the child list instances kept between
+                                         validations, see lyv_data_unique() */
+    uint64_t bloom;                 /**< filter of the descendant names, see #LY_CTX_SUBTREE_FILTERS */
+};
+
+/**
+ * @brief Get the side table record of a data node.
+ *
+ * @param[in] node Container, list, RPC, action, or notification.
+ * @param[in] create Whether to create the record if the node has none.
+ * @return Node record, NULL if there is none and \p create was not set or on error.
+ */
+    struct lyd_side *lyd_side_get(struct lyd_node *node, int create);
+
+/**
+ * @brief Free the side table record of a data node being freed, if it has one.
+ *
+ * @param[in] node Data node.
+ */
+    void lyd_side_free(struct lyd_node *node);
+
+/**
+ * @brief Free all the side table records of a context.
+ *
+ * @param[in] ctx Context to use.
+ */
+    void lyd_side_clear(struct ly_ctx *ctx);
+
+/**
+ * @brief Effective type, the restrictions of a type and all its typedefs collected in one place.
+ */
+struct lys_type_eff {
+    LY_DATA_TYPE base;              /**< base type */
+    struct lys_type *info;          /**< the nearest type in the chain with the bits, enums, or union member
+                                         definitions, the type itself for the other base types */
+    struct len_ran_cmp *intv;       /**< compiled length or range restriction, owned by the restriction */
+    lytype_parse_clb parse;         /**< specialized value parser, see lys_set_value_parser() */
+    uint32_t pat_count;             /**< number of all the patterns */
+    struct {
+        struct lys_restr *restr;    /**< pattern restriction */
+        void *regex;                /**< its compiled expression, owned by the type */
+        void *study;                /**< its study data, owned by the type */
+    } pat[];                        /**< patterns of the whole chain, the ones of the furthest typedef first */
+};
+
+/**
+ * @brief Get the effective type of a type, it is built on the first use.
+ *
+ * @param[in] ctx Context of the type.
+ * @param[in] type Resolved type.
+ * @return Effective type, NULL on error.
+ */
+struct lys_type_eff *lys_type_eff(struct ly_ctx *ctx, struct lys_type *type);
+
+/**
+ * @brief Get the effective type of a type if it was already built by lys_type_eff() (in any thread), NULL otherwise.
+ */
+#define LYS_TYPE_EFF(type) ((struct lys_type_eff *)atomic_load_explicit((void * _Atomic *)&(type)->eff, memory_order_acquire))
 #endif
 
 /**
@@ -201,6 +411,22 @@ struct lys_submodule *lys_sub_parse_fd(struct lys_module *module, int fd, LYS_IN
  */
 void lys_submodule_free(struct lys_submodule *submodule, void (*private_destructor)(const struct lys_node *node, void *priv));
 
+/**
+ * @brief Add the memory occupied by a module and its submodules to the context memory usage.
+ *
+ * @param[in] module Module to examine.
+ * @param[in,out] usage Memory usage to add to, only the schema parts are changed.
+ */
+void lys_mem_usage(const struct lys_module *module, struct ly_ctx_mem_usage *usage);
+
+/**
+ * @brief Build all the lazily created caches of a module and its submodules, see ly_ctx_precompile().
+ *
+ * @param[in] module Module to prepare.
+ * @return 0 on success, -1 on error.
+ */
+int lys_precompile(struct lys_module *module);
+
 /**
  * @brief Add child schema tree node at the end of the parent's child list.
  *
@@ -391,6 +617,81 @@ void lys_node_free(struct lys_node *node, void (*private_destructor)(const struc
 void lys_free(struct lys_module *module, void (*private_destructor)(const struct lys_node *node, void *priv),
               int free_subs, int remove_from_ctx);
 
+/**
+ * @brief Allocate zeroed memory for a new data node, from the arena active in the thread, if any,
+ * otherwise by the context data allocator, if set, otherwise from the node structures freed before and cached
+ * by the thread.
+ *
+ * @param[in] ctx Context of the node.
+ * @param[in] size Size of the node structure.
+ * @return Allocated node, NULL on memory allocation error.
+ */
+struct lyd_node *lyd_node_alloc(struct ly_ctx *ctx, size_t size);
+
+/**
+ * @brief Free the memory of a data node allocated by lyd_node_alloc(). Nothing is done for arena nodes,
+ * the structures of the other nodes not allocated by the context data allocator are cached by the thread
+ * for reuse.
+ *
+ * @param[in] node Node to free.
+ */
+void lyd_node_dealloc(struct lyd_node *node);
+
+/**
+ * @brief Free a whole top-level data tree without unlinking its nodes, possibly in several threads
+ * (see ly_ctx_set_free_threads()). The dictionary removals are batched.
+ *
+ * @param[in] first First top-level sibling of the tree.
+ */
+void lyd_free_tree(struct lyd_node *first);
+
+/**
+ * @brief Free all the data trees passed to lyd_free_deferred() and stop the background thread.
+ *
+ * @param[in] ctx Context of the trees.
+ */
+void lyd_reclaim_stop(struct ly_ctx *ctx);
+
+/**
+ * @brief Highest data modification generation that can be stored in a leaf (lyd_node_leaf_list#ref_gen and
+ * lyd_node_leaf_list#ref_gen_hi use the padding after the node flags and after the value flags). Once the generation
+ * of a context exceeds it, the resolved targets are never trusted so a stored generation cannot match again.
+ */
+#define LYD_REF_GEN_MAX 0xffffffffffULL
+
+/**
+ * @brief Note a modification of a data tree of the context (a node inserted, unlinked, freed, or its value changed).
+ * It invalidates all the leafref and instance-identifier targets resolved before, see lyd_node_leaf_list#ref_gen.
+ *
+ * @param[in] ctx Context of the modified tree.
+ */
+void lyd_gen_bump(struct ly_ctx *ctx);
+
+/**
+ * @brief Get the current data modification generation of a context, see lyd_gen_bump().
+ *
+ * @param[in] ctx Context to use.
+ * @return Current generation, never 0.
+ */
+uint64_t lyd_gen_get(struct ly_ctx *ctx);
+
+/**
+ * @brief Remember the current data modification generation in a leaf with a resolved leafref or
+ * instance-identifier target.
+ *
+ * @param[in] leaf Leaf with the resolved target.
+ */
+void lyd_gen_stamp(struct lyd_node_leaf_list *leaf);
+
+/**
+ * @brief Check that no data tree of the context was modified since the target of a leaf was resolved,
+ * see lyd_gen_stamp().
+ *
+ * @param[in] leaf Leaf with the resolved target.
+ * @return 1 if the target is still valid, 0 if it must be resolved again.
+ */
+int lyd_gen_stamp_current(const struct lyd_node_leaf_list *leaf);
+
 /**
  * @brief Create a data container knowing it's schema node.
  *
@@ -420,6 +721,21 @@ struct lyd_node *_lyd_new(struct lyd_node *parent, const struct lys_node *schema
 struct lyd_node *lyd_new_dummy(struct lyd_node *data, struct lyd_node *parent, const struct lys_node *schema,
                                const char *value, int dflt);
 
+/**
+ * @brief Find an existing instance of a schema node among siblings by its canonical values,
+ * through the children hash table of the parent if it has one.
+ *
+ * Instances of keyless lists are never found.
+ *
+ * @param[in] parent Parent of the instance, NULL for top-level.
+ * @param[in] first First sibling to search.
+ * @param[in] schema Schema node of the instance.
+ * @param[in] values Key values for lists, the value for leaf-lists.
+ * @return Found instance, NULL if there is none.
+ */
+struct lyd_node *lyd_find_values(struct lyd_node *parent, struct lyd_node *first, const struct lys_node *schema,
+                                 const char **values);
+
 /**
  * @brief Find the parent node of an attribute.
  *
@@ -491,6 +807,320 @@ int lys_get_sibling(const struct lys_node *siblings, const char *mod_name, int m
 int lys_getnext_data(const struct lys_module *mod, const struct lys_node *parent, const char *name, int nam_len,
                      LYS_NODE type, const struct lys_node **ret);
 
+/**
+ * @brief Find a data child of a schema node by its name and namespace using a hash table of all the children
+ * built in the context on the first use. Choices, cases, uses, and input/output are transparent like in
+ * lys_getnext(), but disabled nodes are also returned. Does not log.
+ *
+ * @param[in] ctx Context with the hash table.
+ * @param[in] parent Schema parent of the node, NULL for a top-level node.
+ * @param[in] mod Main module of a top-level node, it is ignored if \p parent is set.
+ * @param[in] inout RPC/action children to search in, #LYS_INPUT, #LYS_OUTPUT, or 0 for both.
+ * @param[in] name Node name.
+ * @param[in] nam_len Node \p name length.
+ * @param[in] ns Namespace of the node module, must be in the dictionary.
+ * @param[out] ret Found node, NULL if there is none.
+ * @return 0 on success, 1 if the hash table cannot be used and the children must be searched directly.
+ */
+int lys_find_child_hash(struct ly_ctx *ctx, const struct lys_node *parent, const struct lys_module *mod, LYS_NODE inout,
+                        const char *name, int nam_len, const char *ns, const struct lys_node **ret);
+
+/**
+ * @brief Find a schema child of a schema node by its name and namespace using the same hash table as
+ * lys_find_child_hash(). The children are those returned by lys_getnext() with #LYS_GETNEXT_WITHCHOICE,
+ * #LYS_GETNEXT_WITHCASE, #LYS_GETNEXT_WITHINOUT, and #LYS_GETNEXT_NOSTATECHECK. Does not log.
+ *
+ * @param[in] ctx Context with the hash table.
+ * @param[in] parent Schema parent of the node, NULL for a top-level node.
+ * @param[in] mod Main module of a top-level node, it is ignored if \p parent is set.
+ * @param[in] name Node name.
+ * @param[in] nam_len Node \p name length.
+ * @param[in] ns Namespace of the node module, must be in the dictionary.
+ * @param[out] ret Found node, NULL if there is none.
+ * @return 0 on success, 1 if the hash table cannot be used and the children must be searched directly.
+ */
+int lys_find_schema_child_hash(struct ly_ctx *ctx, const struct lys_node *parent, const struct lys_module *mod,
+                               const char *name, int nam_len, const char *ns, const struct lys_node **ret);
+
+/**
+ * @brief Note that some schema children were added or removed so the hash table of lys_find_child_hash()
+ * and the table of lys_node_id() are rebuilt on the next use.
+ *
+ * @param[in] ctx Context of the changed schema.
+ */
+void lys_children_changed(struct ly_ctx *ctx);
+
+/**
+ * @brief Note that the state of some features changed so all the if-feature results cached by
+ * resolve_iffeature() are evaluated again on their next use.
+ *
+ * @param[in] ctx Context of the changed features.
+ */
+void lys_features_changed(struct ly_ctx *ctx);
+
+/**
+ * @brief Drop the hash tables created by lys_find_child_hash() after the schema children have changed.
+ *
+ * @param[in] ctx Context with the hash tables.
+ */
+void lys_child_hash_clear(struct ly_ctx *ctx);
+
+/**
+ * @brief Learn whether there can be any mandatory node, choice, list and leaf-list with min/max-elements,
+ * or a node with a when condition in a schema subtree, the result is cached in the context until the module
+ * set changes.
+ *
+ * @param[in] ctx Context with the hash table.
+ * @param[in] node Root of the schema subtree.
+ * @return 1 if the subtree must be checked for mandatory nodes, 0 if there are none.
+ */
+int lys_mand_subtree(struct ly_ctx *ctx, const struct lys_node *node);
+
+/**
+ * @brief Drop the results cached by lys_mand_subtree() after the schema nodes have changed.
+ *
+ * @param[in] ctx Context with the hash table.
+ */
+void lys_mand_hash_clear(struct ly_ctx *ctx);
+
+/**
+ * @brief Learn whether validating an RPC/action input or output or a notification can depend on data outside
+ * of the operation tree (must and when referencing the datastore, leafrefs pointing outside of the operation,
+ * instance-identifiers), the result is cached in the context until the module set changes.
+ *
+ * @param[in] ctx Context with the hash table.
+ * @param[in] op RPC, action, or notification schema node.
+ * @param[in] output Whether the output of an RPC/action is validated, otherwise its input.
+ * @return 1 if the operation may need the data tree, 0 if it is validated on its own.
+ */
+int lys_op_ext_deps(struct ly_ctx *ctx, const struct lys_node *op, int output);
+
+/**
+ * @brief Drop the results cached by lys_op_ext_deps() after the schema nodes have changed.
+ *
+ * @param[in] ctx Context with the hash table.
+ */
+void lys_op_deps_hash_clear(struct ly_ctx *ctx);
+
+/**
+ * @brief Kinds of the schema paths cached by lys_path_hash_add().
+ */
+#define LYS_PATH_JSON 0            /**< resolve_json_nodeid() of a data path */
+#define LYS_PATH_JSON_OUTPUT 1     /**< resolve_json_nodeid() of a data path in an RPC/action output */
+#define LYS_PATH_SCHEMA 2          /**< ly_ctx_find_path() of a schema path */
+
+/**
+ * @brief Find an absolute schema path resolved before. The cached paths are valid until the modules, their
+ * deviations and augments, or the feature states change. Does not log.
+ *
+ * @param[in] ctx Context with the hash table.
+ * @param[in] path Absolute path.
+ * @param[in] kind Kind of the path, see lys_path_hash_add().
+ * @param[out] node Resolved node of a #LYS_PATH_JSON or #LYS_PATH_JSON_OUTPUT path.
+ * @param[out] set Copy of the resolved nodes of a #LYS_PATH_SCHEMA path, to be freed by the caller.
+ * @return 0 if found, 1 if the path must be resolved.
+ */
+int lys_path_hash_find(struct ly_ctx *ctx, const char *path, int kind, const struct lys_node **node, struct ly_set **set);
+
+/**
+ * @brief Remember a successfully resolved absolute schema path. At most #LY_CACHE_PATH_MAX paths are stored,
+ * the table is started over when it fills up. Does not log.
+ *
+ * @param[in] ctx Context with the hash table.
+ * @param[in] path Absolute path.
+ * @param[in] kind Kind of the path, #LYS_PATH_JSON, #LYS_PATH_JSON_OUTPUT, or #LYS_PATH_SCHEMA.
+ * @param[in] node Resolved node of a #LYS_PATH_JSON or #LYS_PATH_JSON_OUTPUT path.
+ * @param[in] set Resolved nodes of a #LYS_PATH_SCHEMA path, they are copied.
+ */
+void lys_path_hash_add(struct ly_ctx *ctx, const char *path, int kind, const struct lys_node *node,
+                       const struct ly_set *set);
+
+/**
+ * @brief Drop the schema paths cached by lys_path_hash_add().
+ *
+ * @param[in] ctx Context with the hash table.
+ */
+void lys_path_hash_clear(struct ly_ctx *ctx);
+
+/**
+ * @brief Find a schema node by its ID from lys_node_id().
+ *
+ * @param[in] ctx Context with the node.
+ * @param[in] id ID of the node.
+ * @return Found node, NULL if none or on error.
+ */
+const struct lys_node *lys_node_id_find(struct ly_ctx *ctx, uint64_t id);
+
+/**
+ * @brief Drop the schema node IDs table of lys_node_id().
+ *
+ * @param[in] ctx Context with the table.
+ */
+void lys_node_id_clear(struct ly_ctx *ctx);
+
+/**
+ * @brief Drop the schema nodes of other contexts mapped into the context when copying data between them.
+ *
+ * @param[in] ctx Target context with the hash table.
+ */
+void lys_ctx_map_clear(struct ly_ctx *ctx);
+
+/**
+ * @brief Drop the LYB sibling hash tables cached by the LYB printer after the schema nodes have changed.
+ *
+ * @param[in] ctx Context with the hash tables.
+ */
+void lyb_sib_ht_clear(struct ly_ctx *ctx);
+
+/**
+ * @brief Drop the modules printed in YANG and YIN format cached by the schema printer.
+ *
+ * @param[in] ctx Context with the printed modules.
+ */
+void lys_print_cache_clear(struct ly_ctx *ctx);
+
+/**
+ * @brief Drop the yang-library data cached by ly_ctx_info() after the module set has changed
+ * without changing its ID (features or conformance of a module).
+ *
+ * @param[in] ctx Context with the data.
+ */
+void ly_ctx_info_clear(struct ly_ctx *ctx);
+
+/**
+ * @brief Number all the data nodes of a module and of its applied augments in the schema order for lyd_schema_sort().
+ * Augments applied later renumber their target children themselves.
+ *
+ * @param[in] module Module with all the unres items resolved.
+ */
+void lys_node_pos_module(struct lys_module *module);
+
+/**
+ * @brief Learn which containers and lists of a module can have state data in their subtree (#LYS_INCL_STATUS),
+ * including the nodes of its applied augments and the modules changed by its deviations.
+ *
+ * @param[in] module Module with all the unres items resolved.
+ */
+void lys_node_state_module(struct lys_module *module);
+
+/**
+ * @brief Learn #LYS_INCL_STATUS again for the modules changed by the deviations of a (sub)module.
+ *
+ * @param[in] module (Sub)module with the deviations.
+ */
+void lys_node_state_devs(struct lys_module *module);
+
+/**
+ * @brief Find an enum of a type by its name using a context hash table.
+ *
+ * @param[in] ctx Context with the type.
+ * @param[in] type Type with the enums (not a type derived from it without any enums).
+ * @param[in] name Name of the enum.
+ * @param[out] enm Found enum, NULL if there is none.
+ * @return 0 on success, 1 if the hash table cannot be used and the enums must be searched directly.
+ */
+int lys_find_enum_hash(struct ly_ctx *ctx, const struct lys_type *type, const char *name, struct lys_type_enum **enm);
+
+/**
+ * @brief Find a bit of a type by its name using a context hash table.
+ *
+ * @param[in] ctx Context with the type.
+ * @param[in] type Type with the bits (not a type derived from it without any bits).
+ * @param[in] name Name of the bit, does not need to be terminated.
+ * @param[in] nam_len Length of \p name.
+ * @param[out] bit Found bit, NULL if there is none.
+ * @return 0 on success, 1 if the hash table cannot be used and the bits must be searched directly.
+ */
+int lys_find_bit_hash(struct ly_ctx *ctx, const struct lys_type *type, const char *name, int nam_len,
+                      struct lys_type_bit **bit);
+
+/**
+ * @brief Find an identity derived from a base identity by its name and module using a context hash table.
+ *
+ * @param[in] ctx Context with the identities.
+ * @param[in] base Base identity.
+ * @param[in] name Name of the derived identity, does not need to be terminated.
+ * @param[in] nam_len Length of \p name.
+ * @param[in] mod Main module of the derived identity.
+ * @param[out] der First found derived identity, NULL if there is none.
+ * @return 0 on success, 1 if the hash table cannot be used and the derived identities must be searched directly.
+ */
+int lys_find_ident_hash(struct ly_ctx *ctx, const struct lys_ident *base, const char *name, int nam_len,
+                        const struct lys_module *mod, struct lys_ident **der);
+
+/**
+ * @brief Drop the hash table created by lys_find_enum_hash(), lys_find_bit_hash() and lys_find_ident_hash().
+ *
+ * @param[in] ctx Context with the hash table.
+ */
+void lys_value_hash_clear(struct ly_ctx *ctx);
+
+/**
+ * @brief Find an identity by its module and name using a context hash table.
+ *
+ * @param[in] ctx Context with the identities.
+ * @param[in] mod Module of the identity.
+ * @param[in] name Name of the identity, does not need to be terminated.
+ * @param[in] nam_len Length of \p name.
+ * @param[out] ident Found identity, NULL if there is none.
+ * @return 0 on success, 1 if the hash table cannot be used and the identities must be searched directly.
+ */
+int lys_find_ident_name_hash(struct ly_ctx *ctx, const struct lys_module *mod, const char *name, int nam_len,
+                             struct lys_ident **ident);
+
+/**
+ * @brief Learn whether an identity is derived, directly or not, from another one using a context hash table.
+ *
+ * @param[in] ctx Context with the identities.
+ * @param[in] der Possibly derived identity.
+ * @param[in] base Base identity.
+ * @param[out] derived 1 if \p der is derived from \p base, 0 otherwise.
+ * @return 0 on success, 1 if the hash table cannot be used and the bases must be searched directly.
+ */
+int lys_ident_derived_hash(struct ly_ctx *ctx, const struct lys_ident *der, const struct lys_ident *base, int *derived);
+
+/**
+ * @brief Drop the hash table created by lys_find_ident_name_hash() and lys_ident_derived_hash().
+ *
+ * @param[in] ctx Context with the hash table.
+ */
+void lys_ident_hash_clear(struct ly_ctx *ctx);
+
+/**
+ * @brief Drop the hash table created by lys_find_annotation().
+ *
+ * @param[in] ctx Context with the hash table.
+ */
+void lys_annot_hash_clear(struct ly_ctx *ctx);
+
+struct lys_search_index;
+
+/**
+ * @brief Search for a (sub)module file the same way as lys_search_localfile(), but using (and building)
+ * the index of all the files in the search directories.
+ *
+ * The index is rebuilt when the current working directory changes and a direct search is
+ * performed whenever the index seems outdated.
+ *
+ * @param[in,out] index Index of the search directories, NULL to build it.
+ * @param[in] searchpaths Search paths the index is built for.
+ * @param[in] cwd Whether to search also in the current working directory.
+ * @param[in] name Name of the (sub)module.
+ * @param[in] revision Revision of the (sub)module, NULL for the newest.
+ * @param[out] localfile Path of the found file, NULL if not found.
+ * @param[out] format Format of the found file.
+ * @return EXIT_SUCCESS on success (even if no file was found), EXIT_FAILURE on error.
+ */
+int lys_search_localfile_index(struct lys_search_index **index, const char * const *searchpaths, int cwd,
+                               const char *name, const char *revision, char **localfile, LYS_INFORMAT *format);
+
+/**
+ * @brief Free the search directories index.
+ *
+ * @param[in] index Index to free.
+ */
+void lys_search_index_free(struct lys_search_index *index);
+
 int lyd_get_unique_default(const char* unique_expr, struct lyd_node *list, const char **dflt);
 
 int lyd_build_relative_data_path(const struct lys_module *module, const struct lyd_node *node, const char *schema_id,
@@ -499,8 +1129,128 @@ int lyd_build_relative_data_path(const struct lys_module *module, const struct l
 void lyd_free_value(lyd_val value, LY_DATA_TYPE value_type, uint8_t value_flags, struct lys_type *type, lyd_val *old_val,
                     LY_DATA_TYPE *old_val_type, uint8_t *old_val_flags);
 
+/**
+ * @brief Allocate a new bits value array, not yet shared.
+ *
+ * @param[in] ctx Context of the bits type.
+ * @param[in] count Number of bits of the type.
+ * @return Zeroed array of \p count bits, NULL on memory allocation error.
+ */
+struct lys_type_bit **lyd_bits_new(struct ly_ctx *ctx, uint32_t count);
+
+/**
+ * @brief Share a filled bits value array created by lyd_bits_new() with all the data nodes
+ * with the same value, it must not be modified anymore.
+ *
+ * @param[in] bit Bits value array, it is freed if the same value is already shared.
+ * @return Shared bits value array, NULL on memory allocation error (\p bit is freed).
+ */
+struct lys_type_bit **lyd_bits_share(struct lys_type_bit **bit);
+
+/**
+ * @brief Use a bits value array for another data node.
+ *
+ * @param[in] bit Bits value array from lyd_bits_share().
+ * @return \p bit.
+ */
+struct lys_type_bit **lyd_bits_dup(struct lys_type_bit **bit);
+
+/**
+ * @brief Free a bits value array, shared or not.
+ *
+ * @param[in] bit Bits value array to free.
+ */
+void lyd_bits_free(struct lys_type_bit **bit);
+
+/**
+ * @brief Get the memory used by a bits value array, divided among all the data nodes sharing it.
+ *
+ * @param[in] bit Bits value array.
+ * @return Memory size in bytes.
+ */
+size_t lyd_bits_mem_size(struct lys_type_bit **bit);
+
+/**
+ * @brief Get the memory used by the hash table of the shared bits values of a context.
+ *
+ * @param[in] ctx Context to use.
+ * @return Memory size in bytes.
+ */
+size_t lyd_bits_ht_mem_size(struct ly_ctx *ctx);
+
+/**
+ * @brief Free all the shared bits values of a context.
+ *
+ * @param[in] ctx Context to use.
+ */
+void lyd_bits_clear(struct ly_ctx *ctx);
+
+/**
+ * @brief Get the memory used by the decoded binary values of a context, see lyd_binary_value().
+ *
+ * @param[in] ctx Context to use.
+ * @return Memory size in bytes.
+ */
+size_t lyd_binary_mem_size(struct ly_ctx *ctx);
+
+/**
+ * @brief Free all the decoded binary values of a context.
+ *
+ * @param[in] ctx Context to use.
+ */
+void lyd_binary_clear(struct ly_ctx *ctx);
+
 int lyd_list_equal(struct lyd_node *node1, struct lyd_node *node2, int with_defaults);
 
+/**
+ * @brief Compare values of 2 leaves or leaf-lists, by the user type plugin if it can compare them.
+ *
+ * @param[in] node1 First leaf(-list).
+ * @param[in] node2 Second leaf(-list) of the same schema node, in another context if \p diff_ctx is set.
+ * @param[in] diff_ctx Whether the nodes are from different contexts.
+ * @return 1 if the values are equal, 0 otherwise.
+ */
+int lyd_leaf_val_equal(struct lyd_node *node1, struct lyd_node *node2, int diff_ctx);
+
+/**
+ * @brief Learn whether the new non-default instances of a leaf or leaf-list store their value strings
+ * privately, see ly_ctx_set_private_values().
+ *
+ * @param[in] snode Schema leaf or leaf-list.
+ * @return non-zero if the value strings are private (#LY_VALUE_PRIVATE), 0 if they are in the dictionary.
+ */
+int lyd_value_private(const struct lys_node *snode);
+
+/**
+ * @brief Order the value of a leaf(-list) and another value by the user type plugin.
+ *
+ * @param[in] node Leaf(-list) with a value stored by a user type plugin.
+ * @param[in] node2 Second leaf(-list), if set, its value is used.
+ * @param[in] value2 Second value as a string, used if \p node2 is NULL or does not have a value of the same user type.
+ * @param[out] order Negative value, 0, or positive value if the value of \p node is less than, equal to,
+ * or greater than the second value.
+ * @return 0 on success, 1 if the values cannot be ordered by the plugin.
+ */
+int lyd_leaf_val_order(const struct lyd_node *node, const struct lyd_node *node2, const char *value2, int *order);
+
+/**
+ * @brief Add a leaf(-list) value into a hash, by the user type plugin if it hashes the values.
+ *
+ * @param[in] hash Hash to add to.
+ * @param[in] leaf Leaf(-list) with the value.
+ * @return Hash with the value added.
+ */
+uint32_t lyd_hash_value(uint32_t hash, const struct lyd_node_leaf_list *leaf);
+
+/**
+ * @brief Check whether lyd_hash() of the instances of a leaf-list or list does not hash some values as strings
+ * so the hash cannot be computed from string values (of predicates).
+ *
+ * @param[in] snode Schema leaf-list or list.
+ * @return 1 if some values are hashed by a user type plugin, 0 otherwise.
+ */
+int lyd_hash_user_type(const struct lys_node *snode);
+
 int lys_make_implemented_r(struct lys_module *module, struct unres_schema *unres);
 
 /**
@@ -551,6 +1301,22 @@ int lyd_defaults_add_unres(struct lyd_node **root, int options, struct ly_ctx *c
                            int mod_count, const struct lyd_node *data_tree, struct lyd_node *act_notif,
                            struct unres_data *unres, int wd);
 
+/**
+ * @brief Create the default leaves of a data node that were left out with #LY_CTX_VIRTUAL_DFLT, before its
+ * children are accessed. Does nothing without the context option.
+ *
+ * @param[in] parent Data node whose children are going to be accessed.
+ * @param[in] created Optional set to add the created default leaves into.
+ */
+void lyd_wd_materialize(struct lyd_node *parent, struct ly_set *created);
+
+/**
+ * @brief Free the default leaves created by lyd_wd_materialize(), the data tree is left the way it was before.
+ *
+ * @param[in] created Set of the created leaves, emptied.
+ */
+void lyd_wd_virtualize(struct ly_set *created);
+
 void lys_enable_deviations(struct lys_module *module);
 
 void lys_disable_deviations(struct lys_module *module);
@@ -571,6 +1337,11 @@ const struct lys_module *lys_parse_fd_(struct ly_ctx *ctx, int fd, LYS_INFORMAT
 const struct lys_module *lys_parse_mem_(struct ly_ctx *ctx, const char *data, LYS_INFORMAT format, const char *revision,
                                         int internal, int implement);
 
+/**
+ * @brief Parse a YIN module from its already parsed XML, the same as lys_parse_mem_().
+ */
+const struct lys_module *lys_parse_yin_(struct ly_ctx *ctx, struct lyxml_elem *yin, const char *revision, int implement);
+
 /**
  * @brief Get next augment from \p mod augmenting \p aug_target
  */
@@ -19,6 +19,7 @@
 #endif
 #include <assert.h>
 #include <ctype.h>
+#include <inttypes.h>
 #include <limits.h>
 #include <stdlib.h>
 #include <sys/mman.h>
@@ -246,2730 +247,5739 @@ lys_getnext_data(const struct lys_module *mod, const struct lys_node *parent, co
     return EXIT_FAILURE;
 }
 
-API const struct lys_node *
-lys_getnext(const struct lys_node *last, const struct lys_node *parent, const struct lys_module *module, int options)
-{
-    const struct lys_node *next, *aug_parent;
-    struct lys_node **snode;
-
-    if ((!parent && !module) || (module && module->type) || (parent && (parent->nodetype == LYS_USES) && !(options & LYS_GETNEXT_PARENTUSES))) {
-        LOGARG;
-        return NULL;
-    }
-
-    if (!last) {
-        /* first call */
+#ifdef LY_ENABLED_CACHE
 
-        /* get know where to start */
-        if (parent) {
-            /* schema subtree */
-            snode = lys_child(parent, LYS_UNKNOWN);
-            /* do not return anything if the augment does not have any children */
-            if (!snode || !(*snode) || ((parent->nodetype == LYS_AUGMENT) && ((*snode)->parent != parent))) {
-                return NULL;
-            }
-            next = last = *snode;
-        } else {
-            /* top level data */
-            if (!(options & LYS_GETNEXT_NOSTATECHECK) && (module->disabled || !module->implemented)) {
-                /* nothing to return from a disabled/imported module */
-                return NULL;
-            }
-            next = last = module->data;
-        }
-    } else if ((last->nodetype == LYS_USES) && (options & LYS_GETNEXT_INTOUSES) && last->child) {
-        /* continue with uses content */
-        next = last->child;
-    } else {
-        /* continue after the last returned value */
-        next = last->next;
-    }
+/* schema child in the context hash table, a record with no name marks a parent with all its children stored */
+struct lys_child_rec {
+    const void *parent;                 /* schema parent or module of top-level nodes */
+    LYS_NODE inout;
+    int schema;                         /* schema children including choices, cases, input and output */
+    const char *name;
+    int nam_len;
+    const char *ns;
+    const struct lys_node *node;
+};
 
-repeat:
-    if (parent && (parent->nodetype == LYS_AUGMENT) && next) {
-        /* do not return anything outside the parent augment */
-        aug_parent = next->parent;
-        do {
-            while (aug_parent && (aug_parent->nodetype != LYS_AUGMENT)) {
-                aug_parent = aug_parent->parent;
-            }
-            if (aug_parent) {
-                if (aug_parent == parent) {
-                    break;
-                }
-                aug_parent = ((struct lys_node_augment *)aug_parent)->target;
-            }
+static int
+lys_child_hash_val_equal(void *val1_p, void *val2_p, int UNUSED(mod), void *UNUSED(cb_data))
+{
+    struct lys_child_rec *rec1 = (struct lys_child_rec *)val1_p, *rec2 = (struct lys_child_rec *)val2_p;
 
-        } while (aug_parent);
-        if (!aug_parent) {
-            return NULL;
-        }
+    if ((rec1->parent != rec2->parent) || (rec1->inout != rec2->inout) || (rec1->schema != rec2->schema)
+            || (rec1->ns != rec2->ns) || (rec1->nam_len != rec2->nam_len)) {
+        return 0;
     }
-    while (next && (next->nodetype == LYS_GROUPING)) {
-        if (options & LYS_GETNEXT_WITHGROUPING) {
-            return next;
-        }
-        next = next->next;
+    if (!rec1->name || !rec2->name) {
+        return (rec1->name == rec2->name);
     }
+    return !strncmp(rec1->name, rec2->name, rec1->nam_len);
+}
 
-    if (!next) {     /* cover case when parent is augment */
-        if (!last || last->parent == parent || lys_parent(last) == parent) {
-            /* no next element */
-            return NULL;
-        }
-        last = lys_parent(last);
-        next = last->next;
-        goto repeat;
-    } else {
-        last = next;
-    }
+static uint32_t
+lys_child_hash_rec(const struct lys_child_rec *rec)
+{
+    uint32_t hash;
 
-    if (!(options & LYS_GETNEXT_NOSTATECHECK) && lys_is_disabled(next, 0)) {
-        next = next->next;
-        goto repeat;
+    hash = dict_hash_multi(0, (const char *)&rec->parent, sizeof rec->parent);
+    hash = dict_hash_multi(hash, (const char *)&rec->inout, sizeof rec->inout);
+    hash = dict_hash_multi(hash, (const char *)&rec->schema, sizeof rec->schema);
+    if (rec->name) {
+        hash = dict_hash_multi(hash, rec->name, rec->nam_len);
+        hash = dict_hash_multi(hash, (const char *)&rec->ns, sizeof rec->ns);
     }
+    return dict_hash_multi(hash, NULL, 0);
+}
 
-    switch (next->nodetype) {
-    case LYS_INPUT:
-    case LYS_OUTPUT:
-        if (options & LYS_GETNEXT_WITHINOUT) {
-            return next;
-        } else if (next->child) {
-            next = next->child;
-        } else {
-            next = next->next;
+/* store all the data children of a parent, the same way xml_data_search_schemanode() searches them,
+ * or all the schema children the same way lys_getnext() returns them with choices, cases, and input/output */
+static int
+lys_child_hash_fill(struct hash_table *ht, struct lys_child_rec *rec, const struct lys_node *start)
+{
+    const struct lys_node *node;
+    LYS_NODE transparent;
+
+    transparent = rec->schema ? LYS_USES : (LYS_CHOICE | LYS_CASE | LYS_USES | LYS_INPUT | LYS_OUTPUT);
+    LY_TREE_FOR(start, node) {
+        if (node->nodetype == LYS_GROUPING) {
+            continue;
+        } else if ((node->nodetype & (LYS_INPUT | LYS_OUTPUT)) && rec->inout && (node->nodetype != rec->inout)) {
+            continue;
         }
-        goto repeat;
 
-    case LYS_CASE:
-        if (options & LYS_GETNEXT_WITHCASE) {
-            return next;
-        } else if (next->child) {
-            next = next->child;
-        } else {
-            next = next->next;
+        if (node->nodetype & transparent) {
+            if (lys_child_hash_fill(ht, rec, node->child)) {
+                return -1;
+            }
+            continue;
         }
-        goto repeat;
 
-    case LYS_USES:
-        /* go into */
-        if (options & LYS_GETNEXT_WITHUSES) {
-            return next;
-        } else if (next->child) {
-            next = next->child;
-        } else {
-            next = next->next;
+        rec->name = node->name;
+        rec->nam_len = strlen(node->name);
+        rec->ns = lys_main_module(node->module)->ns;
+        rec->node = node;
+        /* if there are several nodes with the same name (invalid schema), the first one is found */
+        if (lyht_insert(ht, rec, lys_child_hash_rec(rec), NULL) == -1) {
+            return -1;
         }
-        goto repeat;
+    }
 
-    case LYS_RPC:
-    case LYS_ACTION:
-    case LYS_NOTIF:
-    case LYS_LEAF:
-    case LYS_ANYXML:
-    case LYS_ANYDATA:
-    case LYS_LIST:
-    case LYS_LEAFLIST:
-        return next;
+    return 0;
+}
 
-    case LYS_CONTAINER:
-        if (!((struct lys_node_container *)next)->presence && (options & LYS_GETNEXT_INTONPCONT)) {
-            if (next->child) {
-                /* go into */
-                next = next->child;
-            } else {
-                next = next->next;
-            }
-            goto repeat;
-        } else {
-            return next;
-        }
+#endif
 
-    case LYS_CHOICE:
-        if (options & LYS_GETNEXT_WITHCHOICE) {
-            return next;
-        } else if (next->child) {
-            /* go into */
-            next = next->child;
-        } else {
-            next = next->next;
-        }
-        goto repeat;
+void
+lys_children_changed(struct ly_ctx *ctx)
+{
+    ++ctx->schema_gen;
+}
 
-    default:
-        /* we should not be here */
-        return NULL;
+void
+lys_features_changed(struct ly_ctx *ctx)
+{
+#ifdef LY_ENABLED_CACHE
+    /* the generation is stored next to the result bit, zero marks a not evaluated expression */
+    if (!(++ctx->feature_gen & 0x7fffffff)) {
+        ctx->feature_gen = 1;
     }
+#else
+    (void)ctx;
+#endif
 }
 
 void
-lys_node_unlink(struct lys_node *node)
+lys_child_hash_clear(struct ly_ctx *ctx)
 {
-    struct lys_node *parent, *first, **pp = NULL;
-    struct lys_module *main_module;
+#ifdef LY_ENABLED_CACHE
+    pthread_rwlock_wrlock(&ctx->child_hash_lock);
+    lyht_free(ctx->child_hash);
+    ctx->child_hash = NULL;
+    pthread_rwlock_unlock(&ctx->child_hash_lock);
+#else
+    (void)ctx;
+#endif
+}
 
-    if (!node) {
-        return;
-    }
+#ifdef LY_ENABLED_CACHE
 
-    /* unlink from data model if necessary */
-    if (node->module) {
-        /* get main module with data tree */
-        main_module = lys_node_module(node);
-        if (main_module->data == node) {
-            main_module->data = node->next;
-        }
+static int
+lys_find_child_hash_(struct ly_ctx *ctx, const struct lys_node *parent, const struct lys_module *mod, LYS_NODE inout,
+                     int schema, const char *name, int nam_len, const char *ns, const struct lys_node **ret)
+{
+    struct lys_child_rec rec, marker, *match;
+    int found = 0, filled = 0, r = 1;
+
+    if (ctx->models.parsing_sub_modules_count) {
+        /* the schema trees change between the searches, the hash table would be rebuilt all the time */
+        return 1;
     }
 
-    /* store pointers to important nodes */
-    parent = node->parent;
-    if (parent && (parent->nodetype == LYS_AUGMENT)) {
-        /* handle augments - first, unlink it from the augment parent ... */
-        if (parent->child == node) {
-            parent->child = (node->next && node->next->parent == parent) ? node->next : NULL;
+    if (parent) {
+        if (!(parent->nodetype & (LYS_CONTAINER | LYS_LIST | LYS_RPC | LYS_ACTION | LYS_NOTIF | LYS_INPUT | LYS_OUTPUT
+                | (schema ? LYS_CHOICE | LYS_CASE : 0)))) {
+            return 1;
         }
-
-        if (parent->flags & LYS_NOTAPPLIED) {
-            /* data are not connected in the target, so we cannot continue with the target as a parent */
-            parent = NULL;
-        } else {
-            /* data are connected in target, so we will continue with the target as a parent */
-            parent = ((struct lys_node_augment *)parent)->target;
+        if (schema || !(parent->nodetype & (LYS_RPC | LYS_ACTION))) {
+            /* only RPC/action data children differ */
+            inout = 0;
+        }
+        rec.parent = parent;
+    } else {
+        if (mod->type) {
+            return 1;
         }
+        rec.parent = mod;
+        inout = 0;
+    }
+    rec.inout = inout;
+    rec.schema = schema;
+    rec.name = name;
+    rec.nam_len = nam_len;
+    rec.ns = ns;
+    marker = rec;
+    marker.name = NULL;
+    marker.nam_len = 0;
+    marker.ns = NULL;
+
+    pthread_rwlock_rdlock(&ctx->child_hash_lock);
+    if (ctx->child_hash && (ctx->child_hash_set_id == ctx->models.module_set_id)
+            && (ctx->child_hash_gen == ctx->schema_gen)) {
+        if (!lyht_find(ctx->child_hash, &rec, lys_child_hash_rec(&rec), (void **)&match)) {
+            found = 1;
+            *ret = match->node;
+        } else if (!lyht_find(ctx->child_hash, &marker, lys_child_hash_rec(&marker), NULL)) {
+            /* the parent children are stored, there is no such node */
+            found = 1;
+            *ret = NULL;
+        }
+    }
+    pthread_rwlock_unlock(&ctx->child_hash_lock);
+    if (found) {
+        return 0;
     }
 
-    /* unlink from parent */
-    if (parent) {
-        if (parent->nodetype == LYS_EXT) {
-            pp = (struct lys_node **)lys_ext_complex_get_substmt(lys_snode2stmt(node->nodetype),
-                                                                 (struct lys_ext_instance_complex*)parent, NULL);
-            if (*pp == node) {
-                *pp = node->next;
-            }
-        } else if (parent->child == node) {
-            parent->child = node->next;
+    pthread_rwlock_wrlock(&ctx->child_hash_lock);
+    if (ctx->child_hash && ((ctx->child_hash_set_id != ctx->models.module_set_id)
+            || (ctx->child_hash_gen != ctx->schema_gen))) {
+        /* the schema could have changed, the parents may not even exist anymore */
+        lyht_free(ctx->child_hash);
+        ctx->child_hash = NULL;
+    }
+    if (!ctx->child_hash) {
+        ctx->child_hash = lyht_new(1024, sizeof(struct lys_child_rec), lys_child_hash_val_equal, NULL, 1);
+        if (!ctx->child_hash) {
+            goto unlock;
         }
-        node->parent = NULL;
+        ctx->child_hash_set_id = ctx->models.module_set_id;
+        ctx->child_hash_gen = ctx->schema_gen;
     }
 
-    /* unlink from siblings */
-    if (node->prev == node) {
-        /* there are no more siblings */
-        return;
-    }
-    if (node->next) {
-        node->next->prev = node->prev;
+    if (!lyht_find(ctx->child_hash, &marker, lys_child_hash_rec(&marker), NULL)) {
+        /* filled by another thread meanwhile */
+        filled = 1;
     } else {
-        /* unlinking the last element */
-        if (parent) {
-            if (parent->nodetype == LYS_EXT) {
-                first = *(struct lys_node **)pp;
-            } else {
-                first = parent->child;
-            }
+        filled = !lys_child_hash_fill(ctx->child_hash, &marker, parent ? parent->child : mod->data);
+        marker.name = NULL;
+        marker.nam_len = 0;
+        marker.ns = NULL;
+        marker.node = NULL;
+        if (filled && (lyht_insert(ctx->child_hash, &marker, lys_child_hash_rec(&marker), NULL) == -1)) {
+            filled = 0;
+        }
+    }
+    if (filled) {
+        if (!lyht_find(ctx->child_hash, &rec, lys_child_hash_rec(&rec), (void **)&match)) {
+            *ret = match->node;
         } else {
-            first = node;
-            while (first->prev->next) {
-                first = first->prev;
-            }
+            *ret = NULL;
         }
-        first->prev = node->prev;
-    }
-    if (node->prev->next) {
-        node->prev->next = node->next;
+        r = 0;
+    } else {
+        /* some children may be missing, do not use the table anymore */
+        lyht_free(ctx->child_hash);
+        ctx->child_hash = NULL;
     }
 
-    /* clean up the unlinked element */
-    node->next = NULL;
-    node->prev = node;
+unlock:
+    pthread_rwlock_unlock(&ctx->child_hash_lock);
+    return r;
 }
 
-struct lys_node_grp *
-lys_find_grouping_up(const char *name, struct lys_node *start)
+#endif
+
+int
+lys_find_child_hash(struct ly_ctx *ctx, const struct lys_node *parent, const struct lys_module *mod, LYS_NODE inout,
+                    const char *name, int nam_len, const char *ns, const struct lys_node **ret)
 {
-    struct lys_node *par_iter, *iter, *stop;
+#ifdef LY_ENABLED_CACHE
+    return lys_find_child_hash_(ctx, parent, mod, inout, 0, name, nam_len, ns, ret);
+#else
+    (void)ctx;
+    (void)parent;
+    (void)mod;
+    (void)inout;
+    (void)name;
+    (void)nam_len;
+    (void)ns;
+    (void)ret;
+    return 1;
+#endif
+}
 
-    for (par_iter = start; par_iter; par_iter = par_iter->parent) {
-        /* top-level augment, look into module (uses augment is handled correctly below) */
-        if (par_iter->parent && !par_iter->parent->parent && (par_iter->parent->nodetype == LYS_AUGMENT)) {
-            par_iter = lys_main_module(par_iter->parent->module)->data;
-            if (!par_iter) {
-                break;
-            }
-        }
-
-        if (par_iter->nodetype == LYS_EXT) {
-            /* we are in a top-level extension, search grouping in top-level groupings */
-            par_iter = lys_main_module(par_iter->module)->data;
-            if (!par_iter) {
-                /* not connected yet, wait */
-                return NULL;
-            }
-        } else if (par_iter->parent && (par_iter->parent->nodetype & (LYS_CHOICE | LYS_CASE | LYS_AUGMENT | LYS_USES))) {
-            continue;
-        }
+int
+lys_find_schema_child_hash(struct ly_ctx *ctx, const struct lys_node *parent, const struct lys_module *mod,
+                           const char *name, int nam_len, const char *ns, const struct lys_node **ret)
+{
+#ifdef LY_ENABLED_CACHE
+    return lys_find_child_hash_(ctx, parent, mod, 0, 1, name, nam_len, ns, ret);
+#else
+    (void)ctx;
+    (void)parent;
+    (void)mod;
+    (void)name;
+    (void)nam_len;
+    (void)ns;
+    (void)ret;
+    return 1;
+#endif
+}
 
-        for (iter = par_iter, stop = NULL; iter; iter = iter->prev) {
-            if (!stop) {
-                stop = par_iter;
-            } else if (iter == stop) {
-                break;
-            }
-            if (iter->nodetype != LYS_GROUPING) {
-                continue;
-            }
+#ifdef LY_ENABLED_CACHE
 
-            if (!strcmp(name, iter->name)) {
-                return (struct lys_node_grp *)iter;
-            }
-        }
-    }
+/* schema node in the context hash table with the result of lys_mand_subtree() */
+struct lys_mand_rec {
+    const struct lys_node *node;
+    int mand;
+};
 
-    return NULL;
+static int
+lys_mand_hash_val_equal(void *val1_p, void *val2_p, int UNUSED(mod), void *UNUSED(cb_data))
+{
+    return ((struct lys_mand_rec *)val1_p)->node == ((struct lys_mand_rec *)val2_p)->node;
 }
 
-/*
- * get next grouping in the root's subtree, in the
- * first call, tha last is NULL
- */
-static struct lys_node_grp *
-lys_get_next_grouping(struct lys_node_grp *lastgrp, struct lys_node *root)
+static uint32_t
+lys_mand_hash_rec(const struct lys_node *node)
 {
-    struct lys_node *last = (struct lys_node *)lastgrp;
-    struct lys_node *next;
+    uint32_t hash;
 
-    assert(root);
+    hash = dict_hash_multi(0, (const char *)&node, sizeof node);
+    return dict_hash_multi(hash, NULL, 0);
+}
 
-    if (!last) {
-        last = root;
+/* the same nodes lyd_check_mandatory_subtree() checks and descends into */
+static int
+lys_mand_hash_fill(struct hash_table *ht, const struct lys_node *node)
+{
+    const struct lys_node *child;
+    struct lys_mand_rec rec, *match;
+    int r;
+
+    rec.node = node;
+    if (!lyht_find(ht, &rec, lys_mand_hash_rec(node), (void **)&match)) {
+        return match->mand;
     }
 
-    while (1) {
-        if ((last->nodetype & (LYS_CONTAINER | LYS_CHOICE | LYS_LIST | LYS_GROUPING | LYS_INPUT | LYS_OUTPUT))) {
-            next = last->child;
+    rec.mand = 0;
+    switch (node->nodetype) {
+    case LYS_LEAF:
+    case LYS_ANYXML:
+    case LYS_ANYDATA:
+        rec.mand = (node->flags & LYS_MAND_TRUE) ? 1 : 0;
+        break;
+    case LYS_LEAFLIST:
+        rec.mand = (((struct lys_node_leaflist *)node)->min || ((struct lys_node_leaflist *)node)->max) ? 1 : 0;
+        break;
+    case LYS_LIST:
+    case LYS_CHOICE:
+        if (node->nodetype == LYS_LIST) {
+            rec.mand = (((struct lys_node_list *)node)->min || ((struct lys_node_list *)node)->max) ? 1 : 0;
         } else {
-            next = NULL;
-        }
-        if (!next) {
-            if (last == root) {
-                /* we are done */
-                return NULL;
-            }
-
-            /* no children, go to siblings */
-            next = last->next;
+            rec.mand = (node->flags & LYS_MAND_TRUE) ? 1 : 0;
         }
-        while (!next) {
-            /* go back through parents */
-            if (lys_parent(last) == root) {
-                /* we are done */
-                return NULL;
+        /* fallthrough */
+    case LYS_CONTAINER:
+    case LYS_CASE:
+    case LYS_USES:
+    case LYS_INPUT:
+    case LYS_OUTPUT:
+    case LYS_NOTIF:
+        /* children are filled even if the node itself is mandatory, they are searched next */
+        LY_TREE_FOR(node->child, child) {
+            r = lys_mand_hash_fill(ht, child);
+            if (r == -1) {
+                return -1;
             }
-            next = last->next;
-            last = lys_parent(last);
-        }
-
-        if (next->nodetype == LYS_GROUPING) {
-            return (struct lys_node_grp *)next;
+            rec.mand |= r;
         }
+        break;
+    default:
+        return 0;
+    }
+    if (!rec.mand && resolve_applies_when(node, 0, NULL)) {
+        /* absent conditional nodes are checked for their when conditions */
+        rec.mand = 1;
+    }
 
-        last = next;
+    if (lyht_insert(ht, &rec, lys_mand_hash_rec(node), NULL) == -1) {
+        return -1;
     }
+    return rec.mand;
 }
 
-/* logs directly */
-int
-lys_check_id(struct lys_node *node, struct lys_node *parent, struct lys_module *module)
+#endif
+
+void
+lys_mand_hash_clear(struct ly_ctx *ctx)
 {
-    struct lys_node *start, *stop, *iter;
-    struct lys_node_grp *grp;
-    int down, up;
+#ifdef LY_ENABLED_CACHE
+    pthread_rwlock_wrlock(&ctx->mand_hash_lock);
+    lyht_free(ctx->mand_hash);
+    ctx->mand_hash = NULL;
+    pthread_rwlock_unlock(&ctx->mand_hash_lock);
+#else
+    (void)ctx;
+#endif
+}
 
-    assert(node);
+int
+lys_mand_subtree(struct ly_ctx *ctx, const struct lys_node *node)
+{
+#ifdef LY_ENABLED_CACHE
+    struct lys_mand_rec rec, *match;
+    int r = -1;
 
-    if (!parent) {
-        assert(module);
-    } else {
-        module = parent->module;
+    rec.node = node;
+    pthread_rwlock_rdlock(&ctx->mand_hash_lock);
+    if (ctx->mand_hash && (ctx->mand_hash_set_id == ctx->models.module_set_id)
+            && !lyht_find(ctx->mand_hash, &rec, lys_mand_hash_rec(node), (void **)&match)) {
+        r = match->mand;
+    }
+    pthread_rwlock_unlock(&ctx->mand_hash_lock);
+    if (r > -1) {
+        return r;
     }
-    module = lys_main_module(module);
 
-    switch (node->nodetype) {
-    case LYS_GROUPING:
-        /* 6.2.1, rule 6 */
-        if (parent) {
-            start = *lys_child(parent, LYS_GROUPING);
-            if (!start) {
-                down = 0;
-                start = parent;
-            } else {
-                down = 1;
-            }
-            if (parent->nodetype == LYS_EXT) {
-                up = 0;
-            } else {
-                up = 1;
-            }
-        } else {
-            down = up = 1;
-            start = module->data;
-        }
-        /* go up */
-        if (up && lys_find_grouping_up(node->name, start)) {
-            LOGVAL(module->ctx, LYE_DUPID, LY_VLOG_LYS, node, "grouping", node->name);
-            return EXIT_FAILURE;
+    pthread_rwlock_wrlock(&ctx->mand_hash_lock);
+    if (ctx->mand_hash && (ctx->mand_hash_set_id != ctx->models.module_set_id)) {
+        lyht_free(ctx->mand_hash);
+        ctx->mand_hash = NULL;
+    }
+    if (!ctx->mand_hash) {
+        ctx->mand_hash = lyht_new(1024, sizeof(struct lys_mand_rec), lys_mand_hash_val_equal, NULL, 1);
+        if (!ctx->mand_hash) {
+            goto unlock;
         }
-        /* go down, because grouping can be defined after e.g. container in which is collision */
-        if (down) {
-            for (iter = start, stop = NULL; iter; iter = iter->prev) {
-                if (!stop) {
-                    stop = start;
-                } else if (iter == stop) {
-                    break;
-                }
-                if (!(iter->nodetype & (LYS_CONTAINER | LYS_CHOICE | LYS_LIST | LYS_GROUPING | LYS_INPUT | LYS_OUTPUT))) {
-                    continue;
-                }
+        ctx->mand_hash_set_id = ctx->models.module_set_id;
+    }
+    r = lys_mand_hash_fill(ctx->mand_hash, node);
+    if (r == -1) {
+        /* some nodes may be missing, do not use the table anymore */
+        lyht_free(ctx->mand_hash);
+        ctx->mand_hash = NULL;
+    }
 
-                grp = NULL;
-                while ((grp = lys_get_next_grouping(grp, iter))) {
-                    if (ly_strequal(node->name, grp->name, 1)) {
-                        LOGVAL(module->ctx, LYE_DUPID,LY_VLOG_LYS, node, "grouping", node->name);
-                        return EXIT_FAILURE;
-                    }
-                }
+unlock:
+    pthread_rwlock_unlock(&ctx->mand_hash_lock);
+    return (r == -1) ? 1 : r;
+#else
+    (void)ctx;
+    (void)node;
+    return 1;
+#endif
+}
+
+/* instance-identifiers are checked for external dependencies only at runtime */
+static int
+lys_type_has_instid(const struct lys_type *type)
+{
+    const struct lys_type *t = NULL;
+
+    if (type->base == LY_TYPE_INST) {
+        return 1;
+    } else if (type->base == LY_TYPE_UNION) {
+        while ((t = lys_getnext_union_type(t, type))) {
+            if (t->base == LY_TYPE_INST) {
+                return 1;
             }
         }
-        break;
+    }
+    return 0;
+}
+
+static int
+lys_op_ext_deps_subtree(const struct lys_node *node)
+{
+    const struct lys_node *child;
+
+    /* dependency flags were set when the expressions and leafrefs were resolved */
+    if (node->flags & (LYS_XPCONF_DEP | LYS_XPSTATE_DEP | LYS_LEAFREF_DEP)) {
+        return 1;
+    }
+    if (node->parent && (node->parent->nodetype == LYS_AUGMENT)
+            && (node->parent->flags & (LYS_XPCONF_DEP | LYS_XPSTATE_DEP))) {
+        return 1;
+    }
+
+    switch (node->nodetype) {
     case LYS_LEAF:
     case LYS_LEAFLIST:
-    case LYS_LIST:
+        return lys_type_has_instid(&((struct lys_node_leaf *)node)->type);
     case LYS_CONTAINER:
+    case LYS_LIST:
     case LYS_CHOICE:
-    case LYS_ANYDATA:
-        /* 6.2.1, rule 7 */
-        if (parent) {
-            iter = parent;
-            while (iter && (iter->nodetype & (LYS_USES | LYS_CASE | LYS_CHOICE | LYS_AUGMENT))) {
-                if (iter->nodetype == LYS_AUGMENT) {
-                    if (((struct lys_node_augment *)iter)->target) {
-                        /* augment is resolved, go up */
-                        iter = ((struct lys_node_augment *)iter)->target;
-                        continue;
-                    }
-                    /* augment is not resolved, this is the final parent */
-                    break;
-                }
-                iter = iter->parent;
+    case LYS_CASE:
+    case LYS_USES:
+    case LYS_INPUT:
+    case LYS_OUTPUT:
+    case LYS_NOTIF:
+        LY_TREE_FOR(node->child, child) {
+            if (lys_op_ext_deps_subtree(child)) {
+                return 1;
             }
+        }
+        return 0;
+    default:
+        return 0;
+    }
+}
 
-            if (!iter) {
-                stop = NULL;
-                iter = module->data;
-            } else if (iter->nodetype == LYS_EXT) {
-                stop = iter;
-                iter = (struct lys_node *)lys_child(iter, node->nodetype);
-                if (iter) {
-                    iter = *(struct lys_node **)iter;
+static int
+lys_op_ext_deps_check(const struct lys_node *op, const struct lys_node *msg)
+{
+    const struct lys_node *parent;
+    const struct lys_node_list *slist;
+    uint8_t i;
+
+    /* nested operations are validated together with their parents in the data tree */
+    for (parent = lys_parent(op); parent; parent = lys_parent(parent)) {
+        if (resolve_applies_when(parent, 0, NULL)) {
+            return 1;
+        }
+        if (parent->nodetype == LYS_CONTAINER) {
+            if (((struct lys_node_container *)parent)->must_size) {
+                return 1;
+            }
+        } else if (parent->nodetype == LYS_LIST) {
+            slist = (struct lys_node_list *)parent;
+            if (slist->must_size) {
+                return 1;
+            }
+            for (i = 0; i < slist->keys_size; ++i) {
+                if ((slist->keys[i]->type.base == LY_TYPE_LEAFREF) || lys_type_has_instid(&slist->keys[i]->type)) {
+                    return 1;
                 }
-            } else {
-                stop = iter;
-                iter = iter->child;
             }
-        } else {
-            stop = NULL;
-            iter = module->data;
         }
-        while (iter) {
-            if (iter->nodetype & (LYS_USES | LYS_CASE)) {
-                iter = iter->child;
-                continue;
-            }
+    }
 
-            if (iter->nodetype & (LYS_LEAF | LYS_LEAFLIST | LYS_LIST | LYS_CONTAINER | LYS_CHOICE | LYS_ANYDATA)) {
-                if (iter->module == node->module && ly_strequal(iter->name, node->name, 1)) {
-                    LOGVAL(module->ctx, LYE_DUPID, LY_VLOG_LYS, node, strnodetype(node->nodetype), node->name);
-                    return EXIT_FAILURE;
-                }
-            }
+    return msg ? lys_op_ext_deps_subtree(msg) : 0;
+}
 
-            /* special case for choice - we must check the choice's name as
-             * well as the names of nodes under the choice
-             */
-            if (iter->nodetype == LYS_CHOICE) {
-                iter = iter->child;
-                continue;
-            }
+#ifdef LY_ENABLED_CACHE
 
-            /* go to siblings */
-            if (!iter->next) {
-                /* no sibling, go to parent's sibling */
-                do {
-                    /* for parent LYS_AUGMENT */
-                    if (iter->parent == stop) {
-                        iter = stop;
-                        break;
-                    }
-                    iter = lys_parent(iter);
-                    if (iter && iter->next) {
-                        break;
-                    }
-                } while (iter != stop);
+/* operation input, output, or notification in the context hash table with the result of lys_op_ext_deps() */
+struct lys_op_deps_rec {
+    const struct lys_node *msg;
+    int deps;
+};
 
-                if (iter == stop) {
-                    break;
-                }
+static int
+lys_op_deps_hash_val_equal(void *val1_p, void *val2_p, int UNUSED(mod), void *UNUSED(cb_data))
+{
+    return ((struct lys_op_deps_rec *)val1_p)->msg == ((struct lys_op_deps_rec *)val2_p)->msg;
+}
+
+#endif
+
+void
+lys_op_deps_hash_clear(struct ly_ctx *ctx)
+{
+#ifdef LY_ENABLED_CACHE
+    pthread_rwlock_wrlock(&ctx->op_deps_hash_lock);
+    lyht_free(ctx->op_deps_hash);
+    ctx->op_deps_hash = NULL;
+    pthread_rwlock_unlock(&ctx->op_deps_hash_lock);
+#else
+    (void)ctx;
+#endif
+}
+
+int
+lys_op_ext_deps(struct ly_ctx *ctx, const struct lys_node *op, int output)
+{
+    const struct lys_node *msg = NULL;
+#ifdef LY_ENABLED_CACHE
+    struct lys_op_deps_rec rec, *match;
+    uint32_t hash;
+    int r = -1;
+#endif
+
+    assert(op->nodetype & (LYS_RPC | LYS_ACTION | LYS_NOTIF));
+
+    if (op->nodetype == LYS_NOTIF) {
+        msg = op;
+    } else {
+        LY_TREE_FOR(op->child, msg) {
+            if (msg->nodetype == (output ? LYS_OUTPUT : LYS_INPUT)) {
+                break;
             }
-            iter = iter->next;
         }
-        break;
-    case LYS_CASE:
-        /* 6.2.1, rule 8 */
-        if (parent) {
-            start = *lys_child(parent, LYS_CASE);
-        } else {
-            start = module->data;
+        if (!msg) {
+            /* no input/output at all, only the parents of an action matter */
+            return lys_op_ext_deps_check(op, NULL);
         }
+    }
 
-        LY_TREE_FOR(start, iter) {
-            if (!(iter->nodetype & (LYS_ANYDATA | LYS_CASE | LYS_CONTAINER | LYS_LEAF | LYS_LEAFLIST | LYS_LIST))) {
-                continue;
-            }
+#ifdef LY_ENABLED_CACHE
+    rec.msg = msg;
+    hash = dict_hash_multi(0, (const char *)&msg, sizeof msg);
+    hash = dict_hash_multi(hash, NULL, 0);
 
-            if (iter->module == node->module && ly_strequal(iter->name, node->name, 1)) {
-                LOGVAL(module->ctx, LYE_DUPID, LY_VLOG_LYS, node, "case", node->name);
-                return EXIT_FAILURE;
-            }
-        }
-        break;
-    default:
-        /* no check needed */
-        break;
+    pthread_rwlock_rdlock(&ctx->op_deps_hash_lock);
+    if (ctx->op_deps_hash && (ctx->op_deps_hash_set_id == ctx->models.module_set_id)
+            && !lyht_find(ctx->op_deps_hash, &rec, hash, (void **)&match)) {
+        r = match->deps;
+    }
+    pthread_rwlock_unlock(&ctx->op_deps_hash_lock);
+    if (r > -1) {
+        return r;
     }
 
-    return EXIT_SUCCESS;
+    rec.deps = lys_op_ext_deps_check(op, msg);
+
+    pthread_rwlock_wrlock(&ctx->op_deps_hash_lock);
+    if (ctx->op_deps_hash && (ctx->op_deps_hash_set_id != ctx->models.module_set_id)) {
+        lyht_free(ctx->op_deps_hash);
+        ctx->op_deps_hash = NULL;
+    }
+    if (!ctx->op_deps_hash) {
+        ctx->op_deps_hash = lyht_new(16, sizeof(struct lys_op_deps_rec), lys_op_deps_hash_val_equal, NULL, 1);
+        ctx->op_deps_hash_set_id = ctx->models.module_set_id;
+    }
+    if (ctx->op_deps_hash && (lyht_insert(ctx->op_deps_hash, &rec, hash, NULL) == -1)) {
+        lyht_free(ctx->op_deps_hash);
+        ctx->op_deps_hash = NULL;
+    }
+    pthread_rwlock_unlock(&ctx->op_deps_hash_lock);
+
+    return rec.deps;
+#else
+    (void)ctx;
+    return lys_op_ext_deps_check(op, msg);
+#endif
 }
 
-/* logs directly */
-int
-lys_node_addchild(struct lys_node *parent, struct lys_module *module, struct lys_node *child, int options)
+#ifdef LY_ENABLED_CACHE
+
+/* absolute schema path in the context hash table with the node(s) it was resolved to */
+struct lys_path_rec {
+    const char *path;                   /* owned by the record once inserted */
+    int kind;
+    const struct lys_node *node;        /* #LYS_PATH_JSON and #LYS_PATH_JSON_OUTPUT result */
+    struct ly_set *set;                 /* #LYS_PATH_SCHEMA result */
+};
+
+static int
+lys_path_hash_val_equal(void *val1_p, void *val2_p, int UNUSED(mod), void *UNUSED(cb_data))
 {
-    struct ly_ctx *ctx = child->module->ctx;
-    struct lys_node *iter, **pchild, *log_parent;
-    struct lys_node_inout *in, *out;
-    struct lys_node_case *c;
-    int type, shortcase = 0;
-    void *p;
-    struct lyext_substmt *info = NULL;
+    struct lys_path_rec *rec1 = (struct lys_path_rec *)val1_p, *rec2 = (struct lys_path_rec *)val2_p;
 
-    assert(child);
+    return (rec1->kind == rec2->kind) && !strcmp(rec1->path, rec2->path);
+}
 
-    if (parent) {
-        type = parent->nodetype;
-        module = parent->module;
-        log_parent = parent;
+static uint32_t
+lys_path_hash_rec(const struct lys_path_rec *rec)
+{
+    uint32_t hash;
 
-        if (type == LYS_USES) {
-            /* we are adding children to uses -> we must be copying grouping contents into it, so properly check the parent */
-            log_parent = lys_parent(log_parent);
-            while (log_parent && (log_parent->nodetype == LYS_USES)) {
-                log_parent = lys_parent(log_parent);
-            }
-            if (log_parent) {
-                type = log_parent->nodetype;
-            } else {
-                type = 0;
-            }
+    hash = dict_hash_multi(0, rec->path, strlen(rec->path));
+    hash = dict_hash_multi(hash, (const char *)&rec->kind, sizeof rec->kind);
+    return dict_hash_multi(hash, NULL, 0);
+}
+
+static void
+lys_path_hash_free(struct hash_table *ht)
+{
+    struct lys_path_rec *rec;
+    uint32_t i;
+
+    if (!ht) {
+        return;
+    }
+    for (i = 0; i < ht->size; ++i) {
+        if (ht->ctrl[i] & LYHT_CTRL_FULL) {
+            rec = (struct lys_path_rec *)lyht_get_rec(ht->recs, ht->rec_size, i)->val;
+            free((char *)rec->path);
+            ly_set_free(rec->set);
         }
-    } else {
-        assert(module);
-        assert(!(child->nodetype & (LYS_INPUT | LYS_OUTPUT)));
-        type = 0;
-        log_parent = NULL;
     }
+    lyht_free(ht);
+}
 
-    /* checks */
-    switch (type) {
-    case LYS_CONTAINER:
-    case LYS_LIST:
-    case LYS_GROUPING:
-    case LYS_USES:
-        if (!(child->nodetype &
-                (LYS_ANYDATA | LYS_CHOICE | LYS_CONTAINER | LYS_GROUPING | LYS_LEAF |
-                 LYS_LEAFLIST | LYS_LIST | LYS_USES | LYS_ACTION | LYS_NOTIF))) {
-            LOGVAL(ctx, LYE_INCHILDSTMT, LY_VLOG_LYS, log_parent, strnodetype(child->nodetype), strnodetype(log_parent->nodetype));
-            return EXIT_FAILURE;
-        }
-        break;
-    case LYS_INPUT:
-    case LYS_OUTPUT:
-    case LYS_NOTIF:
-        if (!(child->nodetype &
-                (LYS_ANYDATA | LYS_CHOICE | LYS_CONTAINER | LYS_GROUPING | LYS_LEAF |
-                 LYS_LEAFLIST | LYS_LIST | LYS_USES))) {
-            LOGVAL(ctx, LYE_INCHILDSTMT, LY_VLOG_LYS, log_parent, strnodetype(child->nodetype), strnodetype(log_parent->nodetype));
-            return EXIT_FAILURE;
-        }
-        break;
-    case LYS_CHOICE:
-        if (!(child->nodetype &
-                (LYS_ANYDATA | LYS_CASE | LYS_CONTAINER | LYS_LEAF | LYS_LEAFLIST | LYS_LIST | LYS_CHOICE))) {
-            LOGVAL(ctx, LYE_INCHILDSTMT, LY_VLOG_LYS, log_parent, strnodetype(child->nodetype), "choice");
-            return EXIT_FAILURE;
-        }
-        if (child->nodetype != LYS_CASE) {
-            shortcase = 1;
-        }
-        break;
-    case LYS_CASE:
-        if (!(child->nodetype &
-                (LYS_ANYDATA | LYS_CHOICE | LYS_CONTAINER | LYS_LEAF | LYS_LEAFLIST | LYS_LIST | LYS_USES))) {
-            LOGVAL(ctx, LYE_INCHILDSTMT, LY_VLOG_LYS, log_parent, strnodetype(child->nodetype), "case");
-            return EXIT_FAILURE;
-        }
-        break;
-    case LYS_RPC:
-    case LYS_ACTION:
-        if (!(child->nodetype & (LYS_INPUT | LYS_OUTPUT | LYS_GROUPING))) {
-            LOGVAL(ctx, LYE_INCHILDSTMT, LY_VLOG_LYS, log_parent, strnodetype(child->nodetype), "rpc");
-            return EXIT_FAILURE;
-        }
-        break;
-    case LYS_LEAF:
-    case LYS_LEAFLIST:
-    case LYS_ANYXML:
-    case LYS_ANYDATA:
-        LOGVAL(ctx, LYE_INCHILDSTMT, LY_VLOG_LYS, log_parent, strnodetype(child->nodetype), strnodetype(log_parent->nodetype));
-        LOGVAL(ctx, LYE_SPEC, LY_VLOG_PREV, NULL, "The \"%s\" statement cannot have any data substatement.",
-               strnodetype(log_parent->nodetype));
-        return EXIT_FAILURE;
-    case LYS_AUGMENT:
-        if (!(child->nodetype &
-                (LYS_ANYDATA | LYS_CASE | LYS_CHOICE | LYS_CONTAINER | LYS_LEAF
-                | LYS_LEAFLIST | LYS_LIST | LYS_USES | LYS_ACTION | LYS_NOTIF))) {
-            LOGVAL(ctx, LYE_INCHILDSTMT, LY_VLOG_LYS, log_parent, strnodetype(child->nodetype), strnodetype(log_parent->nodetype));
-            return EXIT_FAILURE;
-        }
-        break;
-    case LYS_UNKNOWN:
-        /* top level */
-        if (!(child->nodetype &
-                (LYS_ANYDATA | LYS_CHOICE | LYS_CONTAINER | LYS_LEAF | LYS_GROUPING
-                | LYS_LEAFLIST | LYS_LIST | LYS_USES | LYS_RPC | LYS_NOTIF | LYS_AUGMENT))) {
-            LOGVAL(ctx, LYE_INCHILDSTMT, LY_VLOG_LYS, log_parent, strnodetype(child->nodetype), "(sub)module");
-            return EXIT_FAILURE;
-        }
-        break;
-    case LYS_EXT:
-        /* plugin-defined */
-        p = lys_ext_complex_get_substmt(lys_snode2stmt(child->nodetype), (struct lys_ext_instance_complex*)log_parent, &info);
-        if (!p) {
-            LOGVAL(ctx, LYE_INCHILDSTMT, LY_VLOG_LYS, log_parent, strnodetype(child->nodetype),
-                   ((struct lys_ext_instance_complex*)log_parent)->def->name);
-            return EXIT_FAILURE;
+/* the resolved nodes depend on the modules, their deviations and augments, and the feature states */
+static int
+lys_path_hash_valid(struct ly_ctx *ctx)
+{
+    return (ctx->path_hash_set_id == ctx->models.module_set_id) && (ctx->path_hash_gen == ctx->schema_gen)
+            && (ctx->path_hash_feature_gen == ctx->feature_gen);
+}
+
+#endif
+
+void
+lys_path_hash_clear(struct ly_ctx *ctx)
+{
+#ifdef LY_ENABLED_CACHE
+    pthread_rwlock_wrlock(&ctx->path_hash_lock);
+    lys_path_hash_free(ctx->path_hash);
+    ctx->path_hash = NULL;
+    pthread_rwlock_unlock(&ctx->path_hash_lock);
+#else
+    (void)ctx;
+#endif
+}
+
+int
+lys_path_hash_find(struct ly_ctx *ctx, const char *path, int kind, const struct lys_node **node, struct ly_set **set)
+{
+#ifdef LY_ENABLED_CACHE
+    struct lys_path_rec rec, *match;
+    int r = 1;
+
+    if (ctx->models.parsing_sub_modules_count) {
+        /* the schema trees are just being changed */
+        return 1;
+    }
+
+    rec.path = path;
+    rec.kind = kind;
+    pthread_rwlock_rdlock(&ctx->path_hash_lock);
+    if (ctx->path_hash && lys_path_hash_valid(ctx)
+            && !lyht_find(ctx->path_hash, &rec, lys_path_hash_rec(&rec), (void **)&match)) {
+        if (kind == LYS_PATH_SCHEMA) {
+            *set = ly_set_dup(match->set);
+            r = *set ? 0 : 1;
+        } else {
+            *node = match->node;
+            r = 0;
         }
-        /* TODO check cardinality */
-        break;
     }
+    pthread_rwlock_unlock(&ctx->path_hash_lock);
 
-    /* check identifier uniqueness */
-    if (!(module->ctx->models.flags & LY_CTX_TRUSTED) && lys_check_id(child, parent, module)) {
-        return EXIT_FAILURE;
+    return r;
+#else
+    (void)ctx;
+    (void)path;
+    (void)kind;
+    (void)node;
+    (void)set;
+    return 1;
+#endif
+}
+
+void
+lys_path_hash_add(struct ly_ctx *ctx, const char *path, int kind, const struct lys_node *node, const struct ly_set *set)
+{
+#ifdef LY_ENABLED_CACHE
+    struct lys_path_rec rec;
+    uint32_t hash;
+
+    if (ctx->models.parsing_sub_modules_count) {
+        return;
     }
 
-    if (child->parent) {
-        lys_node_unlink(child);
+    rec.kind = kind;
+    rec.node = node;
+    rec.set = NULL;
+    rec.path = strdup(path);
+    if (!rec.path || (set && !(rec.set = ly_set_dup(set)))) {
+        /* not storing it is not an error */
+        free((char *)rec.path);
+        return;
     }
+    hash = lys_path_hash_rec(&rec);
 
-    if ((child->nodetype & (LYS_INPUT | LYS_OUTPUT)) && parent->nodetype != LYS_EXT) {
-        /* find the implicit input/output node */
-        LY_TREE_FOR(parent->child, iter) {
-            if (iter->nodetype == child->nodetype) {
-                break;
-            }
-        }
-        assert(iter);
+    pthread_rwlock_wrlock(&ctx->path_hash_lock);
+    if (ctx->path_hash && (!lys_path_hash_valid(ctx) || (ctx->path_hash->used >= LY_CACHE_PATH_MAX))) {
+        /* outdated, or start over instead of tracking the least used paths */
+        lys_path_hash_free(ctx->path_hash);
+        ctx->path_hash = NULL;
+    }
+    if (!ctx->path_hash) {
+        ctx->path_hash = lyht_new(64, sizeof rec, lys_path_hash_val_equal, NULL, 1);
+        ctx->path_hash_set_id = ctx->models.module_set_id;
+        ctx->path_hash_gen = ctx->schema_gen;
+        ctx->path_hash_feature_gen = ctx->feature_gen;
+    }
+    if (!ctx->path_hash || lyht_insert(ctx->path_hash, &rec, hash, NULL)) {
+        /* no memory or stored by another thread meanwhile */
+        free((char *)rec.path);
+        ly_set_free(rec.set);
+    }
+    pthread_rwlock_unlock(&ctx->path_hash_lock);
+#else
+    (void)ctx;
+    (void)path;
+    (void)kind;
+    (void)node;
+    (void)set;
+#endif
+}
 
-        /* switch the old implicit node (iter) with the new one (child) */
-        if (parent->child == iter) {
-            /* first child */
-            parent->child = child;
-        } else {
-            iter->prev->next = child;
-        }
-        child->prev = iter->prev;
-        child->next = iter->next;
-        if (iter->next) {
-            iter->next->prev = child;
-        } else {
-            /* last child */
-            parent->child->prev = child;
-        }
-        child->parent = parent;
+/* schema node in the table of node IDs, no node marks colliding IDs */
+struct lys_node_id_rec {
+    uint64_t id;
+    const struct lys_node *node;
+};
 
-        /* isolate the node and free it */
-        iter->next = NULL;
-        iter->prev = iter;
-        iter->parent = NULL;
-        lys_node_free(iter, NULL, 0);
-    } else {
-        if (shortcase) {
-            /* create the implicit case to allow it to serve as a target of the augments,
-             * it won't be printed, but it will be present in the tree */
-            c = calloc(1, sizeof *c);
-            LY_CHECK_ERR_RETURN(!c, LOGMEM(ctx), EXIT_FAILURE);
-            c->name = lydict_insert(module->ctx, child->name, 0);
-            c->flags = LYS_IMPLICIT;
-            if (!(options & (LYS_PARSE_OPT_CFG_IGNORE | LYS_PARSE_OPT_CFG_NOINHERIT))) {
-                /* get config flag from parent */
-                c->flags |= parent->flags & LYS_CONFIG_MASK;
-            }
-            c->module = module;
-            c->nodetype = LYS_CASE;
-            c->prev = (struct lys_node*)c;
-            lys_node_addchild(parent, module, (struct lys_node*)c, options);
-            parent = (struct lys_node*)c;
-        }
-        /* connect the child correctly */
-        if (!parent) {
-            if (module->data) {
-                module->data->prev->next = child;
-                child->prev = module->data->prev;
-                module->data->prev = child;
-            } else {
-                module->data = child;
-            }
-        } else {
-            pchild = lys_child(parent, child->nodetype);
-            assert(pchild);
+static int
+lys_node_id_val_equal(void *val1_p, void *val2_p, int UNUSED(mod), void *UNUSED(cb_data))
+{
+    return ((struct lys_node_id_rec *)val1_p)->id == ((struct lys_node_id_rec *)val2_p)->id;
+}
 
-            child->parent = parent;
-            if (!(*pchild)) {
-                /* the only/first child of the parent */
-                *pchild = child;
-                iter = child;
-            } else {
-                /* add a new child at the end of parent's child list */
-                iter = (*pchild)->prev;
-                iter->next = child;
-                child->prev = iter;
-            }
-            while (iter->next) {
-                iter = iter->next;
-                iter->parent = parent;
-            }
-            (*pchild)->prev = iter;
-        }
+static uint32_t
+lys_node_id_ht_hash(uint64_t id)
+{
+    return (uint32_t)(id ^ (id >> 32));
+}
+
+/* 64-bit FNV-1a, the IDs must not change between processes and libyang versions */
+static uint64_t
+lys_node_id_hash(uint64_t hash, const char *data, size_t len)
+{
+    size_t i;
+
+    for (i = 0; i < len; ++i) {
+        hash ^= (uint8_t)data[i];
+        hash *= 0x100000001b3ULL;
     }
+    return hash;
+}
 
-    /* check config value (but ignore them in groupings and augments) */
-    for (iter = parent; iter && !(iter->nodetype & (LYS_GROUPING | LYS_AUGMENT | LYS_EXT)); iter = iter->parent);
-    if (parent && !iter) {
-        for (iter = child; iter && !(iter->nodetype & (LYS_NOTIF | LYS_INPUT | LYS_OUTPUT | LYS_RPC)); iter = iter->parent);
-        if (!iter && (parent->flags & LYS_CONFIG_R) && (child->flags & LYS_CONFIG_W)) {
-            LOGVAL(ctx, LYE_INARG, LY_VLOG_LYS, child, "true", "config");
-            LOGVAL(ctx, LYE_SPEC, LY_VLOG_PREV, NULL, "State nodes cannot have configuration nodes as children.");
-            return EXIT_FAILURE;
-        }
+/* hash of the module a top-level node is defined in, its name and latest revision */
+static uint64_t
+lys_node_id_module(const struct lys_module *module)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+
+    hash = lys_node_id_hash(hash, module->name, strlen(module->name));
+    hash = lys_node_id_hash(hash, "@", 1);
+    if (module->rev_size) {
+        hash = lys_node_id_hash(hash, module->rev[0].date, strlen(module->rev[0].date));
     }
+    return hash;
+}
 
-    /* propagate information about status data presence */
-    if ((child->nodetype & (LYS_CONTAINER | LYS_CHOICE | LYS_LEAF | LYS_LEAFLIST | LYS_LIST | LYS_ANYDATA)) &&
-            (child->flags & LYS_INCL_STATUS)) {
-        for(iter = parent; iter; iter = lys_parent(iter)) {
-            /* store it only into container or list - the only data inner nodes */
-            if (iter->nodetype & (LYS_CONTAINER | LYS_LIST)) {
-                if (iter->flags & LYS_INCL_STATUS) {
-                    /* done, someone else set it already from here */
-                    break;
-                }
-                /* set flag about including status data */
-                iter->flags |= LYS_INCL_STATUS;
-            }
+/* add a node into the hash of its parent, the node type distinguishes the groupings and uses from the data nodes */
+static uint64_t
+lys_node_id_step(uint64_t hash, const struct lys_node *node)
+{
+    const char *mod_name = lys_node_module(node)->name;
+    uint8_t type[2];
+
+    type[0] = node->nodetype >> 8;
+    type[1] = node->nodetype & 0xff;
+    hash = lys_node_id_hash(hash, "/", 1);
+    hash = lys_node_id_hash(hash, (const char *)type, 2);
+    hash = lys_node_id_hash(hash, mod_name, strlen(mod_name));
+    hash = lys_node_id_hash(hash, ":", 1);
+    return lys_node_id_hash(hash, node->name, strlen(node->name));
+}
+
+static uint64_t
+lys_node_id_compute(const struct lys_node *node)
+{
+    const struct lys_node *parent;
+
+    parent = lys_parent(node);
+    return lys_node_id_step(parent ? lys_node_id_compute(parent) : lys_node_id_module(lys_node_module(node)), node);
+}
+
+/* 0 is never an ID */
+static uint64_t
+lys_node_id_fix(uint64_t id)
+{
+    return id ? id : 1;
+}
+
+static int
+lys_node_id_add(struct ly_ctx *ctx, struct hash_table *ht, const struct lys_node *first, uint64_t parent_hash)
+{
+    const struct lys_node *node;
+    struct lys_node_id_rec rec, *found;
+    uint64_t hash;
+    int r;
+
+    LY_TREE_FOR(first, node) {
+        hash = lys_node_id_step(parent_hash, node);
+        rec.id = lys_node_id_fix(hash);
+        rec.node = node;
+        r = lyht_insert(ht, &rec, lys_node_id_ht_hash(rec.id), (void **)&found);
+        if (r == -1) {
+            return -1;
+        } else if (r && found->node) {
+            LOGWRN(ctx, "Schema nodes \"%s\" and \"%s\" have the same ID, none of them can be found by it.",
+                   found->node->name, node->name);
+            found->node = NULL;
         }
-    }
 
-    /* create implicit input/output nodes to have available them as possible target for augment */
-    if ((child->nodetype & (LYS_RPC | LYS_ACTION)) && !child->child) {
-        in = calloc(1, sizeof *in);
-        out = calloc(1, sizeof *out);
-        if (!in || !out) {
-            LOGMEM(ctx);
-            free(in);
-            free(out);
-            return EXIT_FAILURE;
+        if (!(node->nodetype & (LYS_LEAF | LYS_LEAFLIST | LYS_ANYDATA)) && node->child
+                && lys_node_id_add(ctx, ht, node->child, hash)) {
+            return -1;
         }
-        in->nodetype = LYS_INPUT;
-        in->name = lydict_insert(child->module->ctx, "input", 5);
-        out->nodetype = LYS_OUTPUT;
-        out->name = lydict_insert(child->module->ctx, "output", 6);
-        in->module = out->module = child->module;
-        in->parent = out->parent = child;
-        in->flags = out->flags = LYS_IMPLICIT;
-        in->next = (struct lys_node *)out;
-        in->prev = (struct lys_node *)out;
-        out->prev = (struct lys_node *)in;
-        child->child = (struct lys_node *)in;
     }
-    return EXIT_SUCCESS;
+
+    return 0;
 }
 
-const struct lys_module *
-lys_parse_mem_(struct ly_ctx *ctx, const char *data, LYS_INFORMAT format, const char *revision, int internal, int implement)
+/* call with the write lock */
+static struct hash_table *
+lys_node_id_table(struct ly_ctx *ctx)
 {
-    char *enlarged_data = NULL;
-    struct lys_module *mod = NULL;
-    unsigned int len;
+    struct hash_table *ht;
+    struct lys_module *mod;
+    int i;
 
-    if (!ctx || !data) {
-        LOGARG;
-        return NULL;
+    if (ctx->node_id_ht && (ctx->node_id_set_id == ctx->models.module_set_id) && (ctx->node_id_gen == ctx->schema_gen)) {
+        return ctx->node_id_ht;
     }
+    lyht_free(ctx->node_id_ht);
+    ctx->node_id_ht = NULL;
 
-    if (!internal && format == LYS_IN_YANG) {
-        /* enlarge data by 2 bytes for flex */
-        len = strlen(data);
-        enlarged_data = malloc((len + 2) * sizeof *enlarged_data);
-        LY_CHECK_ERR_RETURN(!enlarged_data, LOGMEM(ctx), NULL);
-        memcpy(enlarged_data, data, len);
-        enlarged_data[len] = enlarged_data[len + 1] = '\0';
-        data = enlarged_data;
+    ht = lyht_new(256, sizeof(struct lys_node_id_rec), lys_node_id_val_equal, NULL, 1);
+    LY_CHECK_ERR_RETURN(!ht, LOGMEM(ctx), NULL);
+    for (i = 0; i < ctx->models.used; ++i) {
+        mod = ctx->models.list[i];
+        if (mod->data && lys_node_id_add(ctx, ht, mod->data, lys_node_id_module(mod))) {
+            LOGMEM(ctx);
+            lyht_free(ht);
+            return NULL;
+        }
     }
 
-    switch (format) {
-    case LYS_IN_YIN:
-        mod = yin_read_module(ctx, data, revision, implement);
-        break;
-    case LYS_IN_YANG:
-        mod = yang_read_module(ctx, data, 0, revision, implement);
-        break;
-    default:
-        LOGERR(ctx, LY_EINVAL, "Invalid schema input format.");
-        break;
-    }
+    ctx->node_id_ht = ht;
+    ctx->node_id_set_id = ctx->models.module_set_id;
+    ctx->node_id_gen = ctx->schema_gen;
+    return ht;
+}
 
-    free(enlarged_data);
+/* find the record of an ID, the table is built first if needed */
+static int
+lys_node_id_get(struct ly_ctx *ctx, uint64_t id, struct lys_node_id_rec *ret)
+{
+    struct lys_node_id_rec rec, *found;
+    int r = 1;
 
-    /* hack for NETCONF's edit-config's operation attribute. It is not defined in the schema, but since libyang
-     * implements YANG metadata (annotations), we need its definition. Because the ietf-netconf schema is not the
-     * internal part of libyang, we cannot add the annotation into the schema source, but we do it here to have
-     * the anotation definitions available in the internal schema structure. There is another hack in schema
-     * printers to do not print this internally added annotation. */
-    if (mod && ly_strequal(mod->name, "ietf-netconf", 0)) {
-        if (lyp_add_ietf_netconf_annotations_config(mod)) {
-            lys_free(mod, NULL, 1, 1);
-            return NULL;
+    rec.id = id;
+    pthread_rwlock_rdlock(&ctx->node_id_lock);
+    if (ctx->node_id_ht && (ctx->node_id_set_id == ctx->models.module_set_id) && (ctx->node_id_gen == ctx->schema_gen)) {
+        r = lyht_find(ctx->node_id_ht, &rec, lys_node_id_ht_hash(id), (void **)&found);
+        if (!r) {
+            *ret = *found;
         }
+        pthread_rwlock_unlock(&ctx->node_id_lock);
+        return r ? 1 : 0;
     }
+    pthread_rwlock_unlock(&ctx->node_id_lock);
 
-    return mod;
-}
+    pthread_rwlock_wrlock(&ctx->node_id_lock);
+    if (!lys_node_id_table(ctx)) {
+        r = -1;
+    } else {
+        r = lyht_find(ctx->node_id_ht, &rec, lys_node_id_ht_hash(id), (void **)&found);
+        if (!r) {
+            *ret = *found;
+        }
+    }
+    pthread_rwlock_unlock(&ctx->node_id_lock);
 
-API const struct lys_module *
-lys_parse_mem(struct ly_ctx *ctx, const char *data, LYS_INFORMAT format)
-{
-    return lys_parse_mem_(ctx, data, format, NULL, 0, 1);
+    return (r == -1) ? -1 : (r ? 1 : 0);
 }
 
-struct lys_submodule *
-lys_sub_parse_mem(struct lys_module *module, const char *data, LYS_INFORMAT format, struct unres_schema *unres)
+API uint64_t
+lys_node_id(const struct lys_node *node)
 {
-    char *enlarged_data = NULL;
-    struct lys_submodule *submod = NULL;
-    unsigned int len;
-
-    assert(module);
-    assert(data);
+    struct ly_ctx *ctx;
+    struct lys_node_id_rec rec;
+    uint64_t id;
 
-    if (format == LYS_IN_YANG) {
-        /* enlarge data by 2 bytes for flex */
-        len = strlen(data);
-        enlarged_data = malloc((len + 2) * sizeof *enlarged_data);
-        LY_CHECK_ERR_RETURN(!enlarged_data, LOGMEM(module->ctx), NULL);
-        memcpy(enlarged_data, data, len);
-        enlarged_data[len] = enlarged_data[len + 1] = '\0';
-        data = enlarged_data;
+    if (!node || (node->nodetype & (LYS_AUGMENT | LYS_EXT))) {
+        LOGARG;
+        return 0;
     }
+    ctx = node->module->ctx;
 
-    /* get the main module */
-    module = lys_main_module(module);
-
-    switch (format) {
-    case LYS_IN_YIN:
-        submod = yin_read_submodule(module, data, unres);
-        break;
-    case LYS_IN_YANG:
-        submod = yang_read_submodule(module, data, 0, unres);
-        break;
+    id = lys_node_id_fix(lys_node_id_compute(node));
+    switch (lys_node_id_get(ctx, id, &rec)) {
+    case -1:
+        return 0;
+    case 1:
+        LOGERR(ctx, LY_EINVAL, "Schema node \"%s\" is not in the schema trees of its context.", node->name);
+        return 0;
     default:
-        assert(0);
         break;
     }
+    if (rec.node != node) {
+        LOGERR(ctx, LY_EINVAL, "Schema node \"%s\" has no unique ID.", node->name);
+        return 0;
+    }
 
-    free(enlarged_data);
-    return submod;
+    return id;
 }
 
-API const struct lys_module *
-lys_parse_path(struct ly_ctx *ctx, const char *path, LYS_INFORMAT format)
+const struct lys_node *
+lys_node_id_find(struct ly_ctx *ctx, uint64_t id)
 {
-    int fd;
-    const struct lys_module *ret;
-    const char *rev, *dot, *filename;
-    size_t len;
+    struct lys_node_id_rec rec;
 
-    if (!ctx || !path) {
-        LOGARG;
+    switch (lys_node_id_get(ctx, id, &rec)) {
+    case -1:
         return NULL;
-    }
-
-    fd = open(path, O_RDONLY);
-    if (fd == -1) {
-        LOGERR(ctx, LY_ESYS, "Opening file \"%s\" failed (%s).", path, strerror(errno));
+    case 1:
+        LOGERR(ctx, LY_EINVAL, "No schema node with the ID %" PRIu64 ".", id);
         return NULL;
+    default:
+        break;
+    }
+    if (!rec.node) {
+        LOGERR(ctx, LY_EINVAL, "More schema nodes with the ID %" PRIu64 ".", id);
     }
 
-    ret = lys_parse_fd(ctx, fd, format);
-    close(fd);
+    return rec.node;
+}
 
-    if (!ret) {
-        /* error */
-        return NULL;
-    }
+void
+lys_node_id_clear(struct ly_ctx *ctx)
+{
+    pthread_rwlock_wrlock(&ctx->node_id_lock);
+    lyht_free(ctx->node_id_ht);
+    ctx->node_id_ht = NULL;
+    pthread_rwlock_unlock(&ctx->node_id_lock);
+}
 
-    /* check that name and revision match filename */
-    filename = strrchr(path, '/');
-    if (!filename) {
-        filename = path;
-    } else {
-        filename++;
+#ifdef LY_ENABLED_CACHE
+
+/* enum, bit or derived identity in the context hash table, a record with no name marks stored definitions */
+struct lys_value_rec {
+    const void *defs;                   /* array of enums or bits, or the base identity */
+    const char *name;
+    int nam_len;
+    const struct lys_module *mod;       /* main module of a derived identity */
+    const void *item;
+};
+
+static int
+lys_value_hash_val_equal(void *val1_p, void *val2_p, int UNUSED(mod), void *UNUSED(cb_data))
+{
+    struct lys_value_rec *rec1 = (struct lys_value_rec *)val1_p, *rec2 = (struct lys_value_rec *)val2_p;
+
+    if ((rec1->defs != rec2->defs) || (rec1->mod != rec2->mod) || (rec1->nam_len != rec2->nam_len)) {
+        return 0;
     }
-    rev = strchr(filename, '@');
-    dot = strrchr(filename, '.');
+    if (!rec1->name || !rec2->name) {
+        return (rec1->name == rec2->name);
+    }
+    return !strncmp(rec1->name, rec2->name, rec1->nam_len);
+}
 
-    /* name */
-    len = strlen(ret->name);
-    if (strncmp(filename, ret->name, len) ||
-            ((rev && rev != &filename[len]) || (!rev && dot != &filename[len]))) {
-        LOGWRN(ctx, "File name \"%s\" does not match module name \"%s\".", filename, ret->name);
+static uint32_t
+lys_value_hash_rec(const struct lys_value_rec *rec)
+{
+    uint32_t hash;
+
+    hash = dict_hash_multi(0, (const char *)&rec->defs, sizeof rec->defs);
+    if (rec->name) {
+        hash = dict_hash_multi(hash, rec->name, rec->nam_len);
+        hash = dict_hash_multi(hash, (const char *)&rec->mod, sizeof rec->mod);
     }
-    if (rev) {
-        len = dot - ++rev;
-        if (!ret->rev_size || len != 10 || strncmp(ret->rev[0].date, rev, len)) {
-            LOGWRN(ctx, "File name \"%s\" does not match module revision \"%s\".", filename,
-                   ret->rev_size ? ret->rev[0].date : "none");
+    return dict_hash_multi(hash, NULL, 0);
+}
+
+/* store all the definitions, in their order to find the first one the same way as the direct search */
+static int
+lys_value_hash_fill(struct hash_table *ht, LY_DATA_TYPE base, const void *defs, unsigned int count)
+{
+    struct lys_value_rec rec;
+    struct lys_ident *der;
+    unsigned int u;
+
+    rec.defs = defs;
+    rec.mod = NULL;
+    for (u = 0; u < count; ++u) {
+        switch (base) {
+        case LY_TYPE_ENUM:
+            rec.name = ((struct lys_type_enum *)defs)[u].name;
+            rec.item = &((struct lys_type_enum *)defs)[u];
+            break;
+        case LY_TYPE_BITS:
+            rec.name = ((struct lys_type_bit *)defs)[u].name;
+            rec.item = &((struct lys_type_bit *)defs)[u];
+            break;
+        default:
+            der = (struct lys_ident *)((struct lys_ident *)defs)->der->set.g[u];
+            rec.name = der->name;
+            rec.mod = lys_main_module(der->module);
+            rec.item = der;
+            break;
+        }
+        rec.nam_len = strlen(rec.name);
+        if (lyht_insert(ht, &rec, lys_value_hash_rec(&rec), NULL) == -1) {
+            return -1;
         }
     }
 
-    if (!ret->filepath) {
-        /* store URI */
-        char rpath[PATH_MAX];
-        if (realpath(path, rpath) != NULL) {
-            ((struct lys_module *)ret)->filepath = lydict_insert(ctx, rpath, 0);
+    return 0;
+}
+
+/**
+ * @brief Find an enum, a bit or a derived identity by its name using the context hash table. The definitions
+ * are stored on the first search in them.
+ *
+ * @param[in] ctx Context with the definitions.
+ * @param[in] base Type of the definitions, #LY_TYPE_ENUM, #LY_TYPE_BITS or #LY_TYPE_IDENT.
+ * @param[in] defs Array of enums or bits, or the base identity.
+ * @param[in] count Count of the enums, bits or derived identities.
+ * @param[in] name Name to find.
+ * @param[in] nam_len Length of \p name.
+ * @param[in] mod Main module of the derived identity, NULL otherwise.
+ * @param[out] ret Found definition, NULL if there is none.
+ * @return 0 on success, 1 if the hash table cannot be used and the definitions must be searched directly.
+ */
+static int
+lys_find_value_hash(struct ly_ctx *ctx, LY_DATA_TYPE base, const void *defs, unsigned int count, const char *name,
+                    int nam_len, const struct lys_module *mod, const void **ret)
+{
+    struct lys_value_rec rec, marker, *match;
+    int found = 0, filled, r = 1;
+
+    if ((count < LY_CACHE_HT_MIN_CHILDREN) || ctx->models.parsing_sub_modules_count) {
+        /* not worth it, or the definitions of a module being parsed, which may still be freed */
+        return 1;
+    }
+
+    rec.defs = defs;
+    rec.name = name;
+    rec.nam_len = nam_len;
+    rec.mod = mod;
+    memset(&marker, 0, sizeof marker);
+    marker.defs = defs;
+
+    pthread_rwlock_rdlock(&ctx->value_hash_lock);
+    if (ctx->value_hash && (ctx->value_hash_set_id == ctx->models.module_set_id)) {
+        if (!lyht_find(ctx->value_hash, &rec, lys_value_hash_rec(&rec), (void **)&match)) {
+            found = 1;
+            *ret = match->item;
+        } else if (!lyht_find(ctx->value_hash, &marker, lys_value_hash_rec(&marker), NULL)) {
+            /* the definitions are stored, there is no such name */
+            found = 1;
+            *ret = NULL;
+        }
+    }
+    pthread_rwlock_unlock(&ctx->value_hash_lock);
+    if (found) {
+        return 0;
+    }
+
+    pthread_rwlock_wrlock(&ctx->value_hash_lock);
+    if (ctx->value_hash && (ctx->value_hash_set_id != ctx->models.module_set_id)) {
+        /* the definitions may not exist anymore and derived identities may have been added */
+        lyht_free(ctx->value_hash);
+        ctx->value_hash = NULL;
+    }
+    if (!ctx->value_hash) {
+        ctx->value_hash = lyht_new(1024, sizeof(struct lys_value_rec), lys_value_hash_val_equal, NULL, 1);
+        if (!ctx->value_hash) {
+            goto unlock;
+        }
+        ctx->value_hash_set_id = ctx->models.module_set_id;
+    }
+
+    if (!lyht_find(ctx->value_hash, &marker, lys_value_hash_rec(&marker), NULL)) {
+        /* filled by another thread meanwhile */
+        filled = 1;
+    } else {
+        filled = !lys_value_hash_fill(ctx->value_hash, base, defs, count);
+        if (filled && (lyht_insert(ctx->value_hash, &marker, lys_value_hash_rec(&marker), NULL) == -1)) {
+            filled = 0;
+        }
+    }
+    if (filled) {
+        if (!lyht_find(ctx->value_hash, &rec, lys_value_hash_rec(&rec), (void **)&match)) {
+            *ret = match->item;
         } else {
-            ((struct lys_module *)ret)->filepath = lydict_insert(ctx, path, 0);
+            *ret = NULL;
         }
+        r = 0;
+    } else {
+        /* some definitions may be missing, do not use the table anymore */
+        lyht_free(ctx->value_hash);
+        ctx->value_hash = NULL;
     }
 
-    return ret;
+unlock:
+    pthread_rwlock_unlock(&ctx->value_hash_lock);
+    return r;
 }
 
-API const struct lys_module *
-lys_parse_fd(struct ly_ctx *ctx, int fd, LYS_INFORMAT format)
+#endif
+
+int
+lys_find_enum_hash(struct ly_ctx *ctx, const struct lys_type *type, const char *name, struct lys_type_enum **enm)
 {
-    return lys_parse_fd_(ctx, fd, format, NULL, 1);
+#ifdef LY_ENABLED_CACHE
+    return lys_find_value_hash(ctx, LY_TYPE_ENUM, type->info.enums.enm, type->info.enums.count, name, strlen(name),
+                               NULL, (const void **)enm);
+#else
+    (void)ctx;
+    (void)type;
+    (void)name;
+    (void)enm;
+    return 1;
+#endif
 }
 
-static void
-lys_parse_set_filename(struct ly_ctx *ctx, const char **filename, int fd)
+int
+lys_find_bit_hash(struct ly_ctx *ctx, const struct lys_type *type, const char *name, int nam_len,
+                  struct lys_type_bit **bit)
 {
-#ifdef __APPLE__
-    char path[MAXPATHLEN];
+#ifdef LY_ENABLED_CACHE
+    return lys_find_value_hash(ctx, LY_TYPE_BITS, type->info.bits.bit, type->info.bits.count, name, nam_len,
+                               NULL, (const void **)bit);
 #else
-    int len;
-    char path[PATH_MAX], proc_path[32];
+    (void)ctx;
+    (void)type;
+    (void)name;
+    (void)nam_len;
+    (void)bit;
+    return 1;
 #endif
+}
 
-#ifdef __APPLE__
-    if (fcntl(fd, F_GETPATH, path) != -1) {
-        *filename = lydict_insert(ctx, path, 0);
-    }
+int
+lys_find_ident_hash(struct ly_ctx *ctx, const struct lys_ident *base, const char *name, int nam_len,
+                    const struct lys_module *mod, struct lys_ident **der)
+{
+#ifdef LY_ENABLED_CACHE
+    return lys_find_value_hash(ctx, LY_TYPE_IDENT, base, base->der ? base->der->number : 0, name, nam_len, mod,
+                               (const void **)der);
 #else
-    /* get URI if there is /proc */
-    sprintf(proc_path, "/proc/self/fd/%d", fd);
-    if ((len = readlink(proc_path, path, PATH_MAX - 1)) > 0) {
-        *filename = lydict_insert(ctx, path, len);
-    }
+    (void)ctx;
+    (void)base;
+    (void)name;
+    (void)nam_len;
+    (void)mod;
+    (void)der;
+    return 1;
 #endif
 }
 
-const struct lys_module *
-lys_parse_fd_(struct ly_ctx *ctx, int fd, LYS_INFORMAT format, const char *revision, int implement)
+void
+lys_value_hash_clear(struct ly_ctx *ctx)
 {
-    const struct lys_module *module;
-    size_t length;
-    char *addr;
+#ifdef LY_ENABLED_CACHE
+    pthread_rwlock_wrlock(&ctx->value_hash_lock);
+    lyht_free(ctx->value_hash);
+    ctx->value_hash = NULL;
+    pthread_rwlock_unlock(&ctx->value_hash_lock);
+#else
+    (void)ctx;
+#endif
+}
 
-    if (!ctx || fd < 0) {
-        LOGARG;
-        return NULL;
-    }
+#ifdef LY_ENABLED_CACHE
 
-    if (lyp_mmap(ctx, fd, format == LYS_IN_YANG ? 1 : 0, &length, (void **)&addr)) {
-        LOGERR(ctx, LY_ESYS, "Mapping file descriptor into memory failed (%s()).", __func__);
-        return NULL;
-    } else if (!addr) {
-        LOGERR(ctx, LY_EINVAL, "Empty schema file.");
-        return NULL;
-    }
+/* identity by its module and name, or a pair of a derived identity and one of its direct or indirect bases */
+struct lys_ident_rec {
+    const struct lys_ident *der;        /* derived identity, NULL for a name record */
+    const struct lys_ident *ident;      /* base identity, or the identity of a name record */
+    const struct lys_module *mod;       /* main module of the identity of a name record */
+    const char *name;
+    int nam_len;
+};
 
-    module = lys_parse_mem_(ctx, addr, format, revision, 1, implement);
-    lyp_munmap(addr, length);
+static int
+lys_ident_hash_val_equal(void *val1_p, void *val2_p, int UNUSED(mod), void *UNUSED(cb_data))
+{
+    struct lys_ident_rec *rec1 = (struct lys_ident_rec *)val1_p, *rec2 = (struct lys_ident_rec *)val2_p;
 
-    if (module && !module->filepath) {
-        lys_parse_set_filename(ctx, (const char **)&module->filepath, fd);
+    if (rec1->der != rec2->der) {
+        return 0;
     }
-
-    return module;
+    if (rec1->der) {
+        return (rec1->ident == rec2->ident);
+    }
+    return (rec1->mod == rec2->mod) && (rec1->nam_len == rec2->nam_len) && !strncmp(rec1->name, rec2->name, rec1->nam_len);
 }
 
-struct lys_submodule *
-lys_sub_parse_fd(struct lys_module *module, int fd, LYS_INFORMAT format, struct unres_schema *unres)
+static uint32_t
+lys_ident_hash_rec(const struct lys_ident_rec *rec)
 {
-    struct lys_submodule *submodule;
-    size_t length;
-    char *addr;
+    uint32_t hash;
 
-    assert(module);
-    assert(fd >= 0);
-
-    if (lyp_mmap(module->ctx, fd, format == LYS_IN_YANG ? 1 : 0, &length, (void **)&addr)) {
-        LOGERR(module->ctx, LY_ESYS, "Mapping file descriptor into memory failed (%s()).", __func__);
-        return NULL;
-    } else if (!addr) {
-        LOGERR(module->ctx, LY_EINVAL, "Empty submodule schema file.");
-        return NULL;
+    if (rec->der) {
+        hash = dict_hash_multi(0, (const char *)&rec->der, sizeof rec->der);
+        hash = dict_hash_multi(hash, (const char *)&rec->ident, sizeof rec->ident);
+    } else {
+        hash = dict_hash_multi(0, (const char *)&rec->mod, sizeof rec->mod);
+        hash = dict_hash_multi(hash, rec->name, rec->nam_len);
     }
+    return dict_hash_multi(hash, NULL, 0);
+}
 
-    /* get the main module */
-    module = lys_main_module(module);
-
-    switch (format) {
-    case LYS_IN_YIN:
-        submodule = yin_read_submodule(module, addr, unres);
-        break;
-    case LYS_IN_YANG:
-        submodule = yang_read_submodule(module, addr, 0, unres);
-        break;
-    default:
-        LOGINT(module->ctx);
-        return NULL;
+/* store der with all the bases of ident, the backlinks to derived identities exist only for implemented modules */
+static int
+lys_ident_hash_fill_bases(struct hash_table *ht, const struct lys_ident *der, const struct lys_ident *ident)
+{
+    struct lys_ident_rec rec;
+    uint8_t i;
+    int r;
+
+    memset(&rec, 0, sizeof rec);
+    rec.der = der;
+    for (i = 0; i < ident->base_size; ++i) {
+        rec.ident = ident->base[i];
+        r = lyht_insert(ht, &rec, lys_ident_hash_rec(&rec), NULL);
+        if (r == -1) {
+            return -1;
+        } else if (!r && lys_ident_hash_fill_bases(ht, der, ident->base[i])) {
+            /* bases of an already stored base are stored, too */
+            return -1;
+        }
     }
 
-    lyp_munmap(addr, length);
+    return 0;
+}
 
-    if (submodule && !submodule->filepath) {
-        lys_parse_set_filename(module->ctx, (const char **)&submodule->filepath, fd);
+static int
+lys_ident_hash_fill_idents(struct hash_table *ht, const struct lys_module *mainmod, struct lys_ident *idents,
+                           uint32_t count)
+{
+    struct lys_ident_rec rec;
+    uint32_t u;
+
+    for (u = 0; u < count; ++u) {
+        memset(&rec, 0, sizeof rec);
+        rec.ident = &idents[u];
+        rec.mod = mainmod;
+        rec.name = idents[u].name;
+        rec.nam_len = strlen(rec.name);
+        if ((lyht_insert(ht, &rec, lys_ident_hash_rec(&rec), NULL) == -1)
+                || lys_ident_hash_fill_bases(ht, &idents[u], &idents[u])) {
+            return -1;
+        }
     }
 
-    return submodule;
-
+    return 0;
 }
 
-API int
-lys_search_localfile(const char * const *searchpaths, int cwd, const char *name, const char *revision, char **localfile, LYS_INFORMAT *format)
+/* store all the identities of all the modules in the context */
+static int
+lys_ident_hash_fill(struct ly_ctx *ctx, struct hash_table *ht)
 {
-    size_t len, flen, match_len = 0, dir_len;
-    int i, implicit_cwd = 0, ret = EXIT_FAILURE;
-    char *wd, *wn = NULL;
-    DIR *dir = NULL;
-    struct dirent *file;
-    char *match_name = NULL;
-    LYS_INFORMAT format_aux, match_format = 0;
-    unsigned int u;
-    struct ly_set *dirs;
-    struct stat st;
+    struct lys_module *mod;
+    int i;
+    uint8_t j;
 
-    if (!localfile) {
-        LOGARG;
-        return EXIT_FAILURE;
+    for (i = 0; i < ctx->models.used; ++i) {
+        mod = ctx->models.list[i];
+        if (lys_ident_hash_fill_idents(ht, mod, mod->ident, mod->ident_size)) {
+            return -1;
+        }
+        for (j = 0; j < mod->inc_size; ++j) {
+            if (mod->inc[j].submodule && lys_ident_hash_fill_idents(ht, mod, mod->inc[j].submodule->ident,
+                                                                    mod->inc[j].submodule->ident_size)) {
+                return -1;
+            }
+        }
     }
 
-    /* start to fill the dir fifo with the context's search path (if set)
-     * and the current working directory */
-    dirs = ly_set_new();
-    if (!dirs) {
-        LOGMEM(NULL);
-        return EXIT_FAILURE;
+    return 0;
+}
+
+/**
+ * @brief Find an identity record in the context hash table, which is filled with all the identities
+ * and their derivations on the first search.
+ *
+ * @param[in] ctx Context with the identities.
+ * @param[in] rec Record to find.
+ * @param[out] ret Found identity, NULL if there is no such record.
+ * @return 0 on success, 1 if the hash table cannot be used and the identities must be searched directly.
+ */
+static int
+lys_find_ident_rec_hash(struct ly_ctx *ctx, struct lys_ident_rec *rec, struct lys_ident **ret)
+{
+    struct lys_ident_rec *match;
+    int found = 0, r = 1;
+
+    if (ctx->models.parsing_sub_modules_count) {
+        /* identities of a module being parsed, which may still be freed */
+        return 1;
     }
 
-    len = strlen(name);
-    if (cwd) {
-        wd = get_current_dir_name();
-        if (!wd) {
-            LOGMEM(NULL);
-            goto cleanup;
+    pthread_rwlock_rdlock(&ctx->ident_hash_lock);
+    if (ctx->ident_hash && (ctx->ident_hash_set_id == ctx->models.module_set_id)) {
+        found = 1;
+        if (!lyht_find(ctx->ident_hash, rec, lys_ident_hash_rec(rec), (void **)&match)) {
+            *ret = (struct lys_ident *)match->ident;
         } else {
-            /* add implicit current working directory (./) to be searched,
-             * this directory is not searched recursively */
-            if (ly_set_add(dirs, wd, 0) == -1) {
-                goto cleanup;
-            }
-            implicit_cwd = 1;
+            *ret = NULL;
         }
     }
-    if (searchpaths) {
-        for (i = 0; searchpaths[i]; i++) {
-            /* check for duplicities with the implicit current working directory */
-            if (implicit_cwd && !strcmp(dirs->set.g[0], searchpaths[i])) {
-                implicit_cwd = 0;
-                continue;
-            }
-            wd = strdup(searchpaths[i]);
-            if (!wd) {
-                LOGMEM(NULL);
-                goto cleanup;
-            } else if (ly_set_add(dirs, wd, 0) == -1) {
-                goto cleanup;
-            }
+    pthread_rwlock_unlock(&ctx->ident_hash_lock);
+    if (found) {
+        return 0;
+    }
+
+    pthread_rwlock_wrlock(&ctx->ident_hash_lock);
+    if (!ctx->ident_hash || (ctx->ident_hash_set_id != ctx->models.module_set_id)) {
+        /* the identities may not exist anymore and new derivations may have been added */
+        lyht_free(ctx->ident_hash);
+        ctx->ident_hash = lyht_new(1024, sizeof(struct lys_ident_rec), lys_ident_hash_val_equal, NULL, 1);
+        if (!ctx->ident_hash) {
+            goto unlock;
+        }
+        if (lys_ident_hash_fill(ctx, ctx->ident_hash)) {
+            /* some identities may be missing, do not use the table */
+            lyht_free(ctx->ident_hash);
+            ctx->ident_hash = NULL;
+            goto unlock;
         }
+        ctx->ident_hash_set_id = ctx->models.module_set_id;
     }
-    wd = NULL;
 
-    /* start searching */
-    while (dirs->number) {
-        free(wd);
-        free(wn); wn = NULL;
+    if (!lyht_find(ctx->ident_hash, rec, lys_ident_hash_rec(rec), (void **)&match)) {
+        *ret = (struct lys_ident *)match->ident;
+    } else {
+        *ret = NULL;
+    }
+    r = 0;
 
-        dirs->number--;
-        wd = (char *)dirs->set.g[dirs->number];
-        dirs->set.g[dirs->number] = NULL;
-        LOGVRB("Searching for \"%s\" in %s.", name, wd);
+unlock:
+    pthread_rwlock_unlock(&ctx->ident_hash_lock);
+    return r;
+}
 
-        if (dir) {
-            closedir(dir);
-        }
-        dir = opendir(wd);
-        dir_len = strlen(wd);
-        if (!dir) {
-            LOGWRN(NULL, "Unable to open directory \"%s\" for searching (sub)modules (%s).", wd, strerror(errno));
-        } else {
-            while ((file = readdir(dir))) {
-                if (!strcmp(".", file->d_name) || !strcmp("..", file->d_name)) {
-                    /* skip . and .. */
-                    continue;
-                }
-                free(wn);
-                if (asprintf(&wn, "%s/%s", wd, file->d_name) == -1) {
-                    LOGMEM(NULL);
-                    goto cleanup;
-                }
-                if (stat(wn, &st) == -1) {
-                    LOGWRN(NULL, "Unable to get information about \"%s\" file in \"%s\" when searching for (sub)modules (%s)",
-                           file->d_name, wd, strerror(errno));
-                    continue;
-                }
-                if (S_ISDIR(st.st_mode) && (dirs->number || !implicit_cwd)) {
-                    /* we have another subdirectory in searchpath to explore,
-                     * subdirectories are not taken into account in current working dir (dirs->set.g[0]) */
-                    if (ly_set_add(dirs, wn, 0) == -1) {
-                        goto cleanup;
-                    }
-                    /* continue with the next item in current directory */
-                    wn = NULL;
-                    continue;
-                } else if (!S_ISREG(st.st_mode)) {
-                    /* not a regular file (note that we see the target of symlinks instead of symlinks */
-                    continue;
-                }
+#endif
 
-                /* here we know that the item is a file which can contain a module */
-                if (strncmp(name, file->d_name, len) ||
-                        (file->d_name[len] != '.' && file->d_name[len] != '@')) {
-                    /* different filename than the module we search for */
-                    continue;
-                }
+int
+lys_find_ident_name_hash(struct ly_ctx *ctx, const struct lys_module *mod, const char *name, int nam_len,
+                         struct lys_ident **ident)
+{
+#ifdef LY_ENABLED_CACHE
+    struct lys_ident_rec rec;
 
-                /* get type according to filename suffix */
-                flen = strlen(file->d_name);
-                if (!strcmp(&file->d_name[flen - 4], ".yin")) {
-                    format_aux = LYS_IN_YIN;
-                } else if (!strcmp(&file->d_name[flen - 5], ".yang")) {
-                    format_aux = LYS_IN_YANG;
-                } else {
-                    /* not supportde suffix/file format */
-                    continue;
-                }
+    memset(&rec, 0, sizeof rec);
+    rec.mod = lys_main_module(mod);
+    rec.name = name;
+    rec.nam_len = nam_len;
+    return lys_find_ident_rec_hash(ctx, &rec, ident);
+#else
+    (void)ctx;
+    (void)mod;
+    (void)name;
+    (void)nam_len;
+    (void)ident;
+    return 1;
+#endif
+}
 
-                if (revision) {
-                    /* we look for the specific revision, try to get it from the filename */
-                    if (file->d_name[len] == '@') {
-                        /* check revision from the filename */
-                        if (strncmp(revision, &file->d_name[len + 1], strlen(revision))) {
-                            /* another revision */
-                            continue;
-                        } else {
-                            /* exact revision */
-                            free(match_name);
-                            match_name = wn;
-                            wn = NULL;
-                            match_len = dir_len + 1 + len;
-                            match_format = format_aux;
-                            goto success;
-                        }
-                    } else {
-                        /* continue trying to find exact revision match, use this only if not found */
-                        free(match_name);
-                        match_name = wn;
-                        wn = NULL;
-                        match_len = dir_len + 1 +len;
-                        match_format = format_aux;
-                        continue;
-                    }
-                } else {
-                    /* remember the revision and try to find the newest one */
-                    if (match_name) {
-                        if (file->d_name[len] != '@' || lyp_check_date(NULL, &file->d_name[len + 1])) {
-                            continue;
-                        } else if (match_name[match_len] == '@' &&
-                                (strncmp(&match_name[match_len + 1], &file->d_name[len + 1], LY_REV_SIZE - 1) >= 0)) {
-                            continue;
-                        }
-                        free(match_name);
-                    }
+int
+lys_ident_derived_hash(struct ly_ctx *ctx, const struct lys_ident *der, const struct lys_ident *base, int *derived)
+{
+#ifdef LY_ENABLED_CACHE
+    struct lys_ident_rec rec;
+    struct lys_ident *match;
 
-                    match_name = wn;
-                    wn = NULL;
-                    match_len = dir_len + 1 + len;
-                    match_format = format_aux;
-                    continue;
-                }
-            }
-        }
+    memset(&rec, 0, sizeof rec);
+    rec.der = der;
+    rec.ident = base;
+    if (lys_find_ident_rec_hash(ctx, &rec, &match)) {
+        return 1;
     }
+    *derived = match ? 1 : 0;
+    return 0;
+#else
+    (void)ctx;
+    (void)der;
+    (void)base;
+    (void)derived;
+    return 1;
+#endif
+}
 
-success:
-    (*localfile) = match_name;
-    match_name = NULL;
-    if (format) {
-        (*format) = match_format;
-    }
-    ret = EXIT_SUCCESS;
+void
+lys_ident_hash_clear(struct ly_ctx *ctx)
+{
+#ifdef LY_ENABLED_CACHE
+    pthread_rwlock_wrlock(&ctx->ident_hash_lock);
+    lyht_free(ctx->ident_hash);
+    ctx->ident_hash = NULL;
+    pthread_rwlock_unlock(&ctx->ident_hash_lock);
+#else
+    (void)ctx;
+#endif
+}
 
-cleanup:
-    free(wn);
-    free(wd);
-    if (dir) {
-        closedir(dir);
-    }
-    free(match_name);
-    for (u = 0; u < dirs->number; u++) {
-        free(dirs->set.g[u]);
-    }
-    ly_set_free(dirs);
+#ifdef LY_ENABLED_CACHE
 
-    return ret;
-}
+/* annotation definition in the context hash table, a record with no name marks stored modules */
+struct lys_annot_rec {
+    const struct lys_module *mod;       /* main module */
+    const char *name;
+    struct lys_ext_instance_complex *annot;
+};
 
-int
-lys_ext_iter(struct lys_ext_instance **ext, uint8_t ext_size, uint8_t start, LYEXT_SUBSTMT substmt)
+static int
+lys_annot_hash_val_equal(void *val1_p, void *val2_p, int UNUSED(mod), void *UNUSED(cb_data))
 {
-    unsigned int u;
+    struct lys_annot_rec *rec1 = (struct lys_annot_rec *)val1_p, *rec2 = (struct lys_annot_rec *)val2_p;
 
-    for (u = start; u < ext_size; u++) {
-        if (ext[u]->insubstmt == substmt) {
-            return u;
-        }
+    if (rec1->mod != rec2->mod) {
+        return 0;
     }
-
-    return -1;
+    if (!rec1->name || !rec2->name) {
+        return (rec1->name == rec2->name);
+    }
+    return !strcmp(rec1->name, rec2->name);
 }
 
-/*
- * duplicate extension instance
- */
-int
-lys_ext_dup(struct ly_ctx *ctx, struct lys_module *mod, struct lys_ext_instance **orig, uint8_t size, void *parent,
-            LYEXT_PAR parent_type, struct lys_ext_instance ***new, int shallow, struct unres_schema *unres)
+static uint32_t
+lys_annot_hash_rec(const struct lys_annot_rec *rec)
 {
-    int i;
-    uint8_t u = 0;
-    struct lys_ext_instance **result;
-    struct unres_ext *info, *info_orig;
-    size_t len;
-
-    assert(new);
+    uint32_t hash;
 
-    if (!size) {
-        if (orig) {
-            LOGINT(ctx);
-            return EXIT_FAILURE;
-        }
-        (*new) = NULL;
-        return EXIT_SUCCESS;
+    hash = dict_hash_multi(0, (const char *)&rec->mod, sizeof rec->mod);
+    if (rec->name) {
+        hash = dict_hash_multi(hash, rec->name, strlen(rec->name));
     }
+    return dict_hash_multi(hash, NULL, 0);
+}
 
-    (*new) = result = calloc(size, sizeof *result);
-    LY_CHECK_ERR_RETURN(!result, LOGMEM(ctx), EXIT_FAILURE);
-    for (u = 0; u < size; u++) {
-        if (orig[u]) {
-            /* resolved extension instance, just duplicate it */
-            switch(orig[u]->ext_type) {
-            case LYEXT_FLAG:
-                result[u] = malloc(sizeof(struct lys_ext_instance));
-                LY_CHECK_ERR_GOTO(!result[u], LOGMEM(ctx), error);
-                break;
-            case LYEXT_COMPLEX:
-                len = ((struct lyext_plugin_complex*)orig[u]->def->plugin)->instance_size;
-                result[u] = calloc(1, len);
-                LY_CHECK_ERR_GOTO(!result[u], LOGMEM(ctx), error);
-
-                ((struct lys_ext_instance_complex*)result[u])->substmt = ((struct lyext_plugin_complex*)orig[u]->def->plugin)->substmt;
-                /* TODO duplicate data in extension instance content */
-                memcpy((void*)result[u] + sizeof(**orig), (void*)orig[u] + sizeof(**orig), len - sizeof(**orig));
-                break;
-            }
-            /* generic part */
-            result[u]->def = orig[u]->def;
-            result[u]->flags = LYEXT_OPT_CONTENT;
-            result[u]->arg_value = lydict_insert(ctx, orig[u]->arg_value, 0);
-            result[u]->parent = parent;
-            result[u]->parent_type = parent_type;
-            result[u]->insubstmt = orig[u]->insubstmt;
-            result[u]->insubstmt_index = orig[u]->insubstmt_index;
-            result[u]->ext_type = orig[u]->ext_type;
-            result[u]->priv = NULL;
-            result[u]->nodetype = LYS_EXT;
-            result[u]->module = mod;
+#endif
 
-            /* extensions */
-            result[u]->ext_size = orig[u]->ext_size;
-            if (lys_ext_dup(ctx, mod, orig[u]->ext, orig[u]->ext_size, result[u],
-                            LYEXT_PAR_EXTINST, &result[u]->ext, shallow, unres)) {
-                goto error;
-            }
+/* annotation instances in an extension instance list, find the first one with the name or store all of them */
+static struct lys_ext_instance_complex *
+lys_annot_search(struct lys_ext *annot_def, struct lys_ext_instance **ext, uint8_t ext_size, const char *name,
+                 struct hash_table *ht, const struct lys_module *mod)
+{
+#ifdef LY_ENABLED_CACHE
+    struct lys_annot_rec rec;
+#endif
+    int i, j;
 
-            /* in case of shallow copy (duplication for deviation), duplicate only the link to private data
-             * in a new copy, otherwise (grouping instantiation) do not duplicate the private data */
-            if (shallow) {
-                result[u]->priv = orig[u]->priv;
-            }
-        } else {
-            /* original extension is not yet resolved, so duplicate it in unres */
-            i = unres_schema_find(unres, -1, &orig, UNRES_EXT);
-            if (i == -1) {
-                /* extension not found in unres */
-                LOGINT(ctx);
-                goto error;
-            }
-            info_orig = unres->str_snode[i];
-            info = malloc(sizeof *info);
-            LY_CHECK_ERR_GOTO(!info, LOGMEM(ctx), error);
-            info->datatype = info_orig->datatype;
-            if (info->datatype == LYS_IN_YIN) {
-                info->data.yin = lyxml_dup_elem(ctx, info_orig->data.yin, NULL, 1);
-            } /* else TODO YANG */
-            info->parent = parent;
-            info->mod = mod;
-            info->parent_type = parent_type;
-            info->ext_index = u;
-            if (unres_schema_add_node(info->mod, unres, new, UNRES_EXT, (struct lys_node *)info) == -1) {
-                goto error;
+    for (i = 0, j = 0; i < ext_size; i = i + j + 1) {
+        j = lys_ext_instance_presence(annot_def, &ext[i], ext_size - i);
+        if (j == -1) {
+            break;
+        }
+        if (name) {
+            if (!strcmp(ext[i + j]->arg_value, name)) {
+                return (struct lys_ext_instance_complex *)ext[i + j];
             }
+            continue;
+        }
+#ifdef LY_ENABLED_CACHE
+        /* the first definition of a name is kept */
+        rec.mod = mod;
+        rec.name = ext[i + j]->arg_value;
+        rec.annot = (struct lys_ext_instance_complex *)ext[i + j];
+        if (lyht_insert(ht, &rec, lys_annot_hash_rec(&rec), NULL) == -1) {
+            return (struct lys_ext_instance_complex *)ext[i + j];
         }
+#else
+        (void)ht;
+        (void)mod;
+#endif
     }
 
-    return EXIT_SUCCESS;
+    return NULL;
+}
 
-error:
-    (*new) = NULL;
-    lys_extension_instances_free(ctx, result, u, NULL);
-    return EXIT_FAILURE;
+/**
+ * @brief Find an annotation definition in a module and its submodules, or store all of them in a hash table.
+ *
+ * @param[in] mod Main module with the definitions.
+ * @param[in] name Name of the annotation, NULL to store all the definitions in \p ht.
+ * @param[in] ht Hash table to store the definitions in, only with no \p name.
+ * @return Found definition, NULL if there is none. With no \p name, non-NULL on error.
+ */
+static struct lys_ext_instance_complex *
+lys_find_annotation_direct(const struct lys_module *mod, const char *name, struct hash_table *ht)
+{
+    struct lys_ext *annot_def = &mod->ctx->models.list[0]->extensions[0];
+    struct lys_ext_instance_complex *annot;
+    uint8_t u;
+
+    annot = lys_annot_search(annot_def, mod->ext, mod->ext_size, name, ht, mod);
+    for (u = 0; !annot && (u < mod->inc_size); ++u) {
+        annot = lys_annot_search(annot_def, mod->inc[u].submodule->ext, mod->inc[u].submodule->ext_size, name, ht, mod);
+    }
+
+    return annot;
 }
 
-static struct lys_restr *
-lys_restr_dup(struct lys_module *mod, struct lys_restr *old, int size, int shallow, struct unres_schema *unres)
+API struct lys_ext_instance_complex *
+lys_find_annotation(const struct lys_module *module, const char *name)
 {
-    struct lys_restr *result;
-    int i;
+    struct ly_ctx *ctx;
+#ifdef LY_ENABLED_CACHE
+    struct lys_annot_rec rec, marker, *match;
+    struct lys_ext_instance_complex *annot = NULL;
+    int found = 0;
+#endif
 
-    if (!size) {
+    if (!module || !name) {
+        LOGARG;
         return NULL;
     }
+    module = lys_main_module(module);
+    ctx = module->ctx;
 
-    result = calloc(size, sizeof *result);
-    LY_CHECK_ERR_RETURN(!result, LOGMEM(mod->ctx), NULL);
+#ifdef LY_ENABLED_CACHE
+    if (ctx->models.parsing_sub_modules_count) {
+        /* annotations may still be added to the modules being parsed */
+        return lys_find_annotation_direct(module, name, NULL);
+    }
 
-    for (i = 0; i < size; i++) {
-        result[i].ext_size = old[i].ext_size;
-        lys_ext_dup(mod->ctx, mod, old[i].ext, old[i].ext_size, &result[i], LYEXT_PAR_RESTR, &result[i].ext, shallow, unres);
-        result[i].expr = lydict_insert(mod->ctx, old[i].expr, 0);
-        result[i].dsc = lydict_insert(mod->ctx, old[i].dsc, 0);
-        result[i].ref = lydict_insert(mod->ctx, old[i].ref, 0);
-        result[i].eapptag = lydict_insert(mod->ctx, old[i].eapptag, 0);
-        result[i].emsg = lydict_insert(mod->ctx, old[i].emsg, 0);
+    rec.mod = module;
+    rec.name = name;
+    memset(&marker, 0, sizeof marker);
+    marker.mod = module;
+
+    pthread_rwlock_rdlock(&ctx->annot_hash_lock);
+    if (ctx->annot_hash && (ctx->annot_hash_set_id == ctx->models.module_set_id)) {
+        if (!lyht_find(ctx->annot_hash, &rec, lys_annot_hash_rec(&rec), (void **)&match)) {
+            found = 1;
+            annot = match->annot;
+        } else if (!lyht_find(ctx->annot_hash, &marker, lys_annot_hash_rec(&marker), NULL)) {
+            /* the definitions of the module are stored, there is no such annotation */
+            found = 1;
+        }
+    }
+    pthread_rwlock_unlock(&ctx->annot_hash_lock);
+    if (found) {
+        return annot;
     }
 
-    return result;
+    pthread_rwlock_wrlock(&ctx->annot_hash_lock);
+    if (ctx->annot_hash && (ctx->annot_hash_set_id != ctx->models.module_set_id)) {
+        /* the modules may not exist anymore */
+        lyht_free(ctx->annot_hash);
+        ctx->annot_hash = NULL;
+    }
+    if (!ctx->annot_hash) {
+        ctx->annot_hash = lyht_new(64, sizeof(struct lys_annot_rec), lys_annot_hash_val_equal, NULL, 1);
+        if (!ctx->annot_hash) {
+            goto direct;
+        }
+        ctx->annot_hash_set_id = ctx->models.module_set_id;
+    }
+
+    if (lyht_find(ctx->annot_hash, &marker, lys_annot_hash_rec(&marker), NULL)) {
+        /* not filled by another thread meanwhile */
+        if (lys_find_annotation_direct(module, NULL, ctx->annot_hash)
+                || (lyht_insert(ctx->annot_hash, &marker, lys_annot_hash_rec(&marker), NULL) == -1)) {
+            /* some definitions may be missing, do not use the table anymore */
+            lyht_free(ctx->annot_hash);
+            ctx->annot_hash = NULL;
+            goto direct;
+        }
+    }
+    if (!lyht_find(ctx->annot_hash, &rec, lys_annot_hash_rec(&rec), (void **)&match)) {
+        annot = match->annot;
+    }
+    pthread_rwlock_unlock(&ctx->annot_hash_lock);
+    return annot;
+
+direct:
+    pthread_rwlock_unlock(&ctx->annot_hash_lock);
+#endif
+    return lys_find_annotation_direct(module, name, NULL);
 }
 
 void
-lys_restr_free(struct ly_ctx *ctx, struct lys_restr *restr,
-               void (*private_destructor)(const struct lys_node *node, void *priv))
+lys_annot_hash_clear(struct ly_ctx *ctx)
 {
-    assert(ctx);
-    if (!restr) {
-        return;
-    }
-
-    lys_extension_instances_free(ctx, restr->ext, restr->ext_size, private_destructor);
-    lydict_remove(ctx, restr->expr);
-    lydict_remove(ctx, restr->dsc);
-    lydict_remove(ctx, restr->ref);
-    lydict_remove(ctx, restr->eapptag);
-    lydict_remove(ctx, restr->emsg);
+#ifdef LY_ENABLED_CACHE
+    pthread_rwlock_wrlock(&ctx->annot_hash_lock);
+    lyht_free(ctx->annot_hash);
+    ctx->annot_hash = NULL;
+    pthread_rwlock_unlock(&ctx->annot_hash_lock);
+#else
+    (void)ctx;
+#endif
 }
 
-API void
-lys_iffeature_free(struct ly_ctx *ctx, struct lys_iffeature *iffeature, uint8_t iffeature_size,
-                   int shallow, void (*private_destructor)(const struct lys_node *node, void *priv))
+#ifdef LY_ENABLED_CACHE
+
+/* number the data children of a schema parent (top-level data nodes of a module) in the lys_getnext() order */
+static void
+lys_node_pos_assign(const struct lys_node *parent, const struct lys_module *mod, int recursive)
 {
-    uint8_t i;
+    struct lys_node *node = NULL;
+    uint32_t pos = 0;
 
-    for (i = 0; i < iffeature_size; ++i) {
-        lys_extension_instances_free(ctx, iffeature[i].ext, iffeature[i].ext_size, private_destructor);
-        if (!shallow) {
-            free(iffeature[i].expr);
-            free(iffeature[i].features);
+    while ((node = (struct lys_node *)lys_getnext(node, parent, mod, LYS_GETNEXT_NOSTATECHECK))) {
+        node->pos = ++pos;
+        if (recursive && (node->nodetype & (LYS_CONTAINER | LYS_LIST | LYS_RPC | LYS_ACTION | LYS_NOTIF))) {
+            lys_node_pos_assign(node, NULL, 1);
         }
     }
-    free(iffeature);
 }
 
-static int
-type_dup(struct lys_module *mod, struct lys_node *parent, struct lys_type *new, struct lys_type *old,
-         LY_DATA_TYPE base, int in_grp, int shallow, struct unres_schema *unres)
+#endif
+
+/* renumber the data siblings of a node after a node was added among them */
+static void
+lys_node_pos_siblings(const struct lys_node *node)
 {
-    int i;
-    unsigned int u;
+#ifdef LY_ENABLED_CACHE
+    const struct lys_node *parent;
 
-    switch (base) {
-    case LY_TYPE_BINARY:
-        if (old->info.binary.length) {
-            new->info.binary.length = lys_restr_dup(mod, old->info.binary.length, 1, shallow, unres);
-        }
-        break;
+    for (parent = lys_parent(node); parent && (parent->nodetype & (LYS_CHOICE | LYS_CASE | LYS_USES)); parent = lys_parent(parent));
+    lys_node_pos_assign(parent, parent ? NULL : lys_node_module(node), 0);
+#else
+    (void)node;
+#endif
+}
 
-    case LY_TYPE_BITS:
-        new->info.bits.count = old->info.bits.count;
-        if (new->info.bits.count) {
-            new->info.bits.bit = calloc(new->info.bits.count, sizeof *new->info.bits.bit);
-            LY_CHECK_ERR_RETURN(!new->info.bits.bit, LOGMEM(mod->ctx), -1);
+/* number the nodes of an applied augment together with their new siblings in the target */
+static void
+lys_node_pos_aug(const struct lys_node_augment *augment)
+{
+#ifdef LY_ENABLED_CACHE
+    const struct lys_node *node = NULL;
 
-            for (u = 0; u < new->info.bits.count; u++) {
-                new->info.bits.bit[u].name = lydict_insert(mod->ctx, old->info.bits.bit[u].name, 0);
-                new->info.bits.bit[u].dsc = lydict_insert(mod->ctx, old->info.bits.bit[u].dsc, 0);
-                new->info.bits.bit[u].ref = lydict_insert(mod->ctx, old->info.bits.bit[u].ref, 0);
-                new->info.bits.bit[u].flags = old->info.bits.bit[u].flags;
-                new->info.bits.bit[u].pos = old->info.bits.bit[u].pos;
-                new->info.bits.bit[u].ext_size = old->info.bits.bit[u].ext_size;
-                if (lys_ext_dup(mod->ctx, mod, old->info.bits.bit[u].ext, old->info.bits.bit[u].ext_size,
-                                &new->info.bits.bit[u], LYEXT_PAR_TYPE_BIT,
-                                &new->info.bits.bit[u].ext, shallow, unres)) {
-                    return -1;
-                }
-            }
-        }
-        break;
+    if ((augment->flags & LYS_NOTAPPLIED) || !augment->target || !augment->child) {
+        return;
+    }
 
-    case LY_TYPE_DEC64:
-        new->info.dec64.dig = old->info.dec64.dig;
-        new->info.dec64.div = old->info.dec64.div;
-        if (old->info.dec64.range) {
-            new->info.dec64.range = lys_restr_dup(mod, old->info.dec64.range, 1, shallow, unres);
+    lys_node_pos_siblings(augment->child);
+    while ((node = lys_getnext(node, (struct lys_node *)augment, NULL, LYS_GETNEXT_NOSTATECHECK))) {
+        if (node->nodetype & (LYS_CONTAINER | LYS_LIST | LYS_RPC | LYS_ACTION | LYS_NOTIF)) {
+            lys_node_pos_assign(node, NULL, 1);
         }
-        break;
+    }
+#else
+    (void)augment;
+#endif
+}
 
-    case LY_TYPE_ENUM:
-        new->info.enums.count = old->info.enums.count;
-        if (new->info.enums.count) {
-            new->info.enums.enm = calloc(new->info.enums.count, sizeof *new->info.enums.enm);
-            LY_CHECK_ERR_RETURN(!new->info.enums.enm, LOGMEM(mod->ctx), -1);
+void
+lys_node_pos_module(struct lys_module *module)
+{
+#ifdef LY_ENABLED_CACHE
+    uint8_t u, v;
 
-            for (u = 0; u < new->info.enums.count; u++) {
-                new->info.enums.enm[u].name = lydict_insert(mod->ctx, old->info.enums.enm[u].name, 0);
-                new->info.enums.enm[u].dsc = lydict_insert(mod->ctx, old->info.enums.enm[u].dsc, 0);
-                new->info.enums.enm[u].ref = lydict_insert(mod->ctx, old->info.enums.enm[u].ref, 0);
-                new->info.enums.enm[u].flags = old->info.enums.enm[u].flags;
-                new->info.enums.enm[u].value = old->info.enums.enm[u].value;
-                new->info.enums.enm[u].ext_size = old->info.enums.enm[u].ext_size;
-                if (lys_ext_dup(mod->ctx, mod, old->info.enums.enm[u].ext, old->info.enums.enm[u].ext_size,
-                                &new->info.enums.enm[u], LYEXT_PAR_TYPE_ENUM,
-                                &new->info.enums.enm[u].ext, shallow, unres)) {
-                    return -1;
-                }
-            }
-        }
-        break;
+    lys_node_pos_assign(NULL, module, 1);
 
-    case LY_TYPE_IDENT:
-        new->info.ident.count = old->info.ident.count;
-        if (old->info.ident.count) {
-            new->info.ident.ref = malloc(old->info.ident.count * sizeof *new->info.ident.ref);
-            LY_CHECK_ERR_RETURN(!new->info.ident.ref, LOGMEM(mod->ctx), -1);
-            memcpy(new->info.ident.ref, old->info.ident.ref, old->info.ident.count * sizeof *new->info.ident.ref);
-        } else {
-            /* there can be several unresolved base identities, duplicate them all */
-            i = -1;
-            do {
-                i = unres_schema_find(unres, i, old, UNRES_TYPE_IDENTREF);
-                if (i != -1) {
-                    if (unres_schema_add_str(mod, unres, new, UNRES_TYPE_IDENTREF, unres->str_snode[i]) == -1) {
-                        return -1;
-                    }
-                }
-                --i;
-            } while (i > -1);
+    for (u = 0; u < module->augment_size; ++u) {
+        lys_node_pos_aug(&module->augment[u]);
+    }
+    for (v = 0; v < module->inc_size && module->inc[v].submodule; ++v) {
+        for (u = 0; u < module->inc[v].submodule->augment_size; ++u) {
+            lys_node_pos_aug(&module->inc[v].submodule->augment[u]);
         }
-        break;
+    }
+#else
+    (void)module;
+#endif
+}
 
-    case LY_TYPE_INST:
-        new->info.inst.req = old->info.inst.req;
-        break;
+/**
+ * @brief Learn whether the subtree of a data node can contain state data, remembered in #LYS_INCL_STATUS
+ * of containers and lists.
+ *
+ * @param[in] node Schema node.
+ * @param[in] recursive Whether to learn it for all the descendants first, otherwise their flags are used.
+ * @return 1 if the subtree can contain state data, 0 if not.
+ */
+static int
+lys_node_state_learn(struct lys_node *node, int recursive)
+{
+    struct lys_node *child = NULL;
+    int state;
 
-    case LY_TYPE_INT8:
-    case LY_TYPE_INT16:
-    case LY_TYPE_INT32:
-    case LY_TYPE_INT64:
-    case LY_TYPE_UINT8:
-    case LY_TYPE_UINT16:
-    case LY_TYPE_UINT32:
-    case LY_TYPE_UINT64:
-        if (old->info.num.range) {
-            new->info.num.range = lys_restr_dup(mod, old->info.num.range, 1, shallow, unres);
-        }
-        break;
+    state = (node->flags & LYS_CONFIG_R) ? 1 : 0;
+    if (!(node->nodetype & (LYS_CONTAINER | LYS_LIST))) {
+        return state;
+    }
 
-    case LY_TYPE_LEAFREF:
-        if (old->info.lref.path) {
-            new->info.lref.path = lydict_insert(mod->ctx, old->info.lref.path, 0);
-            new->info.lref.req = old->info.lref.req;
-            if (!in_grp && unres_schema_add_node(mod, unres, new, UNRES_TYPE_LEAFREF, parent) == -1) {
-                return -1;
-            }
+    while ((child = (struct lys_node *)lys_getnext(child, node, NULL, LYS_GETNEXT_NOSTATECHECK))) {
+        if (!(child->nodetype & (LYS_CONTAINER | LYS_LIST | LYS_LEAF | LYS_LEAFLIST | LYS_ANYDATA))) {
+            /* operations and notifications */
+            continue;
         }
-        break;
+        if (recursive) {
+            state |= lys_node_state_learn(child, 1);
+        } else if ((child->flags & LYS_CONFIG_R)
+                || ((child->nodetype & (LYS_CONTAINER | LYS_LIST)) && (child->flags & LYS_INCL_STATUS))) {
+            state = 1;
+            break;
+        }
+    }
 
-    case LY_TYPE_STRING:
-        if (old->info.str.length) {
-            new->info.str.length = lys_restr_dup(mod, old->info.str.length, 1, shallow, unres);
+    if (state) {
+        node->flags |= LYS_INCL_STATUS;
+    } else {
+        node->flags &= ~LYS_INCL_STATUS;
+    }
+    return state;
+}
+
+/* learn the state data presence of a changed subtree and of all its data ancestors */
+static void
+lys_node_state_update(struct lys_node *node, int recursive)
+{
+    uint16_t flag;
+
+    lys_node_state_learn(node, recursive);
+    for (node = lys_parent(node); node; node = lys_parent(node)) {
+        if (!(node->nodetype & (LYS_CONTAINER | LYS_LIST))) {
+            continue;
         }
-        if (old->info.str.pat_count) {
-            new->info.str.patterns = lys_restr_dup(mod, old->info.str.patterns, old->info.str.pat_count, shallow, unres);
-            new->info.str.pat_count = old->info.str.pat_count;
-#ifdef LY_ENABLED_CACHE
-            if (!in_grp) {
-                new->info.str.patterns_pcre = malloc(new->info.str.pat_count * 2 * sizeof *new->info.str.patterns_pcre);
-                LY_CHECK_ERR_RETURN(!new->info.str.patterns_pcre, LOGMEM(mod->ctx), -1);
-                for (u = 0; u < new->info.str.pat_count; u++) {
-                    if (lyp_precompile_pattern(mod->ctx, &new->info.str.patterns[u].expr[1],
-                                              (pcre**)&new->info.str.patterns_pcre[2 * u],
-                                              (pcre_extra**)&new->info.str.patterns_pcre[2 * u + 1])) {
-                        free(new->info.str.patterns_pcre);
-                        new->info.str.patterns_pcre = NULL;
-                        return -1;
-                    }
-                }
-            }
-#endif
+        flag = node->flags & LYS_INCL_STATUS;
+        if (lys_node_state_learn(node, 0) == (flag ? 1 : 0)) {
+            /* nothing changes above */
+            break;
         }
-        break;
+    }
+}
 
-    case LY_TYPE_UNION:
-        new->info.uni.has_ptr_type = old->info.uni.has_ptr_type;
-        new->info.uni.count = old->info.uni.count;
-        if (new->info.uni.count) {
-            new->info.uni.types = calloc(new->info.uni.count, sizeof *new->info.uni.types);
-            LY_CHECK_ERR_RETURN(!new->info.uni.types, LOGMEM(mod->ctx), -1);
+static void
+lys_node_state_aug(struct lys_node_augment *augment)
+{
+    struct lys_node *node = NULL;
 
-            for (u = 0; u < new->info.uni.count; u++) {
-                if (lys_type_dup(mod, parent, &(new->info.uni.types[u]), &(old->info.uni.types[u]), in_grp,
-                        shallow, unres)) {
-                    return -1;
-                }
-            }
-        }
-        break;
+    if ((augment->flags & LYS_NOTAPPLIED) || !augment->target || !augment->child) {
+        return;
+    }
 
-    default:
-        /* nothing to do for LY_TYPE_BOOL, LY_TYPE_EMPTY */
-        break;
+    while ((node = (struct lys_node *)lys_getnext(node, (struct lys_node *)augment, NULL, LYS_GETNEXT_NOSTATECHECK))) {
+        if (node->nodetype & (LYS_CONTAINER | LYS_LIST | LYS_LEAF | LYS_LEAFLIST | LYS_ANYDATA)) {
+            lys_node_state_update(node, 1);
+        }
     }
+}
 
-    return EXIT_SUCCESS;
+static void
+lys_node_state_tree(const struct lys_module *module)
+{
+    struct lys_node *node = NULL;
+
+    while ((node = (struct lys_node *)lys_getnext(node, NULL, module, LYS_GETNEXT_NOSTATECHECK))) {
+        lys_node_state_learn(node, 1);
+    }
 }
 
-struct yang_type *
-lys_yang_type_dup(struct lys_module *module, struct lys_node *parent, struct yang_type *old, struct lys_type *type,
-                  int in_grp, int shallow, struct unres_schema *unres)
+void
+lys_node_state_devs(struct lys_module *module)
 {
-    struct yang_type *new;
+    struct lys_deviation *dev;
+    struct ly_set *mods;
+    uint8_t u, v;
+    uint32_t i;
 
-    new = calloc(1, sizeof *new);
-    LY_CHECK_ERR_RETURN(!new, LOGMEM(module->ctx), NULL);
-    new->flags = old->flags;
-    new->base = old->base;
-    new->name = lydict_insert(module->ctx, old->name, 0);
-    new->type = type;
-    if (!new->name) {
+    mods = ly_set_new();
+    if (!mods) {
         LOGMEM(module->ctx);
-        goto error;
+        return;
     }
-    if (type_dup(module, parent, type, old->type, new->base, in_grp, shallow, unres)) {
-        new->type->base = new->base;
-        lys_type_free(module->ctx, new->type, NULL);
-        memset(&new->type->info, 0, sizeof new->type->info);
-        goto error;
+
+    /* every changed module is learned only once */
+    for (u = 0; u < module->deviation_size; ++u) {
+        if (module->deviation[u].target
+                && (ly_set_add(mods, lys_node_module(module->deviation[u].target), 0) == -1)) {
+            goto cleanup;
+        }
+    }
+    for (v = 0; v < module->inc_size && module->inc[v].submodule; ++v) {
+        dev = module->inc[v].submodule->deviation;
+        for (u = 0; u < module->inc[v].submodule->deviation_size; ++u) {
+            if (dev[u].target && (ly_set_add(mods, lys_node_module(dev[u].target), 0) == -1)) {
+                goto cleanup;
+            }
+        }
     }
-    return new;
 
-error:
-    free(new);
-    return NULL;
+    for (i = 0; i < mods->number; ++i) {
+        lys_node_state_tree(mods->set.g[i]);
+    }
+
+cleanup:
+    ly_set_free(mods);
 }
 
-int
-lys_copy_union_leafrefs(struct lys_module *mod, struct lys_node *parent, struct lys_type *type, struct lys_type *prev_new,
-                        struct unres_schema *unres)
+void
+lys_node_state_module(struct lys_module *module)
 {
-    struct lys_type new;
-    unsigned int i, top_type;
-    struct lys_ext_instance **ext;
-    uint8_t ext_size;
-    void *reloc;
+    uint8_t u, v;
 
-    if (!prev_new) {
-        /* this is the "top-level" type, meaning it is a real type and no typedef directly above */
-        top_type = 1;
+    lys_node_state_tree(module);
 
-        memset(&new, 0, sizeof new);
+    for (u = 0; u < module->augment_size; ++u) {
+        lys_node_state_aug(&module->augment[u]);
+    }
+    for (v = 0; v < module->inc_size && module->inc[v].submodule; ++v) {
+        for (u = 0; u < module->inc[v].submodule->augment_size; ++u) {
+            lys_node_state_aug(&module->inc[v].submodule->augment[u]);
+        }
+    }
 
-        new.base = type->base;
-        new.parent = (struct lys_tpdf *)parent;
+    lys_node_state_devs(module);
+}
 
-        prev_new = &new;
+API const struct lys_node *
+lys_getnext(const struct lys_node *last, const struct lys_node *parent, const struct lys_module *module, int options)
+{
+    const struct lys_node *next, *aug_parent;
+    struct lys_node **snode;
+
+    if ((!parent && !module) || (module && module->type) || (parent && (parent->nodetype == LYS_USES) && !(options & LYS_GETNEXT_PARENTUSES))) {
+        LOGARG;
+        return NULL;
+    }
+
+    if (!last) {
+        /* first call */
+
+        /* get know where to start */
+        if (parent) {
+            /* schema subtree */
+            snode = lys_child(parent, LYS_UNKNOWN);
+            /* do not return anything if the augment does not have any children */
+            if (!snode || !(*snode) || ((parent->nodetype == LYS_AUGMENT) && ((*snode)->parent != parent))) {
+                return NULL;
+            }
+            next = last = *snode;
+        } else {
+            /* top level data */
+            if (!(options & LYS_GETNEXT_NOSTATECHECK) && (module->disabled || !module->implemented)) {
+                /* nothing to return from a disabled/imported module */
+                return NULL;
+            }
+            next = last = module->data;
+        }
+    } else if ((last->nodetype == LYS_USES) && (options & LYS_GETNEXT_INTOUSES) && last->child) {
+        /* continue with uses content */
+        next = last->child;
     } else {
-        /* this is not top-level type, just a type of a typedef */
-        top_type = 0;
+        /* continue after the last returned value */
+        next = last->next;
     }
 
-    assert(type->der);
-    if (type->der->module) {
-        /* typedef, skip it, but keep the extensions */
-        ext_size = type->ext_size;
-        if (lys_ext_dup(mod->ctx, mod, type->ext, type->ext_size, prev_new, LYEXT_PAR_TYPE, &ext, 0, unres)) {
-            return -1;
+repeat:
+    if (parent && (parent->nodetype == LYS_AUGMENT) && next) {
+        /* do not return anything outside the parent augment */
+        aug_parent = next->parent;
+        do {
+            while (aug_parent && (aug_parent->nodetype != LYS_AUGMENT)) {
+                aug_parent = aug_parent->parent;
+            }
+            if (aug_parent) {
+                if (aug_parent == parent) {
+                    break;
+                }
+                aug_parent = ((struct lys_node_augment *)aug_parent)->target;
+            }
+
+        } while (aug_parent);
+        if (!aug_parent) {
+            return NULL;
         }
-        if (prev_new->ext) {
-            reloc = realloc(prev_new->ext, (prev_new->ext_size + ext_size) * sizeof *prev_new->ext);
-            LY_CHECK_ERR_RETURN(!reloc, LOGMEM(mod->ctx), -1);
-            prev_new->ext = reloc;
+    }
+    while (next && (next->nodetype == LYS_GROUPING)) {
+        if (options & LYS_GETNEXT_WITHGROUPING) {
+            return next;
+        }
+        next = next->next;
+    }
 
-            memcpy(prev_new->ext + prev_new->ext_size, ext, ext_size * sizeof *ext);
-            free(ext);
+    if (!next) {     /* cover case when parent is augment */
+        if (!last || last->parent == parent || lys_parent(last) == parent) {
+            /* no next element */
+            return NULL;
+        }
+        last = lys_parent(last);
+        next = last->next;
+        goto repeat;
+    } else {
+        last = next;
+    }
 
-            prev_new->ext_size += ext_size;
+    if (!(options & LYS_GETNEXT_NOSTATECHECK) && lys_is_disabled(next, 0)) {
+        next = next->next;
+        goto repeat;
+    }
+
+    switch (next->nodetype) {
+    case LYS_INPUT:
+    case LYS_OUTPUT:
+        if (options & LYS_GETNEXT_WITHINOUT) {
+            return next;
+        } else if (next->child) {
+            next = next->child;
         } else {
-            prev_new->ext = ext;
-            prev_new->ext_size = ext_size;
+            next = next->next;
         }
+        goto repeat;
 
-        if (lys_copy_union_leafrefs(mod, parent, &type->der->type, prev_new, unres)) {
-            return -1;
+    case LYS_CASE:
+        if (options & LYS_GETNEXT_WITHCASE) {
+            return next;
+        } else if (next->child) {
+            next = next->child;
+        } else {
+            next = next->next;
         }
-    } else {
-        /* type, just make a deep copy */
-        switch (type->base) {
-        case LY_TYPE_UNION:
-            prev_new->info.uni.has_ptr_type = type->info.uni.has_ptr_type;
-            prev_new->info.uni.count = type->info.uni.count;
-            /* this cannot be a typedef anymore */
-            assert(prev_new->info.uni.count);
+        goto repeat;
 
-            prev_new->info.uni.types = calloc(prev_new->info.uni.count, sizeof *prev_new->info.uni.types);
-            LY_CHECK_ERR_RETURN(!prev_new->info.uni.types, LOGMEM(mod->ctx), -1);
+    case LYS_USES:
+        /* go into */
+        if (options & LYS_GETNEXT_WITHUSES) {
+            return next;
+        } else if (next->child) {
+            next = next->child;
+        } else {
+            next = next->next;
+        }
+        goto repeat;
 
-            for (i = 0; i < prev_new->info.uni.count; i++) {
-                if (lys_copy_union_leafrefs(mod, parent, &(type->info.uni.types[i]), &(prev_new->info.uni.types[i]), unres)) {
-                    return -1;
-                }
-            }
+    case LYS_RPC:
+    case LYS_ACTION:
+    case LYS_NOTIF:
+    case LYS_LEAF:
+    case LYS_ANYXML:
+    case LYS_ANYDATA:
+    case LYS_LIST:
+    case LYS_LEAFLIST:
+        return next;
 
-            prev_new->der = type->der;
-            break;
-        default:
-            if (lys_type_dup(mod, parent, prev_new, type, 0, 0, unres)) {
-                return -1;
+    case LYS_CONTAINER:
+        if (!((struct lys_node_container *)next)->presence && (options & LYS_GETNEXT_INTONPCONT)) {
+            if (next->child) {
+                /* go into */
+                next = next->child;
+            } else {
+                next = next->next;
             }
-            break;
+            goto repeat;
+        } else {
+            return next;
         }
-    }
 
-    if (top_type) {
-        memcpy(type, prev_new, sizeof *type);
+    case LYS_CHOICE:
+        if (options & LYS_GETNEXT_WITHCHOICE) {
+            return next;
+        } else if (next->child) {
+            /* go into */
+            next = next->child;
+        } else {
+            next = next->next;
+        }
+        goto repeat;
+
+    default:
+        /* we should not be here */
+        return NULL;
     }
-    return EXIT_SUCCESS;
 }
 
-API const void *
-lys_ext_instance_substmt(const struct lys_ext_instance *ext)
+void
+lys_node_unlink(struct lys_node *node)
 {
-    if (!ext) {
-        return NULL;
+    struct lys_node *parent, *first, **pp = NULL;
+    struct lys_module *main_module;
+
+    if (!node) {
+        return;
     }
 
-    switch (ext->insubstmt) {
-    case LYEXT_SUBSTMT_SELF:
-    case LYEXT_SUBSTMT_MODIFIER:
-    case LYEXT_SUBSTMT_VERSION:
-        return NULL;
-    case LYEXT_SUBSTMT_ARGUMENT:
-        if (ext->parent_type == LYEXT_PAR_EXT) {
-            return ((struct lys_ext_instance*)ext->parent)->arg_value;
+    /* unlink from data model if necessary */
+    if (node->module) {
+        lys_children_changed(node->module->ctx);
+
+        /* get main module with data tree */
+        main_module = lys_node_module(node);
+        if (main_module->data == node) {
+            main_module->data = node->next;
         }
-        break;
-    case LYEXT_SUBSTMT_BASE:
-        if (ext->parent_type == LYEXT_PAR_TYPE) {
-            return ((struct lys_type*)ext->parent)->info.ident.ref[ext->insubstmt_index];
-        } else if (ext->parent_type == LYEXT_PAR_IDENT) {
-            return ((struct lys_ident*)ext->parent)->base[ext->insubstmt_index];
+    }
+
+    /* store pointers to important nodes */
+    parent = node->parent;
+    if (parent && (parent->nodetype == LYS_AUGMENT)) {
+        /* handle augments - first, unlink it from the augment parent ... */
+        if (parent->child == node) {
+            parent->child = (node->next && node->next->parent == parent) ? node->next : NULL;
         }
-        break;
-    case LYEXT_SUBSTMT_BELONGSTO:
-        if (ext->parent_type == LYEXT_PAR_MODULE && ((struct lys_module*)ext->parent)->type) {
-            return ((struct lys_submodule*)ext->parent)->belongsto;
+
+        if (parent->flags & LYS_NOTAPPLIED) {
+            /* data are not connected in the target, so we cannot continue with the target as a parent */
+            parent = NULL;
+        } else {
+            /* data are connected in target, so we will continue with the target as a parent */
+            parent = ((struct lys_node_augment *)parent)->target;
         }
-        break;
-    case LYEXT_SUBSTMT_CONFIG:
-    case LYEXT_SUBSTMT_MANDATORY:
-        if (ext->parent_type == LYEXT_PAR_NODE) {
-            return &((struct lys_node*)ext->parent)->flags;
-        } else if (ext->parent_type == LYEXT_PAR_DEVIATE) {
-            return &((struct lys_deviate*)ext->parent)->flags;
-        } else if (ext->parent_type == LYEXT_PAR_REFINE) {
-            return &((struct lys_refine*)ext->parent)->flags;
+    }
+
+    /* unlink from parent */
+    if (parent) {
+        if (parent->nodetype == LYS_EXT) {
+            pp = (struct lys_node **)lys_ext_complex_get_substmt(lys_snode2stmt(node->nodetype),
+                                                                 (struct lys_ext_instance_complex*)parent, NULL);
+            if (*pp == node) {
+                *pp = node->next;
+            }
+        } else if (parent->child == node) {
+            parent->child = node->next;
         }
-        break;
-    case LYEXT_SUBSTMT_CONTACT:
-        if (ext->parent_type == LYEXT_PAR_MODULE) {
-            return ((struct lys_module*)ext->parent)->contact;
+        node->parent = NULL;
+    }
+
+    /* unlink from siblings */
+    if (node->prev == node) {
+        /* there are no more siblings */
+        return;
+    }
+    if (node->next) {
+        node->next->prev = node->prev;
+    } else {
+        /* unlinking the last element */
+        if (parent) {
+            if (parent->nodetype == LYS_EXT) {
+                first = *(struct lys_node **)pp;
+            } else {
+                first = parent->child;
+            }
+        } else {
+            first = node;
+            while (first->prev->next) {
+                first = first->prev;
+            }
         }
-        break;
-    case LYEXT_SUBSTMT_DEFAULT:
-        if (ext->parent_type == LYEXT_PAR_NODE) {
-            switch (((struct lys_node*)ext->parent)->nodetype) {
-            case LYS_LEAF:
-            case LYS_LEAFLIST:
-                /* in case of leaf, the index is supposed to be 0, so it will return the
-                 * correct pointer despite the leaf structure does not have dflt as array */
-                return ((struct lys_node_leaflist*)ext->parent)->dflt[ext->insubstmt_index];
-            case LYS_CHOICE:
-                return ((struct lys_node_choice*)ext->parent)->dflt;
-            default:
-                /* internal error */
+        first->prev = node->prev;
+    }
+    if (node->prev->next) {
+        node->prev->next = node->next;
+    }
+
+    /* clean up the unlinked element */
+    node->next = NULL;
+    node->prev = node;
+}
+
+struct lys_node_grp *
+lys_find_grouping_up(const char *name, struct lys_node *start)
+{
+    struct lys_node *par_iter, *iter, *stop;
+
+    for (par_iter = start; par_iter; par_iter = par_iter->parent) {
+        /* top-level augment, look into module (uses augment is handled correctly below) */
+        if (par_iter->parent && !par_iter->parent->parent && (par_iter->parent->nodetype == LYS_AUGMENT)) {
+            par_iter = lys_main_module(par_iter->parent->module)->data;
+            if (!par_iter) {
                 break;
             }
-        } else if (ext->parent_type == LYEXT_PAR_TPDF) {
-            return ((struct lys_tpdf*)ext->parent)->dflt;
-        } else if (ext->parent_type == LYEXT_PAR_DEVIATE) {
-            return ((struct lys_deviate*)ext->parent)->dflt[ext->insubstmt_index];
-        } else if (ext->parent_type == LYEXT_PAR_REFINE) {
-            return &((struct lys_refine*)ext->parent)->dflt[ext->insubstmt_index];
         }
-        break;
-    case LYEXT_SUBSTMT_DESCRIPTION:
-        switch (ext->parent_type) {
-        case LYEXT_PAR_NODE:
-            return ((struct lys_node*)ext->parent)->dsc;
-        case LYEXT_PAR_MODULE:
-            return ((struct lys_module*)ext->parent)->dsc;
-        case LYEXT_PAR_IMPORT:
-            return ((struct lys_import*)ext->parent)->dsc;
-        case LYEXT_PAR_INCLUDE:
-            return ((struct lys_include*)ext->parent)->dsc;
-        case LYEXT_PAR_EXT:
-            return ((struct lys_ext*)ext->parent)->dsc;
-        case LYEXT_PAR_FEATURE:
-            return ((struct lys_feature*)ext->parent)->dsc;
-        case LYEXT_PAR_TPDF:
-            return ((struct lys_tpdf*)ext->parent)->dsc;
-        case LYEXT_PAR_TYPE_BIT:
-            return ((struct lys_type_bit*)ext->parent)->dsc;
-        case LYEXT_PAR_TYPE_ENUM:
-            return ((struct lys_type_enum*)ext->parent)->dsc;
-        case LYEXT_PAR_RESTR:
-            return ((struct lys_restr*)ext->parent)->dsc;
-        case LYEXT_PAR_WHEN:
-            return ((struct lys_when*)ext->parent)->dsc;
-        case LYEXT_PAR_IDENT:
-            return ((struct lys_ident*)ext->parent)->dsc;
-        case LYEXT_PAR_DEVIATION:
-            return ((struct lys_deviation*)ext->parent)->dsc;
-        case LYEXT_PAR_REVISION:
-            return ((struct lys_revision*)ext->parent)->dsc;
-        case LYEXT_PAR_REFINE:
-            return ((struct lys_refine*)ext->parent)->dsc;
-        default:
-            break;
+
+        if (par_iter->nodetype == LYS_EXT) {
+            /* we are in a top-level extension, search grouping in top-level groupings */
+            par_iter = lys_main_module(par_iter->module)->data;
+            if (!par_iter) {
+                /* not connected yet, wait */
+                return NULL;
+            }
+        } else if (par_iter->parent && (par_iter->parent->nodetype & (LYS_CHOICE | LYS_CASE | LYS_AUGMENT | LYS_USES))) {
+            continue;
         }
-        break;
-    case LYEXT_SUBSTMT_ERRTAG:
-        if (ext->parent_type == LYEXT_PAR_RESTR) {
-            return ((struct lys_restr*)ext->parent)->eapptag;
+
+        for (iter = par_iter, stop = NULL; iter; iter = iter->prev) {
+            if (!stop) {
+                stop = par_iter;
+            } else if (iter == stop) {
+                break;
+            }
+            if (iter->nodetype != LYS_GROUPING) {
+                continue;
+            }
+
+            if (!strcmp(name, iter->name)) {
+                return (struct lys_node_grp *)iter;
+            }
         }
-        break;
-    case LYEXT_SUBSTMT_ERRMSG:
-        if (ext->parent_type == LYEXT_PAR_RESTR) {
-            return ((struct lys_restr*)ext->parent)->emsg;
+    }
+
+    return NULL;
+}
+
+/*
+ * get next grouping in the root's subtree, in the
+ * first call, tha last is NULL
+ */
+static struct lys_node_grp *
+lys_get_next_grouping(struct lys_node_grp *lastgrp, struct lys_node *root)
+{
+    struct lys_node *last = (struct lys_node *)lastgrp;
+    struct lys_node *next;
+
+    assert(root);
+
+    if (!last) {
+        last = root;
+    }
+
+    while (1) {
+        if ((last->nodetype & (LYS_CONTAINER | LYS_CHOICE | LYS_LIST | LYS_GROUPING | LYS_INPUT | LYS_OUTPUT))) {
+            next = last->child;
+        } else {
+            next = NULL;
         }
-        break;
-    case LYEXT_SUBSTMT_DIGITS:
-        if (ext->parent_type == LYEXT_PAR_TYPE && ((struct lys_type*)ext->parent)->base == LY_TYPE_DEC64) {
-            return &((struct lys_type*)ext->parent)->info.dec64.dig;
+        if (!next) {
+            if (last == root) {
+                /* we are done */
+                return NULL;
+            }
+
+            /* no children, go to siblings */
+            next = last->next;
+        }
+        while (!next) {
+            /* go back through parents */
+            if (lys_parent(last) == root) {
+                /* we are done */
+                return NULL;
+            }
+            next = last->next;
+            last = lys_parent(last);
+        }
+
+        if (next->nodetype == LYS_GROUPING) {
+            return (struct lys_node_grp *)next;
+        }
+
+        last = next;
+    }
+}
+
+/* logs directly */
+int
+lys_check_id(struct lys_node *node, struct lys_node *parent, struct lys_module *module)
+{
+    struct lys_node *start, *stop, *iter;
+    struct lys_node_grp *grp;
+    int down, up;
+
+    assert(node);
+
+    if (!parent) {
+        assert(module);
+    } else {
+        module = parent->module;
+    }
+    module = lys_main_module(module);
+
+    switch (node->nodetype) {
+    case LYS_GROUPING:
+        /* 6.2.1, rule 6 */
+        if (parent) {
+            start = *lys_child(parent, LYS_GROUPING);
+            if (!start) {
+                down = 0;
+                start = parent;
+            } else {
+                down = 1;
+            }
+            if (parent->nodetype == LYS_EXT) {
+                up = 0;
+            } else {
+                up = 1;
+            }
+        } else {
+            down = up = 1;
+            start = module->data;
+        }
+        /* go up */
+        if (up && lys_find_grouping_up(node->name, start)) {
+            LOGVAL(module->ctx, LYE_DUPID, LY_VLOG_LYS, node, "grouping", node->name);
+            return EXIT_FAILURE;
+        }
+        /* go down, because grouping can be defined after e.g. container in which is collision */
+        if (down) {
+            for (iter = start, stop = NULL; iter; iter = iter->prev) {
+                if (!stop) {
+                    stop = start;
+                } else if (iter == stop) {
+                    break;
+                }
+                if (!(iter->nodetype & (LYS_CONTAINER | LYS_CHOICE | LYS_LIST | LYS_GROUPING | LYS_INPUT | LYS_OUTPUT))) {
+                    continue;
+                }
+
+                grp = NULL;
+                while ((grp = lys_get_next_grouping(grp, iter))) {
+                    if (ly_strequal(node->name, grp->name, 1)) {
+                        LOGVAL(module->ctx, LYE_DUPID,LY_VLOG_LYS, node, "grouping", node->name);
+                        return EXIT_FAILURE;
+                    }
+                }
+            }
+        }
+        break;
+    case LYS_LEAF:
+    case LYS_LEAFLIST:
+    case LYS_LIST:
+    case LYS_CONTAINER:
+    case LYS_CHOICE:
+    case LYS_ANYDATA:
+        /* 6.2.1, rule 7 */
+        if (parent) {
+            iter = parent;
+            while (iter && (iter->nodetype & (LYS_USES | LYS_CASE | LYS_CHOICE | LYS_AUGMENT))) {
+                if (iter->nodetype == LYS_AUGMENT) {
+                    if (((struct lys_node_augment *)iter)->target) {
+                        /* augment is resolved, go up */
+                        iter = ((struct lys_node_augment *)iter)->target;
+                        continue;
+                    }
+                    /* augment is not resolved, this is the final parent */
+                    break;
+                }
+                iter = iter->parent;
+            }
+
+            if (!iter) {
+                stop = NULL;
+                iter = module->data;
+            } else if (iter->nodetype == LYS_EXT) {
+                stop = iter;
+                iter = (struct lys_node *)lys_child(iter, node->nodetype);
+                if (iter) {
+                    iter = *(struct lys_node **)iter;
+                }
+            } else {
+                stop = iter;
+                iter = iter->child;
+            }
+        } else {
+            stop = NULL;
+            iter = module->data;
+        }
+        while (iter) {
+            if (iter->nodetype & (LYS_USES | LYS_CASE)) {
+                iter = iter->child;
+                continue;
+            }
+
+            if (iter->nodetype & (LYS_LEAF | LYS_LEAFLIST | LYS_LIST | LYS_CONTAINER | LYS_CHOICE | LYS_ANYDATA)) {
+                if (iter->module == node->module && ly_strequal(iter->name, node->name, 1)) {
+                    LOGVAL(module->ctx, LYE_DUPID, LY_VLOG_LYS, node, strnodetype(node->nodetype), node->name);
+                    return EXIT_FAILURE;
+                }
+            }
+
+            /* special case for choice - we must check the choice's name as
+             * well as the names of nodes under the choice
+             */
+            if (iter->nodetype == LYS_CHOICE) {
+                iter = iter->child;
+                continue;
+            }
+
+            /* go to siblings */
+            if (!iter->next) {
+                /* no sibling, go to parent's sibling */
+                do {
+                    /* for parent LYS_AUGMENT */
+                    if (iter->parent == stop) {
+                        iter = stop;
+                        break;
+                    }
+                    iter = lys_parent(iter);
+                    if (iter && iter->next) {
+                        break;
+                    }
+                } while (iter != stop);
+
+                if (iter == stop) {
+                    break;
+                }
+            }
+            iter = iter->next;
+        }
+        break;
+    case LYS_CASE:
+        /* 6.2.1, rule 8 */
+        if (parent) {
+            start = *lys_child(parent, LYS_CASE);
+        } else {
+            start = module->data;
+        }
+
+        LY_TREE_FOR(start, iter) {
+            if (!(iter->nodetype & (LYS_ANYDATA | LYS_CASE | LYS_CONTAINER | LYS_LEAF | LYS_LEAFLIST | LYS_LIST))) {
+                continue;
+            }
+
+            if (iter->module == node->module && ly_strequal(iter->name, node->name, 1)) {
+                LOGVAL(module->ctx, LYE_DUPID, LY_VLOG_LYS, node, "case", node->name);
+                return EXIT_FAILURE;
+            }
+        }
+        break;
+    default:
+        /* no check needed */
+        break;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+/* logs directly */
+int
+lys_node_addchild(struct lys_node *parent, struct lys_module *module, struct lys_node *child, int options)
+{
+    struct ly_ctx *ctx = child->module->ctx;
+    struct lys_node *iter, **pchild, *log_parent;
+    struct lys_node_inout *in, *out;
+    struct lys_node_case *c;
+    int type, shortcase = 0;
+    void *p;
+    struct lyext_substmt *info = NULL;
+
+    assert(child);
+
+    if (parent) {
+        type = parent->nodetype;
+        module = parent->module;
+        log_parent = parent;
+
+        if (type == LYS_USES) {
+            /* we are adding children to uses -> we must be copying grouping contents into it, so properly check the parent */
+            log_parent = lys_parent(log_parent);
+            while (log_parent && (log_parent->nodetype == LYS_USES)) {
+                log_parent = lys_parent(log_parent);
+            }
+            if (log_parent) {
+                type = log_parent->nodetype;
+            } else {
+                type = 0;
+            }
+        }
+    } else {
+        assert(module);
+        assert(!(child->nodetype & (LYS_INPUT | LYS_OUTPUT)));
+        type = 0;
+        log_parent = NULL;
+    }
+
+    /* checks */
+    switch (type) {
+    case LYS_CONTAINER:
+    case LYS_LIST:
+    case LYS_GROUPING:
+    case LYS_USES:
+        if (!(child->nodetype &
+                (LYS_ANYDATA | LYS_CHOICE | LYS_CONTAINER | LYS_GROUPING | LYS_LEAF |
+                 LYS_LEAFLIST | LYS_LIST | LYS_USES | LYS_ACTION | LYS_NOTIF))) {
+            LOGVAL(ctx, LYE_INCHILDSTMT, LY_VLOG_LYS, log_parent, strnodetype(child->nodetype), strnodetype(log_parent->nodetype));
+            return EXIT_FAILURE;
+        }
+        break;
+    case LYS_INPUT:
+    case LYS_OUTPUT:
+    case LYS_NOTIF:
+        if (!(child->nodetype &
+                (LYS_ANYDATA | LYS_CHOICE | LYS_CONTAINER | LYS_GROUPING | LYS_LEAF |
+                 LYS_LEAFLIST | LYS_LIST | LYS_USES))) {
+            LOGVAL(ctx, LYE_INCHILDSTMT, LY_VLOG_LYS, log_parent, strnodetype(child->nodetype), strnodetype(log_parent->nodetype));
+            return EXIT_FAILURE;
+        }
+        break;
+    case LYS_CHOICE:
+        if (!(child->nodetype &
+                (LYS_ANYDATA | LYS_CASE | LYS_CONTAINER | LYS_LEAF | LYS_LEAFLIST | LYS_LIST | LYS_CHOICE))) {
+            LOGVAL(ctx, LYE_INCHILDSTMT, LY_VLOG_LYS, log_parent, strnodetype(child->nodetype), "choice");
+            return EXIT_FAILURE;
+        }
+        if (child->nodetype != LYS_CASE) {
+            shortcase = 1;
+        }
+        break;
+    case LYS_CASE:
+        if (!(child->nodetype &
+                (LYS_ANYDATA | LYS_CHOICE | LYS_CONTAINER | LYS_LEAF | LYS_LEAFLIST | LYS_LIST | LYS_USES))) {
+            LOGVAL(ctx, LYE_INCHILDSTMT, LY_VLOG_LYS, log_parent, strnodetype(child->nodetype), "case");
+            return EXIT_FAILURE;
+        }
+        break;
+    case LYS_RPC:
+    case LYS_ACTION:
+        if (!(child->nodetype & (LYS_INPUT | LYS_OUTPUT | LYS_GROUPING))) {
+            LOGVAL(ctx, LYE_INCHILDSTMT, LY_VLOG_LYS, log_parent, strnodetype(child->nodetype), "rpc");
+            return EXIT_FAILURE;
+        }
+        break;
+    case LYS_LEAF:
+    case LYS_LEAFLIST:
+    case LYS_ANYXML:
+    case LYS_ANYDATA:
+        LOGVAL(ctx, LYE_INCHILDSTMT, LY_VLOG_LYS, log_parent, strnodetype(child->nodetype), strnodetype(log_parent->nodetype));
+        LOGVAL(ctx, LYE_SPEC, LY_VLOG_PREV, NULL, "The \"%s\" statement cannot have any data substatement.",
+               strnodetype(log_parent->nodetype));
+        return EXIT_FAILURE;
+    case LYS_AUGMENT:
+        if (!(child->nodetype &
+                (LYS_ANYDATA | LYS_CASE | LYS_CHOICE | LYS_CONTAINER | LYS_LEAF
+                | LYS_LEAFLIST | LYS_LIST | LYS_USES | LYS_ACTION | LYS_NOTIF))) {
+            LOGVAL(ctx, LYE_INCHILDSTMT, LY_VLOG_LYS, log_parent, strnodetype(child->nodetype), strnodetype(log_parent->nodetype));
+            return EXIT_FAILURE;
+        }
+        break;
+    case LYS_UNKNOWN:
+        /* top level */
+        if (!(child->nodetype &
+                (LYS_ANYDATA | LYS_CHOICE | LYS_CONTAINER | LYS_LEAF | LYS_GROUPING
+                | LYS_LEAFLIST | LYS_LIST | LYS_USES | LYS_RPC | LYS_NOTIF | LYS_AUGMENT))) {
+            LOGVAL(ctx, LYE_INCHILDSTMT, LY_VLOG_LYS, log_parent, strnodetype(child->nodetype), "(sub)module");
+            return EXIT_FAILURE;
+        }
+        break;
+    case LYS_EXT:
+        /* plugin-defined */
+        p = lys_ext_complex_get_substmt(lys_snode2stmt(child->nodetype), (struct lys_ext_instance_complex*)log_parent, &info);
+        if (!p) {
+            LOGVAL(ctx, LYE_INCHILDSTMT, LY_VLOG_LYS, log_parent, strnodetype(child->nodetype),
+                   ((struct lys_ext_instance_complex*)log_parent)->def->name);
+            return EXIT_FAILURE;
+        }
+        /* TODO check cardinality */
+        break;
+    }
+
+    /* check identifier uniqueness */
+    if (!(module->ctx->models.flags & LY_CTX_TRUSTED) && lys_check_id(child, parent, module)) {
+        return EXIT_FAILURE;
+    }
+
+    if (child->parent) {
+        lys_node_unlink(child);
+    }
+
+    if ((child->nodetype & (LYS_INPUT | LYS_OUTPUT)) && parent->nodetype != LYS_EXT) {
+        /* find the implicit input/output node */
+        LY_TREE_FOR(parent->child, iter) {
+            if (iter->nodetype == child->nodetype) {
+                break;
+            }
+        }
+        assert(iter);
+
+        /* switch the old implicit node (iter) with the new one (child) */
+        if (parent->child == iter) {
+            /* first child */
+            parent->child = child;
+        } else {
+            iter->prev->next = child;
+        }
+        child->prev = iter->prev;
+        child->next = iter->next;
+        if (iter->next) {
+            iter->next->prev = child;
+        } else {
+            /* last child */
+            parent->child->prev = child;
+        }
+        child->parent = parent;
+
+        /* isolate the node and free it */
+        iter->next = NULL;
+        iter->prev = iter;
+        iter->parent = NULL;
+        lys_node_free(iter, NULL, 0);
+    } else {
+        if (shortcase) {
+            /* create the implicit case to allow it to serve as a target of the augments,
+             * it won't be printed, but it will be present in the tree */
+            c = calloc(1, sizeof *c);
+            LY_CHECK_ERR_RETURN(!c, LOGMEM(ctx), EXIT_FAILURE);
+            c->name = lydict_insert(module->ctx, child->name, 0);
+            c->flags = LYS_IMPLICIT;
+            if (!(options & (LYS_PARSE_OPT_CFG_IGNORE | LYS_PARSE_OPT_CFG_NOINHERIT))) {
+                /* get config flag from parent */
+                c->flags |= parent->flags & LYS_CONFIG_MASK;
+            }
+            c->module = module;
+            c->nodetype = LYS_CASE;
+            c->prev = (struct lys_node*)c;
+            lys_node_addchild(parent, module, (struct lys_node*)c, options);
+            parent = (struct lys_node*)c;
+        }
+        /* connect the child correctly */
+        if (!parent) {
+            if (module->data) {
+                module->data->prev->next = child;
+                child->prev = module->data->prev;
+                module->data->prev = child;
+            } else {
+                module->data = child;
+            }
+        } else {
+            pchild = lys_child(parent, child->nodetype);
+            assert(pchild);
+
+            child->parent = parent;
+            if (!(*pchild)) {
+                /* the only/first child of the parent */
+                *pchild = child;
+                iter = child;
+            } else {
+                /* add a new child at the end of parent's child list */
+                iter = (*pchild)->prev;
+                iter->next = child;
+                child->prev = iter;
+            }
+            while (iter->next) {
+                iter = iter->next;
+                iter->parent = parent;
+            }
+            (*pchild)->prev = iter;
+        }
+    }
+    lys_children_changed(ctx);
+
+    /* check config value (but ignore them in groupings and augments) */
+    for (iter = parent; iter && !(iter->nodetype & (LYS_GROUPING | LYS_AUGMENT | LYS_EXT)); iter = iter->parent);
+    if (parent && !iter) {
+        for (iter = child; iter && !(iter->nodetype & (LYS_NOTIF | LYS_INPUT | LYS_OUTPUT | LYS_RPC)); iter = iter->parent);
+        if (!iter && (parent->flags & LYS_CONFIG_R) && (child->flags & LYS_CONFIG_W)) {
+            LOGVAL(ctx, LYE_INARG, LY_VLOG_LYS, child, "true", "config");
+            LOGVAL(ctx, LYE_SPEC, LY_VLOG_PREV, NULL, "State nodes cannot have configuration nodes as children.");
+            return EXIT_FAILURE;
+        }
+    }
+
+    /* create implicit input/output nodes to have available them as possible target for augment */
+    if ((child->nodetype & (LYS_RPC | LYS_ACTION)) && !child->child) {
+        in = calloc(1, sizeof *in);
+        out = calloc(1, sizeof *out);
+        if (!in || !out) {
+            LOGMEM(ctx);
+            free(in);
+            free(out);
+            return EXIT_FAILURE;
+        }
+        in->nodetype = LYS_INPUT;
+        in->name = lydict_insert(child->module->ctx, "input", 5);
+        out->nodetype = LYS_OUTPUT;
+        out->name = lydict_insert(child->module->ctx, "output", 6);
+        in->module = out->module = child->module;
+        in->parent = out->parent = child;
+        in->flags = out->flags = LYS_IMPLICIT;
+        in->next = (struct lys_node *)out;
+        in->prev = (struct lys_node *)out;
+        out->prev = (struct lys_node *)in;
+        child->child = (struct lys_node *)in;
+    }
+    return EXIT_SUCCESS;
+}
+
+static const struct lys_module *
+lys_parse_netconf_hack(struct lys_module *mod)
+{
+    /* hack for NETCONF's edit-config's operation attribute. It is not defined in the schema, but since libyang
+     * implements YANG metadata (annotations), we need its definition. Because the ietf-netconf schema is not the
+     * internal part of libyang, we cannot add the annotation into the schema source, but we do it here to have
+     * the anotation definitions available in the internal schema structure. There is another hack in schema
+     * printers to do not print this internally added annotation. */
+    if (mod && ly_strequal(mod->name, "ietf-netconf", 0)) {
+        if (lyp_add_ietf_netconf_annotations_config(mod)) {
+            lys_free(mod, NULL, 1, 1);
+            return NULL;
+        }
+    }
+
+    return mod;
+}
+
+const struct lys_module *
+lys_parse_mem_(struct ly_ctx *ctx, const char *data, LYS_INFORMAT format, const char *revision, int internal, int implement)
+{
+    char *enlarged_data = NULL;
+    struct lys_module *mod = NULL;
+    struct ly_stats_phase_prev phase;
+    unsigned int len;
+
+    if (!ctx || !data) {
+        LOGARG;
+        return NULL;
+    }
+
+    if (!internal && format == LYS_IN_YANG) {
+        /* enlarge data by 2 bytes for flex */
+        len = strlen(data);
+        enlarged_data = malloc((len + 2) * sizeof *enlarged_data);
+        LY_CHECK_ERR_RETURN(!enlarged_data, LOGMEM(ctx), NULL);
+        memcpy(enlarged_data, data, len);
+        enlarged_data[len] = enlarged_data[len + 1] = '\0';
+        data = enlarged_data;
+    }
+
+    LY_STATS_ADD(ctx, schema_loads, 1);
+    ly_stats_phase_enter(ctx, LY_STATS_PHASE_PARSE, &phase);
+    switch (format) {
+    case LYS_IN_YIN:
+        mod = yin_read_module(ctx, data, revision, implement);
+        break;
+    case LYS_IN_YANG:
+        mod = yang_read_module(ctx, data, 0, revision, implement);
+        break;
+    default:
+        LOGERR(ctx, LY_EINVAL, "Invalid schema input format.");
+        break;
+    }
+    ly_stats_phase_leave(&phase);
+
+    free(enlarged_data);
+
+    return lys_parse_netconf_hack(mod);
+}
+
+const struct lys_module *
+lys_parse_yin_(struct ly_ctx *ctx, struct lyxml_elem *yin, const char *revision, int implement)
+{
+    return lys_parse_netconf_hack(yin_read_module_(ctx, yin, revision, implement));
+}
+
+API const struct lys_module *
+lys_parse_mem(struct ly_ctx *ctx, const char *data, LYS_INFORMAT format)
+{
+    return lys_parse_mem_(ctx, data, format, NULL, 0, 1);
+}
+
+struct lys_submodule *
+lys_sub_parse_mem(struct lys_module *module, const char *data, LYS_INFORMAT format, struct unres_schema *unres)
+{
+    char *enlarged_data = NULL;
+    struct lys_submodule *submod = NULL;
+    struct ly_stats_phase_prev phase;
+    unsigned int len;
+
+    assert(module);
+    assert(data);
+
+    if (format == LYS_IN_YANG) {
+        /* enlarge data by 2 bytes for flex */
+        len = strlen(data);
+        enlarged_data = malloc((len + 2) * sizeof *enlarged_data);
+        LY_CHECK_ERR_RETURN(!enlarged_data, LOGMEM(module->ctx), NULL);
+        memcpy(enlarged_data, data, len);
+        enlarged_data[len] = enlarged_data[len + 1] = '\0';
+        data = enlarged_data;
+    }
+
+    /* get the main module */
+    module = lys_main_module(module);
+
+    LY_STATS_ADD(module->ctx, schema_loads, 1);
+    ly_stats_phase_enter(module->ctx, LY_STATS_PHASE_PARSE, &phase);
+    switch (format) {
+    case LYS_IN_YIN:
+        submod = yin_read_submodule(module, data, unres);
+        break;
+    case LYS_IN_YANG:
+        submod = yang_read_submodule(module, data, 0, unres);
+        break;
+    default:
+        assert(0);
+        break;
+    }
+    ly_stats_phase_leave(&phase);
+
+    free(enlarged_data);
+    return submod;
+}
+
+API const struct lys_module *
+lys_parse_path(struct ly_ctx *ctx, const char *path, LYS_INFORMAT format)
+{
+    int fd;
+    const struct lys_module *ret;
+    const char *rev, *dot, *filename;
+    size_t len;
+
+    if (!ctx || !path) {
+        LOGARG;
+        return NULL;
+    }
+
+    fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        LOGERR(ctx, LY_ESYS, "Opening file \"%s\" failed (%s).", path, strerror(errno));
+        return NULL;
+    }
+
+    ret = lys_parse_fd(ctx, fd, format);
+    close(fd);
+
+    if (!ret) {
+        /* error */
+        return NULL;
+    }
+
+    /* check that name and revision match filename */
+    filename = strrchr(path, '/');
+    if (!filename) {
+        filename = path;
+    } else {
+        filename++;
+    }
+    rev = strchr(filename, '@');
+    dot = strrchr(filename, '.');
+
+    /* name */
+    len = strlen(ret->name);
+    if (strncmp(filename, ret->name, len) ||
+            ((rev && rev != &filename[len]) || (!rev && dot != &filename[len]))) {
+        LOGWRN(ctx, "File name \"%s\" does not match module name \"%s\".", filename, ret->name);
+    }
+    if (rev) {
+        len = dot - ++rev;
+        if (!ret->rev_size || len != 10 || strncmp(ret->rev[0].date, rev, len)) {
+            LOGWRN(ctx, "File name \"%s\" does not match module revision \"%s\".", filename,
+                   ret->rev_size ? ret->rev[0].date : "none");
+        }
+    }
+
+    if (!ret->filepath) {
+        /* store URI */
+        char rpath[PATH_MAX];
+        if (realpath(path, rpath) != NULL) {
+            ((struct lys_module *)ret)->filepath = lydict_insert(ctx, rpath, 0);
+        } else {
+            ((struct lys_module *)ret)->filepath = lydict_insert(ctx, path, 0);
+        }
+    }
+
+    return ret;
+}
+
+API const struct lys_module *
+lys_parse_fd(struct ly_ctx *ctx, int fd, LYS_INFORMAT format)
+{
+    return lys_parse_fd_(ctx, fd, format, NULL, 1);
+}
+
+static void
+lys_parse_set_filename(struct ly_ctx *ctx, const char **filename, int fd)
+{
+#ifdef __APPLE__
+    char path[MAXPATHLEN];
+#else
+    int len;
+    char path[PATH_MAX], proc_path[32];
+#endif
+
+#ifdef __APPLE__
+    if (fcntl(fd, F_GETPATH, path) != -1) {
+        *filename = lydict_insert(ctx, path, 0);
+    }
+#else
+    /* get URI if there is /proc */
+    sprintf(proc_path, "/proc/self/fd/%d", fd);
+    if ((len = readlink(proc_path, path, PATH_MAX - 1)) > 0) {
+        *filename = lydict_insert(ctx, path, len);
+    }
+#endif
+}
+
+const struct lys_module *
+lys_parse_fd_(struct ly_ctx *ctx, int fd, LYS_INFORMAT format, const char *revision, int implement)
+{
+    const struct lys_module *module;
+    size_t length;
+    char *addr;
+
+    if (!ctx || fd < 0) {
+        LOGARG;
+        return NULL;
+    }
+
+    if (lyp_mmap(ctx, fd, format == LYS_IN_YANG ? 1 : 0, &length, (void **)&addr)) {
+        LOGERR(ctx, LY_ESYS, "Mapping file descriptor into memory failed (%s()).", __func__);
+        return NULL;
+    } else if (!addr) {
+        LOGERR(ctx, LY_EINVAL, "Empty schema file.");
+        return NULL;
+    }
+
+    module = lys_parse_mem_(ctx, addr, format, revision, 1, implement);
+    lyp_munmap(addr, length);
+
+    if (module && !module->filepath) {
+        lys_parse_set_filename(ctx, (const char **)&module->filepath, fd);
+    }
+
+    return module;
+}
+
+struct lys_submodule *
+lys_sub_parse_fd(struct lys_module *module, int fd, LYS_INFORMAT format, struct unres_schema *unres)
+{
+    struct lys_submodule *submodule;
+    size_t length;
+    char *addr;
+
+    assert(module);
+    assert(fd >= 0);
+
+    if (lyp_mmap(module->ctx, fd, format == LYS_IN_YANG ? 1 : 0, &length, (void **)&addr)) {
+        LOGERR(module->ctx, LY_ESYS, "Mapping file descriptor into memory failed (%s()).", __func__);
+        return NULL;
+    } else if (!addr) {
+        LOGERR(module->ctx, LY_EINVAL, "Empty submodule schema file.");
+        return NULL;
+    }
+
+    /* get the main module */
+    module = lys_main_module(module);
+
+    switch (format) {
+    case LYS_IN_YIN:
+        submodule = yin_read_submodule(module, addr, unres);
+        break;
+    case LYS_IN_YANG:
+        submodule = yang_read_submodule(module, addr, 0, unres);
+        break;
+    default:
+        LOGINT(module->ctx);
+        return NULL;
+    }
+
+    lyp_munmap(addr, length);
+
+    if (submodule && !submodule->filepath) {
+        lys_parse_set_filename(module->ctx, (const char **)&submodule->filepath, fd);
+    }
+
+    return submodule;
+
+}
+
+/**
+ * @brief Learn whether a file can contain a (sub)module and get its format.
+ *
+ * @param[in] fname File name.
+ * @param[in] name Name of the (sub)module, NULL for any.
+ * @param[in] len Length of \p name.
+ * @param[out] format Format of the file.
+ * @return 1 if the file can contain the (sub)module, 0 otherwise.
+ */
+static int
+lys_search_localfile_file(const char *fname, const char *name, size_t len, LYS_INFORMAT *format)
+{
+    size_t flen;
+
+    if (name && (strncmp(name, fname, len) || ((fname[len] != '.') && (fname[len] != '@')))) {
+        /* different filename than the module we search for */
+        return 0;
+    }
+
+    /* get type according to filename suffix */
+    flen = strlen(fname);
+    if ((flen >= 4) && !strcmp(&fname[flen - 4], ".yin")) {
+        *format = LYS_IN_YIN;
+    } else if ((flen >= 5) && !strcmp(&fname[flen - 5], ".yang")) {
+        *format = LYS_IN_YANG;
+    } else {
+        /* not supportde suffix/file format */
+        return 0;
+    }
+
+    return 1;
+}
+
+/**
+ * @brief Compare a found file with the best one found so far.
+ *
+ * @param[in] fname Name of the found file, it starts with the (sub)module name.
+ * @param[in] len Length of the (sub)module name.
+ * @param[in] revision Searched revision, NULL for the newest one.
+ * @param[in] match_name Path of the best file found so far, NULL if none.
+ * @param[in] match_len Offset in \p match_name after the (sub)module name.
+ * @return 0 if \p fname is not better, 1 if it is the new best file, 2 if it is the exact revision.
+ */
+static int
+lys_search_localfile_cmp(const char *fname, size_t len, const char *revision, const char *match_name, size_t match_len)
+{
+    if (revision) {
+        /* we look for the specific revision, try to get it from the filename */
+        if (fname[len] == '@') {
+            /* check revision from the filename */
+            if (strncmp(revision, &fname[len + 1], strlen(revision))) {
+                /* another revision */
+                return 0;
+            }
+            /* exact revision */
+            return 2;
+        }
+        /* continue trying to find exact revision match, use this only if not found */
+        return 1;
+    }
+
+    /* remember the revision and try to find the newest one */
+    if (match_name) {
+        if ((fname[len] != '@') || lyp_check_date(NULL, &fname[len + 1])) {
+            return 0;
+        } else if ((match_name[match_len] == '@') &&
+                (strncmp(&match_name[match_len + 1], &fname[len + 1], LY_REV_SIZE - 1) >= 0)) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/**
+ * @brief Callback for a file found by lys_search_dirs().
+ *
+ * @param[in,out] path Path of the file, the callback can take it and set it to NULL.
+ * @param[in] dir_len Length of the directory part of \p path, without the separator.
+ * @param[in] format Format of the file.
+ * @param[in] data Callback data.
+ * @return 0 to continue, 1 to stop the search, -1 on error.
+ */
+typedef int (*lys_search_file_clb)(char **path, size_t dir_len, LYS_INFORMAT format, void *data);
+
+/**
+ * @brief Go through all the files in the search directories that can contain a (sub)module.
+ *
+ * @param[in] searchpaths Search paths, searched recursively.
+ * @param[in] cwd Whether to search also in the current working directory (not recursively).
+ * @param[in] name Name of the (sub)module the files are searched for, NULL for any.
+ * @param[in] file_clb Callback called for every found file.
+ * @param[in] data Callback data.
+ * @return EXIT_SUCCESS on success, EXIT_FAILURE on error.
+ */
+static int
+lys_search_dirs(const char * const *searchpaths, int cwd, const char *name, lys_search_file_clb file_clb, void *data)
+{
+    size_t len = 0, dir_len;
+    int i, implicit_cwd = 0, ret = EXIT_FAILURE, r;
+    char *wd, *wn = NULL;
+    DIR *dir = NULL;
+    struct dirent *file;
+    LYS_INFORMAT format_aux;
+    unsigned int u;
+    struct ly_set *dirs;
+    struct stat st;
+
+    /* start to fill the dir fifo with the context's search path (if set)
+     * and the current working directory */
+    dirs = ly_set_new();
+    if (!dirs) {
+        LOGMEM(NULL);
+        return EXIT_FAILURE;
+    }
+
+    if (name) {
+        len = strlen(name);
+    }
+    if (cwd) {
+        wd = get_current_dir_name();
+        if (!wd) {
+            LOGMEM(NULL);
+            goto cleanup;
+        } else {
+            /* add implicit current working directory (./) to be searched,
+             * this directory is not searched recursively */
+            if (ly_set_add(dirs, wd, 0) == -1) {
+                goto cleanup;
+            }
+            implicit_cwd = 1;
+        }
+    }
+    if (searchpaths) {
+        for (i = 0; searchpaths[i]; i++) {
+            /* check for duplicities with the implicit current working directory */
+            if (implicit_cwd && !strcmp(dirs->set.g[0], searchpaths[i])) {
+                implicit_cwd = 0;
+                continue;
+            }
+            wd = strdup(searchpaths[i]);
+            if (!wd) {
+                LOGMEM(NULL);
+                goto cleanup;
+            } else if (ly_set_add(dirs, wd, 0) == -1) {
+                goto cleanup;
+            }
+        }
+    }
+    wd = NULL;
+
+    /* start searching */
+    while (dirs->number) {
+        free(wd);
+        free(wn); wn = NULL;
+
+        wd = (char *)dirs->set.g[dirs->number - 1];
+        ly_set_rm_index(dirs, dirs->number - 1);
+        LOGVRB("Searching for \"%s\" in %s.", (name ? name : "(sub)modules"), wd);
+
+        if (dir) {
+            closedir(dir);
+        }
+        dir = opendir(wd);
+        dir_len = strlen(wd);
+        if (!dir) {
+            LOGWRN(NULL, "Unable to open directory \"%s\" for searching (sub)modules (%s).", wd, strerror(errno));
+        } else {
+            while ((file = readdir(dir))) {
+                if (!strcmp(".", file->d_name) || !strcmp("..", file->d_name)) {
+                    /* skip . and .. */
+                    continue;
+                }
+                free(wn);
+                if (asprintf(&wn, "%s/%s", wd, file->d_name) == -1) {
+                    LOGMEM(NULL);
+                    goto cleanup;
+                }
+                if (stat(wn, &st) == -1) {
+                    LOGWRN(NULL, "Unable to get information about \"%s\" file in \"%s\" when searching for (sub)modules (%s)",
+                           file->d_name, wd, strerror(errno));
+                    continue;
+                }
+                if (S_ISDIR(st.st_mode) && (dirs->number || !implicit_cwd)) {
+                    /* we have another subdirectory in searchpath to explore,
+                     * subdirectories are not taken into account in current working dir (dirs->set.g[0]) */
+                    if (ly_set_add(dirs, wn, 0) == -1) {
+                        goto cleanup;
+                    }
+                    /* continue with the next item in current directory */
+                    wn = NULL;
+                    continue;
+                } else if (!S_ISREG(st.st_mode)) {
+                    /* not a regular file (note that we see the target of symlinks instead of symlinks */
+                    continue;
+                }
+
+                /* here we know that the item is a file which can contain a module */
+                if (!lys_search_localfile_file(file->d_name, name, len, &format_aux)) {
+                    continue;
+                }
+
+                r = file_clb(&wn, dir_len, format_aux, data);
+                if (r == -1) {
+                    goto cleanup;
+                } else if (r) {
+                    goto success;
+                }
+            }
+        }
+    }
+
+success:
+    ret = EXIT_SUCCESS;
+
+cleanup:
+    free(wn);
+    free(wd);
+    if (dir) {
+        closedir(dir);
+    }
+    for (u = 0; u < dirs->number; u++) {
+        free(dirs->set.g[u]);
+    }
+    ly_set_free(dirs);
+
+    return ret;
+}
+
+/* state of lys_search_localfile() */
+struct lys_search_match {
+    const char *name;
+    size_t len;
+    const char *revision;
+    char *match_name;
+    size_t match_len;
+    LYS_INFORMAT match_format;
+};
+
+static int
+lys_search_localfile_clb(char **path, size_t dir_len, LYS_INFORMAT format, void *data)
+{
+    struct lys_search_match *match = (struct lys_search_match *)data;
+    int r;
+
+    r = lys_search_localfile_cmp(*path + dir_len + 1, match->len, match->revision, match->match_name, match->match_len);
+    if (!r) {
+        return 0;
+    }
+
+    free(match->match_name);
+    match->match_name = *path;
+    *path = NULL;
+    match->match_len = dir_len + 1 + match->len;
+    match->match_format = format;
+
+    /* stop on the exact revision */
+    return (r == 2) ? 1 : 0;
+}
+
+API int
+lys_search_localfile(const char * const *searchpaths, int cwd, const char *name, const char *revision, char **localfile, LYS_INFORMAT *format)
+{
+    struct lys_search_match match;
+
+    if (!localfile) {
+        LOGARG;
+        return EXIT_FAILURE;
+    }
+
+    memset(&match, 0, sizeof match);
+    match.name = name;
+    match.len = strlen(name);
+    match.revision = revision;
+    if (lys_search_dirs(searchpaths, cwd, name, lys_search_localfile_clb, &match)) {
+        free(match.match_name);
+        return EXIT_FAILURE;
+    }
+
+    (*localfile) = match.match_name;
+    if (format) {
+        (*format) = match.match_format;
+    }
+    return EXIT_SUCCESS;
+}
+
+/* file in the search directories index, see lys_search_index_find() */
+struct lys_search_file {
+    char *path;
+    size_t dir_len;
+    LYS_INFORMAT format;
+    uint32_t next;              /* next file with the same (sub)module name, in the search order */
+};
+
+/* (sub)module name in the search directories index */
+struct lys_search_name {
+    const char *name;           /* points into the path of the first file */
+    size_t len;
+    uint32_t first;             /* index of the first and the last file with this name */
+    uint32_t last;
+};
+
+struct lys_search_index {
+    char *cwd;                  /* current working directory searched, NULL if not */
+    struct lys_search_file *files;
+    uint32_t count;
+    uint32_t size;
+    struct hash_table *names;
+};
+
+#define LYS_SEARCH_INDEX_NONE UINT32_MAX
+
+static int
+lys_search_name_equal(void *val1_p, void *val2_p, int UNUSED(mod), void *UNUSED(cb_data))
+{
+    struct lys_search_name *name1 = (struct lys_search_name *)val1_p, *name2 = (struct lys_search_name *)val2_p;
+
+    return (name1->len == name2->len) && !strncmp(name1->name, name2->name, name1->len);
+}
+
+static uint32_t
+lys_search_name_hash(const char *name, size_t len)
+{
+    uint32_t hash;
+
+    hash = dict_hash_multi(0, name, len);
+    return dict_hash_multi(hash, NULL, 0);
+}
+
+/* add the file under all the names it can be found for (the name is followed by '.' or '@') */
+static int
+lys_search_index_clb(char **path, size_t dir_len, LYS_INFORMAT format, void *data)
+{
+    struct lys_search_index *index = (struct lys_search_index *)data;
+    struct lys_search_file *file;
+    struct lys_search_name rec, *match;
+    const char *fname, *ptr;
+    char *own_path = NULL;
+    uint32_t hash;
+    void *mem;
+
+    fname = *path + dir_len + 1;
+    for (ptr = fname; (ptr = strpbrk(ptr, ".@")); ++ptr) {
+        if (ptr == fname) {
+            continue;
+        }
+        if (index->count == index->size) {
+            index->size = index->size ? index->size * 2 : 64;
+            mem = realloc(index->files, index->size * sizeof *index->files);
+            LY_CHECK_ERR_RETURN(!mem, LOGMEM(NULL), -1);
+            index->files = mem;
+        }
+        if (!own_path) {
+            /* the path is shared by all the names of the file, only the first record owns it */
+            own_path = *path;
+        }
+        file = &index->files[index->count];
+        file->path = own_path;
+        file->dir_len = dir_len;
+        file->format = format;
+        file->next = LYS_SEARCH_INDEX_NONE;
+
+        rec.name = fname;
+        rec.len = ptr - fname;
+        rec.first = rec.last = index->count;
+        hash = lys_search_name_hash(rec.name, rec.len);
+        if (!lyht_find(index->names, &rec, hash, (void **)&match)) {
+            index->files[match->last].next = index->count;
+            match->last = index->count;
+        } else if (lyht_insert(index->names, &rec, hash, NULL)) {
+            return -1;
+        }
+        ++index->count;
+        *path = NULL;
+
+        if (*ptr == '@') {
+            /* no module name can contain '@' */
+            break;
+        }
+    }
+
+    return 0;
+}
+
+void
+lys_search_index_free(struct lys_search_index *index)
+{
+    uint32_t i;
+
+    if (!index) {
+        return;
+    }
+
+    for (i = 0; i < index->count; ++i) {
+        if (!i || (index->files[i].path != index->files[i - 1].path)) {
+            free(index->files[i].path);
+        }
+    }
+    free(index->files);
+    lyht_free(index->names);
+    free(index->cwd);
+    free(index);
+}
+
+/**
+ * @brief Build the index of all the (sub)module files in the search directories.
+ *
+ * @param[in] searchpaths Search paths.
+ * @param[in] cwd Whether to search also in the current working directory.
+ * @return Built index, NULL on error.
+ */
+static struct lys_search_index *
+lys_search_index_new(const char * const *searchpaths, int cwd)
+{
+    struct lys_search_index *index;
+
+    index = calloc(1, sizeof *index);
+    LY_CHECK_ERR_RETURN(!index, LOGMEM(NULL), NULL);
+
+    index->names = lyht_new(256, sizeof(struct lys_search_name), lys_search_name_equal, NULL, 1);
+    LY_CHECK_ERR_GOTO(!index->names, LOGMEM(NULL), error);
+    if (cwd) {
+        index->cwd = get_current_dir_name();
+        LY_CHECK_ERR_GOTO(!index->cwd, LOGMEM(NULL), error);
+    }
+
+    if (lys_search_dirs(searchpaths, cwd, NULL, lys_search_index_clb, index)) {
+        goto error;
+    }
+
+    return index;
+
+error:
+    lys_search_index_free(index);
+    return NULL;
+}
+
+int
+lys_search_localfile_index(struct lys_search_index **index, const char * const *searchpaths, int cwd,
+                           const char *name, const char *revision, char **localfile, LYS_INFORMAT *format)
+{
+    struct lys_search_name rec, *match;
+    struct lys_search_file *file;
+    const char *match_name = NULL;
+    size_t match_len = 0;
+    LYS_INFORMAT match_format = 0;
+    uint32_t i;
+    char *wd;
+    int r;
+
+    if (*index && cwd) {
+        /* the index is valid only for the same working directory */
+        wd = get_current_dir_name();
+        if (!wd || !(*index)->cwd || strcmp(wd, (*index)->cwd)) {
+            lys_search_index_free(*index);
+            *index = NULL;
+        }
+        free(wd);
+    } else if (*index && (*index)->cwd) {
+        lys_search_index_free(*index);
+        *index = NULL;
+    }
+
+    if (!*index) {
+        *index = lys_search_index_new(searchpaths, cwd);
+        if (!*index) {
+            /* search directly */
+            return lys_search_localfile(searchpaths, cwd, name, revision, localfile, format);
+        }
+    }
+
+    rec.name = name;
+    rec.len = strlen(name);
+    if (!lyht_find((*index)->names, &rec, lys_search_name_hash(rec.name, rec.len), (void **)&match)) {
+        for (i = match->first; i != LYS_SEARCH_INDEX_NONE; i = file->next) {
+            file = &(*index)->files[i];
+            r = lys_search_localfile_cmp(file->path + file->dir_len + 1, rec.len, revision, match_name, match_len);
+            if (!r) {
+                continue;
+            }
+
+            match_name = file->path;
+            match_len = file->dir_len + 1 + rec.len;
+            match_format = file->format;
+            if (r == 2) {
+                break;
+            }
+        }
+    }
+
+    if (!match_name) {
+        /* a file may have been added since the index was built, search directly */
+        if (lys_search_localfile(searchpaths, cwd, name, revision, localfile, format)) {
+            return EXIT_FAILURE;
+        }
+        if (*localfile) {
+            /* the index is outdated, rebuild it next time */
+            lys_search_index_free(*index);
+            *index = NULL;
+        }
+        return EXIT_SUCCESS;
+    } else if (access(match_name, R_OK)) {
+        /* the file was removed, search directly and rebuild the index next time */
+        lys_search_index_free(*index);
+        *index = NULL;
+        return lys_search_localfile(searchpaths, cwd, name, revision, localfile, format);
+    }
+
+    *localfile = strdup(match_name);
+    LY_CHECK_ERR_RETURN(!*localfile, LOGMEM(NULL), EXIT_FAILURE);
+    if (format) {
+        *format = match_format;
+    }
+    return EXIT_SUCCESS;
+}
+
+int
+lys_ext_iter(struct lys_ext_instance **ext, uint8_t ext_size, uint8_t start, LYEXT_SUBSTMT substmt)
+{
+    unsigned int u;
+
+    for (u = start; u < ext_size; u++) {
+        if (ext[u]->insubstmt == substmt) {
+            return u;
+        }
+    }
+
+    return -1;
+}
+
+/*
+ * duplicate extension instance
+ */
+int
+lys_ext_dup(struct ly_ctx *ctx, struct lys_module *mod, struct lys_ext_instance **orig, uint8_t size, void *parent,
+            LYEXT_PAR parent_type, struct lys_ext_instance ***new, int shallow, struct unres_schema *unres)
+{
+    int i;
+    uint8_t u = 0;
+    struct lys_ext_instance **result;
+    struct unres_ext *info, *info_orig;
+    size_t len;
+
+    assert(new);
+
+    if (!size) {
+        if (orig) {
+            LOGINT(ctx);
+            return EXIT_FAILURE;
+        }
+        (*new) = NULL;
+        return EXIT_SUCCESS;
+    }
+
+    (*new) = result = calloc(size, sizeof *result);
+    LY_CHECK_ERR_RETURN(!result, LOGMEM(ctx), EXIT_FAILURE);
+    for (u = 0; u < size; u++) {
+        if (orig[u]) {
+            /* resolved extension instance, just duplicate it */
+            switch(orig[u]->ext_type) {
+            case LYEXT_FLAG:
+                result[u] = malloc(sizeof(struct lys_ext_instance));
+                LY_CHECK_ERR_GOTO(!result[u], LOGMEM(ctx), error);
+                break;
+            case LYEXT_COMPLEX:
+                len = ((struct lyext_plugin_complex*)orig[u]->def->plugin)->instance_size;
+                result[u] = calloc(1, len);
+                LY_CHECK_ERR_GOTO(!result[u], LOGMEM(ctx), error);
+
+                ((struct lys_ext_instance_complex*)result[u])->substmt = ((struct lyext_plugin_complex*)orig[u]->def->plugin)->substmt;
+                /* TODO duplicate data in extension instance content */
+                memcpy((void*)result[u] + sizeof(**orig), (void*)orig[u] + sizeof(**orig), len - sizeof(**orig));
+                break;
+            }
+            /* generic part */
+            result[u]->def = orig[u]->def;
+            result[u]->flags = LYEXT_OPT_CONTENT;
+            result[u]->arg_value = lydict_insert(ctx, orig[u]->arg_value, 0);
+            result[u]->parent = parent;
+            result[u]->parent_type = parent_type;
+            result[u]->insubstmt = orig[u]->insubstmt;
+            result[u]->insubstmt_index = orig[u]->insubstmt_index;
+            result[u]->ext_type = orig[u]->ext_type;
+            result[u]->priv = NULL;
+            result[u]->nodetype = LYS_EXT;
+            result[u]->module = mod;
+
+            /* extensions */
+            result[u]->ext_size = orig[u]->ext_size;
+            if (lys_ext_dup(ctx, mod, orig[u]->ext, orig[u]->ext_size, result[u],
+                            LYEXT_PAR_EXTINST, &result[u]->ext, shallow, unres)) {
+                goto error;
+            }
+
+            /* in case of shallow copy (duplication for deviation), duplicate only the link to private data
+             * in a new copy, otherwise (grouping instantiation) do not duplicate the private data */
+            if (shallow) {
+                result[u]->priv = orig[u]->priv;
+            }
+        } else {
+            /* original extension is not yet resolved, so duplicate it in unres */
+            i = unres_schema_find(unres, -1, &orig, UNRES_EXT);
+            if (i == -1) {
+                /* extension not found in unres */
+                LOGINT(ctx);
+                goto error;
+            }
+            info_orig = unres->str_snode[i];
+            info = malloc(sizeof *info);
+            LY_CHECK_ERR_GOTO(!info, LOGMEM(ctx), error);
+            info->datatype = info_orig->datatype;
+            if (info->datatype == LYS_IN_YIN) {
+                info->data.yin = lyxml_dup_elem(ctx, info_orig->data.yin, NULL, 1);
+            } /* else TODO YANG */
+            info->parent = parent;
+            info->mod = mod;
+            info->parent_type = parent_type;
+            info->ext_index = u;
+            if (unres_schema_add_node(info->mod, unres, new, UNRES_EXT, (struct lys_node *)info) == -1) {
+                goto error;
+            }
+        }
+    }
+
+    return EXIT_SUCCESS;
+
+error:
+    (*new) = NULL;
+    lys_extension_instances_free(ctx, result, u, NULL);
+    return EXIT_FAILURE;
+}
+
+static struct lys_restr *
+lys_restr_dup(struct lys_module *mod, struct lys_restr *old, int size, int shallow, struct unres_schema *unres)
+{
+    struct lys_restr *result;
+    int i;
+
+    if (!size) {
+        return NULL;
+    }
+
+    result = calloc(size, sizeof *result);
+    LY_CHECK_ERR_RETURN(!result, LOGMEM(mod->ctx), NULL);
+
+    for (i = 0; i < size; i++) {
+        result[i].ext_size = old[i].ext_size;
+        lys_ext_dup(mod->ctx, mod, old[i].ext, old[i].ext_size, &result[i], LYEXT_PAR_RESTR, &result[i].ext, shallow, unres);
+        result[i].expr = lydict_insert(mod->ctx, old[i].expr, 0);
+        result[i].dsc = lydict_insert(mod->ctx, old[i].dsc, 0);
+        result[i].ref = lydict_insert(mod->ctx, old[i].ref, 0);
+        result[i].eapptag = lydict_insert(mod->ctx, old[i].eapptag, 0);
+        result[i].emsg = lydict_insert(mod->ctx, old[i].emsg, 0);
+    }
+
+    return result;
+}
+
+void
+lys_restr_free(struct ly_ctx *ctx, struct lys_restr *restr,
+               void (*private_destructor)(const struct lys_node *node, void *priv))
+{
+    assert(ctx);
+    if (!restr) {
+        return;
+    }
+
+    lys_extension_instances_free(ctx, restr->ext, restr->ext_size, private_destructor);
+    lydict_remove(ctx, restr->expr);
+    lydict_remove(ctx, restr->dsc);
+    lydict_remove(ctx, restr->ref);
+    lydict_remove(ctx, restr->eapptag);
+    lydict_remove(ctx, restr->emsg);
+#ifdef LY_ENABLED_CACHE
+    lyxp_expr_free(restr->expr_xpath);
+    ly_set_free(restr->deps);
+    free(restr->intv);
+#endif
+}
+
+API void
+lys_iffeature_free(struct ly_ctx *ctx, struct lys_iffeature *iffeature, uint8_t iffeature_size,
+                   int shallow, void (*private_destructor)(const struct lys_node *node, void *priv))
+{
+    uint8_t i;
+
+    for (i = 0; i < iffeature_size; ++i) {
+        lys_extension_instances_free(ctx, iffeature[i].ext, iffeature[i].ext_size, private_destructor);
+        if (!shallow) {
+            free(iffeature[i].expr);
+            free(iffeature[i].features);
+        }
+    }
+    free(iffeature);
+}
+
+#ifdef LY_ENABLED_CACHE
+
+static int
+lys_type_precompile_patterns(struct ly_ctx *ctx, struct lys_type *type)
+{
+    unsigned int u;
+
+    type->info.str.patterns_pcre = malloc(type->info.str.pat_count * 2 * sizeof *type->info.str.patterns_pcre);
+    LY_CHECK_ERR_RETURN(!type->info.str.patterns_pcre, LOGMEM(ctx), -1);
+    for (u = 0; u < type->info.str.pat_count; u++) {
+        if (lyp_precompile_pattern(ctx, &type->info.str.patterns[u].expr[1],
+                                   (pcre**)&type->info.str.patterns_pcre[2 * u],
+                                   (pcre_extra**)&type->info.str.patterns_pcre[2 * u + 1])) {
+            /* the patterns compiled so far must be freed */
+            while (u--) {
+                pcre_free((pcre*)type->info.str.patterns_pcre[2 * u]);
+                pcre_free_study((pcre_extra*)type->info.str.patterns_pcre[2 * u + 1]);
+            }
+            free(type->info.str.patterns_pcre);
+            type->info.str.patterns_pcre = NULL;
+            return -1;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
+
+struct lys_type_eff *
+lys_type_eff(struct ly_ctx *ctx, struct lys_type *type)
+{
+    struct lys_type_eff *eff = NULL;
+    struct lys_type *t;
+    struct len_ran_cmp *intv;
+    uint32_t count = 0, i;
+    unsigned int u;
+
+    if ((eff = LYS_TYPE_EFF(type))) {
+        return eff;
+    }
+
+    /* other threads may be validating with the same type */
+    pthread_mutex_lock(&ctx->regex_lock);
+    if (type->eff) {
+        goto cleanup;
+    }
+
+    if (resolve_len_ran_compiled(ctx, type, &intv)) {
+        goto cleanup;
+    }
+    if (type->base == LY_TYPE_STRING) {
+        for (t = type; t; t = (t->der ? &t->der->type : NULL)) {
+            if (t->info.str.pat_count && !t->info.str.patterns_pcre && lys_type_precompile_patterns(ctx, t)) {
+                goto cleanup;
+            }
+            count += t->info.str.pat_count;
+        }
+    }
+
+    eff = malloc(sizeof *eff + count * sizeof *eff->pat);
+    LY_CHECK_ERR_GOTO(!eff, LOGMEM(ctx), cleanup);
+    eff->base = type->base;
+    eff->intv = intv;
+    eff->parse = NULL;
+    eff->pat_count = count;
+
+    /* since YANG 1.1 allows restricted bits and enums, it is the first type with some explicit definitions */
+    t = type;
+    switch (type->base) {
+    case LY_TYPE_BITS:
+        for (; !t->info.bits.count; t = &t->der->type);
+        break;
+    case LY_TYPE_ENUM:
+        for (; !t->info.enums.count; t = &t->der->type);
+        break;
+    case LY_TYPE_UNION:
+        for (; !t->info.uni.count; t = &t->der->type);
+        break;
+    default:
+        break;
+    }
+    eff->info = t;
+
+    /* the patterns of the furthest typedef are checked first */
+    i = count;
+    for (t = type; i; t = &t->der->type) {
+        for (u = t->info.str.pat_count; u; --u) {
+            --i;
+            eff->pat[i].restr = &t->info.str.patterns[u - 1];
+            eff->pat[i].regex = t->info.str.patterns_pcre[2 * (u - 1)];
+            eff->pat[i].study = t->info.str.patterns_pcre[2 * (u - 1) + 1];
+        }
+    }
+
+    /* published only when complete, it is read without the lock */
+    atomic_store_explicit((void * _Atomic *)&type->eff, eff, memory_order_release);
+
+cleanup:
+    eff = type->eff;
+    pthread_mutex_unlock(&ctx->regex_lock);
+    return eff;
+}
+
+#endif
+
+API int
+lys_set_value_parser(const struct lys_node *node, lytype_parse_clb parse_clb)
+{
+    struct ly_ctx *ctx;
+    struct lys_type *type;
+    struct lys_tpdf *tpdf;
+#ifdef LY_ENABLED_CACHE
+    struct lys_type_eff *eff;
+#endif
+
+    if (!node || !(node->nodetype & (LYS_LEAF | LYS_LEAFLIST))) {
+        LOGARG;
+        return EXIT_FAILURE;
+    }
+    ctx = node->module->ctx;
+    type = &((struct lys_node_leaf *)node)->type;
+
+    switch (type->base) {
+    case LY_TYPE_STRING:
+        /* ietf-yang-types xpath1.0 values are transformed by the XML parser */
+        for (tpdf = type->der;
+             tpdf->module && (strcmp(tpdf->name, "xpath1.0") || strcmp(tpdf->module->name, "ietf-yang-types"));
+             tpdf = tpdf->type.der);
+        if (tpdf->module) {
+            break;
+        }
+        /* fallthrough */
+    case LY_TYPE_BOOL:
+    case LY_TYPE_DEC64:
+    case LY_TYPE_ENUM:
+    case LY_TYPE_INT8:
+    case LY_TYPE_INT16:
+    case LY_TYPE_INT32:
+    case LY_TYPE_INT64:
+    case LY_TYPE_UINT8:
+    case LY_TYPE_UINT16:
+    case LY_TYPE_UINT32:
+    case LY_TYPE_UINT64:
+#ifdef LY_ENABLED_CACHE
+        eff = lys_type_eff(ctx, type);
+        if (!eff) {
+            return EXIT_FAILURE;
+        }
+        eff->parse = parse_clb;
+        return EXIT_SUCCESS;
+#else
+        LOGERR(ctx, LY_EINVAL, "Specialized value parsers require libyang built with the cache.");
+        return EXIT_FAILURE;
+#endif
+    default:
+        break;
+    }
+
+    LOGERR(ctx, LY_EINVAL, "Values of \"%s\" cannot be parsed by a specialized parser.", node->name);
+    return EXIT_FAILURE;
+}
+
+/**
+ * @brief Learn whether an instantiated type can share the restrictions of the type in a grouping
+ * (#LY_CTX_SHARE_GROUPINGS). Leafrefs and unions are resolved for every instance.
+ */
+static int
+lys_type_shareable(struct lys_module *mod, struct lys_type *old, int in_grp, int shallow)
+{
+    if (!(mod->ctx->models.flags & LY_CTX_SHARE_GROUPINGS) || in_grp || shallow
+            || (old->value_flags & LY_VALUE_SHARED)) {
+        /* copies in groupings are owners for their own instances, the shallow copies of deviated nodes are
+         * always full, and there must be only one owner */
+        return 0;
+    }
+
+    switch (old->base) {
+    case LY_TYPE_BINARY:
+    case LY_TYPE_BITS:
+    case LY_TYPE_DEC64:
+    case LY_TYPE_ENUM:
+    case LY_TYPE_INT8:
+    case LY_TYPE_INT16:
+    case LY_TYPE_INT32:
+    case LY_TYPE_INT64:
+    case LY_TYPE_UINT8:
+    case LY_TYPE_UINT16:
+    case LY_TYPE_UINT32:
+    case LY_TYPE_UINT64:
+    case LY_TYPE_STRING:
+        return 1;
+    case LY_TYPE_IDENT:
+        /* only with all the bases resolved */
+        return old->info.ident.count ? 1 : 0;
+    default:
+        return 0;
+    }
+}
+
+static int
+lys_type_share(struct lys_module *mod, struct lys_type *new, struct lys_type *old)
+{
+#ifdef LY_ENABLED_CACHE
+    if ((old->base == LY_TYPE_STRING) && old->info.str.pat_count && !old->info.str.patterns_pcre) {
+        /* the patterns in groupings are not compiled, compile them once for all the instances */
+        if (lys_type_precompile_patterns(mod->ctx, old)) {
+            return -1;
+        }
+    }
+#else
+    (void)mod;
+#endif
+
+    new->info = old->info;
+    new->value_flags |= LY_VALUE_SHARED;
+    return EXIT_SUCCESS;
+}
+
+static int
+type_dup(struct lys_module *mod, struct lys_node *parent, struct lys_type *new, struct lys_type *old,
+         LY_DATA_TYPE base, int in_grp, int shallow, struct unres_schema *unres)
+{
+    int i;
+    unsigned int u;
+
+    switch (base) {
+    case LY_TYPE_BINARY:
+        if (old->info.binary.length) {
+            new->info.binary.length = lys_restr_dup(mod, old->info.binary.length, 1, shallow, unres);
+        }
+        break;
+
+    case LY_TYPE_BITS:
+        new->info.bits.count = old->info.bits.count;
+        if (new->info.bits.count) {
+            new->info.bits.bit = calloc(new->info.bits.count, sizeof *new->info.bits.bit);
+            LY_CHECK_ERR_RETURN(!new->info.bits.bit, LOGMEM(mod->ctx), -1);
+
+            for (u = 0; u < new->info.bits.count; u++) {
+                new->info.bits.bit[u].name = lydict_insert(mod->ctx, old->info.bits.bit[u].name, 0);
+                new->info.bits.bit[u].dsc = lydict_insert(mod->ctx, old->info.bits.bit[u].dsc, 0);
+                new->info.bits.bit[u].ref = lydict_insert(mod->ctx, old->info.bits.bit[u].ref, 0);
+                new->info.bits.bit[u].flags = old->info.bits.bit[u].flags;
+                new->info.bits.bit[u].pos = old->info.bits.bit[u].pos;
+                new->info.bits.bit[u].ext_size = old->info.bits.bit[u].ext_size;
+                if (lys_ext_dup(mod->ctx, mod, old->info.bits.bit[u].ext, old->info.bits.bit[u].ext_size,
+                                &new->info.bits.bit[u], LYEXT_PAR_TYPE_BIT,
+                                &new->info.bits.bit[u].ext, shallow, unres)) {
+                    return -1;
+                }
+            }
+        }
+        break;
+
+    case LY_TYPE_DEC64:
+        new->info.dec64.dig = old->info.dec64.dig;
+        new->info.dec64.div = old->info.dec64.div;
+        if (old->info.dec64.range) {
+            new->info.dec64.range = lys_restr_dup(mod, old->info.dec64.range, 1, shallow, unres);
+        }
+        break;
+
+    case LY_TYPE_ENUM:
+        new->info.enums.count = old->info.enums.count;
+        if (new->info.enums.count) {
+            new->info.enums.enm = calloc(new->info.enums.count, sizeof *new->info.enums.enm);
+            LY_CHECK_ERR_RETURN(!new->info.enums.enm, LOGMEM(mod->ctx), -1);
+
+            for (u = 0; u < new->info.enums.count; u++) {
+                new->info.enums.enm[u].name = lydict_insert(mod->ctx, old->info.enums.enm[u].name, 0);
+                new->info.enums.enm[u].dsc = lydict_insert(mod->ctx, old->info.enums.enm[u].dsc, 0);
+                new->info.enums.enm[u].ref = lydict_insert(mod->ctx, old->info.enums.enm[u].ref, 0);
+                new->info.enums.enm[u].flags = old->info.enums.enm[u].flags;
+                new->info.enums.enm[u].value = old->info.enums.enm[u].value;
+                new->info.enums.enm[u].ext_size = old->info.enums.enm[u].ext_size;
+                if (lys_ext_dup(mod->ctx, mod, old->info.enums.enm[u].ext, old->info.enums.enm[u].ext_size,
+                                &new->info.enums.enm[u], LYEXT_PAR_TYPE_ENUM,
+                                &new->info.enums.enm[u].ext, shallow, unres)) {
+                    return -1;
+                }
+            }
+        }
+        break;
+
+    case LY_TYPE_IDENT:
+        new->info.ident.count = old->info.ident.count;
+        if (old->info.ident.count) {
+            new->info.ident.ref = malloc(old->info.ident.count * sizeof *new->info.ident.ref);
+            LY_CHECK_ERR_RETURN(!new->info.ident.ref, LOGMEM(mod->ctx), -1);
+            memcpy(new->info.ident.ref, old->info.ident.ref, old->info.ident.count * sizeof *new->info.ident.ref);
+        } else {
+            /* there can be several unresolved base identities, duplicate them all */
+            i = -1;
+            do {
+                i = unres_schema_find(unres, i, old, UNRES_TYPE_IDENTREF);
+                if (i != -1) {
+                    if (unres_schema_add_str(mod, unres, new, UNRES_TYPE_IDENTREF, unres->str_snode[i]) == -1) {
+                        return -1;
+                    }
+                }
+                --i;
+            } while (i > -1);
+        }
+        break;
+
+    case LY_TYPE_INST:
+        new->info.inst.req = old->info.inst.req;
+        break;
+
+    case LY_TYPE_INT8:
+    case LY_TYPE_INT16:
+    case LY_TYPE_INT32:
+    case LY_TYPE_INT64:
+    case LY_TYPE_UINT8:
+    case LY_TYPE_UINT16:
+    case LY_TYPE_UINT32:
+    case LY_TYPE_UINT64:
+        if (old->info.num.range) {
+            new->info.num.range = lys_restr_dup(mod, old->info.num.range, 1, shallow, unres);
+        }
+        break;
+
+    case LY_TYPE_LEAFREF:
+        if (old->info.lref.path) {
+            new->info.lref.path = lydict_insert(mod->ctx, old->info.lref.path, 0);
+            new->info.lref.req = old->info.lref.req;
+            if (!in_grp && unres_schema_add_node(mod, unres, new, UNRES_TYPE_LEAFREF, parent) == -1) {
+                return -1;
+            }
+        }
+        break;
+
+    case LY_TYPE_STRING:
+        if (old->info.str.length) {
+            new->info.str.length = lys_restr_dup(mod, old->info.str.length, 1, shallow, unres);
+        }
+        if (old->info.str.pat_count) {
+            new->info.str.patterns = lys_restr_dup(mod, old->info.str.patterns, old->info.str.pat_count, shallow, unres);
+            new->info.str.pat_count = old->info.str.pat_count;
+#ifdef LY_ENABLED_CACHE
+            if (!in_grp && lys_type_precompile_patterns(mod->ctx, new)) {
+                return -1;
+            }
+#endif
+        }
+        break;
+
+    case LY_TYPE_UNION:
+        new->info.uni.has_ptr_type = old->info.uni.has_ptr_type;
+        new->info.uni.count = old->info.uni.count;
+        if (new->info.uni.count) {
+            new->info.uni.types = calloc(new->info.uni.count, sizeof *new->info.uni.types);
+            LY_CHECK_ERR_RETURN(!new->info.uni.types, LOGMEM(mod->ctx), -1);
+
+            for (u = 0; u < new->info.uni.count; u++) {
+                if (lys_type_dup(mod, parent, &(new->info.uni.types[u]), &(old->info.uni.types[u]), in_grp,
+                        shallow, unres)) {
+                    return -1;
+                }
+            }
+        }
+        break;
+
+    default:
+        /* nothing to do for LY_TYPE_BOOL, LY_TYPE_EMPTY */
+        break;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+struct yang_type *
+lys_yang_type_dup(struct lys_module *module, struct lys_node *parent, struct yang_type *old, struct lys_type *type,
+                  int in_grp, int shallow, struct unres_schema *unres)
+{
+    struct yang_type *new;
+
+    new = calloc(1, sizeof *new);
+    LY_CHECK_ERR_RETURN(!new, LOGMEM(module->ctx), NULL);
+    new->flags = old->flags;
+    new->base = old->base;
+    new->name = lydict_insert(module->ctx, old->name, 0);
+    new->type = type;
+    if (!new->name) {
+        LOGMEM(module->ctx);
+        goto error;
+    }
+    if (type_dup(module, parent, type, old->type, new->base, in_grp, shallow, unres)) {
+        new->type->base = new->base;
+        lys_type_free(module->ctx, new->type, NULL);
+        memset(&new->type->info, 0, sizeof new->type->info);
+        goto error;
+    }
+    return new;
+
+error:
+    free(new);
+    return NULL;
+}
+
+int
+lys_copy_union_leafrefs(struct lys_module *mod, struct lys_node *parent, struct lys_type *type, struct lys_type *prev_new,
+                        struct unres_schema *unres)
+{
+    struct lys_type new;
+    unsigned int i, top_type;
+    struct lys_ext_instance **ext;
+    uint8_t ext_size;
+    void *reloc;
+
+    if (!prev_new) {
+        /* this is the "top-level" type, meaning it is a real type and no typedef directly above */
+        top_type = 1;
+
+        memset(&new, 0, sizeof new);
+
+        new.base = type->base;
+        new.parent = (struct lys_tpdf *)parent;
+
+        prev_new = &new;
+    } else {
+        /* this is not top-level type, just a type of a typedef */
+        top_type = 0;
+    }
+
+    assert(type->der);
+    if (type->der->module) {
+        /* typedef, skip it, but keep the extensions */
+        ext_size = type->ext_size;
+        if (lys_ext_dup(mod->ctx, mod, type->ext, type->ext_size, prev_new, LYEXT_PAR_TYPE, &ext, 0, unres)) {
+            return -1;
+        }
+        if (prev_new->ext) {
+            reloc = realloc(prev_new->ext, (prev_new->ext_size + ext_size) * sizeof *prev_new->ext);
+            LY_CHECK_ERR_RETURN(!reloc, LOGMEM(mod->ctx), -1);
+            prev_new->ext = reloc;
+
+            memcpy(prev_new->ext + prev_new->ext_size, ext, ext_size * sizeof *ext);
+            free(ext);
+
+            prev_new->ext_size += ext_size;
+        } else {
+            prev_new->ext = ext;
+            prev_new->ext_size = ext_size;
+        }
+
+        if (lys_copy_union_leafrefs(mod, parent, &type->der->type, prev_new, unres)) {
+            return -1;
+        }
+    } else {
+        /* type, just make a deep copy */
+        switch (type->base) {
+        case LY_TYPE_UNION:
+            prev_new->info.uni.has_ptr_type = type->info.uni.has_ptr_type;
+            prev_new->info.uni.count = type->info.uni.count;
+            /* this cannot be a typedef anymore */
+            assert(prev_new->info.uni.count);
+
+            prev_new->info.uni.types = calloc(prev_new->info.uni.count, sizeof *prev_new->info.uni.types);
+            LY_CHECK_ERR_RETURN(!prev_new->info.uni.types, LOGMEM(mod->ctx), -1);
+
+            for (i = 0; i < prev_new->info.uni.count; i++) {
+                if (lys_copy_union_leafrefs(mod, parent, &(type->info.uni.types[i]), &(prev_new->info.uni.types[i]), unres)) {
+                    return -1;
+                }
+            }
+
+            prev_new->der = type->der;
+            break;
+        default:
+            if (lys_type_dup(mod, parent, prev_new, type, 0, 0, unres)) {
+                return -1;
+            }
+            break;
+        }
+    }
+
+    if (top_type) {
+        memcpy(type, prev_new, sizeof *type);
+    }
+    return EXIT_SUCCESS;
+}
+
+API const void *
+lys_ext_instance_substmt(const struct lys_ext_instance *ext)
+{
+    if (!ext) {
+        return NULL;
+    }
+
+    switch (ext->insubstmt) {
+    case LYEXT_SUBSTMT_SELF:
+    case LYEXT_SUBSTMT_MODIFIER:
+    case LYEXT_SUBSTMT_VERSION:
+        return NULL;
+    case LYEXT_SUBSTMT_ARGUMENT:
+        if (ext->parent_type == LYEXT_PAR_EXT) {
+            return ((struct lys_ext_instance*)ext->parent)->arg_value;
+        }
+        break;
+    case LYEXT_SUBSTMT_BASE:
+        if (ext->parent_type == LYEXT_PAR_TYPE) {
+            return ((struct lys_type*)ext->parent)->info.ident.ref[ext->insubstmt_index];
+        } else if (ext->parent_type == LYEXT_PAR_IDENT) {
+            return ((struct lys_ident*)ext->parent)->base[ext->insubstmt_index];
+        }
+        break;
+    case LYEXT_SUBSTMT_BELONGSTO:
+        if (ext->parent_type == LYEXT_PAR_MODULE && ((struct lys_module*)ext->parent)->type) {
+            return ((struct lys_submodule*)ext->parent)->belongsto;
+        }
+        break;
+    case LYEXT_SUBSTMT_CONFIG:
+    case LYEXT_SUBSTMT_MANDATORY:
+        if (ext->parent_type == LYEXT_PAR_NODE) {
+            return &((struct lys_node*)ext->parent)->flags;
+        } else if (ext->parent_type == LYEXT_PAR_DEVIATE) {
+            return &((struct lys_deviate*)ext->parent)->flags;
+        } else if (ext->parent_type == LYEXT_PAR_REFINE) {
+            return &((struct lys_refine*)ext->parent)->flags;
+        }
+        break;
+    case LYEXT_SUBSTMT_CONTACT:
+        if (ext->parent_type == LYEXT_PAR_MODULE) {
+            return ((struct lys_module*)ext->parent)->contact;
+        }
+        break;
+    case LYEXT_SUBSTMT_DEFAULT:
+        if (ext->parent_type == LYEXT_PAR_NODE) {
+            switch (((struct lys_node*)ext->parent)->nodetype) {
+            case LYS_LEAF:
+            case LYS_LEAFLIST:
+                /* in case of leaf, the index is supposed to be 0, so it will return the
+                 * correct pointer despite the leaf structure does not have dflt as array */
+                return ((struct lys_node_leaflist*)ext->parent)->dflt[ext->insubstmt_index];
+            case LYS_CHOICE:
+                return ((struct lys_node_choice*)ext->parent)->dflt;
+            default:
+                /* internal error */
+                break;
+            }
+        } else if (ext->parent_type == LYEXT_PAR_TPDF) {
+            return ((struct lys_tpdf*)ext->parent)->dflt;
+        } else if (ext->parent_type == LYEXT_PAR_DEVIATE) {
+            return ((struct lys_deviate*)ext->parent)->dflt[ext->insubstmt_index];
+        } else if (ext->parent_type == LYEXT_PAR_REFINE) {
+            return &((struct lys_refine*)ext->parent)->dflt[ext->insubstmt_index];
+        }
+        break;
+    case LYEXT_SUBSTMT_DESCRIPTION:
+        switch (ext->parent_type) {
+        case LYEXT_PAR_NODE:
+            return ((struct lys_node*)ext->parent)->dsc;
+        case LYEXT_PAR_MODULE:
+            return ((struct lys_module*)ext->parent)->dsc;
+        case LYEXT_PAR_IMPORT:
+            return ((struct lys_import*)ext->parent)->dsc;
+        case LYEXT_PAR_INCLUDE:
+            return ((struct lys_include*)ext->parent)->dsc;
+        case LYEXT_PAR_EXT:
+            return ((struct lys_ext*)ext->parent)->dsc;
+        case LYEXT_PAR_FEATURE:
+            return ((struct lys_feature*)ext->parent)->dsc;
+        case LYEXT_PAR_TPDF:
+            return ((struct lys_tpdf*)ext->parent)->dsc;
+        case LYEXT_PAR_TYPE_BIT:
+            return ((struct lys_type_bit*)ext->parent)->dsc;
+        case LYEXT_PAR_TYPE_ENUM:
+            return ((struct lys_type_enum*)ext->parent)->dsc;
+        case LYEXT_PAR_RESTR:
+            return ((struct lys_restr*)ext->parent)->dsc;
+        case LYEXT_PAR_WHEN:
+            return ((struct lys_when*)ext->parent)->dsc;
+        case LYEXT_PAR_IDENT:
+            return ((struct lys_ident*)ext->parent)->dsc;
+        case LYEXT_PAR_DEVIATION:
+            return ((struct lys_deviation*)ext->parent)->dsc;
+        case LYEXT_PAR_REVISION:
+            return ((struct lys_revision*)ext->parent)->dsc;
+        case LYEXT_PAR_REFINE:
+            return ((struct lys_refine*)ext->parent)->dsc;
+        default:
+            break;
+        }
+        break;
+    case LYEXT_SUBSTMT_ERRTAG:
+        if (ext->parent_type == LYEXT_PAR_RESTR) {
+            return ((struct lys_restr*)ext->parent)->eapptag;
+        }
+        break;
+    case LYEXT_SUBSTMT_ERRMSG:
+        if (ext->parent_type == LYEXT_PAR_RESTR) {
+            return ((struct lys_restr*)ext->parent)->emsg;
+        }
+        break;
+    case LYEXT_SUBSTMT_DIGITS:
+        if (ext->parent_type == LYEXT_PAR_TYPE && ((struct lys_type*)ext->parent)->base == LY_TYPE_DEC64) {
+            return &((struct lys_type*)ext->parent)->info.dec64.dig;
+        }
+        break;
+    case LYEXT_SUBSTMT_KEY:
+        if (ext->parent_type == LYEXT_PAR_NODE && ((struct lys_node*)ext->parent)->nodetype == LYS_LIST) {
+            return ((struct lys_node_list*)ext->parent)->keys;
+        }
+        break;
+    case LYEXT_SUBSTMT_MAX:
+        if (ext->parent_type == LYEXT_PAR_NODE) {
+            if (((struct lys_node*)ext->parent)->nodetype == LYS_LIST) {
+                return &((struct lys_node_list*)ext->parent)->max;
+            } else if (((struct lys_node*)ext->parent)->nodetype == LYS_LEAFLIST) {
+                return &((struct lys_node_leaflist*)ext->parent)->max;
+            }
+        } else if (ext->parent_type == LYEXT_PAR_REFINE) {
+            return &((struct lys_refine*)ext->parent)->mod.list.max;
+        }
+        break;
+    case LYEXT_SUBSTMT_MIN:
+        if (ext->parent_type == LYEXT_PAR_NODE) {
+            if (((struct lys_node*)ext->parent)->nodetype == LYS_LIST) {
+                return &((struct lys_node_list*)ext->parent)->min;
+            } else if (((struct lys_node*)ext->parent)->nodetype == LYS_LEAFLIST) {
+                return &((struct lys_node_leaflist*)ext->parent)->min;
+            }
+        } else if (ext->parent_type == LYEXT_PAR_REFINE) {
+            return &((struct lys_refine*)ext->parent)->mod.list.min;
+        }
+        break;
+    case LYEXT_SUBSTMT_NAMESPACE:
+        if (ext->parent_type == LYEXT_PAR_MODULE && !((struct lys_module*)ext->parent)->type) {
+            return ((struct lys_module*)ext->parent)->ns;
+        }
+        break;
+    case LYEXT_SUBSTMT_ORDEREDBY:
+        if (ext->parent_type == LYEXT_PAR_NODE &&
+                (((struct lys_node*)ext->parent)->nodetype & (LYS_LIST | LYS_LEAFLIST))) {
+            return &((struct lys_node_list*)ext->parent)->flags;
+        }
+        break;
+    case LYEXT_SUBSTMT_ORGANIZATION:
+        if (ext->parent_type == LYEXT_PAR_MODULE) {
+            return ((struct lys_module*)ext->parent)->org;
+        }
+        break;
+    case LYEXT_SUBSTMT_PATH:
+        if (ext->parent_type == LYEXT_PAR_TYPE && ((struct lys_type*)ext->parent)->base == LY_TYPE_LEAFREF) {
+            return ((struct lys_type*)ext->parent)->info.lref.path;
+        }
+        break;
+    case LYEXT_SUBSTMT_POSITION:
+        if (ext->parent_type == LYEXT_PAR_TYPE_BIT) {
+            return &((struct lys_type_bit*)ext->parent)->pos;
+        }
+        break;
+    case LYEXT_SUBSTMT_PREFIX:
+        if (ext->parent_type == LYEXT_PAR_MODULE) {
+            /* covers also lys_submodule */
+            return ((struct lys_module*)ext->parent)->prefix;
+        } else if (ext->parent_type == LYEXT_PAR_IMPORT) {
+            return ((struct lys_import*)ext->parent)->prefix;
+        }
+        break;
+    case LYEXT_SUBSTMT_PRESENCE:
+        if (ext->parent_type == LYEXT_PAR_NODE && ((struct lys_node*)ext->parent)->nodetype == LYS_CONTAINER) {
+            return ((struct lys_node_container*)ext->parent)->presence;
+        } else if (ext->parent_type == LYEXT_PAR_REFINE) {
+            return ((struct lys_refine*)ext->parent)->mod.presence;
+        }
+        break;
+    case LYEXT_SUBSTMT_REFERENCE:
+        switch (ext->parent_type) {
+        case LYEXT_PAR_NODE:
+            return ((struct lys_node*)ext->parent)->ref;
+        case LYEXT_PAR_MODULE:
+            return ((struct lys_module*)ext->parent)->ref;
+        case LYEXT_PAR_IMPORT:
+            return ((struct lys_import*)ext->parent)->ref;
+        case LYEXT_PAR_INCLUDE:
+            return ((struct lys_include*)ext->parent)->ref;
+        case LYEXT_PAR_EXT:
+            return ((struct lys_ext*)ext->parent)->ref;
+        case LYEXT_PAR_FEATURE:
+            return ((struct lys_feature*)ext->parent)->ref;
+        case LYEXT_PAR_TPDF:
+            return ((struct lys_tpdf*)ext->parent)->ref;
+        case LYEXT_PAR_TYPE_BIT:
+            return ((struct lys_type_bit*)ext->parent)->ref;
+        case LYEXT_PAR_TYPE_ENUM:
+            return ((struct lys_type_enum*)ext->parent)->ref;
+        case LYEXT_PAR_RESTR:
+            return ((struct lys_restr*)ext->parent)->ref;
+        case LYEXT_PAR_WHEN:
+            return ((struct lys_when*)ext->parent)->ref;
+        case LYEXT_PAR_IDENT:
+            return ((struct lys_ident*)ext->parent)->ref;
+        case LYEXT_PAR_DEVIATION:
+            return ((struct lys_deviation*)ext->parent)->ref;
+        case LYEXT_PAR_REVISION:
+            return ((struct lys_revision*)ext->parent)->ref;
+        case LYEXT_PAR_REFINE:
+            return ((struct lys_refine*)ext->parent)->ref;
+        default:
+            break;
+        }
+        break;
+    case LYEXT_SUBSTMT_REQINSTANCE:
+        if (ext->parent_type == LYEXT_PAR_TYPE) {
+            if (((struct lys_type*)ext->parent)->base == LY_TYPE_LEAFREF) {
+                return &((struct lys_type*)ext->parent)->info.lref.req;
+            } else if (((struct lys_type*)ext->parent)->base == LY_TYPE_INST) {
+                return &((struct lys_type*)ext->parent)->info.inst.req;
+            }
+        }
+        break;
+    case LYEXT_SUBSTMT_REVISIONDATE:
+        if (ext->parent_type == LYEXT_PAR_IMPORT) {
+            return ((struct lys_import*)ext->parent)->rev;
+        } else if (ext->parent_type == LYEXT_PAR_INCLUDE) {
+            return ((struct lys_include*)ext->parent)->rev;
+        }
+        break;
+    case LYEXT_SUBSTMT_STATUS:
+        switch (ext->parent_type) {
+        case LYEXT_PAR_NODE:
+        case LYEXT_PAR_IDENT:
+        case LYEXT_PAR_TPDF:
+        case LYEXT_PAR_EXT:
+        case LYEXT_PAR_FEATURE:
+        case LYEXT_PAR_TYPE_ENUM:
+        case LYEXT_PAR_TYPE_BIT:
+            /* in all structures the flags member is at the same offset */
+            return &((struct lys_node*)ext->parent)->flags;
+        default:
+            break;
+        }
+        break;
+    case LYEXT_SUBSTMT_UNIQUE:
+        if (ext->parent_type == LYEXT_PAR_DEVIATE) {
+            return &((struct lys_deviate*)ext->parent)->unique[ext->insubstmt_index];
+        } else if (ext->parent_type == LYEXT_PAR_NODE && ((struct lys_node*)ext->parent)->nodetype == LYS_LIST) {
+            return &((struct lys_node_list*)ext->parent)->unique[ext->insubstmt_index];
+        }
+        break;
+    case LYEXT_SUBSTMT_UNITS:
+        if (ext->parent_type == LYEXT_PAR_NODE &&
+                (((struct lys_node*)ext->parent)->nodetype & (LYS_LEAF | LYS_LEAFLIST))) {
+            /* units is at the same offset in both lys_node_leaf and lys_node_leaflist */
+            return ((struct lys_node_leaf*)ext->parent)->units;
+        } else if (ext->parent_type == LYEXT_PAR_TPDF) {
+            return ((struct lys_tpdf*)ext->parent)->units;
+        } else if (ext->parent_type == LYEXT_PAR_DEVIATE) {
+            return ((struct lys_deviate*)ext->parent)->units;
+        }
+        break;
+    case LYEXT_SUBSTMT_VALUE:
+        if (ext->parent_type == LYEXT_PAR_TYPE_ENUM) {
+            return &((struct lys_type_enum*)ext->parent)->value;
+        }
+        break;
+    case LYEXT_SUBSTMT_YINELEM:
+        if (ext->parent_type == LYEXT_PAR_EXT) {
+            return &((struct lys_ext*)ext->parent)->flags;
+        }
+        break;
+    }
+    LOGINT(ext->module->ctx);
+    return NULL;
+}
+
+static int
+lys_type_dup(struct lys_module *mod, struct lys_node *parent, struct lys_type *new, struct lys_type *old,
+            int in_grp, int shallow, struct unres_schema *unres)
+{
+    int i;
+
+    new->base = old->base;
+    new->der = old->der;
+    new->parent = (struct lys_tpdf *)parent;
+    new->ext_size = old->ext_size;
+    if (lys_ext_dup(mod->ctx, mod, old->ext, old->ext_size, new, LYEXT_PAR_TYPE, &new->ext, shallow, unres)) {
+        return -1;
+    }
+
+    i = unres_schema_find(unres, -1, old, UNRES_TYPE_DER);
+    if (i != -1) {
+        /* HACK (serious one) for unres */
+        /* nothing else we can do but duplicate it immediately */
+        if (((struct lyxml_elem *)old->der)->flags & LY_YANG_STRUCTURE_FLAG) {
+            new->der = (struct lys_tpdf *)lys_yang_type_dup(mod, parent, (struct yang_type *)old->der, new, in_grp,
+                                                            shallow, unres);
+        } else {
+            new->der = (struct lys_tpdf *)lyxml_dup_elem(mod->ctx, (struct lyxml_elem *)old->der, NULL, 1);
+        }
+        /* all these unres additions can fail even though they did not before */
+        if (!new->der || (unres_schema_add_node(mod, unres, new, UNRES_TYPE_DER, parent) == -1)) {
+            return -1;
+        }
+        return EXIT_SUCCESS;
+    }
+
+    if (lys_type_shareable(mod, old, in_grp, shallow)) {
+        return lys_type_share(mod, new, old);
+    }
+
+    return type_dup(mod, parent, new, old, new->base, in_grp, shallow, unres);
+}
+
+void
+lys_type_free(struct ly_ctx *ctx, struct lys_type *type,
+              void (*private_destructor)(const struct lys_node *node, void *priv))
+{
+    unsigned int i;
+
+    assert(ctx);
+    if (!type) {
+        return;
+    }
+
+    lys_extension_instances_free(ctx, type->ext, type->ext_size, private_destructor);
+#ifdef LY_ENABLED_CACHE
+    free(type->eff);
+    type->eff = NULL;
+#endif
+
+    if (type->value_flags & LY_VALUE_SHARED) {
+        /* the restrictions are owned by the type in the grouping */
+        type->value_flags &= ~LY_VALUE_SHARED;
+        return;
+    }
+
+    switch (type->base) {
+    case LY_TYPE_BINARY:
+        lys_restr_free(ctx, type->info.binary.length, private_destructor);
+        free(type->info.binary.length);
+        break;
+    case LY_TYPE_BITS:
+        for (i = 0; i < type->info.bits.count; i++) {
+            lydict_remove(ctx, type->info.bits.bit[i].name);
+            lydict_remove(ctx, type->info.bits.bit[i].dsc);
+            lydict_remove(ctx, type->info.bits.bit[i].ref);
+            lys_iffeature_free(ctx, type->info.bits.bit[i].iffeature, type->info.bits.bit[i].iffeature_size, 0,
+                               private_destructor);
+            lys_extension_instances_free(ctx, type->info.bits.bit[i].ext, type->info.bits.bit[i].ext_size,
+                                         private_destructor);
+        }
+        free(type->info.bits.bit);
+        break;
+
+    case LY_TYPE_DEC64:
+        lys_restr_free(ctx, type->info.dec64.range, private_destructor);
+        free(type->info.dec64.range);
+        break;
+
+    case LY_TYPE_ENUM:
+        for (i = 0; i < type->info.enums.count; i++) {
+            lydict_remove(ctx, type->info.enums.enm[i].name);
+            lydict_remove(ctx, type->info.enums.enm[i].dsc);
+            lydict_remove(ctx, type->info.enums.enm[i].ref);
+            lys_iffeature_free(ctx, type->info.enums.enm[i].iffeature, type->info.enums.enm[i].iffeature_size, 0,
+                               private_destructor);
+            lys_extension_instances_free(ctx, type->info.enums.enm[i].ext, type->info.enums.enm[i].ext_size,
+                                         private_destructor);
+        }
+        free(type->info.enums.enm);
+        break;
+
+    case LY_TYPE_INT8:
+    case LY_TYPE_INT16:
+    case LY_TYPE_INT32:
+    case LY_TYPE_INT64:
+    case LY_TYPE_UINT8:
+    case LY_TYPE_UINT16:
+    case LY_TYPE_UINT32:
+    case LY_TYPE_UINT64:
+        lys_restr_free(ctx, type->info.num.range, private_destructor);
+        free(type->info.num.range);
+        break;
+
+    case LY_TYPE_LEAFREF:
+        lydict_remove(ctx, type->info.lref.path);
+        break;
+
+    case LY_TYPE_STRING:
+        lys_restr_free(ctx, type->info.str.length, private_destructor);
+        free(type->info.str.length);
+        for (i = 0; i < type->info.str.pat_count; i++) {
+            lys_restr_free(ctx, &type->info.str.patterns[i], private_destructor);
+#ifdef LY_ENABLED_CACHE
+            if (type->info.str.patterns_pcre) {
+                pcre_free((pcre*)type->info.str.patterns_pcre[2 * i]);
+                pcre_free_study((pcre_extra*)type->info.str.patterns_pcre[2 * i + 1]);
+            }
+#endif
+        }
+        free(type->info.str.patterns);
+#ifdef LY_ENABLED_CACHE
+        free(type->info.str.patterns_pcre);
+#endif
+        break;
+
+    case LY_TYPE_UNION:
+        for (i = 0; i < type->info.uni.count; i++) {
+            lys_type_free(ctx, &type->info.uni.types[i], private_destructor);
+        }
+        free(type->info.uni.types);
+        break;
+
+    case LY_TYPE_IDENT:
+        free(type->info.ident.ref);
+        break;
+
+    default:
+        /* nothing to do for LY_TYPE_INST, LY_TYPE_BOOL, LY_TYPE_EMPTY */
+        break;
+    }
+}
+
+static void
+lys_tpdf_free(struct ly_ctx *ctx, struct lys_tpdf *tpdf,
+              void (*private_destructor)(const struct lys_node *node, void *priv))
+{
+    assert(ctx);
+    if (!tpdf) {
+        return;
+    }
+
+    lydict_remove(ctx, tpdf->name);
+    lydict_remove(ctx, tpdf->dsc);
+    lydict_remove(ctx, tpdf->ref);
+
+    lys_type_free(ctx, &tpdf->type, private_destructor);
+
+    lydict_remove(ctx, tpdf->units);
+    lydict_remove(ctx, tpdf->dflt);
+
+    lys_extension_instances_free(ctx, tpdf->ext, tpdf->ext_size, private_destructor);
+}
+
+static struct lys_when *
+lys_when_dup(struct lys_module *mod, struct lys_when *old, int shallow, struct unres_schema *unres)
+{
+    struct lys_when *new;
+
+    if (!old) {
+        return NULL;
+    }
+
+    new = calloc(1, sizeof *new);
+    LY_CHECK_ERR_RETURN(!new, LOGMEM(mod->ctx), NULL);
+    new->cond = lydict_insert(mod->ctx, old->cond, 0);
+    new->dsc = lydict_insert(mod->ctx, old->dsc, 0);
+    new->ref = lydict_insert(mod->ctx, old->ref, 0);
+    new->ext_size = old->ext_size;
+    lys_ext_dup(mod->ctx, mod, old->ext, old->ext_size, new, LYEXT_PAR_WHEN, &new->ext, shallow, unres);
+
+    return new;
+}
+
+void
+lys_when_free(struct ly_ctx *ctx, struct lys_when *w,
+              void (*private_destructor)(const struct lys_node *node, void *priv))
+{
+    if (!w) {
+        return;
+    }
+
+    lys_extension_instances_free(ctx, w->ext, w->ext_size, private_destructor);
+    lydict_remove(ctx, w->cond);
+    lydict_remove(ctx, w->dsc);
+    lydict_remove(ctx, w->ref);
+#ifdef LY_ENABLED_CACHE
+    lyxp_expr_free(w->cond_xpath);
+    ly_set_free(w->deps);
+#endif
+
+    free(w);
+}
+
+static void
+lys_augment_free(struct ly_ctx *ctx, struct lys_node_augment *aug,
+                 void (*private_destructor)(const struct lys_node *node, void *priv))
+{
+    struct lys_node *next, *sub;
+
+    /* children from a resolved augment are freed under the target node */
+    if (!aug->target || (aug->flags & LYS_NOTAPPLIED)) {
+        LY_TREE_FOR_SAFE(aug->child, next, sub) {
+            lys_node_free(sub, private_destructor, 0);
+        }
+    }
+
+    lydict_remove(ctx, aug->target_name);
+    lydict_remove(ctx, aug->dsc);
+    lydict_remove(ctx, aug->ref);
+
+    lys_iffeature_free(ctx, aug->iffeature, aug->iffeature_size, 0, private_destructor);
+    lys_extension_instances_free(ctx, aug->ext, aug->ext_size, private_destructor);
+
+    lys_when_free(ctx, aug->when, private_destructor);
+}
+
+static void
+lys_ident_free(struct ly_ctx *ctx, struct lys_ident *ident,
+               void (*private_destructor)(const struct lys_node *node, void *priv))
+{
+    assert(ctx);
+    if (!ident) {
+        return;
+    }
+
+    free(ident->base);
+    ly_set_free(ident->der);
+    lydict_remove(ctx, ident->name);
+    lydict_remove(ctx, ident->dsc);
+    lydict_remove(ctx, ident->ref);
+    lys_iffeature_free(ctx, ident->iffeature, ident->iffeature_size, 0, private_destructor);
+    lys_extension_instances_free(ctx, ident->ext, ident->ext_size, private_destructor);
+
+}
+
+static void
+lys_grp_free(struct ly_ctx *ctx, struct lys_node_grp *grp,
+             void (*private_destructor)(const struct lys_node *node, void *priv))
+{
+    int i;
+
+    /* handle only specific parts for LYS_GROUPING */
+    for (i = 0; i < grp->tpdf_size; i++) {
+        lys_tpdf_free(ctx, &grp->tpdf[i], private_destructor);
+    }
+    free(grp->tpdf);
+}
+
+static void
+lys_rpc_action_free(struct ly_ctx *ctx, struct lys_node_rpc_action *rpc_act,
+             void (*private_destructor)(const struct lys_node *node, void *priv))
+{
+    int i;
+
+    /* handle only specific parts for LYS_GROUPING */
+    for (i = 0; i < rpc_act->tpdf_size; i++) {
+        lys_tpdf_free(ctx, &rpc_act->tpdf[i], private_destructor);
+    }
+    free(rpc_act->tpdf);
+}
+
+static void
+lys_inout_free(struct ly_ctx *ctx, struct lys_node_inout *io,
+               void (*private_destructor)(const struct lys_node *node, void *priv))
+{
+    int i;
+
+    /* handle only specific parts for LYS_INPUT and LYS_OUTPUT */
+    for (i = 0; i < io->tpdf_size; i++) {
+        lys_tpdf_free(ctx, &io->tpdf[i], private_destructor);
+    }
+    free(io->tpdf);
+
+    for (i = 0; i < io->must_size; i++) {
+        lys_restr_free(ctx, &io->must[i], private_destructor);
+    }
+    free(io->must);
+}
+
+static void
+lys_notif_free(struct ly_ctx *ctx, struct lys_node_notif *notif,
+               void (*private_destructor)(const struct lys_node *node, void *priv))
+{
+    int i;
+
+    for (i = 0; i < notif->must_size; i++) {
+        lys_restr_free(ctx, &notif->must[i], private_destructor);
+    }
+    free(notif->must);
+
+    for (i = 0; i < notif->tpdf_size; i++) {
+        lys_tpdf_free(ctx, &notif->tpdf[i], private_destructor);
+    }
+    free(notif->tpdf);
+}
+static void
+lys_anydata_free(struct ly_ctx *ctx, struct lys_node_anydata *anyxml,
+                 void (*private_destructor)(const struct lys_node *node, void *priv))
+{
+    int i;
+
+    for (i = 0; i < anyxml->must_size; i++) {
+        lys_restr_free(ctx, &anyxml->must[i], private_destructor);
+    }
+    free(anyxml->must);
+
+    lys_when_free(ctx, anyxml->when, private_destructor);
+}
+
+static void
+lys_leaf_free(struct ly_ctx *ctx, struct lys_node_leaf *leaf,
+              void (*private_destructor)(const struct lys_node *node, void *priv))
+{
+    int i;
+
+    /* leafref backlinks */
+    ly_set_free((struct ly_set *)leaf->backlinks);
+
+    for (i = 0; i < leaf->must_size; i++) {
+        lys_restr_free(ctx, &leaf->must[i], private_destructor);
+    }
+    free(leaf->must);
+
+    lys_when_free(ctx, leaf->when, private_destructor);
+
+    lys_type_free(ctx, &leaf->type, private_destructor);
+    lydict_remove(ctx, leaf->units);
+    lydict_remove(ctx, leaf->dflt);
+}
+
+static void
+lys_leaflist_free(struct ly_ctx *ctx, struct lys_node_leaflist *llist,
+                  void (*private_destructor)(const struct lys_node *node, void *priv))
+{
+    int i;
+
+    if (llist->backlinks) {
+        /* leafref backlinks */
+        ly_set_free(llist->backlinks);
+    }
+
+    for (i = 0; i < llist->must_size; i++) {
+        lys_restr_free(ctx, &llist->must[i], private_destructor);
+    }
+    free(llist->must);
+
+    for (i = 0; i < llist->dflt_size; i++) {
+        lydict_remove(ctx, llist->dflt[i]);
+    }
+    free(llist->dflt);
+
+    lys_when_free(ctx, llist->when, private_destructor);
+
+    lys_type_free(ctx, &llist->type, private_destructor);
+    lydict_remove(ctx, llist->units);
+}
+
+static void
+lys_list_free(struct ly_ctx *ctx, struct lys_node_list *list,
+              void (*private_destructor)(const struct lys_node *node, void *priv))
+{
+    int i, j;
+
+    /* handle only specific parts for LY_NODE_LIST */
+    lys_when_free(ctx, list->when, private_destructor);
+
+    for (i = 0; i < list->must_size; i++) {
+        lys_restr_free(ctx, &list->must[i], private_destructor);
+    }
+    free(list->must);
+
+    for (i = 0; i < list->tpdf_size; i++) {
+        lys_tpdf_free(ctx, &list->tpdf[i], private_destructor);
+    }
+    free(list->tpdf);
+
+    free(list->keys);
+
+    for (i = 0; i < list->unique_size; i++) {
+        for (j = 0; j < list->unique[i].expr_size; j++) {
+            lydict_remove(ctx, list->unique[i].expr[j]);
+        }
+        free(list->unique[i].expr);
+    }
+    free(list->unique);
+
+    lydict_remove(ctx, list->keys_str);
+}
+
+static void
+lys_container_free(struct ly_ctx *ctx, struct lys_node_container *cont,
+                   void (*private_destructor)(const struct lys_node *node, void *priv))
+{
+    int i;
+
+    /* handle only specific parts for LY_NODE_CONTAINER */
+    lydict_remove(ctx, cont->presence);
+
+    for (i = 0; i < cont->tpdf_size; i++) {
+        lys_tpdf_free(ctx, &cont->tpdf[i], private_destructor);
+    }
+    free(cont->tpdf);
+
+    for (i = 0; i < cont->must_size; i++) {
+        lys_restr_free(ctx, &cont->must[i], private_destructor);
+    }
+    free(cont->must);
+
+    lys_when_free(ctx, cont->when, private_destructor);
+}
+
+static void
+lys_feature_free(struct ly_ctx *ctx, struct lys_feature *f,
+                 void (*private_destructor)(const struct lys_node *node, void *priv))
+{
+    lydict_remove(ctx, f->name);
+    lydict_remove(ctx, f->dsc);
+    lydict_remove(ctx, f->ref);
+    lys_iffeature_free(ctx, f->iffeature, f->iffeature_size, 0, private_destructor);
+    ly_set_free(f->depfeatures);
+    lys_extension_instances_free(ctx, f->ext, f->ext_size, private_destructor);
+}
+
+static void
+lys_extension_free(struct ly_ctx *ctx, struct lys_ext *e,
+                   void (*private_destructor)(const struct lys_node *node, void *priv))
+{
+    lydict_remove(ctx, e->name);
+    lydict_remove(ctx, e->dsc);
+    lydict_remove(ctx, e->ref);
+    lydict_remove(ctx, e->argument);
+    lys_extension_instances_free(ctx, e->ext, e->ext_size, private_destructor);
+}
+
+static void
+lys_deviation_free(struct lys_module *module, struct lys_deviation *dev,
+                   void (*private_destructor)(const struct lys_node *node, void *priv))
+{
+    int i, j, k;
+    struct ly_ctx *ctx;
+    struct lys_node *next, *elem;
+
+    ctx = module->ctx;
+
+    lydict_remove(ctx, dev->target_name);
+    lydict_remove(ctx, dev->dsc);
+    lydict_remove(ctx, dev->ref);
+    lys_extension_instances_free(ctx, dev->ext, dev->ext_size, private_destructor);
+
+    if (!dev->deviate) {
+        return;
+    }
+
+    /* it could not be applied because it failed to be applied */
+    if (dev->orig_node) {
+        /* the module was freed, but we only need the context from orig_node, use ours */
+        if (dev->deviate[0].mod == LY_DEVIATE_NO) {
+            /* it's actually a node subtree, we need to update modules on all the nodes :-/ */
+            LY_TREE_DFS_BEGIN(dev->orig_node, next, elem) {
+                elem->module = module;
+
+                LY_TREE_DFS_END(dev->orig_node, next, elem);
+            }
+            lys_node_free(dev->orig_node, NULL, 0);
+        } else {
+            /* it's just a shallow copy, freeing one node */
+            dev->orig_node->module = module;
+            lys_node_free(dev->orig_node, NULL, 1);
         }
-        break;
-    case LYEXT_SUBSTMT_KEY:
-        if (ext->parent_type == LYEXT_PAR_NODE && ((struct lys_node*)ext->parent)->nodetype == LYS_LIST) {
-            return ((struct lys_node_list*)ext->parent)->keys;
+    }
+
+    for (i = 0; i < dev->deviate_size; i++) {
+        lys_extension_instances_free(ctx, dev->deviate[i].ext, dev->deviate[i].ext_size, private_destructor);
+
+        for (j = 0; j < dev->deviate[i].dflt_size; j++) {
+            lydict_remove(ctx, dev->deviate[i].dflt[j]);
         }
-        break;
-    case LYEXT_SUBSTMT_MAX:
-        if (ext->parent_type == LYEXT_PAR_NODE) {
-            if (((struct lys_node*)ext->parent)->nodetype == LYS_LIST) {
-                return &((struct lys_node_list*)ext->parent)->max;
-            } else if (((struct lys_node*)ext->parent)->nodetype == LYS_LEAFLIST) {
-                return &((struct lys_node_leaflist*)ext->parent)->max;
+        free(dev->deviate[i].dflt);
+
+        lydict_remove(ctx, dev->deviate[i].units);
+
+        if (dev->deviate[i].mod == LY_DEVIATE_DEL) {
+            for (j = 0; j < dev->deviate[i].must_size; j++) {
+                lys_restr_free(ctx, &dev->deviate[i].must[j], private_destructor);
             }
-        } else if (ext->parent_type == LYEXT_PAR_REFINE) {
-            return &((struct lys_refine*)ext->parent)->mod.list.max;
-        }
-        break;
-    case LYEXT_SUBSTMT_MIN:
-        if (ext->parent_type == LYEXT_PAR_NODE) {
-            if (((struct lys_node*)ext->parent)->nodetype == LYS_LIST) {
-                return &((struct lys_node_list*)ext->parent)->min;
-            } else if (((struct lys_node*)ext->parent)->nodetype == LYS_LEAFLIST) {
-                return &((struct lys_node_leaflist*)ext->parent)->min;
+            free(dev->deviate[i].must);
+
+            for (j = 0; j < dev->deviate[i].unique_size; j++) {
+                for (k = 0; k < dev->deviate[i].unique[j].expr_size; k++) {
+                    lydict_remove(ctx, dev->deviate[i].unique[j].expr[k]);
+                }
+                free(dev->deviate[i].unique[j].expr);
             }
-        } else if (ext->parent_type == LYEXT_PAR_REFINE) {
-            return &((struct lys_refine*)ext->parent)->mod.list.min;
+            free(dev->deviate[i].unique);
         }
-        break;
-    case LYEXT_SUBSTMT_NAMESPACE:
-        if (ext->parent_type == LYEXT_PAR_MODULE && !((struct lys_module*)ext->parent)->type) {
-            return ((struct lys_module*)ext->parent)->ns;
+    }
+    free(dev->deviate);
+}
+
+static void
+lys_uses_free(struct ly_ctx *ctx, struct lys_node_uses *uses,
+              void (*private_destructor)(const struct lys_node *node, void *priv))
+{
+    int i, j;
+
+    for (i = 0; i < uses->refine_size; i++) {
+        lydict_remove(ctx, uses->refine[i].target_name);
+        lydict_remove(ctx, uses->refine[i].dsc);
+        lydict_remove(ctx, uses->refine[i].ref);
+
+        lys_iffeature_free(ctx, uses->refine[i].iffeature, uses->refine[i].iffeature_size, 0, private_destructor);
+
+        for (j = 0; j < uses->refine[i].must_size; j++) {
+            lys_restr_free(ctx, &uses->refine[i].must[j], private_destructor);
         }
-        break;
-    case LYEXT_SUBSTMT_ORDEREDBY:
-        if (ext->parent_type == LYEXT_PAR_NODE &&
-                (((struct lys_node*)ext->parent)->nodetype & (LYS_LIST | LYS_LEAFLIST))) {
-            return &((struct lys_node_list*)ext->parent)->flags;
+        free(uses->refine[i].must);
+
+        for (j = 0; j < uses->refine[i].dflt_size; j++) {
+            lydict_remove(ctx, uses->refine[i].dflt[j]);
         }
-        break;
-    case LYEXT_SUBSTMT_ORGANIZATION:
-        if (ext->parent_type == LYEXT_PAR_MODULE) {
-            return ((struct lys_module*)ext->parent)->org;
+        free(uses->refine[i].dflt);
+
+        lys_extension_instances_free(ctx, uses->refine[i].ext, uses->refine[i].ext_size, private_destructor);
+
+        if (uses->refine[i].target_type & LYS_CONTAINER) {
+            lydict_remove(ctx, uses->refine[i].mod.presence);
         }
-        break;
-    case LYEXT_SUBSTMT_PATH:
-        if (ext->parent_type == LYEXT_PAR_TYPE && ((struct lys_type*)ext->parent)->base == LY_TYPE_LEAFREF) {
-            return ((struct lys_type*)ext->parent)->info.lref.path;
+    }
+    free(uses->refine);
+
+    for (i = 0; i < uses->augment_size; i++) {
+        lys_augment_free(ctx, &uses->augment[i], private_destructor);
+    }
+    free(uses->augment);
+
+    lys_when_free(ctx, uses->when, private_destructor);
+}
+
+void
+lys_node_free(struct lys_node *node, void (*private_destructor)(const struct lys_node *node, void *priv), int shallow)
+{
+    struct ly_ctx *ctx;
+    struct lys_node *sub, *next;
+
+    if (!node) {
+        return;
+    }
+
+    assert(node->module);
+    assert(node->module->ctx);
+
+    ctx = node->module->ctx;
+
+    /* remove private object */
+    if (node->priv && private_destructor) {
+        private_destructor(node, node->priv);
+    }
+
+    /* common part */
+    lydict_remove(ctx, node->name);
+    if (!(node->nodetype & (LYS_INPUT | LYS_OUTPUT))) {
+        lys_iffeature_free(ctx, node->iffeature, node->iffeature_size, shallow, private_destructor);
+        lydict_remove(ctx, node->dsc);
+        lydict_remove(ctx, node->ref);
+    }
+
+    if (!shallow && !(node->nodetype & (LYS_LEAF | LYS_LEAFLIST))) {
+        LY_TREE_FOR_SAFE(node->child, next, sub) {
+            lys_node_free(sub, private_destructor, 0);
         }
+    }
+
+    lys_extension_instances_free(ctx, node->ext, node->ext_size, private_destructor);
+
+    /* specific part */
+    switch (node->nodetype) {
+    case LYS_CONTAINER:
+        lys_container_free(ctx, (struct lys_node_container *)node, private_destructor);
         break;
-    case LYEXT_SUBSTMT_POSITION:
-        if (ext->parent_type == LYEXT_PAR_TYPE_BIT) {
-            return &((struct lys_type_bit*)ext->parent)->pos;
-        }
+    case LYS_CHOICE:
+        lys_when_free(ctx, ((struct lys_node_choice *)node)->when, private_destructor);
         break;
-    case LYEXT_SUBSTMT_PREFIX:
-        if (ext->parent_type == LYEXT_PAR_MODULE) {
-            /* covers also lys_submodule */
-            return ((struct lys_module*)ext->parent)->prefix;
-        } else if (ext->parent_type == LYEXT_PAR_IMPORT) {
-            return ((struct lys_import*)ext->parent)->prefix;
-        }
+    case LYS_LEAF:
+        lys_leaf_free(ctx, (struct lys_node_leaf *)node, private_destructor);
         break;
-    case LYEXT_SUBSTMT_PRESENCE:
-        if (ext->parent_type == LYEXT_PAR_NODE && ((struct lys_node*)ext->parent)->nodetype == LYS_CONTAINER) {
-            return ((struct lys_node_container*)ext->parent)->presence;
-        } else if (ext->parent_type == LYEXT_PAR_REFINE) {
-            return ((struct lys_refine*)ext->parent)->mod.presence;
-        }
+    case LYS_LEAFLIST:
+        lys_leaflist_free(ctx, (struct lys_node_leaflist *)node, private_destructor);
         break;
-    case LYEXT_SUBSTMT_REFERENCE:
-        switch (ext->parent_type) {
-        case LYEXT_PAR_NODE:
-            return ((struct lys_node*)ext->parent)->ref;
-        case LYEXT_PAR_MODULE:
-            return ((struct lys_module*)ext->parent)->ref;
-        case LYEXT_PAR_IMPORT:
-            return ((struct lys_import*)ext->parent)->ref;
-        case LYEXT_PAR_INCLUDE:
-            return ((struct lys_include*)ext->parent)->ref;
-        case LYEXT_PAR_EXT:
-            return ((struct lys_ext*)ext->parent)->ref;
-        case LYEXT_PAR_FEATURE:
-            return ((struct lys_feature*)ext->parent)->ref;
-        case LYEXT_PAR_TPDF:
-            return ((struct lys_tpdf*)ext->parent)->ref;
-        case LYEXT_PAR_TYPE_BIT:
-            return ((struct lys_type_bit*)ext->parent)->ref;
-        case LYEXT_PAR_TYPE_ENUM:
-            return ((struct lys_type_enum*)ext->parent)->ref;
-        case LYEXT_PAR_RESTR:
-            return ((struct lys_restr*)ext->parent)->ref;
-        case LYEXT_PAR_WHEN:
-            return ((struct lys_when*)ext->parent)->ref;
-        case LYEXT_PAR_IDENT:
-            return ((struct lys_ident*)ext->parent)->ref;
-        case LYEXT_PAR_DEVIATION:
-            return ((struct lys_deviation*)ext->parent)->ref;
-        case LYEXT_PAR_REVISION:
-            return ((struct lys_revision*)ext->parent)->ref;
-        case LYEXT_PAR_REFINE:
-            return ((struct lys_refine*)ext->parent)->ref;
-        default:
-            break;
-        }
+    case LYS_LIST:
+        lys_list_free(ctx, (struct lys_node_list *)node, private_destructor);
+        break;
+    case LYS_ANYXML:
+    case LYS_ANYDATA:
+        lys_anydata_free(ctx, (struct lys_node_anydata *)node, private_destructor);
         break;
-    case LYEXT_SUBSTMT_REQINSTANCE:
-        if (ext->parent_type == LYEXT_PAR_TYPE) {
-            if (((struct lys_type*)ext->parent)->base == LY_TYPE_LEAFREF) {
-                return &((struct lys_type*)ext->parent)->info.lref.req;
-            } else if (((struct lys_type*)ext->parent)->base == LY_TYPE_INST) {
-                return &((struct lys_type*)ext->parent)->info.inst.req;
-            }
-        }
+    case LYS_USES:
+        lys_uses_free(ctx, (struct lys_node_uses *)node, private_destructor);
         break;
-    case LYEXT_SUBSTMT_REVISIONDATE:
-        if (ext->parent_type == LYEXT_PAR_IMPORT) {
-            return ((struct lys_import*)ext->parent)->rev;
-        } else if (ext->parent_type == LYEXT_PAR_INCLUDE) {
-            return ((struct lys_include*)ext->parent)->rev;
-        }
+    case LYS_CASE:
+        lys_when_free(ctx, ((struct lys_node_case *)node)->when, private_destructor);
         break;
-    case LYEXT_SUBSTMT_STATUS:
-        switch (ext->parent_type) {
-        case LYEXT_PAR_NODE:
-        case LYEXT_PAR_IDENT:
-        case LYEXT_PAR_TPDF:
-        case LYEXT_PAR_EXT:
-        case LYEXT_PAR_FEATURE:
-        case LYEXT_PAR_TYPE_ENUM:
-        case LYEXT_PAR_TYPE_BIT:
-            /* in all structures the flags member is at the same offset */
-            return &((struct lys_node*)ext->parent)->flags;
-        default:
-            break;
-        }
+    case LYS_AUGMENT:
+        /* do nothing */
         break;
-    case LYEXT_SUBSTMT_UNIQUE:
-        if (ext->parent_type == LYEXT_PAR_DEVIATE) {
-            return &((struct lys_deviate*)ext->parent)->unique[ext->insubstmt_index];
-        } else if (ext->parent_type == LYEXT_PAR_NODE && ((struct lys_node*)ext->parent)->nodetype == LYS_LIST) {
-            return &((struct lys_node_list*)ext->parent)->unique[ext->insubstmt_index];
-        }
+    case LYS_GROUPING:
+        lys_grp_free(ctx, (struct lys_node_grp *)node, private_destructor);
         break;
-    case LYEXT_SUBSTMT_UNITS:
-        if (ext->parent_type == LYEXT_PAR_NODE &&
-                (((struct lys_node*)ext->parent)->nodetype & (LYS_LEAF | LYS_LEAFLIST))) {
-            /* units is at the same offset in both lys_node_leaf and lys_node_leaflist */
-            return ((struct lys_node_leaf*)ext->parent)->units;
-        } else if (ext->parent_type == LYEXT_PAR_TPDF) {
-            return ((struct lys_tpdf*)ext->parent)->units;
-        } else if (ext->parent_type == LYEXT_PAR_DEVIATE) {
-            return ((struct lys_deviate*)ext->parent)->units;
-        }
+    case LYS_RPC:
+    case LYS_ACTION:
+        lys_rpc_action_free(ctx, (struct lys_node_rpc_action *)node, private_destructor);
         break;
-    case LYEXT_SUBSTMT_VALUE:
-        if (ext->parent_type == LYEXT_PAR_TYPE_ENUM) {
-            return &((struct lys_type_enum*)ext->parent)->value;
-        }
+    case LYS_NOTIF:
+        lys_notif_free(ctx, (struct lys_node_notif *)node, private_destructor);
         break;
-    case LYEXT_SUBSTMT_YINELEM:
-        if (ext->parent_type == LYEXT_PAR_EXT) {
-            return &((struct lys_ext*)ext->parent)->flags;
-        }
+    case LYS_INPUT:
+    case LYS_OUTPUT:
+        lys_inout_free(ctx, (struct lys_node_inout *)node, private_destructor);
+        break;
+    case LYS_EXT:
+    case LYS_UNKNOWN:
+        LOGINT(ctx);
         break;
     }
-    LOGINT(ext->module->ctx);
-    return NULL;
+
+    /* again common part */
+    lys_node_unlink(node);
+    free(node);
 }
 
-static int
-lys_type_dup(struct lys_module *mod, struct lys_node *parent, struct lys_type *new, struct lys_type *old,
-            int in_grp, int shallow, struct unres_schema *unres)
+API struct lys_module *
+lys_implemented_module(const struct lys_module *mod)
 {
+    struct ly_ctx *ctx;
     int i;
 
-    new->base = old->base;
-    new->der = old->der;
-    new->parent = (struct lys_tpdf *)parent;
-    new->ext_size = old->ext_size;
-    if (lys_ext_dup(mod->ctx, mod, old->ext, old->ext_size, new, LYEXT_PAR_TYPE, &new->ext, shallow, unres)) {
-        return -1;
+    if (!mod || mod->implemented) {
+        /* invalid argument or the module itself is implemented */
+        return (struct lys_module *)mod;
     }
 
-    i = unres_schema_find(unres, -1, old, UNRES_TYPE_DER);
-    if (i != -1) {
-        /* HACK (serious one) for unres */
-        /* nothing else we can do but duplicate it immediately */
-        if (((struct lyxml_elem *)old->der)->flags & LY_YANG_STRUCTURE_FLAG) {
-            new->der = (struct lys_tpdf *)lys_yang_type_dup(mod, parent, (struct yang_type *)old->der, new, in_grp,
-                                                            shallow, unres);
-        } else {
-            new->der = (struct lys_tpdf *)lyxml_dup_elem(mod->ctx, (struct lyxml_elem *)old->der, NULL, 1);
+    ctx = mod->ctx;
+    for (i = 0; i < ctx->models.used; i++) {
+        if (!ctx->models.list[i]->implemented) {
+            continue;
         }
-        /* all these unres additions can fail even though they did not before */
-        if (!new->der || (unres_schema_add_node(mod, unres, new, UNRES_TYPE_DER, parent) == -1)) {
-            return -1;
+
+        if (ly_strequal(mod->name, ctx->models.list[i]->name, 1)) {
+            /* we have some revision of the module implemented */
+            return ctx->models.list[i];
         }
-        return EXIT_SUCCESS;
     }
 
-    return type_dup(mod, parent, new, old, new->base, in_grp, shallow, unres);
+    /* we have no revision of the module implemented, return the module itself,
+     * it is up to the caller to set the module implemented when needed */
+    return (struct lys_module *)mod;
 }
 
-void
-lys_type_free(struct ly_ctx *ctx, struct lys_type *type,
-              void (*private_destructor)(const struct lys_node *node, void *priv))
+/* free_int_mods - flag whether to free the internal modules as well */
+static void
+module_free_common(struct lys_module *module, void (*private_destructor)(const struct lys_node *node, void *priv))
 {
+    struct ly_ctx *ctx;
+    struct lys_node *next, *iter;
     unsigned int i;
 
-    assert(ctx);
-    if (!type) {
-        return;
-    }
-
-    lys_extension_instances_free(ctx, type->ext, type->ext_size, private_destructor);
-
-    switch (type->base) {
-    case LY_TYPE_BINARY:
-        lys_restr_free(ctx, type->info.binary.length, private_destructor);
-        free(type->info.binary.length);
-        break;
-    case LY_TYPE_BITS:
-        for (i = 0; i < type->info.bits.count; i++) {
-            lydict_remove(ctx, type->info.bits.bit[i].name);
-            lydict_remove(ctx, type->info.bits.bit[i].dsc);
-            lydict_remove(ctx, type->info.bits.bit[i].ref);
-            lys_iffeature_free(ctx, type->info.bits.bit[i].iffeature, type->info.bits.bit[i].iffeature_size, 0,
-                               private_destructor);
-            lys_extension_instances_free(ctx, type->info.bits.bit[i].ext, type->info.bits.bit[i].ext_size,
-                                         private_destructor);
-        }
-        free(type->info.bits.bit);
-        break;
-
-    case LY_TYPE_DEC64:
-        lys_restr_free(ctx, type->info.dec64.range, private_destructor);
-        free(type->info.dec64.range);
-        break;
-
-    case LY_TYPE_ENUM:
-        for (i = 0; i < type->info.enums.count; i++) {
-            lydict_remove(ctx, type->info.enums.enm[i].name);
-            lydict_remove(ctx, type->info.enums.enm[i].dsc);
-            lydict_remove(ctx, type->info.enums.enm[i].ref);
-            lys_iffeature_free(ctx, type->info.enums.enm[i].iffeature, type->info.enums.enm[i].iffeature_size, 0,
-                               private_destructor);
-            lys_extension_instances_free(ctx, type->info.enums.enm[i].ext, type->info.enums.enm[i].ext_size,
-                                         private_destructor);
-        }
-        free(type->info.enums.enm);
-        break;
-
-    case LY_TYPE_INT8:
-    case LY_TYPE_INT16:
-    case LY_TYPE_INT32:
-    case LY_TYPE_INT64:
-    case LY_TYPE_UINT8:
-    case LY_TYPE_UINT16:
-    case LY_TYPE_UINT32:
-    case LY_TYPE_UINT64:
-        lys_restr_free(ctx, type->info.num.range, private_destructor);
-        free(type->info.num.range);
-        break;
-
-    case LY_TYPE_LEAFREF:
-        lydict_remove(ctx, type->info.lref.path);
-        break;
+    assert(module->ctx);
+    ctx = module->ctx;
 
-    case LY_TYPE_STRING:
-        lys_restr_free(ctx, type->info.str.length, private_destructor);
-        free(type->info.str.length);
-        for (i = 0; i < type->info.str.pat_count; i++) {
-            lys_restr_free(ctx, &type->info.str.patterns[i], private_destructor);
-#ifdef LY_ENABLED_CACHE
-            if (type->info.str.patterns_pcre) {
-                pcre_free((pcre*)type->info.str.patterns_pcre[2 * i]);
-                pcre_free_study((pcre_extra*)type->info.str.patterns_pcre[2 * i + 1]);
-            }
-#endif
-        }
-        free(type->info.str.patterns);
-#ifdef LY_ENABLED_CACHE
-        free(type->info.str.patterns_pcre);
-#endif
-        break;
+    /* just free the import array, imported modules will stay in the context */
+    for (i = 0; i < module->imp_size; i++) {
+        lydict_remove(ctx, module->imp[i].prefix);
+        lydict_remove(ctx, module->imp[i].dsc);
+        lydict_remove(ctx, module->imp[i].ref);
+        lys_extension_instances_free(ctx, module->imp[i].ext, module->imp[i].ext_size, private_destructor);
+    }
+    free(module->imp);
 
-    case LY_TYPE_UNION:
-        for (i = 0; i < type->info.uni.count; i++) {
-            lys_type_free(ctx, &type->info.uni.types[i], private_destructor);
+    /* submodules don't have data tree, the data nodes
+     * are placed in the main module altogether */
+    if (!module->type) {
+        LY_TREE_FOR_SAFE(module->data, next, iter) {
+            lys_node_free(iter, private_destructor, 0);
         }
-        free(type->info.uni.types);
-        break;
-
-    case LY_TYPE_IDENT:
-        free(type->info.ident.ref);
-        break;
-
-    default:
-        /* nothing to do for LY_TYPE_INST, LY_TYPE_BOOL, LY_TYPE_EMPTY */
-        break;
     }
-}
 
-static void
-lys_tpdf_free(struct ly_ctx *ctx, struct lys_tpdf *tpdf,
-              void (*private_destructor)(const struct lys_node *node, void *priv))
-{
-    assert(ctx);
-    if (!tpdf) {
-        return;
+    lydict_remove(ctx, module->dsc);
+    lydict_remove(ctx, module->ref);
+    lydict_remove(ctx, module->org);
+    lydict_remove(ctx, module->contact);
+    lydict_remove(ctx, module->filepath);
+
+    /* revisions */
+    for (i = 0; i < module->rev_size; i++) {
+        lys_extension_instances_free(ctx, module->rev[i].ext, module->rev[i].ext_size, private_destructor);
+        lydict_remove(ctx, module->rev[i].dsc);
+        lydict_remove(ctx, module->rev[i].ref);
     }
+    free(module->rev);
 
-    lydict_remove(ctx, tpdf->name);
-    lydict_remove(ctx, tpdf->dsc);
-    lydict_remove(ctx, tpdf->ref);
+    /* identities */
+    for (i = 0; i < module->ident_size; i++) {
+        lys_ident_free(ctx, &module->ident[i], private_destructor);
+    }
+    module->ident_size = 0;
+    free(module->ident);
 
-    lys_type_free(ctx, &tpdf->type, private_destructor);
+    /* typedefs */
+    for (i = 0; i < module->tpdf_size; i++) {
+        lys_tpdf_free(ctx, &module->tpdf[i], private_destructor);
+    }
+    free(module->tpdf);
 
-    lydict_remove(ctx, tpdf->units);
-    lydict_remove(ctx, tpdf->dflt);
+    /* extension instances */
+    lys_extension_instances_free(ctx, module->ext, module->ext_size, private_destructor);
 
-    lys_extension_instances_free(ctx, tpdf->ext, tpdf->ext_size, private_destructor);
-}
+    /* augment */
+    for (i = 0; i < module->augment_size; i++) {
+        lys_augment_free(ctx, &module->augment[i], private_destructor);
+    }
+    free(module->augment);
 
-static struct lys_when *
-lys_when_dup(struct lys_module *mod, struct lys_when *old, int shallow, struct unres_schema *unres)
-{
-    struct lys_when *new;
+    /* features */
+    for (i = 0; i < module->features_size; i++) {
+        lys_feature_free(ctx, &module->features[i], private_destructor);
+    }
+    free(module->features);
 
-    if (!old) {
-        return NULL;
+    /* deviations */
+    for (i = 0; i < module->deviation_size; i++) {
+        lys_deviation_free(module, &module->deviation[i], private_destructor);
     }
+    free(module->deviation);
 
-    new = calloc(1, sizeof *new);
-    LY_CHECK_ERR_RETURN(!new, LOGMEM(mod->ctx), NULL);
-    new->cond = lydict_insert(mod->ctx, old->cond, 0);
-    new->dsc = lydict_insert(mod->ctx, old->dsc, 0);
-    new->ref = lydict_insert(mod->ctx, old->ref, 0);
-    new->ext_size = old->ext_size;
-    lys_ext_dup(mod->ctx, mod, old->ext, old->ext_size, new, LYEXT_PAR_WHEN, &new->ext, shallow, unres);
+    /* extensions */
+    for (i = 0; i < module->extensions_size; i++) {
+        lys_extension_free(ctx, &module->extensions[i], private_destructor);
+    }
+    free(module->extensions);
 
-    return new;
+    lydict_remove(ctx, module->name);
+    lydict_remove(ctx, module->prefix);
 }
 
 void
-lys_when_free(struct ly_ctx *ctx, struct lys_when *w,
-              void (*private_destructor)(const struct lys_node *node, void *priv))
+lys_submodule_free(struct lys_submodule *submodule, void (*private_destructor)(const struct lys_node *node, void *priv))
 {
-    if (!w) {
+    int i;
+
+    if (!submodule) {
         return;
     }
 
-    lys_extension_instances_free(ctx, w->ext, w->ext_size, private_destructor);
-    lydict_remove(ctx, w->cond);
-    lydict_remove(ctx, w->dsc);
-    lydict_remove(ctx, w->ref);
-
-    free(w);
-}
-
-static void
-lys_augment_free(struct ly_ctx *ctx, struct lys_node_augment *aug,
-                 void (*private_destructor)(const struct lys_node *node, void *priv))
-{
-    struct lys_node *next, *sub;
+    /* common part with struct ly_module */
+    module_free_common((struct lys_module *)submodule, private_destructor);
 
-    /* children from a resolved augment are freed under the target node */
-    if (!aug->target || (aug->flags & LYS_NOTAPPLIED)) {
-        LY_TREE_FOR_SAFE(aug->child, next, sub) {
-            lys_node_free(sub, private_destructor, 0);
-        }
+    /* include */
+    for (i = 0; i < submodule->inc_size; i++) {
+        lydict_remove(submodule->ctx, submodule->inc[i].dsc);
+        lydict_remove(submodule->ctx, submodule->inc[i].ref);
+        lys_extension_instances_free(submodule->ctx, submodule->inc[i].ext, submodule->inc[i].ext_size, private_destructor);
+        /* complete submodule free is done only from main module since
+         * submodules propagate their includes to the main module */
     }
+    free(submodule->inc);
 
-    lydict_remove(ctx, aug->target_name);
-    lydict_remove(ctx, aug->dsc);
-    lydict_remove(ctx, aug->ref);
-
-    lys_iffeature_free(ctx, aug->iffeature, aug->iffeature_size, 0, private_destructor);
-    lys_extension_instances_free(ctx, aug->ext, aug->ext_size, private_destructor);
-
-    lys_when_free(ctx, aug->when, private_destructor);
+    free(submodule);
 }
 
-static void
-lys_ident_free(struct ly_ctx *ctx, struct lys_ident *ident,
-               void (*private_destructor)(const struct lys_node *node, void *priv))
+static size_t
+lys_set_mem_usage(const struct ly_set *set)
 {
-    assert(ctx);
-    if (!ident) {
-        return;
-    }
+    size_t size;
 
-    free(ident->base);
-    ly_set_free(ident->der);
-    lydict_remove(ctx, ident->name);
-    lydict_remove(ctx, ident->dsc);
-    lydict_remove(ctx, ident->ref);
-    lys_iffeature_free(ctx, ident->iffeature, ident->iffeature_size, 0, private_destructor);
-    lys_extension_instances_free(ctx, ident->ext, ident->ext_size, private_destructor);
+    if (!set) {
+        return 0;
+    }
 
+    size = sizeof *set + set->size * sizeof *set->set.g;
+#ifdef LY_ENABLED_CACHE
+    size += lyht_mem_size(set->ht);
+#endif
+    return size;
 }
 
-static void
-lys_grp_free(struct ly_ctx *ctx, struct lys_node_grp *grp,
-             void (*private_destructor)(const struct lys_node *node, void *priv))
+static size_t
+lys_ext_mem_usage(struct lys_ext_instance **ext, uint8_t ext_size)
 {
-    int i;
+    size_t size;
+    uint8_t i;
 
-    /* handle only specific parts for LYS_GROUPING */
-    for (i = 0; i < grp->tpdf_size; i++) {
-        lys_tpdf_free(ctx, &grp->tpdf[i], private_destructor);
+    size = ext_size * sizeof *ext;
+    for (i = 0; i < ext_size; ++i) {
+        if (ext[i]->ext_type == LYEXT_COMPLEX) {
+            size += sizeof(struct lys_ext_instance_complex);
+        } else {
+            size += sizeof **ext;
+        }
     }
-    free(grp->tpdf);
+    return size;
 }
 
-static void
-lys_rpc_action_free(struct ly_ctx *ctx, struct lys_node_rpc_action *rpc_act,
-             void (*private_destructor)(const struct lys_node *node, void *priv))
+static size_t
+lys_restr_mem_usage(const struct lys_restr *restr, uint8_t restr_size)
 {
-    int i;
+    size_t size;
+    uint8_t i;
 
-    /* handle only specific parts for LYS_GROUPING */
-    for (i = 0; i < rpc_act->tpdf_size; i++) {
-        lys_tpdf_free(ctx, &rpc_act->tpdf[i], private_destructor);
+    size = restr_size * sizeof *restr;
+    for (i = 0; i < restr_size; ++i) {
+        size += lys_ext_mem_usage(restr[i].ext, restr[i].ext_size);
     }
-    free(rpc_act->tpdf);
+    return size;
 }
 
-static void
-lys_inout_free(struct ly_ctx *ctx, struct lys_node_inout *io,
-               void (*private_destructor)(const struct lys_node *node, void *priv))
+static size_t
+lys_when_mem_usage(const struct lys_when *when)
 {
-    int i;
-
-    /* handle only specific parts for LYS_INPUT and LYS_OUTPUT */
-    for (i = 0; i < io->tpdf_size; i++) {
-        lys_tpdf_free(ctx, &io->tpdf[i], private_destructor);
-    }
-    free(io->tpdf);
-
-    for (i = 0; i < io->must_size; i++) {
-        lys_restr_free(ctx, &io->must[i], private_destructor);
-    }
-    free(io->must);
+    return when ? sizeof *when + lys_ext_mem_usage(when->ext, when->ext_size) : 0;
 }
 
 static void
-lys_notif_free(struct ly_ctx *ctx, struct lys_node_notif *notif,
-               void (*private_destructor)(const struct lys_node *node, void *priv))
+lys_type_mem_usage(const struct lys_type *type, struct ly_ctx_mem_usage *usage)
 {
-    int i;
+    unsigned int i;
 
-    for (i = 0; i < notif->must_size; i++) {
-        lys_restr_free(ctx, &notif->must[i], private_destructor);
+    usage->modules += lys_ext_mem_usage(type->ext, type->ext_size);
+#ifdef LY_ENABLED_CACHE
+    if (type->eff) {
+        usage->types += sizeof(struct lys_type_eff) + ((struct lys_type_eff *)type->eff)->pat_count
+                * sizeof *((struct lys_type_eff *)type->eff)->pat;
     }
-    free(notif->must);
-
-    for (i = 0; i < notif->tpdf_size; i++) {
-        lys_tpdf_free(ctx, &notif->tpdf[i], private_destructor);
+#endif
+    if (type->value_flags & LY_VALUE_SHARED) {
+        /* owned by the type in the grouping */
+        return;
     }
-    free(notif->tpdf);
-}
-static void
-lys_anydata_free(struct ly_ctx *ctx, struct lys_node_anydata *anyxml,
-                 void (*private_destructor)(const struct lys_node *node, void *priv))
-{
-    int i;
 
-    for (i = 0; i < anyxml->must_size; i++) {
-        lys_restr_free(ctx, &anyxml->must[i], private_destructor);
+    switch (type->base) {
+    case LY_TYPE_BINARY:
+        usage->types += type->info.binary.length ? lys_restr_mem_usage(type->info.binary.length, 1) : 0;
+        break;
+    case LY_TYPE_BITS:
+        usage->types += type->info.bits.count * sizeof *type->info.bits.bit;
+        for (i = 0; i < type->info.bits.count; ++i) {
+            usage->types += type->info.bits.bit[i].iffeature_size * sizeof *type->info.bits.bit[i].iffeature
+                    + lys_ext_mem_usage(type->info.bits.bit[i].ext, type->info.bits.bit[i].ext_size);
+        }
+        break;
+    case LY_TYPE_DEC64:
+        usage->types += type->info.dec64.range ? lys_restr_mem_usage(type->info.dec64.range, 1) : 0;
+        break;
+    case LY_TYPE_ENUM:
+        usage->types += type->info.enums.count * sizeof *type->info.enums.enm;
+        for (i = 0; i < type->info.enums.count; ++i) {
+            usage->types += type->info.enums.enm[i].iffeature_size * sizeof *type->info.enums.enm[i].iffeature
+                    + lys_ext_mem_usage(type->info.enums.enm[i].ext, type->info.enums.enm[i].ext_size);
+        }
+        break;
+    case LY_TYPE_INT8:
+    case LY_TYPE_INT16:
+    case LY_TYPE_INT32:
+    case LY_TYPE_INT64:
+    case LY_TYPE_UINT8:
+    case LY_TYPE_UINT16:
+    case LY_TYPE_UINT32:
+    case LY_TYPE_UINT64:
+        usage->types += type->info.num.range ? lys_restr_mem_usage(type->info.num.range, 1) : 0;
+        break;
+    case LY_TYPE_STRING:
+        usage->types += type->info.str.length ? lys_restr_mem_usage(type->info.str.length, 1) : 0;
+        usage->types += type->info.str.pat_count * sizeof *type->info.str.patterns;
+#ifdef LY_ENABLED_CACHE
+        if (type->info.str.patterns_pcre) {
+            usage->types += 2 * type->info.str.pat_count * sizeof *type->info.str.patterns_pcre;
+            for (i = 0; i < type->info.str.pat_count; ++i) {
+                usage->patterns += lyp_regex_mem_size((pcre *)type->info.str.patterns_pcre[2 * i],
+                                                      (pcre_extra *)type->info.str.patterns_pcre[2 * i + 1]);
+            }
+        }
+#endif
+        break;
+    case LY_TYPE_UNION:
+        usage->types += type->info.uni.count * sizeof *type->info.uni.types;
+        for (i = 0; i < type->info.uni.count; ++i) {
+            lys_type_mem_usage(&type->info.uni.types[i], usage);
+        }
+        break;
+    case LY_TYPE_IDENT:
+        usage->types += type->info.ident.count * sizeof *type->info.ident.ref;
+        break;
+    default:
+        break;
     }
-    free(anyxml->must);
-
-    lys_when_free(ctx, anyxml->when, private_destructor);
 }
 
 static void
-lys_leaf_free(struct ly_ctx *ctx, struct lys_node_leaf *leaf,
-              void (*private_destructor)(const struct lys_node *node, void *priv))
+lys_tpdf_mem_usage(const struct lys_tpdf *tpdf, uint16_t tpdf_size, struct ly_ctx_mem_usage *usage)
 {
-    int i;
-
-    /* leafref backlinks */
-    ly_set_free((struct ly_set *)leaf->backlinks);
+    uint16_t i;
 
-    for (i = 0; i < leaf->must_size; i++) {
-        lys_restr_free(ctx, &leaf->must[i], private_destructor);
+    usage->modules += tpdf_size * sizeof *tpdf;
+    for (i = 0; i < tpdf_size; ++i) {
+        usage->modules += lys_ext_mem_usage(tpdf[i].ext, tpdf[i].ext_size);
+        lys_type_mem_usage(&tpdf[i].type, usage);
     }
-    free(leaf->must);
-
-    lys_when_free(ctx, leaf->when, private_destructor);
-
-    lys_type_free(ctx, &leaf->type, private_destructor);
-    lydict_remove(ctx, leaf->units);
-    lydict_remove(ctx, leaf->dflt);
 }
 
 static void
-lys_leaflist_free(struct ly_ctx *ctx, struct lys_node_leaflist *llist,
-                  void (*private_destructor)(const struct lys_node *node, void *priv))
+lys_node_mem_usage_r(const struct lys_node *node, struct ly_ctx_mem_usage *usage)
 {
+    const struct lys_node *child;
+    const struct lys_node_container *cont;
+    const struct lys_node_leaf *leaf;
+    const struct lys_node_leaflist *llist;
+    const struct lys_node_list *list;
+    const struct lys_node_uses *uses;
+    size_t size = 0;
     int i;
 
-    if (llist->backlinks) {
-        /* leafref backlinks */
-        ly_set_free(llist->backlinks);
+    if (!(node->nodetype & (LYS_INPUT | LYS_OUTPUT))) {
+        size += node->iffeature_size * sizeof *node->iffeature;
     }
+    size += lys_ext_mem_usage(node->ext, node->ext_size);
 
-    for (i = 0; i < llist->must_size; i++) {
-        lys_restr_free(ctx, &llist->must[i], private_destructor);
+    switch (node->nodetype) {
+    case LYS_CONTAINER:
+        cont = (const struct lys_node_container *)node;
+        size += sizeof *cont + lys_when_mem_usage(cont->when) + lys_restr_mem_usage(cont->must, cont->must_size);
+        lys_tpdf_mem_usage(cont->tpdf, cont->tpdf_size, usage);
+        break;
+    case LYS_CHOICE:
+        size += sizeof(struct lys_node_choice) + lys_when_mem_usage(((struct lys_node_choice *)node)->when);
+        break;
+    case LYS_CASE:
+        size += sizeof(struct lys_node_case) + lys_when_mem_usage(((struct lys_node_case *)node)->when);
+        break;
+    case LYS_LEAF:
+        leaf = (const struct lys_node_leaf *)node;
+        size += sizeof *leaf + lys_when_mem_usage(leaf->when) + lys_restr_mem_usage(leaf->must, leaf->must_size)
+                + lys_set_mem_usage(leaf->backlinks);
+        lys_type_mem_usage(&leaf->type, usage);
+        break;
+    case LYS_LEAFLIST:
+        llist = (const struct lys_node_leaflist *)node;
+        size += sizeof *llist + lys_when_mem_usage(llist->when) + lys_restr_mem_usage(llist->must, llist->must_size)
+                + lys_set_mem_usage(llist->backlinks) + llist->dflt_size * sizeof *llist->dflt;
+        lys_type_mem_usage(&llist->type, usage);
+        break;
+    case LYS_LIST:
+        list = (const struct lys_node_list *)node;
+        size += sizeof *list + lys_when_mem_usage(list->when) + lys_restr_mem_usage(list->must, list->must_size)
+                + list->keys_size * sizeof *list->keys + list->unique_size * sizeof *list->unique;
+        for (i = 0; i < list->unique_size; ++i) {
+            size += list->unique[i].expr_size * sizeof *list->unique[i].expr;
+        }
+        lys_tpdf_mem_usage(list->tpdf, list->tpdf_size, usage);
+        break;
+    case LYS_ANYXML:
+    case LYS_ANYDATA:
+        size += sizeof(struct lys_node_anydata) + lys_when_mem_usage(((struct lys_node_anydata *)node)->when)
+                + lys_restr_mem_usage(((struct lys_node_anydata *)node)->must, ((struct lys_node_anydata *)node)->must_size);
+        break;
+    case LYS_USES:
+        uses = (const struct lys_node_uses *)node;
+        size += sizeof *uses + lys_when_mem_usage(uses->when) + uses->refine_size * sizeof *uses->refine
+                + uses->augment_size * sizeof *uses->augment;
+        for (i = 0; i < uses->refine_size; ++i) {
+            size += lys_restr_mem_usage(uses->refine[i].must, uses->refine[i].must_size)
+                    + uses->refine[i].dflt_size * sizeof *uses->refine[i].dflt;
+        }
+        for (i = 0; i < uses->augment_size; ++i) {
+            size += lys_when_mem_usage(uses->augment[i].when);
+        }
+        break;
+    case LYS_GROUPING:
+        size += sizeof(struct lys_node_grp);
+        lys_tpdf_mem_usage(((struct lys_node_grp *)node)->tpdf, ((struct lys_node_grp *)node)->tpdf_size, usage);
+        break;
+    case LYS_RPC:
+    case LYS_ACTION:
+        size += sizeof(struct lys_node_rpc_action);
+        lys_tpdf_mem_usage(((struct lys_node_rpc_action *)node)->tpdf, ((struct lys_node_rpc_action *)node)->tpdf_size,
+                           usage);
+        break;
+    case LYS_INPUT:
+    case LYS_OUTPUT:
+        size += sizeof(struct lys_node_inout)
+                + lys_restr_mem_usage(((struct lys_node_inout *)node)->must, ((struct lys_node_inout *)node)->must_size);
+        lys_tpdf_mem_usage(((struct lys_node_inout *)node)->tpdf, ((struct lys_node_inout *)node)->tpdf_size, usage);
+        break;
+    case LYS_NOTIF:
+        size += sizeof(struct lys_node_notif)
+                + lys_restr_mem_usage(((struct lys_node_notif *)node)->must, ((struct lys_node_notif *)node)->must_size);
+        lys_tpdf_mem_usage(((struct lys_node_notif *)node)->tpdf, ((struct lys_node_notif *)node)->tpdf_size, usage);
+        break;
+    default:
+        break;
     }
-    free(llist->must);
+    usage->modules += size;
 
-    for (i = 0; i < llist->dflt_size; i++) {
-        lydict_remove(ctx, llist->dflt[i]);
+    if (!(node->nodetype & (LYS_LEAF | LYS_LEAFLIST))) {
+        /* including the nodes of the applied augments */
+        LY_TREE_FOR(node->child, child) {
+            lys_node_mem_usage_r(child, usage);
+        }
     }
-    free(llist->dflt);
-
-    lys_when_free(ctx, llist->when, private_destructor);
-
-    lys_type_free(ctx, &llist->type, private_destructor);
-    lydict_remove(ctx, llist->units);
 }
 
+/* the parts common for modules and submodules */
 static void
-lys_list_free(struct ly_ctx *ctx, struct lys_node_list *list,
-              void (*private_destructor)(const struct lys_node *node, void *priv))
+lys_module_mem_usage_common(const struct lys_module *module, struct ly_ctx_mem_usage *usage)
 {
+    const struct lys_node *child;
+    size_t size;
     int i, j;
 
-    /* handle only specific parts for LY_NODE_LIST */
-    lys_when_free(ctx, list->when, private_destructor);
+    size = module->imp_size * sizeof *module->imp + module->inc_size * sizeof *module->inc
+            + module->rev_size * sizeof *module->rev + lys_ext_mem_usage(module->ext, module->ext_size);
+    for (i = 0; i < module->imp_size; ++i) {
+        size += lys_ext_mem_usage(module->imp[i].ext, module->imp[i].ext_size);
+    }
+    for (i = 0; i < module->rev_size; ++i) {
+        size += lys_ext_mem_usage(module->rev[i].ext, module->rev[i].ext_size);
+    }
 
-    for (i = 0; i < list->must_size; i++) {
-        lys_restr_free(ctx, &list->must[i], private_destructor);
+    size += module->ident_size * sizeof *module->ident;
+    for (i = 0; i < module->ident_size; ++i) {
+        size += module->ident[i].base_size * sizeof *module->ident[i].base + lys_set_mem_usage(module->ident[i].der)
+                + module->ident[i].iffeature_size * sizeof *module->ident[i].iffeature
+                + lys_ext_mem_usage(module->ident[i].ext, module->ident[i].ext_size);
     }
-    free(list->must);
 
-    for (i = 0; i < list->tpdf_size; i++) {
-        lys_tpdf_free(ctx, &list->tpdf[i], private_destructor);
+    size += module->features_size * sizeof *module->features;
+    for (i = 0; i < module->features_size; ++i) {
+        size += lys_set_mem_usage(module->features[i].depfeatures)
+                + module->features[i].iffeature_size * sizeof *module->features[i].iffeature
+                + lys_ext_mem_usage(module->features[i].ext, module->features[i].ext_size);
     }
-    free(list->tpdf);
 
-    free(list->keys);
+    size += module->augment_size * sizeof *module->augment;
+    for (i = 0; i < module->augment_size; ++i) {
+        size += lys_when_mem_usage(module->augment[i].when)
+                + module->augment[i].iffeature_size * sizeof *module->augment[i].iffeature
+                + lys_ext_mem_usage(module->augment[i].ext, module->augment[i].ext_size);
+        if (!module->augment[i].target || (module->augment[i].flags & LYS_NOTAPPLIED)) {
+            /* otherwise the children are counted under the target */
+            LY_TREE_FOR(module->augment[i].child, child) {
+                lys_node_mem_usage_r(child, usage);
+            }
+        }
+    }
 
-    for (i = 0; i < list->unique_size; i++) {
-        for (j = 0; j < list->unique[i].expr_size; j++) {
-            lydict_remove(ctx, list->unique[i].expr[j]);
+    size += module->deviation_size * sizeof *module->deviation;
+    for (i = 0; i < module->deviation_size; ++i) {
+        size += module->deviation[i].deviate_size * sizeof *module->deviation[i].deviate
+                + lys_ext_mem_usage(module->deviation[i].ext, module->deviation[i].ext_size);
+        for (j = 0; j < module->deviation[i].deviate_size; ++j) {
+            size += module->deviation[i].deviate[j].dflt_size * sizeof *module->deviation[i].deviate[j].dflt;
         }
-        free(list->unique[i].expr);
     }
-    free(list->unique);
 
-    lydict_remove(ctx, list->keys_str);
+    size += module->extensions_size * sizeof *module->extensions;
+    usage->modules += size;
+
+    lys_tpdf_mem_usage(module->tpdf, module->tpdf_size, usage);
 }
 
-static void
-lys_container_free(struct ly_ctx *ctx, struct lys_node_container *cont,
-                   void (*private_destructor)(const struct lys_node *node, void *priv))
+void
+lys_mem_usage(const struct lys_module *module, struct ly_ctx_mem_usage *usage)
 {
+    const struct lys_node *node;
     int i;
 
-    /* handle only specific parts for LY_NODE_CONTAINER */
-    lydict_remove(ctx, cont->presence);
+    usage->modules += sizeof *module;
+    lys_module_mem_usage_common(module, usage);
 
-    for (i = 0; i < cont->tpdf_size; i++) {
-        lys_tpdf_free(ctx, &cont->tpdf[i], private_destructor);
+    for (i = 0; i < module->inc_size; ++i) {
+        if (module->inc[i].submodule) {
+            usage->modules += sizeof *module->inc[i].submodule;
+            lys_module_mem_usage_common((struct lys_module *)module->inc[i].submodule, usage);
+        }
     }
-    free(cont->tpdf);
 
-    for (i = 0; i < cont->must_size; i++) {
-        lys_restr_free(ctx, &cont->must[i], private_destructor);
+    /* the data nodes of the submodules are connected to the main module */
+    LY_TREE_FOR(module->data, node) {
+        lys_node_mem_usage_r(node, usage);
     }
-    free(cont->must);
-
-    lys_when_free(ctx, cont->when, private_destructor);
-}
-
-static void
-lys_feature_free(struct ly_ctx *ctx, struct lys_feature *f,
-                 void (*private_destructor)(const struct lys_node *node, void *priv))
-{
-    lydict_remove(ctx, f->name);
-    lydict_remove(ctx, f->dsc);
-    lydict_remove(ctx, f->ref);
-    lys_iffeature_free(ctx, f->iffeature, f->iffeature_size, 0, private_destructor);
-    ly_set_free(f->depfeatures);
-    lys_extension_instances_free(ctx, f->ext, f->ext_size, private_destructor);
 }
 
-static void
-lys_extension_free(struct ly_ctx *ctx, struct lys_ext *e,
-                   void (*private_destructor)(const struct lys_node *node, void *priv))
-{
-    lydict_remove(ctx, e->name);
-    lydict_remove(ctx, e->dsc);
-    lydict_remove(ctx, e->ref);
-    lydict_remove(ctx, e->argument);
-    lys_extension_instances_free(ctx, e->ext, e->ext_size, private_destructor);
-}
+#ifdef LY_ENABLED_CACHE
 
 static void
-lys_deviation_free(struct lys_module *module, struct lys_deviation *dev,
-                   void (*private_destructor)(const struct lys_node *node, void *priv))
+lys_iffeature_precompile(struct lys_iffeature *iffeature, uint8_t iffeature_size)
 {
-    int i, j, k;
-    struct ly_ctx *ctx;
-    struct lys_node *next, *elem;
-
-    ctx = module->ctx;
-
-    lydict_remove(ctx, dev->target_name);
-    lydict_remove(ctx, dev->dsc);
-    lydict_remove(ctx, dev->ref);
-    lys_extension_instances_free(ctx, dev->ext, dev->ext_size, private_destructor);
+    uint8_t i;
 
-    if (!dev->deviate) {
-        return;
+    for (i = 0; i < iffeature_size; ++i) {
+        resolve_iffeature(&iffeature[i]);
     }
+}
 
-    /* it could not be applied because it failed to be applied */
-    if (dev->orig_node) {
-        /* the module was freed, but we only need the context from orig_node, use ours */
-        if (dev->deviate[0].mod == LY_DEVIATE_NO) {
-            /* it's actually a node subtree, we need to update modules on all the nodes :-/ */
-            LY_TREE_DFS_BEGIN(dev->orig_node, next, elem) {
-                elem->module = module;
+static int
+lys_restr_precompile(struct ly_ctx *ctx, struct lys_restr *must, uint8_t must_size)
+{
+    uint8_t i;
 
-                LY_TREE_DFS_END(dev->orig_node, next, elem);
-            }
-            lys_node_free(dev->orig_node, NULL, 0);
-        } else {
-            /* it's just a shallow copy, freeing one node */
-            dev->orig_node->module = module;
-            lys_node_free(dev->orig_node, NULL, 1);
+    for (i = 0; i < must_size; ++i) {
+        if (!lyxp_compile_expr_cached(ctx, must[i].expr, &must[i].expr_xpath)) {
+            return -1;
         }
     }
+    return 0;
+}
 
-    for (i = 0; i < dev->deviate_size; i++) {
-        lys_extension_instances_free(ctx, dev->deviate[i].ext, dev->deviate[i].ext_size, private_destructor);
-
-        for (j = 0; j < dev->deviate[i].dflt_size; j++) {
-            lydict_remove(ctx, dev->deviate[i].dflt[j]);
-        }
-        free(dev->deviate[i].dflt);
-
-        lydict_remove(ctx, dev->deviate[i].units);
-
-        if (dev->deviate[i].mod == LY_DEVIATE_DEL) {
-            for (j = 0; j < dev->deviate[i].must_size; j++) {
-                lys_restr_free(ctx, &dev->deviate[i].must[j], private_destructor);
-            }
-            free(dev->deviate[i].must);
-
-            for (j = 0; j < dev->deviate[i].unique_size; j++) {
-                for (k = 0; k < dev->deviate[i].unique[j].expr_size; k++) {
-                    lydict_remove(ctx, dev->deviate[i].unique[j].expr[k]);
-                }
-                free(dev->deviate[i].unique[j].expr);
-            }
-            free(dev->deviate[i].unique);
-        }
+static int
+lys_when_precompile(struct ly_ctx *ctx, struct lys_when *when)
+{
+    if (when && !lyxp_compile_expr_cached(ctx, when->cond, &when->cond_xpath)) {
+        return -1;
     }
-    free(dev->deviate);
+    return 0;
 }
 
-static void
-lys_uses_free(struct ly_ctx *ctx, struct lys_node_uses *uses,
-              void (*private_destructor)(const struct lys_node *node, void *priv))
+static int
+lys_type_precompile(struct ly_ctx *ctx, struct lys_type *type)
 {
-    int i, j;
-
-    for (i = 0; i < uses->refine_size; i++) {
-        lydict_remove(ctx, uses->refine[i].target_name);
-        lydict_remove(ctx, uses->refine[i].dsc);
-        lydict_remove(ctx, uses->refine[i].ref);
-
-        lys_iffeature_free(ctx, uses->refine[i].iffeature, uses->refine[i].iffeature_size, 0, private_destructor);
+    struct len_ran_cmp *intv;
+    unsigned int i;
 
-        for (j = 0; j < uses->refine[i].must_size; j++) {
-            lys_restr_free(ctx, &uses->refine[i].must[j], private_destructor);
+    switch (type->base) {
+    case LY_TYPE_STRING:
+        if (type->info.str.pat_count && !type->info.str.patterns_pcre && !(type->value_flags & LY_VALUE_SHARED)
+                && lys_type_precompile_patterns(ctx, type)) {
+            return -1;
         }
-        free(uses->refine[i].must);
-
-        for (j = 0; j < uses->refine[i].dflt_size; j++) {
-            lydict_remove(ctx, uses->refine[i].dflt[j]);
+        /* fallthrough */
+    case LY_TYPE_BINARY:
+    case LY_TYPE_DEC64:
+    case LY_TYPE_INT8:
+    case LY_TYPE_INT16:
+    case LY_TYPE_INT32:
+    case LY_TYPE_INT64:
+    case LY_TYPE_UINT8:
+    case LY_TYPE_UINT16:
+    case LY_TYPE_UINT32:
+    case LY_TYPE_UINT64:
+        /* owned by the restriction */
+        return resolve_len_ran_compiled(ctx, type, &intv);
+    case LY_TYPE_BITS:
+        for (i = 0; i < type->info.bits.count; ++i) {
+            lys_iffeature_precompile(type->info.bits.bit[i].iffeature, type->info.bits.bit[i].iffeature_size);
         }
-        free(uses->refine[i].dflt);
-
-        lys_extension_instances_free(ctx, uses->refine[i].ext, uses->refine[i].ext_size, private_destructor);
-
-        if (uses->refine[i].target_type & LYS_CONTAINER) {
-            lydict_remove(ctx, uses->refine[i].mod.presence);
+        break;
+    case LY_TYPE_ENUM:
+        for (i = 0; i < type->info.enums.count; ++i) {
+            lys_iffeature_precompile(type->info.enums.enm[i].iffeature, type->info.enums.enm[i].iffeature_size);
         }
+        break;
+    case LY_TYPE_UNION:
+        for (i = 0; i < type->info.uni.count; ++i) {
+            if (lys_type_precompile(ctx, &type->info.uni.types[i])) {
+                return -1;
+            }
+        }
+        break;
+    default:
+        break;
     }
-    free(uses->refine);
-
-    for (i = 0; i < uses->augment_size; i++) {
-        lys_augment_free(ctx, &uses->augment[i], private_destructor);
-    }
-    free(uses->augment);
-
-    lys_when_free(ctx, uses->when, private_destructor);
+    return 0;
 }
 
-void
-lys_node_free(struct lys_node *node, void (*private_destructor)(const struct lys_node *node, void *priv), int shallow)
+static int
+lys_tpdf_precompile(struct ly_ctx *ctx, struct lys_tpdf *tpdf, uint16_t tpdf_size)
 {
-    struct ly_ctx *ctx;
-    struct lys_node *sub, *next;
+    uint32_t hash;
+    uint16_t i;
 
-    if (!node) {
-        return;
+    for (i = 0; i < tpdf_size; ++i) {
+        /* only looks up and remembers the user type plugin */
+        lytype_hash(&tpdf[i], NULL, &hash);
+        if (lys_type_precompile(ctx, &tpdf[i].type)) {
+            return -1;
+        }
     }
+    return 0;
+}
 
-    assert(node->module);
-    assert(node->module->ctx);
-
-    ctx = node->module->ctx;
-
-    /* remove private object */
-    if (node->priv && private_destructor) {
-        private_destructor(node, node->priv);
-    }
+static int
+lys_node_precompile_r(struct ly_ctx *ctx, struct lys_node *node, int in_grp)
+{
+    struct lys_node *child;
+    struct lys_node_uses *uses;
+    const struct lys_node *dummy;
+    struct lys_tpdf *tpdf = NULL;
+    struct lys_restr *must = NULL;
+    struct lys_when *when = NULL;
+    struct lys_type *type = NULL;
+    uint16_t tpdf_size = 0;
+    uint8_t must_size = 0;
+    int i;
 
-    /* common part */
-    lydict_remove(ctx, node->name);
     if (!(node->nodetype & (LYS_INPUT | LYS_OUTPUT))) {
-        lys_iffeature_free(ctx, node->iffeature, node->iffeature_size, shallow, private_destructor);
-        lydict_remove(ctx, node->dsc);
-        lydict_remove(ctx, node->ref);
+        lys_iffeature_precompile(node->iffeature, node->iffeature_size);
     }
 
-    if (!shallow && !(node->nodetype & (LYS_LEAF | LYS_LEAFLIST))) {
-        LY_TREE_FOR_SAFE(node->child, next, sub) {
-            lys_node_free(sub, private_destructor, 0);
-        }
-    }
-
-    lys_extension_instances_free(ctx, node->ext, node->ext_size, private_destructor);
-
-    /* specific part */
     switch (node->nodetype) {
     case LYS_CONTAINER:
-        lys_container_free(ctx, (struct lys_node_container *)node, private_destructor);
+        when = ((struct lys_node_container *)node)->when;
+        must = ((struct lys_node_container *)node)->must;
+        must_size = ((struct lys_node_container *)node)->must_size;
+        tpdf = ((struct lys_node_container *)node)->tpdf;
+        tpdf_size = ((struct lys_node_container *)node)->tpdf_size;
         break;
     case LYS_CHOICE:
-        lys_when_free(ctx, ((struct lys_node_choice *)node)->when, private_destructor);
+        when = ((struct lys_node_choice *)node)->when;
+        break;
+    case LYS_CASE:
+        when = ((struct lys_node_case *)node)->when;
         break;
     case LYS_LEAF:
-        lys_leaf_free(ctx, (struct lys_node_leaf *)node, private_destructor);
+        when = ((struct lys_node_leaf *)node)->when;
+        must = ((struct lys_node_leaf *)node)->must;
+        must_size = ((struct lys_node_leaf *)node)->must_size;
+        type = &((struct lys_node_leaf *)node)->type;
         break;
     case LYS_LEAFLIST:
-        lys_leaflist_free(ctx, (struct lys_node_leaflist *)node, private_destructor);
+        when = ((struct lys_node_leaflist *)node)->when;
+        must = ((struct lys_node_leaflist *)node)->must;
+        must_size = ((struct lys_node_leaflist *)node)->must_size;
+        type = &((struct lys_node_leaflist *)node)->type;
         break;
     case LYS_LIST:
-        lys_list_free(ctx, (struct lys_node_list *)node, private_destructor);
+        when = ((struct lys_node_list *)node)->when;
+        must = ((struct lys_node_list *)node)->must;
+        must_size = ((struct lys_node_list *)node)->must_size;
+        tpdf = ((struct lys_node_list *)node)->tpdf;
+        tpdf_size = ((struct lys_node_list *)node)->tpdf_size;
         break;
     case LYS_ANYXML:
     case LYS_ANYDATA:
-        lys_anydata_free(ctx, (struct lys_node_anydata *)node, private_destructor);
+        when = ((struct lys_node_anydata *)node)->when;
+        must = ((struct lys_node_anydata *)node)->must;
+        must_size = ((struct lys_node_anydata *)node)->must_size;
         break;
     case LYS_USES:
-        lys_uses_free(ctx, (struct lys_node_uses *)node, private_destructor);
-        break;
-    case LYS_CASE:
-        lys_when_free(ctx, ((struct lys_node_case *)node)->when, private_destructor);
-        break;
-    case LYS_AUGMENT:
-        /* do nothing */
+        uses = (struct lys_node_uses *)node;
+        when = uses->when;
+        for (i = 0; i < uses->augment_size; ++i) {
+            if (!in_grp && lys_when_precompile(ctx, uses->augment[i].when)) {
+                return -1;
+            }
+        }
         break;
     case LYS_GROUPING:
-        lys_grp_free(ctx, (struct lys_node_grp *)node, private_destructor);
+        /* the typedefs are referenced from the instances, the rest is never evaluated */
+        in_grp = 1;
+        tpdf = ((struct lys_node_grp *)node)->tpdf;
+        tpdf_size = ((struct lys_node_grp *)node)->tpdf_size;
         break;
     case LYS_RPC:
     case LYS_ACTION:
-        lys_rpc_action_free(ctx, (struct lys_node_rpc_action *)node, private_destructor);
-        break;
-    case LYS_NOTIF:
-        lys_notif_free(ctx, (struct lys_node_notif *)node, private_destructor);
+        tpdf = ((struct lys_node_rpc_action *)node)->tpdf;
+        tpdf_size = ((struct lys_node_rpc_action *)node)->tpdf_size;
         break;
     case LYS_INPUT:
     case LYS_OUTPUT:
-        lys_inout_free(ctx, (struct lys_node_inout *)node, private_destructor);
+        must = ((struct lys_node_inout *)node)->must;
+        must_size = ((struct lys_node_inout *)node)->must_size;
+        tpdf = ((struct lys_node_inout *)node)->tpdf;
+        tpdf_size = ((struct lys_node_inout *)node)->tpdf_size;
         break;
-    case LYS_EXT:
-    case LYS_UNKNOWN:
-        LOGINT(ctx);
+    case LYS_NOTIF:
+        must = ((struct lys_node_notif *)node)->must;
+        must_size = ((struct lys_node_notif *)node)->must_size;
+        tpdf = ((struct lys_node_notif *)node)->tpdf;
+        tpdf_size = ((struct lys_node_notif *)node)->tpdf_size;
+        break;
+    default:
         break;
     }
 
-    /* again common part */
-    lys_node_unlink(node);
-    free(node);
-}
-
-API struct lys_module *
-lys_implemented_module(const struct lys_module *mod)
-{
-    struct ly_ctx *ctx;
-    int i;
-
-    if (!mod || mod->implemented) {
-        /* invalid argument or the module itself is implemented */
-        return (struct lys_module *)mod;
+    if (lys_tpdf_precompile(ctx, tpdf, tpdf_size) || (type && lys_type_precompile(ctx, type))) {
+        return -1;
     }
-
-    ctx = mod->ctx;
-    for (i = 0; i < ctx->models.used; i++) {
-        if (!ctx->models.list[i]->implemented) {
-            continue;
+    if (!in_grp) {
+        if (lys_when_precompile(ctx, when) || lys_restr_precompile(ctx, must, must_size)
+                || (type && !lys_type_eff(ctx, type))) {
+            return -1;
         }
 
-        if (ly_strequal(mod->name, ctx->models.list[i]->name, 1)) {
-            /* we have some revision of the module implemented */
-            return ctx->models.list[i];
+        /* fill the context lookup tables, searching for no name stores all the children */
+        if (node->nodetype & (LYS_RPC | LYS_ACTION)) {
+            lys_find_child_hash(ctx, node, NULL, LYS_INPUT, "", 0, NULL, &dummy);
+            lys_find_child_hash(ctx, node, NULL, LYS_OUTPUT, "", 0, NULL, &dummy);
+        } else {
+            lys_find_child_hash(ctx, node, NULL, 0, "", 0, NULL, &dummy);
         }
+        lys_find_schema_child_hash(ctx, node, NULL, "", 0, NULL, &dummy);
+        lys_mand_subtree(ctx, node);
     }
 
-    /* we have no revision of the module implemented, return the module itself,
-     * it is up to the caller to set the module implemented when needed */
-    return (struct lys_module *)mod;
-}
-
-/* free_int_mods - flag whether to free the internal modules as well */
-static void
-module_free_common(struct lys_module *module, void (*private_destructor)(const struct lys_node *node, void *priv))
-{
-    struct ly_ctx *ctx;
-    struct lys_node *next, *iter;
-    unsigned int i;
-
-    assert(module->ctx);
-    ctx = module->ctx;
-
-    /* just free the import array, imported modules will stay in the context */
-    for (i = 0; i < module->imp_size; i++) {
-        lydict_remove(ctx, module->imp[i].prefix);
-        lydict_remove(ctx, module->imp[i].dsc);
-        lydict_remove(ctx, module->imp[i].ref);
-        lys_extension_instances_free(ctx, module->imp[i].ext, module->imp[i].ext_size, private_destructor);
-    }
-    free(module->imp);
-
-    /* submodules don't have data tree, the data nodes
-     * are placed in the main module altogether */
-    if (!module->type) {
-        LY_TREE_FOR_SAFE(module->data, next, iter) {
-            lys_node_free(iter, private_destructor, 0);
+    if (!(node->nodetype & (LYS_LEAF | LYS_LEAFLIST))) {
+        LY_TREE_FOR(node->child, child) {
+            if (lys_node_precompile_r(ctx, child, in_grp)) {
+                return -1;
+            }
         }
     }
+    return 0;
+}
 
-    lydict_remove(ctx, module->dsc);
-    lydict_remove(ctx, module->ref);
-    lydict_remove(ctx, module->org);
-    lydict_remove(ctx, module->contact);
-    lydict_remove(ctx, module->filepath);
-
-    /* revisions */
-    for (i = 0; i < module->rev_size; i++) {
-        lys_extension_instances_free(ctx, module->rev[i].ext, module->rev[i].ext_size, private_destructor);
-        lydict_remove(ctx, module->rev[i].dsc);
-        lydict_remove(ctx, module->rev[i].ref);
-    }
-    free(module->rev);
-
-    /* identities */
-    for (i = 0; i < module->ident_size; i++) {
-        lys_ident_free(ctx, &module->ident[i], private_destructor);
-    }
-    module->ident_size = 0;
-    free(module->ident);
-
-    /* typedefs */
-    for (i = 0; i < module->tpdf_size; i++) {
-        lys_tpdf_free(ctx, &module->tpdf[i], private_destructor);
-    }
-    free(module->tpdf);
-
-    /* extension instances */
-    lys_extension_instances_free(ctx, module->ext, module->ext_size, private_destructor);
-
-    /* augment */
-    for (i = 0; i < module->augment_size; i++) {
-        lys_augment_free(ctx, &module->augment[i], private_destructor);
-    }
-    free(module->augment);
+/* the parts common for modules and submodules */
+static int
+lys_module_precompile_common(struct lys_module *module)
+{
+    struct lys_node *child;
+    int i;
 
-    /* features */
-    for (i = 0; i < module->features_size; i++) {
-        lys_feature_free(ctx, &module->features[i], private_destructor);
+    for (i = 0; i < module->ident_size; ++i) {
+        lys_iffeature_precompile(module->ident[i].iffeature, module->ident[i].iffeature_size);
     }
-    free(module->features);
-
-    /* deviations */
-    for (i = 0; i < module->deviation_size; i++) {
-        lys_deviation_free(module, &module->deviation[i], private_destructor);
+    for (i = 0; i < module->features_size; ++i) {
+        lys_iffeature_precompile(module->features[i].iffeature, module->features[i].iffeature_size);
     }
-    free(module->deviation);
-
-    /* extensions */
-    for (i = 0; i < module->extensions_size; i++) {
-        lys_extension_free(ctx, &module->extensions[i], private_destructor);
+    for (i = 0; i < module->augment_size; ++i) {
+        lys_iffeature_precompile(module->augment[i].iffeature, module->augment[i].iffeature_size);
+        if (lys_when_precompile(module->ctx, module->augment[i].when)) {
+            return -1;
+        }
+        if (!module->augment[i].target || (module->augment[i].flags & LYS_NOTAPPLIED)) {
+            /* otherwise the children are walked under the target */
+            LY_TREE_FOR(module->augment[i].child, child) {
+                if (lys_node_precompile_r(module->ctx, child, 0)) {
+                    return -1;
+                }
+            }
+        }
     }
-    free(module->extensions);
 
-    lydict_remove(ctx, module->name);
-    lydict_remove(ctx, module->prefix);
+    return lys_tpdf_precompile(module->ctx, module->tpdf, module->tpdf_size);
 }
 
-void
-lys_submodule_free(struct lys_submodule *submodule, void (*private_destructor)(const struct lys_node *node, void *priv))
+#endif
+
+int
+lys_precompile(struct lys_module *module)
 {
+#ifdef LY_ENABLED_CACHE
+    struct lys_node *node;
+    const struct lys_node *dummy;
     int i;
 
-    if (!submodule) {
-        return;
+    if (lys_module_precompile_common(module)) {
+        return -1;
     }
-
-    /* common part with struct ly_module */
-    module_free_common((struct lys_module *)submodule, private_destructor);
-
-    /* include */
-    for (i = 0; i < submodule->inc_size; i++) {
-        lydict_remove(submodule->ctx, submodule->inc[i].dsc);
-        lydict_remove(submodule->ctx, submodule->inc[i].ref);
-        lys_extension_instances_free(submodule->ctx, submodule->inc[i].ext, submodule->inc[i].ext_size, private_destructor);
-        /* complete submodule free is done only from main module since
-         * submodules propagate their includes to the main module */
+    for (i = 0; i < module->inc_size; ++i) {
+        if (module->inc[i].submodule && lys_module_precompile_common((struct lys_module *)module->inc[i].submodule)) {
+            return -1;
+        }
     }
-    free(submodule->inc);
 
-    free(submodule);
+    lys_find_child_hash(module->ctx, NULL, module, 0, "", 0, NULL, &dummy);
+    lys_find_schema_child_hash(module->ctx, NULL, module, "", 0, NULL, &dummy);
+    /* the data nodes of the submodules are connected to the main module */
+    LY_TREE_FOR(module->data, node) {
+        if (lys_node_precompile_r(module->ctx, node, 0)) {
+            return -1;
+        }
+    }
+#else
+    (void)module;
+#endif
+    return 0;
 }
 
 int
@@ -2986,6 +5996,59 @@ lys_ingrouping(const struct lys_node *node)
     }
 }
 
+/**
+ * @brief Find the copy of an original list key in the duplicated list by its child indices.
+ *
+ * Duplication copies all the children except groupings in order, so the key copy is at the same
+ * position (possibly inside uses) as the original key. The result is only a hint, resolve_list_keys()
+ * still checks it.
+ *
+ * @param[in] list_orig Original list.
+ * @param[in] key_orig Resolved key of the original list.
+ * @param[in] list Duplicated list with all the children already duplicated.
+ * @return Key copy, NULL if not found.
+ */
+static struct lys_node *
+lys_list_key_rebind(const struct lys_node_list *list_orig, const struct lys_node_leaf *key_orig,
+                    const struct lys_node_list *list)
+{
+    const struct lys_node *chain[8], *iter, *node;
+    uint16_t idx;
+    int depth = 0;
+
+    /* remember the path from the key up to the list */
+    for (node = (struct lys_node *)key_orig; node != (struct lys_node *)list_orig; node = node->parent) {
+        if (!node || (depth == 8)) {
+            return NULL;
+        }
+        chain[depth++] = node;
+    }
+
+    node = (struct lys_node *)list;
+    while (depth--) {
+        /* index of the original node among its siblings */
+        idx = 0;
+        for (iter = chain[depth]->parent->child; iter != chain[depth]; iter = iter->next) {
+            if (!(iter->nodetype & LYS_GROUPING)) {
+                ++idx;
+            }
+        }
+
+        /* the same index in the copy */
+        for (iter = node->child; iter; iter = iter->next) {
+            if (!(iter->nodetype & LYS_GROUPING) && !idx--) {
+                break;
+            }
+        }
+        if (!iter || (iter->nodetype != chain[depth]->nodetype) || !ly_strequal(iter->name, chain[depth]->name, 1)) {
+            return NULL;
+        }
+        node = iter;
+    }
+
+    return (struct lys_node *)node;
+}
+
 /*
  * final: 0 - do not change config flags; 1 - inherit config flags from the parent; 2 - remove config flags
  */
@@ -3349,6 +6412,12 @@ lys_node_dup_recursion(struct lys_module *module, struct lys_node *parent, const
             list->keys_size = list_orig->keys_size;
 
             if (!shallow) {
+                /* rebind the already resolved keys by position, they are only checked in unres then */
+                for (i = 0; i < list->keys_size; ++i) {
+                    if (list_orig->keys[i]) {
+                        list->keys[i] = (struct lys_node_leaf *)lys_list_key_rebind(list_orig, list_orig->keys[i], list);
+                    }
+                }
                 if (unres_schema_add_node(module, unres, list, UNRES_LIST_KEYS, NULL) == -1) {
                     goto error;
                 }
@@ -3366,6 +6435,7 @@ lys_node_dup_recursion(struct lys_module *module, struct lys_node *parent, const
                 list->unique[i].expr = malloc(list_orig->unique[i].expr_size * sizeof *list->unique[i].expr);
                 LY_CHECK_ERR_GOTO(!list->unique[i].expr, LOGMEM(ctx), error);
                 list->unique[i].expr_size = list_orig->unique[i].expr_size;
+                list->unique[i].trg_type = list_orig->unique[i].trg_type;
                 for (j = 0; j < list->unique[i].expr_size; j++) {
                     list->unique[i].expr[j] = lydict_insert(ctx, list_orig->unique[i].expr[j], 0);
 
@@ -3588,7 +6658,7 @@ lys_node_dup(struct lys_module *module, struct lys_node *parent, const struct ly
 static void
 lys_node_switch(struct lys_node *node1, struct lys_node *node2)
 {
-    const size_t mem_size = 104;
+    const size_t mem_size = 112;
     uint8_t mem[mem_size];
     size_t offset, size;
 
@@ -3760,9 +6830,10 @@ lys_free(struct lys_module *module, void (*private_destructor)(const struct lys_
     if (remove_from_ctx && ctx->models.used) {
         for (i = 0; i < ctx->models.used; i++) {
             if (ctx->models.list[i] == module) {
+                ly_ctx_module_hash_remove(ctx, module);
                 /* move all the models to not change the order in the list */
                 ctx->models.used--;
-                memmove(&ctx->models.list[i], ctx->models.list[i + 1], (ctx->models.used - i) * sizeof *ctx->models.list);
+                memmove(&ctx->models.list[i], &ctx->models.list[i + 1], (ctx->models.used - i) * sizeof *ctx->models.list);
                 ctx->models.list[ctx->models.used] = NULL;
                 /* we are done */
                 break;
@@ -3878,10 +6949,12 @@ lys_features_change(const struct lys_module *module, const char *name, int op)
                         if (k == f[j].iffeature_size) {
                             /* the last check passed, do the change */
                             f[j].flags |= LYS_FENABLED;
+                            lys_features_changed(module->ctx);
                             progress++;
                         }
                     } else {
                         lys_features_disable_recursive(&f[j]);
+                        lys_features_changed(module->ctx);
                         progress++;
                     }
                     if (!all) {
@@ -3910,13 +6983,28 @@ lys_features_change(const struct lys_module *module, const char *name, int op)
 API int
 lys_features_enable(const struct lys_module *module, const char *feature)
 {
-    return lys_features_change(module, feature, 1);
+    int ret;
+
+    ret = lys_features_change(module, feature, 1);
+    if (module) {
+        /* the set of enabled nodes may have changed without changing the module set ID */
+        lyb_sib_ht_clear(module->ctx);
+        ly_ctx_info_clear(module->ctx);
+    }
+    return ret;
 }
 
 API int
 lys_features_disable(const struct lys_module *module, const char *feature)
 {
-    return lys_features_change(module, feature, 0);
+    int ret;
+
+    ret = lys_features_change(module, feature, 0);
+    if (module) {
+        lyb_sib_ht_clear(module->ctx);
+        ly_ctx_info_clear(module->ctx);
+    }
+    return ret;
 }
 
 API int
@@ -4200,6 +7288,9 @@ lys_xpath_atomize(const struct lys_node *ctx_node, enum lyxp_node_type ctx_node_
 {
     struct lyxp_set set;
     struct ly_set *ret_set;
+#ifdef LY_ENABLED_CACHE
+    const struct ly_set *deps;
+#endif
     uint32_t i;
 
     if (!ctx_node || !expr) {
@@ -4226,6 +7317,13 @@ lys_xpath_atomize(const struct lys_node *ctx_node, enum lyxp_node_type ctx_node_
         options |= LYXP_SNODE;
     }
 
+#ifdef LY_ENABLED_CACHE
+    if ((ctx_node_type == LYXP_NODE_ELEM) && (deps = lyxp_node_expr_deps(ctx_node, expr, options))) {
+        /* atomized already when the schema was resolved */
+        return ly_set_dup(deps);
+    }
+#endif
+
     if (lyxp_atomize(expr, ctx_node, ctx_node_type, &set, options, NULL)) {
         free(set.val.snodes);
         LOGVAL(ctx_node->module->ctx, LYE_SPEC, LY_VLOG_LYS, ctx_node, "Resolving XPath expression \"%s\" failed.", expr);
@@ -4366,6 +7464,7 @@ apply_aug(struct lys_node_augment *augment, struct unres_schema *unres)
     }
 
     /* reconnect augmenting data into the target - add them to the target child list */
+    lys_children_changed(augment->module->ctx);
     if (augment->target->child) {
         child = augment->target->child->prev;
         child->next = augment->child;
@@ -4378,6 +7477,10 @@ apply_aug(struct lys_node_augment *augment, struct unres_schema *unres)
 success:
     /* remove the flag about not applicability */
     augment->flags &= ~LYS_NOTAPPLIED;
+
+    /* the augmenting nodes were appended to the target children */
+    lys_node_pos_aug(augment);
+    lys_node_state_aug(augment);
     return EXIT_SUCCESS;
 }
 
@@ -4393,6 +7496,7 @@ remove_aug(struct lys_node_augment *augment)
 
     elem = augment->child;
     if (elem) {
+        lys_children_changed(augment->module->ctx);
         LY_TREE_FOR(elem, last) {
             if (!last->next || (last->next->parent != (struct lys_node *)augment)) {
                 break;
@@ -4425,6 +7529,33 @@ remove_aug(struct lys_node_augment *augment)
     /* augment->target still keeps the resolved target, but for lys_augment_free()
      * we have to keep information that this augment is not applied to free its data */
     augment->flags |= LYS_NOTAPPLIED;
+
+    if (elem) {
+        /* the target may have lost its only state data */
+        lys_node_state_update(augment->target, 0);
+    }
+}
+
+/*
+ * @param[in] module - the module where the deviation is defined
+ */
+static struct lys_node *
+lys_deviation_target(struct lys_deviation *dev, const struct lys_module *module)
+{
+    struct ly_set *set;
+
+    if (!dev->target) {
+        /* resolve it only once, the node is kept even when not connected to the tree */
+        if (resolve_schema_nodeid(dev->target_name, NULL, module, &set, 0, 1) == -1) {
+            LOGINT(module->ctx);
+            ly_set_free(set);
+            return NULL;
+        }
+        dev->target = set->set.s[0];
+        ly_set_free(set);
+    }
+
+    return dev->target;
 }
 
 /*
@@ -4474,6 +7605,9 @@ lys_switch_deviation(struct lys_deviation *dev, const struct lys_module *module,
                 } else if (parent && (parent->nodetype == LYS_USES)) {
                     /* uses child */
                     lys_node_addchild(parent, NULL, dev->orig_node, 0);
+                } else if (dev->target_parent) {
+                    /* non-augment, non-toplevel, the parent it was removed from is known */
+                    lys_node_addchild(dev->target_parent, NULL, dev->orig_node, 0);
                 } else {
                     /* non-augment, non-toplevel */
                     parent_path = strndup(dev->target_name, strrchr(dev->target_name, '/') - dev->target_name);
@@ -4494,20 +7628,19 @@ lys_switch_deviation(struct lys_deviation *dev, const struct lys_module *module,
                 lys_node_addchild(NULL, (struct lys_module *)dev->orig_node->module, dev->orig_node, 0);
             }
 
+            /* the node was appended to its siblings */
+            lys_node_pos_siblings(dev->orig_node);
             dev->orig_node = NULL;
         } else {
             /* adding not-supported deviation */
-            ret = resolve_schema_nodeid(dev->target_name, NULL, module, &set, 0, 1);
-            if (ret == -1) {
-                LOGINT(module->ctx);
-                ly_set_free(set);
+            target = lys_deviation_target(dev, module);
+            if (!target) {
                 return;
             }
-            target = set->set.s[0];
-            ly_set_free(set);
 
             /* unlink and store the original node */
             parent = target->parent;
+            dev->target_parent = parent;
             lys_node_unlink(target);
             if (parent) {
                 if (parent->nodetype & (LYS_AUGMENT | LYS_USES)) {
@@ -4538,14 +7671,10 @@ lys_switch_deviation(struct lys_deviation *dev, const struct lys_module *module,
             dev->orig_node = target;
         }
     } else {
-        ret = resolve_schema_nodeid(dev->target_name, NULL, module, &set, 0, 1);
-        if (ret == -1) {
-            LOGINT(module->ctx);
-            ly_set_free(set);
+        target = lys_deviation_target(dev, module);
+        if (!target) {
             return;
         }
-        target = set->set.s[0];
-        ly_set_free(set);
 
         /* contents are switched */
         lys_node_switch(target, dev->orig_node);
@@ -4591,6 +7720,9 @@ lys_enable_deviations(struct lys_module *module)
             resolve_unres_schema(module, unres);
         }
         unres_schema_free(module, &unres, 1);
+
+        /* config of the deviated nodes changed */
+        lys_node_state_tree(module);
     }
 }
 
@@ -4636,17 +7768,24 @@ lys_disable_deviations(struct lys_module *module)
             resolve_unres_schema(module, unres);
         }
         unres_schema_free(module, &unres, 1);
+
+        /* config of the deviated nodes changed */
+        lys_node_state_tree(module);
     }
 }
 
 static void
 apply_dev(struct lys_deviation *dev, const struct lys_module *module, struct unres_schema *unres)
 {
+    struct ly_stats_phase_prev phase;
+
+    ly_stats_phase_enter(module->ctx, LY_STATS_PHASE_AUGDEV, &phase);
     lys_switch_deviation(dev, module, unres);
 
     assert(dev->orig_node);
     lys_node_module(dev->orig_node)->deviated = 1; /* main module */
     dev->orig_node->module->deviated = 1;          /* possible submodule */
+    ly_stats_phase_leave(&phase);
 }
 
 static void
@@ -4727,6 +7866,8 @@ lys_sub_module_apply_devs_augs(struct lys_module *module)
     }
     /* nothing else left to do even if something is not resolved */
     unres_schema_free(module, &unres, 1);
+
+    lys_node_state_devs(module);
 }
 
 void
@@ -4742,6 +7883,8 @@ lys_sub_module_remove_devs_augs(struct lys_module *module)
     for (u = 0; u < module->deviation_size; ++u) {
         /* the deviation could not be applied because it failed to be applied in the first place*/
         if (module->deviation[u].orig_node) {
+            /* deviated nodes are freed, the profile could refer them */
+            ly_ctx_clean_val_profile(module->ctx);
             remove_dev(&module->deviation[u], module, unres);
         }
 
@@ -4762,6 +7905,7 @@ lys_sub_module_remove_devs_augs(struct lys_module *module)
     for (v = 0; v < module->inc_size && module->inc[v].submodule; ++v) {
         for (u = 0; u < module->inc[v].submodule->deviation_size; ++u) {
             if (module->inc[v].submodule->deviation[u].orig_node) {
+                ly_ctx_clean_val_profile(module->ctx);
                 remove_dev(&module->inc[v].submodule->deviation[u], module, unres);
             }
 
@@ -4784,6 +7928,34 @@ lys_sub_module_remove_devs_augs(struct lys_module *module)
     }
     /* nothing else left to do even if something is not resolved */
     unres_schema_free(module, &unres, 1);
+
+    lys_node_state_devs(module);
+}
+
+/* the XPath expressions of only imported modules are not checked, check them in the subtree now */
+static int
+lys_make_implemented_xpath_r(struct lys_module *module, struct lys_node *node, struct unres_schema *unres)
+{
+    struct lys_node *child;
+
+    if (node->nodetype == LYS_GROUPING) {
+        return 0;
+    }
+    if (lys_has_xpath(node) && (unres_schema_add_node(module, unres, node, UNRES_XPATH, NULL) == -1)) {
+        return -1;
+    }
+    if (!(node->nodetype & (LYS_LEAF | LYS_LEAFLIST | LYS_ANYDATA))) {
+        LY_TREE_FOR(node->child, child) {
+            if ((node->nodetype == LYS_AUGMENT) && (child->parent != node)) {
+                /* the following children of the augment target */
+                break;
+            }
+            if (lys_make_implemented_xpath_r(module, child, unres)) {
+                return -1;
+            }
+        }
+    }
+    return 0;
 }
 
 int
@@ -4793,9 +7965,12 @@ lys_make_implemented_r(struct lys_module *module, struct unres_schema *unres)
     struct lys_node *root, *next, *node;
     struct lys_module *target_module;
     uint16_t i, j, k;
+    int xpath;
 
     assert(module->implemented);
     ctx = module->ctx;
+    /* the XPath expressions were not checked while the module was only imported */
+    xpath = !(ctx->models.flags & LY_CTX_TRUSTED);
 
     for (i = 0; i < ctx->models.used; ++i) {
         if (module == ctx->models.list[i]) {
@@ -4824,9 +7999,13 @@ lys_make_implemented_r(struct lys_module *module, struct unres_schema *unres)
         if ((module->augment[i].flags & LYS_NOTAPPLIED) && apply_aug(&module->augment[i], unres)) {
             return -1;
         }
+        if (xpath && lys_make_implemented_xpath_r(module, (struct lys_node *)&module->augment[i], unres)) {
+            return -1;
+        }
     }
 
-    /* identities */
+    /* identities, the derived identities change without changing the module set ID */
+    lys_value_hash_clear(module->ctx);
     for (i = 0; i < module->ident_size; i++) {
         for (j = 0; j < module->ident[i].base_size; j++) {
             resolve_identity_backlink_update(&module->ident[i], module->ident[i].base[j]);
@@ -4853,6 +8032,10 @@ lys_make_implemented_r(struct lys_module *module, struct unres_schema *unres)
             if ((module->inc[i].submodule->augment[j].flags & LYS_NOTAPPLIED) && apply_aug(&module->inc[i].submodule->augment[j], unres)) {
                 return -1;
             }
+            if (xpath && lys_make_implemented_xpath_r(module, (struct lys_node *)&module->inc[i].submodule->augment[j],
+                                                      unres)) {
+                return -1;
+            }
         }
 
         /* identities */
@@ -4878,6 +8061,9 @@ lys_make_implemented_r(struct lys_module *module, struct unres_schema *unres)
                     }
                 }
             }
+            if (xpath && lys_has_xpath(node) && (unres_schema_add_node(module, unres, node, UNRES_XPATH, NULL) == -1)) {
+                return -1;
+            }
 
             /* modified LY_TREE_DFS_END */
             next = node->child;
@@ -4957,6 +8143,13 @@ lys_set_implemented(const struct lys_module *module)
     }
     unres_schema_free(NULL, &unres, 0);
 
+    /* augments were applied, the module set ID is not changed */
+    lys_child_hash_clear(module->ctx);
+    lys_mand_hash_clear(module->ctx);
+    lys_op_deps_hash_clear(module->ctx);
+    lyb_sib_ht_clear(module->ctx);
+    ly_ctx_info_clear(module->ctx);
+
     LOGVRB("Module \"%s%s%s\" now implemented.", module->name, (module->rev_size ? "@" : ""),
            (module->rev_size ? module->rev[0].date : ""));
     return EXIT_SUCCESS;
@@ -599,6 +599,18 @@ int lys_ext_instance_presence(struct lys_ext *def, struct lys_ext_instance **ext
  */
 void *lys_ext_complex_get_substmt(LY_STMT stmt, struct lys_ext_instance_complex *ext, struct lyext_substmt **info);
 
+/**
+ * @brief Find the definition of a metadata annotation (RFC 7952) in a module or its submodules.
+ *
+ * The definitions of a module are hashed in the context on the first search, so the returned pointer
+ * identifies the annotation and can be used to find its instances by lyd_find_attr().
+ *
+ * @param[in] module Module defining the annotation.
+ * @param[in] name Name of the annotation.
+ * @return Annotation definition, NULL if the module does not define it.
+ */
+struct lys_ext_instance_complex *lys_find_annotation(const struct lys_module *module, const char *name);
+
 /**
  * @brief Get list of all the loaded plugins, both extension and user type ones.
  *
@@ -626,6 +638,9 @@ struct lytype_plugin_list;
  * application-specific extensions.  Instead of loading them from separate module files through dlopen (which can
  * introduce additional problems like mismatching or incorrectly installed modules), they can be directly added
  * by reference.
+ *
+ * The plugins are looked up without any locking, so they must be registered before any other thread uses
+ * a context.
  */
 int ly_register_exts(struct lyext_plugin_list *plugin, const char *log_name);
 
@@ -984,6 +999,10 @@ struct lys_type {
     struct lys_tpdf *parent;         /**< except ::lys_tpdf, it can points also to ::lys_node_leaf or ::lys_node_leaflist
                                           so access only the compatible members! */
     union lys_type_info info;        /**< detailed type-specific information */
+#ifdef LY_ENABLED_CACHE
+    void *eff;                       /**< the effective restrictions of the whole typedef chain flattened to
+                                          optimize value validation. For internal use only. */
+#endif
     /*
      * here is an overview of the info union:
      * LY_TYPE_BINARY (binary)
@@ -1074,6 +1093,11 @@ struct lys_type {
 struct lys_iffeature {
     uint8_t *expr;                   /**< 2bits array describing the if-feature expression in prefix format */
     uint8_t ext_size;                /**< number of elements in #ext array */
+#ifdef LY_ENABLED_CACHE
+    uint32_t value_cache;            /**< result of the expression (the lowest bit) and the feature generation it was
+                                          evaluated for (the other bits), zero if not evaluated.
+                                          For internal use only. */
+#endif
     struct lys_feature **features;   /**< array of pointers to the features used in expression */
     struct lys_ext_instance **ext;   /**< array of pointers to the extension instances */
 };
@@ -1130,6 +1154,10 @@ struct lys_iffeature {
  *     13 LYS_DFLTJSON     | | |x|x| | | | | | | | | | | |x| |r| |
  *                         +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
  *     14 LYS_VALID_EXT    |x| |x|x|x|x| | | | | | | | | |x| | | |
+ *                         +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ *     15 LYS_NACM_DENYW   |x|x|x|x|x|x|x|x|x| | | |x|x| | | | | |
+ *                         +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ *     16 LYS_NACM_DENYA   |x|x|x|x|x|x|x|x|x| | | |x|x| | | | | |
  *     --------------------+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
  *
  *     x - used
@@ -1150,8 +1178,10 @@ struct lys_iffeature {
                                           ::lys_node_choice, ::lys_node_leaf and ::lys_node_anydata */
 #define LYS_MAND_FALSE   0x80        /**< mandatory false; applicable only to
                                           ::lys_node_choice, ::lys_node_leaf and ::lys_node_anydata */
-#define LYS_INCL_STATUS  0x80        /**< flag that the subtree includes status node(s), applicable only to
-                                          ::lys_node_container and lys_node_list */
+#define LYS_INCL_STATUS  0x80        /**< flag that the node is a state node or its subtree includes some, applicable
+                                          only to ::lys_node_container and lys_node_list of the data trees; learned when
+                                          the module is added into the context and kept up to date with the applied
+                                          augments and deviations */
 #define LYS_MAND_MASK    0xc0        /**< mask for mandatory values */
 #define LYS_USERORDERED  0x100       /**< ordered-by user lists, applicable only to
                                           ::lys_node_list and ::lys_node_leaflist */
@@ -1177,6 +1207,10 @@ struct lys_iffeature {
 #define LYS_NOTAPPLIED   0x01        /**< flag for the not applied augments to allow keeping the resolved target */
 #define LYS_YINELEM      0x01        /**< yin-element true for extension's argument */
 #define LYS_VALID_EXT    0x2000      /**< flag marking nodes that need to be validated using an extension validation function */
+#define LYS_NACM_DENYW   0x4000      /**< NACM default-deny-write extension instance (explicit or inherited) is in the node,
+                                          precomputed when the extension is resolved, see lyd_nacm_apply() */
+#define LYS_NACM_DENYA   0x8000      /**< NACM default-deny-all extension instance (explicit or inherited) is in the node,
+                                          precomputed when the extension is resolved, see lyd_nacm_apply() */
 
 /**
  * @}
@@ -1242,6 +1276,8 @@ struct lys_node {
 
 #ifdef LY_ENABLED_CACHE
     uint8_t hash[LYS_NODE_HASH_COUNT]; /**< schema hash required for LYB printer/parser */
+    uint32_t pos;                    /**< position among the data siblings in the schema order, 0 if not known.
+                                          For internal use only. */
 #endif
 };
 
@@ -1284,6 +1320,8 @@ struct lys_node_container {
 
 #ifdef LY_ENABLED_CACHE
     uint8_t hash[LYS_NODE_HASH_COUNT]; /**< schema hash required for LYB printer/parser */
+    uint32_t pos;                    /**< position among the data siblings in the schema order, 0 if not known.
+                                          For internal use only. */
 #endif
 
     /* specific container's data */
@@ -1375,6 +1413,8 @@ struct lys_node_leaf {
 
 #ifdef LY_ENABLED_CACHE
     uint8_t hash[LYS_NODE_HASH_COUNT]; /**< schema hash required for LYB printer/parser */
+    uint32_t pos;                    /**< position among the data siblings in the schema order, 0 if not known.
+                                          For internal use only. */
 #endif
 
     /* specific leaf's data */
@@ -1429,6 +1469,8 @@ struct lys_node_leaflist {
 
 #ifdef LY_ENABLED_CACHE
     uint8_t hash[LYS_NODE_HASH_COUNT]; /**< schema hash required for LYB printer/parser */
+    uint32_t pos;                    /**< position among the data siblings in the schema order, 0 if not known.
+                                          For internal use only. */
 #endif
 
     /* specific leaf-list's data */
@@ -1484,6 +1526,8 @@ struct lys_node_list {
 
 #ifdef LY_ENABLED_CACHE
     uint8_t hash[LYS_NODE_HASH_COUNT]; /**< schema hash required for LYB printer/parser */
+    uint32_t pos;                    /**< position among the data siblings in the schema order, 0 if not known.
+                                          For internal use only. */
 #endif
 
     /* specific list's data */
@@ -1541,6 +1585,8 @@ struct lys_node_anydata {
 
 #ifdef LY_ENABLED_CACHE
     uint8_t hash[LYS_NODE_HASH_COUNT]; /**< schema hash required for LYB printer/parser */
+    uint32_t pos;                    /**< position among the data siblings in the schema order, 0 if not known.
+                                          For internal use only. */
 #endif
 
     /* specific anyxml's data */
@@ -1759,6 +1805,8 @@ struct lys_node_notif {
 
 #ifdef LY_ENABLED_CACHE
     uint8_t hash[LYS_NODE_HASH_COUNT]; /**< schema hash required for LYB printer/parser */
+    uint32_t pos;                    /**< position among the data siblings in the schema order, 0 if not known.
+                                          For internal use only. */
 #endif
 
     /* specific rpc's data */
@@ -1805,6 +1853,8 @@ struct lys_node_rpc_action {
 
 #ifdef LY_ENABLED_CACHE
     uint8_t hash[LYS_NODE_HASH_COUNT]; /**< schema hash required for LYB printer/parser */
+    uint32_t pos;                    /**< position among the data siblings in the schema order, 0 if not known.
+                                          For internal use only. */
 #endif
 
     /* specific rpc's data */
@@ -1950,6 +2000,10 @@ struct lys_deviation {
     const char *dsc;                  /**< description (optional) */
     const char *ref;                  /**< reference (optional) */
     struct lys_node *orig_node;       /**< original (non-deviated) node (mandatory) */
+    struct lys_node *target;          /**< pointer to the target node, kept even when it is removed from the tree by
+                                           a not-supported deviate. For internal use only. */
+    struct lys_node *target_parent;   /**< parent of the target node removed by a not-supported deviate to connect
+                                           it back to. For internal use only. */
 
     uint8_t deviate_size;             /**< number of elements in the #deviate array */
     uint8_t ext_size;                 /**< number of elements in #ext array */
@@ -2016,6 +2070,13 @@ struct lys_tpdf {
     struct lys_type type;            /**< base type from which the typedef is derived (mandatory). In case of a special
                                           built-in typedef (from yang_types.c), only the base member is filled */
     const char *dflt;                /**< default value of the newly defined type (optional) */
+
+#ifdef LY_ENABLED_CACHE
+    uint16_t plugin_gen;             /**< generation of the user type plugins when #plugin_idx was searched for.
+                                          For internal use only. */
+    uint16_t plugin_idx;             /**< user type plugin of this type (its index + 1), 0 if there is none.
+                                          For internal use only. */
+#endif
 };
 
 /**
@@ -2062,6 +2123,15 @@ struct lys_restr {
     struct lys_ext_instance **ext;   /**< array of pointers to the extension instances */
     uint8_t ext_size;                /**< number of elements in #ext array */
     uint16_t flags;                  /**< only flags #LYS_XPCONF_DEP and #LYS_XPSTATE_DEP can be specified */
+#ifdef LY_ENABLED_CACHE
+    void *expr_xpath;                /**< parsed XPath #expr of a must restriction to optimize its evaluation,
+                                          created on the first evaluation. For internal use only. */
+    struct ly_set *deps;             /**< schema nodes referenced by #expr, used for validating only the changed
+                                          data. For internal use only. */
+    void *intv;                      /**< compiled intervals of a length or range restriction together with the
+                                          restrictions of all the superior types, created on the first value
+                                          validation. For internal use only. */
+#endif
 };
 
 /**
@@ -2074,6 +2144,12 @@ struct lys_when {
     struct lys_ext_instance **ext;   /**< array of pointers to the extension instances */
     uint8_t ext_size;                /**< number of elements in #ext array */
     uint16_t flags;                  /**< only flags #LYS_XPCONF_DEP and #LYS_XPSTATE_DEP can be specified */
+#ifdef LY_ENABLED_CACHE
+    void *cond_xpath;                /**< parsed XPath #cond to optimize its evaluation, created on the first
+                                          evaluation. For internal use only. */
+    struct ly_set *deps;             /**< schema nodes referenced by #cond, used for validating only the changed
+                                          data. For internal use only. */
+#endif
 };
 
 /**
@@ -2353,6 +2429,19 @@ char *lys_path(const struct lys_node *node, int options);
  */
 char *lys_data_path(const struct lys_node *node);
 
+/**
+ * @brief Get the stable 64-bit ID of a schema node.
+ *
+ * The ID is derived from the name and the latest revision of the module of the top-level ancestor and from the path
+ * of the node (including choices, cases, uses, groupings and operation input/output), so it is the same in every
+ * process and context with the module. The IDs of all the nodes of a context are checked for collisions,
+ * use ly_ctx_get_node_by_id() to get the node of an ID back.
+ *
+ * @param[in] node Schema node in the schema trees of its context (not in an augment that is not applied).
+ * @return ID of the node, 0 on error or if another node in the context has the same ID.
+ */
+uint64_t lys_node_id(const struct lys_node *node);
+
 /**
  * @brief Return parent node in the schema tree.
  *
@@ -41,6 +41,65 @@ extern "C" {
  */
 typedef int (*lytype_store_clb)(const char *type_name, const char *value_str, lyd_val *value, char **err_msg);
 
+/**
+ * @brief Optional callback for comparing user type values.
+ *
+ * @param[in] type_name Name of the type of the values.
+ * @param[in] value1 First value stored by #lytype_store_clb.
+ * @param[in] value2 Second value stored by #lytype_store_clb.
+ * @return 0 if the values are equal, non-zero otherwise.
+ */
+typedef int (*lytype_compare_clb)(const char *type_name, const lyd_val *value1, const lyd_val *value2);
+
+/**
+ * @brief Optional callback for ordering user type values, for types that have a natural order.
+ *
+ * @param[in] type_name Name of the type of the values.
+ * @param[in] value1 First value stored by #lytype_store_clb.
+ * @param[in] value2 Second value stored by #lytype_store_clb.
+ * @return Negative value, 0, or positive value if \p value1 is less than, equal to, or greater than \p value2.
+ */
+typedef int (*lytype_order_clb)(const char *type_name, const lyd_val *value1, const lyd_val *value2);
+
+/**
+ * @brief Optional callback for hashing user type values. Equal values (see #lytype_compare_clb) must have
+ * the same hash.
+ *
+ * @param[in] type_name Name of the type of the value.
+ * @param[in] value Value stored by #lytype_store_clb.
+ * @return Hash of the value.
+ */
+typedef uint32_t (*lytype_hash_clb)(const char *type_name, const lyd_val *value);
+
+/**
+ * @brief Optional callback for printing user type values in their canonical form.
+ *
+ * The printed value replaces the string value of the data node after the value is stored, so the printers,
+ * XPath, and all the other string comparisons use the canonical form.
+ *
+ * @param[in] type_name Name of the type of the value.
+ * @param[in] value Value stored by #lytype_store_clb.
+ * @param[out] buf Buffer to print the value into, always terminated by a zero byte if \p buf_len is not 0.
+ * @param[in] buf_len Size of \p buf.
+ * @return Length of the whole canonical value (without the terminating zero) as snprintf(3) returns it,
+ * negative value on error.
+ */
+typedef int (*lytype_print_clb)(const char *type_name, const lyd_val *value, char *buf, size_t buf_len);
+
+/**
+ * @brief Callback of a value parser specialized for the type of a leaf or a leaf-list, see lys_set_value_parser().
+ *
+ * It is tried before the generic parser and it must accept only the values that are valid for the type and
+ * already in their canonical form, the rest is left to the generic parser, which also reports the errors.
+ *
+ * @param[in] type Type with the definitions of the values, for enumerations the nearest type in the typedef
+ * chain with some enums, the type of the node otherwise.
+ * @param[in] value_str String value to parse, stored in the context dictionary.
+ * @param[out] value Value union to store the value in the standard way, as the generic parser would.
+ * @return 0 if the value was stored, non-zero to parse the value by the generic parser.
+ */
+typedef int (*lytype_parse_clb)(const struct lys_type *type, const char *value_str, lyd_val *value);
+
 struct lytype_plugin_list {
     const char *module;          /**< Name of the module where the type is defined. */
     const char *revision;        /**< Optional module revision - if not specified, the plugin applies to any revision,
@@ -51,8 +110,30 @@ struct lytype_plugin_list {
     const char *name;            /**< Name of the type to be stored in a custom way. */
     lytype_store_clb store_clb;  /**< Callback used for storing values of this type. */
     void (*free_clb)(void *ptr); /**< Callback used for freeing values of this type. */
+    lytype_compare_clb compare_clb; /**< Optional callback for comparing values of this type, used instead of
+                                         comparing their string values. */
+    lytype_hash_clb hash_clb;    /**< Optional callback for hashing values of this type, used for the list keys and
+                                      leaf-list values instead of hashing their string values. */
+    lytype_print_clb print_clb;  /**< Optional callback for printing the canonical form of values of this type. */
+    lytype_order_clb order_clb;  /**< Optional callback for ordering values of this type, used by the XPath relational
+                                      operators instead of converting the values to numbers. */
 };
 
+/**
+ * @brief Set a value parser specialized for the type of a leaf or a leaf-list, which is used by all the data
+ * parsers and lyd_new_path() instead of the generic parser for the values it accepts.
+ *
+ * Such parsers are usually generated for the schema by the yang2c tool. They can be set only for the integer,
+ * decimal64, boolean, enumeration, and string types and only with libyang built with the cache. The parser
+ * must be set before parsing any data of the node and it is forgotten when the schema node is freed. The data
+ * parsers read it without any synchronization, so it must not be set while another thread parses data of the context.
+ *
+ * @param[in] node Leaf or leaf-list schema node.
+ * @param[in] parse_clb Value parser, NULL to use only the generic one.
+ * @return EXIT_SUCCESS on success, EXIT_FAILURE on error.
+ */
+int lys_set_value_parser(const struct lys_node *node, lytype_parse_clb parse_clb);
+
 /**
  * @}
  */
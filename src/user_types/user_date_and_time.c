@@ -1,7 +1,7 @@
 /**
  * @file user_date_and_time.c
  * @author Michal Vasko <mvasko@cesnet.cz>
- * @brief Example implementation of an date-and-time as a user type, only validation is performed
+ * @brief Implementation of date-and-time as a user type, stored as the time since the epoch
  *
  * Copyright (c) 2018 CESNET, z.s.p.o.
  *
@@ -14,6 +14,7 @@
 #define _GNU_SOURCE
 
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 #include <errno.h>
 #include <time.h>
@@ -87,11 +88,22 @@ static const char *gmt_offsets[] = {
     "-12:00",
 };
 
+/* stored value */
+struct date_and_time {
+    int64_t sec;        /* seconds since the epoch (in UTC) */
+    uint32_t nsec;      /* nanoseconds */
+    int16_t offset;     /* timezone offset in minutes */
+    uint8_t unknown;    /* the offset to the local time is unknown ("-00:00") */
+};
+
 static int
-date_and_time_store_clb(const char *UNUSED(type_name), const char *value_str, lyd_val *UNUSED(value), char **err_msg)
+date_and_time_store_clb(const char *UNUSED(type_name), const char *value_str, lyd_val *value, char **err_msg)
 {
     struct tm tm, tm2;
-    uint32_t i, j, k;
+    struct date_and_time *dt;
+    time_t t;
+    uint32_t i, j, k, nsec = 0, digits;
+    int16_t offset = 0;
     int ret;
 
     /* \d{4}-\d{2}-\d{2}T\d{2}:\d{2}:\d{2}(\.\d+)?(Z|[\+\-]\d{2}:\d{2})
@@ -186,18 +198,11 @@ date_and_time_store_clb(const char *UNUSED(type_name), const char *value_str, ly
         goto error;
     }
 
-    /* validate using mktime() */
+    /* validate using timegm(), it normalizes any invalid date or time, there is no DST to consider in UTC */
     tm2 = tm;
-    if (mktime(&tm) == -1) {
-        ret = asprintf(err_msg, "Checking date-and-time value \"%s\" failed (%s).", value_str, strerror(errno));
-        goto error;
-    }
-    /* we now have correctly filled the remaining values, use them */
-    memcpy(((char *)&tm2) + (6 * sizeof(int)), ((char *)&tm) + (6 * sizeof(int)), sizeof(struct tm) - (6 * sizeof(int)));
-    /* back it up again */
-    tm = tm2;
-    /* let mktime() correct date & time with having the other values correct now */
-    if (mktime(&tm) == -1) {
+    errno = 0;
+    t = timegm(&tm);
+    if ((t == -1) && errno) {
         ret = asprintf(err_msg, "Checking date-and-time value \"%s\" failed (%s).", value_str, strerror(errno));
         goto error;
     }
@@ -208,16 +213,24 @@ date_and_time_store_clb(const char *UNUSED(type_name), const char *value_str, ly
         goto error;
     }
 
-    /* tenth of a second */
+    /* fractions of a second, only nanoseconds are stored */
     if (value_str[i] == '.') {
         ++i;
         if (!isdigit(value_str[i])) {
             ret = asprintf(err_msg, "Invalid character '%c'[%d] in date-and-time value \"%s\", a digit expected.", value_str[i], i, value_str);
             goto error;
         }
+        digits = 0;
         do {
+            if (digits < 9) {
+                nsec = nsec * 10 + (value_str[i] - '0');
+                ++digits;
+            }
             ++i;
         } while (isdigit(value_str[i]));
+        for (; digits < 9; ++digits) {
+            nsec *= 10;
+        }
     }
 
     switch (value_str[i]) {
@@ -237,6 +250,10 @@ date_and_time_store_clb(const char *UNUSED(type_name), const char *value_str, ly
             ret = asprintf(err_msg, "Invalid timezone \"%.6s\" in date-and-time value \"%s\".", value_str + i, value_str);
             goto error;
         }
+        offset = atoi(value_str + i + 1) * 60 + atoi(value_str + i + 4);
+        if (value_str[i] == '-') {
+            offset = -offset;
+        }
         i += 5;
         break;
     default:
@@ -251,18 +268,61 @@ date_and_time_store_clb(const char *UNUSED(type_name), const char *value_str, ly
         goto error;
     }
 
-    /* validation succeeded and we do not want to change how it is stored */
+    dt = malloc(sizeof *dt);
+    if (!dt) {
+        ret = asprintf(err_msg, "Memory allocation failed.");
+        goto error;
+    }
+    dt->sec = (int64_t)t - offset * 60;
+    dt->nsec = nsec;
+    dt->offset = offset;
+    dt->unknown = !strcmp(value_str + i - 6, "-00:00");
+
+    value->ptr = dt;
     return 0;
 
 error:
     if (ret == -1) {
-        err_msg = NULL;
+        *err_msg = NULL;
     }
     return 1;
 }
 
+static int
+date_and_time_compare_clb(const char *UNUSED(type_name), const lyd_val *value1, const lyd_val *value2)
+{
+    const struct date_and_time *dt1 = value1->ptr, *dt2 = value2->ptr;
+
+    /* the same point in time in different timezones is not the same value */
+    return (dt1->sec != dt2->sec) || (dt1->nsec != dt2->nsec) || (dt1->offset != dt2->offset)
+            || (dt1->unknown != dt2->unknown);
+}
+
+static uint32_t
+date_and_time_hash_clb(const char *UNUSED(type_name), const lyd_val *value)
+{
+    const struct date_and_time *dt = value->ptr;
+
+    return (uint32_t)dt->sec ^ (uint32_t)(dt->sec >> 32) ^ dt->nsec ^ ((uint32_t)(uint16_t)dt->offset << 16);
+}
+
+static int
+date_and_time_order_clb(const char *UNUSED(type_name), const lyd_val *value1, const lyd_val *value2)
+{
+    const struct date_and_time *dt1 = value1->ptr, *dt2 = value2->ptr;
+
+    if (dt1->sec != dt2->sec) {
+        return (dt1->sec < dt2->sec) ? -1 : 1;
+    }
+    if (dt1->nsec != dt2->nsec) {
+        return (dt1->nsec < dt2->nsec) ? -1 : 1;
+    }
+    return 0;
+}
+
 /* Name of this array must match the file name! */
 struct lytype_plugin_list user_date_and_time[] = {
-    {"ietf-yang-types", "2013-07-15", "date-and-time", date_and_time_store_clb, NULL},
-    {NULL, NULL, NULL, NULL, NULL} /* terminating item */
+    {"ietf-yang-types", "2013-07-15", "date-and-time", date_and_time_store_clb, free, date_and_time_compare_clb,
+     date_and_time_hash_clb, NULL, date_and_time_order_clb},
+    {NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL} /* terminating item */
 };
@@ -0,0 +1,239 @@
+/**
+ * @file user_inet_types.c
+ * @author Michal Vasko <mvasko@cesnet.cz>
+ * @brief ietf-inet-types ip-address and ip-prefix types stored in a binary form
+ *
+ * Copyright (c) 2018 CESNET, z.s.p.o.
+ *
+ * This source code is licensed under BSD 3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://opensource.org/licenses/BSD-3-Clause
+ */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#include "../user_types.h"
+
+/*
+ * ipv4-address-no-zone and ipv4-prefix values fit into lyd_val itself, the address (in host byte order)
+ * is stored in the upper 32 bits and the prefix length in the lowest byte. All the other types
+ * are stored in a struct inet_addr.
+ */
+#define IPV4_PACK(addr, prefix) (((uint64_t)ntohl(addr) << 8) | (prefix))
+#define IPV4_ADDR(val) htonl((uint32_t)((val) >> 8))
+#define IPV4_PREFIX(val) ((uint8_t)((val) & 0xff))
+
+struct inet_addr {
+    uint8_t addr[16];   /* address in network byte order, ipv4 addresses use the first 4 bytes */
+    uint8_t prefix;     /* prefix length, 0 for addresses */
+    char zone[];        /* zone of the address, empty if none */
+};
+
+static int
+inet_family(const char *type_name)
+{
+    return (type_name[3] == '4') ? AF_INET : AF_INET6;
+}
+
+static int
+inet_is_prefix(const char *type_name)
+{
+    return !strcmp(type_name + 5, "prefix");
+}
+
+static int
+inet_is_packed(const char *type_name)
+{
+    return !strcmp(type_name, "ipv4-address-no-zone") || !strcmp(type_name, "ipv4-prefix");
+}
+
+/* zero all the bits not covered by the prefix */
+static void
+inet_mask(uint8_t *addr, size_t addr_len, uint8_t prefix)
+{
+    size_t i;
+
+    for (i = prefix / 8; i < addr_len; ++i) {
+        if (i == prefix / 8U) {
+            addr[i] &= (uint8_t)(0xff << (8 - prefix % 8));
+        } else {
+            addr[i] = 0;
+        }
+    }
+}
+
+static int
+inet_store_clb(const char *type_name, const char *value_str, lyd_val *value, char **err_msg)
+{
+    int af = inet_family(type_name);
+    size_t addr_len = (af == AF_INET) ? 4 : 16, max_prefix = addr_len * 8, len;
+    const char *delim = NULL, *ptr;
+    char buf[INET6_ADDRSTRLEN];
+    uint8_t addr[16];
+    uint32_t addr4;
+    unsigned long prefix = 0;
+    struct inet_addr *val;
+
+    /* split the address from the prefix or zone */
+    if (inet_is_prefix(type_name)) {
+        delim = strchr(value_str, '/');
+        if (!delim || !isdigit(delim[1])) {
+            if (asprintf(err_msg, "Invalid %s value \"%s\", missing prefix length.", type_name, value_str) == -1) {
+                *err_msg = NULL;
+            }
+            return 1;
+        }
+        for (ptr = delim + 1; isdigit(*ptr) && (prefix <= max_prefix); ++ptr) {
+            prefix = prefix * 10 + (*ptr - '0');
+        }
+        if (*ptr || (prefix > max_prefix)) {
+            if (asprintf(err_msg, "Invalid %s value \"%s\", invalid prefix length.", type_name, value_str) == -1) {
+                *err_msg = NULL;
+            }
+            return 1;
+        }
+    } else {
+        delim = strchr(value_str, '%');
+        if (delim && !delim[1]) {
+            if (asprintf(err_msg, "Invalid %s value \"%s\", empty zone.", type_name, value_str) == -1) {
+                *err_msg = NULL;
+            }
+            return 1;
+        }
+    }
+
+    len = delim ? (size_t)(delim - value_str) : strlen(value_str);
+    if (len >= sizeof buf) {
+        goto invalid_addr;
+    }
+    memcpy(buf, value_str, len);
+    buf[len] = '\0';
+    if (inet_pton(af, buf, addr) != 1) {
+        goto invalid_addr;
+    }
+
+    if (inet_is_prefix(type_name)) {
+        inet_mask(addr, addr_len, prefix);
+    }
+
+    if (inet_is_packed(type_name)) {
+        memcpy(&addr4, addr, sizeof addr4);
+        value->uint64 = IPV4_PACK(addr4, prefix);
+        return 0;
+    }
+
+    /* zone is stored only for the types allowing it */
+    ptr = (delim && !inet_is_prefix(type_name)) ? delim + 1 : "";
+    val = calloc(1, sizeof *val + strlen(ptr) + 1);
+    if (!val) {
+        return 1;
+    }
+    memcpy(val->addr, addr, addr_len);
+    val->prefix = prefix;
+    strcpy(val->zone, ptr);
+
+    value->ptr = val;
+    return 0;
+
+invalid_addr:
+    if (asprintf(err_msg, "Invalid %s value \"%s\", invalid address.", type_name, value_str) == -1) {
+        *err_msg = NULL;
+    }
+    return 1;
+}
+
+static int
+inet_compare_clb(const char *type_name, const lyd_val *value1, const lyd_val *value2)
+{
+    const struct inet_addr *val1, *val2;
+
+    if (inet_is_packed(type_name)) {
+        return value1->uint64 != value2->uint64;
+    }
+
+    val1 = value1->ptr;
+    val2 = value2->ptr;
+    if (memcmp(val1->addr, val2->addr, sizeof val1->addr) || (val1->prefix != val2->prefix)) {
+        return 1;
+    }
+    return strcmp(val1->zone, val2->zone);
+}
+
+static uint32_t
+inet_hash_clb(const char *type_name, const lyd_val *value)
+{
+    const struct inet_addr *val;
+    uint32_t hash = 0;
+    size_t i;
+
+    if (inet_is_packed(type_name)) {
+        return (uint32_t)(value->uint64 >> 8) ^ (uint32_t)(value->uint64 << 24);
+    }
+
+    /* one-at-a-time hash of the address and the prefix, the zone is ignored */
+    val = value->ptr;
+    for (i = 0; i < sizeof val->addr; ++i) {
+        hash += val->addr[i];
+        hash += (hash << 10);
+        hash ^= (hash >> 6);
+    }
+    hash += val->prefix;
+    hash += (hash << 3);
+    hash ^= (hash >> 11);
+    hash += (hash << 15);
+    return hash;
+}
+
+static int
+inet_print_clb(const char *type_name, const lyd_val *value, char *buf, size_t buf_len)
+{
+    int af = inet_family(type_name);
+    const struct inet_addr *val;
+    char str[INET6_ADDRSTRLEN];
+    uint32_t addr;
+
+    if (inet_is_packed(type_name)) {
+        addr = IPV4_ADDR(value->uint64);
+        if (!inet_ntop(AF_INET, &addr, str, sizeof str)) {
+            return -1;
+        }
+        if (inet_is_prefix(type_name)) {
+            return snprintf(buf, buf_len, "%s/%u", str, IPV4_PREFIX(value->uint64));
+        }
+        return snprintf(buf, buf_len, "%s", str);
+    }
+
+    val = value->ptr;
+    if (!inet_ntop(af, val->addr, str, sizeof str)) {
+        return -1;
+    }
+    if (inet_is_prefix(type_name)) {
+        return snprintf(buf, buf_len, "%s/%u", str, val->prefix);
+    }
+    return snprintf(buf, buf_len, "%s%s%s", str, val->zone[0] ? "%" : "", val->zone);
+}
+
+/* Name of this array must match the file name! */
+struct lytype_plugin_list user_inet_types[] = {
+    {"ietf-inet-types", "2013-07-15", "ipv4-address", inet_store_clb, free, inet_compare_clb, inet_hash_clb,
+     inet_print_clb, NULL},
+    {"ietf-inet-types", "2013-07-15", "ipv4-address-no-zone", inet_store_clb, NULL, inet_compare_clb, inet_hash_clb,
+     inet_print_clb, NULL},
+    {"ietf-inet-types", "2013-07-15", "ipv6-address", inet_store_clb, free, inet_compare_clb, inet_hash_clb,
+     inet_print_clb, NULL},
+    {"ietf-inet-types", "2013-07-15", "ipv6-address-no-zone", inet_store_clb, free, inet_compare_clb,
+     inet_hash_clb, inet_print_clb, NULL},
+    {"ietf-inet-types", "2013-07-15", "ipv4-prefix", inet_store_clb, NULL, inet_compare_clb, inet_hash_clb,
+     inet_print_clb, NULL},
+    {"ietf-inet-types", "2013-07-15", "ipv6-prefix", inet_store_clb, free, inet_compare_clb, inet_hash_clb,
+     inet_print_clb, NULL},
+    {NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL} /* terminating item */
+};
@@ -12,6 +12,7 @@
  *     https://opensource.org/licenses/BSD-3-Clause
  */
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <arpa/inet.h>
@@ -34,9 +35,34 @@ ipv4_store_clb(const char *type_name, const char *value_str, lyd_val *value, cha
     return 0;
 }
 
+static int
+ipv4_compare_clb(const char *type_name, const lyd_val *value1, const lyd_val *value2)
+{
+    return memcmp(value1->ptr, value2->ptr, sizeof(struct in_addr));
+}
+
+static uint32_t
+ipv4_hash_clb(const char *type_name, const lyd_val *value)
+{
+    return ((struct in_addr *)value->ptr)->s_addr;
+}
+
+static int
+ipv4_print_clb(const char *type_name, const lyd_val *value, char *buf, size_t buf_len)
+{
+    char str[INET_ADDRSTRLEN];
+
+    if (!inet_ntop(AF_INET, value->ptr, str, sizeof str)) {
+        return -1;
+    }
+    return snprintf(buf, buf_len, "%s", str);
+}
+
 /* Name of this array must match the file name! */
 struct lytype_plugin_list user_ipv4[] = {
-    {"ietf-inet-types", "2013-07-15", "ipv4-address", ipv4_store_clb, free},
-    {"ietf-inet-types", "2013-07-15", "ipv4-address-no-zone", ipv4_store_clb, free},
-    {NULL, NULL, NULL, NULL, NULL} /* terminating item */
+    {"ietf-inet-types", "2013-07-15", "ipv4-address", ipv4_store_clb, free, ipv4_compare_clb, ipv4_hash_clb, ipv4_print_clb,
+     NULL},
+    {"ietf-inet-types", "2013-07-15", "ipv4-address-no-zone", ipv4_store_clb, free, ipv4_compare_clb, ipv4_hash_clb,
+     ipv4_print_clb, NULL},
+    {NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL} /* terminating item */
 };
@@ -17,6 +17,7 @@
 #include <string.h>
 
 #include "common.h"
+#include "context.h"
 #include "validation.h"
 #include "libyang.h"
 #include "xpath.h"
@@ -48,6 +49,29 @@ lyv_keys(const struct lyd_node *list)
     return 0;
 }
 
+/**
+ * @brief Check whether the resolved target of a leafref or instance-identifier can be trusted because
+ * no data tree of the context was modified since it was resolved.
+ */
+static int
+lyv_ref_target_current(const struct lyd_node_leaf_list *leaf, int options)
+{
+    if (options & (LYD_OPT_RPC | LYD_OPT_RPCREPLY | LYD_OPT_NOTIF | LYD_OPT_ACT_NOTIF)) {
+        /* the target may be in a separate data tree */
+        return 0;
+    }
+
+    if (leaf->value_flags & LY_VALUE_UNRES) {
+        return 0;
+    }
+    if (((leaf->value_type != LY_TYPE_LEAFREF) || !leaf->value.leafref)
+            && ((leaf->value_type != LY_TYPE_INST) || !leaf->value.instance)) {
+        return 0;
+    }
+
+    return lyd_gen_stamp_current(leaf);
+}
+
 int
 lyv_data_context(const struct lyd_node *node, int options, struct unres_data *unres)
 {
@@ -73,6 +97,9 @@ lyv_data_context(const struct lyd_node *node, int options, struct unres_data *un
                 if (unres_data_add(unres, (struct lyd_node *)node, UNRES_UNION)) {
                     return 1;
                 }
+            } else if (lyv_ref_target_current(leaf, options)) {
+                /* the target is still the same */
+                leaf->validity &= ~LYD_VAL_LEAFREF;
             } else if ((((struct lys_node_leaf *)leaf->schema)->type.base == LY_TYPE_LEAFREF)
                     && ((leaf->validity & LYD_VAL_LEAFREF) || (leaf->value_flags & LY_VALUE_UNRES))) {
                 /* always retry validation on unres leafrefs, if again not possible, the correct flags should
@@ -192,7 +219,7 @@ uniquecheck:
                 }
             }
 
-            if (!val1 || !val2 || !ly_strequal(val1, val2, 1)) {
+            if (!val1 || !val2 || !ly_strequal(val1, val2, 0)) {
                 /* values differ or either one is not set */
                 break;
             }
@@ -234,24 +261,335 @@ unique_errmsg_cleanup:
     return 0;
 }
 
-int
-lyv_data_unique(struct lyd_node *list)
+/**
+ * @brief Get the hash of the values of a list instance unique.
+ *
+ * @param[in] slist Schema list.
+ * @param[in] idx Index of the unique in \p slist.
+ * @param[in] list List instance.
+ * @param[out] hash Finished hash of the unique values.
+ * @return 0 on success, 1 if some of the unique values is not set, -1 on error.
+ */
+static int
+lyv_uniq_hash(struct lys_node_list *slist, uint32_t idx, struct lyd_node *list, uint32_t *hash)
 {
     struct lyd_node *diter;
+    const char *id;
+    uint32_t i;
+
+    for (i = 0, *hash = 0; i < slist->unique[idx].expr_size; i++) {
+        diter = resolve_data_descendant_schema_nodeid(slist->unique[idx].expr[i], list->child);
+        if (diter) {
+            id = ((struct lyd_node_leaf_list *)diter)->value_str;
+        } else {
+            /* use default value */
+            if (lyd_get_unique_default(slist->unique[idx].expr[i], list, &id)) {
+                return -1;
+            }
+        }
+        if (!id) {
+            /* unique item not present nor has default value */
+            return 1;
+        }
+        *hash = dict_hash_multi(*hash, id, strlen(id));
+    }
+
+    /* finish the hash value */
+    *hash = dict_hash_multi(*hash, NULL, 0);
+    return 0;
+}
+
+#ifdef LY_ENABLED_CACHE
+
+/**
+ * @brief Unique index of the instances of a list, kept by their parent across validations.
+ *
+ * Indexed instances are stored in the unique tables under their hashes from the time of indexing,
+ * instances with #LYD_VAL_UNIQUE are re-indexed with their current values on the next validation.
+ */
+struct lyd_uniq_idx {
+    struct lys_node_list *slist;   /* schema list of the instances */
+    struct hash_table *insts;      /* all the indexed instances (struct lyv_uniq_rec), hashed by their pointers */
+    struct lyd_uniq_idx *next;     /* index of another list of the same parent */
+    struct hash_table *uniq[];     /* instances with all the values set for each unique of slist */
+};
+
+struct lyv_uniq_rec {
+    struct lyd_node *list;         /* indexed instance */
+    uint32_t hash[];               /* its hash in each unique table, 0 if not stored there */
+};
+
+static int
+lyv_uniq_ptr_equal(void *val1_p, void *val2_p, int UNUSED(mod), void *UNUSED(cb_data))
+{
+    return *((struct lyd_node **)val1_p) == *((struct lyd_node **)val2_p);
+}
+
+/* the indexed instance comes first and the error is reported for the instance being added */
+static int
+lyv_uniq_idx_equal(void *val1_p, void *val2_p, int mod, void *cb_data)
+{
+    return lyv_list_uniq_equal(val2_p, val1_p, mod, cb_data);
+}
+
+static uint32_t
+lyv_uniq_ptr_hash(const struct lyd_node *list)
+{
+    return dict_hash_multi(dict_hash_multi(0, (const char *)&list, sizeof list), NULL, 0);
+}
+
+static struct lyd_uniq_idx *
+lyv_uniq_idx_new(struct lyd_node *parent, struct lys_node_list *slist)
+{
+    struct lyd_side *side;
+    struct lyd_uniq_idx *idx;
+    uint32_t j;
+
+    side = lyd_side_get(parent, 1);
+    if (!side) {
+        return NULL;
+    }
+
+    idx = calloc(1, sizeof *idx + slist->unique_size * sizeof *idx->uniq);
+    LY_CHECK_ERR_RETURN(!idx, LOGMEM(slist->module->ctx), NULL);
+    idx->slist = slist;
+
+    idx->insts = lyht_new(16, sizeof(struct lyv_uniq_rec) + slist->unique_size * sizeof(uint32_t), lyv_uniq_ptr_equal,
+                          NULL, 1);
+    LY_CHECK_ERR_GOTO(!idx->insts, LOGMEM(slist->module->ctx), error);
+    for (j = 0; j < slist->unique_size; j++) {
+        idx->uniq[j] = lyht_new(16, sizeof(struct lyd_node *), lyv_uniq_idx_equal, (void *)(j + 1L), 1);
+        LY_CHECK_ERR_GOTO(!idx->uniq[j], LOGMEM(slist->module->ctx), error);
+    }
+
+    idx->next = side->uniq;
+    side->uniq = idx;
+    return idx;
+
+error:
+    lyht_free(idx->insts);
+    for (j = 0; j < slist->unique_size; j++) {
+        lyht_free(idx->uniq[j]);
+    }
+    free(idx);
+    return NULL;
+}
+
+void
+lyv_uniq_idx_free(struct lyd_uniq_idx *idx)
+{
+    struct lyd_uniq_idx *next;
+    uint32_t j;
+
+    for (; idx; idx = next) {
+        next = idx->next;
+        lyht_free(idx->insts);
+        for (j = 0; j < idx->slist->unique_size; j++) {
+            lyht_free(idx->uniq[j]);
+        }
+        free(idx);
+    }
+}
+
+/* free the index of the instances of list from its parent */
+static void
+lyv_uniq_idx_drop(struct lyd_node *parent, struct lys_node_list *slist)
+{
+    struct lyd_side *side;
+    struct lyd_uniq_idx **idx, *next;
+
+    side = lyd_side_get(parent, 0);
+    if (!side) {
+        return;
+    }
+
+    for (idx = &side->uniq; *idx && ((*idx)->slist != slist); idx = &(*idx)->next);
+    if (*idx) {
+        next = (*idx)->next;
+        (*idx)->next = NULL;
+        lyv_uniq_idx_free(*idx);
+        *idx = next;
+    }
+}
+
+/* remove an instance from the index, using its hashes from the time it was indexed */
+static void
+lyv_uniq_idx_remove(struct lyd_uniq_idx *idx, struct lyd_node *list)
+{
+    struct lyv_uniq_rec *rec;
+    values_equal_cb cb;
+    uint32_t j, hash;
+
+    hash = lyv_uniq_ptr_hash(list);
+    if (lyht_find(idx->insts, &list, hash, (void **)&rec)) {
+        /* not indexed */
+        return;
+    }
+
+    for (j = 0; j < idx->slist->unique_size; j++) {
+        if (rec->hash[j]) {
+            cb = lyht_set_cb(idx->uniq[j], lyv_uniq_ptr_equal);
+            lyht_remove(idx->uniq[j], &list, rec->hash[j]);
+            lyht_set_cb(idx->uniq[j], cb);
+        }
+    }
+    lyht_remove(idx->insts, &list, hash);
+}
+
+/* add an instance into the index, 1 if its unique values are already used by another instance */
+static int
+lyv_uniq_idx_add(struct lyd_uniq_idx *idx, struct lyd_node *list)
+{
+    struct lyv_uniq_rec *rec;
+    values_equal_cb cb;
+    uint32_t j, hash;
+    int r, ret = 0;
+
+    rec = malloc(sizeof *rec + idx->slist->unique_size * sizeof *rec->hash);
+    LY_CHECK_ERR_RETURN(!rec, LOGMEM(idx->slist->module->ctx), -1);
+    rec->list = list;
+
+    for (j = 0; j < idx->slist->unique_size; j++) {
+        rec->hash[j] = 0;
+        r = lyv_uniq_hash(idx->slist, j, list, &hash);
+        if (r == -1) {
+            ret = -1;
+            goto cleanup;
+        } else if (r) {
+            /* incomplete unique set */
+            continue;
+        }
+
+        /* hash 0 marks an instance not stored in the table */
+        hash = hash ? hash : 1;
+        if (lyht_insert(idx->uniq[j], &list, hash, NULL)) {
+            /* duplicate values, the error was logged by the callback */
+            ret = 1;
+            goto cleanup;
+        }
+        rec->hash[j] = hash;
+    }
+
+    if (lyht_insert(idx->insts, rec, lyv_uniq_ptr_hash(list), NULL)) {
+        LOGINT(idx->slist->module->ctx);
+        ret = -1;
+    }
+
+cleanup:
+    if (ret) {
+        /* remove it from the tables it was added into */
+        while (j--) {
+            if (rec->hash[j]) {
+                cb = lyht_set_cb(idx->uniq[j], lyv_uniq_ptr_equal);
+                lyht_remove(idx->uniq[j], &list, rec->hash[j]);
+                lyht_set_cb(idx->uniq[j], cb);
+            }
+        }
+    }
+    free(rec);
+    return ret;
+}
+
+void
+lyv_uniq_idx_unlink(struct lyd_node *list, struct lyd_node *parent)
+{
+    struct lyd_side *side;
+    struct lyd_uniq_idx *idx;
+
+    side = lyd_side_get(parent, 0);
+    if (!side) {
+        return;
+    }
+
+    for (idx = side->uniq; idx && (idx->slist != (struct lys_node_list *)list->schema); idx = idx->next);
+    if (idx) {
+        lyv_uniq_idx_remove(idx, list);
+    }
+}
+
+/* whether there can be more parent instances of the list instances, which are all checked together */
+static int
+lyv_list_in_list(const struct lys_node *snode)
+{
+    for (snode = lys_parent(snode); snode; snode = lys_parent(snode)) {
+        if (snode->nodetype == LYS_LIST) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Check list unique leaves using the index kept by the parent, only the changed instances
+ * are compared with the others.
+ */
+static int
+lyv_data_unique_idx(struct lyd_node *list, uint32_t *checked)
+{
+    struct lyd_node *parent = list->parent, *diter;
+    struct lys_node_list *slist = (struct lys_node_list *)list->schema;
+    struct lyd_side *side;
+    struct lyd_uniq_idx *idx;
+    int changed_only = 1, ret = 0;
+
+    side = lyd_side_get(parent, 0);
+    for (idx = side ? side->uniq : NULL; idx && (idx->slist != slist); idx = idx->next);
+    if (!idx) {
+        /* index all the instances */
+        idx = lyv_uniq_idx_new(parent, slist);
+        if (!idx) {
+            return -1;
+        }
+        changed_only = 0;
+    } else {
+        /* remove all the changed instances first so that they are compared with their current values */
+        LY_TREE_FOR(parent->child, diter) {
+            if ((diter->schema == list->schema) && (diter->validity & LYD_VAL_UNIQUE)) {
+                lyv_uniq_idx_remove(idx, diter);
+            }
+        }
+    }
+
+    LY_TREE_FOR(parent->child, diter) {
+        if ((diter->schema != list->schema) || (changed_only && !(diter->validity & LYD_VAL_UNIQUE))) {
+            continue;
+        }
+
+        /* remove the flag */
+        diter->validity &= ~LYD_VAL_UNIQUE;
+        ++(*checked);
+
+        ret = lyv_uniq_idx_add(idx, diter);
+        if (ret) {
+            /* the index is not complete, it will be created again */
+            lyv_uniq_idx_drop(parent, slist);
+            break;
+        }
+    }
+
+    return ret;
+}
+
+#endif
+
+static int
+lyv_data_unique_check(struct lyd_node *list, uint32_t *checked)
+{
     struct ly_set *set;
     uint32_t i, j, n = 0;
-    int ret = 0;
+    int r, ret = 0;
     uint32_t hash, u, usize = 0;
     struct hash_table **uniqtables = NULL;
-    const char *id;
     char *path;
     struct lys_node_list *slist;
     struct ly_ctx *ctx = list->schema->module->ctx;
 
-    if (!(list->validity & LYD_VAL_UNIQUE)) {
-        /* validated sa part of another instance validation */
-        return 0;
+#ifdef LY_ENABLED_CACHE
+    if (list->parent && !lyv_list_in_list(list->schema)) {
+        /* the only parent of all the instances keeps the index */
+        return lyv_data_unique_idx(list, checked);
     }
+#endif
 
     slist = (struct lys_node_list *)list->schema;
 
@@ -269,6 +607,7 @@ lyv_data_unique(struct lyd_node *list)
         /* remove the flag */
         set->set.d[i]->validity &= ~LYD_VAL_UNIQUE;
     }
+    *checked = set->number;
 
     if (set->number == 2) {
         /* simple comparison */
@@ -316,32 +655,15 @@ lyv_data_unique(struct lyd_node *list)
         for (u = 0; u < set->number; u++) {
             /* loop for unique - get the hash for the instances */
             for (j = 0; j < n; j++) {
-                id = NULL;
-                for (i = hash = 0; i < slist->unique[j].expr_size; i++) {
-                    diter = resolve_data_descendant_schema_nodeid(slist->unique[j].expr[i], set->set.d[u]->child);
-                    if (diter) {
-                        id = ((struct lyd_node_leaf_list *)diter)->value_str;
-                    } else {
-                        /* use default value */
-                        if (lyd_get_unique_default(slist->unique[j].expr[i], set->set.d[u], &id)) {
-                            ret = -1;
-                            goto cleanup;
-                        }
-                    }
-                    if (!id) {
-                        /* unique item not present nor has default value */
-                        break;
-                    }
-                    hash = dict_hash_multi(hash, id, strlen(id));
-                }
-                if (!id) {
+                r = lyv_uniq_hash(slist, j, set->set.d[u], &hash);
+                if (r == -1) {
+                    ret = -1;
+                    goto cleanup;
+                } else if (r) {
                     /* skip this list instance since its unique set is incomplete */
                     continue;
                 }
 
-                /* finish the hash value */
-                hash = dict_hash_multi(hash, NULL, 0);
-
                 /* insert into the hashtable */
                 if (lyht_insert(uniqtables[j], &set->set.d[u], hash, NULL)) {
                     ret = 1;
@@ -365,14 +687,33 @@ cleanup:
     return ret;
 }
 
+int
+lyv_data_unique(struct lyd_node *list)
+{
+    struct ly_ctx *ctx = list->schema->module->ctx;
+    struct timespec prof_start;
+    uint32_t checked = 0;
+    int ret;
+
+    if (!(list->validity & LYD_VAL_UNIQUE)) {
+        /* validated sa part of another instance validation */
+        return 0;
+    }
+
+    ly_val_prof_start(ctx, &prof_start);
+    ret = lyv_data_unique_check(list, &checked);
+    ly_val_prof_add(ctx, &prof_start, LY_VAL_PROF_UNIQUE, list->schema, NULL, checked);
+
+    return ret;
+}
+
 static int
 lyv_list_equal(void *val1_p, void *val2_p, int UNUSED(mod), void *UNUSED(cb_data))
 {
     struct ly_ctx *ctx;
     struct lys_node_list *slist;
     const struct lys_node *snode = NULL;
-    struct lyd_node *diter, *first, *second;
-    const char *val1, *val2;
+    struct lyd_node *diter, *first, *second, *key1, *key2;
     int i;
 
     assert(val1_p && val2_p);
@@ -392,8 +733,7 @@ lyv_list_equal(void *val1_p, void *val2_p, int UNUSED(mod), void *UNUSED(cb_data
             return 0;
         }
         /* compare values */
-        if (ly_strequal(((struct lyd_node_leaf_list *)first)->value_str,
-                        ((struct lyd_node_leaf_list *)second)->value_str, 1)) {
+        if (lyd_leaf_val_equal(first, second, 0)) {
             LOGVAL(ctx, LYE_DUPLEAFLIST, LY_VLOG_LYD, second, second->schema->name,
                    ((struct lyd_node_leaf_list *)second)->value_str);
             return 1;
@@ -409,20 +749,20 @@ lyv_list_equal(void *val1_p, void *val2_p, int UNUSED(mod), void *UNUSED(cb_data
         } else {
             for (i = 0; i < slist->keys_size; i++) {
                 snode = (struct lys_node *)slist->keys[i];
-                val1 = val2 = NULL;
+                key1 = key2 = NULL;
                 LY_TREE_FOR(first->child, diter) {
                     if (diter->schema == snode) {
-                        val1 = ((struct lyd_node_leaf_list *)diter)->value_str;
+                        key1 = diter;
                         break;
                     }
                 }
                 LY_TREE_FOR(second->child, diter) {
                     if (diter->schema == snode) {
-                        val2 = ((struct lyd_node_leaf_list *)diter)->value_str;
+                        key2 = diter;
                         break;
                     }
                 }
-                if (!ly_strequal(val1, val2, 1)) {
+                if ((key1 && key2) ? !lyd_leaf_val_equal(key1, key2, 0) : (key1 != key2)) {
                     return 0;
                 }
             }
@@ -445,14 +785,44 @@ lyv_data_dup(struct lyd_node *node, struct lyd_node *start)
     int i, ret = 0;
     uint32_t hash, u, usize = 0;
     struct hash_table *keystable = NULL;
-    const char *id;
     struct ly_ctx *ctx = node->schema->module->ctx;
+#ifdef LY_ENABLED_CACHE
+    struct lyd_node **match_p;
+#endif
 
     /* get the first list/leaflist instance sibling */
     if (!start) {
         start = lyd_first_sibling(node);
     }
 
+#ifdef LY_ENABLED_CACHE
+    if (node->parent && node->parent->ht
+            && ((node->schema->nodetype == LYS_LEAFLIST) || ((struct lys_node_list *)node->schema)->keys_size)) {
+        /* the parent hash table already has all the instances hashed by their keys/value,
+         * look up only the changed instances there */
+        for (diter = start; diter; diter = diter->next) {
+            if ((diter->schema != node->schema) || !(diter->validity & LYD_VAL_DUP)) {
+                continue;
+            }
+
+            /* remove the flag */
+            diter->validity &= ~LYD_VAL_DUP;
+
+            if (!diter->hash || lyht_find(node->parent->ht, &diter, diter->hash, (void **)&match_p)) {
+                /* not hashed (missing keys) */
+                continue;
+            }
+            do {
+                if ((*match_p != diter) && lyv_list_equal(match_p, &diter, 0, NULL)) {
+                    /* instance duplication */
+                    return 1;
+                }
+            } while (!lyht_find_next(node->parent->ht, match_p, diter->hash, (void **)&match_p));
+        }
+        return 0;
+    }
+#endif
+
     /* check uniqueness of the list/leaflist instances (compare values) */
     set = ly_set_new();
     for (diter = start; diter; diter = diter->next) {
@@ -503,14 +873,12 @@ lyv_data_dup(struct lyd_node *node, struct lyd_node *start)
         for (u = 0; u < set->number; u++) {
             /* get the hash for the instance - keys */
             if (node->schema->nodetype == LYS_LEAFLIST) {
-                id = ((struct lyd_node_leaf_list *)set->set.d[u])->value_str;
-                hash = dict_hash_multi(0, id, strlen(id));
+                hash = lyd_hash_value(0, (struct lyd_node_leaf_list *)set->set.d[u]);
             } else { /* LYS_LIST */
                 for (hash = i = 0, key = set->set.d[u]->child;
                         i < ((struct lys_node_list *)set->set.d[u]->schema)->keys_size;
                         i++, key = key->next) {
-                    id = ((struct lyd_node_leaf_list *)key)->value_str;
-                    hash = dict_hash_multi(hash, id, strlen(id));
+                    hash = lyd_hash_value(hash, (struct lyd_node_leaf_list *)key);
                 }
             }
             /* finish the hash value */
@@ -568,10 +936,16 @@ static int
 lyv_extension(struct lys_ext_instance **ext, uint8_t size, struct lyd_node *node)
 {
     uint i;
+    int r;
+    struct timespec start;
 
     for (i = 0; i < size; ++i) {
         if ((ext[i]->flags & LYEXT_OPT_VALID) && ext[i]->def->plugin->valid_data) {
-            if (ext[i]->def->plugin->valid_data(ext[i], node)) {
+            ly_plugin_stats_start(ext[i]->def->module->ctx, &start);
+            r = ext[i]->def->plugin->valid_data(ext[i], node);
+            ly_plugin_stats_add(ext[i]->def->module->ctx, &start, LY_PLUGIN_VALID_DATA, ext[i]->def->module->name,
+                                ext[i]->def->name);
+            if (r) {
                 return EXIT_FAILURE;
             }
         }
@@ -797,6 +1171,12 @@ lyv_data_content(struct lyd_node *node, int options, struct unres_data *unres)
         if (options & LYD_OPT_TRUSTED) {
             /* just remove flag */
             node->validity &= ~LYD_VAL_UNIQUE;
+#ifdef LY_ENABLED_CACHE
+            if (node->parent && node->parent->side) {
+                /* the instance values are not indexed anymore */
+                lyv_uniq_idx_drop(node->parent, (struct lys_node_list *)schema);
+            }
+#endif
         } else {
             /* check the unique constraint at the end (once the parsing is done) */
             if (unres_data_add(unres, node, UNRES_UNIQ_LEAVES)) {
@@ -57,6 +57,27 @@ int lyv_data_content(struct lyd_node *node, int options, struct unres_data *unre
  */
 int lyv_data_unique(struct lyd_node *list);
 
+#ifdef LY_ENABLED_CACHE
+
+struct lyd_uniq_idx;
+
+/**
+ * @brief Free the unique indexes of a parent node (lyd_side#uniq).
+ *
+ * @param[in] idx Indexes to free.
+ */
+void lyv_uniq_idx_free(struct lyd_uniq_idx *idx);
+
+/**
+ * @brief Remove a list instance being unlinked from the unique index of its parent.
+ *
+ * @param[in] list List instance.
+ * @param[in] parent Parent \p list is being unlinked from.
+ */
+void lyv_uniq_idx_unlink(struct lyd_node *list, struct lyd_node *parent);
+
+#endif
+
 /**
  * @brief Check for list/leaflist instance duplications.
  *
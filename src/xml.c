@@ -40,36 +40,39 @@
 
 static struct lyxml_attr *lyxml_dup_attr(struct ly_ctx *ctx, struct lyxml_elem *parent, struct lyxml_attr *attr);
 
-API const struct lyxml_ns *
-lyxml_get_ns(const struct lyxml_elem *elem, const char *prefix)
+const struct lyxml_ns *
+lyxml_get_ns_len(const struct lyxml_elem *elem, const char *prefix, size_t prefix_len)
 {
     struct lyxml_attr *attr;
 
-    if (!elem) {
-        return NULL;
-    }
-
-    for (attr = elem->attr; attr; attr = attr->next) {
-        if (attr->type != LYXML_ATTR_NS) {
-            continue;
-        }
-        if (!attr->name) {
-            if (!prefix) {
-                /* default namespace found */
-                if (!attr->value) {
-                    /* empty default namespace -> no default namespace */
-                    return NULL;
+    for (; elem; elem = elem->parent) {
+        for (attr = elem->attr; attr; attr = attr->next) {
+            if (attr->type != LYXML_ATTR_NS) {
+                continue;
+            }
+            if (!attr->name) {
+                if (!prefix) {
+                    /* default namespace found */
+                    if (!attr->value) {
+                        /* empty default namespace -> no default namespace */
+                        return NULL;
+                    }
+                    return (struct lyxml_ns *)attr;
                 }
+            } else if (prefix && !strncmp(attr->name, prefix, prefix_len) && !attr->name[prefix_len]) {
+                /* prefix found */
                 return (struct lyxml_ns *)attr;
             }
-        } else if (prefix && !strcmp(attr->name, prefix)) {
-            /* prefix found */
-            return (struct lyxml_ns *)attr;
         }
     }
 
-    /* go recursively */
-    return lyxml_get_ns(elem->parent, prefix);
+    return NULL;
+}
+
+API const struct lyxml_ns *
+lyxml_get_ns(const struct lyxml_elem *elem, const char *prefix)
+{
+    return lyxml_get_ns_len(elem, prefix, prefix ? strlen(prefix) : 0);
 }
 
 static void
@@ -552,6 +555,16 @@ lyxml_getutf8(struct ly_ctx *ctx, const char *buf, unsigned int *read)
     return c;
 }
 
+/* number of the leading ASCII name characters other than ':' */
+static unsigned int
+xml_name_ascii(const char *data)
+{
+    unsigned int i;
+
+    for (i = 0; isalnum((unsigned char)data[i]) || (data[i] == '_') || (data[i] == '-') || (data[i] == '.'); ++i);
+    return i;
+}
+
 /* logs directly */
 static int
 parse_ignore(struct ly_ctx *ctx, const char *data, const char *endstr, unsigned int *len)
@@ -586,6 +599,8 @@ parse_text(struct ly_ctx *ctx, const char *data, char delim, unsigned int *len)
     int o, size = 0;
     int cdsect = 0;
     int32_t n;
+    size_t stop = 0, plain;
+    const char stopchars[] = {'<', '&', ']', delim, '\0'};
 
     for (*len = o = 0; cdsect || data[*len] != delim; o++) {
         if (!data[*len] || (!cdsect && !strncmp(&data[*len], "]]>", 3))) {
@@ -684,6 +699,19 @@ loop:
                 (*len)++;
             }
         } else {
+            /* copy the characters up to the next markup, reference, or delimiter in bulk while they are valid */
+            if (*len >= stop) {
+                stop = *len + strcspn(&data[*len], stopchars);
+            }
+            plain = ly_utf8_span(&data[*len], (stop - *len < (unsigned)(BUFSIZE - o)) ? stop - *len : (unsigned)(BUFSIZE - o),
+                                 NULL);
+            if (plain) {
+                memcpy(&buf[o], &data[*len], plain);
+                o += plain - 1; /* o is ++ in for loop */
+                *len += plain;
+                continue;
+            }
+
             r = copyutf8(ctx, &buf[o], &data[*len]);
             if (!r) {
                 goto error;
@@ -733,7 +761,7 @@ static struct lyxml_attr *
 parse_attr(struct ly_ctx *ctx, const char *data, unsigned int *len, struct lyxml_elem *parent)
 {
     const char *c = data, *start, *delim;
-    char *prefix = NULL, xml_flag, *str;
+    char xml_flag, *str;
     int uc;
     struct lyxml_attr *attr = NULL, *a;
     unsigned int size;
@@ -781,11 +809,7 @@ parse_attr(struct ly_ctx *ctx, const char *data, unsigned int *len, struct lyxml
                 start = c + 1;
 
                 /* look for the prefix in namespaces */
-                prefix = malloc((c - data + 1) * sizeof *prefix);
-                LY_CHECK_ERR_GOTO(!prefix, LOGMEM(ctx), error);
-                memcpy(prefix, data, c - data);
-                prefix[c - data] = '\0';
-                attr->ns = lyxml_get_ns(parent, prefix);
+                attr->ns = lyxml_get_ns_len(parent, data, c - data);
             } else if (((*c == 'm') && (xml_flag == 1)) ||
                     ((*c == 'l') && (xml_flag == 2))) {
                 ++xml_flag;
@@ -836,29 +860,25 @@ equal:
         parent->attr = attr;
     }
 
-    free(prefix);
     return attr;
 
 error:
     lyxml_free_attr(ctx, NULL, attr);
-    free(prefix);
     return NULL;
 }
 
 /* logs directly */
 struct lyxml_elem *
-lyxml_parse_elem(struct ly_ctx *ctx, const char *data, unsigned int *len, struct lyxml_elem *parent, int options)
+lyxml_parse_elem_start(struct ly_ctx *ctx, const char *data, unsigned int *len, struct lyxml_elem *parent)
 {
     const char *c = data, *start, *e;
-    const char *lws;    /* leading white space for handling mixed content */
     int uc;
-    char *str;
-    char *prefix = NULL;
+    const char *prefix = NULL;
     unsigned int prefix_len = 0;
-    struct lyxml_elem *elem = NULL, *child;
+    struct lyxml_elem *elem = NULL;
     struct lyxml_attr *attr;
     unsigned int size;
-    int nons_flag = 0, closed_flag = 0;
+    int nons_flag = 0;
 
     *len = 0;
 
@@ -876,6 +896,7 @@ lyxml_parse_elem(struct ly_ctx *ctx, const char *data, unsigned int *len, struct
         return NULL;
     }
     e += size;
+    e += xml_name_ascii(e);
     uc = lyxml_getutf8(ctx, e, &size);
     while (is_xmlnamechar(uc)) {
         if (*e == ':') {
@@ -889,24 +910,24 @@ lyxml_parse_elem(struct ly_ctx *ctx, const char *data, unsigned int *len, struct
             /* look for the prefix in namespaces */
             prefix_len = e - c;
             LY_CHECK_ERR_GOTO(prefix, LOGVAL(ctx, LYE_XML_INCHAR, LY_VLOG_NONE, NULL, e), error);
-            prefix = malloc((prefix_len + 1) * sizeof *prefix);
-            LY_CHECK_ERR_GOTO(!prefix, LOGMEM(ctx), error);
-            memcpy(prefix, c, prefix_len);
-            prefix[prefix_len] = '\0';
+            prefix = c;
             c = start;
         }
         e += size;
+        e += xml_name_ascii(e);
         uc = lyxml_getutf8(ctx, e, &size);
     }
     if (!*e) {
         LOGVAL(ctx, LYE_EOF, LY_VLOG_NONE, NULL);
-        free(prefix);
         return NULL;
     }
 
     /* allocate element structure */
+    if (ly_parse_charge(ctx, 0, sizeof *elem)) {
+        return NULL;
+    }
     elem = calloc(1, sizeof *elem);
-    LY_CHECK_ERR_RETURN(!elem, free(prefix); LOGMEM(ctx), NULL);
+    LY_CHECK_ERR_RETURN(!elem, LOGMEM(ctx), NULL);
 
     elem->next = NULL;
     elem->prev = elem;
@@ -924,263 +945,540 @@ process:
         /* we are done, it was EmptyElemTag */
         c += 2;
         elem->content = lydict_insert(ctx, "", 0);
-        closed_flag = 1;
     } else if (*c == '>') {
-        /* process element content */
+        /* the element content follows */
         c++;
-        lws = NULL;
+    } else {
+        /* process attribute */
+        attr = parse_attr(ctx, c, &size, elem);
+        if (!attr) {
+            goto error;
+        }
+        c += size;              /* move after processed attribute */
 
-        while (*c) {
-            if (!strncmp(c, "</", 2)) {
-                if (lws && !elem->child) {
-                    /* leading white spaces were actually content */
-                    goto store_content;
+        /* check namespace */
+        if (attr->type == LYXML_ATTR_NS) {
+            if (!prefix_len && !attr->name) {
+                if (attr->value) {
+                    /* default prefix */
+                    elem->ns = (struct lyxml_ns *)attr;
+                } else {
+                    /* xmlns="" -> no namespace */
+                    nons_flag = 1;
                 }
+            } else if (prefix_len && attr->name && !strncmp(attr->name, prefix, prefix_len) && !attr->name[prefix_len]) {
+                /* matching namespace with prefix */
+                elem->ns = (struct lyxml_ns *)attr;
+            }
+        }
 
-                /* Etag */
-                c += 2;
-                /* get name and check it */
-                e = c;
-                uc = lyxml_getutf8(ctx, e, &size);
-                if (!is_xmlnamestartchar(uc)) {
-                    LOGVAL(ctx, LYE_XML_INVAL, LY_VLOG_XML, elem, "NameStartChar of the element");
-                    goto error;
+        /* go back to finish element processing */
+        goto process;
+    }
+
+    *len = c - data;
+
+    if (!elem->ns && !nons_flag && parent) {
+        if (parent->ns && (prefix_len ? (parent->ns->prefix && !strncmp(parent->ns->prefix, prefix, prefix_len)
+                                         && !parent->ns->prefix[prefix_len]) : !parent->ns->prefix)) {
+            /* the parent has just been parsed and its namespace is still in scope, it is the nearest declaration
+             * of the same prefix, so the ancestors do not have to be searched */
+            elem->ns = parent->ns;
+        } else {
+            elem->ns = lyxml_get_ns_len(parent, prefix_len ? prefix : NULL, prefix_len);
+        }
+    }
+    return elem;
+
+error:
+    lyxml_free(ctx, elem);
+    return NULL;
+}
+
+/**
+ * @brief Parse content of an element following its start tag. Logs directly.
+ *
+ * @param[in] ctx Context to use.
+ * @param[in] data Input data right after the start tag of \p elem.
+ * @param[out] len Number of processed bytes in \p data.
+ * @param[in] elem Element being parsed.
+ * @param[in] stag Start tag of \p elem in the input.
+ * @param[in] options Parser options.
+ * @param[in] stream Whether to stop before the start tag of any child element or parse whole subtrees of children.
+ * @return 1 if the end tag of \p elem was processed, 0 on a child start tag (only with \p stream), -1 on error.
+ */
+static int
+parse_content(struct ly_ctx *ctx, const char *data, unsigned int *len, struct lyxml_elem *elem, const char *stag,
+              int options, int stream)
+{
+    const char *c = data, *e;
+    const char *lws;    /* leading white space for handling mixed content */
+    int uc;
+    char *str;
+    const char *prefix;
+    unsigned int prefix_len;
+    struct lyxml_elem *child;
+    unsigned int size;
+
+    *len = 0;
+
+    /* find the prefix of the element name in its start tag */
+    prefix = stag + 1;
+    for (e = prefix; *e && (*e != ':') && (*e != '>') && (*e != '/') && !is_xmlws(*e); ++e);
+    prefix_len = (*e == ':') ? e - prefix : 0;
+
+    lws = NULL;
+    while (*c) {
+        if (!strncmp(c, "</", 2)) {
+            if (lws && !elem->child) {
+                /* leading white spaces were actually content */
+                goto store_content;
+            }
+
+            /* Etag */
+            c += 2;
+            /* get name and check it */
+            e = c;
+            uc = lyxml_getutf8(ctx, e, &size);
+            if (!is_xmlnamestartchar(uc)) {
+                LOGVAL(ctx, LYE_XML_INVAL, LY_VLOG_XML, elem, "NameStartChar of the element");
+                return -1;
+            }
+            e += size;
+            e += xml_name_ascii(e);
+            uc = lyxml_getutf8(ctx, e, &size);
+            while (is_xmlnamechar(uc)) {
+                if (*e == ':') {
+                    /* element in a namespace, it must be the same prefix as in the start tag */
+                    if (!prefix_len || ((unsigned)(e - c) != prefix_len) || memcmp(prefix, c, prefix_len)) {
+                        LOGVAL(ctx, LYE_SPEC, LY_VLOG_XML, elem,
+                               "Invalid (different namespaces) opening (%s) and closing element tags.", elem->name);
+                        return -1;
+                    }
+                    c = e + 1;
                 }
                 e += size;
+                e += xml_name_ascii(e);
                 uc = lyxml_getutf8(ctx, e, &size);
-                while (is_xmlnamechar(uc)) {
-                    if (*e == ':') {
-                        /* element in a namespace */
-                        start = e + 1;
-
-                        /* look for the prefix in namespaces */
-                        if (!prefix || memcmp(prefix, c, e - c)) {
-                            LOGVAL(ctx, LYE_SPEC, LY_VLOG_XML, elem,
-                                   "Invalid (different namespaces) opening (%s) and closing element tags.", elem->name);
-                            goto error;
-                        }
-                        c = start;
-                    }
-                    e += size;
-                    uc = lyxml_getutf8(ctx, e, &size);
-                }
-                if (!*e) {
-                    LOGVAL(ctx, LYE_EOF, LY_VLOG_NONE, NULL);
-                    goto error;
-                }
+            }
+            if (!*e) {
+                LOGVAL(ctx, LYE_EOF, LY_VLOG_NONE, NULL);
+                return -1;
+            }
 
-                /* check that it corresponds to opening tag */
-                size = e - c;
-                str = malloc((size + 1) * sizeof *str);
-                LY_CHECK_ERR_GOTO(!str, LOGMEM(ctx), error);
-                memcpy(str, c, e - c);
-                str[e - c] = '\0';
-                if (size != strlen(elem->name) || memcmp(str, elem->name, size)) {
-                    LOGVAL(ctx, LYE_SPEC, LY_VLOG_XML, elem,
-                           "Invalid (mixed names) opening (%s) and closing (%s) element tags.", elem->name, str);
-                    free(str);
-                    goto error;
-                }
+            /* check that it corresponds to opening tag */
+            size = e - c;
+            if (size != strlen(elem->name) || memcmp(c, elem->name, size)) {
+                str = strndup(c, size);
+                LY_CHECK_ERR_RETURN(!str, LOGMEM(ctx), -1);
+                LOGVAL(ctx, LYE_SPEC, LY_VLOG_XML, elem,
+                       "Invalid (mixed names) opening (%s) and closing (%s) element tags.", elem->name, str);
                 free(str);
-                c = e;
+                return -1;
+            }
+            c = e;
 
-                ign_xmlws(c);
-                if (*c != '>') {
-                    LOGVAL(ctx, LYE_SPEC, LY_VLOG_XML, elem, "Data after closing element tag \"%s\".", elem->name);
-                    goto error;
-                }
-                c++;
-                if (!(elem->flags & LYXML_ELEM_MIXED) && !elem->content) {
-                    /* there was no content, but we don't want NULL (only if mixed content) */
-                    elem->content = lydict_insert(ctx, "", 0);
-                }
-                closed_flag = 1;
-                break;
+            ign_xmlws(c);
+            if (*c != '>') {
+                LOGVAL(ctx, LYE_SPEC, LY_VLOG_XML, elem, "Data after closing element tag \"%s\".", elem->name);
+                return -1;
+            }
+            c++;
+            if (!(elem->flags & LYXML_ELEM_MIXED) && !elem->content) {
+                /* there was no content, but we don't want NULL (only if mixed content) */
+                elem->content = lydict_insert(ctx, "", 0);
+            }
 
-            } else if (!strncmp(c, "<?", 2)) {
-                if (lws) {
+            *len = c - data;
+            return 1;
+
+        } else if (!strncmp(c, "<?", 2)) {
+            if (lws) {
+                /* leading white spaces were only formatting */
+                lws = NULL;
+            }
+            /* PI - ignore it */
+            c += 2;
+            if (parse_ignore(ctx, c, "?>", &size)) {
+                return -1;
+            }
+            c += size;
+        } else if (!strncmp(c, "<!--", 4)) {
+            if (lws) {
+                /* leading white spaces were only formatting */
+                lws = NULL;
+            }
+            /* Comment - ignore it */
+            c += 4;
+            if (parse_ignore(ctx, c, "-->", &size)) {
+                return -1;
+            }
+            c += size;
+        } else if (!strncmp(c, "<![CDATA[", 9)) {
+            /* CDSect */
+            goto store_content;
+        } else if (*c == '<') {
+            if (lws) {
+                if (elem->flags & LYXML_ELEM_MIXED) {
+                    /* we have a mixed content */
+                    goto store_content;
+                } else {
                     /* leading white spaces were only formatting */
                     lws = NULL;
                 }
-                /* PI - ignore it */
-                c += 2;
-                if (parse_ignore(ctx, c, "?>", &size)) {
-                    goto error;
+            }
+            if (stream) {
+                /* the child is going to be parsed by the caller, any text content is left in the element */
+                *len = c - data;
+                return 0;
+            }
+            if (elem->content) {
+                /* we have a mixed content */
+                if (options & LYXML_PARSE_NOMIXEDCONTENT) {
+                    LOGVAL(ctx, LYE_XML_INVAL, LY_VLOG_XML, elem, "XML element with mixed content");
+                    return -1;
                 }
-                c += size;
-            } else if (!strncmp(c, "<!--", 4)) {
-                if (lws) {
-                    /* leading white spaces were only formatting */
-                    lws = NULL;
+                child = calloc(1, sizeof *child);
+                LY_CHECK_ERR_RETURN(!child, LOGMEM(ctx), -1);
+                child->content = elem->content;
+                elem->content = NULL;
+                lyxml_add_child(ctx, elem, child);
+                elem->flags |= LYXML_ELEM_MIXED;
+            }
+            child = lyxml_parse_elem(ctx, c, &size, elem, options);
+            if (!child) {
+                return -1;
+            }
+            c += size;      /* move after processed child element */
+        } else if (is_xmlws(*c)) {
+            lws = c;
+            ign_xmlws(c);
+        } else {
+store_content:
+            /* store text content */
+            if (lws) {
+                /* process content including the leading white spaces */
+                c = lws;
+                lws = NULL;
+            }
+            str = parse_text(ctx, c, '<', &size);
+            if (!str && !size) {
+                return -1;
+            }
+            /* content stored before can be present only if it was interrupted by a comment or PI */
+            lydict_remove(ctx, elem->content);
+            elem->content = lydict_insert_zc(ctx, str);
+            c += size;      /* move after processed text content */
+
+            if (elem->child) {
+                /* we have a mixed content */
+                if (options & LYXML_PARSE_NOMIXEDCONTENT) {
+                    LOGVAL(ctx, LYE_XML_INVAL, LY_VLOG_XML, elem, "XML element with mixed content");
+                    return -1;
                 }
-                /* Comment - ignore it */
-                c += 4;
-                if (parse_ignore(ctx, c, "-->", &size)) {
-                    goto error;
+                child = calloc(1, sizeof *child);
+                LY_CHECK_ERR_RETURN(!child, LOGMEM(ctx), -1);
+                child->content = elem->content;
+                elem->content = NULL;
+                lyxml_add_child(ctx, elem, child);
+                elem->flags |= LYXML_ELEM_MIXED;
+            }
+        }
+    }
+
+    LOGVAL(ctx, LYE_XML_MISS, LY_VLOG_XML, elem, "closing element tag", elem->name);
+    return -1;
+}
+
+int
+lyxml_parse_elem_next(struct ly_ctx *ctx, const char *data, unsigned int *len, struct lyxml_elem *elem, const char *stag,
+                      int options)
+{
+    return parse_content(ctx, data, len, elem, stag, options, 1);
+}
+
+int
+lyxml_parse_elem_finish(struct ly_ctx *ctx, const char *data, unsigned int *len, struct lyxml_elem *elem, const char *stag,
+                        int options)
+{
+    return (parse_content(ctx, data, len, elem, stag, options, 0) == 1) ? 0 : -1;
+}
+
+/* declare the namespaces in scope on a top-level element of a raw content, logs directly */
+static int
+parse_raw_declare_ns(struct ly_ctx *ctx, struct lyout *out, const char *stag, struct ly_set *nss)
+{
+    struct lyxml_elem *child;
+    struct lyxml_attr *attr;
+    const struct lyxml_ns *ns;
+    unsigned int i, size;
+
+    /* only the start tag is parsed to learn the namespaces the element declares itself */
+    child = lyxml_parse_elem_start(ctx, stag, &size, NULL);
+    if (!child) {
+        return EXIT_FAILURE;
+    }
+
+    for (i = 0; i < nss->number; ++i) {
+        ns = nss->set.g[i];
+        for (attr = child->attr; attr; attr = attr->next) {
+            if ((attr->type == LYXML_ATTR_NS) && (attr->name == ns->prefix)) {
+                break;
+            }
+        }
+        if (attr) {
+            continue;
+        }
+
+        if (ns->prefix) {
+            ly_print(out, " xmlns:%s=\"%s\"", ns->prefix, ns->value ? ns->value : "");
+        } else {
+            ly_print(out, " xmlns=\"%s\"", ns->value ? ns->value : "");
+        }
+    }
+
+    lyxml_free(ctx, child);
+    return EXIT_SUCCESS;
+}
+
+/* logs directly, \p out is NULL if the content is only skipped */
+static int
+parse_elem_raw(struct ly_ctx *ctx, const char *data, unsigned int *len, struct lyxml_elem *elem, const char *stag,
+               struct lyout *out)
+{
+    const char *c = data, *e, *copied = data, *qname = stag + 1;
+    struct lyxml_elem *iter;
+    struct lyxml_attr *attr;
+    struct ly_set *nss = NULL;
+    unsigned int i, qname_len;
+    int depth = 0;
+    char quot;
+
+    for (qname_len = 0; qname[qname_len] && !is_xmlws(qname[qname_len]) && (qname[qname_len] != '/')
+            && (qname[qname_len] != '>'); ++qname_len);
+
+    if (out) {
+        /* namespaces in scope, the closest declaration of each prefix applies */
+        nss = ly_set_new();
+        LY_CHECK_ERR_RETURN(!nss, LOGMEM(ctx), -1);
+        for (iter = elem; iter; iter = iter->parent) {
+            for (attr = iter->attr; attr; attr = attr->next) {
+                if (attr->type != LYXML_ATTR_NS) {
+                    continue;
                 }
-                c += size;
-            } else if (!strncmp(c, "<![CDATA[", 9)) {
-                /* CDSect */
-                goto store_content;
-            } else if (*c == '<') {
-                if (lws) {
-                    if (elem->flags & LYXML_ELEM_MIXED) {
-                        /* we have a mixed content */
-                        goto store_content;
-                    } else {
-                        /* leading white spaces were only formatting */
-                        lws = NULL;
-                    }
+                for (i = 0; (i < nss->number) && (((struct lyxml_ns *)nss->set.g[i])->prefix != attr->name); ++i);
+                if (i == nss->number) {
+                    ly_set_add(nss, attr, LY_SET_OPT_USEASLIST);
                 }
-                if (elem->content) {
-                    /* we have a mixed content */
-                    if (options & LYXML_PARSE_NOMIXEDCONTENT) {
-                        LOGVAL(ctx, LYE_XML_INVAL, LY_VLOG_XML, elem, "XML element with mixed content");
-                        goto error;
-                    }
-                    child = calloc(1, sizeof *child);
-                    LY_CHECK_ERR_GOTO(!child, LOGMEM(ctx), error);
-                    child->content = elem->content;
-                    elem->content = NULL;
-                    lyxml_add_child(ctx, elem, child);
-                    elem->flags |= LYXML_ELEM_MIXED;
+            }
+        }
+    }
+
+    while ((c = strchr(c, '<'))) {
+        if (!strncmp(c, "<?", 2)) {
+            e = strstr(c + 2, "?>");
+            c = e ? e + 2 : NULL;
+        } else if (!strncmp(c, "<!--", 4)) {
+            e = strstr(c + 4, "-->");
+            c = e ? e + 3 : NULL;
+        } else if (!strncmp(c, "<![CDATA[", 9)) {
+            e = strstr(c + 9, "]]>");
+            c = e ? e + 3 : NULL;
+        } else if (c[1] == '/') {
+            if (depth) {
+                --depth;
+                c = strchr(c, '>');
+                c = c ? c + 1 : NULL;
+            } else {
+                /* end tag of the element */
+                e = c + 2;
+                if (strncmp(e, qname, qname_len)) {
+                    LOGVAL(ctx, LYE_SPEC, LY_VLOG_XML, elem, "Invalid (mixed names) opening (%s) and closing element tags.",
+                           elem->name);
+                    goto error;
                 }
-                child = lyxml_parse_elem(ctx, c, &size, elem, options);
-                if (!child) {
+                e += qname_len;
+                ign_xmlws(e);
+                if (*e != '>') {
+                    LOGVAL(ctx, LYE_SPEC, LY_VLOG_XML, elem, "Data after closing element tag \"%s\".", elem->name);
                     goto error;
                 }
-                c += size;      /* move after processed child element */
-            } else if (is_xmlws(*c)) {
-                lws = c;
-                ign_xmlws(c);
-            } else {
-store_content:
-                /* store text content */
-                if (lws) {
-                    /* process content including the leading white spaces */
-                    c = lws;
-                    lws = NULL;
+
+                if (out) {
+                    ly_write(out, copied, c - copied);
                 }
-                str = parse_text(ctx, c, '<', &size);
-                if (!str && !size) {
+                *len = e + 1 - data;
+                break;
+            }
+        } else {
+            if (out && !depth) {
+                /* top-level element, declare the namespaces after its name */
+                for (e = c + 1; *e && !is_xmlws(*e) && (*e != '/') && (*e != '>'); ++e);
+                ly_write(out, copied, e - copied);
+                copied = e;
+                if (parse_raw_declare_ns(ctx, out, c, nss)) {
                     goto error;
                 }
-                elem->content = lydict_insert_zc(ctx, str);
-                c += size;      /* move after processed text content */
+            }
 
-                if (elem->child) {
-                    /* we have a mixed content */
-                    if (options & LYXML_PARSE_NOMIXEDCONTENT) {
-                        LOGVAL(ctx, LYE_XML_INVAL, LY_VLOG_XML, elem, "XML element with mixed content");
-                        goto error;
-                    }
-                    child = calloc(1, sizeof *child);
-                    LY_CHECK_ERR_GOTO(!child, LOGMEM(ctx), error);
-                    child->content = elem->content;
-                    elem->content = NULL;
-                    lyxml_add_child(ctx, elem, child);
-                    elem->flags |= LYXML_ELEM_MIXED;
+            /* find the end of the start tag, attribute values may include '>' */
+            for (quot = 0, e = c + 1; *e && (quot || (*e != '>')); ++e) {
+                if (quot && (*e == quot)) {
+                    quot = 0;
+                } else if (!quot && ((*e == '"') || (*e == '\''))) {
+                    quot = *e;
                 }
             }
+            if (*e && (e[-1] != '/')) {
+                ++depth;
+            }
+            c = *e ? e + 1 : NULL;
         }
-    } else {
-        /* process attribute */
-        attr = parse_attr(ctx, c, &size, elem);
-        if (!attr) {
-            goto error;
+        if (!c) {
+            break;
         }
-        c += size;              /* move after processed attribute */
+    }
+    if (!c) {
+        LOGVAL(ctx, LYE_XML_MISS, LY_VLOG_XML, elem, "closing element tag", elem->name);
+        goto error;
+    }
 
-        /* check namespace */
-        if (attr->type == LYXML_ATTR_NS) {
-            if ((!prefix || !prefix[0]) && !attr->name) {
-                if (attr->value) {
-                    /* default prefix */
-                    elem->ns = (struct lyxml_ns *)attr;
-                } else {
-                    /* xmlns="" -> no namespace */
-                    nons_flag = 1;
-                }
-            } else if (prefix && prefix[0] && attr->name && !strncmp(attr->name, prefix, prefix_len + 1)) {
-                /* matching namespace with prefix */
-                elem->ns = (struct lyxml_ns *)attr;
-            }
-        }
+    ly_set_free(nss);
+    return 0;
 
-        /* go back to finish element processing */
-        goto process;
-    }
+error:
+    ly_set_free(nss);
+    return -1;
+}
 
-    *len = c - data;
+char *
+lyxml_parse_elem_raw(struct ly_ctx *ctx, const char *data, unsigned int *len, struct lyxml_elem *elem,
+                     const char *stag)
+{
+    struct lyout out;
 
-    if (!closed_flag) {
-        LOGVAL(ctx, LYE_XML_MISS, LY_VLOG_XML, elem, "closing element tag", elem->name);
-        goto error;
+    memset(&out, 0, sizeof out);
+    out.type = LYOUT_MEMORY;
+
+    if (parse_elem_raw(ctx, data, len, elem, stag, &out)) {
+        free(out.method.mem.buf);
+        return NULL;
     }
 
-    if (!elem->ns && !nons_flag && parent) {
-        elem->ns = lyxml_get_ns(parent, prefix_len ? prefix : NULL);
+    if (!out.method.mem.buf) {
+        return strdup("");
     }
-    free(prefix);
-    return elem;
+    return out.method.mem.buf;
+}
 
-error:
-    lyxml_free(ctx, elem);
-    free(prefix);
-    return NULL;
+int
+lyxml_parse_elem_skip(struct ly_ctx *ctx, const char *data, unsigned int *len, struct lyxml_elem *elem,
+                      const char *stag)
+{
+    return parse_elem_raw(ctx, data, len, elem, stag, NULL);
 }
 
 /* logs directly */
-API struct lyxml_elem *
-lyxml_parse_mem(struct ly_ctx *ctx, const char *data, int options)
+struct lyxml_elem *
+lyxml_parse_elem(struct ly_ctx *ctx, const char *data, unsigned int *len, struct lyxml_elem *parent, int options)
 {
     const char *c = data;
-    unsigned int len;
-    struct lyxml_elem *root, *first = NULL, *next;
+    struct lyxml_elem *elem;
+    unsigned int size;
 
-    if (!ctx) {
-        LOGARG;
+    elem = lyxml_parse_elem_start(ctx, c, &size, parent);
+    if (!elem) {
+        *len = 0;
         return NULL;
     }
+    c += size;
 
-repeat:
-    /* process document */
+    if (!elem->content) {
+        /* not an EmptyElemTag, parse the content and the end tag */
+        if (lyxml_parse_elem_finish(ctx, c, &size, elem, data, options)) {
+            lyxml_free(ctx, elem);
+            *len = 0;
+            return NULL;
+        }
+        c += size;
+    }
+
+    *len = c - data;
+    return elem;
+}
+
+/* logs directly */
+int
+lyxml_parse_misc(struct ly_ctx *ctx, const char *data, unsigned int *len)
+{
+    const char *c = data;
+    unsigned int size;
+
+    *len = 0;
     while (1) {
         if (!*c) {
             /* eof */
-            return first;
+            *len = c - data;
+            return 1;
         } else if (is_xmlws(*c)) {
             /* skip whitespaces */
             ign_xmlws(c);
         } else if (!strncmp(c, "<?", 2)) {
             /* XMLDecl or PI - ignore it */
             c += 2;
-            if (parse_ignore(ctx, c, "?>", &len)) {
-                goto error;
+            if (parse_ignore(ctx, c, "?>", &size)) {
+                return -1;
             }
-            c += len;
+            c += size;
         } else if (!strncmp(c, "<!--", 4)) {
             /* Comment - ignore it */
             c += 2;
-            if (parse_ignore(ctx, c, "-->", &len)) {
-                goto error;
+            if (parse_ignore(ctx, c, "-->", &size)) {
+                return -1;
             }
-            c += len;
+            c += size;
         } else if (!strncmp(c, "<!", 2)) {
             /* DOCTYPE */
             /* TODO - standalone ignore counting < and > */
             LOGERR(ctx, LY_EINVAL, "DOCTYPE not supported in XML documents.");
-            goto error;
+            return -1;
         } else if (*c == '<') {
-            /* element - process it in next loop to strictly follow XML
-             * format
-             */
-            break;
+            /* element */
+            *len = c - data;
+            return 0;
         } else {
             LOGVAL(ctx, LYE_XML_INCHAR, LY_VLOG_NONE, NULL, c);
-            goto error;
+            return -1;
         }
     }
+}
+
+/* logs directly */
+API struct lyxml_elem *
+lyxml_parse_mem(struct ly_ctx *ctx, const char *data, int options)
+{
+    const char *c = data;
+    unsigned int len;
+    struct lyxml_elem *root, *first = NULL, *next;
+
+    if (!ctx) {
+        LOGARG;
+        return NULL;
+    }
+
+repeat:
+    /* process document */
+    switch (lyxml_parse_misc(ctx, c, &len)) {
+    case 1:
+        /* eof */
+        return first;
+    case 0:
+        /* element - process it */
+        c += len;
+        break;
+    default:
+        goto error;
+    }
 
     root = lyxml_parse_elem(ctx, c, &len, NULL, options);
     if (!root) {
@@ -1255,42 +1553,67 @@ error:
     return NULL;
 }
 
-int
-lyxml_dump_text(struct lyout *out, const char *text, LYXML_DATA_TYPE type)
+static int
+lyxml_dump_text_(struct lyout *out, const char *text, LYXML_DATA_TYPE type, int ref)
 {
     unsigned int i, n;
+    size_t len;
 
     if (!text) {
         return 0;
     }
 
-    for (i = n = 0; text[i]; i++) {
+    for (i = n = 0; text[i]; ) {
+        /* print the longest run of characters without escaping at once */
+        len = strcspn(&text[i], (type == LYXML_DATA_ATTR) ? "&<>\"" : "&<>");
+        if (len) {
+            if (ref) {
+                ly_write_ref(out, &text[i], len);
+            } else {
+                ly_write(out, &text[i], len);
+            }
+            n += len;
+            i += len;
+            continue;
+        }
+
         switch (text[i]) {
         case '&':
-            n += ly_print(out, "&amp;");
+            ly_write(out, "&amp;", 5);
+            n += 5;
             break;
         case '<':
-            n += ly_print(out, "&lt;");
+            ly_write(out, "&lt;", 4);
+            n += 4;
             break;
         case '>':
             /* not needed, just for readability */
-            n += ly_print(out, "&gt;");
+            ly_write(out, "&gt;", 4);
+            n += 4;
             break;
         case '"':
-            if (type == LYXML_DATA_ATTR) {
-                n += ly_print(out, "&quot;");
-                break;
-            }
-            /* falls through */
-        default:
-            ly_write(out, &text[i], 1);
-            n++;
+            ly_write(out, "&quot;", 6);
+            n += 6;
+            break;
         }
+        ++i;
     }
 
     return n;
 }
 
+int
+lyxml_dump_text(struct lyout *out, const char *text, LYXML_DATA_TYPE type)
+{
+    return lyxml_dump_text_(out, text, type, 0);
+}
+
+int
+lyxml_dump_value(struct lyout *out, const char *text, LYXML_DATA_TYPE type)
+{
+    return lyxml_dump_text_(out, text, type, 1);
+}
+
 static int
 dump_elem(struct lyout *out, const struct lyxml_elem *e, int level, int options, int last_elem)
 {
@@ -1446,6 +1769,7 @@ API int
 lyxml_print_fd(int fd, const struct lyxml_elem *elem, int options)
 {
     struct lyout out;
+    int r;
 
     if (fd < 0 || !elem) {
         return 0;
@@ -1457,10 +1781,13 @@ lyxml_print_fd(int fd, const struct lyxml_elem *elem, int options)
     out.method.fd = fd;
 
     if (options & LYXML_PRINT_SIBLINGS) {
-        return dump_siblings(&out, elem, options);
+        r = dump_siblings(&out, elem, options);
     } else {
-        return dump_elem(&out, elem, 0, options, 1);
+        r = dump_elem(&out, elem, 0, options, 1);
     }
+
+    ly_print_clean(&out);
+    return r;
 }
 
 API int
@@ -1491,6 +1818,7 @@ API int
 lyxml_print_clb(ssize_t (*writeclb)(void *arg, const void *buf, size_t count), void *arg, const struct lyxml_elem *elem, int options)
 {
     struct lyout out;
+    int r;
 
     if (!writeclb || !elem) {
         return 0;
@@ -1503,8 +1831,11 @@ lyxml_print_clb(ssize_t (*writeclb)(void *arg, const void *buf, size_t count), v
     out.method.clb.arg = arg;
 
     if (options & LYXML_PRINT_SIBLINGS) {
-        return dump_siblings(&out, elem, options);
+        r = dump_siblings(&out, elem, options);
     } else {
-        return dump_elem(&out, elem, 0, options, 1);
+        r = dump_elem(&out, elem, 0, options, 1);
     }
+
+    ly_print_clean(&out);
+    return r;
 }
@@ -127,6 +127,119 @@ void lyxml_unlink_elem(struct ly_ctx *ctx, struct lyxml_elem *elem, int copy_ns)
  */
 int lyxml_getutf8(struct ly_ctx *ctx, const char *buf, unsigned int *read);
 
+/**
+ * @brief Get the namespace definition of a prefix given by its length, see lyxml_get_ns().
+ *
+ * @param[in] elem Element where start namespace searching
+ * @param[in] prefix Prefix of the namespace to search for, NULL for the default namespace
+ * @param[in] prefix_len Length of \p prefix.
+ * @return Namespace defintion or NULL if no such namespace exists
+ */
+const struct lyxml_ns *lyxml_get_ns_len(const struct lyxml_elem *elem, const char *prefix, size_t prefix_len);
+
+/*
+ * Functions
+ * Incremental parser
+ */
+
+/**
+ * @brief Parse a whole XML element subtree.
+ *
+ * @param[in] ctx libyang context to use.
+ * @param[in] data Input data starting with the element start tag.
+ * @param[out] len Number of processed bytes in \p data.
+ * @param[in] parent Parent element to add the parsed element to, can be NULL.
+ * @param[in] options Parser options, see @ref xmlreadoptions.
+ * @return Parsed element, NULL on error.
+ */
+struct lyxml_elem *lyxml_parse_elem(struct ly_ctx *ctx, const char *data, unsigned int *len, struct lyxml_elem *parent,
+                                    int options);
+
+/**
+ * @brief Skip everything that can precede or follow a top-level element in an XML document (white spaces,
+ * comments, PIs).
+ *
+ * @param[in] ctx libyang context to use.
+ * @param[in] data Input data.
+ * @param[out] len Number of skipped bytes in \p data.
+ * @return 0 if an element start tag follows, 1 on the end of input, -1 on error.
+ */
+int lyxml_parse_misc(struct ly_ctx *ctx, const char *data, unsigned int *len);
+
+/**
+ * @brief Parse only the start tag of an XML element, its name, attributes and namespace. If the element
+ * was an EmptyElemTag, its content is set to an empty string, otherwise it is NULL and the element content
+ * must be read by lyxml_parse_elem_next() or lyxml_parse_elem_finish().
+ *
+ * @param[in] ctx libyang context to use.
+ * @param[in] data Input data starting with the element start tag.
+ * @param[out] len Number of processed bytes in \p data.
+ * @param[in] parent Parent element to add the parsed element to, can be NULL.
+ * @return Parsed element, NULL on error.
+ */
+struct lyxml_elem *lyxml_parse_elem_start(struct ly_ctx *ctx, const char *data, unsigned int *len,
+                                          struct lyxml_elem *parent);
+
+/**
+ * @brief Read content of an element parsed by lyxml_parse_elem_start() up to the start tag of its next
+ * child element, which is left for the caller. Text content is stored in the element.
+ *
+ * @param[in] ctx libyang context to use.
+ * @param[in] data Input data following the start tag of \p elem or the end of its previous child.
+ * @param[out] len Number of processed bytes in \p data.
+ * @param[in] elem Element being read.
+ * @param[in] stag Start tag of \p elem in the input.
+ * @param[in] options Parser options, see @ref xmlreadoptions.
+ * @return 0 if a child element start tag follows, 1 if the end tag of \p elem was read, -1 on error.
+ */
+int lyxml_parse_elem_next(struct ly_ctx *ctx, const char *data, unsigned int *len, struct lyxml_elem *elem,
+                          const char *stag, int options);
+
+/**
+ * @brief Read the whole remaining content of an element parsed by lyxml_parse_elem_start(), including
+ * all the child subtrees, and its end tag.
+ *
+ * @param[in] ctx libyang context to use.
+ * @param[in] data Input data following the start tag of \p elem or the end of its previous child.
+ * @param[out] len Number of processed bytes in \p data.
+ * @param[in] elem Element being read.
+ * @param[in] stag Start tag of \p elem in the input.
+ * @param[in] options Parser options, see @ref xmlreadoptions.
+ * @return 0 on success, -1 on error.
+ */
+int lyxml_parse_elem_finish(struct ly_ctx *ctx, const char *data, unsigned int *len, struct lyxml_elem *elem,
+                            const char *stag, int options);
+
+/**
+ * @brief Read the whole remaining content of an element parsed by lyxml_parse_elem_start() as a string,
+ * without parsing it. Only the markup is recognized to find the end tag of the element, so the content is not
+ * checked to be well-formed. The namespaces in scope of the element are declared on each of the top-level elements
+ * of the content so that it can be parsed on its own.
+ *
+ * @param[in] ctx libyang context to use.
+ * @param[in] data Input data following the start tag of \p elem.
+ * @param[out] len Number of processed bytes in \p data including the end tag.
+ * @param[in] elem Element being read.
+ * @param[in] stag Start tag of \p elem in the input.
+ * @return Serialized content, NULL on error.
+ */
+char *lyxml_parse_elem_raw(struct ly_ctx *ctx, const char *data, unsigned int *len, struct lyxml_elem *elem,
+                           const char *stag);
+
+/**
+ * @brief Skip the whole remaining content of an element parsed by lyxml_parse_elem_start() including its end tag.
+ * Only the markup is recognized, the same way as by lyxml_parse_elem_raw().
+ *
+ * @param[in] ctx libyang context to use.
+ * @param[in] data Input data following the start tag of \p elem.
+ * @param[out] len Number of skipped bytes in \p data including the end tag.
+ * @param[in] elem Element being skipped.
+ * @param[in] stag Start tag of \p elem in the input.
+ * @return 0 on success, -1 on error.
+ */
+int lyxml_parse_elem_skip(struct ly_ctx *ctx, const char *data, unsigned int *len, struct lyxml_elem *elem,
+                          const char *stag);
+
 /**
  * @brief Types of the XML data
  */
@@ -144,4 +257,12 @@ typedef enum lyxml_data_type {
  */
 int lyxml_dump_text(struct lyout *out, const char *text, LYXML_DATA_TYPE type);
 
+/**
+ * @brief Dump XML text stored in a data tree, the output can reference it instead of copying.
+ * @param[in] out Output structure.
+ * @param[in] text Text to dump, must not be freed until the printing finishes.
+ * @return Number of dumped characters.
+ */
+int lyxml_dump_value(struct lyout *out, const char *text, LYXML_DATA_TYPE type);
+
 #endif /* LY_XML_INTERNAL_H_ */
@@ -26,6 +26,7 @@
 #include <limits.h>
 #include <errno.h>
 #include <math.h>
+#include <pthread.h>
 #include <pcre.h>
 
 #include "xpath.h"
@@ -44,7 +45,9 @@
 static const struct lyd_node *moveto_get_root(const struct lyd_node *cur_node, int options,
                                               enum lyxp_node_type *root_type);
 static int reparse_or_expr(struct ly_ctx *ctx, struct lyxp_expr *exp, uint16_t *exp_idx);
+static int moveto_node_hidden(const struct lyd_node *node);
 static int set_snode_insert_node(struct lyxp_set *set, const struct lys_node *node, enum lyxp_node_type node_type);
+static char *cast_number_to_string(const struct lyxp_set *set);
 static int eval_expr_select(struct lyxp_expr *exp, uint16_t *exp_idx, enum lyxp_expr_type etype, struct lyd_node *cur_node,
                             struct lys_module *local_mod, struct lyxp_set *set, int options);
 
@@ -67,6 +70,12 @@ lyxp_expr_free(struct lyxp_expr *expr)
         }
     }
     free(expr->repeat);
+    if (expr->tok_data) {
+        for (i = 0; i < expr->used; ++i) {
+            lydict_remove(expr->ctx, expr->tok_data[i].name);
+        }
+        free(expr->tok_data);
+    }
     free(expr);
 }
 
@@ -283,23 +292,7 @@ print_set_debug(struct lyxp_set *set)
     case LYXP_SET_NUMBER:
         LOGDBG(LY_LDGXPATH, "set NUMBER");
 
-        if (isnan(set->val.num)) {
-            str_num = strdup("NaN");
-        } else if ((set->val.num == 0) || (set->val.num == -0.0f)) {
-            str_num = strdup("0");
-        } else if (isinf(set->val.num) && !signbit(set->val.num)) {
-            str_num = strdup("Infinity");
-        } else if (isinf(set->val.num) && signbit(set->val.num)) {
-            str_num = strdup("-Infinity");
-        } else if ((long long)set->val.num == set->val.num) {
-            if (asprintf(&str_num, "%lld", (long long)set->val.num) == -1) {
-                str_num = NULL;
-            }
-        } else {
-            if (asprintf(&str_num, "%03.1Lf", set->val.num) == -1) {
-                str_num = NULL;
-            }
-        }
+        str_num = cast_number_to_string(set);
         LY_CHECK_ERR_RETURN(!str_num, LOGMEM(NULL), );
 
         LOGDBG(LY_LDGXPATH, "\t%s", str_num);
@@ -371,6 +364,9 @@ cast_string_recursive(struct lyd_node *node, struct lys_module *local_mod, int f
         ++(*used);
 
         LY_TREE_FOR(node->child, child) {
+            if (moveto_node_hidden(child)) {
+                continue;
+            }
             cast_string_recursive(child, local_mod, 0, root_type, indent + 1, str, used, size);
         }
 
@@ -539,25 +535,181 @@ cast_node_set_to_string(struct lyxp_set *set, struct lyd_node *cur_node, struct
     return NULL;
 }
 
+/**
+ * @brief Parse an integer number that fits into int64_t without any loss.
+ *
+ * Only plain decimal integers of at most 18 digits are accepted, "-0" is not
+ * because it is a negative zero.
+ *
+ * @param[in] str String to parse.
+ * @param[in] len Length of the number in \p str, all of it must be consumed.
+ * @param[out] inum Parsed number.
+ *
+ * @return 1 if parsed, 0 if the number must be parsed as a long double.
+ */
+static int
+cast_string_to_int(const char *str, size_t len, int64_t *inum)
+{
+    uint64_t val = 0;
+    size_t i = 0;
+    int neg = 0;
+
+    if (len && (str[0] == '-')) {
+        neg = 1;
+        ++i;
+    }
+    if ((i == len) || (len - i > 18)) {
+        return 0;
+    }
+    for (; i < len; ++i) {
+        if (!isdigit(str[i])) {
+            return 0;
+        }
+        val = val * 10 + (str[i] - '0');
+    }
+    if (neg && !val) {
+        return 0;
+    }
+
+    *inum = neg ? -(int64_t)val : (int64_t)val;
+    return 1;
+}
+
+/**
+ * @brief Cast a string into an exact decimal number, if possible.
+ *
+ * @param[in] str String to use.
+ * @param[in] len Length of \p str.
+ * @param[out] dec Cast number without the floating point.
+ * @param[out] dig Number of fraction digits of \p dec.
+ *
+ * @return 1 if \p dec was set, 0 if \p str is not a decimal number with at most 18 digits.
+ */
+static int
+cast_string_to_dec(const char *str, size_t len, int64_t *dec, uint8_t *dig)
+{
+    uint64_t val = 0;
+    size_t i = 0;
+    int neg = 0, digits = 0, frac = -1;
+
+    if (len && (str[0] == '-')) {
+        neg = 1;
+        ++i;
+    }
+    for (; i < len; ++i) {
+        if ((str[i] == '.') && (frac == -1)) {
+            frac = 0;
+            continue;
+        } else if (!isdigit(str[i]) || (++digits > 18)) {
+            return 0;
+        }
+        val = val * 10 + (str[i] - '0');
+        if (frac > -1) {
+            ++frac;
+        }
+    }
+    if (frac < 1) {
+        /* integers are not decimals */
+        return 0;
+    }
+
+    *dec = neg ? -(int64_t)val : (int64_t)val;
+    *dig = frac;
+    return 1;
+}
+
+/**
+ * @brief Check whether adding two integers would overflow.
+ *
+ * @param[in] a First operand.
+ * @param[in] b Second operand.
+ *
+ * @return 1 on overflow, 0 otherwise.
+ */
+static int
+int_add_overflow(int64_t a, int64_t b)
+{
+    return (b > 0) ? (a > INT64_MAX - b) : (a < INT64_MIN - b);
+}
+
 /**
  * @brief Cast a string into an XPath number.
  *
  * @param[in] str String to use.
+ * @param[out] inum Cast number if it is an integer.
+ * @param[out] num Cast number otherwise.
+ * @param[out] dec Exact \p num without the floating point, if it is a decimal.
+ * @param[out] dig Number of fraction digits of \p dec, 0 if \p num is not a decimal.
  *
- * @return Cast number.
+ * @return 1 if \p inum was set, 0 if \p num was set.
  */
-static long double
-cast_string_to_number(const char *str)
+static int
+cast_string_to_number(const char *str, int64_t *inum, long double *num, int64_t *dec, uint8_t *dig)
 {
-    long double num;
     char *ptr;
 
+    if (cast_string_to_int(str, strlen(str), inum)) {
+        *dig = 0;
+        return 1;
+    }
+
+    if (!cast_string_to_dec(str, strlen(str), dec, dig)) {
+        *dig = 0;
+    }
     errno = 0;
-    num = strtold(str, &ptr);
+    *num = strtold(str, &ptr);
     if (errno || *ptr) {
-        num = NAN;
+        *num = NAN;
+    }
+    return 0;
+}
+
+/**
+ * @brief Cast an XPath number into a string.
+ *
+ * @param[in] set Number set to cast.
+ *
+ * @return Cast number, NULL on memory allocation failure.
+ */
+static char *
+cast_number_to_string(const struct lyxp_set *set)
+{
+    char buf[21], *ptr, *str;
+    uint64_t val;
+
+    if (set->num_int) {
+        /* no need for the generic formatting */
+        val = (set->val.inum < 0) ? -(uint64_t)set->val.inum : (uint64_t)set->val.inum;
+        ptr = &buf[20];
+        *ptr = '\0';
+        do {
+            *--ptr = '0' + val % 10;
+            val /= 10;
+        } while (val);
+        if (set->val.inum < 0) {
+            *--ptr = '-';
+        }
+        return strdup(ptr);
+    }
+
+    if (isnan(set->val.num)) {
+        str = strdup("NaN");
+    } else if ((set->val.num == 0) || (set->val.num == -0.0f)) {
+        str = strdup("0");
+    } else if (isinf(set->val.num) && !signbit(set->val.num)) {
+        str = strdup("Infinity");
+    } else if (isinf(set->val.num) && signbit(set->val.num)) {
+        str = strdup("-Infinity");
+    } else if ((long long)set->val.num == set->val.num) {
+        if (asprintf(&str, "%lld", (long long)set->val.num) == -1) {
+            str = NULL;
+        }
+    } else {
+        if (asprintf(&str, "%03.1Lf", set->val.num) == -1) {
+            str = NULL;
+        }
     }
-    return num;
+    return str;
 }
 
 /*
@@ -678,6 +830,175 @@ set_dup_node_hash_check(const struct lyxp_set *set, struct lyd_node *node, enum
 
 #endif
 
+/* data nodes checked by the node tests of the thread, added to the statistics after an evaluation */
+static THREAD_LOCAL uint64_t lyxp_visits;
+
+/*
+ * Most of the sets created during an evaluation are temporary and hold only a few nodes, so the set structures
+ * and the node arrays of the initial size freed during an evaluation are kept for reuse until the top-level
+ * evaluation finishes. They are still allocated by malloc() so the sets escaping the evaluation can be freed normally.
+ */
+#define LYXP_POOL_SIZE 64
+
+static THREAD_LOCAL struct {
+    uint32_t depth;                               /* nested evaluations, the pool is used only during one */
+    uint16_t nodes_count;
+    uint16_t sets_count;
+    struct lyxp_set_node *nodes[LYXP_POOL_SIZE];  /* arrays of LYXP_SET_SIZE_START nodes */
+    struct lyxp_set *sets[LYXP_POOL_SIZE];
+} lyxp_pool;
+
+static void
+pool_enter(void)
+{
+    ++lyxp_pool.depth;
+}
+
+static void
+pool_leave(void)
+{
+    if (--lyxp_pool.depth) {
+        return;
+    }
+
+    while (lyxp_pool.nodes_count) {
+        free(lyxp_pool.nodes[--lyxp_pool.nodes_count]);
+    }
+    while (lyxp_pool.sets_count) {
+        free(lyxp_pool.sets[--lyxp_pool.sets_count]);
+    }
+}
+
+/*
+ * Instances of schema-only nodes (uses, choice, case, augment) hidden from a when evaluation (RFC 7950 section 7.21.5),
+ * they are skipped instead of being unlinked from the data tree, see lyxp_eval_expr_hide().
+ */
+static THREAD_LOCAL struct {
+    const struct lys_node *snode;   /* schema-only node whose data instances are hidden */
+    const struct lyd_node *parent;  /* data parent of the hidden instances, NULL for top-level nodes */
+} lyxp_hide;
+
+/*
+ * Absolute location paths evaluated in predicates select the same nodes for every node the predicate is evaluated for,
+ * so their results are remembered until the top-level evaluation finishes, see eval_absolute_location_path_cached().
+ */
+#define LYXP_ABS_CACHE_SIZE 8
+
+struct lyxp_abs_cache {
+    uint16_t count;
+    struct {
+        const struct lyxp_expr *exp;
+        uint16_t start;             /* first token of the path */
+        uint16_t end;               /* token following the path */
+        int options;
+        struct lyxp_set set;
+    } paths[LYXP_ABS_CACHE_SIZE];
+};
+
+static THREAD_LOCAL struct {
+    uint32_t pred_depth;            /* number of predicates being evaluated on data nodes */
+    struct lyxp_abs_cache *cache;   /* cache of the current top-level evaluation */
+} lyxp_abs;
+
+/*
+ * Relative paths of the when and must expressions are often the same for many nodes (siblings, list instances),
+ * so while validation resolves the data constraints, the selected nodes of a path are remembered for the node
+ * the path starts from, see lyxp_memo_set() and eval_path_expr_memo().
+ */
+#define LYXP_MEMO_MAX_PATHS 16384
+
+struct lyxp_memo {
+    struct hash_table *paths;       /* struct lyxp_memo_path *, created on the first path */
+    struct lyxp_memo_path *first;   /* all the paths to be freed */
+};
+
+struct lyxp_memo_path {
+    struct lyxp_memo_path *next;
+    const char *expr;               /* path text, not terminated */
+    uint16_t expr_len;
+    const struct lyd_node *node;    /* node the path starts from */
+    const struct lyd_node *cur_node; /* original context node if the path refers to it by current() */
+    const struct lyd_node *dummy;   /* dummy (LYD_VAL_INUSE) original context node the path may reach */
+    const struct lys_node *hide_snode;
+    const struct lyd_node *hide_parent;
+    const struct lys_module *local_mod;
+    int options;                    /* evaluation options without LYXP_EXISTS */
+    int root_config;                /* whether the root is LYXP_NODE_ROOT_CONFIG */
+    struct lyxp_set set;            /* selected nodes */
+};
+
+static THREAD_LOCAL struct lyxp_memo *lyxp_memo;
+
+/**
+ * @brief Check whether a data node is hidden from the current evaluation.
+ *
+ * @param[in] node Data node to check.
+ * @return 1 if hidden, 0 otherwise.
+ */
+static int
+moveto_node_hidden(const struct lyd_node *node)
+{
+    const struct lys_node *sparent;
+
+    if (!lyxp_hide.snode || (node->parent != lyxp_hide.parent)) {
+        return 0;
+    }
+
+    for (sparent = node->schema; sparent; ) {
+        if (sparent->parent == lyxp_hide.snode) {
+            /* also the augment the node comes from */
+            return 1;
+        }
+        sparent = lys_parent(sparent);
+        if (!sparent || !(sparent->nodetype & (LYS_USES | LYS_CHOICE | LYS_CASE))) {
+            break;
+        }
+        if (sparent == lyxp_hide.snode) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static struct lyxp_set_node *
+pool_nodes_get(void)
+{
+    if (lyxp_pool.nodes_count) {
+        return lyxp_pool.nodes[--lyxp_pool.nodes_count];
+    }
+    return malloc(LYXP_SET_SIZE_START * sizeof(struct lyxp_set_node));
+}
+
+static void
+pool_nodes_put(struct lyxp_set_node *nodes, uint32_t size)
+{
+    if (nodes && lyxp_pool.depth && (size == LYXP_SET_SIZE_START) && (lyxp_pool.nodes_count < LYXP_POOL_SIZE)) {
+        lyxp_pool.nodes[lyxp_pool.nodes_count++] = nodes;
+    } else {
+        free(nodes);
+    }
+}
+
+static struct lyxp_set *
+pool_set_get(void)
+{
+    if (lyxp_pool.sets_count) {
+        return lyxp_pool.sets[--lyxp_pool.sets_count];
+    }
+    return malloc(sizeof(struct lyxp_set));
+}
+
+static void
+pool_set_put(struct lyxp_set *set)
+{
+    if (lyxp_pool.depth && (lyxp_pool.sets_count < LYXP_POOL_SIZE)) {
+        lyxp_pool.sets[lyxp_pool.sets_count++] = set;
+    } else {
+        free(set);
+    }
+}
+
 static void
 set_free_content(struct lyxp_set *set)
 {
@@ -686,7 +1007,7 @@ set_free_content(struct lyxp_set *set)
     }
 
     if (set->type == LYXP_SET_NODE_SET) {
-        free(set->val.nodes);
+        pool_nodes_put(set->val.nodes, set->size);
 #ifdef LY_ENABLED_CACHE
         lyht_free(set->ht);
         set->ht = NULL;
@@ -697,6 +1018,7 @@ set_free_content(struct lyxp_set *set)
         free(set->val.str);
     }
     set->type = LYXP_SET_EMPTY;
+    set->unordered = 0;
 }
 
 void
@@ -707,7 +1029,7 @@ lyxp_set_free(struct lyxp_set *set)
     }
 
     set_free_content(set);
-    free(set);
+    pool_set_put(set);
 }
 
 /**
@@ -727,7 +1049,7 @@ set_copy(struct lyxp_set *set)
         return NULL;
     }
 
-    ret = malloc(sizeof *ret);
+    ret = pool_set_get();
     LY_CHECK_ERR_RETURN(!ret, LOGMEM(NULL), NULL);
 
     if (set->type == LYXP_SET_SNODE_SET) {
@@ -744,13 +1066,18 @@ set_copy(struct lyxp_set *set)
         }
     } else if (set->type == LYXP_SET_NODE_SET) {
         ret->type = set->type;
-        ret->val.nodes = malloc(set->used * sizeof *ret->val.nodes);
-        LY_CHECK_ERR_RETURN(!ret->val.nodes, LOGMEM(NULL); free(ret), NULL);
+        if (set->used == LYXP_SET_SIZE_START) {
+            ret->val.nodes = pool_nodes_get();
+        } else {
+            ret->val.nodes = malloc(set->used * sizeof *ret->val.nodes);
+        }
+        LY_CHECK_ERR_RETURN(!ret->val.nodes, LOGMEM(NULL); pool_set_put(ret), NULL);
         memcpy(ret->val.nodes, set->val.nodes, set->used * sizeof *ret->val.nodes);
 
         ret->used = ret->size = set->used;
         ret->ctx_pos = set->ctx_pos;
         ret->ctx_size = set->ctx_size;
+        ret->unordered = set->unordered;
 
 #ifdef LY_ENABLED_CACHE
         ret->ht = lyht_dup(set->ht);
@@ -759,7 +1086,7 @@ set_copy(struct lyxp_set *set)
        memcpy(ret, set, sizeof *ret);
        if (set->type == LYXP_SET_STRING) {
            ret->val.str = strdup(set->val.str);
-           LY_CHECK_ERR_RETURN(!ret->val.str, LOGMEM(NULL); free(ret), NULL);
+           LY_CHECK_ERR_RETURN(!ret->val.str, LOGMEM(NULL); pool_set_put(ret), NULL);
        }
     }
 
@@ -799,6 +1126,112 @@ set_fill_number(struct lyxp_set *set, long double number)
 
     set->type = LYXP_SET_NUMBER;
     set->val.num = number;
+    set->num_int = 0;
+    set->num_dig = 0;
+}
+
+/**
+ * @brief Fill XPath set with an integer number. Any current data are disposed of.
+ *
+ * @param[in] set Set to fill.
+ * @param[in] number Number to fill into \p set.
+ */
+static void
+set_fill_int(struct lyxp_set *set, int64_t number)
+{
+    set_free_content(set);
+
+    set->type = LYXP_SET_NUMBER;
+    set->val.inum = number;
+    set->num_int = 1;
+    set->num_dig = 0;
+}
+
+/**
+ * @brief Store an integer number in \p set as a long double.
+ *
+ * @param[in] set Number set to modify.
+ */
+static void
+set_num_widen(struct lyxp_set *set)
+{
+    assert(set->type == LYXP_SET_NUMBER);
+
+    if (set->num_int) {
+        set->val.num = set->val.inum;
+        set->num_int = 0;
+        set->num_dig = 0;
+    }
+}
+
+/**
+ * @brief Scale a decimal number to more fraction digits.
+ *
+ * @param[in,out] num Number without the floating point.
+ * @param[in] dig Number of fraction digits of \p num.
+ * @param[in] to Number of fraction digits to scale \p num to.
+ *
+ * @return 0 on success, 1 on overflow.
+ */
+static int
+num_dec_scale(int64_t *num, uint8_t dig, uint8_t to)
+{
+    int64_t pow;
+
+    if (dig >= to) {
+        return 0;
+    }
+
+    pow = dec_pow(to - dig);
+    if ((*num > INT64_MAX / pow) || (*num < INT64_MIN / pow)) {
+        return 1;
+    }
+    *num *= pow;
+    return 0;
+}
+
+/**
+ * @brief Compare 2 XPath numbers exactly, if they are integers or decimals.
+ *
+ * @param[in] set1 First number set.
+ * @param[in] set2 Second number set.
+ * @param[out] order Negative, 0, or positive if \p set1 is smaller, equal, or greater than \p set2.
+ *
+ * @return 0 on success, 1 if the numbers must be compared as long doubles.
+ */
+static int
+set_num_exact_cmp(const struct lyxp_set *set1, const struct lyxp_set *set2, int *order)
+{
+    int64_t num1, num2;
+    uint8_t dig1, dig2;
+
+    assert((set1->type == LYXP_SET_NUMBER) && (set2->type == LYXP_SET_NUMBER));
+
+    if (!set1->num_int && !set1->num_dig) {
+        return 1;
+    } else if (!set2->num_int && !set2->num_dig) {
+        return 1;
+    }
+    num1 = set1->num_int ? set1->val.inum : set1->num_dec;
+    dig1 = set1->num_int ? 0 : set1->num_dig;
+    num2 = set2->num_int ? set2->val.inum : set2->num_dec;
+    dig2 = set2->num_int ? 0 : set2->num_dig;
+
+    /* scale the number with less fraction digits */
+    if (num_dec_scale(&num1, dig1, dig2) || num_dec_scale(&num2, dig2, dig1)) {
+        return 1;
+    }
+
+    *order = (num1 > num2) - (num1 < num2);
+    return 0;
+}
+
+long double
+lyxp_set_num(const struct lyxp_set *set)
+{
+    assert(set->type == LYXP_SET_NUMBER);
+
+    return set->num_int ? (long double)set->val.inum : set->val.num;
 }
 
 /**
@@ -841,12 +1274,18 @@ set_fill_set(struct lyxp_set *trg, struct lyxp_set *src)
     } else if (src->type == LYXP_SET_BOOLEAN) {
         set_fill_boolean(trg, src->val.bool);
     } else if (src->type ==  LYXP_SET_NUMBER) {
-        set_fill_number(trg, src->val.num);
+        if (src->num_int) {
+            set_fill_int(trg, src->val.inum);
+        } else {
+            set_fill_number(trg, src->val.num);
+            trg->num_dig = src->num_dig;
+            trg->num_dec = src->num_dec;
+        }
     } else if (src->type == LYXP_SET_STRING) {
         set_fill_string(trg, src->val.str, strlen(src->val.str));
     } else {
         if (trg->type == LYXP_SET_NODE_SET) {
-            free(trg->val.nodes);
+            pool_nodes_put(trg->val.nodes, trg->size);
         } else if (trg->type == LYXP_SET_STRING) {
             free(trg->val.str);
         }
@@ -861,8 +1300,13 @@ set_fill_set(struct lyxp_set *trg, struct lyxp_set *src)
             trg->size = src->used;
             trg->ctx_pos = src->ctx_pos;
             trg->ctx_size = src->ctx_size;
+            trg->unordered = src->unordered;
 
-            trg->val.nodes = malloc(trg->used * sizeof *trg->val.nodes);
+            if (trg->used == LYXP_SET_SIZE_START) {
+                trg->val.nodes = pool_nodes_get();
+            } else {
+                trg->val.nodes = malloc(trg->used * sizeof *trg->val.nodes);
+            }
             LY_CHECK_ERR_RETURN(!trg->val.nodes, LOGMEM(NULL); memset(trg, 0, sizeof *trg), );
             memcpy(trg->val.nodes, src->val.nodes, src->used * sizeof *src->val.nodes);
 #ifdef LY_ENABLED_CACHE
@@ -1030,13 +1474,14 @@ set_insert_node(struct lyxp_set *set, const struct lyd_node *node, uint32_t pos,
             LOGINT(NULL);
             idx = 0;
         }
-        set->val.nodes = malloc(LYXP_SET_SIZE_START * sizeof *set->val.nodes);
+        set->val.nodes = pool_nodes_get();
         LY_CHECK_ERR_RETURN(!set->val.nodes, LOGMEM(NULL), );
         set->type = LYXP_SET_NODE_SET;
         set->used = 0;
         set->size = LYXP_SET_SIZE_START;
         set->ctx_pos = 1;
         set->ctx_size = 1;
+        set->unordered = 0;
 #ifdef LY_ENABLED_CACHE
         set->ht = NULL;
 #endif
@@ -1434,6 +1879,78 @@ set_comp_cast(struct lyxp_set *trg, struct lyxp_set *src, enum lyxp_set_type typ
     return EXIT_SUCCESS;
 }
 
+/**
+ * @brief Sort an unordered \p set into XPath document order. Sets that are not marked
+ *        unordered are left untouched. Only the missing node positions are computed.
+ *
+ * @param[in] set Set to sort.
+ * @param[in] cur_node Original context node.
+ * @param[in] options Whether to apply data node access restrictions defined for 'when' and 'must' evaluation.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int
+set_order(struct lyxp_set *set, const struct lyd_node *cur_node, int options)
+{
+    uint32_t width, start, mid, end, i, j, k;
+    const struct lyd_node *root;
+    enum lyxp_node_type root_type;
+    struct lyxp_set_node *buf, *src, *dst, *tmp;
+
+    if ((set->type != LYXP_SET_NODE_SET) || !set->unordered) {
+        return 0;
+    }
+    set->unordered = 0;
+
+    if (set->used < 2) {
+        return 0;
+    }
+
+    /* get root */
+    root = moveto_get_root(cur_node, options, &root_type);
+
+    /* fill positions */
+    if (set_assign_pos(set, root, root_type)) {
+        return -1;
+    }
+
+    buf = malloc(set->used * sizeof *buf);
+    LY_CHECK_ERR_RETURN(!buf, LOGMEM(cur_node->schema->module->ctx), -1);
+
+    /* bottom-up merge sort, there are no duplicates so it does not matter that it is stable */
+    src = set->val.nodes;
+    dst = buf;
+    for (width = 1; width < set->used; width *= 2) {
+        for (start = 0; start < set->used; start += 2 * width) {
+            mid = (start + width < set->used) ? start + width : set->used;
+            end = (mid + width < set->used) ? mid + width : set->used;
+
+            i = start;
+            j = mid;
+            for (k = start; k < end; ++k) {
+                if ((i < mid) && ((j == end) || (set_sort_compare(&src[i], &src[j], root) <= 0))) {
+                    dst[k] = src[i++];
+                } else {
+                    dst[k] = src[j++];
+                }
+            }
+        }
+
+        tmp = src;
+        src = dst;
+        dst = tmp;
+    }
+
+    /* the sorted nodes can be in the temporary buffer */
+    if (src != set->val.nodes) {
+        memcpy(set->val.nodes, src, set->used * sizeof *src);
+    }
+    free(buf);
+
+    /* the hash table stores only the nodes, so it is still valid */
+    return 0;
+}
+
 #ifndef NDEBUG
 
 /**
@@ -1559,6 +2076,28 @@ set_sorted_dup_node_clean(struct lyxp_set *set)
 
 #endif
 
+/**
+ * @brief Check whether the positions of all the nodes in \p set are already known.
+ *
+ * @param[in] set Set to check.
+ *
+ * @return 1 if all the positions are filled, 0 otherwise.
+ */
+static int
+set_pos_known(const struct lyxp_set *set)
+{
+    uint32_t i;
+
+    for (i = 0; i < set->used; ++i) {
+        if (!set->val.nodes[i].pos && (set->val.nodes[i].type != LYXP_NODE_ROOT)
+                && (set->val.nodes[i].type != LYXP_NODE_ROOT_CONFIG)) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
 /**
  * @brief Merge 2 sorted sets into one.
  *
@@ -3118,7 +3657,7 @@ xpath_bit_is_set(struct lyxp_set **args, uint16_t UNUSED(arg_count), struct lyd_
 {
     struct lyd_node_leaf_list *leaf;
     struct lys_node_leaf *sleaf;
-    int i, bits_count, ret = EXIT_SUCCESS;
+    int ret = EXIT_SUCCESS;
 
     if (options & LYXP_SNODE_ALL) {
         if ((args[0]->type != LYXP_SET_SNODE_SET) || !(sleaf = (struct lys_node_leaf *)warn_get_snode_in_ctx(args[0]))) {
@@ -3157,14 +3696,9 @@ xpath_bit_is_set(struct lyxp_set **args, uint16_t UNUSED(arg_count), struct lyd_
     if (args[0]->type == LYXP_SET_NODE_SET) {
         leaf = (struct lyd_node_leaf_list *)args[0]->val.nodes[0].node;
         if ((leaf->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST))
-                && (((struct lys_node_leaf *)leaf->schema)->type.base == LY_TYPE_BITS)) {
-            bits_count = ((struct lys_node_leaf *)leaf->schema)->type.info.bits.count;
-            for (i = 0; i < bits_count; ++i) {
-                if (leaf->value.bit[i] && ly_strequal(leaf->value.bit[i]->name, args[1]->val.str, 0)) {
-                    set_fill_boolean(set, 1);
-                    break;
-                }
-            }
+                && (((struct lys_node_leaf *)leaf->schema)->type.base == LY_TYPE_BITS)
+                && (lyd_bit_is_set((struct lyd_node *)leaf, args[1]->val.str) == 1)) {
+            set_fill_boolean(set, 1);
         }
     }
 
@@ -3235,7 +3769,9 @@ xpath_ceiling(struct lyxp_set **args, uint16_t UNUSED(arg_count), struct lyd_nod
     if (lyxp_set_cast(args[0], LYXP_SET_NUMBER, cur_node, local_mod, options)) {
         return -1;
     }
-    if ((long long)args[0]->val.num != args[0]->val.num) {
+    if (args[0]->num_int) {
+        set_fill_int(set, args[0]->val.inum);
+    } else if ((long long)args[0]->val.num != args[0]->val.num) {
         set_fill_number(set, ((long long)args[0]->val.num) + 1);
     } else {
         set_fill_number(set, args[0]->val.num);
@@ -3392,7 +3928,7 @@ xpath_count(struct lyxp_set **args, uint16_t UNUSED(arg_count), struct lyd_node
     }
 
     if (args[0]->type == LYXP_SET_EMPTY) {
-        set_fill_number(set, 0);
+        set_fill_int(set, 0);
         return EXIT_SUCCESS;
     }
 
@@ -3401,7 +3937,7 @@ xpath_count(struct lyxp_set **args, uint16_t UNUSED(arg_count), struct lyd_node
         return -1;
     }
 
-    set_fill_number(set, args[0]->used);
+    set_fill_int(set, args[0]->used);
     return EXIT_SUCCESS;
 }
 
@@ -3531,6 +4067,51 @@ xpath_derived_from_ident_cmp(struct lys_ident *ident, const char *ident_str)
     return 0;
 }
 
+/* resolve the identity in the second argument of derived-from(), NULL if it cannot be resolved using the hash table */
+static struct lys_ident *
+xpath_derived_from_base(struct lys_module *local_mod, const char *ident_str)
+{
+    const struct lys_module *mod;
+    struct lys_ident *base;
+    const char *ptr;
+
+    ptr = strchr(ident_str, ':');
+    if (ptr) {
+        mod = ly_ctx_nget_module(local_mod->ctx, ident_str, ptr - ident_str, NULL, 1);
+        if (!mod) {
+            mod = ly_ctx_nget_module(local_mod->ctx, ident_str, ptr - ident_str, NULL, 0);
+        }
+        ++ptr;
+    } else {
+        mod = local_mod;
+        ptr = ident_str;
+    }
+
+    if (!mod || lys_find_ident_name_hash(local_mod->ctx, mod, ptr, strlen(ptr), &base)) {
+        return NULL;
+    }
+    return base;
+}
+
+/* return 1 if ident is derived from base, directly or not */
+static int
+xpath_derived_from_check(struct ly_ctx *ctx, struct lys_ident *ident, struct lys_ident *base)
+{
+    uint8_t i;
+    int derived;
+
+    if (!lys_ident_derived_hash(ctx, ident, base, &derived)) {
+        return derived;
+    }
+
+    for (i = 0; i < ident->base_size; ++i) {
+        if ((ident->base[i] == base) || xpath_derived_from_check(ctx, ident->base[i], base)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
 /**
  * @brief Execute the YANG 1.1 derived-from(node-set, string) function. Returns LYXP_SET_BOOLEAN depending
  *        on whether the first argument nodes contain a node of an identity derived from the second
@@ -3551,6 +4132,7 @@ xpath_derived_from(struct lyxp_set **args, uint16_t UNUSED(arg_count), struct ly
     uint16_t i, j;
     struct lyd_node_leaf_list *leaf;
     struct lys_node_leaf *sleaf;
+    struct lys_ident *base;
     int ret = EXIT_SUCCESS;
 
     if (options & LYXP_SNODE_ALL) {
@@ -3587,7 +4169,18 @@ xpath_derived_from(struct lyxp_set **args, uint16_t UNUSED(arg_count), struct ly
     }
 
     set_fill_boolean(set, 0);
-    if (args[0]->type != LYXP_SET_EMPTY) {
+    if ((args[0]->type != LYXP_SET_EMPTY) && (base = xpath_derived_from_base(local_mod, args[1]->val.str))) {
+        /* the identity exists, compare the identities themselves */
+        for (i = 0; i < args[0]->used; ++i) {
+            leaf = (struct lyd_node_leaf_list *)args[0]->val.nodes[i].node;
+            sleaf = (struct lys_node_leaf *)leaf->schema;
+            if ((sleaf->nodetype & (LYS_LEAF | LYS_LEAFLIST)) && (sleaf->type.base == LY_TYPE_IDENT)
+                    && (leaf->value.ident != base) && xpath_derived_from_check(local_mod->ctx, leaf->value.ident, base)) {
+                set_fill_boolean(set, 1);
+                break;
+            }
+        }
+    } else if (args[0]->type != LYXP_SET_EMPTY) {
         for (i = 0; i < args[0]->used; ++i) {
             leaf = (struct lyd_node_leaf_list *)args[0]->val.nodes[i].node;
             sleaf = (struct lys_node_leaf *)leaf->schema;
@@ -3629,6 +4222,7 @@ xpath_derived_from_or_self(struct lyxp_set **args, uint16_t UNUSED(arg_count), s
     uint16_t i, j;
     struct lyd_node_leaf_list *leaf;
     struct lys_node_leaf *sleaf;
+    struct lys_ident *base;
     int ret = EXIT_SUCCESS;
 
     if (options & LYXP_SNODE_ALL) {
@@ -3665,7 +4259,18 @@ xpath_derived_from_or_self(struct lyxp_set **args, uint16_t UNUSED(arg_count), s
     }
 
     set_fill_boolean(set, 0);
-    if (args[0]->type != LYXP_SET_EMPTY) {
+    if ((args[0]->type != LYXP_SET_EMPTY) && (base = xpath_derived_from_base(local_mod, args[1]->val.str))) {
+        /* the identity exists, compare the identities themselves */
+        for (i = 0; i < args[0]->used; ++i) {
+            leaf = (struct lyd_node_leaf_list *)args[0]->val.nodes[i].node;
+            sleaf = (struct lys_node_leaf *)leaf->schema;
+            if ((sleaf->nodetype & (LYS_LEAF | LYS_LEAFLIST)) && (sleaf->type.base == LY_TYPE_IDENT)
+                    && ((leaf->value.ident == base) || xpath_derived_from_check(local_mod->ctx, leaf->value.ident, base))) {
+                set_fill_boolean(set, 1);
+                break;
+            }
+        }
+    } else if (args[0]->type != LYXP_SET_EMPTY) {
         for (i = 0; i < args[0]->used; ++i) {
             leaf = (struct lyd_node_leaf_list *)args[0]->val.nodes[i].node;
             sleaf = (struct lys_node_leaf *)leaf->schema;
@@ -3737,7 +4342,7 @@ xpath_enum_value(struct lyxp_set **args, uint16_t UNUSED(arg_count), struct lyd_
         leaf = (struct lyd_node_leaf_list *)args[0]->val.nodes[0].node;
         if ((leaf->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST))
                 && (((struct lys_node_leaf *)leaf->schema)->type.base == LY_TYPE_ENUM)) {
-            set_fill_number(set, leaf->value.enm->value);
+            set_fill_int(set, leaf->value.enm->value);
         }
     }
 
@@ -3788,7 +4393,9 @@ xpath_floor(struct lyxp_set **args, uint16_t UNUSED(arg_count), struct lyd_node
     if (lyxp_set_cast(args[0], LYXP_SET_NUMBER, cur_node, local_mod, options)) {
         return -1;
     }
-    if (isfinite(args[0]->val.num)) {
+    if (args[0]->num_int) {
+        set_fill_int(set, args[0]->val.inum);
+    } else if (isfinite(args[0]->val.num)) {
         set_fill_number(set, (long long)args[0]->val.num);
     }
 
@@ -3915,7 +4522,7 @@ xpath_last(struct lyxp_set **UNUSED(args), uint16_t UNUSED(arg_count), struct ly
     }
 
     if (set->type == LYXP_SET_EMPTY) {
-        set_fill_number(set, 0);
+        set_fill_int(set, 0);
         return EXIT_SUCCESS;
     }
     if (set->type != LYXP_SET_NODE_SET) {
@@ -3923,7 +4530,7 @@ xpath_last(struct lyxp_set **UNUSED(args), uint16_t UNUSED(arg_count), struct ly
         return -1;
     }
 
-    set_fill_number(set, set->ctx_size);
+    set_fill_int(set, set->ctx_size);
     return EXIT_SUCCESS;
 }
 
@@ -3964,6 +4571,9 @@ xpath_local_name(struct lyxp_set **args, uint16_t arg_count, struct lyd_node *cu
         }
 
         /* we need the set sorted, it affects the result */
+        if (set_order(args[0], cur_node, options)) {
+            return -1;
+        }
         assert(!set_sort(args[0], cur_node, options));
 
         item = &args[0]->val.nodes[0];
@@ -3978,6 +4588,9 @@ xpath_local_name(struct lyxp_set **args, uint16_t arg_count, struct lyd_node *cu
         }
 
         /* we need the set sorted, it affects the result */
+        if (set_order(set, cur_node, options)) {
+            return -1;
+        }
         assert(!set_sort(set, cur_node, options));
 
         item = &set->val.nodes[0];
@@ -4059,6 +4672,9 @@ xpath_namespace_uri(struct lyxp_set **args, uint16_t arg_count, struct lyd_node
         }
 
         /* we need the set sorted, it affects the result */
+        if (set_order(args[0], cur_node, options)) {
+            return -1;
+        }
         assert(!set_sort(args[0], cur_node, options));
 
         item = &args[0]->val.nodes[0];
@@ -4073,6 +4689,9 @@ xpath_namespace_uri(struct lyxp_set **args, uint16_t arg_count, struct lyd_node
         }
 
         /* we need the set sorted, it affects the result */
+        if (set_order(set, cur_node, options)) {
+            return -1;
+        }
         assert(!set_sort(set, cur_node, options));
 
         item = &set->val.nodes[0];
@@ -4313,7 +4932,7 @@ xpath_position(struct lyxp_set **UNUSED(args), uint16_t UNUSED(arg_count), struc
     }
 
     if (set->type == LYXP_SET_EMPTY) {
-        set_fill_number(set, 0);
+        set_fill_int(set, 0);
         return EXIT_SUCCESS;
     }
     if (set->type != LYXP_SET_NODE_SET) {
@@ -4321,7 +4940,7 @@ xpath_position(struct lyxp_set **UNUSED(args), uint16_t UNUSED(arg_count), struc
         return -1;
     }
 
-    set_fill_number(set, set->ctx_pos);
+    set_fill_int(set, set->ctx_pos);
 
     /* UNUSED in 'Release' build type */
     (void)options;
@@ -4346,8 +4965,9 @@ xpath_re_match(struct lyxp_set **args, uint16_t UNUSED(arg_count), struct lyd_no
                struct lyxp_set *set, int options)
 {
     pcre *precomp;
+    pcre_extra *prestudy;
     struct lys_node_leaf *sleaf;
-    int ret = EXIT_SUCCESS;
+    int ret = EXIT_SUCCESS, cached;
 
     if (options & LYXP_SNODE_ALL) {
         if ((args[0]->type == LYXP_SET_SNODE_SET) && (sleaf = (struct lys_node_leaf *)warn_get_snode_in_ctx(args[0]))) {
@@ -4380,15 +5000,17 @@ xpath_re_match(struct lyxp_set **args, uint16_t UNUSED(arg_count), struct lyd_no
         return -1;
     }
 
-    if (lyp_check_pattern(local_mod->ctx, args[1]->val.str, &precomp)) {
+    if (lyp_regex_get(local_mod->ctx, args[1]->val.str, &precomp, &prestudy, &cached)) {
         return -1;
     }
-    if (pcre_exec(precomp, NULL, args[0]->val.str, strlen(args[0]->val.str), 0, 0, NULL, 0)) {
+    if (lyp_regex_exec(precomp, prestudy, args[0]->val.str)) {
         set_fill_boolean(set, 0);
     } else {
         set_fill_boolean(set, 1);
     }
-    free(precomp);
+    if (!cached) {
+        lyp_regex_free(precomp, prestudy);
+    }
 
     return EXIT_SUCCESS;
 }
@@ -4433,14 +5055,16 @@ xpath_round(struct lyxp_set **args, uint16_t UNUSED(arg_count), struct lyd_node
     }
 
     /* cover only the cases where floor can't be used */
-    if ((args[0]->val.num == -0.0f) || ((args[0]->val.num < 0) && (args[0]->val.num >= -0.5))) {
+    if (args[0]->num_int) {
+        set_fill_int(set, args[0]->val.inum);
+    } else if ((args[0]->val.num == -0.0f) || ((args[0]->val.num < 0) && (args[0]->val.num >= -0.5))) {
         set_fill_number(set, -0.0f);
     } else {
         args[0]->val.num += 0.5;
         if (xpath_floor(args, 1, cur_node, local_mod, args[0], options)) {
             return -1;
         }
-        set_fill_number(set, args[0]->val.num);
+        set_fill_set(set, args[0]);
     }
 
     return EXIT_SUCCESS;
@@ -4587,12 +5211,12 @@ xpath_string_length(struct lyxp_set **args, uint16_t arg_count, struct lyd_node
         if (lyxp_set_cast(args[0], LYXP_SET_STRING, cur_node, local_mod, options)) {
             return -1;
         }
-        set_fill_number(set, strlen(args[0]->val.str));
+        set_fill_int(set, strlen(args[0]->val.str));
     } else {
         if (lyxp_set_cast(set, LYXP_SET_STRING, cur_node, local_mod, options)) {
             return -1;
         }
-        set_fill_number(set, strlen(set->val.str));
+        set_fill_int(set, strlen(set->val.str));
     }
 
     return EXIT_SUCCESS;
@@ -4663,7 +5287,9 @@ xpath_substring(struct lyxp_set **args, uint16_t arg_count, struct lyd_node *cur
     if (xpath_round(&args[1], 1, cur_node, local_mod, args[1], options)) {
         return -1;
     }
-    if (isfinite(args[1]->val.num)) {
+    if (args[1]->num_int) {
+        start = (args[1]->val.inum > INT_MAX) ? INT_MAX : ((args[1]->val.inum < INT_MIN + 1) ? INT_MIN : args[1]->val.inum - 1);
+    } else if (isfinite(args[1]->val.num)) {
         start = args[1]->val.num - 1;
     } else if (isinf(args[1]->val.num) && signbit(args[1]->val.num)) {
         start = INT_MIN;
@@ -4676,7 +5302,9 @@ xpath_substring(struct lyxp_set **args, uint16_t arg_count, struct lyd_node *cur
         if (xpath_round(&args[2], 1, cur_node, local_mod, args[2], options)) {
             return -1;
         }
-        if (isfinite(args[2]->val.num)) {
+        if (args[2]->num_int) {
+            len = (args[2]->val.inum > INT_MAX) ? INT_MAX : ((args[2]->val.inum < 0) ? 0 : args[2]->val.inum);
+        } else if (isfinite(args[2]->val.num)) {
             len = args[2]->val.num;
         } else if (isnan(args[2]->val.num) || signbit(args[2]->val.num)) {
             len = 0;
@@ -4844,7 +5472,10 @@ static int
 xpath_sum(struct lyxp_set **args, uint16_t UNUSED(arg_count), struct lyd_node *cur_node, struct lys_module *local_mod,
           struct lyxp_set *set, int options)
 {
-    long double num;
+    long double num, sum = 0;
+    int64_t inum, dec, isum = 0, scaled;
+    uint8_t dig, sum_dig = 0;
+    int exact = 1, r;
     char *str;
     uint16_t i;
     struct lyxp_set set_item;
@@ -4870,7 +5501,7 @@ xpath_sum(struct lyxp_set **args, uint16_t UNUSED(arg_count), struct lyd_node *c
         return ret;
     }
 
-    set_fill_number(set, 0);
+    set_fill_int(set, 0);
     if (args[0]->type == LYXP_SET_EMPTY) {
         return EXIT_SUCCESS;
     }
@@ -4894,13 +5525,40 @@ xpath_sum(struct lyxp_set **args, uint16_t UNUSED(arg_count), struct lyd_node *c
         if (!str) {
             return -1;
         }
-        num = cast_string_to_number(str);
+        r = cast_string_to_number(str, &inum, &num, &dec, &dig);
         free(str);
-        set->val.num += num;
+
+        /* integers and decimals (such as decimal64 values) are summed exactly as scaled integers */
+        if (exact && (r || dig)) {
+            scaled = r ? inum : dec;
+            if (!num_dec_scale(&scaled, dig, sum_dig) && !num_dec_scale(&isum, sum_dig, dig)) {
+                sum_dig = (dig > sum_dig) ? dig : sum_dig;
+                if (!int_add_overflow(isum, scaled)) {
+                    isum += scaled;
+                    continue;
+                }
+            }
+        }
+        if (exact) {
+            /* continue summing in long double */
+            sum = (long double)isum / dec_pow(sum_dig);
+            exact = 0;
+        }
+        sum += r ? (long double)inum : num;
     }
 
     free(set_item.val.nodes);
 
+    if (exact && !sum_dig) {
+        set_fill_int(set, isum);
+    } else if (exact) {
+        set_fill_number(set, (long double)isum / dec_pow(sum_dig));
+        set->num_dig = sum_dig;
+        set->num_dec = isum;
+    } else {
+        set_fill_number(set, sum);
+    }
+
     return EXIT_SUCCESS;
 }
 
@@ -5188,7 +5846,7 @@ moveto_get_root(const struct lyd_node *cur_node, int options, enum lyxp_node_typ
         return NULL;
     }
 
-    if (!options) {
+    if (!(options & (LYXP_MUST | LYXP_WHEN))) {
         /* special kind of root that can access everything */
         for (root = cur_node; root->parent; root = root->parent);
         for (; root->prev->next; root = root->prev);
@@ -5290,11 +5948,18 @@ static int
 moveto_node_check(struct lyd_node *node, enum lyxp_node_type root_type, const char *node_name,
                   struct lys_module *moveto_mod, int options)
 {
+    ++lyxp_visits;
+
     /* module check */
     if (moveto_mod && (lyd_node_module(node) != moveto_mod)) {
         return -1;
     }
 
+    /* hidden instance check */
+    if (moveto_node_hidden(node)) {
+        return -1;
+    }
+
     /* context check */
     if ((root_type == LYXP_NODE_ROOT_CONFIG) && (node->schema->flags & LYS_CONFIG_R)) {
         return -1;
@@ -5359,12 +6024,14 @@ moveto_snode_check(const struct lys_node *node, enum lyxp_node_type root_type, c
  * @param[in] cur_node Original context node.
  * @param[in] qname Qualified node name to move to.
  * @param[in] qname_len Length of \p qname.
+ * @param[in] tok Resolved \p qname, if available.
  * @param[in] options Whether to apply data node access restrictions defined for 'when' and 'must' evaluation.
  *
  * @return EXIT_SUCCESS on success, EXIT_FAILURE on unresolved when, -1 on error.
  */
 static int
-moveto_node(struct lyxp_set *set, struct lyd_node *cur_node, const char *qname, uint16_t qname_len, int options)
+moveto_node(struct lyxp_set *set, struct lyd_node *cur_node, const char *qname, uint16_t qname_len,
+            const struct lyxp_tok_data *tok, int options)
 {
     uint32_t i;
     int replaced, pref_len, ret;
@@ -5388,8 +6055,15 @@ moveto_node(struct lyxp_set *set, struct lyd_node *cur_node, const char *qname,
 
     moveto_get_root(cur_node, options, &root_type);
 
+    if (tok) {
+        /* resolved when the expression was compiled */
+        moveto_mod = tok->mod;
+        if (!moveto_mod && strcmp(tok->name, "*")) {
+            moveto_mod = lyd_node_module(cur_node);
+        }
+        name_dict = tok->name;
     /* prefix */
-    if ((ptr = strnchr(qname, ':', qname_len))) {
+    } else if ((ptr = strnchr(qname, ':', qname_len))) {
         /* specific module */
         pref_len = ptr - qname;
         moveto_mod = moveto_resolve_model(qname, pref_len, ctx, NULL, 1, 0);
@@ -5408,7 +6082,9 @@ moveto_node(struct lyxp_set *set, struct lyd_node *cur_node, const char *qname,
     }
 
     /* name */
-    name_dict = lydict_insert(ctx, qname, qname_len);
+    if (!tok) {
+        name_dict = lydict_insert(ctx, qname, qname_len);
+    }
 
     for (i = 0; i < set->used; ) {
         replaced = 0;
@@ -5425,8 +6101,13 @@ moveto_node(struct lyxp_set *set, struct lyd_node *cur_node, const char *qname,
                         set_insert_node(set, sub, 0, LYXP_NODE_ELEM, i);
                     }
                     ++i;
+                    if (options & LYXP_EXISTS) {
+                        break;
+                    }
                 } else if (ret == EXIT_FAILURE) {
-                    lydict_remove(ctx, name_dict);
+                    if (!tok) {
+                        lydict_remove(ctx, name_dict);
+                    }
                     return EXIT_FAILURE;
                 }
             }
@@ -5435,6 +6116,7 @@ moveto_node(struct lyxp_set *set, struct lyd_node *cur_node, const char *qname,
         } else if (!(set->val.nodes[i].node->validity & LYD_VAL_INUSE)
                 && !(set->val.nodes[i].node->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST | LYS_ANYDATA))) {
 
+            lyd_wd_materialize(set->val.nodes[i].node, NULL);
             LY_TREE_FOR(set->val.nodes[i].node->child, sub) {
                 ret = moveto_node_check(sub, root_type, name_dict, moveto_mod, options);
                 if (!ret) {
@@ -5445,8 +6127,13 @@ moveto_node(struct lyxp_set *set, struct lyd_node *cur_node, const char *qname,
                         set_insert_node(set, sub, 0, LYXP_NODE_ELEM, i);
                     }
                     ++i;
+                    if (options & LYXP_EXISTS) {
+                        break;
+                    }
                 } else if (ret == EXIT_FAILURE) {
-                    lydict_remove(ctx, name_dict);
+                    if (!tok) {
+                        lydict_remove(ctx, name_dict);
+                    }
                     return EXIT_FAILURE;
                 }
             }
@@ -5455,13 +6142,309 @@ moveto_node(struct lyxp_set *set, struct lyd_node *cur_node, const char *qname,
         if (!replaced) {
             /* no match */
             set_remove_node(set, i);
+        } else if (options & LYXP_EXISTS) {
+            /* one node is enough, drop the rest of the context */
+            while (set->used > i) {
+                set_remove_node(set, set->used - 1);
+            }
         }
     }
-    lydict_remove(ctx, name_dict);
+    if (!tok) {
+        lydict_remove(ctx, name_dict);
+    }
 
     return EXIT_SUCCESS;
 }
 
+#ifdef LY_ENABLED_CACHE
+
+/**
+ * @brief Key equality predicate of a list step, see moveto_node_keys().
+ */
+struct moveto_key_pred {
+    const char *name;           /**< key name (not in the dictionary), without prefix */
+    uint16_t name_len;          /**< length of name */
+    struct lys_module *mod;     /**< module of the key */
+    const char *value;          /**< compared literal (not in the dictionary), without quotes */
+    uint16_t value_len;         /**< length of value */
+};
+
+/**
+ * @brief Searched list instance, the value used for list hash table lookup.
+ */
+struct moveto_key_list {
+    const struct lys_node_list *slist;
+    struct moveto_key_pred **keys;  /**< predicates in the order of the list keys */
+};
+
+static int
+moveto_key_list_match(const struct moveto_key_list *kl, const struct lyd_node *node)
+{
+    const struct lyd_node *key;
+    const char *str;
+    uint8_t i;
+
+    if (node->schema != (struct lys_node *)kl->slist) {
+        return 0;
+    }
+
+    /* the keys are always the first children in the schema order */
+    for (i = 0, key = node->child; i < kl->slist->keys_size; ++i, key = key->next) {
+        if (!key || (key->schema != (struct lys_node *)kl->slist->keys[i])) {
+            return 0;
+        }
+        str = ((struct lyd_node_leaf_list *)key)->value_str;
+        if (!str || strncmp(str, kl->keys[i]->value, kl->keys[i]->value_len) || str[kl->keys[i]->value_len]) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+static int
+moveto_key_list_equal(void *val1_p, void *val2_p, int mod, void *UNUSED(cb_data))
+{
+    assert(!mod);
+    (void)mod;
+
+    return moveto_key_list_match((struct moveto_key_list *)val1_p, *((struct lyd_node **)val2_p));
+}
+
+/**
+ * @brief Find a list schema node and order the key predicates accordingly.
+ *
+ * @param[in] sparent Schema parent of the list, NULL for top-level.
+ * @param[in] mod Module of the list.
+ * @param[in] name List name. Must be in the dictionary!
+ * @param[in] preds Parsed key predicates.
+ * @param[in] pred_count Count of \p preds.
+ * @param[in,out] kl Searched list to fill, keys must be allocated for \p pred_count items.
+ * @return 0 if the predicates are exactly all the keys of the list, non-zero otherwise.
+ */
+static int
+moveto_key_list_fill(const struct lys_node *sparent, const struct lys_module *mod, const char *name,
+                     struct moveto_key_pred *preds, uint16_t pred_count, struct moveto_key_list *kl)
+{
+    const struct lys_node *siter = NULL;
+    const struct lys_node_leaf *key;
+    uint16_t i, j;
+
+    while ((siter = lys_getnext(siter, sparent, mod, 0))) {
+        if (ly_strequal(siter->name, name, 1) && (lys_node_module(siter) == mod)) {
+            break;
+        }
+    }
+    if (!siter || (siter->nodetype != LYS_LIST) || (((struct lys_node_list *)siter)->keys_size != pred_count)) {
+        return 1;
+    }
+    kl->slist = (struct lys_node_list *)siter;
+
+    for (i = 0; i < pred_count; ++i) {
+        key = kl->slist->keys[i];
+        kl->keys[i] = NULL;
+        for (j = 0; j < pred_count; ++j) {
+            if ((preds[j].mod == lys_node_module((struct lys_node *)key)) && !strncmp(key->name, preds[j].name, preds[j].name_len)
+                    && !key->name[preds[j].name_len]) {
+                if (kl->keys[i]) {
+                    /* the same key twice */
+                    return 1;
+                }
+                kl->keys[i] = &preds[j];
+            }
+        }
+        if (!kl->keys[i]) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Get the data parent whose children a context node stands for, in the same way as moveto_node().
+ *
+ * @param[in] set Context set.
+ * @param[in] idx Index of the context node in \p set.
+ * @param[out] parent Data parent, NULL for the root.
+ * @return 0 if the context node can have children, 1 if not.
+ */
+static int
+moveto_key_parent(struct lyxp_set *set, uint32_t idx, struct lyd_node **parent)
+{
+    if ((set->val.nodes[idx].type == LYXP_NODE_ROOT_CONFIG) || (set->val.nodes[idx].type == LYXP_NODE_ROOT)) {
+        *parent = NULL;
+    } else if (!(set->val.nodes[idx].node->validity & LYD_VAL_INUSE)
+            && !(set->val.nodes[idx].node->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST | LYS_ANYDATA))) {
+        *parent = set->val.nodes[idx].node;
+    } else {
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Move context \p set to list instances selected by equality predicates on all their keys.
+ *        Handles 'NAME[KEY='VAL']...' or 'PREFIX:NAME[PREFIX:KEY='VAL']...'. The instances are found using
+ *        the children hash tables instead of evaluating the predicates on all the instances.
+ *        Result is LYXP_SET_NODE_SET (or LYXP_SET_EMPTY). Context position aware.
+ *
+ * @param[in] exp Parsed XPath expression.
+ * @param[in,out] exp_idx Position in the expression \p exp, the name test. Moved after the predicates on success.
+ * @param[in] cur_node Original context node.
+ * @param[in,out] set Set to use.
+ * @param[in] options Whether to apply data node access restrictions defined for 'when' and 'must' evaluation.
+ *
+ * @return EXIT_SUCCESS on success, 1 if the step is not of this form and must be evaluated normally, -1 on error.
+ */
+static int
+moveto_node_keys(struct lyxp_expr *exp, uint16_t *exp_idx, struct lyd_node *cur_node, struct lyxp_set *set, int options)
+{
+    struct ly_ctx *ctx;
+    struct moveto_key_pred *preds = NULL;
+    struct moveto_key_list kl;
+    struct lys_module *moveto_mod;
+    const struct lys_node *sparent;
+    struct lyd_node *parent, *sub, **match;
+    enum lyxp_node_type root_type;
+    const char *qname, *ptr, *name_dict = NULL;
+    uint16_t qname_len, idx, pred_count, i;
+    uint32_t hash, j;
+    int ret = 1;
+
+    if ((set->type != LYXP_SET_NODE_SET) || (options & LYXP_WHEN)) {
+        return 1;
+    }
+
+    /* count the predicates and check their form */
+    pred_count = 0;
+    for (idx = *exp_idx + 1; (idx + 4 < exp->used) && (exp->tokens[idx] == LYXP_TOKEN_BRACK1); idx += 5) {
+        if ((exp->tokens[idx + 1] != LYXP_TOKEN_NAMETEST) || (exp->tokens[idx + 2] != LYXP_TOKEN_OPERATOR_COMP)
+                || (exp->tok_len[idx + 2] != 1) || (exp->expr[exp->expr_pos[idx + 2]] != '=')
+                || (exp->tokens[idx + 3] != LYXP_TOKEN_LITERAL) || (exp->tokens[idx + 4] != LYXP_TOKEN_BRACK2)) {
+            break;
+        }
+        ++pred_count;
+    }
+    qname = &exp->expr[exp->expr_pos[*exp_idx]];
+    qname_len = exp->tok_len[*exp_idx];
+    if (!pred_count || (qname[qname_len - 1] == '*')) {
+        return 1;
+    }
+
+    ctx = cur_node->schema->module->ctx;
+    moveto_get_root(cur_node, options, &root_type);
+
+    /* list module, the same way as in moveto_node() */
+    if ((ptr = strnchr(qname, ':', qname_len))) {
+        moveto_mod = moveto_resolve_model(qname, ptr - qname, ctx, NULL, 1, 0);
+        if (!moveto_mod) {
+            /* let the error be logged normally */
+            return 1;
+        }
+        qname_len -= ptr - qname + 1;
+        qname = ptr + 1;
+    } else {
+        moveto_mod = lyd_node_module(cur_node);
+    }
+
+    preds = malloc(pred_count * (sizeof *preds + sizeof *kl.keys));
+    LY_CHECK_ERR_RETURN(!preds, LOGMEM(ctx), -1);
+    kl.keys = (struct moveto_key_pred **)&preds[pred_count];
+    kl.slist = NULL;
+
+    for (i = 0, idx = *exp_idx + 2; i < pred_count; ++i, idx += 5) {
+        preds[i].name = &exp->expr[exp->expr_pos[idx]];
+        preds[i].name_len = exp->tok_len[idx];
+        if ((ptr = strnchr(preds[i].name, ':', preds[i].name_len))) {
+            preds[i].mod = moveto_resolve_model(preds[i].name, ptr - preds[i].name, ctx, NULL, 1, 0);
+            if (!preds[i].mod) {
+                goto cleanup;
+            }
+            preds[i].name_len -= ptr - preds[i].name + 1;
+            preds[i].name = ptr + 1;
+        } else {
+            preds[i].mod = lyd_node_module(cur_node);
+        }
+        preds[i].value = &exp->expr[exp->expr_pos[idx + 2] + 1];
+        preds[i].value_len = exp->tok_len[idx + 2] - 2;
+    }
+
+    name_dict = lydict_insert(ctx, qname, qname_len);
+
+    /* the list with exactly these keys must exist in all the context nodes, otherwise evaluate the predicates */
+    for (j = 0, sparent = NULL; j < set->used; ++j) {
+        if (moveto_key_parent(set, j, &parent)) {
+            continue;
+        }
+        if (!kl.slist || ((parent ? parent->schema : NULL) != sparent)) {
+            sparent = parent ? parent->schema : NULL;
+            if (moveto_key_list_fill(sparent, moveto_mod, name_dict, preds, pred_count, &kl)) {
+                goto cleanup;
+            }
+        }
+    }
+
+    for (j = 0, kl.slist = NULL, sparent = NULL; j < set->used; ) {
+        match = NULL;
+        if (moveto_key_parent(set, j, &parent)) {
+            /* no children */
+            set_remove_node(set, j);
+            continue;
+        }
+
+        if (!kl.slist || ((parent ? parent->schema : NULL) != sparent)) {
+            sparent = parent ? parent->schema : NULL;
+            moveto_key_list_fill(sparent, moveto_mod, name_dict, preds, pred_count, &kl);
+        }
+
+        if (parent && parent->ht && !lyd_hash_user_type((struct lys_node *)kl.slist)) {
+            /* find the instance by its hash */
+            hash = dict_hash_multi(0, lys_node_module((struct lys_node *)kl.slist)->name,
+                                   strlen(lys_node_module((struct lys_node *)kl.slist)->name));
+            hash = dict_hash_multi(hash, kl.slist->name, strlen(kl.slist->name));
+            for (i = 0; i < pred_count; ++i) {
+                hash = dict_hash_multi(hash, kl.keys[i]->value, kl.keys[i]->value_len);
+            }
+            hash = dict_hash_multi(hash, NULL, 0);
+
+            if (lyht_find_cb(parent->ht, &kl, hash, moveto_key_list_equal, NULL, (void **)&match)) {
+                match = NULL;
+            }
+        } else {
+            /* few children or top-level nodes, compare the keys directly */
+            LY_TREE_FOR(parent ? parent->child : set->val.nodes[j].node, sub) {
+                if (moveto_key_list_match(&kl, sub)) {
+                    match = &sub;
+                    break;
+                }
+            }
+        }
+
+        if (match && ((root_type != LYXP_NODE_ROOT_CONFIG) || !((*match)->schema->flags & LYS_CONFIG_R))
+                && !moveto_node_hidden(*match)) {
+            /* pos filled later */
+            set_replace_node(set, *match, 0, LYXP_NODE_ELEM, j);
+            ++j;
+        } else {
+            set_remove_node(set, j);
+        }
+    }
+
+    LOGDBG(LY_LDGXPATH, "%-27s %s %s[%u] with %u key predicates", __func__, "parsed",
+           print_token(exp->tokens[*exp_idx]), exp->expr_pos[*exp_idx], pred_count);
+    *exp_idx += 1 + pred_count * 5;
+    ret = EXIT_SUCCESS;
+
+cleanup:
+    lydict_remove(ctx, name_dict);
+    free(preds);
+    return ret;
+}
+
+#endif
+
 static int
 moveto_snode(struct lyxp_set *set, struct lys_node *cur_node, const char *qname, uint16_t qname_len, int options)
 {
@@ -5575,28 +6558,71 @@ get_next_augment:
 }
 
 /**
- * @brief Move context \p set to a node and all its descendants. Handles '//' and '*', 'NAME',
- *        'PREFIX:*', or 'PREFIX:NAME'. Result is LYXP_SET_NODE_SET (or LYXP_SET_EMPTY).
- *        Context position aware.
+ * @brief Learn whether instances of a schema node can have any descendants matching a name test. Used to skip
+ *        data subtrees that cannot contain any matching node.
  *
- * @param[in] set Set to use.
- * @param[in] cur_node Original context node.
- * @param[in] qname Qualified node name to move to.
+ * @param[in] snode Schema node.
+ * @param[in] moveto_mod Module of the matching nodes.
+ * @param[in] qname Name of the matching nodes.
  * @param[in] qname_len Length of \p qname.
- * @param[in] options Whether to apply data node access restrictions defined for 'when' and 'must' evaluation.
+ * @param[in] desc Schema nodes known to have matching descendants.
+ * @param[in] nodesc Schema nodes known not to have any matching descendants.
  *
- * @return EXIT_SUCCESS on success, ECIT_FAILURE on unresolved when, -1 on error.
+ * @return 1 if there can be matching descendants, 0 if there cannot.
  */
 static int
-moveto_node_alldesc(struct lyxp_set *set, struct lyd_node *cur_node, const char *qname, uint16_t qname_len,
-                    int options)
+moveto_node_alldesc_match(const struct lys_node *snode, const struct lys_module *moveto_mod, const char *qname,
+                          uint16_t qname_len, struct ly_set *desc, struct ly_set *nodesc)
 {
-    uint32_t i;
-    int pref_len, all = 0, match, ret;
-    struct lyd_node *next, *elem, *start;
-    struct lys_module *moveto_mod;
+    const struct lys_node *iter = NULL;
+
+    if (ly_set_contains(desc, (void *)snode) > -1) {
+        return 1;
+    } else if (ly_set_contains(nodesc, (void *)snode) > -1) {
+        return 0;
+    }
+
+    while ((iter = lys_getnext(iter, snode, NULL, LYS_GETNEXT_NOSTATECHECK))) {
+        if (((lys_node_module(iter) == moveto_mod) && !strncmp(iter->name, qname, qname_len) && !iter->name[qname_len])
+                || (!(iter->nodetype & (LYS_LEAF | LYS_LEAFLIST | LYS_ANYDATA))
+                && moveto_node_alldesc_match(iter, moveto_mod, qname, qname_len, desc, nodesc))) {
+            ly_set_add(desc, (void *)snode, LY_SET_OPT_USEASLIST);
+            return 1;
+        }
+    }
+
+    ly_set_add(nodesc, (void *)snode, LY_SET_OPT_USEASLIST);
+    return 0;
+}
+
+/**
+ * @brief Move context \p set to a node and all its descendants. Handles '//' and '*', 'NAME',
+ *        'PREFIX:*', or 'PREFIX:NAME'. Result is LYXP_SET_NODE_SET (or LYXP_SET_EMPTY).
+ *        Context position aware.
+ *
+ * @param[in] set Set to use.
+ * @param[in] cur_node Original context node.
+ * @param[in] qname Qualified node name to move to.
+ * @param[in] qname_len Length of \p qname.
+ * @param[in] tok Resolved \p qname, if available.
+ * @param[in] options Whether to apply data node access restrictions defined for 'when' and 'must' evaluation.
+ *
+ * @return EXIT_SUCCESS on success, ECIT_FAILURE on unresolved when, -1 on error.
+ */
+static int
+moveto_node_alldesc(struct lyxp_set *set, struct lyd_node *cur_node, const char *qname, uint16_t qname_len,
+                    const struct lyxp_tok_data *tok, int options)
+{
+    uint32_t i;
+    int pref_len, all = 0, match, ret;
+    struct lyd_node *next, *elem, *start;
+    struct lys_module *moveto_mod;
     enum lyxp_node_type root_type;
     struct lyxp_set ret_set;
+    struct ly_set *desc = NULL, *nodesc = NULL;
+#ifdef LY_ENABLED_CACHE
+    uint64_t bits = 0;
+#endif
 
     if (!set || (set->type == LYXP_SET_EMPTY)) {
         return EXIT_SUCCESS;
@@ -5609,8 +6635,13 @@ moveto_node_alldesc(struct lyxp_set *set, struct lyd_node *cur_node, const char
 
     moveto_get_root(cur_node, options, &root_type);
 
+    if (tok) {
+        /* resolved when the expression was compiled */
+        moveto_mod = tok->mod;
+        qname = tok->name;
+        qname_len = strlen(qname);
     /* prefix */
-    if (strnchr(qname, ':', qname_len) && cur_node) {
+    } else if (strnchr(qname, ':', qname_len) && cur_node) {
         pref_len = strnchr(qname, ':', qname_len) - qname;
         moveto_mod = moveto_resolve_model(qname, pref_len, cur_node->schema->module->ctx, NULL, 1, 0);
         if (!moveto_mod) {
@@ -5624,13 +6655,31 @@ moveto_node_alldesc(struct lyxp_set *set, struct lyd_node *cur_node, const char
     }
 
     /* replace the original nodes (and throws away all text and attr nodes, root is replaced by a child) */
-    ret = moveto_node(set, cur_node, "*", 1, options);
+    ret = moveto_node(set, cur_node, "*", 1, NULL, options & ~LYXP_EXISTS);
     if (ret) {
         return ret;
     }
 
     if ((qname_len == 1) && (qname[0] == '*')) {
         all = 1;
+    } else {
+        /* the schema tells us which subtrees cannot contain any matching nodes */
+        if (!moveto_mod) {
+            moveto_mod = lyd_node_module(cur_node);
+        }
+        desc = ly_set_new();
+        nodesc = ly_set_new();
+        if (!desc || !nodesc) {
+            ly_set_free(desc);
+            ly_set_free(nodesc);
+            return -1;
+        }
+#ifdef LY_ENABLED_CACHE
+        /* and the subtree filters which data subtrees do not (virtual defaults are not in the filters) */
+        if (cur_node && !(cur_node->schema->module->ctx->models.flags & LY_CTX_VIRTUAL_DFLT)) {
+            bits = lyd_bloom_bits(qname, qname_len);
+        }
+#endif
     }
 
     /* this loop traverses all the nodes in the set and addds/keeps only
@@ -5641,9 +6690,17 @@ moveto_node_alldesc(struct lyxp_set *set, struct lyd_node *cur_node, const char
         /* TREE DFS */
         start = set->val.nodes[i].node;
         for (elem = next = start; elem; elem = next) {
+            ++lyxp_visits;
+
+            /* hidden instance check */
+            if ((elem != start) && moveto_node_hidden(elem)) {
+                goto skip_children;
+            }
 
             /* when check */
             if ((options & LYXP_WHEN) && !LYD_WHEN_DONE(elem->when_status)) {
+                ly_set_free(desc);
+                ly_set_free(nodesc);
                 return EXIT_FAILURE;
             }
 
@@ -5655,12 +6712,8 @@ moveto_node_alldesc(struct lyxp_set *set, struct lyd_node *cur_node, const char
             match = 1;
 
             /* module check */
-            if (!all) {
-                if (moveto_mod && (lys_node_module(elem->schema) != moveto_mod)) {
-                    match = 0;
-                } else if (!moveto_mod && (lys_node_module(elem->schema) != lyd_node_module(cur_node))) {
-                    match = 0;
-                }
+            if (!all && (lys_node_module(elem->schema) != moveto_mod)) {
+                match = 0;
             }
 
             /* name check */
@@ -5671,6 +6724,10 @@ moveto_node_alldesc(struct lyxp_set *set, struct lyd_node *cur_node, const char
             if (match) {
                 /* add matching node into result set */
                 set_insert_node(&ret_set, elem, 0, LYXP_NODE_ELEM, ret_set.used);
+                if (options & LYXP_EXISTS) {
+                    /* one node is enough */
+                    goto finish;
+                }
                 if (set_dup_node_check(set, elem, LYXP_NODE_ELEM, i)) {
                     /* the node is a duplicate, we'll process it later in the set */
                     goto skip_children;
@@ -5681,7 +6738,16 @@ moveto_node_alldesc(struct lyxp_set *set, struct lyd_node *cur_node, const char
             /* select element for the next run - children first */
             if (elem->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST | LYS_ANYDATA)) {
                 next = NULL;
+            } else if (!all && !moveto_node_alldesc_match(elem->schema, moveto_mod, qname, qname_len, desc, nodesc)) {
+                /* no descendant can match */
+                next = NULL;
+#ifdef LY_ENABLED_CACHE
+            } else if (bits && !lyd_bloom_contains(elem, bits)) {
+                /* no descendant matches */
+                next = NULL;
+#endif
             } else {
+                lyd_wd_materialize(elem, NULL);
                 next = elem->child;
             }
             if (!next) {
@@ -5707,9 +6773,14 @@ skip_children:
         }
     }
 
+finish:
+    ly_set_free(desc);
+    ly_set_free(nodesc);
+
     /* make the temporary set the current one */
     ret_set.ctx_pos = set->ctx_pos;
     ret_set.ctx_size = set->ctx_size;
+    ret_set.unordered = set->unordered;
     set_free_content(set);
     memcpy(set, &ret_set, sizeof *set);
 
@@ -5963,6 +7034,7 @@ moveto_attr(struct lyxp_set *set, struct lyd_node *cur_node, const char *qname,
 static int
 moveto_union(struct lyxp_set *set1, struct lyxp_set *set2, struct lyd_node *cur_node, int options)
 {
+    uint32_t i;
     struct ly_ctx *ctx = (options & LYXP_SNODE) ? ((struct lys_node *)cur_node)->module->ctx : cur_node->schema->module->ctx;
 
     if (((set1->type != LYXP_SET_NODE_SET) && (set1->type != LYXP_SET_EMPTY))
@@ -5983,17 +7055,35 @@ moveto_union(struct lyxp_set *set1, struct lyxp_set *set2, struct lyd_node *cur_
         return EXIT_SUCCESS;
     }
 
-    /* we assume sets are sorted */
-    assert(!set_sort(set1, cur_node, options) && !set_sort(set2, cur_node, options));
+    if (!set1->unordered && !set2->unordered && set_pos_known(set1) && set_pos_known(set2)) {
+        /* both sets are sorted and all the positions are known, merging them is cheap */
+        assert(!set_sort(set1, cur_node, options) && !set_sort(set2, cur_node, options));
 
-    /* sort, remove duplicates */
-    if (set_sorted_merge(set1, set2, cur_node, options)) {
-        return -1;
+        /* sort, remove duplicates */
+        if (set_sorted_merge(set1, set2, cur_node, options)) {
+            return -1;
+        }
+
+        /* final set must be sorted */
+        assert(!set_sort(set1, cur_node, options));
+
+        return EXIT_SUCCESS;
     }
 
-    /* final set must be sorted */
-    assert(!set_sort(set1, cur_node, options));
+    /* just append the new nodes, the set is sorted only when the order is needed */
+    if (set1->size - set1->used < set2->used) {
+        set1->size = set1->used + set2->used;
+        set1->val.nodes = ly_realloc(set1->val.nodes, set1->size * sizeof *set1->val.nodes);
+        LY_CHECK_ERR_RETURN(!set1->val.nodes, LOGMEM(ctx), -1);
+    }
+    for (i = 0; i < set2->used; ++i) {
+        if (!set_dup_node_check(set1, set2->val.nodes[i].node, set2->val.nodes[i].type, -1)) {
+            set_insert_node(set1, set2->val.nodes[i].node, set2->val.nodes[i].pos, set2->val.nodes[i].type, set1->used);
+        }
+    }
+    set1->unordered = 1;
 
+    lyxp_set_cast(set2, LYXP_SET_EMPTY, cur_node, NULL, options);
     return EXIT_SUCCESS;
 }
 
@@ -6048,7 +7138,7 @@ moveto_attr_alldesc(struct lyxp_set *set, struct lyd_node *cur_node, const char
     /* copy the context */
     set_all_desc = set_copy(set);
     /* get all descendant nodes (the original context nodes are removed) */
-    ret = moveto_node_alldesc(set_all_desc, cur_node, "*", 1, options);
+    ret = moveto_node_alldesc(set_all_desc, cur_node, "*", 1, NULL, options);
     if (ret) {
         lyxp_set_free(set_all_desc);
         return ret;
@@ -6110,9 +7200,10 @@ moveto_self_add_children_r(const struct lyd_node *parent, uint32_t parent_pos, s
 
     /* add all the children ... */
     if (!(parent->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST))) {
+        lyd_wd_materialize((struct lyd_node *)parent, NULL);
         LY_TREE_FOR(parent->child, sub) {
-            /* context check */
-            if ((root_type == LYXP_NODE_ROOT_CONFIG) && (sub->schema->flags & LYS_CONFIG_R)) {
+            /* context and hidden instance check */
+            if (((root_type == LYXP_NODE_ROOT_CONFIG) && (sub->schema->flags & LYS_CONFIG_R)) || moveto_node_hidden(sub)) {
                 continue;
             }
 
@@ -6212,6 +7303,7 @@ moveto_self(struct lyxp_set *set, struct lyd_node *cur_node, int all_desc, int o
     /* use the temporary set as the current one */
     ret_set.ctx_pos = set->ctx_pos;
     ret_set.ctx_size = set->ctx_size;
+    ret_set.unordered = set->unordered;
     set_free_content(set);
     memcpy(set, &ret_set, sizeof *set);
 
@@ -6342,7 +7434,7 @@ moveto_parent(struct lyxp_set *set, struct lyd_node *cur_node, int all_desc, int
 
         /* node already there can also be the root */
         if (root == node) {
-            if (options && (cur_node->schema->flags & LYS_CONFIG_W)) {
+            if ((options & (LYXP_MUST | LYXP_WHEN)) && (cur_node->schema->flags & LYS_CONFIG_W)) {
                 new_type = LYXP_NODE_ROOT_CONFIG;
             } else {
                 new_type = LYXP_NODE_ROOT;
@@ -6351,7 +7443,7 @@ moveto_parent(struct lyxp_set *set, struct lyd_node *cur_node, int all_desc, int
 
         /* node has no parent */
         } else if (!new_node) {
-            if (options && (cur_node->schema->flags & LYS_CONFIG_W)) {
+            if ((options & (LYXP_MUST | LYXP_WHEN)) && (cur_node->schema->flags & LYS_CONFIG_W)) {
                 new_type = LYXP_NODE_ROOT_CONFIG;
             } else {
                 new_type = LYXP_NODE_ROOT;
@@ -6379,7 +7471,7 @@ moveto_parent(struct lyxp_set *set, struct lyd_node *cur_node, int all_desc, int
         }
     }
 
-    assert(!set_sort(set, cur_node, options) && !set_sorted_dup_node_clean(set));
+    assert(set->unordered || (!set_sort(set, cur_node, options) && !set_sorted_dup_node_clean(set)));
 
     return EXIT_SUCCESS;
 }
@@ -6478,6 +7570,173 @@ moveto_snode_parent(struct lyxp_set *set, struct lys_node *cur_node, int all_des
     return EXIT_SUCCESS;
 }
 
+/**
+ * @brief Compare a node with the other operand of a relational operator by the order defined by its user type plugin.
+ *
+ * @param[in] item Node from a node-set.
+ * @param[in] set2 The other operand, only a string or a node-set can be compared.
+ * @param[in] op Relational operator.
+ * @param[in] reversed Whether \p item is the second operand of \p op.
+ *
+ * @return 1 if the comparison is true, 0 if it is false, -1 if the values cannot be ordered this way.
+ */
+static int
+moveto_op_comp_user(const struct lyxp_set_node *item, const struct lyxp_set *set2, const char *op, int reversed)
+{
+    uint32_t i;
+    int order;
+
+    if ((item->type != LYXP_NODE_ELEM) || ((set2->type != LYXP_SET_STRING) && (set2->type != LYXP_SET_NODE_SET))) {
+        return -1;
+    }
+
+    for (i = 0; (set2->type == LYXP_SET_STRING) ? !i : i < set2->used; ++i) {
+        if (set2->type == LYXP_SET_STRING) {
+            if (lyd_leaf_val_order(item->node, NULL, set2->val.str, &order)) {
+                return -1;
+            }
+        } else if ((set2->val.nodes[i].type != LYXP_NODE_ELEM)
+                || lyd_leaf_val_order(item->node, set2->val.nodes[i].node, NULL, &order)) {
+            return -1;
+        }
+
+        if (reversed) {
+            order = -order;
+        }
+        if ((op[0] == '<') ? ((order < 0) || ((op[1] == '=') && !order)) : ((order > 0) || ((op[1] == '=') && !order))) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Get the string value of a node-set item without casting it, if it is just the value of a leaf.
+ *
+ * @param[in] item Node from a node-set.
+ * @param[in] root_type Type of the XPath root.
+ *
+ * @return Value of the node, NULL if it must be cast.
+ */
+static const char *
+set_comp_item_str(const struct lyxp_set_node *item, enum lyxp_node_type root_type)
+{
+    const struct lyd_node *node = item->node;
+    const char *value_str;
+
+    if (((item->type != LYXP_NODE_ELEM) && (item->type != LYXP_NODE_TEXT))
+            || !(node->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST)) || (node->validity & LYD_VAL_INUSE)
+            || ((root_type == LYXP_NODE_ROOT_CONFIG) && (node->schema->flags & LYS_CONFIG_R))) {
+        /* the cast handles these */
+        return NULL;
+    }
+
+    value_str = ((struct lyd_node_leaf_list *)node)->value_str;
+    return value_str ? value_str : "";
+}
+
+static int
+set_comp_str_equal_cb(void *val1_p, void *val2_p, int UNUSED(mod), void *UNUSED(cb_data))
+{
+    return !strcmp(*(const char **)val1_p, *(const char **)val2_p);
+}
+
+/**
+ * @brief Compare the values of two node-sets of leaves with '=' or '!='. Nodes that would need to be cast
+ *        into strings are not handled.
+ *
+ * Small node-sets are compared pair by pair, the values of the smaller one of larger node-sets are hashed
+ * and the values of the other one looked up. '!=' is true for any values except the same single one in both.
+ *
+ * @param[in] set1 First node-set.
+ * @param[in] set2 Second node-set.
+ * @param[in] op Comparison operator, '=' or '!='.
+ * @param[in] root_type Type of the XPath root.
+ *
+ * @return 1 if the comparison is true, 0 if it is false, -1 if the node-sets must be compared generally.
+ */
+static int
+moveto_op_comp_sets(const struct lyxp_set *set1, const struct lyxp_set *set2, const char *op,
+                    enum lyxp_node_type root_type)
+{
+    const struct lyxp_set *small, *big;
+    struct hash_table *ht;
+    const char *str, *first;
+    uint32_t i, j;
+    int result = 0;
+
+    for (i = 0; i < set1->used; ++i) {
+        if (!set_comp_item_str(&set1->val.nodes[i], root_type)) {
+            return -1;
+        }
+    }
+    for (i = 0; i < set2->used; ++i) {
+        if (!set_comp_item_str(&set2->val.nodes[i], root_type)) {
+            return -1;
+        }
+    }
+
+    if (op[0] == '!') {
+        first = set_comp_item_str(&set1->val.nodes[0], root_type);
+        for (i = 1; i < set1->used; ++i) {
+            if (strcmp(set_comp_item_str(&set1->val.nodes[i], root_type), first)) {
+                return 1;
+            }
+        }
+        for (i = 0; i < set2->used; ++i) {
+            if (strcmp(set_comp_item_str(&set2->val.nodes[i], root_type), first)) {
+                return 1;
+            }
+        }
+        return 0;
+    }
+
+    if (set1->used <= set2->used) {
+        small = set1;
+        big = set2;
+    } else {
+        small = set2;
+        big = set1;
+    }
+
+    if (small->used < LY_CACHE_HT_MIN_CHILDREN) {
+        for (i = 0; i < small->used; ++i) {
+            str = set_comp_item_str(&small->val.nodes[i], root_type);
+            for (j = 0; j < big->used; ++j) {
+                if (!strcmp(str, set_comp_item_str(&big->val.nodes[j], root_type))) {
+                    return 1;
+                }
+            }
+        }
+        return 0;
+    }
+
+    ht = lyht_new(1, sizeof str, set_comp_str_equal_cb, NULL, 1);
+    if (!ht || lyht_reserve(ht, small->used)) {
+        /* compare them generally */
+        lyht_free(ht);
+        return -1;
+    }
+    for (i = 0; i < small->used; ++i) {
+        str = set_comp_item_str(&small->val.nodes[i], root_type);
+        if (lyht_insert(ht, &str, dict_hash_multi(dict_hash_multi(0, str, strlen(str)), NULL, 0), NULL) == -1) {
+            lyht_free(ht);
+            return -1;
+        }
+    }
+    for (j = 0; j < big->used; ++j) {
+        str = set_comp_item_str(&big->val.nodes[j], root_type);
+        if (!lyht_find(ht, &str, dict_hash_multi(dict_hash_multi(0, str, strlen(str)), NULL, 0), NULL)) {
+            result = 1;
+            break;
+        }
+    }
+
+    lyht_free(ht);
+    return result;
+}
+
 /**
  * @brief Move context \p set to the result of a comparison. Handles '=', '!=', '<=', '<', '>=', or '>'.
  *        Result is LYXP_SET_BOOLEAN. Indirectly context position aware.
@@ -6525,7 +7784,9 @@ moveto_op_comp(struct lyxp_set *set1, struct lyxp_set *set2, const char *op, str
      * STRING + BOOLEAN = NUMBER + NUMBER      /(1 NUMBER) 2 NUMBER
      */
     struct lyxp_set iter1, iter2;
-    int result;
+    enum lyxp_node_type root_type;
+    const char *str;
+    int result, order;
     int64_t i;
 
     iter1.type = LYXP_SET_EMPTY;
@@ -6538,8 +7799,44 @@ moveto_op_comp(struct lyxp_set *set1, struct lyxp_set *set2, const char *op, str
 
     /* iterative evaluation with node-sets */
     if ((set1->type == LYXP_SET_NODE_SET) || (set2->type == LYXP_SET_NODE_SET)) {
+        /* the same as by moveto_get_root(), without finding the root */
+        if (cur_node && (options & (LYXP_MUST | LYXP_WHEN)) && (cur_node->schema->flags & LYS_CONFIG_W)) {
+            root_type = LYXP_NODE_ROOT_CONFIG;
+        } else {
+            root_type = LYXP_NODE_ROOT;
+        }
+
+        if ((set1->type == LYXP_SET_NODE_SET) && (set2->type == LYXP_SET_NODE_SET) && ((op[0] == '=') || (op[0] == '!'))) {
+            /* leaf values are compared directly */
+            result = moveto_op_comp_sets(set1, set2, op, root_type);
+            if (result > -1) {
+                set_fill_boolean(set1, result);
+                return EXIT_SUCCESS;
+            }
+        }
+
         if (set1->type == LYXP_SET_NODE_SET) {
             for (i = 0; i < set1->used; ++i) {
+                if (((op[0] == '=') || (op[0] == '!')) && (set2->type == LYXP_SET_STRING)
+                        && (str = set_comp_item_str(&set1->val.nodes[i], root_type))) {
+                    /* leaf value compared with a string directly */
+                    if ((op[0] == '=') == (strcmp(str, set2->val.str) == 0)) {
+                        set_fill_boolean(set1, 1);
+                        return EXIT_SUCCESS;
+                    }
+                    continue;
+                }
+                if ((op[0] == '<') || (op[0] == '>')) {
+                    /* values with an order defined by their type are compared directly */
+                    result = moveto_op_comp_user(&set1->val.nodes[i], set2, op, 0);
+                    if (result == 1) {
+                        set_fill_boolean(set1, 1);
+                        return EXIT_SUCCESS;
+                    } else if (!result) {
+                        continue;
+                    }
+                }
+
                 switch (set2->type) {
                 case LYXP_SET_NUMBER:
                     if (set_comp_cast(&iter1, set1, LYXP_SET_NUMBER, cur_node, local_mod, i, options)) {
@@ -6571,6 +7868,24 @@ moveto_op_comp(struct lyxp_set *set1, struct lyxp_set *set2, const char *op, str
             }
         } else {
             for (i = 0; i < set2->used; ++i) {
+                if (((op[0] == '=') || (op[0] == '!')) && (set1->type == LYXP_SET_STRING)
+                        && (str = set_comp_item_str(&set2->val.nodes[i], root_type))) {
+                    if ((op[0] == '=') == (strcmp(set1->val.str, str) == 0)) {
+                        set_fill_boolean(set1, 1);
+                        return EXIT_SUCCESS;
+                    }
+                    continue;
+                }
+                if ((op[0] == '<') || (op[0] == '>')) {
+                    result = moveto_op_comp_user(&set2->val.nodes[i], set1, op, 1);
+                    if (result == 1) {
+                        set_fill_boolean(set1, 1);
+                        return EXIT_SUCCESS;
+                    } else if (!result) {
+                        continue;
+                    }
+                }
+
                 switch (set1->type) {
                     case LYXP_SET_NUMBER:
                         if (set_comp_cast(&iter2, set2, LYXP_SET_NUMBER, cur_node, local_mod, i, options)) {
@@ -6634,13 +7949,31 @@ moveto_op_comp(struct lyxp_set *set1, struct lyxp_set *set2, const char *op, str
     }
 
     assert(set1->type == set2->type);
+    if ((set1->type == LYXP_SET_NUMBER) && (set1->num_dig || set2->num_dig) && !set_num_exact_cmp(set1, set2, &order)) {
+        /* decimals (such as decimal64 values) are compared exactly as scaled integers */
+        if (op[0] == '=') {
+            result = !order;
+        } else if (op[0] == '!') {
+            result = (order != 0);
+        } else if (op[0] == '<') {
+            result = (op[1] == '=') ? (order <= 0) : (order < 0);
+        } else {
+            result = (op[1] == '=') ? (order >= 0) : (order > 0);
+        }
+        set_fill_boolean(set1, result);
+        return EXIT_SUCCESS;
+    }
+    if ((set1->type == LYXP_SET_NUMBER) && (set1->num_int != set2->num_int)) {
+        set_num_widen(set1);
+        set_num_widen(set2);
+    }
 
     /* compute result */
     if (op[0] == '=') {
         if (set1->type == LYXP_SET_BOOLEAN) {
             result = (set1->val.bool == set2->val.bool);
         } else if (set1->type == LYXP_SET_NUMBER) {
-            result = (set1->val.num == set2->val.num);
+            result = set1->num_int ? (set1->val.inum == set2->val.inum) : (set1->val.num == set2->val.num);
         } else {
             assert(set1->type == LYXP_SET_STRING);
             result = (ly_strequal(set1->val.str, set2->val.str, 0));
@@ -6649,7 +7982,7 @@ moveto_op_comp(struct lyxp_set *set1, struct lyxp_set *set2, const char *op, str
         if (set1->type == LYXP_SET_BOOLEAN) {
             result = (set1->val.bool != set2->val.bool);
         } else if (set1->type == LYXP_SET_NUMBER) {
-            result = (set1->val.num != set2->val.num);
+            result = set1->num_int ? (set1->val.inum != set2->val.inum) : (set1->val.num != set2->val.num);
         } else {
             assert(set1->type == LYXP_SET_STRING);
             result = (!ly_strequal(set1->val.str, set2->val.str, 0));
@@ -6658,15 +7991,15 @@ moveto_op_comp(struct lyxp_set *set1, struct lyxp_set *set2, const char *op, str
         assert(set1->type == LYXP_SET_NUMBER);
         if (op[0] == '<') {
             if (op[1] == '=') {
-                result = (set1->val.num <= set2->val.num);
+                result = set1->num_int ? (set1->val.inum <= set2->val.inum) : (set1->val.num <= set2->val.num);
             } else {
-                result = (set1->val.num < set2->val.num);
+                result = set1->num_int ? (set1->val.inum < set2->val.inum) : (set1->val.num < set2->val.num);
             }
         } else {
             if (op[1] == '=') {
-                result = (set1->val.num >= set2->val.num);
+                result = set1->num_int ? (set1->val.inum >= set2->val.inum) : (set1->val.num >= set2->val.num);
             } else {
-                result = (set1->val.num > set2->val.num);
+                result = set1->num_int ? (set1->val.inum > set2->val.inum) : (set1->val.num > set2->val.num);
             }
         }
     }
@@ -6681,6 +8014,59 @@ moveto_op_comp(struct lyxp_set *set1, struct lyxp_set *set2, const char *op, str
     return EXIT_SUCCESS;
 }
 
+/**
+ * @brief Perform a basic operation on integers if the result is an exact integer.
+ *
+ * @param[in] a First operand.
+ * @param[in] b Second operand.
+ * @param[in] op Operator, the first character of '+', '-', '*', 'div', or 'mod'.
+ * @param[out] res Result of the operation.
+ *
+ * @return 0 on success, 1 if the operation must be performed on long doubles.
+ */
+static int
+op_math_int(int64_t a, int64_t b, char op, int64_t *res)
+{
+    switch (op) {
+    case '+':
+        if (int_add_overflow(a, b)) {
+            return 1;
+        }
+        *res = a + b;
+        break;
+    case '-':
+        if ((b == INT64_MIN) || int_add_overflow(a, -b)) {
+            return 1;
+        }
+        *res = a - b;
+        break;
+    case '*':
+        /* operands this small cannot overflow, a zero result may have to be a negative zero */
+        if ((a > INT32_MAX) || (a < -INT32_MAX) || (b > INT32_MAX) || (b < -INT32_MAX)
+                || ((!a || !b) && ((a < 0) || (b < 0)))) {
+            return 1;
+        }
+        *res = a * b;
+        break;
+    case 'd':
+        if (!b || ((a == INT64_MIN) && (b == -1)) || (a % b) || (!a && (b < 0))) {
+            return 1;
+        }
+        *res = a / b;
+        break;
+    case 'm':
+        if (!b) {
+            return 1;
+        }
+        *res = (b == -1) ? 0 : a % b;
+        break;
+    default:
+        return 1;
+    }
+
+    return 0;
+}
+
 /**
  * @brief Move context \p set to the result of a basic operation. Handles '+', '-', unary '-', '*', 'div',
  *        or 'mod'. Result is LYXP_SET_NUMBER. Indirectly context position aware.
@@ -6701,7 +8087,14 @@ moveto_op_math(struct lyxp_set *set1, struct lyxp_set *set2, const char *op, str
         if (lyxp_set_cast(set1, LYXP_SET_NUMBER, cur_node, local_mod, options)) {
             return -1;
         }
-        set1->val.num *= -1;
+        if (set1->num_int && set1->val.inum && (set1->val.inum != INT64_MIN)) {
+            set1->val.inum = -set1->val.inum;
+        } else {
+            /* zero must become a negative zero */
+            set_num_widen(set1);
+            set1->val.num *= -1;
+            set1->num_dec = -set1->num_dec;
+        }
         lyxp_set_free(set2);
         return EXIT_SUCCESS;
     }
@@ -6715,6 +8108,14 @@ moveto_op_math(struct lyxp_set *set1, struct lyxp_set *set2, const char *op, str
         return -1;
     }
 
+    /* integers stay integers as long as the result is exact */
+    if (set1->num_int && set2->num_int && !op_math_int(set1->val.inum, set2->val.inum, op[0], &set1->val.inum)) {
+        return EXIT_SUCCESS;
+    }
+    set_num_widen(set1);
+    set_num_widen(set2);
+    set1->num_dig = 0;
+
     switch (op[0]) {
     /* '+' */
     case '+':
@@ -6738,7 +8139,11 @@ moveto_op_math(struct lyxp_set *set1, struct lyxp_set *set2, const char *op, str
 
     /* 'mod' */
     case 'm':
-        set1->val.num = ((long long)set1->val.num) % ((long long)set2->val.num);
+        if (!(long long)set2->val.num) {
+            set1->val.num = NAN;
+        } else {
+            set1->val.num = ((long long)set1->val.num) % ((long long)set2->val.num);
+        }
         break;
 
     default:
@@ -6779,6 +8184,26 @@ eval_literal(struct lyxp_expr *exp, uint16_t *exp_idx, struct lyxp_set *set)
     ++(*exp_idx);
 }
 
+/**
+ * @brief Get token data resolved when the expression was compiled, if still valid.
+ *
+ * @param[in] exp Parsed XPath expression.
+ * @param[in] exp_idx Index of the token.
+ * @param[in] cur_node Start node for the expression \p exp.
+ *
+ * @return Resolved token data, NULL if there are none.
+ */
+static const struct lyxp_tok_data *
+eval_tok_data(const struct lyxp_expr *exp, uint16_t exp_idx, const struct lyd_node *cur_node)
+{
+    if (!exp->tok_data || !exp->tok_data[exp_idx].name || !cur_node
+            || (exp->ctx != cur_node->schema->module->ctx) || (exp->module_set_id != exp->ctx->models.module_set_id)) {
+        return NULL;
+    }
+
+    return &exp->tok_data[exp_idx];
+}
+
 /**
  * @brief Evaluate NodeTest. Logs directly on error.
  *
@@ -6822,7 +8247,7 @@ eval_node_test(struct lyxp_expr *exp, uint16_t *exp_idx, struct lyd_node *cur_no
                                               exp->tok_len[*exp_idx], options);
                 } else {
                     rc = moveto_node_alldesc(set, cur_node, &exp->expr[exp->expr_pos[*exp_idx]],
-                                             exp->tok_len[*exp_idx], options);
+                                             exp->tok_len[*exp_idx], eval_tok_data(exp, *exp_idx, cur_node), options);
                 }
             } else {
                 if (set && (options & LYXP_SNODE_ALL)) {
@@ -6830,7 +8255,7 @@ eval_node_test(struct lyxp_expr *exp, uint16_t *exp_idx, struct lyd_node *cur_no
                                       exp->tok_len[*exp_idx], options);
                 } else {
                     rc = moveto_node(set, cur_node, &exp->expr[exp->expr_pos[*exp_idx]], exp->tok_len[*exp_idx],
-                                     options);
+                                     eval_tok_data(exp, *exp_idx, cur_node), options);
                 }
             }
 
@@ -6904,34 +8329,297 @@ eval_node_test(struct lyxp_expr *exp, uint16_t *exp_idx, struct lyd_node *cur_no
 }
 
 /**
- * @brief Evaluate Predicate. Logs directly on error.
- *
- * [7] Predicate ::= '[' Expr ']'
+ * @brief Evaluate Predicate for one node of a node set. Logs directly on error.
  *
  * @param[in] exp Parsed XPath expression.
- * @param[in] exp_idx Position in the expression \p exp.
+ * @param[in] exp_idx Position in the expression \p exp, the predicate expression.
  * @param[in] cur_node Start node for the expression \p exp.
- * @param[in,out] set Context and result set. On NULL the rule is only parsed.
+ * @param[in] item Node to evaluate the predicate for.
+ * @param[in] ctx_pos Context position of \p item.
+ * @param[in] ctx_size Context size.
  * @param[in] options Whether to apply data node access restrictions defined for 'when' and 'must' evaluation.
+ * @param[out] satisfied Whether the predicate is satisfied for \p item.
  *
  * @return EXIT_SUCCESS on success, EXIT_FAILURE on unresolved when, -1 on error.
  */
 static int
-eval_predicate(struct lyxp_expr *exp, uint16_t *exp_idx, struct lyd_node *cur_node, struct lys_module *local_mod,
-               struct lyxp_set *set, int options, int parent_pos_pred)
+eval_predicate_node(struct lyxp_expr *exp, uint16_t *exp_idx, struct lyd_node *cur_node, struct lys_module *local_mod,
+                    const struct lyxp_set_node *item, uint32_t ctx_pos, uint32_t ctx_size, int options, int *satisfied)
 {
-    int ret;
-    uint16_t i, orig_exp, brack2_exp, open_brack;
-    uint32_t orig_pos, orig_size, pred_in_ctx;
     struct lyxp_set set2;
-    struct lyd_node *orig_parent;
-
-    /* '[' */
-    LOGDBG(LY_LDGXPATH, "%-27s %s %s[%u]", __func__, (set ? "parsed" : "skipped"),
-           print_token(exp->tokens[*exp_idx]), exp->expr_pos[*exp_idx]);
-    ++(*exp_idx);
+    int ret;
 
-    if (!set) {
+    memset(&set2, 0, sizeof set2);
+    set_insert_node(&set2, item->node, item->pos, item->type, 0);
+    set2.ctx_pos = ctx_pos;
+    set2.ctx_size = ctx_size;
+
+    /* a node set result is only tested for being non-empty */
+    ++lyxp_abs.pred_depth;
+    ret = eval_expr_select(exp, exp_idx, 0, cur_node, local_mod, &set2, options | LYXP_EXISTS);
+    --lyxp_abs.pred_depth;
+    if (ret == -1 || ret == EXIT_FAILURE) {
+        lyxp_set_cast(&set2, LYXP_SET_EMPTY, cur_node, local_mod, options);
+        return ret;
+    }
+
+    /* number is a position */
+    if (set2.type == LYXP_SET_NUMBER) {
+        if (set2.num_int) {
+            set_fill_boolean(&set2, set2.val.inum == ctx_pos);
+        } else {
+            set_fill_boolean(&set2, (long long)set2.val.num == ctx_pos);
+        }
+    }
+    lyxp_set_cast(&set2, LYXP_SET_BOOLEAN, cur_node, local_mod, options);
+
+    *satisfied = set2.val.bool;
+    return EXIT_SUCCESS;
+}
+
+/* node sets with at least this many nodes per thread have their predicates evaluated by several threads */
+#define LYXP_PRED_THREAD_NODES 1024
+
+struct lyxp_pred_thread {
+    struct lyxp_expr *exp;
+    uint16_t exp_idx;                /* the predicate expression */
+    struct lyd_node *cur_node;
+    struct lys_module *local_mod;
+    int options;
+    const struct lyxp_set *set;      /* filtered node set */
+    const uint32_t *ctx_pos;         /* context positions of the nodes */
+    uint32_t start;                  /* nodes evaluated by the thread */
+    uint32_t end;
+    uint8_t *satisfied;              /* predicate results of all the nodes */
+    enum int_log_opts log_opt;       /* internal logging options of the calling thread */
+    const struct lys_node *hide_snode; /* hidden nodes of the calling thread */
+    const struct lyd_node *hide_parent;
+    uint32_t pred_depth;             /* predicates evaluated by the calling thread */
+    uint64_t visits;                 /* data nodes checked by the thread */
+    struct ly_err_item *err;         /* errors logged by the thread */
+    int ret;
+};
+
+static void *
+eval_predicate_thread(void *arg)
+{
+    struct lyxp_pred_thread *pt = (struct lyxp_pred_thread *)arg;
+    struct lyxp_abs_cache abs_cache, *prev_cache = lyxp_abs.cache;
+    const struct lys_node *prev_snode = lyxp_hide.snode;
+    const struct lyd_node *prev_parent = lyxp_hide.parent;
+    uint32_t i, prev_depth = lyxp_abs.pred_depth;
+    uint64_t prev_visits = lyxp_visits;
+    uint16_t exp_idx;
+    int satisfied;
+
+    /* the same evaluation state as in the calling thread */
+    log_opt = pt->log_opt;
+    lyxp_hide.snode = pt->hide_snode;
+    lyxp_hide.parent = pt->hide_parent;
+    abs_cache.count = 0;
+    lyxp_abs.cache = &abs_cache;
+    lyxp_abs.pred_depth = pt->pred_depth;
+    lyxp_visits = 0;
+    pool_enter();
+
+    pt->ret = EXIT_SUCCESS;
+    for (i = pt->start; i < pt->end; ++i) {
+        exp_idx = pt->exp_idx;
+        pt->ret = eval_predicate_node(pt->exp, &exp_idx, pt->cur_node, pt->local_mod, &pt->set->val.nodes[i],
+                                      pt->ctx_pos[i], pt->set->used, pt->options, &satisfied);
+        if (pt->ret) {
+            break;
+        }
+        pt->satisfied[i] = satisfied;
+    }
+
+    for (i = 0; i < abs_cache.count; ++i) {
+        set_free_content(&abs_cache.paths[i].set);
+    }
+    pool_leave();
+    pt->visits = lyxp_visits;
+    lyxp_visits = prev_visits;
+    lyxp_abs.cache = prev_cache;
+    lyxp_abs.pred_depth = prev_depth;
+    lyxp_hide.snode = prev_snode;
+    lyxp_hide.parent = prev_parent;
+
+    /* the errors are passed to the calling thread */
+    pt->err = ly_err_detach(pt->cur_node->schema->module->ctx);
+    return NULL;
+}
+
+/**
+ * @brief Evaluate Predicate for the nodes of a large node set in several threads, see ly_ctx_set_xpath_threads().
+ * Logs directly on error.
+ *
+ * @param[in] exp Parsed XPath expression.
+ * @param[in] exp_idx Position in the expression \p exp, the predicate expression.
+ * @param[in] cur_node Start node for the expression \p exp.
+ * @param[in,out] set Sorted node set to filter.
+ * @param[in] options Whether to apply data node access restrictions defined for 'when' and 'must' evaluation.
+ * @param[in] parent_pos_pred Whether the context positions are relative to the node parents.
+ *
+ * @return EXIT_SUCCESS on success, EXIT_FAILURE on unresolved when, -1 on error, 2 if evaluated in the calling
+ * thread only.
+ */
+static int
+eval_predicate_threads(struct lyxp_expr *exp, uint16_t exp_idx, struct lyd_node *cur_node, struct lys_module *local_mod,
+                       struct lyxp_set *set, int options, int parent_pos_pred)
+{
+    struct ly_ctx *ctx;
+    struct lyxp_pred_thread *pt = NULL;
+    struct lyd_node *orig_parent = NULL;
+    pthread_t *tids = NULL;
+    int8_t *started = NULL;
+    uint32_t *ctx_pos = NULL, i, j, pos = 0, thread_count, start;
+    uint8_t *satisfied = NULL;
+    int ret = -1;
+
+    if (!cur_node || lyxp_abs.pred_depth) {
+        /* nested predicates are evaluated by the thread of the outer one */
+        return 2;
+    }
+    ctx = cur_node->schema->module->ctx;
+    if (ctx->models.flags & LY_CTX_VIRTUAL_DFLT) {
+        /* moving to the nodes materializes the default nodes in the shared tree */
+        return 2;
+    }
+    thread_count = set->used / LYXP_PRED_THREAD_NODES;
+    if (thread_count > ctx->xpath_threads) {
+        thread_count = ctx->xpath_threads;
+    }
+    if (thread_count < 2) {
+        return 2;
+    }
+
+#ifdef LY_ENABLED_CACHE
+    /* the threads only read the subtree filters */
+    lyd_bloom_build_tree(cur_node);
+#endif
+
+    pt = calloc(thread_count, sizeof *pt);
+    tids = malloc(thread_count * sizeof *tids);
+    started = calloc(thread_count, sizeof *started);
+    ctx_pos = malloc(set->used * sizeof *ctx_pos);
+    satisfied = malloc(set->used * sizeof *satisfied);
+    LY_CHECK_ERR_GOTO(!pt || !tids || !started || !ctx_pos || !satisfied, LOGMEM(ctx), cleanup);
+
+    for (i = 0; i < set->used; ++i) {
+        if (parent_pos_pred && (set->val.nodes[i].node->parent != orig_parent)) {
+            orig_parent = set->val.nodes[i].node->parent;
+            pos = 1;
+        } else {
+            ++pos;
+        }
+        ctx_pos[i] = pos;
+    }
+
+    /* split the nodes into contiguous parts */
+    for (i = 0, start = 0; i < thread_count; ++i) {
+        pt[i].exp = exp;
+        pt[i].exp_idx = exp_idx;
+        pt[i].cur_node = cur_node;
+        pt[i].local_mod = local_mod;
+        pt[i].options = options;
+        pt[i].set = set;
+        pt[i].ctx_pos = ctx_pos;
+        pt[i].start = start;
+        pt[i].end = start + (set->used - start) / (thread_count - i);
+        pt[i].satisfied = satisfied;
+        pt[i].log_opt = log_opt;
+        pt[i].hide_snode = lyxp_hide.snode;
+        pt[i].hide_parent = lyxp_hide.parent;
+        pt[i].pred_depth = lyxp_abs.pred_depth;
+        start = pt[i].end;
+    }
+
+    /* the calling thread evaluates the first part itself */
+    for (i = 1; i < thread_count; ++i) {
+        started[i] = pthread_create(&tids[i], NULL, eval_predicate_thread, &pt[i]) ? 0 : 1;
+    }
+    for (i = 0; i < thread_count; ++i) {
+        if (started[i]) {
+            pthread_join(tids[i], NULL);
+        } else {
+            /* the first part or a thread could not be created */
+            eval_predicate_thread(&pt[i]);
+        }
+    }
+
+    ret = EXIT_SUCCESS;
+    for (i = 0; i < thread_count; ++i) {
+        lyxp_visits += pt[i].visits;
+        if (!ret) {
+            /* only the errors up to the first failed node, as if evaluated serially */
+            ly_err_append(ctx, pt[i].err);
+            pt[i].err = NULL;
+            ret = pt[i].ret;
+        }
+    }
+    if (ret) {
+        goto cleanup;
+    }
+
+    /* keep the satisfied nodes in the document order */
+    for (i = 0, j = 0; i < set->used; ++i) {
+        if (satisfied[i]) {
+            set->val.nodes[j++] = set->val.nodes[i];
+        } else {
+#ifdef LY_ENABLED_CACHE
+            set_remove_node_hash(set, set->val.nodes[i].node, set->val.nodes[i].type);
+#endif
+        }
+    }
+    set->used = j;
+    if (!set->used) {
+        set_free_content(set);
+        memset(set, 0, sizeof *set);
+    }
+
+cleanup:
+    if (pt) {
+        for (i = 0; i < thread_count; ++i) {
+            ly_err_free(pt[i].err);
+        }
+    }
+    free(pt);
+    free(tids);
+    free(started);
+    free(ctx_pos);
+    free(satisfied);
+    return ret;
+}
+
+/**
+ * @brief Evaluate Predicate. Logs directly on error.
+ *
+ * [7] Predicate ::= '[' Expr ']'
+ *
+ * @param[in] exp Parsed XPath expression.
+ * @param[in] exp_idx Position in the expression \p exp.
+ * @param[in] cur_node Start node for the expression \p exp.
+ * @param[in,out] set Context and result set. On NULL the rule is only parsed.
+ * @param[in] options Whether to apply data node access restrictions defined for 'when' and 'must' evaluation.
+ *
+ * @return EXIT_SUCCESS on success, EXIT_FAILURE on unresolved when, -1 on error.
+ */
+static int
+eval_predicate(struct lyxp_expr *exp, uint16_t *exp_idx, struct lyd_node *cur_node, struct lys_module *local_mod,
+               struct lyxp_set *set, int options, int parent_pos_pred)
+{
+    int ret, satisfied;
+    uint16_t orig_exp, brack2_exp, open_brack;
+    uint32_t i, j, orig_pos, orig_size, pred_in_ctx;
+    struct lyxp_set set2;
+    struct lyd_node *orig_parent;
+
+    /* '[' */
+    LOGDBG(LY_LDGXPATH, "%-27s %s %s[%u]", __func__, (set ? "parsed" : "skipped"),
+           print_token(exp->tokens[*exp_idx]), exp->expr_pos[*exp_idx]);
+    ++(*exp_idx);
+
+    if (!set) {
 only_parse:
         ret = eval_expr_select(exp, exp_idx, 0, cur_node, local_mod, NULL, options);
         if (ret == -1 || ret == EXIT_FAILURE) {
@@ -6939,6 +8627,9 @@ only_parse:
         }
     } else if (set->type == LYXP_SET_NODE_SET) {
         /* we (possibly) need the set sorted, it can affect the result (if the predicate result is a number) */
+        if (set_order(set, cur_node, options)) {
+            return -1;
+        }
         assert(!set_sort(set, cur_node, options));
 
         /* empty set, nothing to evaluate */
@@ -6958,12 +8649,19 @@ only_parse:
             }
         }
 
+        ret = eval_predicate_threads(exp, orig_exp, cur_node, local_mod, set, options, parent_pos_pred);
+        if (ret != 2) {
+            if (ret) {
+                return ret;
+            }
+            *exp_idx = brack2_exp;
+            goto brack2;
+        }
+
         orig_pos = 0;
         orig_size = set->used;
         orig_parent = NULL;
-        for (i = 0; i < set->used; ) {
-            memset(&set2, 0, sizeof set2);
-            set_insert_node(&set2, set->val.nodes[i].node, set->val.nodes[i].pos, set->val.nodes[i].type, 0);
+        for (i = 0, j = 0; i < orig_size; ++i) {
             /* remember the node context position for position() and context size for last(),
              * predicates should always be evaluated with respect to the child axis (since we do
              * not support explicit axes) so we assign positions based on their parents */
@@ -6974,33 +8672,27 @@ only_parse:
                 ++orig_pos;
             }
 
-            set2.ctx_pos = orig_pos;
-            set2.ctx_size = orig_size;
             *exp_idx = orig_exp;
-
-            ret = eval_expr_select(exp, exp_idx, 0, cur_node, local_mod, &set2, options);
-            if (ret == -1 || ret == EXIT_FAILURE) {
-                lyxp_set_cast(&set2, LYXP_SET_EMPTY, cur_node, local_mod, options);
+            ret = eval_predicate_node(exp, exp_idx, cur_node, local_mod, &set->val.nodes[i], orig_pos, orig_size,
+                                      options, &satisfied);
+            if (ret) {
                 return ret;
             }
 
-            /* number is a position */
-            if (set2.type == LYXP_SET_NUMBER) {
-                if ((long long)set2.val.num == orig_pos) {
-                    set2.val.num = 1;
-                } else {
-                    set2.val.num = 0;
-                }
-            }
-            lyxp_set_cast(&set2, LYXP_SET_BOOLEAN, cur_node, local_mod, options);
-
-            /* predicate satisfied or not? */
-            if (set2.val.bool) {
-                ++i;
+            /* predicate satisfied or not, the satisfied nodes are moved in place */
+            if (satisfied) {
+                set->val.nodes[j++] = set->val.nodes[i];
             } else {
-                set_remove_node(set, i);
+#ifdef LY_ENABLED_CACHE
+                set_remove_node_hash(set, set->val.nodes[i].node, set->val.nodes[i].type);
+#endif
             }
         }
+        set->used = j;
+        if (!set->used) {
+            set_free_content(set);
+            memset(set, 0, sizeof *set);
+        }
 
     } else if (set->type == LYXP_SET_SNODE_SET) {
         for (i = 0; i < set->used; ++i) {
@@ -7072,6 +8764,7 @@ only_parse:
         lyxp_set_cast(&set2, LYXP_SET_EMPTY, cur_node, local_mod, options);
     }
 
+brack2:
     /* ']' */
     assert(exp->tokens[*exp_idx] == LYXP_TOKEN_BRACK2);
     LOGDBG(LY_LDGXPATH, "%-27s %s %s[%u]", __func__, (set ? "parsed" : "skipped"),
@@ -7100,7 +8793,7 @@ static int
 eval_relative_location_path(struct lyxp_expr *exp, uint16_t *exp_idx, struct lyd_node *cur_node, struct lys_module *local_mod,
                             int all_desc, struct lyxp_set *set, int options)
 {
-    int attr_axis, ret;
+    int attr_axis, ret, step_options;
 
     goto step;
     do {
@@ -7118,13 +8811,14 @@ eval_relative_location_path(struct lyxp_expr *exp, uint16_t *exp_idx, struct lyd
 step:
         /* Step */
         attr_axis = 0;
+        step_options = options & ~LYXP_EXISTS;
         switch (exp->tokens[*exp_idx]) {
         case LYXP_TOKEN_DOT:
             /* evaluate '.' */
             if (set && (options & LYXP_SNODE_ALL)) {
                 ret = moveto_snode_self(set, (struct lys_node *)cur_node, all_desc, options);
             } else {
-                ret = moveto_self(set, cur_node, all_desc, options);
+                ret = moveto_self(set, cur_node, all_desc, step_options);
             }
             if (ret) {
                 return ret;
@@ -7139,7 +8833,7 @@ step:
             if (set && (options & LYXP_SNODE_ALL)) {
                 ret = moveto_snode_parent(set, (struct lys_node *)cur_node, all_desc, options);
             } else {
-                ret = moveto_parent(set, cur_node, all_desc, options);
+                ret = moveto_parent(set, cur_node, all_desc, step_options);
             }
             if (ret) {
                 return ret;
@@ -7159,13 +8853,33 @@ step:
             /* fall through */
         case LYXP_TOKEN_NAMETEST:
         case LYXP_TOKEN_NODETYPE:
-            ret = eval_node_test(exp, exp_idx, cur_node, local_mod, attr_axis, all_desc, set, options);
+            if ((options & LYXP_EXISTS) && !attr_axis && (exp->tokens[*exp_idx] == LYXP_TOKEN_NAMETEST)
+                    && ((exp->used == *exp_idx + 1) || ((exp->tokens[*exp_idx + 1] != LYXP_TOKEN_BRACK1)
+                    && (exp->tokens[*exp_idx + 1] != LYXP_TOKEN_OPERATOR_PATH)))) {
+                /* last step without predicates, the first node found is enough */
+                step_options = options;
+            }
+
+            ret = 1;
+#ifdef LY_ENABLED_CACHE
+            if (set && !attr_axis && !all_desc && !(options & LYXP_SNODE_ALL)
+                    && (exp->tokens[*exp_idx] == LYXP_TOKEN_NAMETEST)) {
+                /* list instance selected by its keys, use the hash tables */
+                ret = moveto_node_keys(exp, exp_idx, cur_node, set, step_options);
+                if (ret == -1) {
+                    return ret;
+                }
+            }
+#endif
             if (ret) {
-                return ret;
+                ret = eval_node_test(exp, exp_idx, cur_node, local_mod, attr_axis, all_desc, set, step_options);
+                if (ret) {
+                    return ret;
+                }
             }
 
             while ((exp->used > *exp_idx) && (exp->tokens[*exp_idx] == LYXP_TOKEN_BRACK1)) {
-                ret = eval_predicate(exp, exp_idx, cur_node, local_mod, set, options, 1);
+                ret = eval_predicate(exp, exp_idx, cur_node, local_mod, set, step_options, 1);
                 if (ret) {
                     return ret;
                 }
@@ -7252,6 +8966,394 @@ eval_absolute_location_path(struct lyxp_expr *exp, uint16_t *exp_idx, struct lyd
     return EXIT_SUCCESS;
 }
 
+/**
+ * @brief Evaluate AbsoluteLocationPath in a predicate, only once during a top-level evaluation. Logs directly on error.
+ *
+ * @param[in] exp Parsed XPath expression.
+ * @param[in] exp_idx Position in the expression \p exp.
+ * @param[in] cur_node Start node for the expression \p exp.
+ * @param[in,out] set Context and result set.
+ * @param[in] options Whether to apply data node access restrictions defined for 'when' and 'must' evaluation.
+ *
+ * @return EXIT_SUCCESS on success, EXIT_FAILURE on unresolved when, -1 on error.
+ */
+static int
+eval_absolute_location_path_cached(struct lyxp_expr *exp, uint16_t *exp_idx, struct lyd_node *cur_node,
+                                   struct lys_module *local_mod, struct lyxp_set *set, int options)
+{
+    struct lyxp_abs_cache *cache = lyxp_abs.cache;
+    uint16_t i, start = *exp_idx;
+    int ret;
+
+    for (i = 0; i < cache->count; ++i) {
+        if ((cache->paths[i].exp == exp) && (cache->paths[i].start == start) && (cache->paths[i].options == options)) {
+            set_fill_set(set, &cache->paths[i].set);
+            *exp_idx = cache->paths[i].end;
+            return EXIT_SUCCESS;
+        }
+    }
+
+    ret = eval_absolute_location_path(exp, exp_idx, cur_node, local_mod, set, options);
+    if (!ret && (cache->count < LYXP_ABS_CACHE_SIZE)) {
+        i = cache->count++;
+        cache->paths[i].exp = exp;
+        cache->paths[i].start = start;
+        cache->paths[i].end = *exp_idx;
+        cache->paths[i].options = options;
+        memset(&cache->paths[i].set, 0, sizeof cache->paths[i].set);
+        set_fill_set(&cache->paths[i].set, set);
+    }
+
+    return ret;
+}
+
+/**
+ * @brief Check whether a token is the name of a specific function.
+ *
+ * @param[in] exp Parsed XPath expression.
+ * @param[in] exp_idx Position of the token in the expression \p exp.
+ * @param[in] name Function name.
+ * @return 1 if it is, 0 otherwise.
+ */
+static int
+memo_tok_func(struct lyxp_expr *exp, uint16_t exp_idx, const char *name)
+{
+    return (exp->tokens[exp_idx] == LYXP_TOKEN_FUNCNAME) && (exp->tok_len[exp_idx] == strlen(name))
+            && !strncmp(&exp->expr[exp->expr_pos[exp_idx]], name, exp->tok_len[exp_idx]);
+}
+
+/**
+ * @brief Check whether the remembered paths are the same. Callback for the memo hash table.
+ */
+static int
+memo_path_equal_cb(void *val1_p, void *val2_p, int UNUSED(mod), void *UNUSED(cb_data))
+{
+    struct lyxp_memo_path *path1 = *(struct lyxp_memo_path **)val1_p, *path2 = *(struct lyxp_memo_path **)val2_p;
+
+    return (path1->node == path2->node) && (path1->cur_node == path2->cur_node) && (path1->dummy == path2->dummy)
+            && (path1->hide_snode == path2->hide_snode) && (path1->hide_parent == path2->hide_parent)
+            && (path1->local_mod == path2->local_mod) && (path1->options == path2->options)
+            && (path1->root_config == path2->root_config) && (path1->expr_len == path2->expr_len)
+            && !strncmp(path1->expr, path2->expr, path1->expr_len);
+}
+
+/**
+ * @brief Check whether a dummy node can be reached by a path. It cannot if the path consists only of child steps
+ * and the first one does not select the ancestor of the node.
+ *
+ * @param[in] exp Parsed XPath expression.
+ * @param[in] start First token of the path, evaluated from \p node.
+ * @param[in] end Token following the path.
+ * @param[in] node Node the path starts from.
+ * @param[in] dummy Dummy node.
+ * @return 1 if it can, 0 otherwise.
+ */
+static int
+memo_path_reaches(struct lyxp_expr *exp, uint16_t start, uint16_t end, const struct lyd_node *node,
+                  const struct lyd_node *dummy)
+{
+    const struct lyd_node *anc;
+    const char *name;
+    uint16_t i, name_len;
+
+    for (anc = dummy; anc->parent && (anc->parent != node); anc = anc->parent);
+    if (anc->parent != node) {
+        return 1;
+    }
+    if (start == end) {
+        /* selects only the start node */
+        return 0;
+    }
+
+    for (i = start; i < end; ++i) {
+        if ((exp->tokens[i] == LYXP_TOKEN_OPERATOR_PATH) && (exp->tok_len[i] == 1)) {
+            continue;
+        }
+        if (exp->tokens[i] != LYXP_TOKEN_NAMETEST) {
+            return 1;
+        }
+    }
+
+    name = &exp->expr[exp->expr_pos[start]];
+    name_len = exp->tok_len[start];
+    for (i = 0; i < name_len; ++i) {
+        if (name[i] == ':') {
+            name += i + 1;
+            name_len -= i + 1;
+            break;
+        }
+    }
+    if (((name_len == 1) && (name[0] == '*')) || (!strncmp(anc->schema->name, name, name_len) && !anc->schema->name[name_len])) {
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Evaluate PathExpr, which is either a RelativeLocationPath of the top-level expression or a RelativeLocationPath
+ * following current(), only once for the node it starts from while the thread remembers the paths, see lyxp_memo_set().
+ * Logs directly on error.
+ *
+ * @param[in] exp Parsed XPath expression.
+ * @param[in] exp_idx Position in the expression \p exp.
+ * @param[in] cur_node Start node for the expression \p exp.
+ * @param[in,out] set Context and result set.
+ * @param[in] options Whether to apply data node access restrictions defined for 'when' and 'must' evaluation.
+ *
+ * @return EXIT_SUCCESS on success, EXIT_FAILURE on unresolved when, -1 on error, 2 if the path cannot be remembered.
+ */
+static int
+eval_path_expr_memo(struct lyxp_expr *exp, uint16_t *exp_idx, struct lyd_node *cur_node, struct lys_module *local_mod,
+                    struct lyxp_set *set, int options)
+{
+    struct lyxp_memo_path key, *path, **match;
+    struct lyd_node *node;
+    uint16_t idx = *exp_idx, end, i;
+    uint32_t hash;
+    int ret, last = 0;
+
+    if (!cur_node) {
+        return 2;
+    }
+
+    if (exp->tokens[idx] == LYXP_TOKEN_FUNCNAME) {
+        /* current() '/' RelativeLocationPath */
+        if ((exp->used < idx + 5) || !memo_tok_func(exp, idx, "current") || (exp->tokens[idx + 2] != LYXP_TOKEN_PAR2)
+                || (exp->tokens[idx + 3] != LYXP_TOKEN_OPERATOR_PATH) || (exp->tok_len[idx + 3] != 1)) {
+            return 2;
+        }
+        node = cur_node;
+        idx += 4;
+    } else {
+        /* in predicates, the path is evaluated for many different nodes */
+        if (lyxp_abs.pred_depth || (set->type != LYXP_SET_NODE_SET) || (set->used != 1)
+                || (set->val.nodes[0].type != LYXP_NODE_ELEM)) {
+            return 2;
+        }
+        node = set->val.nodes[0].node;
+    }
+
+    /* leading '..' steps only move to the parent, remember the rest of the path so that the children share it */
+    while ((exp->tokens[idx] == LYXP_TOKEN_DDOT) && node->parent) {
+        if ((exp->used > idx + 1) && (exp->tokens[idx + 1] == LYXP_TOKEN_OPERATOR_PATH)) {
+            if (exp->tok_len[idx + 1] != 1) {
+                break;
+            }
+        } else {
+            last = 1;
+        }
+        if ((options & LYXP_WHEN) && !LYD_WHEN_DONE(node->parent->when_status)) {
+            return 2;
+        }
+
+        node = node->parent;
+        idx += (last ? 1 : 2);
+        if (last) {
+            break;
+        }
+    }
+
+    /* find the end of the path */
+    end = idx;
+    if (!last) {
+        ret = eval_relative_location_path(exp, &end, cur_node, local_mod, 0, NULL, options);
+        if (ret) {
+            return ret;
+        }
+    }
+
+    memset(&key, 0, sizeof key);
+    for (i = idx; i < end; ++i) {
+        if (memo_tok_func(exp, i, "deref")) {
+            /* the leafref targets are resolved after the when conditions */
+            return 2;
+        } else if (memo_tok_func(exp, i, "current")) {
+            key.cur_node = cur_node;
+        }
+    }
+    key.expr = (end > idx) ? &exp->expr[exp->expr_pos[idx]] : "";
+    key.expr_len = (end > idx) ? exp->expr_pos[end - 1] + exp->tok_len[end - 1] - exp->expr_pos[idx] : 0;
+    key.node = node;
+    if ((cur_node->validity & LYD_VAL_INUSE) && memo_path_reaches(exp, idx, end, node, cur_node)) {
+        key.dummy = cur_node;
+    }
+    key.hide_snode = lyxp_hide.snode;
+    key.hide_parent = lyxp_hide.parent;
+    key.local_mod = local_mod;
+    key.options = options & ~LYXP_EXISTS;
+    key.root_config = (options & (LYXP_MUST | LYXP_WHEN)) && (cur_node->schema->flags & LYS_CONFIG_W);
+
+    hash = dict_hash_multi(0, key.expr, key.expr_len);
+    hash = dict_hash_multi(hash, (const char *)&key.node, sizeof key.node);
+    hash = dict_hash_multi(hash, NULL, 0);
+
+    lyxp_set_cast(set, LYXP_SET_EMPTY, cur_node, local_mod, options);
+
+    path = &key;
+    if (lyxp_memo->paths && !lyht_find(lyxp_memo->paths, &path, hash, (void **)&match)) {
+        set_fill_set(set, &(*match)->set);
+        *exp_idx = end;
+        return EXIT_SUCCESS;
+    }
+
+    /* the complete node set is remembered */
+    set_insert_node(set, node, 0, LYXP_NODE_ELEM, 0);
+    if (end > idx) {
+        ret = eval_relative_location_path(exp, &idx, cur_node, local_mod, 0, set, key.options);
+        if (ret) {
+            return ret;
+        }
+    }
+    *exp_idx = end;
+
+    if (lyxp_memo->paths && (lyxp_memo->paths->used >= LYXP_MEMO_MAX_PATHS)) {
+        return EXIT_SUCCESS;
+    }
+    if (!lyxp_memo->paths) {
+        lyxp_memo->paths = lyht_new(64, sizeof path, memo_path_equal_cb, NULL, 1);
+        LY_CHECK_ERR_RETURN(!lyxp_memo->paths, LOGMEM(local_mod->ctx), -1);
+    }
+
+    path = malloc(sizeof *path + key.expr_len);
+    LY_CHECK_ERR_RETURN(!path, LOGMEM(local_mod->ctx), -1);
+    *path = key;
+    path->expr = memcpy(path + 1, key.expr, key.expr_len);
+    set_fill_set(&path->set, set);
+    path->next = lyxp_memo->first;
+    lyxp_memo->first = path;
+    lyht_insert(lyxp_memo->paths, &path, hash, NULL);
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Get the implementation of an XPath function.
+ *
+ * @param[in] name Function name, not terminated.
+ * @param[in] name_len Length of \p name.
+ *
+ * @return Function callback, NULL if there is no such function.
+ */
+static lyxp_func_clb
+get_xpath_func(const char *name, uint16_t name_len)
+{
+    lyxp_func_clb xpath_func = NULL;
+
+    switch (name_len) {
+    case 3:
+        if (!strncmp(name, "not", 3)) {
+            xpath_func = &xpath_not;
+        } else if (!strncmp(name, "sum", 3)) {
+            xpath_func = &xpath_sum;
+        }
+        break;
+    case 4:
+        if (!strncmp(name, "lang", 4)) {
+            xpath_func = &xpath_lang;
+        } else if (!strncmp(name, "last", 4)) {
+            xpath_func = &xpath_last;
+        } else if (!strncmp(name, "name", 4)) {
+            xpath_func = &xpath_name;
+        } else if (!strncmp(name, "true", 4)) {
+            xpath_func = &xpath_true;
+        }
+        break;
+    case 5:
+        if (!strncmp(name, "count", 5)) {
+            xpath_func = &xpath_count;
+        } else if (!strncmp(name, "false", 5)) {
+            xpath_func = &xpath_false;
+        } else if (!strncmp(name, "floor", 5)) {
+            xpath_func = &xpath_floor;
+        } else if (!strncmp(name, "round", 5)) {
+            xpath_func = &xpath_round;
+        } else if (!strncmp(name, "deref", 5)) {
+            xpath_func = &xpath_deref;
+        }
+        break;
+    case 6:
+        if (!strncmp(name, "concat", 6)) {
+            xpath_func = &xpath_concat;
+        } else if (!strncmp(name, "number", 6)) {
+            xpath_func = &xpath_number;
+        } else if (!strncmp(name, "string", 6)) {
+            xpath_func = &xpath_string;
+        }
+        break;
+    case 7:
+        if (!strncmp(name, "boolean", 7)) {
+            xpath_func = &xpath_boolean;
+        } else if (!strncmp(name, "ceiling", 7)) {
+            xpath_func = &xpath_ceiling;
+        } else if (!strncmp(name, "current", 7)) {
+            xpath_func = &xpath_current;
+        }
+        break;
+    case 8:
+        if (!strncmp(name, "contains", 8)) {
+            xpath_func = &xpath_contains;
+        } else if (!strncmp(name, "position", 8)) {
+            xpath_func = &xpath_position;
+        } else if (!strncmp(name, "re-match", 8)) {
+            xpath_func = &xpath_re_match;
+        }
+        break;
+    case 9:
+        if (!strncmp(name, "substring", 9)) {
+            xpath_func = &xpath_substring;
+        } else if (!strncmp(name, "translate", 9)) {
+            xpath_func = &xpath_translate;
+        }
+        break;
+    case 10:
+        if (!strncmp(name, "local-name", 10)) {
+            xpath_func = &xpath_local_name;
+        } else if (!strncmp(name, "enum-value", 10)) {
+            xpath_func = &xpath_enum_value;
+        } else if (!strncmp(name, "bit-is-set", 10)) {
+            xpath_func = &xpath_bit_is_set;
+        }
+        break;
+    case 11:
+        if (!strncmp(name, "starts-with", 11)) {
+            xpath_func = &xpath_starts_with;
+        }
+        break;
+    case 12:
+        if (!strncmp(name, "derived-from", 12)) {
+            xpath_func = &xpath_derived_from;
+        }
+        break;
+    case 13:
+        if (!strncmp(name, "namespace-uri", 13)) {
+            xpath_func = &xpath_namespace_uri;
+        } else if (!strncmp(name, "string-length", 13)) {
+            xpath_func = &xpath_string_length;
+        }
+        break;
+    case 15:
+        if (!strncmp(name, "normalize-space", 15)) {
+            xpath_func = &xpath_normalize_space;
+        } else if (!strncmp(name, "substring-after", 15)) {
+            xpath_func = &xpath_substring_after;
+        }
+        break;
+    case 16:
+        if (!strncmp(name, "substring-before", 16)) {
+            xpath_func = &xpath_substring_before;
+        }
+        break;
+    case 20:
+        if (!strncmp(name, "derived-from-or-self", 20)) {
+            xpath_func = &xpath_derived_from_or_self;
+        }
+        break;
+    }
+
+    return xpath_func;
+}
+
 /**
  * @brief Evaluate FunctionCall. Logs directly on error.
  *
@@ -7269,122 +9371,18 @@ static int
 eval_function_call(struct lyxp_expr *exp, uint16_t *exp_idx, struct lyd_node *cur_node, struct lys_module *local_mod,
                    struct lyxp_set *set, int options)
 {
-    int rc = EXIT_FAILURE;
-    int (*xpath_func)(struct lyxp_set **, uint16_t, struct lyd_node *, struct lys_module *, struct lyxp_set *, int) = NULL;
+    int rc = EXIT_FAILURE, arg_options;
+    lyxp_func_clb xpath_func = NULL;
     uint16_t arg_count = 0, i, func_exp = *exp_idx;
     struct lyxp_set **args = NULL, **args_aux;
 
     if (set) {
         /* FunctionName */
-        switch (exp->tok_len[*exp_idx]) {
-        case 3:
-            if (!strncmp(&exp->expr[exp->expr_pos[*exp_idx]], "not", 3)) {
-                xpath_func = &xpath_not;
-            } else if (!strncmp(&exp->expr[exp->expr_pos[*exp_idx]], "sum", 3)) {
-                xpath_func = &xpath_sum;
-            }
-            break;
-        case 4:
-            if (!strncmp(&exp->expr[exp->expr_pos[*exp_idx]], "lang", 4)) {
-                xpath_func = &xpath_lang;
-            } else if (!strncmp(&exp->expr[exp->expr_pos[*exp_idx]], "last", 4)) {
-                xpath_func = &xpath_last;
-            } else if (!strncmp(&exp->expr[exp->expr_pos[*exp_idx]], "name", 4)) {
-                xpath_func = &xpath_name;
-            } else if (!strncmp(&exp->expr[exp->expr_pos[*exp_idx]], "true", 4)) {
-                xpath_func = &xpath_true;
-            }
-            break;
-        case 5:
-            if (!strncmp(&exp->expr[exp->expr_pos[*exp_idx]], "count", 5)) {
-                xpath_func = &xpath_count;
-            } else if (!strncmp(&exp->expr[exp->expr_pos[*exp_idx]], "false", 5)) {
-                xpath_func = &xpath_false;
-            } else if (!strncmp(&exp->expr[exp->expr_pos[*exp_idx]], "floor", 5)) {
-                xpath_func = &xpath_floor;
-            } else if (!strncmp(&exp->expr[exp->expr_pos[*exp_idx]], "round", 5)) {
-                xpath_func = &xpath_round;
-            } else if (!strncmp(&exp->expr[exp->expr_pos[*exp_idx]], "deref", 5)) {
-                xpath_func = &xpath_deref;
-            }
-            break;
-        case 6:
-            if (!strncmp(&exp->expr[exp->expr_pos[*exp_idx]], "concat", 6)) {
-                xpath_func = &xpath_concat;
-            } else if (!strncmp(&exp->expr[exp->expr_pos[*exp_idx]], "number", 6)) {
-                xpath_func = &xpath_number;
-            } else if (!strncmp(&exp->expr[exp->expr_pos[*exp_idx]], "string", 6)) {
-                xpath_func = &xpath_string;
-            }
-            break;
-        case 7:
-            if (!strncmp(&exp->expr[exp->expr_pos[*exp_idx]], "boolean", 7)) {
-                xpath_func = &xpath_boolean;
-            } else if (!strncmp(&exp->expr[exp->expr_pos[*exp_idx]], "ceiling", 7)) {
-                xpath_func = &xpath_ceiling;
-            } else if (!strncmp(&exp->expr[exp->expr_pos[*exp_idx]], "current", 7)) {
-                xpath_func = &xpath_current;
-            }
-            break;
-        case 8:
-            if (!strncmp(&exp->expr[exp->expr_pos[*exp_idx]], "contains", 8)) {
-                xpath_func = &xpath_contains;
-            } else if (!strncmp(&exp->expr[exp->expr_pos[*exp_idx]], "position", 8)) {
-                xpath_func = &xpath_position;
-            } else if (!strncmp(&exp->expr[exp->expr_pos[*exp_idx]], "re-match", 8)) {
-                xpath_func = &xpath_re_match;
-            }
-            break;
-        case 9:
-            if (!strncmp(&exp->expr[exp->expr_pos[*exp_idx]], "substring", 9)) {
-                xpath_func = &xpath_substring;
-            } else if (!strncmp(&exp->expr[exp->expr_pos[*exp_idx]], "translate", 9)) {
-                xpath_func = &xpath_translate;
-            }
-            break;
-        case 10:
-            if (!strncmp(&exp->expr[exp->expr_pos[*exp_idx]], "local-name", 10)) {
-                xpath_func = &xpath_local_name;
-            } else if (!strncmp(&exp->expr[exp->expr_pos[*exp_idx]], "enum-value", 10)) {
-                xpath_func = &xpath_enum_value;
-            } else if (!strncmp(&exp->expr[exp->expr_pos[*exp_idx]], "bit-is-set", 10)) {
-                xpath_func = &xpath_bit_is_set;
-            }
-            break;
-        case 11:
-            if (!strncmp(&exp->expr[exp->expr_pos[*exp_idx]], "starts-with", 11)) {
-                xpath_func = &xpath_starts_with;
-            }
-            break;
-        case 12:
-            if (!strncmp(&exp->expr[exp->expr_pos[*exp_idx]], "derived-from", 12)) {
-                xpath_func = &xpath_derived_from;
-            }
-            break;
-        case 13:
-            if (!strncmp(&exp->expr[exp->expr_pos[*exp_idx]], "namespace-uri", 13)) {
-                xpath_func = &xpath_namespace_uri;
-            } else if (!strncmp(&exp->expr[exp->expr_pos[*exp_idx]], "string-length", 13)) {
-                xpath_func = &xpath_string_length;
-            }
-            break;
-        case 15:
-            if (!strncmp(&exp->expr[exp->expr_pos[*exp_idx]], "normalize-space", 15)) {
-                xpath_func = &xpath_normalize_space;
-            } else if (!strncmp(&exp->expr[exp->expr_pos[*exp_idx]], "substring-after", 15)) {
-                xpath_func = &xpath_substring_after;
-            }
-            break;
-        case 16:
-            if (!strncmp(&exp->expr[exp->expr_pos[*exp_idx]], "substring-before", 16)) {
-                xpath_func = &xpath_substring_before;
-            }
-            break;
-        case 20:
-            if (!strncmp(&exp->expr[exp->expr_pos[*exp_idx]], "derived-from-or-self", 20)) {
-                xpath_func = &xpath_derived_from_or_self;
-            }
-            break;
+        if (exp->tok_data && exp->tok_data[*exp_idx].func) {
+            /* found during the compilation */
+            xpath_func = exp->tok_data[*exp_idx].func;
+        } else {
+            xpath_func = get_xpath_func(&exp->expr[exp->expr_pos[*exp_idx]], exp->tok_len[*exp_idx]);
         }
 
         if (!xpath_func) {
@@ -7405,6 +9403,14 @@ eval_function_call(struct lyxp_expr *exp, uint16_t *exp_idx, struct lyd_node *cu
                print_token(exp->tokens[*exp_idx]), exp->expr_pos[*exp_idx]);
     ++(*exp_idx);
 
+    /* arguments of not() and boolean() are cast to boolean, the others need complete node sets */
+    if (((xpath_func == &xpath_not) || (xpath_func == &xpath_boolean)) && !(options & LYXP_SNODE_ALL)) {
+        arg_options = options | LYXP_EXISTS;
+    } else {
+        arg_options = options & ~LYXP_EXISTS;
+    }
+    options &= ~LYXP_EXISTS;
+
     /* ( Expr ( ',' Expr )* )? */
     if (exp->tokens[*exp_idx] != LYXP_TOKEN_PAR2) {
         if (set) {
@@ -7416,12 +9422,12 @@ eval_function_call(struct lyxp_expr *exp, uint16_t *exp_idx, struct lyd_node *cu
                 goto cleanup;
             }
 
-            rc = eval_expr_select(exp, exp_idx, 0, cur_node, local_mod, args[0], options);
+            rc = eval_expr_select(exp, exp_idx, 0, cur_node, local_mod, args[0], arg_options);
             if (rc == -1 || rc == EXIT_FAILURE) {
                 goto cleanup;
             }
         } else {
-            rc = eval_expr_select(exp, exp_idx, 0, cur_node, local_mod, NULL, options);
+            rc = eval_expr_select(exp, exp_idx, 0, cur_node, local_mod, NULL, arg_options);
             if (rc == -1 || rc == EXIT_FAILURE) {
                 goto cleanup;
             }
@@ -7442,12 +9448,12 @@ eval_function_call(struct lyxp_expr *exp, uint16_t *exp_idx, struct lyd_node *cu
                 goto cleanup;
             }
 
-            rc = eval_expr_select(exp, exp_idx, 0, cur_node, local_mod, args[arg_count - 1], options);
+            rc = eval_expr_select(exp, exp_idx, 0, cur_node, local_mod, args[arg_count - 1], arg_options);
             if (rc == -1 || rc == EXIT_FAILURE) {
                 goto cleanup;
             }
         } else {
-            rc = eval_expr_select(exp, exp_idx, 0, cur_node, local_mod, NULL, options);
+            rc = eval_expr_select(exp, exp_idx, 0, cur_node, local_mod, NULL, arg_options);
             if (rc == -1 || rc == EXIT_FAILURE) {
                 goto cleanup;
             }
@@ -7505,9 +9511,16 @@ static int
 eval_number(struct ly_ctx *ctx, struct lyxp_expr *exp, uint16_t *exp_idx, struct lyxp_set *set)
 {
     long double num;
+    int64_t inum, dec;
+    uint8_t dig;
     char *endptr;
 
     if (set) {
+        if (cast_string_to_int(&exp->expr[exp->expr_pos[*exp_idx]], exp->tok_len[*exp_idx], &inum)) {
+            set_fill_int(set, inum);
+            goto print;
+        }
+
         errno = 0;
         num = strtold(&exp->expr[exp->expr_pos[*exp_idx]], &endptr);
         if (errno) {
@@ -7523,8 +9536,14 @@ eval_number(struct ly_ctx *ctx, struct lyxp_expr *exp, uint16_t *exp_idx, struct
         }
 
         set_fill_number(set, num);
+        if (cast_string_to_dec(&exp->expr[exp->expr_pos[*exp_idx]], exp->tok_len[*exp_idx], &dec, &dig)) {
+            /* remember the exact value */
+            set->num_dig = dig;
+            set->num_dec = dec;
+        }
     }
 
+print:
     LOGDBG(LY_LDGXPATH, "%-27s %s %s[%u]", __func__, (set ? "parsed" : "skipped"),
                print_token(exp->tokens[*exp_idx]), exp->expr_pos[*exp_idx]);
     ++(*exp_idx);
@@ -7552,7 +9571,8 @@ static int
 eval_path_expr(struct lyxp_expr *exp, uint16_t *exp_idx, struct lyd_node *cur_node, struct lys_module *local_mod,
                struct lyxp_set *set, int options)
 {
-    int all_desc, ret, parent_pos_pred;
+    int all_desc, ret, parent_pos_pred, expr_options;
+    uint16_t par2_exp, open_par;
 
     switch (exp->tokens[*exp_idx]) {
     case LYXP_TOKEN_PAR1:
@@ -7563,8 +9583,27 @@ eval_path_expr(struct lyxp_expr *exp, uint16_t *exp_idx, struct lyd_node *cur_no
                print_token(exp->tokens[*exp_idx]), exp->expr_pos[*exp_idx]);
         ++(*exp_idx);
 
+        expr_options = options & ~LYXP_EXISTS;
+        if (options & LYXP_EXISTS) {
+            /* find the closing parenthesis */
+            open_par = 0;
+            for (par2_exp = *exp_idx; open_par || (exp->tokens[par2_exp] != LYXP_TOKEN_PAR2); ++par2_exp) {
+                if (exp->tokens[par2_exp] == LYXP_TOKEN_PAR1) {
+                    ++open_par;
+                } else if (exp->tokens[par2_exp] == LYXP_TOKEN_PAR2) {
+                    --open_par;
+                }
+            }
+
+            /* the whole set is needed only for predicates or further steps */
+            if ((exp->used == par2_exp + 1) || ((exp->tokens[par2_exp + 1] != LYXP_TOKEN_BRACK1)
+                    && (exp->tokens[par2_exp + 1] != LYXP_TOKEN_OPERATOR_PATH))) {
+                expr_options = options;
+            }
+        }
+
         /* Expr */
-        ret = eval_expr_select(exp, exp_idx, 0, cur_node, local_mod, set, options);
+        ret = eval_expr_select(exp, exp_idx, 0, cur_node, local_mod, set, expr_options);
         if (ret == -1 || ret == EXIT_FAILURE) {
             return ret;
         }
@@ -7584,6 +9623,12 @@ eval_path_expr(struct lyxp_expr *exp, uint16_t *exp_idx, struct lyd_node *cur_no
     case LYXP_TOKEN_NAMETEST:
     case LYXP_TOKEN_NODETYPE:
         /* RelativeLocationPath */
+        if (set && lyxp_memo && !(options & LYXP_SNODE_ALL)) {
+            ret = eval_path_expr_memo(exp, exp_idx, cur_node, local_mod, set, options);
+            if (ret != 2) {
+                return ret;
+            }
+        }
         ret = eval_relative_location_path(exp, exp_idx, cur_node, local_mod, 0, set, options);
         if (ret) {
             return ret;
@@ -7592,6 +9637,13 @@ eval_path_expr(struct lyxp_expr *exp, uint16_t *exp_idx, struct lyd_node *cur_no
 
     case LYXP_TOKEN_FUNCNAME:
         /* FunctionCall */
+        if (set && lyxp_memo && !(options & LYXP_SNODE_ALL)) {
+            /* current() '/' RelativeLocationPath */
+            ret = eval_path_expr_memo(exp, exp_idx, cur_node, local_mod, set, options);
+            if (ret != 2) {
+                return ret;
+            }
+        }
         if (!set) {
             ret = eval_function_call(exp, exp_idx, cur_node, local_mod, NULL, options);
         } else {
@@ -7606,7 +9658,12 @@ eval_path_expr(struct lyxp_expr *exp, uint16_t *exp_idx, struct lyd_node *cur_no
 
     case LYXP_TOKEN_OPERATOR_PATH:
         /* AbsoluteLocationPath */
-        ret = eval_absolute_location_path(exp, exp_idx, cur_node, local_mod, set, options);
+        if (set && lyxp_abs.pred_depth && lyxp_abs.cache && !(options & (LYXP_SNODE_ALL | LYXP_EXISTS))) {
+            /* the same for all the nodes the predicate is evaluated for */
+            ret = eval_absolute_location_path_cached(exp, exp_idx, cur_node, local_mod, set, options);
+        } else {
+            ret = eval_absolute_location_path(exp, exp_idx, cur_node, local_mod, set, options);
+        }
         if (ret) {
             return ret;
         }
@@ -8163,6 +10220,11 @@ eval_and_expr(struct lyxp_expr *exp, uint16_t *exp_idx, uint16_t repeat, struct
 
     set_fill_set(&orig_set, set);
 
+    /* all the operands are cast to boolean */
+    if (!(options & LYXP_SNODE_ALL)) {
+        options |= LYXP_EXISTS;
+    }
+
     ret = eval_expr_select(exp, exp_idx, LYXP_EXPR_AND, cur_node, local_mod, set, options);
     if (ret) {
         goto finish;
@@ -8241,6 +10303,11 @@ eval_or_expr(struct lyxp_expr *exp, uint16_t *exp_idx, uint16_t repeat, struct l
 
     set_fill_set(&orig_set, set);
 
+    /* all the operands are cast to boolean */
+    if (!(options & LYXP_SNODE_ALL)) {
+        options |= LYXP_EXISTS;
+    }
+
     ret = eval_expr_select(exp, exp_idx, LYXP_EXPR_OR, cur_node, local_mod, set, options);
     if (ret) {
         goto finish;
@@ -8313,6 +10380,10 @@ eval_expr_select(struct lyxp_expr *exp, uint16_t *exp_idx, enum lyxp_expr_type e
     uint16_t i, count;
     enum lyxp_expr_type next_etype;
 
+    if (set && ly_eval_step(local_mod ? local_mod->ctx : NULL)) {
+        return -1;
+    }
+
     /* process operator repeats */
     if (!exp->repeat[*exp_idx]) {
         next_etype = LYXP_EXPR_NONE;
@@ -8330,6 +10401,12 @@ eval_expr_select(struct lyxp_expr *exp, uint16_t *exp_idx, enum lyxp_expr_type e
         }
     }
 
+    if ((next_etype != LYXP_EXPR_NONE) && (next_etype != LYXP_EXPR_OR) && (next_etype != LYXP_EXPR_AND)
+            && (next_etype != LYXP_EXPR_UNION)) {
+        /* the operands of all the other expressions need complete node sets */
+        options &= ~LYXP_EXISTS;
+    }
+
     /* decide what expression are we parsing based on the repeat */
     switch (next_etype) {
     case LYXP_EXPR_OR:
@@ -8365,57 +10442,262 @@ eval_expr_select(struct lyxp_expr *exp, uint16_t *exp_idx, enum lyxp_expr_type e
         break;
     }
 
-    return ret;
+    return ret;
+}
+
+/**
+ * @brief Resolve the modules and names of all the name tests and the functions of all the function calls
+ *        so that it is not done on every evaluation.
+ *
+ * @param[in] ctx Context for the modules and the dictionary.
+ * @param[in] exp Parsed XPath expression.
+ *
+ * @return EXIT_SUCCESS on success, -1 on error.
+ */
+static int
+compile_tok_data(struct ly_ctx *ctx, struct lyxp_expr *exp)
+{
+    uint16_t i, qname_len, pref_len;
+    const char *qname, *ptr;
+
+    exp->tok_data = calloc(exp->used, sizeof *exp->tok_data);
+    LY_CHECK_ERR_RETURN(!exp->tok_data, LOGMEM(ctx), -1);
+    exp->ctx = ctx;
+    exp->module_set_id = ctx->models.module_set_id;
+
+    for (i = 0; i < exp->used; ++i) {
+        qname = &exp->expr[exp->expr_pos[i]];
+        qname_len = exp->tok_len[i];
+
+        switch (exp->tokens[i]) {
+        case LYXP_TOKEN_NAMETEST:
+            if ((ptr = strnchr(qname, ':', qname_len))) {
+                pref_len = ptr - qname;
+                exp->tok_data[i].mod = moveto_resolve_model(qname, pref_len, ctx, NULL, 1, 0);
+                if (!exp->tok_data[i].mod) {
+                    /* leave it unresolved, the error is printed if it is ever evaluated */
+                    break;
+                }
+                qname += pref_len + 1;
+                qname_len -= pref_len + 1;
+            }
+            exp->tok_data[i].name = lydict_insert(ctx, qname, qname_len);
+            break;
+        case LYXP_TOKEN_FUNCNAME:
+            exp->tok_data[i].func = get_xpath_func(qname, qname_len);
+            break;
+        default:
+            break;
+        }
+    }
+
+    return EXIT_SUCCESS;
 }
 
-int
-lyxp_eval(const char *expr, const struct lyd_node *cur_node, enum lyxp_node_type cur_node_type,
-          const struct lys_module *local_mod, struct lyxp_set *set, int options)
+struct lyxp_expr *
+lyxp_compile_expr(struct ly_ctx *ctx, const char *expr)
 {
-    struct ly_ctx *ctx = local_mod ? local_mod->ctx : NULL;
     struct lyxp_expr *exp;
     uint16_t exp_idx = 0;
-    int rc = -1;
-
-    if (!expr || !set) {
-        LOGARG;
-        return EXIT_FAILURE;
-    }
 
     exp = lyxp_parse_expr(ctx, expr);
     if (!exp) {
-        rc = -1;
-        goto finish;
+        return NULL;
     }
 
-    rc = reparse_or_expr(ctx, exp, &exp_idx);
-    if (rc) {
-        goto finish;
+    if (reparse_or_expr(ctx, exp, &exp_idx)) {
+        goto error;
     } else if (exp->used > exp_idx) {
         LOGVAL(ctx, LYE_XPATH_INTOK, LY_VLOG_NONE, NULL, "Unknown", &exp->expr[exp->expr_pos[exp_idx]]);
         LOGVAL(ctx, LYE_SPEC, LY_VLOG_NONE, NULL, "Unparsed characters \"%s\" left at the end of an XPath expression.",
                &exp->expr[exp->expr_pos[exp_idx]]);
-        rc = -1;
-        goto finish;
+        goto error;
+    }
+
+    if (ctx && compile_tok_data(ctx, exp)) {
+        goto error;
     }
 
     print_expr_struct_debug(exp);
+    return exp;
+
+error:
+    lyxp_expr_free(exp);
+    return NULL;
+}
+
+struct lyxp_expr *
+lyxp_compile_expr_cached(struct ly_ctx *ctx, const char *expr, void **cache)
+{
+    struct lyxp_expr *exp, *prev = NULL;
+
+    exp = atomic_load_explicit((void * _Atomic *)cache, memory_order_acquire);
+    if (exp) {
+        return exp;
+    }
+
+    exp = lyxp_compile_expr(ctx, expr);
+    if (!exp) {
+        return NULL;
+    }
+
+    /* other threads may be compiling the same expression, the first one is used */
+    if (!atomic_compare_exchange_strong_explicit((void * _Atomic *)cache, (void **)&prev, exp, memory_order_acq_rel,
+                                                 memory_order_acquire)) {
+        lyxp_expr_free(exp);
+        exp = prev;
+    }
+    return exp;
+}
+
+int
+lyxp_eval_expr(const struct lyxp_expr *exp, const struct lyd_node *cur_node, enum lyxp_node_type cur_node_type,
+               const struct lys_module *local_mod, struct lyxp_set *set, int options)
+{
+    uint16_t exp_idx = 0, i;
+    int rc;
+    struct lyxp_abs_cache abs_cache, *prev_cache = lyxp_abs.cache;
+    uint32_t prev_depth = lyxp_abs.pred_depth;
+
+    assert(exp && set);
+
+    pool_enter();
+
+    /* nested evaluations have their own context */
+    abs_cache.count = 0;
+    lyxp_abs.cache = &abs_cache;
+    lyxp_abs.pred_depth = 0;
 
-    exp_idx = 0;
     memset(set, 0, sizeof *set);
     if (cur_node) {
         set_insert_node(set, (struct lyd_node *)cur_node, 0, cur_node_type, 0);
     }
 
-    rc = eval_expr_select(exp, &exp_idx, 0, (struct lyd_node *)cur_node, (struct lys_module *)local_mod, set, options);
+    /* 'must' and 'when' results are cast to boolean, any node found is enough */
+    if (options & (LYXP_MUST | LYXP_WHEN)) {
+        options |= LYXP_EXISTS;
+    }
+
+    /* the expression is only read during the evaluation */
+    rc = eval_expr_select((struct lyxp_expr *)exp, &exp_idx, 0, (struct lyd_node *)cur_node,
+                          (struct lys_module *)local_mod, set, options);
     if (rc == 2) {
         rc = EXIT_SUCCESS;
     }
+    if (!rc && !(options & (LYXP_MUST | LYXP_WHEN)) && set_order(set, cur_node, options)) {
+        /* the resulting nodes are returned in the document order, 'must' and 'when' need just a boolean */
+        rc = -1;
+    }
     if ((rc == -1) && cur_node) {
-        LOGPATH(ctx, LY_VLOG_LYD, cur_node);
+        LOGPATH(local_mod ? local_mod->ctx : NULL, LY_VLOG_LYD, cur_node);
+    }
+    if (rc == -1) {
+        /* callers do not expect any result on error */
+        lyxp_set_cast(set, LYXP_SET_EMPTY, cur_node, local_mod, options);
     }
 
-finish:
+    if (local_mod) {
+        LY_STATS_ADD(local_mod->ctx, xpath_evals, 1);
+        LY_STATS_ADD(local_mod->ctx, xpath_nodes, lyxp_visits);
+    }
+    lyxp_visits = 0;
+
+    for (i = 0; i < abs_cache.count; ++i) {
+        set_free_content(&abs_cache.paths[i].set);
+    }
+    lyxp_abs.cache = prev_cache;
+    lyxp_abs.pred_depth = prev_depth;
+
+    pool_leave();
+    return rc;
+}
+
+struct lyxp_memo *
+lyxp_memo_new(void)
+{
+    struct lyxp_memo *memo;
+
+    memo = calloc(1, sizeof *memo);
+    LY_CHECK_ERR_RETURN(!memo, LOGMEM(NULL), NULL);
+
+    return memo;
+}
+
+struct lyxp_memo *
+lyxp_memo_set(struct lyxp_memo *memo)
+{
+    struct lyxp_memo *prev = lyxp_memo;
+
+    lyxp_memo = memo;
+    return prev;
+}
+
+void
+lyxp_memo_flush(struct lyxp_memo *memo)
+{
+    struct lyxp_memo_path *path;
+
+    if (!memo) {
+        return;
+    }
+
+    while (memo->first) {
+        path = memo->first;
+        memo->first = path->next;
+        set_free_content(&path->set);
+        free(path);
+    }
+    lyht_free(memo->paths);
+    memo->paths = NULL;
+}
+
+void
+lyxp_memo_free(struct lyxp_memo *memo)
+{
+    lyxp_memo_flush(memo);
+    free(memo);
+}
+
+int
+lyxp_eval_expr_hide(const struct lyxp_expr *exp, const struct lyd_node *cur_node, enum lyxp_node_type cur_node_type,
+                    const struct lys_module *local_mod, struct lyxp_set *set, int options,
+                    const struct lys_node *hide_snode, const struct lyd_node *hide_parent)
+{
+    const struct lys_node *prev_snode = lyxp_hide.snode;
+    const struct lyd_node *prev_parent = lyxp_hide.parent;
+    int rc;
+
+    /* nested evaluations see the same data tree */
+    lyxp_hide.snode = hide_snode;
+    lyxp_hide.parent = hide_parent;
+    rc = lyxp_eval_expr(exp, cur_node, cur_node_type, local_mod, set, options);
+    lyxp_hide.snode = prev_snode;
+    lyxp_hide.parent = prev_parent;
+
+    return rc;
+}
+
+int
+lyxp_eval(const char *expr, const struct lyd_node *cur_node, enum lyxp_node_type cur_node_type,
+          const struct lys_module *local_mod, struct lyxp_set *set, int options)
+{
+    struct lyxp_expr *exp;
+    int rc;
+
+    if (!expr || !set) {
+        LOGARG;
+        return EXIT_FAILURE;
+    }
+
+    exp = lyxp_compile_expr(local_mod ? local_mod->ctx : NULL, expr);
+    if (!exp) {
+        return -1;
+    }
+
+    LY_TRACE(xpath_start, expr, cur_node ? cur_node->schema->name : NULL, options);
+    rc = lyxp_eval_expr(exp, cur_node, cur_node_type, local_mod, set, options);
+    LY_TRACE(xpath_done, expr, rc, set->type, set->type == LYXP_SET_NODE_SET ? set->used : 0);
+
     lyxp_expr_free(exp);
     return rc;
 }
@@ -8523,6 +10805,9 @@ lyxp_set_cast(struct lyxp_set *set, enum lyxp_set_type target, const struct lyd_
               const struct lys_module *local_mod, int options)
 {
     long double num;
+    int64_t inum, dec;
+    uint8_t dig;
+    int num_int;
     char *str;
 
     if (!set || (set->type == target)) {
@@ -8542,31 +10827,8 @@ lyxp_set_cast(struct lyxp_set *set, enum lyxp_set_type target, const struct lyd_
             && ((set->type == LYXP_SET_NODE_SET) || (set->type == LYXP_SET_EMPTY)))) {
         switch (set->type) {
         case LYXP_SET_NUMBER:
-            if (isnan(set->val.num)) {
-                set->val.str = strdup("NaN");
-                LY_CHECK_ERR_RETURN(!set->val.str, LOGMEM(local_mod->ctx), -1);
-            } else if ((set->val.num == 0) || (set->val.num == -0.0f)) {
-                set->val.str = strdup("0");
-                LY_CHECK_ERR_RETURN(!set->val.str, LOGMEM(local_mod->ctx), -1);
-            } else if (isinf(set->val.num) && !signbit(set->val.num)) {
-                set->val.str = strdup("Infinity");
-                LY_CHECK_ERR_RETURN(!set->val.str, LOGMEM(local_mod->ctx), -1);
-            } else if (isinf(set->val.num) && signbit(set->val.num)) {
-                set->val.str = strdup("-Infinity");
-                LY_CHECK_ERR_RETURN(!set->val.str, LOGMEM(local_mod->ctx), -1);
-            } else if ((long long)set->val.num == set->val.num) {
-                if (asprintf(&str, "%lld", (long long)set->val.num) == -1) {
-                    LOGMEM(local_mod->ctx);
-                    return -1;
-                }
-                set->val.str = str;
-            } else {
-                if (asprintf(&str, "%03.1Lf", set->val.num) == -1) {
-                    LOGMEM(local_mod->ctx);
-                    return -1;
-                }
-                set->val.str = str;
-            }
+            set->val.str = cast_number_to_string(set);
+            LY_CHECK_ERR_RETURN(!set->val.str, LOGMEM(local_mod->ctx), -1);
             break;
         case LYXP_SET_BOOLEAN:
             if (set->val.bool) {
@@ -8580,6 +10842,9 @@ lyxp_set_cast(struct lyxp_set *set, enum lyxp_set_type target, const struct lyd_
             assert(set->used);
 
             /* we need the set sorted, it affects the result */
+            if (set_order(set, cur_node, options)) {
+                return -1;
+            }
             assert(!set_sort(set, cur_node, options));
 
             str = cast_node_set_to_string(set, (struct lyd_node *)cur_node, (struct lys_module *)local_mod, options);
@@ -8604,16 +10869,22 @@ lyxp_set_cast(struct lyxp_set *set, enum lyxp_set_type target, const struct lyd_
     if (target == LYXP_SET_NUMBER) {
         switch (set->type) {
         case LYXP_SET_STRING:
-            num = cast_string_to_number(set->val.str);
+            num_int = cast_string_to_number(set->val.str, &inum, &num, &dec, &dig);
             set_free_content(set);
-            set->val.num = num;
-            break;
-        case LYXP_SET_BOOLEAN:
-            if (set->val.bool) {
-                set->val.num = 1;
+            if (num_int) {
+                set->val.inum = inum;
+                set->num_dig = 0;
             } else {
-                set->val.num = 0;
+                set->val.num = num;
+                set->num_dig = dig;
+                set->num_dec = dec;
             }
+            set->num_int = num_int;
+            break;
+        case LYXP_SET_BOOLEAN:
+            set->val.inum = set->val.bool ? 1 : 0;
+            set->num_int = 1;
+            set->num_dig = 0;
             break;
         default:
             LOGINT(local_mod->ctx);
@@ -8626,7 +10897,9 @@ lyxp_set_cast(struct lyxp_set *set, enum lyxp_set_type target, const struct lyd_
     if (target == LYXP_SET_BOOLEAN) {
         switch (set->type) {
         case LYXP_SET_NUMBER:
-            if ((set->val.num == 0) || (set->val.num == -0.0f) || isnan(set->val.num)) {
+            if (set->num_int) {
+                set->val.bool = set->val.inum ? 1 : 0;
+            } else if ((set->val.num == 0) || (set->val.num == -0.0f) || isnan(set->val.num)) {
                 set->val.bool = 0;
             } else {
                 set->val.bool = 1;
@@ -8722,81 +10995,184 @@ finish:
     return rc;
 }
 
-int
-lyxp_node_atomize(const struct lys_node *node, struct lyxp_set *set, int set_ext_dep_flags)
+/**
+ * @brief Get the when and must expressions of a schema node.
+ *
+ * @param[in] node Node to examine.
+ * @param[out] when When condition of \p node, NULL if none.
+ * @param[out] must Must restrictions of \p node, NULL if none.
+ * @param[out] must_size Number of \p must restrictions.
+ */
+static void
+snode_get_when_must(const struct lys_node *node, struct lys_when **when, struct lys_restr **must, uint8_t *must_size)
 {
-    struct lys_node *parent, *elem;
-    const struct lys_node *ctx_snode = NULL;
-    struct lyxp_set tmp_set;
-    uint8_t must_size = 0;
-    uint32_t i, j;
-    int opts, ret = EXIT_SUCCESS;
-    struct lys_when *when = NULL;
-    struct lys_restr *must = NULL;
-    char *path = NULL;
-
-    memset(&tmp_set, 0, sizeof tmp_set);
-    memset(set, 0, sizeof *set);
-
-    /* check if we will be traversing RPC output */
-    opts = 0;
-    for (parent = (struct lys_node *)node; parent && (parent->nodetype != LYS_OUTPUT); parent = lys_parent(parent));
-    if (parent) {
-        opts |= LYXP_SNODE_OUTPUT;
-    }
+    *when = NULL;
+    *must = NULL;
+    *must_size = 0;
 
     switch (node->nodetype) {
     case LYS_CONTAINER:
-        when = ((struct lys_node_container *)node)->when;
-        must = ((struct lys_node_container *)node)->must;
-        must_size = ((struct lys_node_container *)node)->must_size;
+        *when = ((struct lys_node_container *)node)->when;
+        *must = ((struct lys_node_container *)node)->must;
+        *must_size = ((struct lys_node_container *)node)->must_size;
         break;
     case LYS_CHOICE:
-        when = ((struct lys_node_choice *)node)->when;
+        *when = ((struct lys_node_choice *)node)->when;
         break;
     case LYS_LEAF:
-        when = ((struct lys_node_leaf *)node)->when;
-        must = ((struct lys_node_leaf *)node)->must;
-        must_size = ((struct lys_node_leaf *)node)->must_size;
+        *when = ((struct lys_node_leaf *)node)->when;
+        *must = ((struct lys_node_leaf *)node)->must;
+        *must_size = ((struct lys_node_leaf *)node)->must_size;
         break;
     case LYS_LEAFLIST:
-        when = ((struct lys_node_leaflist *)node)->when;
-        must = ((struct lys_node_leaflist *)node)->must;
-        must_size = ((struct lys_node_leaflist *)node)->must_size;
+        *when = ((struct lys_node_leaflist *)node)->when;
+        *must = ((struct lys_node_leaflist *)node)->must;
+        *must_size = ((struct lys_node_leaflist *)node)->must_size;
         break;
     case LYS_LIST:
-        when = ((struct lys_node_list *)node)->when;
-        must = ((struct lys_node_list *)node)->must;
-        must_size = ((struct lys_node_list *)node)->must_size;
+        *when = ((struct lys_node_list *)node)->when;
+        *must = ((struct lys_node_list *)node)->must;
+        *must_size = ((struct lys_node_list *)node)->must_size;
         break;
     case LYS_ANYXML:
     case LYS_ANYDATA:
-        when = ((struct lys_node_anydata *)node)->when;
-        must = ((struct lys_node_anydata *)node)->must;
-        must_size = ((struct lys_node_anydata *)node)->must_size;
+        *when = ((struct lys_node_anydata *)node)->when;
+        *must = ((struct lys_node_anydata *)node)->must;
+        *must_size = ((struct lys_node_anydata *)node)->must_size;
         break;
     case LYS_CASE:
-        when = ((struct lys_node_case *)node)->when;
+        *when = ((struct lys_node_case *)node)->when;
         break;
     case LYS_NOTIF:
-        must = ((struct lys_node_notif *)node)->must;
-        must_size = ((struct lys_node_notif *)node)->must_size;
+        *must = ((struct lys_node_notif *)node)->must;
+        *must_size = ((struct lys_node_notif *)node)->must_size;
         break;
     case LYS_INPUT:
     case LYS_OUTPUT:
-        must = ((struct lys_node_inout *)node)->must;
-        must_size = ((struct lys_node_inout *)node)->must_size;
+        *must = ((struct lys_node_inout *)node)->must;
+        *must_size = ((struct lys_node_inout *)node)->must_size;
         break;
     case LYS_USES:
-        when = ((struct lys_node_uses *)node)->when;
+        *when = ((struct lys_node_uses *)node)->when;
         break;
     case LYS_AUGMENT:
-        when = ((struct lys_node_augment *)node)->when;
+        *when = ((struct lys_node_augment *)node)->when;
         break;
     default:
-        /* nothing to check */
+        /* no expressions */
         break;
     }
+}
+
+/**
+ * @brief Check whether a schema node is in an RPC/action output.
+ *
+ * @param[in] node Node to examine.
+ *
+ * @return 1 if in output, 0 otherwise.
+ */
+static int
+snode_in_output(const struct lys_node *node)
+{
+    const struct lys_node *parent;
+
+    for (parent = node; parent && (parent->nodetype != LYS_OUTPUT); parent = lys_parent(parent));
+    return parent ? 1 : 0;
+}
+
+#ifdef LY_ENABLED_CACHE
+
+/**
+ * @brief Remember the schema nodes of an atomized expression.
+ *
+ * @param[in,out] deps Set of the schema nodes to (re)create.
+ * @param[in] set Atomized expression schema nodes.
+ */
+static void
+set_snode_store_deps(struct ly_set **deps, const struct lyxp_set *set)
+{
+    uint32_t i;
+
+    ly_set_free(*deps);
+    *deps = ly_set_new();
+    LY_CHECK_ERR_RETURN(!*deps, LOGMEM(NULL), );
+
+    for (i = 0; i < set->used; ++i) {
+        if (set->val.snodes[i].type == LYXP_NODE_ELEM) {
+            ly_set_add(*deps, set->val.snodes[i].snode, 0);
+        }
+    }
+}
+
+/**
+ * @brief Merge remembered schema nodes of an atomized expression into a set.
+ *
+ * @param[in,out] set Set to merge into.
+ * @param[in] deps Schema nodes of the expression.
+ */
+static void
+set_snode_merge_deps(struct lyxp_set *set, const struct ly_set *deps)
+{
+    unsigned int i;
+
+    if (set->type == LYXP_SET_EMPTY) {
+        set->type = LYXP_SET_SNODE_SET;
+    }
+    for (i = 0; i < deps->number; ++i) {
+        if (set_snode_insert_node(set, deps->set.s[i], LYXP_NODE_ELEM) == -1) {
+            return;
+        }
+    }
+}
+
+const struct ly_set *
+lyxp_node_expr_deps(const struct lys_node *node, const char *expr, int options)
+{
+    struct lys_when *when;
+    struct lys_restr *must;
+    uint8_t must_size, i;
+    int out_opt;
+
+    snode_get_when_must(node, &when, &must, &must_size);
+    out_opt = snode_in_output(node) ? LYXP_SNODE_OUTPUT : 0;
+
+    if (options == (LYXP_SNODE_WHEN | out_opt)) {
+        if (when && ly_strequal(when->cond, expr, 0)) {
+            return when->deps;
+        }
+    } else if (options == (LYXP_SNODE_MUST | out_opt)) {
+        for (i = 0; i < must_size; ++i) {
+            if (ly_strequal(must[i].expr, expr, 0)) {
+                return must[i].deps;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+#endif
+
+int
+lyxp_node_atomize(const struct lys_node *node, struct lyxp_set *set, int set_ext_dep_flags)
+{
+    struct lys_node *parent = NULL, *elem;
+    const struct lys_node *ctx_snode = NULL;
+    struct lyxp_set tmp_set;
+    uint8_t must_size = 0;
+    uint32_t i, j;
+    int opts, ret = EXIT_SUCCESS;
+    struct lys_when *when = NULL;
+    struct lys_restr *must = NULL;
+    char *path = NULL;
+
+    memset(&tmp_set, 0, sizeof tmp_set);
+    memset(set, 0, sizeof *set);
+
+    /* check if we will be traversing RPC output */
+    opts = snode_in_output(node) ? LYXP_SNODE_OUTPUT : 0;
+
+    snode_get_when_must(node, &when, &must, &must_size);
 
     if (set_ext_dep_flags) {
         /* find operation if in one, used later */
@@ -8805,6 +11181,14 @@ lyxp_node_atomize(const struct lys_node *node, struct lyxp_set *set, int set_ext
              parent = lys_parent(parent));
     }
 
+#ifdef LY_ENABLED_CACHE
+    if (!set_ext_dep_flags && when && when->deps) {
+        /* atomized already when the schema was resolved */
+        set_snode_merge_deps(set, when->deps);
+        when = NULL;
+    }
+#endif
+
     /* check "when" */
     if (when) {
         if (lyxp_atomize(when->cond, node, LYXP_NODE_ELEM, &tmp_set, LYXP_SNODE_WHEN | opts, &ctx_snode)) {
@@ -8846,6 +11230,9 @@ lyxp_node_atomize(const struct lys_node *node, struct lyxp_set *set, int set_ext
                         }
                     }
                 }
+#ifdef LY_ENABLED_CACHE
+                set_snode_store_deps(&when->deps, &tmp_set);
+#endif
             }
             set_snode_merge(set, &tmp_set);
             memset(&tmp_set, 0, sizeof tmp_set);
@@ -8854,6 +11241,12 @@ lyxp_node_atomize(const struct lys_node *node, struct lyxp_set *set, int set_ext
 
     /* check "must" */
     for (i = 0; i < must_size; ++i) {
+#ifdef LY_ENABLED_CACHE
+        if (!set_ext_dep_flags && must[i].deps) {
+            set_snode_merge_deps(set, must[i].deps);
+            continue;
+        }
+#endif
         if (lyxp_atomize(must[i].expr, node, LYXP_NODE_ELEM, &tmp_set, LYXP_SNODE_MUST | opts, &ctx_snode)) {
             free(tmp_set.val.snodes);
             if (ctx_snode) {
@@ -8893,6 +11286,9 @@ lyxp_node_atomize(const struct lys_node *node, struct lyxp_set *set, int set_ext
                         }
                     }
                 }
+#ifdef LY_ENABLED_CACHE
+                set_snode_store_deps(&must[i].deps, &tmp_set);
+#endif
             }
             set_snode_merge(set, &tmp_set);
             memset(&tmp_set, 0, sizeof tmp_set);
@@ -8918,58 +11314,7 @@ lyxp_node_check_syntax(const struct lys_node *node)
     struct lys_restr *must = NULL;
     struct lyxp_expr *expr;
 
-    switch (node->nodetype) {
-    case LYS_CONTAINER:
-        when = ((struct lys_node_container *)node)->when;
-        must = ((struct lys_node_container *)node)->must;
-        must_size = ((struct lys_node_container *)node)->must_size;
-        break;
-    case LYS_CHOICE:
-        when = ((struct lys_node_choice *)node)->when;
-        break;
-    case LYS_LEAF:
-        when = ((struct lys_node_leaf *)node)->when;
-        must = ((struct lys_node_leaf *)node)->must;
-        must_size = ((struct lys_node_leaf *)node)->must_size;
-        break;
-    case LYS_LEAFLIST:
-        when = ((struct lys_node_leaflist *)node)->when;
-        must = ((struct lys_node_leaflist *)node)->must;
-        must_size = ((struct lys_node_leaflist *)node)->must_size;
-        break;
-    case LYS_LIST:
-        when = ((struct lys_node_list *)node)->when;
-        must = ((struct lys_node_list *)node)->must;
-        must_size = ((struct lys_node_list *)node)->must_size;
-        break;
-    case LYS_ANYXML:
-    case LYS_ANYDATA:
-        when = ((struct lys_node_anydata *)node)->when;
-        must = ((struct lys_node_anydata *)node)->must;
-        must_size = ((struct lys_node_anydata *)node)->must_size;
-        break;
-    case LYS_CASE:
-        when = ((struct lys_node_case *)node)->when;
-        break;
-    case LYS_NOTIF:
-        must = ((struct lys_node_notif *)node)->must;
-        must_size = ((struct lys_node_notif *)node)->must_size;
-        break;
-    case LYS_INPUT:
-    case LYS_OUTPUT:
-        must = ((struct lys_node_inout *)node)->must;
-        must_size = ((struct lys_node_inout *)node)->must_size;
-        break;
-    case LYS_USES:
-        when = ((struct lys_node_uses *)node)->when;
-        break;
-    case LYS_AUGMENT:
-        when = ((struct lys_node_augment *)node)->when;
-        break;
-    default:
-        /* nothing to check */
-        break;
-    }
+    snode_get_when_must(node, &when, &must, &must_size);
 
     /* check "when" */
     if (when) {
@@ -122,6 +122,24 @@ enum lyxp_expr_type {
     LYXP_EXPR_UNION,
 };
 
+struct lyxp_set;
+struct lyxp_memo;
+
+/**
+ * @brief XPath function implementation.
+ */
+typedef int (*lyxp_func_clb)(struct lyxp_set **args, uint16_t arg_count, struct lyd_node *cur_node,
+                             struct lys_module *local_mod, struct lyxp_set *set, int options);
+
+/**
+ * @brief Token data resolved when compiling an expression, so that they are not looked up on every evaluation.
+ */
+struct lyxp_tok_data {
+    struct lys_module *mod;  /* NameTest - module of the prefix, NULL if there is none */
+    const char *name;        /* NameTest - name without the prefix (in the dictionary), NULL if not resolved */
+    lyxp_func_clb func;      /* FunctionName - function implementation */
+};
+
 /**
  * @brief Structure holding a parsed XPath expression.
  */
@@ -135,6 +153,10 @@ struct lyxp_expr {
     uint16_t size;           /* allocated array items */
 
     char *expr;              /* the original XPath expression */
+
+    struct lyxp_tok_data *tok_data; /* array of resolved token data (used items), only in compiled expressions */
+    struct ly_ctx *ctx;      /* context of tok_data */
+    uint16_t module_set_id;  /* module set id of ctx the modules in tok_data were resolved for */
 };
 
 /*
@@ -216,9 +238,18 @@ struct lyxp_set {
         } *attrs;
         char *str;
         long double num;
+        int64_t inum;
         int bool;
     } val;
 
+    /* this is valid only for type LYXP_SET_NUMBER, the number is an integer stored in val.inum */
+    uint8_t num_int;
+
+    /* this is valid only for type LYXP_SET_NUMBER stored in val.num, if set, the number is a decimal
+     * exactly num_dec / 10^num_dig and val.num is only its approximation */
+    uint8_t num_dig;
+    int64_t num_dec;
+
     /* this is valid only for type LYXP_SET_NODE_SET and LYXP_SET_SNODE_SET */
     uint32_t used;
     uint32_t size;
@@ -228,6 +259,7 @@ struct lyxp_set {
     /* this is valid only for type LYXP_SET_NODE_SET */
     uint32_t ctx_pos;
     uint32_t ctx_size;
+    uint8_t unordered; /* nodes may not be in the document order, they are sorted only when it matters */
 };
 
 /**
@@ -250,12 +282,77 @@ struct lyxp_set {
  * @param[in] options Whether to apply some evaluation restrictions.
  * LYXP_MUST - apply must data tree access restrictions.
  * LYXP_WHEN - apply when data tree access restrictions and consider LYD_WHEN flags in data nodes.
+ * With either of them the result is expected to be cast to boolean, so a resulting node set may be incomplete.
  *
  * @return EXIT_SUCCESS on success, EXIT_FAILURE on unresolved when dependency, -1 on error.
  */
 int lyxp_eval(const char *expr, const struct lyd_node *cur_node, enum lyxp_node_type cur_node_type,
               const struct lys_module *local_mod, struct lyxp_set *set, int options);
 
+/**
+ * @brief Evaluate an XPath expression previously parsed by lyxp_compile_expr(). Works exactly like lyxp_eval(),
+ * but the expression is not parsed again so it is suitable for expressions that are evaluated repeatedly.
+ *
+ * @param[in] exp Parsed XPath expression to evaluate, it is not modified so it can be shared.
+ * @param[in] cur_node Current (context) data node, see lyxp_eval().
+ * @param[in] cur_node_type Current (context) data node type, see lyxp_eval().
+ * @param[in] local_mod Local module relative to the \p exp.
+ * @param[out] set Result set, see lyxp_eval().
+ * @param[in] options Whether to apply some evaluation restrictions, see lyxp_eval().
+ * @return EXIT_SUCCESS on success, EXIT_FAILURE on unresolved when dependency, -1 on error.
+ */
+int lyxp_eval_expr(const struct lyxp_expr *exp, const struct lyd_node *cur_node, enum lyxp_node_type cur_node_type,
+                   const struct lys_module *local_mod, struct lyxp_set *set, int options);
+
+/**
+ * @brief Evaluate an XPath expression previously parsed by lyxp_compile_expr() as if the data instances
+ * of a schema-only node were not in the data tree. The tree itself is not modified.
+ *
+ * @param[in] exp Parsed XPath expression to evaluate.
+ * @param[in] cur_node Current (context) data node, see lyxp_eval().
+ * @param[in] cur_node_type Current (context) data node type, see lyxp_eval().
+ * @param[in] local_mod Local module relative to the \p exp.
+ * @param[out] set Result set, see lyxp_eval().
+ * @param[in] options Whether to apply some evaluation restrictions, see lyxp_eval().
+ * @param[in] hide_snode Uses, choice, case, or augment whose data instances are skipped.
+ * @param[in] hide_parent Data parent of the skipped instances, NULL if they are top-level.
+ * @return EXIT_SUCCESS on success, EXIT_FAILURE on unresolved when dependency, -1 on error.
+ */
+int lyxp_eval_expr_hide(const struct lyxp_expr *exp, const struct lyd_node *cur_node, enum lyxp_node_type cur_node_type,
+                        const struct lys_module *local_mod, struct lyxp_set *set, int options,
+                        const struct lys_node *hide_snode, const struct lyd_node *hide_parent);
+
+/**
+ * @brief Create a memo of the nodes selected by relative paths. While it is set for a thread, the nodes a path
+ * selects are remembered for the node it starts from and evaluating the same path from the same node again only
+ * copies them. The data trees must not be modified meanwhile, any change requires lyxp_memo_flush().
+ *
+ * @return New memo, NULL on error.
+ */
+struct lyxp_memo *lyxp_memo_new(void);
+
+/**
+ * @brief Set the memo used by the evaluations of the thread.
+ *
+ * @param[in] memo Memo to use, NULL to stop remembering the paths.
+ * @return Previously used memo to be restored.
+ */
+struct lyxp_memo *lyxp_memo_set(struct lyxp_memo *memo);
+
+/**
+ * @brief Forget all the paths remembered in a memo.
+ *
+ * @param[in] memo Memo to flush, can be NULL.
+ */
+void lyxp_memo_flush(struct lyxp_memo *memo);
+
+/**
+ * @brief Free a memo, it must not be used by any thread.
+ *
+ * @param[in] memo Memo to free, can be NULL.
+ */
+void lyxp_memo_free(struct lyxp_memo *memo);
+
 /**
  * @brief Get all the partial XPath nodes (atoms) that are required for \p expr to be evaluated.
  *
@@ -286,6 +383,7 @@ int lyxp_atomize(const char *expr, const struct lys_node *cur_snode, enum lyxp_n
 #define LYXP_SNODE_MUST 0x08
 #define LYXP_SNODE_WHEN 0x10
 #define LYXP_SNODE_OUTPUT 0x20
+#define LYXP_EXISTS 0x40 /* only the existence of a node matters, evaluation can stop on the first node found */
 
 #define LYXP_SNODE_ALL 0x1C
 
@@ -303,6 +401,22 @@ int lyxp_atomize(const char *expr, const struct lys_node *cur_snode, enum lyxp_n
  */
 int lyxp_node_atomize(const struct lys_node *node, struct lyxp_set *set, int set_ext_dep_flags);
 
+#ifdef LY_ENABLED_CACHE
+
+/**
+ * @brief Get the schema nodes referenced by a when or must expression of a node, as stored when the schema
+ * was resolved, so that the expression does not have to be atomized again.
+ *
+ * @param[in] node Node with the expression.
+ * @param[in] expr Expression of \p node.
+ * @param[in] options Atomization options as for lyxp_atomize().
+ *
+ * @return Schema nodes of the expression, NULL if not stored.
+ */
+const struct ly_set *lyxp_node_expr_deps(const struct lys_node *node, const char *expr, int options);
+
+#endif
+
 /**
  * @brief Check syntax of all the XPath expressions of the node.
  *
@@ -327,6 +441,15 @@ int lyxp_node_check_syntax(const struct lys_node *node);
 int lyxp_set_cast(struct lyxp_set *set, enum lyxp_set_type target, const struct lyd_node *cur_node,
                   const struct lys_module *local_mod, int options);
 
+/**
+ * @brief Get the value of an XPath number \p set.
+ *
+ * @param[in] set Set of type #LYXP_SET_NUMBER.
+ *
+ * @return Number value.
+ */
+long double lyxp_set_num(const struct lyxp_set *set);
+
 /**
  * @brief Free contents of an XPath \p set.
  *
@@ -347,6 +470,29 @@ void lyxp_set_free(struct lyxp_set *set);
  */
 struct lyxp_expr *lyxp_parse_expr(struct ly_ctx *ctx, const char *expr);
 
+/**
+ * @brief Parse an XPath expression and check its syntax so that it can be evaluated by lyxp_eval_expr().
+ *        The modules of the name tests and the functions are resolved as well. Logs directly.
+ *
+ * @param[in] ctx Context for errors, modules, and the dictionary.
+ * @param[in] expr XPath expression to parse. It is duplicated.
+ *
+ * @return Parsed expression ready for evaluation or NULL on error.
+ */
+struct lyxp_expr *lyxp_compile_expr(struct ly_ctx *ctx, const char *expr);
+
+/**
+ * @brief Get a compiled XPath expression from a schema cache, compile it by lyxp_compile_expr() and publish it
+ *        there if it is not yet. Several threads may call it for the same cache at once. Logs directly.
+ *
+ * @param[in] ctx Context for errors, modules, and the dictionary.
+ * @param[in] expr XPath expression to compile.
+ * @param[in,out] cache Cached compiled expression, such as ::lys_restr#expr_xpath.
+ *
+ * @return Compiled expression or NULL on error.
+ */
+struct lyxp_expr *lyxp_compile_expr_cached(struct ly_ctx *ctx, const char *expr, void **cache);
+
 /**
  * @brief Frees a parsed XPath expression. \p expr should not be used afterwards.
  *
@@ -12,6 +12,8 @@
  *     https://opensource.org/licenses/BSD-3-Clause
  */
 
+#include <cmath>
+#include <cstdlib>
 #include <iostream>
 #include <memory>
 #include <stdexcept>
@@ -381,6 +383,85 @@ std::vector<S_Schema_Node> Set::schema() {
 
     return s_vector;
 };
+std::vector<std::string> Set::data_paths() {
+    std::vector<std::string> s_vector;
+    char *path;
+
+    s_vector.reserve(set->number);
+    for (unsigned int i = 0; i < set->number; i++) {
+        path = lyd_path(set->set.d[i]);
+        if (!path) {
+            check_libyang_error(set->set.d[i]->schema->module->ctx);
+            return s_vector;
+        }
+        s_vector.emplace_back(path);
+        free(path);
+    }
+
+    return s_vector;
+}
+std::vector<std::string> Set::data_values() {
+    std::vector<std::string> s_vector;
+    struct lyd_node_leaf_list *leaf;
+
+    s_vector.reserve(set->number);
+    for (unsigned int i = 0; i < set->number; i++) {
+        leaf = (struct lyd_node_leaf_list *) set->set.d[i];
+        if ((leaf->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST)) && leaf->value_str) {
+            s_vector.emplace_back(leaf->value_str);
+        } else {
+            s_vector.emplace_back();
+        }
+    }
+
+    return s_vector;
+}
+static double leaf_number(const struct lyd_node *node) {
+    const struct lyd_node_leaf_list *leaf;
+
+    while (node && (node->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST))) {
+        leaf = (const struct lyd_node_leaf_list *) node;
+        switch (leaf->value_type) {
+        case LY_TYPE_INT8:
+            return leaf->value.int8;
+        case LY_TYPE_INT16:
+            return leaf->value.int16;
+        case LY_TYPE_INT32:
+            return leaf->value.int32;
+        case LY_TYPE_INT64:
+            return leaf->value.int64;
+        case LY_TYPE_UINT8:
+            return leaf->value.uint8;
+        case LY_TYPE_UINT16:
+            return leaf->value.uint16;
+        case LY_TYPE_UINT32:
+            return leaf->value.uint32;
+        case LY_TYPE_UINT64:
+            return leaf->value.uint64;
+        case LY_TYPE_DEC64:
+            /* the canonical value is exact, scaling the integer would add rounding errors */
+            return strtod(leaf->value_str, NULL);
+        case LY_TYPE_LEAFREF:
+            /* resolved leafref, unresolved ones have the value of the target type */
+            node = leaf->value.leafref;
+            break;
+        default:
+            return NAN;
+        }
+    }
+
+    return NAN;
+}
+std::vector<double> Set::data_numbers() {
+    std::vector<double> s_vector;
+
+    s_vector.reserve(set->number);
+    for (unsigned int i = 0; i < set->number; i++) {
+        s_vector.push_back(leaf_number(set->set.d[i]));
+    }
+
+    return s_vector;
+}
 S_Set Set::dup() {
     ly_set *new_set = ly_set_dup(set);
     if (!new_set) {
@@ -118,6 +118,10 @@ public:
     /* functions */
     /** wrapper for [lyd_parse_mem](@ref lyd_parse_mem) */
     S_Data_Node parse_data_mem(const char *data, LYD_FORMAT format, int options = 0);
+#ifndef SWIG
+    /** wrapper for [lyd_parse_mem](@ref lyd_parse_mem), \p data are parsed in place, they are not copied */
+    S_Data_Node parse_data_mem(const std::string &data, LYD_FORMAT format, int options = 0) {return parse_data_mem(data.c_str(), format, options);};
+#endif
     /** wrapper for [lyd_parse_fd](@ref lyd_parse_fd) */
     S_Data_Node parse_data_fd(int fd, LYD_FORMAT format, int options = 0);
     /** wrapper for [lyd_parse_path](@ref lyd_parse_path) */
@@ -198,6 +202,12 @@ public:
     std::vector<S_Data_Node> data();
     /** get s variable from [ly_set_set](@ref ly_set_set)*/
     std::vector<S_Schema_Node> schema();
+    /** paths of all the data nodes in the set, see [lyd_path](@ref lyd_path), no per-node wrappers are created */
+    std::vector<std::string> data_paths();
+    /** canonical values of all the data nodes in the set, empty strings for the nodes other than leaves and leaf-lists */
+    std::vector<std::string> data_values();
+    /** numeric values of all the data nodes in the set (leafrefs are followed), NaN for the nodes with no numeric value */
+    std::vector<double> data_numbers();
 
     /* functions */
     /** wrapper for [ly_set_dup](@ref ly_set_dup) */
@@ -16,6 +16,7 @@
 #include <memory>
 #include <stdexcept>
 #include <vector>
+#include <sys/uio.h>
 
 #include "Xml.hpp"
 #include "Libyang.hpp"
@@ -421,20 +422,30 @@ S_Module Data_Node::node_module() {
 
     return module ? std::make_shared<Module>(module, deleter) : nullptr;
 }
+static ssize_t print_mem_append(void *arg, const struct iovec *iov, int iovcnt) {
+    std::string *buf = static_cast<std::string *>(arg);
+    ssize_t count = 0;
+
+    for (int i = 0; i < iovcnt; ++i) {
+        buf->append(static_cast<const char *>(iov[i].iov_base), iov[i].iov_len);
+        count += iov[i].iov_len;
+    }
+
+    return count;
+}
 std::string Data_Node::print_mem(LYD_FORMAT format, int options) {
-    char *strp = nullptr;
+    std::string s_strp;
+
+    print_mem(s_strp, format, options);
+    return s_strp;
+}
+void Data_Node::print_mem(std::string &buf, LYD_FORMAT format, int options) {
     int rc = 0;
 
-    rc = lyd_print_mem(&strp, node, format, options);
+    rc = lyd_print_iov(print_mem_append, &buf, node, format, options);
     if (rc) {
         check_libyang_error(node->schema->module->ctx);
-        return nullptr;
     }
-
-    std::string s_strp = strp;
-    free(strp);
-    return s_strp;
-
 }
 std::vector<S_Data_Node> Data_Node::tree_for() {
     std::vector<S_Data_Node> s_vector;
@@ -458,6 +469,40 @@ std::vector<S_Data_Node> Data_Node::tree_dfs() {
     return s_vector;
 }
 
+S_Data_Node Data_Node_View::retain() const {
+    return std::make_shared<Data_Node>(node, *deleter);
+}
+
+Data_Node_Iterator &Data_Node_Iterator::operator++() {
+    struct lyd_node *elem = view.node, *next;
+
+    if (!dfs) {
+        view.node = elem->next;
+        return *this;
+    }
+
+    /* the same steps as LY_TREE_DFS_END, children first */
+    next = (elem->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST | LYS_ANYDATA)) ? nullptr : elem->child;
+    if (!next) {
+        if (elem == start) {
+            view.node = nullptr;
+            return *this;
+        }
+        next = elem->next;
+    }
+    while (!next) {
+        elem = elem->parent;
+        if (elem->parent == start->parent) {
+            view.node = nullptr;
+            return *this;
+        }
+        next = elem->next;
+    }
+
+    view.node = next;
+    return *this;
+}
+
 Data_Node_Leaf_List::Data_Node_Leaf_List(S_Data_Node derived):
     Data_Node(derived->node, derived->deleter),
     node(derived->node),
@@ -16,6 +16,7 @@
 #define LIBYANG_CPP_TREE_DATA_H
 
 #include <iostream>
+#include <iterator>
 #include <memory>
 #include <exception>
 #include <vector>
@@ -90,6 +91,98 @@ private:
     S_Deleter deleter;
 };
 
+#ifndef SWIG
+
+/**
+ * @brief Non-owning view of a [lyd_node](@ref lyd_node) yielded by [Data_Node_Range](@ref Data_Node_Range).
+ * @class Data_Node_View
+ *
+ * A view costs no allocation, but it is valid only as long as the range it comes from. To keep the node,
+ * create the owning wrapper by retain().
+ */
+class Data_Node_View
+{
+public:
+    /** wrapper for struct [lyd_node](@ref lyd_node), for internal use only */
+    Data_Node_View(struct lyd_node *node, const S_Deleter *deleter): node(node), deleter(deleter) {};
+    /** get name of the schema node of [lyd_node](@ref lyd_node) */
+    const char *name() const {return node->schema->name;};
+    /** get nodetype of the schema node of [lyd_node](@ref lyd_node) */
+    LYS_NODE nodetype() const {return node->schema->nodetype;};
+    /** get value_str variable from [lyd_node_leaf_list](@ref lyd_node_leaf_list), nullptr if not a leaf or leaf-list */
+    const char *value_str() const {
+        return (node->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST)) ? ((struct lyd_node_leaf_list *) node)->value_str : nullptr;
+    };
+    /** get validity variable from [lyd_node](@ref lyd_node)*/
+    uint8_t validity() const {return node->validity;};
+    /** get dflt variable from [lyd_node](@ref lyd_node)*/
+    uint8_t dflt() const {return node->dflt;};
+    /** create the owning wrapper of the node */
+    S_Data_Node retain() const;
+
+    /** libnetconf2 related wrappers, for internal use only */
+    struct lyd_node *C_lyd_node() const {return node;};
+
+    friend class Data_Node_Iterator;
+
+private:
+    struct lyd_node *node;
+    const S_Deleter *deleter;
+};
+
+/**
+ * @brief Forward iterator of [Data_Node_Range](@ref Data_Node_Range).
+ * @class Data_Node_Iterator
+ */
+class Data_Node_Iterator
+{
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = Data_Node_View;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const Data_Node_View *;
+    using reference = const Data_Node_View &;
+
+    /** for internal use only */
+    Data_Node_Iterator(struct lyd_node *start, struct lyd_node *node, const S_Deleter *deleter, bool dfs):
+        start(start), view(node, deleter), dfs(dfs) {};
+    reference operator*() const {return view;};
+    pointer operator->() const {return &view;};
+    Data_Node_Iterator &operator++();
+    Data_Node_Iterator operator++(int) {Data_Node_Iterator prev(*this); ++(*this); return prev;};
+    bool operator==(const Data_Node_Iterator &other) const {return view.node == other.view.node;};
+    bool operator!=(const Data_Node_Iterator &other) const {return view.node != other.view.node;};
+
+private:
+    struct lyd_node *start;
+    Data_Node_View view;
+    bool dfs;
+};
+
+/**
+ * @brief Lazy range of data nodes, see [Data_Node::dfs()](@ref Data_Node::dfs) and
+ * [Data_Node::siblings()](@ref Data_Node::siblings).
+ * @class Data_Node_Range
+ *
+ * The nodes are visited while iterating, as long as the tree is not modified.
+ */
+class Data_Node_Range
+{
+public:
+    /** for internal use only */
+    Data_Node_Range(struct lyd_node *start, S_Deleter deleter, bool dfs): start(start), deleter(deleter), dfs(dfs) {};
+    Data_Node_Iterator begin() const {return Data_Node_Iterator(start, start, &deleter, dfs);};
+    Data_Node_Iterator end() const {return Data_Node_Iterator(start, nullptr, &deleter, dfs);};
+    bool empty() const {return !start;};
+
+private:
+    struct lyd_node *start;
+    S_Deleter deleter;
+    bool dfs;
+};
+
+#endif
+
 /**
  * @brief classes for wrapping [lyd_node](@ref lyd_node).
  * @class Data_Node
@@ -194,12 +287,27 @@ public:
     S_Module node_module();
     /** wrapper for [lyd_print_mem](@ref lyd_print_mem) */
     std::string print_mem(LYD_FORMAT format, int options);
+#ifndef SWIG
+    /** wrapper for [lyd_print_iov](@ref lyd_print_iov), the output is appended to \p buf with no intermediate copy */
+    void print_mem(std::string &buf, LYD_FORMAT format, int options);
+#endif
 
     /* emulate TREE macro's */
     /** wrapper for macro [LY_TREE_FOR](@ref LY_TREE_FOR) */
     std::vector<S_Data_Node> tree_for();
     /** wrapper for macro [LY_TREE_DFS_BEGIN](@ref LY_TREE_DFS_BEGIN) and [LY_TREE_DFS_END](@ref LY_TREE_DFS_END) */
     std::vector<S_Data_Node> tree_dfs();
+#ifndef SWIG
+    /** lazy [tree_dfs()](@ref tree_dfs), the subtree is visited while iterating with no allocation per node */
+    Data_Node_Range dfs() {return Data_Node_Range(node, deleter, true);};
+    /** lazy [tree_for()](@ref tree_for), this node and its following siblings */
+    Data_Node_Range siblings() {return Data_Node_Range(node, deleter, false);};
+    /** lazy range of the children, empty for leaves, leaf-lists and anydata */
+    Data_Node_Range children() {
+        return Data_Node_Range((node->schema->nodetype & (LYS_LEAF | LYS_LEAFLIST | LYS_ANYDATA)) ? nullptr : node->child,
+                               deleter, false);
+    };
+#endif
 
     /** SWIG related wrappers, for internal use only */
     struct lyd_node *swig_node() {return node;};
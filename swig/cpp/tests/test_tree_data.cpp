@@ -20,6 +20,7 @@
 #include "../tests/config.h"
 #include "microtest.h"
 #include <string.h>
+#include <cmath>
 
 const char *lys_module_a = \
 "<?xml version=\"1.0\" encoding=\"UTF-8\"?>           \
@@ -458,6 +459,47 @@ TEST(test_ly_data_node_find_path)
     }
 }
 
+TEST(test_ly_data_node_find_path_values)
+{
+    const char *yang_folder = TESTS_DIR "/api/files";
+    const char *data_xml = "<x xmlns=\"urn:a\"><bubba>test</bubba><number32>-5</number32><number64>1234567</number64></x>";
+
+    try {
+        auto ctx = std::make_shared<libyang::Context>(yang_folder);
+        ASSERT_NOTNULL(ctx);
+        ctx->parse_module_mem(lys_module_a, LYS_IN_YIN);
+        auto root = ctx->parse_data_mem(data_xml, LYD_XML, LYD_OPT_CONFIG | LYD_OPT_STRICT);
+        ASSERT_NOTNULL(root);
+
+        auto set = root->find_path("/a:x | /a:x/bubba | /a:x/number32 | /a:x/number64");
+        ASSERT_NOTNULL(set);
+        ASSERT_EQ(4, set->number());
+
+        auto paths = set->data_paths();
+        ASSERT_EQ(4, paths.size());
+        ASSERT_STREQ("/a:x", paths[0]);
+        ASSERT_STREQ("/a:x/bubba", paths[1]);
+        ASSERT_STREQ("/a:x/number64", paths[3]);
+
+        auto values = set->data_values();
+        ASSERT_EQ(4, values.size());
+        ASSERT_STREQ("", values[0]);
+        ASSERT_STREQ("test", values[1]);
+        ASSERT_STREQ("-5", values[2]);
+        ASSERT_STREQ("1234567", values[3]);
+
+        auto numbers = set->data_numbers();
+        ASSERT_EQ(4, numbers.size());
+        ASSERT_TRUE(std::isnan(numbers[0]));
+        ASSERT_TRUE(std::isnan(numbers[1]));
+        ASSERT_EQ(-5, numbers[2]);
+        ASSERT_EQ(1234567, numbers[3]);
+    } catch (const std::exception& e) {
+        mt::printFailed(e.what(), stdout);
+        throw;
+    }
+}
+
 TEST(test_ly_data_node_find_instance)
 {
     const char *yang_folder = TESTS_DIR "/api/files";
@@ -597,6 +639,43 @@ TEST(test_ly_data_node_print_mem_json)
     }
 }
 
+TEST(test_ly_data_node_print_mem_buf)
+{
+    const char *yang_folder = TESTS_DIR "/api/files";
+    const char *config_file = TESTS_DIR "/api/files/a.xml";
+
+    try {
+        auto ctx = std::make_shared<libyang::Context>(yang_folder);
+        ASSERT_NOTNULL(ctx);
+        ctx->parse_module_mem(lys_module_a, LYS_IN_YIN);
+        auto root = ctx->parse_data_path(config_file, LYD_XML, LYD_OPT_CONFIG | LYD_OPT_STRICT);
+        ASSERT_NOTNULL(root);
+
+        /* the output is appended */
+        std::string buf = "prefix";
+        root->print_mem(buf, LYD_JSON, LYP_FORMAT);
+        ASSERT_STREQ(std::string("prefix") + result_json, buf);
+
+        /* parse the printed data in place and print them again */
+        buf.erase(0, 6);
+        auto node = ctx->parse_data_mem(buf, LYD_JSON, LYD_OPT_CONFIG | LYD_OPT_STRICT);
+        ASSERT_NOTNULL(node);
+        buf.clear();
+        node->print_mem(buf, LYD_XML, 0);
+        ASSERT_STREQ(result_xml, buf);
+
+        /* binary LYB output is not cut at the first zero byte */
+        buf.clear();
+        root->print_mem(buf, LYD_LYB, 0);
+        node = ctx->parse_data_mem(buf, LYD_LYB, LYD_OPT_CONFIG | LYD_OPT_STRICT);
+        ASSERT_NOTNULL(node);
+        ASSERT_STREQ(result_xml, node->print_mem(LYD_XML, 0));
+    } catch (const std::exception& e) {
+        mt::printFailed(e.what(), stdout);
+        throw;
+    }
+}
+
 TEST(test_ly_data_node_path)
 {
     const char *yang_folder = TESTS_DIR "/api/files";
@@ -764,4 +843,57 @@ TEST(test_ly_data_node_validate_value)
     }
 }
 
+TEST(test_ly_data_node_ranges)
+{
+    const char *yang_folder = TESTS_DIR "/api/files";
+    const char *config_file = TESTS_DIR "/api/files/a.xml";
+
+    try {
+        auto ctx = std::make_shared<libyang::Context>(yang_folder);
+        ASSERT_NOTNULL(ctx);
+        ctx->parse_module_mem(lys_module_a, LYS_IN_YIN);
+        auto root = ctx->parse_data_path(config_file, LYD_XML, LYD_OPT_CONFIG | LYD_OPT_STRICT);
+        ASSERT_NOTNULL(root);
+
+        /* the same nodes in the same order as the vectors */
+        auto dfs_list = root->tree_dfs();
+        size_t i = 0;
+        for (auto &view : root->dfs()) {
+            ASSERT_FALSE(i >= dfs_list.size());
+            ASSERT_TRUE(view.C_lyd_node() == dfs_list[i]->swig_node());
+            ++i;
+        }
+        ASSERT_EQ(dfs_list.size(), i);
+
+        auto for_list = root->tree_for();
+        i = 0;
+        for (auto &view : root->siblings()) {
+            ASSERT_TRUE(view.C_lyd_node() == for_list[i]->swig_node());
+            ++i;
+        }
+        ASSERT_EQ(for_list.size(), i);
+
+        i = 0;
+        for (auto &view : root->children()) {
+            ASSERT_STREQ(view.name(), root->child()->tree_for()[i]->schema()->name());
+            ++i;
+        }
+        ASSERT_FALSE(i == 0);
+
+        /* a retained node outlives the range */
+        libyang::S_Data_Node leaf;
+        for (auto &view : root->dfs()) {
+            if (view.value_str()) {
+                leaf = view.retain();
+                break;
+            }
+        }
+        ASSERT_NOTNULL(leaf);
+        ASSERT_NOTNULL(leaf->schema());
+    } catch (const std::exception &e) {
+        mt::printFailed(e.what(), stdout);
+        throw;
+    }
+}
+
 TEST_MAIN();
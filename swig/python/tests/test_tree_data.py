@@ -14,6 +14,7 @@ __license__ = "BSD 3-Clause"
 import yang as ly
 import unittest
 import sys
+import math
 
 import config
 
@@ -459,6 +460,29 @@ class TestUM(unittest.TestCase):
         except Exception as e:
             self.fail(e)
 
+    def test_ly_data_node_find_path_values(self):
+        yang_folder = config.TESTS_DIR + "/api/files"
+        data_xml = '<x xmlns="urn:a"><bubba>test</bubba><number32>-5</number32><number64>1234567</number64></x>'
+        try:
+            # Setup
+            ctx = ly.Context(yang_folder)
+            self.assertIsNotNone(ctx)
+            ctx.parse_module_mem(lys_module_a, ly.LYS_IN_YIN)
+            root = ctx.parse_data_mem(data_xml, ly.LYD_XML, ly.LYD_OPT_CONFIG | ly.LYD_OPT_STRICT)
+            self.assertIsNotNone(root)
+
+            # Tests
+            set = root.find_path("/a:x/bubba | /a:x/number32 | /a:x/number64")
+            self.assertIsNotNone(set)
+            self.assertEqual(("/a:x/bubba", "/a:x/number32", "/a:x/number64"), set.data_paths())
+            self.assertEqual(("test", "-5", "1234567"), set.data_values())
+            numbers = set.data_numbers()
+            self.assertTrue(math.isnan(numbers[0]))
+            self.assertEqual((-5.0, 1234567.0), numbers[1:])
+
+        except Exception as e:
+            self.fail(e)
+
     def test_ly_data_node_find_instance(self):
         yang_folder = config.TESTS_DIR + "/api/files"
         config_file = config.TESTS_DIR + "/api/files/a.xml"
@@ -595,6 +619,34 @@ class TestUM(unittest.TestCase):
         except Exception as e:
             self.fail(e)
 
+    def test_ly_data_node_print_buf(self):
+        yang_folder = config.TESTS_DIR + "/api/files"
+        config_file = config.TESTS_DIR + "/api/files/a.xml"
+        try:
+            # Setup
+            ctx = ly.Context(yang_folder)
+            self.assertIsNotNone(ctx)
+            ctx.parse_module_mem(lys_module_a, ly.LYS_IN_YIN)
+            root = ctx.parse_data_path(config_file, ly.LYD_XML, ly.LYD_OPT_CONFIG | ly.LYD_OPT_STRICT)
+            self.assertIsNotNone(root)
+
+            # Tests
+            result = root.print_buf(ly.LYD_JSON, ly.LYP_FORMAT)
+            self.assertEqual(result_json.encode(), result)
+            buf = bytearray(b"prefix")
+            self.assertIs(buf, root.print_buf(ly.LYD_XML, 0, buf))
+            self.assertEqual(b"prefix" + result_xml.encode(), buf)
+
+            node = ctx.parse_data_buf(result, ly.LYD_JSON, ly.LYD_OPT_CONFIG | ly.LYD_OPT_STRICT)
+            self.assertIsNotNone(node)
+            self.assertEqual(result_xml, node.print_mem(ly.LYD_XML, 0))
+            node = ctx.parse_data_buf(memoryview(result_xml.encode())[:], ly.LYD_XML, ly.LYD_OPT_CONFIG | ly.LYD_OPT_STRICT)
+            self.assertIsNotNone(node)
+            self.assertEqual(result_xml, node.print_mem(ly.LYD_XML, 0))
+
+        except Exception as e:
+            self.fail(e)
+
     def test_ly_data_node_path(self):
         yang_folder = config.TESTS_DIR + "/api/files"
         config_file = config.TESTS_DIR + "/api/files/a.xml"
@@ -16,6 +16,7 @@
 
 %inline %{
 #include <unistd.h>
+#include <sys/uio.h>
 #include "libyang.h"
 #include <signal.h>
 #include <vector>
@@ -75,6 +76,27 @@ static const char *g_ly_module_imp_clb(const char *mod_name, const char *mod_rev
     *format = pair.second;
     return pair.first;
 }
+
+static ssize_t g_print_bytearray(void *arg, const struct iovec *iov, int iovcnt) {
+    PyObject *buf = (PyObject *) arg;
+    Py_ssize_t len = PyByteArray_GET_SIZE(buf), count = 0;
+    char *ptr;
+    int i;
+
+    for (i = 0; i < iovcnt; ++i) {
+        count += iov[i].iov_len;
+    }
+    if (PyByteArray_Resize(buf, len + count)) {
+        return -1;
+    }
+
+    ptr = PyByteArray_AS_STRING(buf) + len;
+    for (i = 0; i < iovcnt; ++i) {
+        memcpy(ptr, iov[i].iov_base, iov[i].iov_len);
+        ptr += iov[i].iov_len;
+    }
+    return count;
+}
 %}
 
 %extend libyang::Context {
@@ -94,9 +116,61 @@ static const char *g_ly_module_imp_clb(const char *mod_name, const char *mod_rev
 
         ly_ctx_set_module_imp_clb(self->swig_ctx(), g_ly_module_imp_clb, class_ctx);
     };
+
+    /* parse the data of a bytes-like object in place, without converting them to str */
+    std::shared_ptr<libyang::Data_Node> parse_data_buf(PyObject *buf, LYD_FORMAT format, int options = 0) {
+        std::shared_ptr<libyang::Data_Node> node;
+        std::string copy;
+        const char *data;
+        Py_buffer view;
+
+        if (PyObject_GetBuffer(buf, &view, PyBUF_SIMPLE)) {
+            PyErr_Clear();
+            throw std::runtime_error("Python Object does not support the buffer protocol.\n");
+        }
+
+        /* bytes and bytearray are always terminated, other buffers are copied unless they include the terminating zero */
+        data = (const char *) view.buf;
+        if (!PyBytes_Check(buf) && !PyByteArray_Check(buf) && (!view.len || data[view.len - 1])) {
+            copy.assign(data, view.len);
+            data = copy.c_str();
+        }
+
+        try {
+            node = self->parse_data_mem(data, format, options);
+        } catch (...) {
+            PyBuffer_Release(&view);
+            throw;
+        }
+        PyBuffer_Release(&view);
+        return node;
+    }
 }
 
 %extend libyang::Data_Node {
+    /* print into a bytearray, appending to buf if given, without the intermediate copies of print_mem() */
+    PyObject *print_buf(LYD_FORMAT format, int options, PyObject *buf = nullptr) {
+        if (!buf || buf == Py_None) {
+            buf = PyByteArray_FromStringAndSize(nullptr, 0);
+            if (!buf) {
+                throw std::runtime_error("Failed to create a bytearray.\n");
+            }
+        } else if (PyByteArray_Check(buf)) {
+            Py_INCREF(buf);
+        } else {
+            throw std::runtime_error("Python Object is not a bytearray.\n");
+        }
+
+        if (lyd_print_iov(g_print_bytearray, buf, self->swig_node(), format, options)) {
+            Py_DECREF(buf);
+            PyErr_Clear();
+            libyang::check_libyang_error(self->swig_node()->schema->module->ctx);
+            throw std::runtime_error("Failed to print the data tree.\n");
+        }
+
+        return buf;
+    }
+
     PyObject *subtype() {
         PyObject *casted = 0;
 
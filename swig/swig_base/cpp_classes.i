@@ -422,6 +422,7 @@
 %template(vectorData_Node) std::vector<std::shared_ptr<libyang::Data_Node>>;
 %template(vectorSchema_Node) std::vector<std::shared_ptr<libyang::Schema_Node>>;
 %template(vector_String) std::vector<std::string>;
+%template(vector_Double) std::vector<double>;
 %template(vectorModules) std::vector<std::shared_ptr<libyang::Module>>;
 %template(vectorType) std::vector<std::shared_ptr<libyang::Type>>;
 %template(vectorExt_Instance) std::vector<std::shared_ptr<libyang::Ext_Instance>>;
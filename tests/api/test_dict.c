@@ -26,9 +26,12 @@
 #include <sys/mman.h>
 #include <unistd.h>
 #include <string.h>
+#include <stdint.h>
+#include <pthread.h>
 
 #include "tests/config.h"
 #include "libyang.h"
+#include "../../src/context.h"
 
 struct ly_ctx *ctx = NULL;
 
@@ -244,6 +247,120 @@ test_similar_strings(void **state) {
     lydict_remove(ctx, "bbba");
 }
 
+static void
+test_partial_strings(void **state) {
+    (void) state; /* unused */
+
+    const char *ret, *ret2;
+
+    /* only the first 3 characters are stored */
+    ret = lydict_insert(ctx, "aaab", 3);
+    if (!ret) {
+        fail();
+    }
+    assert_string_equal(ret, "aaa");
+
+    ret2 = lydict_insert(ctx, "aaa", 0);
+    assert_ptr_equal(ret2, ret);
+
+    ret2 = lydict_insert(ctx, "aaab", 4);
+    if (!ret2) {
+        fail();
+    }
+    assert_ptr_not_equal(ret2, ret);
+    assert_string_equal(ret2, "aaab");
+
+    lydict_remove(ctx, "aaa");
+    lydict_remove(ctx, "aaab");
+
+    /* one reference is still held */
+    ret2 = lydict_insert(ctx, "aaa", 0);
+    assert_ptr_equal(ret2, ret);
+
+    lydict_remove(ctx, "aaa");
+    lydict_remove(ctx, "aaa");
+}
+
+static uint32_t
+dict_used_count(struct ly_ctx *ctx)
+{
+    uint32_t used = 0;
+    int i;
+
+    for (i = 0; i < LYDICT_SHARDS; i++) {
+        used += ctx->dict->shards[i].hash_tab->used;
+    }
+
+    return used;
+}
+
+#define THREAD_COUNT 4
+#define THREAD_STRINGS 32
+
+static void *
+refcount_thread(void *arg)
+{
+    const char *held[THREAD_STRINGS] = {NULL};
+    char buf[32];
+    unsigned int seed = (unsigned int)(uintptr_t)arg;
+    int i, j;
+
+    for (i = 0; i < 20000; ++i) {
+        j = rand_r(&seed) % THREAD_STRINGS;
+        sprintf(buf, "string%d", j);
+        if (held[j]) {
+            if (strcmp(held[j], buf)) {
+                return (void *)1;
+            }
+            lydict_remove(ctx, held[j]);
+            held[j] = NULL;
+        } else if (rand_r(&seed) % 2) {
+            held[j] = lydict_insert(ctx, buf, 0);
+        } else {
+            held[j] = lydict_insert_zc(ctx, strdup(buf));
+        }
+    }
+
+    for (j = 0; j < THREAD_STRINGS; ++j) {
+        if (held[j]) {
+            lydict_remove(ctx, held[j]);
+        }
+    }
+    return NULL;
+}
+
+static void
+test_concurrent_refcount(void **state)
+{
+    (void) state; /* unused */
+
+    pthread_t threads[THREAD_COUNT];
+    const char *str;
+    void *ret;
+    uintptr_t i;
+    uint32_t used;
+
+    used = dict_used_count(ctx);
+
+    /* all the threads share the same strings */
+    for (i = 0; i < THREAD_COUNT; ++i) {
+        assert_int_equal(pthread_create(&threads[i], NULL, refcount_thread, (void *)(i + 1)), 0);
+    }
+    for (i = 0; i < THREAD_COUNT; ++i) {
+        assert_int_equal(pthread_join(threads[i], &ret), 0);
+        assert_ptr_equal(ret, NULL);
+    }
+
+    /* no references are left, all the strings were removed */
+    assert_int_equal(dict_used_count(ctx), used);
+
+    str = lydict_insert(ctx, "string0XX", 7);
+    assert_string_equal(str, "string0");
+    assert_int_equal(dict_used_count(ctx), used + 1);
+    lydict_remove(ctx, str);
+    assert_int_equal(dict_used_count(ctx), used);
+}
+
 int main(void)
 {
     const struct CMUnitTest tests[] = {
@@ -251,6 +368,8 @@ int main(void)
         cmocka_unit_test_setup_teardown(test_lydict_insert_zc, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_lydict_remove, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_similar_strings, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_partial_strings, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_concurrent_refcount, setup_f, teardown_f),
     };
 
     return cmocka_run_group_tests(tests, NULL, NULL);
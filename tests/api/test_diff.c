@@ -15,6 +15,7 @@
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <setjmp.h>
 #include <cmocka.h>
 
@@ -344,9 +345,10 @@ test_move2(void **state)
     assert_ptr_not_equal((diff = lyd_diff(st->first, st->second, 0)), NULL);
     assert_ptr_not_equal(diff->type, NULL);
 
+    /* 1, 4 and 5 keep their places */
     assert_int_equal(diff->type[0], LYD_DIFF_MOVEDAFTER1);
     assert_ptr_not_equal(diff->first[0], NULL);
-    assert_string_equal((str = lyd_path(diff->first[0])), "/defaults:df/llist[.='2']");
+    assert_string_equal((str = lyd_path(diff->first[0])), "/defaults:df/llist[.='3']");
     free(str);
     assert_ptr_not_equal(diff->second[0], NULL);
     assert_string_equal((str = lyd_path(diff->second[0])), "/defaults:df/llist[.='4']");
@@ -354,10 +356,10 @@ test_move2(void **state)
 
     assert_int_equal(diff->type[1], LYD_DIFF_MOVEDAFTER1);
     assert_ptr_not_equal(diff->first[1], NULL);
-    assert_string_equal((str = lyd_path(diff->first[1])), "/defaults:df/llist[.='4']");
+    assert_string_equal((str = lyd_path(diff->first[1])), "/defaults:df/llist[.='2']");
     free(str);
     assert_ptr_not_equal(diff->second[1], NULL);
-    assert_string_equal((str = lyd_path(diff->second[1])), "/defaults:df/llist[.='1']");
+    assert_string_equal((str = lyd_path(diff->second[1])), "/defaults:df/llist[.='3']");
     free(str);
 
     assert_int_equal(diff->type[2], LYD_DIFF_END);
@@ -405,6 +407,57 @@ test_move3(void **state)
     lyd_free_diff(diff);
 }
 
+static void
+test_move_long(void **state)
+{
+    struct state *st = (*state);
+    char *xml1, *xml2, *str;
+    int i, len1, len2;
+    struct lyd_difflist *diff;
+
+    xml1 = malloc(16384);
+    xml2 = malloc(16384);
+    assert_non_null(xml1);
+    assert_non_null(xml2);
+
+    /* llist 150 is moved to the beginning and llist 10 to the end */
+    len1 = sprintf(xml1, "<df xmlns=\"urn:libyang:tests:defaults\">");
+    len2 = sprintf(xml2, "<df xmlns=\"urn:libyang:tests:defaults\"><llist>150</llist>");
+    for (i = 0; i < 200; ++i) {
+        len1 += sprintf(xml1 + len1, "<llist>%d</llist>", i);
+        if ((i != 10) && (i != 150)) {
+            len2 += sprintf(xml2 + len2, "<llist>%d</llist>", i);
+        }
+    }
+    strcpy(xml1 + len1, "</df>");
+    strcpy(xml2 + len2, "<llist>10</llist></df>");
+
+    st->first = lyd_parse_mem(st->ctx, xml1, LYD_XML, LYD_OPT_CONFIG);
+    st->second = lyd_parse_mem(st->ctx, xml2, LYD_XML, LYD_OPT_CONFIG);
+    free(xml1);
+    free(xml2);
+    assert_ptr_not_equal(st->first, NULL);
+    assert_ptr_not_equal(st->second, NULL);
+
+    assert_ptr_not_equal((diff = lyd_diff(st->first, st->second, 0)), NULL);
+    assert_ptr_not_equal(diff->type, NULL);
+
+    assert_int_equal(diff->type[0], LYD_DIFF_MOVEDAFTER1);
+    assert_string_equal((str = lyd_path(diff->first[0])), "/defaults:df/llist[.='150']");
+    free(str);
+    assert_ptr_equal(diff->second[0], NULL);
+
+    assert_int_equal(diff->type[1], LYD_DIFF_MOVEDAFTER1);
+    assert_string_equal((str = lyd_path(diff->first[1])), "/defaults:df/llist[.='10']");
+    free(str);
+    assert_string_equal((str = lyd_path(diff->second[1])), "/defaults:df/llist[.='199']");
+    free(str);
+
+    assert_int_equal(diff->type[2], LYD_DIFF_END);
+
+    lyd_free_diff(diff);
+}
+
 static void
 test_mix1(void **state)
 {
@@ -561,6 +614,109 @@ test_wd1(void **state)
     lyd_free_diff(diff);
 }
 
+static void
+test_toplevel_list(void **state)
+{
+    struct state *st = (*state);
+    const char *yang = "module tl {"
+                       "  namespace urn:tl;"
+                       "  prefix tl;"
+                       "  list item { key name; leaf name { type string; } leaf value { type uint32; } }"
+                       "}";
+    char xml1[2048], xml2[2048], *str;
+    int i, len1 = 0, len2 = 0;
+    struct lyd_difflist *diff;
+
+    assert_ptr_not_equal(lys_parse_mem(st->ctx, yang, LYS_IN_YANG), NULL);
+
+    /* the second tree has the items in the reverse order, item0 is deleted, item20 created and item5 changed */
+    for (i = 0; i < 20; ++i) {
+        len1 += sprintf(xml1 + len1, "<item xmlns=\"urn:tl\"><name>item%d</name><value>%d</value></item>", i, i);
+    }
+    len2 += sprintf(xml2 + len2, "<item xmlns=\"urn:tl\"><name>item20</name><value>20</value></item>");
+    for (i = 19; i > 0; --i) {
+        len2 += sprintf(xml2 + len2, "<item xmlns=\"urn:tl\"><name>item%d</name><value>%d</value></item>", i,
+                        (i == 5) ? 50 : i);
+    }
+
+    assert_ptr_not_equal((st->first = lyd_parse_mem(st->ctx, xml1, LYD_XML, LYD_OPT_CONFIG)), NULL);
+    assert_ptr_not_equal((st->second = lyd_parse_mem(st->ctx, xml2, LYD_XML, LYD_OPT_CONFIG)), NULL);
+
+    assert_ptr_not_equal((diff = lyd_diff(st->first, st->second, 0)), NULL);
+    assert_ptr_not_equal(diff->type, NULL);
+
+    assert_int_equal(diff->type[0], LYD_DIFF_CHANGED);
+    assert_string_equal((str = lyd_path(diff->first[0])), "/tl:item[name='item5']/value");
+    free(str);
+    assert_int_equal(((struct lyd_node_leaf_list *)diff->second[0])->value.uint32, 50);
+
+    assert_int_equal(diff->type[1], LYD_DIFF_DELETED);
+    assert_string_equal((str = lyd_path(diff->first[1])), "/tl:item[name='item0']");
+    free(str);
+    assert_ptr_equal(diff->second[1], NULL);
+
+    assert_int_equal(diff->type[2], LYD_DIFF_CREATED);
+    assert_ptr_equal(diff->first[2], NULL);
+    assert_string_equal((str = lyd_path(diff->second[2])), "/tl:item[name='item20']");
+    free(str);
+
+    assert_int_equal(diff->type[3], LYD_DIFF_END);
+
+    lyd_free_diff(diff);
+}
+
+static void
+test_parallel(void **state)
+{
+    struct state *st = (*state);
+    const char *xml1 = "<df xmlns=\"urn:libyang:tests:defaults\">"
+                        "<foo>42</foo>"
+                      "</df><hidden xmlns=\"urn:libyang:tests:defaults\">"
+                        "<foo>42</foo><baz>42</baz></hidden>";
+    const char *xml2 = "<df xmlns=\"urn:libyang:tests:defaults\">"
+                        "<foo>41</foo><b1_1>42</b1_1>"
+                      "</df><hidden xmlns=\"urn:libyang:tests:defaults\">"
+                        "<foo>42</foo><baz>43</baz></hidden>";
+    char *str;
+    struct lyd_difflist *diff;
+
+    ly_ctx_set_validation_threads(st->ctx, 2);
+    assert_ptr_not_equal((st->first = lyd_parse_mem(st->ctx, xml1, LYD_XML, LYD_OPT_CONFIG)), NULL);
+    assert_ptr_not_equal((st->second = lyd_parse_mem(st->ctx, xml2, LYD_XML, LYD_OPT_CONFIG)), NULL);
+
+    assert_ptr_not_equal((diff = lyd_diff(st->first, st->second, LYD_DIFFOPT_PARALLEL)), NULL);
+    assert_ptr_not_equal(diff->type, NULL);
+
+    /* the differences are grouped by the top-level subtrees */
+    assert_int_equal(diff->type[0], LYD_DIFF_CHANGED);
+    assert_string_equal((str = lyd_path(diff->first[0])), "/defaults:df/foo");
+    free(str);
+    assert_string_equal((str = lyd_path(diff->second[0])), "/defaults:df/foo");
+    free(str);
+
+    assert_int_equal(diff->type[1], LYD_DIFF_CREATED);
+    assert_string_equal((str = lyd_path(diff->first[1])), "/defaults:df");
+    free(str);
+    assert_string_equal((str = lyd_path(diff->second[1])), "/defaults:df/b1_1");
+    free(str);
+
+    assert_int_equal(diff->type[2], LYD_DIFF_CHANGED);
+    assert_string_equal((str = lyd_path(diff->first[2])), "/defaults:hidden/baz");
+    free(str);
+    assert_int_equal(((struct lyd_node_leaf_list *)diff->second[2])->value.int32, 43);
+
+    assert_int_equal(diff->type[3], LYD_DIFF_END);
+    lyd_free_diff(diff);
+
+    /* the trees are left intact for another diff */
+    assert_ptr_not_equal((diff = lyd_diff(st->first, st->second, 0)), NULL);
+    assert_int_equal(diff->type[0], LYD_DIFF_CHANGED);
+    assert_int_equal(diff->type[1], LYD_DIFF_CHANGED);
+    assert_int_equal(diff->type[2], LYD_DIFF_CREATED);
+    assert_int_equal(diff->type[3], LYD_DIFF_END);
+    lyd_free_diff(diff);
+}
+
 int main(void)
 {
     const struct CMUnitTest tests[] = {
@@ -573,9 +729,12 @@ int main(void)
                     cmocka_unit_test_setup_teardown(test_move1, setup_f, teardown_f),
                     cmocka_unit_test_setup_teardown(test_move2, setup_f, teardown_f),
                     cmocka_unit_test_setup_teardown(test_move3, setup_f, teardown_f),
+                    cmocka_unit_test_setup_teardown(test_move_long, setup_f, teardown_f),
                     cmocka_unit_test_setup_teardown(test_mix1, setup_f, teardown_f),
                     cmocka_unit_test_setup_teardown(test_mix2, setup_f, teardown_f),
-                    cmocka_unit_test_setup_teardown(test_wd1, setup_f, teardown_f), };
+                    cmocka_unit_test_setup_teardown(test_wd1, setup_f, teardown_f),
+                    cmocka_unit_test_setup_teardown(test_toplevel_list, setup_f, teardown_f),
+                    cmocka_unit_test_setup_teardown(test_parallel, setup_f, teardown_f), };
 
     return cmocka_run_group_tests(tests, NULL, NULL);
 }
@@ -27,6 +27,7 @@
 #include <unistd.h>
 #include <string.h>
 #include <limits.h>
+#include <pthread.h>
 
 #include "tests/config.h"
 #include "libyang.h"
@@ -38,6 +39,19 @@ struct ly_ctx *ctx = NULL;
 struct lyd_node *root = NULL;
 const struct lys_module *module = NULL;
 
+static uint32_t
+dict_used_count(struct ly_ctx *ctx)
+{
+    uint32_t used = 0;
+    int i;
+
+    for (i = 0; i < LYDICT_SHARDS; i++) {
+        used += ctx->dict->shards[i].hash_tab->used;
+    }
+
+    return used;
+}
+
 static int
 setup_f(void **state)
 {
@@ -128,6 +142,94 @@ test_ly_ctx_new_invalid(void **state)
     }
 }
 
+static void
+test_ly_ctx_new_internal_patterns(void **state)
+{
+    const char *yang = "module p {namespace urn:p; prefix p; import ietf-yang-types {prefix yang;}"
+        "leaf addr {type yang:mac-address;}}";
+    const struct lys_module *mod, *types;
+    struct lys_tpdf *tpdf = NULL;
+    struct lyd_node *data;
+    int i;
+    (void) state; /* unused */
+
+    ctx = ly_ctx_new(NULL, 0);
+    assert_ptr_not_equal(NULL, ctx);
+    /* the internal modules are loaded as trusted, the context itself is not */
+    assert_int_equal(ctx->models.flags & LY_CTX_TRUSTED, 0);
+    types = ly_ctx_get_module(ctx, "ietf-yang-types", NULL, 0);
+    assert_ptr_not_equal(NULL, types);
+    for (i = 0; i < types->tpdf_size; ++i) {
+        if (!strcmp(types->tpdf[i].name, "mac-address")) {
+            tpdf = &types->tpdf[i];
+        }
+    }
+    assert_ptr_not_equal(NULL, tpdf);
+    assert_int_equal(tpdf->type.info.str.pat_count, 1);
+    mod = lys_parse_mem(ctx, yang, LYS_IN_YANG);
+    assert_ptr_not_equal(NULL, mod);
+
+#ifdef LY_ENABLED_CACHE
+    /* the patterns of the internal types are compiled on their first use */
+    assert_ptr_equal(NULL, tpdf->type.info.str.patterns_pcre);
+#endif
+    data = lyd_new_leaf(NULL, mod, "addr", "00:11:22:33:44:55");
+    assert_ptr_not_equal(NULL, data);
+    lyd_free(data);
+#ifdef LY_ENABLED_CACHE
+    assert_ptr_not_equal(NULL, tpdf->type.info.str.patterns_pcre);
+#endif
+
+    ly_ctx_destroy(ctx, NULL);
+    ctx = NULL;
+}
+
+static void
+test_ly_ctx_new_no_descriptions(void **state)
+{
+    const char *yang = "module d {namespace urn:d; prefix d; organization org; description dsc; reference ref;"
+        "revision 2020-01-01 {description rev;}"
+        "leaf l {type enumeration {enum a {description enm;}} must \".\" {description must;} description leaf;}}";
+    const char *yin = "<module name=\"y\" xmlns=\"urn:ietf:params:xml:ns:yang:yin:1\">"
+        "<namespace uri=\"urn:y\"/><prefix value=\"y\"/><description><text>dsc</text></description>"
+        "<container name=\"c\"><description><text>cont</text></description>"
+        "<reference><text>ref</text></reference></container></module>";
+    const struct lys_module *mod;
+    struct lys_node_leaf *leaf;
+    (void) state; /* unused */
+
+    ctx = ly_ctx_new(NULL, LY_CTX_NO_DESCRIPTIONS);
+    assert_ptr_not_equal(NULL, ctx);
+
+    mod = lys_parse_mem(ctx, yang, LYS_IN_YANG);
+    assert_ptr_not_equal(NULL, mod);
+    assert_ptr_equal(NULL, mod->dsc);
+    assert_ptr_equal(NULL, mod->ref);
+    assert_string_equal(mod->org, "org");
+    assert_ptr_equal(NULL, mod->rev[0].dsc);
+    leaf = (struct lys_node_leaf *)mod->data;
+    assert_ptr_equal(NULL, leaf->dsc);
+    assert_ptr_equal(NULL, leaf->must[0].dsc);
+    assert_ptr_equal(NULL, leaf->type.info.enums.enm[0].dsc);
+
+    mod = lys_parse_mem(ctx, yin, LYS_IN_YIN);
+    assert_ptr_not_equal(NULL, mod);
+    assert_ptr_equal(NULL, mod->dsc);
+    assert_ptr_equal(NULL, mod->data->dsc);
+    assert_ptr_equal(NULL, mod->data->ref);
+    ly_ctx_destroy(ctx, NULL);
+
+    ctx = ly_ctx_new(NULL, 0);
+    assert_ptr_not_equal(NULL, ctx);
+    mod = lys_parse_mem(ctx, yang, LYS_IN_YANG);
+    assert_ptr_not_equal(NULL, mod);
+    assert_string_equal(mod->dsc, "dsc");
+    assert_string_equal(mod->data->dsc, "leaf");
+
+    ly_ctx_destroy(ctx, NULL);
+    ctx = NULL;
+}
+
 static void
 test_ly_ctx_get_searchdirs(void **state)
 {
@@ -248,12 +350,57 @@ test_ly_ctx_info(void **state)
     lyd_free_withsiblings(node);
 }
 
+static void
+test_ly_ctx_info_cache(void **state)
+{
+    const char *mem_mod = "module mem {namespace urn:mem; prefix m; leaf l {type string;}}";
+    struct lyd_node *node;
+    char *mem1, *mem2;
+    (void) state; /* unused */
+
+    node = ly_ctx_info(ctx);
+    assert_ptr_not_equal(node, NULL);
+    assert_int_equal(lyd_print_mem(&mem1, node, LYD_XML, LYP_WITHSIBLINGS), 0);
+    lyd_free_withsiblings(node);
+
+    /* the same data again, as a separate copy */
+    node = ly_ctx_info(ctx);
+    assert_ptr_not_equal(node, NULL);
+    assert_int_equal(LYD_VAL_OK, node->validity);
+    assert_int_equal(lyd_print_mem(&mem2, node, LYD_XML, LYP_WITHSIBLINGS), 0);
+    lyd_free_withsiblings(node);
+    assert_string_equal(mem1, mem2);
+    free(mem2);
+
+    /* a feature does not change the module set ID */
+    assert_int_equal(lys_features_enable(ly_ctx_get_module(ctx, "a", NULL, 0), "foo"), 0);
+    node = ly_ctx_info(ctx);
+    assert_ptr_not_equal(node, NULL);
+    assert_int_equal(lyd_print_mem(&mem2, node, LYD_XML, LYP_WITHSIBLINGS), 0);
+    lyd_free_withsiblings(node);
+    assert_string_not_equal(mem1, mem2);
+    assert_ptr_not_equal(strstr(mem2, "<feature>foo</feature>"), NULL);
+    free(mem1);
+
+    /* a new module */
+    assert_ptr_not_equal(lys_parse_mem(ctx, mem_mod, LYS_IN_YANG), NULL);
+    node = ly_ctx_info(ctx);
+    assert_ptr_not_equal(node, NULL);
+    assert_int_equal(lyd_print_mem(&mem1, node, LYD_XML, LYP_WITHSIBLINGS), 0);
+    lyd_free_withsiblings(node);
+    assert_ptr_equal(strstr(mem2, "<name>mem</name>"), NULL);
+    assert_ptr_not_equal(strstr(mem1, "<name>mem</name>"), NULL);
+    free(mem1);
+    free(mem2);
+}
+
 static void
 test_ly_ctx_new_ylmem(void **state)
 {
     struct lyd_node *node;
     char *mem;
     struct ly_ctx *new_ctx;
+    int i;
     (void) state; /* unused */
 
     node = ly_ctx_info(ctx);
@@ -269,12 +416,177 @@ test_ly_ctx_new_ylmem(void **state)
     if (!new_ctx) {
         fail();
     }
+    ly_ctx_destroy(new_ctx, NULL);
+
+    /* the same modules are loaded from the files read in advance */
+    new_ctx = ly_ctx_new_ylmem(TESTS_DIR"/api/files", mem, LYD_XML, LY_CTX_PARALLEL_LOAD);
+    if (!new_ctx) {
+        fail();
+    }
+    assert_int_equal(new_ctx->models.used, ctx->models.used);
+    for (i = 0; i < ctx->models.used; ++i) {
+        assert_string_equal(new_ctx->models.list[i]->name, ctx->models.list[i]->name);
+        assert_int_equal(new_ctx->models.list[i]->implemented, ctx->models.list[i]->implemented);
+    }
+    assert_ptr_equal(new_ctx->models.prefetch, NULL);
 
     lyd_free_withsiblings(node);
     free(mem);
     ly_ctx_destroy(new_ctx, NULL);
 }
 
+static void
+test_ly_ctx_new_image(void **state)
+{
+    (void) state; /* unused */
+    char path[] = "/tmp/libyang_image_XXXXXX";
+    const char *mem_mod = "module mem {namespace urn:mem; prefix m; import a {prefix a;} feature f; leaf l {type string;}}";
+    const struct lys_module *mod;
+    const char **features;
+    struct lyd_node *data;
+    struct ly_ctx *new_ctx;
+    uint8_t *states;
+    int fd, i;
+
+    mod = ly_ctx_get_module(ctx, "a", NULL, 0);
+    assert_ptr_not_equal(mod, NULL);
+    assert_int_equal(lys_features_enable(mod, "fox"), 0);
+    mod = lys_parse_mem(ctx, mem_mod, LYS_IN_YANG);
+    assert_ptr_not_equal(mod, NULL);
+    assert_int_equal(lys_features_enable(mod, "f"), 0);
+    assert_ptr_not_equal(ly_ctx_load_module(ctx, "c", NULL), NULL);
+    assert_int_equal(lys_set_disabled(ly_ctx_get_module(ctx, "c", NULL, 0)), 0);
+
+    fd = mkstemp(path);
+    assert_int_not_equal(fd, -1);
+    close(fd);
+    assert_int_equal(ly_ctx_print_image(ctx, path), 0);
+
+    /* no search directory, everything is taken from the image */
+    new_ctx = ly_ctx_new_image(NULL, path, 0);
+    assert_ptr_not_equal(new_ctx, NULL);
+    assert_int_equal(new_ctx->models.used, ctx->models.used);
+    for (i = 0; i < ctx->models.used; ++i) {
+        assert_string_equal(new_ctx->models.list[i]->name, ctx->models.list[i]->name);
+        assert_int_equal(new_ctx->models.list[i]->implemented, ctx->models.list[i]->implemented);
+        assert_int_equal(new_ctx->models.list[i]->disabled, ctx->models.list[i]->disabled);
+    }
+
+    mod = ly_ctx_get_module(new_ctx, "a", NULL, 0);
+    assert_ptr_not_equal(mod, NULL);
+    features = lys_features_list(mod, &states);
+    for (i = 0; features[i]; ++i) {
+        assert_int_equal(states[i], !strcmp(features[i], "fox"));
+    }
+    free(features);
+    free(states);
+    assert_int_equal(lys_features_state(ly_ctx_get_module(new_ctx, "mem", NULL, 0), "f"), 1);
+    assert_ptr_equal(ly_ctx_get_module(new_ctx, "c", NULL, 1), NULL);
+
+    /* the deviation is applied the same way */
+    data = lyd_parse_path(new_ctx, TESTS_DIR"/api/files/a.xml", LYD_XML, LYD_OPT_CONFIG | LYD_OPT_STRICT);
+    assert_ptr_not_equal(data, NULL);
+    lyd_free_withsiblings(data);
+    ly_ctx_destroy(new_ctx, NULL);
+
+    /* truncated image */
+    assert_int_equal(truncate(path, 64), 0);
+    assert_ptr_equal(ly_ctx_new_image(NULL, path, 0), NULL);
+    unlink(path);
+}
+
+static void
+test_ly_ctx_clone(void **state)
+{
+    (void) state; /* unused */
+    const char *mem_mod = "module mem {namespace urn:mem; prefix m; import a {prefix a;} feature f; leaf l {type string;}}";
+    const struct lys_module *mod;
+    struct lyd_node *data;
+    struct ly_ctx *new_ctx;
+    int i;
+
+    mod = ly_ctx_get_module(ctx, "a", NULL, 0);
+    assert_ptr_not_equal(mod, NULL);
+    assert_int_equal(lys_features_enable(mod, "fox"), 0);
+    mod = lys_parse_mem(ctx, mem_mod, LYS_IN_YANG);
+    assert_ptr_not_equal(mod, NULL);
+    assert_int_equal(lys_features_enable(mod, "f"), 0);
+    assert_ptr_not_equal(ly_ctx_load_module(ctx, "c", NULL), NULL);
+    assert_int_equal(lys_set_disabled(ly_ctx_get_module(ctx, "c", NULL, 0)), 0);
+
+    new_ctx = ly_ctx_clone(ctx);
+    assert_ptr_not_equal(new_ctx, NULL);
+    assert_ptr_equal(new_ctx->dict, ctx->dict);
+    assert_string_equal(ly_ctx_get_searchdirs(new_ctx)[0], ly_ctx_get_searchdirs(ctx)[0]);
+    assert_int_equal(new_ctx->models.used, ctx->models.used);
+    for (i = 0; i < ctx->models.used; ++i) {
+        /* the same strings from the shared dictionary */
+        assert_ptr_equal(new_ctx->models.list[i]->name, ctx->models.list[i]->name);
+        assert_ptr_not_equal(new_ctx->models.list[i], ctx->models.list[i]);
+        assert_int_equal(new_ctx->models.list[i]->implemented, ctx->models.list[i]->implemented);
+        assert_int_equal(new_ctx->models.list[i]->disabled, ctx->models.list[i]->disabled);
+    }
+    assert_int_equal(lys_features_state(ly_ctx_get_module(new_ctx, "a", NULL, 0), "fox"), 1);
+    assert_int_equal(lys_features_state(ly_ctx_get_module(new_ctx, "mem", NULL, 0), "f"), 1);
+    assert_ptr_equal(ly_ctx_get_module(new_ctx, "c", NULL, 1), NULL);
+
+    /* the clone outlives the original context */
+    lyd_free_withsiblings(root);
+    root = NULL;
+    ly_ctx_destroy(ctx, NULL);
+    ctx = new_ctx;
+    data = lyd_parse_path(ctx, TESTS_DIR"/api/files/a.xml", LYD_XML, LYD_OPT_CONFIG | LYD_OPT_STRICT);
+    assert_ptr_not_equal(data, NULL);
+    lyd_free_withsiblings(data);
+}
+
+static void
+test_ly_ctx_precompile(void **state)
+{
+    (void) state; /* unused */
+    const char *yang = "module p {namespace urn:p; prefix p; feature f;"
+        "container c {presence p; must \"l\"; when \"true()\";"
+        "leaf l {if-feature f; type string {pattern \"[a-z]+\"; length 1..5;}}"
+        "leaf-list n {type int8 {range 0..10;}}}}";
+    const struct lys_module *mod;
+    struct lys_node_container *cont;
+    struct lys_node_leaf *leaf;
+    struct lyd_node *data;
+    struct ly_ctx *new_ctx;
+
+    assert_int_equal(ly_ctx_precompile(NULL), EXIT_FAILURE);
+
+    /* the patterns of trusted schemas are compiled only on the first use */
+    new_ctx = ly_ctx_new(NULL, LY_CTX_TRUSTED);
+    assert_ptr_not_equal(new_ctx, NULL);
+    mod = lys_parse_mem(new_ctx, yang, LYS_IN_YANG);
+    assert_ptr_not_equal(mod, NULL);
+    assert_int_equal(ly_ctx_precompile(new_ctx), EXIT_SUCCESS);
+
+    cont = (struct lys_node_container *)mod->data;
+    leaf = (struct lys_node_leaf *)cont->child;
+#ifdef LY_ENABLED_CACHE
+    assert_ptr_not_equal(cont->must[0].expr_xpath, NULL);
+    assert_ptr_not_equal(cont->when->cond_xpath, NULL);
+    assert_ptr_not_equal(leaf->type.info.str.patterns_pcre, NULL);
+    assert_ptr_not_equal(leaf->type.info.str.length->intv, NULL);
+    assert_ptr_not_equal(((struct lys_node_leaf *)leaf->next)->type.info.num.range->intv, NULL);
+    assert_int_not_equal(leaf->iffeature[0].value_cache, 0);
+#endif
+
+    /* the prepared caches are used and the feature changes still apply */
+    assert_int_equal(lys_features_enable(mod, "f"), 0);
+    assert_int_equal(ly_ctx_precompile(new_ctx), EXIT_SUCCESS);
+    data = lyd_new_path(NULL, new_ctx, "/p:c/l", "abc", 0, 0);
+    assert_ptr_not_equal(data, NULL);
+    assert_int_equal(lyd_validate(&data, LYD_OPT_CONFIG, NULL), 0);
+    lyd_free_withsiblings(data);
+    data = lyd_new_path(NULL, new_ctx, "/p:c/n", "20", 0, 0);
+    assert_ptr_equal(data, NULL);
+
+    ly_ctx_destroy(new_ctx, NULL);
+}
+
 static void
 test_ly_ctx_module_clb(void **state)
 {
@@ -450,6 +762,195 @@ test_ly_ctx_load_module(void **state)
     assert_string_equal("b", module->name);
 }
 
+static void
+write_module_file(const char *dir, const char *file, const char *name, const char *revision)
+{
+    char path[PATH_MAX];
+    FILE *f;
+
+    snprintf(path, sizeof path, "%s/%s", dir, file);
+    f = fopen(path, "w");
+    assert_ptr_not_equal(f, NULL);
+    fprintf(f, "module %s {namespace urn:%s; prefix %s; revision %s;}", name, name, name, revision);
+    fclose(f);
+}
+
+static void
+test_ly_ctx_load_module_searchdir_index(void **state)
+{
+    (void) state; /* unused */
+    char dir[] = "/tmp/libyang_searchdir_XXXXXX", path[PATH_MAX];
+    struct ly_ctx *new_ctx;
+    const struct lys_module *mod;
+
+    assert_ptr_not_equal(mkdtemp(dir), NULL);
+    write_module_file(dir, "idx@2017-01-01.yang", "idx", "2017-01-01");
+    write_module_file(dir, "idx@2018-01-01.yang", "idx", "2018-01-01");
+    write_module_file(dir, "idx-dep.yang", "idx-dep", "2017-01-01");
+
+    new_ctx = ly_ctx_new(dir, LY_CTX_DISABLE_SEARCHDIR_CWD);
+    assert_ptr_not_equal(new_ctx, NULL);
+
+    /* the newest revision, "idx" is also a prefix of "idx-dep" */
+    mod = ly_ctx_load_module(new_ctx, "idx-dep", NULL);
+    assert_ptr_not_equal(mod, NULL);
+    mod = ly_ctx_load_module(new_ctx, "idx", NULL);
+    assert_ptr_not_equal(mod, NULL);
+    assert_string_equal(mod->rev[0].date, "2018-01-01");
+    ly_ctx_destroy(new_ctx, NULL);
+
+    /* specific revision */
+    new_ctx = ly_ctx_new(dir, LY_CTX_DISABLE_SEARCHDIR_CWD);
+    assert_ptr_not_equal(new_ctx, NULL);
+    mod = ly_ctx_load_module(new_ctx, "idx", "2017-01-01");
+    assert_ptr_not_equal(mod, NULL);
+    assert_string_equal(mod->rev[0].date, "2017-01-01");
+
+    /* a file added after the index was built */
+    write_module_file(dir, "idx-new.yang", "idx-new", "2017-01-01");
+    mod = ly_ctx_load_module(new_ctx, "idx-new", NULL);
+    assert_ptr_not_equal(mod, NULL);
+
+    /* a removed file */
+    write_module_file(dir, "idx-gone.yang", "idx-gone", "2017-01-01");
+    ly_ctx_unset_searchdirs(new_ctx, -1);
+    assert_int_equal(ly_ctx_set_searchdir(new_ctx, dir), 0);
+    ly_ctx_set_disable_searchdir_cwd(new_ctx);
+    assert_ptr_not_equal(ly_ctx_load_module(new_ctx, "idx-new", NULL), NULL);
+    snprintf(path, sizeof path, "%s/idx-gone.yang", dir);
+    unlink(path);
+    assert_ptr_equal(ly_ctx_load_module(new_ctx, "idx-gone", NULL), NULL);
+
+    ly_ctx_destroy(new_ctx, NULL);
+
+    unlink(path);
+    snprintf(path, sizeof path, "%s/idx@2017-01-01.yang", dir);
+    unlink(path);
+    snprintf(path, sizeof path, "%s/idx@2018-01-01.yang", dir);
+    unlink(path);
+    snprintf(path, sizeof path, "%s/idx-dep.yang", dir);
+    unlink(path);
+    snprintf(path, sizeof path, "%s/idx-new.yang", dir);
+    unlink(path);
+    rmdir(dir);
+}
+
+struct fetch_async {
+    struct ly_fetch *request;
+    const char *data;
+};
+
+static const char *fetch_src[][2] = {
+    {"fa", "module fa { namespace urn:fa; prefix fa;\n"
+           "  // import fx { prefix fx; }\n"
+           "  import fb { prefix fb; revision-date 2018-01-01; }\n"
+           "  import 'fc' { prefix fc; }\n"
+           "  description \"import fy { prefix fy; }\";\n"
+           "  leaf a { type fb:t; } }"},
+    {"fb", "module fb { namespace urn:fb; prefix fb; include fbs;\n"
+           "  revision 2018-01-01; }"},
+    {"fbs", "submodule fbs { belongs-to fb { prefix fb; }\n"
+            "  typedef t { type string; } }"},
+    {"fc", "<module name=\"fc\" xmlns=\"urn:ietf:params:xml:ns:yang:yin:1\">"
+           "<namespace uri=\"urn:fc\"/><prefix value=\"fc\"/>"
+           "<import module=\"fb\"><prefix value=\"fb\"/></import></module>"},
+};
+
+static pthread_t fetch_threads[8];
+static int fetch_thread_count;
+static int fetch_requests;
+static int fetch_freed;
+
+static void *
+fetch_thread(void *arg)
+{
+    struct fetch_async *async = arg;
+
+    usleep(10000);
+    ly_fetch_done(async->request, async->data, async->data[0] == '<' ? LYS_IN_YIN : LYS_IN_YANG, NULL);
+    free(async);
+    return NULL;
+}
+
+static void
+fetch_free(void *model_data, void *user_data)
+{
+    (void)model_data;
+    (void)user_data;
+    ++fetch_freed;
+}
+
+static void
+fetch_clb(struct ly_fetch *request, const char *mod_name, const char *mod_rev, const char *submod_name,
+          const char *submod_rev, void *user_data)
+{
+    struct fetch_async *async;
+    const char *name = submod_name ? submod_name : mod_name;
+    unsigned int i;
+
+    (void)mod_rev;
+    (void)submod_rev;
+    (void)user_data;
+    ++fetch_requests;
+
+    for (i = 0; i < sizeof fetch_src / sizeof *fetch_src; ++i) {
+        if (!strcmp(fetch_src[i][0], name)) {
+            break;
+        }
+    }
+    if (i == sizeof fetch_src / sizeof *fetch_src) {
+        /* not available */
+        ly_fetch_done(request, NULL, LYS_IN_UNKNOWN, NULL);
+    } else if (!strcmp(name, "fa")) {
+        /* synchronously */
+        ly_fetch_done(request, fetch_src[i][1], LYS_IN_YANG, fetch_free);
+    } else {
+        /* from another thread */
+        async = malloc(sizeof *async);
+        assert_non_null(async);
+        async->request = request;
+        async->data = fetch_src[i][1];
+        assert_int_equal(pthread_create(&fetch_threads[fetch_thread_count++], NULL, fetch_thread, async), 0);
+    }
+}
+
+static void
+test_ly_ctx_fetch_modules(void **state)
+{
+    (void) state; /* unused */
+    const char *names[] = {"fa", "fz"};
+    struct ly_ctx *new_ctx;
+    const struct lys_module *mod;
+    int i;
+
+    new_ctx = ly_ctx_new(NULL, LY_CTX_DISABLE_SEARCHDIRS);
+    assert_ptr_not_equal(new_ctx, NULL);
+
+    /* "fa", "fb", "fbs" and "fc" once, nothing from the comment and the description */
+    assert_int_equal(ly_ctx_fetch_modules(new_ctx, names, NULL, 1, fetch_clb, NULL), EXIT_SUCCESS);
+    for (i = 0; i < fetch_thread_count; ++i) {
+        pthread_join(fetch_threads[i], NULL);
+    }
+    assert_int_equal(fetch_requests, 4);
+    assert_int_equal(fetch_thread_count, 3);
+    assert_int_equal(fetch_freed, 1);
+
+    mod = ly_ctx_get_module(new_ctx, "fa", NULL, 1);
+    assert_ptr_not_equal(mod, NULL);
+    mod = ly_ctx_get_module(new_ctx, "fb", "2018-01-01", 0);
+    assert_ptr_not_equal(mod, NULL);
+    assert_int_equal(mod->inc_size, 1);
+    assert_ptr_not_equal(ly_ctx_get_module(new_ctx, "fc", NULL, 0), NULL);
+
+    /* already in the context, "fz" is not available */
+    fetch_requests = fetch_thread_count = 0;
+    assert_int_equal(ly_ctx_fetch_modules(new_ctx, names, NULL, 2, fetch_clb, NULL), EXIT_FAILURE);
+    assert_int_equal(fetch_requests, 1);
+    assert_int_equal(fetch_thread_count, 0);
+
+    ly_ctx_destroy(new_ctx, NULL);
+}
+
 static void
 test_ly_ctx_clean(void **state)
 {
@@ -464,25 +965,25 @@ test_ly_ctx_clean(void **state)
     /* remember starting values */
     setid = ctx->models.module_set_id;
     modules_count = ctx->models.used;
-    dict_used = ctx->dict.hash_tab->used;
+    dict_used = dict_used_count(ctx);
 
     /* add a module */
     mod = ly_ctx_load_module(ctx, "x", NULL);
     assert_ptr_not_equal(mod, NULL);
     assert_int_equal(modules_count + 1, ctx->models.used);
-    assert_int_not_equal(dict_used, ctx->dict.hash_tab->used);
+    assert_int_not_equal(dict_used, dict_used_count(ctx));
 
     /* clean the context */
     ly_ctx_clean(ctx, NULL);
     assert_int_equal(setid + 2, ctx->models.module_set_id);
     assert_int_equal(modules_count, ctx->models.used);
-    assert_int_equal(dict_used, ctx->dict.hash_tab->used);
+    assert_int_equal(dict_used, dict_used_count(ctx));
 
     /* add a module again ... */
     mod = ly_ctx_load_module(ctx, "x", NULL);
     assert_ptr_not_equal(mod, NULL);
     assert_int_equal(modules_count + 1, ctx->models.used);
-    assert_int_not_equal(dict_used, ctx->dict.hash_tab->used);
+    assert_int_not_equal(dict_used, dict_used_count(ctx));
 
     /* .. and add some string into dictionary */
     assert_ptr_not_equal(lydict_insert(ctx, "qwertyuiop", 0), NULL);
@@ -492,7 +993,7 @@ test_ly_ctx_clean(void **state)
     ly_ctx_clean(ctx, NULL);
     assert_int_equal(setid + 4, ctx->models.module_set_id);
     assert_int_equal(modules_count, ctx->models.used);
-    assert_int_equal(dict_used, ctx->dict.hash_tab->used);
+    assert_int_equal(dict_used, dict_used_count(ctx));
 
     /* cleanup */
     lydict_remove(ctx, "qwertyuiop");
@@ -547,7 +1048,7 @@ test_ly_ctx_remove_module(void **state)
     /* remember starting values */
     setid = ctx->models.module_set_id;
     modules_count = ctx->models.used;
-    dict_used = ctx->dict.hash_tab->used;
+    dict_used = dict_used_count(ctx);
 
     mod = ly_ctx_load_module(ctx, "x", NULL);
     ly_ctx_remove_module(mod, NULL);
@@ -558,16 +1059,19 @@ test_ly_ctx_remove_module(void **state)
     assert_true(setid < ctx->models.module_set_id);
     setid = ctx->models.module_set_id;
     assert_int_equal(modules_count + 2, ctx->models.used);
-    assert_int_not_equal(dict_used, ctx->dict.hash_tab->used);
+    assert_int_not_equal(dict_used, dict_used_count(ctx));
 
     /* remove the imported module (x), that should cause removing also the loaded module (y) */
     mod = ly_ctx_get_module(ctx, "x", NULL, 0);
     assert_ptr_not_equal(mod, NULL);
+    assert_ptr_equal(ly_ctx_get_module_by_ns(ctx, mod->ns, NULL, 0), mod);
     ly_ctx_remove_module(mod, NULL);
     assert_true(setid < ctx->models.module_set_id);
     setid = ctx->models.module_set_id;
     assert_int_equal(modules_count, ctx->models.used);
-    assert_int_equal(dict_used, ctx->dict.hash_tab->used);
+    assert_int_equal(dict_used, dict_used_count(ctx));
+    assert_ptr_equal(ly_ctx_get_module(ctx, "x", NULL, 0), NULL);
+    assert_ptr_equal(ly_ctx_get_module(ctx, "y", NULL, 0), NULL);
 
     /* add a module again ... */
     mod = ly_ctx_load_module(ctx, "y", NULL);
@@ -575,14 +1079,14 @@ test_ly_ctx_remove_module(void **state)
     assert_true(setid < ctx->models.module_set_id);
     setid = ctx->models.module_set_id;
     assert_int_equal(modules_count + 2, ctx->models.used);
-    assert_int_not_equal(dict_used, ctx->dict.hash_tab->used);
+    assert_int_not_equal(dict_used, dict_used_count(ctx));
     /* ... now remove the loaded module, the imported module is supposed to be removed because it is not
      * used in any other module */
     ly_ctx_remove_module(mod, NULL);
     assert_true(setid < ctx->models.module_set_id);
     setid = ctx->models.module_set_id;
     assert_int_equal(modules_count, ctx->models.used);
-    assert_int_equal(dict_used, ctx->dict.hash_tab->used);
+    assert_int_equal(dict_used, dict_used_count(ctx));
 
     /* add a module again ... */
     mod = ly_ctx_load_module(ctx, "y", NULL);
@@ -590,7 +1094,7 @@ test_ly_ctx_remove_module(void **state)
     assert_true(setid < ctx->models.module_set_id);
     setid = ctx->models.module_set_id;
     assert_int_equal(modules_count + 2, ctx->models.used);
-    assert_int_not_equal(dict_used, ctx->dict.hash_tab->used);
+    assert_int_not_equal(dict_used, dict_used_count(ctx));
     /* and mark even the imported module 'x' as implemented ... */
     assert_int_equal(lys_set_implemented(mod->imp[0].module), EXIT_SUCCESS);
     /* ... now remove the loaded module, the imported module is supposed to be kept because it is implemented */
@@ -598,7 +1102,7 @@ test_ly_ctx_remove_module(void **state)
     assert_true(setid < ctx->models.module_set_id);
     setid = ctx->models.module_set_id;
     assert_int_equal(modules_count + 1, ctx->models.used);
-    assert_int_not_equal(dict_used, ctx->dict.hash_tab->used);
+    assert_int_not_equal(dict_used, dict_used_count(ctx));
     mod = ly_ctx_get_module(ctx, "y", NULL, 0);
     assert_ptr_equal(mod, NULL);
     mod = ly_ctx_get_module(ctx, "x", NULL, 0);
@@ -610,7 +1114,7 @@ test_ly_ctx_remove_module(void **state)
     assert_true(setid < ctx->models.module_set_id);
     setid = ctx->models.module_set_id;
     assert_int_equal(modules_count + 2, ctx->models.used);
-    assert_int_not_equal(dict_used, ctx->dict.hash_tab->used);
+    assert_int_not_equal(dict_used, dict_used_count(ctx));
     /* and add another one also importing module 'x' ... */
     assert_ptr_not_equal(ly_ctx_load_module(ctx, "z", NULL), NULL);
     assert_true(setid < ctx->models.module_set_id);
@@ -622,7 +1126,7 @@ test_ly_ctx_remove_module(void **state)
     assert_true(setid < ctx->models.module_set_id);
     setid = ctx->models.module_set_id;
     assert_int_equal(modules_count + 2, ctx->models.used);
-    assert_int_not_equal(dict_used, ctx->dict.hash_tab->used);
+    assert_int_not_equal(dict_used, dict_used_count(ctx));
     mod = ly_ctx_get_module(ctx, "y", NULL, 0);
     assert_ptr_equal(mod, NULL);
     mod = ly_ctx_get_module(ctx, "x", NULL, 0);
@@ -1035,6 +1539,77 @@ test_ly_set_rm_index(void **state)
     ly_set_free(set);
 }
 
+static void
+test_ly_set_many(void **state)
+{
+    (void) state; /* unused */
+    struct ly_set *set, *set2;
+    int items[200];
+    int i, idx;
+
+    set = ly_set_new();
+    assert_ptr_not_equal(set, NULL);
+
+    /* large enough for the items to be indexed */
+    for (i = 0; i < 150; ++i) {
+        assert_int_equal(ly_set_add(set, &items[i], 0), i);
+    }
+    for (i = 0; i < 150; ++i) {
+        assert_int_equal(ly_set_add(set, &items[i], 0), i);
+        assert_int_equal(ly_set_contains(set, &items[i]), i);
+    }
+    assert_int_equal(ly_set_contains(set, &items[150]), -1);
+
+    /* the last item is moved to the place of the removed one */
+    assert_int_equal(ly_set_rm_index(set, 10), 0);
+    assert_int_equal(ly_set_contains(set, &items[10]), -1);
+    assert_int_equal(ly_set_contains(set, &items[149]), 10);
+    assert_int_equal(ly_set_rm(set, &items[20]), 0);
+    assert_int_equal(ly_set_contains(set, &items[148]), 20);
+    assert_int_equal(ly_set_rm(set, &items[20]), 1);
+    assert_int_equal(set->number, 148);
+
+    /* duplicates */
+    assert_int_equal(ly_set_add(set, &items[0], LY_SET_OPT_USEASLIST), 148);
+    assert_int_equal(ly_set_contains(set, &items[0]), 0);
+    assert_int_equal(ly_set_add(set, &items[10], 0), 149);
+    assert_int_equal(ly_set_contains(set, &items[10]), 149);
+    assert_int_equal(ly_set_rm_index(set, 148), 0);
+    assert_int_equal(ly_set_contains(set, &items[10]), 148);
+
+    /* merge, only the new items are added */
+    set2 = ly_set_new();
+    assert_ptr_not_equal(set2, NULL);
+    for (i = 140; i < 200; ++i) {
+        assert_int_equal(ly_set_add(set2, &items[i], 0), i - 140);
+    }
+    assert_int_equal(ly_set_merge(set, set2, 0), 50);
+    assert_int_equal(set->number, 199);
+    for (i = 150; i < 200; ++i) {
+        /* removing the duplicates from the source does not keep the order of its items */
+        idx = ly_set_contains(set, &items[i]);
+        assert_in_range(idx, 149, 198);
+        assert_ptr_equal(set->set.g[idx], &items[i]);
+    }
+    assert_int_equal(ly_set_contains(set, &items[20]), -1);
+
+    /* duplicate set */
+    set2 = ly_set_dup(set);
+    assert_ptr_not_equal(set2, NULL);
+    idx = ly_set_contains(set, &items[199]);
+    assert_int_equal(ly_set_contains(set2, &items[199]), idx);
+    assert_int_equal(ly_set_rm(set2, &items[199]), 0);
+    assert_int_equal(ly_set_contains(set2, &items[199]), -1);
+    assert_int_equal(ly_set_contains(set, &items[199]), idx);
+    ly_set_free(set2);
+
+    assert_int_equal(ly_set_clean(set), 0);
+    assert_int_equal(ly_set_contains(set, &items[0]), -1);
+    assert_int_equal(ly_set_add(set, &items[0], 0), 0);
+
+    ly_set_free(set);
+}
+
 static void
 test_ly_set_free(void **state)
 {
@@ -1099,7 +1674,9 @@ test_ly_log_options(void **state)
 {
     (void)state;
     const struct ly_err_item *i;
+    struct ly_err_item *last;
     const struct lys_module *mod;
+    struct ly_ctx *ctx2;
     char *path;
 
     /* reset logging with path */
@@ -1163,6 +1740,45 @@ test_ly_log_options(void **state)
     assert_non_null(i->prev->next);
     assert_non_null(i->prev->prev->next);
 
+    /* messages neither printed nor stored still set the error number */
+    ly_err_clean(ctx, NULL);
+    ly_log_options(0);
+
+    path = ly_path_data2schema(ctx, "/a:f/g/h");
+    assert_null(path);
+    assert_int_equal(ly_errno, LY_EVALID);
+    assert_null(ly_err_first(ctx));
+
+    /* errors are kept per context, cleaning from an error keeps the older ones */
+    ly_log_options(LY_LOSTORE);
+    ctx2 = ly_ctx_new(NULL, 0);
+    assert_non_null(ctx2);
+
+    assert_null(ly_path_data2schema(ctx, "/a:f/g/h"));
+    last = ly_err_first(ctx)->prev;
+    assert_null(ly_ctx_load_module(ctx2, "INVALID_NAME", NULL));
+    assert_null(ly_path_data2schema(ctx, "/fgh:f/g/h"));
+    assert_null(ly_path_data2schema(ctx, "/a:f/g/h"));
+
+    i = ly_err_first(ctx2);
+    assert_non_null(i);
+    assert_int_equal(i->no, LY_ESYS);
+    assert_ptr_equal(i->prev, i);
+
+    assert_int_equal(last->next->vecode, LYVE_PATH_INMOD);
+    ly_err_clean(ctx, last->next);
+    assert_null(last->next);
+    assert_ptr_equal(ly_err_first(ctx)->prev, last);
+    assert_int_equal(last->vecode, LYVE_PATH_INNODE);
+    assert_int_equal(ly_errno, LY_EVALID);
+
+    ly_ctx_destroy(ctx2, NULL);
+    ctx2 = ly_ctx_new(NULL, 0);
+    assert_non_null(ctx2);
+    assert_null(ly_err_first(ctx2));
+    ly_ctx_destroy(ctx2, NULL);
+    ctx2 = NULL;
+
     ly_log_options(LY_LOLOG | LY_LOSTORE_LAST);
 
     ly_err_clean(ctx, NULL);
@@ -1456,6 +2072,308 @@ test_ly_ctx_find_path(void **state)
     ly_set_free(set);
 }
 
+static void
+test_ly_ctx_get_node_changed(void **state)
+{
+    (void) state;
+    const char *mod_a = "module na {namespace urn:na; prefix na;"
+        "container c {leaf x {type string;} choice ch {case k {leaf y {type string;}}}}"
+        "rpc r {input {leaf i {type string;}} output {leaf i {type string;}}}}";
+    const char *mod_b = "module nb {namespace urn:nb; prefix nb; import na {prefix na;}"
+        "augment /na:c {leaf z {type string;}} deviation /na:c/na:x {deviate not-supported;}}";
+    const struct lys_node *node;
+    const struct lys_module *mod;
+    struct ly_set *set;
+
+    assert_ptr_not_equal(lys_parse_mem(ctx, mod_a, LYS_IN_YANG), NULL);
+    node = ly_ctx_get_node(ctx, NULL, "/na:c/y", 0);
+    assert_ptr_not_equal(node, NULL);
+    assert_string_equal(node->name, "y");
+    assert_ptr_not_equal(ly_ctx_get_node(ctx, NULL, "/na:c/x", 0), NULL);
+    assert_ptr_equal(ly_ctx_get_node(ctx, NULL, "/na:c/z", 0), NULL);
+    set = ly_ctx_find_path(ctx, "/na:c/na:ch/na:k/na:y");
+    assert_ptr_not_equal(set, NULL);
+    assert_int_equal(set->number, 1);
+    assert_ptr_equal(set->set.s[0], node);
+    ly_set_free(set);
+
+    /* input and output children with the same name */
+    node = ly_ctx_get_node(ctx, NULL, "/na:r/i", 1);
+    assert_ptr_not_equal(node, NULL);
+    assert_int_equal(lys_parent(node)->nodetype, LYS_OUTPUT);
+    node = ly_ctx_get_node(ctx, NULL, "/na:r/i", 0);
+    assert_ptr_not_equal(node, NULL);
+    assert_int_equal(lys_parent(node)->nodetype, LYS_INPUT);
+
+    /* the children of the container change */
+    mod = lys_parse_mem(ctx, mod_b, LYS_IN_YANG);
+    assert_ptr_not_equal(mod, NULL);
+    assert_ptr_not_equal(ly_ctx_get_node(ctx, NULL, "/na:c/nb:z", 0), NULL);
+    assert_ptr_equal(ly_ctx_get_node(ctx, NULL, "/na:c/x", 0), NULL);
+    assert_ptr_not_equal(ly_ctx_get_node(ctx, NULL, "/na:c/y", 0), NULL);
+
+    assert_int_equal(lys_set_disabled(mod), 0);
+    assert_ptr_equal(ly_ctx_get_node(ctx, NULL, "/na:c/nb:z", 0), NULL);
+    assert_ptr_not_equal(ly_ctx_get_node(ctx, NULL, "/na:c/x", 0), NULL);
+}
+
+static void
+test_ly_ctx_get_node_cached(void **state)
+{
+    (void) state;
+    const char *yang = "module nc {namespace urn:nc; prefix nc;"
+        "list l {key k; leaf k {type int32;} leaf v {type string;}}}";
+    const struct lys_node *node;
+    const struct lys_module *mod;
+    struct ly_set *set1, *set2;
+    char path[32];
+    int i;
+
+    mod = lys_parse_mem(ctx, yang, LYS_IN_YANG);
+    assert_ptr_not_equal(mod, NULL);
+
+    /* repeated lookups give the same results, the sets are separate copies */
+    node = ly_ctx_get_node(ctx, NULL, "/nc:l/v", 0);
+    assert_ptr_not_equal(node, NULL);
+    assert_ptr_equal(ly_ctx_get_node(ctx, NULL, "/nc:l/v", 0), node);
+    set1 = ly_ctx_find_path(ctx, "/nc:l/nc:v");
+    assert_ptr_not_equal(set1, NULL);
+    set2 = ly_ctx_find_path(ctx, "/nc:l/nc:v");
+    assert_ptr_not_equal(set2, NULL);
+    assert_ptr_not_equal(set1, set2);
+    assert_int_equal(set2->number, 1);
+    assert_ptr_equal(set2->set.s[0], node);
+    ly_set_free(set1);
+    ly_set_free(set2);
+
+    /* many different paths do not break the lookups */
+    for (i = 0; i < 10000; ++i) {
+        sprintf(path, "/nc:l[k='%d']/v", i);
+        assert_ptr_equal(ly_ctx_get_node(ctx, NULL, path, 0), node);
+    }
+    assert_ptr_equal(ly_ctx_get_node(ctx, NULL, "/nc:l/v", 0), node);
+
+    /* failed lookups still fail */
+    assert_ptr_equal(ly_ctx_get_node(ctx, NULL, "/nc:l/w", 0), NULL);
+    assert_ptr_equal(ly_ctx_get_node(ctx, NULL, "/nc:l/w", 0), NULL);
+
+    assert_int_equal(ly_ctx_remove_module(mod, NULL), 0);
+    assert_ptr_equal(ly_ctx_get_node(ctx, NULL, "/nc:l/v", 0), NULL);
+    assert_ptr_equal(ly_ctx_find_path(ctx, "/nc:l/nc:v"), NULL);
+}
+
+static void
+test_ly_ctx_get_node_by_id(void **state)
+{
+    (void) state;
+    const char *mod_a = "module ia {namespace urn:ia; prefix ia; revision 2020-01-01;"
+        "grouping g {leaf x {type string;}} container x {uses g;}"
+        "container c {list l {key k; leaf k {type string;}} choice ch {case k {leaf y {type string;}}}}"
+        "rpc r {input {leaf i {type string;}} output {leaf i {type string;}}}}";
+    const char *mod_b = "module ib {namespace urn:ib; prefix ib; import ia {prefix ia;}"
+        "augment /ia:c {leaf z {type string;}}}";
+    const struct lys_node *node, *in, *out;
+    const struct lys_module *mod;
+    struct ly_ctx *ctx2;
+    uint64_t id, id_in, id_out;
+
+    assert_ptr_not_equal(lys_parse_mem(ctx, mod_a, LYS_IN_YANG), NULL);
+    node = ly_ctx_get_node(ctx, NULL, "/ia:c/l/k", 0);
+    assert_ptr_not_equal(node, NULL);
+    id = lys_node_id(node);
+    assert_int_not_equal(id, 0);
+    assert_ptr_equal(ly_ctx_get_node_by_id(ctx, id), node);
+
+    /* the grouping, the uses and the container with the same name */
+    node = ly_ctx_get_node(ctx, NULL, "/ia:x/x", 0);
+    assert_ptr_not_equal(node, NULL);
+    assert_ptr_equal(ly_ctx_get_node_by_id(ctx, lys_node_id(node)), node);
+    assert_ptr_equal(ly_ctx_get_node_by_id(ctx, lys_node_id(lys_parent(node))), lys_parent(node));
+    assert_ptr_equal(ly_ctx_get_node_by_id(ctx, lys_node_id(node->module->data)), node->module->data);
+    assert_int_not_equal(lys_node_id(node->module->data), lys_node_id(lys_parent(lys_parent(node))));
+
+    /* input and output children with the same name */
+    in = ly_ctx_get_node(ctx, NULL, "/ia:r/i", 0);
+    out = ly_ctx_get_node(ctx, NULL, "/ia:r/i", 1);
+    id_in = lys_node_id(in);
+    id_out = lys_node_id(out);
+    assert_int_not_equal(id_in, id_out);
+    assert_ptr_equal(ly_ctx_get_node_by_id(ctx, id_in), in);
+    assert_ptr_equal(ly_ctx_get_node_by_id(ctx, id_out), out);
+
+    /* augmenting nodes get their IDs when the augment is applied */
+    mod = lys_parse_mem(ctx, mod_b, LYS_IN_YANG);
+    assert_ptr_not_equal(mod, NULL);
+    node = ly_ctx_get_node(ctx, NULL, "/ia:c/ib:z", 0);
+    assert_ptr_not_equal(node, NULL);
+    assert_ptr_equal(ly_ctx_get_node_by_id(ctx, lys_node_id(node)), node);
+    assert_ptr_equal(ly_ctx_get_node_by_id(ctx, id), ly_ctx_get_node(ctx, NULL, "/ia:c/l/k", 0));
+    assert_int_equal(lys_set_disabled(mod), 0);
+    assert_int_equal(lys_node_id(node), 0);
+
+    /* the same IDs in another context */
+    ctx2 = ly_ctx_new(NULL, 0);
+    assert_ptr_not_equal(ctx2, NULL);
+    assert_ptr_not_equal(lys_parse_mem(ctx2, mod_a, LYS_IN_YANG), NULL);
+    assert_ptr_equal(ly_ctx_get_node_by_id(ctx2, id), ly_ctx_get_node(ctx2, NULL, "/ia:c/l/k", 0));
+    assert_int_equal(lys_node_id(ly_ctx_get_node(ctx2, NULL, "/ia:r/i", 1)), id_out);
+    assert_ptr_equal(ly_ctx_get_node_by_id(ctx2, id + 1), NULL);
+    ly_ctx_destroy(ctx2, NULL);
+}
+
+static void
+test_ly_ctx_stats(void **state)
+{
+    (void) state;
+    const char *yang = "module st {namespace urn:st; prefix st;"
+        "leaf a {type string;} leaf r {type leafref {path ../a;}}"
+        "leaf b {type string; must \". = ../a\";} leaf c {when \"../a = 'x'\"; type string;}}";
+    const char *xml = "<a xmlns=\"urn:st\">x</a><r xmlns=\"urn:st\">x</r><b xmlns=\"urn:st\">x</b><c xmlns=\"urn:st\">y</c>";
+    struct ly_ctx_stats stats;
+    struct lyd_node *data;
+
+    assert_ptr_not_equal(lys_parse_mem(ctx, yang, LYS_IN_YANG), NULL);
+
+    /* nothing is collected by default */
+    assert_int_equal(ly_ctx_get_stats(ctx, &stats), EXIT_SUCCESS);
+    assert_int_equal(stats.parse_calls, 0);
+    assert_int_equal(stats.dict_inserts, 0);
+    assert_int_not_equal(stats.dict_strings, 0);
+
+    ly_ctx_set_stats(ctx, 1);
+    data = lyd_parse_mem(ctx, xml, LYD_XML, LYD_OPT_CONFIG);
+    assert_ptr_not_equal(data, NULL);
+    lyd_free_withsiblings(data);
+    ly_ctx_set_stats(ctx, 0);
+
+    assert_int_equal(ly_ctx_get_stats(ctx, &stats), EXIT_SUCCESS);
+    assert_int_equal(stats.parse_calls, 1);
+    assert_int_equal(stats.parse_bytes, strlen(xml));
+    assert_true(stats.nodes_created >= 4);
+    assert_int_equal(stats.nodes_freed, stats.nodes_created);
+    assert_int_not_equal(stats.dict_inserts, 0);
+    assert_int_equal(stats.must_evals, 1);
+    assert_int_equal(stats.when_evals, 1);
+    assert_int_equal(stats.leafref_evals, 1);
+    assert_int_not_equal(stats.xpath_evals, 0);
+    assert_int_not_equal(stats.xpath_nodes, 0);
+    assert_int_not_equal(stats.val_time, 0);
+
+    /* disabled again */
+    data = lyd_parse_mem(ctx, "<a xmlns=\"urn:st\">x</a>", LYD_XML, LYD_OPT_CONFIG);
+    assert_ptr_not_equal(data, NULL);
+    lyd_free_withsiblings(data);
+    assert_int_equal(ly_ctx_get_stats(ctx, &stats), EXIT_SUCCESS);
+    assert_int_equal(stats.parse_calls, 1);
+
+    ly_ctx_clean_stats(ctx);
+    assert_int_equal(ly_ctx_get_stats(ctx, &stats), EXIT_SUCCESS);
+    assert_int_equal(stats.parse_calls, 0);
+    assert_int_equal(stats.nodes_created, 0);
+    assert_int_equal(stats.val_time, 0);
+
+    /* schema loading phases */
+    ly_ctx_set_stats(ctx, 1);
+    assert_ptr_not_equal(lys_parse_mem(ctx, "module st2 {namespace urn:st2; prefix st2; import st {prefix st;}"
+                                       "augment /st2:c2 {leaf d {type string {pattern '[a-z]+';}}} container c2;"
+                                       "leaf l {type leafref {path /st:a;}} leaf m {type string; must \"../l\";}}",
+                                       LYS_IN_YANG), NULL);
+    ly_ctx_set_stats(ctx, 0);
+    assert_int_equal(ly_ctx_get_stats(ctx, &stats), EXIT_SUCCESS);
+    assert_int_equal(stats.schema_loads, 1);
+    assert_int_not_equal(stats.schema_parse_time, 0);
+    assert_int_not_equal(stats.schema_unres_time, 0);
+    assert_int_not_equal(stats.schema_augdev_time, 0);
+    assert_int_equal(stats.schema_patterns, 1);
+    assert_int_not_equal(stats.schema_pattern_time, 0);
+}
+
+static void
+test_ly_ctx_plugin_stats(void **state)
+{
+    (void) state;
+    const char *yang = "module pst {namespace urn:pst; prefix pst; import ietf-yang-types {prefix yang;}"
+        "leaf t {type yang:date-and-time;}}";
+    struct ly_plugin_stats *plugins;
+    struct lyd_node *data;
+    uint32_t count, i;
+
+    assert_ptr_not_equal(lys_parse_mem(ctx, yang, LYS_IN_YANG), NULL);
+
+    /* nothing is collected by default */
+    data = lyd_parse_mem(ctx, "<t xmlns=\"urn:pst\">2019-01-01T10:00:00Z</t>", LYD_XML, LYD_OPT_CONFIG);
+    assert_ptr_not_equal(data, NULL);
+    lyd_free_withsiblings(data);
+    assert_ptr_equal(ly_ctx_get_plugin_stats(ctx, &count), NULL);
+    assert_int_equal(count, 0);
+
+    ly_ctx_set_stats(ctx, 1);
+    data = lyd_parse_mem(ctx, "<t xmlns=\"urn:pst\">2019-01-01T10:00:00Z</t>", LYD_XML, LYD_OPT_CONFIG);
+    assert_ptr_not_equal(data, NULL);
+    lyd_free_withsiblings(data);
+    ly_ctx_set_stats(ctx, 0);
+
+    plugins = ly_ctx_get_plugin_stats(ctx, &count);
+    assert_ptr_not_equal(plugins, NULL);
+    for (i = 0; i < count; ++i) {
+        assert_string_equal(plugins[i].module, "ietf-yang-types");
+        assert_string_equal(plugins[i].name, "date-and-time");
+        if (plugins[i].clb == LY_PLUGIN_STORE) {
+            assert_int_equal(plugins[i].count, 1);
+        }
+    }
+    for (i = 0; (i < count) && (plugins[i].clb != LY_PLUGIN_STORE); ++i);
+    assert_int_not_equal(i, count);
+    free(plugins);
+
+    ly_ctx_clean_stats(ctx);
+    assert_ptr_equal(ly_ctx_get_plugin_stats(ctx, &count), NULL);
+    assert_int_equal(count, 0);
+}
+
+static void
+test_ly_alloc_trace(void **state)
+{
+    (void) state;
+    struct ly_alloc_site *sites;
+    struct lyd_node *data;
+    uint32_t count, i;
+    uint64_t allocs = 0, frees = 0;
+
+    if (ly_alloc_trace_get(&sites, &count)) {
+        /* not compiled in */
+        assert_ptr_equal(sites, NULL);
+        assert_int_equal(count, 0);
+        return;
+    }
+    free(sites);
+
+    assert_ptr_not_equal(lys_parse_mem(ctx, "module at {namespace urn:at; prefix at; leaf a {type string;}}",
+                                       LYS_IN_YANG), NULL);
+    ly_alloc_trace_clean();
+    data = lyd_parse_mem(ctx, "<a xmlns=\"urn:at\">x</a>", LYD_XML, LYD_OPT_CONFIG);
+    assert_ptr_not_equal(data, NULL);
+    lyd_free_withsiblings(data);
+
+    assert_int_equal(ly_alloc_trace_get(&sites, &count), EXIT_SUCCESS);
+    assert_int_not_equal(count, 0);
+    for (i = 0; i < count; ++i) {
+        assert_ptr_not_equal(sites[i].file, NULL);
+        assert_int_not_equal(sites[i].calls, 0);
+        if (i) {
+            assert_true(sites[i].calls <= sites[i - 1].calls);
+        }
+        if (!strcmp(sites[i].func, "free")) {
+            frees += sites[i].calls;
+        } else {
+            allocs += sites[i].calls;
+        }
+    }
+    free(sites);
+    assert_int_not_equal(allocs, 0);
+    assert_int_not_equal(frees, 0);
+}
+
 void
 test_ly_ctx_destroy(void **state)
 {
@@ -1648,15 +2566,23 @@ int main(void)
     const struct CMUnitTest tests[] = {
         cmocka_unit_test(test_ly_ctx_new),
         cmocka_unit_test(test_ly_ctx_new_invalid),
+        cmocka_unit_test(test_ly_ctx_new_internal_patterns),
+        cmocka_unit_test(test_ly_ctx_new_no_descriptions),
         cmocka_unit_test(test_ly_ctx_get_searchdirs),
         cmocka_unit_test(test_ly_ctx_set_searchdir),
         cmocka_unit_test(test_ly_ctx_set_searchdir_invalid),
         cmocka_unit_test_setup_teardown(test_ly_ctx_info, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_ly_ctx_info_cache, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_ly_ctx_new_ylmem, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_ly_ctx_new_image, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_ly_ctx_clone, setup_f, teardown_f),
+        cmocka_unit_test(test_ly_ctx_precompile),
         cmocka_unit_test_setup_teardown(test_ly_ctx_module_clb, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_ly_ctx_get_module, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_ly_ctx_get_module_older, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_ly_ctx_load_module, setup_f, teardown_f),
+        cmocka_unit_test(test_ly_ctx_load_module_searchdir_index),
+        cmocka_unit_test(test_ly_ctx_fetch_modules),
         cmocka_unit_test_teardown(test_ly_ctx_remove_module, teardown_f),
         cmocka_unit_test_teardown(test_ly_ctx_remove_module2, teardown_f),
         cmocka_unit_test_teardown(test_lys_set_enabled, teardown_f),
@@ -1671,6 +2597,7 @@ int main(void)
         cmocka_unit_test_setup_teardown(test_ly_set_add, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_ly_set_rm, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_ly_set_rm_index, setup_f, teardown_f),
+        cmocka_unit_test(test_ly_set_many),
         cmocka_unit_test_setup_teardown(test_ly_set_free, setup_f, teardown_f),
         cmocka_unit_test(test_ly_verb),
         cmocka_unit_test(test_ly_get_log_clb),
@@ -1685,6 +2612,12 @@ int main(void)
         cmocka_unit_test_setup_teardown(test_ly_ctx_set_trusted, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_ly_ctx_get_node, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_ly_ctx_find_path, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_ly_ctx_get_node_changed, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_ly_ctx_get_node_cached, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_ly_ctx_get_node_by_id, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_ly_ctx_stats, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_ly_ctx_plugin_stats, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_ly_alloc_trace, setup_f, teardown_f),
         cmocka_unit_test(test_ly_ctx_destroy),
         cmocka_unit_test_setup_teardown(test_ly_path_xml2json, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_ly_set_dup, setup_f, teardown_f),
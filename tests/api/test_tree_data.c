@@ -23,7 +23,10 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <pthread.h>
 #include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
 #include <unistd.h>
 #include <string.h>
 
@@ -31,6 +34,7 @@
 #include "libyang.h"
 #include "../../src/tree_data.h"
 #include "../../src/tree_schema.h"
+#include "../../src/user_types.h"
 
 #define TMP_TEMPLATE "/tmp/libyang-XXXXXX"
 
@@ -400,6 +404,376 @@ error:
     fail();
 }
 
+static struct lyd_node *
+parser_push_chunks(LYD_FORMAT format, const char *data, size_t chunk)
+{
+    struct lyd_parser *parser;
+    size_t len, i;
+
+    parser = lyd_parser_new(ctx, format, LYD_OPT_CONFIG | LYD_OPT_STRICT);
+    assert_non_null(parser);
+
+    len = strlen(data);
+    for (i = 0; i < len; i += chunk) {
+        if (lyd_parser_push(parser, &data[i], (i + chunk > len) ? len - i : chunk)) {
+            break;
+        }
+    }
+
+    return lyd_parser_finish(parser);
+}
+
+static void
+test_lyd_parser_push(void **state)
+{
+    (void) state; /* unused */
+    const char *xml = "<?xml version=\"1.0\"?><!-- x <y> -->\n"
+                      "<x xmlns=\"urn:a\"><bubba>a &gt; <![CDATA[<b>]]></bubba><number32>4</number32></x>\n"
+                      "<l xmlns=\"urn:a\"><key1>1</key1><key2>2</key2><value>v</value></l>"
+                      "<l xmlns=\"urn:a\" xmlns:a=\"urn:a\" a:test=\"1>2\"><key1>2</key1><key2>2</key2></l>"
+                      "<y xmlns=\"urn:a\">y</y><!-- end -->\n";
+    const char *json = " {\"a:x\": {\"bubba\": \"a } \\\"b\\\", [\", \"number32\": 4},"
+                       "\"a:l\": [{\"key1\": 1, \"key2\": 2, \"value\": \"v\"}, {\"key1\": 2, \"key2\": 2}],"
+                       "\"@a:y\": {\"a:test\": \"1\"}, \"a:y\": \"y\"}\n";
+    struct lyd_node *node;
+    char *expected, *printed;
+    size_t chunk;
+
+    node = lyd_parse_mem(ctx, xml, LYD_XML, LYD_OPT_CONFIG | LYD_OPT_STRICT);
+    assert_non_null(node);
+    lyd_print_mem(&expected, node, LYD_XML, LYP_WITHSIBLINGS);
+    lyd_free_withsiblings(node);
+    for (chunk = 1; chunk < 8; ++chunk) {
+        node = parser_push_chunks(LYD_XML, xml, chunk);
+        assert_non_null(node);
+        lyd_print_mem(&printed, node, LYD_XML, LYP_WITHSIBLINGS);
+        assert_string_equal(printed, expected);
+        free(printed);
+        lyd_free_withsiblings(node);
+    }
+    free(expected);
+
+    node = lyd_parse_mem(ctx, json, LYD_JSON, LYD_OPT_CONFIG | LYD_OPT_STRICT);
+    assert_non_null(node);
+    lyd_print_mem(&expected, node, LYD_JSON, LYP_WITHSIBLINGS);
+    lyd_free_withsiblings(node);
+    for (chunk = 1; chunk < 8; ++chunk) {
+        node = parser_push_chunks(LYD_JSON, json, chunk);
+        assert_non_null(node);
+        lyd_print_mem(&printed, node, LYD_JSON, LYP_WITHSIBLINGS);
+        assert_string_equal(printed, expected);
+        free(printed);
+        lyd_free_withsiblings(node);
+    }
+    free(expected);
+
+    /* empty data, only the default nodes are created */
+    node = parser_push_chunks(LYD_XML, " <!-- empty -->", 3);
+    assert_int_equal(ly_errno, LY_SUCCESS);
+    assert_non_null(node);
+    assert_int_equal(node->dflt, 1);
+    lyd_free_withsiblings(node);
+    node = parser_push_chunks(LYD_JSON, "{ }", 1);
+    assert_int_equal(ly_errno, LY_SUCCESS);
+    assert_non_null(node);
+    assert_int_equal(node->dflt, 1);
+    lyd_free_withsiblings(node);
+
+    /* incomplete data */
+    assert_null(parser_push_chunks(LYD_XML, "<x xmlns=\"urn:a\"><bubba>test</bubba>", 5));
+    assert_int_not_equal(ly_errno, LY_SUCCESS);
+    assert_null(parser_push_chunks(LYD_JSON, "{\"a:y\": \"y\"", 5));
+    assert_int_not_equal(ly_errno, LY_SUCCESS);
+
+    /* invalid data */
+    assert_null(parser_push_chunks(LYD_XML, "<y xmlns=\"urn:a\">y</y><y xmlns=\"urn:a\">z</y>", 4));
+    assert_int_not_equal(ly_errno, LY_SUCCESS);
+    assert_null(parser_push_chunks(LYD_JSON, "{\"a:y\": \"y\" \"a:x\": {}}", 4));
+    assert_int_not_equal(ly_errno, LY_SUCCESS);
+}
+
+static void
+test_lyd_anydata_convert(void **state)
+{
+    (void) state; /* unused */
+    const char *xml = "<any xmlns=\"urn:a\" xmlns:p=\"urn:p\"><p:e attr=\"x>y\"><inner>1 &amp; 2</inner></p:e>"
+                      "<!-- <c> --><f xmlns=\"urn:f\"/></any><y xmlns=\"urn:a\">y</y>";
+    struct lyd_node *node;
+    struct lyd_node_anydata *any;
+
+    node = lyd_parse_mem(ctx, xml, LYD_XML, LYD_OPT_CONFIG | LYD_OPT_ANYDATA_RAW);
+    assert_non_null(node);
+    assert_string_equal(node->schema->name, "any");
+    assert_string_equal(node->next->schema->name, "y");
+    any = (struct lyd_node_anydata *)node;
+    assert_int_equal(any->value_type, LYD_ANYDATA_SXML);
+    assert_string_equal(any->value.str, "<p:e xmlns=\"urn:a\" xmlns:p=\"urn:p\" attr=\"x>y\"><inner>1 &amp; 2</inner></p:e>"
+                        "<!-- <c> --><f xmlns:p=\"urn:p\" xmlns=\"urn:f\"/>");
+
+    /* parsed on request */
+    assert_int_equal(lyd_anydata_convert(node, LYD_ANYDATA_XML, 0), EXIT_SUCCESS);
+    assert_int_equal(any->value_type, LYD_ANYDATA_XML);
+    assert_string_equal(any->value.xml->name, "e");
+    assert_string_equal(any->value.xml->ns->value, "urn:p");
+    assert_string_equal(any->value.xml->child->ns->value, "urn:a");
+    assert_string_equal(any->value.xml->child->content, "1 & 2");
+    assert_string_equal(any->value.xml->next->ns->value, "urn:f");
+    assert_int_equal(lyd_anydata_convert(node, LYD_ANYDATA_SXML, 0), EXIT_SUCCESS);
+    assert_int_equal(any->value_type, LYD_ANYDATA_SXML);
+    assert_int_equal(lyd_anydata_convert(node, LYD_ANYDATA_JSON, 0), EXIT_FAILURE);
+    lyd_free_withsiblings(node);
+
+    /* content modeled by YANG */
+    node = lyd_parse_mem(ctx, "<any xmlns=\"urn:a\"><x><bubba>b</bubba></x></any>", LYD_XML,
+                         LYD_OPT_CONFIG | LYD_OPT_ANYDATA_RAW);
+    assert_non_null(node);
+    assert_int_equal(lyd_anydata_convert(node, LYD_ANYDATA_DATATREE, LYD_OPT_CONFIG), EXIT_SUCCESS);
+    any = (struct lyd_node_anydata *)node;
+    assert_int_equal(any->value_type, LYD_ANYDATA_DATATREE);
+    assert_string_equal(any->value.tree->schema->name, "x");
+    assert_string_equal(((struct lyd_node_leaf_list *)any->value.tree->child)->value_str, "b");
+    lyd_free_withsiblings(node);
+
+    node = lyd_parse_mem(ctx, "{\"a:any\": {\"a:x\": {\"bubba\": \"b\"}}}", LYD_JSON, LYD_OPT_CONFIG);
+    assert_non_null(node);
+    any = (struct lyd_node_anydata *)node;
+    assert_int_equal(any->value_type, LYD_ANYDATA_JSON);
+    assert_int_equal(lyd_anydata_convert(node, LYD_ANYDATA_DATATREE, LYD_OPT_CONFIG), EXIT_SUCCESS);
+    assert_string_equal(any->value.tree->schema->name, "x");
+    lyd_free_withsiblings(node);
+
+    /* the end tag is still checked */
+    assert_null(lyd_parse_mem(ctx, "<any xmlns=\"urn:a\"><e></any>", LYD_XML, LYD_OPT_CONFIG | LYD_OPT_ANYDATA_RAW));
+    assert_null(lyd_parse_mem(ctx, "<any xmlns=\"urn:a\"><e/></anyx>", LYD_XML, LYD_OPT_CONFIG | LYD_OPT_ANYDATA_RAW));
+}
+
+static void
+test_lyd_parse_canonical(void **state)
+{
+    (void) state; /* unused */
+    const char *xml = "<x xmlns=\"urn:a\"><number32>+007</number32></x>";
+    struct lyd_node *node;
+    struct lyd_node_leaf_list *leaf;
+
+    /* trusted values are still canonized */
+    node = lyd_parse_mem(ctx, xml, LYD_XML, LYD_OPT_CONFIG | LYD_OPT_TRUSTED);
+    assert_non_null(node);
+    leaf = (struct lyd_node_leaf_list *)node->child;
+    assert_string_equal(leaf->value_str, "7");
+    assert_int_equal(leaf->value.int32, 7);
+    lyd_free_withsiblings(node);
+
+    /* canonical values are only parsed */
+    node = lyd_parse_mem(ctx, xml, LYD_XML, LYD_OPT_CONFIG | LYD_OPT_TRUSTED | LYD_OPT_CANONICAL);
+    assert_non_null(node);
+    leaf = (struct lyd_node_leaf_list *)node->child;
+    assert_string_equal(leaf->value_str, "+007");
+    assert_int_equal(leaf->value.int32, 7);
+    lyd_free_withsiblings(node);
+
+    node = lyd_parse_mem(ctx, "{\"a:x\": {\"number32\": -5}}", LYD_JSON,
+                         LYD_OPT_CONFIG | LYD_OPT_TRUSTED | LYD_OPT_CANONICAL);
+    assert_non_null(node);
+    leaf = (struct lyd_node_leaf_list *)node->child;
+    assert_string_equal(leaf->value_str, "-5");
+    assert_int_equal(leaf->value.int32, -5);
+    lyd_free_withsiblings(node);
+
+    /* invalid values are still refused */
+    assert_null(lyd_parse_mem(ctx, "<x xmlns=\"urn:a\"><number32>x</number32></x>", LYD_XML,
+                              LYD_OPT_CONFIG | LYD_OPT_TRUSTED | LYD_OPT_CANONICAL));
+}
+
+static void
+test_lyd_parse_projection(void **state)
+{
+    (void) state; /* unused */
+    const char *xml = "<x xmlns=\"urn:a\"><bubba>b</bubba><number32>1</number32></x><y xmlns=\"urn:a\">y</y>"
+                      "<l xmlns=\"urn:a\"><key1>1</key1><key2>2</key2><value>v</value></l>"
+                      "<any xmlns=\"urn:a\"><e><f>&lt;</f></e></any>";
+    const char *json = "{\"a:x\": {\"bubba\": \"b\", \"number32\": 1}, \"a:y\": \"y\", \"@a:y\": {\"a:test\": \"t\"},"
+                       "\"a:l\": [{\"key1\": 1, \"key2\": 2, \"value\": \"v\"}], \"a:any\": {\"e\": [\"}\", {\"f\": 1}]}}";
+    struct ly_set *set, *set2;
+    struct lyd_node *node;
+
+    set = ly_ctx_find_path(ctx, "/a:x/a:bubba");
+    assert_non_null(set);
+    set2 = ly_ctx_find_path(ctx, "/a:l");
+    assert_non_null(set2);
+    assert_int_equal(ly_set_merge(set, set2, 0), 1);
+
+    /* only valid for the state data retrieval */
+    assert_null(lyd_parse_mem(ctx, xml, LYD_XML, LYD_OPT_CONFIG | LYD_OPT_PROJECTION, set));
+
+    node = lyd_parse_mem(ctx, xml, LYD_XML, LYD_OPT_GET | LYD_OPT_PROJECTION, set);
+    assert_non_null(node);
+    assert_string_equal(node->schema->name, "x");
+    assert_string_equal(node->child->schema->name, "bubba");
+    assert_null(node->child->next);
+    assert_string_equal(node->next->schema->name, "l");
+    assert_string_equal(node->next->child->prev->schema->name, "value");
+    assert_null(node->next->next);
+    lyd_free_withsiblings(node);
+
+    node = lyd_parse_mem(ctx, json, LYD_JSON, LYD_OPT_GET | LYD_OPT_PROJECTION, set);
+    assert_non_null(node);
+    assert_string_equal(node->schema->name, "x");
+    assert_string_equal(node->child->schema->name, "bubba");
+    assert_null(node->child->next);
+    assert_string_equal(node->next->schema->name, "l");
+    assert_string_equal(node->next->child->prev->schema->name, "value");
+    assert_null(node->next->next);
+    lyd_free_withsiblings(node);
+
+    /* list keys are kept */
+    ly_set_free(set);
+    set = ly_ctx_find_path(ctx, "/a:l/a:value");
+    assert_non_null(set);
+    node = lyd_parse_mem(ctx, xml, LYD_XML, LYD_OPT_GET | LYD_OPT_PROJECTION, set);
+    assert_non_null(node);
+    assert_string_equal(node->schema->name, "l");
+    assert_string_equal(node->child->schema->name, "key1");
+    assert_string_equal(node->child->next->schema->name, "key2");
+    assert_string_equal(node->child->next->next->schema->name, "value");
+    assert_null(node->next);
+    lyd_free_withsiblings(node);
+
+    /* nothing selected */
+    assert_null(lyd_parse_mem(ctx, "<y xmlns=\"urn:a\">y</y>", LYD_XML, LYD_OPT_GET | LYD_OPT_PROJECTION, set));
+    assert_int_equal(ly_errno, LY_SUCCESS);
+    assert_null(lyd_parse_mem(ctx, "{\"a:y\": \"y\"}", LYD_JSON, LYD_OPT_GET | LYD_OPT_PROJECTION, set));
+    assert_int_equal(ly_errno, LY_SUCCESS);
+
+    /* skipped content must still be well-formed */
+    assert_null(lyd_parse_mem(ctx, "<y xmlns=\"urn:a\"><e></y>", LYD_XML, LYD_OPT_GET | LYD_OPT_PROJECTION, set));
+    assert_null(lyd_parse_mem(ctx, "{\"a:y\": \"y", LYD_JSON, LYD_OPT_GET | LYD_OPT_PROJECTION, set));
+
+    ly_set_free(set);
+}
+
+static void
+test_lyd_parse_batch(void **state)
+{
+    (void) state; /* unused */
+    struct lyd_batch_item items[64];
+    unsigned int i;
+
+    for (i = 0; i < 64; ++i) {
+        items[i].data = (i % 3) ? a_data_xml : "<x xmlns=\"urn:a\"><number32>x</number32></x>";
+    }
+
+    assert_int_equal(lyd_parse_batch(ctx, items, 64, LYD_XML, LYD_OPT_CONFIG, 4), EXIT_FAILURE);
+    assert_int_equal(ly_errno, LY_EVALID);
+    assert_null(ly_err_first(ctx));
+    for (i = 0; i < 64; ++i) {
+        if (i % 3) {
+            assert_int_equal(items[i].err, LY_SUCCESS);
+            assert_non_null(items[i].tree);
+            assert_string_equal(items[i].tree->child->schema->name, "bubba");
+            assert_null(items[i].errmsg);
+        } else {
+            assert_int_equal(items[i].err, LY_EVALID);
+            assert_int_equal(items[i].vecode, LYVE_INVAL);
+            assert_null(items[i].tree);
+            assert_non_null(items[i].errmsg);
+            assert_string_equal(items[i].errpath, "/a:x/number32");
+        }
+        lyd_free_withsiblings(items[i].tree);
+        free(items[i].errmsg);
+        free(items[i].errpath);
+    }
+
+    for (i = 0; i < 64; ++i) {
+        items[i].data = a_data_xml;
+    }
+    assert_int_equal(lyd_parse_batch(ctx, items, 64, LYD_XML, LYD_OPT_CONFIG, 0), EXIT_SUCCESS);
+    for (i = 0; i < 64; ++i) {
+        assert_non_null(items[i].tree);
+        lyd_free_withsiblings(items[i].tree);
+    }
+}
+
+static void
+test_lyd_parse_mem_mixed(void **state)
+{
+    struct ly_ctx *ctx = *state;
+    const char *yang = "module m {namespace urn:m; prefix m; container c {leaf l {type string;}} leaf t {type string;}}";
+    const char *mixed[] = {
+        "<c xmlns=\"urn:m\">text<l>1</l></c><t xmlns=\"urn:m\">v</t>",
+        "<c xmlns=\"urn:m\"><l>1</l>text</c><t xmlns=\"urn:m\">v</t>",
+        "<c xmlns=\"urn:m\"><l>1</l>text<l>2</l></c><t xmlns=\"urn:m\">v</t>"
+    };
+    struct lyd_node *data;
+    struct ly_set *set;
+    unsigned int i;
+
+    assert_non_null(lys_parse_mem(ctx, yang, LYS_IN_YANG));
+
+    for (i = 0; i < sizeof mixed / sizeof *mixed; ++i) {
+        /* the element with mixed content is skipped */
+        data = lyd_parse_mem(ctx, mixed[i], LYD_XML, LYD_OPT_CONFIG);
+        assert_non_null(data);
+        assert_string_equal(data->schema->name, "t");
+        set = lyd_find_path(data, "/m:c/l");
+        assert_non_null(set);
+        assert_int_equal(set->number, 0);
+        ly_set_free(set);
+        lyd_free_withsiblings(data);
+
+        assert_null(lyd_parse_mem(ctx, mixed[i], LYD_XML, LYD_OPT_CONFIG | LYD_OPT_STRICT));
+        assert_int_equal(ly_vecode(ctx), LYVE_XML_INVAL);
+    }
+
+    /* only text is never valid */
+    assert_null(lyd_parse_mem(ctx, "<c xmlns=\"urn:m\">text</c>", LYD_XML, LYD_OPT_CONFIG));
+}
+
+static void
+test_lyd_parse_batch_xpath(void **state)
+{
+    struct ly_ctx *ctx = *state;
+    const char *yang = "module m {namespace urn:m; prefix m;"
+        "container c {leaf a {type uint8; must \". < 100\";} leaf b {when \"../a > 1\"; type string;}}"
+        "container d {leaf e {type string; must \"string-length(.) > 1\";}}}";
+    const struct lys_module *mod;
+    const struct lys_node_leaf *a, *b, *e;
+    struct lyd_batch_item items[32];
+    unsigned int i;
+
+    mod = lys_parse_mem(ctx, yang, LYS_IN_YANG);
+    assert_non_null(mod);
+    a = (const struct lys_node_leaf *)mod->data->child;
+    b = (const struct lys_node_leaf *)a->next;
+    e = (const struct lys_node_leaf *)mod->data->next->child;
+    assert_null(a->must[0].expr_xpath);
+    assert_null(b->when->cond_xpath);
+
+    for (i = 0; i < 32; ++i) {
+        items[i].data = (i % 4) ? "<c xmlns=\"urn:m\"><a>5</a><b>x</b></c>" : "<c xmlns=\"urn:m\"><a>200</a></c>";
+    }
+    assert_int_equal(lyd_parse_batch(ctx, items, 32, LYD_XML, LYD_OPT_CONFIG, 4), EXIT_FAILURE);
+
+    /* all the expressions were compiled before the threads started, even the unused ones */
+    assert_non_null(a->must[0].expr_xpath);
+    assert_non_null(b->when->cond_xpath);
+    assert_non_null(e->must[0].expr_xpath);
+
+    for (i = 0; i < 32; ++i) {
+        if (i % 4) {
+            assert_int_equal(items[i].err, LY_SUCCESS);
+            assert_non_null(items[i].tree);
+            assert_string_equal(items[i].tree->child->next->schema->name, "b");
+        } else {
+            assert_int_equal(items[i].err, LY_EVALID);
+            assert_int_equal(items[i].vecode, LYVE_NOMUST);
+            assert_string_equal(items[i].errpath, "/m:c/a");
+        }
+        lyd_free_withsiblings(items[i].tree);
+        free(items[i].errmsg);
+        free(items[i].errpath);
+    }
+}
+
 static void
 test_lyd_parse_xml(void **state)
 {
@@ -689,6 +1063,220 @@ test_lyd_new_path(void **state)
     lyd_free_withsiblings(root);
 }
 
+static void
+test_lyd_new_path_template(void **state)
+{
+    (void) state; /* unused */
+    struct lyd_path_template *tmpl;
+    struct lyd_node *node, *root;
+    const char *values[3];
+    char key[4];
+    int i;
+
+    tmpl = lyd_path_template_compile(ctx, "/a:l[key1='0'][key2='0']/value", 0);
+    assert_non_null(tmpl);
+    assert_int_equal(lyd_path_template_value_count(tmpl), 3);
+
+    /* new tree */
+    values[0] = "1";
+    values[1] = "2";
+    values[2] = "val";
+    root = lyd_new_path_template(NULL, tmpl, values, 0);
+    assert_non_null(root);
+    assert_string_equal(root->schema->name, "l");
+    assert_string_equal(root->child->schema->name, "key1");
+    assert_string_equal(root->child->next->schema->name, "key2");
+    assert_string_equal(((struct lyd_node_leaf_list *)root->child->next->next)->value_str, "val");
+
+    /* existing leaf */
+    assert_null(lyd_new_path_template(root, tmpl, values, 0));
+    assert_int_equal(ly_errno, LY_EVALID);
+    ly_errno = 0;
+    values[2] = "val2";
+    node = lyd_new_path_template(root, tmpl, values, LYD_PATH_OPT_UPDATE);
+    assert_ptr_equal(node, root->child->next->next);
+    assert_string_equal(((struct lyd_node_leaf_list *)node)->value_str, "val2");
+
+    /* many instances */
+    for (i = 0; i < 100; ++i) {
+        sprintf(key, "%d", i);
+        values[1] = key;
+        node = lyd_new_path_template(root, tmpl, values, LYD_PATH_OPT_UPDATE);
+        if (i != 2) {
+            assert_non_null(node);
+            assert_string_equal(node->schema->name, "l");
+        }
+    }
+    for (i = 0, node = root; node; node = node->next, ++i);
+    assert_int_equal(i, 100);
+
+    /* only the list instance */
+    lyd_path_template_free(tmpl);
+    tmpl = lyd_path_template_compile(ctx, "/a:l", 0);
+    assert_non_null(tmpl);
+    assert_int_equal(lyd_path_template_value_count(tmpl), 2);
+    values[0] = "1";
+    values[1] = "50";
+    assert_null(lyd_new_path_template(root, tmpl, values, 0));
+    assert_int_equal(ly_errno, LY_EVALID);
+    ly_errno = 0;
+    values[1] = "100";
+    node = lyd_new_path_template(root, tmpl, values, 0);
+    assert_non_null(node);
+    assert_ptr_equal(root->prev, node);
+
+    /* invalid value */
+    values[1] = "1000";
+    assert_null(lyd_new_path_template(root, tmpl, values, 0));
+    assert_ptr_equal(root->prev, node);
+
+    lyd_path_template_free(tmpl);
+    lyd_free_withsiblings(root);
+
+    /* not a data node */
+    assert_null(lyd_path_template_compile(ctx, "/a:l/key3", 0));
+}
+
+static void
+test_lyd_insert_batch(void **state)
+{
+    (void) state; /* unused */
+    const char *yang = "module b {yang-version 1.1; namespace urn:b; prefix b;"
+        "container c { list l { key k; leaf k { type uint16; } leaf v { type string; } }"
+        "leaf-list ll { type string; default dflt; } leaf other { type string; } } }";
+    struct lyd_node *root, *tmp, *first, *node, *iter;
+    const struct lys_module *mod;
+    struct ly_set *set;
+    char key[8];
+    int i;
+
+    mod = lys_parse_mem(ctx, yang, LYS_IN_YANG);
+    assert_non_null(mod);
+    root = lyd_new(NULL, mod, "c");
+    assert_non_null(root);
+    assert_int_equal(lyd_validate(&root, LYD_OPT_CONFIG, NULL), 0);
+    assert_non_null(root->child);
+    assert_int_equal(root->child->dflt, 1);
+    node = lyd_new_leaf(root, NULL, "other", "x");
+    assert_non_null(node);
+
+    /* chain of list and leaf-list instances without a parent */
+    tmp = lyd_new(NULL, mod, "c");
+    assert_non_null(tmp);
+    first = NULL;
+    for (i = 0; i < 200; ++i) {
+        sprintf(key, "%d", i);
+        node = lyd_new(tmp, NULL, "l");
+        assert_non_null(node);
+        assert_non_null(lyd_new_leaf(node, NULL, "k", key));
+        assert_int_equal(lyd_unlink(node), 0);
+        if (first) {
+            assert_int_equal(lyd_insert_after(first->prev, node), 0);
+        } else {
+            first = node;
+        }
+    }
+    node = lyd_new_leaf(tmp, NULL, "ll", "a");
+    assert_non_null(node);
+    assert_int_equal(lyd_unlink(node), 0);
+    assert_int_equal(lyd_insert_after(first->prev, node), 0);
+
+    /* wrong arguments */
+    assert_int_not_equal(lyd_insert_batch(root, first->next), 0);
+    assert_int_not_equal(lyd_insert_batch(NULL, first), 0);
+
+    assert_int_equal(lyd_insert_batch(root, first), 0);
+    /* the default leaf-list instance was replaced */
+    assert_string_equal(root->child->schema->name, "other");
+    assert_ptr_equal(root->child->next, first);
+    for (i = 0, iter = first; iter->schema->nodetype == LYS_LIST; iter = iter->next, ++i) {
+        assert_ptr_equal(iter->parent, root);
+        sprintf(key, "%d", i);
+        assert_string_equal(((struct lyd_node_leaf_list *)iter->child)->value_str, key);
+    }
+    assert_int_equal(i, 200);
+    assert_ptr_equal(root->child->prev, iter);
+    assert_string_equal(((struct lyd_node_leaf_list *)iter)->value_str, "a");
+
+    set = lyd_find_path(root, "l[k='150']");
+    assert_non_null(set);
+    assert_int_equal(set->number, 1);
+    ly_set_free(set);
+    assert_int_equal(lyd_validate(&root, LYD_OPT_CONFIG, NULL), 0);
+
+    /* anything else is inserted the standard way */
+    node = lyd_new_leaf(tmp, NULL, "other", "y");
+    assert_non_null(node);
+    assert_int_equal(lyd_unlink(node), 0);
+    assert_int_equal(lyd_insert_batch(root, node), 0);
+    assert_ptr_equal(node->parent, root);
+    assert_int_not_equal(lyd_validate(&root, LYD_OPT_CONFIG, NULL), 0);
+
+    lyd_free_withsiblings(root);
+    lyd_free(tmp);
+}
+
+static void
+test_lyd_find_sibling_val(void **state)
+{
+    (void) state; /* unused */
+    const char *yang = "module c {namespace urn:c; prefix c;"
+        "container c { list l { key \"k1 k2\"; leaf k1 { type string; } leaf k2 { type int8; } }"
+        "leaf-list ll { type string; } leaf other { type string; } } }";
+    const struct lys_module *mod;
+    const struct lys_node *slist, *sllist, *sleaf;
+    struct lyd_node *root, *node;
+    const char *values[2];
+    char path[64];
+    int i;
+
+    mod = lys_parse_mem(ctx, yang, LYS_IN_YANG);
+    assert_non_null(mod);
+    root = NULL;
+    for (i = 0; i < 100; ++i) {
+        sprintf(path, "/c:c/l[k1='key%d'][k2='%d']", i, i % 10);
+        node = lyd_new_path(root, ctx, path, NULL, 0, 0);
+        assert_non_null(node);
+        if (!root) {
+            root = node;
+        }
+        sprintf(path, "/c:c/ll[.='val%d']", i);
+        assert_non_null(lyd_new_path(root, ctx, path, NULL, 0, 0));
+    }
+    assert_non_null(lyd_new_path(root, ctx, "/c:c/other", "x", 0, 0));
+    slist = root->schema->child;
+    sllist = slist->next;
+    sleaf = sllist->next;
+
+    values[0] = "key42";
+    values[1] = "2";
+    node = lyd_find_sibling_val(root->child, slist, values);
+    assert_non_null(node);
+    assert_string_equal(((struct lyd_node_leaf_list *)node->child)->value_str, "key42");
+    values[1] = "3";
+    assert_null(lyd_find_sibling_val(root->child->prev, slist, values));
+
+    values[0] = "val57";
+    node = lyd_find_sibling_val(root->child, sllist, values);
+    assert_non_null(node);
+    assert_string_equal(((struct lyd_node_leaf_list *)node)->value_str, "val57");
+    values[0] = "val100";
+    assert_null(lyd_find_sibling_val(root->child, sllist, values));
+
+    node = lyd_find_sibling_val(root->child, sleaf, NULL);
+    assert_non_null(node);
+    assert_string_equal(((struct lyd_node_leaf_list *)node)->value_str, "x");
+
+    /* top-level without a hash table */
+    assert_ptr_equal(lyd_find_sibling_val(root, root->schema, NULL), root);
+    assert_null(lyd_find_sibling_val(root, slist, values));
+
+    /* missing key values */
+    assert_null(lyd_find_sibling_val(root->child, slist, NULL));
+
+    lyd_free(root);
+}
+
 static void
 test_lyd_dup(void **state)
 {
@@ -705,6 +1293,123 @@ test_lyd_dup(void **state)
     lyd_free(copy);
 }
 
+static void
+test_lyd_arena(void **state)
+{
+    (void) state; /* unused */
+    struct lyd_arena *arena;
+    struct lyd_node *copy = NULL;
+    char *str1 = NULL, *str2 = NULL;
+
+    /* small blocks to use more of them */
+    arena = lyd_arena_new(64);
+    assert_ptr_not_equal(arena, NULL);
+    assert_ptr_equal(lyd_arena_use(arena), NULL);
+
+    copy = lyd_dup(root, 1);
+    assert_ptr_not_equal(copy, NULL);
+    lyd_print_mem(&str1, root, LYD_XML, LYP_WITHSIBLINGS);
+    lyd_print_mem(&str2, copy, LYD_XML, LYP_WITHSIBLINGS);
+    assert_string_equal(str1, str2);
+    free(str2);
+    str2 = NULL;
+    lyd_free_withsiblings(copy);
+
+    /* reuse the memory */
+    lyd_arena_reset(arena);
+    copy = lyd_parse_mem(ctx, str1, LYD_XML, LYD_OPT_CONFIG | LYD_OPT_STRICT);
+    assert_ptr_not_equal(copy, NULL);
+    lyd_print_mem(&str2, copy, LYD_XML, LYP_WITHSIBLINGS);
+    assert_string_equal(str1, str2);
+    lyd_free_withsiblings(copy);
+
+    assert_ptr_equal(lyd_arena_use(NULL), arena);
+    lyd_arena_free(arena);
+    free(str1);
+    free(str2);
+}
+
+static void
+test_lyd_compact(void **state)
+{
+    (void) state; /* unused */
+    struct lyd_arena *arena;
+    struct lyd_node *copy = NULL, *orig;
+    char *str1 = NULL, *str2 = NULL;
+
+    assert_ptr_equal(lyd_compact(&copy), NULL);
+
+    /* small threshold to create some children hash tables */
+    ly_ctx_set_data_hash_threshold(ctx, 2);
+    copy = lyd_dup_withsiblings(root, LYD_DUP_OPT_RECURSIVE);
+    assert_ptr_not_equal(copy, NULL);
+    orig = copy;
+
+    arena = lyd_compact(&copy);
+    assert_ptr_not_equal(arena, NULL);
+    assert_ptr_not_equal(copy, orig);
+    assert_ptr_equal(copy->parent, NULL);
+
+    lyd_print_mem(&str1, root, LYD_XML, LYP_WITHSIBLINGS);
+    lyd_print_mem(&str2, copy, LYD_XML, LYP_WITHSIBLINGS);
+    assert_string_equal(str1, str2);
+    assert_int_equal(lyd_validate(&copy, LYD_OPT_CONFIG, NULL), 0);
+
+    lyd_free_withsiblings(copy);
+    lyd_arena_free(arena);
+    free(str1);
+    free(str2);
+}
+
+static void
+test_lyd_vtree(void **state)
+{
+    (void) state; /* unused */
+    struct lyd_vtree *vtree;
+    struct lyd_vtree_ver *ver1, *ver2;
+    struct lyd_node *root1, *root2, *copy;
+    char *str1 = NULL, *str2 = NULL;
+
+    copy = lyd_dup_withsiblings(root, LYD_DUP_OPT_RECURSIVE);
+    assert_ptr_not_equal(copy, NULL);
+    vtree = lyd_vtree_new(copy);
+    assert_ptr_not_equal(vtree, NULL);
+
+    ver1 = lyd_vtree_pin(vtree, &root1);
+    assert_ptr_not_equal(ver1, NULL);
+    assert_ptr_equal(root1, copy);
+    assert_int_equal(lyd_vtree_ver_id(ver1), 1);
+
+    /* the writer modifies its own copy */
+    copy = lyd_vtree_copy(vtree);
+    assert_ptr_not_equal(copy, NULL);
+    assert_ptr_not_equal(copy, root1);
+    lyd_free(copy->child);
+    assert_int_equal(lyd_vtree_publish(vtree, copy), 0);
+
+    /* the pinned version is not affected */
+    ver2 = lyd_vtree_pin(vtree, &root2);
+    assert_ptr_not_equal(ver2, NULL);
+    assert_ptr_equal(root2, copy);
+    assert_int_equal(lyd_vtree_ver_id(ver2), 2);
+    lyd_print_mem(&str1, root, LYD_XML, LYP_WITHSIBLINGS);
+    lyd_print_mem(&str2, root1, LYD_XML, LYP_WITHSIBLINGS);
+    assert_string_equal(str1, str2);
+    free(str2);
+    lyd_print_mem(&str2, root2, LYD_XML, LYP_WITHSIBLINGS);
+    assert_string_not_equal(str1, str2);
+    lyd_vtree_unpin(ver1);
+
+    /* empty version, the pinned one outlives the versioned tree */
+    assert_int_equal(lyd_vtree_publish(vtree, NULL), 0);
+    lyd_vtree_free(vtree);
+    assert_ptr_equal(root2->child, copy->child);
+    lyd_vtree_unpin(ver2);
+
+    free(str1);
+    free(str2);
+}
+
 static void
 test_lyd_insert(void **state)
 {
@@ -933,323 +1638,1377 @@ test_lyd_schema_sort(void **state)
 }
 
 static void
-test_lyd_find_path(void **state)
+test_lyd_schema_sort_augment(void **state)
 {
-    (void) state; /* unused */
-    struct ly_set *set = NULL;
-    struct lyd_node_leaf_list *result;
-
-    set = lyd_find_path(root->child, "/a:x/bubba");
+    struct ly_ctx *ctx = *state;
+    struct lyd_node *data, *node;
+    const char *yang1 = "module t {namespace urn:t; prefix t;"
+        "container c {leaf a {type string;} choice ch {leaf b {type string;} case c1 {leaf d {type string;}}}"
+        "leaf-list ll {type string; ordered-by user;} leaf e {type string;}}"
+        "leaf t1 {type string;} leaf t2 {type string;}}";
+    const char *yang2 = "module t2 {namespace urn:t2; prefix t2; import t {prefix t;}"
+        "augment /t:c {leaf f {type string;} container g {leaf h {type string;} leaf i {type string;}}}"
+        "augment /t:c/t:ch {leaf j {type string;}}}";
+    const char *json = "{\"t:t2\":\"2\",\"t:c\":{\"t2:g\":{\"i\":\"i\",\"h\":\"h\"},\"e\":\"e\","
+        "\"ll\":[\"z\",\"a\"],\"t2:f\":\"f\",\"d\":\"d\",\"a\":\"a\"},\"t:t1\":\"1\"}";
+
+    assert_ptr_not_equal(lys_parse_mem(ctx, yang1, LYS_IN_YANG), NULL);
+    /* the augments are applied into an already loaded module */
+    assert_ptr_not_equal(lys_parse_mem(ctx, yang2, LYS_IN_YANG), NULL);
+
+    data = lyd_parse_mem(ctx, json, LYD_JSON, LYD_OPT_CONFIG | LYD_OPT_STRICT);
+    assert_ptr_not_equal(data, NULL);
+    assert_int_equal(lyd_schema_sort(data, 1), 0);
+    while (data->prev->next) {
+        data = data->prev;
+    }
 
-    struct lyd_node *node = *set->set.d;
-    result = (struct lyd_node_leaf_list *) node;
-    assert_string_equal("test", result->value_str);
+    assert_string_equal(data->schema->name, "c");
+    assert_string_equal(data->next->schema->name, "t1");
+    assert_string_equal(data->next->next->schema->name, "t2");
+
+    node = data->child;
+    assert_string_equal(node->schema->name, "a");
+    node = node->next;
+    assert_string_equal(node->schema->name, "d");
+    /* user-ordered instances keep their order */
+    node = node->next;
+    assert_string_equal(((struct lyd_node_leaf_list *)node)->value_str, "z");
+    node = node->next;
+    assert_string_equal(((struct lyd_node_leaf_list *)node)->value_str, "a");
+    node = node->next;
+    assert_string_equal(node->schema->name, "e");
+    node = node->next;
+    assert_string_equal(node->schema->name, "f");
+    node = node->next;
+    assert_string_equal(node->schema->name, "g");
+    assert_string_equal(node->child->schema->name, "h");
+    assert_string_equal(node->child->next->schema->name, "i");
+    assert_null(node->next);
 
-    ly_set_free(set);
+    lyd_free_withsiblings(data);
 }
 
-static void
-test_lyd_find_instance(void **state)
+static int
+hex_store_clb(const char *type_name, const char *value_str, lyd_val *value, char **err_msg)
 {
-    (void) state; /* unused */
-    struct ly_set *set = NULL;
-    struct lyd_node_leaf_list *result;
+    char *end;
 
-    set = lyd_find_instance(root->child, root->child->schema);
-    if (!set) {
-        fail();
-    }
+    (void)type_name;
+    (void)err_msg;
 
-    struct lyd_node *node = *set->set.d;
-    result = (struct lyd_node_leaf_list *) node;
-    assert_string_equal("test", result->value_str);
+    value->uint64 = strtoull(value_str, &end, 16);
+    return *end ? 1 : 0;
+}
 
-    ly_set_free(set);
+static int
+hex_compare_clb(const char *type_name, const lyd_val *value1, const lyd_val *value2)
+{
+    (void)type_name;
+    return value1->uint64 != value2->uint64;
 }
 
-static void
-test_lyd_validate(void **state)
+static uint32_t
+hex_hash_clb(const char *type_name, const lyd_val *value)
 {
-    (void) state; /* unused */
-    struct lyd_node *new = NULL;
-    struct lyd_node *node = root;
-    int rc;
+    (void)type_name;
+    return (uint32_t)value->uint64;
+}
 
-    rc = lyd_validate(&root, LYD_OPT_CONFIG, NULL);
-    if (rc) {
-        fail();
-    }
+static int
+hex_print_clb(const char *type_name, const lyd_val *value, char *buf, size_t buf_len)
+{
+    (void)type_name;
+    return snprintf(buf, buf_len, "%llx", (unsigned long long)value->uint64);
+}
 
-    if (root->child->next->next) {
-        fail();
-    }
+static struct lytype_plugin_list hex_plugin[] = {
+    {"h", NULL, "hex", hex_store_clb, NULL, hex_compare_clb, hex_hash_clb, hex_print_clb, NULL},
+    {NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL}
+};
 
-    new = lyd_new_leaf(root, node->schema->module, "number32", "1");
-    if (!new) {
-        fail();
-    }
+static void
+test_lyd_user_type_callbacks(void **state)
+{
+    struct ly_ctx *ctx = *state;
+    struct lyd_node *data;
+    struct ly_set *set;
+    const char *yang = "module h {namespace urn:h; prefix h; typedef hex {type string;}"
+        "container c {list l {key k; leaf k {type hex;} leaf v {type string;}} leaf-list ll {type hex;}}}";
 
-    rc = lyd_insert(root, new);
-    if (rc) {
-        fail();
+    assert_int_equal(ly_register_types(hex_plugin, "test"), 0);
+    assert_ptr_not_equal(lys_parse_mem(ctx, yang, LYS_IN_YANG), NULL);
+
+    /* values are printed in the canonical form of the plugin */
+    data = lyd_parse_mem(ctx, "<c xmlns=\"urn:h\"><l><k>0x1F</k><v>a</v></l><l><k>2</k></l><ll>0A</ll></c>",
+                         LYD_XML, LYD_OPT_CONFIG);
+    assert_ptr_not_equal(data, NULL);
+    assert_string_equal(((struct lyd_node_leaf_list *)data->child->child)->value_str, "1f");
+    assert_string_equal(((struct lyd_node_leaf_list *)data->child->prev)->value_str, "a");
+
+    /* keyed lookup still finds the instance */
+    set = lyd_find_path(data, "/h:c/l[k='1f']/v");
+    assert_ptr_not_equal(set, NULL);
+    assert_int_equal(set->number, 1);
+    ly_set_free(set);
+    lyd_free_withsiblings(data);
+
+    /* equal values in different lexical forms are duplicates */
+    data = lyd_parse_mem(ctx, "<c xmlns=\"urn:h\"><l><k>1f</k></l><l><k>0x1f</k></l></c>", LYD_XML, LYD_OPT_CONFIG);
+    assert_ptr_equal(data, NULL);
+    data = lyd_parse_mem(ctx, "<c xmlns=\"urn:h\"><ll>a</ll><ll>0xA</ll></c>", LYD_XML, LYD_OPT_CONFIG);
+    assert_ptr_equal(data, NULL);
+}
+
+static int digit_parser_calls;
+
+static int
+digit_parser(const struct lys_type *type, const char *value_str, lyd_val *value)
+{
+    (void)type;
+    ++digit_parser_calls;
+    if ((value_str[0] < '1') || (value_str[0] > '9') || value_str[1]) {
+        return 1;
     }
+    value->uint8 = value_str[0] - '0';
+    return 0;
+}
 
-    rc = lyd_validate(&root, LYD_OPT_CONFIG, NULL);
-    if (rc) {
-        fail();
+static int
+ab_parser(const struct lys_type *type, const char *value_str, lyd_val *value)
+{
+    if (!strcmp(value_str, "a")) {
+        value->enm = &type->info.enums.enm[0];
+    } else if (!strcmp(value_str, "b")) {
+        value->enm = &type->info.enums.enm[1];
+    } else {
+        return 1;
     }
+    return 0;
 }
 
 static void
-test_lyd_unlink(void **state)
+test_lyd_value_parser(void **state)
 {
-    (void) state; /* unused */
-    struct lyd_node *new = NULL;
-    struct lyd_node *node = root->child;
-    struct lyd_node_leaf_list *result;
-    int rc;
+    struct ly_ctx *ctx = *state;
+    const struct lys_module *mod;
+    struct lyd_node *data;
+    struct lyd_node_leaf_list *leaf;
+    const char *yang = "module vp {namespace urn:vp; prefix vp; typedef ab {type enumeration {enum a; enum b;}}"
+        "container c {leaf n {type uint8 {range 1..20;}} leaf e {type ab;} leaf u {type union {type uint8; type string;}}}}";
+
+    mod = lys_parse_mem(ctx, yang, LYS_IN_YANG);
+    assert_ptr_not_equal(mod, NULL);
+    assert_int_equal(lys_set_value_parser(mod->data, digit_parser), EXIT_FAILURE);
+    assert_int_equal(lys_set_value_parser(mod->data->child->prev, digit_parser), EXIT_FAILURE);
+#ifndef LY_ENABLED_CACHE
+    assert_int_equal(lys_set_value_parser(mod->data->child, digit_parser), EXIT_FAILURE);
+#else
+    assert_int_equal(lys_set_value_parser(mod->data->child, digit_parser), EXIT_SUCCESS);
+    assert_int_equal(lys_set_value_parser(mod->data->child->next, ab_parser), EXIT_SUCCESS);
+
+    /* accepted by the specialized parser */
+    data = lyd_parse_mem(ctx, "<c xmlns=\"urn:vp\"><n>5</n><e>b</e></c>", LYD_XML, LYD_OPT_CONFIG);
+    assert_ptr_not_equal(data, NULL);
+    assert_int_equal(digit_parser_calls, 1);
+    leaf = (struct lyd_node_leaf_list *)data->child;
+    assert_int_equal(leaf->value_type, LY_TYPE_UINT8);
+    assert_int_equal(leaf->value.uint8, 5);
+    leaf = (struct lyd_node_leaf_list *)data->child->next;
+    assert_int_equal(leaf->value_type, LY_TYPE_ENUM);
+    assert_string_equal(leaf->value.enm->name, "b");
+
+    /* the rest is parsed by the generic parser */
+    assert_ptr_not_equal(lyd_new_path(data, NULL, "/vp:c/n", "+15", 0, LYD_PATH_OPT_UPDATE), NULL);
+    assert_int_equal(digit_parser_calls, 2);
+    leaf = (struct lyd_node_leaf_list *)data->child;
+    assert_string_equal(leaf->value_str, "15");
+    assert_int_equal(leaf->value.uint8, 15);
+    lyd_free_withsiblings(data);
 
-    new = lyd_new_leaf(root, node->schema->module, "number32", "1");
-    if (!new) {
-        fail();
-    }
+    data = lyd_parse_mem(ctx, "<c xmlns=\"urn:vp\"><n>0</n></c>", LYD_XML, LYD_OPT_CONFIG);
+    assert_ptr_equal(data, NULL);
+    assert_int_equal(digit_parser_calls, 3);
+    data = lyd_parse_mem(ctx, "<c xmlns=\"urn:vp\"><e>c</e></c>", LYD_XML, LYD_OPT_CONFIG);
+    assert_ptr_equal(data, NULL);
 
-    rc = lyd_insert(root, new);
-    if (rc) {
-        fail();
-    }
+    /* unset */
+    assert_int_equal(lys_set_value_parser(mod->data->child, NULL), EXIT_SUCCESS);
+    data = lyd_new_path(NULL, ctx, "/vp:c/n", "7", 0, 0);
+    assert_ptr_not_equal(data, NULL);
+    assert_int_equal(digit_parser_calls, 3);
+    lyd_free_withsiblings(data);
+#endif
+}
 
-    result = (struct lyd_node_leaf_list *) node->prev;
-    assert_string_equal("1", result->value_str);
+static void
+test_lyd_private_values(void **state)
+{
+    struct ly_ctx *ctx = *state;
+    const struct lys_module *mod;
+    struct lyd_node *data, *copy;
+    struct lyd_node_leaf_list *leaf;
+    lyd_val val;
+    char *mem;
+    const char *yang = "module pv {namespace urn:pv; prefix pv;"
+        "container c {leaf n {type uint32;} leaf d {type decimal64 {fraction-digits 2;} default 1.5;}"
+        "leaf e {type enumeration {enum a; enum b;}} leaf s {type string;}"
+        "list l {key k; leaf k {type int16;}} leaf r {type leafref {path ../l/k;}}}}";
+
+    mod = lys_parse_mem(ctx, yang, LYS_IN_YANG);
+    assert_ptr_not_equal(mod, NULL);
+    ly_ctx_set_private_values(ctx, LY_PRIVVAL_NUMBERS);
+    assert_int_equal(ly_ctx_get_private_values(ctx), LY_PRIVVAL_NUMBERS);
+
+    data = lyd_parse_mem(ctx, "<c xmlns=\"urn:pv\"><n>+0042</n><e>b</e><s>x</s><l><k>7</k></l><r>7</r></c>",
+                         LYD_XML, LYD_OPT_CONFIG);
+    assert_ptr_not_equal(data, NULL);
 
-    rc = lyd_unlink(node->prev);
-    if (rc) {
-        fail();
-    }
+    /* only the numeric non-default values are private, even after canonization */
+    leaf = (struct lyd_node_leaf_list *)data->child;
+    assert_string_equal(leaf->value_str, "42");
+    assert_true(leaf->value_flags & LY_VALUE_PRIVATE);
+    assert_int_equal(leaf->value.uint32, 42);
+    leaf = (struct lyd_node_leaf_list *)leaf->next;
+    assert_false(leaf->value_flags & LY_VALUE_PRIVATE);
+    assert_false(((struct lyd_node_leaf_list *)leaf->next)->value_flags & LY_VALUE_PRIVATE);
+    assert_true(((struct lyd_node_leaf_list *)leaf->next->next->child)->value_flags & LY_VALUE_PRIVATE);
+    leaf = (struct lyd_node_leaf_list *)data->child->prev;
+    assert_string_equal(leaf->schema->name, "d");
+    assert_true(leaf->dflt);
+    assert_false(leaf->value_flags & LY_VALUE_PRIVATE);
+
+    /* the leafref target is found by the private value */
+    assert_int_equal(lyd_validate(&data, LYD_OPT_CONFIG, NULL), 0);
+    leaf = (struct lyd_node_leaf_list *)data->child->next->next->next->next;
+    assert_string_equal(leaf->schema->name, "r");
+    assert_ptr_equal(leaf->value.leafref, data->child->next->next->next->child);
+
+    /* changed values */
+    leaf = (struct lyd_node_leaf_list *)data->child;
+    val.uint32 = 1234567;
+    assert_int_equal(lyd_change_leaf_val(leaf, &val), 0);
+    assert_string_equal(leaf->value_str, "1234567");
+    assert_true(leaf->value_flags & LY_VALUE_PRIVATE);
+    assert_int_equal(lyd_change_leaf(leaf, "08"), 0);
+    assert_string_equal(leaf->value_str, "8");
+    assert_int_equal(lyd_change_leaf((struct lyd_node_leaf_list *)data->child->prev, "2.50"), 0);
+    assert_string_equal(((struct lyd_node_leaf_list *)data->child->prev)->value_str, "2.5");
+    assert_true(((struct lyd_node_leaf_list *)data->child->prev)->value_flags & LY_VALUE_PRIVATE);
+    assert_int_equal(lyd_change_leaf((struct lyd_node_leaf_list *)data->child->prev, "x"), -1);
+
+    /* the private values survive printing, parsing, and duplication */
+    assert_int_equal(lyd_change_leaf((struct lyd_node_leaf_list *)data->child->prev, "1.5"), 0);
+    copy = lyd_dup(data, LYD_DUP_OPT_RECURSIVE);
+    assert_ptr_not_equal(copy, NULL);
+    assert_true(((struct lyd_node_leaf_list *)copy->child)->value_flags & LY_VALUE_PRIVATE);
+    assert_int_equal(lyd_print_mem(&mem, copy, LYD_XML, LYP_WITHSIBLINGS), 0);
+    assert_string_equal(mem, "<c xmlns=\"urn:pv\"><n>8</n><e>b</e><s>x</s><l><k>7</k></l><r>7</r><d>1.5</d></c>");
+    free(mem);
+    lyd_free_withsiblings(copy);
 
-    assert_string_not_equal("1", ((struct lyd_node_leaf_list *)node->prev)->value_str);
+    assert_int_equal(lyd_print_mem(&mem, data, LYD_JSON, LYP_WITHSIBLINGS), 0);
+    copy = lyd_parse_mem(ctx, mem, LYD_JSON, LYD_OPT_CONFIG);
+    free(mem);
+    assert_ptr_not_equal(copy, NULL);
+    assert_true(((struct lyd_node_leaf_list *)copy->child)->value_flags & LY_VALUE_PRIVATE);
+    assert_string_equal(((struct lyd_node_leaf_list *)copy->child)->value_str, "8");
+    lyd_free_withsiblings(copy);
 
-    lyd_free(new);
+    assert_int_equal(lyd_print_mem(&mem, data, LYD_LYB, LYP_WITHSIBLINGS), 0);
+    copy = lyd_parse_mem(ctx, mem, LYD_LYB, LYD_OPT_CONFIG);
+    free(mem);
+    assert_ptr_not_equal(copy, NULL);
+    assert_string_equal(((struct lyd_node_leaf_list *)copy->child)->value_str, "8");
+    assert_true(((struct lyd_node_leaf_list *)copy->child)->value_flags & LY_VALUE_PRIVATE);
+    lyd_free_withsiblings(copy);
+
+    /* the existing nodes are not affected by the setting */
+    ly_ctx_set_private_values(ctx, 0);
+    copy = lyd_new_path(data, NULL, "/pv:c/l[k='9']", NULL, 0, 0);
+    assert_ptr_not_equal(copy, NULL);
+    assert_false(((struct lyd_node_leaf_list *)copy->child)->value_flags & LY_VALUE_PRIVATE);
+    assert_true(((struct lyd_node_leaf_list *)data->child)->value_flags & LY_VALUE_PRIVATE);
+    lyd_free_withsiblings(data);
 }
 
 static void
-test_lyd_free(void **state)
+test_lyd_find_path(void **state)
 {
     (void) state; /* unused */
-    struct lyd_node *copy = NULL;
+    struct ly_set *set = NULL;
+    struct lyd_node_leaf_list *result;
 
-    copy = lyd_dup(root->child, 0);
-    if (!copy) {
-        fail();
-    }
+    set = lyd_find_path(root->child, "/a:x/bubba");
 
-    lyd_free(copy);
+    struct lyd_node *node = *set->set.d;
+    result = (struct lyd_node_leaf_list *) node;
+    assert_string_equal("test", result->value_str);
+
+    ly_set_free(set);
 }
 
 static void
-test_lyd_free_withsiblings(void **state)
+test_lyd_find_compiled(void **state)
 {
     (void) state; /* unused */
-    struct lyd_node *copy = NULL;
-    struct lyd_node *new = NULL;
-    struct lyd_node *node = root->child;
-    int rc;
+    struct ly_set *set;
+    struct lyd_path_query *query;
 
-    copy = lyd_dup(root->child, 0);
-    if (!copy) {
-        fail();
-    }
+    query = lyd_path_compile(root->schema->module, "/a:x/bubba");
+    assert_ptr_not_equal(query, NULL);
 
-    new = lyd_new_leaf(root, node->schema->module, "number32", "1");
-    if (!new) {
-        fail();
-    }
+    set = lyd_find_compiled(root->child, query);
+    assert_ptr_not_equal(set, NULL);
+    assert_int_equal(set->number, 1);
+    assert_string_equal(((struct lyd_node_leaf_list *)set->set.d[0])->value_str, "test");
+    ly_set_free(set);
 
-    rc = lyd_insert(copy, new);
-    if (!rc) {
-        fail();
-    }
+    /* the same query again */
+    set = lyd_find_compiled(root, query);
+    assert_ptr_not_equal(set, NULL);
+    assert_int_equal(set->number, 1);
+    ly_set_free(set);
+    lyd_path_query_free(query);
+
+    /* relative path */
+    query = lyd_path_compile(root->schema->module, "bubba");
+    assert_ptr_not_equal(query, NULL);
+    set = lyd_find_compiled(root, query);
+    assert_ptr_not_equal(set, NULL);
+    assert_int_equal(set->number, 1);
+    ly_set_free(set);
+    lyd_path_query_free(query);
 
-    lyd_free_withsiblings(copy);
+    /* unknown module */
+    assert_ptr_equal(lyd_path_compile(root->schema->module, "/nonexistent:x"), NULL);
 }
 
 static void
-test_lyd_insert_attr(void **state)
+test_lyd_find_iter(void **state)
 {
-    (void) state; /* unused */
-    struct lyd_attr *attr = NULL;
-    struct lyd_node *node = root->child;
+    struct ly_ctx *ctx = *state;
+    struct lyd_node *data, *node;
+    struct lyd_find_iter *iter;
+    struct ly_set *set;
+    uint32_t i;
+    int j;
+    const char *yang = "module i {namespace urn:i; prefix i;"
+        "container c {list l {key k; leaf k {type string;} leaf v {type int8;}"
+        "container s {leaf-list x {type string;}}}}}";
+    const char *paths[] = {"/i:c/l/k", "/i:c/l[v > 1]/s/x", "/i:c/l[2]/k", "/i:c/l[v > 1][2]/k", "/i:c/l[last()]/k",
+                           "/i:c/*/s", "//x", "/i:c/l[k = 'd']"};
+
+    assert_ptr_not_equal(lys_parse_mem(ctx, yang, LYS_IN_YANG), NULL);
+    data = lyd_parse_mem(ctx, "<c xmlns=\"urn:i\"><l><k>a</k><v>1</v></l><l><k>b</k><v>2</v><s><x>p</x><x>q</x></s></l>"
+                         "<l><k>c</k><v>3</v><s><x>r</x></s></l></c>", LYD_XML, LYD_OPT_CONFIG);
+    assert_ptr_not_equal(data, NULL);
 
-    attr = lyd_insert_attr(node, NULL, "test", "test");
-    if (!attr) {
-        fail();
+    /* the same nodes in the same order as the whole result */
+    for (j = 0; j < 8; ++j) {
+        set = lyd_find_path(data, paths[j]);
+        assert_ptr_not_equal(set, NULL);
+        iter = lyd_find_iter_new(data, paths[j]);
+        assert_ptr_not_equal(iter, NULL);
+        for (i = 0; (node = lyd_find_iter_next(iter)); ++i) {
+            assert_true(i < set->number);
+            assert_ptr_equal(node, set->set.d[i]);
+        }
+        assert_int_equal(i, set->number);
+        assert_ptr_equal(lyd_find_iter_next(iter), NULL);
+        lyd_find_iter_free(iter);
+        ly_set_free(set);
     }
 
-    assert_string_equal("test", node->attr->name);
+    /* positional predicates */
+    iter = lyd_find_iter_new(data, "/i:c/l[v > 1][2]/k");
+    assert_ptr_not_equal(iter, NULL);
+    node = lyd_find_iter_next(iter);
+    assert_ptr_not_equal(node, NULL);
+    assert_string_equal(((struct lyd_node_leaf_list *)node)->value_str, "c");
+    assert_ptr_equal(lyd_find_iter_next(iter), NULL);
+    lyd_find_iter_free(iter);
+
+    /* relative path */
+    iter = lyd_find_iter_new(data, "l[k='b']/v");
+    assert_ptr_not_equal(iter, NULL);
+    node = lyd_find_iter_next(iter);
+    assert_ptr_not_equal(node, NULL);
+    assert_string_equal(((struct lyd_node_leaf_list *)node)->value_str, "2");
+    assert_ptr_equal(lyd_find_iter_next(iter), NULL);
+    lyd_find_iter_free(iter);
+
+    lyd_free_withsiblings(data);
 }
 
 static void
-test_lyd_free_attr(void **state)
+test_lyd_find_instance(void **state)
 {
     (void) state; /* unused */
-    struct lyd_attr *attr = NULL;
-    struct lyd_node *node = root->child;
-
-    attr = lyd_insert_attr(node, NULL, "test", "test");
+    struct ly_set *set = NULL;
+    struct lyd_node_leaf_list *result;
 
-    if (!node->attr) {
+    set = lyd_find_instance(root->child, root->child->schema);
+    if (!set) {
         fail();
     }
 
-    lyd_free_attr(ctx, node, attr, 0);
-
-    if (node->attr) {
-        fail();
-    }
+    struct lyd_node *node = *set->set.d;
+    result = (struct lyd_node_leaf_list *) node;
+    assert_string_equal("test", result->value_str);
 
+    ly_set_free(set);
 }
 
 static void
-test_lyd_print_mem_xml(void **state)
+test_lyd_validate(void **state)
 {
     (void) state; /* unused */
-    char *result = NULL;
+    struct lyd_node *new = NULL;
+    struct lyd_node *node = root;
     int rc;
 
-    rc = lyd_print_mem(&result, root, LYD_XML, 0);
+    rc = lyd_validate(&root, LYD_OPT_CONFIG, NULL);
     if (rc) {
         fail();
     }
 
-    assert_string_equal(result_xml, result);
-    free(result);
-}
+    if (root->child->next->next) {
+        fail();
+    }
 
-static void
-test_lyd_print_mem_xml_format(void **state)
-{
-    (void) state; /* unused */
-    char *result = NULL;
-    int rc;
+    new = lyd_new_leaf(root, node->schema->module, "number32", "1");
+    if (!new) {
+        fail();
+    }
 
-    rc = lyd_print_mem(&result, root, LYD_XML, LYP_FORMAT);
+    rc = lyd_insert(root, new);
     if (rc) {
         fail();
     }
 
-    assert_string_equal(result_xml_format, result);
-    free(result);
-}
-
-static void
-test_lyd_print_mem_json(void **state)
-{
-    (void) state; /* unused */
-    char *result = NULL;
-    int rc;
-
-    rc = lyd_print_mem(&result, root, LYD_JSON, LYP_FORMAT);
+    rc = lyd_validate(&root, LYD_OPT_CONFIG, NULL);
     if (rc) {
         fail();
     }
+}
 
-    assert_string_equal(result_json, result);
-    free(result);
+static void *
+node_cache_thread(void *arg)
+{
+    struct lyd_node *data = arg;
+    char path[64];
+    int i;
+
+    /* the structures freed by the main thread are reused */
+    for (i = 0; i < 1000; ++i) {
+        sprintf(path, "/nc:c/l[k='%d']/v", i);
+        if (!lyd_new_path(data, NULL, path, "thread", 0, 0)) {
+            return NULL;
+        }
+    }
+    return data;
 }
 
 static void
-test_lyd_print_fd_xml(void **state)
+test_lyd_node_cache(void **state)
 {
-    (void) state; /* unused */
-    char *result = NULL;
-    struct stat sb;
-    char file_name[20];
-    int rc;
-    int fd;
-
-    memset(file_name, 0, sizeof(file_name));
-    strncpy(file_name, TMP_TEMPLATE, sizeof(file_name));
-
-    fd = mkstemp(file_name);
-    if (fd < 1) {
-        goto error;
+    struct ly_ctx *ctx = *state;
+    struct lyd_node *data;
+    pthread_t thread;
+    void *ret;
+    char path[64], *str;
+    int i;
+    const char *yang = "module nc {namespace urn:nc; prefix nc;"
+        "container c {list l {key k; leaf k {type uint16;} leaf v {type string;}}}}";
+
+    assert_ptr_not_equal(lys_parse_mem(ctx, yang, LYS_IN_YANG), NULL);
+    data = lyd_new_path(NULL, ctx, "/nc:c", NULL, 0, 0);
+    assert_ptr_not_equal(data, NULL);
+    for (i = 0; i < 1000; ++i) {
+        sprintf(path, "/nc:c/l[k='%d']/v", i);
+        assert_ptr_not_equal(lyd_new_path(data, NULL, path, "main", 0, 0), NULL);
     }
-
-    rc = lyd_print_fd(fd, root, LYD_XML, 0);
-    if (rc) {
-        goto error;
+    while (data->child) {
+        lyd_free(data->child);
     }
 
-    if (fstat(fd, &sb) == -1 || !S_ISREG(sb.st_mode)) {
-        goto error;
-    }
+    assert_int_equal(pthread_create(&thread, NULL, node_cache_thread, data), 0);
+    assert_int_equal(pthread_join(thread, &ret), 0);
+    assert_ptr_equal(ret, data);
+    assert_int_equal(lyd_validate(&data, LYD_OPT_CONFIG, NULL), 0);
+    assert_int_equal(lyd_print_mem(&str, data->child->prev, LYD_XML, 0), 0);
+    assert_string_equal(str, "<l xmlns=\"urn:nc\"><k>999</k><v>thread</v></l>");
+    free(str);
 
-    result = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    /* the nodes created by the thread are freed by the main thread */
+    lyd_free_withsiblings(data);
+}
 
-    assert_string_equal(result_xml, result);
+static void *
+find_path_thread(void *arg)
+{
+    struct lyd_node *data = arg;
+    const struct lys_node *slist;
+    struct ly_set *set;
+    char path[64], key[8];
+    const char *values[1];
+    int i, ok = 1;
+
+    slist = data->child->schema;
+    for (i = 0; ok && (i < 2000); ++i) {
+        sprintf(path, "/fp:c/l[k='%d']/v", i % 100);
+        set = lyd_find_path(data, path);
+        ok = set && (set->number == 1) && !strcmp(((struct lyd_node_leaf_list *)set->set.d[0])->value_str, "v");
+        ly_set_free(set);
+
+        sprintf(key, "%d", (i * 7) % 100);
+        values[0] = key;
+        ok = ok && lyd_find_sibling_val(data->child, slist, values);
+    }
 
-    close(fd);
-    unlink(file_name);
+    set = lyd_find_path(data, "/fp:c/l[v='v']");
+    ok = ok && set && (set->number == 100);
+    ly_set_free(set);
 
-    return;
-error:
-    if (fd > 0) {
-        close(fd);
-        unlink(file_name);
-    }
-    fail();
+    return ok ? data : NULL;
 }
 
 static void
-test_lyd_print_fd_xml_format(void **state)
+test_lyd_find_path_threads(void **state)
 {
-    (void) state; /* unused */
-    char *result = NULL;
-    struct stat sb;
-    char file_name[20];
-    int rc;
-    int fd;
-
-    memset(file_name, 0, sizeof(file_name));
-    strncpy(file_name, TMP_TEMPLATE, sizeof(file_name));
-
-    fd = mkstemp(file_name);
-    if (fd < 1) {
-        goto error;
+    struct ly_ctx *ctx = *state;
+    struct lyd_node *data;
+    pthread_t threads[4];
+    void *ret;
+    char path[64];
+    int i;
+    const char *yang = "module fp {namespace urn:fp; prefix fp;"
+        "container c {list l {key k; leaf k {type int16;} leaf v {type string;}}}}";
+
+    assert_ptr_not_equal(lys_parse_mem(ctx, yang, LYS_IN_YANG), NULL);
+    data = lyd_new_path(NULL, ctx, "/fp:c", NULL, 0, 0);
+    assert_ptr_not_equal(data, NULL);
+    for (i = 0; i < 100; ++i) {
+        sprintf(path, "/fp:c/l[k='%d']/v", i);
+        assert_ptr_not_equal(lyd_new_path(data, NULL, path, "v", 0, 0), NULL);
     }
+    assert_int_equal(lyd_validate(&data, LYD_OPT_CONFIG, NULL), 0);
 
-    rc = lyd_print_fd(fd, root, LYD_XML, LYP_FORMAT);
-    if (rc) {
-        goto error;
+    /* the same tree is only read by all the threads */
+    for (i = 0; i < 4; ++i) {
+        assert_int_equal(pthread_create(&threads[i], NULL, find_path_thread, data), 0);
     }
-
-    if (fstat(fd, &sb) == -1 || !S_ISREG(sb.st_mode)) {
-        goto error;
+    for (i = 0; i < 4; ++i) {
+        assert_int_equal(pthread_join(threads[i], &ret), 0);
+        assert_ptr_equal(ret, data);
     }
 
-    result = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
-
-    assert_string_equal(result_xml_format, result);
-
-    close(fd);
-    unlink(file_name);
-
-    return;
-error:
-    if (fd > 0) {
-        close(fd);
-        unlink(file_name);
-    }
-    fail();
+    lyd_free_withsiblings(data);
 }
 
 static void
-test_lyd_print_fd_json(void **state)
+test_lyd_validate_threads(void **state)
 {
-    (void) state; /* unused */
-    char *result = NULL;
+    struct ly_ctx *ctx = *state;
+    struct lyd_node *data = NULL;
+    const char *yang = "module t {namespace urn:t; prefix t;"
+        "container a {leaf x {type string;} leaf ref {type leafref {path /t:d/t:v;}}}"
+        "container b {list l {key k; unique u; leaf k {type int8;} leaf u {type int8;}}}"
+        "container c {leaf s {type string; must \". != /t:a/t:x\";} leaf st {type string; config false;}}"
+        "container d {leaf-list v {type string;}}}";
+    const char *xml = "<a xmlns=\"urn:t\"><x>1</x><ref>v2</ref></a>"
+        "<b xmlns=\"urn:t\"><l><k>1</k><u>1</u></l><l><k>2</k><u>2</u></l></b>"
+        "<c xmlns=\"urn:t\"><s>2</s></c>"
+        "<d xmlns=\"urn:t\"><v>v1</v><v>v2</v></d>";
+
+    assert_ptr_not_equal(lys_parse_mem(ctx, yang, LYS_IN_YANG), NULL);
+    ly_ctx_set_validation_threads(ctx, 3);
+    assert_int_equal(ly_ctx_get_validation_threads(ctx), 3);
+
+    data = lyd_parse_mem(ctx, xml, LYD_XML, LYD_OPT_CONFIG | LYD_OPT_TRUSTED);
+    assert_ptr_not_equal(data, NULL);
+    assert_int_equal(lyd_validate(&data, LYD_OPT_CONFIG, NULL), 0);
+
+    /* cross-subtree dependency */
+    lyd_change_leaf((struct lyd_node_leaf_list *)data->child->next, "v3");
+    assert_int_not_equal(lyd_validate(&data, LYD_OPT_CONFIG, NULL), 0);
+    assert_int_equal(ly_errno, LY_EVALID);
+    assert_int_equal(ly_vecode(ctx), LYVE_NOLEAFREF);
+    lyd_change_leaf((struct lyd_node_leaf_list *)data->child->next, "v1");
+    assert_int_equal(lyd_validate(&data, LYD_OPT_CONFIG, NULL), 0);
+
+    /* error in a subtree checked by another thread */
+    assert_ptr_not_equal(lyd_new_leaf(data->next->next, NULL, "st", "x"), NULL);
+    assert_int_not_equal(lyd_validate(&data, LYD_OPT_CONFIG, NULL), 0);
+    assert_int_equal(ly_errno, LY_EVALID);
+    assert_int_equal(ly_vecode(ctx), LYVE_INELEM);
+    assert_string_equal(ly_errpath(ctx), "/t:c/st");
+
+    lyd_free_withsiblings(data);
+}
+
+static void
+test_lyd_hash_threshold(void **state)
+{
+    struct ly_ctx *ctx = *state;
+    struct lyd_node *data, *node;
+    const char *yang = "module t {namespace urn:t; prefix t;"
+        "container a {leaf x {type string;} leaf y {type string;} leaf z {type string;}}}";
+
+    assert_ptr_not_equal(lys_parse_mem(ctx, yang, LYS_IN_YANG), NULL);
+    assert_int_equal(ly_ctx_get_data_hash_threshold(ctx), 4);
+    ly_ctx_set_data_hash_threshold(ctx, 2);
+    assert_int_equal(ly_ctx_get_data_hash_threshold(ctx), 2);
+
+    data = lyd_new_path(NULL, ctx, "/t:a/x", "1", 0, 0);
+    assert_ptr_not_equal(data, NULL);
+#ifdef LY_ENABLED_CACHE
+    assert_ptr_equal(data->ht, NULL);
+#endif
+    assert_ptr_not_equal(lyd_new_path(data, NULL, "/t:a/y", "2", 0, 0), NULL);
+#ifdef LY_ENABLED_CACHE
+    assert_ptr_not_equal(data->ht, NULL);
+#endif
+    node = lyd_new_path(data, NULL, "/t:a/z", "3", 0, 0);
+    assert_ptr_not_equal(node, NULL);
+    assert_ptr_equal(data->child->next->next, node);
+
+    /* raised threshold, the table is freed once there are fewer children */
+    ly_ctx_set_data_hash_threshold(ctx, 3);
+    lyd_free(node);
+#ifdef LY_ENABLED_CACHE
+    assert_ptr_equal(data->ht, NULL);
+#endif
+
+    /* no tables at all */
+    ly_ctx_set_data_hash_threshold(ctx, 0);
+    assert_ptr_not_equal(lyd_new_path(data, NULL, "/t:a/z", "3", 0, 0), NULL);
+#ifdef LY_ENABLED_CACHE
+    assert_ptr_equal(data->ht, NULL);
+#endif
+    assert_ptr_not_equal(lyd_new_path(data, NULL, "/t:a/z", "4", 0, LYD_PATH_OPT_UPDATE), NULL);
+    assert_string_equal(((struct lyd_node_leaf_list *)data->child->next->next)->value_str, "4");
+
+    lyd_free_withsiblings(data);
+}
+
+static void
+test_lyd_print_threads(void **state)
+{
+    struct ly_ctx *ctx = *state;
+    struct lyd_node *data;
+    const char *yang = "module t {namespace urn:t; prefix t;"
+        "container a {leaf x {type string;}}"
+        "list l {key k; leaf k {type int8;} leaf v {type string;}}"
+        "leaf-list ll {type string;}"
+        "leaf b {type string; default \"d\";}"
+        "anydata any;}";
+    const char *xml = "<l xmlns=\"urn:t\"><k>1</k><v>a&lt;b</v></l>"
+        "<a xmlns=\"urn:t\"><x>1</x></a>"
+        "<ll xmlns=\"urn:t\">x</ll>"
+        "<l xmlns=\"urn:t\"><k>2</k></l>"
+        "<any xmlns=\"urn:t\"><y xmlns=\"urn:y\">text</y></any>"
+        "<ll xmlns=\"urn:t\">y</ll>";
+    const int options[] = {LYP_WITHSIBLINGS, LYP_WITHSIBLINGS | LYP_FORMAT, LYP_WITHSIBLINGS | LYP_WD_ALL_TAG};
+    const LYD_FORMAT formats[] = {LYD_XML, LYD_JSON};
+    char *str1, *str2;
+    int i, j;
+
+    assert_ptr_not_equal(lys_parse_mem(ctx, yang, LYS_IN_YANG), NULL);
+    data = lyd_parse_mem(ctx, xml, LYD_XML, LYD_OPT_CONFIG);
+    assert_ptr_not_equal(data, NULL);
+
+    for (i = 0; i < 2; ++i) {
+        for (j = 0; j < 3; ++j) {
+            ly_ctx_set_print_threads(ctx, 0);
+            assert_int_equal(lyd_print_mem(&str1, data, formats[i], options[j]), 0);
+            ly_ctx_set_print_threads(ctx, 4);
+            assert_int_equal(ly_ctx_get_print_threads(ctx), 4);
+            assert_int_equal(lyd_print_mem(&str2, data, formats[i], options[j]), 0);
+            assert_string_equal(str1, str2);
+            free(str1);
+            free(str2);
+        }
+    }
+
+    lyd_free_withsiblings(data);
+}
+
+static void
+test_lyd_val_profile(void **state)
+{
+    struct ly_ctx *ctx = *state;
+    struct lyd_node *data;
+    struct ly_val_prof *profs;
+    uint32_t count, i;
+    const char *yang = "module t {namespace urn:t; prefix t;"
+        "list l {key k; unique v; must \"v != 'x'\"; leaf k {type string;} leaf v {type string;}}"
+        "leaf r {type leafref {path \"/l/k\";}}"
+        "leaf w {when \"/r = 'a'\"; type string;}}";
+    const char *xml = "<l xmlns=\"urn:t\"><k>a</k><v>1</v></l>"
+        "<l xmlns=\"urn:t\"><k>b</k><v>2</v></l>"
+        "<l xmlns=\"urn:t\"><k>c</k><v>3</v></l>"
+        "<r xmlns=\"urn:t\">a</r>"
+        "<w xmlns=\"urn:t\">x</w>";
+
+    assert_ptr_not_equal(lys_parse_mem(ctx, yang, LYS_IN_YANG), NULL);
+
+    /* disabled by default */
+    assert_int_equal(ly_ctx_get_val_profiling(ctx), 0);
+    data = lyd_parse_mem(ctx, xml, LYD_XML, LYD_OPT_CONFIG);
+    assert_ptr_not_equal(data, NULL);
+    lyd_free_withsiblings(data);
+    assert_ptr_equal(ly_ctx_get_val_profile(ctx, &count), NULL);
+    assert_int_equal(count, 0);
+
+    ly_ctx_set_val_profiling(ctx, 1);
+    assert_int_equal(ly_ctx_get_val_profiling(ctx), 1);
+    data = lyd_parse_mem(ctx, xml, LYD_XML, LYD_OPT_CONFIG);
+    assert_ptr_not_equal(data, NULL);
+    lyd_free_withsiblings(data);
+
+    profs = ly_ctx_get_val_profile(ctx, &count);
+    assert_ptr_not_equal(profs, NULL);
+    assert_int_equal(count, 4);
+    for (i = 0; i < count; ++i) {
+        if (i) {
+            assert_true(profs[i - 1].time >= profs[i].time);
+        }
+        switch (profs[i].type) {
+        case LY_VAL_PROF_MUST:
+            assert_string_equal(profs[i].node->name, "l");
+            assert_string_equal(profs[i].expr, "v != 'x'");
+            assert_int_equal(profs[i].count, 3);
+            break;
+        case LY_VAL_PROF_WHEN:
+            assert_string_equal(profs[i].node->name, "w");
+            assert_string_equal(profs[i].expr, "/r = 'a'");
+            assert_int_equal(profs[i].count, 1);
+            break;
+        case LY_VAL_PROF_LEAFREF:
+            assert_string_equal(profs[i].node->name, "r");
+            assert_string_equal(profs[i].expr, "/l/k");
+            assert_int_equal(profs[i].count, 1);
+            assert_true(profs[i].max_nodes >= 1);
+            break;
+        case LY_VAL_PROF_UNIQUE:
+            assert_string_equal(profs[i].node->name, "l");
+            assert_ptr_equal(profs[i].expr, NULL);
+            assert_int_equal(profs[i].count, 1);
+            assert_int_equal(profs[i].nodes, 3);
+            break;
+        }
+    }
+    free(profs);
+
+    /* the profile is kept when disabled, but not extended */
+    ly_ctx_set_val_profiling(ctx, 0);
+    data = lyd_parse_mem(ctx, xml, LYD_XML, LYD_OPT_CONFIG);
+    assert_ptr_not_equal(data, NULL);
+    lyd_free_withsiblings(data);
+    profs = ly_ctx_get_val_profile(ctx, &count);
+    assert_int_equal(count, 4);
+    for (i = 0; i < count; ++i) {
+        if (profs[i].type == LY_VAL_PROF_MUST) {
+            assert_int_equal(profs[i].count, 3);
+        }
+    }
+    free(profs);
+
+    ly_ctx_clean_val_profile(ctx);
+    assert_ptr_equal(ly_ctx_get_val_profile(ctx, &count), NULL);
+    assert_int_equal(count, 0);
+}
+
+static int
+test_lyd_eval_budget_yield(void *user_data)
+{
+    int *calls = user_data;
+
+    ++(*calls);
+    return (*calls > 1) ? 1 : 0;
+}
+
+static void
+test_lyd_eval_budget(void **state)
+{
+    struct ly_ctx *ctx = *state;
+    struct lyd_node *data;
+    volatile int cancel = 0;
+    int calls = 0, i;
+    char xml[4096];
+    const char *yang = "module t {namespace urn:t; prefix t;"
+        "list l {key k; leaf k {type uint32;} must \"count(/l[k > current()/k]) >= 0\";}}";
+
+    assert_ptr_not_equal(lys_parse_mem(ctx, yang, LYS_IN_YANG), NULL);
+    xml[0] = '\0';
+    for (i = 0; i < 60; ++i) {
+        sprintf(xml + strlen(xml), "<l xmlns=\"urn:t\"><k>%d</k></l>", i);
+    }
+    data = lyd_parse_mem(ctx, xml, LYD_XML, LYD_OPT_CONFIG | LYD_OPT_TRUSTED);
+    assert_ptr_not_equal(data, NULL);
+
+    /* step budget */
+    ly_eval_budget(100, 0, NULL, NULL, NULL);
+    assert_int_not_equal(lyd_validate(&data, LYD_OPT_CONFIG, NULL), 0);
+    assert_int_equal(ly_errno, LY_EINCOMPLETE);
+
+    /* exhausted until set again */
+    assert_ptr_equal(lyd_find_path(data, "/t:l[k='1']"), NULL);
+    assert_int_equal(ly_errno, LY_EINCOMPLETE);
+
+    /* enough steps */
+    ly_eval_budget(1000000, 0, NULL, NULL, NULL);
+    assert_int_equal(lyd_validate(&data, LYD_OPT_CONFIG, NULL), 0);
+
+    /* cancelled */
+    lyd_change_leaf((struct lyd_node_leaf_list *)data->child, "100");
+    cancel = 1;
+    ly_eval_budget(0, 0, &cancel, NULL, NULL);
+    assert_int_not_equal(lyd_validate(&data, LYD_OPT_CONFIG, NULL), 0);
+    assert_int_equal(ly_errno, LY_EINCOMPLETE);
+
+    /* interrupted by the yield callback */
+    ly_eval_budget(0, 0, NULL, test_lyd_eval_budget_yield, &calls);
+    assert_int_not_equal(lyd_validate(&data, LYD_OPT_CONFIG, NULL), 0);
+    assert_int_equal(ly_errno, LY_EINCOMPLETE);
+    assert_int_equal(calls, 2);
+
+    /* no budget */
+    ly_eval_budget(0, 0, NULL, NULL, NULL);
+    assert_int_equal(lyd_validate(&data, LYD_OPT_CONFIG, NULL), 0);
+
+    lyd_free_withsiblings(data);
+}
+
+static void
+test_lyd_validate_changed(void **state)
+{
+    struct ly_ctx *ctx = *state;
+    struct lyd_node *data = NULL, *node;
+    struct ly_set *set;
+    const char *yang = "module t {namespace urn:t; prefix t;"
+        "container a {leaf x {type int8;} leaf y {type int8; must \". > ../x\";}}"
+        "container b {leaf z {type int8; must \"/t:c/t:w\";}}"
+        "container c {leaf w {type string;}}"
+        "leaf d {type string; when \"/t:e = 'e'\";} leaf e {type string;}}";
+    const char *xml = "<a xmlns=\"urn:t\"><x>1</x><y>2</y></a>"
+        "<b xmlns=\"urn:t\"><z>1</z></b>"
+        "<c xmlns=\"urn:t\"><w>w</w></c>"
+        "<d xmlns=\"urn:t\">d</d><e xmlns=\"urn:t\">e</e>";
+
+    assert_ptr_not_equal(lys_parse_mem(ctx, yang, LYS_IN_YANG), NULL);
+    data = lyd_parse_mem(ctx, xml, LYD_XML, LYD_OPT_CONFIG);
+    assert_ptr_not_equal(data, NULL);
+    assert_int_equal(lyd_validate(&data, LYD_OPT_CONFIG | LYD_OPT_VAL_CHANGED, NULL), 0);
+
+    /* a must of an unchanged sibling references the changed node */
+    assert_int_equal(lyd_change_leaf((struct lyd_node_leaf_list *)data->child, "3"), 0);
+    assert_int_not_equal(lyd_validate(&data, LYD_OPT_CONFIG | LYD_OPT_VAL_CHANGED, NULL), 0);
+    assert_int_equal(ly_vecode(ctx), LYVE_NOMUST);
+    assert_int_equal(lyd_change_leaf((struct lyd_node_leaf_list *)data->child, "1"), 0);
+    assert_int_equal(lyd_validate(&data, LYD_OPT_CONFIG | LYD_OPT_VAL_CHANGED, NULL), 0);
+
+    /* a must in another subtree references the removed node */
+    node = data->next->next->child;
+    lyd_free(node);
+    assert_int_not_equal(lyd_validate(&data, LYD_OPT_CONFIG | LYD_OPT_VAL_CHANGED, NULL), 0);
+    assert_int_equal(ly_vecode(ctx), LYVE_NOMUST);
+    assert_ptr_not_equal(lyd_new_leaf(data->next->next, NULL, "w", "w"), NULL);
+    assert_int_equal(lyd_validate(&data, LYD_OPT_CONFIG | LYD_OPT_VAL_CHANGED, NULL), 0);
+
+    /* a top-level node referenced by a must is removed */
+    lyd_free(data->next->next);
+    assert_int_not_equal(lyd_validate(&data, LYD_OPT_CONFIG | LYD_OPT_VAL_CHANGED, NULL), 0);
+    assert_int_equal(ly_vecode(ctx), LYVE_NOMUST);
+    assert_ptr_not_equal(lyd_new_path(data, ctx, "/t:c/w", "w", 0, 0), NULL);
+    assert_int_equal(lyd_validate(&data, LYD_OPT_CONFIG | LYD_OPT_VAL_CHANGED, NULL), 0);
+
+    /* a when of an unchanged node references the changed node */
+    set = lyd_find_path(data, "/t:e");
+    assert_ptr_not_equal(set, NULL);
+    assert_int_equal(set->number, 1);
+    assert_int_equal(lyd_change_leaf((struct lyd_node_leaf_list *)set->set.d[0], "v"), 0);
+    ly_set_free(set);
+    assert_int_not_equal(lyd_validate(&data, LYD_OPT_CONFIG | LYD_OPT_VAL_CHANGED, NULL), 0);
+    assert_int_equal(ly_vecode(ctx), LYVE_NOWHEN);
+
+    lyd_free_withsiblings(data);
+}
+
+static void
+test_lyd_validate_leafref(void **state)
+{
+    struct ly_ctx *ctx = *state;
+    struct lyd_node *data = NULL;
+    struct ly_set *set;
+    const char *yang = "module t {namespace urn:t; prefix t;"
+        "list l {key k; leaf k {type string;}}"
+        "leaf-list r {type leafref {path \"/t:l/t:k\";}}}";
+    const char *xml = "<l xmlns=\"urn:t\"><k>a</k></l><l xmlns=\"urn:t\"><k>b</k></l><l xmlns=\"urn:t\"><k>c</k></l>"
+        "<r xmlns=\"urn:t\">c</r><r xmlns=\"urn:t\">a</r>";
+
+    assert_ptr_not_equal(lys_parse_mem(ctx, yang, LYS_IN_YANG), NULL);
+    data = lyd_parse_mem(ctx, xml, LYD_XML, LYD_OPT_CONFIG);
+    assert_ptr_not_equal(data, NULL);
+
+    /* the leafrefs are resolved to their targets */
+    set = lyd_find_path(data, "/t:r");
+    assert_ptr_not_equal(set, NULL);
+    assert_int_equal(set->number, 2);
+    assert_int_equal(((struct lyd_node_leaf_list *)set->set.d[0])->value_type, LY_TYPE_LEAFREF);
+    assert_ptr_equal(((struct lyd_node_leaf_list *)set->set.d[0])->value.leafref, data->next->next->child);
+    assert_ptr_equal(((struct lyd_node_leaf_list *)set->set.d[1])->value.leafref, data->child);
+    ly_set_free(set);
+
+    /* removing a target invalidates only the leafref referring to it */
+    lyd_free(data->next->next);
+    set = lyd_find_path(data, "/t:r");
+    assert_ptr_not_equal(set, NULL);
+    assert_int_equal(set->number, 2);
+    assert_int_not_equal(((struct lyd_node_leaf_list *)set->set.d[0])->value_type, LY_TYPE_LEAFREF);
+    assert_int_equal(((struct lyd_node_leaf_list *)set->set.d[1])->value_type, LY_TYPE_LEAFREF);
+    ly_set_free(set);
+    assert_int_not_equal(lyd_validate(&data, LYD_OPT_CONFIG, NULL), 0);
+    assert_int_equal(ly_vecode(ctx), LYVE_NOLEAFREF);
+
+    /* the target is back */
+    assert_ptr_not_equal(lyd_new_path(data, ctx, "/t:l[k='c']", NULL, 0, 0), NULL);
+    assert_int_equal(lyd_validate(&data, LYD_OPT_CONFIG, NULL), 0);
+
+    lyd_free_withsiblings(data);
+}
+
+static void
+test_lyd_parse_schema_children(void **state)
+{
+    struct ly_ctx *ctx = *state;
+    struct lyd_node *data = NULL;
+    const char *yang1 = "module t {namespace urn:t; prefix t;"
+        "container c {leaf a {type string;} leaf b {type string;} leaf x1 {type string;} leaf x2 {type string;}"
+        "choice ch {case c1 {leaf d {type string;}} leaf e {type string;}}}"
+        "rpc r {input {leaf v {type string;}} output {leaf v {type int8;}}}}";
+    const char *yang2 = "module t2 {namespace urn:t2; prefix t2; import t {prefix t;}"
+        "augment /t:c {leaf a {type int8;}}}";
+    const char *yang3 = "module t3 {namespace urn:t3; prefix t3; import t {prefix t;}"
+        "augment /t:c {leaf f {type string;}}}";
+    const char *xml = "<c xmlns=\"urn:t\"><a>str</a><e>e</e><a xmlns=\"urn:t2\">1</a><d>d</d></c>";
+    const char *json = "{\"t:c\":{\"a\":\"str\",\"e\":\"e\",\"t2:a\":1}}";
+
+    assert_ptr_not_equal(lys_parse_mem(ctx, yang1, LYS_IN_YANG), NULL);
+    assert_ptr_not_equal(lys_parse_mem(ctx, yang2, LYS_IN_YANG), NULL);
+
+    /* nodes in choices are found, here from different cases */
+    data = lyd_parse_mem(ctx, xml, LYD_XML, LYD_OPT_CONFIG | LYD_OPT_STRICT);
+    assert_ptr_equal(data, NULL);
+    assert_int_equal(ly_vecode(ctx), LYVE_MCASEDATA);
+
+    /* nodes with the same name from different modules */
+    data = lyd_parse_mem(ctx, "<c xmlns=\"urn:t\"><a>str</a><e>e</e><a xmlns=\"urn:t2\">1</a></c>", LYD_XML,
+                         LYD_OPT_CONFIG | LYD_OPT_STRICT);
+    assert_ptr_not_equal(data, NULL);
+    assert_string_equal(data->child->schema->name, "a");
+    assert_string_equal(lyd_node_module(data->child)->name, "t");
+    assert_string_equal(data->child->next->schema->name, "e");
+    assert_string_equal(lyd_node_module(data->child->next->next)->name, "t2");
+    lyd_free_withsiblings(data);
+
+    data = lyd_parse_mem(ctx, json, LYD_JSON, LYD_OPT_CONFIG | LYD_OPT_STRICT);
+    assert_ptr_not_equal(data, NULL);
+    assert_string_equal(lyd_node_module(data->child)->name, "t");
+    assert_string_equal(lyd_node_module(data->child->next->next)->name, "t2");
+    lyd_free_withsiblings(data);
+
+    /* RPC input and output children with the same name */
+    data = lyd_parse_mem(ctx, "<r xmlns=\"urn:t\"><v>str</v></r>", LYD_XML, LYD_OPT_RPC, NULL);
+    assert_ptr_not_equal(data, NULL);
+    assert_int_equal(data->child->schema->parent->nodetype, LYS_INPUT);
+    lyd_free_withsiblings(data);
+
+    /* a new augment is found after another module is loaded */
+    data = lyd_parse_mem(ctx, "<c xmlns=\"urn:t\"><f xmlns=\"urn:t3\">f</f></c>", LYD_XML,
+                         LYD_OPT_CONFIG | LYD_OPT_STRICT);
+    assert_ptr_equal(data, NULL);
+    assert_ptr_not_equal(lys_parse_mem(ctx, yang3, LYS_IN_YANG), NULL);
+    data = lyd_parse_mem(ctx, "<c xmlns=\"urn:t\"><f xmlns=\"urn:t3\">f</f></c>", LYD_XML,
+                         LYD_OPT_CONFIG | LYD_OPT_STRICT);
+    assert_ptr_not_equal(data, NULL);
+    assert_string_equal(data->child->schema->name, "f");
+    lyd_free_withsiblings(data);
+}
+
+static void
+test_lyd_unlink(void **state)
+{
+    (void) state; /* unused */
+    struct lyd_node *new = NULL;
+    struct lyd_node *node = root->child;
+    struct lyd_node_leaf_list *result;
+    int rc;
+
+    new = lyd_new_leaf(root, node->schema->module, "number32", "1");
+    if (!new) {
+        fail();
+    }
+
+    rc = lyd_insert(root, new);
+    if (rc) {
+        fail();
+    }
+
+    result = (struct lyd_node_leaf_list *) node->prev;
+    assert_string_equal("1", result->value_str);
+
+    rc = lyd_unlink(node->prev);
+    if (rc) {
+        fail();
+    }
+
+    assert_string_not_equal("1", ((struct lyd_node_leaf_list *)node->prev)->value_str);
+
+    lyd_free(new);
+}
+
+static void
+test_lyd_free(void **state)
+{
+    (void) state; /* unused */
+    struct lyd_node *copy = NULL;
+
+    copy = lyd_dup(root->child, 0);
+    if (!copy) {
+        fail();
+    }
+
+    lyd_free(copy);
+}
+
+static void
+test_lyd_free_withsiblings(void **state)
+{
+    (void) state; /* unused */
+    struct lyd_node *copy = NULL;
+    struct lyd_node *new = NULL;
+    struct lyd_node *node = root->child;
+    int rc;
+
+    copy = lyd_dup(root->child, 0);
+    if (!copy) {
+        fail();
+    }
+
+    new = lyd_new_leaf(root, node->schema->module, "number32", "1");
+    if (!new) {
+        fail();
+    }
+
+    rc = lyd_insert(copy, new);
+    if (!rc) {
+        fail();
+    }
+
+    lyd_free_withsiblings(copy);
+}
+
+static void
+test_lyd_insert_attr(void **state)
+{
+    (void) state; /* unused */
+    struct lyd_attr *attr = NULL;
+    struct lyd_node *node = root->child;
+
+    attr = lyd_insert_attr(node, NULL, "test", "test");
+    if (!attr) {
+        fail();
+    }
+
+    assert_string_equal("test", node->attr->name);
+}
+
+static void
+test_lyd_find_attr(void **state)
+{
+    (void) state; /* unused */
+    struct lys_ext_instance_complex *annot;
+    struct lyd_attr *attr;
+    struct lyd_node *node = root->child;
+
+    annot = lys_find_annotation(node->schema->module, "test");
+    assert_ptr_not_equal(annot, NULL);
+    assert_string_equal(annot->arg_value, "test");
+    assert_ptr_equal(lys_find_annotation(node->schema->module, "test"), annot);
+    assert_ptr_equal(lys_find_annotation(node->schema->module, "none"), NULL);
+
+    assert_ptr_equal(lyd_find_attr(node, annot), NULL);
+    attr = lyd_insert_attr(node, NULL, "test", "test");
+    assert_ptr_not_equal(attr, NULL);
+    assert_ptr_equal(attr->annotation, annot);
+    assert_ptr_equal(lyd_find_attr(node, annot), attr);
+    assert_ptr_equal(lyd_find_attr(root, annot), NULL);
+}
+
+static void
+test_lyd_free_attr(void **state)
+{
+    (void) state; /* unused */
+    struct lyd_attr *attr = NULL;
+    struct lyd_node *node = root->child;
+
+    attr = lyd_insert_attr(node, NULL, "test", "test");
+
+    if (!node->attr) {
+        fail();
+    }
+
+    lyd_free_attr(ctx, node, attr, 0);
+
+    if (node->attr) {
+        fail();
+    }
+
+}
+
+static void
+test_lyd_print_mem_xml(void **state)
+{
+    (void) state; /* unused */
+    char *result = NULL;
+    int rc;
+
+    rc = lyd_print_mem(&result, root, LYD_XML, 0);
+    if (rc) {
+        fail();
+    }
+
+    assert_string_equal(result_xml, result);
+    free(result);
+}
+
+static void
+test_lyd_print_mem_xml_format(void **state)
+{
+    (void) state; /* unused */
+    char *result = NULL;
+    int rc;
+
+    rc = lyd_print_mem(&result, root, LYD_XML, LYP_FORMAT);
+    if (rc) {
+        fail();
+    }
+
+    assert_string_equal(result_xml_format, result);
+    free(result);
+}
+
+static void
+test_lyd_print_mem_json(void **state)
+{
+    (void) state; /* unused */
+    char *result = NULL;
+    int rc;
+
+    rc = lyd_print_mem(&result, root, LYD_JSON, LYP_FORMAT);
+    if (rc) {
+        fail();
+    }
+
+    assert_string_equal(result_json, result);
+    free(result);
+}
+
+static void
+test_lyd_print_fd_xml(void **state)
+{
+    (void) state; /* unused */
+    char *result = NULL;
+    struct stat sb;
+    char file_name[20];
+    int rc;
+    int fd;
+
+    memset(file_name, 0, sizeof(file_name));
+    strncpy(file_name, TMP_TEMPLATE, sizeof(file_name));
+
+    fd = mkstemp(file_name);
+    if (fd < 1) {
+        goto error;
+    }
+
+    rc = lyd_print_fd(fd, root, LYD_XML, 0);
+    if (rc) {
+        goto error;
+    }
+
+    if (fstat(fd, &sb) == -1 || !S_ISREG(sb.st_mode)) {
+        goto error;
+    }
+
+    result = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    assert_string_equal(result_xml, result);
+
+    close(fd);
+    unlink(file_name);
+
+    return;
+error:
+    if (fd > 0) {
+        close(fd);
+        unlink(file_name);
+    }
+    fail();
+}
+
+static void
+test_lyd_print_fd_xml_format(void **state)
+{
+    (void) state; /* unused */
+    char *result = NULL;
+    struct stat sb;
+    char file_name[20];
+    int rc;
+    int fd;
+
+    memset(file_name, 0, sizeof(file_name));
+    strncpy(file_name, TMP_TEMPLATE, sizeof(file_name));
+
+    fd = mkstemp(file_name);
+    if (fd < 1) {
+        goto error;
+    }
+
+    rc = lyd_print_fd(fd, root, LYD_XML, LYP_FORMAT);
+    if (rc) {
+        goto error;
+    }
+
+    if (fstat(fd, &sb) == -1 || !S_ISREG(sb.st_mode)) {
+        goto error;
+    }
+
+    result = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    assert_string_equal(result_xml_format, result);
+
+    close(fd);
+    unlink(file_name);
+
+    return;
+error:
+    if (fd > 0) {
+        close(fd);
+        unlink(file_name);
+    }
+    fail();
+}
+
+static void
+test_lyd_print_fd_json(void **state)
+{
+    (void) state; /* unused */
+    char *result = NULL;
+    struct stat sb;
+    char file_name[20];
+    int rc;
+    int fd;
+
+    memset(file_name, 0, sizeof(file_name));
+    strncpy(file_name, TMP_TEMPLATE, sizeof(file_name));
+
+    fd = mkstemp(file_name);
+    if (fd < 1) {
+        goto error;
+    }
+
+    rc = lyd_print_fd(fd, root, LYD_JSON, LYP_FORMAT);
+    if (rc) {
+        goto error;
+    }
+
+    if (fstat(fd, &sb) == -1 || !S_ISREG(sb.st_mode)) {
+        goto error;
+    }
+
+    result = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    assert_string_equal(result_json, result);
+
+    close(fd);
+    unlink(file_name);
+
+    return;
+error:
+    if (fd > 0) {
+        close(fd);
+        unlink(file_name);
+    }
+    fail();
+}
+
+static void
+test_lyd_print_file_xml(void **state)
+{
+    (void) state; /* unused */
+    struct stat sb;
+    char file_name[20];
+    char *result;
+    FILE *f = NULL;
+    int rc;
+    int fd;
+
+    memset(file_name, 0, sizeof(file_name));
+    strncpy(file_name, TMP_TEMPLATE, sizeof(file_name));
+
+    fd = mkstemp(file_name);
+    if (fd < 1) {
+        goto error;
+    }
+    close(fd);
+
+    f = (fopen(file_name,"r+"));
+    if (f == NULL) {
+        goto error;
+    }
+
+    rc = lyd_print_file(f, root, LYD_XML, 0);
+    if (rc) {
+        goto error;
+    }
+
+    fclose(f);
+
+    fd = open(file_name, O_RDONLY);
+    if (fd == -1 || fstat(fd, &sb) == -1 || !S_ISREG(sb.st_mode)) {
+        goto error;
+    }
+
+    result = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    assert_string_equal(result_xml, result);
+
+    close(fd);
+    unlink(file_name);
+
+    return;
+error:
+    if (f)
+        fclose(f);
+    if (fd > 0) {
+        unlink(file_name);
+        close(fd);
+    }
+    fail();
+}
+
+static void
+test_lyd_print_file_xml_format(void **state)
+{
+    (void) state; /* unused */
     struct stat sb;
     char file_name[20];
+    char *result;
+    FILE *f = NULL;
     int rc;
     int fd;
 
@@ -1260,13 +3019,77 @@ test_lyd_print_fd_json(void **state)
     if (fd < 1) {
         goto error;
     }
+    close(fd);
+
+    f = (fopen(file_name,"r+"));
+    if (f == NULL) {
+        goto error;
+    }
+
+    rc = lyd_print_file(f, root, LYD_XML, LYP_FORMAT);
+    if (rc) {
+        goto error;
+    }
+
+    fclose(f);
+
+    fd = open(file_name, O_RDONLY);
+    if (fd == -1 || fstat(fd, &sb) == -1 || !S_ISREG(sb.st_mode)) {
+        goto error;
+    }
+
+    result = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    assert_string_equal(result_xml_format, result);
+
+    close(fd);
+    unlink(file_name);
+
+    return;
+error:
+    if (f)
+        fclose(f);
+    if (fd > 0) {
+        unlink(file_name);
+        close(fd);
+    }
+    fail();
+}
+
+static void
+test_lyd_print_file_json(void **state)
+{
+    (void) state; /* unused */
+    struct stat sb;
+    char file_name[20];
+    char *result;
+    FILE *f = NULL;
+    int rc;
+    int fd = -1;
+
+    memset(file_name, 0, sizeof(file_name));
+    strncpy(file_name, TMP_TEMPLATE, sizeof(file_name));
+
+    fd = mkstemp(file_name);
+    if (fd < 1) {
+        goto error;
+    }
+    close(fd);
+
+    f = (fopen(file_name,"r+"));
+    if (f == NULL) {
+        goto error;
+    }
 
-    rc = lyd_print_fd(fd, root, LYD_JSON, LYP_FORMAT);
+    rc = lyd_print_file(f, root, LYD_JSON, LYP_FORMAT);
     if (rc) {
         goto error;
     }
 
-    if (fstat(fd, &sb) == -1 || !S_ISREG(sb.st_mode)) {
+    fclose(f);
+
+    fd = open(file_name, O_RDONLY);
+    if (fd == -1 || fstat(fd, &sb) == -1 || !S_ISREG(sb.st_mode)) {
         goto error;
     }
 
@@ -1279,288 +3102,1541 @@ test_lyd_print_fd_json(void **state)
 
     return;
 error:
+    if (f)
+        fclose(f);
     if (fd > 0) {
-        close(fd);
         unlink(file_name);
+        close(fd);
     }
     fail();
 }
 
+struct buff {
+    int len;
+    const char *cmp;
+};
+
+ssize_t custom_lyd_print_clb(void *arg, const void *buf, size_t count) {
+    int rc;
+    int len;
+    struct buff *pos = arg;
+
+    len = pos->len + count;
+
+    const char *chunk = &pos->cmp[pos->len];
+
+    rc = strncmp(chunk, buf, count);
+    if (rc) {
+        fail();
+    }
+
+    pos->len = len;
+    return count;
+}
+
 static void
-test_lyd_print_file_xml(void **state)
+test_lyd_print_clb_xml(void **state)
 {
     (void) state; /* unused */
-    struct stat sb;
-    char file_name[20];
-    char *result;
-    FILE *f = NULL;
     int rc;
-    int fd;
 
-    memset(file_name, 0, sizeof(file_name));
-    strncpy(file_name, TMP_TEMPLATE, sizeof(file_name));
+    struct buff *buf = calloc(1, sizeof(struct buff));
+    if (!buf) {
+        fail();
+    }
 
-    fd = mkstemp(file_name);
-    if (fd < 1) {
-        goto error;
+    buf->len = 0;
+    buf->cmp = result_xml;
+    void *arg = buf;
+
+    rc = lyd_print_clb(custom_lyd_print_clb, arg, root, LYD_XML, 0);
+    if (rc) {
+        fail();
+        free(buf);
     }
-    close(fd);
 
-    f = (fopen(file_name,"r+"));
-    if (f == NULL) {
-        goto error;
+    free(buf);
+}
+
+static void
+test_lyd_print_clb_xml_format(void **state)
+{
+    (void) state; /* unused */
+    int rc;
+
+    struct buff *buf = calloc(1, sizeof(struct buff));
+    if (!buf) {
+        fail();
     }
 
-    rc = lyd_print_file(f, root, LYD_XML, 0);
+    buf->len = 0;
+    buf->cmp = result_xml_format;
+    void *arg = buf;
+
+    rc = lyd_print_clb(custom_lyd_print_clb, arg, root, LYD_XML, LYP_FORMAT);
     if (rc) {
-        goto error;
+        fail();
+        free(buf);
+    }
+
+    free(buf);
+}
+
+static void
+test_lyd_print_clb_json(void **state)
+{
+    (void) state; /* unused */
+    int rc;
+
+    struct buff *buf = calloc(1, sizeof(struct buff));
+    if (!buf) {
+        fail();
+    }
+
+    buf->len = 0;
+    buf->cmp = result_json;
+    void *arg = buf;
+
+    rc = lyd_print_clb(custom_lyd_print_clb, arg, root, LYD_JSON, LYP_FORMAT);
+    if (rc) {
+        fail();
+        free(buf);
+    }
+
+    free(buf);
+}
+
+struct iov_buff {
+    char buf[1024];
+    size_t len;
+    const char *value;
+    int refs;
+};
+
+static ssize_t
+custom_lyd_print_iov(void *arg, const struct iovec *iov, int iovcnt)
+{
+    struct iov_buff *b = arg;
+    size_t len;
+
+    /* write at most 100 bytes at once */
+    len = iov[0].iov_len < 100 ? iov[0].iov_len : 100;
+    assert_true(b->len + len < sizeof b->buf);
+    assert_true(iovcnt > 0);
+
+    if ((const char *)iov[0].iov_base >= b->value && (const char *)iov[0].iov_base < b->value + strlen(b->value)) {
+        ++b->refs;
+    }
+    memcpy(b->buf + b->len, iov[0].iov_base, len);
+    b->len += len;
+    return len;
+}
+
+static void
+test_lyd_print_iov(void **state)
+{
+    struct ly_ctx *ctx = *state;
+    struct lyd_node *data;
+    struct iov_buff b;
+    const char *yang = "module t {namespace urn:t; prefix t;"
+        "container a {leaf x {type string;} leaf-list y {type string;}}}";
+    const char *value = "A value long enough not to be copied into the output buffer by the printer, "
+        "<escaped> and still long enough after the escaped characters not to be copied either.";
+    const LYD_FORMAT formats[] = {LYD_XML, LYD_JSON};
+    char *str;
+    int i;
+
+    assert_ptr_not_equal(lys_parse_mem(ctx, yang, LYS_IN_YANG), NULL);
+    data = lyd_new_path(NULL, ctx, "/t:a/x", (void *)value, 0, 0);
+    assert_ptr_not_equal(data, NULL);
+    assert_ptr_not_equal(lyd_new_path(data, NULL, "/t:a/y", "short", 0, 0), NULL);
+
+    for (i = 0; i < 2; ++i) {
+        memset(&b, 0, sizeof b);
+        b.value = ((struct lyd_node_leaf_list *)data->child)->value_str;
+        assert_int_equal(lyd_print_iov(custom_lyd_print_iov, &b, data, formats[i], LYP_FORMAT), 0);
+        assert_int_equal(lyd_print_mem(&str, data, formats[i], LYP_FORMAT), 0);
+        assert_int_equal(b.len, strlen(str));
+        assert_memory_equal(b.buf, str, b.len);
+        assert_int_equal(b.refs, 2);
+        free(str);
     }
 
-    fclose(f);
+    lyd_free_withsiblings(data);
+}
+
+static void
+test_lyd_print_fd_nb(void **state)
+{
+    struct ly_ctx *ctx = *state;
+    struct lyd_node *data;
+    struct lyd_print_pending *pending;
+    const char *yang = "module t {namespace urn:t; prefix t;"
+        "container a {leaf-list y {type string;}}}";
+    char *str, *buf, value[16];
+    int fds[2], i, r;
+    size_t len = 0;
+    ssize_t rd;
+
+    assert_ptr_not_equal(lys_parse_mem(ctx, yang, LYS_IN_YANG), NULL);
+    data = NULL;
+    for (i = 0; i < 20000; ++i) {
+        sprintf(value, "value%d", i);
+        if (!data) {
+            data = lyd_new_path(NULL, ctx, "/t:a/y", value, 0, 0);
+            assert_ptr_not_equal(data, NULL);
+        } else {
+            assert_ptr_not_equal(lyd_new_path(data, NULL, "/t:a/y", value, 0, 0), NULL);
+        }
+    }
+    assert_int_equal(lyd_print_mem(&str, data, LYD_XML, LYP_FORMAT), 0);
+
+    /* the output does not fit into the socket buffer */
+    assert_int_equal(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    assert_int_equal(fcntl(fds[0], F_SETFL, O_NONBLOCK), 0);
+    assert_int_equal(lyd_print_fd_nb(fds[0], data, LYD_XML, LYP_FORMAT, &pending), 0);
+    assert_ptr_not_equal(pending, NULL);
+    assert_true(lyd_print_pending_len(pending) > 0);
+
+    buf = malloc(strlen(str) + 1);
+    assert_ptr_not_equal(buf, NULL);
+    while (len < strlen(str)) {
+        if (pending) {
+            r = lyd_print_pending_write(pending);
+            assert_int_not_equal(r, -1);
+            if (!r) {
+                assert_int_equal(lyd_print_pending_len(pending), 0);
+                lyd_print_pending_free(pending);
+                pending = NULL;
+            }
+        }
+        rd = read(fds[1], buf + len, strlen(str) - len);
+        assert_true(rd > 0);
+        len += rd;
+    }
+    assert_ptr_equal(pending, NULL);
+    assert_memory_equal(buf, str, len);
+    free(str);
+
+    /* all written at once */
+    assert_int_equal(lyd_print_mem(&str, data->child, LYD_XML, 0), 0);
+    assert_int_equal(lyd_print_fd_nb(fds[0], data->child, LYD_XML, 0, &pending), 0);
+    assert_ptr_equal(pending, NULL);
+    assert_int_equal(read(fds[1], buf, strlen(str)), strlen(str));
+    assert_memory_equal(buf, str, strlen(str));
+
+    close(fds[0]);
+    close(fds[1]);
+    free(buf);
+    free(str);
+    lyd_free_withsiblings(data);
+}
+
+static void
+test_lyd_print_page(void **state)
+{
+    struct ly_ctx *ctx = *state;
+    struct lyd_node *data, *parsed;
+    const struct lyd_node *next;
+    const char *yang = "module t {namespace urn:t; prefix t;"
+        "container c {list top {key n; leaf n {type string;}"
+        "list item {key i; leaf i {type uint8;} leaf v {type string;}}}}}";
+    const char *xml = "<c xmlns=\"urn:t\"><top><n>a</n>"
+        "<item><i>1</i><v>x</v></item><item><i>2</i></item><item><i>3</i></item></top></c>";
+    const LYD_FORMAT formats[] = {LYD_XML, LYD_JSON};
+    char *str;
+    int i;
+
+    assert_ptr_not_equal(lys_parse_mem(ctx, yang, LYS_IN_YANG), NULL);
+    data = lyd_parse_mem(ctx, xml, LYD_XML, LYD_OPT_CONFIG);
+    assert_ptr_not_equal(data, NULL);
+
+    /* first page */
+    assert_int_equal(lyd_print_page(&str, data->child->child->next, 2, LYD_XML, 0, &next), 0);
+    assert_string_equal(str, "<c xmlns=\"urn:t\"><top><n>a</n>"
+                        "<item xmlns=\"urn:t\"><i>1</i><v>x</v></item><item xmlns=\"urn:t\"><i>2</i></item></top></c>");
+    free(str);
+    assert_ptr_equal(next, data->child->child->next->next->next);
+
+    /* last page */
+    assert_int_equal(lyd_print_page(&str, next, 2, LYD_JSON, 0, &next), 0);
+    assert_string_equal(str, "{\"t:c\":{\"top\":[{\"n\":\"a\",\"item\":[{\"i\":3}]}]}}");
+    free(str);
+    assert_ptr_equal(next, NULL);
+
+    /* formatted pages can be parsed back */
+    for (i = 0; i < 2; ++i) {
+        assert_int_equal(lyd_print_page(&str, data->child->child->next, 2, formats[i], LYP_FORMAT, NULL), 0);
+        parsed = lyd_parse_mem(ctx, str, formats[i], LYD_OPT_CONFIG);
+        assert_ptr_not_equal(parsed, NULL);
+        assert_ptr_not_equal(parsed->child->child->next->next, NULL);
+        assert_ptr_equal(parsed->child->child->next->next->next, NULL);
+        lyd_free_withsiblings(parsed);
+        free(str);
+    }
+
+    lyd_free_withsiblings(data);
+}
+
+struct gen_buff {
+    char buf[1024];
+    size_t len;
+    int produced;
+    int count;
+};
+
+static ssize_t
+gen_write(void *arg, const void *buf, size_t count)
+{
+    struct gen_buff *b = arg;
+
+    assert_true(b->len + count < sizeof b->buf);
+    memcpy(b->buf + b->len, buf, count);
+    b->len += count;
+    b->buf[b->len] = '\0';
+    return count;
+}
+
+static int
+gen_item(struct lyd_node *instance, void *user_data)
+{
+    struct gen_buff *b = user_data;
+    char value[8];
+
+    if (b->produced == b->count) {
+        return 1;
+    }
+
+    ++b->produced;
+    sprintf(value, "%d", b->produced);
+    assert_ptr_not_equal(lyd_new_leaf(instance, NULL, "i", value), NULL);
+    if (b->produced == 1) {
+        assert_ptr_not_equal(lyd_new_leaf(instance, NULL, "v", "<x>"), NULL);
+    }
+    return 0;
+}
+
+static void
+test_lyd_print_gen(void **state)
+{
+    struct ly_ctx *ctx = *state;
+    struct lyd_node *data, *parsed;
+    const struct lys_module *mod;
+    struct gen_buff b;
+    const char *yang = "module t {namespace urn:t; prefix t;"
+        "container c {list top {key n; leaf n {type string;}"
+        "list item {key i; leaf i {type uint8;} leaf v {type string;}}}}}";
+    const char *xml = "<c xmlns=\"urn:t\"><top><n>a</n></top></c>";
+    const LYD_FORMAT formats[] = {LYD_XML, LYD_JSON};
+    int i;
+
+    mod = lys_parse_mem(ctx, yang, LYS_IN_YANG);
+    assert_ptr_not_equal(mod, NULL);
+    data = lyd_parse_mem(ctx, xml, LYD_XML, LYD_OPT_CONFIG);
+    assert_ptr_not_equal(data, NULL);
+
+    memset(&b, 0, sizeof b);
+    b.count = 3;
+    assert_int_equal(lyd_print_gen(gen_write, &b, data->child, mod->data->child->child->next, LYD_XML, 0, gen_item, &b), 0);
+    assert_string_equal(b.buf, "<c xmlns=\"urn:t\"><top><n>a</n>"
+                        "<item xmlns=\"urn:t\"><i>1</i><v>&lt;x&gt;</v></item><item xmlns=\"urn:t\"><i>2</i></item>"
+                        "<item xmlns=\"urn:t\"><i>3</i></item></top></c>");
+
+    memset(&b, 0, sizeof b);
+    b.count = 2;
+    assert_int_equal(lyd_print_gen(gen_write, &b, data->child, mod->data->child->child->next, LYD_JSON, 0, gen_item, &b), 0);
+    assert_string_equal(b.buf, "{\"t:c\":{\"top\":[{\"n\":\"a\",\"item\":[{\"i\":1,\"v\":\"<x>\"},{\"i\":2}]}]}}");
+
+    /* no instances */
+    memset(&b, 0, sizeof b);
+    assert_int_equal(lyd_print_gen(gen_write, &b, data->child, mod->data->child->child->next, LYD_JSON, 0, gen_item, &b), 0);
+    assert_string_equal(b.buf, "{\"t:c\":{\"top\":[{\"n\":\"a\"}]}}");
+
+    /* formatted output can be parsed back */
+    for (i = 0; i < 2; ++i) {
+        memset(&b, 0, sizeof b);
+        b.count = 3;
+        assert_int_equal(lyd_print_gen(gen_write, &b, data->child, mod->data->child->child->next, formats[i],
+                                       LYP_FORMAT, gen_item, &b), 0);
+        parsed = lyd_parse_mem(ctx, b.buf, formats[i], LYD_OPT_CONFIG);
+        assert_ptr_not_equal(parsed, NULL);
+        assert_ptr_not_equal(parsed->child->child->next->next->next, NULL);
+        lyd_free_withsiblings(parsed);
+    }
+
+    /* wrong parent */
+    memset(&b, 0, sizeof b);
+    assert_int_equal(lyd_print_gen(gen_write, &b, data, mod->data->child->child->next, LYD_XML, 0, gen_item, &b), 1);
+
+    lyd_free_withsiblings(data);
+}
+
+static void
+test_lyd_nacm(void **state)
+{
+    struct ly_ctx *ctx = *state;
+    struct lyd_node *data;
+    struct lyd_nacm *nacm;
+    struct ly_set *denied;
+    char *str;
+    const char *yang = "module n {namespace urn:n; prefix n; import ietf-netconf-acm {prefix nacm;}"
+        "container c {leaf pub {type string;} leaf wr {nacm:default-deny-write; type string;}"
+        "container secret {nacm:default-deny-all; leaf s {type string;}}"
+        "list l {key k; leaf k {type string;} leaf v {type string;}}}}";
+    const char *xml = "<c xmlns=\"urn:n\"><pub>p</pub><wr>w</wr><secret><s>x</s></secret>"
+        "<l><k>a</k><v>1</v></l><l><k>b</k><v>2</v></l></c>";
+    const struct lyd_nacm_rule rules[] = {
+        {"n", "/n:c/l[k='b']", LYD_NACM_READ, 1},
+        {"n", "/n:c/secret", LYD_NACM_READ | LYD_NACM_UPDATE, 0},
+        {"*", "/n:c/l/k", LYD_NACM_UPDATE, 1},
+    };
+    const struct lyd_nacm_rule deny_mod = {"n", NULL, LYD_NACM_ALL, 1};
+
+    ly_ctx_set_searchdir(ctx, TESTS_DIR"/schema/yang/ietf");
+    assert_ptr_not_equal(lys_parse_mem(ctx, yang, LYS_IN_YANG), NULL);
+
+    /* the default-deny flags are precomputed and inherited */
+    assert_true(ly_ctx_get_node(ctx, NULL, "/n:c/secret", 0)->flags & LYS_NACM_DENYA);
+    assert_true(ly_ctx_get_node(ctx, NULL, "/n:c/secret/s", 0)->flags & LYS_NACM_DENYA);
+    assert_true(ly_ctx_get_node(ctx, NULL, "/n:c/wr", 0)->flags & LYS_NACM_DENYW);
+    assert_false(ly_ctx_get_node(ctx, NULL, "/n:c/pub", 0)->flags & (LYS_NACM_DENYW | LYS_NACM_DENYA));
+
+    data = lyd_parse_mem(ctx, xml, LYD_XML, LYD_OPT_CONFIG);
+    assert_ptr_not_equal(data, NULL);
+
+    /* no rules, only the default-deny nodes are denied */
+    nacm = lyd_nacm_compile(ctx, NULL, 0, LYD_NACM_READ, 0);
+    assert_ptr_not_equal(nacm, NULL);
+    assert_int_equal(lyd_nacm_apply(nacm, &data, 0, &denied), 0);
+    assert_int_equal(denied->number, 1);
+    assert_string_equal(denied->set.d[0]->schema->name, "secret");
+    ly_set_free(denied);
+    lyd_nacm_free(nacm);
+
+    nacm = lyd_nacm_compile(ctx, NULL, 0, LYD_NACM_UPDATE, 0);
+    assert_ptr_not_equal(nacm, NULL);
+    assert_int_equal(lyd_nacm_apply(nacm, &data, 0, &denied), 0);
+    assert_int_equal(denied->number, 2);
+    assert_string_equal(denied->set.d[0]->schema->name, "wr");
+    assert_string_equal(denied->set.d[1]->schema->name, "secret");
+    ly_set_free(denied);
+    lyd_nacm_free(nacm);
+
+    /* the rules override the defaults, a list instance with a denied key is denied */
+    nacm = lyd_nacm_compile(ctx, rules, 3, LYD_NACM_UPDATE, 0);
+    assert_ptr_not_equal(nacm, NULL);
+    assert_int_equal(lyd_nacm_apply(nacm, &data, 0, &denied), 0);
+    assert_int_equal(denied->number, 3);
+    assert_string_equal(denied->set.d[0]->schema->name, "wr");
+    assert_string_equal(denied->set.d[1]->schema->name, "l");
+    assert_string_equal(denied->set.d[2]->schema->name, "l");
+    ly_set_free(denied);
+    lyd_nacm_free(nacm);
+
+    nacm = lyd_nacm_compile(ctx, rules, 3, LYD_NACM_READ, 0);
+    assert_ptr_not_equal(nacm, NULL);
+    assert_int_equal(lyd_nacm_apply(nacm, &data, LYD_NACM_PRUNE, NULL), 0);
+    lyd_nacm_free(nacm);
+    lyd_print_mem(&str, data, LYD_XML, LYP_WITHSIBLINGS);
+    assert_string_equal(str, "<c xmlns=\"urn:n\"><pub>p</pub><wr>w</wr><secret><s>x</s></secret>"
+                        "<l><k>a</k><v>1</v></l></c>");
+    free(str);
+
+    /* pruning the whole tree */
+    nacm = lyd_nacm_compile(ctx, &deny_mod, 1, LYD_NACM_READ, 0);
+    assert_ptr_not_equal(nacm, NULL);
+    assert_int_equal(lyd_nacm_apply(nacm, &data, LYD_NACM_PRUNE, NULL), 0);
+    assert_ptr_equal(data, NULL);
+    lyd_nacm_free(nacm);
+}
+
+static void
+test_lyd_filter(void **state)
+{
+    struct ly_ctx *ctx = *state;
+    struct lyd_node *data, *result;
+    struct lyd_filter *filter;
+    struct ly_set *set;
+    char *str;
+    const char *yang = "module f {namespace urn:f; prefix f;"
+        "container c {leaf a {type string;} leaf-list ll {type string;}"
+        "list l {key k; leaf k {type uint8;} leaf v {type string;} leaf w {type string;}}}}";
+    const char *xml = "<c xmlns=\"urn:f\"><a>x</a><ll>p</ll><ll>q</ll>"
+        "<l><k>1</k><v>1</v><w>1</w></l><l><k>2</k><v>2</v><w>2</w></l></c>";
+
+    assert_ptr_not_equal(lys_parse_mem(ctx, yang, LYS_IN_YANG), NULL);
+    data = lyd_parse_mem(ctx, xml, LYD_XML, LYD_OPT_CONFIG);
+    assert_ptr_not_equal(data, NULL);
+
+    /* selection node, also without a namespace */
+    filter = lyd_filter_compile(ctx, "<c><a/></c>");
+    assert_ptr_not_equal(filter, NULL);
+    assert_int_equal(lyd_filter_apply(filter, data, &result, NULL), 0);
+    lyd_filter_free(filter);
+    lyd_print_mem(&str, result, LYD_XML, LYP_WITHSIBLINGS);
+    assert_string_equal(str, "<c xmlns=\"urn:f\"><a>x</a></c>");
+    free(str);
+    lyd_free_withsiblings(result);
+
+    /* key content match in a non-canonical form with a selection node */
+    filter = lyd_filter_compile(ctx, "<c xmlns=\"urn:f\"><l><k>02</k><v/></l></c>");
+    assert_ptr_not_equal(filter, NULL);
+    assert_int_equal(lyd_filter_apply(filter, data, &result, NULL), 0);
+    lyd_filter_free(filter);
+    lyd_print_mem(&str, result, LYD_XML, LYP_WITHSIBLINGS);
+    assert_string_equal(str, "<c xmlns=\"urn:f\"><l><k>2</k><v>2</v></l></c>");
+    free(str);
+    lyd_free_withsiblings(result);
+
+    /* content match nodes only select the whole list instances */
+    filter = lyd_filter_compile(ctx, "<c xmlns=\"urn:f\"><l><k>1</k></l><l><w>2</w></l></c>");
+    assert_ptr_not_equal(filter, NULL);
+    assert_int_equal(lyd_filter_apply(filter, data, &result, NULL), 0);
+    lyd_print_mem(&str, result, LYD_XML, LYP_WITHSIBLINGS);
+    assert_string_equal(str, "<c xmlns=\"urn:f\"><l><k>1</k><v>1</v><w>1</w></l><l><k>2</k><v>2</v><w>2</w></l></c>");
+    free(str);
+    lyd_free_withsiblings(result);
+
+    /* the same in the original tree */
+    assert_int_equal(lyd_filter_apply(filter, data, NULL, &set), 0);
+    lyd_filter_free(filter);
+    assert_int_equal(set->number, 2);
+    assert_ptr_equal(set->set.d[0]->parent, data);
+    assert_string_equal(set->set.d[0]->schema->name, "l");
+    assert_string_equal(set->set.d[1]->schema->name, "l");
+    ly_set_free(set);
+
+    /* unknown node and not matching content match node */
+    filter = lyd_filter_compile(ctx, "<c xmlns=\"urn:f\"><unknown/></c><c xmlns=\"urn:f\"><a>y</a></c>");
+    assert_ptr_not_equal(filter, NULL);
+    assert_int_equal(lyd_filter_apply(filter, data, &result, NULL), 0);
+    lyd_filter_free(filter);
+    assert_ptr_equal(result, NULL);
+
+    /* empty filter */
+    filter = lyd_filter_compile(ctx, " ");
+    assert_ptr_not_equal(filter, NULL);
+    assert_int_equal(lyd_filter_apply(filter, data, NULL, &set), 0);
+    lyd_filter_free(filter);
+    assert_int_equal(set->number, 0);
+    ly_set_free(set);
+
+    lyd_free_withsiblings(data);
+}
+
+static void
+test_lyd_export_columns(void **state)
+{
+    struct ly_ctx *ctx = *state;
+    struct lyd_node *data;
+    struct lyd_columns *cols;
+    const struct lys_module *mod;
+    const char *yang = "module t {namespace urn:t; prefix t;"
+        "container c {list r {key n; leaf n {type string;} leaf m {type uint16;}"
+        "leaf d {type decimal64 {fraction-digits 2;}} leaf b {type boolean;} leaf e {type enumeration {enum one;}}}}}";
+    const char *xml = "<c xmlns=\"urn:t\">"
+        "<r><n>a</n><m>1</m><d>1.5</d><b>true</b></r>"
+        "<r><n>bc</n><b>false</b><e>one</e></r>"
+        "<r><n>d</n><m>65535</m><d>-2</d><b>true</b></r></c>";
+    const char *names[] = {"n", "t:m", "d", "b", "e"}, *wrong[] = {"c"};
+
+    mod = lys_parse_mem(ctx, yang, LYS_IN_YANG);
+    assert_ptr_not_equal(mod, NULL);
+    data = lyd_parse_mem(ctx, xml, LYD_XML, LYD_OPT_CONFIG);
+    assert_ptr_not_equal(data, NULL);
+
+    assert_int_equal(lyd_export_columns(data, mod->data->child, names, 5, &cols), 0);
+    assert_int_equal(cols->rows, 3);
+    assert_int_equal(cols->count, 5);
+
+    /* strings */
+    assert_int_equal(cols->columns[0].type, LY_TYPE_STRING);
+    assert_int_equal(cols->columns[0].null_count, 0);
+    assert_int_equal(cols->columns[0].offsets[0], 0);
+    assert_int_equal(cols->columns[0].offsets[1], 1);
+    assert_int_equal(cols->columns[0].offsets[2], 3);
+    assert_int_equal(cols->columns[0].offsets[3], 4);
+    assert_memory_equal(cols->columns[0].data, "abcd", 4);
+
+    /* integers with a missing value */
+    assert_int_equal(cols->columns[1].type, LY_TYPE_UINT16);
+    assert_int_equal(cols->columns[1].null_count, 1);
+    assert_int_equal(cols->columns[1].validity[0], 0x5);
+    assert_int_equal(((uint16_t *)cols->columns[1].values)[0], 1);
+    assert_int_equal(((uint16_t *)cols->columns[1].values)[2], 65535);
+
+    /* decimal64 */
+    assert_int_equal(cols->columns[2].type, LY_TYPE_DEC64);
+    assert_int_equal(cols->columns[2].fraction_digits, 2);
+    assert_int_equal(((int64_t *)cols->columns[2].values)[0], 150);
+    assert_int_equal(((int64_t *)cols->columns[2].values)[2], -200);
+
+    /* boolean bitmap */
+    assert_int_equal(cols->columns[3].type, LY_TYPE_BOOL);
+    assert_int_equal(cols->columns[3].validity[0], 0x7);
+    assert_int_equal(((uint8_t *)cols->columns[3].values)[0], 0x5);
+
+    /* enumeration as strings */
+    assert_int_equal(cols->columns[4].type, LY_TYPE_STRING);
+    assert_int_equal(cols->columns[4].null_count, 2);
+    assert_int_equal(cols->columns[4].validity[0], 0x2);
+    assert_int_equal(cols->columns[4].offsets[1], 0);
+    assert_int_equal(cols->columns[4].offsets[3], 3);
+    assert_memory_equal(cols->columns[4].data, "one", 3);
+    lyd_free_columns(cols);
+
+    /* not a leaf of the list */
+    assert_int_equal(lyd_export_columns(data, mod->data->child, wrong, 1, &cols), -1);
+    assert_ptr_equal(cols, NULL);
+
+    lyd_free_withsiblings(data);
+}
+
+static void
+test_lyd_print_config(void **state)
+{
+    struct ly_ctx *ctx = *state;
+    struct lyd_node *data, *dup;
+    const struct lys_module *mod;
+    const struct lys_node *c, *l, *cfg;
+    char *str;
+    const char *yang = "module t {namespace urn:t; prefix t;"
+        "container c {list l {key k; leaf k {type string;} container stats {config false; leaf in {type uint32;}}}"
+        "container cfg {leaf a {type string;} leaf b {type string;}} leaf s {config false; type string;}}}";
+    const char *dev = "module d {namespace urn:d; prefix d; import t {prefix t;}"
+        "deviation /t:c/t:cfg/t:b {deviate replace {config false;}}}";
+    const char *xml = "<c xmlns=\"urn:t\"><l><k>x</k><stats><in>1</in></stats></l><l><k>y</k></l>"
+        "<cfg><a>1</a></cfg><s>up</s></c>";
+    const char *result = "<c xmlns=\"urn:t\"><l><k>x</k></l><l><k>y</k></l><cfg><a>1</a></cfg></c>";
+
+    mod = lys_parse_mem(ctx, yang, LYS_IN_YANG);
+    assert_ptr_not_equal(mod, NULL);
+    c = mod->data;
+    l = c->child;
+    cfg = l->next;
+    assert_true(c->flags & LYS_INCL_STATUS);
+    assert_true(l->flags & LYS_INCL_STATUS);
+    assert_false(cfg->flags & LYS_INCL_STATUS);
+
+    /* the deviation is learned as well */
+    assert_ptr_not_equal(lys_parse_mem(ctx, dev, LYS_IN_YANG), NULL);
+    assert_true(cfg->flags & LYS_INCL_STATUS);
+
+    data = lyd_parse_mem(ctx, xml, LYD_XML, LYD_OPT_GET);
+    assert_ptr_not_equal(data, NULL);
+
+    lyd_print_mem(&str, data, LYD_XML, LYP_WITHSIBLINGS | LYP_CONFIG);
+    assert_string_equal(str, result);
+    free(str);
+    lyd_print_mem(&str, data, LYD_JSON, LYP_WITHSIBLINGS | LYP_CONFIG);
+    assert_string_equal(str, "{\"t:c\":{\"l\":[{\"k\":\"x\"},{\"k\":\"y\"}],\"cfg\":{\"a\":\"1\"}}}");
+    free(str);
+
+    /* the same configuration duplicated */
+    dup = lyd_dup_withsiblings(data, LYD_DUP_OPT_RECURSIVE | LYD_DUP_OPT_CONFIG);
+    assert_ptr_not_equal(dup, NULL);
+    lyd_print_mem(&str, dup, LYD_XML, LYP_WITHSIBLINGS);
+    assert_string_equal(str, result);
+    free(str);
+    lyd_free_withsiblings(dup);
+
+    dup = lyd_dup(data, LYD_DUP_OPT_RECURSIVE | LYD_DUP_OPT_CONFIG);
+    assert_ptr_not_equal(dup, NULL);
+    lyd_print_mem(&str, dup, LYD_XML, LYP_WITHSIBLINGS);
+    assert_string_equal(str, result);
+    free(str);
+    lyd_free_withsiblings(dup);
+
+    lyd_free_withsiblings(data);
+}
+
+static void
+test_lyd_sorted_insert(void **state)
+{
+    struct ly_ctx *sctx;
+    struct lyd_node *root, *list, *batch;
+    const struct lys_module *mod, *aug;
+    char *str;
+    const char *yang = "module s {namespace urn:s; prefix s;"
+        "container c {leaf a {type string;} leaf-list b {type uint8;}"
+        "list l {key k; leaf x {type string;} leaf k {type string;} leaf y {type string;}} leaf z {type string;}}}";
+    const char *yang_aug = "module sa {namespace urn:sa; prefix sa; import s {prefix s;}"
+        "augment /s:c {leaf w {type string;}}}";
+    const char *result = "<c xmlns=\"urn:s\"><a>1</a><b>2</b><b>1</b><b>3</b>"
+        "<l><k>first</k><x>x</x><y>y</y></l><l><k>second</k></l><z>z</z><w xmlns=\"urn:sa\">w</w></c>";
+
+    (void)state;
+
+    sctx = ly_ctx_new(NULL, LY_CTX_SORTED_INSERT);
+    assert_ptr_not_equal(sctx, NULL);
+    mod = lys_parse_mem(sctx, yang, LYS_IN_YANG);
+    assert_ptr_not_equal(mod, NULL);
+    aug = lys_parse_mem(sctx, yang_aug, LYS_IN_YANG);
+    assert_ptr_not_equal(aug, NULL);
+
+    /* created in the reverse schema order */
+    root = lyd_new(NULL, mod, "c");
+    assert_ptr_not_equal(root, NULL);
+    assert_ptr_not_equal(lyd_new_leaf(root, aug, "w", "w"), NULL);
+    assert_ptr_not_equal(lyd_new_leaf(root, mod, "z", "z"), NULL);
+    list = lyd_new(root, mod, "l");
+    assert_ptr_not_equal(list, NULL);
+    assert_ptr_not_equal(lyd_new_leaf(list, mod, "y", "y"), NULL);
+    assert_ptr_not_equal(lyd_new_leaf(list, mod, "k", "first"), NULL);
+    assert_ptr_not_equal(lyd_new_leaf(list, mod, "x", "x"), NULL);
+    list = lyd_new(root, mod, "l");
+    assert_ptr_not_equal(list, NULL);
+    assert_ptr_not_equal(lyd_new_leaf(list, mod, "k", "second"), NULL);
+    assert_ptr_not_equal(lyd_new_leaf(root, mod, "b", "2"), NULL);
+    assert_ptr_not_equal(lyd_new_leaf(root, mod, "b", "1"), NULL);
+
+    /* a batch of instances as well */
+    batch = lyd_new_leaf(root, mod, "b", "3");
+    assert_ptr_not_equal(batch, NULL);
+    lyd_unlink(batch);
+    assert_int_equal(lyd_insert_batch(root, batch), 0);
+    assert_ptr_not_equal(lyd_new_leaf(root, mod, "a", "1"), NULL);
+
+    lyd_print_mem(&str, root, LYD_XML, 0);
+    assert_string_equal(str, result);
+    free(str);
+
+    /* nothing for the sort to change */
+    assert_int_equal(lyd_schema_sort(root, 1), 0);
+    lyd_print_mem(&str, root, LYD_XML, 0);
+    assert_string_equal(str, result);
+    free(str);
+
+    lyd_free(root);
+    ly_ctx_destroy(sctx, NULL);
+}
+
+static void
+test_lyd_subtree_filters(void **state)
+{
+    struct ly_ctx *fctx;
+    struct lyd_node *data, *result;
+    struct lyd_filter *filter;
+    struct ly_set *set;
+    const struct lys_module *mod;
+    char *str;
+    const char *yang = "module f {namespace urn:f; prefix f;"
+        "container c {list l {key k; leaf k {type string;} container deep {leaf target {type string;} leaf other {type string;}}}}}";
+    const char *xml = "<c xmlns=\"urn:f\"><l><k>a</k><deep><other>1</other></deep></l>"
+        "<l><k>b</k><deep><target>2</target></deep></l><l><k>c</k></l></c>";
+
+    (void)state;
+
+    fctx = ly_ctx_new(NULL, LY_CTX_SUBTREE_FILTERS);
+    assert_ptr_not_equal(fctx, NULL);
+    mod = lys_parse_mem(fctx, yang, LYS_IN_YANG);
+    assert_ptr_not_equal(mod, NULL);
+    data = lyd_parse_mem(fctx, xml, LYD_XML, LYD_OPT_CONFIG);
+    assert_ptr_not_equal(data, NULL);
 
-    fd = open(file_name, O_RDONLY);
-    if (fd == -1 || fstat(fd, &sb) == -1 || !S_ISREG(sb.st_mode)) {
-        goto error;
-    }
+    /* filters built by the search */
+    set = lyd_find_instance(data, mod->data->child->child->next->child);
+    assert_ptr_not_equal(set, NULL);
+    assert_int_equal(set->number, 1);
+    ly_set_free(set);
+    set = lyd_find_path(data, "//f:target");
+    assert_ptr_not_equal(set, NULL);
+    assert_int_equal(set->number, 1);
+    ly_set_free(set);
 
-    result = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    /* updated by an insert */
+    assert_ptr_not_equal(lyd_new_leaf(data->child->child->next, mod, "target", "1"), NULL);
+    set = lyd_find_path(data, "//f:target");
+    assert_ptr_not_equal(set, NULL);
+    assert_int_equal(set->number, 2);
+    ly_set_free(set);
 
-    assert_string_equal(result_xml, result);
+    /* and a removal */
+    set = lyd_find_path(data, "/f:c/l[k='b']/deep");
+    assert_ptr_not_equal(set, NULL);
+    assert_int_equal(set->number, 1);
+    lyd_free(set->set.d[0]);
+    ly_set_free(set);
+    set = lyd_find_instance(data, mod->data->child->child->next->child);
+    assert_ptr_not_equal(set, NULL);
+    assert_int_equal(set->number, 1);
+    ly_set_free(set);
 
-    close(fd);
-    unlink(file_name);
+    /* a new instance in a new subtree */
+    assert_ptr_not_equal(lyd_new_path(data, NULL, "/f:c/l[k='c']/deep/target", "3", 0, 0), NULL);
 
-    return;
-error:
-    if (f)
-        fclose(f);
-    if (fd > 0) {
-        unlink(file_name);
-        close(fd);
-    }
-    fail();
+    filter = lyd_filter_compile(fctx, "<c xmlns=\"urn:f\"><l><deep><target/></deep></l></c>");
+    assert_ptr_not_equal(filter, NULL);
+    assert_int_equal(lyd_filter_apply(filter, data, &result, NULL), 0);
+    lyd_print_mem(&str, result, LYD_XML, LYP_WITHSIBLINGS);
+    assert_string_equal(str, "<c xmlns=\"urn:f\"><l><k>a</k><deep><target>1</target></deep></l>"
+                        "<l><k>c</k><deep><target>3</target></deep></l></c>");
+    free(str);
+    lyd_free_withsiblings(result);
+    lyd_filter_free(filter);
+
+    lyd_free_withsiblings(data);
+    ly_ctx_destroy(fctx, NULL);
 }
 
-static void
-test_lyd_print_file_xml_format(void **state)
+static char *
+store_xml(struct lyd_node *root)
 {
-    (void) state; /* unused */
-    struct stat sb;
-    char file_name[20];
-    char *result;
-    FILE *f = NULL;
-    int rc;
-    int fd;
+    char *str = NULL;
 
-    memset(file_name, 0, sizeof(file_name));
-    strncpy(file_name, TMP_TEMPLATE, sizeof(file_name));
+    lyd_print_mem(&str, root, LYD_XML, LYP_WITHSIBLINGS);
+    return str;
+}
 
-    fd = mkstemp(file_name);
-    if (fd < 1) {
-        goto error;
+static void
+test_lyd_store(void **state)
+{
+    struct ly_ctx *ctx = *state;
+    struct lyd_store *store;
+    struct lyd_node *data = NULL, *prev, *recovered;
+    struct lyd_difflist *diff;
+    struct stat st;
+    char dir[] = "/tmp/libyang-store-XXXXXX", file[64], log[64], tmp[64], path[32], value[8], *str1, *str2;
+    off_t log_size;
+    int fd, i;
+    const char *yang = "module j {namespace urn:j; prefix j;"
+        "container c {list l {key k; leaf k {type uint8;} leaf v {type string;}}}}";
+
+    assert_ptr_not_equal(lys_parse_mem(ctx, yang, LYS_IN_YANG), NULL);
+    assert_ptr_not_equal(mkdtemp(dir), NULL);
+    sprintf(file, "%s/running.lyb", dir);
+    sprintf(log, "%s/running.lyb.log", dir);
+
+    /* nothing stored yet, compacted only explicitly */
+    store = lyd_store_open(ctx, file, LYD_OPT_CONFIG, SIZE_MAX, &recovered);
+    assert_ptr_not_equal(store, NULL);
+    assert_ptr_equal(recovered, NULL);
+
+    for (i = 0; i < 10; ++i) {
+        prev = data ? lyd_dup_withsiblings(data, LYD_DUP_OPT_RECURSIVE) : NULL;
+        sprintf(path, "/j:c/l[k='%d']/v", i % 4);
+        sprintf(value, "%d", i);
+        if (data) {
+            assert_ptr_not_equal(lyd_new_path(data, NULL, path, value, 0, LYD_PATH_OPT_UPDATE), NULL);
+        } else {
+            data = lyd_new_path(NULL, ctx, path, value, 0, 0);
+            assert_ptr_not_equal(data, NULL);
+        }
+        diff = lyd_diff(prev, data, 0);
+        assert_ptr_not_equal(diff, NULL);
+        assert_int_equal(lyd_store_commit(store, diff, data), 0);
+        lyd_free_diff(diff);
+        lyd_free_withsiblings(prev);
     }
+    lyd_store_close(store);
+    str1 = store_xml(data);
+
+    /* only the log was written */
+    assert_int_equal(stat(file, &st), -1);
+    store = lyd_store_open(ctx, file, LYD_OPT_CONFIG, SIZE_MAX, &recovered);
+    assert_ptr_not_equal(store, NULL);
+    str2 = store_xml(recovered);
+    assert_string_equal(str1, str2);
+    free(str2);
+    lyd_free_withsiblings(recovered);
+    lyd_store_close(store);
+
+    /* a torn record at the end is cut off */
+    assert_int_equal(stat(log, &st), 0);
+    log_size = st.st_size;
+    fd = open(log, O_WRONLY | O_APPEND);
+    assert_int_not_equal(fd, -1);
+    assert_int_equal(write(fd, "\x40\0\0\0garbage", 11), 11);
     close(fd);
+    store = lyd_store_open(ctx, file, LYD_OPT_CONFIG, SIZE_MAX, &recovered);
+    assert_ptr_not_equal(store, NULL);
+    str2 = store_xml(recovered);
+    assert_string_equal(str1, str2);
+    free(str2);
+    assert_int_equal(stat(log, &st), 0);
+    assert_int_equal(st.st_size, log_size);
+
+    /* compaction moves everything into the snapshot */
+    assert_int_equal(lyd_store_compact(store, recovered), 0);
+    lyd_free_withsiblings(recovered);
+    lyd_store_close(store);
+    assert_int_equal(stat(log, &st), 0);
+    assert_int_equal(st.st_size, 8);
+    store = lyd_store_open(ctx, file, LYD_OPT_CONFIG, SIZE_MAX, &recovered);
+    assert_ptr_not_equal(store, NULL);
+    str2 = store_xml(recovered);
+    assert_string_equal(str1, str2);
+    free(str2);
+    free(str1);
+
+    /* the whole tree deleted */
+    diff = lyd_diff(recovered, NULL, 0);
+    assert_ptr_not_equal(diff, NULL);
+    assert_int_equal(lyd_store_commit(store, diff, NULL), 0);
+    lyd_free_diff(diff);
+    lyd_free_withsiblings(recovered);
+    lyd_store_close(store);
+    store = lyd_store_open(ctx, file, LYD_OPT_CONFIG, SIZE_MAX, &recovered);
+    assert_ptr_not_equal(store, NULL);
+    str2 = store_xml(recovered);
+    assert_ptr_equal(str2, NULL);
+    lyd_free_withsiblings(recovered);
+    lyd_store_close(store);
+
+    /* a failed compaction does not undo the commit */
+    store = lyd_store_open(ctx, file, LYD_OPT_CONFIG, 1, &recovered);
+    assert_ptr_not_equal(store, NULL);
+    lyd_free_withsiblings(recovered);
+    sprintf(tmp, "%s.tmp", file);
+    assert_int_equal(mkdir(tmp, 0700), 0);
+    diff = lyd_diff(NULL, data, 0);
+    assert_ptr_not_equal(diff, NULL);
+    assert_int_equal(lyd_store_commit(store, diff, data), 1);
+    lyd_free_diff(diff);
+    lyd_store_close(store);
+    rmdir(tmp);
+    str1 = store_xml(data);
+    store = lyd_store_open(ctx, file, LYD_OPT_CONFIG, SIZE_MAX, &recovered);
+    assert_ptr_not_equal(store, NULL);
+    str2 = store_xml(recovered);
+    assert_string_equal(str1, str2);
+    free(str2);
+    free(str1);
+    lyd_free_withsiblings(recovered);
+    lyd_store_close(store);
 
-    f = (fopen(file_name,"r+"));
-    if (f == NULL) {
-        goto error;
-    }
-
-    rc = lyd_print_file(f, root, LYD_XML, LYP_FORMAT);
-    if (rc) {
-        goto error;
-    }
-
-    fclose(f);
+    lyd_free_withsiblings(data);
+    unlink(file);
+    unlink(log);
+    rmdir(dir);
+}
 
-    fd = open(file_name, O_RDONLY);
-    if (fd == -1 || fstat(fd, &sb) == -1 || !S_ISREG(sb.st_mode)) {
-        goto error;
+static void
+test_lyd_lyb_stream(void **state)
+{
+    struct ly_ctx *ctx = *state;
+    struct lyd_lyb_stream *writer, *reader;
+    struct lyd_node *data, *parsed;
+    char *header, *frame, *full, *str1, *str2, path[32];
+    uint32_t len;
+    int i;
+    const char *yang = "module s {namespace urn:s; prefix s;"
+        "container c {list l {key k; leaf k {type uint8;} leaf v {type string;}}}"
+        "leaf t {type string;}}";
+
+    assert_ptr_not_equal(lys_parse_mem(ctx, yang, LYS_IN_YANG), NULL);
+    writer = lyd_lyb_stream_new(ctx, LYP_STRTABLE);
+    reader = lyd_lyb_stream_new(ctx, 0);
+    assert_ptr_not_equal(writer, NULL);
+    assert_ptr_not_equal(reader, NULL);
+
+    /* frames cannot precede the header */
+    data = lyd_new_path(NULL, ctx, "/s:t", "value", 0, 0);
+    assert_ptr_not_equal(data, NULL);
+    assert_int_equal(lyd_lyb_stream_print(&frame, writer, data, 0), 1);
+
+    assert_int_equal(lyd_lyb_stream_print_header(&header, writer), 0);
+    assert_int_equal(lyd_lyb_stream_print_header(&str1, writer), 1);
+    assert_ptr_equal(lyd_parse_mem(ctx, header, LYD_LYB, LYD_OPT_CONFIG), NULL);
+    assert_int_equal(lyd_lyb_stream_parse_header(reader, header), lyd_lyb_data_length(header));
+    free(header);
+
+    for (i = 0; i < 3; ++i) {
+        sprintf(path, "/s:c/l[k='%d']/v", i);
+        assert_ptr_not_equal(lyd_new_path(data, NULL, path, "same value", 0, 0), NULL);
+
+        assert_int_equal(lyd_lyb_stream_print(&frame, writer, data, LYP_WITHSIBLINGS), 0);
+        len = (uint8_t)frame[0] | ((uint8_t)frame[1] << 8) | ((uint8_t)frame[2] << 16) | ((uint32_t)(uint8_t)frame[3] << 24);
+
+        /* the frame does not include the models */
+        assert_int_equal(lyd_print_mem(&full, data, LYD_LYB, LYP_WITHSIBLINGS | LYP_STRTABLE), 0);
+        assert_true(len + 4 < (unsigned)lyd_lyb_data_length(full));
+        free(full);
+
+        parsed = lyd_lyb_stream_parse(reader, frame, LYD_OPT_CONFIG);
+        assert_ptr_not_equal(parsed, NULL);
+        free(frame);
+        lyd_print_mem(&str1, data, LYD_XML, LYP_WITHSIBLINGS);
+        lyd_print_mem(&str2, parsed, LYD_XML, LYP_WITHSIBLINGS);
+        assert_string_equal(str1, str2);
+        free(str1);
+        free(str2);
+        lyd_free_withsiblings(parsed);
     }
 
-    result = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    /* the models are found again after the module set changes */
+    assert_ptr_not_equal(lys_parse_mem(ctx, "module s2 {namespace urn:s2; prefix s2; leaf x {type string;}}", LYS_IN_YANG), NULL);
+    assert_int_equal(lyd_lyb_stream_print(&frame, writer, data, 0), 0);
+    parsed = lyd_lyb_stream_parse(reader, frame, LYD_OPT_CONFIG);
+    free(frame);
+    assert_ptr_not_equal(parsed, NULL);
+    assert_string_equal(parsed->schema->name, "t");
+    assert_ptr_equal(parsed->next, NULL);
+    lyd_free_withsiblings(parsed);
+
+    /* but the new modules are not in the header */
+    lyd_free_withsiblings(data);
+    data = lyd_new_path(NULL, ctx, "/s2:x", "value", 0, 0);
+    assert_ptr_not_equal(data, NULL);
+    assert_int_equal(lyd_lyb_stream_print(&frame, writer, data, 0), 1);
+    free(frame);
+    lyd_free_withsiblings(data);
 
-    assert_string_equal(result_xml_format, result);
+    /* an empty frame */
+    assert_int_equal(lyd_lyb_stream_print(&frame, writer, NULL, 0), 0);
+    assert_ptr_equal(lyd_lyb_stream_parse(reader, frame, LYD_OPT_CONFIG), NULL);
+    assert_int_equal(ly_errno, LY_SUCCESS);
+    free(frame);
 
-    close(fd);
-    unlink(file_name);
+    lyd_lyb_stream_free(writer);
+    lyd_lyb_stream_free(reader);
+}
 
-    return;
-error:
-    if (f)
-        fclose(f);
-    if (fd > 0) {
-        unlink(file_name);
-        close(fd);
+static void
+test_lyd_lyb_patch(void **state)
+{
+    struct ly_ctx *ctx = *state;
+    struct lyd_node *first, *second, *patched;
+    struct lyd_difflist *diff;
+    struct ly_set *set;
+    char *patch, *full, *str1, *str2, path[32];
+    int i;
+    const char *yang = "module p {namespace urn:p; prefix p;"
+        "container c {leaf a {type string;} anydata any;"
+        "list l {key k; ordered-by user; leaf k {type uint8;} leaf v {type string;}"
+        "container in {leaf-list ll {type string; ordered-by user;}}}}}";
+    const char *xml1 = "<c xmlns=\"urn:p\"><a>x</a><l><k>1</k><v>1</v></l><l><k>2</k><v>2</v>"
+        "<in><ll>p</ll><ll>q</ll></in></l><l><k>3</k><v>3</v></l></c>";
+
+    assert_ptr_not_equal(lys_parse_mem(ctx, yang, LYS_IN_YANG), NULL);
+    first = lyd_parse_mem(ctx, xml1, LYD_XML, LYD_OPT_CONFIG);
+    assert_ptr_not_equal(first, NULL);
+    for (i = 10; i < 50; ++i) {
+        sprintf(path, "/p:c/l[k='%d']/v", i);
+        assert_ptr_not_equal(lyd_new_path(first, NULL, path, "unchanged value", 0, 0), NULL);
     }
-    fail();
+
+    /* changed, deleted, created and moved nodes */
+    second = lyd_dup(first, LYD_DUP_OPT_RECURSIVE);
+    assert_ptr_not_equal(second, NULL);
+    assert_ptr_not_equal(lyd_new_path(second, NULL, "/p:c/a", "y", 0, LYD_PATH_OPT_UPDATE), NULL);
+    assert_ptr_not_equal(lyd_new_path(second, NULL, "/p:c/l[k='2']/in/ll", "r", 0, 0), NULL);
+    assert_ptr_not_equal(lyd_new_path(second, NULL, "/p:c/l[k='4']/v", "4", 0, 0), NULL);
+    set = lyd_find_path(second, "/p:c/l[k='1']");
+    assert_int_equal(set->number, 1);
+    lyd_free(set->set.d[0]);
+    ly_set_free(set);
+    assert_int_equal(lyd_insert_before(second->child->next, second->child->prev), 0);
+    assert_int_equal(lyd_validate(&second, LYD_OPT_CONFIG, NULL), 0);
+
+    diff = lyd_diff(first, second, 0);
+    assert_ptr_not_equal(diff, NULL);
+    assert_int_equal(lyd_print_lyb_patch(&patch, diff, LYP_STRTABLE), 0);
+    lyd_free_diff(diff);
+
+    /* the patch is smaller than the whole tree */
+    assert_int_equal(lyd_print_mem(&full, second, LYD_LYB, LYP_WITHSIBLINGS), 0);
+    assert_true(lyd_lyb_data_length(patch) > 0);
+    assert_true(lyd_lyb_data_length(patch) < lyd_lyb_data_length(full));
+    free(full);
+
+    /* the patch is not a data tree */
+    assert_ptr_equal(lyd_parse_mem(ctx, patch, LYD_LYB, LYD_OPT_CONFIG), NULL);
+
+    patched = lyd_dup(first, LYD_DUP_OPT_RECURSIVE);
+    assert_int_equal(lyd_apply_lyb_patch(ctx, &patched, patch), 0);
+    assert_int_equal(lyd_validate(&patched, LYD_OPT_CONFIG, NULL), 0);
+    lyd_print_mem(&str1, second, LYD_XML, LYP_WITHSIBLINGS);
+    lyd_print_mem(&str2, patched, LYD_XML, LYP_WITHSIBLINGS);
+    assert_string_equal(str1, str2);
+    free(str1);
+    free(str2);
+
+    /* applying it twice fails, the deleted instance is missing */
+    assert_int_equal(lyd_apply_lyb_patch(ctx, &patched, patch), -1);
+    lyd_free_withsiblings(patched);
+    free(patch);
+
+    /* deleting the whole tree */
+    diff = lyd_diff(first, NULL, 0);
+    assert_ptr_not_equal(diff, NULL);
+    assert_int_equal(lyd_print_lyb_patch(&patch, diff, 0), 0);
+    lyd_free_diff(diff);
+    assert_int_equal(lyd_apply_lyb_patch(ctx, &first, patch), 0);
+    assert_ptr_equal(first, NULL);
+    free(patch);
+
+    /* and creating it in an empty tree */
+    diff = lyd_diff(NULL, second, 0);
+    assert_ptr_not_equal(diff, NULL);
+    assert_int_equal(lyd_print_lyb_patch(&patch, diff, 0), 0);
+    lyd_free_diff(diff);
+    assert_int_equal(lyd_apply_lyb_patch(ctx, &first, patch), 0);
+    free(patch);
+    lyd_print_mem(&str1, second, LYD_XML, LYP_WITHSIBLINGS);
+    lyd_print_mem(&str2, first, LYD_XML, LYP_WITHSIBLINGS);
+    assert_string_equal(str1, str2);
+    free(str1);
+    free(str2);
+
+    lyd_free_withsiblings(first);
+    lyd_free_withsiblings(second);
 }
 
 static void
-test_lyd_print_file_json(void **state)
+test_lyd_bit_is_set(void **state)
 {
-    (void) state; /* unused */
-    struct stat sb;
-    char file_name[20];
-    char *result;
-    FILE *f = NULL;
-    int rc;
-    int fd = -1;
+    struct ly_ctx *ctx = *state;
+    struct lyd_node *data;
+    struct lyd_node_leaf_list *a1, *a2, *b;
+    struct ly_set *set;
+    const char *yang = "module q {namespace urn:q; prefix q;"
+        "typedef flags {type bits {bit up; bit running; bit lower-down;}}"
+        "container c {list l {key k; leaf k {type uint8;} leaf a {type flags;}}"
+        "leaf b {type flags;} leaf s {type string;}}}";
+    const char *xml = "<c xmlns=\"urn:q\"><l><k>1</k><a>up lower-down</a></l><l><k>2</k><a>up  lower-down</a></l>"
+        "<b>running</b><s>up</s></c>";
+
+    assert_ptr_not_equal(lys_parse_mem(ctx, yang, LYS_IN_YANG), NULL);
+    data = lyd_parse_mem(ctx, xml, LYD_XML, LYD_OPT_CONFIG);
+    assert_ptr_not_equal(data, NULL);
 
-    memset(file_name, 0, sizeof(file_name));
-    strncpy(file_name, TMP_TEMPLATE, sizeof(file_name));
+    a1 = (struct lyd_node_leaf_list *)data->child->child->next;
+    a2 = (struct lyd_node_leaf_list *)data->child->next->child->next;
+    b = (struct lyd_node_leaf_list *)data->child->next->next;
+    assert_int_equal(lyd_bit_is_set((struct lyd_node *)a1, "up"), 1);
+    assert_int_equal(lyd_bit_is_set((struct lyd_node *)a1, "running"), 0);
+    assert_int_equal(lyd_bit_is_set((struct lyd_node *)a1, "lower-down"), 1);
+    assert_int_equal(lyd_bit_is_set((struct lyd_node *)b, "running"), 1);
+    assert_int_equal(lyd_bit_is_set((struct lyd_node *)b, "none"), 0);
+    assert_int_equal(lyd_bit_is_set(b->next, "up"), 0);
+    assert_int_equal(lyd_bit_is_set(data, "up"), -1);
+
+    /* the same values share their bits */
+    assert_ptr_equal(a1->value.bit, a2->value.bit);
+    assert_ptr_not_equal(a1->value.bit, b->value.bit);
+
+    /* bits of a typedef */
+    set = lyd_find_path(data, "/q:c/l[bit-is-set(a, 'lower-down')]");
+    assert_ptr_not_equal(set, NULL);
+    assert_int_equal(set->number, 2);
+    ly_set_free(set);
+    set = lyd_find_path(data, "/q:c/l[bit-is-set(a, 'running')]");
+    assert_ptr_not_equal(set, NULL);
+    assert_int_equal(set->number, 0);
+    ly_set_free(set);
 
-    fd = mkstemp(file_name);
-    if (fd < 1) {
-        goto error;
-    }
-    close(fd);
+    /* changing one value does not change the other */
+    assert_int_equal(lyd_change_leaf(a2, "running"), 0);
+    assert_ptr_equal(a2->value.bit, b->value.bit);
+    assert_int_equal(lyd_bit_is_set((struct lyd_node *)a1, "up"), 1);
+    assert_int_equal(lyd_bit_is_set((struct lyd_node *)a2, "up"), 0);
 
-    f = (fopen(file_name,"r+"));
-    if (f == NULL) {
-        goto error;
-    }
+    lyd_free_withsiblings(data);
+}
 
-    rc = lyd_print_file(f, root, LYD_JSON, LYP_FORMAT);
-    if (rc) {
-        goto error;
-    }
+static void
+test_lyd_binary_value(void **state)
+{
+    struct ly_ctx *ctx = *state;
+    struct lyd_node *data, *b1, *b2;
+    const void *bin, *bin2;
+    size_t len;
+    const char *yang = "module r {namespace urn:r; prefix r;"
+        "container c {leaf b1 {type binary;} leaf b2 {type binary {length 4;}} leaf b3 {type binary;} leaf s {type string;}}}";
+    const char *xml = "<c xmlns=\"urn:r\"><b1>bGli\neWFuZw==</b1><b2>AAECAw==</b2><b3></b3><s>AAECAw==</s></c>";
+
+    assert_ptr_not_equal(lys_parse_mem(ctx, yang, LYS_IN_YANG), NULL);
+    data = lyd_parse_mem(ctx, xml, LYD_XML, LYD_OPT_CONFIG);
+    assert_ptr_not_equal(data, NULL);
+    b1 = data->child;
+    b2 = b1->next;
 
-    fclose(f);
+    bin = lyd_binary_value(b1, &len);
+    assert_ptr_not_equal(bin, NULL);
+    assert_int_equal(len, 7);
+    assert_memory_equal(bin, "libyang", 7);
 
-    fd = open(file_name, O_RDONLY);
-    if (fd == -1 || fstat(fd, &sb) == -1 || !S_ISREG(sb.st_mode)) {
-        goto error;
-    }
+    bin = lyd_binary_value(b2, &len);
+    assert_int_equal(len, 4);
+    assert_memory_equal(bin, "\x00\x01\x02\x03", 4);
 
-    result = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    /* decoded only once */
+    bin2 = lyd_binary_value(b2, &len);
+    assert_ptr_equal(bin, bin2);
 
-    assert_string_equal(result_json, result);
+    bin = lyd_binary_value(b2->next, &len);
+    assert_ptr_not_equal(bin, NULL);
+    assert_int_equal(len, 0);
 
-    close(fd);
-    unlink(file_name);
+    assert_ptr_equal(lyd_binary_value(b2->next->next, &len), NULL);
 
-    return;
-error:
-    if (f)
-        fclose(f);
-    if (fd > 0) {
-        unlink(file_name);
-        close(fd);
-    }
-    fail();
+    /* the decoded data stay valid after the data are freed */
+    lyd_free_withsiblings(data);
+    assert_memory_equal(bin2, "\x00\x01\x02\x03", 4);
+    ly_ctx_clean_binary(ctx);
 }
 
-struct buff {
-    int len;
-    const char *cmp;
-};
+static void
+test_lyd_path(void **state)
+{
+    (void) state; /* unused */
+    char *str;
 
-ssize_t custom_lyd_print_clb(void *arg, const void *buf, size_t count) {
-    int rc;
-    int len;
-    struct buff *pos = arg;
+    str = lyd_path(root);
+    assert_ptr_not_equal(str, NULL);
+    assert_string_equal(str, "/a:x");
+    free(str);
 
-    len = pos->len + count;
+    str = lyd_path(root->child);
+    assert_ptr_not_equal(str, NULL);
+    assert_string_equal(str, "/a:x/bubba");
+    free(str);
+}
 
-    const char *chunk = &pos->cmp[pos->len];
+static void
+test_lyd_path_buf(void **state)
+{
+    (void) state; /* unused */
+    const char *yang = "module d {namespace urn:d; prefix d;"
+        "container c { config false; list kl { leaf v { type string; } }"
+        "list l { key \"k1 k2\"; leaf k1 { type string; } leaf k2 { type string; } leaf v { type string; } }"
+        "leaf-list ll { type string; } } }";
+    struct lyd_node *data, *node, *first;
+    char buf[64], *str;
+    int i;
+
+    assert_non_null(lys_parse_mem(ctx, yang, LYS_IN_YANG));
+    data = lyd_new_path(NULL, ctx, "/d:c/l[k1='a'][k2=\"it's\"]/v", "x", 0, 0);
+    assert_non_null(data);
+    assert_non_null(lyd_new_path(data, ctx, "/d:c/ll[.='b']", NULL, 0, 0));
+    first = NULL;
+    for (i = 0; i < 5; ++i) {
+        node = lyd_new(data, NULL, "kl");
+        assert_non_null(node);
+        first = first ? first : node;
+    }
 
-    rc = strncmp(chunk, buf, count);
-    if (rc) {
-        fail();
+    /* the same paths as lyd_path() */
+    node = data->child->child->prev;
+    assert_int_equal(lyd_path_buf(node, buf, sizeof buf), 27);
+    assert_string_equal(buf, "/d:c/l[k1='a'][k2=\"it's\"]/v");
+    str = lyd_path(node);
+    assert_string_equal(str, buf);
+    free(str);
+    assert_int_equal(lyd_path_buf(data->child->next, buf, sizeof buf), 14);
+    assert_string_equal(buf, "/d:c/ll[.='b']");
+
+    /* truncated */
+    assert_int_equal(lyd_path_buf(data->child->next, buf, 6), 14);
+    assert_string_equal(buf, "/d:c/");
+    assert_int_equal(lyd_path_buf(data->child->next, NULL, 0), 14);
+
+    /* keyless list positions, consecutive and after a change */
+    for (i = 1, node = first; node; node = node->next, ++i) {
+        assert_int_equal(lyd_list_pos(node), i);
+        sprintf(buf, "/d:c/kl[%d]", i);
+        str = lyd_path(node);
+        assert_string_equal(str, buf);
+        free(str);
     }
+    assert_int_equal(lyd_list_pos(first->next->next), 3);
+    assert_int_equal(lyd_insert_before(first, data->child->prev), 0);
+    assert_int_equal(lyd_list_pos(first->next->next), 4);
+    assert_int_equal(lyd_list_pos(first->next->next->next), 5);
 
-    pos->len = len;
-    return count;
+    lyd_free(data);
 }
 
 static void
-test_lyd_print_clb_xml(void **state)
+test_lyd_journal(void **state)
 {
     (void) state; /* unused */
-    int rc;
+    const char *yang = "module e {namespace urn:e; prefix e;"
+        "container c { leaf a { type string; } leaf b { type string; }"
+        "leaf-list ll { type string; ordered-by user; } } }";
+    struct lyd_node *data, *node, *dup;
+    struct lyd_journal *journal;
+    struct lyd_difflist *diff;
+
+    assert_non_null(lys_parse_mem(ctx, yang, LYS_IN_YANG));
+    data = lyd_new_path(NULL, ctx, "/e:c/a", "x", 0, 0);
+    assert_non_null(data);
+    assert_non_null(lyd_new_path(data, ctx, "/e:c/ll", "1", 0, 0));
+    dup = lyd_dup(data, LYD_DUP_OPT_RECURSIVE);
+    assert_non_null(dup);
+
+    journal = lyd_journal_start(data);
+    assert_non_null(journal);
+    /* only one journal per thread, changes of other trees are not recorded */
+    assert_null(lyd_journal_start(dup));
+    assert_non_null(lyd_new_leaf(dup, NULL, "b", "z"));
+
+    node = lyd_new_leaf(data, NULL, "b", "y");
+    assert_non_null(node);
+    assert_int_equal(lyd_change_leaf((struct lyd_node_leaf_list *)data->child, "xx"), 0);
+    lyd_free(data->child);
+    node = lyd_new_leaf(data, NULL, "ll", "0");
+    assert_non_null(node);
+    assert_int_equal(lyd_insert_before(data->child, node), 0);
+
+    diff = lyd_journal_diff(journal);
+    assert_non_null(diff);
+    assert_int_equal(diff->type[0], LYD_DIFF_CREATED);
+    assert_string_equal((char *)diff->first[0], "/e:c");
+    assert_string_equal(diff->second[0]->schema->name, "b");
+    assert_int_equal(diff->type[1], LYD_DIFF_CHANGED);
+    assert_string_equal((char *)diff->first[1], "/e:c/a");
+    assert_string_equal(((struct lyd_node_leaf_list *)diff->second[1])->value_str, "xx");
+    assert_int_equal(diff->type[2], LYD_DIFF_DELETED);
+    assert_string_equal(diff->first[2]->schema->name, "a");
+    assert_string_equal((char *)diff->second[2], "/e:c");
+    /* appended as the last, then moved */
+    assert_int_equal(diff->type[3], LYD_DIFF_CREATED);
+    assert_int_equal(diff->type[4], LYD_DIFF_DELETED);
+    assert_int_equal(diff->type[5], LYD_DIFF_CREATED);
+    assert_int_equal(diff->type[6], LYD_DIFF_MOVEDAFTER2);
+    assert_null(diff->first[6]);
+    assert_string_equal((char *)diff->second[6], "/e:c/ll[.='0']");
+    assert_int_equal(diff->type[7], LYD_DIFF_END);
+    lyd_free_val_diff(diff);
+
+    /* new records after the diff was read */
+    lyd_free(data->child);
+    diff = lyd_journal_diff(journal);
+    assert_non_null(diff);
+    assert_int_equal(diff->type[0], LYD_DIFF_DELETED);
+    assert_int_equal(diff->type[1], LYD_DIFF_END);
+    lyd_free_val_diff(diff);
+
+    lyd_journal_stop(journal);
+    lyd_free(data);
+    lyd_free(dup);
+}
 
-    struct buff *buf = calloc(1, sizeof(struct buff));
-    if (!buf) {
-        fail();
+static void
+test_lyd_mem_usage(void **state)
+{
+    (void) state; /* unused */
+    const char *yang = "module f {namespace urn:f; prefix f;"
+        "container c { list l { key k; leaf k { type string; } leaf v { type string { pattern '[a-z]*'; } } } } }";
+    struct ly_ctx_mem_usage before, after;
+    struct lyd_node *data, *data2;
+    size_t size, size2;
+    char path[32];
+    int i;
+
+    assert_int_equal(ly_ctx_get_mem_usage(ctx, &before), 0);
+    assert_int_equal(before.total, before.modules + before.types + before.patterns + before.dict + before.caches);
+    assert_non_null(lys_parse_mem(ctx, yang, LYS_IN_YANG));
+    assert_int_equal(ly_ctx_get_mem_usage(ctx, &after), 0);
+    assert_true(after.modules > before.modules);
+    assert_true(after.types > before.types);
+    assert_true(after.patterns > before.patterns);
+    assert_true(after.dict > before.dict);
+
+    data = lyd_new_path(NULL, ctx, "/f:c/l[k='a']/v", "x", 0, 0);
+    assert_non_null(data);
+    size = lyd_mem_usage(data, 0);
+    assert_true(size >= sizeof *data + 3 * sizeof(struct lyd_node_leaf_list));
+
+    /* more nodes, more memory */
+    for (i = 0; i < 20; ++i) {
+        sprintf(path, "/f:c/l[k='k%d']/v", i);
+        assert_non_null(lyd_new_path(data, ctx, path, "y", 0, 0));
     }
+    size2 = lyd_mem_usage(data, 0);
+    assert_true(size2 > size + 20 * 3 * sizeof(struct lyd_node_leaf_list));
+    assert_true(lyd_mem_usage(data, 0) > lyd_mem_usage(data->child, LYD_MEM_WITHSIBLINGS));
+    assert_true(lyd_mem_usage(data->child, LYD_MEM_WITHSIBLINGS) > lyd_mem_usage(data->child, 0));
+
+    /* shared strings are split between the trees */
+    data2 = lyd_dup(data, LYD_DUP_OPT_RECURSIVE);
+    assert_non_null(data2);
+    assert_true(lyd_mem_usage(data, 0) < size2);
+    assert_true(lyd_mem_usage(data, 0) + lyd_mem_usage(data2, 0) < 2 * size2);
+
+    lyd_free(data2);
+    lyd_free(data);
+}
 
-    buf->len = 0;
-    buf->cmp = result_xml;
-    void *arg = buf;
+static int alloc_count, free_count;
 
-    rc = lyd_print_clb(custom_lyd_print_clb, arg, root, LYD_XML, 0);
-    if (rc) {
-        fail();
-        free(buf);
-    }
+static void *
+test_alloc_clb(size_t size, void *user_data)
+{
+    ++*(int *)user_data;
+    ++alloc_count;
+    return malloc(size);
+}
 
-    free(buf);
+static void
+test_free_clb(void *ptr, void *user_data)
+{
+    (void)user_data;
+    ++free_count;
+    free(ptr);
 }
 
 static void
-test_lyd_print_clb_xml_format(void **state)
+test_ly_parse_budget(void **state)
 {
     (void) state; /* unused */
-    int rc;
-
-    struct buff *buf = calloc(1, sizeof(struct buff));
-    if (!buf) {
-        fail();
-    }
-
-    buf->len = 0;
-    buf->cmp = result_xml_format;
-    void *arg = buf;
-
-    rc = lyd_print_clb(custom_lyd_print_clb, arg, root, LYD_XML, LYP_FORMAT);
-    if (rc) {
-        fail();
-        free(buf);
-    }
+    const char *yang = "module g {namespace urn:g; prefix g;"
+        "container c { leaf-list ll { type string; } } }";
+    const char *xml = "<c xmlns=\"urn:g\"><ll>a</ll><ll>b</ll><ll>c</ll></c>";
+    const char *json = "{\"g:c\":{\"ll\":[\"a\",\"b\",\"c\"]}}";
+    struct lyd_node *data;
+    int user_count = 0;
+
+    assert_non_null(lys_parse_mem(ctx, yang, LYS_IN_YANG));
+
+    /* node budget */
+    ly_parse_budget(3, 0);
+    assert_null(lyd_parse_mem(ctx, xml, LYD_XML, LYD_OPT_CONFIG | LYD_OPT_STRICT));
+    assert_int_equal(ly_errno, LY_EMEM);
+    assert_null(lyd_parse_mem(ctx, json, LYD_JSON, LYD_OPT_CONFIG | LYD_OPT_STRICT));
+    ly_parse_budget(4, 0);
+    data = lyd_parse_mem(ctx, xml, LYD_XML, LYD_OPT_CONFIG | LYD_OPT_STRICT);
+    assert_non_null(data);
+    lyd_free_withsiblings(data);
+    /* renewed for every parsing */
+    data = lyd_parse_mem(ctx, json, LYD_JSON, LYD_OPT_CONFIG | LYD_OPT_STRICT);
+    assert_non_null(data);
+    lyd_free_withsiblings(data);
 
-    free(buf);
+    /* byte budget, the input itself does not fit */
+    ly_parse_budget(0, strlen(xml) - 1);
+    assert_null(lyd_parse_mem(ctx, xml, LYD_XML, LYD_OPT_CONFIG | LYD_OPT_STRICT));
+    assert_int_equal(ly_errno, LY_EMEM);
+    ly_parse_budget(0, 0);
+
+    /* data allocator */
+    assert_int_not_equal(ly_ctx_set_data_allocator(ctx, test_alloc_clb, NULL, NULL), 0);
+    assert_int_equal(ly_ctx_set_data_allocator(ctx, test_alloc_clb, test_free_clb, &user_count), 0);
+    alloc_count = free_count = 0;
+    data = lyd_parse_mem(ctx, xml, LYD_XML, LYD_OPT_CONFIG | LYD_OPT_STRICT);
+    assert_non_null(data);
+    assert_int_equal(user_count, alloc_count);
+    assert_true(alloc_count >= 4);
+    lyd_free_withsiblings(data);
+    assert_int_equal(free_count, alloc_count);
+    assert_int_equal(ly_ctx_set_data_allocator(ctx, NULL, NULL, NULL), 0);
 }
 
 static void
-test_lyd_print_clb_json(void **state)
+test_lyd_change_leaf_val(void **state)
 {
     (void) state; /* unused */
-    int rc;
+    const char *yang = "module h {namespace urn:h; prefix h;"
+        "container c { leaf cnt { type uint32 { range \"0..1000\"; } } leaf d { type decimal64 { fraction-digits 2; } }"
+        "leaf b { type boolean; } leaf s { type string; } leaf r { type leafref { path \"../cnt\"; } } } }";
+    const struct lys_module *mod;
+    struct lyd_node *data;
+    struct lyd_node_leaf_list *cnt, *d, *b, *s, *r;
+    lyd_val val;
 
-    struct buff *buf = calloc(1, sizeof(struct buff));
-    if (!buf) {
-        fail();
-    }
+    mod = lys_parse_mem(ctx, yang, LYS_IN_YANG);
+    assert_non_null(mod);
+    data = lyd_new(NULL, mod, "c");
+    cnt = (struct lyd_node_leaf_list *)lyd_new_leaf(data, mod, "cnt", "5");
+    d = (struct lyd_node_leaf_list *)lyd_new_leaf(data, mod, "d", "1.5");
+    b = (struct lyd_node_leaf_list *)lyd_new_leaf(data, mod, "b", "false");
+    s = (struct lyd_node_leaf_list *)lyd_new_leaf(data, mod, "s", "x");
+    r = (struct lyd_node_leaf_list *)lyd_new_leaf(data, mod, "r", "5");
+    assert_non_null(r);
+    assert_int_equal(lyd_validate(&data, LYD_OPT_CONFIG, NULL), 0);
+
+    val.uint32 = 42;
+    assert_int_equal(lyd_change_leaf_val(cnt, &val), 0);
+    assert_string_equal(cnt->value_str, "42");
+    assert_int_equal(cnt->value.uint32, 42);
+    /* the leafref pointing to the counter is invalidated */
+    assert_int_not_equal(r->validity & LYD_VAL_LEAFREF, 0);
+    assert_int_equal(lyd_change_leaf_val(cnt, &val), 1);
+
+    /* range restriction */
+    val.uint32 = 1001;
+    assert_int_equal(lyd_change_leaf_val(cnt, &val), -1);
+    assert_string_equal(cnt->value_str, "42");
+
+    val.dec64 = -5;
+    assert_int_equal(lyd_change_leaf_val(d, &val), 0);
+    assert_string_equal(d->value_str, "-0.05");
+    val.bln = 1;
+    assert_int_equal(lyd_change_leaf_val(b, &val), 0);
+    assert_string_equal(b->value_str, "true");
+
+    /* leafref takes the generic path */
+    val.uint32 = 42;
+    assert_int_equal(lyd_change_leaf_val(r, &val), 0);
+    assert_string_equal(r->value_str, "42");
+    assert_int_equal(lyd_validate(&data, LYD_OPT_CONFIG, NULL), 0);
+
+    /* not a numeric type */
+    assert_int_equal(lyd_change_leaf_val(s, &val), -1);
+    assert_int_equal(ly_errno, LY_EINVAL);
 
-    buf->len = 0;
-    buf->cmp = result_json;
-    void *arg = buf;
+    lyd_free_withsiblings(data);
+}
 
-    rc = lyd_print_clb(custom_lyd_print_clb, arg, root, LYD_JSON, LYP_FORMAT);
-    if (rc) {
-        fail();
-        free(buf);
+static struct lyd_node *
+free_test_tree(const struct lys_module *mod, int count)
+{
+    struct lyd_node *root, *list;
+    char buf[32];
+    int i;
+
+    root = lyd_new(NULL, mod, "c");
+    for (i = 0; i < count; ++i) {
+        sprintf(buf, "k%d", i);
+        list = lyd_new(root, mod, "l");
+        lyd_new_leaf(list, mod, "k", buf);
+        sprintf(buf, "v%d", i % 7);
+        lyd_new_leaf(list, mod, "v", buf);
     }
-
-    free(buf);
+    lyd_insert_sibling(&root, lyd_new_leaf(NULL, mod, "t", "top"));
+    return root;
 }
 
 static void
-test_lyd_path(void **state)
+test_lyd_free_parallel(void **state)
 {
     (void) state; /* unused */
-    char *str;
-
-    str = lyd_path(root);
-    assert_ptr_not_equal(str, NULL);
-    assert_string_equal(str, "/a:x");
-    free(str);
+    const char *yang = "module i {namespace urn:i; prefix i;"
+        "container c { list l { key k; leaf k { type string; } leaf v { type string; } } } leaf t { type string; } }";
+    const struct lys_module *mod;
+    struct ly_ctx_mem_usage before, after;
+    struct lyd_node *tree;
+    int i;
 
-    str = lyd_path(root->child);
-    assert_ptr_not_equal(str, NULL);
-    assert_string_equal(str, "/a:x/bubba");
-    free(str);
+    mod = lys_parse_mem(ctx, yang, LYS_IN_YANG);
+    assert_non_null(mod);
+    assert_int_equal(ly_ctx_get_mem_usage(ctx, &before), 0);
+
+    /* split among threads, the only top-level container is split into its children */
+    ly_ctx_set_free_threads(ctx, 4);
+    assert_int_equal(ly_ctx_get_free_threads(ctx), 4);
+    tree = free_test_tree(mod, 200);
+    assert_non_null(tree);
+    lyd_free_withsiblings(tree);
+    assert_int_equal(ly_ctx_get_mem_usage(ctx, &after), 0);
+    assert_int_equal(after.dict, before.dict);
+
+    /* background freeing */
+    for (i = 0; i < 5; ++i) {
+        tree = free_test_tree(mod, 100);
+        assert_non_null(tree);
+        lyd_free_deferred(tree);
+    }
+    lyd_free_deferred_wait(ctx);
+    assert_int_equal(ly_ctx_get_mem_usage(ctx, &after), 0);
+    assert_int_equal(after.dict, before.dict);
+
+    /* the context finishes the pending freeing itself */
+    ly_ctx_set_free_threads(ctx, 0);
+    tree = free_test_tree(mod, 100);
+    lyd_free_deferred(tree);
 }
 
 static void
@@ -1769,25 +4845,68 @@ int main(void)
         cmocka_unit_test(test_lyd_parse_mem),
         cmocka_unit_test(test_lyd_parse_fd),
         cmocka_unit_test(test_lyd_parse_path),
+        cmocka_unit_test_setup_teardown(test_lyd_parser_push, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_lyd_anydata_convert, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_lyd_parse_canonical, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_lyd_parse_projection, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_lyd_parse_batch, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_lyd_parse_mem_mixed, setup_f2, teardown_f2),
+        cmocka_unit_test_setup_teardown(test_lyd_parse_batch_xpath, setup_f2, teardown_f2),
         cmocka_unit_test(test_lyd_parse_xml),
         cmocka_unit_test_setup_teardown(test_lyd_new, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_lyd_new_leaf, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_lyd_change_leaf, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_lyd_output_new_leaf, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_lyd_new_path, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_lyd_new_path_template, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_lyd_insert_batch, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_lyd_find_sibling_val, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_lyd_dup, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_lyd_arena, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_lyd_compact, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_lyd_vtree, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_lyd_insert, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_lyd_insert_sibling, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_lyd_insert_before, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_lyd_insert_after, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_lyd_schema_sort, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_lyd_schema_sort_augment, setup_f2, teardown_f2),
+        cmocka_unit_test_setup_teardown(test_lyd_user_type_callbacks, setup_f2, teardown_f2),
+        cmocka_unit_test_setup_teardown(test_lyd_value_parser, setup_f2, teardown_f2),
+        cmocka_unit_test_setup_teardown(test_lyd_private_values, setup_f2, teardown_f2),
         cmocka_unit_test_setup_teardown(test_lyd_find_path, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_lyd_find_compiled, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_lyd_find_iter, setup_f2, teardown_f2),
         cmocka_unit_test_setup_teardown(test_lyd_find_instance, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_lyd_validate, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_lyd_validate_threads, setup_f2, teardown_f2),
+        cmocka_unit_test_setup_teardown(test_lyd_node_cache, setup_f2, teardown_f2),
+        cmocka_unit_test_setup_teardown(test_lyd_find_path_threads, setup_f2, teardown_f2),
+        cmocka_unit_test_setup_teardown(test_lyd_hash_threshold, setup_f2, teardown_f2),
+        cmocka_unit_test_setup_teardown(test_lyd_print_threads, setup_f2, teardown_f2),
+        cmocka_unit_test_setup_teardown(test_lyd_val_profile, setup_f2, teardown_f2),
+        cmocka_unit_test_setup_teardown(test_lyd_eval_budget, setup_f2, teardown_f2),
+        cmocka_unit_test_setup_teardown(test_lyd_print_page, setup_f2, teardown_f2),
+        cmocka_unit_test_setup_teardown(test_lyd_print_gen, setup_f2, teardown_f2),
+        cmocka_unit_test_setup_teardown(test_lyd_nacm, setup_f2, teardown_f2),
+        cmocka_unit_test_setup_teardown(test_lyd_filter, setup_f2, teardown_f2),
+        cmocka_unit_test_setup_teardown(test_lyd_export_columns, setup_f2, teardown_f2),
+        cmocka_unit_test_setup_teardown(test_lyd_print_config, setup_f2, teardown_f2),
+        cmocka_unit_test_setup_teardown(test_lyd_sorted_insert, setup_f2, teardown_f2),
+        cmocka_unit_test_setup_teardown(test_lyd_subtree_filters, setup_f2, teardown_f2),
+        cmocka_unit_test_setup_teardown(test_lyd_lyb_patch, setup_f2, teardown_f2),
+        cmocka_unit_test_setup_teardown(test_lyd_lyb_stream, setup_f2, teardown_f2),
+        cmocka_unit_test_setup_teardown(test_lyd_store, setup_f2, teardown_f2),
+        cmocka_unit_test_setup_teardown(test_lyd_bit_is_set, setup_f2, teardown_f2),
+        cmocka_unit_test_setup_teardown(test_lyd_binary_value, setup_f2, teardown_f2),
+        cmocka_unit_test_setup_teardown(test_lyd_validate_changed, setup_f2, teardown_f2),
+        cmocka_unit_test_setup_teardown(test_lyd_validate_leafref, setup_f2, teardown_f2),
+        cmocka_unit_test_setup_teardown(test_lyd_parse_schema_children, setup_f2, teardown_f2),
         cmocka_unit_test_setup_teardown(test_lyd_unlink, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_lyd_free, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_lyd_free_withsiblings, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_lyd_insert_attr, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_lyd_find_attr, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_lyd_free_attr, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_lyd_print_mem_xml, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_lyd_print_mem_xml_format, setup_f, teardown_f),
@@ -1801,7 +4920,15 @@ int main(void)
         cmocka_unit_test_setup_teardown(test_lyd_print_clb_xml, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_lyd_print_clb_xml_format, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_lyd_print_clb_json, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_lyd_print_iov, setup_f2, teardown_f2),
+        cmocka_unit_test_setup_teardown(test_lyd_print_fd_nb, setup_f2, teardown_f2),
         cmocka_unit_test_setup_teardown(test_lyd_path, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_lyd_path_buf, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_lyd_journal, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_lyd_mem_usage, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_ly_parse_budget, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_lyd_change_leaf_val, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_lyd_free_parallel, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_lyd_leaf_type, setup_f2, teardown_f2),
         cmocka_unit_test_setup_teardown(test_lyd_validation_dflt_empty_containers, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_lyd_diff, setup_f, teardown_f),
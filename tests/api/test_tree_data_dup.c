@@ -227,12 +227,133 @@ test_dup_to_ctx_leafrefs(void **state)
     free(printed);
 }
 
+static void
+test_dup_bits_enum(void **state)
+{
+    struct state *st = (*state);
+    const struct lys_module *mod;
+    const char *sch = "module x {"
+                    "  namespace urn:x;"
+                    "  prefix x;"
+                    "  container x {"
+                    "    leaf a { type bits { bit one; bit two; bit three; } }"
+                    "    leaf b { type leafref { path ../a; } }"
+                    "    leaf c { type enumeration { enum red; enum green; } } } }";
+    const char *data = "<x xmlns=\"urn:x\"><a>one three</a><b>one three</b><c>green</c></x>";
+    struct lyd_node_leaf_list *leaf1, *leaf2;
+    char *printed = NULL;
+
+    mod = lys_parse_mem(st->ctx1, sch, LYS_IN_YANG);
+    assert_ptr_not_equal(mod, NULL);
+
+    st->dt1 = lyd_parse_mem(st->ctx1, data, LYD_XML, LYD_OPT_CONFIG);
+    assert_ptr_not_equal(st->dt1, NULL);
+
+    st->dt2 = lyd_dup(st->dt1, LYD_DUP_OPT_RECURSIVE);
+    assert_ptr_not_equal(st->dt2, NULL);
+
+    /* the bits value is shared */
+    leaf1 = (struct lyd_node_leaf_list *)st->dt1->child;
+    leaf2 = (struct lyd_node_leaf_list *)st->dt2->child;
+    assert_int_equal(leaf2->value_type, LY_TYPE_BITS);
+    assert_ptr_equal(leaf1->value.bit, leaf2->value.bit);
+    assert_ptr_equal(leaf1->value.bit[0], leaf2->value.bit[0]);
+    assert_ptr_equal(leaf2->value.bit[1], NULL);
+    assert_ptr_equal(leaf1->value.bit[2], leaf2->value.bit[2]);
+
+    /* the leafref is resolved again */
+    assert_int_equal(lyd_validate(&st->dt2, LYD_OPT_CONFIG, NULL), 0);
+    leaf2 = (struct lyd_node_leaf_list *)st->dt2->child->next;
+    assert_int_equal(leaf2->value_type, LY_TYPE_LEAFREF);
+    assert_ptr_equal(leaf2->value.leafref, st->dt2->child);
+
+    /* the enum references the same schema definition */
+    leaf1 = (struct lyd_node_leaf_list *)st->dt1->child->prev;
+    leaf2 = (struct lyd_node_leaf_list *)st->dt2->child->prev;
+    assert_int_equal(leaf2->value_type, LY_TYPE_ENUM);
+    assert_ptr_equal(leaf1->value.enm, leaf2->value.enm);
+
+    lyd_free(st->dt1);
+    st->dt1 = NULL;
+
+    lyd_print_mem(&printed, st->dt2, LYD_XML, 0);
+    assert_string_equal(printed, data);
+
+    free(printed);
+}
+
+static void
+test_dup_to_ctx_repeated(void **state)
+{
+    struct state *st = (*state);
+    const struct lys_module *mod;
+    const char *sch = "module x {"
+                    "  namespace urn:x;"
+                    "  prefix x;"
+                    "  container x {"
+                    "    list l { key k; leaf k { type string; } leaf v { type string; } } } }";
+    const char *sch2 = "module y {"
+                    "  namespace urn:y;"
+                    "  prefix y;"
+                    "  leaf y { type string; } }";
+    const char *data = "<x xmlns=\"urn:x\"><l><k>a</k><v>1</v></l><l><k>b</k><v>2</v></l></x>";
+    struct lyd_node *dup;
+    struct ly_ctx_mem_usage usage1, usage2;
+    char *printed = NULL;
+
+    mod = lys_parse_mem(st->ctx1, sch, LYS_IN_YANG);
+    assert_ptr_not_equal(mod, NULL);
+    mod = lys_parse_mem(st->ctx2, sch, LYS_IN_YANG);
+    assert_ptr_not_equal(mod, NULL);
+
+    st->dt1 = lyd_parse_mem(st->ctx1, data, LYD_XML, LYD_OPT_CONFIG);
+    assert_ptr_not_equal(st->dt1, NULL);
+
+    /* the second copy uses the schema nodes mapped by the first one */
+    st->dt2 = lyd_dup_to_ctx(st->dt1, 1, st->ctx2);
+    assert_ptr_not_equal(st->dt2, NULL);
+    ly_ctx_get_mem_usage(st->ctx2, &usage1);
+    dup = lyd_dup_to_ctx(st->dt1, 1, st->ctx2);
+    assert_ptr_not_equal(dup, NULL);
+    ly_ctx_get_mem_usage(st->ctx2, &usage2);
+    assert_int_equal(usage1.caches, usage2.caches);
+    assert_ptr_equal(st->dt2->schema, dup->schema);
+    assert_ptr_equal(st->dt2->child->child->next->schema, dup->child->child->next->schema);
+    assert_ptr_equal(dup->schema->module->ctx, st->ctx2);
+
+    /* merging into the target context maps the same nodes */
+    assert_int_equal(lyd_merge_to_ctx(&dup, st->dt1, 0, st->ctx2), 0);
+    lyd_print_mem(&printed, dup, LYD_XML, 0);
+    assert_string_equal(printed, data);
+    free(printed);
+    lyd_free(dup);
+
+    /* a module set change of the target context drops the mapped nodes */
+    lyd_free(st->dt2);
+    st->dt2 = NULL;
+    assert_int_equal(ly_ctx_remove_module(ly_ctx_get_module(st->ctx2, "x", NULL, 0), NULL), 0);
+    mod = lys_parse_mem(st->ctx2, sch2, LYS_IN_YANG);
+    assert_ptr_not_equal(mod, NULL);
+    assert_ptr_equal(lyd_dup_to_ctx(st->dt1, 1, st->ctx2), NULL);
+
+    mod = lys_parse_mem(st->ctx2, sch, LYS_IN_YANG);
+    assert_ptr_not_equal(mod, NULL);
+    st->dt2 = lyd_dup_to_ctx(st->dt1, 1, st->ctx2);
+    assert_ptr_not_equal(st->dt2, NULL);
+    assert_ptr_equal(st->dt2->schema, mod->data);
+    lyd_print_mem(&printed, st->dt2, LYD_XML, 0);
+    assert_string_equal(printed, data);
+    free(printed);
+}
+
 int main(void)
 {
     const struct CMUnitTest tests[] = {
                     cmocka_unit_test_setup_teardown(test_dup_to_ctx, setup_f, teardown_f),
                     cmocka_unit_test_setup_teardown(test_dup_to_ctx_bits, setup_f, teardown_f),
-                    cmocka_unit_test_setup_teardown(test_dup_to_ctx_leafrefs, setup_f, teardown_f),};
+                    cmocka_unit_test_setup_teardown(test_dup_to_ctx_leafrefs, setup_f, teardown_f),
+                    cmocka_unit_test_setup_teardown(test_dup_to_ctx_repeated, setup_f, teardown_f),
+                    cmocka_unit_test_setup_teardown(test_dup_bits_enum, setup_f, teardown_f),};
 
     return cmocka_run_group_tests(tests, NULL, NULL);
 }
@@ -653,6 +653,80 @@ test_merge_leafrefs(void **state)
     free(prt);
 }
 
+static void
+test_merge_toplevel_siblings(void **state)
+{
+    struct state *st = (*state);
+    const char *sch = "module x {"
+                      "  namespace urn:x;"
+                      "  prefix x;"
+                      "  list l {"
+                      "    key n;"
+                      "    leaf n { type uint32; }"
+                      "    leaf v { type string; }}"
+                      "  leaf-list s { type string; config false; }}";
+    struct lyd_node *node;
+    struct ly_set *set;
+    char path[32];
+    uint32_t i;
+    int r;
+
+    assert_ptr_not_equal(lys_parse_mem(st->ctx1, sch, LYS_IN_YANG), NULL);
+
+    /* enough top-level siblings to be found by their hash */
+    for (i = 0; i < 100; ++i) {
+        sprintf(path, "/x:l[n='%u']/v", i);
+        node = lyd_new_path(st->target, st->ctx1, path, "old", 0, 0);
+        assert_ptr_not_equal(node, NULL);
+        if (!st->target) {
+            st->target = node;
+        }
+    }
+    assert_ptr_not_equal(lyd_new_path(st->target, st->ctx1, "/x:s", "a", 0, 0), NULL);
+    assert_ptr_not_equal(lyd_new_path(st->target, st->ctx1, "/x:s", "a", 0, 0), NULL);
+
+    for (i = 50; i < 150; ++i) {
+        sprintf(path, "/x:l[n='%u']/v", i);
+        node = lyd_new_path(st->source, st->ctx1, path, "new", 0, 0);
+        assert_ptr_not_equal(node, NULL);
+        if (!st->source) {
+            st->source = node;
+        }
+    }
+    for (i = 0; i < 3; ++i) {
+        assert_ptr_not_equal(lyd_new_path(st->source, st->ctx1, "/x:s", "a", 0, 0), NULL);
+    }
+
+    /* merging the same source twice must not add anything the second time */
+    for (r = 0; r < 2; ++r) {
+        assert_int_equal(lyd_merge(st->target, st->source, 0), 0);
+
+        set = lyd_find_path(st->target, "/x:l");
+        assert_ptr_not_equal(set, NULL);
+        assert_int_equal(set->number, 150);
+        ly_set_free(set);
+        set = lyd_find_path(st->target, "/x:l[v='new']");
+        assert_ptr_not_equal(set, NULL);
+        assert_int_equal(set->number, 100);
+        ly_set_free(set);
+        set = lyd_find_path(st->target, "/x:s");
+        assert_ptr_not_equal(set, NULL);
+        assert_int_equal(set->number, 3);
+        ly_set_free(set);
+    }
+
+    assert_int_equal(lyd_merge(st->target, st->source, LYD_OPT_DESTRUCT), 0);
+    st->source = NULL;
+    set = lyd_find_path(st->target, "/x:l");
+    assert_ptr_not_equal(set, NULL);
+    assert_int_equal(set->number, 150);
+    ly_set_free(set);
+    set = lyd_find_path(st->target, "/x:s");
+    assert_ptr_not_equal(set, NULL);
+    assert_int_equal(set->number, 3);
+    ly_set_free(set);
+}
+
 
 int
 main(void)
@@ -670,6 +744,7 @@ main(void)
                     cmocka_unit_test_setup_teardown(test_merge_to_ctx, setup_mctx, teardown_mctx),
                     cmocka_unit_test_setup_teardown(test_merge_to_ctx_with_missing_schema, setup_mctx, teardown_mctx),
                     cmocka_unit_test_setup_teardown(test_merge_leafrefs, setup_dflt, teardown_dflt),
+                    cmocka_unit_test_setup_teardown(test_merge_toplevel_siblings, setup_dflt, teardown_dflt),
     };
 
     return cmocka_run_group_tests(tests, NULL, NULL);
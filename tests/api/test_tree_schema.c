@@ -389,6 +389,43 @@ test_lys_parse_mem(void **state)
     ctx = NULL;
 }
 
+static void
+test_lys_parse_mem_yin_body(void **state)
+{
+    (void) state; /* unused */
+    const struct lys_module *module;
+    const char *yin =
+        "<module name=\"lazy\" xmlns=\"urn:ietf:params:xml:ns:yang:yin:1\" xmlns:l=\"urn:lazy\">"
+        "<namespace uri=\"urn:lazy\"/><prefix value=\"l\"/>"
+        "<grouping name=\"g\"><leaf name=\"gl\"><type name=\"string\"/></leaf></grouping>"
+        "<container name=\"c\"><uses name=\"l:g\"/><leaf name=\"ref\"><type name=\"leafref\">"
+        "<path value=\"/l:c/l:gl\"/></type></leaf></container>"
+        "<augment target-node=\"/l:c\"><leaf name=\"al\"><type name=\"int8\"/></leaf></augment>"
+        "</module>";
+
+    ctx = ly_ctx_new(NULL, 0);
+    assert_non_null(ctx);
+
+    /* the body statements are read only when processed, with the module namespaces in scope */
+    module = lys_parse_mem(ctx, yin, LYS_IN_YIN);
+    assert_non_null(module);
+    assert_non_null(ly_ctx_get_node(ctx, NULL, "/lazy:c/gl", 0));
+    assert_non_null(ly_ctx_get_node(ctx, NULL, "/lazy:c/ref", 0));
+    assert_non_null(ly_ctx_get_node(ctx, NULL, "/lazy:c/al", 0));
+
+    /* errors in the skipped content are still found */
+    assert_null(lys_parse_mem(ctx, "<module name=\"lazy2\" xmlns=\"urn:ietf:params:xml:ns:yang:yin:1\">"
+                              "<namespace uri=\"urn:lazy2\"/><prefix value=\"l\"/><container name=\"c\"><leaf>"
+                              "</container></module>", LYS_IN_YIN));
+    assert_null(lys_parse_mem(ctx, "<module name=\"lazy2\" xmlns=\"urn:ietf:params:xml:ns:yang:yin:1\">"
+                              "<namespace uri=\"urn:lazy2\"/><prefix value=\"l\"/><container name=\"c\">"
+                              "<leaf name=\"x\">text<type name=\"string\"/></leaf></container></module>",
+                              LYS_IN_YIN));
+
+    ly_ctx_destroy(ctx, NULL);
+    ctx = NULL;
+}
+
 static void
 test_lys_parse_fd(void **state)
 {
@@ -605,6 +642,133 @@ test_lys_features_state(void **state)
     assert_int_equal(0x0, feature_state);
 }
 
+static const char *
+imp_xpath_clb(const char *mod_name, const char *UNUSED(mod_rev), const char *UNUSED(submod_name),
+              const char *UNUSED(sub_rev), void *user_data, LYS_INFORMAT *format,
+              void (**free_module_data)(void *model_data, void *user_data))
+{
+    *free_module_data = NULL;
+    *format = LYS_IN_YANG;
+    return strcmp(mod_name, "i") ? NULL : user_data;
+}
+
+static void
+test_lys_set_implemented_xpath(void **state)
+{
+    (void) state; /* unused */
+    const struct lys_module *module;
+    const struct lys_node *leaf;
+    const char *imp = "module i {"
+                      "  namespace urn:i; prefix i;"
+                      "  leaf cfg { type string; }"
+                      "  notification n { leaf l { type string; must \"/i:cfg\"; } }"
+                      "}";
+    const char *yang = "module m { namespace urn:m; prefix m; import i { prefix i; } }";
+
+    ly_ctx_set_module_imp_clb(ctx, imp_xpath_clb, (void *)imp);
+    module = lys_parse_mem(ctx, yang, LYS_IN_YANG);
+    assert_ptr_not_equal(module, NULL);
+    module = module->imp[0].module;
+    assert_int_equal(module->implemented, 0);
+    leaf = module->data->next->child;
+    assert_string_equal(leaf->name, "l");
+
+    /* the XPath expressions of only imported modules are checked once they are implemented */
+    assert_int_equal(leaf->flags & LYS_XPCONF_DEP, 0);
+    assert_int_equal(lys_set_implemented(module), 0);
+    assert_int_not_equal(leaf->flags & LYS_XPCONF_DEP, 0);
+    ly_ctx_set_module_imp_clb(ctx, NULL, NULL);
+}
+
+static void
+test_lys_grouping_list_keys(void **state)
+{
+    (void) state; /* unused */
+    const struct lys_module *module;
+    const struct lys_node_list *grp_list, *list;
+    const struct lys_node *cont;
+    const char *yang = "module g {"
+                       "  namespace urn:g; prefix g;"
+                       "  grouping kg { leaf k2 { type string; } }"
+                       "  grouping lg {"
+                       "    list l { key \"k1 k2\"; unique u; leaf k1 { type string; } uses kg; leaf u { type string; } }"
+                       "  }"
+                       "  container a { uses lg; }"
+                       "  container b { uses lg; }"
+                       "}";
+    const char *data = "<a xmlns=\"urn:g\"><l><k1>1</k1><k2>1</k2><u>x</u></l><l><k1>2</k1><k2>1</k2><u>x</u></l></a>";
+
+    module = lys_parse_mem(ctx, yang, LYS_IN_YANG);
+    assert_ptr_not_equal(module, NULL);
+    grp_list = (struct lys_node_list *)module->data->next->child;
+    assert_string_equal(grp_list->name, "l");
+
+    /* every instance has its own keys, also the one from the nested uses */
+    LY_TREE_FOR(module->data->next->next, cont) {
+        list = (struct lys_node_list *)cont->child->child;
+        assert_string_equal(list->name, "l");
+        assert_int_equal(list->keys_size, 2);
+        assert_string_equal(list->keys[0]->name, "k1");
+        assert_ptr_equal(list->keys[0]->parent, list);
+        assert_string_equal(list->keys[1]->name, "k2");
+        assert_ptr_equal(list->keys[1]->parent->parent, list);
+        assert_ptr_not_equal(list->keys[0], grp_list->keys[0]);
+        assert_ptr_not_equal(list->keys[1], grp_list->keys[1]);
+        assert_int_equal(list->unique[0].trg_type, grp_list->unique[0].trg_type);
+    }
+
+    /* unique is still enforced in the instances */
+    assert_ptr_equal(lyd_parse_mem(ctx, data, LYD_XML, LYD_OPT_CONFIG), NULL);
+    assert_int_equal(ly_vecode(ctx), LYVE_NOUNIQ);
+}
+
+static void
+test_lys_features_iffeature_change(void **state)
+{
+    (void) state; /* unused */
+    const struct lys_module *module;
+    const struct lys_node *node;
+    const char *yang = "module x {"
+                       "  yang-version 1.1;"
+                       "  namespace urn:x; prefix x;"
+                       "  feature a;"
+                       "  feature b { if-feature a; }"
+                       "  feature c;"
+                       "  leaf l { type string; if-feature \"b and not c\"; }"
+                       "  leaf e { type enumeration { enum one; enum two { if-feature b; } } }"
+                       "}";
+    const char *data = "<e xmlns=\"urn:x\">two</e>";
+
+    module = lys_parse_mem(ctx, yang, LYS_IN_YANG);
+    assert_ptr_not_equal(module, NULL);
+    node = module->data;
+    assert_string_equal(node->name, "l");
+
+    /* every evaluation must follow the current feature states */
+    assert_ptr_not_equal(lys_is_disabled(node, 0), NULL);
+    assert_ptr_equal(lyd_parse_mem(ctx, data, LYD_XML, LYD_OPT_CONFIG), NULL);
+
+    assert_int_equal(lys_features_enable(module, "b"), 1);
+    assert_int_equal(lys_features_enable(module, "a"), 0);
+    assert_int_equal(lys_features_enable(module, "b"), 0);
+    assert_ptr_equal(lys_is_disabled(node, 0), NULL);
+    root = lyd_parse_mem(ctx, data, LYD_XML, LYD_OPT_CONFIG);
+    assert_ptr_not_equal(root, NULL);
+    lyd_free(root);
+    root = NULL;
+
+    assert_int_equal(lys_features_enable(module, "c"), 0);
+    assert_ptr_not_equal(lys_is_disabled(node, 0), NULL);
+    assert_int_equal(lys_features_disable(module, "c"), 0);
+    assert_ptr_equal(lys_is_disabled(node, 0), NULL);
+
+    /* disabling a feature disables also the features depending on it */
+    assert_int_equal(lys_features_disable(module, "a"), 0);
+    assert_int_equal(lys_features_state(module, "b"), 0);
+    assert_ptr_not_equal(lys_is_disabled(node, 0), NULL);
+    assert_ptr_equal(lyd_parse_mem(ctx, data, LYD_XML, LYD_OPT_CONFIG), NULL);
+}
+
 static void
 test_lys_is_disabled(void **state)
 {
@@ -768,6 +932,20 @@ test_lys_print_mem_yang(void **state)
 
     assert_string_equal(result_yang, result);
     free(result);
+
+    /* printed again, the same output */
+    rc = lys_print_mem(&result, module, LYS_OUT_YIN, NULL, 0, 0);
+    if (rc) {
+        fail();
+    }
+    free(result);
+    rc = lys_print_mem(&result, module, LYS_OUT_YANG, NULL, 0, 0);
+    if (rc) {
+        fail();
+    }
+
+    assert_string_equal(result_yang, result);
+    free(result);
 }
 
 static void
@@ -1538,6 +1716,57 @@ test_lys_xpath_atomize(void **state)
     ly_set_free(set);
 }
 
+static void
+test_lys_xpath_atomize_must(void **state)
+{
+    (void) state; /* unused */
+    const struct lys_module *module;
+    const struct lys_node_leaf *leaf;
+    struct ly_set *set, *set2;
+    unsigned int i;
+    const char *schema =
+    "module c {"
+        "namespace \"urn:c\";"
+        "prefix \"c\";"
+        "leaf top {"
+            "type string;"
+        "}"
+        "notification n {"
+            "leaf x {"
+                "type string;"
+                "must \"../y = /top\";"
+            "}"
+            "leaf y {"
+                "type string;"
+            "}"
+        "}"
+    "}";
+
+    module = lys_parse_mem(ctx, schema, LYS_IN_YANG);
+    assert_non_null(module);
+    leaf = (struct lys_node_leaf *)module->data->next->child;
+    assert_string_equal(leaf->name, "x");
+
+    /* the atomized must expression is the same whether it was stored with the schema or not */
+    set = lys_xpath_atomize((struct lys_node *)leaf, LYXP_NODE_ELEM, leaf->must[0].expr, LYXP_MUST);
+    assert_non_null(set);
+    set2 = lys_xpath_atomize((struct lys_node *)leaf, LYXP_NODE_ELEM, "../y = /top", LYXP_MUST);
+    assert_non_null(set2);
+    assert_int_equal(set->number, set2->number);
+    for (i = 0; i < set->number; ++i) {
+        assert_ptr_equal(set->set.s[i], set2->set.s[i]);
+    }
+    ly_set_free(set2);
+
+    set2 = lys_node_xpath_atomize((struct lys_node *)leaf, 0);
+    assert_non_null(set2);
+    assert_int_equal(set->number, set2->number);
+    assert_int_not_equal(ly_set_contains(set2, module->data), -1);
+    assert_int_not_equal(ly_set_contains(set2, leaf->next), -1);
+    ly_set_free(set2);
+    ly_set_free(set);
+}
+
 static void
 test_lys_path(void **state)
 {
@@ -1575,12 +1804,16 @@ int main(void)
 {
     const struct CMUnitTest tests[] = {
         cmocka_unit_test(test_lys_parse_mem),
+        cmocka_unit_test(test_lys_parse_mem_yin_body),
         cmocka_unit_test(test_lys_parse_fd),
         cmocka_unit_test(test_lys_parse_path),
         cmocka_unit_test_setup_teardown(test_lys_features_list, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_lys_features_enable, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_lys_features_disable, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_lys_features_state, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_lys_features_iffeature_change, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_lys_set_implemented_xpath, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_lys_grouping_list_keys, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_lys_is_disabled, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_lys_getnext, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_lys_parent, setup_f, teardown_f),
@@ -1602,6 +1835,7 @@ int main(void)
         cmocka_unit_test_setup_teardown(test_lys_print_file_jsons, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_lys_find_path, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_lys_xpath_atomize, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_lys_xpath_atomize_must, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_lys_path, setup_f, teardown_f),
     };
 
@@ -136,6 +136,44 @@ test_lyxml_parse_mem(void **state)
     lyxml_free(ctx, xml);
 }
 
+static void
+test_lyxml_parse_mem_text(void **state)
+{
+    (void) state; /* unused */
+    struct lyxml_elem *xml = NULL;
+    char data[4096], expected[2048];
+    int i, len;
+
+    /* long content with references, a CDATA section and non-ASCII characters spread across the blocks */
+    len = sprintf(data, "<x xmlns=\"urn:a\" name-with.chars_1=\"");
+    for (i = 0; i < 1500; ++i) {
+        data[len++] = 'a' + i % 26;
+    }
+    len += sprintf(&data[len], "\"><bubba>");
+    for (i = 0; i < 40; ++i) {
+        len += sprintf(&data[len], "%02d\t&lt;&#x41;<![CDATA[<]>]]>\xc3\xa9 line\n", i);
+    }
+    sprintf(&data[len], "</bubba></x>");
+
+    len = 0;
+    for (i = 0; i < 40; ++i) {
+        len += sprintf(&expected[len], "%02d\t<A<]>\xc3\xa9 line\n", i);
+    }
+
+    xml = lyxml_parse_mem(ctx, data, 0);
+    assert_non_null(xml);
+    assert_string_equal(xml->attr->next->name, "name-with.chars_1");
+    assert_int_equal(strlen(xml->attr->next->value), 1500);
+    assert_string_equal(xml->child->content, expected);
+    lyxml_free(ctx, xml);
+
+    /* invalid characters are still found */
+    assert_null(lyxml_parse_mem(ctx, "<x xmlns=\"urn:a\"><bubba>0123456789abcdef0123456789\x01</bubba></x>", 0));
+    assert_null(lyxml_parse_mem(ctx, "<x xmlns=\"urn:a\"><bubba>0123456789abcdef0123456789\xc3</bubba></x>", 0));
+    assert_null(lyxml_parse_mem(ctx, "<x xmlns=\"urn:a\" a=\"0123456789abcdef0123456789\x02\"/>", 0));
+    assert_null(lyxml_parse_mem(ctx, "<x xmlns=\"urn:a\"><bubba>0123456789abcdef]]>0123456789</bubba></x>", 0));
+}
+
 static void
 test_lyxml_free(void **state)
 {
@@ -436,6 +474,37 @@ test_lyxml_get_ns(void **state)
     lyxml_free(ctx, xml);
 }
 
+static void
+test_lyxml_ns_scope(void **state)
+{
+    (void) state; /* unused */
+    struct lyxml_elem *xml, *b, *c, *d, *e;
+    const char *data = "<a xmlns=\"urn:a\" xmlns:p=\"urn:p\"><b><c xmlns=\"urn:c\"><d p:x=\"1\"/></c>"
+                       "<p:e xmlns:p=\"urn:q\"><f/><p:g/></p:e><h xmlns=\"\"/></b></a>";
+
+    xml = lyxml_parse_mem(ctx, data, 0);
+    assert_ptr_not_equal(xml, NULL);
+
+    b = xml->child;
+    c = b->child;
+    d = c->child;
+    e = c->next;
+    assert_string_equal(b->ns->value, "urn:a");
+    assert_string_equal(c->ns->value, "urn:c");
+    assert_string_equal(d->ns->value, "urn:c");
+    assert_string_equal(d->attr->ns->value, "urn:p");
+    assert_string_equal(e->ns->value, "urn:q");
+    assert_string_equal(e->child->ns->value, "urn:a");
+    assert_string_equal(e->child->next->ns->value, "urn:q");
+    assert_string_equal(e->next->ns->value, "");
+
+    assert_string_equal(lyxml_get_ns(d, "p")->value, "urn:p");
+    assert_string_equal(lyxml_get_ns(e->child, "p")->value, "urn:q");
+    assert_ptr_equal(lyxml_get_ns(d, "q"), NULL);
+
+    lyxml_free(ctx, xml);
+}
+
 void
 test_lyxml_dup(void **state)
 {
@@ -488,6 +557,7 @@ int main(void)
 {
     const struct CMUnitTest tests[] = {
         cmocka_unit_test_setup_teardown(test_lyxml_parse_mem, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_lyxml_parse_mem_text, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_lyxml_free, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_lyxml_parse_path, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_lyxml_print_file, setup_f, teardown_f),
@@ -497,6 +567,7 @@ int main(void)
         cmocka_unit_test_setup_teardown(test_lyxml_unlink, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_lyxml_get_attr, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_lyxml_get_ns, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_lyxml_ns_scope, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_lyxml_dup, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_lyxml_free_withsiblings, setup_f, teardown_f),
     };
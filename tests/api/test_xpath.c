@@ -285,6 +285,213 @@ test_advanced(void **state)
     st->set = NULL;
 }
 
+static void
+test_key_predicates(void **state)
+{
+    struct state *st = (*state);
+    char path[64];
+    int i;
+
+    /* enough instances for the list to be hashed */
+    for (i = 3; i < 10; ++i) {
+        sprintf(path, "/ietf-interfaces:interfaces/interface[name='iface%d']/type", i);
+        assert_ptr_not_equal(lyd_new_path(st->dt, NULL, path, "iana-if-type:ethernetCsmacd", 0, 0), NULL);
+    }
+
+    st->set = lyd_find_path(st->dt, "/ietf-interfaces:interfaces/interface[name='iface7']");
+    assert_ptr_not_equal(st->set, NULL);
+    assert_int_equal(st->set->number, 1);
+    assert_string_equal(((struct lyd_node_leaf_list *)st->set->set.d[0]->child)->value_str, "iface7");
+    ly_set_free(st->set);
+    st->set = NULL;
+
+    st->set = lyd_find_path(st->dt, "/ietf-interfaces:interfaces/ietf-interfaces:interface[ietf-interfaces:name='iface2']/type");
+    assert_ptr_not_equal(st->set, NULL);
+    assert_int_equal(st->set->number, 1);
+    assert_string_equal(((struct lyd_node_leaf_list *)st->set->set.d[0])->value_str, "iana-if-type:softwareLoopback");
+    ly_set_free(st->set);
+    st->set = NULL;
+
+    st->set = lyd_find_path(st->dt, "/ietf-interfaces:interfaces/interface[name='iface10']");
+    assert_ptr_not_equal(st->set, NULL);
+    assert_int_equal(st->set->number, 0);
+    ly_set_free(st->set);
+    st->set = NULL;
+
+    /* further predicates are evaluated on the found instance */
+    st->set = lyd_find_path(st->dt, "/ietf-interfaces:interfaces/interface[name='iface1'][enabled='false']");
+    assert_ptr_not_equal(st->set, NULL);
+    assert_int_equal(st->set->number, 0);
+    ly_set_free(st->set);
+    st->set = NULL;
+
+    st->set = lyd_find_path(st->dt, "/ietf-interfaces:interfaces/interface[name='iface1'][1]");
+    assert_ptr_not_equal(st->set, NULL);
+    assert_int_equal(st->set->number, 1);
+    ly_set_free(st->set);
+    st->set = NULL;
+
+    /* several context nodes */
+    st->set = lyd_find_path(st->dt, "/ietf-interfaces:interfaces/interface/ietf-ip:ipv4/ietf-ip:address[ietf-ip:ip='10.0.0.5']");
+    assert_ptr_not_equal(st->set, NULL);
+    assert_int_equal(st->set->number, 1);
+    ly_set_free(st->set);
+    st->set = NULL;
+}
+
+static void
+test_descendants(void **state)
+{
+    struct state *st = (*state);
+
+    st->set = lyd_find_path(st->dt, "//ietf-ip:ip");
+    assert_ptr_not_equal(st->set, NULL);
+    assert_int_equal(st->set->number, 10);
+    ly_set_free(st->set);
+    st->set = NULL;
+
+    /* augment nodes */
+    st->set = lyd_find_path(st->dt, "/ietf-interfaces:interfaces//ietf-ip:ipv6//ietf-ip:ip");
+    assert_ptr_not_equal(st->set, NULL);
+    assert_int_equal(st->set->number, 4);
+    ly_set_free(st->set);
+    st->set = NULL;
+
+    /* nodes of the augmented module are not found in the augments */
+    st->set = lyd_find_path(st->dt, "//ietf-interfaces:name");
+    assert_ptr_not_equal(st->set, NULL);
+    assert_int_equal(st->set->number, 2);
+    ly_set_free(st->set);
+    st->set = NULL;
+
+    st->set = lyd_find_path(st->dt, "//ietf-interfaces:ip");
+    assert_ptr_not_equal(st->set, NULL);
+    assert_int_equal(st->set->number, 0);
+    ly_set_free(st->set);
+    st->set = NULL;
+}
+
+static void
+test_node_set_equality(void **state)
+{
+    struct state *st = (*state);
+    char path[96], value[16];
+    int i;
+
+    /* leaf values compared with literals */
+    st->set = lyd_find_path(st->dt, "/ietf-interfaces:interfaces/interface[enabled != 'true']");
+    assert_ptr_not_equal(st->set, NULL);
+    assert_int_equal(st->set->number, 1);
+    assert_string_equal(((struct lyd_node_leaf_list *)st->set->set.d[0]->child)->value_str, "iface2");
+    ly_set_free(st->set);
+    st->set = NULL;
+
+    st->set = lyd_find_path(st->dt, "/ietf-interfaces:interfaces/interface['iface2' = name]/description");
+    assert_ptr_not_equal(st->set, NULL);
+    assert_int_equal(st->set->number, 1);
+    assert_string_equal(((struct lyd_node_leaf_list *)st->set->set.d[0])->value_str, "iface2 dsc");
+    ly_set_free(st->set);
+    st->set = NULL;
+
+    /* small node-sets */
+    st->set = lyd_find_path(st->dt, "/ietf-interfaces:interfaces/interface[ietf-ip:ipv4/ietf-ip:address/ietf-ip:ip = "
+                            "/ietf-interfaces:interfaces/interface/ietf-ip:ipv4/ietf-ip:neighbor/ietf-ip:ip]");
+    assert_ptr_not_equal(st->set, NULL);
+    assert_int_equal(st->set->number, 1);
+    assert_string_equal(((struct lyd_node_leaf_list *)st->set->set.d[0]->child)->value_str, "iface1");
+    ly_set_free(st->set);
+    st->set = NULL;
+
+    st->set = lyd_find_path(st->dt, "/ietf-interfaces:interfaces/interface[name != ../interface[name = 'iface1']/name]");
+    assert_ptr_not_equal(st->set, NULL);
+    assert_int_equal(st->set->number, 1);
+    assert_string_equal(((struct lyd_node_leaf_list *)st->set->set.d[0]->child)->value_str, "iface2");
+    ly_set_free(st->set);
+    st->set = NULL;
+
+    /* node-sets large enough to be hashed, each description is the name of another interface */
+    for (i = 3; i < 10; ++i) {
+        sprintf(path, "/ietf-interfaces:interfaces/interface[name='iface%d']/description", i);
+        sprintf(value, "iface%d", i - 1);
+        assert_ptr_not_equal(lyd_new_path(st->dt, NULL, path, value, 0, 0), NULL);
+    }
+
+    st->set = lyd_find_path(st->dt, "/ietf-interfaces:interfaces/interface[../interface/description = name]");
+    assert_ptr_not_equal(st->set, NULL);
+    assert_int_equal(st->set->number, 7);
+    ly_set_free(st->set);
+    st->set = NULL;
+
+    st->set = lyd_find_path(st->dt, "/ietf-interfaces:interfaces/interface[../interface/description = ../interface/name]");
+    assert_ptr_not_equal(st->set, NULL);
+    assert_int_equal(st->set->number, 9);
+    ly_set_free(st->set);
+    st->set = NULL;
+
+    st->set = lyd_find_path(st->dt, "/ietf-interfaces:interfaces/interface[../interface/description = 'iface9']");
+    assert_ptr_not_equal(st->set, NULL);
+    assert_int_equal(st->set->number, 0);
+    ly_set_free(st->set);
+    st->set = NULL;
+
+    st->set = lyd_find_path(st->dt, "/ietf-interfaces:interfaces/interface[../interface/name != ../interface/name]");
+    assert_ptr_not_equal(st->set, NULL);
+    assert_int_equal(st->set->number, 9);
+    ly_set_free(st->set);
+    st->set = NULL;
+
+    /* containers are still cast into strings */
+    st->set = lyd_find_path(st->dt, "/ietf-interfaces:interfaces/interface[ietf-ip:ipv4 = ../interface/name]");
+    assert_ptr_not_equal(st->set, NULL);
+    assert_int_equal(st->set->number, 0);
+    ly_set_free(st->set);
+    st->set = NULL;
+}
+
+static void
+test_predicate_threads(void **state)
+{
+    struct state *st = (*state);
+    const char *paths[] = {
+        "/ietf-interfaces:interfaces/interface[description = 'odd']",
+        "/ietf-interfaces:interfaces/interface[position() mod 3 = 0]/name",
+        "/ietf-interfaces:interfaces/interface[name = /ietf-interfaces:interfaces/interface[description = 'even']/name]",
+        "/ietf-interfaces:interfaces/interface[not(description)]"
+    };
+    struct ly_set *set;
+    char path[96];
+    unsigned int i, j;
+
+    /* enough interfaces to be split among the threads */
+    for (i = 0; i < 5000; ++i) {
+        sprintf(path, "/ietf-interfaces:interfaces/interface[name='if%u']/description", i);
+        assert_ptr_not_equal(lyd_new_path(st->dt, NULL, path, (i % 2) ? "odd" : "even", 0, 0), NULL);
+    }
+
+    for (i = 0; i < sizeof paths / sizeof *paths; ++i) {
+        ly_ctx_set_xpath_threads(st->ctx, 0);
+        st->set = lyd_find_path(st->dt, paths[i]);
+        assert_ptr_not_equal(st->set, NULL);
+
+        /* the same nodes in the same order */
+        ly_ctx_set_xpath_threads(st->ctx, 4);
+        set = lyd_find_path(st->dt, paths[i]);
+        assert_ptr_not_equal(set, NULL);
+        assert_int_equal(set->number, st->set->number);
+        for (j = 0; j < set->number; ++j) {
+            assert_ptr_equal(set->set.d[j], st->set->set.d[j]);
+        }
+        ly_set_free(set);
+        ly_set_free(st->set);
+        st->set = NULL;
+    }
+
+    /* errors are reported as well */
+    st->set = lyd_find_path(st->dt, "/ietf-interfaces:interfaces/interface[substring(name)]");
+    assert_ptr_equal(st->set, NULL);
+    assert_int_equal(ly_errno, LY_EVALID);
+}
+
 static void
 test_functions_operators(void **state)
 {
@@ -359,6 +566,89 @@ test_functions_operators(void **state)
     assert_int_equal(st->set->number, 15);
     ly_set_free(st->set);
     st->set = NULL;
+
+    /* union operands in the reverse document order */
+    st->set = lyd_find_path(st->dt, "(//ietf-ip:neighbor/ietf-ip:ip | //ietf-ip:address/ietf-ip:ip)[1]");
+    assert_ptr_not_equal(st->set, NULL);
+    assert_int_equal(st->set->number, 1);
+    assert_string_equal(((struct lyd_node_leaf_list *)st->set->set.d[0])->value_str, "10.0.0.1");
+    ly_set_free(st->set);
+    st->set = NULL;
+
+    st->set = lyd_find_path(st->dt, "/ietf-interfaces:interfaces/interface[name = string(//ietf-interfaces:description | //ietf-interfaces:name)]");
+    assert_ptr_not_equal(st->set, NULL);
+    assert_int_equal(st->set->number, 1);
+    ly_set_free(st->set);
+    st->set = NULL;
+
+    st->set = lyd_find_path(st->dt, "//ietf-ip:neighbor/ietf-ip:ip | //ietf-ip:address/ietf-ip:ip | //ietf-ip:neighbor/ietf-ip:ip");
+    assert_ptr_not_equal(st->set, NULL);
+    assert_int_equal(st->set->number, 10);
+    assert_string_equal(((struct lyd_node_leaf_list *)st->set->set.d[0])->value_str, "10.0.0.1");
+    assert_string_equal(((struct lyd_node_leaf_list *)st->set->set.d[1])->value_str, "172.0.0.1");
+    assert_string_equal(((struct lyd_node_leaf_list *)st->set->set.d[2])->value_str, "10.0.0.2");
+    ly_set_free(st->set);
+    st->set = NULL;
+
+    /* boolean contexts */
+    st->set = lyd_find_path(st->dt, "/ietf-interfaces:interfaces/interface[ietf-ip:ipv4/ietf-ip:address/ietf-ip:netmask and not(ietf-ip:ipv4/ietf-ip:mtu)]");
+    assert_ptr_not_equal(st->set, NULL);
+    assert_int_equal(st->set->number, 1);
+    assert_string_equal(((struct lyd_node_leaf_list *)st->set->set.d[0]->child)->value_str, "iface2");
+    ly_set_free(st->set);
+    st->set = NULL;
+
+    st->set = lyd_find_path(st->dt, "/ietf-interfaces:interfaces/interface[boolean(.//ietf-ip:neighbor[ietf-ip:ip = '10.0.0.1']) or (ietf-ip:ipv4/ietf-ip:mtu)]");
+    assert_ptr_not_equal(st->set, NULL);
+    assert_int_equal(st->set->number, 2);
+    ly_set_free(st->set);
+    st->set = NULL;
+
+    st->set = lyd_find_path(st->dt, "/ietf-interfaces:interfaces/interface[.//ietf-ip:autoconf]");
+    assert_ptr_not_equal(st->set, NULL);
+    assert_int_equal(st->set->number, 2);
+    ly_set_free(st->set);
+    st->set = NULL;
+
+    st->set = lyd_find_path(st->dt, "/ietf-interfaces:interfaces/interface[count(.//ietf-ip:ip) = 5 and .//ietf-ip:ip = '172.0.0.5']");
+    assert_ptr_not_equal(st->set, NULL);
+    assert_int_equal(st->set->number, 1);
+    assert_string_equal(((struct lyd_node_leaf_list *)st->set->set.d[0]->child)->value_str, "iface2");
+    ly_set_free(st->set);
+    st->set = NULL;
+}
+
+static void
+test_numbers(void **state)
+{
+    struct state *st = (*state);
+
+    st->set = lyd_find_path(st->dt, "/ietf-interfaces:interfaces/interface[ietf-ip:ipv4/ietf-ip:mtu * 2 = 136 and ietf-ip:ipv4/ietf-ip:mtu div 3 > 22.6 and ietf-ip:ipv4/ietf-ip:mtu mod 5 = 3]");
+    assert_ptr_not_equal(st->set, NULL);
+    assert_int_equal(st->set->number, 1);
+    assert_string_equal(((struct lyd_node_leaf_list *)st->set->set.d[0]->child)->value_str, "iface1");
+    ly_set_free(st->set);
+    st->set = NULL;
+
+    st->set = lyd_find_path(st->dt, "(/ietf-interfaces:interfaces/interface)[7 div 2 - 1.5]");
+    assert_ptr_not_equal(st->set, NULL);
+    assert_int_equal(st->set->number, 1);
+    assert_string_equal(((struct lyd_node_leaf_list *)st->set->set.d[0]->child)->value_str, "iface2");
+    ly_set_free(st->set);
+    st->set = NULL;
+
+    /* negative zero, NaN, and integers beyond the double precision */
+    st->set = lyd_find_path(st->dt, "/ietf-interfaces:interfaces/interface[1 div (0 * -5) < 0 and 1 div -(3 - 3) < 0 and not(10 mod 0 = 10 mod 0) and string(9007199254740992 + 1) = '9007199254740993' and string(5 div 2) = '2.5']");
+    assert_ptr_not_equal(st->set, NULL);
+    assert_int_equal(st->set->number, 2);
+    ly_set_free(st->set);
+    st->set = NULL;
+
+    st->set = lyd_find_path(st->dt, "/ietf-interfaces:interfaces/interface[sum(.//ietf-ip:prefix-length) = 80 and sum(.//ietf-ip:prefix-length | .//ietf-ip:mtu) != 80.5]");
+    assert_ptr_not_equal(st->set, NULL);
+    assert_int_equal(st->set->number, 2);
+    ly_set_free(st->set);
+    st->set = NULL;
 }
 
 int main(void)
@@ -367,7 +657,12 @@ int main(void)
                     cmocka_unit_test_setup_teardown(test_invalid, setup_f, teardown_f),
                     cmocka_unit_test_setup_teardown(test_simple, setup_f, teardown_f),
                     cmocka_unit_test_setup_teardown(test_advanced, setup_f, teardown_f),
+                    cmocka_unit_test_setup_teardown(test_key_predicates, setup_f, teardown_f),
+                    cmocka_unit_test_setup_teardown(test_node_set_equality, setup_f, teardown_f),
+                    cmocka_unit_test_setup_teardown(test_predicate_threads, setup_f, teardown_f),
+                    cmocka_unit_test_setup_teardown(test_descendants, setup_f, teardown_f),
                     cmocka_unit_test_setup_teardown(test_functions_operators, setup_f, teardown_f),
+                    cmocka_unit_test_setup_teardown(test_numbers, setup_f, teardown_f),
                     };
 
     return cmocka_run_group_tests(tests, NULL, NULL);
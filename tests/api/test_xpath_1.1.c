@@ -46,6 +46,12 @@ static const char *data2 =
 "</top>"
 ;
 
+static const char *data3 =
+"<top xmlns=\"urn:xpath-1.1\">"
+    "<identref>ident3</identref>"
+"</top>"
+;
+
 static int
 setup_f(void **state)
 {
@@ -109,6 +115,22 @@ test_func_re_match(void **state)
     st->set = lyd_find_path(st->dt, "/xpath-1.1:top/*[re-match(., 'a+b+c+')]");
     assert_ptr_not_equal(st->set, NULL);
     assert_int_equal(st->set->number, 2);
+    ly_set_free(st->set);
+
+    /* the compiled pattern is reused */
+    st->set = lyd_find_path(st->dt, "/xpath-1.1:top/*[re-match(., 'a+b+c+')]");
+    assert_ptr_not_equal(st->set, NULL);
+    assert_int_equal(st->set->number, 2);
+    ly_set_free(st->set);
+
+    st->set = lyd_find_path(st->dt, "/xpath-1.1:top/*[re-match(., 'a+b+')]");
+    assert_ptr_not_equal(st->set, NULL);
+    assert_int_equal(st->set->number, 1);
+    ly_set_free(st->set);
+
+    st->set = lyd_find_path(st->dt, "/xpath-1.1:top/*[re-match(., '[a-c$]*')]");
+    assert_ptr_not_equal(st->set, NULL);
+    assert_int_equal(st->set->number, 3);
 }
 
 static void
@@ -231,6 +253,34 @@ test_func_derived_from_or_self4(void **state)
     assert_int_equal(st->set->number, 1);
 }
 
+static void
+test_func_derived_from_indirect(void **state)
+{
+    struct state *st = (*state);
+
+    st->dt = lyd_parse_mem(st->ctx, data3, LYD_XML, LYD_OPT_CONFIG);
+    assert_ptr_not_equal(st->dt, NULL);
+
+    st->set = lyd_find_path(st->dt, "/xpath-1.1:top/*[derived-from(., 'ident1')]");
+    assert_ptr_not_equal(st->set, NULL);
+    assert_int_equal(st->set->number, 1);
+    ly_set_free(st->set);
+
+    st->set = lyd_find_path(st->dt, "/xpath-1.1:top/*[derived-from(., 'xpath-1.1:ident2')]");
+    assert_ptr_not_equal(st->set, NULL);
+    assert_int_equal(st->set->number, 1);
+    ly_set_free(st->set);
+
+    st->set = lyd_find_path(st->dt, "/xpath-1.1:top/*[derived-from(., 'ident3')]");
+    assert_ptr_not_equal(st->set, NULL);
+    assert_int_equal(st->set->number, 0);
+    ly_set_free(st->set);
+
+    st->set = lyd_find_path(st->dt, "/xpath-1.1:top/*[derived-from-or-self(., 'ident3')]");
+    assert_ptr_not_equal(st->set, NULL);
+    assert_int_equal(st->set->number, 1);
+}
+
 static void
 test_func_enum_value1(void **state)
 {
@@ -297,6 +347,7 @@ main(void)
         cmocka_unit_test_setup_teardown(test_func_derived_from_or_self2, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_func_derived_from_or_self3, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_func_derived_from_or_self4, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_func_derived_from_indirect, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_func_enum_value1, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_func_enum_value2, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_func_bit_is_set1, setup_f, teardown_f),
@@ -0,0 +1,84 @@
+#!/bin/sh
+#
+# Callgrind regression gate. Runs every scenario of the scenarios binary under callgrind and
+# compares the instruction count of its instrumented part with the baseline file. Fails if any
+# count rises by more than CALLGRIND_THRESHOLD percent (default 2). With -u, the baseline file
+# is rewritten with the current counts instead. Without any recorded count in the baseline file
+# or without valgrind, nothing can be checked and it fails.
+#
+# usage: check.sh <scenarios-binary> <baseline-file> [-u]
+
+# scenario:count pairs, a small and a large generated input of each to catch scaling regressions
+SCENARIOS="parse_xml:1000 parse_xml:20000
+parse_json:1000 parse_json:20000
+parse_lyb:1000 parse_lyb:20000
+validate:100 validate:1000
+xpath:1000 xpath:20000
+diff:1000 diff:20000
+merge:1000 merge:20000
+print_xml:1000 print_xml:20000
+print_json:1000 print_json:20000"
+
+if [ $# -lt 2 ]; then
+    echo "usage: $0 <scenarios-binary> <baseline-file> [-u]" >&2
+    exit 2
+fi
+BIN="$1"
+BASELINE="$2"
+UPDATE=0
+if [ "$3" = "-u" ]; then
+    UPDATE=1
+fi
+THRESHOLD=${CALLGRIND_THRESHOLD:-2}
+
+if [ $UPDATE -eq 0 ] && ! grep -q '^[^#]' "$BASELINE" 2>/dev/null; then
+    echo "No instruction counts recorded in $BASELINE, record them with \"make callgrind_baseline\"." >&2
+    exit 2
+fi
+if ! command -v valgrind >/dev/null 2>&1; then
+    echo "valgrind not found." >&2
+    exit 2
+fi
+
+OUT=$(mktemp -d) || exit 2
+trap 'rm -rf "$OUT"' EXIT
+
+RET=0
+for item in $SCENARIOS; do
+    name="${item%%:*}-${item##*:}"
+
+    if ! valgrind --tool=callgrind --instr-atstart=no --callgrind-out-file="$OUT/$name.out" \
+            "$BIN" "${item%%:*}" "${item##*:}" >"$OUT/$name.log" 2>&1; then
+        cat "$OUT/$name.log" >&2
+        echo "$name: FAILED to run" >&2
+        RET=1
+        continue
+    fi
+    count=$(sed -n -e 's/^summary: *\([0-9]*\).*/\1/p' -e 's/^totals: *\([0-9]*\).*/\1/p' "$OUT/$name.out" | tail -n 1)
+    if [ -z "$count" ]; then
+        echo "$name: FAILED, no instruction count in the callgrind output" >&2
+        RET=1
+        continue
+    fi
+    echo "$name $count" >>"$OUT/counts"
+
+    base=$(sed -n "s/^$name \([0-9]*\)$/\1/p" "$BASELINE" 2>/dev/null)
+    if [ -z "$base" ]; then
+        echo "$name: $count (no baseline)"
+    elif [ $((count * 100)) -gt $((base * (100 + THRESHOLD))) ]; then
+        echo "$name: $count, REGRESSION against the baseline $base (+$(((count - base) * 100 / base))%)"
+        RET=1
+    else
+        echo "$name: $count, baseline $base"
+    fi
+done
+
+if [ $UPDATE -eq 1 ]; then
+    grep '^#' "$BASELINE" >"$OUT/baseline" 2>/dev/null
+    cat "$OUT/counts" >>"$OUT/baseline"
+    cp "$OUT/baseline" "$BASELINE" || exit 2
+    echo "Baseline $BASELINE updated."
+    exit 0
+fi
+
+exit $RET
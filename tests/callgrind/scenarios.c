@@ -0,0 +1,206 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <valgrind/callgrind.h>
+
+#include "tests/config.h"
+#include "libyang.h"
+
+#define SCHEMA_LISTS TESTS_DIR "/callgrind/files/lists.yang"
+#define SCHEMA_XPATH TESTS_DIR "/callgrind/files/xpath.yang"
+
+#define PARSE_OPTS (LYD_OPT_CONFIG | LYD_OPT_STRICT)
+
+/* generate lists data with count list entries and leaf-list instances, like files/gen_list.sh,
+ * every step-th entry (if non-zero) gets a different leaf value and every (step + 1)-th is left out */
+static char *
+gen_lists(int count, int step)
+{
+    char *data = NULL, *item;
+    size_t len = 0, ilen;
+    int i;
+
+    data = strdup("<cont xmlns=\"urn:libyang:test:lists\">");
+    len = strlen(data);
+    for (i = 0; i < count; ++i) {
+        if (step && !(i % (step + 1))) {
+            continue;
+        }
+        ilen = asprintf(&item, "<list1><key1>vl%d</key1><leaf1>%d</leaf1></list1>", i,
+                        (step && !(i % step)) ? i + 1 : i);
+        data = realloc(data, len + ilen + 1);
+        strcpy(data + len, item);
+        len += ilen;
+        free(item);
+    }
+    for (i = 0; i < count; ++i) {
+        ilen = asprintf(&item, "<llist1>vl%d</llist1>", i);
+        data = realloc(data, len + ilen + 1);
+        strcpy(data + len, item);
+        len += ilen;
+        free(item);
+    }
+    data = realloc(data, len + 8);
+    strcpy(data + len, "</cont>");
+
+    return data;
+}
+
+/* generate xpath data with count list1 and list2 instances, each list1 must refers to its list2 */
+static char *
+gen_xpath(int count)
+{
+    char *data = NULL, *item;
+    size_t len = 0, ilen;
+    int i, j;
+
+    data = strdup("<cont1 xmlns=\"urn:libyang:test:xpath\">");
+    len = strlen(data);
+    for (j = 0; j < 2; ++j) {
+        for (i = 0; i < count; ++i) {
+            ilen = asprintf(&item, "<list%d><key%d>a%d</key%d></list%d>", j + 1, j + 1, i, j + 1, j + 1);
+            data = realloc(data, len + ilen + 1);
+            strcpy(data + len, item);
+            len += ilen;
+            free(item);
+        }
+    }
+    data = realloc(data, len + 9);
+    strcpy(data + len, "</cont1>");
+
+    return data;
+}
+
+int
+main(int argc, char **argv)
+{
+    int ret = 0, count, i;
+    const char *scenario;
+    char *str = NULL, *path;
+    struct ly_ctx *ctx = NULL;
+    struct lyd_node *data = NULL, *data2 = NULL;
+    struct lyd_difflist *diff = NULL;
+    struct ly_set *set;
+
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s parse_xml|parse_json|parse_lyb|validate|xpath|diff|merge|print_xml|print_json <count>\n",
+                argv[0]);
+        return 1;
+    }
+    scenario = argv[1];
+    count = atoi(argv[2]);
+
+    ctx = ly_ctx_new(NULL, 0);
+    if (!ctx) {
+        ret = 1;
+        goto finish;
+    }
+
+    if (!strcmp(scenario, "validate")) {
+        if (!lys_parse_path(ctx, SCHEMA_XPATH, LYS_YANG)) {
+            ret = 1;
+            goto finish;
+        }
+
+        /* only the validation of the musts is measured */
+        str = gen_xpath(count);
+        data = lyd_parse_mem(ctx, str, LYD_XML, PARSE_OPTS | LYD_OPT_TRUSTED);
+        if (!data) {
+            ret = 1;
+            goto finish;
+        }
+
+        CALLGRIND_START_INSTRUMENTATION;
+        ret = lyd_validate(&data, PARSE_OPTS, NULL);
+        CALLGRIND_STOP_INSTRUMENTATION;
+        goto finish;
+    }
+
+    if (!lys_parse_path(ctx, SCHEMA_LISTS, LYS_YANG)) {
+        ret = 1;
+        goto finish;
+    }
+    str = gen_lists(count, 0);
+
+    if (!strcmp(scenario, "parse_xml")) {
+        CALLGRIND_START_INSTRUMENTATION;
+        data = lyd_parse_mem(ctx, str, LYD_XML, PARSE_OPTS);
+        CALLGRIND_STOP_INSTRUMENTATION;
+        ret = data ? 0 : 1;
+        goto finish;
+    }
+
+    data = lyd_parse_mem(ctx, str, LYD_XML, PARSE_OPTS);
+    if (!data) {
+        ret = 1;
+        goto finish;
+    }
+    free(str);
+    str = NULL;
+
+    if (!strcmp(scenario, "parse_json") || !strcmp(scenario, "parse_lyb")) {
+        LYD_FORMAT format = (scenario[6] == 'j') ? LYD_JSON : LYD_LYB;
+
+        if (lyd_print_mem(&str, data, format, LYP_WITHSIBLINGS)) {
+            ret = 1;
+            goto finish;
+        }
+        lyd_free_withsiblings(data);
+
+        CALLGRIND_START_INSTRUMENTATION;
+        data = lyd_parse_mem(ctx, str, format, PARSE_OPTS);
+        CALLGRIND_STOP_INSTRUMENTATION;
+        ret = data ? 0 : 1;
+    } else if (!strcmp(scenario, "xpath")) {
+        CALLGRIND_START_INSTRUMENTATION;
+        /* key lookups (hash tables) and a full scan with a predicate */
+        for (i = 0; i < count; i += count / 100 + 1) {
+            asprintf(&path, "/lists:cont/list1[key1='vl%d']/leaf1", i);
+            set = lyd_find_path(data, path);
+            free(path);
+            if (!set || (set->number != 1)) {
+                ret = 1;
+            }
+            ly_set_free(set);
+        }
+        set = lyd_find_path(data, "/lists:cont/list1[leaf1 mod 2 = 0]");
+        if (!set || (set->number != (unsigned)(count + 1) / 2)) {
+            ret = 1;
+        }
+        ly_set_free(set);
+        CALLGRIND_STOP_INSTRUMENTATION;
+    } else if (!strcmp(scenario, "diff") || !strcmp(scenario, "merge")) {
+        str = gen_lists(count, 10);
+        data2 = lyd_parse_mem(ctx, str, LYD_XML, PARSE_OPTS);
+        if (!data2) {
+            ret = 1;
+            goto finish;
+        }
+
+        CALLGRIND_START_INSTRUMENTATION;
+        if (scenario[0] == 'd') {
+            diff = lyd_diff(data, data2, 0);
+            ret = diff ? 0 : 1;
+        } else {
+            ret = lyd_merge(data, data2, 0);
+        }
+        CALLGRIND_STOP_INSTRUMENTATION;
+    } else if (!strcmp(scenario, "print_xml") || !strcmp(scenario, "print_json")) {
+        CALLGRIND_START_INSTRUMENTATION;
+        ret = lyd_print_mem(&str, data, (scenario[6] == 'x') ? LYD_XML : LYD_JSON, LYP_WITHSIBLINGS);
+        CALLGRIND_STOP_INSTRUMENTATION;
+    } else {
+        fprintf(stderr, "Unknown scenario \"%s\".\n", scenario);
+        ret = 1;
+    }
+
+finish:
+    free(str);
+    lyd_free_diff(diff);
+    lyd_free_withsiblings(data);
+    lyd_free_withsiblings(data2);
+    ly_ctx_destroy(ctx, NULL);
+    return ret;
+}
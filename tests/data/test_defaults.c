@@ -528,6 +528,114 @@ test_val_diff(void **state)
     lyd_free_val_diff(diff);
 }
 
+static void
+test_val_diff_ref(void **state)
+{
+    struct state *st = (*state);
+    struct lyd_val_change *changes;
+    char *path;
+    int ret;
+
+    st->dt = lyd_new_path(NULL, st->ctx, "/defaults2:l1[k='when-true']", NULL, 0, 0);
+    assert_non_null(st->dt);
+
+    ret = lyd_validate_modules(&st->dt, &st->mod2, 1, LYD_OPT_CONFIG | LYD_OPT_VAL_DIFF | LYD_OPT_VAL_DIFF_REF, &changes);
+    assert_int_equal(ret, 0);
+
+    /* created nodes are referenced in the tree */
+    assert_int_equal(changes[0].type, LYD_DIFF_CREATED);
+    assert_string_equal(changes[0].schema->name, "cont1");
+    assert_ptr_equal(changes[0].parent, st->dt);
+    assert_ptr_equal(changes[0].node->parent, st->dt);
+    assert_string_equal(changes[0].node->child->child->schema->name, "dflt1");
+    path = lyd_val_change_path(&changes[0]);
+    assert_string_equal(path, "/defaults2:l1[k='when-true']/cont1");
+    free(path);
+    assert_int_equal(changes[1].type, LYD_DIFF_CREATED);
+    assert_string_equal(changes[1].schema->name, "dflt2");
+    assert_ptr_equal(changes[1].node->parent, NULL);
+    path = lyd_val_change_path(&changes[1]);
+    assert_string_equal(path, "/defaults2:dflt2");
+    free(path);
+    assert_int_equal(changes[2].type, LYD_DIFF_END);
+
+    lyd_free_val_changes(changes);
+
+    st->dt = st->dt->next;
+    lyd_free(st->dt->prev);
+
+    ret = lyd_validate_modules(&st->dt, &st->mod2, 1, LYD_OPT_CONFIG | LYD_OPT_VAL_DIFF | LYD_OPT_VAL_DIFF_REF, &changes);
+    assert_int_equal(ret, 0);
+
+    /* deleted nodes are only described */
+    assert_int_equal(changes[0].type, LYD_DIFF_DELETED);
+    assert_string_equal(changes[0].schema->name, "dflt2");
+    assert_ptr_equal(changes[0].node, NULL);
+    assert_ptr_equal(changes[0].parent, NULL);
+    assert_non_null(changes[0].value);
+    path = lyd_val_change_path(&changes[0]);
+    assert_string_equal(path, "/defaults2:dflt2");
+    free(path);
+    assert_int_equal(changes[1].type, LYD_DIFF_END);
+
+    lyd_free_val_changes(changes);
+
+    /* not a diff option on its own */
+    ret = lyd_validate_modules(&st->dt, &st->mod2, 1, LYD_OPT_CONFIG | LYD_OPT_VAL_DIFF_REF, &changes);
+    assert_int_not_equal(ret, 0);
+}
+
+static void
+test_virtual_dflt(void **state)
+{
+    struct state *st = (*state);
+    const struct lys_module *mod;
+    struct ly_set *set;
+    const char *yang = "module x {"
+                       "  namespace urn:x;"
+                       "  prefix x;"
+                       "  container c {"
+                       "    presence \"c\";"
+                       "    leaf a { type string; }"
+                       "    leaf d { type uint8; default 5; }"
+                       "    leaf r { type leafref { path \"../d\"; } default 5; }"
+                       "  }"
+                       "}";
+
+    ly_ctx_destroy(st->ctx, NULL);
+    st->ctx = ly_ctx_new(NULL, LY_CTX_VIRTUAL_DFLT);
+    assert_ptr_not_equal(st->ctx, NULL);
+    mod = lys_parse_mem(st->ctx, yang, LYS_IN_YANG);
+    assert_ptr_not_equal(mod, NULL);
+
+    st->dt = lyd_new_path(NULL, st->ctx, "/x:c/a", "val", 0, 0);
+    assert_ptr_not_equal(st->dt, NULL);
+    assert_int_equal(lyd_validate(&st->dt, LYD_OPT_CONFIG, NULL), 0);
+
+    /* only the leafref default was created */
+    assert_string_equal(st->dt->child->schema->name, "a");
+    assert_string_equal(st->dt->child->next->schema->name, "r");
+    assert_ptr_equal(st->dt->child->next->next, NULL);
+
+    /* printed with with-defaults, removed afterwards */
+    assert_int_equal(lyd_print_mem(&st->xml, st->dt, LYD_XML, LYP_WD_ALL), 0);
+    assert_string_equal(st->xml, "<c xmlns=\"urn:x\"><a>val</a><r>5</r><d>5</d></c>");
+    assert_ptr_equal(st->dt->child->next->next, NULL);
+    free(st->xml);
+    st->xml = NULL;
+    assert_int_equal(lyd_print_mem(&st->xml, st->dt, LYD_XML, 0), 0);
+    assert_string_equal(st->xml, "<c xmlns=\"urn:x\"><a>val</a></c>");
+
+    /* found by a lookup, stays in the tree from now on */
+    set = lyd_find_path(st->dt, "/x:c/d");
+    assert_ptr_not_equal(set, NULL);
+    assert_int_equal(set->number, 1);
+    assert_int_equal(set->set.d[0]->dflt, 1);
+    assert_string_equal(((struct lyd_node_leaf_list *)set->set.d[0])->value_str, "5");
+    assert_ptr_equal(set->set.d[0]->parent, st->dt);
+    ly_set_free(set);
+}
+
 static void
 test_feature(void **state)
 {
@@ -661,6 +769,33 @@ test_leaflist_yang(void **state)
     assert_string_equal(st->xml, xml_three);
 }
 
+static void
+test_trim_nested(void **state)
+{
+    struct state *st = (*state);
+    const char *yang = "module n {namespace urn:n; prefix n;"
+        "container a {leaf d {type uint8; default 1;}"
+        "  container b {leaf d {type uint8; default 1;}"
+        "    container c {leaf d {type uint8; default 1;} leaf s {type uint8; config false;}"
+        "      container e {leaf d {type uint8; default 1;}}}}}"
+        "container x {container y {container z {leaf d {type uint8; default 1;}}}}}";
+    const char *xml_in = "<a xmlns=\"urn:n\"><d>1</d><b><c><d>2</d><e><d>1</d></e></c></b></a>";
+    const char *xml_trim = "<a xmlns=\"urn:n\"><b><c><d>2</d></c></b></a>";
+    const char *xml_explicit = "<a xmlns=\"urn:n\"><d>1</d><b><c><d>2</d><e><d>1</d></e></c></b></a>";
+
+    assert_ptr_not_equal(lys_parse_mem(st->ctx, yang, LYS_IN_YANG), NULL);
+    assert_ptr_not_equal((st->dt = lyd_parse_mem(st->ctx, xml_in, LYD_XML, LYD_OPT_CONFIG)), NULL);
+
+    /* only the non-default leaf and its ancestors */
+    assert_int_equal(lyd_print_mem(&(st->xml), st->dt, LYD_XML, LYP_WITHSIBLINGS | LYP_WD_TRIM), 0);
+    assert_string_equal(st->xml, xml_trim);
+    free(st->xml);
+
+    /* only the explicitly set nodes, no empty default containers */
+    assert_int_equal(lyd_print_mem(&(st->xml), st->dt, LYD_XML, LYP_WITHSIBLINGS | LYP_WD_EXPLICIT), 0);
+    assert_string_equal(st->xml, xml_explicit);
+}
+
 int main(void)
 {
     const struct CMUnitTest tests[] = {
@@ -669,6 +804,7 @@ int main(void)
                     cmocka_unit_test_setup_teardown(test_status, setup_f, teardown_f),
                     cmocka_unit_test_setup_teardown(test_trim1, setup_f, teardown_f),
                     cmocka_unit_test_setup_teardown(test_trim2, setup_f, teardown_f),
+                    cmocka_unit_test_setup_teardown(test_trim_nested, setup_f, teardown_f),
                     cmocka_unit_test_setup_teardown(test_df1, setup_f, teardown_f),
                     cmocka_unit_test_setup_teardown(test_df2, setup_f, teardown_f),
                     cmocka_unit_test_setup_teardown(test_df3, setup_f, teardown_f),
@@ -677,6 +813,8 @@ int main(void)
                     cmocka_unit_test_setup_teardown(test_rpc_output_default, setup_f, teardown_f),
                     cmocka_unit_test_setup_teardown(test_notif_default, setup_f, teardown_f),
                     cmocka_unit_test_setup_teardown(test_val_diff, setup_f, teardown_f),
+                    cmocka_unit_test_setup_teardown(test_val_diff_ref, setup_f, teardown_f),
+                    cmocka_unit_test_setup_teardown(test_virtual_dflt, setup_clean_f, teardown_f),
                     cmocka_unit_test_setup_teardown(test_feature, setup_f, teardown_f),
                     cmocka_unit_test_setup_teardown(test_leaflist_in10, setup_clean_f, teardown_f),
                     cmocka_unit_test_setup_teardown(test_leaflist_yang, setup_clean_f, teardown_f),
@@ -92,10 +92,43 @@ test_instid_unlink(void **state)
     assert_int_equal(r, 0);
 }
 
+static void
+test_instid_cached(void **state)
+{
+    struct state *st = (*state);
+    struct lyd_node_leaf_list *link;
+    struct lyd_node *target;
+
+    link = (struct lyd_node_leaf_list *)st->data->child;
+    assert_string_equal(link->schema->name, "link-req");
+
+    assert_int_equal(lyd_validate(&(st->data), LYD_OPT_CONFIG, NULL), 0);
+    target = link->value.instance;
+    assert_ptr_not_equal(target, NULL);
+    assert_string_equal(((struct lyd_node_leaf_list *)target)->value_str, "ctyri");
+
+    /* unmodified tree, the target is kept */
+    assert_int_equal(lyd_validate(&(st->data), LYD_OPT_CONFIG, NULL), 0);
+    assert_ptr_equal(link->value.instance, target);
+
+    /* the key of the target list instance changed, the reference is resolved again */
+    assert_int_equal(lyd_change_leaf((struct lyd_node_leaf_list *)target->parent->child, "40"), 0);
+    assert_int_not_equal(lyd_validate(&(st->data), LYD_OPT_CONFIG, NULL), 0);
+
+    assert_int_equal(lyd_change_leaf((struct lyd_node_leaf_list *)target->parent->child, "4"), 0);
+    assert_int_equal(lyd_validate(&(st->data), LYD_OPT_CONFIG, NULL), 0);
+    assert_ptr_equal(link->value.instance, target);
+
+    /* the target is freed */
+    lyd_free(target->parent);
+    assert_int_not_equal(lyd_validate(&(st->data), LYD_OPT_CONFIG, NULL), 0);
+}
+
 int main(void)
 {
     const struct CMUnitTest tests[] = {
-                    cmocka_unit_test_setup_teardown(test_instid_unlink, setup_f, teardown_f) };
+                    cmocka_unit_test_setup_teardown(test_instid_unlink, setup_f, teardown_f),
+                    cmocka_unit_test_setup_teardown(test_instid_cached, setup_f, teardown_f) };
 
     return cmocka_run_group_tests(tests, NULL, NULL);
 }
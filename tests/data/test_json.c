@@ -294,12 +294,53 @@ test_parse_numbers(void **state)
 
 }
 
+static void
+test_parse_strings(void **state)
+{
+    struct lyd_node_leaf_list *leaf;
+    struct state *st;
+    const char *yang = "module str {namespace urn:str; prefix s; leaf-list s {type string; ordered-by user;}}";
+    const char *str_data =
+        "{\"str:s\": [\"short\", \"a longer string value spanning several blocks\", \"\","
+        " \"escaped \\\"quotes\\\" and \\u0041 and a tab\\t in a long string\","
+        " \"non-ASCII \xc5\xbelu\xc5\xa5ou\xc4\x8dk\xc3\xbd k\xc5\xaf\xc5\x88\"]}";
+
+    if (setup_f(&st, TESTS_DIR "/data/files", NULL, 0)) {
+        fail();
+    }
+
+    (*state) = st;
+
+    assert_ptr_not_equal(lys_parse_mem(st->ctx, yang, LYS_IN_YANG), NULL);
+    st->dt = lyd_parse_mem(st->ctx, str_data, LYD_JSON, LYD_OPT_CONFIG);
+    assert_ptr_not_equal(st->dt, NULL);
+
+    leaf = (struct lyd_node_leaf_list *)st->dt;
+    assert_string_equal(leaf->value_str, "short");
+    leaf = (struct lyd_node_leaf_list *)leaf->next;
+    assert_string_equal(leaf->value_str, "a longer string value spanning several blocks");
+    leaf = (struct lyd_node_leaf_list *)leaf->next;
+    assert_string_equal(leaf->value_str, "");
+    leaf = (struct lyd_node_leaf_list *)leaf->next;
+    assert_string_equal(leaf->value_str, "escaped \"quotes\" and A and a tab\t in a long string");
+    leaf = (struct lyd_node_leaf_list *)leaf->next;
+    assert_string_equal(leaf->value_str, "non-ASCII \xc5\xbelu\xc5\xa5ou\xc4\x8dk\xc3\xbd k\xc5\xaf\xc5\x88");
+
+    /* unescaped control character after a long plain prefix */
+    assert_ptr_equal(lyd_parse_mem(st->ctx, "{\"str:s\": [\"a long plain prefix of the value\x01\"]}", LYD_JSON,
+                                   LYD_OPT_CONFIG), NULL);
+    /* missing end of the string */
+    assert_ptr_equal(lyd_parse_mem(st->ctx, "{\"str:s\": [\"a long plain prefix of the value", LYD_JSON,
+                                   LYD_OPT_CONFIG), NULL);
+}
+
 int
 main(void)
 {
     const struct CMUnitTest tests[] = {
                     cmocka_unit_test_teardown(test_parse_if, teardown_f),
                     cmocka_unit_test_teardown(test_parse_numbers, teardown_f),
+                    cmocka_unit_test_teardown(test_parse_strings, teardown_f),
                     };
 
     return cmocka_run_group_tests(tests, NULL, NULL);
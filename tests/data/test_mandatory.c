@@ -162,10 +162,52 @@ test_mandatory(void **state)
     assert_int_equal(ly_errno, LY_SUCCESS);
 }
 
+static void
+test_mandatory_deviation(void **state)
+{
+    struct state *st = (*state);
+    struct ly_ctx *ctx;
+    const char *base =
+    "module mand-base {"
+        "namespace urn:libyang:tests:mand-base;"
+        "prefix mb;"
+        "container c { container inner { leaf l { type string; } leaf m { type string; } } }"
+    "}";
+    const char *dev =
+    "module mand-dev {"
+        "namespace urn:libyang:tests:mand-dev;"
+        "prefix md;"
+        "import mand-base { prefix mb; }"
+        "deviation /mb:c/mb:inner/mb:m { deviate add { mandatory true; } }"
+    "}";
+    const char xml[] = "<c xmlns=\"urn:libyang:tests:mand-base\"><inner><l>x</l></inner></c>";
+
+    /* separate context without the mandatory module */
+    ctx = ly_ctx_new(NULL, 0);
+    assert_non_null(ctx);
+    assert_non_null(lys_parse_mem(ctx, base, LYS_IN_YANG));
+
+    /* no mandatory nodes in the module */
+    st->dt = lyd_parse_mem(ctx, xml, LYD_XML, LYD_OPT_CONFIG);
+    assert_non_null(st->dt);
+    lyd_free_withsiblings(st->dt);
+    st->dt = NULL;
+
+    /* the deviation makes a leaf in the subtree checked before mandatory */
+    assert_non_null(lys_parse_mem(ctx, dev, LYS_IN_YANG));
+    st->dt = lyd_parse_mem(ctx, xml, LYD_XML, LYD_OPT_CONFIG);
+    assert_null(st->dt);
+    assert_int_equal(ly_vecode(ctx), LYVE_MISSELEM);
+    assert_string_equal(ly_errpath(ctx), "/mand-base:c/inner");
+
+    ly_ctx_destroy(ctx, NULL);
+}
+
 int main(void)
 {
     const struct CMUnitTest tests[] = {
-                    cmocka_unit_test_setup_teardown(test_mandatory, setup_f, teardown_f)
+                    cmocka_unit_test_setup_teardown(test_mandatory, setup_f, teardown_f),
+                    cmocka_unit_test_setup_teardown(test_mandatory_deviation, setup_f, teardown_f),
     };
 
     return cmocka_run_group_tests(tests, NULL, NULL);
@@ -588,6 +588,52 @@ test_nc_editconfig4_json(void **state)
     assert_int_equal(ly_vecode(st->ctx), LYVE_INATTR);
 }
 
+/*
+ * annotations of every leaf and leaf-list instance are matched to their nodes
+ */
+static void
+test_annotations_json(void **state)
+{
+    struct state *st = (*state);
+    const char *yang = "module x {"
+                    "  namespace urn:x;"
+                    "  prefix x;"
+                    "  leaf-list a { type string; }"
+                    "  leaf b { type string; }"
+                    "}";
+    const struct lys_module *mod;
+    const struct lyd_node *node;
+    const char *input = "{"
+        "\"x:a\":[\"1\",\"2\",\"3\"],"
+        "\"@x:a\":[{\"ietf-origin:origin\":\"ietf-origin:intended\"},{\"ietf-origin:origin\":\"ietf-origin:intended\"},"
+            "{\"ietf-origin:origin\":\"ietf-origin:system\"}],"
+        "\"x:b\":\"b\","
+        "\"@x:b\":{\"ietf-origin:origin\":\"ietf-origin:intended\"}"
+    "}";
+    const char *extra = "{"
+        "\"x:a\":[\"1\"],"
+        "\"@x:a\":[{\"ietf-origin:origin\":\"ietf-origin:intended\"},{\"ietf-origin:origin\":\"ietf-origin:intended\"}]"
+    "}";
+    int i;
+
+    assert_ptr_not_equal(ly_ctx_load_module(st->ctx, "ietf-origin", NULL), NULL);
+    mod = lys_parse_mem(st->ctx, yang, LYS_IN_YANG);
+    assert_ptr_not_equal(mod, NULL);
+
+    st->data = lyd_parse_mem(st->ctx, input, LYD_JSON, LYD_OPT_CONFIG);
+    assert_ptr_not_equal(st->data, NULL);
+    for (node = st->data, i = 0; node; node = node->next, ++i) {
+        assert_ptr_not_equal(node->attr, NULL);
+        assert_ptr_equal(node->attr->parent, node);
+        assert_string_equal(node->attr->value_str, (i == 2) ? "ietf-origin:system" : "ietf-origin:intended");
+    }
+    assert_int_equal(i, 4);
+
+    /* more annotations than instances */
+    assert_ptr_equal(lyd_parse_mem(st->ctx, extra, LYD_JSON, LYD_OPT_CONFIG), NULL);
+    assert_int_equal(ly_vecode(st->ctx), LYVE_XML_MISS);
+}
+
 /*
  * correctness of parsing and printing NETCONF's edit-config's attributes
  * - insert attr in operation delete
@@ -1461,6 +1507,60 @@ test_nc_editconfig18_xml(void **state)
     assert_string_equal(st->data->attr->value_str, "delete");
 }
 
+/*
+ * applying NETCONF's edit-config directly to a data tree
+ */
+static void
+test_nc_editconfig_apply(void **state)
+{
+    struct state *st = (*state);
+    const char *yang = "module x {"
+                    "  namespace urn:x;"
+                    "  prefix x;"
+                    "  container c {"
+                    "    leaf a { type string; }"
+                    "    leaf b { type string; }"
+                    "    list l { key k; leaf k { type string; } leaf v { type string; } }"
+                    "    leaf-list ll { type string; }"
+                    "  }"
+                    "  leaf d { type string; }"
+                    "}";
+    const char *data = "<c xmlns=\"urn:x\"><a>a</a><b>b</b><l><k>1</k><v>v</v></l><ll>x</ll><ll>y</ll></c>";
+    const char *edit =
+        "<c xmlns=\"urn:x\" xmlns:nc=\"urn:ietf:params:xml:ns:netconf:base:1.0\">"
+            "<a>a2</a><b nc:operation=\"delete\"/><l nc:operation=\"create\"><k>2</k></l>"
+            "<l><k>1</k><v nc:operation=\"remove\"/></l><ll nc:operation=\"remove\">x</ll><ll>z</ll>"
+        "</c>"
+        "<d xmlns=\"urn:x\">d</d>";
+
+    assert_ptr_not_equal(lys_parse_path(st->ctx, TESTS_DIR"/schema/yang/ietf/ietf-netconf.yang", LYS_IN_YANG), NULL);
+    assert_ptr_not_equal(lys_parse_mem(st->ctx, yang, LYS_IN_YANG), NULL);
+
+    st->data = lyd_parse_mem(st->ctx, data, LYD_XML, LYD_OPT_CONFIG);
+    assert_ptr_not_equal(st->data, NULL);
+
+    assert_int_equal(lyd_parse_edit(st->ctx, &st->data, edit, LYD_XML, 0, LYD_EDIT_MERGE), EXIT_SUCCESS);
+    assert_int_equal(lyd_validate(&st->data, LYD_OPT_CONFIG, NULL), 0);
+    lyd_print_mem(&st->str, st->data, LYD_XML, LYP_WITHSIBLINGS);
+    assert_string_equal(st->str, "<c xmlns=\"urn:x\"><a>a2</a><l><k>1</k></l><ll>y</ll><l><k>2</k></l><ll>z</ll></c>"
+                        "<d xmlns=\"urn:x\">d</d>");
+    free(st->str);
+    st->str = NULL;
+
+    /* the operations are checked against the target */
+    assert_int_equal(lyd_parse_edit(st->ctx, &st->data, "<d xmlns=\"urn:x\" xmlns:nc=\"urn:ietf:params:xml:ns:netconf:base:1.0\" "
+                                    "nc:operation=\"create\">d</d>", LYD_XML, 0, LYD_EDIT_MERGE), EXIT_FAILURE);
+    assert_int_equal(ly_vecode(st->ctx), LYVE_PATH_EXISTS);
+    assert_int_equal(lyd_parse_edit(st->ctx, &st->data, "<c xmlns=\"urn:x\" xmlns:nc=\"urn:ietf:params:xml:ns:netconf:base:1.0\">"
+                                    "<b nc:operation=\"delete\"/></c>", LYD_XML, 0, LYD_EDIT_MERGE), EXIT_FAILURE);
+
+    /* replace the whole tree */
+    assert_int_equal(lyd_parse_edit(st->ctx, &st->data, "<c xmlns=\"urn:x\"><b>b</b></c>", LYD_XML, 0, LYD_EDIT_REPLACE),
+                     EXIT_SUCCESS);
+    lyd_print_mem(&st->str, st->data, LYD_XML, LYP_WITHSIBLINGS);
+    assert_string_equal(st->str, "<d xmlns=\"urn:x\">d</d><c xmlns=\"urn:x\"><b>b</b></c>");
+}
+
 int main(void)
 {
     const struct CMUnitTest tests[] = {
@@ -1482,6 +1582,7 @@ int main(void)
                     cmocka_unit_test_setup_teardown(test_nc_editconfig3_json, setup_f, teardown_f),
                     cmocka_unit_test_setup_teardown(test_nc_editconfig4_xml, setup_f, teardown_f),
                     cmocka_unit_test_setup_teardown(test_nc_editconfig4_json, setup_f, teardown_f),
+                    cmocka_unit_test_setup_teardown(test_annotations_json, setup_f, teardown_f),
                     cmocka_unit_test_setup_teardown(test_nc_editconfig5_xml, setup_f, teardown_f),
                     cmocka_unit_test_setup_teardown(test_nc_editconfig5_json, setup_f, teardown_f),
                     cmocka_unit_test_setup_teardown(test_nc_editconfig6_xml, setup_f, teardown_f),
@@ -1509,6 +1610,7 @@ int main(void)
                     cmocka_unit_test_setup_teardown(test_nc_editconfig17_xml, setup_f, teardown_f),
                     cmocka_unit_test_setup_teardown(test_nc_editconfig17_json, setup_f, teardown_f),
                     cmocka_unit_test_setup_teardown(test_nc_editconfig18_xml, setup_f, teardown_f),
+                    cmocka_unit_test_setup_teardown(test_nc_editconfig_apply, setup_f, teardown_f),
     };
 
     return cmocka_run_group_tests(tests, NULL, NULL);
@@ -126,6 +126,43 @@ test_dependency_action(void **state)
     assert_string_equal(st->xml, "<top xmlns=\"urn:libyang:tests:must-dependact\"><list1><key1>c</key1><key2>d</key2><a>aa</a></list1></top>");
 }
 
+static void
+test_independent_rpc(void **state)
+{
+    struct state *st = (struct state *)*state;
+    struct lyd_node *data;
+
+    /* schemas */
+    assert_ptr_not_equal(lys_parse_path(st->ctx, TESTS_DIR"/data/files/must-dependrpc.yin", LYS_IN_YIN), NULL);
+    st->mod = lys_parse_path(st->ctx, TESTS_DIR"/data/files/must-inout.yin", LYS_IN_YIN);
+    assert_ptr_not_equal(st->mod, NULL);
+
+    data = lyd_new_path(NULL, st->ctx, "/must-dependrpc:top/a", "val_a", 0, 0);
+    assert_ptr_not_equal(data, NULL);
+
+    /* the input does not reference any data, it is validated on its own */
+    st->dt = lyd_new_path(NULL, st->ctx, "/must-inout:rpc1/b", "bb", 0, 0);
+    assert_ptr_not_equal(st->dt, NULL);
+
+    assert_int_equal(lyd_validate(&(st->dt), LYD_OPT_RPC, data), 1);
+    assert_ptr_equal(st->dt->parent, NULL);
+    assert_ptr_equal(data->next, NULL);
+
+    assert_ptr_not_equal(lyd_new_path(st->dt, st->ctx, "/must-inout:rpc1/c", "5", 0, 0), NULL);
+    assert_int_equal(lyd_validate(&(st->dt), LYD_OPT_RPC, data), 0);
+    assert_ptr_equal(st->dt->parent, NULL);
+    assert_ptr_equal(data->next, NULL);
+
+    /* the output neither */
+    st->dt2 = lyd_new_path(NULL, st->ctx, "/must-inout:rpc1/d", "6", 0, LYD_PATH_OPT_OUTPUT);
+    assert_ptr_not_equal(st->dt2, NULL);
+    assert_int_equal(lyd_validate(&(st->dt2), LYD_OPT_RPCREPLY, data), 0);
+
+    lyd_print_mem(&(st->xml), data, LYD_XML, LYP_WITHSIBLINGS);
+    assert_string_equal(st->xml, "<top xmlns=\"urn:libyang:tests:must-dependrpc\"><a>val_a</a></top>");
+    lyd_free_withsiblings(data);
+}
+
 static void
 test_inout(void **state)
 {
@@ -186,6 +223,7 @@ int main(void)
     const struct CMUnitTest tests[] = {
                     cmocka_unit_test_setup_teardown(test_dependency_rpc, setup_f, teardown_f),
                     cmocka_unit_test_setup_teardown(test_dependency_action, setup_f, teardown_f),
+                    cmocka_unit_test_setup_teardown(test_independent_rpc, setup_f, teardown_f),
                     cmocka_unit_test_setup_teardown(test_inout, setup_f, teardown_f),
                     cmocka_unit_test_setup_teardown(test_notif, setup_f, teardown_f)
     };
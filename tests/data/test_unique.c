@@ -14,6 +14,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <setjmp.h>
 #include <stdarg.h>
 #include <cmocka.h>
@@ -198,6 +199,63 @@ test_un_nested(void **state)
     assert_string_equal(ly_errmsg(st->ctx), "Unique data leaf(s) \"cont/a cont/b\" not satisfied in \"/unique:un/list[name='namc']/list2[name='a']\" and \"/unique:un/list[name='nam']/list2[name='x']\".");
 }
 
+static void
+test_un_edit(void **state)
+{
+    struct state *st = (*state);
+    struct lyd_node *list, *iter;
+    struct ly_set *set;
+    char xml[1024];
+    int i, len;
+
+    len = sprintf(xml, "<un xmlns=\"urn:libyang:tests:unique\">");
+    for (i = 0; i < 10; ++i) {
+        len += sprintf(xml + len, "<list><name>%d</name><value>%d</value></list>", i, i);
+    }
+    sprintf(xml + len, "</un>");
+
+    st->dt = lyd_parse_mem(st->ctx, xml, LYD_XML, LYD_OPT_CONFIG);
+    assert_ptr_not_equal(st->dt, NULL);
+
+    /* changed value */
+    set = lyd_find_path(st->dt, "/unique:un/list[name='5']/value");
+    assert_ptr_not_equal(set, NULL);
+    assert_int_equal(set->number, 1);
+    assert_int_equal(lyd_change_leaf((struct lyd_node_leaf_list *)set->set.d[0], "3"), 0);
+    assert_int_not_equal(lyd_validate(&st->dt, LYD_OPT_CONFIG, NULL), 0);
+    assert_int_equal(ly_vecode(st->ctx), LYVE_NOUNIQ);
+    assert_string_equal(ly_errmsg(st->ctx), "Unique data leaf(s) \"value a\" not satisfied in \"/unique:un/list[name='3']\" and \"/unique:un/list[name='5']\".");
+    assert_int_equal(lyd_change_leaf((struct lyd_node_leaf_list *)set->set.d[0], "5"), 0);
+    assert_int_equal(lyd_validate(&st->dt, LYD_OPT_CONFIG, NULL), 0);
+    ly_set_free(set);
+
+    /* new instance */
+    list = lyd_new(st->dt, st->mod, "list");
+    assert_ptr_not_equal(lyd_new_leaf(list, st->mod, "name", "10"), NULL);
+    assert_ptr_not_equal(lyd_new_leaf(list, st->mod, "value", "7"), NULL);
+    assert_int_not_equal(lyd_validate(&st->dt, LYD_OPT_CONFIG, NULL), 0);
+    assert_int_equal(ly_vecode(st->ctx), LYVE_NOUNIQ);
+    assert_string_equal(ly_errmsg(st->ctx), "Unique data leaf(s) \"value a\" not satisfied in \"/unique:un/list[name='7']\" and \"/unique:un/list[name='10']\".");
+
+    /* removed conflicting instance */
+    LY_TREE_FOR(st->dt->child, iter) {
+        if (!strcmp(((struct lyd_node_leaf_list *)iter->child)->value_str, "7")) {
+            break;
+        }
+    }
+    lyd_free(iter);
+    assert_int_equal(lyd_validate(&st->dt, LYD_OPT_CONFIG, NULL), 0);
+
+    /* duplicate key */
+    list = lyd_new(st->dt, st->mod, "list");
+    assert_ptr_not_equal(lyd_new_leaf(list, st->mod, "name", "2"), NULL);
+    assert_ptr_not_equal(lyd_new_leaf(list, st->mod, "value", "20"), NULL);
+    assert_int_not_equal(lyd_validate(&st->dt, LYD_OPT_CONFIG, NULL), 0);
+    assert_int_equal(ly_vecode(st->ctx), LYVE_DUPLIST);
+    lyd_free(list);
+    assert_int_equal(lyd_validate(&st->dt, LYD_OPT_CONFIG, NULL), 0);
+}
+
 static void
 test_schema_inpath(void **state)
 {
@@ -225,6 +283,7 @@ int main(void)
                     cmocka_unit_test_setup_teardown(test_un_defaults, setup_f, teardown_f),
                     cmocka_unit_test_setup_teardown(test_un_empty, setup_f, teardown_f),
                     cmocka_unit_test_setup_teardown(test_un_nested, setup_f, teardown_f),
+                    cmocka_unit_test_setup_teardown(test_un_edit, setup_f, teardown_f),
                     cmocka_unit_test_setup_teardown(test_schema_inpath, setup_f, teardown_f),
     };
 
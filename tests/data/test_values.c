@@ -234,6 +234,79 @@ test_xmltojson_instanceid(void **state)
     assert_string_equal(st->data, result);
 }
 
+static void
+test_instanceid_predicates(void **state)
+{
+    struct state *st = (*state);
+    struct lyd_node_leaf_list *leaf;
+    struct ly_set *set;
+    const char *yang = "module x {"
+                    "  namespace urn:x;"
+                    "  prefix x;"
+                    "  list l { key \"a b\"; leaf a { type string; } leaf b { type decimal64 { fraction-digits 2; } }"
+                    "    list m { key k; leaf k { type uint8; } leaf v { type string; } } }"
+                    "  leaf-list ll { type int16; }"
+                    "  list kl { config false; leaf v { type string; } }"
+                    "  leaf i { type instance-identifier; }"
+                    "}";
+    const char *data = "<l xmlns=\"urn:x\"><a>one</a><b>1.5</b><m><k>1</k></m><m><k>2</k><v>hit</v></m></l>"
+                    "<l xmlns=\"urn:x\"><a>two</a><b>1.5</b><m><k>2</k></m></l>"
+                    "<ll xmlns=\"urn:x\">3</ll><ll xmlns=\"urn:x\">7</ll>"
+                    "<kl xmlns=\"urn:x\"><v>first</v></kl><kl xmlns=\"urn:x\"><v>second</v></kl>";
+    char xml[1024];
+
+    assert_ptr_not_equal(lys_parse_mem(st->ctx, yang, LYS_IN_YANG), NULL);
+
+    /* all the keys, in any order and non-canonical */
+    sprintf(xml, "%s<i xmlns=\"urn:x\" xmlns:x=\"urn:x\">/x:l[x:b='1.50'][x:a='one']/x:m[x:k='02']/x:v</i>", data);
+    st->dt = lyd_parse_mem(st->ctx, xml, LYD_XML, LYD_OPT_DATA | LYD_OPT_DATA_NO_YANGLIB);
+    assert_ptr_not_equal(st->dt, NULL);
+    set = lyd_find_path(st->dt, "/x:i");
+    assert_ptr_not_equal(set, NULL);
+    assert_int_equal(set->number, 1);
+    leaf = (struct lyd_node_leaf_list *)set->set.d[0];
+    ly_set_free(set);
+    assert_ptr_not_equal(leaf->value.instance, NULL);
+    assert_string_equal(((struct lyd_node_leaf_list *)leaf->value.instance)->value_str, "hit");
+    lyd_free_withsiblings(st->dt);
+
+    /* leaf-list value */
+    sprintf(xml, "%s<i xmlns=\"urn:x\" xmlns:x=\"urn:x\">/x:ll[.='7']</i>", data);
+    st->dt = lyd_parse_mem(st->ctx, xml, LYD_XML, LYD_OPT_DATA | LYD_OPT_DATA_NO_YANGLIB);
+    assert_ptr_not_equal(st->dt, NULL);
+    set = lyd_find_path(st->dt, "/x:i");
+    assert_ptr_not_equal(set, NULL);
+    assert_int_equal(set->number, 1);
+    leaf = (struct lyd_node_leaf_list *)set->set.d[0];
+    ly_set_free(set);
+    assert_ptr_not_equal(leaf->value.instance, NULL);
+    assert_string_equal(((struct lyd_node_leaf_list *)leaf->value.instance)->value_str, "7");
+    lyd_free_withsiblings(st->dt);
+
+    /* position in a keyless list */
+    sprintf(xml, "%s<i xmlns=\"urn:x\" xmlns:x=\"urn:x\">/x:kl[2]/x:v</i>", data);
+    st->dt = lyd_parse_mem(st->ctx, xml, LYD_XML, LYD_OPT_DATA | LYD_OPT_DATA_NO_YANGLIB);
+    assert_ptr_not_equal(st->dt, NULL);
+    set = lyd_find_path(st->dt, "/x:i");
+    assert_ptr_not_equal(set, NULL);
+    assert_int_equal(set->number, 1);
+    leaf = (struct lyd_node_leaf_list *)set->set.d[0];
+    ly_set_free(set);
+    assert_ptr_not_equal(leaf->value.instance, NULL);
+    assert_string_equal(((struct lyd_node_leaf_list *)leaf->value.instance)->value_str, "second");
+    lyd_free_withsiblings(st->dt);
+
+    /* no such instance */
+    sprintf(xml, "%s<i xmlns=\"urn:x\" xmlns:x=\"urn:x\">/x:l[x:a='two'][x:b='1.5']/x:m[x:k='1']</i>", data);
+    st->dt = lyd_parse_mem(st->ctx, xml, LYD_XML, LYD_OPT_DATA | LYD_OPT_DATA_NO_YANGLIB);
+    assert_ptr_equal(st->dt, NULL);
+
+    /* missing key */
+    sprintf(xml, "%s<i xmlns=\"urn:x\" xmlns:x=\"urn:x\">/x:l[x:a='one']</i>", data);
+    st->dt = lyd_parse_mem(st->ctx, xml, LYD_XML, LYD_OPT_DATA | LYD_OPT_DATA_NO_YANGLIB);
+    assert_ptr_equal(st->dt, NULL);
+}
+
 static void
 test_canonical(void **state)
 {
@@ -422,6 +495,531 @@ test_validate_value(void **state)
     assert_int_equal(lyd_validate_value(node, "9.223372036854775807"), EXIT_SUCCESS); /* ok */
 }
 
+static void
+test_validate_range_intervals(void **state)
+{
+    struct state *st = (*state);
+    const struct lys_module *mod;
+    struct lys_node *node;
+    const char *yang = "module x {"
+                    "  namespace urn:x;"
+                    "  prefix x;"
+                    "  typedef base {"
+                    "    type int32 {"
+                    "      range \"min..-100 | -10..10 | 20 | 30..40 | 100..max\";"
+                    "    }"
+                    "  }"
+                    "  leaf a {"
+                    "    type base;"
+                    "  }"
+                    "  leaf b {"
+                    "    type base {"
+                    "      range \"-10..0 | 35..40\" {"
+                    "        error-app-tag b-range;"
+                    "      }"
+                    "    }"
+                    "  }"
+                    "  leaf c {"
+                    "    type decimal64 {"
+                    "      fraction-digits 2;"
+                    "      range \"-1.5..-0.5 | 0.25 | 1..2\";"
+                    "    }"
+                    "  }"
+                    "  leaf d {"
+                    "    type string {"
+                    "      length \"1 | 3..4 | 8..max\";"
+                    "    }"
+                    "  }"
+                    "}";
+
+    mod = lys_parse_mem(st->ctx, yang, LYS_IN_YANG);
+    assert_ptr_not_equal(mod, NULL);
+
+    /* a */
+    node = mod->data;
+    assert_int_equal(lyd_validate_value(node, "-2147483648"), EXIT_SUCCESS);
+    assert_int_equal(lyd_validate_value(node, "-100"), EXIT_SUCCESS);
+    assert_int_equal(lyd_validate_value(node, "-99"), EXIT_FAILURE);
+    assert_int_equal(lyd_validate_value(node, "-10"), EXIT_SUCCESS);
+    assert_int_equal(lyd_validate_value(node, "11"), EXIT_FAILURE);
+    assert_int_equal(lyd_validate_value(node, "20"), EXIT_SUCCESS);
+    assert_int_equal(lyd_validate_value(node, "21"), EXIT_FAILURE);
+    assert_int_equal(lyd_validate_value(node, "29"), EXIT_FAILURE);
+    assert_int_equal(lyd_validate_value(node, "35"), EXIT_SUCCESS);
+    assert_int_equal(lyd_validate_value(node, "99"), EXIT_FAILURE);
+    assert_int_equal(lyd_validate_value(node, "2147483647"), EXIT_SUCCESS);
+
+    /* b, both the restrictions must be satisfied */
+    node = node->next;
+    assert_int_equal(lyd_validate_value(node, "-5"), EXIT_SUCCESS);
+    assert_int_equal(lyd_validate_value(node, "5"), EXIT_FAILURE);
+    assert_string_equal(ly_errapptag(st->ctx), "b-range");
+    assert_int_equal(lyd_validate_value(node, "20"), EXIT_FAILURE);
+    assert_int_equal(lyd_validate_value(node, "40"), EXIT_SUCCESS);
+    assert_int_equal(lyd_validate_value(node, "-200"), EXIT_FAILURE);
+
+    /* c */
+    node = node->next;
+    assert_int_equal(lyd_validate_value(node, "-1.5"), EXIT_SUCCESS);
+    assert_int_equal(lyd_validate_value(node, "-0.4"), EXIT_FAILURE);
+    assert_int_equal(lyd_validate_value(node, "0.25"), EXIT_SUCCESS);
+    assert_int_equal(lyd_validate_value(node, "0.26"), EXIT_FAILURE);
+    assert_int_equal(lyd_validate_value(node, "1.99"), EXIT_SUCCESS);
+    assert_int_equal(lyd_validate_value(node, "2.01"), EXIT_FAILURE);
+
+    /* d */
+    node = node->next;
+    assert_int_equal(lyd_validate_value(node, NULL), EXIT_FAILURE);
+    assert_int_equal(lyd_validate_value(node, "a"), EXIT_SUCCESS);
+    assert_int_equal(lyd_validate_value(node, "ab"), EXIT_FAILURE);
+    assert_int_equal(lyd_validate_value(node, "abcd"), EXIT_SUCCESS);
+    assert_int_equal(lyd_validate_value(node, "abcde"), EXIT_FAILURE);
+    assert_int_equal(lyd_validate_value(node, "abcdefghijk"), EXIT_SUCCESS);
+}
+
+static void
+test_validate_enum_bits_ident(void **state)
+{
+    struct state *st = (*state);
+    const struct lys_module *mod;
+    struct lys_node *node;
+    const char *yang = "module x {"
+                    "  yang-version 1.1;"
+                    "  namespace urn:x;"
+                    "  prefix x;"
+                    "  feature f;"
+                    "  identity base;"
+                    "  identity i1 { base base; }"
+                    "  identity i2 { base base; }"
+                    "  identity i3 { base i1; }"
+                    "  identity i4 { base base; if-feature f; }"
+                    "  typedef e {"
+                    "    type enumeration {"
+                    "      enum one; enum two; enum three; enum four; enum five { if-feature f; }"
+                    "    }"
+                    "  }"
+                    "  leaf a { type e; }"
+                    "  leaf b { type e { enum two; enum four; } }"
+                    "  leaf c {"
+                    "    type bits {"
+                    "      bit b0; bit b1; bit b2; bit b3; bit b4 { if-feature f; }"
+                    "    }"
+                    "  }"
+                    "  leaf d { type identityref { base base; } }"
+                    "}";
+    const char *yang_y = "module y {"
+                    "  namespace urn:y;"
+                    "  prefix y;"
+                    "  import x { prefix x; }"
+                    "  identity i1 { base x:base; }"
+                    "}";
+
+    mod = lys_parse_mem(st->ctx, yang, LYS_IN_YANG);
+    assert_ptr_not_equal(mod, NULL);
+
+    /* a */
+    node = mod->data;
+    assert_int_equal(lyd_validate_value(node, "one"), EXIT_SUCCESS);
+    assert_int_equal(lyd_validate_value(node, "four"), EXIT_SUCCESS);
+    assert_int_equal(lyd_validate_value(node, "fou"), EXIT_FAILURE);
+    assert_int_equal(lyd_validate_value(node, "six"), EXIT_FAILURE);
+    assert_int_equal(lyd_validate_value(node, NULL), EXIT_FAILURE);
+    assert_int_equal(lyd_validate_value(node, "five"), EXIT_FAILURE);
+    assert_int_equal(lys_features_enable(mod, "f"), 0);
+    assert_int_equal(lyd_validate_value(node, "five"), EXIT_SUCCESS);
+
+    /* b, restricted enums */
+    node = node->next;
+    assert_int_equal(lyd_validate_value(node, "four"), EXIT_SUCCESS);
+    assert_int_equal(lyd_validate_value(node, "one"), EXIT_FAILURE);
+
+    /* c */
+    node = node->next;
+    assert_int_equal(lyd_validate_value(node, "b3 b0 b4"), EXIT_SUCCESS);
+    assert_int_equal(lyd_validate_value(node, "b1 b1"), EXIT_FAILURE);
+    assert_int_equal(lyd_validate_value(node, "b1 b"), EXIT_FAILURE);
+    assert_int_equal(lys_features_disable(mod, "f"), 0);
+    assert_int_equal(lyd_validate_value(node, "b4"), EXIT_FAILURE);
+
+    /* d */
+    node = node->next;
+    assert_int_equal(lyd_validate_value(node, "x:i2"), EXIT_SUCCESS);
+    assert_int_equal(lyd_validate_value(node, "x:i3"), EXIT_SUCCESS);
+    assert_int_equal(lyd_validate_value(node, "x:i4"), EXIT_FAILURE);
+    assert_int_equal(lyd_validate_value(node, "x:i5"), EXIT_FAILURE);
+    assert_int_equal(lyd_validate_value(node, "y:i1"), EXIT_FAILURE);
+
+    /* a new derived identity */
+    assert_ptr_not_equal(lys_parse_mem(st->ctx, yang_y, LYS_IN_YANG), NULL);
+    assert_int_equal(lyd_validate_value(node, "y:i1"), EXIT_SUCCESS);
+    assert_int_equal(lyd_validate_value(node, "x:i1"), EXIT_SUCCESS);
+}
+
+static void
+test_union_member_types(void **state)
+{
+    struct state *st = (*state);
+    const struct lys_module *mod;
+    struct lyd_node_leaf_list *leaf;
+    const char *yang = "module u {"
+                    "  yang-version 1.1;"
+                    "  namespace urn:u;"
+                    "  prefix u;"
+                    "  leaf a {"
+                    "    type union {"
+                    "      type uint32; type boolean; type empty; type decimal64 { fraction-digits 2; }"
+                    "      type binary { length 3; } type enumeration { enum one; } type string;"
+                    "    }"
+                    "  }"
+                    "  leaf d { type union { type int8; type string; } default 0x1F; }"
+                    "}";
+    const struct {
+        const char *value;
+        LY_DATA_TYPE type;
+    } vals[] = {
+        {"42", LY_TYPE_UINT32},
+        {" 42 ", LY_TYPE_UINT32},
+        {"-42", LY_TYPE_DEC64},
+        {"true", LY_TYPE_BOOL},
+        {"", LY_TYPE_EMPTY},
+        {"4.20", LY_TYPE_DEC64},
+        {"YWJj", LY_TYPE_BINARY},
+        {"one", LY_TYPE_ENUM},
+        {"0x1", LY_TYPE_STRING},
+        {"two", LY_TYPE_STRING},
+        {NULL, 0}
+    };
+    int i;
+
+    mod = lys_parse_mem(st->ctx, yang, LYS_IN_YANG);
+    assert_ptr_not_equal(mod, NULL);
+
+    for (i = 0; vals[i].value; ++i) {
+        leaf = (struct lyd_node_leaf_list *)lyd_new_path(NULL, st->ctx, "/u:a", (void *)vals[i].value, 0, 0);
+        assert_ptr_not_equal(leaf, NULL);
+        assert_int_equal(leaf->value_type, vals[i].type);
+        lyd_free((struct lyd_node *)leaf);
+    }
+
+    /* schema default values of integers may be hexadecimal */
+    assert_int_equal(lyd_validate(&st->dt, LYD_OPT_CONFIG, st->ctx), 0);
+    assert_ptr_not_equal(st->dt, NULL);
+    leaf = (struct lyd_node_leaf_list *)st->dt;
+    assert_string_equal(leaf->schema->name, "d");
+    assert_int_equal(leaf->value_type, LY_TYPE_INT8);
+    assert_int_equal(leaf->value.int8, 31);
+}
+
+/*
+ * ietf-inet-types addresses and prefixes are stored by the inet types plugin and printed in their canonical form
+ */
+static void
+test_inet_types(void **state)
+{
+    struct state *st = (*state);
+    const char *yang = "module x {"
+                    "  namespace urn:x;"
+                    "  prefix x;"
+                    "  import ietf-inet-types { prefix inet; }"
+                    "  container x {"
+                    "    list r4 { key p; leaf p { type inet:ipv4-prefix; } }"
+                    "    list r6 { key p; leaf p { type inet:ipv6-prefix; } }"
+                    "    leaf-list a4 { type inet:ipv4-address; }"
+                    "    leaf-list a6 { type inet:ipv6-address-no-zone; }"
+                    "    leaf-list a { type inet:ip-address; }"
+                    "    leaf a6lr { type leafref { path ../a6; } }"
+                    "} }";
+    const char *input = "<x xmlns=\"urn:x\">"
+                    "<r4><p>10.1.2.3/8</p></r4><r4><p>192.168.1.1/32</p></r4>"
+                    "<r6><p>2001:DB8::1/32</p></r6><r6><p>::/0</p></r6>"
+                    "<a4>1.2.3.4%eth0</a4><a4>1.2.3.4</a4>"
+                    "<a6>2001:0db8:0:0:0:0:0:1</a6>"
+                    "<a>::FFFF</a><a>10.0.0.1</a>"
+                    "<a6lr>2001:DB8::1</a6lr>"
+                    "</x>";
+    const char *result = "<x xmlns=\"urn:x\">"
+                    "<r4><p>10.0.0.0/8</p></r4><r4><p>192.168.1.1/32</p></r4>"
+                    "<r6><p>2001:db8::/32</p></r6><r6><p>::/0</p></r6>"
+                    "<a4>1.2.3.4%eth0</a4><a4>1.2.3.4</a4>"
+                    "<a6>2001:db8::1</a6>"
+                    "<a>::ffff</a><a>10.0.0.1</a>"
+                    "<a6lr>2001:db8::1</a6lr>"
+                    "</x>";
+    struct ly_set *set;
+
+    assert_ptr_not_equal(lys_parse_mem(st->ctx, yang, LYS_IN_YANG), NULL);
+    st->dt = lyd_parse_mem(st->ctx, input, LYD_XML, LYD_OPT_CONFIG);
+    assert_ptr_not_equal(st->dt, NULL);
+
+    lyd_print_mem(&st->data, st->dt, LYD_XML, LYP_WITHSIBLINGS);
+    assert_ptr_not_equal(st->data, NULL);
+    assert_string_equal(st->data, result);
+
+    set = lyd_find_path(st->dt, "/x:x/r6[p='2001:db8::/32']");
+    assert_ptr_not_equal(set, NULL);
+    assert_int_equal(set->number, 1);
+    ly_set_free(set);
+
+    /* the same prefix in a different form is a duplicate key */
+    assert_ptr_equal(lyd_parse_mem(st->ctx, "<x xmlns=\"urn:x\"><r4><p>10.1.2.3/8</p></r4><r4><p>10.0.0.0/8</p></r4></x>",
+                                   LYD_XML, LYD_OPT_CONFIG), NULL);
+    /* invalid prefix length */
+    assert_ptr_equal(lyd_parse_mem(st->ctx, "<x xmlns=\"urn:x\"><r6><p>::/129</p></r6></x>", LYD_XML, LYD_OPT_CONFIG), NULL);
+}
+
+/*
+ * date-and-time values are stored as the time since the epoch and XPath relational operators compare them as such
+ */
+static void
+test_date_and_time(void **state)
+{
+    struct state *st = (*state);
+    const char *yang = "module x {"
+                    "  namespace urn:x;"
+                    "  prefix x;"
+                    "  import ietf-yang-types { prefix yang; }"
+                    "  container x {"
+                    "    list ev { key t; leaf t { type yang:date-and-time; } }"
+                    "    leaf since { type yang:date-and-time; }"
+                    "} }";
+    const char *input = "<x xmlns=\"urn:x\">"
+                    "<ev><t>2018-03-25T02:30:00Z</t></ev>"
+                    "<ev><t>2018-03-21T09:11:05.5+02:00</t></ev>"
+                    "<ev><t>2018-03-21T07:11:05.4Z</t></ev>"
+                    "<since>2018-03-21T07:11:05.45Z</since>"
+                    "</x>";
+    struct ly_set *set;
+
+    assert_ptr_not_equal(lys_parse_mem(st->ctx, yang, LYS_IN_YANG), NULL);
+    st->dt = lyd_parse_mem(st->ctx, input, LYD_XML, LYD_OPT_CONFIG);
+    assert_ptr_not_equal(st->dt, NULL);
+
+    set = lyd_find_path(st->dt, "/x:x/ev[t >= '2018-03-21T09:11:05.50+02:00']");
+    assert_ptr_not_equal(set, NULL);
+    assert_int_equal(set->number, 2);
+    ly_set_free(set);
+
+    set = lyd_find_path(st->dt, "/x:x/ev[t < ../since]");
+    assert_ptr_not_equal(set, NULL);
+    assert_int_equal(set->number, 1);
+    ly_set_free(set);
+
+    /* the same point in time with the same offset is a duplicate key */
+    assert_ptr_equal(lyd_parse_mem(st->ctx, "<x xmlns=\"urn:x\"><ev><t>2018-03-21T07:11:05Z</t></ev>"
+                                   "<ev><t>2018-03-21T07:11:05.000+00:00</t></ev></x>", LYD_XML, LYD_OPT_CONFIG), NULL);
+}
+
+static void
+test_dec64(void **state)
+{
+    struct state *st = (*state);
+    const char *yang = "module x {"
+                    "  namespace urn:x;"
+                    "  prefix x;"
+                    "  container x {"
+                    "    list m { key k; leaf k { type uint8; } leaf r { type decimal64 { fraction-digits 3; } } }"
+                    "    leaf-list c { type decimal64 { fraction-digits 3; } }"
+                    "    leaf min { type decimal64 { fraction-digits 18; } }"
+                    "} }";
+    const char *input = "<x xmlns=\"urn:x\">"
+                    "<m><k>0</k><r>0.1</r></m><m><k>1</k><r>0.1</r></m><m><k>2</k><r>0.1</r></m>"
+                    "<m><k>3</k><r>0.1</r></m><m><k>4</k><r>0.1</r></m><m><k>5</k><r>0.1</r></m>"
+                    "<m><k>6</k><r>0.1</r></m><m><k>7</k><r>0.1</r></m><m><k>8</k><r>0.1</r></m>"
+                    "<m><k>9</k><r>0.100</r></m>"
+                    "<c>-0.050</c><c>+100</c><c>-0</c>"
+                    "<min>-9.223372036854775808</min>"
+                    "</x>";
+    const char *result = "<x xmlns=\"urn:x\">"
+                    "<m><k>0</k><r>0.1</r></m><m><k>1</k><r>0.1</r></m><m><k>2</k><r>0.1</r></m>"
+                    "<m><k>3</k><r>0.1</r></m><m><k>4</k><r>0.1</r></m><m><k>5</k><r>0.1</r></m>"
+                    "<m><k>6</k><r>0.1</r></m><m><k>7</k><r>0.1</r></m><m><k>8</k><r>0.1</r></m>"
+                    "<m><k>9</k><r>0.1</r></m>"
+                    "<c>-0.05</c><c>100.0</c><c>0.0</c>"
+                    "<min>-9.223372036854775808</min>"
+                    "</x>";
+    struct ly_set *set;
+
+    assert_ptr_not_equal(lys_parse_mem(st->ctx, yang, LYS_IN_YANG), NULL);
+    st->dt = lyd_parse_mem(st->ctx, input, LYD_XML, LYD_OPT_CONFIG);
+    assert_ptr_not_equal(st->dt, NULL);
+
+    /* canonical values */
+    lyd_print_mem(&st->data, st->dt, LYD_XML, 0);
+    assert_string_equal(st->data, result);
+
+    /* exact comparisons */
+    set = lyd_find_path(st->dt, "/x:x/m[r = 0.10]");
+    assert_ptr_not_equal(set, NULL);
+    assert_int_equal(set->number, 10);
+    ly_set_free(set);
+
+    set = lyd_find_path(st->dt, "/x:x/c[. < -0.049]");
+    assert_ptr_not_equal(set, NULL);
+    assert_int_equal(set->number, 1);
+    ly_set_free(set);
+
+    set = lyd_find_path(st->dt, "/x:x[sum(m/r) = 1]");
+    assert_ptr_not_equal(set, NULL);
+    assert_int_equal(set->number, 1);
+    ly_set_free(set);
+
+    set = lyd_find_path(st->dt, "/x:x[min < -9.223372036854775807]");
+    assert_ptr_not_equal(set, NULL);
+    assert_int_equal(set->number, 1);
+    ly_set_free(set);
+}
+
+static void
+test_string_length(void **state)
+{
+    struct state *st = (*state);
+    const char *yang = "module x {"
+                    "  namespace urn:x;"
+                    "  prefix x;"
+                    "  container x {"
+                    "    leaf s { type string { length 13; } }"
+                    "    leaf l { type string { length 17; } }"
+                    "} }";
+
+    assert_ptr_not_equal(lys_parse_mem(st->ctx, yang, LYS_IN_YANG), NULL);
+
+    /* characters are counted, not bytes */
+    st->dt = lyd_parse_mem(st->ctx, "<x xmlns=\"urn:x\"><s>\xc5\xbelu\xc5\xa5ou\xc4\x8dk\xc3\xbd k\xc5\xaf\xc5\x88</s>"
+                           "<l>0123456789abcdef\xf0\x9f\x98\x80</l></x>", LYD_XML, LYD_OPT_CONFIG);
+    assert_ptr_not_equal(st->dt, NULL);
+    lyd_free_withsiblings(st->dt);
+
+    st->dt = lyd_parse_mem(st->ctx, "{\"x:x\":{\"s\":\"\xc5\xbelu\xc5\xa5ou\xc4\x8dk\xc3\xbd k\xc5\xaf\xc5\x88\"}}",
+                           LYD_JSON, LYD_OPT_CONFIG);
+    assert_ptr_not_equal(st->dt, NULL);
+    lyd_free_withsiblings(st->dt);
+
+    st->dt = lyd_parse_mem(st->ctx, "<x xmlns=\"urn:x\"><l>0123456789abcdef\xc3\xbd\xc3\xbd</l></x>", LYD_XML, LYD_OPT_CONFIG);
+    assert_ptr_equal(st->dt, NULL);
+    assert_int_equal(ly_vecode(st->ctx), LYVE_NOCONSTR);
+}
+
+static void
+test_typedef_chain(void **state)
+{
+    struct state *st = (*state);
+    const char *yang = "module x {"
+                    "  yang-version 1.1;"
+                    "  namespace urn:x;"
+                    "  prefix x;"
+                    "  typedef e1 { type enumeration { enum a; enum b; enum c; } }"
+                    "  typedef e2 { type e1; }"
+                    "  typedef e3 { type e2 { enum a; enum b; } }"
+                    "  typedef b1 { type bits { bit p; bit q; bit r; } }"
+                    "  typedef b2 { type b1 { bit q; bit r; } }"
+                    "  typedef b3 { type b2; }"
+                    "  typedef s1 { type string { length 1..10; } }"
+                    "  typedef s2 { type s1; }"
+                    "  typedef s3 { type s2 { length 2..5; } }"
+                    "  container x {"
+                    "    leaf e { type e3; }"
+                    "    leaf b { type b3; }"
+                    "    leaf s { type s3; }"
+                    "} }";
+
+    assert_ptr_not_equal(lys_parse_mem(st->ctx, yang, LYS_IN_YANG), NULL);
+
+    st->dt = lyd_parse_mem(st->ctx, "<x xmlns=\"urn:x\"><e>b</e><b>q r</b><s>abc</s></x>", LYD_XML, LYD_OPT_CONFIG);
+    assert_ptr_not_equal(st->dt, NULL);
+    assert_int_equal(((struct lyd_node_leaf_list *)st->dt->child)->value.enm->value, 1);
+    lyd_free_withsiblings(st->dt);
+
+    /* restrictions of the whole chain */
+    st->dt = lyd_parse_mem(st->ctx, "<x xmlns=\"urn:x\"><e>c</e></x>", LYD_XML, LYD_OPT_CONFIG);
+    assert_ptr_equal(st->dt, NULL);
+    st->dt = lyd_parse_mem(st->ctx, "<x xmlns=\"urn:x\"><b>p</b></x>", LYD_XML, LYD_OPT_CONFIG);
+    assert_ptr_equal(st->dt, NULL);
+    st->dt = lyd_parse_mem(st->ctx, "<x xmlns=\"urn:x\"><s>a</s></x>", LYD_XML, LYD_OPT_CONFIG);
+    assert_ptr_equal(st->dt, NULL);
+    st->dt = lyd_parse_mem(st->ctx, "<x xmlns=\"urn:x\"><s>abcdef</s></x>", LYD_XML, LYD_OPT_CONFIG);
+    assert_ptr_equal(st->dt, NULL);
+    assert_int_equal(ly_vecode(st->ctx), LYVE_NOCONSTR);
+}
+
+static void
+test_value_checker(void **state)
+{
+    struct state *st = (*state);
+    struct lyd_value_checker *checker;
+    const struct lys_module *mod;
+    struct lys_node *node;
+    unsigned int i, j;
+    const char *yang = "module x {"
+                    "  yang-version 1.1;"
+                    "  namespace urn:x;"
+                    "  prefix x;"
+                    "  feature f;"
+                    "  identity base;"
+                    "  identity one { base base; }"
+                    "  typedef r { type int16 { range \"-10..-5 | 5..10\"; } }"
+                    "  container x {"
+                    "    leaf i { type r { range \"-8..-6 | 6..8\"; } }"
+                    "    leaf u { type uint8 { range \"1..100\"; } }"
+                    "    leaf d { type decimal64 { fraction-digits 2; range \"0..10\"; } }"
+                    "    leaf s { type string { length 2..4; } }"
+                    "    leaf b { type boolean; }"
+                    "    leaf e { type empty; }"
+                    "    leaf n { type enumeration { enum a; enum b { if-feature f; } } }"
+                    "    leaf t { type bits { bit p; bit q; bit r { if-feature f; } } }"
+                    "    leaf y { type binary { length 1..3; } }"
+                    "    leaf un { type union { type uint8; type enumeration { enum none; } } }"
+                    "    leaf lr { type leafref { path \"../u\"; } }"
+                    "    leaf id { type identityref { base base; } }"
+                    "  }"
+                    "}";
+    struct {
+        const char *name;
+        const char *values[8];
+    } cases[] = {
+        {"i", {"6", "-6", "0", "9", "-9", " 7 ", "7a", ""}},
+        {"u", {"1", "100", "0", "101", "-1", "-0", "256", "x"}},
+        {"d", {"0", "9.99", "10.00", "10.01", "-1", "1.234", "1.", ""}},
+        {"s", {"ab", "abcd", "a", "abcde", "\xc3\xbd\xc3\xbd", "", NULL}},
+        {"b", {"true", "false", "True", "", NULL}},
+        {"e", {"", "x", NULL}},
+        {"n", {"a", "b", "c", "", NULL}},
+        {"t", {"", "p", "p q", " q  p ", "p p", "r", "z", NULL}},
+        {"y", {"AQ==", "AQID", "AQIDBA==", "AQ=", "A\nQ==", "A*==", "", NULL}},
+        {"un", {"5", "none", "256", "all", NULL}},
+        {"lr", {"1", "100", "101", NULL}},
+        {"id", {"one", "x:one", "base", "none", NULL}},
+    };
+
+    mod = lys_parse_mem(st->ctx, yang, LYS_IN_YANG);
+    assert_ptr_not_equal(mod, NULL);
+
+    for (i = 0; i < sizeof cases / sizeof *cases; ++i) {
+        node = NULL;
+        while ((node = (struct lys_node *)lys_getnext(node, mod->data, NULL, 0)) && strcmp(node->name, cases[i].name));
+        assert_ptr_not_equal(node, NULL);
+
+        checker = lyd_value_checker_new(node);
+        assert_ptr_not_equal(checker, NULL);
+        for (j = 0; (j < 8) && cases[i].values[j]; ++j) {
+            /* the same result as the full validation */
+            assert_int_equal(lyd_value_check(checker, cases[i].values[j]), lyd_validate_value(node, cases[i].values[j]));
+        }
+        lyd_value_checker_free(checker);
+    }
+
+    /* enabled feature changes the result */
+    assert_int_equal(lys_features_enable(mod, "f"), 0);
+    node = NULL;
+    while ((node = (struct lys_node *)lys_getnext(node, mod->data, NULL, 0)) && strcmp(node->name, "n"));
+    checker = lyd_value_checker_new(node);
+    assert_ptr_not_equal(checker, NULL);
+    assert_int_equal(lyd_value_check(checker, "b"), EXIT_SUCCESS);
+    lyd_value_checker_free(checker);
+
+    /* only leaves and leaf-lists */
+    assert_ptr_equal(lyd_value_checker_new(mod->data), NULL);
+}
+
 int main(void)
 {
     const struct CMUnitTest tests[] = {
@@ -430,8 +1028,18 @@ int main(void)
                     cmocka_unit_test_setup_teardown(test_xmltojson_identityref, setup_f, teardown_f),
                     cmocka_unit_test_setup_teardown(test_xmltojson_identityref2, setup_f, teardown_f),
                     cmocka_unit_test_setup_teardown(test_xmltojson_instanceid, setup_f, teardown_f),
+                    cmocka_unit_test_setup_teardown(test_instanceid_predicates, setup_f, teardown_f),
                     cmocka_unit_test_setup_teardown(test_canonical, setup_f, teardown_f),
-                    cmocka_unit_test_setup_teardown(test_validate_value, setup_f, teardown_f),};
+                    cmocka_unit_test_setup_teardown(test_validate_value, setup_f, teardown_f),
+                    cmocka_unit_test_setup_teardown(test_validate_range_intervals, setup_f, teardown_f),
+                    cmocka_unit_test_setup_teardown(test_validate_enum_bits_ident, setup_f, teardown_f),
+                    cmocka_unit_test_setup_teardown(test_union_member_types, setup_f, teardown_f),
+                    cmocka_unit_test_setup_teardown(test_inet_types, setup_f, teardown_f),
+                    cmocka_unit_test_setup_teardown(test_date_and_time, setup_f, teardown_f),
+                    cmocka_unit_test_setup_teardown(test_dec64, setup_f, teardown_f),
+                    cmocka_unit_test_setup_teardown(test_string_length, setup_f, teardown_f),
+                    cmocka_unit_test_setup_teardown(test_typedef_chain, setup_f, teardown_f),
+                    cmocka_unit_test_setup_teardown(test_value_checker, setup_f, teardown_f),};
 
     return cmocka_run_group_tests(tests, NULL, NULL);
 }
@@ -271,6 +271,104 @@ test_augment_choice(void **state)
     assert_non_null(st->dt);
 }
 
+static void
+test_autodel_subtree(void **state)
+{
+    struct state *st = (*state);
+    const char *schema =
+    "module autodel {"
+        "namespace urn:libyang:tests:autodel;"
+        "prefix ad;"
+        "leaf sw { type boolean; }"
+        "container c {"
+            "container gated {"
+                "when \"/sw = 'true'\";"
+                "leaf l { type string; }"
+                "list item {"
+                    "key name;"
+                    "leaf name { type string; }"
+                    "leaf v { when \"../name != 'x'\"; type string; }"
+                    "leaf ref { type leafref { path \"../../l\"; } }"
+                "}"
+            "}"
+        "}"
+        "leaf after { when \"/sw = 'true'\"; type string; }"
+    "}";
+    const char *xml =
+    "<sw xmlns=\"urn:libyang:tests:autodel\">true</sw>"
+    "<c xmlns=\"urn:libyang:tests:autodel\"><gated><l>a</l>"
+        "<item><name>a</name><v>1</v><ref>a</ref></item>"
+        "<item><name>b</name><v>2</v><ref>a</ref></item>"
+    "</gated></c>"
+    "<after xmlns=\"urn:libyang:tests:autodel\">z</after>";
+
+    st->mod2 = lys_parse_mem(st->ctx, schema, LYS_IN_YANG);
+    assert_non_null(st->mod2);
+
+    st->dt = lyd_parse_mem(st->ctx, xml, LYD_XML, LYD_OPT_CONFIG | LYD_OPT_STRICT);
+    assert_non_null(st->dt);
+
+    /* the whole subtree including the nested when and leafref nodes is removed together with the empty parent */
+    assert_int_equal(lyd_change_leaf((struct lyd_node_leaf_list *)st->dt, "false"), 0);
+    assert_int_equal(lyd_validate(&st->dt, LYD_OPT_CONFIG | LYD_OPT_WHENAUTODEL, NULL), 0);
+
+    lyd_print_mem(&st->xml, st->dt, LYD_XML, LYP_WITHSIBLINGS);
+    assert_string_equal(st->xml, "<sw xmlns=\"urn:libyang:tests:autodel\">false</sw>");
+}
+
+static void
+test_shared_paths(void **state)
+{
+    struct state *st = (*state);
+    const char *schema =
+    "module shared {"
+        "namespace urn:libyang:tests:shared;"
+        "prefix sh;"
+        "list item {"
+            "key name;"
+            "leaf name { type string; }"
+            "leaf type { type string; }"
+            "leaf mode { when \"../type = 'eth'\"; type string; }"
+            "leaf a { when \"../mode\"; type string; }"
+            "leaf b { when \"../mode\"; type string; }"
+            "leaf c { when \"../type = 'eth'\"; must \"../../item[type = 'eth']/name = current()/../name\"; type string; }"
+            "leaf peer { must \"../../item[name = current()]/type = 'eth'\"; type string; }"
+        "}"
+    "}";
+    const char *xml =
+    "<item xmlns=\"urn:libyang:tests:shared\"><name>x</name><type>eth</type><mode>m</mode><a>1</a><b>2</b><c>3</c></item>"
+    "<item xmlns=\"urn:libyang:tests:shared\"><name>y</name><type>eth</type><mode>m</mode><a>1</a><b>2</b><c>3</c>"
+        "<peer>x</peer></item>";
+    struct ly_set *set;
+
+    st->mod2 = lys_parse_mem(st->ctx, schema, LYS_IN_YANG);
+    assert_non_null(st->mod2);
+
+    st->dt = lyd_parse_mem(st->ctx, xml, LYD_XML, LYD_OPT_CONFIG | LYD_OPT_STRICT);
+    assert_non_null(st->dt);
+
+    /* the paths shared by the siblings and the instances are evaluated for each of them */
+    set = lyd_find_path(st->dt, "/shared:item[name='x']/type");
+    assert_non_null(set);
+    assert_int_equal(set->number, 1);
+    assert_int_equal(lyd_change_leaf((struct lyd_node_leaf_list *)set->set.d[0], "ppp"), 0);
+    ly_set_free(set);
+    assert_int_equal(lyd_validate(&st->dt, LYD_OPT_CONFIG | LYD_OPT_WHENAUTODEL, NULL), 1);
+    assert_int_equal(ly_vecode(st->ctx), LYVE_NOMUST);
+
+    set = lyd_find_path(st->dt, "/shared:item[name='y']/peer");
+    assert_non_null(set);
+    assert_int_equal(set->number, 1);
+    lyd_free(set->set.d[0]);
+    ly_set_free(set);
+    assert_int_equal(lyd_validate(&st->dt, LYD_OPT_CONFIG | LYD_OPT_WHENAUTODEL, NULL), 0);
+
+    lyd_print_mem(&st->xml, st->dt, LYD_XML, LYP_WITHSIBLINGS);
+    assert_string_equal(st->xml,
+    "<item xmlns=\"urn:libyang:tests:shared\"><name>x</name><type>ppp</type></item>"
+    "<item xmlns=\"urn:libyang:tests:shared\"><name>y</name><type>eth</type><mode>m</mode><a>1</a><b>2</b><c>3</c></item>");
+}
+
 int main(void)
 {
     const struct CMUnitTest tests[] = {
@@ -281,6 +379,8 @@ int main(void)
                     cmocka_unit_test_setup_teardown(test_insert_noautodel, setup_f, teardown_f),
                     cmocka_unit_test_setup_teardown(test_value_prefix, setup_f, teardown_f),
                     cmocka_unit_test_setup_teardown(test_augment_choice, setup_f, teardown_f),
+                    cmocka_unit_test_setup_teardown(test_autodel_subtree, setup_f, teardown_f),
+                    cmocka_unit_test_setup_teardown(test_shared_paths, setup_f, teardown_f),
     };
 
     return cmocka_run_group_tests(tests, NULL, NULL);
@@ -148,6 +148,41 @@ test_unlink_augment(void **state)
     assert_string_equal(st->xml, "<top xmlns=\"urn:libyang:tests:when-unlink\"><d>1</d><d>2</d></top>");
 }
 
+static void
+test_unlink_toplevel(void **state)
+{
+    struct state *st = (struct state *)*state;
+    struct lyd_node *node;
+    const char *schema =
+    "module when-unlink-top {"
+        "namespace urn:libyang:tests:when-unlink-top;"
+        "prefix wut;"
+        "grouping g { leaf y { type string; } }"
+        "uses g { when \"/x and not(/y)\"; }"
+        "leaf x { type string; }"
+        "leaf z { type string; }"
+    "}";
+
+    /* schema */
+    st->mod = lys_parse_mem(st->ctx, schema, LYS_IN_YANG);
+    assert_ptr_not_equal(st->mod, NULL);
+
+    st->dt = lyd_new_path(NULL, st->ctx, "/when-unlink-top:z", "val_z", 0, 0);
+    assert_ptr_not_equal(st->dt, NULL);
+    node = lyd_new_path(st->dt, st->ctx, "/when-unlink-top:y", "val_y", 0, 0);
+    assert_ptr_not_equal(node, NULL);
+    node = lyd_new_path(st->dt, st->ctx, "/when-unlink-top:x", "val_x", 0, 0);
+    assert_ptr_not_equal(node, NULL);
+
+    /* y is not accessible from its when, the top-level nodes are kept in place */
+    assert_int_equal(lyd_validate(&(st->dt), LYD_OPT_CONFIG, NULL), 0);
+
+    lyd_print_mem(&(st->xml), st->dt, LYD_XML, LYP_WITHSIBLINGS);
+    assert_string_equal(st->xml, "<z xmlns=\"urn:libyang:tests:when-unlink-top\">val_z</z>"
+                                 "<y xmlns=\"urn:libyang:tests:when-unlink-top\">val_y</y>"
+                                 "<x xmlns=\"urn:libyang:tests:when-unlink-top\">val_x</x>");
+}
+
 static void
 test_dummy(void **state)
 {
@@ -242,6 +277,7 @@ int main(void)
                     cmocka_unit_test_setup_teardown(test_unlink_choice, setup_f, teardown_f),
                     cmocka_unit_test_setup_teardown(test_unlink_case, setup_f, teardown_f),
                     cmocka_unit_test_setup_teardown(test_unlink_augment, setup_f, teardown_f),
+                    cmocka_unit_test_setup_teardown(test_unlink_toplevel, setup_f, teardown_f),
                     cmocka_unit_test_setup_teardown(test_dummy, setup_f, teardown_f),
                     cmocka_unit_test_setup_teardown(test_dependency_noautodel, setup_f, teardown_f),
                     cmocka_unit_test_setup_teardown(test_dependency_circular, setup_f, teardown_f),
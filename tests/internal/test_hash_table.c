@@ -65,6 +65,20 @@ setup_f_resize(void **state)
     return 0;
 }
 
+static int
+setup_f_incremental(void **state)
+{
+    (void)state;
+
+    ht = lyht_new(64, sizeof(int), val_equal, NULL, 1 | LYHT_RESIZE_INCREMENTAL);
+    if (!ht) {
+        fprintf(stderr, "Failed to create hash table.\n");
+        return -1;
+    }
+
+    return 0;
+}
+
 static int
 teardown_f(void **state)
 {
@@ -125,116 +139,87 @@ test_half_full(void **state)
     assert_int_equal(lyht_find(ht, &l, l, NULL), 1);
 }
 
+static int
+count_ctrl(uint8_t ctrl)
+{
+    uint32_t i;
+    int count = 0;
+
+    for (i = 0; i < ht->size; ++i) {
+        if ((ctrl == LYHT_CTRL_FULL) ? (ht->ctrl[i] & LYHT_CTRL_FULL) : (ht->ctrl[i] == ctrl)) {
+            ++count;
+        }
+    }
+
+    return count;
+}
+
 static void
 test_resize(void **state)
 {
     int i;
-    struct ht_rec *rec;
     (void)state;
 
-    for (i = 2; i < 8; ++i) {
+    for (i = 2; i < 14; ++i) {
         assert_int_equal(lyht_insert(ht, &i, i, NULL), 0);
     }
 
-    assert_int_equal(ht->size, 16);
-
-    for (i = 0; i < 2; ++i) {
-        rec = lyht_get_rec(ht->recs, ht->rec_size, i);
-        assert_int_equal(rec->hits, 0);
-    }
-    for (; i < 8; ++i) {
-        rec = lyht_get_rec(ht->recs, ht->rec_size, i);
-        assert_int_equal(rec->hits, 1);
-        assert_int_equal(rec->hash, i);
-    }
-    for (; i < 16; ++i) {
-        rec = lyht_get_rec(ht->recs, ht->rec_size, i);
-        assert_int_equal(rec->hits, 0);
-    }
+    assert_int_equal(ht->size, 32);
+    assert_int_equal(count_ctrl(LYHT_CTRL_FULL), 12);
+    assert_int_equal(count_ctrl(LYHT_CTRL_EMPTY), 20);
 
     for (i = 0; i < 2; ++i) {
         assert_int_equal(lyht_find(ht, &i, i, NULL), 1);
     }
-    for (; i < 8; ++i) {
+    for (; i < 14; ++i) {
         assert_int_equal(lyht_find(ht, &i, i, NULL), 0);
     }
 
     for (i = 0; i < 2; ++i) {
         assert_int_equal(lyht_remove(ht, &i, i), 1);
     }
-    for (; i < 8; ++i) {
+    for (; i < 14; ++i) {
         assert_int_equal(lyht_remove(ht, &i, i), 0);
     }
 
-    assert_int_equal(ht->size, 8);
+    assert_int_equal(ht->size, 16);
+    assert_int_equal(count_ctrl(LYHT_CTRL_EMPTY), 16);
 
-    for (i = 0; i < 8; ++i) {
+    for (i = 0; i < 14; ++i) {
         assert_int_equal(lyht_find(ht, &i, i, NULL), 1);
     }
 }
 
-#define GET_REC_VAL(rec) (*((int *)&(rec)->val))
-
 static void
 test_collisions(void **state)
 {
-    int i;
-    struct ht_rec *rec;
+    int i, count;
+    int *match;
     (void)state;
 
     for (i = 2; i < 6; ++i) {
         assert_int_equal(lyht_insert(ht, &i, 2, NULL), 0);
     }
+    assert_int_equal(count_ctrl(LYHT_CTRL_FULL), 4);
 
-    /* check all records */
-    for (i = 0; i < 2; ++i) {
-        rec = lyht_get_rec(ht->recs, ht->rec_size, i);
-        assert_int_equal(rec->hits, 0);
-    }
-    rec = lyht_get_rec(ht->recs, ht->rec_size, i);
-    assert_int_equal(rec->hits, 4);
-    assert_int_equal(GET_REC_VAL(rec), i);
-    ++i;
-    for (; i < 6; ++i) {
-        rec = lyht_get_rec(ht->recs, ht->rec_size, i);
-        assert_int_equal(rec->hits, 1);
-        assert_int_equal(GET_REC_VAL(rec), i);
-    }
-    for (; i < 8; ++i) {
-        rec = lyht_get_rec(ht->recs, ht->rec_size, i);
-        assert_int_equal(rec->hits, 0);
+    /* all the values with the same hash are found */
+    i = 2;
+    assert_int_equal(lyht_find(ht, &i, 2, (void **)&match), 0);
+    count = 1;
+    while (!lyht_find_next(ht, match, 2, (void **)&match)) {
+        ++count;
     }
+    assert_int_equal(count, 4);
 
     i = 4;
     assert_int_equal(lyht_remove(ht, &i, 2), 0);
-
-    rec = lyht_get_rec(ht->recs, ht->rec_size, i);
-    assert_int_equal(rec->hits, -1);
-
     i = 2;
     assert_int_equal(lyht_remove(ht, &i, 2), 0);
 
-    /* check all records */
-    for (i = 0; i < 2; ++i) {
-        rec = lyht_get_rec(ht->recs, ht->rec_size, i);
-        assert_int_equal(rec->hits, 0);
-    }
-    rec = lyht_get_rec(ht->recs, ht->rec_size, i);
-    assert_int_equal(rec->hits, 2);
-    assert_int_equal(GET_REC_VAL(rec), 5);
-    ++i;
-    rec = lyht_get_rec(ht->recs, ht->rec_size, i);
-    assert_int_equal(rec->hits, 1);
-    assert_int_equal(GET_REC_VAL(rec), 3);
-    ++i;
-    for (; i < 6; ++i) {
-        rec = lyht_get_rec(ht->recs, ht->rec_size, i);
-        assert_int_equal(rec->hits, -1);
-    }
-    for (; i < 8; ++i) {
-        rec = lyht_get_rec(ht->recs, ht->rec_size, i);
-        assert_int_equal(rec->hits, 0);
-    }
+    /* there are empty records in the group, so nothing is left deleted */
+    assert_int_equal(count_ctrl(LYHT_CTRL_FULL), 2);
+    assert_int_equal(count_ctrl(LYHT_CTRL_DELETED), 0);
+    assert_int_equal(ht->deleted, 0);
 
     for (i = 0; i < 3; ++i) {
         assert_int_equal(lyht_find(ht, &i, 2, NULL), 1);
@@ -254,18 +239,105 @@ test_collisions(void **state)
     i = 5;
     assert_int_equal(lyht_remove(ht, &i, 2), 0);
 
-    /* check all records */
-    for (i = 0; i < 2; ++i) {
-        rec = lyht_get_rec(ht->recs, ht->rec_size, i);
-        assert_int_equal(rec->hits, 0);
+    assert_int_equal(count_ctrl(LYHT_CTRL_EMPTY), 16);
+}
+
+static void
+test_deleted(void **state)
+{
+    int i;
+    (void)state;
+
+    /* fill the whole table */
+    for (i = 0; i < 16; ++i) {
+        assert_int_equal(lyht_insert(ht, &i, 2, NULL), 0);
     }
-    for (; i < 6; ++i) {
-        rec = lyht_get_rec(ht->recs, ht->rec_size, i);
-        assert_int_equal(rec->hits, -1);
+    assert_int_equal(count_ctrl(LYHT_CTRL_FULL), 16);
+
+    /* no empty records, removed ones must stay deleted */
+    i = 4;
+    assert_int_equal(lyht_remove(ht, &i, 2), 0);
+    i = 7;
+    assert_int_equal(lyht_remove(ht, &i, 2), 0);
+    assert_int_equal(count_ctrl(LYHT_CTRL_DELETED), 2);
+    assert_int_equal(ht->deleted, 2);
+
+    for (i = 0; i < 16; ++i) {
+        assert_int_equal(lyht_find(ht, &i, 2, NULL), ((i == 4) || (i == 7)) ? 1 : 0);
     }
-    for (; i < 8; ++i) {
-        rec = lyht_get_rec(ht->recs, ht->rec_size, i);
-        assert_int_equal(rec->hits, 0);
+
+    /* deleted records are reused */
+    i = 20;
+    assert_int_equal(lyht_insert(ht, &i, 2, NULL), 0);
+    assert_int_equal(ht->deleted, 1);
+    assert_int_equal(lyht_find(ht, &i, 2, NULL), 0);
+}
+
+static void
+test_churn(void **state)
+{
+    int i, j;
+    (void)state;
+
+    /* keep the table around half full while constantly replacing the values */
+    for (i = 0; i < 40; ++i) {
+        assert_int_equal(lyht_insert(ht, &i, i, NULL), 0);
+    }
+    for (j = 0; j < 2000; ++j, ++i) {
+        assert_int_equal(lyht_insert(ht, &i, i, NULL), 0);
+        assert_int_equal(lyht_remove(ht, &j, j), 0);
+        assert_int_equal(ht->used, 40);
+        assert_true(ht->used + ht->deleted < ht->size);
+    }
+    assert_true(ht->size <= 128);
+
+    for (j = 0; j < i; ++j) {
+        assert_int_equal(lyht_find(ht, &j, j, NULL), (j < i - 40) ? 1 : 0);
+    }
+}
+
+static void
+test_incremental(void **state)
+{
+    int i, count;
+    int *match;
+    (void)state;
+
+    /* the last insert starts the resize, all the values stay in the previous records */
+    for (i = 0; i < 48; ++i) {
+        assert_int_equal(lyht_insert(ht, &i, i % 40, NULL), 0);
+    }
+    assert_int_equal(ht->size, 128);
+    assert_int_equal(ht->old_size, 64);
+    assert_non_null(ht->old_recs);
+    assert_int_equal(count_ctrl(LYHT_CTRL_FULL), 0);
+
+    for (i = 0; i < 48; ++i) {
+        assert_int_equal(lyht_find(ht, &i, i % 40, NULL), 0);
+    }
+
+    /* every modification migrates some records */
+    i = 0;
+    assert_int_equal(lyht_insert(ht, &i, 0, NULL), 1);
+    assert_non_null(ht->old_recs);
+    assert_int_equal(ht->migrated, 2);
+    i = 47;
+    assert_int_equal(lyht_remove(ht, &i, 7), 0);
+    assert_null(ht->old_recs);
+    assert_int_equal(count_ctrl(LYHT_CTRL_FULL), 47);
+    assert_int_equal(ht->used, 47);
+
+    /* values with the same hash are all found */
+    i = 1;
+    assert_int_equal(lyht_find(ht, &i, 1, (void **)&match), 0);
+    count = 1;
+    while (!lyht_find_next(ht, match, 1, (void **)&match)) {
+        ++count;
+    }
+    assert_int_equal(count, 2);
+
+    for (i = 0; i < 48; ++i) {
+        assert_int_equal(lyht_find(ht, &i, i % 40, NULL), (i == 47) ? 1 : 0);
     }
 }
 
@@ -276,6 +348,9 @@ int main(void)
         cmocka_unit_test_setup_teardown(test_half_full, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_resize, setup_f_resize, teardown_f),
         cmocka_unit_test_setup_teardown(test_collisions, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_deleted, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_churn, setup_f_resize, teardown_f),
+        cmocka_unit_test_setup_teardown(test_incremental, setup_f_incremental, teardown_f),
     };
 
     return cmocka_run_group_tests(tests, NULL, NULL);
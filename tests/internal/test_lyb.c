@@ -657,6 +657,275 @@ test_leafrefs(void **state)
     check_data_tree(st->dt1, st->dt2);
 }
 
+static void
+test_feature_change(void **state)
+{
+    struct state *st = (*state);
+    const struct lys_module *mod;
+    const char *yang = "module f {namespace urn:f; prefix f; feature ft;"
+        "container c {leaf a {type string;} leaf b {if-feature ft; type string;}}}";
+    int ret;
+
+    mod = lys_parse_mem(st->ctx, yang, LYS_IN_YANG);
+    assert_non_null(mod);
+
+    /* hash the siblings without the disabled leaf */
+    st->dt1 = lyd_parse_mem(st->ctx, "<c xmlns=\"urn:f\"><a>a</a></c>", LYD_XML, LYD_OPT_CONFIG);
+    assert_ptr_not_equal(st->dt1, NULL);
+    ret = lyd_print_mem(&st->mem, st->dt1, LYD_LYB, LYP_WITHSIBLINGS);
+    assert_int_equal(ret, 0);
+    lyd_free_withsiblings(st->dt1);
+    free(st->mem);
+
+    /* the siblings must be hashed again */
+    assert_int_equal(lys_features_enable(mod, "ft"), 0);
+    st->dt1 = lyd_parse_mem(st->ctx, "<c xmlns=\"urn:f\"><a>a</a><b>b</b></c>", LYD_XML, LYD_OPT_CONFIG);
+    assert_ptr_not_equal(st->dt1, NULL);
+    ret = lyd_print_mem(&st->mem, st->dt1, LYD_LYB, LYP_WITHSIBLINGS);
+    assert_int_equal(ret, 0);
+
+    st->dt2 = lyd_parse_mem(st->ctx, st->mem, LYD_LYB, LYD_OPT_CONFIG | LYD_OPT_STRICT);
+    assert_ptr_not_equal(st->dt2, NULL);
+
+    check_data_tree(st->dt1, st->dt2);
+}
+
+static void
+test_string_table(void **state)
+{
+    struct state *st = (*state);
+    const char *yang = "module s {namespace urn:s; prefix s;"
+        "list l {key k; leaf k {type uint8;} leaf v {type string;} leaf w {type string;}}}";
+    const char *xml = "<l xmlns=\"urn:s\"><k>1</k><v>repeated value</v><w>other value</w></l>"
+        "<l xmlns=\"urn:s\"><k>2</k><v>repeated value</v><w>other value</w></l>"
+        "<l xmlns=\"urn:s\"><k>3</k><v>repeated value</v><w></w></l>"
+        "<l xmlns=\"urn:s\"><k>4</k><v></v><w>repeated value</w></l>";
+    char *mem;
+    int ret;
+
+    assert_non_null(lys_parse_mem(st->ctx, yang, LYS_IN_YANG));
+    st->dt1 = lyd_parse_mem(st->ctx, xml, LYD_XML, LYD_OPT_CONFIG);
+    assert_ptr_not_equal(st->dt1, NULL);
+
+    ret = lyd_print_mem(&mem, st->dt1, LYD_LYB, LYP_WITHSIBLINGS);
+    assert_int_equal(ret, 0);
+    ret = lyd_print_mem(&st->mem, st->dt1, LYD_LYB, LYP_WITHSIBLINGS | LYP_STRTABLE);
+    assert_int_equal(ret, 0);
+    assert_true(lyd_lyb_data_length(st->mem) < lyd_lyb_data_length(mem));
+    free(mem);
+
+    st->dt2 = lyd_parse_mem(st->ctx, st->mem, LYD_LYB, LYD_OPT_CONFIG | LYD_OPT_STRICT);
+    assert_ptr_not_equal(st->dt2, NULL);
+
+    check_data_tree(st->dt1, st->dt2);
+}
+
+static void
+test_index(void **state)
+{
+    struct state *st = (*state);
+    const char *yang1 = "module s {namespace urn:s; prefix s;"
+        "list l {key k; leaf k {type uint8;} leaf v {type string;}} container c {leaf v {type string;}}}";
+    const char *yang2 = "module t {namespace urn:t; prefix t; leaf-list ll {type string;}}";
+    const char *xml = "<l xmlns=\"urn:s\"><k>1</k><v>value</v></l>"
+        "<l xmlns=\"urn:s\"><k>2</k><v>value</v></l>"
+        "<c xmlns=\"urn:s\"><v>value</v></c>"
+        "<ll xmlns=\"urn:t\">value</ll><ll xmlns=\"urn:t\">other</ll>";
+    int ret;
+
+    assert_non_null(lys_parse_mem(st->ctx, yang1, LYS_IN_YANG));
+    assert_non_null(lys_parse_mem(st->ctx, yang2, LYS_IN_YANG));
+    st->dt1 = lyd_parse_mem(st->ctx, xml, LYD_XML, LYD_OPT_CONFIG);
+    assert_ptr_not_equal(st->dt1, NULL);
+
+    ret = lyd_print_mem(&st->mem, st->dt1, LYD_LYB, LYP_WITHSIBLINGS | LYP_STRTABLE | LYP_INDEX);
+    assert_int_equal(ret, 0);
+
+    /* the whole data */
+    st->dt2 = lyd_parse_mem(st->ctx, st->mem, LYD_LYB, LYD_OPT_CONFIG | LYD_OPT_STRICT);
+    assert_ptr_not_equal(st->dt2, NULL);
+    check_data_tree(st->dt1, st->dt2);
+    lyd_free_withsiblings(st->dt2);
+
+    /* a single list instance, using the string table */
+    st->dt2 = lyd_parse_lyb_subtrees(st->ctx, st->mem, lyd_lyb_data_length(st->mem), LYD_OPT_CONFIG, "/s:l[k='2']");
+    assert_ptr_not_equal(st->dt2, NULL);
+    assert_ptr_equal(st->dt2->next, NULL);
+    assert_string_equal(((struct lyd_node_leaf_list *)st->dt2->child)->value_str, "2");
+    assert_string_equal(((struct lyd_node_leaf_list *)st->dt2->child->next)->value_str, "value");
+    lyd_free_withsiblings(st->dt2);
+
+    /* all the instances */
+    st->dt2 = lyd_parse_lyb_subtrees(st->ctx, st->mem, 0, LYD_OPT_CONFIG, "/s:l");
+    assert_ptr_not_equal(st->dt2, NULL);
+    assert_ptr_not_equal(st->dt2->next, NULL);
+    assert_ptr_equal(st->dt2->next->next, NULL);
+    lyd_free_withsiblings(st->dt2);
+
+    /* a module */
+    st->dt2 = lyd_parse_lyb_subtrees(st->ctx, st->mem, 0, LYD_OPT_CONFIG, "/t:*");
+    assert_ptr_not_equal(st->dt2, NULL);
+    assert_string_equal(st->dt2->schema->name, "ll");
+    assert_string_equal(((struct lyd_node_leaf_list *)st->dt2)->value_str, "value");
+    assert_string_equal(((struct lyd_node_leaf_list *)st->dt2->next)->value_str, "other");
+    lyd_free_withsiblings(st->dt2);
+
+    /* a container, not its prefix */
+    st->dt2 = lyd_parse_lyb_subtrees(st->ctx, st->mem, 0, LYD_OPT_CONFIG, "/s:c");
+    assert_ptr_not_equal(st->dt2, NULL);
+    assert_ptr_equal(st->dt2->next, NULL);
+    assert_string_equal(((struct lyd_node_leaf_list *)st->dt2->child)->value_str, "value");
+    lyd_free_withsiblings(st->dt2);
+    st->dt2 = lyd_parse_lyb_subtrees(st->ctx, st->mem, 0, LYD_OPT_CONFIG, "/s:");
+    assert_ptr_equal(st->dt2, NULL);
+}
+
+static const char *
+ident_submodule_clb(const char *mod_name, const char *mod_rev, const char *submod_name, const char *sub_rev,
+                    void *user_data, LYS_INFORMAT *format, void (**free_module_data)(void *model_data, void *user_data))
+{
+    (void)mod_name;
+    (void)mod_rev;
+    (void)sub_rev;
+    (void)free_module_data;
+
+    if (!submod_name || strcmp(submod_name, "s-sub")) {
+        return NULL;
+    }
+    *format = LYS_IN_YANG;
+    return user_data;
+}
+
+static void
+test_ident_index(void **state)
+{
+    struct state *st = (*state);
+    const char *yang1 = "module t {namespace urn:t; prefix t; identity base; identity t1 {base base;}}";
+    const char *yang2 = "submodule s-sub {belongs-to s {prefix s;} import t {prefix t;}"
+        "identity s3 {base t:base;}}";
+    const char *yang3 = "module s {namespace urn:s; prefix s; import t {prefix t;} include s-sub;"
+        "identity s1 {base t:base;} identity s2 {base s1;}"
+        "list l {key k; leaf k {type uint8;} leaf v {type identityref {base t:base;}}}}";
+    const char *xml = "<l xmlns=\"urn:s\"><k>1</k><v>s2</v></l>"
+        "<l xmlns=\"urn:s\" xmlns:t=\"urn:t\"><k>2</k><v>t:t1</v></l>"
+        "<l xmlns=\"urn:s\"><k>3</k><v>s3</v></l>"
+        "<l xmlns=\"urn:s\"><k>4</k><v>s1</v></l>";
+    struct lyd_node *node1, *node2;
+    int ret;
+
+    assert_non_null(lys_parse_mem(st->ctx, yang1, LYS_IN_YANG));
+    ly_ctx_set_module_imp_clb(st->ctx, ident_submodule_clb, (void *)yang2);
+    assert_non_null(lys_parse_mem(st->ctx, yang3, LYS_IN_YANG));
+    st->dt1 = lyd_parse_mem(st->ctx, xml, LYD_XML, LYD_OPT_CONFIG);
+    assert_ptr_not_equal(st->dt1, NULL);
+
+    /* identities stored as strings by default */
+    ret = lyd_print_mem(&st->mem, st->dt1, LYD_LYB, LYP_WITHSIBLINGS | LYP_STRTABLE);
+    assert_int_equal(ret, 0);
+    assert_false(st->mem[3] & LYB_HEADER_IDENTIDX);
+    st->dt2 = lyd_parse_mem(st->ctx, st->mem, LYD_LYB, LYD_OPT_CONFIG | LYD_OPT_STRICT);
+    assert_ptr_not_equal(st->dt2, NULL);
+    check_data_tree(st->dt1, st->dt2);
+    lyd_free_withsiblings(st->dt2);
+    free(st->mem);
+
+    ret = lyd_print_mem(&st->mem, st->dt1, LYD_LYB, LYP_WITHSIBLINGS | LYP_STRTABLE | LYP_IDENTIDX);
+    assert_int_equal(ret, 0);
+    assert_true(st->mem[3] & LYB_HEADER_IDENTIDX);
+
+    /* validated */
+    st->dt2 = lyd_parse_mem(st->ctx, st->mem, LYD_LYB, LYD_OPT_CONFIG | LYD_OPT_STRICT);
+    assert_ptr_not_equal(st->dt2, NULL);
+    check_data_tree(st->dt1, st->dt2);
+    lyd_free_withsiblings(st->dt2);
+
+    /* trusted, identities are not resolved again */
+    st->dt2 = lyd_parse_mem(st->ctx, st->mem, LYD_LYB, LYD_OPT_CONFIG | LYD_OPT_STRICT | LYD_OPT_TRUSTED);
+    assert_ptr_not_equal(st->dt2, NULL);
+    check_data_tree(st->dt1, st->dt2);
+
+    for (node1 = st->dt1, node2 = st->dt2; node1; node1 = node1->next, node2 = node2->next) {
+        assert_ptr_equal(((struct lyd_node_leaf_list *)node1->child->next)->value.ident,
+                         ((struct lyd_node_leaf_list *)node2->child->next)->value.ident);
+    }
+    assert_string_equal(((struct lyd_node_leaf_list *)st->dt2->next->next->child->next)->value_str, "s:s3");
+}
+
+static void
+test_lazy(void **state)
+{
+    struct state *st = (*state);
+    struct lyd_lazy *lazy;
+    struct ly_set *set;
+    struct lyd_node *tree;
+    char *mem;
+    const char *yang1 = "module s {namespace urn:s; prefix s;"
+        "list l {key k; leaf k {type uint8;} leaf v {type string;} leaf r {type leafref {path \"../v\";}}}"
+        "container c {leaf ref {type leafref {path \"/s:l/s:k\";}}}}";
+    const char *yang2 = "module t {namespace urn:t; prefix t; leaf-list ll {type string;}}";
+    const char *xml = "<l xmlns=\"urn:s\"><k>1</k><v>value</v><r>value</r></l>"
+        "<l xmlns=\"urn:s\"><k>2</k><v>value</v></l>"
+        "<c xmlns=\"urn:s\"><ref>2</ref></c>"
+        "<ll xmlns=\"urn:t\">value</ll><ll xmlns=\"urn:t\">other</ll>";
+
+    assert_non_null(lys_parse_mem(st->ctx, yang1, LYS_IN_YANG));
+    assert_non_null(lys_parse_mem(st->ctx, yang2, LYS_IN_YANG));
+    st->dt1 = lyd_parse_mem(st->ctx, xml, LYD_XML, LYD_OPT_CONFIG);
+    assert_ptr_not_equal(st->dt1, NULL);
+
+    /* the index is required */
+    assert_int_equal(lyd_print_mem(&st->mem, st->dt1, LYD_LYB, LYP_WITHSIBLINGS), 0);
+    assert_ptr_equal(lyd_lazy_new(st->ctx, st->mem, 0, LYD_OPT_CONFIG), NULL);
+    free(st->mem);
+
+    assert_int_equal(lyd_print_mem(&st->mem, st->dt1, LYD_LYB, LYP_WITHSIBLINGS | LYP_STRTABLE | LYP_INDEX), 0);
+    lazy = lyd_lazy_new(st->ctx, st->mem, 0, LYD_OPT_CONFIG);
+    assert_ptr_not_equal(lazy, NULL);
+
+    /* only the instance */
+    set = lyd_lazy_find_path(lazy, "/s:l[k='2']/v");
+    assert_ptr_not_equal(set, NULL);
+    assert_int_equal(set->number, 1);
+    assert_string_equal(((struct lyd_node_leaf_list *)set->set.d[0])->value_str, "value");
+    ly_set_free(set);
+    tree = lyd_lazy_tree(lazy, "/s:");
+    assert_ptr_not_equal(tree, NULL);
+    assert_ptr_equal(tree->next, NULL);
+
+    /* all the instances of a leaf-list, after the parsed list instance */
+    set = lyd_lazy_find_path(lazy, "/t:ll");
+    assert_ptr_not_equal(set, NULL);
+    assert_int_equal(set->number, 2);
+    ly_set_free(set);
+    tree = lyd_lazy_tree(lazy, "/s:l");
+    assert_string_equal(((struct lyd_node_leaf_list *)tree->child)->value_str, "1");
+    assert_string_equal(((struct lyd_node_leaf_list *)tree->next->child)->value_str, "2");
+    assert_string_equal(tree->next->next->schema->name, "ll");
+    assert_ptr_equal(tree->prev, tree->next->next->next);
+
+    /* the leaf-list instances were used least recently */
+    assert_int_equal(lyd_lazy_evict(lazy, 2), 2);
+    tree = lyd_lazy_tree(lazy, "/s:");
+    assert_ptr_equal(tree->next->next, NULL);
+    assert_ptr_equal(tree->prev, tree->next);
+
+    /* reference into another subtree stays unresolved */
+    set = lyd_lazy_find_path(lazy, "/s:c/ref");
+    assert_ptr_not_equal(set, NULL);
+    assert_int_equal(set->number, 1);
+    assert_string_equal(((struct lyd_node_leaf_list *)set->set.d[0])->value_str, "2");
+    ly_set_free(set);
+
+    /* the same as the original data */
+    assert_int_equal(lyd_lazy_print_mem(&mem, lazy, LYD_XML, 0), 0);
+    assert_string_equal(mem, xml);
+    free(mem);
+
+    assert_int_equal(lyd_lazy_evict(lazy, 0), 5);
+    assert_ptr_equal(lyd_lazy_tree(lazy, "/s:"), NULL);
+    lyd_lazy_free(lazy);
+}
+
 int
 main(void)
 {
@@ -675,6 +944,11 @@ main(void)
         cmocka_unit_test_setup_teardown(test_submodule_feature, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_coliding_augments, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_leafrefs, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_feature_change, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_string_table, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_index, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_ident_index, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_lazy, setup_f, teardown_f),
     };
 
     return cmocka_run_group_tests(tests, NULL, NULL);
@@ -106,6 +106,19 @@ test_hash(void **state)
 
     lyd_free(st->root1->child->child->next);
     lyd_hash_check(st->root1);
+
+    /* an instance built node by node in a different order has the same hash as the parsed one */
+    root = lyd_new(st->root1, NULL, "l");
+    assert_non_null(root);
+    node = lyd_new(root, NULL, "lcont");
+    assert_non_null(node);
+    node = lyd_new(node, NULL, "l2");
+    assert_non_null(node);
+    assert_non_null(lyd_new_leaf(node, NULL, "leaf5", "bb"));
+    assert_non_null(lyd_new_leaf(root, NULL, "leaf2", "20"));
+    assert_non_null(lyd_new_leaf(root, NULL, "leaf1", "b"));
+    assert_int_equal(root->hash, st->root2->child->next->hash);
+    lyd_hash_check(st->root1);
 }
 
 #endif
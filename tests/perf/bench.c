@@ -0,0 +1,585 @@
+/**
+ * @file bench.c
+ * @brief performance test - wall-clock scaling of the core operations over data sizes and threads.
+ *
+ * Copyright (c) 2016 CESNET, z.s.p.o.
+ *
+ * This source code is licensed under BSD 3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://opensource.org/licenses/BSD-3-Clause
+ */
+
+#define _GNU_SOURCE
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <libyang/libyang.h>
+
+static const char *schema =
+    "module bench {"
+    "  namespace urn:libyang:performance:bench;"
+    "  prefix b;"
+    "  container top {"
+    "    list item {"
+    "      key name;"
+    "      leaf name {type string;}"
+    "      leaf value {type uint32;}"
+    "    }"
+    "  }"
+    "}";
+
+/* every list instance is 3 data nodes */
+#define NODES_PER_ITEM 3
+
+/* input shared by all the threads */
+static struct {
+    struct ly_ctx *ctx;
+    unsigned int items;
+    char *xml;
+    char *xml2;     /* modified data for diff and merge */
+    char *json;
+    char *lyb;
+    int alloc_trace;    /* libyang compiled with ENABLE_ALLOC_TRACE */
+    pthread_barrier_t barrier;
+} in;
+
+/* per-thread state */
+struct op;
+
+struct thr {
+    pthread_t tid;
+    const struct op *op;
+    struct ly_ctx *ctx;
+    struct lyd_node *data;
+    struct lyd_node *data2;
+    struct lyd_node *work;
+    struct lyd_difflist *diff;
+    char *out;
+    struct ly_set *set;
+    unsigned int repeats;
+    double *samples;
+    double start;
+    double end;
+    uint64_t allocs;    /* measured allocations, if traced */
+    uint64_t alloc_bytes;
+    int err;
+};
+
+struct op {
+    const char *name;
+    int sized;                          /* depends on the data size */
+    int (*prep)(struct thr *thr);       /* before every sample, not measured */
+    int (*run)(struct thr *thr);        /* measured */
+    void (*post)(struct thr *thr);      /* after every sample, not measured */
+};
+
+static double
+get_time_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000.0 + ts.tv_nsec / 1000.0;
+}
+
+static int
+buf_printf(char **buf, size_t *size, size_t *used, const char *format, ...)
+{
+    va_list ap;
+    int len;
+    char *mem;
+
+    while (1) {
+        va_start(ap, format);
+        len = vsnprintf(*buf + *used, *size - *used, format, ap);
+        va_end(ap);
+        if (len < 0) {
+            return -1;
+        }
+        if (*used + len < *size) {
+            break;
+        }
+
+        *size = (*size + len) * 2;
+        mem = realloc(*buf, *size);
+        if (!mem) {
+            return -1;
+        }
+        *buf = mem;
+    }
+    *used += len;
+
+    return 0;
+}
+
+/* with modify, every 10th value is changed, every 11th item is missing and there are 10 % new items */
+static char *
+generate_data(unsigned int items, int modify)
+{
+    char *buf = NULL;
+    size_t size = 0, used = 0;
+    unsigned int i;
+    int r = 0;
+
+    r |= buf_printf(&buf, &size, &used, "<top xmlns=\"urn:libyang:performance:bench\">");
+    for (i = 0; i < items + (modify ? items / 10 : 0); ++i) {
+        if (modify && !(i % 11)) {
+            continue;
+        }
+        r |= buf_printf(&buf, &size, &used, "<item><name>item%u</name><value>%u</value></item>", i,
+                        (modify && !(i % 10)) ? i + 1 : i);
+    }
+    r |= buf_printf(&buf, &size, &used, "</top>");
+
+    if (r) {
+        free(buf);
+        return NULL;
+    }
+    return buf;
+}
+
+static struct lyd_node *
+parse_xml(struct ly_ctx *ctx, const char *xml, int options)
+{
+    return lyd_parse_mem(ctx, xml, LYD_XML, LYD_OPT_CONFIG | LYD_OPT_STRICT | options);
+}
+
+/*
+ * operations
+ */
+
+static int
+op_ctx_new_run(struct thr *thr)
+{
+    thr->ctx = ly_ctx_new(NULL, 0);
+    return !thr->ctx || !lys_parse_mem(thr->ctx, schema, LYS_IN_YANG);
+}
+
+static void
+op_ctx_new_post(struct thr *thr)
+{
+    ly_ctx_destroy(thr->ctx, NULL);
+    thr->ctx = NULL;
+}
+
+static int
+op_parse_xml_run(struct thr *thr)
+{
+    thr->work = parse_xml(in.ctx, in.xml, 0);
+    return !thr->work;
+}
+
+static int
+op_parse_json_run(struct thr *thr)
+{
+    thr->work = lyd_parse_mem(in.ctx, in.json, LYD_JSON, LYD_OPT_CONFIG | LYD_OPT_STRICT);
+    return !thr->work;
+}
+
+static int
+op_parse_lyb_run(struct thr *thr)
+{
+    thr->work = lyd_parse_mem(in.ctx, in.lyb, LYD_LYB, LYD_OPT_CONFIG | LYD_OPT_STRICT);
+    return !thr->work;
+}
+
+static void
+op_work_post(struct thr *thr)
+{
+    lyd_free_withsiblings(thr->work);
+    thr->work = NULL;
+}
+
+static int
+op_validate_prep(struct thr *thr)
+{
+    thr->work = parse_xml(in.ctx, in.xml, LYD_OPT_TRUSTED);
+    return !thr->work;
+}
+
+static int
+op_validate_run(struct thr *thr)
+{
+    return lyd_validate(&thr->work, LYD_OPT_CONFIG, NULL);
+}
+
+static int
+op_print_xml_run(struct thr *thr)
+{
+    return lyd_print_mem(&thr->out, thr->data, LYD_XML, LYP_WITHSIBLINGS);
+}
+
+static void
+op_print_post(struct thr *thr)
+{
+    free(thr->out);
+    thr->out = NULL;
+}
+
+static int
+op_dup_run(struct thr *thr)
+{
+    thr->work = lyd_dup_withsiblings(thr->data, LYD_DUP_OPT_RECURSIVE);
+    return !thr->work;
+}
+
+static int
+op_diff_run(struct thr *thr)
+{
+    thr->diff = lyd_diff(thr->data, thr->data2, 0);
+    return !thr->diff;
+}
+
+static void
+op_diff_post(struct thr *thr)
+{
+    lyd_free_diff(thr->diff);
+    thr->diff = NULL;
+}
+
+static int
+op_merge_prep(struct thr *thr)
+{
+    thr->work = lyd_dup_withsiblings(thr->data, LYD_DUP_OPT_RECURSIVE);
+    return !thr->work;
+}
+
+static int
+op_merge_run(struct thr *thr)
+{
+    return lyd_merge(thr->work, thr->data2, 0);
+}
+
+static int
+op_find_key_run(struct thr *thr)
+{
+    char path[64];
+
+    sprintf(path, "/bench:top/item[name='item%u']/value", in.items / 2);
+    thr->set = lyd_find_path(thr->data, path);
+    return !thr->set || (thr->set->number != 1);
+}
+
+static int
+op_find_scan_run(struct thr *thr)
+{
+    thr->set = lyd_find_path(thr->data, "/bench:top/item[value mod 2 = 0]");
+    return !thr->set || (thr->set->number != (in.items + 1) / 2);
+}
+
+static void
+op_find_post(struct thr *thr)
+{
+    ly_set_free(thr->set);
+    thr->set = NULL;
+}
+
+static const struct op ops[] = {
+    {"ctx_new", 0, NULL, op_ctx_new_run, op_ctx_new_post},
+    {"parse_xml", 1, NULL, op_parse_xml_run, op_work_post},
+    {"parse_json", 1, NULL, op_parse_json_run, op_work_post},
+    {"parse_lyb", 1, NULL, op_parse_lyb_run, op_work_post},
+    {"validate", 1, op_validate_prep, op_validate_run, op_work_post},
+    {"print_xml", 1, NULL, op_print_xml_run, op_print_post},
+    {"dup", 1, NULL, op_dup_run, op_work_post},
+    {"diff", 1, NULL, op_diff_run, op_diff_post},
+    {"merge", 1, op_merge_prep, op_merge_run, op_work_post},
+    {"find_path_key", 1, NULL, op_find_key_run, op_find_post},
+    {"find_path_scan", 1, NULL, op_find_scan_run, op_find_post},
+    {NULL, 0, NULL, NULL, NULL}
+};
+
+/*
+ * harness
+ */
+
+/* allocations made by libyang so far, only with the allocation tracing compiled in */
+static void
+alloc_totals(uint64_t *calls, uint64_t *bytes)
+{
+    struct ly_alloc_site *sites;
+    uint32_t i, count;
+
+    *calls = *bytes = 0;
+    if (ly_alloc_trace_get(&sites, &count)) {
+        return;
+    }
+    for (i = 0; i < count; ++i) {
+        if (strcmp(sites[i].func, "free")) {
+            *calls += sites[i].calls;
+            *bytes += sites[i].bytes;
+        }
+    }
+    free(sites);
+}
+
+static void *
+bench_thread(void *arg)
+{
+    struct thr *thr = arg;
+    const struct op *op = thr->op;
+    unsigned int i;
+    uint64_t calls, bytes, calls2, bytes2;
+    double start;
+
+    pthread_barrier_wait(&in.barrier);
+    thr->start = get_time_us();
+    for (i = 0; !thr->err && (i < thr->repeats); ++i) {
+        if (op->prep && op->prep(thr)) {
+            thr->err = 1;
+            break;
+        }
+        if (in.alloc_trace) {
+            alloc_totals(&calls, &bytes);
+        }
+        start = get_time_us();
+        thr->err = op->run(thr);
+        thr->samples[i] = get_time_us() - start;
+        if (in.alloc_trace) {
+            alloc_totals(&calls2, &bytes2);
+            thr->allocs += calls2 - calls;
+            thr->alloc_bytes += bytes2 - bytes;
+        }
+        op->post(thr);
+    }
+    thr->end = get_time_us();
+
+    return NULL;
+}
+
+static int
+cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+static double
+percentile(double *sorted, unsigned int count, unsigned int p)
+{
+    return sorted[((count - 1) * p + 50) / 100];
+}
+
+static int
+bench_op(const struct op *op, unsigned int nodes, unsigned int threads, unsigned int repeats, int *first)
+{
+    struct thr *thr;
+    double *samples, start, end, sum = 0;
+    unsigned int i, count = threads * repeats;
+    int ret = 0;
+
+    thr = calloc(threads, sizeof *thr);
+    samples = malloc(count * sizeof *samples);
+    if (!thr || !samples) {
+        free(thr);
+        free(samples);
+        return 1;
+    }
+
+    /* every thread works on its own data trees */
+    for (i = 0; i < threads; ++i) {
+        thr[i].op = op;
+        thr[i].repeats = repeats;
+        thr[i].samples = samples + i * repeats;
+        if (op->sized) {
+            thr[i].data = parse_xml(in.ctx, in.xml, 0);
+            thr[i].data2 = parse_xml(in.ctx, in.xml2, 0);
+            if (!thr[i].data || !thr[i].data2) {
+                ret = 1;
+            }
+        }
+    }
+    if (ret) {
+        goto cleanup;
+    }
+
+    pthread_barrier_init(&in.barrier, NULL, threads + 1);
+    for (i = 0; i < threads; ++i) {
+        pthread_create(&thr[i].tid, NULL, bench_thread, &thr[i]);
+    }
+    pthread_barrier_wait(&in.barrier);
+    for (i = 0; i < threads; ++i) {
+        pthread_join(thr[i].tid, NULL);
+        ret |= thr[i].err;
+    }
+    pthread_barrier_destroy(&in.barrier);
+    if (ret) {
+        fprintf(stderr, "Operation \"%s\" failed (%u nodes, %u threads).\n", op->name, nodes, threads);
+        goto cleanup;
+    }
+
+    /* throughput over the wall-clock time of all the threads */
+    start = thr[0].start;
+    end = thr[0].end;
+    for (i = 1; i < threads; ++i) {
+        start = (thr[i].start < start) ? thr[i].start : start;
+        end = (thr[i].end > end) ? thr[i].end : end;
+    }
+
+    qsort(samples, count, sizeof *samples, cmp_double);
+    for (i = 0; i < count; ++i) {
+        sum += samples[i];
+    }
+    printf("%s    {\"op\": \"%s\", \"nodes\": %u, \"threads\": %u, \"samples\": %u, \"ops_per_s\": %.1f,\n"
+           "     \"us\": {\"min\": %.1f, \"p50\": %.1f, \"p90\": %.1f, \"p99\": %.1f, \"max\": %.1f, \"mean\": %.1f}",
+           *first ? "" : ",\n", op->name, nodes, threads, count, count * 1000000.0 / (end - start), samples[0],
+           percentile(samples, count, 50), percentile(samples, count, 90), percentile(samples, count, 99),
+           samples[count - 1], sum / count);
+    if (in.alloc_trace && (threads == 1)) {
+        /* the counters are global, other threads would be counted as well */
+        printf(",\n     \"allocs_per_op\": %.1f, \"alloc_bytes_per_op\": %.1f}", (double)thr[0].allocs / repeats,
+               (double)thr[0].alloc_bytes / repeats);
+    } else {
+        printf("}");
+    }
+    fflush(stdout);
+    *first = 0;
+
+cleanup:
+    for (i = 0; i < threads; ++i) {
+        lyd_free_withsiblings(thr[i].data);
+        lyd_free_withsiblings(thr[i].data2);
+    }
+    free(thr);
+    free(samples);
+    return ret;
+}
+
+static int
+bench_size(unsigned int nodes)
+{
+    struct lyd_node *data;
+
+    in.items = nodes / NODES_PER_ITEM;
+    in.xml = generate_data(in.items, 0);
+    in.xml2 = generate_data(in.items, 1);
+    if (!in.xml || !in.xml2) {
+        return 1;
+    }
+    data = parse_xml(in.ctx, in.xml, 0);
+    if (!data || lyd_print_mem(&in.json, data, LYD_JSON, LYP_WITHSIBLINGS)
+            || lyd_print_mem(&in.lyb, data, LYD_LYB, LYP_WITHSIBLINGS)) {
+        lyd_free_withsiblings(data);
+        return 1;
+    }
+    lyd_free_withsiblings(data);
+    return 0;
+}
+
+static void
+bench_size_clean(void)
+{
+    free(in.xml);
+    free(in.xml2);
+    free(in.json);
+    free(in.lyb);
+    in.xml = in.xml2 = in.json = in.lyb = NULL;
+}
+
+static int
+op_selected(const char *list, const char *name)
+{
+    size_t len = strlen(name);
+    const char *ptr;
+
+    if (!list) {
+        return 1;
+    }
+    for (ptr = strstr(list, name); ptr; ptr = strstr(ptr + 1, name)) {
+        if (((ptr == list) || (ptr[-1] == ',')) && ((ptr[len] == ',') || !ptr[len])) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+    unsigned int max_nodes = 100000, max_threads = 1, repeats = 10, nodes, threads;
+    const char *selected = NULL;
+    struct ly_alloc_site *sites;
+    uint32_t count;
+    int i, opt, first = 1, ret = 1;
+
+    while ((opt = getopt(argc, argv, "n:t:r:o:h")) != -1) {
+        switch (opt) {
+        case 'n':
+            max_nodes = atoi(optarg);
+            break;
+        case 't':
+            max_threads = atoi(optarg);
+            break;
+        case 'r':
+            repeats = atoi(optarg);
+            break;
+        case 'o':
+            selected = optarg;
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-n max-nodes] [-t max-threads] [-r repeats] [-o op[,op...]]\n"
+                    "Data sizes grow 10 times from 1000 up to max-nodes, thread counts double up to max-threads.\n"
+                    "Operations:", argv[0]);
+            for (i = 0; ops[i].name; ++i) {
+                fprintf(stderr, " %s", ops[i].name);
+            }
+            fprintf(stderr, "\n");
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if ((max_nodes < 1000) || !max_threads || !repeats) {
+        fprintf(stderr, "Invalid arguments.\n");
+        return 1;
+    }
+
+    in.ctx = ly_ctx_new(NULL, 0);
+    if (!in.ctx || !lys_parse_mem(in.ctx, schema, LYS_IN_YANG)) {
+        fprintf(stderr, "Failed to create context.\n");
+        goto cleanup;
+    }
+
+    /* fails if not compiled in */
+    if (!ly_alloc_trace_get(&sites, &count)) {
+        in.alloc_trace = 1;
+        free(sites);
+    }
+    printf("{\"repeats\": %u, \"results\": [\n", repeats);
+    for (threads = 1; threads <= max_threads; threads *= 2) {
+        for (i = 0; ops[i].name; ++i) {
+            if (!ops[i].sized && op_selected(selected, ops[i].name) && bench_op(&ops[i], 0, threads, repeats, &first)) {
+                goto cleanup;
+            }
+        }
+    }
+    for (nodes = 1000; nodes <= max_nodes; nodes *= 10) {
+        if (bench_size(nodes)) {
+            fprintf(stderr, "Failed to generate data of %u nodes.\n", nodes);
+            goto cleanup;
+        }
+        for (threads = 1; threads <= max_threads; threads *= 2) {
+            for (i = 0; ops[i].name; ++i) {
+                if (ops[i].sized && op_selected(selected, ops[i].name)
+                        && bench_op(&ops[i], nodes, threads, repeats, &first)) {
+                    goto cleanup;
+                }
+            }
+        }
+        bench_size_clean();
+    }
+    printf("\n]}\n");
+    ret = 0;
+
+cleanup:
+    bench_size_clean();
+    ly_ctx_destroy(in.ctx, NULL);
+    return ret;
+}
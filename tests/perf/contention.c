@@ -0,0 +1,453 @@
+/**
+ * @file contention.c
+ * @brief performance test - throughput scaling of threads sharing one context and read-only data trees.
+ *
+ * Copyright (c) 2016 CESNET, z.s.p.o.
+ *
+ * This source code is licensed under BSD 3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://opensource.org/licenses/BSD-3-Clause
+ */
+
+#define _GNU_SOURCE
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <libyang/libyang.h>
+
+static const char *schema =
+    "module contention {"
+    "  namespace urn:libyang:performance:contention;"
+    "  prefix c;"
+    "  typedef state { type enumeration { enum up; enum down; enum testing; } }"
+    "  container top {"
+    "    list group {"
+    "      key name;"
+    "      leaf name {type string;}"
+    "    }"
+    "    list item {"
+    "      key name;"
+    "      leaf name {type string;}"
+    "      leaf value {type uint32 {range \"0..1000000\";}}"
+    "      leaf state {type state;}"
+    "      leaf group {type leafref {path \"../../group/name\";}}"
+    "      leaf tag {type union {type uint8; type string {length 1..16;}}}"
+    "    }"
+    "  }"
+    "}";
+
+/* data shared by all the threads, the trees are never modified while the threads run */
+static struct {
+    struct ly_ctx *ctx;
+    unsigned int items;
+    unsigned int iters;
+    char *xml;
+    char *xml_invalid;
+    struct lyd_node *data;
+    pthread_barrier_t barrier;
+} in;
+
+struct thr {
+    pthread_t tid;
+    int (*run)(struct thr *thr);
+    unsigned int seed;
+    double start;
+    double end;
+    int err;
+};
+
+static double
+get_time_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000.0 + ts.tv_nsec / 1000.0;
+}
+
+static int
+buf_printf(char **buf, size_t *size, size_t *used, const char *format, ...)
+{
+    va_list ap;
+    int len;
+    char *mem;
+
+    while (1) {
+        va_start(ap, format);
+        len = vsnprintf(*buf + *used, *size - *used, format, ap);
+        va_end(ap);
+        if (len < 0) {
+            return -1;
+        }
+        if (*used + len < *size) {
+            break;
+        }
+
+        *size = (*size + len) * 2;
+        mem = realloc(*buf, *size);
+        if (!mem) {
+            return -1;
+        }
+        *buf = mem;
+    }
+    *used += len;
+
+    return 0;
+}
+
+/* with invalid, the value of the last item is out of its range */
+static char *
+generate_data(unsigned int items, int invalid)
+{
+    static const char *states[] = {"up", "down", "testing"};
+    char *buf = NULL;
+    size_t size = 0, used = 0;
+    unsigned int i;
+    int r = 0;
+
+    r |= buf_printf(&buf, &size, &used, "<top xmlns=\"urn:libyang:performance:contention\">");
+    for (i = 0; i < 10; ++i) {
+        r |= buf_printf(&buf, &size, &used, "<group><name>group%u</name></group>", i);
+    }
+    for (i = 0; i < items; ++i) {
+        r |= buf_printf(&buf, &size, &used, "<item><name>item%u</name><value>%u</value><state>%s</state>"
+                        "<group>group%u</group><tag>%s%u</tag></item>", i,
+                        (invalid && (i == items - 1)) ? 2000000 : i, states[i % 3], i % 10, (i % 2) ? "t" : "", i % 200);
+    }
+    r |= buf_printf(&buf, &size, &used, "</top>");
+
+    if (r) {
+        free(buf);
+        return NULL;
+    }
+    return buf;
+}
+
+/*
+ * workloads, one iteration each
+ */
+
+/* dictionary inserts and removals, validation */
+static int
+run_parse(struct thr *thr)
+{
+    struct lyd_node *data;
+
+    (void)thr;
+
+    data = lyd_parse_mem(in.ctx, in.xml, LYD_XML, LYD_OPT_CONFIG | LYD_OPT_STRICT);
+    if (!data) {
+        return 1;
+    }
+    lyd_free_withsiblings(data);
+    return 0;
+}
+
+/* error path, all the errors stored in the thread-specific list */
+static int
+run_invalid(struct thr *thr)
+{
+    struct lyd_node *data;
+
+    (void)thr;
+
+    data = lyd_parse_mem(in.ctx, in.xml_invalid, LYD_XML, LYD_OPT_CONFIG | LYD_OPT_STRICT);
+    if (data) {
+        lyd_free_withsiblings(data);
+        return 1;
+    }
+    if (!ly_err_first(in.ctx)) {
+        return 1;
+    }
+    ly_err_clean(in.ctx, NULL);
+    return 0;
+}
+
+/* validation of a private copy of the shared tree */
+static int
+run_validate(struct thr *thr)
+{
+    struct lyd_node *data;
+    int ret;
+
+    (void)thr;
+
+    data = lyd_dup_withsiblings(in.data, LYD_DUP_OPT_RECURSIVE);
+    if (!data) {
+        return 1;
+    }
+    ret = lyd_validate(&data, LYD_OPT_CONFIG, NULL);
+    lyd_free_withsiblings(data);
+    return ret;
+}
+
+/* printing the shared tree */
+static int
+run_print(struct thr *thr)
+{
+    char *out;
+
+    (void)thr;
+
+    if (lyd_print_mem(&out, in.data, LYD_XML, LYP_WITHSIBLINGS)) {
+        return 1;
+    }
+    free(out);
+    return 0;
+}
+
+/* key lookup and a scan of the shared tree */
+static int
+run_query(struct thr *thr)
+{
+    struct ly_set *set;
+    char path[64];
+    int ret;
+
+    sprintf(path, "/contention:top/item[name='item%u']/value", rand_r(&thr->seed) % in.items);
+    set = lyd_find_path(in.data, path);
+    ret = !set || (set->number != 1);
+    ly_set_free(set);
+    if (ret) {
+        return 1;
+    }
+
+    set = lyd_find_path(in.data, "/contention:top/item[state='up'][group='group3']");
+    ret = !set || !set->number;
+    ly_set_free(set);
+    return ret;
+}
+
+/* context creation, the global plugin registry */
+static int
+run_ctx(struct thr *thr)
+{
+    struct ly_ctx *ctx;
+    int ret;
+
+    (void)thr;
+
+    ctx = ly_ctx_new(NULL, LY_CTX_NOYANGLIBRARY);
+    if (!ctx) {
+        return 1;
+    }
+    ret = !lys_parse_mem(ctx, schema, LYS_IN_YANG);
+    ly_ctx_destroy(ctx, NULL);
+    return ret;
+}
+
+/* all of the above interleaved */
+static int
+run_mixed(struct thr *thr)
+{
+    switch (rand_r(&thr->seed) % 6) {
+    case 0:
+        return run_parse(thr);
+    case 1:
+        return run_invalid(thr);
+    case 2:
+        return run_validate(thr);
+    case 3:
+        return run_print(thr);
+    case 4:
+        return run_query(thr);
+    default:
+        return run_ctx(thr);
+    }
+}
+
+static const struct {
+    const char *name;
+    int (*run)(struct thr *thr);
+} workloads[] = {
+    {"parse", run_parse},
+    {"invalid", run_invalid},
+    {"validate", run_validate},
+    {"print", run_print},
+    {"query", run_query},
+    {"ctx", run_ctx},
+    {"mixed", run_mixed},
+    {NULL, NULL}
+};
+
+/*
+ * harness
+ */
+
+static void *
+bench_thread(void *arg)
+{
+    struct thr *thr = arg;
+    unsigned int i;
+
+    pthread_barrier_wait(&in.barrier);
+    thr->start = get_time_us();
+    for (i = 0; !thr->err && (i < in.iters); ++i) {
+        thr->err = thr->run(thr);
+    }
+    thr->end = get_time_us();
+
+    return NULL;
+}
+
+/* throughput of all the threads in operations per second, 0 on error */
+static double
+bench_workload(int (*run)(struct thr *thr), unsigned int threads)
+{
+    struct thr *thr;
+    double start, end;
+    unsigned int i;
+    int err = 0;
+
+    thr = calloc(threads, sizeof *thr);
+    if (!thr) {
+        return 0;
+    }
+
+    pthread_barrier_init(&in.barrier, NULL, threads + 1);
+    for (i = 0; i < threads; ++i) {
+        thr[i].run = run;
+        thr[i].seed = i + 1;
+        pthread_create(&thr[i].tid, NULL, bench_thread, &thr[i]);
+    }
+    pthread_barrier_wait(&in.barrier);
+    for (i = 0; i < threads; ++i) {
+        pthread_join(thr[i].tid, NULL);
+        err |= thr[i].err;
+    }
+    pthread_barrier_destroy(&in.barrier);
+
+    /* over the wall-clock time of all the threads */
+    start = thr[0].start;
+    end = thr[0].end;
+    for (i = 1; i < threads; ++i) {
+        start = (thr[i].start < start) ? thr[i].start : start;
+        end = (thr[i].end > end) ? thr[i].end : end;
+    }
+    free(thr);
+
+    if (err) {
+        return 0;
+    }
+    return (double)threads * in.iters * 1000000.0 / (end - start);
+}
+
+static int
+workload_selected(const char *list, const char *name)
+{
+    size_t len = strlen(name);
+    const char *ptr;
+
+    if (!list) {
+        return 1;
+    }
+    for (ptr = strstr(list, name); ptr; ptr = strstr(ptr + 1, name)) {
+        if (((ptr == list) || (ptr[-1] == ',')) && ((ptr[len] == ',') || !ptr[len])) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+    unsigned int max_threads = 8, threads;
+    const char *selected = NULL;
+    double base, ops;
+    int i, opt, first = 1, ret = 1;
+
+    in.items = 1000;
+    in.iters = 100;
+    while ((opt = getopt(argc, argv, "n:t:i:w:h")) != -1) {
+        switch (opt) {
+        case 'n':
+            in.items = atoi(optarg);
+            break;
+        case 't':
+            max_threads = atoi(optarg);
+            break;
+        case 'i':
+            in.iters = atoi(optarg);
+            break;
+        case 'w':
+            selected = optarg;
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-n items] [-t max-threads] [-i iterations] [-w workload[,workload...]]\n"
+                    "Every thread runs the iterations of a workload on one shared context, thread counts double up to\n"
+                    "max-threads.\nWorkloads:", argv[0]);
+            for (i = 0; workloads[i].name; ++i) {
+                fprintf(stderr, " %s", workloads[i].name);
+            }
+            fprintf(stderr, "\n");
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (!in.items || !max_threads || !in.iters) {
+        fprintf(stderr, "Invalid arguments.\n");
+        return 1;
+    }
+
+    /* the errors of the invalid data are only stored, in the list of every thread */
+    ly_log_options(LY_LOSTORE);
+
+    in.ctx = ly_ctx_new(NULL, 0);
+    if (!in.ctx || !lys_parse_mem(in.ctx, schema, LYS_IN_YANG)) {
+        fprintf(stderr, "Failed to create context.\n");
+        goto cleanup;
+    }
+    in.xml = generate_data(in.items, 0);
+    in.xml_invalid = generate_data(in.items, 1);
+    if (!in.xml || !in.xml_invalid) {
+        fprintf(stderr, "Failed to generate data of %u items.\n", in.items);
+        goto cleanup;
+    }
+    in.data = lyd_parse_mem(in.ctx, in.xml, LYD_XML, LYD_OPT_CONFIG | LYD_OPT_STRICT);
+    if (!in.data) {
+        fprintf(stderr, "Failed to parse data of %u items.\n", in.items);
+        goto cleanup;
+    }
+
+    printf("{\"items\": %u, \"iterations\": %u, \"results\": [\n", in.items, in.iters);
+    for (i = 0; workloads[i].name; ++i) {
+        if (!workload_selected(selected, workloads[i].name)) {
+            continue;
+        }
+        base = 0;
+        for (threads = 1; threads <= max_threads; threads *= 2) {
+            ops = bench_workload(workloads[i].run, threads);
+            if (!ops) {
+                fprintf(stderr, "Workload \"%s\" failed (%u threads).\n", workloads[i].name, threads);
+                goto cleanup;
+            }
+            if (threads == 1) {
+                base = ops;
+            }
+
+            /* speedup over a single thread, efficiency 1.0 is linear scaling */
+            printf("%s    {\"workload\": \"%s\", \"threads\": %u, \"ops_per_s\": %.1f, \"speedup\": %.2f, "
+                   "\"efficiency\": %.2f}", first ? "" : ",\n", workloads[i].name, threads, ops, ops / base,
+                   ops / base / threads);
+            fflush(stdout);
+            first = 0;
+        }
+    }
+    printf("\n]}\n");
+    ret = 0;
+
+cleanup:
+    lyd_free_withsiblings(in.data);
+    free(in.xml);
+    free(in.xml_invalid);
+    ly_ctx_destroy(in.ctx, NULL);
+    return ret;
+}
@@ -0,0 +1,227 @@
+/**
+ * @file schema.c
+ * @brief performance test - loading a large set of schemas into a context with the phases breakdown.
+ *
+ * Copyright (c) 2016 CESNET, z.s.p.o.
+ *
+ * This source code is licensed under BSD 3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://opensource.org/licenses/BSD-3-Clause
+ */
+
+#define _GNU_SOURCE
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <libyang/libyang.h>
+
+/* module to load, from a file name@revision.yang or name.yin in one of the directories */
+struct module {
+    char *name;
+    char *revision;
+};
+
+static double
+get_time_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000.0 + ts.tv_nsec / 1000.0;
+}
+
+/* submodules cannot be loaded directly, they are included by their modules */
+static int
+is_submodule(const char *path)
+{
+    char buf[4096];
+    ssize_t len;
+    int fd;
+
+    fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        return 1;
+    }
+    len = read(fd, buf, sizeof buf - 1);
+    close(fd);
+    if (len < 0) {
+        return 1;
+    }
+    buf[len] = '\0';
+
+    return strstr(buf, "belongs-to") != NULL;
+}
+
+static int
+collect_modules(const char *dir, struct module **mods, unsigned int *count)
+{
+    struct dirent **files;
+    char *path, *ptr;
+    int i, n;
+
+    n = scandir(dir, &files, NULL, alphasort);
+    if (n < 0) {
+        fprintf(stderr, "Failed to read directory \"%s\".\n", dir);
+        return 1;
+    }
+
+    for (i = 0; i < n; ++i) {
+        ptr = strrchr(files[i]->d_name, '.');
+        if (!ptr || (strcmp(ptr, ".yang") && strcmp(ptr, ".yin"))) {
+            free(files[i]);
+            continue;
+        }
+        if (asprintf(&path, "%s/%s", dir, files[i]->d_name) == -1) {
+            free(files[i]);
+            continue;
+        }
+        if (!is_submodule(path)) {
+            *mods = realloc(*mods, (*count + 1) * sizeof **mods);
+            *ptr = '\0';
+            ptr = strchr(files[i]->d_name, '@');
+            if (ptr) {
+                *ptr = '\0';
+                (*mods)[*count].revision = strdup(ptr + 1);
+            } else {
+                (*mods)[*count].revision = NULL;
+            }
+            (*mods)[*count].name = strdup(files[i]->d_name);
+            ++(*count);
+        }
+        free(path);
+        free(files[i]);
+    }
+    free(files);
+
+    return 0;
+}
+
+static int
+cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+int
+main(int argc, char *argv[])
+{
+    struct ly_ctx *ctx;
+    struct ly_ctx_stats stats;
+    struct module *mods = NULL;
+    const char *ylpath = NULL;
+    unsigned int count = 0, loaded = 0, repeats = 5, r, u;
+    double start, *times = NULL;
+    int i, opt, ret = 1;
+
+    while ((opt = getopt(argc, argv, "r:y:h")) != -1) {
+        switch (opt) {
+        case 'r':
+            repeats = atoi(optarg);
+            break;
+        case 'y':
+            ylpath = optarg;
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-r repeats] [-y yang-library-file] search-dir...\n"
+                    "Loads all the modules found in the search directories (or the modules of the yang-library\n"
+                    "data by ly_ctx_new_ylpath()) into a new context, the time of the loading phases is reported\n"
+                    "as the median of the repeats.\n", argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if ((optind == argc) || !repeats) {
+        fprintf(stderr, "Invalid arguments.\n");
+        return 1;
+    }
+
+    for (i = optind; !ylpath && (i < argc); ++i) {
+        if (collect_modules(argv[i], &mods, &count)) {
+            goto cleanup;
+        }
+    }
+    times = calloc(repeats * 7, sizeof *times);
+    if (!times) {
+        goto cleanup;
+    }
+
+    for (r = 0; r < repeats; ++r) {
+        if (ylpath) {
+            /* the statistics cannot be enabled before the context is created, only the total time is known */
+            start = get_time_us();
+            ctx = ly_ctx_new_ylpath(argv[optind], ylpath, LYD_UNKNOWN, 0);
+            times[r] = get_time_us() - start;
+            if (!ctx) {
+                fprintf(stderr, "Failed to create context from \"%s\".\n", ylpath);
+                goto cleanup;
+            }
+            ly_ctx_destroy(ctx, NULL);
+            continue;
+        }
+
+        start = get_time_us();
+        ctx = ly_ctx_new(argv[optind], LY_CTX_NOYANGLIBRARY);
+        if (!ctx) {
+            fprintf(stderr, "Failed to create context.\n");
+            goto cleanup;
+        }
+        for (i = optind + 1; i < argc; ++i) {
+            ly_ctx_set_searchdir(ctx, argv[i]);
+        }
+        ly_ctx_set_stats(ctx, 1);
+        for (u = 0, loaded = 0; u < count; ++u) {
+            if (ly_ctx_load_module(ctx, mods[u].name, mods[u].revision)) {
+                ++loaded;
+            } else if (!r) {
+                fprintf(stderr, "Failed to load module \"%s\".\n", mods[u].name);
+            }
+        }
+        times[r] = get_time_us() - start;
+
+        ly_ctx_get_stats(ctx, &stats);
+        times[repeats + r] = stats.schema_parse_time / 1000.0;
+        times[2 * repeats + r] = stats.schema_unres_time / 1000.0;
+        times[3 * repeats + r] = stats.schema_augdev_time / 1000.0;
+        times[4 * repeats + r] = stats.schema_pattern_time / 1000.0;
+        times[5 * repeats + r] = stats.schema_loads;
+        times[6 * repeats + r] = stats.schema_patterns;
+        ly_ctx_destroy(ctx, NULL);
+    }
+
+    for (u = 0; u < 7; ++u) {
+        qsort(times + u * repeats, repeats, sizeof *times, cmp_double);
+    }
+#define MEDIAN(u) times[(u) * repeats + repeats / 2]
+    if (ylpath) {
+        printf("Context from \"%s\" (%u repeats): %.0f us\n", ylpath, repeats, MEDIAN(0));
+    } else {
+        printf("Loaded %u of %u modules (%.0f schema files parsed, %.0f patterns, %u repeats).\n\n",
+               loaded, count, MEDIAN(5), MEDIAN(6), repeats);
+        printf("%-28s %12s\n", "phase", "us");
+        printf("%-28s %12.0f\n", "lexing and parsing", MEDIAN(1));
+        printf("%-28s %12.0f\n", "resolving unres", MEDIAN(2));
+        printf("%-28s %12.0f\n", "augments and deviations", MEDIAN(3));
+        printf("%-28s %12.0f\n", "pattern compilation", MEDIAN(4));
+        printf("%-28s %12.0f\n", "total with the context", MEDIAN(0));
+    }
+#undef MEDIAN
+    ret = 0;
+
+cleanup:
+    for (u = 0; u < count; ++u) {
+        free(mods[u].name);
+        free(mods[u].revision);
+    }
+    free(mods);
+    free(times);
+    return ret;
+}
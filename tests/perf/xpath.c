@@ -0,0 +1,364 @@
+/**
+ * @file xpath.c
+ * @brief performance test - evaluating XPath expressions on generated data trees.
+ *
+ * Copyright (c) 2016 CESNET, z.s.p.o.
+ *
+ * This source code is licensed under BSD 3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://opensource.org/licenses/BSD-3-Clause
+ */
+
+#define _GNU_SOURCE
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <libyang/libyang.h>
+
+/* the "deep" container is generated, see generate_schema() */
+static const char *schema_fmt =
+    "module xpbench {"
+    "  namespace urn:libyang:performance:xpath;"
+    "  prefix xb;"
+    "  container deep {%s}"
+    "  container wide {"
+    "    list item {"
+    "      key name;"
+    "      leaf name {type string;}"
+    "      leaf value {type uint32;}"
+    "      leaf enabled {type boolean;}"
+    "      leaf-list tag {type string;}"
+    "    }"
+    "  }"
+    "  container keyed {"
+    "    list entry {"
+    "      key \"k1 k2 k3\";"
+    "      leaf k1 {type uint32;}"
+    "      leaf k2 {type string;}"
+    "      leaf k3 {type uint32;}"
+    "      leaf data {type string;}"
+    "    }"
+    "  }"
+    "}";
+
+/* expressions with the context node ("/" means the first top-level node) */
+static const struct {
+    const char *ctx_path;
+    const char *expr;
+} exprs[] = {
+    /* NETCONF-like filters */
+    {"/", "/xpbench:wide/item"},
+    {"/", "/xpbench:wide/item[name='item500']"},
+    {"/", "/xpbench:wide/item[name='item500']/value"},
+    {"/", "/xpbench:wide/item[value > 500]"},
+    {"/", "/xpbench:wide/item[enabled = 'true']/name"},
+    {"/", "/xpbench:wide/item[tag = 'tag7']"},
+    {"/", "/xpbench:keyed/entry[k1='10'][k2='key10'][k3='10']/data"},
+    {"/", "/xpbench:keyed/entry[k2='key10']"},
+    {"/", "/xpbench:deep//name"},
+    {"/", "//xpbench:value"},
+    {"/", "/xpbench:deep/level/next/level/next/level/next/level/name"},
+    /* navigation (only the abbreviated syntax is supported) */
+    {"/xpbench:wide/item[name='item500']", "../item[name='item100']"},
+    {"/xpbench:wide/item[name='item500']", "../item[last()]"},
+    {"/xpbench:wide/item[name='item500']", "../*/*"},
+    {"/xpbench:wide/item[name='item500']", ".//."},
+    {"/xpbench:deep/level[id='0']/next/level[id='1']/next/level[id='2']", "../../../../name"},
+    /* functions and must-like expressions */
+    {"/", "count(/xpbench:wide/item)"},
+    {"/", "sum(/xpbench:wide/item/value)"},
+    {"/", "/xpbench:wide/item[starts-with(name, 'item9')]"},
+    {"/", "/xpbench:wide/item[contains(name, '99')]"},
+    {"/", "/xpbench:wide/item[string-length(name) > 6]"},
+    {"/", "/xpbench:wide/item[concat(name, '-', value) = 'item5-5']"},
+    {"/", "/xpbench:wide/item[translate(name, 'item', 'ITEM') = 'ITEM5']"},
+    {"/", "/xpbench:wide/item[not(enabled = 'true') and value mod 2 = 0]"},
+    {"/xpbench:wide/item[name='item500']/value", ". > ../../item[name='item499']/value"},
+    {"/xpbench:wide/item[name='item500']", "count(../item[value = current()/value]) = 1"},
+    {"/", "/xpbench:wide/item[value = /xpbench:keyed/entry/k1]"},
+    {"/", "/xpbench:wide/item[tag != /xpbench:wide/item[name='item1']/tag]"},
+    {NULL, NULL}
+};
+
+#ifdef __GLIBC__
+
+/* count allocations made by the library, glibc allows to interpose the allocator functions */
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static unsigned long long alloc_count;
+
+void *
+malloc(size_t size)
+{
+    ++alloc_count;
+    return __libc_malloc(size);
+}
+
+void *
+calloc(size_t nmemb, size_t size)
+{
+    ++alloc_count;
+    return __libc_calloc(nmemb, size);
+}
+
+void *
+realloc(void *ptr, size_t size)
+{
+    ++alloc_count;
+    return __libc_realloc(ptr, size);
+}
+
+#endif
+
+static unsigned long long
+get_alloc_count(void)
+{
+#ifdef __GLIBC__
+    return alloc_count;
+#else
+    return 0;
+#endif
+}
+
+static double
+get_time_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000.0 + ts.tv_nsec / 1000.0;
+}
+
+static int
+buf_printf(char **buf, size_t *size, size_t *used, const char *format, ...)
+{
+    va_list ap;
+    int len;
+    char *mem;
+
+    while (1) {
+        va_start(ap, format);
+        len = vsnprintf(*buf + *used, *size - *used, format, ap);
+        va_end(ap);
+        if (len < 0) {
+            return -1;
+        }
+        if (*used + len < *size) {
+            break;
+        }
+
+        *size = (*size + len) * 2;
+        mem = realloc(*buf, *size);
+        if (!mem) {
+            return -1;
+        }
+        *buf = mem;
+    }
+    *used += len;
+
+    return 0;
+}
+
+static char *
+generate_schema(unsigned int depth)
+{
+    char *buf, *deep = NULL;
+    size_t size = 4096, used = 0;
+    unsigned int i;
+    int r = 0;
+
+    /* YANG does not allow recursive groupings, so nest the lists explicitly */
+    deep = malloc(size);
+    if (!deep) {
+        return NULL;
+    }
+    deep[0] = '\0';
+    for (i = 0; i < depth; ++i) {
+        r |= buf_printf(&deep, &size, &used, "list level {key id; leaf id {type uint32;} leaf name {type string;}");
+        if (i < depth - 1) {
+            r |= buf_printf(&deep, &size, &used, "container next {");
+        }
+    }
+    for (i = 0; i < depth; ++i) {
+        r |= buf_printf(&deep, &size, &used, (i ? "}}" : "}"));
+    }
+
+    buf = NULL;
+    size = 0;
+    used = 0;
+    r |= buf_printf(&buf, &size, &used, schema_fmt, deep);
+    free(deep);
+    if (r) {
+        free(buf);
+        return NULL;
+    }
+    return buf;
+}
+
+static char *
+generate_data(unsigned int depth, unsigned int width, unsigned int keyed)
+{
+    char *buf;
+    size_t size = 4096, used = 0;
+    unsigned int i, j;
+    int r = 0;
+
+    buf = malloc(size);
+    if (!buf) {
+        return NULL;
+    }
+    buf[0] = '\0';
+
+    /* deep tree, each level has 2 list instances, only the first one continues */
+    r |= buf_printf(&buf, &size, &used, "<deep xmlns=\"urn:libyang:performance:xpath\">");
+    for (i = 0; i < depth; ++i) {
+        r |= buf_printf(&buf, &size, &used, "<level><id>%u</id><name>level%u</name></level>", depth + i, i);
+        r |= buf_printf(&buf, &size, &used, "<level><id>%u</id><name>level%u</name>", i, i);
+        if (i < depth - 1) {
+            r |= buf_printf(&buf, &size, &used, "<next>");
+        }
+    }
+    for (i = 0; i < depth; ++i) {
+        r |= buf_printf(&buf, &size, &used, (i ? "</next></level>" : "</level>"));
+    }
+    r |= buf_printf(&buf, &size, &used, "</deep>");
+
+    /* wide list */
+    r |= buf_printf(&buf, &size, &used, "<wide xmlns=\"urn:libyang:performance:xpath\">");
+    for (i = 0; i < width; ++i) {
+        r |= buf_printf(&buf, &size, &used, "<item><name>item%u</name><value>%u</value><enabled>%s</enabled>",
+                        i, i, (i % 3 ? "true" : "false"));
+        for (j = 0; j < 4; ++j) {
+            r |= buf_printf(&buf, &size, &used, "<tag>tag%u</tag>", (i + j) % 10);
+        }
+        r |= buf_printf(&buf, &size, &used, "</item>");
+    }
+    r |= buf_printf(&buf, &size, &used, "</wide>");
+
+    /* list with several keys */
+    r |= buf_printf(&buf, &size, &used, "<keyed xmlns=\"urn:libyang:performance:xpath\">");
+    for (i = 0; i < keyed; ++i) {
+        r |= buf_printf(&buf, &size, &used, "<entry><k1>%u</k1><k2>key%u</k2><k3>%u</k3><data>data%u</data></entry>",
+                        i, i, i, i);
+    }
+    r |= buf_printf(&buf, &size, &used, "</keyed>");
+
+    if (r) {
+        free(buf);
+        return NULL;
+    }
+    return buf;
+}
+
+int
+main(int argc, char *argv[])
+{
+    struct ly_ctx *ctx = NULL;
+    struct lyd_node *data = NULL, *ctx_node;
+    struct ly_set *set;
+    char *schema, *xml;
+    unsigned int i, k, iters = 100, width = 1000, depth = 20;
+    int j, ret = 1;
+    unsigned long long allocs;
+    double start, t;
+
+    if ((argc > 1) && (!strcmp(argv[1], "-h") || !strcmp(argv[1], "--help"))) {
+        fprintf(stderr, "Usage: %s [iterations [list-items [depth]]]\n", argv[0]);
+        return 0;
+    }
+    if (argc > 1) {
+        iters = atoi(argv[1]);
+    }
+    if (argc > 2) {
+        width = atoi(argv[2]);
+    }
+    if (argc > 3) {
+        depth = atoi(argv[3]);
+    }
+    if (!iters || !width || !depth) {
+        fprintf(stderr, "Invalid arguments.\n");
+        return 1;
+    }
+
+    ctx = ly_ctx_new(NULL, 0);
+    if (!ctx) {
+        fprintf(stderr, "Failed to create context.\n");
+        return 1;
+    }
+    schema = generate_schema(depth);
+    if (!schema || !lys_parse_mem(ctx, schema, LYS_IN_YANG)) {
+        fprintf(stderr, "Failed to load data model.\n");
+        free(schema);
+        goto cleanup;
+    }
+    free(schema);
+
+    xml = generate_data(depth, width, width);
+    if (!xml) {
+        fprintf(stderr, "Failed to generate data.\n");
+        goto cleanup;
+    }
+    start = get_time_us();
+    allocs = get_alloc_count();
+    data = lyd_parse_mem(ctx, xml, LYD_XML, LYD_OPT_CONFIG);
+    t = get_time_us() - start;
+    allocs = get_alloc_count() - allocs;
+    free(xml);
+    if (!data) {
+        fprintf(stderr, "Failed to parse data.\n");
+        goto cleanup;
+    }
+
+    printf("Data: depth %u, %u list items, %u keyed list items, %d iterations.\n", depth, width, width, iters);
+    printf("Parsing and validation: %.0f us, %llu allocations\n\n", t, allocs);
+    printf("%12s %12s %8s  %s\n", "us/eval", "allocs/eval", "nodes", "expression");
+
+    for (i = 0; exprs[i].expr; ++i) {
+        if (!strcmp(exprs[i].ctx_path, "/")) {
+            ctx_node = data;
+        } else {
+            set = lyd_find_path(data, exprs[i].ctx_path);
+            if (!set || (set->number != 1)) {
+                fprintf(stderr, "Failed to find the context node \"%s\".\n", exprs[i].ctx_path);
+                ly_set_free(set);
+                goto cleanup;
+            }
+            ctx_node = set->set.d[0];
+            ly_set_free(set);
+        }
+
+        /* warm up, also checks the expression */
+        set = lyd_find_path(ctx_node, exprs[i].expr);
+        if (!set) {
+            fprintf(stderr, "Failed to evaluate \"%s\".\n", exprs[i].expr);
+            goto cleanup;
+        }
+        j = set->number;
+        ly_set_free(set);
+
+        start = get_time_us();
+        allocs = get_alloc_count();
+        for (k = 0; k < iters; ++k) {
+            set = lyd_find_path(ctx_node, exprs[i].expr);
+            ly_set_free(set);
+        }
+        t = (get_time_us() - start) / iters;
+        allocs = (get_alloc_count() - allocs) / iters;
+
+        printf("%12.2f %12llu %8d  %s\n", t, allocs, j, exprs[i].expr);
+    }
+    ret = 0;
+
+cleanup:
+    lyd_free_withsiblings(data);
+    ly_ctx_destroy(ctx, NULL);
+    return ret;
+}
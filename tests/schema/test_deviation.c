@@ -88,6 +88,60 @@ test_augment_deviation(void **state)
     assert_int_equal(ly_errno, 0);
 }
 
+static void
+test_deviation_switch(void **state)
+{
+    (void)state;
+    char *str;
+    const struct lys_module *mod, *dev;
+    const struct lys_node_leaf *leaf;
+    const char *yang_mod = "module t { namespace urn:t; prefix t;"
+                           "  container c { leaf a { type string; } leaf b { type string; }"
+                           "    choice ch { leaf d { type string; } } }"
+                           "  rpc r { input { leaf i { type string; } } } }";
+    const char *yang_dev = "module t-dev { namespace urn:t-dev; prefix td; import t { prefix t; }"
+                           "  deviation /t:c/t:a { deviate not-supported; }"
+                           "  deviation /t:c/t:b { deviate replace { type int16; } }"
+                           "  deviation /t:c/t:ch/t:d/t:d { deviate not-supported; }"
+                           "  deviation /t:r/t:input/t:i { deviate not-supported; } }";
+
+    mod = lys_parse_mem(ctx, yang_mod, LYS_IN_YANG);
+    assert_ptr_not_equal(mod, NULL);
+    dev = lys_parse_mem(ctx, yang_dev, LYS_IN_YANG);
+    assert_ptr_not_equal(dev, NULL);
+
+    /* the deviations are switched off and on for printing the original module */
+    assert_int_equal(lys_print_mem(&str, mod, LYS_OUT_YANG, NULL, 0, 0), 0);
+    assert_ptr_not_equal(strstr(str, "leaf a"), NULL);
+    assert_ptr_not_equal(strstr(str, "leaf i"), NULL);
+    free(str);
+
+    /* repeated switching must keep the deviated nodes in place */
+    lys_set_disabled(dev);
+    lys_set_enabled(dev);
+    lys_set_disabled(dev);
+    assert_ptr_not_equal(ly_ctx_get_node(ctx, NULL, "/t:c/a", 0), NULL);
+    assert_ptr_not_equal(ly_ctx_get_node(ctx, NULL, "/t:c/d", 0), NULL);
+    assert_ptr_not_equal(ly_ctx_get_node(ctx, NULL, "/t:r/i", 0), NULL);
+    leaf = (const struct lys_node_leaf *)ly_ctx_get_node(ctx, NULL, "/t:c/b", 0);
+    assert_ptr_not_equal(leaf, NULL);
+    assert_int_equal(leaf->type.base, LY_TYPE_STRING);
+
+    lys_set_enabled(dev);
+    assert_ptr_equal(ly_ctx_get_node(ctx, NULL, "/t:c/a", 0), NULL);
+    assert_ptr_equal(ly_ctx_get_node(ctx, NULL, "/t:c/d", 0), NULL);
+    assert_ptr_equal(ly_ctx_get_node(ctx, NULL, "/t:r/i", 0), NULL);
+    leaf = (const struct lys_node_leaf *)ly_ctx_get_node(ctx, NULL, "/t:c/b", 0);
+    assert_ptr_not_equal(leaf, NULL);
+    assert_int_equal(leaf->type.base, LY_TYPE_INT16);
+
+    assert_int_equal(ly_ctx_remove_module(dev, NULL), 0);
+    assert_ptr_not_equal(ly_ctx_get_node(ctx, NULL, "/t:c/a", 0), NULL);
+    assert_ptr_not_equal(ly_ctx_get_node(ctx, NULL, "/t:r/i", 0), NULL);
+    leaf = (const struct lys_node_leaf *)ly_ctx_get_node(ctx, NULL, "/t:c/b", 0);
+    assert_int_equal(leaf->type.base, LY_TYPE_STRING);
+}
+
 int
 main(void)
 {
@@ -95,6 +149,7 @@ main(void)
     const struct CMUnitTest cmut[] = {
         cmocka_unit_test_setup_teardown(test_deviation, setup_ctx_yang, teardown_ctx),
         cmocka_unit_test_setup_teardown(test_augment_deviation, setup_ctx_yang, teardown_ctx),
+        cmocka_unit_test_setup_teardown(test_deviation_switch, setup_ctx_yang, teardown_ctx),
     };
 
     return cmocka_run_group_tests(cmut, NULL, NULL);
@@ -1239,6 +1239,143 @@ test_typedef_patterns_optimizations_yin(void **state)
     test_typedef_patterns_optimizations_schema(st, mod);
 }
 
+static void
+test_typedef_forward_refs(void **state)
+{
+    struct state *st = (*state);
+    const struct lys_module *mod;
+    const struct lys_node_leaf *leaf;
+    const char *yang = "module fw1 {"
+"  namespace \"urn:fw1\"; prefix fw1;"
+"  leaf l { type fw1:t1; }"
+"  container c {"
+"    leaf l { type t1; }"
+"    leaf s { type t5; }"
+"    typedef t5 { type t1; }"
+"  }"
+"  typedef t1 { type t2 { range \"1..10\"; } }"
+"  typedef t2 { type fw1:t3; }"
+"  typedef t3 { type t4; }"
+"  typedef t4 { type uint16; } }";
+
+    const char *yin = "<module name=\"fw2\" xmlns=\"urn:ietf:params:xml:ns:yang:yin:1\">"
+"  <namespace uri=\"urn:fw2\"/><prefix value=\"fw2\"/>"
+"  <leaf name=\"l\"><type name=\"t1\"/></leaf>"
+"  <typedef name=\"t1\"><type name=\"fw2:t2\"/></typedef>"
+"  <typedef name=\"t2\"><type name=\"t3\"/></typedef>"
+"  <typedef name=\"t3\"><type name=\"string\"/></typedef>"
+"</module>";
+
+    const char *yang_missing = "module fw3 {"
+"  namespace \"urn:fw3\"; prefix fw3;"
+"  leaf l { type t1; }"
+"  typedef t1 { type t2; }"
+"  typedef t2 { type t3; } }";
+
+    mod = lys_parse_mem(st->ctx, yang, LYS_IN_YANG);
+    assert_ptr_not_equal(mod, NULL);
+    leaf = (const struct lys_node_leaf *)mod->data;
+    assert_string_equal(leaf->name, "l");
+    assert_int_equal(leaf->type.base, LY_TYPE_UINT16);
+    assert_string_equal(leaf->type.der->name, "t1");
+
+    /* including a scoped typedef */
+    leaf = (const struct lys_node_leaf *)mod->data->next->child;
+    assert_int_equal(leaf->type.base, LY_TYPE_UINT16);
+    leaf = (const struct lys_node_leaf *)leaf->next;
+    assert_int_equal(leaf->type.base, LY_TYPE_UINT16);
+
+    mod = lys_parse_mem(st->ctx, yin, LYS_IN_YIN);
+    assert_ptr_not_equal(mod, NULL);
+    leaf = (const struct lys_node_leaf *)mod->data;
+    assert_int_equal(leaf->type.base, LY_TYPE_STRING);
+
+    assert_ptr_equal(lys_parse_mem(st->ctx, yang_missing, LYS_IN_YANG), NULL);
+    assert_ptr_equal(ly_ctx_get_module(st->ctx, "fw3", NULL, 0), NULL);
+}
+
+static void
+test_typedef_share_groupings(void **state)
+{
+    struct state *st = (*state);
+    const struct lys_module *mod;
+    const struct lys_node *grp, *uses1, *uses2;
+    const struct lys_node_leaf *leaf, *leaf1, *leaf2;
+    struct lyd_node *data;
+    const char *yang = "module sg {"
+"  namespace \"urn:sg\"; prefix sg;"
+"  identity base; identity derived { base base; }"
+"  grouping g {"
+"    leaf s { type string { length \"1..5\"; pattern \"[a-z]+\"; } }"
+"    leaf e { type enumeration { enum one; enum two; } }"
+"    leaf-list n { type uint8 { range \"1..10\"; } }"
+"    leaf i { type identityref { base base; } }"
+"    leaf u { type union { type int8 { range \"-1..1\"; } type string { pattern \"x+\"; } } }"
+"  }"
+"  container c1 { uses g; }"
+"  container c2 { uses g; }"
+"}";
+    const char *dev = "module sg-dev {"
+"  namespace \"urn:sg-dev\"; prefix sgd;"
+"  import sg { prefix sg; }"
+"  deviation /sg:c2/sg:e { deviate replace { type string; } }"
+"}";
+    const char *valid = "<c1 xmlns=\"urn:sg\"><s>abc</s><e>two</e><n>10</n><i>derived</i><u>xx</u></c1>"
+"<c2 xmlns=\"urn:sg\"><s>x</s><e>three</e><u>1</u></c2>";
+    const char *invalid1 = "<c1 xmlns=\"urn:sg\"><s>abcdef</s></c1>";
+    const char *invalid2 = "<c1 xmlns=\"urn:sg\"><s>AB</s></c1>";
+    const char *invalid3 = "<c1 xmlns=\"urn:sg\"><n>11</n></c1>";
+    const char *invalid4 = "<c1 xmlns=\"urn:sg\"><e>three</e></c1>";
+    const char *invalid5 = "<c1 xmlns=\"urn:sg\"><u>y</u></c1>";
+
+    ly_ctx_destroy(st->ctx, NULL);
+    st->ctx = ly_ctx_new(NULL, LY_CTX_SHARE_GROUPINGS);
+    assert_ptr_not_equal(st->ctx, NULL);
+
+    mod = lys_parse_mem(st->ctx, yang, LYS_IN_YANG);
+    assert_ptr_not_equal(mod, NULL);
+    grp = mod->data;
+    assert_int_equal(grp->nodetype, LYS_GROUPING);
+    uses1 = grp->next->child;
+    uses2 = grp->next->next->child;
+    assert_int_equal(uses1->nodetype, LYS_USES);
+
+    /* the instances share the restrictions with the grouping */
+    leaf = (const struct lys_node_leaf *)grp->child;
+    leaf1 = (const struct lys_node_leaf *)uses1->child;
+    leaf2 = (const struct lys_node_leaf *)uses2->child;
+    assert_ptr_equal(leaf1->type.info.str.patterns, leaf->type.info.str.patterns);
+    assert_ptr_equal(leaf2->type.info.str.length, leaf->type.info.str.length);
+#ifdef LY_ENABLED_CACHE
+    assert_ptr_not_equal(leaf1->type.info.str.patterns_pcre, NULL);
+#endif
+    leaf = (const struct lys_node_leaf *)leaf->next;
+    leaf1 = (const struct lys_node_leaf *)leaf1->next;
+    assert_ptr_equal(leaf1->type.info.enums.enm, leaf->type.info.enums.enm);
+
+    /* except the parts resolved for every instance */
+    leaf = (const struct lys_node_leaf *)leaf->next->next->next;
+    leaf1 = (const struct lys_node_leaf *)leaf1->next->next->next;
+    assert_ptr_not_equal(leaf1->type.info.uni.types, leaf->type.info.uni.types);
+
+    /* the type of a shared instance can be replaced */
+    assert_ptr_not_equal(lys_parse_mem(st->ctx, dev, LYS_IN_YANG), NULL);
+
+    data = lyd_parse_mem(st->ctx, valid, LYD_XML, LYD_OPT_CONFIG);
+    assert_ptr_not_equal(data, NULL);
+    lyd_free_withsiblings(data);
+
+    assert_ptr_equal(lyd_parse_mem(st->ctx, invalid1, LYD_XML, LYD_OPT_CONFIG), NULL);
+    assert_ptr_equal(lyd_parse_mem(st->ctx, invalid2, LYD_XML, LYD_OPT_CONFIG), NULL);
+    assert_ptr_equal(lyd_parse_mem(st->ctx, invalid3, LYD_XML, LYD_OPT_CONFIG), NULL);
+    assert_ptr_equal(lyd_parse_mem(st->ctx, invalid4, LYD_XML, LYD_OPT_CONFIG), NULL);
+    assert_ptr_equal(lyd_parse_mem(st->ctx, invalid5, LYD_XML, LYD_OPT_CONFIG), NULL);
+
+    /* removing the deviation restores the shared type */
+    assert_int_equal(ly_ctx_remove_module(ly_ctx_get_module(st->ctx, "sg-dev", NULL, 0), NULL), 0);
+    assert_ptr_equal(lyd_parse_mem(st->ctx, "<c2 xmlns=\"urn:sg\"><e>three</e></c2>", LYD_XML, LYD_OPT_CONFIG), NULL);
+}
+
 int
 main(void)
 {
@@ -1266,6 +1403,8 @@ main(void)
         cmocka_unit_test_setup_teardown(test_typedef_11_union_empty_yang, setup_ctx, teardown_ctx),
         cmocka_unit_test_setup_teardown(test_typedef_patterns_optimizations_yin, setup_ctx, teardown_ctx),
         cmocka_unit_test_setup_teardown(test_typedef_patterns_optimizations_yang, setup_ctx, teardown_ctx),
+        cmocka_unit_test_setup_teardown(test_typedef_forward_refs, setup_ctx, teardown_ctx),
+        cmocka_unit_test_setup_teardown(test_typedef_share_groupings, setup_ctx, teardown_ctx),
     };
 
     return cmocka_run_group_tests(cmut, NULL, NULL);
@@ -14,7 +14,9 @@
 
 #include <string.h>
 #include <stdio.h>
+#include <time.h>
 #include <errno.h>
+#include <inttypes.h>
 #include <ctype.h>
 #include <assert.h>
 #include <sys/types.h>
@@ -156,6 +158,32 @@ cmd_verb_help(void)
     printf("verb (error/0 | warning/1 | verbose/2 | debug/3)\n");
 }
 
+void
+cmd_profile_help(void)
+{
+    printf("profile (on | off | print | clear)\n\n");
+    printf("\tProfiles the must/when/leafref/unique data validation and collects the context statistics\n");
+    printf("\t(XPath evaluations and visited nodes, parsed bytes, created nodes, dictionary, ...).\n");
+}
+
+void
+cmd_bench_help(void)
+{
+    printf("bench [-n COUNT] [-p] [-t TYPE] [-f (xml | json | lyb)] [-e <XPath-expression>]\n"
+           "      (load | validate | print | xpath | diff) <data-file-name> [<second-data-file-name>]\n\n");
+    printf("\tRepeats an operation COUNT times (100 by default) and prints its throughput and latency\n");
+    printf("\tpercentiles. The data file is parsed as TYPE (see the data command), only once except\n");
+    printf("\tfor the load operation.\n\n");
+    printf("\tload       - parse the data file\n");
+    printf("\tvalidate   - validate a copy of the data made before every repetition\n");
+    printf("\tprint      - print the data into memory in the format -f (xml by default)\n");
+    printf("\txpath      - evaluate the XPath expression -e on the data\n");
+    printf("\tdiff       - compare the data with the second data file\n\n");
+    printf("Option -p:\n");
+    printf("\tProfile the repetitions and print the validation profile and statistics, see the profile\n");
+    printf("\tcommand.\n");
+}
+
 #ifndef NDEBUG
 
 void
@@ -1405,6 +1433,390 @@ cmd_verb(const char *arg)
     return 0;
 }
 
+void
+print_val_profile(FILE *out, struct ly_ctx *ctx)
+{
+    struct ly_val_prof *profs;
+    uint32_t i, count;
+    const char *type;
+    char *path;
+
+    profs = ly_ctx_get_val_profile(ctx, &count);
+    if (!count) {
+        fprintf(out, "No validation profile.\n");
+        return;
+    }
+
+    fprintf(out, "%12s %10s %12s %10s  %-8s %s\n", "time [us]", "count", "nodes", "max nodes", "type", "node: expression");
+    for (i = 0; i < count; ++i) {
+        switch (profs[i].type) {
+        case LY_VAL_PROF_MUST:
+            type = "must";
+            break;
+        case LY_VAL_PROF_WHEN:
+            type = "when";
+            break;
+        case LY_VAL_PROF_LEAFREF:
+            type = "leafref";
+            break;
+        case LY_VAL_PROF_UNIQUE:
+            type = "unique";
+            break;
+        default:
+            type = "unknown";
+            break;
+        }
+
+        path = lys_path(profs[i].node, LYS_PATH_FIRST_PREFIX);
+        fprintf(out, "%12.1f %10u %12" PRIu64 " %10u  %-8s %s%s%s\n", profs[i].time / 1000.0, profs[i].count,
+                profs[i].nodes, profs[i].max_nodes, type, path ? path : "?", profs[i].expr ? ": " : "",
+                profs[i].expr ? profs[i].expr : "");
+        free(path);
+    }
+    free(profs);
+}
+
+void
+print_stats(FILE *out, struct ly_ctx *ctx)
+{
+    const char *clb_names[] = {"store", "print", "compare", "order", "hash", "free", "check_position",
+                               "check_result", "check_inherit", "valid_data"};
+    struct ly_ctx_stats stats;
+    struct ly_plugin_stats *plugins;
+    uint32_t i, count;
+    int width;
+
+    if (ly_ctx_get_stats(ctx, &stats)) {
+        return;
+    }
+
+    fprintf(out, "\nStatistics:\n");
+    fprintf(out, "\t%-26s %" PRIu64 " (%" PRIu64 " bytes)\n", "data parser calls", stats.parse_calls, stats.parse_bytes);
+    fprintf(out, "\t%-26s %" PRIu64 " / %" PRIu64 "\n", "data nodes created / freed", stats.nodes_created,
+            stats.nodes_freed);
+    fprintf(out, "\t%-26s %.1f us\n", "validation time", stats.val_time / 1000.0);
+    fprintf(out, "\t%-26s %" PRIu64 " / %" PRIu64 " / %" PRIu64 "\n", "must / when / leafref", stats.must_evals,
+            stats.when_evals, stats.leafref_evals);
+    fprintf(out, "\t%-26s %" PRIu64 " (%" PRIu64 " nodes visited)\n", "XPath evaluations", stats.xpath_evals,
+            stats.xpath_nodes);
+    fprintf(out, "\t%-26s %" PRIu64 " / %" PRIu64 "\n", "hash table probes / resizes", stats.ht_probes,
+            stats.ht_resizes);
+    fprintf(out, "\t%-26s %" PRIu64 " (%" PRIu64 " inserts, %" PRIu64 " hits, %" PRIu64 " lock waits)\n",
+            "dictionary strings", stats.dict_strings, stats.dict_inserts, stats.dict_hits, stats.dict_lock_waits);
+
+    plugins = ly_ctx_get_plugin_stats(ctx, &count);
+    if (!count) {
+        return;
+    }
+    fprintf(out, "\nPlugin callbacks:\n");
+    fprintf(out, "\t%-14s %-40s %10s %12s\n", "callback", "extension/typedef", "calls", "time [us]");
+    for (i = 0; i < count; ++i) {
+        width = 39 - (int)strlen(plugins[i].module);
+        fprintf(out, "\t%-14s %s:%-*s %10" PRIu64 " %12.1f\n", clb_names[plugins[i].clb], plugins[i].module,
+                width > 0 ? width : 0, plugins[i].name, plugins[i].count, plugins[i].time / 1000.0);
+    }
+    free(plugins);
+}
+
+int
+cmd_profile(const char *arg)
+{
+    const char *op;
+
+    for (op = strchr(arg, ' '); op && (op[0] == ' '); ++op);
+    if (!op || (op[0] == '\0')) {
+        cmd_profile_help();
+        return 1;
+    }
+
+    if (!strcmp(op, "on")) {
+        ly_ctx_set_val_profiling(ctx, 1);
+        ly_ctx_set_stats(ctx, 1);
+    } else if (!strcmp(op, "off")) {
+        ly_ctx_set_val_profiling(ctx, 0);
+        ly_ctx_set_stats(ctx, 0);
+    } else if (!strcmp(op, "print")) {
+        print_val_profile(stdout, ctx);
+        print_stats(stdout, ctx);
+    } else if (!strcmp(op, "clear")) {
+        ly_ctx_clean_val_profile(ctx);
+        ly_ctx_clean_stats(ctx);
+    } else {
+        fprintf(stderr, "Unknown profile operation \"%s\"\n", op);
+        return 1;
+    }
+
+    return 0;
+}
+
+static double
+bench_time_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000.0 + ts.tv_nsec / 1000.0;
+}
+
+static int
+bench_cmp(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+/* the most frequent allocation sites of libyang, only if compiled with ENABLE_ALLOC_TRACE */
+static void
+print_alloc_sites(FILE *out, unsigned int repeats)
+{
+    struct ly_alloc_site *sites;
+    uint32_t i, count;
+
+    if (ly_alloc_trace_get(&sites, &count) || !count) {
+        return;
+    }
+
+    fprintf(out, "\nAllocations per repetition (the most frequent):\n");
+    for (i = 0; (i < count) && (i < 20); ++i) {
+        fprintf(out, "\t%-8s %10.1f %12.1f B  %s:%" PRIu32 "\n", sites[i].func, (double)sites[i].calls / repeats,
+                (double)sites[i].bytes / repeats, sites[i].file, sites[i].line);
+    }
+    free(sites);
+}
+
+int
+cmd_bench(const char *arg)
+{
+    int c, argc, option_index, ret = 1, long_str, profile = 0, options = 0;
+    char **argv = NULL, *ptr, *expr = NULL, *str;
+    const char *op;
+    unsigned int i, count = 100;
+    LYD_FORMAT outformat = LYD_XML;
+    double *lat = NULL, start, total = 0;
+    struct lyd_node *data = NULL, *data2 = NULL, *work;
+    struct lyd_difflist *diff;
+    struct ly_set *set;
+    static struct option long_options[] = {
+        {"help", no_argument, 0, 'h'},
+        {"count", required_argument, 0, 'n'},
+        {"profile", no_argument, 0, 'p'},
+        {"format", required_argument, 0, 'f'},
+        {"expr", required_argument, 0, 'e'},
+        {NULL, 0, 0, 0}
+    };
+    void *rlcd;
+
+    long_str = 0;
+    argc = 1;
+    argv = malloc(2 * sizeof *argv);
+    *argv = strdup(arg);
+    ptr = strtok(*argv, " ");
+    while ((ptr = strtok(NULL, " "))) {
+        if (long_str) {
+            ptr[-1] = ' ';
+            if (ptr[strlen(ptr) - 1] == long_str) {
+                long_str = 0;
+                ptr[strlen(ptr) - 1] = '\0';
+            }
+        } else {
+            rlcd = realloc(argv, (argc + 2) * sizeof *argv);
+            if (!rlcd) {
+                fprintf(stderr, "Memory allocation failed (%s:%d, %s)", __FILE__, __LINE__, strerror(errno));
+                goto cleanup;
+            }
+            argv = rlcd;
+            argv[argc] = ptr;
+            if (ptr[0] == '"') {
+                long_str = '"';
+                ++argv[argc];
+            }
+            if (ptr[0] == '\'') {
+                long_str = '\'';
+                ++argv[argc];
+            }
+            if (ptr[strlen(ptr) - 1] == long_str) {
+                long_str = 0;
+                ptr[strlen(ptr) - 1] = '\0';
+            }
+            ++argc;
+        }
+    }
+    argv[argc] = NULL;
+
+    optind = 0;
+    while (1) {
+        option_index = 0;
+        c = getopt_long(argc, argv, "hn:pt:f:e:", long_options, &option_index);
+        if (c == -1) {
+            break;
+        }
+
+        switch (c) {
+        case 'h':
+            cmd_bench_help();
+            ret = 0;
+            goto cleanup;
+        case 'n':
+            count = atoi(optarg);
+            break;
+        case 'p':
+            profile = 1;
+            break;
+        case 't':
+            if (!strcmp(optarg, "auto")) {
+                options = (options & ~LYD_OPT_TYPEMASK) | LYD_OPT_TYPEMASK;
+            } else if (!strcmp(optarg, "data")) {
+                options = (options & ~LYD_OPT_TYPEMASK) | LYD_OPT_DATA;
+            } else if (!strcmp(optarg, "config")) {
+                options = (options & ~LYD_OPT_TYPEMASK) | LYD_OPT_CONFIG;
+            } else if (!strcmp(optarg, "get")) {
+                options = (options & ~LYD_OPT_TYPEMASK) | LYD_OPT_GET;
+            } else if (!strcmp(optarg, "getconfig")) {
+                options = (options & ~LYD_OPT_TYPEMASK) | LYD_OPT_GETCONFIG;
+            } else if (!strcmp(optarg, "edit")) {
+                options = (options & ~LYD_OPT_TYPEMASK) | LYD_OPT_EDIT;
+            } else {
+                fprintf(stderr, "Invalid parser option \"%s\".\n", optarg);
+                cmd_bench_help();
+                goto cleanup;
+            }
+            break;
+        case 'f':
+            if (!strcmp(optarg, "xml")) {
+                outformat = LYD_XML;
+            } else if (!strcmp(optarg, "json")) {
+                outformat = LYD_JSON;
+            } else if (!strcmp(optarg, "lyb")) {
+                outformat = LYD_LYB;
+            } else {
+                fprintf(stderr, "Unknown output format \"%s\".\n", optarg);
+                goto cleanup;
+            }
+            break;
+        case 'e':
+            expr = optarg;
+            break;
+        case '?':
+            fprintf(stderr, "Unknown option \"%d\".\n", (char)c);
+            goto cleanup;
+        }
+    }
+
+    if (argc - optind < 2) {
+        fprintf(stderr, "Missing the operation or the file with data.\n");
+        goto cleanup;
+    }
+    op = argv[optind];
+    if (strcmp(op, "load") && strcmp(op, "validate") && strcmp(op, "print") && strcmp(op, "xpath") && strcmp(op, "diff")) {
+        fprintf(stderr, "Unknown operation \"%s\".\n", op);
+        goto cleanup;
+    }
+    if (!strcmp(op, "xpath") && !expr) {
+        fprintf(stderr, "Missing the XPath expression.\n");
+        goto cleanup;
+    }
+    if (!strcmp(op, "diff") && !argv[optind + 2]) {
+        fprintf(stderr, "Missing the second file with data.\n");
+        goto cleanup;
+    }
+    if (!count) {
+        fprintf(stderr, "Invalid number of repetitions.\n");
+        goto cleanup;
+    }
+
+    lat = malloc(count * sizeof *lat);
+    if (!lat) {
+        fprintf(stderr, "Memory allocation failed (%s:%d, %s)", __FILE__, __LINE__, strerror(errno));
+        goto cleanup;
+    }
+
+    /* parse the data (also checks they are valid and resolves the auto type) */
+    if (parse_data(argv[optind + 1], &options, NULL, NULL, &data)) {
+        goto cleanup;
+    }
+    if (!strcmp(op, "diff") && parse_data(argv[optind + 2], &options, NULL, NULL, &data2)) {
+        goto cleanup;
+    }
+
+    if (profile) {
+        ly_ctx_clean_val_profile(ctx);
+        ly_ctx_clean_stats(ctx);
+        ly_ctx_set_val_profiling(ctx, 1);
+        ly_ctx_set_stats(ctx, 1);
+        ly_alloc_trace_clean();
+    }
+    for (i = 0; i < count; ++i) {
+        if (!strcmp(op, "load")) {
+            start = bench_time_us();
+            c = parse_data(argv[optind + 1], &options, NULL, NULL, &work);
+            lat[i] = bench_time_us() - start;
+            if (!c) {
+                lyd_free_withsiblings(work);
+            }
+        } else if (!strcmp(op, "validate")) {
+            /* validate a copy of the (already valid) data, only the validation itself is measured */
+            work = lyd_dup_withsiblings(data, LYD_DUP_OPT_RECURSIVE);
+            c = work ? 0 : 1;
+            if (!c) {
+                start = bench_time_us();
+                c = lyd_validate(&work, options, ctx);
+                lat[i] = bench_time_us() - start;
+            }
+            lyd_free_withsiblings(work);
+        } else if (!strcmp(op, "print")) {
+            start = bench_time_us();
+            c = lyd_print_mem(&str, data, outformat, LYP_WITHSIBLINGS);
+            lat[i] = bench_time_us() - start;
+            if (!c) {
+                free(str);
+            }
+        } else if (!strcmp(op, "xpath")) {
+            start = bench_time_us();
+            set = lyd_find_path(data, expr);
+            lat[i] = bench_time_us() - start;
+            c = set ? 0 : 1;
+            ly_set_free(set);
+        } else {
+            start = bench_time_us();
+            diff = lyd_diff(data, data2, 0);
+            lat[i] = bench_time_us() - start;
+            c = diff ? 0 : 1;
+            lyd_free_diff(diff);
+        }
+        if (c) {
+            fprintf(stderr, "Operation \"%s\" failed in repetition %u.\n", op, i + 1);
+            goto cleanup;
+        }
+        total += lat[i];
+    }
+
+    qsort(lat, count, sizeof *lat, bench_cmp);
+    printf("%s: %u repetitions, %.0f ops/s\n", op, count, count * 1000000.0 / total);
+    printf("%12s %12s %12s %12s %12s %12s\n", "min [us]", "p50", "p90", "p99", "max", "mean");
+    printf("%12.1f %12.1f %12.1f %12.1f %12.1f %12.1f\n", lat[0], lat[(count - 1) / 2], lat[(count - 1) * 90 / 100],
+           lat[(count - 1) * 99 / 100], lat[count - 1], total / count);
+    if (profile) {
+        printf("\n");
+        print_val_profile(stdout, ctx);
+        print_stats(stdout, ctx);
+        print_alloc_sites(stdout, count);
+    }
+    ret = 0;
+
+cleanup:
+    if (profile) {
+        ly_ctx_set_val_profiling(ctx, 0);
+        ly_ctx_set_stats(ctx, 0);
+    }
+    lyd_free_withsiblings(data);
+    lyd_free_withsiblings(data2);
+    free(lat);
+    free(*argv);
+    free(argv);
+    return ret;
+}
+
 #ifndef NDEBUG
 
 int
@@ -1513,6 +1925,8 @@ COMMAND commands[] = {
         {"searchpath", cmd_searchpath, cmd_searchpath_help, "Print/set the search path(s) for models"},
         {"clear", cmd_clear, cmd_clear_help, "Clear the context - remove all the loaded models"},
         {"verb", cmd_verb, cmd_verb_help, "Change verbosity"},
+        {"profile", cmd_profile, cmd_profile_help, "Profile the must/when/leafref/unique data validation"},
+        {"bench", cmd_bench, cmd_bench_help, "Repeat an operation on data and print its throughput and latency"},
 #ifndef NDEBUG
         {"debug", cmd_debug, cmd_debug_help, "Display specific debug message groups"},
 #endif
@@ -21,6 +21,7 @@
 #  define UNUSED(x) UNUSED_ ## x
 #endif
 
+#include <stdio.h>
 #include <stdlib.h>
 
 #include "libyang.h"
@@ -41,6 +42,9 @@ typedef struct {
 
 LYS_INFORMAT get_schema_format(const char *path);
 
+void print_val_profile(FILE *out, struct ly_ctx *ctx);
+void print_stats(FILE *out, struct ly_ctx *ctx);
+
 extern COMMAND commands[];
 
 #endif /* COMMANDS_H_ */
@@ -18,10 +18,12 @@
 #include <getopt.h>
 #include <errno.h>
 #include <libgen.h>
+#include <pthread.h>
 #include <sys/stat.h>
 #include <sys/times.h>
 #include <sys/types.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "commands.h"
@@ -106,6 +108,13 @@ help(int shortout)
         "                          configuration datastore data referenced from the RPC/Notification. The same data\n"
         "                          apply to all input data <file>s. Note that the file is validated as 'data' TYPE.\n"
         "                          Special value '!' can be used as FILE argument to ignore the external references.\n\n"
+        "  -j NUM, --jobs=NUM    Parse and validate the input data files in NUM threads sharing the context.\n"
+        "                        The messages are printed in the order of the files, followed by the\n"
+        "                        total throughput. Not applicable to the auto and rpcreply TYPEs.\n\n"
+        "  -R, --profile         Profile the data validation and print the cumulative time, number of\n"
+        "                        evaluations and result sizes of every must, when, leafref and unique\n"
+        "                        constraint to stderr, the most expensive first, followed by the context\n"
+        "                        statistics.\n\n"
         "  -y YANGLIB_PATH       - Path to a yang-library data describing the initial context.\n\n"
         "Tree output specific options:\n"
         "  --tree-help           - Print help on tree symbols and exit.\n"
@@ -159,8 +168,8 @@ version(void)
 {
     fprintf(stdout, "yanglint %d.%d.%d\n", LY_VERSION_MAJOR, LY_VERSION_MINOR, LY_VERSION_MICRO);
 }
-void
-libyang_verbclb(LY_LOG_LEVEL level, const char *msg, const char *path)
+static void
+print_msg(FILE *out, LY_LOG_LEVEL level, const char *msg, const char *path)
 {
     char *levstr;
 
@@ -180,11 +189,172 @@ libyang_verbclb(LY_LOG_LEVEL level, const char *msg, const char *path)
             break;
         }
         if (path) {
-            fprintf(stderr, "%s %s (%s)\n", levstr, msg, path);
+            fprintf(out, "%s %s (%s)\n", levstr, msg, path);
         } else {
-            fprintf(stderr, "%s %s\n", levstr, msg);
+            fprintf(out, "%s %s\n", levstr, msg);
+        }
+    }
+}
+
+void
+libyang_verbclb(LY_LOG_LEVEL level, const char *msg, const char *path)
+{
+    print_msg(stderr, level, msg, path);
+}
+
+struct dataitem {
+    const char *filename;
+    struct lyxml_elem *xml;
+    struct lyd_node *tree;
+    struct dataitem *next;
+    LYD_FORMAT format;
+    int type;
+};
+
+/* data files parsed by several threads */
+struct datajobs {
+    struct ly_ctx *ctx;
+    struct lyd_node *running;
+    int options;
+    pthread_mutex_t lock;
+    struct dataitem *next;      /* next file to parse */
+    char **msgs;                /* messages of every file */
+    int *failed;
+    size_t bytes;
+};
+
+static void *
+parse_data_worker(void *arg)
+{
+    struct datajobs *jobs = arg;
+    struct dataitem *item;
+    struct ly_err_item *eitem;
+    struct stat st;
+    size_t size;
+    FILE *msgs;
+    int idx;
+
+    while (1) {
+        pthread_mutex_lock(&jobs->lock);
+        item = jobs->next;
+        if (item) {
+            jobs->next = item->next;
+            if (!stat(item->filename, &st)) {
+                jobs->bytes += st.st_size;
+            }
+        }
+        idx = item ? item->type : 0;
+        pthread_mutex_unlock(&jobs->lock);
+        if (!item) {
+            break;
         }
+
+        ly_errno = 0;
+        item->tree = lyd_parse_path(jobs->ctx, item->filename, item->format, jobs->options, jobs->running);
+        jobs->failed[idx] = ly_errno ? 1 : 0;
+
+        /* keep the messages to print them in the order of the files */
+        msgs = open_memstream(&jobs->msgs[idx], &size);
+        if (msgs) {
+            for (eitem = ly_err_first(jobs->ctx); eitem; eitem = eitem->next) {
+                print_msg(msgs, eitem->level, eitem->msg, eitem->path);
+            }
+            fclose(msgs);
+        }
+        ly_err_clean(jobs->ctx, NULL);
     }
+
+    return NULL;
+}
+
+/* parse all the data files, return the number of the files that failed or -1 on error */
+static int
+parse_data_parallel(struct ly_ctx *ctx, struct dataitem *data, int options, struct lyd_node *running, int threads)
+{
+    struct datajobs jobs;
+    struct dataitem *item;
+    struct timespec start, end;
+    pthread_t *tids;
+    int i, count = 0, ret = 0, prev_opts;
+    double sec;
+
+    for (item = data; item; item = item->next) {
+        count++;
+    }
+
+    memset(&jobs, 0, sizeof jobs);
+    jobs.ctx = ctx;
+    jobs.running = running;
+    jobs.options = options;
+    jobs.next = data;
+    jobs.msgs = calloc(count, sizeof *jobs.msgs);
+    jobs.failed = calloc(count, sizeof *jobs.failed);
+    tids = calloc(threads, sizeof *tids);
+    if (!jobs.msgs || !jobs.failed || !tids) {
+        fprintf(stderr, "yanglint error: memory allocation failed.\n");
+        ret = -1;
+        goto cleanup;
+    }
+
+    /* build the schema caches now so that the threads only read the schemas */
+    if (ly_ctx_precompile(ctx)) {
+        ret = -1;
+        goto cleanup;
+    }
+
+    pthread_mutex_init(&jobs.lock, NULL);
+
+    /* the type is used as the index of the file until the file is parsed */
+    i = 0;
+    for (item = data; item; item = item->next) {
+        item->type = i++;
+    }
+
+    /* the messages are printed after all the files are parsed */
+    prev_opts = ly_log_options(LY_LOSTORE);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < threads; i++) {
+        if (pthread_create(&tids[i], NULL, parse_data_worker, &jobs)) {
+            fprintf(stderr, "yanglint error: unable to create a thread.\n");
+            break;
+        }
+    }
+    if (!i) {
+        /* no thread created, parse in this one */
+        parse_data_worker(&jobs);
+    }
+    threads = i;
+    for (i = 0; i < threads; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    ly_log_options(prev_opts);
+    pthread_mutex_destroy(&jobs.lock);
+
+    for (item = data, i = 0; item; item = item->next, i++) {
+        item->type = options & LYD_OPT_TYPEMASK;
+        if (jobs.msgs[i]) {
+            fputs(jobs.msgs[i], stderr);
+        }
+        if (jobs.failed[i]) {
+            ret++;
+        }
+    }
+
+    sec = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    fprintf(stderr, "yanglint: %d data files (%.1f MB) processed in %.3f s, %.0f files/s, %.1f MB/s.\n", count,
+            jobs.bytes / 1e6, sec, sec > 0 ? count / sec : 0, sec > 0 ? jobs.bytes / 1e6 / sec : 0);
+
+cleanup:
+    for (i = 0; jobs.msgs && (i < count); i++) {
+        free(jobs.msgs[i]);
+    }
+    free(jobs.msgs);
+    free(jobs.failed);
+    free(tids);
+    return ret;
 }
 
 /*
@@ -256,10 +426,12 @@ main_ni(int argc, char* argv[])
         {"help",             no_argument,       NULL, 'h'},
         {"tree-help",        no_argument,       NULL, 'H'},
         {"allimplemented",   no_argument,       NULL, 'i'},
+        {"jobs",             required_argument, NULL, 'j'},
         {"list",             no_argument,       NULL, 'l'},
         {"merge",            no_argument,       NULL, 'm'},
         {"output",           required_argument, NULL, 'o'},
         {"path",             required_argument, NULL, 'p'},
+        {"profile",          no_argument,       NULL, 'R'},
         {"running",          required_argument, NULL, 'r'},
         {"strict",           no_argument,       NULL, 's'},
         {"type",             required_argument, NULL, 't'},
@@ -283,15 +455,8 @@ main_ni(int argc, char* argv[])
     struct stat st;
     uint32_t u;
     int options_dflt = 0, options_parser = 0, options_ctx = LY_CTX_NOYANGLIBRARY, envelope = 0, autodetection = 0;
-    int merge = 0, list = 0, outoptions_s = 0, outline_length_s = 0;
-    struct dataitem {
-        const char *filename;
-        struct lyxml_elem *xml;
-        struct lyd_node *tree;
-        struct dataitem *next;
-        LYD_FORMAT format;
-        int type;
-    } *data = NULL, *data_item, *data_prev = NULL;
+    int merge = 0, list = 0, profile = 0, outoptions_s = 0, outline_length_s = 0, threads = 1, parallel = 0;
+    struct dataitem *data = NULL, *data_item, *data_prev = NULL;
     struct ly_set *mods = NULL;
     struct lyd_node *running = NULL, *subroot, *next, *node;
     void *p;
@@ -300,9 +465,9 @@ main_ni(int argc, char* argv[])
 
     opterr = 0;
 #ifndef NDEBUG
-    while ((opt = getopt_long(argc, argv, "ad:f:F:gunP:L:hHilmo:p:r:st:vVG:y:", options, &opt_index)) != -1)
+    while ((opt = getopt_long(argc, argv, "ad:f:F:gunP:L:hHij:lmo:p:Rr:st:vVG:y:", options, &opt_index)) != -1)
 #else
-    while ((opt = getopt_long(argc, argv, "ad:f:F:gunP:L:hHilmo:p:r:st:vVy:", options, &opt_index)) != -1)
+    while ((opt = getopt_long(argc, argv, "ad:f:F:gunP:L:hHij:lmo:p:Rr:st:vVy:", options, &opt_index)) != -1)
 #endif
     {
         switch (opt) {
@@ -400,6 +565,14 @@ main_ni(int argc, char* argv[])
         case 'i':
             options_ctx |= LY_CTX_ALLIMPLEMENTED;
             break;
+        case 'j':
+            threads = strtol(optarg, &ptr, 10);
+            if (ptr[0] || (threads < 1)) {
+                fprintf(stderr, "yanglint error: invalid number of jobs \"%s\".\n", optarg);
+                help(1);
+                goto cleanup;
+            }
+            break;
         case 'l':
             list = 1;
             break;
@@ -430,6 +603,9 @@ main_ni(int argc, char* argv[])
             }
             ly_set_add(searchpaths, optarg, 0);
             break;
+        case 'R':
+            profile = 1;
+            break;
         case 'r':
             if (running_file || (options_parser & LYD_OPT_NOEXTDEPS)) {
                 fprintf(stderr, "yanglint error: The running datastore (-r) cannot be set multiple times.\n");
@@ -586,6 +762,13 @@ main_ni(int argc, char* argv[])
         /* add option to ignore ietf-yang-library data for implicit data type */
         options_parser |= LYD_OPT_DATA_NO_YANGLIB;
     }
+    if (threads > 1) {
+        if (autodetection || ((options_parser & LYD_OPT_TYPEMASK) == LYD_OPT_RPCREPLY)) {
+            fprintf(stderr, "yanglint warning: parallel processing not allowed, ignoring option -j.\n");
+        } else {
+            parallel = 1;
+        }
+    }
 
     /* set callback for printing libyang messages */
     ly_set_log_clb(libyang_verbclb, 1);
@@ -611,6 +794,11 @@ main_ni(int argc, char* argv[])
     /* derefered setting of verbosity in libyang after context initiation */
     ly_verb(verbose);
 
+    if (profile) {
+        ly_ctx_set_val_profiling(ctx, 1);
+        ly_ctx_set_stats(ctx, 1);
+    }
+
     mods = ly_set_new();
 
 
@@ -733,9 +921,15 @@ main_ni(int argc, char* argv[])
             }
         }
 
+        if (parallel && parse_data_parallel(ctx, data, options_parser, running, threads)) {
+            goto cleanup;
+        }
+
         for (data_item = data, data_prev = NULL; data_item; data_prev = data_item, data_item = data_item->next) {
             /* parse data file - via LYD_OPT_TRUSTED postpone validation when all data are loaded and merged */
-            if (autodetection) {
+            if (parallel) {
+                /* already parsed */
+            } else if (autodetection) {
                 /* erase option not covered by LYD_OPT_TYPEMASK, but used according to the type */
                 options_parser &= ~LYD_OPT_DATA_NO_YANGLIB;
                 /* automatically detect data type from the data top level */
@@ -1022,6 +1216,10 @@ cleanup:
         free(data);
     }
     lyd_free_withsiblings(running);
+    if (ctx && profile) {
+        print_val_profile(stderr, ctx);
+        print_stats(stderr, ctx);
+    }
     ly_ctx_destroy(ctx, NULL);
 
     return ret;
@@ -15,12 +15,15 @@
 #define _GNU_SOURCE
 #include <errno.h>
 #include <fcntl.h>
+#include <inttypes.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <string.h>
 #include <getopt.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "libyang.h"
@@ -33,7 +36,9 @@ help(void)
     fprintf(stdout, "    yangre [-hv]\n");
     fprintf(stdout, "    yangre [-V] -p <regexp1> [-i] [-p <regexp2> [-i] ...] <string>\n");
     fprintf(stdout, "    yangre [-V] -f <file>\n");
-    fprintf(stdout, "Returns 0 if string matches the pattern(s), 1 if not and -1 on error.\n\n");
+    fprintf(stdout, "    yangre [-V] [-j <threads>] (-p <regexp1> [-i] ... | -f <file>) -b <input>\n");
+    fprintf(stdout, "Returns 0 if string matches the pattern(s), 1 if not and -1 on error.\n"
+                    "In the batch mode, returns 0 if all the input lines match.\n\n");
     fprintf(stdout, "Options:\n"
         "  -h, --help              Show this help message and exit.\n"
         "  -v, --version           Show version number and exit.\n"
@@ -48,7 +53,13 @@ help(void)
         "                          beginning of the pattern line. YANG quotation around\n"
         "                          patterns is still expected, but that avoids issues with\n"
         "                          reading quotation by shell. Avoid newline at the end\n"
-        "                          of the string line to represent empty <string>.");
+        "                          of the string line to represent empty <string>.\n"
+        "  -b, --batch=\"INPUT\"     Match every line of <input> (\"-\" for stdin) against\n"
+        "                          the patterns and print the number of matching lines\n"
+        "                          and the throughput of every pattern. The matching\n"
+        "                          lines are printed with -V. The <string> from <file>\n"
+        "                          is not used.\n"
+        "  -j, --threads=NUM       Number of threads matching the batch input lines.\n\n");
     fprintf(stdout, "Examples:\n"
         "  pattern \"[0-9a-fA-F]*\";      -> yangre -p '\"[0-9a-fA-F]*\"' '1F'\n"
         "  pattern '[a-zA-Z0-9\\-_.]*';  -> yangre -p \"'[a-zA-Z0-9\\-_.]*'\" 'a-b'\n"
@@ -79,6 +90,10 @@ static const char *module_start = "module yangre {"
     "prefix re;"
     "leaf pattern {"
     "  type string {";
+static const char *module_head = "module yangre {"
+    "yang-version 1.1;"
+    "namespace urn:cesnet:libyang:yangre;"
+    "prefix re;";
 static const char *module_invertmatch = " { modifier invert-match; }";
 static const char *module_match = ";";
 static const char *module_end = "}}}";
@@ -105,20 +120,230 @@ add_pattern(char ***patterns, int **inverts, int *counter, char *pattern)
     return EXIT_SUCCESS;
 }
 
+/* number of lines read by a thread at once in the batch mode */
+#define BATCH_LINES 1024
+
+struct batch {
+    FILE *in;
+    pthread_mutex_t lock;       /* input, output, and the results */
+    struct lys_node **leaves;   /* leaf with a single pattern for every pattern */
+    int count;
+    int verbose;
+
+    uint64_t lines;
+    uint64_t matching;
+    uint64_t bytes;
+    uint64_t *matches;          /* matching lines of every pattern */
+    uint64_t *nsec;             /* time spent matching every pattern */
+};
+
+/* module with a separate leaf for every pattern */
+static char *
+batch_module(char **patterns, int *inverts, int count)
+{
+    char *modstr = NULL;
+    size_t size;
+    FILE *out;
+    int i;
+
+    out = open_memstream(&modstr, &size);
+    if (!out) {
+        return NULL;
+    }
+    fputs(module_head, out);
+    for (i = 0; i < count; i++) {
+        fprintf(out, "leaf p%d { type string { pattern %s%s}}", i + 1, patterns[i],
+                inverts[i] ? module_invertmatch : module_match);
+    }
+    fputs("}", out);
+    if (fclose(out)) {
+        free(modstr);
+        return NULL;
+    }
+
+    return modstr;
+}
+
+static void *
+batch_worker(void *arg)
+{
+    struct batch *b = arg;
+    char *lines[BATCH_LINES] = {NULL};
+    size_t sizes[BATCH_LINES] = {0};
+    uint64_t *matches, *nsec, nlines = 0, matching = 0, bytes = 0;
+    struct timespec start, end;
+    ssize_t l;
+    int n, i, j, match;
+
+    matches = calloc(2 * b->count, sizeof *matches);
+    if (!matches) {
+        fprintf(stderr, "yangre error: memory allocation failed.\n");
+        return NULL;
+    }
+    nsec = matches + b->count;
+
+    do {
+        pthread_mutex_lock(&b->lock);
+        for (n = 0; (n < BATCH_LINES) && ((l = getline(&lines[n], &sizes[n], b->in)) != -1); n++) {
+            if (l && (lines[n][l - 1] == '\n')) {
+                lines[n][l - 1] = '\0';
+            }
+        }
+        pthread_mutex_unlock(&b->lock);
+
+        for (i = 0; i < n; i++) {
+            match = 1;
+            for (j = 0; j < b->count; j++) {
+                clock_gettime(CLOCK_MONOTONIC, &start);
+                if (!lyd_validate_value(b->leaves[j], lines[i])) {
+                    matches[j]++;
+                } else {
+                    match = 0;
+                }
+                clock_gettime(CLOCK_MONOTONIC, &end);
+                nsec[j] += (end.tv_sec - start.tv_sec) * 1000000000 + end.tv_nsec - start.tv_nsec;
+            }
+            bytes += strlen(lines[i]);
+
+            if (match) {
+                matching++;
+                if (b->verbose) {
+                    pthread_mutex_lock(&b->lock);
+                    fprintf(stdout, "%s\n", lines[i]);
+                    pthread_mutex_unlock(&b->lock);
+                }
+            }
+        }
+        nlines += n;
+    } while (n == BATCH_LINES);
+
+    pthread_mutex_lock(&b->lock);
+    b->lines += nlines;
+    b->matching += matching;
+    b->bytes += bytes;
+    for (j = 0; j < b->count; j++) {
+        b->matches[j] += matches[j];
+        b->nsec[j] += nsec[j];
+    }
+    pthread_mutex_unlock(&b->lock);
+
+    for (n = 0; n < BATCH_LINES; n++) {
+        free(lines[n]);
+    }
+    free(matches);
+    return NULL;
+}
+
+/* match all the lines of the input against every pattern separately */
+static int
+batch_run(struct ly_ctx *ctx, char **patterns, int *inverts, int count, const char *input, int threads, int verbose)
+{
+    struct batch b;
+    const struct lys_module *mod;
+    struct lys_node *node;
+    struct timespec start, end;
+    pthread_t *tids = NULL;
+    char *modstr;
+    double sec, psec;
+    int i, ret = -1;
+
+    memset(&b, 0, sizeof b);
+    pthread_mutex_init(&b.lock, NULL);
+    b.count = count;
+    b.verbose = verbose;
+
+    modstr = batch_module(patterns, inverts, count);
+    if (!modstr) {
+        fprintf(stderr, "yangre error: memory allocation failed.\n");
+        goto cleanup;
+    }
+    mod = lys_parse_mem(ctx, modstr, LYS_IN_YANG);
+    free(modstr);
+    if (!mod) {
+        goto cleanup;
+    }
+
+    b.leaves = calloc(count, sizeof *b.leaves);
+    b.matches = calloc(2 * count, sizeof *b.matches);
+    tids = calloc(threads, sizeof *tids);
+    if (!b.leaves || !b.matches || !tids) {
+        fprintf(stderr, "yangre error: memory allocation failed.\n");
+        goto cleanup;
+    }
+    b.nsec = b.matches + count;
+    i = 0;
+    LY_TREE_FOR(mod->data, node) {
+        b.leaves[i++] = node;
+    }
+
+    if (!strcmp(input, "-")) {
+        b.in = stdin;
+    } else {
+        b.in = fopen(input, "r");
+        if (!b.in) {
+            fprintf(stderr, "yangre error: unable to open input file %s (%s).\n", input, strerror(errno));
+            goto cleanup;
+        }
+    }
+
+    /* not matching lines are expected, do not log them */
+    ly_log_options(0);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < threads; i++) {
+        if (pthread_create(&tids[i], NULL, batch_worker, &b)) {
+            fprintf(stderr, "yangre error: unable to create a thread.\n");
+            threads = i;
+            break;
+        }
+    }
+    for (i = 0; i < threads; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    sec = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+    fprintf(stdout, "lines     : %" PRIu64 "\n", b.lines);
+    fprintf(stdout, "matching  : %" PRIu64 "\n", b.matching);
+    fprintf(stdout, "time      : %.3f s (%.0f lines/s)\n", sec, sec > 0 ? b.lines / sec : 0);
+    for (i = 0; i < count; i++) {
+        /* the throughput of a single thread */
+        psec = b.nsec[i] / 1e9;
+        fprintf(stdout, "pattern  %d: %s\n", i + 1, patterns[i]);
+        fprintf(stdout, "matching %d: %" PRIu64 " (%s)\n", i + 1, b.matches[i], inverts[i] ? "inverted" : "regular");
+        fprintf(stdout, "speed    %d: %.0f lines/s, %.1f MB/s\n", i + 1, psec > 0 ? b.lines / psec : 0,
+                psec > 0 ? b.bytes / psec / 1e6 : 0);
+    }
+
+    ret = (b.matching == b.lines) ? 0 : 1;
+
+cleanup:
+    if (b.in && (b.in != stdin)) {
+        fclose(b.in);
+    }
+    pthread_mutex_destroy(&b.lock);
+    free(b.leaves);
+    free(b.matches);
+    free(tids);
+    return ret;
+}
+
 int
 main(int argc, char* argv[])
 {
-    int i, opt_index = 0, ret = -1, verbose = 0, blankline = 0;
+    int i, opt_index = 0, ret = -1, verbose = 0, blankline = 0, threads = 1;
     struct option options[] = {
         {"help",             no_argument,       NULL, 'h'},
+        {"batch",            required_argument, NULL, 'b'},
         {"file",             required_argument, NULL, 'f'},
         {"invert-match",     no_argument,       NULL, 'i'},
         {"pattern",          required_argument, NULL, 'p'},
+        {"threads",          required_argument, NULL, 'j'},
         {"version",          no_argument,       NULL, 'v'},
         {"verbose",          no_argument,       NULL, 'V'},
         {NULL,               0,                 NULL, 0}
     };
-    char **patterns = NULL, *str = NULL, *modstr = NULL, *s;
+    char **patterns = NULL, *str = NULL, *modstr = NULL, *s, *batch = NULL, *ptr;
     int *invert_match = NULL;
     int patterns_count = 0;
     struct ly_ctx *ctx = NULL;
@@ -128,8 +353,19 @@ main(int argc, char* argv[])
     ssize_t l;
 
     opterr = 0;
-    while ((i = getopt_long(argc, argv, "hf:ivVp:", options, &opt_index)) != -1) {
+    while ((i = getopt_long(argc, argv, "hb:f:ij:vVp:", options, &opt_index)) != -1) {
         switch (i) {
+        case 'b':
+            batch = optarg;
+            break;
+        case 'j':
+            threads = strtol(optarg, &ptr, 10);
+            if (ptr[0] || (threads < 1)) {
+                help();
+                fprintf(stderr, "yangre error: invalid number of threads \"%s\".\n", optarg);
+                goto cleanup;
+            }
+            break;
         case 'h':
             help();
             ret = -2; /* continue to allow printing version and help at once */
@@ -223,6 +459,22 @@ main(int argc, char* argv[])
         goto cleanup;
     }
 
+    if (batch) {
+        if (!patterns_count) {
+            help();
+            fprintf(stderr, "yangre error: missing pattern parameter to use.\n");
+            goto cleanup;
+        }
+
+        ctx = ly_ctx_new(NULL, 0);
+        if (!ctx) {
+            goto cleanup;
+        }
+        ly_set_log_clb(pattern_error, 0);
+        ret = batch_run(ctx, patterns, invert_match, patterns_count, batch, threads, verbose);
+        goto cleanup;
+    }
+
     if (!str) {
         /* check options compatibility */
         if (optind >= argc) {
@@ -0,0 +1,973 @@
+/**
+ * @file main.c
+ * @brief libyang's generator of C code specialized for YANG modules
+ *
+ * Copyright (c) 2018 CESNET, z.s.p.o.
+ *
+ * This source code is licensed under BSD 3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://opensource.org/licenses/BSD-3-Clause
+ */
+
+#define _GNU_SOURCE
+#include <ctype.h>
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <libgen.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libyang.h"
+
+/* generated node of the schema */
+struct gnode {
+    const struct lys_node *node;
+    char *id;                   /* C identifier, without the prefix */
+    char *path;                 /* data path */
+    int parser;                 /* whether a value parser is generated */
+};
+
+struct gen {
+    const char *prefix;         /* prefix of the generated identifiers */
+    struct gnode *nodes;
+    int count;
+    const struct lys_module **mods;
+    int mod_count;
+};
+
+/* interval of a range or length restriction */
+struct intv {
+    int64_t min;
+    int64_t max;
+    uint64_t umin;
+    uint64_t umax;
+};
+
+void
+help(void)
+{
+    fprintf(stdout, "Generator of C code specialized for YANG modules.\n");
+    fprintf(stdout, "Usage:\n");
+    fprintf(stdout, "    yang2c [-hv]\n");
+    fprintf(stdout, "    yang2c [-p <path>]... [-n <name>] -o <output> <module>...\n\n");
+    fprintf(stdout, "Generates <output>.h and <output>.c with the table of the schema nodes of the data\n"
+                    "trees of the modules, typed accessors of the leaves, and value parsers specialized\n"
+                    "for the types of the leaves and leaf-lists, which are set for the data parsers by\n"
+                    "the generated <name>_init(). Values the specialized parsers do not accept and the\n"
+                    "modules of other revisions are still parsed by the generic libyang parser.\n\n");
+    fprintf(stdout, "Options:\n"
+        "  -h, --help              Show this help message and exit.\n"
+        "  -v, --version           Show version number and exit.\n"
+        "  -p, --path=PATH         Search path for the imported modules.\n"
+        "  -o, --output=OUTPUT     Path of the generated files without the suffix.\n"
+        "  -n, --name=NAME         Prefix of the generated identifiers, the file name of\n"
+        "                          <output> by default.\n\n");
+}
+
+void
+version(void)
+{
+    fprintf(stdout, "yang2c %d.%d.%d\n", LY_VERSION_MAJOR, LY_VERSION_MINOR, LY_VERSION_MICRO);
+}
+
+static char *
+c_identifier(const char *str)
+{
+    char *id, *ptr;
+
+    id = strdup(str);
+    if (!id) {
+        return NULL;
+    }
+    for (ptr = id; *ptr; ++ptr) {
+        if (!isalnum(*ptr)) {
+            *ptr = '_';
+        }
+    }
+    if (isdigit(id[0])) {
+        id[0] = '_';
+    }
+    return id;
+}
+
+static void
+print_upper(FILE *out, const char *str)
+{
+    for (; *str; ++str) {
+        fputc(toupper(*str), out);
+    }
+}
+
+/* the type with the definitions of the enums */
+static const struct lys_type *
+type_enums(const struct lys_type *type)
+{
+    for (; !type->info.enums.count; type = &type->der->type);
+    return type;
+}
+
+/* the nearest range or length restriction in the typedef chain, which is the effective one */
+static const struct lys_restr *
+type_restr(const struct lys_type *type)
+{
+    for (; type; type = type->der ? &type->der->type : NULL) {
+        if ((type->base == LY_TYPE_STRING) && type->info.str.length) {
+            return type->info.str.length;
+        } else if ((type->base != LY_TYPE_STRING) && type->info.num.range) {
+            return type->info.num.range;
+        }
+    }
+    return NULL;
+}
+
+static int
+type_has_patterns(const struct lys_type *type)
+{
+    for (; type; type = type->der ? &type->der->type : NULL) {
+        if (type->info.str.pat_count) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int
+type_is_signed(LY_DATA_TYPE base)
+{
+    return (base == LY_TYPE_INT8) || (base == LY_TYPE_INT16) || (base == LY_TYPE_INT32) || (base == LY_TYPE_INT64);
+}
+
+static void
+type_bounds(LY_DATA_TYPE base, struct intv *intv)
+{
+    memset(intv, 0, sizeof *intv);
+    switch (base) {
+    case LY_TYPE_INT8:
+        intv->min = INT8_MIN;
+        intv->max = INT8_MAX;
+        break;
+    case LY_TYPE_INT16:
+        intv->min = INT16_MIN;
+        intv->max = INT16_MAX;
+        break;
+    case LY_TYPE_INT32:
+        intv->min = INT32_MIN;
+        intv->max = INT32_MAX;
+        break;
+    case LY_TYPE_INT64:
+        intv->min = INT64_MIN;
+        intv->max = INT64_MAX;
+        break;
+    case LY_TYPE_UINT8:
+        intv->umax = UINT8_MAX;
+        break;
+    case LY_TYPE_UINT16:
+        intv->umax = UINT16_MAX;
+        break;
+    case LY_TYPE_UINT32:
+        intv->umax = UINT32_MAX;
+        break;
+    case LY_TYPE_UINT64:
+    case LY_TYPE_STRING:
+        intv->umax = UINT64_MAX;
+        break;
+    default:
+        break;
+    }
+}
+
+/* parse one boundary of a restriction, "min" and "max" are the bounds of the type */
+static const char *
+parse_bound(const char *expr, int sign, const struct intv *bounds, int64_t *num, uint64_t *unum)
+{
+    char *end;
+
+    while (isspace(*expr)) {
+        ++expr;
+    }
+    if (!strncmp(expr, "min", 3)) {
+        *num = bounds->min;
+        *unum = bounds->umin;
+        end = (char *)expr + 3;
+    } else if (!strncmp(expr, "max", 3)) {
+        *num = bounds->max;
+        *unum = bounds->umax;
+        end = (char *)expr + 3;
+    } else {
+        errno = 0;
+        if (sign) {
+            *num = strtoll(expr, &end, 10);
+        } else {
+            *unum = strtoull(expr, &end, 10);
+        }
+        if (errno || (end == expr)) {
+            return NULL;
+        }
+    }
+    while (isspace(*end)) {
+        ++end;
+    }
+    return end;
+}
+
+/* parse a range or length restriction into intervals, NULL restriction for the bounds of the type */
+static int
+parse_restr(const struct lys_restr *restr, LY_DATA_TYPE base, struct intv **intvs, int *count)
+{
+    struct intv bounds, *intv;
+    const char *expr;
+    int sign = type_is_signed(base);
+
+    type_bounds(base, &bounds);
+    *intvs = NULL;
+    *count = 0;
+    if (!restr) {
+        *intvs = malloc(sizeof **intvs);
+        if (!*intvs) {
+            return -1;
+        }
+        **intvs = bounds;
+        *count = 1;
+        return 0;
+    }
+
+    for (expr = restr->expr; expr && *expr; ) {
+        intv = realloc(*intvs, (*count + 1) * sizeof **intvs);
+        if (!intv) {
+            return -1;
+        }
+        *intvs = intv;
+        intv = &(*intvs)[(*count)++];
+        memset(intv, 0, sizeof *intv);
+
+        expr = parse_bound(expr, sign, &bounds, &intv->min, &intv->umin);
+        if (!expr) {
+            return -1;
+        }
+        if (!strncmp(expr, "..", 2)) {
+            expr = parse_bound(expr + 2, sign, &bounds, &intv->max, &intv->umax);
+            if (!expr) {
+                return -1;
+            }
+        } else {
+            intv->max = intv->min;
+            intv->umax = intv->umin;
+        }
+        if (*expr == '|') {
+            ++expr;
+        } else if (*expr) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static void
+print_int_literal(FILE *out, int sign, int64_t num, uint64_t unum)
+{
+    if (!sign) {
+        fprintf(out, "UINT64_C(%" PRIu64 ")", unum);
+    } else if (num == INT64_MIN) {
+        fprintf(out, "INT64_MIN");
+    } else {
+        fprintf(out, "INT64_C(%" PRId64 ")", num);
+    }
+}
+
+/* condition of the intervals on the variable, nothing if the whole domain is allowed */
+static int
+print_intv_cond(FILE *out, const char *var, LY_DATA_TYPE base, const struct intv *intvs, int count)
+{
+    struct intv bounds;
+    int i, sign = type_is_signed(base);
+
+    /* the bounds of the type are checked when parsing the number */
+    type_bounds(base, &bounds);
+    if ((count == 1) && (intvs[0].min == bounds.min) && (intvs[0].max == bounds.max)
+            && (intvs[0].umin == bounds.umin) && (intvs[0].umax == bounds.umax)) {
+        return 0;
+    }
+
+    fprintf(out, "!(");
+    for (i = 0; i < count; ++i) {
+        if (i) {
+            fprintf(out, "\n            || ");
+        }
+        if (sign ? (intvs[i].min == intvs[i].max) : (intvs[i].umin == intvs[i].umax)) {
+            fprintf(out, "(%s == ", var);
+            print_int_literal(out, sign, intvs[i].min, intvs[i].umin);
+            fprintf(out, ")");
+        } else if (!sign && !intvs[i].umin) {
+            /* unsigned values are never less */
+            fprintf(out, "(%s <= ", var);
+            print_int_literal(out, sign, intvs[i].max, intvs[i].umax);
+            fprintf(out, ")");
+        } else {
+            fprintf(out, "((%s >= ", var);
+            print_int_literal(out, sign, intvs[i].min, intvs[i].umin);
+            fprintf(out, ") && (%s <= ", var);
+            print_int_literal(out, sign, intvs[i].max, intvs[i].umax);
+            fprintf(out, "))");
+        }
+    }
+    fprintf(out, ")");
+    return 1;
+}
+
+static const char *
+int_member(LY_DATA_TYPE base)
+{
+    switch (base) {
+    case LY_TYPE_INT8:
+        return "int8";
+    case LY_TYPE_INT16:
+        return "int16";
+    case LY_TYPE_INT32:
+        return "int32";
+    case LY_TYPE_INT64:
+        return "int64";
+    case LY_TYPE_UINT8:
+        return "uint8";
+    case LY_TYPE_UINT16:
+        return "uint16";
+    case LY_TYPE_UINT32:
+        return "uint32";
+    case LY_TYPE_UINT64:
+        return "uint64";
+    default:
+        return NULL;
+    }
+}
+
+/* whether a specialized parser can be generated for the type */
+static int
+type_parser_supported(const struct lys_type *type)
+{
+    const struct lys_type *t;
+    const struct lys_tpdf *tpdf;
+    unsigned int i;
+
+    switch (type->base) {
+    case LY_TYPE_BOOL:
+        return 1;
+    case LY_TYPE_INT8:
+    case LY_TYPE_INT16:
+    case LY_TYPE_INT32:
+    case LY_TYPE_INT64:
+    case LY_TYPE_UINT8:
+    case LY_TYPE_UINT16:
+    case LY_TYPE_UINT32:
+    case LY_TYPE_UINT64:
+        return 1;
+    case LY_TYPE_STRING:
+        for (tpdf = type->der; tpdf && tpdf->module; tpdf = tpdf->type.der) {
+            if (!strcmp(tpdf->name, "xpath1.0") && !strcmp(tpdf->module->name, "ietf-yang-types")) {
+                return 0;
+            }
+        }
+        return !type_has_patterns(type);
+    case LY_TYPE_ENUM:
+        /* enums disabled by if-features are left to the generic parser */
+        t = type_enums(type);
+        for (i = 0; i < t->info.enums.count; ++i) {
+            if (t->info.enums.enm[i].iffeature_size) {
+                return 0;
+            }
+        }
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+static int
+gen_add(struct gen *gen, const struct lys_node *node)
+{
+    struct gnode *gnode;
+    char *path, *id, *ptr;
+    int i, suffix = 0;
+
+    path = lys_data_path(node);
+    if (!path) {
+        return -1;
+    }
+    /* "/mod:a/b" -> "mod_a_b" */
+    id = c_identifier(path + 1);
+    if (!id) {
+        free(path);
+        return -1;
+    }
+    for (i = 0; i < gen->count; ++i) {
+        if (!strcmp(gen->nodes[i].id, id)) {
+            /* the same identifier of different names */
+            if (asprintf(&ptr, "%s_%d", id, ++suffix) == -1) {
+                free(path);
+                free(id);
+                return -1;
+            }
+            free(id);
+            id = ptr;
+            i = -1;
+        }
+    }
+
+    gnode = realloc(gen->nodes, (gen->count + 1) * sizeof *gen->nodes);
+    if (!gnode) {
+        free(path);
+        free(id);
+        return -1;
+    }
+    gen->nodes = gnode;
+    gnode = &gen->nodes[gen->count++];
+    gnode->node = node;
+    gnode->id = id;
+    gnode->path = path;
+    gnode->parser = (node->nodetype & (LYS_LEAF | LYS_LEAFLIST))
+            && type_parser_supported(&((struct lys_node_leaf *)node)->type);
+    return 0;
+}
+
+/* collect the data nodes in the schema order */
+static int
+gen_collect(struct gen *gen, const struct lys_node *parent, const struct lys_module *mod)
+{
+    const struct lys_node *node = NULL;
+
+    while ((node = lys_getnext(node, parent, mod, 0))) {
+        if (!(node->nodetype & (LYS_CONTAINER | LYS_LIST | LYS_LEAF | LYS_LEAFLIST))) {
+            continue;
+        }
+        if (gen_add(gen, node)) {
+            return -1;
+        }
+        if ((node->nodetype & (LYS_CONTAINER | LYS_LIST)) && gen_collect(gen, node, mod)) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/* C type of the value returned by the accessor of the leaf, NULL if there is none */
+static const char *
+accessor_type(const struct lys_type *type)
+{
+    switch (type->base) {
+    case LY_TYPE_BOOL:
+        return "int";
+    case LY_TYPE_DEC64:
+        return "double";
+    case LY_TYPE_ENUM:
+    case LY_TYPE_STRING:
+        return "const char *";
+    case LY_TYPE_INT8:
+        return "int8_t";
+    case LY_TYPE_INT16:
+        return "int16_t";
+    case LY_TYPE_INT32:
+        return "int32_t";
+    case LY_TYPE_INT64:
+        return "int64_t";
+    case LY_TYPE_UINT8:
+        return "uint8_t";
+    case LY_TYPE_UINT16:
+        return "uint16_t";
+    case LY_TYPE_UINT32:
+        return "uint32_t";
+    case LY_TYPE_UINT64:
+        return "uint64_t";
+    default:
+        return NULL;
+    }
+}
+
+static void
+print_type_base(FILE *out, LY_DATA_TYPE base)
+{
+    switch (base) {
+    case LY_TYPE_BOOL:
+        fprintf(out, "LY_TYPE_BOOL");
+        break;
+    case LY_TYPE_DEC64:
+        fprintf(out, "LY_TYPE_DEC64");
+        break;
+    case LY_TYPE_ENUM:
+        fprintf(out, "LY_TYPE_ENUM");
+        break;
+    case LY_TYPE_STRING:
+        fprintf(out, "LY_TYPE_STRING");
+        break;
+    default:
+        fprintf(out, "LY_TYPE_");
+        print_upper(out, int_member(base));
+        break;
+    }
+}
+
+static void
+print_header(FILE *out, struct gen *gen, const char *guard)
+{
+    struct gnode *gnode;
+    const char *ctype;
+    int i;
+
+    fprintf(out, "/* Generated by yang2c from the modules");
+    for (i = 0; i < gen->mod_count; ++i) {
+        fprintf(out, " %s%s%s", gen->mods[i]->name, gen->mods[i]->rev_size ? "@" : "",
+                gen->mods[i]->rev_size ? gen->mods[i]->rev[0].date : "");
+    }
+    fprintf(out, ", do not edit. */\n\n");
+    fprintf(out, "#ifndef %s\n#define %s\n\n", guard, guard);
+    fprintf(out, "#include <stdint.h>\n\n#include <libyang/libyang.h>\n\n");
+    fprintf(out, "#ifdef __cplusplus\nextern \"C\" {\n#endif\n\n");
+
+    fprintf(out, "/* indices of the schema nodes in %s_nodes */\nenum %s_node {\n", gen->prefix, gen->prefix);
+    for (i = 0; i < gen->count; ++i) {
+        fprintf(out, "    ");
+        print_upper(out, gen->prefix);
+        fprintf(out, "_");
+        print_upper(out, gen->nodes[i].id);
+        fprintf(out, ", /* %s */\n", gen->nodes[i].path);
+    }
+    fprintf(out, "    ");
+    print_upper(out, gen->prefix);
+    fprintf(out, "_NODE_COUNT\n};\n\n");
+
+    fprintf(out, "/* schema nodes of the context passed to %s_init() */\n", gen->prefix);
+    fprintf(out, "extern const struct lys_node *%s_nodes[", gen->prefix);
+    print_upper(out, gen->prefix);
+    fprintf(out, "_NODE_COUNT];\n\n");
+
+    fprintf(out, "/**\n"
+                 " * @brief Resolve the schema nodes in the context and set the specialized value parsers.\n"
+                 " *\n"
+                 " * @param[in] ctx Context with the modules implemented in the generated revisions.\n"
+                 " * @return 0 on success, -1 if the modules in the context differ, the generic parsers are used then\n"
+                 " * and the accessors cannot be used.\n"
+                 " */\n"
+                 "int %s_init(struct ly_ctx *ctx);\n", gen->prefix);
+
+    for (i = 0; i < gen->count; ++i) {
+        gnode = &gen->nodes[i];
+        if (gnode->node->nodetype != LYS_LEAF) {
+            continue;
+        }
+        ctype = accessor_type(&((struct lys_node_leaf *)gnode->node)->type);
+        if (!ctype) {
+            continue;
+        }
+        fprintf(out, "\n/* value of %s, 0 if it exists, non-zero otherwise */\n", gnode->path);
+        fprintf(out, "int %s_%s(const struct lyd_node *%s, %s%s*value);\n", gen->prefix, gnode->id,
+                lys_parent(gnode->node) ? "parent" : "tree", ctype, (ctype[strlen(ctype) - 1] == '*') ? "" : " ");
+    }
+
+    fprintf(out, "\n#ifdef __cplusplus\n}\n#endif\n\n#endif /* %s */\n", guard);
+}
+
+/* canonical decimal number parsers shared by the value parsers */
+static void
+print_num_parsers(FILE *out, struct gen *gen)
+{
+    fprintf(out, "static int\n"
+                 "%s_parse_uint(const char *str, uint64_t max, uint64_t *num)\n"
+                 "{\n"
+                 "    *num = 0;\n"
+                 "    if ((str[0] == '0') && str[1]) {\n"
+                 "        /* not canonical */\n"
+                 "        return 1;\n"
+                 "    }\n"
+                 "    do {\n"
+                 "        if ((*str < '0') || (*str > '9') || (*num > (max - (*str - '0')) / 10)) {\n"
+                 "            return 1;\n"
+                 "        }\n"
+                 "        *num = *num * 10 + (*str - '0');\n"
+                 "    } while (*++str);\n"
+                 "    return 0;\n"
+                 "}\n\n", gen->prefix);
+
+    fprintf(out, "static int\n"
+                 "%s_parse_int(const char *str, int64_t min, int64_t max, int64_t *num)\n"
+                 "{\n"
+                 "    uint64_t unum;\n"
+                 "\n"
+                 "    if (str[0] == '-') {\n"
+                 "        if ((str[1] == '0') || %s_parse_uint(str + 1, -(uint64_t)min, &unum)) {\n"
+                 "            return 1;\n"
+                 "        }\n"
+                 "        *num = -(int64_t)(unum - 1) - 1;\n"
+                 "        return 0;\n"
+                 "    }\n"
+                 "    if (%s_parse_uint(str, max, &unum)) {\n"
+                 "        return 1;\n"
+                 "    }\n"
+                 "    *num = unum;\n"
+                 "    return 0;\n"
+                 "}\n\n", gen->prefix, gen->prefix, gen->prefix);
+}
+
+static int
+print_parser(FILE *out, struct gen *gen, struct gnode *gnode)
+{
+    const struct lys_type *type = &((struct lys_node_leaf *)gnode->node)->type, *t;
+    struct intv *intvs = NULL, bounds;
+    int count, sign;
+    unsigned int i;
+
+    fprintf(out, "/* %s */\nstatic int\n%s_parse_%s(const struct lys_type *type, const char *value_str, lyd_val *value)\n{\n",
+            gnode->path, gen->prefix, gnode->id);
+
+    switch (type->base) {
+    case LY_TYPE_BOOL:
+        fprintf(out, "    (void)type;\n"
+                     "    if (!strcmp(value_str, \"true\")) {\n"
+                     "        value->bln = 1;\n"
+                     "    } else if (!strcmp(value_str, \"false\")) {\n"
+                     "        value->bln = 0;\n"
+                     "    } else {\n"
+                     "        return 1;\n"
+                     "    }\n");
+        break;
+    case LY_TYPE_ENUM:
+        t = type_enums(type);
+        fprintf(out, "    unsigned int i;\n\n");
+        for (i = 0; i < t->info.enums.count; ++i) {
+            fprintf(out, "    %sif (!strcmp(value_str, \"%s\")) {\n        i = %u;\n", i ? "} else " : "",
+                    t->info.enums.enm[i].name, i);
+        }
+        fprintf(out, "    } else {\n        return 1;\n    }\n");
+        fprintf(out, "    value->enm = &type->info.enums.enm[i];\n");
+        break;
+    case LY_TYPE_STRING:
+        if (type_restr(type)) {
+            if (parse_restr(type_restr(type), LY_TYPE_STRING, &intvs, &count)) {
+                free(intvs);
+                return -1;
+            }
+            fprintf(out, "    const char *ptr;\n"
+                         "    uint64_t len;\n\n"
+                         "    (void)type;\n"
+                         "    /* the length of other than ASCII strings is left to the generic parser */\n"
+                         "    for (ptr = value_str; *ptr; ++ptr) {\n"
+                         "        if (*ptr & 0x80) {\n"
+                         "            return 1;\n"
+                         "        }\n"
+                         "    }\n"
+                         "    len = ptr - value_str;\n"
+                         "    if (");
+            print_intv_cond(out, "len", LY_TYPE_STRING, intvs, count);
+            fprintf(out, ") {\n        return 1;\n    }\n");
+        } else {
+            fprintf(out, "    (void)type;\n");
+        }
+        fprintf(out, "    value->string = value_str;\n");
+        break;
+    default:
+        sign = type_is_signed(type->base);
+        type_bounds(type->base, &bounds);
+        if (parse_restr(type_restr(type), type->base, &intvs, &count)) {
+            free(intvs);
+            return -1;
+        }
+        fprintf(out, "    %s num;\n\n    (void)type;\n", sign ? "int64_t" : "uint64_t");
+        if (sign) {
+            fprintf(out, "    if (%s_parse_int(value_str, ", gen->prefix);
+            print_int_literal(out, 1, bounds.min, 0);
+            fprintf(out, ", ");
+            print_int_literal(out, 1, bounds.max, 0);
+        } else {
+            fprintf(out, "    if (%s_parse_uint(value_str, ", gen->prefix);
+            print_int_literal(out, 0, 0, bounds.umax);
+        }
+        fprintf(out, ", &num)");
+        if ((count > 1) || memcmp(&intvs[0], &bounds, sizeof bounds)) {
+            fprintf(out, "\n            || ");
+            print_intv_cond(out, "num", type->base, intvs, count);
+        }
+        fprintf(out, ") {\n        return 1;\n    }\n");
+        fprintf(out, "    value->%s = num;\n", int_member(type->base));
+        break;
+    }
+    free(intvs);
+
+    fprintf(out, "    return 0;\n}\n\n");
+    return 0;
+}
+
+static void
+print_accessor(FILE *out, struct gen *gen, struct gnode *gnode)
+{
+    const struct lys_type *type = &((struct lys_node_leaf *)gnode->node)->type;
+    const char *ctype;
+    int top = !lys_parent(gnode->node);
+
+    ctype = accessor_type(type);
+    if (!ctype) {
+        return;
+    }
+
+    fprintf(out, "int\n%s_%s(const struct lyd_node *%s, %s%s*value)\n{\n", gen->prefix, gnode->id,
+            top ? "tree" : "parent", ctype, (ctype[strlen(ctype) - 1] == '*') ? "" : " ");
+    fprintf(out, "    const struct lyd_node_leaf_list *leaf;\n\n");
+    if (top) {
+        fprintf(out, "    if (!tree) {\n        return 1;\n    }\n");
+        fprintf(out, "    leaf = (const struct lyd_node_leaf_list *)lyd_find_sibling_val(tree, %s_nodes[", gen->prefix);
+    } else {
+        fprintf(out, "    if (!parent || !parent->child) {\n        return 1;\n    }\n");
+        fprintf(out, "    leaf = (const struct lyd_node_leaf_list *)lyd_find_sibling_val(parent->child, %s_nodes[",
+                gen->prefix);
+    }
+    print_upper(out, gen->prefix);
+    fprintf(out, "_");
+    print_upper(out, gnode->id);
+    fprintf(out, "], NULL);\n");
+    fprintf(out, "    if (!leaf || (leaf->value_type != ");
+    print_type_base(out, type->base);
+    fprintf(out, ") || (leaf->value_flags & LY_VALUE_USER)) {\n        return 1;\n    }\n");
+
+    switch (type->base) {
+    case LY_TYPE_BOOL:
+        fprintf(out, "    *value = leaf->value.bln;\n");
+        break;
+    case LY_TYPE_DEC64:
+        fprintf(out, "    *value = (double)leaf->value.dec64 / %" PRIu64 ";\n", type->info.dec64.div);
+        break;
+    case LY_TYPE_ENUM:
+        fprintf(out, "    *value = leaf->value.enm->name;\n");
+        break;
+    case LY_TYPE_STRING:
+        fprintf(out, "    *value = leaf->value.string;\n");
+        break;
+    default:
+        fprintf(out, "    *value = leaf->value.%s;\n", int_member(type->base));
+        break;
+    }
+    fprintf(out, "    return 0;\n}\n\n");
+}
+
+static int
+print_source(FILE *out, struct gen *gen, const char *header)
+{
+    int i, num_parsers = 0;
+
+    fprintf(out, "/* Generated by yang2c, do not edit. */\n\n");
+    fprintf(out, "#include <stdint.h>\n#include <string.h>\n\n#include <libyang/libyang.h>\n"
+                 "#include <libyang/user_types.h>\n\n#include \"%s\"\n\n", header);
+
+    fprintf(out, "static const struct {\n    const char *name;\n    const char *revision;\n} %s_modules[] = {\n",
+            gen->prefix);
+    for (i = 0; i < gen->mod_count; ++i) {
+        if (gen->mods[i]->rev_size) {
+            fprintf(out, "    {\"%s\", \"%s\"},\n", gen->mods[i]->name, gen->mods[i]->rev[0].date);
+        } else {
+            fprintf(out, "    {\"%s\", NULL},\n", gen->mods[i]->name);
+        }
+    }
+    fprintf(out, "};\n\n");
+
+    fprintf(out, "static const char *%s_paths[] = {\n", gen->prefix);
+    for (i = 0; i < gen->count; ++i) {
+        fprintf(out, "    \"%s\",\n", gen->nodes[i].path);
+    }
+    fprintf(out, "};\n\nconst struct lys_node *%s_nodes[", gen->prefix);
+    print_upper(out, gen->prefix);
+    fprintf(out, "_NODE_COUNT];\n\n");
+
+    for (i = 0; i < gen->count; ++i) {
+        if (!gen->nodes[i].parser) {
+            continue;
+        }
+        if (!num_parsers && int_member(((struct lys_node_leaf *)gen->nodes[i].node)->type.base)) {
+            print_num_parsers(out, gen);
+            num_parsers = 1;
+        }
+        if (print_parser(out, gen, &gen->nodes[i])) {
+            fprintf(stderr, "yang2c error: invalid restriction of \"%s\".\n", gen->nodes[i].path);
+            return -1;
+        }
+    }
+
+    fprintf(out, "static const lytype_parse_clb %s_parsers[] = {\n", gen->prefix);
+    for (i = 0; i < gen->count; ++i) {
+        if (gen->nodes[i].parser) {
+            fprintf(out, "    %s_parse_%s,\n", gen->prefix, gen->nodes[i].id);
+        } else {
+            fprintf(out, "    NULL,\n");
+        }
+    }
+    fprintf(out, "};\n\n");
+
+    fprintf(out, "int\n%s_init(struct ly_ctx *ctx)\n{\n"
+                 "    unsigned int i;\n\n"
+                 "    for (i = 0; i < sizeof %s_modules / sizeof *%s_modules; ++i) {\n"
+                 "        if (!ly_ctx_get_module(ctx, %s_modules[i].name, %s_modules[i].revision, 1)) {\n"
+                 "            return -1;\n"
+                 "        }\n"
+                 "    }\n"
+                 "    for (i = 0; i < sizeof %s_paths / sizeof *%s_paths; ++i) {\n"
+                 "        %s_nodes[i] = ly_ctx_get_node(ctx, NULL, %s_paths[i], 0);\n"
+                 "        if (!%s_nodes[i]) {\n"
+                 "            return -1;\n"
+                 "        }\n"
+                 "    }\n\n"
+                 "    /* without the specialized parsers, the generic ones are used */\n"
+                 "    for (i = 0; i < sizeof %s_parsers / sizeof *%s_parsers; ++i) {\n"
+                 "        if (%s_parsers[i]) {\n"
+                 "            lys_set_value_parser(%s_nodes[i], %s_parsers[i]);\n"
+                 "        }\n"
+                 "    }\n"
+                 "    return 0;\n}\n\n",
+            gen->prefix, gen->prefix, gen->prefix, gen->prefix, gen->prefix, gen->prefix, gen->prefix, gen->prefix,
+            gen->prefix, gen->prefix, gen->prefix, gen->prefix, gen->prefix, gen->prefix, gen->prefix);
+
+    for (i = 0; i < gen->count; ++i) {
+        if (gen->nodes[i].node->nodetype == LYS_LEAF) {
+            print_accessor(out, gen, &gen->nodes[i]);
+        }
+    }
+
+    return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+    int opt, opt_index = 0, i, ret = EXIT_FAILURE;
+    const char *output = NULL, *name = NULL;
+    char *header_path = NULL, *source_path = NULL, *prefix = NULL, *dup = NULL, *guard = NULL, *ptr;
+    struct ly_ctx *ctx = NULL;
+    const struct lys_module *mod;
+    struct gen gen;
+    FILE *out;
+    struct option options[] = {
+        {"help",    no_argument,       NULL, 'h'},
+        {"version", no_argument,       NULL, 'v'},
+        {"path",    required_argument, NULL, 'p'},
+        {"output",  required_argument, NULL, 'o'},
+        {"name",    required_argument, NULL, 'n'},
+        {NULL,      0,                 NULL, 0}
+    };
+
+    memset(&gen, 0, sizeof gen);
+    ctx = ly_ctx_new(NULL, 0);
+    if (!ctx) {
+        return EXIT_FAILURE;
+    }
+
+    opterr = 0;
+    while ((opt = getopt_long(argc, argv, "hvp:o:n:", options, &opt_index)) != -1) {
+        switch (opt) {
+        case 'h':
+            help();
+            ret = EXIT_SUCCESS;
+            goto cleanup;
+        case 'v':
+            version();
+            ret = EXIT_SUCCESS;
+            goto cleanup;
+        case 'p':
+            if (ly_ctx_set_searchdir(ctx, optarg)) {
+                goto cleanup;
+            }
+            break;
+        case 'o':
+            output = optarg;
+            break;
+        case 'n':
+            name = optarg;
+            break;
+        default:
+            fprintf(stderr, "yang2c error: invalid option: -%c\n", optopt);
+            goto cleanup;
+        }
+    }
+    if (!output || (optind == argc)) {
+        help();
+        goto cleanup;
+    }
+
+    if (!name) {
+        dup = strdup(output);
+        if (!dup) {
+            goto cleanup;
+        }
+        name = basename(dup);
+    }
+    prefix = c_identifier(name);
+    if (!prefix || (asprintf(&header_path, "%s.h", output) == -1) || (asprintf(&source_path, "%s.c", output) == -1)) {
+        fprintf(stderr, "yang2c error: memory allocation failed.\n");
+        goto cleanup;
+    }
+    gen.prefix = prefix;
+
+    for (i = optind; i < argc; ++i) {
+        ptr = strrchr(argv[i], '.');
+        mod = lys_parse_path(ctx, argv[i], (ptr && !strcmp(ptr, ".yin")) ? LYS_IN_YIN : LYS_IN_YANG);
+        if (!mod) {
+            goto cleanup;
+        }
+        /* the nodes of all the features are generated, disabled ones just never appear in the data */
+        lys_features_enable((struct lys_module *)mod, "*");
+        gen.mods = realloc(gen.mods, (gen.mod_count + 1) * sizeof *gen.mods);
+        if (!gen.mods) {
+            goto cleanup;
+        }
+        gen.mods[gen.mod_count++] = mod;
+    }
+    for (i = 0; i < gen.mod_count; ++i) {
+        if (gen_collect(&gen, NULL, gen.mods[i])) {
+            fprintf(stderr, "yang2c error: memory allocation failed.\n");
+            goto cleanup;
+        }
+    }
+
+    out = fopen(header_path, "w");
+    if (!out) {
+        fprintf(stderr, "yang2c error: opening \"%s\" failed (%s).\n", header_path, strerror(errno));
+        goto cleanup;
+    }
+    if (asprintf(&guard, "%s_H_", prefix) == -1) {
+        fclose(out);
+        goto cleanup;
+    }
+    for (ptr = guard; *ptr; ++ptr) {
+        *ptr = toupper(*ptr);
+    }
+    print_header(out, &gen, guard);
+    fclose(out);
+
+    out = fopen(source_path, "w");
+    if (!out) {
+        fprintf(stderr, "yang2c error: opening \"%s\" failed (%s).\n", source_path, strerror(errno));
+        goto cleanup;
+    }
+    free(dup);
+    dup = strdup(header_path);
+    if (!dup || print_source(out, &gen, basename(dup))) {
+        fclose(out);
+        goto cleanup;
+    }
+    fclose(out);
+
+    ret = EXIT_SUCCESS;
+
+cleanup:
+    for (i = 0; i < gen.count; ++i) {
+        free(gen.nodes[i].id);
+        free(gen.nodes[i].path);
+    }
+    free(gen.nodes);
+    free(gen.mods);
+    free(header_path);
+    free(source_path);
+    free(prefix);
+    free(guard);
+    free(dup);
+    ly_ctx_destroy(ctx, NULL);
+    return ret;
+}